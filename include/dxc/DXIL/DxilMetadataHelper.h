@@ -370,6 +370,8 @@ public:
   void LoadDxilViewIdState(std::vector<unsigned> &SerializedState);
   // Control flow hints.
   static llvm::MDNode *EmitControlFlowHints(llvm::LLVMContext &Ctx, std::vector<DXIL::ControlFlowHint> &hints);
+  // Makes the branches of the module with the same hints share one node.
+  void UniqueControlFlowHints();
 
   // Subobjects
   void EmitSubobjects(const DxilSubobjects &Subobjects);
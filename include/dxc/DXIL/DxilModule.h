@@ -82,7 +82,15 @@ public:
 
   // Flags.
   unsigned GetGlobalFlags() const;
+  // Recollects the flags of every function, as passes don't say which
+  // functions they changed.
   void CollectShaderFlagsForModule();
+  // Gets the flags a function needs. They are collected on first use and
+  // kept until the function is invalidated or removed, so the flags of a
+  // library are collected once for emission, validation and the container.
+  ShaderFlags GetFunctionShaderFlags(const llvm::Function *F) const;
+  void InvalidateShaderFlags(const llvm::Function *F);
+  void InvalidateAllShaderFlags();
 
   // Resources.
   unsigned AddCBuffer(std::unique_ptr<DxilCBuffer> pCB);
@@ -167,12 +175,28 @@ public:
   const std::vector<unsigned> &GetSerializedViewIdState() const;
 
   // DXIL metadata manipulation.
+  /// Sections of the DXIL metadata that can be regenerated on their own.
+  enum MetadataSection : unsigned {
+    kMDVersions = 1 << 0,      // DXIL and validator versions, shader model
+                               // and intermediate options.
+    kMDEntryPoints = 1 << 1,   // Entries with their properties, signatures
+                               // and resources, and llvm.used.
+    kMDTypeSystem = 1 << 2,    // Type and function annotations.
+    kMDViewIdState = 1 << 3,
+    kMDSubobjects = 1 << 4,
+    kMDRootSignature = 1 << 5,
+    kMDAll = (1 << 6) - 1,
+  };
   /// Clear all DXIL data that exists in in-memory form.
   static void ClearDxilMetadata(llvm::Module &M);
   /// Serialize DXIL in-memory form to metadata form.
   void EmitDxilMetadata();
-  /// Update resource metadata.
-  /// Note: this method not update Metadata for ViewIdState.
+  /// Note that the in-memory form of the given sections changed.
+  void MarkDxilMetadataDirty(unsigned Sections);
+  /// Regenerate the sections marked dirty, leaving the others as they are.
+  void EmitDirtyDxilMetadata();
+  /// Update version, entry point and resource metadata, and the sections
+  /// marked dirty.
   void ReEmitDxilResources();
   /// Deserialize DXIL metadata form into in-memory form.
   void LoadDxilMetadata();
@@ -322,6 +346,7 @@ private:
 
   // Type annotations.
   std::unique_ptr<DxilTypeSystem> m_pTypeSystem;
+  bool m_bTypeSystemPending;
 
   // EntryProps for shader functions.
   DxilEntryPropsMap  m_DxilEntryPropsMap;
@@ -332,9 +357,20 @@ private:
   // Serialized ViewId state.
   std::vector<unsigned> m_SerializedState;
 
+  // Metadata sections whose in-memory form changed since they were emitted.
+  unsigned m_DirtyMetadata;
+
   // DXIL metadata serialization/deserialization.
   llvm::MDTuple *EmitDxilResources();
   void LoadDxilResources(const llvm::MDOperand &MDO);
+  static unsigned GetMetadataSection(llvm::StringRef Name);
+  void ClearDxilMetadataSections(unsigned Sections);
+  void EmitDxilMetadataSections(unsigned Sections);
+  // Type annotations and subobjects are decoded on first access, since a
+  // loaded module is often only queried for its shader model and resources.
+  void LoadPendingTypeSystem();
+  void LoadPendingSubobjects() const;
+  void LoadPendingMetadata();
 
   // Helpers.
   template<typename T> unsigned AddResource(std::vector<std::unique_ptr<T> > &Vec, std::unique_ptr<T> pRes);
@@ -349,7 +385,15 @@ private:
   uint32_t m_IntermediateFlags;
   uint32_t m_AutoBindingSpace;
 
-  std::unique_ptr<DxilSubobjects> m_pSubobjects;
+  mutable std::unique_ptr<DxilSubobjects> m_pSubobjects;
+  mutable bool m_bSubobjectsPending;
+
+  // Flags collected per function, and the validator version they were
+  // collected for.
+  mutable std::unordered_map<const llvm::Function *, ShaderFlags>
+      m_FunctionShaderFlags;
+  mutable unsigned m_ShaderFlagsValMajor;
+  mutable unsigned m_ShaderFlagsValMinor;
 };
 
 } // namespace hlsl
@@ -132,7 +132,9 @@ private:
     llvm::SmallDenseMap<llvm::Type *, llvm::Function *, 8> pOverloads;
   };
   OpCodeCacheItem m_OpCodeClassCache[(unsigned)OpCodeClass::NumOpClasses];
-  std::unordered_map<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
+  // Queried for every dx.op call site that is classified, so it is kept as an
+  // open-addressed map and only written when a function is created or removed.
+  llvm::DenseMap<const llvm::Function *, OpCodeClass> m_FunctionToOpClass;
   void UpdateCache(OpCodeClass opClass, llvm::Type * Ty, llvm::Function *F);
 private:
   // Static properties.
@@ -40,6 +40,11 @@ public:
   const DxilSignatureElement &GetElement(unsigned idx) const;
   const std::vector<std::unique_ptr<DxilSignatureElement> > &GetElements() const;
 
+  // Removes the elements that bRemove is set for and renumbers the rest in
+  // order. Returns the new ID of each old element, or kUndefinedID if it was
+  // removed.
+  std::vector<unsigned> RemoveElements(const std::vector<bool> &bRemove);
+
   // Returns true if all signature elements that should be allocated are allocated
   bool IsFullyAllocated() const;
 
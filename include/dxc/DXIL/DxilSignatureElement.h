@@ -57,6 +57,7 @@ public:
   unsigned GetCols() const;
   void SetCols(unsigned Cols);
   const InterpolationMode *GetInterpolationMode() const;
+  void SetInterpolationMode(const InterpolationMode &InterpMode);
   CompType GetCompType() const;
   unsigned GetOutputStream() const;
   void SetOutputStream(unsigned Stream);
@@ -28,6 +28,7 @@ class DiagnosticInfo;
 class Value;
 class Instruction;
 class BasicBlock;
+class BranchInst;
 class raw_ostream;
 class ModulePass;
 class PassRegistry;
@@ -97,6 +98,10 @@ namespace dxilutil {
                                       unsigned startOpIdx,
                                       unsigned numOperands);
   bool SimplifyTrivialPHIs(llvm::BasicBlock *BB);
+  // Gets the profile weights of the two successors of a conditional branch,
+  // which -fprofile-use attaches as branch_weights metadata.
+  bool GetBranchWeights(llvm::BranchInst *BI, uint64_t *pTrueWeight,
+                        uint64_t *pFalseWeight);
   std::unique_ptr<llvm::Module> LoadModuleFromBitcode(llvm::StringRef BC,
     llvm::LLVMContext &Ctx, std::string &DiagStr);
   std::unique_ptr<llvm::Module> LoadModuleFromBitcode(llvm::MemoryBuffer *MB,
@@ -83,6 +83,7 @@ enum DxilFourCC {
   DFCC_DXIL                     = DXIL_FOURCC('D', 'X', 'I', 'L'),
   DFCC_PipelineStateValidation  = DXIL_FOURCC('P', 'S', 'V', '0'),
   DFCC_RuntimeData              = DXIL_FOURCC('R', 'D', 'A', 'T'),
+  DFCC_CompressedPart           = DXIL_FOURCC('C', 'M', 'P', 'R'),
 };
 
 #undef DXIL_FOURCC
@@ -197,6 +198,21 @@ struct DxilShaderDebugName {
 };
 static const size_t MinDxilShaderDebugNameSize = sizeof(DxilShaderDebugName) + 4;
 
+enum class DxilPartCompression : uint32_t {
+  Zlib = 1,
+};
+
+/// Use this type to describe a part stored in compressed form, in a
+/// DFCC_CompressedPart part.
+struct DxilCompressedPartHeader {
+  uint32_t PartFourCC;       // Four char code of the original part.
+  uint32_t Compression;      // DxilPartCompression of the data.
+  uint32_t UncompressedSize; // Byte count of the original PartData.
+  uint32_t CompressedSize;   // Byte count of the compressed data.
+  // Followed by uint8_t CompressedData[CompressedSize].
+  // Followed by [0-3] zero bytes to align to a 4-byte boundary.
+};
+
 #pragma pack(pop)
 
 /// Gets a part header by index.
@@ -250,6 +266,38 @@ const DxilContainerHeader *IsDxilContainerLike(const void *ptr, size_t length);
 /// Checks whether the DXIL container is valid and in-bounds.
 bool IsValidDxilContainer(const DxilContainerHeader *pHeader, size_t length);
 
+/// Checks whether the parts of a valid container follow each other in order,
+/// as DxilContainerWriter lays them out, so that writing them again gives
+/// back the same bytes.
+bool HasContiguousDxilParts(const DxilContainerHeader *pHeader);
+
+/// Checks whether the DXIL container has parts stored in compressed form.
+bool HasCompressedDxilParts(const DxilContainerHeader *pHeader);
+
+/// Writes a copy of a valid container with its DXIL and debug info parts
+/// compressed, where that makes them smaller. Decompressing the copy gives
+/// back the original bytes, so signed containers stay signed. The container
+/// is copied as is if its parts aren't laid out one after the other, or if
+/// compression is unavailable.
+void CompressDxilContainer(const DxilContainerHeader *pHeader,
+                           AbstractMemoryStream *pStream);
+
+/// Writes a copy of a valid container with its compressed parts restored.
+/// Returns DXC_E_CONTAINER_INVALID if a compressed part is malformed, and
+/// E_NOTIMPL if compression is unavailable.
+HRESULT DecompressDxilContainer(const DxilContainerHeader *pHeader,
+                                AbstractMemoryStream *pStream);
+
+/// Computes a hash of the parts of a valid container that decide what the
+/// code does: DXIL, the signatures, SFI0, PSV0, RTS0 and RDAT. Containers
+/// that only differ in debug info, the debug name, embedded source,
+/// reflection, statistics or private data hash the same, whether or not
+/// their parts are compressed. The hash is xxHash64, so it is the same on
+/// every host and release; it is unrelated to the validator's container
+/// hash. Returns the errors of DecompressDxilContainer.
+HRESULT GetDxilContainerSemanticHash(const DxilContainerHeader *pHeader,
+                                     uint64_t *pHash);
+
 /// Use this type as a unary predicate functor.
 struct DxilPartIsType {
   uint32_t IsFourCC;
@@ -394,7 +442,9 @@ enum class SerializeDxilFlags : uint32_t {
   None = 0,                     // No flags defined.
   IncludeDebugInfoPart = 1,     // Include the debug info part in the container.
   IncludeDebugNamePart = 2,     // Include the debug name part in the container.
-  DebugNameDependOnSource = 4   // Make the debug name depend on source (and not just final module).
+  DebugNameDependOnSource = 4,  // Make the debug name depend on source (and not just final module).
+  IncludeStatisticsPart = 8,    // Include the shader statistics part in the container.
+  CompactParts = 16             // Index names and share strings in RDAT and PSV0.
 };
 inline SerializeDxilFlags& operator |=(SerializeDxilFlags& l, const SerializeDxilFlags& r) {
   l = static_cast<SerializeDxilFlags>(static_cast<int>(l) | static_cast<int>(r));
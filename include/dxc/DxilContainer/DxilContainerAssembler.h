@@ -40,15 +40,22 @@ public:
 DxilPartWriter *NewProgramSignatureWriter(const DxilModule &M, DXIL::SignatureKind Kind);
 DxilPartWriter *NewRootSignatureWriter(const RootSignatureHandle &S);
 DxilPartWriter *NewFeatureInfoWriter(const DxilModule &M);
-DxilPartWriter *NewPSVWriter(const DxilModule &M, uint32_t PSVVersion = 0);
+DxilPartWriter *NewPSVWriter(const DxilModule &M, uint32_t PSVVersion = 0,
+                             bool bCompactStrings = true);
 DxilPartWriter *NewRDATWriter(const DxilModule &M, uint32_t InfoVersion = 0);
+DxilPartWriter *NewShaderStatisticsWriter(const DxilModule &M);
 
 DxilContainerWriter *NewDxilContainerWriter();
 
-void SerializeDxilContainerForModule(hlsl::DxilModule *pModule,
-                                     AbstractMemoryStream *pModuleBitcode,
-                                     AbstractMemoryStream *pStream,
-                                     SerializeDxilFlags Flags);
+// pModuleBitcode holds the module as already serialized by the caller, or is
+// empty to have the module serialized here, once container-only metadata has
+// been stripped from it. A caller that wrote the debug bitcode elsewhere can
+// pass its MD5 in pDebugBitcodeHash, so that a debug name depending on the
+// source doesn't need the module serialized again.
+void SerializeDxilContainerForModule(
+    hlsl::DxilModule *pModule, AbstractMemoryStream *pModuleBitcode,
+    AbstractMemoryStream *pStream, SerializeDxilFlags Flags,
+    const DxilContainerHash *pDebugBitcodeHash = nullptr);
 void SerializeDxilContainerForRootSignature(hlsl::RootSignatureHandle *pRootSigHandle,
                                      AbstractMemoryStream *pStream);
 
@@ -11,6 +11,10 @@
 
 #pragma once
 
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+
 namespace hlsl {
 
 class DxilSubobjects;
@@ -21,4 +25,29 @@ namespace RDAT {
 bool LoadSubobjectsFromRDAT(DxilSubobjects &subobjects,
   RDAT::SubobjectTableReader *pSubobjectTableReader);
 
+/// Read-only view of a container held in a blob, usually a file mapped with
+/// DxcCreateBlobFromMappedFile. Load checks the container header and the
+/// part offset table; a part's bounds are only checked when it is accessed,
+/// so reading one part of a container only touches the pages that hold it.
+/// Part pointers point into the blob and are valid while the view is.
+class DxilContainerView {
+public:
+  /// Returns DXC_E_CONTAINER_INVALID if the blob isn't a container.
+  HRESULT Load(_In_ IDxcBlob *pBlob);
+  HRESULT LoadFile(_In_z_ LPCWSTR pFileName);
+
+  bool IsLoaded() const { return m_pHeader != nullptr; }
+  const DxilContainerHeader *GetHeader() const { return m_pHeader; }
+  uint32_t GetPartCount() const { return m_pHeader ? m_pHeader->PartCount : 0; }
+
+  /// Returns nullptr if the part doesn't fit in the container.
+  const DxilPartHeader *GetPart(uint32_t index) const;
+  /// Returns the first part of the given kind, or nullptr.
+  const DxilPartHeader *FindPart(uint32_t fourCC) const;
+
+private:
+  CComPtr<IDxcBlob> m_pBlob;
+  const DxilContainerHeader *m_pHeader = nullptr;
+};
+
 } // namespace hlsl
\ No newline at end of file
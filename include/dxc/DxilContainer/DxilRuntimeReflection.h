@@ -11,6 +11,7 @@
 
 #pragma once
 #include "dxc/DXIL/DxilConstants.h"
+#include <string.h>
 
 namespace hlsl {
 namespace RDAT {
@@ -29,6 +30,10 @@ namespace RDAT {
 //      byte UTF8Data[part.Size];
 //    - else if part.Type is Index:
 //      uint32_t IndexData[part.Size / 4];
+//    - else if part.Type is NameIndex:
+//      - for each indexed table:
+//        RuntimeDataNameIndexHeader index;
+//        uint32_t Rows[index.RowCount];
 
 enum class RuntimeDataPartType : uint32_t {
   Invalid         = 0,
@@ -38,6 +43,7 @@ enum class RuntimeDataPartType : uint32_t {
   FunctionTable   = 4,
   RawBytes        = 5,
   SubobjectTable  = 6,
+  NameIndex       = 7,
 };
 
 enum RuntimeDataVersion {
@@ -69,6 +75,23 @@ struct RuntimeDataTableHeader {
   // byte TableData[RecordCount * RecordStride];
 };
 
+// Which names of which table a name index sorts.
+enum class RuntimeDataNameIndexKind : uint32_t {
+  ResourceName          = 0,
+  FunctionName          = 1,
+  FunctionUnmangledName = 2,
+  SubobjectName         = 3,
+};
+
+// Name indices let readers find rows by name with a binary search rather than
+// a scan. Readers that predate them skip the part.
+struct RuntimeDataNameIndexHeader {
+  RuntimeDataNameIndexKind Kind;
+  uint32_t RowCount;  // Must match the RecordCount of the table.
+  // Followed by the row indices, in strcmp order of the names of their rows
+  //  uint32_t Rows[RowCount];
+};
+
 // General purpose strided table reader with casting Row() operation that
 // returns nullptr if stride is smaller than type, for record expansion.
 class TableReader {
@@ -127,6 +150,46 @@ public:
   IndexRow getRow(uint32_t i) { return IndexRow(&m_table[i] + 1, m_table[i]); }
 };
 
+// Reader for a name index. Without an index for the table, Find falls back
+// to scanning the table.
+class NameIndexReader {
+  const uint32_t *m_rows;
+  uint32_t m_count;
+
+public:
+  NameIndexReader() : m_rows(nullptr), m_count(0) {}
+  void Init(const uint32_t *rows, uint32_t count) {
+    m_rows = rows; m_count = count;
+  }
+  bool IsPresent() const { return m_rows != nullptr; }
+
+  // Returns the index of the first row with the given name, or UINT_MAX.
+  // getName gives the name of the row at an index.
+  template <typename GetNameFn>
+  uint32_t Find(const char *name, uint32_t rowCount, GetNameFn getName) const {
+    if (!m_rows || m_count != rowCount) {
+      for (uint32_t i = 0; i < rowCount; ++i) {
+        if (0 == strcmp(getName(i), name))
+          return i;
+      }
+      return UINT_MAX;
+    }
+    uint32_t lo = 0, hi = m_count;
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (m_rows[mid] >= rowCount)
+        return UINT_MAX; // Malformed index.
+      if (strcmp(getName(m_rows[mid]), name) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    if (lo < m_count && 0 == strcmp(getName(m_rows[lo]), name))
+      return m_rows[lo];
+    return UINT_MAX;
+  }
+};
+
 class StringTableReader {
   const char *m_table;
   uint32_t m_size;
@@ -274,6 +337,7 @@ public:
 class ResourceTableReader {
 private:
   TableReader m_Table;
+  NameIndexReader m_NameIndex;
   RuntimeDataContext *m_Context;
   uint32_t m_CBufferCount;
   uint32_t m_SamplerCount;
@@ -309,6 +373,9 @@ public:
   }
 
   void SetContext(RuntimeDataContext *context) { m_Context = context; }
+  void SetNameIndex(const uint32_t *rows, uint32_t count) {
+    m_NameIndex.Init(rows, count);
+  }
 
   uint32_t GetNumResources() const {
     return m_CBufferCount + m_SamplerCount + m_SRVCount + m_UAVCount;
@@ -317,6 +384,12 @@ public:
     _Analysis_assume_(i < GetNumResources());
     return ResourceReader(m_Table.Row<RuntimeDataResourceInfo>(i), m_Context);
   }
+  // Returns the index of the resource with the given name, or UINT_MAX.
+  uint32_t FindResource(const char *name) const {
+    return m_NameIndex.Find(name, m_Table.Count(), [this](uint32_t i) {
+      return GetItem(i).GetName();
+    });
+  }
 
   uint32_t GetNumCBuffers() const { return m_CBufferCount; }
   ResourceReader GetCBuffer(uint32_t i) {
@@ -438,6 +511,8 @@ public:
 class FunctionTableReader {
 private:
   TableReader m_Table;
+  NameIndexReader m_NameIndex;
+  NameIndexReader m_UnmangledNameIndex;
   RuntimeDataContext *m_Context;
 
 public:
@@ -447,10 +522,30 @@ public:
     return FunctionReader(m_Table.Row<RuntimeDataFunctionInfo>(i), m_Context);
   }
   uint32_t GetNumFunctions() const { return m_Table.Count(); }
+  // Returns the index of the function with the given mangled name, or
+  // UINT_MAX.
+  uint32_t FindFunction(const char *name) const {
+    return m_NameIndex.Find(name, m_Table.Count(), [this](uint32_t i) {
+      return GetItem(i).GetName();
+    });
+  }
+  // Returns the index of the first function with the given unmangled name,
+  // or UINT_MAX. Overloads share an unmangled name.
+  uint32_t FindFunctionByUnmangledName(const char *name) const {
+    return m_UnmangledNameIndex.Find(name, m_Table.Count(), [this](uint32_t i) {
+      return GetItem(i).GetUnmangledName();
+    });
+  }
 
   void SetFunctionInfo(const char *ptr, uint32_t count, uint32_t recordStride) {
     m_Table.Init(ptr, count, recordStride);
   }
+  void SetNameIndex(const uint32_t *rows, uint32_t count) {
+    m_NameIndex.Init(rows, count);
+  }
+  void SetUnmangledNameIndex(const uint32_t *rows, uint32_t count) {
+    m_UnmangledNameIndex.Init(rows, count);
+  }
   void SetContext(RuntimeDataContext *context) { m_Context = context; }
 };
 
@@ -554,6 +649,7 @@ public:
 class SubobjectTableReader {
 private:
   TableReader m_Table;
+  NameIndexReader m_NameIndex;
   RuntimeDataContext *m_Context;
 
 public:
@@ -563,11 +659,20 @@ public:
   void SetSubobjectInfo(const char *ptr, uint32_t count, uint32_t recordStride) {
     m_Table.Init(ptr, count, recordStride);
   }
+  void SetNameIndex(const uint32_t *rows, uint32_t count) {
+    m_NameIndex.Init(rows, count);
+  }
 
   uint32_t GetCount() const { return m_Table.Count(); }
   SubobjectReader GetItem(uint32_t i) const {
     return SubobjectReader(m_Table.Row<RuntimeDataSubobjectInfo>(i), m_Context);
   }
+  // Returns the index of the subobject with the given name, or UINT_MAX.
+  uint32_t FindSubobject(const char *name) const {
+    return m_NameIndex.Find(name, m_Table.Count(), [this](uint32_t i) {
+      return GetItem(i).GetName();
+    });
+  }
 };
 
 class DxilRuntimeData {
@@ -580,6 +685,7 @@ private:
   FunctionTableReader m_FunctionTableReader;
   SubobjectTableReader m_SubobjectTableReader;
   RuntimeDataContext m_Context;
+  bool m_HasNameIndex;
 
 public:
   DxilRuntimeData();
@@ -591,6 +697,8 @@ public:
   FunctionTableReader *GetFunctionTableReader();
   ResourceTableReader *GetResourceTableReader();
   SubobjectTableReader *GetSubobjectTableReader();
+  // Whether the RDAT has a name index part.
+  bool HasNameIndex() const { return m_HasNameIndex; }
 };
 
 //////////////////////////////////
@@ -94,7 +94,7 @@ DxilRuntimeData::DxilRuntimeData() : DxilRuntimeData(nullptr, 0) {}
 DxilRuntimeData::DxilRuntimeData(const void *ptr, size_t size)
     : m_TableCount(0), m_StringReader(), m_IndexTableReader(), m_RawBytesReader(),
       m_ResourceTableReader(), m_FunctionTableReader(),
-      m_SubobjectTableReader(), m_Context() {
+      m_SubobjectTableReader(), m_Context(), m_HasNameIndex(false) {
   m_Context = {&m_StringReader, &m_IndexTableReader, &m_RawBytesReader,
                &m_ResourceTableReader, &m_FunctionTableReader,
                &m_SubobjectTableReader};
@@ -157,6 +157,34 @@ bool DxilRuntimeData::InitFromRDAT(const void *pRDAT, size_t size) {
             table.RecordCount, table.RecordStride);
           break;
         }
+        case RuntimeDataPartType::NameIndex: {
+          m_HasNameIndex = true;
+          size_t offset = 0;
+          while (offset < part.Size) {
+            RuntimeDataNameIndexHeader index =
+                PR.Read<RuntimeDataNameIndexHeader>();
+            const uint32_t *rows = PR.ReadArray<uint32_t>(index.RowCount);
+            offset += sizeof(RuntimeDataNameIndexHeader) +
+                      sizeof(uint32_t) * (size_t)index.RowCount;
+            switch (index.Kind) {
+            case RuntimeDataNameIndexKind::ResourceName:
+              m_ResourceTableReader.SetNameIndex(rows, index.RowCount);
+              break;
+            case RuntimeDataNameIndexKind::FunctionName:
+              m_FunctionTableReader.SetNameIndex(rows, index.RowCount);
+              break;
+            case RuntimeDataNameIndexKind::FunctionUnmangledName:
+              m_FunctionTableReader.SetUnmangledNameIndex(rows, index.RowCount);
+              break;
+            case RuntimeDataNameIndexKind::SubobjectName:
+              m_SubobjectTableReader.SetNameIndex(rows, index.RowCount);
+              break;
+            default:
+              break; // Skip unrecognized indices
+            }
+          }
+          break;
+        }
         default:
           continue; // Skip unrecognized parts
         }
@@ -0,0 +1,117 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderArchive.h                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides declarations for the shader archive format, which packs many     //
+// containers and stores the parts they share once.                          //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "dxc/DxilContainer/DxilContainer.h"
+
+namespace hlsl {
+
+class AbstractMemoryStream;
+
+#pragma pack(push, 1)
+
+static const uint32_t DxilShaderArchiveFourCC =
+    (uint32_t)'D' | (uint32_t)'X' << 8 | (uint32_t)'A' << 16 |
+    (uint32_t)'R' << 24;
+static const uint32_t DxilShaderArchiveVersion = 1;
+
+/// Use this type to describe a shader archive. All offsets are from the
+/// start of this header.
+struct DxilShaderArchiveHeader {
+  uint32_t HeaderFourCC;       // DxilShaderArchiveFourCC
+  uint32_t Version;            // DxilShaderArchiveVersion
+  uint32_t ArchiveSizeInBytes;
+  uint32_t ContainerCount;
+  uint32_t PartCount;          // Distinct parts.
+  uint32_t PartRefCount;       // Parts of all containers.
+  // Followed by DxilShaderArchiveEntry Entries[ContainerCount], by Key.
+  // Followed by DxilShaderArchivePart Parts[PartCount].
+  // Followed by uint32_t PartRefs[PartRefCount], indices into Parts.
+  // Followed by the part data, each aligned to 4 bytes.
+};
+
+/// Use this type to describe a container in a shader archive.
+struct DxilShaderArchiveEntry {
+  // The container hash, or for containers without one, the MD5 of the
+  // container.
+  DxilContainerHash Key;
+  // The original header; PartCount is also the count of PartRefs.
+  DxilContainerHeader Header;
+  uint32_t FirstPartRef;
+};
+
+/// Use this type to describe a distinct part in a shader archive.
+struct DxilShaderArchivePart {
+  uint32_t PartFourCC;
+  uint32_t PartSize;
+  uint32_t DataOffset;
+};
+
+#pragma pack(pop)
+
+/// Gets the entries, sorted by key.
+inline const DxilShaderArchiveEntry *
+GetDxilShaderArchiveEntries(const DxilShaderArchiveHeader *pHeader) {
+  return reinterpret_cast<const DxilShaderArchiveEntry *>(pHeader + 1);
+}
+
+/// Gets the distinct parts.
+inline const DxilShaderArchivePart *
+GetDxilShaderArchiveParts(const DxilShaderArchiveHeader *pHeader) {
+  return reinterpret_cast<const DxilShaderArchivePart *>(
+      GetDxilShaderArchiveEntries(pHeader) + pHeader->ContainerCount);
+}
+
+/// Gets the indices of the parts of all containers.
+inline const uint32_t *
+GetDxilShaderArchivePartRefs(const DxilShaderArchiveHeader *pHeader) {
+  return reinterpret_cast<const uint32_t *>(GetDxilShaderArchiveParts(pHeader) +
+                                            pHeader->PartCount);
+}
+
+/// Gets a part of a container in the archive.
+inline const DxilShaderArchivePart *
+GetDxilShaderArchivePart(const DxilShaderArchiveHeader *pHeader,
+                         const DxilShaderArchiveEntry *pEntry, uint32_t index) {
+  return GetDxilShaderArchiveParts(pHeader) +
+         GetDxilShaderArchivePartRefs(pHeader)[pEntry->FirstPartRef + index];
+}
+
+/// Gets the data of a part in the archive.
+inline const char *
+GetDxilShaderArchivePartData(const DxilShaderArchiveHeader *pHeader,
+                             const DxilShaderArchivePart *pPart) {
+  return reinterpret_cast<const char *>(pHeader) + pPart->DataOffset;
+}
+
+/// Gets the key under which a container is archived.
+void GetDxilShaderArchiveKey(const DxilContainerHeader *pHeader,
+                             DxilContainerHash *pKey);
+
+/// Checks whether the archive is valid and in-bounds. Only the tables are
+/// read; part data isn't touched.
+bool IsValidDxilShaderArchive(const DxilShaderArchiveHeader *pHeader,
+                              size_t length);
+
+/// Finds the entry with the given key in a valid archive, or nullptr.
+const DxilShaderArchiveEntry *
+FindDxilShaderArchiveEntry(const DxilShaderArchiveHeader *pHeader,
+                           const DxilContainerHash &Key);
+
+/// Writes the container of an entry of a valid archive. This gives back the
+/// bytes that were archived.
+void WriteDxilShaderArchiveContainer(const DxilShaderArchiveHeader *pHeader,
+                                     const DxilShaderArchiveEntry *pEntry,
+                                     AbstractMemoryStream *pStream);
+
+} // namespace hlsl
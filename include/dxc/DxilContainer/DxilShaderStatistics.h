@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderStatistics.h                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides declarations for the shader statistics (STAT) part, which holds  //
+// the instruction mix of each entry so tools need not parse the bitcode.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+namespace hlsl {
+
+#pragma pack(push, 1)
+
+static const uint32_t DxilShaderStatisticsVersion = 1;
+
+/// Use this type to describe the shader statistics part.
+struct DxilShaderStatisticsHeader {
+  uint32_t Version;         // DxilShaderStatisticsVersion
+  uint32_t EntrySize;       // Size of each entry; may grow in later versions.
+  uint32_t EntryCount;
+  uint32_t OpCountCount;
+  uint32_t StringTableSize;
+  // Followed by the entries, each EntrySize bytes.
+  // Followed by DxilShaderStatisticsOpCount OpCounts[OpCountCount].
+  // Followed by the string table of null-terminated entry names, which
+  // starts with the empty string.
+};
+
+/// Use this type to describe the statistics of an entry, the function and
+/// everything it calls. The counts are named as in D3D12_SHADER_DESC.
+struct DxilShaderStatisticsEntry {
+  uint32_t Name;            // Offset in the string table.
+
+  uint32_t InstructionCount;            // All but debug intrinsics.
+  uint32_t TempArrayCount;              // Local arrays.
+  uint32_t TextureNormalInstructions;   // Sample, SampleLevel, Gather.
+  uint32_t TextureLoadInstructions;     // Texture and buffer loads.
+  uint32_t TextureCompInstructions;     // Comparison samples and gathers.
+  uint32_t TextureBiasInstructions;
+  uint32_t TextureGradientInstructions;
+  uint32_t FloatInstructionCount;
+  uint32_t IntInstructionCount;
+  uint32_t UintInstructionCount;
+  uint32_t StaticFlowControlCount;      // Unconditional branches.
+  uint32_t DynamicFlowControlCount;     // Conditional branches and switches.
+  uint32_t ArrayInstructionCount;       // Indexed loads and stores.
+  uint32_t CutInstructionCount;
+  uint32_t EmitInstructionCount;
+  uint32_t MovcInstructionCount;        // Selects.
+  uint32_t ConversionInstructionCount;
+  uint32_t BitwiseInstructionCount;     // Including shifts and bit counts.
+  uint32_t BarrierInstructions;
+  uint32_t InterlockedInstructions;
+  uint32_t TextureStoreInstructions;    // Texture and buffer stores.
+
+  uint32_t TempArrayBytes;
+  uint32_t GroupSharedBytes;
+
+  // Properties of a shader entry, as in D3D12_SHADER_DESC; zero in libraries.
+  uint32_t GSOutputTopology;
+  uint32_t GSMaxOutputVertexCount;
+  uint32_t InputPrimitive;
+  uint32_t GSInstanceCount;
+  uint32_t ControlPoints;
+  uint32_t HSOutputPrimitive;
+  uint32_t HSPartitioning;
+  uint32_t TessellatorDomain;
+
+  // The calls of each DXIL operation, as a range of OpCounts.
+  uint32_t FirstOpCount;
+  uint32_t OpCountCount;
+};
+
+/// Use this type to count the calls of a DXIL operation.
+struct DxilShaderStatisticsOpCount {
+  uint32_t OpCode;          // DXIL::OpCode
+  uint32_t Count;
+};
+
+#pragma pack(pop)
+
+/// Gets the first op count of a valid part.
+inline const DxilShaderStatisticsOpCount *
+GetDxilShaderStatisticsOpCounts(const DxilShaderStatisticsHeader *pHeader) {
+  return reinterpret_cast<const DxilShaderStatisticsOpCount *>(
+      reinterpret_cast<const char *>(pHeader + 1) +
+      pHeader->EntrySize * pHeader->EntryCount);
+}
+
+/// Gets the string table of a valid part.
+inline const char *
+GetDxilShaderStatisticsStrings(const DxilShaderStatisticsHeader *pHeader) {
+  return reinterpret_cast<const char *>(
+      GetDxilShaderStatisticsOpCounts(pHeader) + pHeader->OpCountCount);
+}
+
+/// Checks whether the part is valid and in-bounds.
+inline bool IsValidDxilShaderStatistics(const DxilShaderStatisticsHeader *pHeader,
+                                        uint32_t length) {
+  if (length < sizeof(DxilShaderStatisticsHeader) ||
+      pHeader->Version < DxilShaderStatisticsVersion ||
+      pHeader->EntrySize < sizeof(uint32_t))
+    return false;
+  uint64_t size = sizeof(DxilShaderStatisticsHeader) +
+                  (uint64_t)pHeader->EntrySize * pHeader->EntryCount +
+                  (uint64_t)pHeader->OpCountCount *
+                      sizeof(DxilShaderStatisticsOpCount) +
+                  pHeader->StringTableSize;
+  if (size > length)
+    return false;
+  const char *pStrings = GetDxilShaderStatisticsStrings(pHeader);
+  return pHeader->StringTableSize != 0 &&
+         pStrings[pHeader->StringTableSize - 1] == '\0';
+}
+
+/// Reads an entry of a valid part. Fields the part predates are zero. Returns
+/// false if the entry points outside the part.
+inline bool GetDxilShaderStatisticsEntry(const DxilShaderStatisticsHeader *pHeader,
+                                         uint32_t index,
+                                         DxilShaderStatisticsEntry *pEntry) {
+  if (index >= pHeader->EntryCount)
+    return false;
+  const char *pData =
+      reinterpret_cast<const char *>(pHeader + 1) + pHeader->EntrySize * index;
+  uint32_t size = pHeader->EntrySize < sizeof(DxilShaderStatisticsEntry)
+                      ? pHeader->EntrySize
+                      : (uint32_t)sizeof(DxilShaderStatisticsEntry);
+  memset(pEntry, 0, sizeof(*pEntry));
+  memcpy(pEntry, pData, size);
+  return pEntry->Name < pHeader->StringTableSize &&
+         (uint64_t)pEntry->FirstOpCount + pEntry->OpCountCount <=
+             pHeader->OpCountCount;
+}
+
+/// Finds the entry with the given name in a valid part.
+inline bool FindDxilShaderStatisticsEntry(const DxilShaderStatisticsHeader *pHeader,
+                                          const char *pName,
+                                          DxilShaderStatisticsEntry *pEntry) {
+  const char *pStrings = GetDxilShaderStatisticsStrings(pHeader);
+  for (uint32_t i = 0; i < pHeader->EntryCount; ++i) {
+    if (GetDxilShaderStatisticsEntry(pHeader, i, pEntry) &&
+        strcmp(pStrings + pEntry->Name, pName) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace hlsl
@@ -17,20 +17,24 @@ class PassRegistry;
 
 ModulePass *createDxilAddPixelHitInstrumentationPass();
 ModulePass *createDxilAnnotateWithVirtualRegisterPass();
+ModulePass *createDxilBlockCountInstrumentationPass();
 ModulePass *createDxilOutputColorBecomesConstantPass();
 ModulePass *createDxilRemoveDiscardsPass();
 ModulePass *createDxilReduceMSAAToSingleSamplePass();
 ModulePass *createDxilForceEarlyZPass();
 ModulePass *createDxilDebugInstrumentationPass();
 ModulePass *createDxilShaderAccessTrackingPass();
+ModulePass *createDxilTimestampInstrumentationPass();
 
 void initializeDxilAddPixelHitInstrumentationPass(llvm::PassRegistry&);
 void initializeDxilAnnotateWithVirtualRegisterPass(llvm::PassRegistry&);
+void initializeDxilBlockCountInstrumentationPass(llvm::PassRegistry&);
 void initializeDxilOutputColorBecomesConstantPass(llvm::PassRegistry&);
 void initializeDxilRemoveDiscardsPass(llvm::PassRegistry&);
 void initializeDxilReduceMSAAToSingleSamplePass(llvm::PassRegistry&);
 void initializeDxilForceEarlyZPass(llvm::PassRegistry&);
 void initializeDxilDebugInstrumentationPass(llvm::PassRegistry&);
 void initializeDxilShaderAccessTrackingPass(llvm::PassRegistry&);
+void initializeDxilTimestampInstrumentationPass(llvm::PassRegistry&);
 
 }
@@ -15,6 +15,8 @@
 #define __DXC_ROOTSIGNATURE__
 
 #include <stdint.h>
+#include <memory>
+#include <string>
 
 #include "dxc/Support/WinAdapter.h"
 
@@ -41,6 +43,7 @@ struct DxilRootSignatureDesc;
 struct DxilRootSignatureDesc1;
 struct DxilStaticSamplerDesc;
 struct DxilVersionedRootSignatureDesc;
+class RootSignatureVerifier;
 
 // Constant values.
 static const uint32_t DxilDescriptorRangeOffsetAppend = 0xffffffff;
@@ -371,6 +374,81 @@ bool VerifyRootSignature(_In_ const DxilVersionedRootSignatureDesc *pDesc,
                          _In_ llvm::raw_ostream &DiagStream,
                          _In_ bool bAllowReservedRegisterSpace);
 
+// Use this class to share a root signature that has been deserialized and
+// verified once, through GetCachedRootSignature. It is safe to use from
+// many threads.
+class CachedRootSignature {
+public:
+  // Deserializes and verifies a serialized root signature; throws if it
+  // can't be deserialized.
+  CachedRootSignature(const void *pData, uint32_t length);
+  ~CachedRootSignature();
+
+  const RootSignatureHandle &GetHandle() const { return m_Handle; }
+  const DxilVersionedRootSignatureDesc *GetDesc() const {
+    return m_Handle.GetDesc();
+  }
+  // Whether it passed VerifyRootSignature.
+  bool IsValid() const { return m_pVerifier != nullptr; }
+
+  // Same as VerifyRootSignatureWithShaderPSV, without verifying the root
+  // signature again.
+  bool VerifyShaderPSV(DXIL::ShaderKind ShaderKind, const void *pPSVData,
+                       uint32_t PSVSize, llvm::raw_ostream &DiagStream) const;
+
+private:
+  RootSignatureHandle m_Handle;
+  std::unique_ptr<RootSignatureVerifier> m_pVerifier;
+  std::string m_Diag; // Why verification failed, if it did.
+};
+
+// Gets a serialized root signature from a cache of the process, keyed by a
+// hash of its bytes, so that identical blobs are deserialized and verified
+// once. The cache holds a bounded number of entries, allocated with the
+// default allocator rather than the thread's. Throws if it can't be
+// deserialized.
+std::shared_ptr<const CachedRootSignature>
+GetCachedRootSignature(_In_reads_bytes_(length) const void *pData,
+                       _In_ uint32_t length);
+
+// Drops the root signatures in the cache of the process; those still in
+// use stay alive.
+void ClearRootSignatureCache();
+
+// A shader that a root signature is laid out for.
+struct DxilRootSignatureShader {
+  DXIL::ShaderKind ShaderKind;
+  const void *pPSVData;
+  uint32_t PSVSize;
+};
+
+// Index of a root parameter that no shader reads, in DxilRootParameterRemap.
+static const uint32_t DxilRootParameterRemoved = 0xffffffff;
+
+// Where a root parameter of the original root signature went.
+struct DxilRootParameterRemap {
+  uint32_t NewIndex;
+  DxilRootParameterType NewType;
+};
+
+// Proposes a layout of a root signature for a set of shaders that it binds.
+// pUpdateFrequencies, if given, holds how often each parameter is set, in
+// any unit; 0 means that it is set once.
+// - Parameters that no shader reads are removed.
+// - Static root constants of more than 2 values become root CBVs.
+// - Updated tables of a single buffer descriptor become root descriptors,
+//   most frequent first, while the signature fits 64 DWORDs.
+// - Parameters are ordered by frequency, then by size.
+// The result has the version of the original; pRemap gets an entry per
+// original parameter.
+bool OptimizeRootSignature(_In_ const DxilVersionedRootSignatureDesc *pDesc,
+                           _In_opt_ const uint32_t *pUpdateFrequencies,
+                           _In_reads_(ShaderCount) const DxilRootSignatureShader *pShaders,
+                           _In_ uint32_t ShaderCount,
+                           _Outptr_ IDxcBlob **ppBlob,
+                           _Out_ DxilRootParameterRemap *pRemap,
+                           _In_ llvm::raw_ostream &DiagStream);
+
 } // namespace hlsl
 
 #endif // __DXC_ROOTSIGNATURE__
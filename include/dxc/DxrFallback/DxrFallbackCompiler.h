@@ -58,6 +58,11 @@ public:
   // 3 - dump intermediate stages of SFT to file
   void setDebugOutputLevel(int val);
 
+  // The MaxTraceRecursionDepth of the pipeline, or 0 if unknown. When it is 
+  // known and no stack size was given, link() sizes the stack for the 
+  // deepest chain of shader frames the pipeline can build. 
+  void setMaxTraceRecursionDepth(unsigned depth);
+
   // Returns the entry state id for each of shaderNames. The transformations 
   // are performed in place on the module.
   void compile(std::vector<int>& shaderEntryStateIds, std::vector<unsigned int> &shaderStackSizes, IntToFuncNameMap *pCachedMap);
@@ -65,6 +70,8 @@ public:
   // TODO: Ideally we would run this after inlining everything at the end of compile.
   // Until we figure out to do this, we will call the function after the final link.
   static void resizeStack(llvm::Function* F, unsigned stackSizeInBytes);
+  // Returns the stack size used by link().
+  unsigned getStackSizeInBytes() const { return m_stackSizeInBytes; }
 private:
   typedef std::map<int, llvm::Function*> IntToFuncMap;
   typedef std::map<std::string, llvm::Function*> StringToFuncMap;
@@ -73,6 +80,7 @@ private:
   const std::vector<std::string>& m_entryShaderNames;
   unsigned m_stackSizeInBytes = 0;
   unsigned m_maxAttributeSize = 0;
+  unsigned m_maxTraceRecursionDepth = 0;
   bool m_findCalledShaders = false;
   int m_debugOutputLevel = 0;
 
@@ -84,6 +92,7 @@ private:
   void lowerReportHit();
   void lowerTraceRay(llvm::Type* runtimeDataArgTy);
   void createStateFunctions(IntToFuncMap& stateFunctionMap, std::vector<int>& shaderEntryStateIds, std::vector<unsigned int>& shaderStackSizes, int baseStateId, const std::vector<std::string>& shaderNames, llvm::Type* runtimeDataArgTy);
+  unsigned getPipelineStackSize(const std::vector<unsigned int>& shaderStackSizes);
   void createLaunchParams(llvm::Function* func);
   void createStack(llvm::Function* func);
   void createStateDispatch(llvm::Function* func, const IntToFuncMap& stateFunctionMap, llvm::Type* runtimeDataArgTy);
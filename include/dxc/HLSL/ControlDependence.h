@@ -10,14 +10,20 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Dominators.h"
+#include "llvm/Pass.h"
 
+#include <memory>
 #include <unordered_set>
 #include <unordered_map>
 
 namespace llvm {
   class Function;
+  class Module;
+  class PassRegistry;
   class raw_ostream;
 }
 
@@ -31,21 +37,52 @@ class ControlDependence {
 public:
   void Compute(llvm::Function *F, PostDomRelationType &PostDomRel);
   void Clear();
-  const BasicBlockSet &GetCDBlocks(llvm::BasicBlock *pBB) const;
-  void print(llvm::raw_ostream &OS);
-  void dump();
+  llvm::ArrayRef<llvm::BasicBlock *> GetCDBlocks(llvm::BasicBlock *pBB) const;
+  void print(llvm::raw_ostream &OS) const;
+  void dump() const;
 
 private:
   using BasicBlockVector = std::vector<llvm::BasicBlock *>;
-  using ControlDependenceType = std::unordered_map<llvm::BasicBlock *, BasicBlockSet>;
 
-  llvm::Function *m_pFunc;
-  ControlDependenceType m_ControlDependence;
-  BasicBlockSet m_EmptyBBSet;
+  llvm::Function *m_pFunc = nullptr;
+  // The blocks each block is control dependent on are stored contiguously,
+  // in the order they were found; a block maps to its begin and end.
+  llvm::DenseMap<const llvm::BasicBlock *, std::pair<unsigned, unsigned>>
+      m_CDRanges;
+  BasicBlockVector m_CDBlocks;
 
   llvm::BasicBlock *GetIPostDom(PostDomRelationType &PostDomRel, llvm::BasicBlock *pBB);
   void ComputeRevTopOrderRec(PostDomRelationType &PostDomRel, llvm::BasicBlock *pBB,
                              BasicBlockVector &RevTopOrder, BasicBlockSet &VisitedBBs);
 };
 
+// Computes the control dependence of functions on demand, once each, for
+// the passes that require it. Results stay valid until a pass that doesn't
+// preserve this analysis runs.
+class ControlDependenceAnalysis : public llvm::ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  ControlDependenceAnalysis();
+
+  const char *getPassName() const override {
+    return "Control dependence analysis";
+  }
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+  bool runOnModule(llvm::Module &M) override { return false; }
+  void releaseMemory() override { m_Functions.clear(); }
+  void print(llvm::raw_ostream &OS, const llvm::Module *M) const override;
+
+  const ControlDependence &GetControlDependence(llvm::Function *F);
+
+private:
+  llvm::DenseMap<const llvm::Function *, std::unique_ptr<ControlDependence>>
+      m_Functions;
+};
+
 } // end of hlsl namespace
+
+namespace llvm {
+void initializeControlDependenceAnalysisPass(llvm::PassRegistry &);
+}
@@ -17,8 +17,10 @@ class ModulePass;
 class Function;
 class FunctionPass;
 class Instruction;
+class Value;
 class PassRegistry;
 class StringRef;
+class TargetTransformInfo;
 struct PostDominatorTree;
 }
 
@@ -32,6 +34,20 @@ public:
   virtual bool IsWaveSensitive(llvm::Instruction *op) = 0;
 };
 
+// Finds values that are provably equal on all active lanes of a wave, such as
+// constant buffer loads and resource indices computed only from them.
+class WaveUniformityAnalysis {
+public:
+  static WaveUniformityAnalysis* create(llvm::PostDominatorTree &PDT);
+  virtual ~WaveUniformityAnalysis() { }
+  virtual void Analyze(llvm::Function *F) = 0;
+  virtual bool IsUniform(llvm::Value *V) = 0;
+};
+
+// Costs the code of a function in a DXIL module, with DXIL operations as
+// the single instructions they are rather than as calls.
+llvm::TargetTransformInfo CreateDxilTargetTransformInfo(llvm::Function &F);
+
 class HLSLExtensionsCodegenHelper;
 
 // Pause/resume support.
@@ -48,15 +64,26 @@ ModulePass *createDxilCondenseResourcesPass();
 ModulePass *createDxilLowerCreateHandleForLibPass();
 ModulePass *createDxilAllocateResourcesForLibPass();
 ModulePass *createDxilEliminateOutputDynamicIndexingPass();
+FunctionPass *createDxilEliminateDeadOutputStoresPass();
+FunctionPass *createDxilEliminateLocalDynamicIndexingPass();
+ModulePass *createDxilEliminateRedundantBarriersPass(bool Report = false);
+ModulePass *createDxilPositionOnlyPass();
+ModulePass *createDxilPassThroughHullShaderPass();
 ModulePass *createDxilGenerationPass(bool NotOptimized, hlsl::HLSLExtensionsCodegenHelper *extensionsHelper);
 ModulePass *createHLEmitMetadataPass();
 ModulePass *createHLEnsureMetadataPass();
 ModulePass *createDxilFinalizeModulePass();
 ModulePass *createDxilEmitMetadataPass();
-FunctionPass *createDxilExpandTrigIntrinsicsPass();
+FunctionPass *createDxilExpandTrigIntrinsicsPass(bool Fast = false);
+FunctionPass *createDxilDemoteOutputPrecisionPass(bool Report = false);
+ModulePass *createDxilGroupSharedBankConflictsPass(bool Report = false, bool Pad = false);
+ModulePass *createDxilInferEarlyDepthStencilPass(bool Apply = false, bool Report = false);
+ModulePass *createDxilRootConstantCandidatesPass(unsigned MaxDWords = 8);
+ModulePass *createDxilMergeIdenticalFunctionsPass(bool Report = false);
 ModulePass *createDxilConvergentMarkPass();
 ModulePass *createDxilConvergentClearPass();
 ModulePass *createDxilDeadFunctionEliminationPass();
+ModulePass *createHLBindConstantsPass();
 ModulePass *createHLDeadFunctionEliminationPass();
 ModulePass *createHLPreprocessPass();
 ModulePass *createDxilPrecisePropagatePass();
@@ -67,6 +94,17 @@ ModulePass *createDxilLegalizeResources();
 ModulePass *createDxilLegalizeEvalOperationsPass();
 FunctionPass *createDxilLegalizeSampleOffsetPass();
 FunctionPass *createDxilSimpleGVNHoistPass();
+FunctionPass *createDxilSimpleGVNEliminatePass();
+FunctionPass *createDxilCoalesceRawBufferAccessPass();
+FunctionPass *createDxilHoistResourceOpsPass();
+FunctionPass *createDxilSelectControlFlowHintsPass(bool Report = false, bool ProfiledOnly = false);
+FunctionPass *createDxilUniformResourceIndexPass(bool InferNonUniform = false);
+FunctionPass *createDxilWaveAggregateAtomicsPass(bool Report = false);
+FunctionPass *createDxilPair16BitOpsPass();
+FunctionPass *createDxilClusterFetchesPass(unsigned MaxLiveComponents = 16);
+FunctionPass *createDxilReuseDerivativesPass();
+FunctionPass *createDxilStrengthReduceBufferIndicesPass();
+FunctionPass *createDxilGatherTexelLoadsPass();
 ModulePass *createFailUndefResourcePass();
 FunctionPass *createSimplifyInstPass();
 ModulePass *createDxilTranslateRawBuffer();
@@ -79,13 +117,24 @@ void initializeDxilCondenseResourcesPass(llvm::PassRegistry&);
 void initializeDxilLowerCreateHandleForLibPass(llvm::PassRegistry&);
 void initializeDxilAllocateResourcesForLibPass(llvm::PassRegistry&);
 void initializeDxilEliminateOutputDynamicIndexingPass(llvm::PassRegistry&);
+void initializeDxilEliminateDeadOutputStoresPass(llvm::PassRegistry&);
+void initializeDxilEliminateLocalDynamicIndexingPass(llvm::PassRegistry&);
+void initializeDxilEliminateRedundantBarriersPass(llvm::PassRegistry&);
+void initializeDxilPositionOnlyPass(llvm::PassRegistry&);
+void initializeDxilPassThroughHullShaderPass(llvm::PassRegistry&);
 void initializeDxilGenerationPassPass(llvm::PassRegistry&);
+void initializeDxilGroupSharedBankConflictsPass(llvm::PassRegistry&);
+void initializeDxilInferEarlyDepthStencilPass(llvm::PassRegistry&);
+void initializeDxilRootConstantCandidatesPass(llvm::PassRegistry&);
+void initializeDxilMergeIdenticalFunctionsPass(llvm::PassRegistry&);
 void initializeHLEnsureMetadataPass(llvm::PassRegistry&);
 void initializeHLEmitMetadataPass(llvm::PassRegistry&);
 void initializeDxilFinalizeModulePass(llvm::PassRegistry&);
 void initializeDxilEmitMetadataPass(llvm::PassRegistry&);
 void initializeDxilExpandTrigIntrinsicsPass(llvm::PassRegistry&);
+void initializeDxilDemoteOutputPrecisionPass(llvm::PassRegistry&);
 void initializeDxilDeadFunctionEliminationPass(llvm::PassRegistry&);
+void initializeHLBindConstantsPass(llvm::PassRegistry&);
 void initializeHLDeadFunctionEliminationPass(llvm::PassRegistry&);
 void initializeHLPreprocessPass(llvm::PassRegistry&);
 void initializeDxilConvergentMarkPass(llvm::PassRegistry&);
@@ -98,6 +147,17 @@ void initializeDxilLegalizeResourcesPass(llvm::PassRegistry&);
 void initializeDxilLegalizeEvalOperationsPass(llvm::PassRegistry&);
 void initializeDxilLegalizeSampleOffsetPassPass(llvm::PassRegistry&);
 void initializeDxilSimpleGVNHoistPass(llvm::PassRegistry&);
+void initializeDxilSimpleGVNEliminatePass(llvm::PassRegistry&);
+void initializeDxilCoalesceRawBufferAccessPass(llvm::PassRegistry&);
+void initializeDxilHoistResourceOpsPass(llvm::PassRegistry&);
+void initializeDxilSelectControlFlowHintsPass(llvm::PassRegistry&);
+void initializeDxilUniformResourceIndexPass(llvm::PassRegistry&);
+void initializeDxilWaveAggregateAtomicsPass(llvm::PassRegistry&);
+void initializeDxilPair16BitOpsPass(llvm::PassRegistry&);
+void initializeDxilClusterFetchesPass(llvm::PassRegistry&);
+void initializeDxilReuseDerivativesPass(llvm::PassRegistry&);
+void initializeDxilStrengthReduceBufferIndicesPass(llvm::PassRegistry&);
+void initializeDxilGatherTexelLoadsPass(llvm::PassRegistry&);
 void initializeFailUndefResourcePass(llvm::PassRegistry&);
 void initializeSimplifyInstPass(llvm::PassRegistry&);
 void initializeDxilTranslateRawBufferPass(llvm::PassRegistry&);
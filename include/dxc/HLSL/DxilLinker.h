@@ -48,10 +48,30 @@ public:
   virtual std::unique_ptr<llvm::Module>
   Link(llvm::StringRef entry, llvm::StringRef profile, dxilutil::ExportMap &exportMap) = 0;
 
+  // Links entry like Link, along with the adjacent pipeline stage
+  // pairedEntry, which is linked with the same shader model but not
+  // returned. The signatures between the two stages are then pruned and
+  // packed with LinkPipelineSignatures. If packSearchLimit is set, the rows
+  // that the search saves are reported as a warning.
+  virtual std::unique_ptr<llvm::Module>
+  LinkPipelineStage(llvm::StringRef entry, llvm::StringRef profile,
+                    llvm::StringRef pairedEntry, unsigned packSearchLimit,
+                    dxilutil::ExportMap &exportMap) = 0;
+
 protected:
   DxilLinker(llvm::LLVMContext &Ctx, unsigned valMajor, unsigned valMinor) : m_ctx(Ctx), m_valMajor(valMajor), m_valMinor(valMinor) {}
   llvm::LLVMContext &m_ctx;
   unsigned m_valMajor, m_valMinor;
 };
 
+// Removes the outputs of a vertex or domain shader that the pixel shader
+// after it doesn't read, along with the pixel shader inputs it doesn't read,
+// and packs both signatures so that they still line up. Up to
+// packSearchLimit other orders of the inputs are tried for a packing that
+// uses fewer rows; pRowsSaved, if set, receives how many fewer. Returns false
+// without changing either module if the stages can't be paired.
+bool LinkPipelineSignatures(DxilModule &Producer, DxilModule &Consumer,
+                            unsigned packSearchLimit = 0,
+                            unsigned *pRowsSaved = nullptr);
+
 } // namespace hlsl
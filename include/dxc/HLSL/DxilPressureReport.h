@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPressureReport.h                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Estimates register pressure and on-chip memory use of each entry point.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace llvm {
+  class Module;
+  class raw_ostream;
+}
+
+namespace hlsl {
+
+// A GPU to estimate the occupancy of compute shaders on. Each unit runs whole
+// thread groups on SimdsPerUnit SIMDs, which each hold up to MaxWavesPerSimd
+// waves and RegistersPerLane 32-bit registers for each of their lanes.
+struct DxilGpuModel {
+  std::string Name;
+  unsigned WaveSize;
+  unsigned RegistersPerLane;
+  unsigned MaxWavesPerSimd;
+  unsigned SimdsPerUnit;
+  unsigned GroupSharedBytes; // Per unit.
+  unsigned MaxGroupsPerUnit;
+};
+
+// Parses a model written as
+//   <name>:<wave size>,<registers per lane>,<waves per SIMD>,
+//          <SIMDs per unit>,<groupshared bytes>,<groups per unit>
+// with every number above zero. Returns false if Spec isn't one.
+bool ParseDxilGpuModel(llvm::StringRef Spec, DxilGpuModel &Model);
+
+// Models used when none are given: a wave32 and a wave64 GPU with round,
+// typical figures rather than those of a particular product.
+void GetDefaultDxilGpuModels(std::vector<DxilGpuModel> &Models);
+
+// Writes a UTF-8 JSON report with, for each entry point of a DXIL module:
+// - maxLiveValues: the most SSA values live at any one instruction.
+// - maxLiveComponents: the same, in 32-bit components; 64-bit scalars
+//   count twice and vectors and structs count each element.
+// - maxLiveLine: the source line where that happens, when known.
+// - groupsharedBytes: the size of the groupshared variables it uses.
+// - indexableBytes and dynamicArrays: the local and static arrays it
+//   indexes dynamically, which drivers usually place in scratch memory.
+// Functions called from an entry point are included in its figures.
+//
+// Compute shaders also get numThreads, usesBarriers and usesWaveOps, and
+// under occupancy, for each model, the occupancy of their own group size and
+// of 32 to 1024 threads. Each candidate lists what limits the groups that fit
+// on a unit (registers, groupshared, waves or groups), and is flagged when
+// its size isn't a multiple of the wave size, which leaves lanes idle and
+// changes what wave operations see. The recommended size is the candidate
+// with the highest occupancy, preferring multiples of the wave size and,
+// with barriers, fewer waves to wait on. Models default to
+// GetDefaultDxilGpuModels.
+void WriteDxilPressureReport(llvm::Module &M, llvm::raw_ostream &OS,
+                             const std::vector<DxilGpuModel> *pModels = nullptr);
+
+}
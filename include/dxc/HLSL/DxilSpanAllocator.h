@@ -12,8 +12,10 @@
 #pragma once
 
 #include "dxc/Support/Global.h"
+#include <algorithm>
 #include <set>
 #include <map>
+#include <vector>
 
 namespace hlsl {
 
@@ -36,6 +38,7 @@ public:
     : m_Min(Min), m_Max(Max), m_FirstFree(Min),
       m_Unbounded(nullptr), m_AllocationFull(false) {
     DXASSERT_NOMSG(Min <= Max);
+    m_Gaps.Reset(Min, Max);
   }
   T_index GetMin() { return m_Min; }
   T_index GetMax() { return m_Max; }
@@ -50,15 +53,13 @@ public:
     DXASSERT_NOMSG(size);
     if (size - 1 > m_Max - m_Min)
       return false;
+    if (m_AllocationFull)
+      return false;
     if (pos < m_FirstFree)
       pos = m_FirstFree;
     if (!UpdatePos(pos, size, align))
       return false;
-    T_index end = pos + (size - 1);
-    auto next = m_Spans.lower_bound(Span(nullptr, pos, end));
-    if (next == m_Spans.end() || end < next->start)
-      return true;  // it fits here
-    return Find(size, next, pos, align);
+    return m_Gaps.FindFirstFit(size - 1, align, pos);
   }
 
   // Finds the farthest position at which an element could be allocated.
@@ -80,18 +81,9 @@ public:
     if (m_AllocationFull)
       return false;
     pos = m_FirstFree;
-    if (!UpdatePos(pos, size, align))
+    if (!Find(size, pos, align))
       return false;
-    auto result = m_Spans.emplace(element, pos, pos + (size - 1));
-    if (result.second) {
-      AdvanceFirstFree(result.first);
-      return true;
-    }
-    // Collision, find a gap from iterator
-    if (!Find(size, result.first, pos, align))
-      return false;
-    result = m_Spans.emplace(element, pos, pos + (size - 1));
-    return result.second;
+    return Insert(element, pos, pos + (size - 1)) == nullptr;
   }
 
   bool AllocateUnbounded(const T_element *element, T_index &pos, T_index align = 1) {
@@ -122,7 +114,7 @@ public:
     auto result = m_Spans.emplace(element, start, end);
     if (!result.second)
       return result.first->element;
-    AdvanceFirstFree(result.first);
+    Reserve(start, end);
     return nullptr;
   }
 
@@ -139,36 +131,218 @@ public:
       end = std::max(result.first->end, end);
       m_Spans.erase(result.first);
     }
+    Reserve(start, end);
   }
 
 private:
-  // Find size gap starting at iterator, updating pos, and returning true if successful
-  bool Find(T_index size, typename SpanSet::const_iterator it, T_index &pos, T_index align = 1) {
-    pos = it->end;
-    if (!IncPos(pos, /*inc*/1, size, align))
-      return false;
-    for (++it; it != m_Spans.end() && (it->start < pos || it->start - pos < size); ++it) {
-      pos = it->end;
-      if (!IncPos(pos, /*inc*/1, size, align))
-        return false;
+  // Free gaps, by start. This is an AVL tree in which each node also holds
+  // the largest gap of its subtree, so that the first gap that fits is
+  // found in O(log n) rather than by walking the spans.
+  class GapTree {
+  public:
+    void Reset(T_index start, T_index end) {
+      m_Nodes.clear();
+      m_FreeNodes.clear();
+      m_Root = kNull;
+      Add(start, end);
+    }
+
+    bool IsEmpty() const { return m_Root == kNull; }
+
+    T_index GetFirstStart() const {
+      DXASSERT_NOMSG(!IsEmpty());
+      unsigned n = m_Root;
+      while (m_Nodes[n].left != kNull)
+        n = m_Nodes[n].left;
+      return m_Nodes[n].start;
+    }
+
+    // Removes [start, end] from the gaps.
+    void Reserve(T_index start, T_index end) {
+      for (;;) {
+        // Only the last gap that starts at or before end can overlap.
+        unsigned n = kNull;
+        for (unsigned i = m_Root; i != kNull;) {
+          if (m_Nodes[i].start <= end) {
+            n = i;
+            i = m_Nodes[i].right;
+          } else {
+            i = m_Nodes[i].left;
+          }
+        }
+        if (n == kNull || m_Nodes[n].end < start)
+          return;
+        T_index gapStart = m_Nodes[n].start, gapEnd = m_Nodes[n].end;
+        m_Root = Erase(m_Root, gapStart);
+        if (gapStart < start)
+          Add(gapStart, start - 1);
+        if (end < gapEnd)
+          Add(end + 1, gapEnd);
+      }
+    }
+
+    // Finds the first aligned position at or after pos that is followed by
+    // sizeLess1 more free indices, updating pos.
+    bool FindFirstFit(T_index sizeLess1, T_index align, T_index &pos) const {
+      return Find(m_Root, sizeLess1, align, pos);
+    }
+
+  private:
+    static const unsigned kNull = ~0U;
+    struct Node {
+      T_index start, end; // inclusive
+      T_index maxLenLess1;
+      unsigned left, right;
+      int height;
+    };
+
+    void Add(T_index start, T_index end) {
+      unsigned n;
+      if (!m_FreeNodes.empty()) {
+        n = m_FreeNodes.back();
+        m_FreeNodes.pop_back();
+      } else {
+        n = (unsigned)m_Nodes.size();
+        m_Nodes.emplace_back();
+      }
+      Node &N = m_Nodes[n];
+      N.start = start;
+      N.end = end;
+      N.left = N.right = kNull;
+      Update(n);
+      m_Root = Insert(m_Root, n);
     }
-    return true;
-  }
 
-  // Advance m_FirstFree if it's in span
-  void AdvanceFirstFree(typename SpanSet::const_iterator it) {
-    if (it->start <= m_FirstFree && m_FirstFree <= it->end) {
-      for (; it != m_Spans.end(); ) {
-        if (it->end >= m_Max) {
-          m_AllocationFull = true;
-          break;
+    bool Find(unsigned n, T_index sizeLess1, T_index align,
+              T_index &pos) const {
+      if (n == kNull || m_Nodes[n].maxLenLess1 < sizeLess1)
+        return false;
+      const Node &N = m_Nodes[n];
+      // Gaps on the left end before this one starts.
+      if (pos < N.start && Find(N.left, sizeLess1, align, pos))
+        return true;
+      if (pos <= N.end) {
+        T_index fit = std::max(pos, N.start);
+        T_index rem = (1 < align) ? fit % align : 0;
+        if (rem && fit + (align - rem) < fit)
+          return false; // overflow on alignment
+        fit = rem ? fit + (align - rem) : fit;
+        if (fit <= N.end && sizeLess1 <= N.end - fit) {
+          pos = fit;
+          return true;
         }
-        m_FirstFree = it->end + 1;
-        ++it;
-        if (it != m_Spans.end() && m_FirstFree < it->start)
-          break;
       }
+      return Find(N.right, sizeLess1, align, pos);
     }
+
+    int Height(unsigned n) const {
+      return n == kNull ? 0 : m_Nodes[n].height;
+    }
+
+    void Update(unsigned n) {
+      Node &N = m_Nodes[n];
+      N.height = 1 + std::max(Height(N.left), Height(N.right));
+      N.maxLenLess1 = N.end - N.start;
+      if (N.left != kNull)
+        N.maxLenLess1 = std::max(N.maxLenLess1, m_Nodes[N.left].maxLenLess1);
+      if (N.right != kNull)
+        N.maxLenLess1 = std::max(N.maxLenLess1, m_Nodes[N.right].maxLenLess1);
+    }
+
+    unsigned RotateRight(unsigned n) {
+      unsigned l = m_Nodes[n].left;
+      m_Nodes[n].left = m_Nodes[l].right;
+      m_Nodes[l].right = n;
+      Update(n);
+      Update(l);
+      return l;
+    }
+
+    unsigned RotateLeft(unsigned n) {
+      unsigned r = m_Nodes[n].right;
+      m_Nodes[n].right = m_Nodes[r].left;
+      m_Nodes[r].left = n;
+      Update(n);
+      Update(r);
+      return r;
+    }
+
+    unsigned Balance(unsigned n) {
+      Update(n);
+      unsigned l = m_Nodes[n].left, r = m_Nodes[n].right;
+      int balance = Height(l) - Height(r);
+      if (balance > 1) {
+        if (Height(m_Nodes[l].left) < Height(m_Nodes[l].right))
+          m_Nodes[n].left = RotateLeft(l);
+        return RotateRight(n);
+      }
+      if (balance < -1) {
+        if (Height(m_Nodes[r].right) < Height(m_Nodes[r].left))
+          m_Nodes[n].right = RotateRight(r);
+        return RotateLeft(n);
+      }
+      return n;
+    }
+
+    unsigned Insert(unsigned n, unsigned newNode) {
+      if (n == kNull)
+        return newNode;
+      if (m_Nodes[newNode].start < m_Nodes[n].start) {
+        unsigned l = Insert(m_Nodes[n].left, newNode);
+        m_Nodes[n].left = l;
+      } else {
+        unsigned r = Insert(m_Nodes[n].right, newNode);
+        m_Nodes[n].right = r;
+      }
+      return Balance(n);
+    }
+
+    unsigned RemoveFirst(unsigned n) {
+      if (m_Nodes[n].left == kNull)
+        return m_Nodes[n].right;
+      unsigned l = RemoveFirst(m_Nodes[n].left);
+      m_Nodes[n].left = l;
+      return Balance(n);
+    }
+
+    unsigned Erase(unsigned n, T_index start) {
+      DXASSERT_NOMSG(n != kNull);
+      if (start < m_Nodes[n].start) {
+        unsigned l = Erase(m_Nodes[n].left, start);
+        m_Nodes[n].left = l;
+        return Balance(n);
+      }
+      if (m_Nodes[n].start < start) {
+        unsigned r = Erase(m_Nodes[n].right, start);
+        m_Nodes[n].right = r;
+        return Balance(n);
+      }
+      m_FreeNodes.push_back(n);
+      unsigned l = m_Nodes[n].left, r = m_Nodes[n].right;
+      if (l == kNull)
+        return r;
+      if (r == kNull)
+        return l;
+      unsigned next = r;
+      while (m_Nodes[next].left != kNull)
+        next = m_Nodes[next].left;
+      m_Nodes[next].right = RemoveFirst(r);
+      m_Nodes[next].left = l;
+      return Balance(next);
+    }
+
+    std::vector<Node> m_Nodes;
+    std::vector<unsigned> m_FreeNodes;
+    unsigned m_Root = kNull;
+  };
+
+  // Takes [start, end] out of the free gaps.
+  void Reserve(T_index start, T_index end) {
+    m_Gaps.Reserve(start, end);
+    if (m_Gaps.IsEmpty())
+      m_AllocationFull = true;
+    else
+      m_FirstFree = m_Gaps.GetFirstStart();
   }
 
   T_index Align(T_index pos, T_index align) {
@@ -195,6 +369,7 @@ private:
 
 private:
   SpanSet m_Spans;
+  GapTree m_Gaps;
   T_index m_Min, m_Max, m_FirstFree;
   const T_element *m_Unbounded;
   bool m_AllocationFull;
@@ -260,8 +260,32 @@ enum class ValidationRule : unsigned {
 
 const char *GetValidationRuleText(ValidationRule value);
 void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor);
+
+// Groups of checks that can be selected with ValidationOptions::RuleGroups.
+namespace ValidationRuleGroup {
+enum : unsigned {
+  Metadata = 1 << 0,     // Module metadata, signatures and shader state (Meta, Sm)
+  Declarations = 1 << 1, // Global variables, resources and types (Decl)
+  FlowControl = 1 << 2,  // Control flow and call graph (Flow)
+  Instructions = 1 << 3, // Function bodies (Instr, Types, Uni)
+  Container = 1 << 4,    // Container parts (Container)
+  All = (1 << 5) - 1,
+};
+}
+
+struct ValidationOptions {
+  // Skip the remaining checks once one of them has reported an error.
+  bool StopAtFirstError = false;
+  // ValidationRuleGroup flags of the checks to run.
+  unsigned RuleGroups = ValidationRuleGroup::All;
+  // Report the time taken by each step to the thread's PhaseTimingListener,
+  // as "validation.<step>" phases.
+  bool ReportTimings = false;
+};
+
 HRESULT ValidateDxilModule(_In_ llvm::Module *pModule,
-                           _In_opt_ llvm::Module *pDebugModule);
+                           _In_opt_ llvm::Module *pDebugModule,
+                           const ValidationOptions &Options = ValidationOptions());
 
 // DXIL Container Verification Functions (return false on failure)
 
@@ -289,7 +313,8 @@ struct DxilContainerHeader;
 HRESULT ValidateDxilContainerParts(_In_ llvm::Module *pModule,
                                    _In_opt_ llvm::Module *pDebugModule,
                                    _In_reads_bytes_(ContainerSize) const DxilContainerHeader *pContainer,
-                                   _In_ uint32_t ContainerSize);
+                                   _In_ uint32_t ContainerSize,
+                                   const ValidationOptions &Options = ValidationOptions());
 
 // Loads module, validating load, but not module.
 HRESULT ValidateLoadModule(_In_reads_bytes_(ILLength) const char *pIL,
@@ -317,12 +342,14 @@ HRESULT ValidateLoadModuleFromContainerLazy(
 // Load and validate Dxil module from bitcode.
 HRESULT ValidateDxilBitcode(_In_reads_bytes_(ILLength) const char *pIL,
                             _In_ uint32_t ILLength,
-                            _In_ llvm::raw_ostream &DiagStream);
+                            _In_ llvm::raw_ostream &DiagStream,
+                            const ValidationOptions &Options = ValidationOptions());
 
 // Full container validation, including ValidateDxilModule
 HRESULT ValidateDxilContainer(_In_reads_bytes_(ContainerSize) const void *pContainer,
                               _In_ uint32_t ContainerSize,
-                              _In_ llvm::raw_ostream &DiagStream);
+                              _In_ llvm::raw_ostream &DiagStream,
+                              const ValidationOptions &Options = ValidationOptions());
 
 class PrintDiagnosticContext {
 private:
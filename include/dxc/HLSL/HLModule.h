@@ -216,6 +216,13 @@ public:
   void MarkDxilResourceAttrib(llvm::Argument *Arg, llvm::MDNode *MD);
   llvm::MDNode *GetDxilResourceAttrib(llvm::Argument *Arg);
   static llvm::MDNode *GetDxilResourceAttrib(llvm::Type *Ty, llvm::Module &M);
+  // Static consts bound late, by source name.
+  static void AddLateBindConst(llvm::Module &M, llvm::StringRef Name,
+                               llvm::GlobalVariable *GV);
+  static void GetLateBindConsts(
+      llvm::Module &M,
+      std::vector<std::pair<llvm::StringRef, llvm::GlobalVariable *>> &Consts);
+  static bool ClearLateBindConsts(llvm::Module &M);
 
   // DXIL type system.
   DxilTypeSystem &GetTypeSystem();
@@ -13,7 +13,9 @@
 
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
 #include "llvm/ADT/StringRef.h"
+#include <map>
 #include <string>
+#include <tuple>
 #include <unordered_map>
 
 namespace llvm {
@@ -65,11 +67,23 @@ namespace hlsl {
     // lowering.
     std::string GetExtensionName(llvm::CallInst *CI);
 
+    // Get the entry for the function that calls with the opcode of CI to the
+    // HL function it calls are lowered to, with their types translated as for
+    // the given strategy. The entry is null until it is set.
+    llvm::Function *&GetLoweredFunctionEntry(Strategy typeStrategy, llvm::CallInst *CI);
+
   private:
     Strategy m_strategy;
     HLSLExtensionsCodegenHelper *m_helper;
     OP &m_hlslOp;
 
+    // The lowered function depends only on the types of the HL function, its
+    // opcode and how the types are translated, so the name lookup in the
+    // codegen helper and the function lookup in the module happen once for
+    // all the calls that share them.
+    typedef std::tuple<Strategy, unsigned, llvm::Function *> LoweredFunctionKey;
+    std::map<LoweredFunctionKey, llvm::Function *> m_loweredFunctions;
+
     llvm::Value *Unknown(llvm::CallInst *CI);
     llvm::Value *NoTranslation(llvm::CallInst *CI);
     llvm::Value *Replicate(llvm::CallInst *CI);
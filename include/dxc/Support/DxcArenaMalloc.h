@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcArenaMalloc.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides an IMalloc that serves allocations from large chunks and         //
+// releases them all at once.                                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __DXCARENAMALLOC_H__
+#define __DXCARENAMALLOC_H__
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+#include <cstdint>
+#include <mutex>
+
+namespace hlsl {
+
+struct DxcArenaMallocStats {
+  uint64_t AllocCount;       // Allocations served from the arena.
+  uint64_t AllocBytes;       // Bytes requested by those allocations.
+  uint64_t FreeCount;        // Frees of arena memory.
+  uint64_t ForeignFreeCount; // Frees forwarded to the inner allocator.
+  uint64_t ChunkCount;       // Chunks taken from the inner allocator.
+  uint64_t ReservedBytes;    // Bytes in those chunks.
+};
+
+// Bump allocator over another IMalloc, meant to be installed as the thread
+// allocator for the duration of a single compile.
+//
+// Freeing arena memory only reclaims it when it was the latest allocation;
+// everything else is returned to the inner allocator in one go when the last
+// reference to the arena is released. Memory the arena didn't allocate, such
+// as blocks allocated before it was installed, is passed through to the inner
+// allocator.
+//
+// Anything allocated through the arena must not be used after the arena is
+// released. Objects that keep a reference to their IMalloc keep the arena
+// alive; memory from operator new doesn't, so on Windows, where the compiler's
+// operator new uses the thread allocator, state that outlives the compile must
+// be allocated with another allocator installed. dxcompiler does this for
+// LLVM's ManagedStatic objects, which are created on the default allocator
+// whatever the thread allocator is, and for its own pools and caches.
+class DxcArenaMalloc : public IMalloc {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+
+  struct Chunk {
+    char *Begin;
+    char *End;
+  };
+
+  // Chunks sorted by address, held in memory from the inner allocator.
+  Chunk *m_pChunks = nullptr;
+  size_t m_chunkCount = 0;
+  size_t m_chunkCapacity = 0;
+
+  // Bump range in the current chunk, and the block allocated last from it.
+  char *m_pCur = nullptr;
+  char *m_pEnd = nullptr;
+  char *m_pLast = nullptr;
+
+  DxcArenaMallocStats m_stats = {};
+  std::mutex m_mutex;
+
+  void *AllocLocked(size_t cb);
+  char *AddChunk(size_t cb);
+  bool OwnsLocked(const void *pv) const;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcArenaMalloc)
+  ~DxcArenaMalloc();
+
+  // Size of the chunks that small allocations are carved from. Larger
+  // allocations get a chunk of their own.
+  static const size_t ChunkSize = 1024 * 1024;
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  void *STDMETHODCALLTYPE Alloc(_In_ SIZE_T cb) override;
+  void *STDMETHODCALLTYPE Realloc(_In_opt_ void *pv, _In_ SIZE_T cb) override;
+  void STDMETHODCALLTYPE Free(_In_opt_ void *pv) override;
+#ifdef _WIN32
+  SIZE_T STDMETHODCALLTYPE GetSize(_In_opt_ _Post_writable_byte_size_(return) void *pv) override;
+  int STDMETHODCALLTYPE DidAlloc(_In_opt_ void *pv) override;
+  void STDMETHODCALLTYPE HeapMinimize(void) override {}
+#endif
+
+  DxcArenaMallocStats GetStats();
+};
+
+} // namespace hlsl
+
+#endif
@@ -0,0 +1,27 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcJson.h                                                                 //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides helpers for the JSON reports written by the compiler and tools.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class raw_ostream;
+}
+
+namespace hlsl {
+
+// Writes Value as a quoted JSON string. Quotes, backslashes and control
+// characters are escaped; other bytes, including UTF-8 sequences, are written
+// as they are.
+void WriteJsonString(llvm::raw_ostream &OS, llvm::StringRef Value);
+
+} // namespace hlsl
@@ -56,6 +56,14 @@ public:
   const llvm::SmallVector<std::string, 2>& GetDefines() const { return m_defines; }
   llvm::SmallVector<CComPtr<IDxcIntrinsicTable>, 2>& GetIntrinsicTables(){ return m_intrinsicTables; }
   const std::string &GetSemanticDefineMetadataName() { return m_semanticDefineMetaDataName; }
+  // True when anything has been registered, so compiles may differ from
+  // those of a compiler without extensions.
+  bool HasRegistrations() const {
+    return !m_semanticDefines.empty() || !m_semanticDefineExclusions.empty() ||
+           !m_defines.empty() || !m_intrinsicTables.empty() ||
+           m_semanticDefineValidator != nullptr ||
+           !m_semanticDefineMetaDataName.empty();
+  }
 
   HRESULT STDMETHODCALLTYPE RegisterSemanticDefine(LPCWSTR name)
   {
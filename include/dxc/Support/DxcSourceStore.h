@@ -0,0 +1,44 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcSourceStore.h                                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a content-addressed store for the sources that debug info would  //
+// otherwise embed, so that debug containers can share them.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include <string>
+
+namespace hlsl {
+
+// With a source store, debug info embeds a reference in place of the content
+// of each source: this prefix followed by the MD5 of the content, in hex. The
+// store is a directory holding each content in a file named by that hash.
+extern const char kSourceStoreReferencePrefix[];
+
+// Gets the hash naming the content in a store.
+std::string GetSourceStoreHash(llvm::StringRef Content);
+
+// Gets the reference to embed in place of the content.
+std::string GetSourceStoreReference(llvm::StringRef Content);
+
+// Returns true if embedded content is a reference, and sets pHash to its hash.
+bool IsSourceStoreReference(llvm::StringRef Content, llvm::StringRef *pHash);
+
+// Adds the content to the store in StoreDir, unless the store already holds
+// it. Returns false if the content could not be written.
+bool AddToSourceStore(llvm::StringRef StoreDir, llvm::StringRef Content);
+
+// Reads the content with the given hash from the store in StoreDir. Returns
+// false if the store doesn't hold it; a file being written by another
+// process, or otherwise not matching its name, doesn't count.
+bool ReadFromSourceStore(llvm::StringRef StoreDir, llvm::StringRef Hash,
+                         std::string &Content);
+
+} // namespace hlsl
@@ -137,6 +137,12 @@ DxcCreateBlobFromFile(_In_opt_ IMalloc *pMalloc, LPCWSTR pFileName,
 HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, _In_opt_ UINT32 *pCodePage,
                               _COM_Outptr_ IDxcBlobEncoding **ppBlobEncoding) throw();
 
+// Maps a file read-only instead of reading it. The blob keeps the mapping
+// open, so pages are only read in when touched; the file must not be
+// truncated while the blob is alive.
+HRESULT DxcCreateBlobFromMappedFile(_In_z_ LPCWSTR pFileName,
+                                    _COM_Outptr_ IDxcBlob **ppResult) throw();
+
 // Given a blob, creates a subrange view.
 HRESULT DxcCreateBlobFromBlob(_In_ IDxcBlob *pBlob, UINT32 offset,
                               UINT32 length,
@@ -213,6 +219,9 @@ public:
   virtual HRESULT Reserve(ULONG targetSize) throw() = 0;
 };
 HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, _COM_Outptr_ AbstractMemoryStream** ppResult) throw();
+// Creates a memory stream with room for sizeHint bytes, for writers that know
+// roughly how much they will write.
+HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, ULONG sizeHint, _COM_Outptr_ AbstractMemoryStream** ppResult) throw();
 HRESULT CreateReadOnlyBlobStream(_In_ IDxcBlob *pSource, _COM_Outptr_ IStream** ppResult) throw();
 
 template <typename T>
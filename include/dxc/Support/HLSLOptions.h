@@ -93,6 +93,8 @@ public:
 
   llvm::StringRef AssemblyCode; // OPT_Fc
   llvm::StringRef DebugFile;    // OPT_Fd
+  llvm::StringRef StreamDebugFile; // OPT_Qstream_debug
+  llvm::StringRef SourceStoreDir; // OPT_Qsource_store
   llvm::StringRef EntryPoint;   // OPT_entrypoint
   llvm::StringRef ExternalFn;   // OPT_external_fn
   llvm::StringRef ExternalLib;  // OPT_external_lib
@@ -101,6 +103,8 @@ public:
   llvm::StringRef InputFile; // OPT_INPUT
   llvm::StringRef OutputHeader; // OPT_Fh
   llvm::StringRef OutputObject; // OPT_Fo
+  llvm::StringRef OutputPressureReport; // OPT_Fre
+  std::vector<std::string> PressureReportModels; // OPT_Fre_model
   llvm::StringRef OutputWarningsFile; // OPT_Fe
   llvm::StringRef Preprocess; // OPT_P
   llvm::StringRef TargetProfile; // OPT_target_profile
@@ -111,13 +115,17 @@ public:
   llvm::StringRef RootSignatureDefine; // OPT_rootsig_define
   llvm::StringRef FloatDenormalMode; // OPT_denorm
   std::vector<std::string> Exports; // OPT_exports
+  std::vector<std::string> LateBindConsts; // OPT_late_bind_const
   llvm::StringRef DefaultLinkage; // OPT_default_linkage
+  llvm::StringRef PipelineStage; // OPT_pipeline_stage
+  llvm::StringRef CacheDir; // OPT_cache_dir
 
   bool AllResourcesBound = false; // OPT_all_resources_bound
   bool AstDump = false; // OPT_ast_dump
   bool ColorCodeAssembly = false; // OPT_Cc
   bool CodeGenHighLevel = false; // OPT_fcgl
   bool DebugInfo = false; // OPT__SLASH_Zi
+  bool DebugInfoLinesOnly = false; // OPT_Zi_lines
   bool DebugNameForBinary = false; // OPT_Zsb
   bool DebugNameForSource = false; // OPT_Zss
   bool DumpBin = false;        // OPT_dumpbin
@@ -129,6 +137,7 @@ public:
   bool DisableValidation = false; // OPT_VD
   unsigned OptLevel = 0;      // OPT_O0/O1/O2/O3
   bool DisableOptimizations = false; // OPT_Od
+  bool FastIteration = false;        // OPT_Ofast_iteration
   bool AvoidFlowControl = false;     // OPT_Gfa
   bool PreferFlowControl = false;    // OPT_Gfp
   bool EnableStrictMode = false;     // OPT_Ges
@@ -140,6 +149,7 @@ public:
   bool OutputWarnings = true; // OPT_no_warnings
   bool ShowHelp = false;  // OPT_help
   bool ShowHelpHidden = false; // OPT__help_hidden
+  bool Server = false; // OPT_server
   bool UseColor = false; // OPT_Cc
   bool UseHexLiterals = false; // OPT_Lx
   bool UseInstructionByteOffsets = false; // OPT_No
@@ -153,6 +163,8 @@ public:
   bool StripRootSignature = false; // OPT_Qstrip_rootsignature
   bool StripPrivate = false; // OPT_Qstrip_priv
   bool StripReflection = false; // OPT_Qstrip_reflect
+  bool CompressParts = false; // OPT_Qcompress_parts
+  bool CompactParts = false; // OPT_Qcompact_parts
   bool ExtractRootSignature = false; // OPT_extractrootsignature
   bool DisassembleColorCoded = false; // OPT_Cc
   bool DisassembleInstNumbers = false; //OPT_Ni
@@ -163,6 +175,41 @@ public:
   unsigned long AutoBindingSpace = UINT_MAX; // OPT_auto_binding_space
   bool ExportShadersOnly = false; // OPT_export_shaders_only
   bool ResMayAlias = false; // OPT_res_may_alias
+  bool InferNonUniformIndex = false; // OPT_infer_nonuniform_index
+  bool FastTrig = false; // OPT_ffast_trig
+  bool DemoteOutputPrecision = false; // OPT_demote_output_precision
+  bool AutoControlFlowHints = false; // OPT_auto_control_flow_hints
+  bool GroupSharedBankConflicts = false; // OPT_groupshared_bank_conflicts
+  bool PadGroupShared = false; // OPT_pad_groupshared
+  bool InferEarlyDepthStencil = false; // OPT_infer_early_depth_stencil
+  bool WarnEarlyDepthStencil = false; // OPT_warn_early_depth_stencil
+  bool ReorderCBuffers = false; // OPT_reorder_cbuffers
+  bool RecommendRootConstants = false; // OPT_recommend_root_constants
+  bool MergeIdenticalFunctions = false; // OPT_merge_identical_functions
+  bool PositionOnly = false; // OPT_position_only
+  bool EliminateRedundantBarriers = false; // OPT_eliminate_redundant_barriers
+  bool WaveAggregateAtomics = false; // OPT_wave_aggregate_atomics
+  bool Pair16BitOps = false; // OPT_pair_16bit_ops
+  bool ClusterFetches = false; // OPT_cluster_fetches
+  bool StrengthReduceBufferIndices = false; // OPT_strength_reduce_buffer_indices
+  bool UnswitchUniformLoops = false; // OPT_unswitch_uniform_loops
+  bool GatherTexelLoads = false; // OPT_gather_texel_loads
+  std::vector<std::string> PassOptions; // OPT_pass_option
+  llvm::StringRef ProfileUse; // OPT_fprofile_use
+  bool StripUnusedBeforeCodegen = false; // OPT_strip_unused_before_codegen
+  bool TimeReport = false; // OPT_ftime_report
+  llvm::StringRef TimeTraceFile; // OPT_ftime_trace
+  bool ArenaMalloc = false; // OPT_arena_malloc
+  bool ReuseContext = false; // OPT_reuse_context
+  unsigned long MaxMemoryMB = 0; // OPT_max_memory, zero when unlimited
+  unsigned long PipelinePackSearch = 0; // OPT_pipeline_pack_search
+  unsigned long LibShards = 1; // OPT_lib_shards
+  unsigned long LibShardIndex = UINT_MAX; // OPT_lib_shard_index, UINT_MAX unless compiling one shard
+  unsigned long LibNoInlineSize = 0; // OPT_lib_noinline_size, zero when every helper is inlined
+  bool ScanDependencies = false; // OPT_M
+  bool WriteDependencies = false; // OPT_MD
+  llvm::StringRef DependencyTarget; // OPT_MT
+  llvm::StringRef DependencyFile; // OPT_MF
 
   bool IsRootSignatureProfile();
   bool IsLibraryProfile();
@@ -170,6 +217,7 @@ public:
   // SPIRV Change Starts
 #ifdef ENABLE_SPIRV_CODEGEN
   bool GenSPIRV;                    // OPT_spirv
+  llvm::StringRef OutputSpirvFile;  // OPT_Fspv
   clang::spirv::SpirvCodeGenOptions SpirvOptions; // All SPIR-V CodeGen-related options
 #endif
   // SPIRV Change Ends
@@ -64,6 +64,8 @@ struct SpirvCodeGenOptions {
   llvm::SmallVector<llvm::StringRef, 4> allowedExtensions;
   llvm::SmallVector<llvm::StringRef, 4> optConfig;
   std::vector<std::string> bindRegister;
+  /// Static const globals to make specialization constants, with their SpecIds.
+  std::vector<std::pair<std::string, uint32_t>> specConstants;
 
   // String representation of all command line options.
   std::string clOptions;
@@ -162,12 +162,17 @@
 #define OPEN_EXISTING 3
 #define TRUNCATE_EXISTING 5
 
+#define FILE_BEGIN 0
+#define FILE_CURRENT 1
+#define FILE_END 2
+
 #define FILE_SHARE_DELETE 0x00000004
 #define FILE_SHARE_READ 0x00000001
 #define FILE_SHARE_WRITE 0x00000002
 
 #define GENERIC_READ 0x80000000
 #define GENERIC_WRITE 0x40000000
+#define FILE_APPEND_DATA 0x00000004
 
 #define _atoi64 atoll
 #define sprintf_s snprintf
@@ -204,6 +209,7 @@
 #define DxcEtw_DXCompilerPreprocess_Stop(hr)
 #define DxcEtw_DxcValidation_Start()
 #define DxcEtw_DxcValidation_Stop(hr)
+#define DxcEtw_DXCompilerPhase(name, isPass, shader, durationMicroseconds)
 
 #define UInt32Add UIntAdd
 #define Int32ToUInt32 IntToUInt
@@ -215,12 +221,15 @@
 
 #define E_ABORT (HRESULT)0x80004004
 #define E_ACCESSDENIED (HRESULT)0x80070005
+#define E_BOUNDS (HRESULT)0x8000000B
 #define E_FAIL (HRESULT)0x80004005
 #define E_HANDLE (HRESULT)0x80070006
 #define E_INVALIDARG (HRESULT)0x80070057
 #define E_NOINTERFACE (HRESULT)0x80004002
 #define E_NOTIMPL (HRESULT)0x80004001
+#define E_NOT_VALID_STATE (HRESULT)0x8007139F
 #define E_OUTOFMEMORY (HRESULT)0x8007000E
+#define E_PENDING (HRESULT)0x8000000A
 #define E_POINTER (HRESULT)0x80004003
 #define E_UNEXPECTED (HRESULT)0x8000FFFF
 
@@ -262,6 +271,7 @@
 #define _Outptr_opt_result_z_
 #define _Out_opt_
 #define _Out_writes_(size)
+#define _Out_writes_opt_(size)
 #define _Out_write_bytes_(size)
 #define _Out_writes_z_(size)
 #define _Out_writes_all_(size)
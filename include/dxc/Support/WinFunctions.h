@@ -56,6 +56,10 @@ BOOL WriteFile(_In_ HANDLE hFile, _In_ LPCVOID lpBuffer,
                _Out_opt_ LPDWORD lpNumberOfBytesWritten,
                _Inout_opt_ void *lpOverlapped);
 
+BOOL SetFilePointerEx(_In_ HANDLE hFile, _In_ LARGE_INTEGER liDistanceToMove,
+                      _Out_opt_ PLARGE_INTEGER lpNewFilePointer,
+                      _In_ DWORD dwMoveMethod);
+
 BOOL CloseHandle(_In_ HANDLE hObject);
 
 // Windows-specific heap functions
@@ -32,7 +32,11 @@ public:
   }
 };
 
-class DxcOperationResult : public IDxcOperationResult {
+class DxcOperationResult : public IDxcOperationResult,
+                           public IDxcCompileTimings,
+                           public IDxcCompileMemoryUsage,
+                           public IDxcCompilePressureReport,
+                           public IDxcCompileSpirvOutput {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
 
@@ -50,9 +54,35 @@ public:
   HRESULT m_status;
   CComPtr<IDxcBlob> m_result;
   CComPtr<IDxcBlobEncoding> m_errors;
+  CComPtr<IDxcBlobEncoding> m_timings;
+  CComPtr<IDxcBlobEncoding> m_pressureReport;
+  CComPtr<IDxcBlob> m_spirv;
+  int64_t m_peakBytes = -1; // Negative when heap usage wasn't tracked.
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcOperationResult>(this, iid, ppvObject);
+    HRESULT hr = DoBasicQueryInterface<IDxcOperationResult>(this, iid, ppvObject);
+    if (hr != E_NOINTERFACE)
+      return hr;
+    // Timings, memory usage, the pressure report and the SPIR-V output are
+    // only exposed when the compile recorded them.
+    if (m_timings != nullptr) {
+      hr = DoBasicQueryInterface<IDxcCompileTimings>(this, iid, ppvObject);
+      if (hr != E_NOINTERFACE)
+        return hr;
+    }
+    if (m_pressureReport != nullptr) {
+      hr = DoBasicQueryInterface<IDxcCompilePressureReport>(this, iid, ppvObject);
+      if (hr != E_NOINTERFACE)
+        return hr;
+    }
+    if (m_spirv != nullptr) {
+      hr = DoBasicQueryInterface<IDxcCompileSpirvOutput>(this, iid, ppvObject);
+      if (hr != E_NOINTERFACE)
+        return hr;
+    }
+    if (m_peakBytes >= 0)
+      return DoBasicQueryInterface<IDxcCompileMemoryUsage>(this, iid, ppvObject);
+    return E_NOINTERFACE;
   }
 
   static HRESULT CreateFromResultErrorStatus(_In_opt_ IDxcBlob *pResultBlob,
@@ -114,6 +144,33 @@ public:
     GetErrorBuffer(_COM_Outptr_result_maybenull_ IDxcBlobEncoding **ppErrors) override {
     return m_errors.CopyTo(ppErrors);
   }
+
+  HRESULT STDMETHODCALLTYPE
+    GetTimings(_COM_Outptr_ IDxcBlobEncoding **ppTimings) override {
+    if (ppTimings == nullptr)
+      return E_INVALIDARG;
+    return m_timings.CopyTo(ppTimings);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+    GetPressureReport(_COM_Outptr_ IDxcBlobEncoding **ppReport) override {
+    if (ppReport == nullptr)
+      return E_INVALIDARG;
+    return m_pressureReport.CopyTo(ppReport);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetSpirv(_COM_Outptr_ IDxcBlob **ppSpirv) override {
+    if (ppSpirv == nullptr)
+      return E_INVALIDARG;
+    return m_spirv.CopyTo(ppSpirv);
+  }
+
+  HRESULT STDMETHODCALLTYPE GetPeakBytes(_Out_ UINT64 *pPeakBytes) override {
+    if (pPeakBytes == nullptr)
+      return E_INVALIDARG;
+    *pPeakBytes = (UINT64)m_peakBytes;
+    return S_OK;
+  }
 };
 
 #endif
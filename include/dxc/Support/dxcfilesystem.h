@@ -13,6 +13,8 @@
 
 #include "dxc/dxcapi.h"
 #include "llvm/Support/MSFileSystem.h"
+#include <string>
+#include <vector>
 
 namespace clang {
 class CompilerInstance;
@@ -40,6 +42,9 @@ public:
   virtual void EnableDisplayIncludeProcess() = 0;
   virtual HRESULT CreateStdStreams(_In_ IMalloc *pMalloc) = 0;
   virtual HRESULT RegisterOutputStream(LPCWSTR pName, IStream *pStream) = 0;
+  // Names of the main source and of every file the include handler resolved,
+  // in the order they were first opened.
+  virtual void GetOpenedFileNames(std::vector<std::wstring> &names) = 0;
 };
 
 DxcArgsFileSystem *
@@ -154,6 +154,47 @@ IDxcOperationResult : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOperationResult)
 };
 
+// Available from the result of a compile run with -ftime-report.
+struct __declspec(uuid("3E4C8A52-7D1B-4F0E-9A6C-2B58D17E0C93"))
+IDxcCompileTimings : public IUnknown {
+  // UTF-8 JSON with the wall time of each compile phase and of each pass,
+  // the change in instruction count summed over each pass's runs and, where
+  // the allocator can report it, peak allocation and number of allocations
+  // per phase and the change in outstanding heap bytes per pass.
+  virtual HRESULT STDMETHODCALLTYPE GetTimings(_COM_Outptr_ IDxcBlobEncoding **ppTimings) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileTimings)
+};
+
+// Available from the result of a compile run with -max-memory or
+// -ftime-report, on platforms where the compiler's heap usage is tracked.
+struct __declspec(uuid("9B1F5D2E-6A47-4C83-8E0D-71C4A3B62F58"))
+IDxcCompileMemoryUsage : public IUnknown {
+  // Highest number of bytes the compile had allocated at any one time.
+  virtual HRESULT STDMETHODCALLTYPE GetPeakBytes(_Out_ UINT64 *pPeakBytes) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileMemoryUsage)
+};
+
+// Available from the result of a successful compile run with -Fre.
+struct __declspec(uuid("5C2E8B71-94D3-4A6F-B0E8-3F17A9D6C24B"))
+IDxcCompilePressureReport : public IUnknown {
+  // UTF-8 JSON with the estimated register pressure, groupshared memory and
+  // dynamically indexed arrays of each entry point.
+  virtual HRESULT STDMETHODCALLTYPE GetPressureReport(_COM_Outptr_ IDxcBlobEncoding **ppReport) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompilePressureReport)
+};
+
+// Available from the result of a successful compile run with -Fspv.
+struct __declspec(uuid("E3A7C2D9-58B1-4F06-9D4E-2B8F61C0A7E5"))
+IDxcCompileSpirvOutput : public IUnknown {
+  // The SPIR-V module generated from the same AST as the DXIL container.
+  virtual HRESULT STDMETHODCALLTYPE GetSpirv(_COM_Outptr_ IDxcBlob **ppSpirv) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompileSpirvOutput)
+};
+
 struct __declspec(uuid("7f61fc7d-950d-467f-b3e3-3c02fb49187c"))
 IDxcIncludeHandler : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE LoadSource(
@@ -227,6 +268,107 @@ IDxcCompiler2 : public IDxcCompiler {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompiler2)
 };
 
+// Entry point and shader profile pair for IDxcCompiler3::CompileMany and
+// IDxcLinker2::LinkMany.
+struct DxcCompileTarget {
+  LPCWSTR EntryPoint;
+  LPCWSTR TargetProfile;
+};
+
+struct __declspec(uuid("7A108546-4DD3-4AFC-8149-0CA982F455F4"))
+IDxcCompiler3 : public IDxcCompiler2 {
+  // Compile several entry points out of the same source. Includes are opened
+  // and the source is preprocessed once; each target is then compiled from the
+  // shared preprocessed text. ppResults receives one result per target.
+  virtual HRESULT STDMETHODCALLTYPE CompileMany(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(targetCount) const DxcCompileTarget *pTargets, // Array of entry point and profile pairs
+    _In_ UINT32 targetCount,                      // Number of targets
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(targetCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per target
+  ) = 0;
+
+  // Compile one entry point once per define set. Include files are loaded
+  // once for the whole call. Permutations whose output is identical share a
+  // single result; pCollapsedInto[i] receives the index of the first
+  // permutation with the same output, or i when the output is unique.
+  virtual HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(permutationCount) const DxcDefine *const *ppDefineSets, // Array of define arrays, one per permutation
+    _In_count_(permutationCount) const UINT32 *pDefineCounts, // Number of defines in each define array
+    _In_ UINT32 permutationCount,                 // Number of permutations
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(permutationCount) IDxcOperationResult **ppResults, // Compiler output status, buffer, and errors per permutation
+    _Out_writes_opt_(permutationCount) UINT32 *pCollapsedInto // Index of the permutation each result was shared with
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcCompiler3)
+};
+
+struct IDxcAsyncOperation;
+
+struct __declspec(uuid("051963A5-0FD2-40D9-8826-6C04D6D832B8"))
+IDxcAsyncCompileCallback : public IUnknown {
+  // Called once an asynchronous compile has completed or was cancelled. This
+  // runs on a compiler worker thread, or on the thread that cancelled the
+  // operation.
+  virtual HRESULT STDMETHODCALLTYPE OnCompleted(
+    _In_ IDxcAsyncOperation *pOperation   // Operation that has completed
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompileCallback)
+};
+
+struct __declspec(uuid("571B1D06-2180-4BD2-9CA0-46C4FBEE1B60"))
+IDxcAsyncOperation : public IUnknown {
+  // Returns whether the operation has completed or was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE IsComplete(_Out_ BOOL *pComplete) = 0;
+  // Blocks until the operation has completed or was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE Wait() = 0;
+  // Cancels the operation if it hasn't started yet. Returns S_FALSE when the
+  // compile is already running or done; a running compile is not interrupted.
+  virtual HRESULT STDMETHODCALLTYPE Cancel() = 0;
+  // Gets the compile result once complete. Returns E_PENDING while the
+  // operation is in flight and E_ABORT if it was cancelled.
+  virtual HRESULT STDMETHODCALLTYPE GetResult(
+    _COM_Outptr_ IDxcOperationResult **ppResult // Compiler output status, buffer, and errors
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcAsyncOperation)
+};
+
+struct __declspec(uuid("4D8995CD-FA1A-4D5F-B437-4C4C3906EA1B"))
+IDxcAsyncCompiler : public IUnknown {
+  // Queue a compile of a single entry point onto the compiler's worker
+  // threads and return immediately. All inputs are captured before the call
+  // returns; the include handler is invoked from a worker thread.
+  virtual HRESULT STDMETHODCALLTYPE CompileAsync(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // entry point name
+    _In_ LPCWSTR pTargetProfile,                  // shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_opt_ IDxcAsyncCompileCallback *pCallback, // Optional callback invoked on completion
+    _COM_Outptr_ IDxcAsyncOperation **ppOperation // Handle to wait on, cancel, or get the result from
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompiler)
+};
+
 struct __declspec(uuid("F1B5BE2A-62DD-4327-A1C2-42AC1E1E78E6"))
 IDxcLinker : public IUnknown {
 public:
@@ -254,11 +396,45 @@ public:
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcLinker)
 };
 
+struct __declspec(uuid("2c9e4f71-5a3b-4d86-b0f2-7e18c6a9d453"))
+IDxcLinker2 : public IDxcLinker {
+public:
+  // Links several targets against the same libraries, in parallel on worker
+  // threads. Each worker loads the libraries once for all the targets it
+  // links. ppResults receives one result per target.
+  virtual HRESULT STDMETHODCALLTYPE LinkMany(
+      _In_count_(targetCount)
+          const DxcCompileTarget *pTargets, // Array of entry point and profile pairs
+      UINT32 targetCount,                   // Number of targets
+      _In_count_(libCount)
+          const LPCWSTR *pLibNames, // Array of library names to link
+      UINT32 libCount,              // Number of libraries to link
+      _In_count_(argCount)
+          const LPCWSTR *pArguments, // Array of pointers to arguments
+      _In_ UINT32 argCount,          // Number of arguments
+      _Out_writes_(targetCount) IDxcOperationResult *
+          *ppResults // Linker output status, buffer, and errors per target
+  ) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcLinker2)
+};
+
 static const UINT32 DxcValidatorFlags_Default = 0;
 static const UINT32 DxcValidatorFlags_InPlaceEdit = 1;  // Validator is allowed to update shader blob in-place.
 static const UINT32 DxcValidatorFlags_RootSignatureOnly = 2;
 static const UINT32 DxcValidatorFlags_ModuleOnly = 4;
-static const UINT32 DxcValidatorFlags_ValidMask = 0x7;
+static const UINT32 DxcValidatorFlags_StopAtFirstError = 8; // Skip the remaining checks once one reports an error.
+static const UINT32 DxcValidatorFlags_ReportTimings = 0x10; // Per-check timings are available from IDxcCompileTimings on the result.
+// Run only the selected groups of checks; when none is selected, all run.
+// Metadata also runs the Instructions checks, and Instructions the
+// FlowControl ones, since they collect what the selected checks look at.
+static const UINT32 DxcValidatorFlags_RulesMetadata = 0x100;     // Meta, Sm
+static const UINT32 DxcValidatorFlags_RulesDeclarations = 0x200; // Decl
+static const UINT32 DxcValidatorFlags_RulesFlowControl = 0x400;  // Flow
+static const UINT32 DxcValidatorFlags_RulesInstructions = 0x800; // Instr, Types, Uni
+static const UINT32 DxcValidatorFlags_RulesContainer = 0x1000;   // Container
+static const UINT32 DxcValidatorFlags_RulesMask = 0x1f00;
+static const UINT32 DxcValidatorFlags_ValidMask = 0x1f1f;
 
 struct __declspec(uuid("A6E82BD2-1FD7-4826-9811-2857E797F49A"))
 IDxcValidator : public IUnknown {
@@ -272,6 +448,17 @@ IDxcValidator : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcValidator)
 };
 
+// Implemented by the internal validator. The result of a validation is
+// stored in a directory and reused when a shader with the same parts is
+// validated again by the same validator version with the same flags.
+struct __declspec(uuid("B3D75A2C-4E18-4F69-8C0A-6D29E1F47B35"))
+IDxcValidatorCache : public IUnknown {
+  // Stores and looks up results in pDirectory; nullptr turns caching off.
+  virtual HRESULT STDMETHODCALLTYPE SetCacheDirectory(_In_opt_z_ LPCWSTR pDirectory) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcValidatorCache)
+};
+
 struct __declspec(uuid("334b1f50-2292-4b35-99a1-25588d8c17fe"))
 IDxcContainerBuilder : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pDxilContainerHeader) = 0;                // Loads DxilContainer to the builder
@@ -282,6 +469,33 @@ IDxcContainerBuilder : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerBuilder)
 };
 
+// Packs containers into a shader archive. A part that several containers
+// have in common, such as the root signature or signatures shared by
+// permutations, is stored once.
+struct __declspec(uuid("3b2b3266-11f0-4c28-9d1c-d0b529b35392"))
+IDxcShaderArchiveBuilder : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE AddContainer(_In_ IDxcBlob *pContainer) = 0;            // Adds a container; adding it again has no effect
+  virtual HRESULT STDMETHODCALLTYPE SerializeArchive(_COM_Outptr_ IDxcBlob **ppResult) = 0; // Builds an archive of the added containers
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchiveBuilder)
+};
+
+// Reads containers from a shader archive in place. A container is found by
+// its key: its hash, or the MD5 of the container if it has no hash.
+struct __declspec(uuid("7888900e-18cd-42d1-8d27-eb9d10de1dca"))
+IDxcShaderArchive : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pArchive) = 0; // Archive to load.
+  virtual HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetContainerKey(UINT32 idx, _Out_writes_bytes_(16) BYTE *pKey) = 0;
+  virtual HRESULT STDMETHODCALLTYPE FindContainer(_In_reads_bytes_(16) const BYTE *pKey, _Out_ UINT32 *pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) = 0;   // Rebuilds the archived container
+  virtual HRESULT STDMETHODCALLTYPE GetPartCount(UINT32 idx, _Out_ UINT32 *pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetPartKind(UINT32 idx, UINT32 partIdx, _Out_ UINT32 *pResult) = 0;
+  virtual HRESULT STDMETHODCALLTYPE GetPartContent(UINT32 idx, UINT32 partIdx, _COM_Outptr_ IDxcBlob **ppResult) = 0; // Refers to the archive without copying
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchive)
+};
+
 struct __declspec(uuid("091f7a26-1c1f-4948-904b-e6e3a8a771d5"))
 IDxcAssembler : public IUnknown {
   // Assemble dxil in ll or llvm bitcode to DXIL container.
@@ -297,6 +511,10 @@ IDxcAssembler : public IUnknown {
 // in order to fit it in to ID3D12LibraryReflection.
 static const UINT32 D3D_SIT_RTACCELERATIONSTRUCTURE = 12; // (D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER + 1)
 
+// The reflection objects GetPartReflection returns (ID3D12ShaderReflection,
+// ID3D12LibraryReflection and everything reached from them) don't change
+// once created, and may be shared and queried from several threads at once
+// without locking. Loading a container while it is queried is not safe.
 struct __declspec(uuid("d2c21b26-8350-4bdc-976a-331ce6f4c54c"))
 IDxcContainerReflection : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pContainer) = 0; // Container to load.
@@ -309,6 +527,56 @@ IDxcContainerReflection : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflection)
 };
 
+// Implemented by IDxcContainerReflection. Gets a hash of the loaded container
+// that only covers the parts that decide what the code does, to find
+// duplicate shaders in caches: builds that differ in debug info, the debug
+// name, embedded source or reflection hash the same.
+struct __declspec(uuid("c8a4f1b3-5e27-4d96-9f0a-71b3e6d2c845"))
+IDxcContainerSemanticHash : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE GetSemanticHash(_Out_ UINT64 *pResult) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcContainerSemanticHash)
+};
+
+// A resource of a library, as ID3D12LibraryReflection reports it.
+struct DxcLibraryResourceDesc {
+  LPCSTR Name;
+  UINT32 Type;      // D3D_SHADER_INPUT_TYPE
+  UINT32 Space;
+  UINT32 BindPoint;
+  UINT32 BindCount;
+};
+
+// A function of a library. Resources holds indices into the resources of
+// the table, in the order that ID3D12FunctionReflection reports them.
+struct DxcLibraryFunctionDesc {
+  LPCSTR Name;
+  LPCSTR UnmangledName;
+  UINT64 FeatureInfo;          // ShaderFeatureInfo flags, as in the SFI0 part
+  UINT32 ShaderKind;           // hlsl::DXIL::ShaderKind; Library if not a shader
+  UINT32 PayloadSizeInBytes;   // Hit and miss shaders: payload; callable shaders: parameter
+  UINT32 AttributeSizeInBytes; // Hit shaders
+  UINT32 NumResources;
+  const UINT32 *Resources;
+};
+
+struct DxcLibraryFunctionTable {
+  UINT32 NumFunctions;
+  const DxcLibraryFunctionDesc *Functions; // In GetFunctionByIndex order
+  UINT32 NumResources;
+  const DxcLibraryResourceDesc *Resources;
+};
+
+// Implemented by the library reflection of GetPartReflection. Describes all
+// functions of the library in one call; the arrays stay valid for as long as
+// the reflection object.
+struct __declspec(uuid("6d3e1f2a-8b47-4c59-a0e6-2f9b81c4d735"))
+IDxcLibraryReflectionTable : public IUnknown {
+  virtual HRESULT STDMETHODCALLTYPE GetFunctionTable(_Out_ DxcLibraryFunctionTable *pTable) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcLibraryReflectionTable)
+};
+
 struct __declspec(uuid("AE2CD79F-CC22-453F-9B6B-B124E7A5204C"))
 IDxcOptimizerPass : public IUnknown {
   virtual HRESULT STDMETHODCALLTYPE GetOptionName(_COM_Outptr_ LPWSTR *ppResult) = 0;
@@ -332,6 +600,19 @@ IDxcOptimizer : public IUnknown {
   DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer)
 };
 
+struct __declspec(uuid("5C8E0F3A-94D2-4B7E-A1C6-3F27B8D95E04"))
+IDxcOptimizer2 : public IDxcOptimizer {
+  // As RunOptimizer, and also returns a UTF-8 JSON report with the wall time
+  // of each pass and the change in instruction count summed over its runs.
+  virtual HRESULT STDMETHODCALLTYPE RunOptimizerWithReport(IDxcBlob *pBlob,
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_ IDxcBlob **pOutputModule,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppPassReport) = 0;
+
+  DECLARE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer2)
+};
+
 static const UINT32 DxcVersionInfoFlags_None = 0;
 static const UINT32 DxcVersionInfoFlags_Debug = 1; // Matches VS_FF_DEBUG
 static const UINT32 DxcVersionInfoFlags_Internal = 2; // Internal Validator (non-signing)
@@ -367,6 +648,14 @@ __declspec(selectany) EXTERN const CLSID CLSID_DxcCompiler = {
   { 0xb5, 0xbf, 0xf0, 0x66, 0x4f, 0x39, 0xc1, 0xb0 }
 };
 
+// {9C7BB25C-F9E0-4056-8306-DA7CB78244BF}
+__declspec(selectany) EXTERN const CLSID CLSID_DxcAsyncCompiler = {
+  0x9c7bb25c,
+  0xf9e0,
+  0x4056,
+  { 0x83, 0x06, 0xda, 0x7c, 0xb7, 0x82, 0x44, 0xbf }
+};
+
 // {EF6A8087-B0EA-4D56-9E45-D07E1A8B7806}
 __declspec(selectany) EXTERN const GUID CLSID_DxcLinker = {
     0xef6a8087,
@@ -430,4 +719,20 @@ __declspec(selectany) EXTERN const GUID CLSID_DxcContainerBuilder = {
   0x4574,  
   { 0xb4, 0xd0, 0x87, 0x41, 0xe2, 0x52, 0x40, 0xd2 }
 };
+
+// {d5617430-0c18-42d3-ba23-dac834c3475a}
+__declspec(selectany) EXTERN const GUID CLSID_DxcShaderArchiveBuilder = {
+  0xd5617430,
+  0x0c18,
+  0x42d3,
+  { 0xba, 0x23, 0xda, 0xc8, 0x34, 0xc3, 0x47, 0x5a }
+};
+
+// {5ef104a4-3198-4f2a-a020-5921bf5c22cd}
+__declspec(selectany) EXTERN const GUID CLSID_DxcShaderArchive = {
+  0x5ef104a4,
+  0x3198,
+  0x4f2a,
+  { 0xa0, 0x20, 0x59, 0x21, 0xbf, 0x5c, 0x22, 0xcd }
+};
 #endif
@@ -118,6 +118,16 @@ struct HLSL_INTRINSIC {
   const HLSL_INTRINSIC_ARGUMENT* pArgs; // Pointer to first argument.
 };
 
+// Perfect hash from (name, argument count) to the first matching intrinsic
+// in a table; generated along with the tables.
+struct HLSL_INTRINSIC_INDEX {
+  const HLSL_INTRINSIC* pTable;         // Table being indexed.
+  UINT uNumDisplacements;               // Count of hash buckets.
+  UINT uSlotMask;                       // Count of slots minus one; a power of two minus one.
+  const WORD* pDisplacements;           // Seed that places each bucket's keys in free slots.
+  const WORD* pSlots;                   // Table index of each key, or 0xFFFF for an empty slot.
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // Interfaces.
 struct __declspec(uuid("f0d4da3f-f863-4660-b8b4-dfd94ded6215"))
@@ -151,8 +151,9 @@ typedef enum DxcTranslationUnitFlags
   // Used to indicate that the translation unit is incomplete.
   DxcTranslationUnitFlags_Incomplete = 0x02,
 
-  // Used to indicate that the translation unit should be built with an
-  // implicit precompiled header for the preamble.
+  // Used to indicate that the bodies of functions outside the main file
+  // should be skipped, on parse and on reparse, in place of an implicit
+  // precompiled header for the preamble. Not part of the default options.
   DxcTranslationUnitFlags_PrecompiledPreamble = 0x04,
 
   // Used to indicate that the translation unit should cache some
@@ -71,6 +71,15 @@ public:
   /// custom metadata IDs registered in this LLVMContext.
   void getMDKindNames(SmallVectorImpl<StringRef> &Result) const;
 
+  // HLSL Change Begin - Reuse of a context across modules.
+  /// resetStructTypeNames - Drop the names of the identified struct types
+  /// that don't start with KeepPrefix, and restart the numbering used to
+  /// rename clashing ones, so the next module built in this context names its
+  /// types as it would in a new context. The types themselves stay alive
+  /// until the context is destroyed.
+  void resetStructTypeNames(StringRef KeepPrefix);
+  // HLSL Change End
+
 
   typedef void (*InlineAsmDiagHandlerTy)(const SMDiagnostic&, void *Context,
                                          unsigned LocCookie);
@@ -45,6 +45,7 @@ public:
   virtual void add(Pass *P) = 0;
 
   raw_ostream *TrackPassOS = nullptr; // HLSL Change - add this field
+  ArrayRef<std::string> PassOptionOverrides; // HLSL Change - applied by add
 };
 
 /// PassManager manages ModulePassManagers
@@ -98,6 +98,8 @@ namespace llvm {
   class Value;
   class Timer;
   class PMDataManager;
+  class Function;            // HLSL Change
+  class PhaseTimingListener; // HLSL Change
 
 // enums for debugging strings
 enum PassDebuggingString {
@@ -474,6 +476,35 @@ public:
 
 Timer *getPassTimer(Pass *);
 
+// HLSL Change Begin - per-thread pass timing.
+/// getPassTimingName - Name to report P under to the thread's phase timing
+/// listener, or an empty name for pass managers, whose time is already
+/// covered by the passes they contain.
+StringRef getPassTimingName(Pass *P);
+
+/// PassSizeTracker - Reports to the thread's phase timing listener how a pass
+/// run changed the instruction count of the function or module it ran on,
+/// when the listener wants pass sizes. Declare it ahead of the run's
+/// PhaseTimingRegion so the counting isn't timed.
+class PassSizeTracker {
+  PhaseTimingListener *Listener;
+  StringRef Name;
+  const Function *F;
+  const Module *M;
+  uint64_t Before;
+
+  uint64_t countInstructions() const;
+
+  PassSizeTracker(const PassSizeTracker &) = delete;
+  void operator=(const PassSizeTracker &) = delete;
+
+public:
+  PassSizeTracker(StringRef Name, const Function &F);
+  PassSizeTracker(StringRef Name, const Module &M);
+  ~PassSizeTracker();
+};
+// HLSL Change End
+
 }
 
 #endif
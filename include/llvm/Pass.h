@@ -105,6 +105,13 @@ bool GetPassOptionInt(PassOptions &O, llvm::StringRef name, int *pValue, int def
 bool GetPassOptionUInt32(PassOptions &O, llvm::StringRef name, uint32_t *pValue, uint32_t defaultValue);
 bool GetPassOptionUInt64(PassOptions &O, llvm::StringRef name, uint64_t *pValue, uint64_t defaultValue);
 bool GetPassOptionFloat(PassOptions &O, llvm::StringRef name, float *pValue, float defaultValue);
+
+// Overrides are written like dxopt arguments, without the leading dash:
+// "pass-name,Option=Value[,Option=Value...]". The ones for P's pass are
+// applied on top of its current configuration, so options they don't name
+// keep the values P was created with.
+class Pass;
+void ApplyPassOptionOverrides(Pass *P, llvm::ArrayRef<std::string> Overrides);
 // HLSL Change Ends
 
 //===----------------------------------------------------------------------===//
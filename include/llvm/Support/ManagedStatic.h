@@ -99,6 +99,17 @@ public:
 /// llvm_shutdown - Deallocate and destroy all ManagedStatic variables.
 void llvm_shutdown();
 
+// HLSL Change Starts
+/// llvm_set_managed_static_alloc_hooks - Sets functions called around the
+/// creation of each ManagedStatic object, so a host whose allocator changes
+/// per call can have process-wide state allocated from a long-lived one.
+/// Enter returns a cookie that is passed to the matching Leave.
+typedef void *(*ManagedStaticEnterFn)();
+typedef void (*ManagedStaticLeaveFn)(void *Cookie);
+void llvm_set_managed_static_alloc_hooks(ManagedStaticEnterFn Enter,
+                                         ManagedStaticLeaveFn Leave);
+// HLSL Change Ends
+
 /// llvm_shutdown_obj - This is a simple helper class that calls
 /// llvm_shutdown() when it is destroyed.
 struct llvm_shutdown_obj {
@@ -0,0 +1,80 @@
+//===-- llvm/Support/PhaseTiming.h - Per-thread phase timing ----*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - this file is new. It lets a host collect wall-clock timings
+// for the phases and passes of a single compile without going through the
+// process-wide TimerGroup machinery, which isn't safe to use from several
+// concurrent compiles.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_PHASETIMING_H
+#define LLVM_SUPPORT_PHASETIMING_H
+
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+namespace llvm {
+
+/// PhaseTimingListener - Receives the phase and pass timings recorded on the
+/// thread it is installed on.
+class PhaseTimingListener {
+public:
+  virtual ~PhaseTimingListener();
+
+  /// phaseFinished - A top-level compile phase took Seconds of wall time.
+  virtual void phaseFinished(StringRef Name, double Seconds) = 0;
+
+  /// passFinished - One run of the named pass took Seconds of wall time.
+  virtual void passFinished(StringRef Name, double Seconds) = 0;
+
+  /// wantsPassSizes - Return true to also be told how each pass run changed
+  /// the size of the IR it ran on. Sizes are found by walking the IR before
+  /// and after every run, outside the timed region.
+  virtual bool wantsPassSizes() { return false; }
+
+  /// passStarted - A run of the named pass that will report its size change
+  /// is about to start.
+  virtual void passStarted(StringRef Name) {}
+
+  /// passSizeChanged - The run of the named pass that finished last changed
+  /// the instruction count of the function or module it ran on by
+  /// InstructionDelta.
+  virtual void passSizeChanged(StringRef Name, int64_t InstructionDelta) {}
+};
+
+/// setPhaseTimingListener - Installs L for the current thread and returns the
+/// previously installed listener. Pass nullptr to stop listening.
+PhaseTimingListener *setPhaseTimingListener(PhaseTimingListener *L);
+
+/// getPhaseTimingListener - Returns the listener for the current thread, or
+/// nullptr if none is installed.
+PhaseTimingListener *getPhaseTimingListener();
+
+/// PhaseTimingRegion - Reports the wall time between construction and
+/// destruction to the current thread's listener. Regions with an empty name
+/// are not reported. When no listener is installed this does nothing beyond
+/// a thread-local load.
+class PhaseTimingRegion {
+  PhaseTimingListener *Listener;
+  StringRef Name;
+  bool IsPass;
+  double Start;
+
+  PhaseTimingRegion(const PhaseTimingRegion &) = delete;
+  void operator=(const PhaseTimingRegion &) = delete;
+
+public:
+  PhaseTimingRegion(StringRef Name, bool IsPass = false);
+  ~PhaseTimingRegion();
+};
+
+} // end namespace llvm
+
+#endif // LLVM_SUPPORT_PHASETIMING_H
@@ -0,0 +1,29 @@
+//===- llvm/Support/xxhash.h - XXH64 hash function --------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares xxHash64, a fast non-cryptographic hash function. Its
+// results are the same on every host and in every release of the library,
+// so they can be stored and compared later, unlike those of hash_value.
+//
+// Based on XXH64 from the xxHash library by Yann Collet,
+// https://github.com/Cyan4973/xxHash, under the BSD 2-Clause License.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_XXHASH_H
+#define LLVM_SUPPORT_XXHASH_H
+
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+
+namespace llvm {
+uint64_t xxHash64(llvm::StringRef Data);
+}
+
+#endif
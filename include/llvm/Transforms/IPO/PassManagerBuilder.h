@@ -129,6 +129,26 @@ public:
   bool HLSLHighLevel = false; // HLSL Change
   hlsl::HLSLExtensionsCodegenHelper *HLSLExtensionsCodeGen = nullptr; // HLSL Change
   bool HLSLResMayAlias = false; // HLSL Change
+  bool HLSLFastIteration = false; // HLSL Change
+  bool HLSLInferNonUniformIndex = false; // HLSL Change
+  bool HLSLFastTrig = false; // HLSL Change
+  bool HLSLDemoteOutputPrecision = false; // HLSL Change
+  bool HLSLAutoControlFlowHints = false; // HLSL Change
+  bool HLSLGroupSharedBankConflicts = false; // HLSL Change
+  bool HLSLPadGroupShared = false; // HLSL Change
+  bool HLSLInferEarlyDepthStencil = false; // HLSL Change
+  bool HLSLWarnEarlyDepthStencil = false; // HLSL Change
+  bool HLSLRecommendRootConstants = false; // HLSL Change
+  bool HLSLMergeIdenticalFunctions = false; // HLSL Change
+  bool HLSLPositionOnly = false; // HLSL Change
+  bool HLSLEliminateRedundantBarriers = false; // HLSL Change
+  bool HLSLWaveAggregateAtomics = false; // HLSL Change
+  bool HLSLPair16BitOps = false; // HLSL Change
+  bool HLSLClusterFetches = false; // HLSL Change
+  bool HLSLStrengthReduceBufferIndices = false; // HLSL Change
+  bool HLSLUnswitchUniformLoops = false; // HLSL Change
+  bool HLSLGatherTexelLoads = false; // HLSL Change
+  bool HLSLProfileUse = false; // HLSL Change
 
 private:
   /// ExtensionList - This is list of all of the extensions that are registered.
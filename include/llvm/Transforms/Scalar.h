@@ -221,7 +221,12 @@ Pass *createGlobalMergePass(const TargetMachine *TM, unsigned MaximalOffset,
 //
 // LoopUnswitch - This pass is a simple loop unswitching pass.
 //
-Pass *createLoopUnswitchPass(bool OptimizeForSize = false);
+// HLSL Change - UniformOnly unswitches only on wave-uniform conditions, and
+// SizeBudget bounds the code that unswitching a loop may add; the default
+// takes it from the loop-unswitch-threshold option.
+Pass *createLoopUnswitchPass(bool OptimizeForSize = false,
+                             bool UniformOnly = false,
+                             unsigned SizeBudget = ~0U);
 
 //===----------------------------------------------------------------------===//
 //
@@ -158,7 +158,7 @@ static Constant *ConstantFoldUnaryFPIntrinsic(OP::OpCode opcode, Type *Ty, Const
   case OP::OpCode::Htan: return DxilConstantFoldFP(tanh, Op, Ty);
   case OP::OpCode::Exp:  return DxilConstantFoldFP(exp2, Op, Ty);
   case OP::OpCode::Frc: {
-    NativeFPUnaryOp f = [](double x) { double unused; return fabs(modf(x, &unused)); };
+    NativeFPUnaryOp f = [](double x) { return x - floor(x); };
     return DxilConstantFoldFP(f, Op, Ty);
   }
   case OP::OpCode::Log: return DxilConstantFoldFP(log2, Op, Ty);
@@ -270,6 +270,82 @@ static Constant *ConstantFoldDot(OP::OpCode opcode, Type *Ty, const DxilIntrinsi
   return nullptr;
 }
 
+// Constant folding for dot2AddHalf: acc + ax * bx + ay * by, with the half
+// operands widened to the type of the accumulator.
+static Constant *ConstantFoldDot2AddHalf(Type *Ty, const DxilIntrinsicOperands &operands) {
+  ConstantFP *Acc = operands.GetConstantFloat(0);
+  ConstantFP *Halves[4];
+  for (unsigned i = 0; i < 4; ++i)
+    Halves[i] = operands.GetConstantFloat(i + 1);
+  if (!IsValidOp(Acc) || !AllValidOps(Halves))
+    return nullptr;
+
+  APFloat::roundingMode roundingMode = APFloat::roundingMode::rmNearestTiesToEven;
+  const fltSemantics &Sem = Acc->getValueAPF().getSemantics();
+  APFloat Wide[4] = { Halves[0]->getValueAPF(), Halves[1]->getValueAPF(),
+                      Halves[2]->getValueAPF(), Halves[3]->getValueAPF() };
+  for (APFloat &V : Wide) {
+    bool losesInfo;
+    V.convert(Sem, roundingMode, &losesInfo);
+  }
+  APFloat sum(Acc->getValueAPF());
+  Wide[0].multiply(Wide[2], roundingMode);
+  sum.add(Wide[0], roundingMode);
+  Wide[1].multiply(Wide[3], roundingMode);
+  sum.add(Wide[1], roundingMode);
+  return ConstantFP::get(Ty->getContext(), sum);
+}
+
+// Constant fold the dxil intrinsics that classify a floating point value.
+// These also fold NaN and infinity, since they are what they test for.
+static Constant *ConstantFoldIsSpecialFloat(OP::OpCode opcode, Type *Ty, ConstantFP *Op) {
+  const APFloat &F = Op->getValueAPF();
+  bool result = false;
+  switch (opcode) {
+  default: return nullptr;
+  case OP::OpCode::IsNaN:    result = F.isNaN(); break;
+  case OP::OpCode::IsInf:    result = F.isInfinity(); break;
+  case OP::OpCode::IsFinite: result = F.isFinite(); break;
+  case OP::OpCode::IsNormal: result = F.isNormal(); break;
+  }
+  return ConstantInt::get(Ty, result);
+}
+
+// Constant fold intrinsics whose result type differs from their operand
+// types: classification of floats, and conversion of integer bit patterns
+// to floats.
+static Constant *ConstantFoldConversionIntrinsic(OP::OpCode opcode, Type *Ty, const DxilIntrinsicOperands &IntrinsicOperands) {
+  switch (OP::GetOpCodeClass(opcode)) {
+  default: break;
+  case OP::OpCodeClass::IsSpecialFloat: {
+    ConstantFP *Op = IntrinsicOperands.GetConstantFloat(0);
+    if (!Op || !Ty->isIntegerTy(1))
+      return nullptr;
+    return ConstantFoldIsSpecialFloat(opcode, Ty, Op);
+  }
+  case OP::OpCodeClass::LegacyF16ToF32: {
+    ConstantInt *Op = IntrinsicOperands.GetConstantInt(0);
+    if (!Op || !Ty->isFloatTy())
+      return nullptr;
+    // Only the low 16 bits hold the half; widening it is exact.
+    APFloat F(APFloat::IEEEhalf, Op->getValue().trunc(16));
+    bool losesInfo;
+    F.convert(APFloat::IEEEsingle, APFloat::rmNearestTiesToEven, &losesInfo);
+    return ConstantFP::get(Ty->getContext(), F);
+  }
+  case OP::OpCodeClass::MakeDouble: {
+    ConstantInt *Lo = IntrinsicOperands.GetConstantInt(0);
+    ConstantInt *Hi = IntrinsicOperands.GetConstantInt(1);
+    if (!Lo || !Hi || !Ty->isDoubleTy())
+      return nullptr;
+    APInt Bits = Hi->getValue().zext(64).shl(32) | Lo->getValue().zext(64);
+    return ConstantFP::get(Ty->getContext(), APFloat(APFloat::IEEEdouble, Bits));
+  }
+  }
+
+  return nullptr;
+}
+
 // Constant fold a Bfrev dxil intrinsic.
 static Constant *HLSLConstantFoldBfrev(ConstantInt *C, Type *Ty) {
   APInt API = C->getValue();
@@ -375,6 +451,43 @@ static Constant *ComputeBFE(Type *Ty, APInt width, APInt offset, APInt val, std:
     }
 }
 
+// Compute the masked sum of absolute differences of the bytes of ref and src,
+// skipping the bytes where ref is 0, added to accum.
+// msad: https://msdn.microsoft.com/en-us/library/windows/desktop/hh447210(v=vs.85).aspx
+static Constant *ComputeMsad(Type *Ty, APInt ref, APInt src, APInt accum) {
+  if (ref.getBitWidth() != 32)
+    return nullptr;
+  uint64_t sum = accum.getZExtValue();
+  for (unsigned i = 0; i < 4; ++i) {
+    uint64_t refByte = ref.lshr(i * 8).getZExtValue() & 0xff;
+    uint64_t srcByte = src.lshr(i * 8).getZExtValue() & 0xff;
+    if (!refByte)
+      continue;
+    sum += refByte >= srcByte ? refByte - srcByte : srcByte - refByte;
+  }
+  // Overflow may either saturate or wrap, so it isn't folded.
+  if (sum > UINT32_MAX)
+    return nullptr;
+  return ConstantInt::get(Ty, sum);
+}
+
+// Compute the dot product of the four 8-bit values packed in a and b, signed
+// or unsigned, added to acc.
+static Constant *ComputeDot4AddPacked(Type *Ty, bool isSigned, APInt acc, APInt a, APInt b) {
+  if (acc.getBitWidth() != 32)
+    return nullptr;
+  APInt sum = acc;
+  for (unsigned i = 0; i < 4; ++i) {
+    APInt aByte = a.lshr(i * 8).trunc(8);
+    APInt bByte = b.lshr(i * 8).trunc(8);
+    if (isSigned)
+      sum += aByte.sext(32) * bByte.sext(32);
+    else
+      sum += aByte.zext(32) * bByte.zext(32);
+  }
+  return ConstantInt::get(Ty, sum);
+}
+
 // Constant fold ternary integer intrinsic.
 static Constant *ConstantFoldTernaryIntIntrinsic(OP::OpCode opcode, Type *Ty, ConstantInt *Op1, ConstantInt *Op2, ConstantInt *Op3) {
   APInt C1 = Op1->getValue();
@@ -391,6 +504,7 @@ static Constant *ConstantFoldTernaryIntIntrinsic(OP::OpCode opcode, Type *Ty, Co
   }
   case OP::OpCode::Ubfe: return ComputeBFE(Ty, C1, C2, C3, [](APInt val, APInt amt) {return val.lshr(amt); });
   case OP::OpCode::Ibfe: return ComputeBFE(Ty, C1, C2, C3, [](APInt val, APInt amt) {return val.ashr(amt); });
+  case OP::OpCode::Msad: return ComputeMsad(Ty, C1, C2, C3);
   }
 
   return nullptr;
@@ -421,6 +535,44 @@ static Constant *ConstantFoldQuaternaryIntInstrinsic(OP::OpCode opcode, Type *Ty
   return ConstantInt::get(Ty, result);
 }
 
+// Constant fold the binary integer intrinsics that return two values,
+// udiv and uaddc/usubb.
+static Constant *ConstantFoldStructIntIntrinsic(OP::OpCode opcode, StructType *Ty, const DxilIntrinsicOperands &IntrinsicOperands) {
+  if (IntrinsicOperands.Size() != 2 || Ty->getNumElements() != 2)
+    return nullptr;
+  ConstantInt *Op1 = IntrinsicOperands.GetConstantInt(0);
+  ConstantInt *Op2 = IntrinsicOperands.GetConstantInt(1);
+  if (!Op1 || !Op2)
+    return nullptr;
+  const APInt &C1 = Op1->getValue();
+  const APInt &C2 = Op2->getValue();
+  Type *Ty0 = Ty->getElementType(0);
+  Type *Ty1 = Ty->getElementType(1);
+
+  Constant *Results[2] = { nullptr, nullptr };
+  switch (opcode) {
+  default: return nullptr;
+  case OP::OpCode::UDiv:
+    // Divide by zero returns all ones for both the quotient and remainder.
+    if (!C2) {
+      Results[0] = Results[1] = ConstantInt::get(Ty0, APInt::getAllOnesValue(C1.getBitWidth()));
+    } else {
+      Results[0] = ConstantInt::get(Ty0, C1.udiv(C2));
+      Results[1] = ConstantInt::get(Ty1, C1.urem(C2));
+    }
+    break;
+  case OP::OpCode::UAddc:
+    Results[0] = ConstantInt::get(Ty0, C1 + C2);
+    Results[1] = ConstantInt::get(Ty1, (C1 + C2).ult(C1));
+    break;
+  case OP::OpCode::USubb:
+    Results[0] = ConstantInt::get(Ty0, C1 - C2);
+    Results[1] = ConstantInt::get(Ty1, C1.ult(C2));
+    break;
+  }
+  return ConstantStruct::get(Ty, Results);
+}
+
 // Top level function to constant fold floating point intrinsics.
 static Constant *ConstantFoldFPIntrinsic(OP::OpCode opcode, Type *Ty, const DxilIntrinsicOperands &IntrinsicOperands) {
   if (!Ty->isHalfTy() && !Ty->isFloatTy() && !Ty->isDoubleTy())
@@ -464,6 +616,8 @@ static Constant *ConstantFoldFPIntrinsic(OP::OpCode opcode, Type *Ty, const Dxil
   case OP::OpCodeClass::Dot3:
   case OP::OpCodeClass::Dot4:
     return ConstantFoldDot(opcode, Ty, IntrinsicOperands);
+  case OP::OpCodeClass::Dot2AddHalf:
+    return ConstantFoldDot2AddHalf(Ty, IntrinsicOperands);
   }
 
   return nullptr;
@@ -517,24 +671,59 @@ static Constant *ConstantFoldIntIntrinsic(OP::OpCode opcode, Type *Ty, const Dxi
 
     return ConstantFoldQuaternaryIntInstrinsic(opcode, Ty, Op1, Op2, Op3, Op4);
   }
+  case OP::OpCodeClass::Dot4AddPacked: {
+    assert(IntrinsicOperands.Size() == 3);
+    ConstantInt *Acc = IntrinsicOperands.GetConstantInt(0);
+    ConstantInt *A = IntrinsicOperands.GetConstantInt(1);
+    ConstantInt *B = IntrinsicOperands.GetConstantInt(2);
+    if (!Acc || !A || !B)
+      return nullptr;
+
+    return ComputeDot4AddPacked(Ty, opcode == OP::OpCode::Dot4AddI8Packed,
+                                Acc->getValue(), A->getValue(), B->getValue());
+  }
   }
 
   return nullptr;
 }
 
+// Returns true for the dxil operations folded here.
+static bool IsConstantFoldableOpcode(OP::OpCode opcode) {
+  unsigned op = (unsigned)opcode;
+  /* <py::lines('OPCODE-CONST-FOLDABLE')>hctdb_instrhelp.get_instrs_pred("op", "is_const_foldable")</py>*/
+  // OPCODE-CONST-FOLDABLE:BEGIN
+  // Instructions: FAbs=6, Saturate=7, IsNaN=8, IsInf=9, IsFinite=10,
+  // IsNormal=11, Cos=12, Sin=13, Tan=14, Acos=15, Asin=16, Atan=17, Hcos=18,
+  // Hsin=19, Htan=20, Exp=21, Frc=22, Log=23, Sqrt=24, Rsqrt=25, Round_ne=26,
+  // Round_ni=27, Round_pi=28, Round_z=29, Bfrev=30, Countbits=31, FirstbitLo=32,
+  // FirstbitHi=33, FirstbitSHi=34, FMax=35, FMin=36, IMax=37, IMin=38, UMax=39,
+  // UMin=40, UDiv=43, UAddc=44, USubb=45, FMad=46, Fma=47, IMad=48, UMad=49,
+  // Msad=50, Ibfe=51, Ubfe=52, Bfi=53, Dot2=54, Dot3=55, Dot4=56,
+  // MakeDouble=101, LegacyF16ToF32=131, Dot2AddHalf=162, Dot4AddI8Packed=163,
+  // Dot4AddU8Packed=164
+  return (6 <= op && op <= 40) || (43 <= op && op <= 56) || op == 101 || op == 131 || (162 <= op && op <= 164);
+  // OPCODE-CONST-FOLDABLE:END
+}
+
 // External entry point to constant fold dxil intrinsics.
 // Called from the llvm constant folding routine.
 Constant *hlsl::ConstantFoldScalarCall(StringRef Name, Type *Ty, ArrayRef<Constant *> RawOperands) {
   OP::OpCode opcode;
-  if (GetDxilOpcode(Name, RawOperands, opcode)) {
+  if (GetDxilOpcode(Name, RawOperands, opcode) && IsConstantFoldableOpcode(opcode)) {
     DxilIntrinsicOperands IntrinsicOperands(RawOperands);
 
+    if (Constant *C = ConstantFoldConversionIntrinsic(opcode, Ty, IntrinsicOperands))
+      return C;
+
     if (Ty->isFloatingPointTy()) {
       return ConstantFoldFPIntrinsic(opcode, Ty, IntrinsicOperands);
     }
     else if (Ty->isIntegerTy()) {
       return ConstantFoldIntIntrinsic(opcode, Ty, IntrinsicOperands);
     }
+    else if (StructType *STy = dyn_cast<StructType>(Ty)) {
+      return ConstantFoldStructIntIntrinsic(opcode, STy, IntrinsicOperands);
+    }
   }
 
   return hlsl::ConstantFoldScalarCallExt(Name, Ty, RawOperands);
@@ -567,6 +756,13 @@ bool hlsl::CanConstantFoldCallTo(const Function *F) {
     case OP::OpCodeClass::Dot2:
     case OP::OpCodeClass::Dot3:
     case OP::OpCodeClass::Dot4:
+    case OP::OpCodeClass::IsSpecialFloat:
+    case OP::OpCodeClass::BinaryWithTwoOuts:
+    case OP::OpCodeClass::BinaryWithCarryOrBorrow:
+    case OP::OpCodeClass::MakeDouble:
+    case OP::OpCodeClass::LegacyF16ToF32:
+    case OP::OpCodeClass::Dot2AddHalf:
+    case OP::OpCodeClass::Dot4AddPacked:
       return true;
     }
   }
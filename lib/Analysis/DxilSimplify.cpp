@@ -15,9 +15,11 @@
 // simplify dxil op like mad 0, a, b->b.
 
 #include "llvm/Analysis/InstructionSimplify.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/IRBuilder.h"
 
@@ -39,6 +41,82 @@ DXIL::OpCode GetOpcode(Value *opArg) {
   }
   return DXIL::OpCode::NumOpCodes;
 }
+
+bool IsZero(Value *V) {
+  ConstantFP *C = dyn_cast<ConstantFP>(V);
+  return C && C->isZero();
+}
+
+// Returns true if V is known to be in [0, 1].
+bool IsInUnitInterval(Value *V, unsigned Depth = 0) {
+  if (ConstantFP *C = dyn_cast<ConstantFP>(V)) {
+    const APFloat &F = C->getValueAPF();
+    if (F.isNaN() || F.isNegative())
+      return false;
+    APFloat One(F.getSemantics(), 1);
+    return F.compare(One) != APFloat::cmpGreaterThan;
+  }
+  if (Depth >= 4)
+    return false;
+  if (UIToFPInst *Cast = dyn_cast<UIToFPInst>(V))
+    return Cast->getSrcTy()->isIntegerTy(1);
+  if (SelectInst *Sel = dyn_cast<SelectInst>(V))
+    return IsInUnitInterval(Sel->getTrueValue(), Depth + 1) &&
+           IsInUnitInterval(Sel->getFalseValue(), Depth + 1);
+  CallInst *CI = dyn_cast<CallInst>(V);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI))
+    return false;
+  switch (OP::GetDxilOpFuncCallInst(CI)) {
+  default:
+    return false;
+  case DXIL::OpCode::Saturate:
+  case DXIL::OpCode::Frc:
+    return true;
+  case DXIL::OpCode::FMin:
+  case DXIL::OpCode::FMax:
+    return IsInUnitInterval(
+               CI->getArgOperand(DXIL::OperandIndex::kBinarySrc0OpIdx),
+               Depth + 1) &&
+           IsInUnitInterval(
+               CI->getArgOperand(DXIL::OperandIndex::kBinarySrc1OpIdx),
+               Depth + 1);
+  }
+}
+
+// Drops the terms of a dot product where either side is 0.
+Value *SimplifyDot(DxilModule &DM, unsigned NumComponents,
+                   ArrayRef<Value *> Args, Instruction *I) {
+  SmallVector<Value *, 4> A, B;
+  for (unsigned i = 0; i < NumComponents; ++i) {
+    Value *Ai = Args[1 + i];
+    Value *Bi = Args[1 + NumComponents + i];
+    if (IsZero(Ai) || IsZero(Bi))
+      continue;
+    A.push_back(Ai);
+    B.push_back(Bi);
+  }
+  if (A.size() == NumComponents)
+    return nullptr;
+  Type *Ty = I->getType();
+  if (A.empty())
+    return ConstantFP::get(Ty, 0);
+
+  IRBuilder<> Builder(I);
+  if (A.size() == 1) {
+    llvm::FastMathFlags FMF;
+    FMF.setUnsafeAlgebraHLSL();
+    Builder.SetFastMathFlags(FMF);
+    return Builder.CreateFMul(A[0], B[0]);
+  }
+  DXIL::OpCode Opcode =
+      A.size() == 2 ? DXIL::OpCode::Dot2 : DXIL::OpCode::Dot3;
+  OP *hlslOP = DM.GetOP();
+  SmallVector<Value *, 7> DotArgs;
+  DotArgs.push_back(hlslOP->GetU32Const((unsigned)Opcode));
+  DotArgs.append(A.begin(), A.end());
+  DotArgs.append(B.begin(), B.end());
+  return Builder.CreateCall(hlslOP->GetOpFunc(Opcode, Ty), DotArgs);
+}
 } // namespace
 
 namespace hlsl {
@@ -56,10 +134,17 @@ bool CanSimplify(const llvm::Function *F) {
 
   // Return true for those dxil operation classes we can simplify.
   if (found) {
+    if (CanConstantFoldCallTo(F))
+      return true;
     switch (opClass) {
     default:
       break;
+    case OP::OpCodeClass::Unary:
+    case OP::OpCodeClass::Binary:
     case OP::OpCodeClass::Tertiary:
+    case OP::OpCodeClass::Dot2:
+    case OP::OpCodeClass::Dot3:
+    case OP::OpCodeClass::Dot4:
       return true;
     }
   }
@@ -123,6 +208,13 @@ Value *SimplifyDxilCall(llvm::Function *F, ArrayRef<Value *> Args,
     Value *op1 = Args[DXIL::OperandIndex::kTrinarySrc1OpIdx];
     if (op1 == zero)
       return op2;
+    if (IsZero(op2)) {
+      IRBuilder<> Builder(I);
+      llvm::FastMathFlags FMF;
+      FMF.setUnsafeAlgebraHLSL();
+      Builder.SetFastMathFlags(FMF);
+      return Builder.CreateFMul(op0, op1);
+    }
 
     Constant *one = ConstantFP::get(op0->getType(), 1);
     if (op0 == one) {
@@ -152,6 +244,10 @@ Value *SimplifyDxilCall(llvm::Function *F, ArrayRef<Value *> Args,
     Value *op1 = Args[DXIL::OperandIndex::kTrinarySrc1OpIdx];
     if (op1 == zero)
       return op2;
+    if (op2 == zero) {
+      IRBuilder<> Builder(I);
+      return Builder.CreateMul(op0, op1);
+    }
 
     Constant *one = ConstantInt::get(op0->getType(), 1);
     if (op0 == one) {
@@ -164,6 +260,30 @@ Value *SimplifyDxilCall(llvm::Function *F, ArrayRef<Value *> Args,
     }
     return nullptr;
   } break;
+  case DXIL::OpCode::Saturate: {
+    Value *op = Args[DXIL::OperandIndex::kUnarySrc0OpIdx];
+    if (IsInUnitInterval(op))
+      return op;
+    return nullptr;
+  } break;
+  case DXIL::OpCode::FMax:
+  case DXIL::OpCode::FMin:
+  case DXIL::OpCode::IMax:
+  case DXIL::OpCode::IMin:
+  case DXIL::OpCode::UMax:
+  case DXIL::OpCode::UMin: {
+    Value *op0 = Args[DXIL::OperandIndex::kBinarySrc0OpIdx];
+    Value *op1 = Args[DXIL::OperandIndex::kBinarySrc1OpIdx];
+    if (op0 == op1)
+      return op0;
+    return nullptr;
+  } break;
+  case DXIL::OpCode::Dot2:
+    return SimplifyDot(DM, 2, Args, I);
+  case DXIL::OpCode::Dot3:
+    return SimplifyDot(DM, 3, Args, I);
+  case DXIL::OpCode::Dot4:
+    return SimplifyDot(DM, 4, Args, I);
   }
 }
 
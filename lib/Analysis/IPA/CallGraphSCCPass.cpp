@@ -25,6 +25,7 @@
 #include "llvm/IR/LegacyPassManagers.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
@@ -127,6 +128,8 @@ bool CGPassManager::RunPassOnSCC(Pass *P, CallGraphSCC &CurSCC,
 
     {
       TimeRegion PassTimer(getPassTimer(CGSP));
+      PassSizeTracker PassSize(getPassTimingName(CGSP), CG.getModule()); // HLSL Change
+      PhaseTimingRegion PassPhase(getPassTimingName(CGSP), /*IsPass*/ true); // HLSL Change
       Changed = CGSP->runOnSCC(CurSCC);
     }
     
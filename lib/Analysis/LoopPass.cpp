@@ -17,6 +17,7 @@
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
@@ -247,6 +248,8 @@ bool LPPassManager::runOnFunction(Function &F) {
       {
         PassManagerPrettyStackEntry X(P, *CurrentLoop->getHeader());
         TimeRegion PassTimer(getPassTimer(P));
+        PassSizeTracker PassSize(getPassTimingName(P), F); // HLSL Change
+        PhaseTimingRegion PassPhase(getPassTimingName(P), /*IsPass*/ true); // HLSL Change
 
         Changed |= P->runOnLoop(CurrentLoop, *this);
       }
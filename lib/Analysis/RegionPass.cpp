@@ -17,6 +17,7 @@
 #include "llvm/Analysis/RegionPass.h"
 #include "llvm/Analysis/RegionIterator.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 using namespace llvm;
@@ -96,6 +97,8 @@ bool RGPassManager::runOnFunction(Function &F) {
         PassManagerPrettyStackEntry X(P, *CurrentRegion->getEntry());
 
         TimeRegion PassTimer(getPassTimer(P));
+        PassSizeTracker PassSize(getPassTimingName(P), F); // HLSL Change
+        PhaseTimingRegion PassPhase(getPassTimingName(P), /*IsPass*/ true); // HLSL Change
         Changed |= P->runOnRegion(CurrentRegion, *this);
       }
 
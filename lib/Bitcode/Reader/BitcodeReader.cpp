@@ -4495,7 +4495,8 @@ OutOfRecordLoop:
   // Trim the value list down to the size it was before we parsed this function.
   ValueList.shrinkTo(ModuleValueListSize);
   MDValueList.shrinkTo(ModuleMDValueListSize);
-  std::vector<BasicBlock*>().swap(FunctionBBs);
+  // HLSL Change - keep the capacity for the next function body.
+  FunctionBBs.clear();
   return std::error_code();
 }
 
@@ -4598,6 +4599,14 @@ std::error_code BitcodeReader::materializeModule(Module *M) {
   // Promise to materialize all forward references.
   WillMaterializeAllForwardRefs = true;
 
+  // HLSL Change Starts
+  // Bodies are parsed one at a time: each one extends ValueList and
+  // MDValueList past the module-level values and trims them back, and the
+  // types, constants and metadata it creates are uniqued in the LLVMContext,
+  // which has no locking. Loaders that only need some bodies use
+  // getLazyBitcodeModule instead, as the linker, validator and reflection do.
+  // HLSL Change Ends
+
   // Iterate over the module, deserializing any functions that are still on
   // disk.
   for (Module::iterator F = TheModule->begin(), E = TheModule->end();
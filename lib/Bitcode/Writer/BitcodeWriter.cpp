@@ -58,8 +58,39 @@ enum {
   FUNCTION_INST_RET_VAL_ABBREV,
   FUNCTION_INST_UNREACHABLE_ABBREV,
   FUNCTION_INST_GEP_ABBREV,
+  FUNCTION_INST_CALL_ABBREV,       // HLSL Change
+  FUNCTION_INST_EXTRACTVAL_ABBREV, // HLSL Change
 };
 
+// HLSL Change Begin - DXIL abbreviations.
+// Most of a DXIL function is plain calls of dx.op functions and extracts of
+// their results, which the generic abbreviations leave unabbreviated. They
+// get their own abbreviations in modules for validators from 1.4 on; the
+// records are the same, so any reader can load them, and modules for older
+// validators keep their exact encoding.
+static const unsigned kDxilAbbrevValMajor = 1;
+static const unsigned kDxilAbbrevValMinor = 4;
+
+static bool UseDxilAbbrevs(const Module *M) {
+  NamedMDNode *ValVer = M->getNamedMetadata("dx.valver");
+  if (ValVer == nullptr || ValVer->getNumOperands() != 1)
+    return false;
+  MDNode *Ver = ValVer->getOperand(0);
+  if (Ver->getNumOperands() != 2)
+    return false;
+  ConstantInt *Major = mdconst::dyn_extract<ConstantInt>(Ver->getOperand(0));
+  ConstantInt *Minor = mdconst::dyn_extract<ConstantInt>(Ver->getOperand(1));
+  if (Major == nullptr || Minor == nullptr)
+    return false;
+  uint64_t Maj = Major->getZExtValue(), Min = Minor->getZExtValue();
+  // 0.0 means no validation at all.
+  if (Maj == 0 && Min == 0)
+    return true;
+  return Maj > kDxilAbbrevValMajor ||
+         (Maj == kDxilAbbrevValMajor && Min >= kDxilAbbrevValMinor);
+}
+// HLSL Change End
+
 static unsigned GetEncodedCastOpcode(unsigned Opcode) {
   switch (Opcode) {
   default: llvm_unreachable("Unknown cast instruction!");
@@ -1684,7 +1715,8 @@ static void pushValueSigned(const Value *V, unsigned InstID,
 /// WriteInstruction - Emit an instruction to the specified stream.
 static void WriteInstruction(const Instruction &I, unsigned InstID,
                              ValueEnumerator &VE, BitstreamWriter &Stream,
-                             SmallVectorImpl<unsigned> &Vals) {
+                             SmallVectorImpl<unsigned> &Vals,
+                             bool DxilAbbrevs) { // HLSL Change
   unsigned Code = 0;
   unsigned AbbrevToUse = 0;
   VE.setInstructionID(&I);
@@ -1724,9 +1756,13 @@ static void WriteInstruction(const Instruction &I, unsigned InstID,
   }
   case Instruction::ExtractValue: {
     Code = bitc::FUNC_CODE_INST_EXTRACTVAL;
-    PushValueAndType(I.getOperand(0), InstID, Vals, VE);
+    bool ForwardRef = PushValueAndType(I.getOperand(0), InstID, Vals, VE); // HLSL Change
     const ExtractValueInst *EVI = cast<ExtractValueInst>(&I);
     Vals.append(EVI->idx_begin(), EVI->idx_end());
+    // HLSL Change Begin - DXIL abbreviations.
+    if (DxilAbbrevs && !ForwardRef && EVI->getNumIndices() == 1)
+      AbbrevToUse = FUNCTION_INST_EXTRACTVAL_ABBREV;
+    // HLSL Change End
     break;
   }
   case Instruction::InsertValue: {
@@ -1977,14 +2013,21 @@ static void WriteInstruction(const Instruction &I, unsigned InstID,
     Vals.push_back((CI.getCallingConv() << 1) | unsigned(CI.isTailCall()) |
                    unsigned(CI.isMustTailCall()) << 14 | 1 << 15);
     Vals.push_back(VE.getTypeID(FTy));
-    PushValueAndType(CI.getCalledValue(), InstID, Vals, VE);  // Callee
+    bool ForwardRef =                                         // HLSL Change
+        PushValueAndType(CI.getCalledValue(), InstID, Vals, VE);  // Callee
+    // HLSL Change Begin - DXIL abbreviations.
+    if (DxilAbbrevs && !ForwardRef && !FTy->isVarArg() &&
+        Vals[1] == 1u << 15) // CC 0, not a tail call
+      AbbrevToUse = FUNCTION_INST_CALL_ABBREV;
+    // HLSL Change End
 
     // Emit value #'s for the fixed parameters.
     for (unsigned i = 0, e = FTy->getNumParams(); i != e; ++i) {
       // Check for labels (can happen with asm labels).
-      if (FTy->getParamType(i)->isLabelTy())
+      if (FTy->getParamType(i)->isLabelTy()) {
         Vals.push_back(VE.getValueID(CI.getArgOperand(i)));
-      else
+        AbbrevToUse = 0; // HLSL Change
+      } else
         pushValue(CI.getArgOperand(i), InstID, Vals, VE);  // fixed param.
     }
 
@@ -2102,7 +2145,8 @@ static void WriteUseListBlock(const Function *F, ValueEnumerator &VE,
 
 /// WriteFunction - Emit a function body to the module stream.
 static void WriteFunction(const Function &F, ValueEnumerator &VE,
-                          BitstreamWriter &Stream) {
+                          BitstreamWriter &Stream,
+                          bool DxilAbbrevs) { // HLSL Change
   Stream.EnterSubblock(bitc::FUNCTION_BLOCK_ID, 4);
   VE.incorporateFunction(F);
 
@@ -2133,7 +2177,7 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
   for (Function::const_iterator BB = F.begin(), E = F.end(); BB != E; ++BB)
     for (BasicBlock::const_iterator I = BB->begin(), E = BB->end();
          I != E; ++I) {
-      WriteInstruction(*I, InstID, VE, Stream, Vals);
+      WriteInstruction(*I, InstID, VE, Stream, Vals, DxilAbbrevs); // HLSL Change
 
       if (!I->getType()->isVoidTy())
         ++InstID;
@@ -2174,7 +2218,8 @@ static void WriteFunction(const Function &F, ValueEnumerator &VE,
 }
 
 // Emit blockinfo, which defines the standard abbreviations etc.
-static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
+static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream,
+                           bool DxilAbbrevs) { // HLSL Change
   // We only want to emit block info records for blocks that have multiple
   // instances: CONSTANTS_BLOCK, FUNCTION_BLOCK and VALUE_SYMTAB_BLOCK.
   // Other blocks can define their abbrevs inline.
@@ -2344,6 +2389,33 @@ static void WriteBlockInfo(const ValueEnumerator &VE, BitstreamWriter &Stream) {
         FUNCTION_INST_GEP_ABBREV)
       llvm_unreachable("Unexpected abbrev ordering!");
   }
+  // HLSL Change Begin - DXIL abbreviations.
+  if (DxilAbbrevs) {
+    { // INST_CALL abbrev for FUNCTION_BLOCK, for plain calls.
+      IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
+      Abbv->Add(BitCodeAbbrevOp(bitc::FUNC_CODE_INST_CALL));
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));  // attrs
+      Abbv->Add(BitCodeAbbrevOp(1 << 15));                  // cc
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Fixed,     // fnty
+                                VE.computeBitsRequiredForTypeIndicies()));
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));  // callee
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Array));   // args
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));
+      if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID, Abbv.get()) !=
+          FUNCTION_INST_CALL_ABBREV)
+        llvm_unreachable("Unexpected abbrev ordering!");
+    }
+    { // INST_EXTRACTVAL abbrev for FUNCTION_BLOCK, for a single index.
+      IntrusiveRefCntPtr<BitCodeAbbrev> Abbv = new BitCodeAbbrev();
+      Abbv->Add(BitCodeAbbrevOp(bitc::FUNC_CODE_INST_EXTRACTVAL));
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 6));  // agg
+      Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::VBR, 4));  // idx
+      if (Stream.EmitBlockInfoAbbrev(bitc::FUNCTION_BLOCK_ID, Abbv.get()) !=
+          FUNCTION_INST_EXTRACTVAL_ABBREV)
+        llvm_unreachable("Unexpected abbrev ordering!");
+    }
+  }
+  // HLSL Change End
 
   Stream.ExitBlock();
 }
@@ -2362,7 +2434,8 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
   ValueEnumerator VE(*M, ShouldPreserveUseListOrder);
 
   // Emit blockinfo, which defines the standard abbreviations etc.
-  WriteBlockInfo(VE, Stream);
+  bool DxilAbbrevs = UseDxilAbbrevs(M); // HLSL Change
+  WriteBlockInfo(VE, Stream, DxilAbbrevs); // HLSL Change
 
   // Emit information about attribute groups.
   WriteAttributeGroupTable(VE, Stream);
@@ -2398,7 +2471,7 @@ static void WriteModule(const Module *M, BitstreamWriter &Stream,
   // Emit function bodies.
   for (Module::const_iterator F = M->begin(), E = M->end(); F != E; ++F)
     if (!F->isDeclaration())
-      WriteFunction(*F, VE, Stream);
+      WriteFunction(*F, VE, Stream, DxilAbbrevs); // HLSL Change
 
   Stream.ExitBlock();
 }
@@ -22,12 +22,14 @@
 
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/raw_ostream.h"
 #include <array>
 #include <algorithm>
+#include <map>
 
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/Support/WinFunctions.h"
@@ -1369,6 +1371,28 @@ MDNode *DxilMDHelper::EmitControlFlowHints(llvm::LLVMContext &Ctx, std::vector<D
   return hintsNode;
 }
 
+void DxilMDHelper::UniqueControlFlowHints() {
+  // The self reference keeps hint nodes from being uniqued on creation, so
+  // each branch gets its own; identical hints can share one.
+  std::map<std::vector<Metadata *>, MDNode *> HintsNodes;
+  for (Function &F : m_pModule->functions()) {
+    for (BasicBlock &BB : F) {
+      TerminatorInst *TI = BB.getTerminator();
+      if (!TI)
+        continue;
+      MDNode *pNode = TI->getMetadata(kDxilControlFlowHintMDName);
+      if (!pNode || pNode->getNumOperands() < 1)
+        continue;
+      std::vector<Metadata *> Hints(pNode->op_begin() + 1, pNode->op_end());
+      MDNode *&pShared = HintsNodes[Hints];
+      if (!pShared)
+        pShared = pNode;
+      else if (pShared != pNode)
+        TI->setMetadata(kDxilControlFlowHintMDName, pShared);
+    }
+  }
+}
+
 void DxilMDHelper::EmitSubobjects(const DxilSubobjects &Subobjects) {
   NamedMDNode *pSubobjectsNamedMD = m_pModule->getNamedMetadata(kDxilSubobjectsMDName);
   IFTBOOL(pSubobjectsNamedMD == nullptr, DXC_E_INCORRECT_DXIL_METADATA);
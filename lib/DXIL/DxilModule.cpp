@@ -108,12 +108,17 @@ DxilModule::DxilModule(Module *pModule)
 , m_ValMinor(0)
 , m_pOP(llvm::make_unique<OP>(pModule->getContext(), pModule))
 , m_pTypeSystem(llvm::make_unique<DxilTypeSystem>(pModule))
+, m_bTypeSystemPending(false)
 , m_bDisableOptimizations(false)
 , m_bUseMinPrecision(true) // use min precision by default
 , m_bAllResourcesBound(false)
 , m_IntermediateFlags(0)
 , m_AutoBindingSpace(UINT_MAX)
 , m_pSubobjects(nullptr)
+, m_bSubobjectsPending(false)
+, m_DirtyMetadata(0)
+, m_ShaderFlagsValMajor(0)
+, m_ShaderFlagsValMinor(0)
 {
 
   DXASSERT_NOMSG(m_pModule != nullptr);
@@ -280,9 +285,38 @@ unsigned DxilModule::GetGlobalFlags() const {
   return Flags;
 }
 
+ShaderFlags DxilModule::GetFunctionShaderFlags(const Function *F) const {
+  // Some flags are collected differently for older validators.
+  if (m_ShaderFlagsValMajor != m_ValMajor ||
+      m_ShaderFlagsValMinor != m_ValMinor) {
+    m_FunctionShaderFlags.clear();
+    m_ShaderFlagsValMajor = m_ValMajor;
+    m_ShaderFlagsValMinor = m_ValMinor;
+  }
+  auto it = m_FunctionShaderFlags.find(F);
+  if (it == m_FunctionShaderFlags.end())
+    it = m_FunctionShaderFlags
+             .emplace(F, ShaderFlags::CollectShaderFlags(F, this))
+             .first;
+  // Module options can change without the function changing.
+  ShaderFlags Flags = it->second;
+  Flags.SetUseNativeLowPrecision(!m_bUseMinPrecision);
+  Flags.SetDisableOptimizations(m_bDisableOptimizations);
+  Flags.SetAllResourcesBound(m_bAllResourcesBound);
+  return Flags;
+}
+
+void DxilModule::InvalidateShaderFlags(const Function *F) {
+  m_FunctionShaderFlags.erase(F);
+}
+
+void DxilModule::InvalidateAllShaderFlags() {
+  m_FunctionShaderFlags.clear();
+}
+
 void DxilModule::CollectShaderFlagsForModule(ShaderFlags &Flags) {
   for (Function &F : GetModule()->functions()) {
-    ShaderFlags funcFlags = ShaderFlags::CollectShaderFlags(&F, this);
+    ShaderFlags funcFlags = GetFunctionShaderFlags(&F);
     Flags.CombineShaderFlags(funcFlags);
   };
 
@@ -330,6 +364,7 @@ void DxilModule::CollectShaderFlagsForModule(ShaderFlags &Flags) {
 }
 
 void DxilModule::CollectShaderFlagsForModule() {
+  InvalidateAllShaderFlags();
   CollectShaderFlagsForModule(m_ShaderFlags);
 }
 
@@ -806,8 +841,11 @@ static void ConvertUsedResource(std::unordered_set<unsigned> &immResID,
 void DxilModule::RemoveFunction(llvm::Function *F) {
   DXASSERT_NOMSG(F != nullptr);
   m_DxilEntryPropsMap.erase(F);
-  if (m_pTypeSystem.get()->GetFunctionAnnotation(F))
-    m_pTypeSystem.get()->EraseFunctionAnnotation(F);
+  m_FunctionShaderFlags.erase(F);
+  // The annotation metadata can't be decoded once F is gone.
+  DxilTypeSystem &TypeSystem = GetTypeSystem();
+  if (TypeSystem.GetFunctionAnnotation(F))
+    TypeSystem.EraseFunctionAnnotation(F);
   m_pOP->RemoveFunction(F);
 }
 
@@ -1037,19 +1075,24 @@ bool DxilModule::StripRootSignatureFromMetadata() {
 }
 
 DxilSubobjects *DxilModule::GetSubobjects() {
+  LoadPendingSubobjects();
   return m_pSubobjects.get();
 }
 const DxilSubobjects *DxilModule::GetSubobjects() const {
+  LoadPendingSubobjects();
   return m_pSubobjects.get();
 }
 DxilSubobjects *DxilModule::ReleaseSubobjects() {
+  LoadPendingSubobjects();
   return m_pSubobjects.release();
 }
 void DxilModule::ResetSubobjects(DxilSubobjects *subobjects) {
+  m_bSubobjectsPending = false;
   m_pSubobjects.reset(subobjects);
 }
 
 bool DxilModule::StripSubobjectsFromMetadata() {
+  LoadPendingSubobjects();
   NamedMDNode *pSubobjectsNamedMD = GetModule()->getNamedMetadata(DxilMDHelper::kDxilSubobjectsMDName);
   if (pSubobjectsNamedMD) {
     GetModule()->eraseNamedMetadata(pSubobjectsNamedMD);
@@ -1069,6 +1112,7 @@ void DxilModule::ResetSerializedRootSignature(std::vector<uint8_t> &Value) {
 }
 
 DxilTypeSystem &DxilModule::GetTypeSystem() {
+  LoadPendingTypeSystem();
   return *m_pTypeSystem;
 }
 
@@ -1080,6 +1124,7 @@ const std::vector<unsigned> &DxilModule::GetSerializedViewIdState() const {
 }
 
 void DxilModule::ResetTypeSystem(DxilTypeSystem *pValue) {
+  m_bTypeSystemPending = false;
   m_pTypeSystem.reset(pValue);
 }
 
@@ -1144,6 +1189,27 @@ vector<GlobalVariable* > &DxilModule::GetLLVMUsed() {
 }
 
 // DXIL metadata serialization/deserialization.
+unsigned DxilModule::GetMetadataSection(StringRef name) {
+  if (name == DxilMDHelper::kDxilVersionMDName ||
+      name == DxilMDHelper::kDxilValidatorVersionMDName ||
+      name == DxilMDHelper::kDxilShaderModelMDName ||
+      name == DxilMDHelper::kDxilIntermediateOptionsMDName)
+    return kMDVersions;
+  if (name == DxilMDHelper::kDxilEntryPointsMDName ||
+      name == DxilMDHelper::kDxilResourcesMDName)
+    return kMDEntryPoints;
+  if (name == DxilMDHelper::kDxilTypeSystemMDName ||
+      name.startswith(DxilMDHelper::kDxilTypeSystemHelperVariablePrefix))
+    return kMDTypeSystem;
+  if (name == DxilMDHelper::kDxilViewIdStateMDName)
+    return kMDViewIdState;
+  if (name == DxilMDHelper::kDxilSubobjectsMDName)
+    return kMDSubobjects;
+  if (name == DxilMDHelper::kDxilRootSignatureMDName)
+    return kMDRootSignature;
+  return 0;
+}
+
 void DxilModule::ClearDxilMetadata(Module &M) {
   // Delete: DXIL version, validator version, DXIL shader model,
   // entry point tuples (shader properties, signatures, resources)
@@ -1151,99 +1217,140 @@ void DxilModule::ClearDxilMetadata(Module &M) {
   // root signature, function properties.
   // Other cases for libs pending.
   // LLVM used is a global variable - handle separately.
+  if (M.HasDxilModule())
+    M.GetDxilModule().LoadPendingMetadata();
   SmallVector<NamedMDNode*, 8> nodes;
   for (NamedMDNode &b : M.named_metadata()) {
-    StringRef name = b.getName();
-    if (name == DxilMDHelper::kDxilVersionMDName ||
-      name == DxilMDHelper::kDxilValidatorVersionMDName ||
-      name == DxilMDHelper::kDxilShaderModelMDName ||
-      name == DxilMDHelper::kDxilEntryPointsMDName ||
-      name == DxilMDHelper::kDxilRootSignatureMDName ||
-      name == DxilMDHelper::kDxilIntermediateOptionsMDName ||
-      name == DxilMDHelper::kDxilResourcesMDName ||
-      name == DxilMDHelper::kDxilTypeSystemMDName ||
-      name == DxilMDHelper::kDxilViewIdStateMDName ||
-      name == DxilMDHelper::kDxilSubobjectsMDName ||
-      name.startswith(DxilMDHelper::kDxilTypeSystemHelperVariablePrefix)) {
+    if (GetMetadataSection(b.getName()) != 0)
       nodes.push_back(&b);
-    }
   }
   for (size_t i = 0; i < nodes.size(); ++i) {
     M.eraseNamedMetadata(nodes[i]);
   }
 }
 
+void DxilModule::ClearDxilMetadataSections(unsigned Sections) {
+  // Only what is about to be replaced needs decoding first.
+  if (Sections & kMDTypeSystem)
+    LoadPendingTypeSystem();
+  if (Sections & kMDSubobjects)
+    LoadPendingSubobjects();
+  SmallVector<NamedMDNode*, 8> nodes;
+  for (NamedMDNode &b : m_pModule->named_metadata()) {
+    if (GetMetadataSection(b.getName()) & Sections)
+      nodes.push_back(&b);
+  }
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    m_pModule->eraseNamedMetadata(nodes[i]);
+  }
+}
+
 void DxilModule::EmitDxilMetadata() {
-  m_pMDHelper->EmitDxilVersion(m_DxilMajor, m_DxilMinor);
-  m_pMDHelper->EmitValidatorVersion(m_ValMajor, m_ValMinor);
-  m_pMDHelper->EmitDxilShaderModel(m_pSM);
-  m_pMDHelper->EmitDxilIntermediateOptions(m_IntermediateFlags);
+  EmitDxilMetadataSections(kMDAll);
+  m_DirtyMetadata = 0;
+}
 
-  MDTuple *pMDProperties = nullptr;
-  uint64_t flag = m_ShaderFlags.GetShaderFlagsRaw();
-  if (m_pSM->IsLib()) {
-    DxilFunctionProps props;
-    props.shaderKind = DXIL::ShaderKind::Library;
-    pMDProperties = m_pMDHelper->EmitDxilEntryProperties(flag, props,
-                                                         GetAutoBindingSpace());
-  } else {
-    pMDProperties = m_pMDHelper->EmitDxilEntryProperties(
-        flag, m_DxilEntryPropsMap.begin()->second->props,
-        GetAutoBindingSpace());
+void DxilModule::MarkDxilMetadataDirty(unsigned Sections) {
+  m_DirtyMetadata |= Sections;
+}
+
+void DxilModule::EmitDirtyDxilMetadata() {
+  unsigned Sections = m_DirtyMetadata;
+  m_DirtyMetadata = 0;
+  if (Sections == 0)
+    return;
+  ClearDxilMetadataSections(Sections);
+  EmitDxilMetadataSections(Sections);
+}
+
+// Emits the given sections, in the order full emission has them.
+void DxilModule::EmitDxilMetadataSections(unsigned Sections) {
+  bool bEntryPoints = (Sections & kMDEntryPoints) != 0;
+  if (Sections & kMDVersions) {
+    m_pMDHelper->EmitDxilVersion(m_DxilMajor, m_DxilMinor);
+    m_pMDHelper->EmitValidatorVersion(m_ValMajor, m_ValMinor);
+    m_pMDHelper->EmitDxilShaderModel(m_pSM);
+    m_pMDHelper->EmitDxilIntermediateOptions(m_IntermediateFlags);
   }
 
+  MDTuple *pMDProperties = nullptr;
   MDTuple *pMDSignatures = nullptr;
-  if (!m_pSM->IsLib()) {
-    pMDSignatures = m_pMDHelper->EmitDxilSignatures(
-        m_DxilEntryPropsMap.begin()->second->sig);
+  MDTuple *pMDResources = nullptr;
+  if (bEntryPoints) {
+    uint64_t flag = m_ShaderFlags.GetShaderFlagsRaw();
+    if (m_pSM->IsLib()) {
+      DxilFunctionProps props;
+      props.shaderKind = DXIL::ShaderKind::Library;
+      pMDProperties = m_pMDHelper->EmitDxilEntryProperties(flag, props,
+                                                           GetAutoBindingSpace());
+    } else {
+      pMDProperties = m_pMDHelper->EmitDxilEntryProperties(
+          flag, m_DxilEntryPropsMap.begin()->second->props,
+          GetAutoBindingSpace());
+    }
+
+    if (!m_pSM->IsLib()) {
+      pMDSignatures = m_pMDHelper->EmitDxilSignatures(
+          m_DxilEntryPropsMap.begin()->second->sig);
+    }
+    pMDResources = EmitDxilResources();
+    if (pMDResources)
+      m_pMDHelper->EmitDxilResources(pMDResources);
   }
-  MDTuple *pMDResources = EmitDxilResources();
-  if (pMDResources)
-    m_pMDHelper->EmitDxilResources(pMDResources);
-  m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed);
-  if (!m_pSM->IsLib() && !m_pSM->IsCS() &&
+  if (Sections & kMDTypeSystem)
+    m_pMDHelper->EmitDxilTypeSystem(GetTypeSystem(), m_LLVMUsed);
+  // Hints only change with the code, which only full emission follows.
+  if (Sections == kMDAll)
+    m_pMDHelper->UniqueControlFlowHints();
+  if ((Sections & kMDViewIdState) && !m_pSM->IsLib() && !m_pSM->IsCS() &&
       ((m_ValMajor == 0 &&  m_ValMinor == 0) ||
        (m_ValMajor > 1 || (m_ValMajor == 1 && m_ValMinor >= 1)))) {
     m_pMDHelper->EmitDxilViewIdState(m_SerializedState);
   }
-  EmitLLVMUsed();
-  MDTuple *pEntry = m_pMDHelper->EmitDxilEntryPointTuple(GetEntryFunction(), m_EntryName, pMDSignatures, pMDResources, pMDProperties);
+
   vector<MDNode *> Entries;
-  Entries.emplace_back(pEntry);
+  if (bEntryPoints) {
+    EmitLLVMUsed();
+    MDTuple *pEntry = m_pMDHelper->EmitDxilEntryPointTuple(GetEntryFunction(), m_EntryName, pMDSignatures, pMDResources, pMDProperties);
+    Entries.emplace_back(pEntry);
+  }
 
   if (m_pSM->IsLib()) {
-    // Sort functions by name to keep metadata deterministic
-    vector<const Function *> funcOrder;
-    funcOrder.reserve(m_DxilEntryPropsMap.size());
-
-    std::transform( m_DxilEntryPropsMap.begin(),
-                    m_DxilEntryPropsMap.end(),
-                    std::back_inserter(funcOrder),
-                    [](const std::pair<const llvm::Function * const, std::unique_ptr<DxilEntryProps>> &p) -> const Function* { return p.first; } );
-    std::sort(funcOrder.begin(), funcOrder.end(), [](const Function *F1, const Function *F2) {
-      return F1->getName() < F2->getName();
-    });
-
-    for (auto F : funcOrder) {
-      auto &entryProps = m_DxilEntryPropsMap[F];
-      MDTuple *pProps = m_pMDHelper->EmitDxilEntryProperties(0, entryProps->props, 0);
-      MDTuple *pSig = m_pMDHelper->EmitDxilSignatures(entryProps->sig);
-
-      MDTuple *pSubEntry = m_pMDHelper->EmitDxilEntryPointTuple(
-          const_cast<Function *>(F), F->getName(), pSig, nullptr, pProps);
-
-      Entries.emplace_back(pSubEntry);
+    if (bEntryPoints) {
+      // Sort functions by name to keep metadata deterministic
+      vector<const Function *> funcOrder;
+      funcOrder.reserve(m_DxilEntryPropsMap.size());
+
+      std::transform( m_DxilEntryPropsMap.begin(),
+                      m_DxilEntryPropsMap.end(),
+                      std::back_inserter(funcOrder),
+                      [](const std::pair<const llvm::Function * const, std::unique_ptr<DxilEntryProps>> &p) -> const Function* { return p.first; } );
+      std::sort(funcOrder.begin(), funcOrder.end(), [](const Function *F1, const Function *F2) {
+        return F1->getName() < F2->getName();
+      });
+
+      for (auto F : funcOrder) {
+        auto &entryProps = m_DxilEntryPropsMap[F];
+        MDTuple *pProps = m_pMDHelper->EmitDxilEntryProperties(0, entryProps->props, 0);
+        MDTuple *pSig = m_pMDHelper->EmitDxilSignatures(entryProps->sig);
+
+        MDTuple *pSubEntry = m_pMDHelper->EmitDxilEntryPointTuple(
+            const_cast<Function *>(F), F->getName(), pSig, nullptr, pProps);
+
+        Entries.emplace_back(pSubEntry);
+      }
+      funcOrder.clear();
     }
-    funcOrder.clear();
 
     // Save Subobjects
-    if (GetSubobjects()) {
+    if ((Sections & kMDSubobjects) && GetSubobjects()) {
       m_pMDHelper->EmitSubobjects(*GetSubobjects());
     }
   }
-  m_pMDHelper->EmitDxilEntryPoints(Entries);
+  if (bEntryPoints)
+    m_pMDHelper->EmitDxilEntryPoints(Entries);
 
-  if (!m_SerializedRootSignature.empty()) {
+  if ((Sections & kMDRootSignature) && !m_SerializedRootSignature.empty()) {
     m_pMDHelper->EmitRootSignature(m_SerializedRootSignature);
   }
 }
@@ -1321,12 +1428,8 @@ void DxilModule::LoadDxilMetadata() {
       m_DxilEntryPropsMap[pFunc] = std::move(pEntryProps);
     }
 
-    // Load Subobjects
-    std::unique_ptr<DxilSubobjects> pSubobjects(new DxilSubobjects());
-    m_pMDHelper->LoadSubobjects(*pSubobjects);
-    if (pSubobjects->GetSubobjects().size()) {
-      ResetSubobjects(pSubobjects.release());
-    }
+    // Subobjects are loaded by LoadPendingSubobjects.
+    m_bSubobjectsPending = true;
   } else {
     std::unique_ptr<DxilEntryProps> pEntryProps =
         llvm::make_unique<DxilEntryProps>(entryFuncProps, m_bUseMinPrecision);
@@ -1343,13 +1446,38 @@ void DxilModule::LoadDxilMetadata() {
 
   LoadDxilResources(*pEntryResources);
 
-  m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
+  // The type system is loaded by LoadPendingTypeSystem.
+  m_bTypeSystemPending = true;
 
   m_pMDHelper->LoadRootSignature(m_SerializedRootSignature);
 
   m_pMDHelper->LoadDxilViewIdState(m_SerializedState);
 }
 
+void DxilModule::LoadPendingTypeSystem() {
+  if (!m_bTypeSystemPending)
+    return;
+  m_bTypeSystemPending = false;
+  m_pMDHelper->LoadDxilTypeSystem(*m_pTypeSystem.get());
+}
+
+void DxilModule::LoadPendingSubobjects() const {
+  if (!m_bSubobjectsPending)
+    return;
+  m_bSubobjectsPending = false;
+  std::unique_ptr<DxilSubobjects> pSubobjects(new DxilSubobjects());
+  m_pMDHelper->LoadSubobjects(*pSubobjects);
+  if (pSubobjects->GetSubobjects().size()) {
+    m_pSubobjects.reset(pSubobjects.release());
+  }
+}
+
+// Decodes what is still pending before the metadata it comes from changes.
+void DxilModule::LoadPendingMetadata() {
+  LoadPendingTypeSystem();
+  LoadPendingSubobjects();
+}
+
 MDTuple *DxilModule::EmitDxilResources() {
   // Emit SRV records.
   MDTuple *pTupleSRVs = nullptr;
@@ -1399,8 +1527,8 @@ MDTuple *DxilModule::EmitDxilResources() {
 }
 
 void DxilModule::ReEmitDxilResources() {
-  ClearDxilMetadata(*m_pModule);
-  EmitDxilMetadata();
+  MarkDxilMetadataDirty(kMDVersions | kMDEntryPoints);
+  EmitDirtyDxilMetadata();
 }
 
 void DxilModule::LoadDxilResources(const llvm::MDOperand &MDO) {
@@ -724,7 +724,8 @@ Function *OP::GetOpFunc(OpCode opCode, Type *pOverloadType) {
   OpCodeClass opClass = m_OpCodeProps[(unsigned)opCode].opCodeClass;
   Function *&F = m_OpCodeClassCache[(unsigned)opClass].pOverloads[pOverloadType];
   if (F != nullptr) {
-    UpdateCache(opClass, pOverloadType, F);
+    DXASSERT(m_FunctionToOpClass.count(F),
+             "otherwise cached function lost its opcode class mapping");
     return F;
   }
 
@@ -1078,11 +1079,14 @@ OP::GetOpFuncList(OpCode opCode) const {
 
 void OP::RemoveFunction(Function *F) {
   if (OP::IsDxilOpFunc(F)) {
-    OpCodeClass opClass = m_FunctionToOpClass[F];
+    auto iter = m_FunctionToOpClass.find(F);
+    if (iter == m_FunctionToOpClass.end())
+      return;
+    OpCodeClass opClass = iter->second;
     for (auto it : m_OpCodeClassCache[(unsigned)opClass].pOverloads) {
       if (it.second == F) {
         m_OpCodeClassCache[(unsigned)opClass].pOverloads.erase(it.first);
-        m_FunctionToOpClass.erase(F);
+        m_FunctionToOpClass.erase(iter);
         break;
       }
     }
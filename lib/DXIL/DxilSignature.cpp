@@ -86,6 +86,23 @@ const std::vector<std::unique_ptr<DxilSignatureElement> > &DxilSignature::GetEle
   return m_Elements;
 }
 
+std::vector<unsigned>
+DxilSignature::RemoveElements(const std::vector<bool> &bRemove) {
+  DXASSERT_NOMSG(bRemove.size() == m_Elements.size());
+  std::vector<unsigned> newIDs(m_Elements.size(),
+                               DxilSignatureElement::kUndefinedID);
+  std::vector<std::unique_ptr<DxilSignatureElement> > elements;
+  for (unsigned i = 0; i < m_Elements.size(); ++i) {
+    if (bRemove[i])
+      continue;
+    newIDs[i] = (unsigned)elements.size();
+    m_Elements[i]->SetID(newIDs[i]);
+    elements.emplace_back(std::move(m_Elements[i]));
+  }
+  m_Elements = std::move(elements);
+  return newIDs;
+}
+
 bool DxilSignature::ShouldBeAllocated(DXIL::SemanticInterpretationKind Kind) {
   switch (Kind) {
   case DXIL::SemanticInterpretationKind::NA:
@@ -195,10 +195,9 @@ DxilTypeSystem::GetStructAnnotation(const StructType *pStructType) const {
 }
 
 void DxilTypeSystem::EraseStructAnnotation(const StructType *pStructType) {
-  DXASSERT_NOMSG(m_StructAnnotations.count(pStructType));
-  m_StructAnnotations.remove_if([pStructType](
-      const std::pair<const StructType *, std::unique_ptr<DxilStructAnnotation>>
-          &I) { return pStructType == I.first; });
+  size_t Erased = m_StructAnnotations.erase(pStructType);
+  DXASSERT_NOMSG(Erased == 1);
+  (void)Erased;
 }
 
 DxilTypeSystem::StructAnnotationMap &DxilTypeSystem::GetStructAnnotationMap() {
@@ -234,10 +233,9 @@ DxilTypeSystem::GetFunctionAnnotation(const Function *pFunction) const {
 }
 
 void DxilTypeSystem::EraseFunctionAnnotation(const Function *pFunction) {
-  DXASSERT_NOMSG(m_FunctionAnnotations.count(pFunction));
-  m_FunctionAnnotations.remove_if([pFunction](
-      const std::pair<const Function *, std::unique_ptr<DxilFunctionAnnotation>>
-          &I) { return pFunction == I.first; });
+  size_t Erased = m_FunctionAnnotations.erase(pFunction);
+  DXASSERT_NOMSG(Erased == 1);
+  (void)Erased;
 }
 
 DxilTypeSystem::FunctionAnnotationMap &DxilTypeSystem::GetFunctionAnnotationMap() {
@@ -326,6 +326,25 @@ bool SimplifyTrivialPHIs(BasicBlock *BB) {
   return Changed;
 }
 
+bool GetBranchWeights(BranchInst *BI, uint64_t *pTrueWeight,
+                      uint64_t *pFalseWeight) {
+  if (!BI->isConditional())
+    return false;
+  MDNode *MD = BI->getMetadata(LLVMContext::MD_prof);
+  if (!MD || MD->getNumOperands() != 3)
+    return false;
+  MDString *Name = dyn_cast<MDString>(MD->getOperand(0));
+  if (!Name || !Name->getString().equals("branch_weights"))
+    return false;
+  ConstantInt *TrueWeight = mdconst::dyn_extract<ConstantInt>(MD->getOperand(1));
+  ConstantInt *FalseWeight = mdconst::dyn_extract<ConstantInt>(MD->getOperand(2));
+  if (!TrueWeight || !FalseWeight)
+    return false;
+  *pTrueWeight = TrueWeight->getZExtValue();
+  *pFalseWeight = FalseWeight->getZExtValue();
+  return true;
+}
+
 Value *SelectOnOperation(llvm::Instruction *Inst, unsigned operandIdx) {
   Instruction *prototype = Inst;
   for (unsigned i = 0; i < prototype->getNumOperands(); i++) {
@@ -0,0 +1,198 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcArenaMalloc.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides an IMalloc that serves allocations from large chunks and         //
+// releases them all at once.                                                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/DxcArenaMalloc.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace hlsl;
+
+namespace {
+// Precedes every block so Realloc and GetSize know its size. The padding keeps
+// blocks 16-byte aligned.
+struct BlockHeader {
+  size_t Size;
+  size_t Padding;
+};
+static_assert(sizeof(BlockHeader) == 16, "blocks must stay 16-byte aligned");
+
+const size_t BlockAlignment = 16;
+
+size_t AlignBlockSize(size_t cb) {
+  return (cb + BlockAlignment - 1) & ~(BlockAlignment - 1);
+}
+
+BlockHeader *HeaderOf(void *pv) { return ((BlockHeader *)pv) - 1; }
+} // namespace
+
+DxcArenaMalloc::~DxcArenaMalloc() {
+  for (size_t i = 0; i < m_chunkCount; ++i)
+    m_pMalloc->Free(m_pChunks[i].Begin);
+  m_pMalloc->Free(m_pChunks);
+}
+
+char *DxcArenaMalloc::AddChunk(size_t cb) {
+  if (m_chunkCount == m_chunkCapacity) {
+    size_t capacity = std::max((size_t)64, m_chunkCapacity * 2);
+    Chunk *pChunks =
+        (Chunk *)m_pMalloc->Realloc(m_pChunks, capacity * sizeof(Chunk));
+    if (pChunks == nullptr)
+      return nullptr;
+    m_pChunks = pChunks;
+    m_chunkCapacity = capacity;
+  }
+  // Chunks are allocated with room to align their first block.
+  char *pRaw = (char *)m_pMalloc->Alloc(cb + BlockAlignment);
+  if (pRaw == nullptr)
+    return nullptr;
+
+  Chunk chunk = {pRaw, pRaw + cb + BlockAlignment};
+  Chunk *pInsert = std::upper_bound(
+      m_pChunks, m_pChunks + m_chunkCount, chunk,
+      [](const Chunk &a, const Chunk &b) { return a.Begin < b.Begin; });
+  std::memmove(pInsert + 1, pInsert,
+               (m_pChunks + m_chunkCount - pInsert) * sizeof(Chunk));
+  *pInsert = chunk;
+  ++m_chunkCount;
+  ++m_stats.ChunkCount;
+  m_stats.ReservedBytes += cb + BlockAlignment;
+
+  uintptr_t aligned = ((uintptr_t)pRaw + BlockAlignment - 1) &
+                      ~(uintptr_t)(BlockAlignment - 1);
+  return (char *)aligned;
+}
+
+bool DxcArenaMalloc::OwnsLocked(const void *pv) const {
+  const char *p = (const char *)pv;
+  const Chunk *pBegin = m_pChunks;
+  const Chunk *pEnd = m_pChunks + m_chunkCount;
+  const Chunk *pAfter =
+      std::upper_bound(pBegin, pEnd, p, [](const char *q, const Chunk &c) {
+        return q < c.Begin;
+      });
+  if (pAfter == pBegin)
+    return false;
+  const Chunk &chunk = *(pAfter - 1);
+  return chunk.Begin <= p && p < chunk.End;
+}
+
+void *DxcArenaMalloc::AllocLocked(size_t cb) {
+  size_t blockSize = sizeof(BlockHeader) + AlignBlockSize(cb);
+  if (blockSize < cb)
+    return nullptr; // Overflow.
+
+  char *pBlock;
+  if (blockSize > ChunkSize / 4) {
+    // Big blocks get their own chunk and leave the bump range alone.
+    pBlock = AddChunk(blockSize);
+    if (pBlock == nullptr)
+      return nullptr;
+  } else {
+    if ((size_t)(m_pEnd - m_pCur) < blockSize) {
+      char *pChunk = AddChunk(ChunkSize);
+      if (pChunk == nullptr)
+        return nullptr;
+      m_pCur = pChunk;
+      m_pEnd = pChunk + ChunkSize;
+    }
+    pBlock = m_pCur;
+    m_pCur += blockSize;
+    m_pLast = pBlock;
+  }
+
+  ((BlockHeader *)pBlock)->Size = cb;
+  ++m_stats.AllocCount;
+  m_stats.AllocBytes += cb;
+  return pBlock + sizeof(BlockHeader);
+}
+
+void *DxcArenaMalloc::Alloc(SIZE_T cb) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return AllocLocked(cb);
+}
+
+void *DxcArenaMalloc::Realloc(void *pv, SIZE_T cb) {
+  if (pv == nullptr)
+    return Alloc(cb);
+  if (cb == 0) {
+    Free(pv);
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!OwnsLocked(pv))
+    return m_pMalloc->Realloc(pv, cb);
+
+  BlockHeader *pHeader = HeaderOf(pv);
+  size_t oldSize = pHeader->Size;
+  if (cb <= AlignBlockSize(oldSize)) {
+    pHeader->Size = cb;
+    return pv;
+  }
+  // The latest block can grow in place if the chunk has room.
+  if ((char *)pHeader == m_pLast) {
+    size_t blockSize = sizeof(BlockHeader) + AlignBlockSize(cb);
+    if (blockSize >= cb && (size_t)(m_pEnd - m_pLast) >= blockSize) {
+      m_pCur = m_pLast + blockSize;
+      m_stats.AllocBytes += cb - oldSize;
+      pHeader->Size = cb;
+      return pv;
+    }
+  }
+
+  void *pNew = AllocLocked(cb);
+  if (pNew == nullptr)
+    return nullptr;
+  std::memcpy(pNew, pv, oldSize);
+  ++m_stats.FreeCount;
+  return pNew;
+}
+
+void DxcArenaMalloc::Free(void *pv) {
+  if (pv == nullptr)
+    return;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!OwnsLocked(pv)) {
+    ++m_stats.ForeignFreeCount;
+    m_pMalloc->Free(pv);
+    return;
+  }
+  ++m_stats.FreeCount;
+  // Give the latest block back to the bump range.
+  if ((char *)HeaderOf(pv) == m_pLast) {
+    m_pCur = m_pLast;
+    m_pLast = nullptr;
+  }
+}
+
+#ifdef _WIN32
+SIZE_T DxcArenaMalloc::GetSize(void *pv) {
+  if (pv == nullptr)
+    return (SIZE_T)-1;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!OwnsLocked(pv))
+    return m_pMalloc->GetSize(pv);
+  return HeaderOf(pv)->Size;
+}
+
+int DxcArenaMalloc::DidAlloc(void *pv) {
+  if (pv == nullptr)
+    return -1;
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return OwnsLocked(pv) ? 1 : 0;
+}
+#endif
+
+DxcArenaMallocStats DxcArenaMalloc::GetStats() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
@@ -0,0 +1,40 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcJson.cpp                                                               //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides helpers for the JSON reports written by the compiler and tools.  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/DxcJson.h"
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+namespace hlsl {
+
+void WriteJsonString(raw_ostream &OS, StringRef Value) {
+  OS << '"';
+  for (char c : Value) {
+    switch (c) {
+    case '"':  OS << "\\\""; break;
+    case '\\': OS << "\\\\"; break;
+    case '\n': OS << "\\n"; break;
+    case '\r': OS << "\\r"; break;
+    case '\t': OS << "\\t"; break;
+    default:
+      if ((unsigned char)c < 0x20)
+        OS << format("\\u%04x", (unsigned)(unsigned char)c);
+      else
+        OS << c;
+    }
+  }
+  OS << '"';
+}
+
+} // namespace hlsl
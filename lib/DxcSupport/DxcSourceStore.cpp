@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcSourceStore.cpp                                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a content-addressed store for the sources that debug info would  //
+// otherwise embed, so that debug containers can share them.                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/WinFunctions.h"
+#include "dxc/Support/DxcSourceStore.h"
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Path.h"
+
+using namespace llvm;
+
+namespace hlsl {
+
+const char kSourceStoreReferencePrefix[] = "dxc-source-store:";
+
+// Hex MD5 digests are 32 characters.
+static const size_t kSourceStoreHashLength = 32;
+
+static std::wstring GetSourceStorePath(StringRef StoreDir, StringRef Hash) {
+  SmallString<256> Path(StoreDir);
+  sys::path::append(Path, Hash);
+  return Unicode::UTF8ToUTF16StringOrThrow(Path.c_str());
+}
+
+std::string GetSourceStoreHash(StringRef Content) {
+  MD5 Hasher;
+  Hasher.update(Content);
+  MD5::MD5Result Digest;
+  Hasher.final(Digest);
+  SmallString<32> Text;
+  MD5::stringifyResult(Digest, Text);
+  return Text.str();
+}
+
+std::string GetSourceStoreReference(StringRef Content) {
+  return std::string(kSourceStoreReferencePrefix) + GetSourceStoreHash(Content);
+}
+
+bool IsSourceStoreReference(StringRef Content, StringRef *pHash) {
+  if (!Content.startswith(kSourceStoreReferencePrefix))
+    return false;
+  StringRef Hash = Content.substr(strlen(kSourceStoreReferencePrefix));
+  if (Hash.size() != kSourceStoreHashLength ||
+      Hash.find_first_not_of("0123456789abcdef") != StringRef::npos)
+    return false;
+  if (pHash)
+    *pHash = Hash;
+  return true;
+}
+
+bool AddToSourceStore(StringRef StoreDir, StringRef Content) {
+  try {
+    std::wstring Path = GetSourceStorePath(StoreDir, GetSourceStoreHash(Content));
+    // Creating the file exclusively keeps concurrent compiles from
+    // interleaving their writes; whichever loses finds the content stored.
+    HANDLE hFile = CreateFileW(Path.c_str(), GENERIC_WRITE, 0, nullptr,
+                               CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+      HANDLE hExisting =
+          CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+      if (hExisting == INVALID_HANDLE_VALUE)
+        return false;
+      CloseHandle(hExisting);
+      return true;
+    }
+    CHandle h(hFile);
+    DWORD BytesWritten;
+    return WriteFile(hFile, Content.data(), (DWORD)Content.size(),
+                     &BytesWritten, nullptr) &&
+           BytesWritten == Content.size();
+  } catch (...) {
+    return false;
+  }
+}
+
+bool ReadFromSourceStore(StringRef StoreDir, StringRef Hash,
+                         std::string &Content) {
+  try {
+    std::wstring Path = GetSourceStorePath(StoreDir, Hash);
+    CDxcMallocHeapPtr<char> pData(GetGlobalHeapMalloc());
+    DWORD DataSize = 0;
+    ReadBinaryFile(GetGlobalHeapMalloc(), Path.c_str(), (void **)&pData.m_pData,
+                   &DataSize);
+    StringRef Data(pData.m_pData, DataSize);
+    if (GetSourceStoreHash(Data) != Hash)
+      return false;
+    Content = Data.str();
+    return true;
+  } catch (...) {
+    return false;
+  }
+}
+
+} // namespace hlsl
@@ -22,6 +22,8 @@
 
 #ifdef _WIN32
 #include <intsafe.h>
+#else
+#include <sys/mman.h>
 #endif
 
 #define CP_UTF16 1200
@@ -381,6 +383,73 @@ DxcCreateBlobOnHeapCopy(_In_bytecount_(size) LPCVOID pData, UINT32 size,
   return S_OK;
 }
 
+class MappedFileBlob : public IDxcBlob {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  LPVOID m_pView = nullptr;
+  SIZE_T m_Size = 0;
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(MappedFileBlob)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcBlob>(this, iid, ppvObject);
+  }
+
+  ~MappedFileBlob() {
+    if (m_pView == nullptr)
+      return;
+#ifdef _WIN32
+    UnmapViewOfFile(m_pView);
+#else
+    munmap(m_pView, m_Size);
+#endif
+  }
+
+  HRESULT Map(LPCWSTR pFileName) {
+    HANDLE hFile = CreateFileW(pFileName, GENERIC_READ, FILE_SHARE_READ, NULL,
+                               OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+      return HRESULT_FROM_WIN32(GetLastError());
+    CHandle h(hFile);
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(hFile, &FileSize))
+      return HRESULT_FROM_WIN32(GetLastError());
+    if (FileSize.u.HighPart != 0)
+      return DXC_E_INPUT_FILE_TOO_LARGE;
+    // Empty files can't be mapped, and have nothing to map.
+    if (FileSize.u.LowPart == 0)
+      return S_OK;
+
+#ifdef _WIN32
+    HANDLE hMapping =
+        CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (hMapping == nullptr)
+      return HRESULT_FROM_WIN32(GetLastError());
+    // The view keeps the mapping object alive.
+    CHandle m(hMapping);
+    m_pView = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if (m_pView == nullptr)
+      return HRESULT_FROM_WIN32(GetLastError());
+#else
+    void *pView = mmap(nullptr, FileSize.u.LowPart, PROT_READ, MAP_PRIVATE,
+                       (int)(size_t)hFile, 0);
+    if (pView == MAP_FAILED)
+      return E_FAIL;
+    m_pView = pView;
+#endif
+    m_Size = FileSize.u.LowPart;
+    return S_OK;
+  }
+
+  virtual LPVOID STDMETHODCALLTYPE GetBufferPointer(void) override {
+    return m_pView;
+  }
+  virtual SIZE_T STDMETHODCALLTYPE GetBufferSize(void) override {
+    return m_Size;
+  }
+};
+
 _Use_decl_annotations_
 HRESULT
 DxcCreateBlobFromFile(IMalloc *pMalloc, LPCWSTR pFileName, UINT32 *pCodePage,
@@ -392,6 +461,10 @@ DxcCreateBlobFromFile(IMalloc *pMalloc, LPCWSTR pFileName, UINT32 *pCodePage,
   LPVOID pData;
   DWORD dataSize;
   *ppBlobEncoding = nullptr;
+
+  // The file is read rather than mapped: callers pass arbitrary paths that
+  // other processes may rewrite or truncate while the blob is alive, and a
+  // truncated mapping faults on access instead of failing here.
   try {
     ReadBinaryFile(pMalloc, pFileName, &pData, &dataSize);
   }
@@ -420,6 +493,21 @@ HRESULT DxcCreateBlobFromFile(LPCWSTR pFileName, UINT32 *pCodePage,
   return DxcCreateBlobFromFile(pMalloc, pFileName, pCodePage, ppBlobEncoding);
 }
 
+_Use_decl_annotations_
+HRESULT DxcCreateBlobFromMappedFile(LPCWSTR pFileName,
+                                    IDxcBlob **ppResult) throw() {
+  if (pFileName == nullptr || ppResult == nullptr) {
+    return E_POINTER;
+  }
+  *ppResult = nullptr;
+
+  CComPtr<MappedFileBlob> blob = MappedFileBlob::Alloc(DxcGetThreadMallocNoRef());
+  IFROOM(blob.p);
+  IFR(blob->Map(pFileName));
+  *ppResult = blob.Detach();
+  return S_OK;
+}
+
 _Use_decl_annotations_
 HRESULT
 DxcCreateBlobWithEncodingSet(IMalloc *pMalloc, IDxcBlob *pBlob, UINT32 codePage,
@@ -1107,6 +1195,27 @@ HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, _COM_Outptr_ AbstractMemoryStr
   return (*ppResult == nullptr) ? E_OUTOFMEMORY : S_OK;
 }
 
+HRESULT CreateMemoryStream(_In_ IMalloc *pMalloc, ULONG sizeHint, _COM_Outptr_ AbstractMemoryStream** ppResult) throw() {
+  if (pMalloc == nullptr || ppResult == nullptr) {
+    return E_POINTER;
+  }
+
+  CComPtr<MemoryStream> stream = MemoryStream::Alloc(pMalloc);
+  if (stream.p == nullptr) {
+    *ppResult = nullptr;
+    return E_OUTOFMEMORY;
+  }
+  if (sizeHint != 0) {
+    HRESULT hr = stream->Reserve(sizeHint);
+    if (FAILED(hr)) {
+      *ppResult = nullptr;
+      return hr;
+    }
+  }
+  *ppResult = stream.Detach();
+  return S_OK;
+}
+
 HRESULT CreateReadOnlyBlobStream(_In_ IDxcBlob *pSource, _COM_Outptr_ IStream** ppResult) throw() {
   if (pSource == nullptr || ppResult == nullptr) {
     return E_POINTER;
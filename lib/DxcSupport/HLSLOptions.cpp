@@ -321,6 +321,12 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     }
   }
 
+  // Command lines are read later, one compile at a time.
+  opts.Server = Args.hasFlag(OPT_server, OPT_INVALID, false);
+  if (opts.Server) {
+    return 0;
+  }
+
   // Add macros from the command line.
 
   for (const Arg *A : Args.filtered(OPT_D)) {
@@ -346,6 +352,9 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     if (Args.getLastArg(OPT_entrypoint)) {
       errors << "cannot specify entry point for a library";
       return 1;
+    } else if (Args.getLastArg(OPT_pipeline_stage)) {
+      errors << "cannot specify a pipeline stage for a library";
+      return 1;
     } else {
       // Set entry point to impossible name.
       opts.EntryPoint = "lib.no::entry";
@@ -406,10 +415,14 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   // OutputLibrary not supported (Fl)
   opts.AssemblyCode = Args.getLastArgValue(OPT_Fc);
   opts.DebugFile = Args.getLastArgValue(OPT_Fd);
+  opts.StreamDebugFile = Args.getLastArgValue(OPT_Qstream_debug);
+  opts.SourceStoreDir = Args.getLastArgValue(OPT_Qsource_store);
   opts.ExtractPrivateFile = Args.getLastArgValue(OPT_getprivate);
   opts.Enable16BitTypes = Args.hasFlag(OPT_enable_16bit_types, OPT_INVALID, false);
   opts.OutputObject = Args.getLastArgValue(OPT_Fo);
   opts.OutputHeader = Args.getLastArgValue(OPT_Fh);
+  opts.OutputPressureReport = Args.getLastArgValue(OPT_Fre);
+  opts.PressureReportModels = Args.getAllArgValues(OPT_Fre_model);
   opts.OutputWarningsFile = Args.getLastArgValue(OPT_Fe);
   opts.UseColor = Args.hasFlag(OPT_Cc, OPT_INVALID);
   opts.UseInstructionNumbers = Args.hasFlag(OPT_Ni, OPT_INVALID);
@@ -419,6 +432,9 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.AstDump = Args.hasFlag(OPT_ast_dump, OPT_INVALID, false);
   opts.CodeGenHighLevel = Args.hasFlag(OPT_fcgl, OPT_INVALID, false);
   opts.DebugInfo = Args.hasFlag(OPT__SLASH_Zi, OPT_INVALID, false);
+  opts.DebugInfoLinesOnly = Args.hasFlag(OPT_Zi_lines, OPT_INVALID, false);
+  // Line tables are debug info for everything else, such as the debug part.
+  opts.DebugInfo |= opts.DebugInfoLinesOnly;
   opts.DebugNameForBinary = Args.hasFlag(OPT_Zsb, OPT_INVALID, false);
   opts.DebugNameForSource = Args.hasFlag(OPT_Zss, OPT_INVALID, false);
   opts.VariableName = Args.getLastArgValue(OPT_Vn);
@@ -461,6 +477,68 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   }
 
   opts.Exports = Args.getAllArgValues(OPT_exports);
+  opts.LateBindConsts = Args.getAllArgValues(OPT_late_bind_const);
+  opts.PipelineStage = Args.getLastArgValue(OPT_pipeline_stage);
+
+  opts.CacheDir = Args.getLastArgValue(OPT_cache_dir);
+  opts.TimeReport = Args.hasFlag(OPT_ftime_report, OPT_INVALID, false);
+  opts.TimeTraceFile = Args.getLastArgValue(OPT_ftime_trace);
+  opts.ArenaMalloc = Args.hasFlag(OPT_arena_malloc, OPT_INVALID, false);
+  opts.ReuseContext = Args.hasFlag(OPT_reuse_context, OPT_INVALID, false);
+
+  llvm::StringRef maxMemory = Args.getLastArgValue(OPT_max_memory);
+  if (!maxMemory.empty()) {
+    if (maxMemory.getAsInteger(10, opts.MaxMemoryMB) || opts.MaxMemoryMB == 0) {
+      errors << "Unsupported value '" << maxMemory << "' for max memory.";
+      return 1;
+    }
+  }
+
+  llvm::StringRef packSearch = Args.getLastArgValue(OPT_pipeline_pack_search);
+  if (!packSearch.empty()) {
+    if (packSearch.getAsInteger(10, opts.PipelinePackSearch) ||
+        opts.PipelinePackSearch == 0) {
+      errors << "Unsupported value '" << packSearch
+             << "' for pipeline pack search.";
+      return 1;
+    }
+    if (opts.PipelineStage.empty()) {
+      errors << "-pipeline-pack-search requires -pipeline-stage";
+      return 1;
+    }
+  }
+
+  llvm::StringRef libShards = Args.getLastArgValue(OPT_lib_shards);
+  if (!libShards.empty()) {
+    if (libShards.getAsInteger(10, opts.LibShards) || opts.LibShards == 0 ||
+        opts.LibShards > 64) {
+      errors << "Unsupported value '" << libShards << "' for lib shards.";
+      return 1;
+    }
+  }
+  llvm::StringRef libShardIndex = Args.getLastArgValue(OPT_lib_shard_index);
+  if (!libShardIndex.empty()) {
+    if (libShardIndex.getAsInteger(10, opts.LibShardIndex) ||
+        opts.LibShardIndex >= opts.LibShards) {
+      errors << "Unsupported value '" << libShardIndex << "' for lib shard index.";
+      return 1;
+    }
+  }
+
+  llvm::StringRef libNoInlineSize = Args.getLastArgValue(OPT_lib_noinline_size);
+  if (!libNoInlineSize.empty()) {
+    if (libNoInlineSize.getAsInteger(10, opts.LibNoInlineSize) ||
+        opts.LibNoInlineSize == 0) {
+      errors << "Unsupported value '" << libNoInlineSize
+             << "' for lib noinline size.";
+      return 1;
+    }
+  }
+
+  opts.ScanDependencies = Args.hasFlag(OPT_M, OPT_INVALID, false);
+  opts.WriteDependencies = Args.hasFlag(OPT_MD, OPT_INVALID, false);
+  opts.DependencyTarget = Args.getLastArgValue(OPT_MT);
+  opts.DependencyFile = Args.getLastArgValue(OPT_MF);
 
   opts.DefaultLinkage = Args.getLastArgValue(OPT_default_linkage);
   if (!opts.DefaultLinkage.empty()) {
@@ -499,7 +577,9 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   }
 
   opts.DisableOptimizations = false;
-  if (Arg *A = Args.getLastArg(OPT_O0, OPT_O1, OPT_O2, OPT_O3, OPT_Od)) {
+  opts.FastIteration = false;
+  if (Arg *A = Args.getLastArg(OPT_O0, OPT_O1, OPT_O2, OPT_O3, OPT_Od,
+                               OPT_Ofast_iteration)) {
     if (A->getOption().matches(OPT_O0))
       opts.OptLevel = 0;
     if (A->getOption().matches(OPT_O1))
@@ -512,11 +592,37 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
       opts.DisableOptimizations = true;
       opts.OptLevel = 0;
     }
+    if (A->getOption().matches(OPT_Ofast_iteration)) {
+      opts.FastIteration = true;
+      opts.OptLevel = 1;
+    }
   }
   else
     opts.OptLevel = 3;
   opts.OptDump = Args.hasFlag(OPT_Odump, OPT_INVALID, false);
 
+  // Shards are linked back together, which only applies to code-generated
+  // libraries with every function exported under its own name.
+  if (opts.LibNoInlineSize && !opts.IsLibraryProfile()) {
+    errors << "library profile required when using -lib-noinline-size option";
+    return 1;
+  }
+
+  if (opts.LibShards > 1) {
+    if (!opts.IsLibraryProfile()) {
+      errors << "library profile required when using -lib-shards option";
+      return 1;
+    }
+    if (!opts.Exports.empty()) {
+      errors << "Cannot specify -exports with -lib-shards.";
+      return 1;
+    }
+    if (opts.CodeGenHighLevel || opts.AstDump || opts.OptDump) {
+      errors << "Cannot produce -fcgl, -ast-dump or -Odump output with -lib-shards.";
+      return 1;
+    }
+  }
+
   opts.DisableValidation = Args.hasFlag(OPT_VD, OPT_INVALID, false);
 
   opts.AllResourcesBound = Args.hasFlag(OPT_all_resources_bound, OPT_INVALID, false);
@@ -536,6 +642,8 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.StripRootSignature = Args.hasFlag(OPT_Qstrip_rootsignature, OPT_INVALID, false);
   opts.StripPrivate = Args.hasFlag(OPT_Qstrip_priv, OPT_INVALID, false);
   opts.StripReflection = Args.hasFlag(OPT_Qstrip_reflect, OPT_INVALID, false);
+  opts.CompressParts = Args.hasFlag(OPT_Qcompress_parts, OPT_INVALID, false);
+  opts.CompactParts = Args.hasFlag(OPT_Qcompact_parts, OPT_INVALID, false);
   opts.ExtractRootSignature = Args.hasFlag(OPT_extractrootsignature, OPT_INVALID, false);
   opts.DisassembleColorCoded = Args.hasFlag(OPT_Cc, OPT_INVALID, false);
   opts.DisassembleInstNumbers = Args.hasFlag(OPT_Ni, OPT_INVALID, false);
@@ -545,6 +653,28 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   opts.LegacyResourceReservation = Args.hasFlag(OPT_flegacy_resource_reservation, OPT_INVALID, false);
   opts.ExportShadersOnly = Args.hasFlag(OPT_export_shaders_only, OPT_INVALID, false);
   opts.ResMayAlias = Args.hasFlag(OPT_res_may_alias, OPT_INVALID, false);
+  opts.InferNonUniformIndex = Args.hasFlag(OPT_infer_nonuniform_index, OPT_INVALID, false);
+  opts.FastTrig = Args.hasFlag(OPT_ffast_trig, OPT_INVALID, false);
+  opts.DemoteOutputPrecision = Args.hasFlag(OPT_demote_output_precision, OPT_INVALID, false);
+  opts.AutoControlFlowHints = Args.hasFlag(OPT_auto_control_flow_hints, OPT_INVALID, false);
+  opts.GroupSharedBankConflicts = Args.hasFlag(OPT_groupshared_bank_conflicts, OPT_INVALID, false);
+  opts.PadGroupShared = Args.hasFlag(OPT_pad_groupshared, OPT_INVALID, false);
+  opts.InferEarlyDepthStencil = Args.hasFlag(OPT_infer_early_depth_stencil, OPT_INVALID, false);
+  opts.WarnEarlyDepthStencil = Args.hasFlag(OPT_warn_early_depth_stencil, OPT_INVALID, false);
+  opts.ReorderCBuffers = Args.hasFlag(OPT_reorder_cbuffers, OPT_INVALID, false);
+  opts.RecommendRootConstants = Args.hasFlag(OPT_recommend_root_constants, OPT_INVALID, false);
+  opts.MergeIdenticalFunctions = Args.hasFlag(OPT_merge_identical_functions, OPT_INVALID, false);
+  opts.PositionOnly = Args.hasFlag(OPT_position_only, OPT_INVALID, false);
+  opts.EliminateRedundantBarriers = Args.hasFlag(OPT_eliminate_redundant_barriers, OPT_INVALID, false);
+  opts.WaveAggregateAtomics = Args.hasFlag(OPT_wave_aggregate_atomics, OPT_INVALID, false);
+  opts.Pair16BitOps = Args.hasFlag(OPT_pair_16bit_ops, OPT_INVALID, false);
+  opts.ClusterFetches = Args.hasFlag(OPT_cluster_fetches, OPT_INVALID, false);
+  opts.StrengthReduceBufferIndices = Args.hasFlag(OPT_strength_reduce_buffer_indices, OPT_INVALID, false);
+  opts.UnswitchUniformLoops = Args.hasFlag(OPT_unswitch_uniform_loops, OPT_INVALID, false);
+  opts.GatherTexelLoads = Args.hasFlag(OPT_gather_texel_loads, OPT_INVALID, false);
+  opts.PassOptions = Args.getAllArgValues(OPT_pass_option);
+  opts.ProfileUse = Args.getLastArgValue(OPT_fprofile_use);
+  opts.StripUnusedBeforeCodegen = Args.hasFlag(OPT_strip_unused_before_codegen, OPT_INVALID, false);
 
   if (opts.DefaultColMajor && opts.DefaultRowMajor) {
     errors << "Cannot specify /Zpr and /Zpc together, use /? to get usage information";
@@ -554,6 +684,35 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     errors << "Cannot specify /Gfa and /Gfp together, use /? to get usage information";
     return 1;
   }
+  for (const std::string &PassOption : opts.PassOptions) {
+    StringRef Pass, List;
+    std::tie(Pass, List) = StringRef(PassOption).split(',');
+    if (Pass.empty() || List.empty() || !List.contains('=')) {
+      errors << "/pass-option expects <pass>,<option>=<value>[,...], not '"
+             << PassOption << "'";
+      return 1;
+    }
+  }
+  if (!opts.PressureReportModels.empty() && opts.OutputPressureReport.empty()) {
+    errors << "/Fre-model requires /Fre";
+    return 1;
+  }
+  if (!opts.ProfileUse.empty() && !opts.DebugInfo) {
+    errors << "/fprofile-use requires /Zi, since profiles are matched to the source by line";
+    return 1;
+  }
+  if (opts.StripUnusedBeforeCodegen && opts.IsLibraryProfile()) {
+    errors << "/strip-unused-before-codegen requires a single entry point and can't be used with library targets";
+    return 1;
+  }
+  if (opts.PositionOnly && !opts.TargetProfile.startswith("vs_")) {
+    errors << "/position-only requires a vertex shader target";
+    return 1;
+  }
+  if (opts.Pair16BitOps && !opts.Enable16BitTypes) {
+    errors << "/pair-16bit-ops requires /enable-16bit-types";
+    return 1;
+  }
   if (opts.PackPrefixStable && opts.PackOptimized) {
     errors << "Cannot specify /pack_prefix_stable and /pack_optimized together, use /? to get usage information";
     return 1;
@@ -585,6 +744,17 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     return 1;
   }
 
+  if (opts.ScanDependencies &&
+      (opts.WriteDependencies || !opts.Preprocess.empty())) {
+    errors << "Cannot specify -M with -MD or -P.";
+    return 1;
+  }
+  if (opts.WriteDependencies && opts.DependencyFile.empty() &&
+      opts.OutputObject.empty()) {
+    errors << "Cannot specify -MD without -MF or -Fo.";
+    return 1;
+  }
+
   if (opts.DumpBin) {
     if (opts.DisplayIncludeProcess || opts.AstDump) {
       errors << "Cannot perform actions related to sources from a binary file.";
@@ -602,13 +772,31 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
   }
 
   if ((flagsToInclude & hlsl::options::DriverOption) &&
-      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.RecompileFromBinary) {
+      opts.TargetProfile.empty() && !opts.DumpBin && opts.Preprocess.empty() && !opts.ScanDependencies &&
+      !opts.RecompileFromBinary) {
     // Target profile is required in arguments only for drivers when compiling;
     // APIs take this through an argument.
     errors << "Target profile argument is missing";
     return 1;
   }
 
+  if (!opts.StreamDebugFile.empty()) {
+    if (!opts.DebugInfo) {
+      errors << "/Qstream_debug requires /Zi.";
+      return 1;
+    }
+    if (!opts.DebugFile.empty()) {
+      errors << "Cannot specify both /Qstream_debug and /Fd";
+      return 1;
+    }
+    opts.StripDebug = true;
+  }
+
+  if (!opts.SourceStoreDir.empty() && !opts.DebugInfo) {
+    errors << "/Qsource_store requires /Zi.";
+    return 1;
+  }
+
   if (!opts.DebugNameForBinary && !opts.DebugNameForSource) {
     opts.DebugNameForSource = true;
   }
@@ -634,6 +822,11 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     // SPIRV Change Starts
 #ifdef ENABLE_SPIRV_CODEGEN
   opts.GenSPIRV = Args.hasFlag(OPT_spirv, OPT_INVALID, false);
+  opts.OutputSpirvFile = Args.getLastArgValue(OPT_Fspv);
+  if (opts.GenSPIRV && !opts.OutputSpirvFile.empty()) {
+    errors << "-Fspv should not be used together with -spirv";
+    return 1;
+  }
   opts.SpirvOptions.invertY = Args.hasFlag(OPT_fvk_invert_y, OPT_INVALID, false);
   opts.SpirvOptions.invertW = Args.hasFlag(OPT_fvk_use_dx_position_w, OPT_INVALID, false);
   opts.SpirvOptions.useGlLayout = Args.hasFlag(OPT_fvk_use_gl_layout, OPT_INVALID, false);
@@ -650,6 +843,19 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
     return 1;
 
   opts.SpirvOptions.bindRegister = Args.getAllArgValues(OPT_fvk_bind_register);
+
+  // Handle -fvk-spec-constant <name> <spec-id> option.
+  {
+    const auto values = Args.getAllArgValues(OPT_fvk_spec_constant);
+    for (size_t i = 0; i + 1 < values.size(); i += 2) {
+      uint32_t specId = 0;
+      if (llvm::StringRef(values[i + 1]).getAsInteger(10, specId)) {
+        errors << "invalid -fvk-spec-constant SpecId: " << values[i + 1];
+        return 1;
+      }
+      opts.SpirvOptions.specConstants.emplace_back(values[i], specId);
+    }
+  }
   opts.SpirvOptions.stageIoOrder = Args.getLastArgValue(OPT_fvk_stage_io_order_EQ, "decl");
   if (opts.SpirvOptions.stageIoOrder != "alpha" && opts.SpirvOptions.stageIoOrder != "decl") {
     errors << "unknown Vulkan stage I/O location assignment order: "
@@ -699,7 +905,7 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
       errors << "-Oconfig should not be specified more than once";
       return 1;
     }
-    if (Args.getLastArg(OPT_O0, OPT_O1, OPT_O2, OPT_O3)) {
+    if (Args.getLastArg(OPT_O0, OPT_O1, OPT_O2, OPT_O3, OPT_Ofast_iteration)) {
       errors << "-Oconfig should not be used together with -O";
       return 1;
     }
@@ -718,12 +924,14 @@ int ReadDxcOpts(const OptTable *optionTable, unsigned flagsToInclude,
       Args.hasFlag(OPT_fspv_reflect, OPT_INVALID, false) ||
       Args.hasFlag(OPT_Wno_vk_ignored_features, OPT_INVALID, false) ||
       Args.hasFlag(OPT_Wno_vk_emulated_features, OPT_INVALID, false) ||
+      !Args.getLastArgValue(OPT_Fspv).empty() ||
       !Args.getLastArgValue(OPT_fvk_stage_io_order_EQ).empty() ||
       !Args.getLastArgValue(OPT_fspv_debug_EQ).empty() ||
       !Args.getLastArgValue(OPT_fspv_extension_EQ).empty() ||
       !Args.getLastArgValue(OPT_fspv_target_env_EQ).empty() ||
       !Args.getLastArgValue(OPT_Oconfig).empty() ||
       !Args.getLastArgValue(OPT_fvk_bind_register).empty() ||
+      !Args.getLastArgValue(OPT_fvk_spec_constant).empty() ||
       !Args.getLastArgValue(OPT_fvk_b_shift).empty() ||
       !Args.getLastArgValue(OPT_fvk_t_shift).empty() ||
       !Args.getLastArgValue(OPT_fvk_s_shift).empty() ||
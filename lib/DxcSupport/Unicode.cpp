@@ -13,6 +13,11 @@
 #include <specstrings.h>
 #else
 #include <clocale>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 #endif
 #include <string>
 #include "dxc/Support/Global.h"
@@ -20,6 +25,120 @@
 #include "dxc/Support/WinIncludes.h"
 
 #ifndef _WIN32
+// Both code pages the conversions below support, UTF-8 and ISO-8859-1, map
+// ASCII to the same code points, so the leading ASCII run of a string is
+// converted here directly, 16 characters at a time where vectors are
+// available. Only what follows it goes through the C locale functions, which
+// switch the process locale on every call. Each helper stops at the first
+// non-ASCII character or null, and gives back how many it converted. A null
+// destination only counts.
+static const size_t kASCIIBlock = 16;
+
+static size_t ConvertASCIIPrefix(const char *src, size_t count, wchar_t *dst) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + kASCIIBlock <= count; i += kASCIIBlock) {
+    __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+    // The sign bits flag non-ASCII bytes; a compare with zero flags nulls.
+    if (_mm_movemask_epi8(_mm_or_si128(bytes, _mm_cmpeq_epi8(bytes, zero))))
+      break;
+    if (dst == nullptr || sizeof(wchar_t) != 4)
+      continue;
+    __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+    __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  for (; i + kASCIIBlock <= count; i += kASCIIBlock) {
+    uint8x16_t bytes = vld1q_u8((const uint8_t *)(src + i));
+    // Non-ASCII bytes are above 0x7F; subtracting one wraps nulls there too.
+    if (vmaxvq_u8(vsubq_u8(bytes, vdupq_n_u8(1))) >= 0x7F)
+      break;
+    if (dst == nullptr || sizeof(wchar_t) != 4)
+      continue;
+    uint16x8_t lo = vmovl_u8(vget_low_u8(bytes));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(bytes));
+    vst1q_u32((uint32_t *)(dst + i), vmovl_u16(vget_low_u16(lo)));
+    vst1q_u32((uint32_t *)(dst + i + 4), vmovl_u16(vget_high_u16(lo)));
+    vst1q_u32((uint32_t *)(dst + i + 8), vmovl_u16(vget_low_u16(hi)));
+    vst1q_u32((uint32_t *)(dst + i + 12), vmovl_u16(vget_high_u16(hi)));
+  }
+#endif
+  if (dst != nullptr && sizeof(wchar_t) != 4) {
+    for (size_t j = 0; j < i; ++j)
+      dst[j] = (wchar_t)src[j];
+  }
+  for (; i < count; ++i) {
+    unsigned char c = (unsigned char)src[i];
+    if (c == 0 || c >= 0x80)
+      break;
+    if (dst != nullptr)
+      dst[i] = (wchar_t)c;
+  }
+  return i;
+}
+
+static size_t ConvertASCIIPrefix(const wchar_t *src, size_t count, char *dst) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  if (sizeof(wchar_t) == 4) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i nonASCII = _mm_set1_epi32(~0x7F);
+    for (; i + kASCIIBlock <= count; i += kASCIIBlock) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+      __m128i c = _mm_loadu_si128((const __m128i *)(src + i + 8));
+      __m128i d = _mm_loadu_si128((const __m128i *)(src + i + 12));
+      __m128i high = _mm_and_si128(
+          _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)), nonASCII);
+      __m128i nulls = _mm_or_si128(
+          _mm_or_si128(_mm_cmpeq_epi32(a, zero), _mm_cmpeq_epi32(b, zero)),
+          _mm_or_si128(_mm_cmpeq_epi32(c, zero), _mm_cmpeq_epi32(d, zero)));
+      if (_mm_movemask_epi8(nulls) != 0 ||
+          _mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xFFFF)
+        break;
+      if (dst == nullptr)
+        continue;
+      // Every lane fits in seven bits, so the saturating packs are exact.
+      __m128i words = _mm_packs_epi32(a, b);
+      __m128i words2 = _mm_packs_epi32(c, d);
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(words, words2));
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  if (sizeof(wchar_t) == 4) {
+    for (; i + kASCIIBlock <= count; i += kASCIIBlock) {
+      const uint32_t *p = (const uint32_t *)(src + i);
+      uint32x4_t a = vld1q_u32(p), b = vld1q_u32(p + 4);
+      uint32x4_t c = vld1q_u32(p + 8), d = vld1q_u32(p + 12);
+      // Non-ASCII characters are above 0x7F; subtracting one wraps nulls too.
+      uint32x4_t one = vdupq_n_u32(1);
+      uint32x4_t m = vmaxq_u32(vmaxq_u32(vsubq_u32(a, one), vsubq_u32(b, one)),
+                               vmaxq_u32(vsubq_u32(c, one), vsubq_u32(d, one)));
+      if (vmaxvq_u32(m) >= 0x7F)
+        break;
+      if (dst == nullptr)
+        continue;
+      uint16x8_t lo = vcombine_u16(vmovn_u32(a), vmovn_u32(b));
+      uint16x8_t hi = vcombine_u16(vmovn_u32(c), vmovn_u32(d));
+      vst1q_u8((uint8_t *)(dst + i), vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+  }
+#endif
+  for (; i < count; ++i) {
+    wchar_t c = src[i];
+    if (c == 0 || (unsigned)c >= 0x80)
+      break;
+    if (dst != nullptr)
+      dst[i] = (char)c;
+  }
+  return i;
+}
+
 // MultiByteToWideChar which is a Windows-specific method.
 // This is a very simplistic implementation for non-Windows platforms. This
 // implementation completely ignores CodePage and dwFlags.
@@ -50,6 +169,24 @@ int MultiByteToWideChar(uint32_t CodePage, uint32_t /*dwFlags*/,
     return 0;
   }
 
+  // Only the part after the leading ASCII run needs the locale. A null ends
+  // the conversion, and is counted, as it does with mbstowcs.
+  size_t prefix =
+      ConvertASCIIPrefix(lpMultiByteStr, cbMultiByte, lpWideCharStr);
+  if (prefix == (size_t)cbMultiByte)
+    return cbMultiByte;
+  if (lpMultiByteStr[prefix] == '\0') {
+    if (lpWideCharStr != nullptr)
+      lpWideCharStr[prefix] = L'\0';
+    return prefix + 1;
+  }
+  lpMultiByteStr += prefix;
+  cbMultiByte -= prefix;
+  if (lpWideCharStr != nullptr) {
+    lpWideCharStr += prefix;
+    cchWideChar -= prefix;
+  }
+
   size_t rv;
   const char *locale = CPToLocale(CodePage);
   locale = setlocale(LC_ALL, locale);
@@ -63,8 +200,9 @@ int MultiByteToWideChar(uint32_t CodePage, uint32_t /*dwFlags*/,
     rv = mbstowcs(lpWideCharStr, lpMultiByteStr, cchWideChar);
   }
   setlocale(LC_ALL, locale);
-  if (rv == (size_t)cbMultiByte) return rv;
-  return rv + 1; // mbstowcs excludes the terminating character
+  if (rv == (size_t)-1) return 0;
+  if (rv == (size_t)cbMultiByte) return prefix + rv;
+  return prefix + rv + 1; // mbstowcs excludes the terminating character
 }
 
 // WideCharToMultiByte is a Windows-specific method.
@@ -99,6 +237,23 @@ int WideCharToMultiByte(uint32_t CodePage, uint32_t /*dwFlags*/,
     return 0;
   }
 
+  // As above, only what follows the leading ASCII run needs the locale.
+  size_t prefix =
+      ConvertASCIIPrefix(lpWideCharStr, cchWideChar, lpMultiByteStr);
+  if (prefix == (size_t)cchWideChar)
+    return cchWideChar;
+  if (lpWideCharStr[prefix] == L'\0') {
+    if (lpMultiByteStr != nullptr)
+      lpMultiByteStr[prefix] = '\0';
+    return prefix + 1;
+  }
+  lpWideCharStr += prefix;
+  cchWideChar -= prefix;
+  if (lpMultiByteStr != nullptr) {
+    lpMultiByteStr += prefix;
+    cbMultiByte -= prefix;
+  }
+
   size_t rv;
   const char *locale = CPToLocale(CodePage);
   locale = setlocale(LC_ALL, locale);
@@ -112,8 +267,9 @@ int WideCharToMultiByte(uint32_t CodePage, uint32_t /*dwFlags*/,
     rv = wcstombs(lpMultiByteStr, lpWideCharStr, cbMultiByte);
   }
   setlocale(LC_ALL, locale);
-  if (rv == (size_t)cchWideChar) return rv;
-  return rv + 1; // mbstowcs excludes the terminating character
+  if (rv == (size_t)-1) return 0;
+  if (rv == (size_t)cchWideChar) return prefix + rv;
+  return prefix + rv + 1; // mbstowcs excludes the terminating character
 }
 #endif // _WIN32
 
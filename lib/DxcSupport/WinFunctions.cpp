@@ -181,6 +181,8 @@ HANDLE CreateFileW(_In_ LPCWSTR lpFileName, _In_ DWORD dwDesiredAccess,
       flags |= O_RDWR;
     else
       flags |= O_WRONLY;
+  else if (dwDesiredAccess & FILE_APPEND_DATA)
+    flags |= (O_WRONLY | O_APPEND);
   else // dwDesiredAccess may be 0, but open() demands something here. This is mostly harmless
     flags |= O_RDONLY;
 
@@ -253,6 +255,21 @@ BOOL WriteFile(_In_ HANDLE hFile, _In_ LPCVOID lpBuffer,
   return true;
 }
 
+BOOL SetFilePointerEx(_In_ HANDLE hFile, _In_ LARGE_INTEGER liDistanceToMove,
+                      _Out_opt_ PLARGE_INTEGER lpNewFilePointer,
+                      _In_ DWORD dwMoveMethod) {
+  int fd = (size_t)hFile;
+  int whence = dwMoveMethod == FILE_END
+                   ? SEEK_END
+                   : dwMoveMethod == FILE_CURRENT ? SEEK_CUR : SEEK_SET;
+  off_t rv = lseek(fd, (off_t)liDistanceToMove.QuadPart, whence);
+  if (rv < 0)
+    return false;
+  if (lpNewFilePointer)
+    lpNewFilePointer->QuadPart = (LONGLONG)rv;
+  return true;
+}
+
 BOOL CloseHandle(_In_ HANDLE hObject) {
   int fd = (size_t)hObject;
   return !close(fd);
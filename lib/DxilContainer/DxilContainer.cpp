@@ -10,7 +10,16 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compression.h"
+#include "llvm/Support/xxhash.h"
 #include <algorithm>
+#include <vector>
 
 namespace hlsl {
 
@@ -122,4 +131,228 @@ DxilProgramHeader *GetDxilProgramHeader(DxilContainerHeader *pHeader, DxilFourCC
       GetDxilProgramHeader(static_cast<const DxilContainerHeader *>(pHeader), fourCC));
 }
 
+bool HasCompressedDxilParts(const DxilContainerHeader *pHeader) {
+  return std::any_of(begin(pHeader), end(pHeader),
+                     DxilPartIsType(DFCC_CompressedPart));
+}
+
+namespace {
+// A part as it is written to a compressed or decompressed container.
+struct ContainerPart {
+  uint32_t FourCC;
+  const char *pData;
+  uint32_t Size;
+  // Compressed parts are written with their header, from their own storage.
+  bool bCompressed = false;
+  DxilCompressedPartHeader CompressedHeader;
+  llvm::SmallVector<char, 0> Storage;
+};
+}
+
+bool HasContiguousDxilParts(const DxilContainerHeader *pHeader) {
+  const uint32_t *pPartOffsetTable =
+      reinterpret_cast<const uint32_t *>(pHeader + 1);
+  size_t offset =
+      sizeof(DxilContainerHeader) + GetOffsetTableSize(pHeader->PartCount);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    if (pPartOffsetTable[i] != offset)
+      return false;
+    offset += sizeof(DxilPartHeader) + GetDxilContainerPart(pHeader, i)->PartSize;
+  }
+  return offset == pHeader->ContainerSizeInBytes;
+}
+
+// Writes the parts after a header that keeps the hash and version of the
+// original container.
+static void WriteContainerParts(const DxilContainerHeader *pOriginal,
+                                llvm::ArrayRef<ContainerPart> Parts,
+                                AbstractMemoryStream *pStream) {
+  uint32_t partCount = (uint32_t)Parts.size();
+  uint64_t partsSize = 0;
+  for (const ContainerPart &Part : Parts)
+    partsSize += Part.Size;
+  uint64_t containerSize = partsSize + sizeof(DxilContainerHeader) +
+                           GetOffsetTableSize(partCount) +
+                           sizeof(DxilPartHeader) * (uint64_t)partCount;
+  IFTBOOL(containerSize <= DxilContainerMaxSize, DXC_E_CONTAINER_INVALID);
+
+  DxilContainerHeader header;
+  InitDxilContainer(&header, partCount, (uint32_t)containerSize);
+  header.Hash = pOriginal->Hash;
+  header.Version = pOriginal->Version;
+  IFT(WriteStreamValue(pStream, header));
+
+  uint32_t offset =
+      sizeof(DxilContainerHeader) + (uint32_t)GetOffsetTableSize(partCount);
+  for (const ContainerPart &Part : Parts) {
+    IFT(WriteStreamValue(pStream, offset));
+    offset += sizeof(DxilPartHeader) + Part.Size;
+  }
+
+  ULONG cbWritten;
+  for (const ContainerPart &Part : Parts) {
+    DxilPartHeader partHeader;
+    partHeader.PartFourCC = Part.FourCC;
+    partHeader.PartSize = Part.Size;
+    IFT(WriteStreamValue(pStream, partHeader));
+    if (Part.bCompressed) {
+      IFT(WriteStreamValue(pStream, Part.CompressedHeader));
+      IFT(pStream->Write(Part.Storage.data(), Part.Storage.size(), &cbWritten));
+      const char Pad[4] = {};
+      uint32_t padding =
+          Part.Size - sizeof(DxilCompressedPartHeader) - Part.Storage.size();
+      IFT(pStream->Write(Pad, padding, &cbWritten));
+    } else {
+      IFT(pStream->Write(Part.pData, Part.Size, &cbWritten));
+    }
+  }
+}
+
+void CompressDxilContainer(const DxilContainerHeader *pHeader,
+                           AbstractMemoryStream *pStream) {
+  DXASSERT_NOMSG(IsValidDxilContainer(pHeader, pHeader->ContainerSizeInBytes));
+  std::vector<ContainerPart> Parts(pHeader->PartCount);
+  bool bCanCompress = llvm::zlib::isAvailable() && HasContiguousDxilParts(pHeader);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+    ContainerPart &Part = Parts[i];
+    Part.FourCC = pPart->PartFourCC;
+    Part.pData = GetDxilPartData(pPart);
+    Part.Size = pPart->PartSize;
+    if (!bCanCompress || (pPart->PartFourCC != DFCC_DXIL &&
+                          pPart->PartFourCC != DFCC_ShaderDebugInfoDXIL))
+      continue;
+
+    if (llvm::zlib::compress(llvm::StringRef(Part.pData, Part.Size),
+                             Part.Storage, llvm::zlib::BestSizeCompression) !=
+        llvm::zlib::StatusOK)
+      continue;
+    uint32_t compressedSize = (uint32_t)Part.Storage.size();
+    uint32_t partSize = sizeof(DxilCompressedPartHeader) +
+                        ((compressedSize + 3) & ~3u);
+    if (partSize >= pPart->PartSize) {
+      Part.Storage.clear();
+      continue;
+    }
+    Part.FourCC = DFCC_CompressedPart;
+    Part.Size = partSize;
+    Part.bCompressed = true;
+    Part.CompressedHeader.PartFourCC = pPart->PartFourCC;
+    Part.CompressedHeader.Compression = (uint32_t)DxilPartCompression::Zlib;
+    Part.CompressedHeader.UncompressedSize = pPart->PartSize;
+    Part.CompressedHeader.CompressedSize = compressedSize;
+  }
+
+  if (!bCanCompress) {
+    ULONG cbWritten;
+    IFT(pStream->Write(pHeader, pHeader->ContainerSizeInBytes, &cbWritten));
+    return;
+  }
+  WriteContainerParts(pHeader, Parts, pStream);
+}
+
+// Restores the data of a compressed part into Part.
+static HRESULT DecompressPart(const DxilPartHeader *pPart,
+                              ContainerPart &Part) {
+  if (pPart->PartSize < sizeof(DxilCompressedPartHeader))
+    return DXC_E_CONTAINER_INVALID;
+  const DxilCompressedPartHeader *pCompressed =
+      reinterpret_cast<const DxilCompressedPartHeader *>(Part.pData);
+  if (pCompressed->Compression != (uint32_t)DxilPartCompression::Zlib ||
+      pCompressed->CompressedSize >
+          pPart->PartSize - sizeof(DxilCompressedPartHeader) ||
+      pCompressed->UncompressedSize > DxilContainerMaxSize)
+    return DXC_E_CONTAINER_INVALID;
+  llvm::StringRef CompressedData((const char *)(pCompressed + 1),
+                                 pCompressed->CompressedSize);
+  switch (llvm::zlib::uncompress(CompressedData, Part.Storage,
+                                 pCompressed->UncompressedSize)) {
+  case llvm::zlib::StatusOK:
+    break;
+  case llvm::zlib::StatusUnsupported:
+    return E_NOTIMPL;
+  case llvm::zlib::StatusOutOfMemory:
+    return E_OUTOFMEMORY;
+  default:
+    return DXC_E_CONTAINER_INVALID;
+  }
+  if (Part.Storage.size() != pCompressed->UncompressedSize)
+    return DXC_E_CONTAINER_INVALID;
+  Part.FourCC = pCompressed->PartFourCC;
+  Part.pData = Part.Storage.data();
+  Part.Size = pCompressed->UncompressedSize;
+  return S_OK;
+}
+
+HRESULT DecompressDxilContainer(const DxilContainerHeader *pHeader,
+                                AbstractMemoryStream *pStream) {
+  DXASSERT_NOMSG(IsValidDxilContainer(pHeader, pHeader->ContainerSizeInBytes));
+  std::vector<ContainerPart> Parts(pHeader->PartCount);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+    ContainerPart &Part = Parts[i];
+    Part.FourCC = pPart->PartFourCC;
+    Part.pData = GetDxilPartData(pPart);
+    Part.Size = pPart->PartSize;
+    if (pPart->PartFourCC != DFCC_CompressedPart)
+      continue;
+
+    HRESULT hr = DecompressPart(pPart, Part);
+    if (FAILED(hr))
+      return hr;
+  }
+  WriteContainerParts(pHeader, Parts, pStream);
+  return S_OK;
+}
+
+// Parts that decide what the code does.
+static bool IsSemanticPart(uint32_t FourCC) {
+  switch (FourCC) {
+  case DFCC_DXIL:
+  case DFCC_InputSignature:
+  case DFCC_OutputSignature:
+  case DFCC_PatchConstantSignature:
+  case DFCC_FeatureInfo:
+  case DFCC_PipelineStateValidation:
+  case DFCC_RootSignature:
+  case DFCC_RuntimeData:
+    return true;
+  default:
+    return false;
+  }
+}
+
+HRESULT GetDxilContainerSemanticHash(const DxilContainerHeader *pHeader,
+                                     uint64_t *pHash) {
+  DXASSERT_NOMSG(IsValidDxilContainer(pHeader, pHeader->ContainerSizeInBytes));
+  // Each part is hashed where it is, then the fourCCs and hashes of the
+  // parts are, sorted so that the order of the parts doesn't matter.
+  llvm::SmallVector<std::pair<uint64_t, uint64_t>, 8> PartHashes;
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    const DxilPartHeader *pPart = GetDxilContainerPart(pHeader, i);
+    ContainerPart Part;
+    Part.FourCC = pPart->PartFourCC;
+    Part.pData = GetDxilPartData(pPart);
+    Part.Size = pPart->PartSize;
+    if (pPart->PartFourCC == DFCC_CompressedPart) {
+      HRESULT hr = DecompressPart(pPart, Part);
+      if (FAILED(hr))
+        return hr;
+    }
+    if (IsSemanticPart(Part.FourCC))
+      PartHashes.push_back(std::make_pair(
+          (uint64_t)Part.FourCC,
+          llvm::xxHash64(llvm::StringRef(Part.pData, Part.Size))));
+  }
+  std::sort(PartHashes.begin(), PartHashes.end());
+  llvm::SmallVector<uint64_t, 16> Combined;
+  for (const std::pair<uint64_t, uint64_t> &PartHash : PartHashes) {
+    Combined.push_back(PartHash.first);
+    Combined.push_back(PartHash.second);
+  }
+  *pHash = llvm::xxHash64(llvm::StringRef((const char *)Combined.data(),
+                                          Combined.size() * sizeof(uint64_t)));
+  return S_OK;
+}
+
 } // namespace hlsl
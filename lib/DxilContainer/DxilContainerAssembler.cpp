@@ -13,6 +13,10 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/MD5.h"
 #include "llvm/ADT/STLExtras.h"
@@ -31,8 +35,10 @@
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/DxilContainer/DxilPipelineStateValidation.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
+#include "dxc/DxilContainer/DxilShaderStatistics.h"
 #include <algorithm>
 #include <functional>
+#include <map>
 
 using namespace llvm;
 using namespace hlsl;
@@ -361,6 +367,70 @@ DxilPartWriter *hlsl::NewFeatureInfoWriter(const DxilModule &M) {
   return new DxilFeatureInfoWriter(M);
 }
 
+// Pool of null-terminated strings for the string table of a part, where
+// offset 0 is the empty string. Equal strings share an offset. With suffix
+// merging, a string that ends one already in the pool points into it.
+class DxilStringPool {
+private:
+  SmallVector<char, 256> m_Buffer;
+  StringMap<uint32_t> m_Offsets;
+  // A string is a suffix of another exactly when its reversal is a prefix of
+  // the other's reversal, so reversed strings are kept sorted, each with the
+  // offset of its terminator.
+  std::map<std::string, uint32_t> m_ReversedEnds;
+  bool m_bMergeSuffixes;
+
+  bool FindSuffix(StringRef Str, uint32_t &Offset) const {
+    std::string Reversed(Str.str());
+    std::reverse(Reversed.begin(), Reversed.end());
+    auto it = m_ReversedEnds.lower_bound(Reversed);
+    if (it == m_ReversedEnds.end() ||
+        it->first.compare(0, Reversed.size(), Reversed) != 0)
+      return false;
+    Offset = it->second - (uint32_t)Str.size();
+    return true;
+  }
+
+public:
+  DxilStringPool() : m_bMergeSuffixes(false) { m_Buffer.push_back('\0'); }
+  void SetMergeSuffixes(bool bMerge) { m_bMergeSuffixes = bMerge; }
+
+  // returns the offset of the string inserted
+  uint32_t Insert(StringRef Str) {
+    if (Str.empty())
+      return 0;
+    auto found = m_Offsets.find(Str);
+    if (found != m_Offsets.end())
+      return found->second;
+
+    uint32_t Offset;
+    if (m_bMergeSuffixes && FindSuffix(Str, Offset)) {
+      m_Offsets[Str] = Offset;
+      return Offset;
+    }
+    Offset = (uint32_t)m_Buffer.size();
+    m_Offsets[Str] = Offset;
+    m_Buffer.append(Str.begin(), Str.end());
+    m_Buffer.push_back('\0');
+    if (m_bMergeSuffixes) {
+      std::string Reversed(Str.str());
+      std::reverse(Reversed.begin(), Reversed.end());
+      m_ReversedEnds[Reversed] = Offset + (uint32_t)Str.size();
+    }
+    return Offset;
+  }
+  // Appends the string even if the pool has it already.
+  uint32_t Append(StringRef Str) {
+    uint32_t Offset = (uint32_t)m_Buffer.size();
+    m_Buffer.append(Str.begin(), Str.end());
+    m_Buffer.push_back('\0');
+    return Offset;
+  }
+  const char *Get(uint32_t Offset) const { return m_Buffer.data() + Offset; }
+  const char *data() const { return m_Buffer.data(); }
+  uint32_t size() const { return (uint32_t)m_Buffer.size(); }
+};
+
 class DxilPSVWriter : public DxilPartWriter  {
 private:
   const DxilModule &m_Module;
@@ -368,7 +438,8 @@ private:
   DxilPipelineStateValidation m_PSV;
   uint32_t m_PSVBufferSize;
   SmallVector<char, 512> m_PSVBuffer;
-  SmallVector<char, 256> m_StringBuffer;
+  DxilStringPool m_StringBuffer;
+  bool m_bCompactStrings;
   SmallVector<uint32_t, 8> m_SemanticIndexBuffer;
   std::vector<PSVSignatureElement0> m_SigInputElements;
   std::vector<PSVSignatureElement0> m_SigOutputElements;
@@ -377,10 +448,9 @@ private:
   void SetPSVSigElement(PSVSignatureElement0 &E, const DxilSignatureElement &SE) {
     memset(&E, 0, sizeof(PSVSignatureElement0));
     if (SE.GetKind() == DXIL::SemanticKind::Arbitrary && strlen(SE.GetName()) > 0) {
-      E.SemanticName = (uint32_t)m_StringBuffer.size();
       StringRef Name(SE.GetName());
-      m_StringBuffer.append(Name.size()+1, '\0');
-      memcpy(m_StringBuffer.data() + E.SemanticName, Name.data(), Name.size());
+      E.SemanticName = m_bCompactStrings ? m_StringBuffer.Insert(Name)
+                                         : m_StringBuffer.Append(Name);
     } else {
       // m_StringBuffer always starts with '\0' so offset 0 is empty string:
       E.SemanticName = 0;
@@ -443,7 +513,8 @@ private:
   }
 
 public:
-  DxilPSVWriter(const DxilModule &module, uint32_t PSVVersion = 0)
+  DxilPSVWriter(const DxilModule &module, uint32_t PSVVersion = 0,
+                bool bCompactStrings = true)
   : m_Module(module),
     m_PSVInitInfo(PSVVersion)
   {
@@ -452,6 +523,9 @@ public:
     // Allow PSVVersion to be upgraded
     if (m_PSVInitInfo.PSVVersion < 1 && (ValMajor > 1 || (ValMajor == 1 && ValMinor >= 1)))
       m_PSVInitInfo.PSVVersion = 1;
+    // Released validators expect each semantic name written out again.
+    m_bCompactStrings = bCompactStrings;
+    m_StringBuffer.SetMergeSuffixes(m_bCompactStrings);
 
     const ShaderModel *SM = m_Module.GetShaderModel();
     UINT uCBuffers = m_Module.GetCBuffers().size();
@@ -463,7 +537,6 @@ public:
     if (m_PSVInitInfo.PSVVersion > 0) {
       m_PSVInitInfo.ShaderStage = (PSVShaderKind)SM->GetKind();
       // Copy Dxil Signatures
-      m_StringBuffer.push_back('\0'); // For empty semantic name (system value)
       m_PSVInitInfo.SigInputElements = m_Module.GetInputSignature().GetElements().size();
       m_SigInputElements.resize(m_PSVInitInfo.SigInputElements);
       m_PSVInitInfo.SigOutputElements = m_Module.GetOutputSignature().GetElements().size();
@@ -842,6 +915,8 @@ public:
       return 0;
     return sizeof(RuntimeDataTableHeader) + m_rows.size() * sizeof(T);
   }
+
+  const std::vector<T> &GetRows() const { return m_rows; }
 };
 
 // Resource table will contain a list of RuntimeDataResourceInfo in order of
@@ -858,30 +933,15 @@ public:
 
 class StringBufferPart : public RDATPart {
 private:
-  StringMap<uint32_t> m_StringMap;
-  SmallVector<char, 256> m_StringBuffer;
+  // Empty/null strings have offset of zero
+  DxilStringPool m_StringBuffer;
 public:
-  StringBufferPart() : m_StringMap(), m_StringBuffer() {
-    // Always start string table with null so empty/null strings have offset of zero
-    m_StringBuffer.push_back('\0');
-  }
+  StringBufferPart() : m_StringBuffer() {}
+  void SetMergeSuffixes(bool bMerge) { m_StringBuffer.SetMergeSuffixes(bMerge); }
   // returns the offset of the name inserted
-  uint32_t Insert(StringRef name) {
-    if (name.empty())
-      return 0;
-
-    // Don't add duplicate strings
-    auto found = m_StringMap.find(name);
-    if (found != m_StringMap.end())
-      return found->second;
-
-    uint32_t prevIndex = (uint32_t)m_StringBuffer.size();
-    m_StringMap[name] = prevIndex;
-    m_StringBuffer.reserve(m_StringBuffer.size() + name.size() + 1);
-    m_StringBuffer.append(name.begin(), name.end());
-    m_StringBuffer.push_back('\0');
-    return prevIndex;
-  }
+  uint32_t Insert(StringRef name) { return m_StringBuffer.Insert(name); }
+  // returns the string inserted at an offset
+  const char *Get(uint32_t offset) const { return m_StringBuffer.Get(offset); }
   RuntimeDataPartType GetType() const { return RuntimeDataPartType::StringBuffer; }
   uint32_t GetPartSize() const { return m_StringBuffer.size(); }
   void Write(void *ptr) { memcpy(ptr, m_StringBuffer.data(), m_StringBuffer.size()); }
@@ -967,6 +1027,42 @@ public:
   RuntimeDataPartType GetType() const { return RuntimeDataPartType::SubobjectTable; }
 };
 
+// Name index part holds, for each indexed table, the rows of the table sorted
+// by name so that readers can binary search them.
+class NameIndexPart : public RDATPart {
+private:
+  std::vector<uint32_t> m_IndexBuffer;
+public:
+  NameIndexPart() : m_IndexBuffer() {}
+  // getName returns the name of the row at an index
+  template <typename GetNameFn>
+  void AddIndex(RuntimeDataNameIndexKind kind, uint32_t rowCount,
+                GetNameFn getName) {
+    if (rowCount == 0)
+      return;
+    std::vector<uint32_t> rows(rowCount);
+    for (uint32_t i = 0; i < rowCount; ++i)
+      rows[i] = i;
+    // Stable, so that a lookup of a shared name finds the first row.
+    std::stable_sort(rows.begin(), rows.end(),
+                     [&getName](uint32_t left, uint32_t right) {
+                       return strcmp(getName(left), getName(right)) < 0;
+                     });
+    m_IndexBuffer.push_back((uint32_t)kind);
+    m_IndexBuffer.push_back(rowCount);
+    m_IndexBuffer.insert(m_IndexBuffer.end(), rows.begin(), rows.end());
+  }
+
+  RuntimeDataPartType GetType() const { return RuntimeDataPartType::NameIndex; }
+  uint32_t GetPartSize() const {
+    return sizeof(uint32_t) * m_IndexBuffer.size();
+  }
+
+  void Write(void *ptr) {
+    memcpy(ptr, m_IndexBuffer.data(), m_IndexBuffer.size() * sizeof(uint32_t));
+  }
+};
+
 using namespace DXIL;
 
 class DxilRDATWriter : public DxilPartWriter {
@@ -1149,7 +1245,7 @@ private:
           }
           shaderKind = (uint32_t)props.shaderKind;
         }
-        ShaderFlags flags = ShaderFlags::CollectShaderFlags(&function, &m_Module);
+        ShaderFlags flags = m_Module.GetFunctionShaderFlags(&function);
         RuntimeDataFunctionInfo info = {};
         info.Name = mangledIndex;
         info.UnmangledName = unmangledIndex;
@@ -1258,6 +1354,25 @@ private:
     }
   }
 
+  void UpdateNameIndex() {
+    const StringBufferPart &strings = *m_pStringBufferPart;
+    const auto &resources = m_pResourceTable->GetRows();
+    m_pNameIndexPart->AddIndex(
+        RuntimeDataNameIndexKind::ResourceName, resources.size(),
+        [&](uint32_t i) { return strings.Get(resources[i].Name); });
+    const auto &functions = m_pFunctionTable->GetRows();
+    m_pNameIndexPart->AddIndex(
+        RuntimeDataNameIndexKind::FunctionName, functions.size(),
+        [&](uint32_t i) { return strings.Get(functions[i].Name); });
+    m_pNameIndexPart->AddIndex(
+        RuntimeDataNameIndexKind::FunctionUnmangledName, functions.size(),
+        [&](uint32_t i) { return strings.Get(functions[i].UnmangledName); });
+    const auto &subobjects = m_pSubobjectTable->GetRows();
+    m_pNameIndexPart->AddIndex(
+        RuntimeDataNameIndexKind::SubobjectName, subobjects.size(),
+        [&](uint32_t i) { return strings.Get(subobjects[i].Name); });
+  }
+
   void CreateParts() {
 #define ADD_PART(type) \
     m_Parts.emplace_back(llvm::make_unique<type>()); \
@@ -1268,6 +1383,7 @@ private:
     ADD_PART(IndexArraysPart);
     ADD_PART(RawBytesPart);
     ADD_PART(SubobjectTable);
+    ADD_PART(NameIndexPart);
 #undef ADD_PART
   }
 
@@ -1277,14 +1393,21 @@ private:
   FunctionTable *m_pFunctionTable;
   ResourceTable *m_pResourceTable;
   SubobjectTable *m_pSubobjectTable;
+  NameIndexPart *m_pNameIndexPart;
 
 public:
   DxilRDATWriter(const DxilModule &module, uint32_t InfoVersion = 0)
       : m_Module(module), m_RDATBuffer(), m_Parts(), m_FuncToResNameOffset() {
     CreateParts();
+    // Like name indices, merged suffixes are new in info version 1.
+    m_pStringBufferPart->SetMergeSuffixes(InfoVersion >= 1);
     UpdateResourceInfo();
     UpdateFunctionInfo();
     UpdateSubobjectInfo();
+    // Name indices are new in info version 1; older validators would find
+    // the RDAT part doesn't match.
+    if (InfoVersion >= 1)
+      UpdateNameIndex();
 
     // Delete any empty parts:
     std::vector<std::unique_ptr<RDATPart>>::iterator it = m_Parts.begin();
@@ -1338,14 +1461,346 @@ public:
   }
 };
 
-DxilPartWriter *hlsl::NewPSVWriter(const DxilModule &M, uint32_t PSVVersion) {
-  return new DxilPSVWriter(M, PSVVersion);
+DxilPartWriter *hlsl::NewPSVWriter(const DxilModule &M, uint32_t PSVVersion,
+                                   bool bCompactStrings) {
+  return new DxilPSVWriter(M, PSVVersion, bCompactStrings);
 }
 
 DxilPartWriter *hlsl::NewRDATWriter(const DxilModule &M, uint32_t InfoVersion) {
   return new DxilRDATWriter(M, InfoVersion);
 }
 
+class DxilShaderStatisticsWriter : public DxilPartWriter {
+private:
+  DxilShaderStatisticsHeader m_Header;
+  std::vector<DxilShaderStatisticsEntry> m_Entries;
+  std::vector<DxilShaderStatisticsOpCount> m_OpCounts;
+  DxilStringPool m_Strings;
+
+  static void CollectCallees(const Function *F,
+                             SetVector<const Function *> &Functions) {
+    if (F == nullptr || F->isDeclaration() || !Functions.insert(F))
+      return;
+    for (const BasicBlock &BB : *F)
+      for (const Instruction &I : BB)
+        if (const CallInst *CI = dyn_cast<CallInst>(&I))
+          CollectCallees(CI->getCalledFunction(), Functions);
+  }
+
+  static const GlobalVariable *GetGroupSharedGlobal(const Value *V) {
+    while (const ConstantExpr *CE = dyn_cast<ConstantExpr>(V))
+      V = CE->getOperand(0);
+    const GlobalVariable *GV = dyn_cast<GlobalVariable>(V);
+    if (GV && GV->getType()->getPointerAddressSpace() ==
+                  DXIL::kTGSMAddrSpace)
+      return GV;
+    return nullptr;
+  }
+
+  static bool IsArrayAccess(const Value *Ptr) {
+    const GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr);
+    if (GEP == nullptr)
+      return false;
+    for (gep_type_iterator it = gep_type_begin(GEP), E = gep_type_end(GEP);
+         it != E; ++it) {
+      if (isa<ArrayType>(*it) && !isa<ConstantInt>(it.getOperand()))
+        return true;
+    }
+    return false;
+  }
+
+  static void CountOperation(DXIL::OpCode Op, const CallInst *CI,
+                             DxilShaderStatisticsEntry &E) {
+    switch (Op) {
+    case DXIL::OpCode::Sample:
+    case DXIL::OpCode::SampleLevel:
+    case DXIL::OpCode::TextureGather:
+      ++E.TextureNormalInstructions;
+      return;
+    case DXIL::OpCode::SampleBias:
+      ++E.TextureBiasInstructions;
+      return;
+    case DXIL::OpCode::SampleGrad:
+      ++E.TextureGradientInstructions;
+      return;
+    case DXIL::OpCode::SampleCmp:
+    case DXIL::OpCode::SampleCmpLevelZero:
+    case DXIL::OpCode::TextureGatherCmp:
+      ++E.TextureCompInstructions;
+      return;
+    case DXIL::OpCode::TextureLoad:
+    case DXIL::OpCode::BufferLoad:
+    case DXIL::OpCode::RawBufferLoad:
+      ++E.TextureLoadInstructions;
+      return;
+    case DXIL::OpCode::TextureStore:
+    case DXIL::OpCode::BufferStore:
+    case DXIL::OpCode::RawBufferStore:
+      ++E.TextureStoreInstructions;
+      return;
+    case DXIL::OpCode::AtomicBinOp:
+    case DXIL::OpCode::AtomicCompareExchange:
+    case DXIL::OpCode::BufferUpdateCounter:
+      ++E.InterlockedInstructions;
+      return;
+    case DXIL::OpCode::Barrier:
+      ++E.BarrierInstructions;
+      return;
+    case DXIL::OpCode::EmitStream:
+      ++E.EmitInstructionCount;
+      return;
+    case DXIL::OpCode::CutStream:
+      ++E.CutInstructionCount;
+      return;
+    case DXIL::OpCode::EmitThenCutStream:
+      ++E.EmitInstructionCount;
+      ++E.CutInstructionCount;
+      return;
+    case DXIL::OpCode::UMax:
+    case DXIL::OpCode::UMin:
+    case DXIL::OpCode::UMul:
+    case DXIL::OpCode::UDiv:
+    case DXIL::OpCode::UAddc:
+    case DXIL::OpCode::USubb:
+    case DXIL::OpCode::UMad:
+    case DXIL::OpCode::Ubfe:
+    case DXIL::OpCode::Dot4AddU8Packed:
+      ++E.UintInstructionCount;
+      return;
+    default:
+      break;
+    }
+    switch (OP::GetOpCodeClass(Op)) {
+    case DXIL::OpCodeClass::Unary:
+    case DXIL::OpCodeClass::Binary:
+    case DXIL::OpCodeClass::BinaryWithTwoOuts:
+    case DXIL::OpCodeClass::Tertiary:
+    case DXIL::OpCodeClass::Quaternary:
+    case DXIL::OpCodeClass::IsSpecialFloat:
+    case DXIL::OpCodeClass::Dot2:
+    case DXIL::OpCodeClass::Dot3:
+    case DXIL::OpCodeClass::Dot4:
+    case DXIL::OpCodeClass::Dot2AddHalf:
+    case DXIL::OpCodeClass::Dot4AddPacked:
+      // The first argument after the opcode has the overload type.
+      if (CI->getNumArgOperands() > 1 &&
+          CI->getArgOperand(1)->getType()->getScalarType()->isFloatingPointTy())
+        ++E.FloatInstructionCount;
+      else
+        ++E.IntInstructionCount;
+      return;
+    case DXIL::OpCodeClass::UnaryBits:
+      ++E.BitwiseInstructionCount;
+      return;
+    case DXIL::OpCodeClass::LegacyF16ToF32:
+    case DXIL::OpCodeClass::LegacyF32ToF16:
+    case DXIL::OpCodeClass::LegacyDoubleToFloat:
+    case DXIL::OpCodeClass::LegacyDoubleToSInt32:
+    case DXIL::OpCodeClass::LegacyDoubleToUInt32:
+      ++E.ConversionInstructionCount;
+      return;
+    default:
+      return;
+    }
+  }
+
+  static void CountInstruction(const Instruction &I,
+                               DxilShaderStatisticsEntry &E,
+                               std::map<uint32_t, uint32_t> &OpCounts) {
+    switch (I.getOpcode()) {
+    case Instruction::FAdd:
+    case Instruction::FSub:
+    case Instruction::FMul:
+    case Instruction::FDiv:
+    case Instruction::FRem:
+    case Instruction::FCmp:
+      ++E.FloatInstructionCount;
+      break;
+    case Instruction::Add:
+    case Instruction::Sub:
+    case Instruction::Mul:
+    case Instruction::SDiv:
+    case Instruction::SRem:
+      ++E.IntInstructionCount;
+      break;
+    case Instruction::UDiv:
+    case Instruction::URem:
+      ++E.UintInstructionCount;
+      break;
+    case Instruction::ICmp:
+      if (cast<ICmpInst>(I).isUnsigned())
+        ++E.UintInstructionCount;
+      else
+        ++E.IntInstructionCount;
+      break;
+    case Instruction::Shl:
+    case Instruction::LShr:
+    case Instruction::AShr:
+    case Instruction::And:
+    case Instruction::Or:
+    case Instruction::Xor:
+      ++E.BitwiseInstructionCount;
+      break;
+    case Instruction::Trunc:
+    case Instruction::ZExt:
+    case Instruction::SExt:
+    case Instruction::FPTrunc:
+    case Instruction::FPExt:
+    case Instruction::FPToUI:
+    case Instruction::FPToSI:
+    case Instruction::UIToFP:
+    case Instruction::SIToFP:
+      ++E.ConversionInstructionCount;
+      break;
+    case Instruction::Select:
+      ++E.MovcInstructionCount;
+      break;
+    case Instruction::Br:
+      if (cast<BranchInst>(I).isConditional())
+        ++E.DynamicFlowControlCount;
+      else
+        ++E.StaticFlowControlCount;
+      break;
+    case Instruction::Switch:
+      ++E.DynamicFlowControlCount;
+      break;
+    case Instruction::Load:
+      if (IsArrayAccess(cast<LoadInst>(I).getPointerOperand()))
+        ++E.ArrayInstructionCount;
+      break;
+    case Instruction::Store:
+      if (IsArrayAccess(cast<StoreInst>(I).getPointerOperand()))
+        ++E.ArrayInstructionCount;
+      break;
+    case Instruction::AtomicRMW:
+    case Instruction::AtomicCmpXchg:
+      ++E.InterlockedInstructions;
+      break;
+    case Instruction::Call: {
+      const CallInst *CI = cast<CallInst>(&I);
+      if (OP::IsDxilOpFuncCallInst(CI)) {
+        DXIL::OpCode Op = OP::GetDxilOpFuncCallInst(CI);
+        ++OpCounts[(uint32_t)Op];
+        CountOperation(Op, CI, E);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  void AddEntry(const DxilModule &M, const Function *F,
+                const Function *PatchConstantFunc, StringRef Name) {
+    const DataLayout &DL = M.GetModule()->getDataLayout();
+    SetVector<const Function *> Functions;
+    CollectCallees(F, Functions);
+    CollectCallees(PatchConstantFunc, Functions);
+
+    DxilShaderStatisticsEntry E;
+    memset(&E, 0, sizeof(E));
+    E.Name = m_Strings.Insert(Name);
+    std::map<uint32_t, uint32_t> OpCounts;
+    SmallPtrSet<const GlobalVariable *, 8> GroupShared;
+    for (const Function *Fn : Functions) {
+      for (const BasicBlock &BB : *Fn) {
+        for (const Instruction &I : BB) {
+          if (isa<DbgInfoIntrinsic>(I))
+            continue;
+          ++E.InstructionCount;
+          CountInstruction(I, E, OpCounts);
+          if (const AllocaInst *AI = dyn_cast<AllocaInst>(&I)) {
+            if (AI->getAllocatedType()->isArrayTy()) {
+              ++E.TempArrayCount;
+              E.TempArrayBytes += (uint32_t)DL.getTypeAllocSize(AI->getAllocatedType());
+            }
+          }
+          for (const Value *Op : I.operands()) {
+            const GlobalVariable *GV = GetGroupSharedGlobal(Op);
+            if (GV && GroupShared.insert(GV).second)
+              E.GroupSharedBytes += (uint32_t)DL.getTypeAllocSize(
+                  GV->getType()->getElementType());
+          }
+        }
+      }
+    }
+    E.FirstOpCount = (uint32_t)m_OpCounts.size();
+    E.OpCountCount = (uint32_t)OpCounts.size();
+    for (auto &it : OpCounts)
+      m_OpCounts.push_back({it.first, it.second});
+    m_Entries.push_back(E);
+  }
+
+public:
+  DxilShaderStatisticsWriter(const DxilModule &M) {
+    const ShaderModel *pSM = M.GetShaderModel();
+    if (pSM->IsLib()) {
+      for (const Function &F : M.GetModule()->functions()) {
+        if (!F.isDeclaration())
+          AddEntry(M, &F, nullptr, F.getName());
+      }
+    } else if (M.GetEntryFunction()) {
+      AddEntry(M, M.GetEntryFunction(),
+               pSM->IsHS() ? M.GetPatchConstantFunction() : nullptr,
+               M.GetEntryFunctionName());
+      // Mirror what reflection reports from the module.
+      DxilShaderStatisticsEntry &E = m_Entries.back();
+      E.GSOutputTopology = (uint32_t)M.GetStreamPrimitiveTopology();
+      E.GSMaxOutputVertexCount = M.GetMaxVertexCount();
+      if (pSM->IsHS())
+        E.InputPrimitive = (uint32_t)DXIL::InputPrimitive::ControlPointPatch1 +
+                           M.GetInputControlPointCount() - 1;
+      else
+        E.InputPrimitive = (uint32_t)M.GetInputPrimitive();
+      E.GSInstanceCount = M.GetGSInstanceCount();
+      if (pSM->IsHS())
+        E.ControlPoints = M.GetOutputControlPointCount();
+      else if (pSM->IsDS())
+        E.ControlPoints = M.GetInputControlPointCount();
+      E.HSOutputPrimitive = (uint32_t)M.GetTessellatorOutputPrimitive();
+      E.HSPartitioning = (uint32_t)M.GetTessellatorPartitioning();
+      E.TessellatorDomain = (uint32_t)M.GetTessellatorDomain();
+    }
+    m_Header.Version = DxilShaderStatisticsVersion;
+    m_Header.EntrySize = sizeof(DxilShaderStatisticsEntry);
+    m_Header.EntryCount = (uint32_t)m_Entries.size();
+    m_Header.OpCountCount = (uint32_t)m_OpCounts.size();
+    m_Header.StringTableSize = m_Strings.size();
+  }
+
+  uint32_t size() const override {
+    uint32_t size = sizeof(m_Header) +
+                    m_Header.EntryCount * m_Header.EntrySize +
+                    m_Header.OpCountCount * sizeof(DxilShaderStatisticsOpCount) +
+                    m_Header.StringTableSize;
+    return PSVALIGN4(size);
+  }
+
+  void write(AbstractMemoryStream *pStream) override {
+    ULONG cbWritten;
+    IFT(WriteStreamValue(pStream, m_Header));
+    IFT(pStream->Write(m_Entries.data(),
+                       m_Header.EntryCount * m_Header.EntrySize, &cbWritten));
+    IFT(pStream->Write(m_OpCounts.data(),
+                       m_Header.OpCountCount *
+                           sizeof(DxilShaderStatisticsOpCount),
+                       &cbWritten));
+    IFT(pStream->Write(m_Strings.data(), m_Strings.size(), &cbWritten));
+    uint32_t padding = size() - (sizeof(m_Header) +
+                                 m_Header.EntryCount * m_Header.EntrySize +
+                                 m_Header.OpCountCount *
+                                     sizeof(DxilShaderStatisticsOpCount) +
+                                 m_Header.StringTableSize);
+    const uint32_t zero = 0;
+    if (padding)
+      IFT(pStream->Write(&zero, padding, &cbWritten));
+  }
+};
+
+DxilPartWriter *hlsl::NewShaderStatisticsWriter(const DxilModule &M) {
+  return new DxilShaderStatisticsWriter(M);
+}
+
 class DxilContainerWriter_impl : public DxilContainerWriter  {
 private:
   class DxilPart {
@@ -1461,10 +1916,10 @@ public:
 
 } // namespace
 
-void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
-                                           AbstractMemoryStream *pModuleBitcode,
-                                           AbstractMemoryStream *pFinalStream,
-                                           SerializeDxilFlags Flags) {
+void hlsl::SerializeDxilContainerForModule(
+    DxilModule *pModule, AbstractMemoryStream *pModuleBitcode,
+    AbstractMemoryStream *pFinalStream, SerializeDxilFlags Flags,
+    const DxilContainerHash *pDebugBitcodeHash) {
   // TODO: add a flag to update the module and remove information that is not part
   // of DXIL proper and is used only to assemble the container.
 
@@ -1524,6 +1979,7 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   }
   std::unique_ptr<DxilRDATWriter> pRDATWriter = nullptr;
   std::unique_ptr<DxilPSVWriter> pPSVWriter = nullptr;
+  std::unique_ptr<DxilShaderStatisticsWriter> pStatisticsWriter = nullptr;
   unsigned int major, minor;
   pModule->GetDxilVersion(major, minor);
   RootSignatureWriter rootSigWriter(pModule->GetSerializedRootSignature());
@@ -1533,14 +1989,19 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     DXASSERT(pModule->GetSerializedRootSignature().empty(),
              "otherwise, library has root signature outside subobject definitions");
     // Write the DxilRuntimeData (RDAT) part.
-    pRDATWriter = llvm::make_unique<DxilRDATWriter>(*pModule);
+    // Released validators don't know the name index, so it is opt-in.
+    uint32_t RDATInfoVersion =
+        (Flags & SerializeDxilFlags::CompactParts) ? 1 : 0;
+    pRDATWriter = llvm::make_unique<DxilRDATWriter>(*pModule, RDATInfoVersion);
     writer.AddPart(
         DFCC_RuntimeData, pRDATWriter->size(),
         [&](AbstractMemoryStream *pStream) { pRDATWriter->write(pStream); });
     bModuleDirty |= pModule->StripSubobjectsFromMetadata();
   } else {
     // Write the DxilPipelineStateValidation (PSV0) part.
-    pPSVWriter = llvm::make_unique<DxilPSVWriter>(*pModule);
+    pPSVWriter = llvm::make_unique<DxilPSVWriter>(
+        *pModule, /*PSVVersion*/ 0,
+        /*bCompactStrings*/ (Flags & SerializeDxilFlags::CompactParts));
     writer.AddPart(
         DFCC_PipelineStateValidation, pPSVWriter->size(),
         [&](AbstractMemoryStream *pStream) { pPSVWriter->write(pStream); });
@@ -1553,11 +2014,39 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     }
   }
 
-  // If metadata was stripped, re-serialize the module.
+  // Write the shader statistics (STAT) part.
+  if (Flags & SerializeDxilFlags::IncludeStatisticsPart) {
+    pStatisticsWriter = llvm::make_unique<DxilShaderStatisticsWriter>(*pModule);
+    writer.AddPart(
+        DFCC_ShaderStatistics, pStatisticsWriter->size(),
+        [&](AbstractMemoryStream *pStream) { pStatisticsWriter->write(pStream); });
+  }
+
+  // The module as it is now is the program part when it has no debug info.
+  // Otherwise it is only needed for the debug info part, or for a debug name
+  // that depends on the source. If the caller left pModuleBitcode empty, the
+  // module is written once here, without the metadata stripped above.
+  // Otherwise it is re-serialized only if metadata was stripped and the
+  // result is used.
+  bool bHasDebugInfo = HasDebugInfo(*pModule->GetModule());
+  bool bDebugNameDependsOnSource =
+      (Flags & SerializeDxilFlags::IncludeDebugNamePart) &&
+      (Flags & SerializeDxilFlags::DebugNameDependOnSource) &&
+      pDebugBitcodeHash == nullptr;
   CComPtr<AbstractMemoryStream> pInputProgramStream = pModuleBitcode;
-  if (bModuleDirty) {
+  if (pModuleBitcode->GetPtrSize() == 0) {
+    if (!bHasDebugInfo || (Flags & SerializeDxilFlags::IncludeDebugInfoPart) ||
+        bDebugNameDependsOnSource) {
+      raw_stream_ostream outStream(pModuleBitcode);
+      WriteBitcodeToFile(pModule->GetModule(), outStream, true);
+    }
+  } else if (bModuleDirty &&
+             (!bHasDebugInfo ||
+              (Flags & SerializeDxilFlags::IncludeDebugInfoPart))) {
     pInputProgramStream.Release();
-    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pInputProgramStream));
+    // The module was only touched up, so the old bitcode is a close estimate.
+    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(),
+                           pModuleBitcode->GetPtrSize(), &pInputProgramStream));
     raw_stream_ostream outStream(pInputProgramStream.p);
     WriteBitcodeToFile(pModule->GetModule(), outStream, true);
   }
@@ -1568,10 +2057,10 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
   const uint32_t DebugInfoNameSuffix = 4;     // '.lld'
   const uint32_t DebugInfoNameNullAndPad = 4; // '\0\0\0\0'
   CComPtr<AbstractMemoryStream> pHashStream;
-  if (HasDebugInfo(*pModule->GetModule())) {
-    uint32_t debugInUInt32, debugPaddingBytes;
-    GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32, debugPaddingBytes);
+  if (bHasDebugInfo) {
     if (Flags & SerializeDxilFlags::IncludeDebugInfoPart) {
+      uint32_t debugInUInt32, debugPaddingBytes;
+      GetPaddedProgramPartSize(pInputProgramStream, debugInUInt32, debugPaddingBytes);
       writer.AddPart(DFCC_ShaderDebugInfoDXIL, debugInUInt32 * sizeof(uint32_t) + sizeof(DxilProgramHeader), [&](AbstractMemoryStream *pStream) {
         WriteProgramPart(pModule->GetShaderModel(), pInputProgramStream, pStream);
       });
@@ -1582,7 +2071,10 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
     llvm::StripDebugInfo(*pModule->GetModule());
     pModule->StripDebugRelatedCode();
 
-    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pProgramStream));
+    // The stripped bitcode is no larger than the bitcode with debug info, when
+    // that has been written.
+    IFT(CreateMemoryStream(DxcGetThreadMallocNoRef(),
+                           pInputProgramStream->GetPtrSize(), &pProgramStream));
     raw_stream_ostream outStream(pProgramStream.p);
     WriteBitcodeToFile(pModule->GetModule(), outStream, true);
 
@@ -1602,12 +2094,17 @@ void hlsl::SerializeDxilContainerForModule(DxilModule *pModule,
         NameContent.NameLength = DebugInfoNameHashLen + DebugInfoNameSuffix;
         IFT(WriteStreamValue(pStream, NameContent));
 
-        ArrayRef<uint8_t> Data((uint8_t *)pHashStream->GetPtr(), pHashStream->GetPtrSize());
         llvm::MD5 md5;
         llvm::MD5::MD5Result md5Result;
         SmallString<32> Hash;
-        md5.update(Data);
-        md5.final(md5Result);
+        if (pHashStream == pModuleBitcode && pDebugBitcodeHash) {
+          memcpy(md5Result, pDebugBitcodeHash->Digest, sizeof(md5Result));
+        } else {
+          ArrayRef<uint8_t> Data((uint8_t *)pHashStream->GetPtr(),
+                                 pHashStream->GetPtrSize());
+          md5.update(Data);
+          md5.final(md5Result);
+        }
         md5.stringifyResult(md5Result, Hash);
 
         ULONG cbWritten;
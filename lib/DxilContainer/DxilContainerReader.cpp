@@ -12,6 +12,7 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxc/DXIL/DxilSubobject.h"
 #include "dxc/DxilContainer/DxilContainerReader.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
@@ -80,6 +81,56 @@ bool LoadSubobjectsFromRDAT(DxilSubobjects &subobjects, RDAT::SubobjectTableRead
   return result;
 }
 
+HRESULT DxilContainerView::Load(IDxcBlob *pBlob) {
+  if (pBlob == nullptr)
+    return E_POINTER;
+  m_pBlob.Release();
+  m_pHeader = nullptr;
+
+  // Only the header and the offset table are read here.
+  size_t size = pBlob->GetBufferSize();
+  const DxilContainerHeader *pHeader =
+      IsDxilContainerLike(pBlob->GetBufferPointer(), size);
+  if (pHeader == nullptr || size < sizeof(DxilContainerHeader) ||
+      pHeader->Version.Major != DxilContainerVersionMajor ||
+      pHeader->ContainerSizeInBytes > size ||
+      pHeader->ContainerSizeInBytes > DxilContainerMaxSize ||
+      sizeof(DxilContainerHeader) + sizeof(uint32_t) * (size_t)pHeader->PartCount >
+          pHeader->ContainerSizeInBytes)
+    return DXC_E_CONTAINER_INVALID;
+
+  m_pBlob = pBlob;
+  m_pHeader = pHeader;
+  return S_OK;
+}
+
+HRESULT DxilContainerView::LoadFile(LPCWSTR pFileName) {
+  CComPtr<IDxcBlob> pBlob;
+  IFR(DxcCreateBlobFromMappedFile(pFileName, &pBlob));
+  return Load(pBlob);
+}
+
+const DxilPartHeader *DxilContainerView::GetPart(uint32_t index) const {
+  if (m_pHeader == nullptr || index >= m_pHeader->PartCount)
+    return nullptr;
+  uint32_t containerSize = m_pHeader->ContainerSizeInBytes;
+  uint32_t offset = reinterpret_cast<const uint32_t *>(m_pHeader + 1)[index];
+  if (offset > containerSize - sizeof(DxilPartHeader))
+    return nullptr;
+  const DxilPartHeader *pPart = GetDxilContainerPart(m_pHeader, index);
+  if (pPart->PartSize > containerSize - offset - sizeof(DxilPartHeader))
+    return nullptr;
+  return pPart;
+}
+
+const DxilPartHeader *DxilContainerView::FindPart(uint32_t fourCC) const {
+  for (uint32_t i = 0; i < GetPartCount(); ++i) {
+    const DxilPartHeader *pPart = GetPart(i);
+    if (pPart && pPart->PartFourCC == fourCC)
+      return pPart;
+  }
+  return nullptr;
+}
 
 } // namespace hlsl
 
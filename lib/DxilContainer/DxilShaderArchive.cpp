@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilShaderArchive.cpp                                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides support for reading shader archives.                             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/DxilContainer/DxilShaderArchive.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/MD5.h"
+
+#include <algorithm>
+
+namespace hlsl {
+
+static bool IsZeroHash(const DxilContainerHash &Hash) {
+  return std::all_of(std::begin(Hash.Digest), std::end(Hash.Digest),
+                     [](uint8_t b) { return b == 0; });
+}
+
+static bool KeyLess(const DxilContainerHash &L, const DxilContainerHash &R) {
+  return memcmp(L.Digest, R.Digest, DxilContainerHashSize) < 0;
+}
+
+void GetDxilShaderArchiveKey(const DxilContainerHeader *pHeader,
+                             DxilContainerHash *pKey) {
+  if (!IsZeroHash(pHeader->Hash)) {
+    *pKey = pHeader->Hash;
+    return;
+  }
+  llvm::MD5 md5;
+  llvm::MD5::MD5Result md5Result;
+  md5.update(llvm::ArrayRef<uint8_t>(
+      reinterpret_cast<const uint8_t *>(pHeader),
+      pHeader->ContainerSizeInBytes));
+  md5.final(md5Result);
+  static_assert(sizeof(md5Result) == DxilContainerHashSize,
+                "else key doesn't fit an MD5 digest");
+  memcpy(pKey->Digest, md5Result, DxilContainerHashSize);
+}
+
+bool IsValidDxilShaderArchive(const DxilShaderArchiveHeader *pHeader,
+                              size_t length) {
+  if (pHeader == nullptr || length < sizeof(DxilShaderArchiveHeader))
+    return false;
+  if (pHeader->HeaderFourCC != DxilShaderArchiveFourCC ||
+      pHeader->Version != DxilShaderArchiveVersion ||
+      pHeader->ArchiveSizeInBytes > length)
+    return false;
+
+  // Make sure that the tables fit.
+  uint64_t tablesSize =
+      sizeof(DxilShaderArchiveHeader) +
+      sizeof(DxilShaderArchiveEntry) * (uint64_t)pHeader->ContainerCount +
+      sizeof(DxilShaderArchivePart) * (uint64_t)pHeader->PartCount +
+      sizeof(uint32_t) * (uint64_t)pHeader->PartRefCount;
+  if (tablesSize > pHeader->ArchiveSizeInBytes)
+    return false;
+
+  // Make sure that each part is within the bounds.
+  const DxilShaderArchivePart *pParts = GetDxilShaderArchiveParts(pHeader);
+  for (uint32_t i = 0; i < pHeader->PartCount; ++i) {
+    if (pParts[i].DataOffset < tablesSize ||
+        (uint64_t)pParts[i].DataOffset + pParts[i].PartSize >
+            pHeader->ArchiveSizeInBytes)
+      return false;
+  }
+  const uint32_t *pPartRefs = GetDxilShaderArchivePartRefs(pHeader);
+  for (uint32_t i = 0; i < pHeader->PartRefCount; ++i) {
+    if (pPartRefs[i] >= pHeader->PartCount)
+      return false;
+  }
+
+  // Make sure that entries are sorted, and that each one describes the
+  // container that its parts make up.
+  const DxilShaderArchiveEntry *pEntries = GetDxilShaderArchiveEntries(pHeader);
+  for (uint32_t i = 0; i < pHeader->ContainerCount; ++i) {
+    const DxilShaderArchiveEntry &Entry = pEntries[i];
+    if (i > 0 && !KeyLess(pEntries[i - 1].Key, Entry.Key))
+      return false;
+    uint32_t partCount = Entry.Header.PartCount;
+    if ((uint64_t)Entry.FirstPartRef + partCount > pHeader->PartRefCount)
+      return false;
+    uint64_t partsSize = 0;
+    for (uint32_t j = 0; j < partCount; ++j)
+      partsSize += GetDxilShaderArchivePart(pHeader, &Entry, j)->PartSize;
+    if (Entry.Header.HeaderFourCC != DFCC_Container ||
+        partsSize > DxilContainerMaxSize ||
+        Entry.Header.ContainerSizeInBytes !=
+            GetDxilContainerSizeFromParts(partCount, (uint32_t)partsSize))
+      return false;
+  }
+  return true;
+}
+
+const DxilShaderArchiveEntry *
+FindDxilShaderArchiveEntry(const DxilShaderArchiveHeader *pHeader,
+                           const DxilContainerHash &Key) {
+  const DxilShaderArchiveEntry *pBegin = GetDxilShaderArchiveEntries(pHeader);
+  const DxilShaderArchiveEntry *pEnd = pBegin + pHeader->ContainerCount;
+  const DxilShaderArchiveEntry *pEntry = std::lower_bound(
+      pBegin, pEnd, Key,
+      [](const DxilShaderArchiveEntry &Entry, const DxilContainerHash &Key) {
+        return KeyLess(Entry.Key, Key);
+      });
+  if (pEntry == pEnd || KeyLess(Key, pEntry->Key))
+    return nullptr;
+  return pEntry;
+}
+
+void WriteDxilShaderArchiveContainer(const DxilShaderArchiveHeader *pHeader,
+                                     const DxilShaderArchiveEntry *pEntry,
+                                     AbstractMemoryStream *pStream) {
+  const DxilContainerHeader &Header = pEntry->Header;
+  IFT(pStream->Reserve(Header.ContainerSizeInBytes));
+  IFT(WriteStreamValue(pStream, Header));
+
+  uint32_t offset = sizeof(DxilContainerHeader) +
+                    (uint32_t)GetOffsetTableSize(Header.PartCount);
+  for (uint32_t i = 0; i < Header.PartCount; ++i) {
+    IFT(WriteStreamValue(pStream, offset));
+    offset += sizeof(DxilPartHeader) +
+              GetDxilShaderArchivePart(pHeader, pEntry, i)->PartSize;
+  }
+
+  ULONG cbWritten;
+  for (uint32_t i = 0; i < Header.PartCount; ++i) {
+    const DxilShaderArchivePart *pPart =
+        GetDxilShaderArchivePart(pHeader, pEntry, i);
+    DxilPartHeader partHeader;
+    partHeader.PartFourCC = pPart->PartFourCC;
+    partHeader.PartSize = pPart->PartSize;
+    IFT(WriteStreamValue(pStream, partHeader));
+    IFT(pStream->Write(GetDxilShaderArchivePartData(pHeader, pPart),
+                       pPart->PartSize, &cbWritten));
+  }
+}
+
+} // namespace hlsl
@@ -11,6 +11,10 @@
 
 #include "DxilDiaSession.h"
 
+#include <algorithm>
+#include <cstdlib>
+
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Instruction.h"
@@ -18,6 +22,8 @@
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 
+#include "dxc/Support/DxcSourceStore.h"
+
 #include "DxilDia.h"
 #include "DxilDiaEnumTables.h"
 #include "DxilDiaTable.h"
@@ -57,6 +63,12 @@ void dxil_dia::Session::Init(
     m_module->getNamedMetadata(hlsl::DxilMDHelper::kDxilSourceArgsMDName);
   if (!m_arguments)
     m_arguments = m_module->getNamedMetadata("llvm.dbg.args");
+}
+
+void dxil_dia::Session::EnsureInstructions() {
+  if (m_instructionsBuilt)
+    return;
+  m_instructionsBuilt = true;
 
   // Build up a linear list of instructions. The index will be used as the
   // RVA. Debug instructions are ommitted from this enumeration.
@@ -85,20 +97,89 @@ void dxil_dia::Session::Init(
   }
 }
 
+void dxil_dia::Session::EnsureLineTable() {
+  if (m_lineTableBuilt)
+    return;
+  m_lineTableBuilt = true;
+
+  for (const llvm::Instruction *inst : InstructionLinesRef()) {
+    const llvm::DebugLoc &loc = inst->getDebugLoc();
+    LineEntry entry;
+    if (getSourceFileIdByLoc(loc, &entry.fileId) != S_OK)
+      continue;
+    entry.line = loc.getLine();
+    entry.column = loc.getCol();
+    entry.rva = m_rvaMap[inst];
+    m_lineTable.push_back(entry);
+  }
+  std::sort(m_lineTable.begin(), m_lineTable.end());
+}
+
+// Debug info compiled with /Qsource_store only refers to its sources; they
+// are read on first use from the store the DXC_SOURCE_STORE environment
+// variable names. A source the store doesn't hold keeps its reference as
+// content, which tells the user what is missing.
+static const std::string &GetSourceStoreDir() {
+  static const std::string StoreDir = []() {
+    const char *pDir = std::getenv("DXC_SOURCE_STORE");
+    return std::string(pDir ? pDir : "");
+  }();
+  return StoreDir;
+}
+
+llvm::StringRef dxil_dia::Session::GetSourceContent(unsigned index) {
+  llvm::StringRef content =
+    llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(index)->getOperand(1))
+    ->getString();
+  llvm::StringRef hash;
+  if (!hlsl::IsSourceStoreReference(content, &hash))
+    return content;
+  auto it = m_storedContents.find(index);
+  if (it == m_storedContents.end()) {
+    std::string stored;
+    if (GetSourceStoreDir().empty() ||
+        !hlsl::ReadFromSourceStore(GetSourceStoreDir(), hash, stored))
+      stored = content;
+    it = m_storedContents.emplace(index, std::move(stored)).first;
+  }
+  return it->second;
+}
+
 HRESULT dxil_dia::Session::getSourceFileIdByName(
     llvm::StringRef fileName,
     DWORD *pRetVal) {
-  if (Contents() != nullptr) {
-    for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
-      llvm::StringRef fn =
-        llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(i)->getOperand(0))
-        ->getString();
-      if (fn.equals(fileName)) {
-        *pRetVal = i;
-        return S_OK;
+  if (!m_fileIdsBuilt) {
+    m_fileIdsBuilt = true;
+    if (Contents() != nullptr) {
+      for (unsigned i = 0; i < Contents()->getNumOperands(); ++i) {
+        llvm::StringRef fn =
+          llvm::dyn_cast<llvm::MDString>(Contents()->getOperand(i)->getOperand(0))
+          ->getString();
+        m_fileIds.insert(std::make_pair(fn, i)); // The first one wins.
       }
     }
   }
+  auto it = m_fileIds.find(fileName);
+  if (it != m_fileIds.end()) {
+    *pRetVal = it->second;
+    return S_OK;
+  }
+  *pRetVal = 0;
+  return S_FALSE;
+}
+
+HRESULT dxil_dia::Session::getSourceFileIdByLoc(
+    const llvm::DebugLoc &loc,
+    DWORD *pRetVal) {
+  llvm::MDNode *pScope = loc.getScope();
+  auto *pBlock = llvm::dyn_cast_or_null<llvm::DILexicalBlock>(pScope);
+  if (pBlock != nullptr) {
+    return getSourceFileIdByName(pBlock->getFile()->getFilename(), pRetVal);
+  }
+  auto *pSubProgram = llvm::dyn_cast_or_null<llvm::DISubprogram>(pScope);
+  if (pSubProgram != nullptr) {
+    return getSourceFileIdByName(pSubProgram->getFile()->getFilename(), pRetVal);
+  }
   *pRetVal = 0;
   return S_FALSE;
 }
@@ -203,3 +284,66 @@ STDMETHODIMP dxil_dia::Session::findInjectedSource(
   }
   return S_FALSE;
 }
+
+HRESULT dxil_dia::Session::CreateLineNumbers(
+    std::vector<LineEntry>::const_iterator begin,
+    std::vector<LineEntry>::const_iterator end,
+    IDiaEnumLineNumbers **ppResult) {
+  std::vector<const llvm::Instruction*> instructions;
+  instructions.reserve(end - begin);
+  for (auto it = begin; it != end; ++it)
+    instructions.push_back(m_instructions[it->rva]);
+  *ppResult = CreateOnMalloc<LineNumbersTable>(m_pMalloc, this, std::move(instructions));
+  if (*ppResult == nullptr)
+    return E_OUTOFMEMORY;
+  (*ppResult)->AddRef();
+  return S_OK;
+}
+
+STDMETHODIMP dxil_dia::Session::findLines(
+  /* [in] */ IDiaSymbol *compiland,
+  /* [in] */ IDiaSourceFile *file,
+  /* [out] */ IDiaEnumLineNumbers **ppResult) {
+  if (!ppResult)
+    return E_POINTER;
+  if (!file)
+    return E_INVALIDARG;
+  DxcThreadMalloc TM(m_pMalloc);
+  DWORD fileId;
+  IFR(file->get_uniqueId(&fileId));
+  EnsureLineTable();
+  LineEntry first = { fileId, 0, 0, 0 };
+  auto begin = std::lower_bound(m_lineTable.cbegin(), m_lineTable.cend(), first);
+  auto end = begin;
+  while (end != m_lineTable.cend() && end->fileId == fileId)
+    ++end;
+  return CreateLineNumbers(begin, end, ppResult);
+}
+
+// As in DIA, a line without code finds the next line of the file that has
+// some, and a zero column finds every column of the line.
+STDMETHODIMP dxil_dia::Session::findLinesByLinenum(
+  /* [in] */ IDiaSymbol *compiland,
+  /* [in] */ IDiaSourceFile *file,
+  /* [in] */ DWORD linenum,
+  /* [in] */ DWORD column,
+  /* [out] */ IDiaEnumLineNumbers **ppResult) {
+  if (!ppResult)
+    return E_POINTER;
+  if (!file)
+    return E_INVALIDARG;
+  DxcThreadMalloc TM(m_pMalloc);
+  DWORD fileId;
+  IFR(file->get_uniqueId(&fileId));
+  EnsureLineTable();
+  LineEntry first = { fileId, linenum, column, 0 };
+  auto begin = std::lower_bound(m_lineTable.cbegin(), m_lineTable.cend(), first);
+  auto end = begin;
+  if (begin != m_lineTable.cend() && begin->fileId == fileId) {
+    while (end != m_lineTable.cend() && end->fileId == fileId &&
+           end->line == begin->line &&
+           (column == 0 || end->column == begin->column))
+      ++end;
+  }
+  return CreateLineNumbers(begin, end, ppResult);
+}
@@ -14,6 +14,7 @@
 #include "dxc/Support/WinIncludes.h"
 
 #include <memory>
+#include <tuple>
 #include <unordered_map>
 #include <vector>
 
@@ -21,6 +22,8 @@
 
 #include "dxc/DXIL/DxilModule.h"
 
+#include "llvm/ADT/StringMap.h"
+
 #include "dxc/Support/Global.h"
 #include "dxc/Support/microcom.h"
 
@@ -48,11 +51,13 @@ public:
   hlsl::DxilModule &DxilModuleRef() { return *m_dxilModule.get(); }
   llvm::Module &ModuleRef() { return *m_module.get(); }
   llvm::DebugInfoFinder &InfoRef() { return *m_finder.get(); }
-  std::vector<const llvm::Instruction *> &InstructionsRef() { return m_instructions; }
-  std::vector<const llvm::Instruction *> &InstructionLinesRef() { return m_instructionLines; }
-  std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() { return m_rvaMap; }
+  std::vector<const llvm::Instruction *> &InstructionsRef() { EnsureInstructions(); return m_instructions; }
+  std::vector<const llvm::Instruction *> &InstructionLinesRef() { EnsureInstructions(); return m_instructionLines; }
+  std::unordered_map<const llvm::Instruction *, RVA> &RvaMapRef() { EnsureInstructions(); return m_rvaMap; }
 
+  llvm::StringRef GetSourceContent(unsigned index);
   HRESULT getSourceFileIdByName(llvm::StringRef fileName, DWORD *pRetVal);
+  HRESULT getSourceFileIdByLoc(const llvm::DebugLoc &loc, DWORD *pRetVal);
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
     return DoBasicQueryInterface<IDiaSession>(this, iid, ppvObject);
@@ -166,7 +171,7 @@ public:
   STDMETHODIMP findLines(
     /* [in] */ IDiaSymbol *compiland,
     /* [in] */ IDiaSourceFile *file,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) override { return ENotImpl(); }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) override;
 
   STDMETHODIMP findLinesByAddr(
     /* [in] */ DWORD seg,
@@ -189,7 +194,7 @@ public:
     /* [in] */ IDiaSourceFile *file,
     /* [in] */ DWORD linenum,
     /* [in] */ DWORD column,
-    /* [out] */ IDiaEnumLineNumbers **ppResult) override { return ENotImpl(); }
+    /* [out] */ IDiaEnumLineNumbers **ppResult) override;
 
   STDMETHODIMP findInjectedSource(
       /* [in] */ LPCOLESTR srcFile,
@@ -369,9 +374,37 @@ private:
   llvm::NamedMDNode *m_defines;
   llvm::NamedMDNode *m_mainFileName;
   llvm::NamedMDNode *m_arguments;
+  // The instructions and the tables below are built on first use, so that
+  // opening a session doesn't walk the module.
+  bool m_instructionsBuilt = false;
   std::vector<const llvm::Instruction *> m_instructions;
   std::vector<const llvm::Instruction *> m_instructionLines; // Instructions with line info.
   std::unordered_map<const llvm::Instruction *, RVA> m_rvaMap; // Map instruction to its RVA.
+  bool m_fileIdsBuilt = false;
+  llvm::StringMap<DWORD> m_fileIds; // Map file name to its id.
+
+  // The instructions with line info, sorted by source position for lookups
+  // by file and line.
+  struct LineEntry {
+    DWORD fileId;
+    DWORD line;
+    DWORD column;
+    RVA rva;
+    bool operator<(const LineEntry &other) const {
+      return std::tie(fileId, line, column, rva) <
+             std::tie(other.fileId, other.line, other.column, other.rva);
+    }
+  };
+  bool m_lineTableBuilt = false;
+  std::vector<LineEntry> m_lineTable;
+  // Contents read from the source store, by source index.
+  std::unordered_map<unsigned, std::string> m_storedContents;
+
+  void EnsureInstructions();
+  void EnsureLineTable();
+  HRESULT CreateLineNumbers(std::vector<LineEntry>::const_iterator begin,
+                            std::vector<LineEntry>::const_iterator end,
+                            IDiaEnumLineNumbers **ppResult);
 
 private:
   CComPtr<IDiaEnumTables> m_pEnumTables;
@@ -24,7 +24,7 @@ llvm::StringRef dxil_dia::InjectedSource::Name() {
 }
 
 llvm::StringRef dxil_dia::InjectedSource::Content() {
-  return llvm::dyn_cast<llvm::MDString>(NameContent()->getOperand(1))->getString();
+  return m_pSession->GetSourceContent(m_index);
 }
 
 STDMETHODIMP dxil_dia::InjectedSource::get_length(_Out_ ULONGLONG *pRetVal) {
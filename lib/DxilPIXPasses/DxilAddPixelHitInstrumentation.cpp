@@ -17,6 +17,8 @@
 #include "dxc/DxilPIXPasses/DxilPIXPasses.h"
 #include "dxc/DXIL/DxilUtil.h"
 
+#include "DxilPIXWaveAggregation.h"
+
 #include "llvm/IR/PassManager.h"
 #include "llvm/Transforms/Utils/Local.h"
 
@@ -27,6 +29,7 @@ class DxilAddPixelHitInstrumentation : public ModulePass {
 
   bool ForceEarlyZ = false;
   bool AddPixelCost = false;
+  bool WaveAggregate = true;
   int RTWidth = 1024;
   int NumPixels = 128;
   int SVPositionIndex = -1;
@@ -43,6 +46,7 @@ void DxilAddPixelHitInstrumentation::applyOptions(PassOptions O)
 {
   GetPassOptionBool(O, "force-early-z", &ForceEarlyZ, false);
   GetPassOptionBool(O, "add-pixel-cost", &AddPixelCost, false);
+  GetPassOptionBool(O, "wave-aggregate", &WaveAggregate, true);
   GetPassOptionInt(O, "rt-width", &RTWidth, 0);
   GetPassOptionInt(O, "num-pixels", &NumPixels, 0);
   GetPassOptionInt(O, "sv-position-index", &SVPositionIndex, 0);
@@ -88,6 +92,10 @@ bool DxilAddPixelHitInstrumentation::runOnModule(Module &M)
     SV_Position_ID = SV_Position->get()->GetID();
   }
 
+  // Lanes of a wave that hit the same pixel (e.g. when shading per sample) are counted with one atomic
+  // by the first of them, rather than with one atomic each.
+  bool UseWaveAggregation = WaveAggregate && pix_dxil::WaveAggregation::Enable(DM);
+
   auto EntryPointFunction = DM.GetEntryFunction();
 
   auto & EntryBlock = EntryPointFunction->getEntryBlock();
@@ -119,6 +127,7 @@ bool DxilAddPixelHitInstrumentation::runOnModule(Module &M)
     if (pAnnotation == nullptr)
     {
       pAnnotation = DM.GetTypeSystem().AddStructAnnotation(UAVStructTy);
+      DM.MarkDxilMetadataDirty(DxilModule::kMDTypeSystem);
       pAnnotation->GetFieldAnnotation(0).SetCBufferOffset(0);
       pAnnotation->GetFieldAnnotation(0).SetCompType(hlsl::DXIL::ComponentType::I32);
       pAnnotation->GetFieldAnnotation(0).SetFieldName("count");
@@ -191,6 +200,13 @@ bool DxilAddPixelHitInstrumentation::runOnModule(Module &M)
           Index = Builder.CreateMul(Elementoffset, HlslOP->GetU32Const(4), "ByteIndex");
         }
 
+        // Step 3: Elect the lanes that update the UAV
+        Value * Increment = One32Arg;
+        if (UseWaveAggregation) {
+          Value * UpdatesCounter = pix_dxil::WaveAggregation::EmitAggregation(HlslOP, Builder, Index, &Increment);
+          pix_dxil::WaveAggregation::EmitConditionalBlock(Builder, UpdatesCounter);
+        }
+
         // Insert the UAV increment instruction:
         Function* AtomicOpFunc = HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
         Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
@@ -203,7 +219,7 @@ bool DxilAddPixelHitInstrumentation::runOnModule(Module &M)
             Index,          // i32, ; coordinate c0: byte offset
             UndefArg,       // i32, ; coordinate c1 (unused)
             UndefArg,       // i32, ; coordinate c2 (unused)
-            One32Arg        // i32); increment value
+            Increment       // i32); increment value
           }, "UAVIncResult");
         }
 
@@ -231,7 +247,10 @@ bool DxilAddPixelHitInstrumentation::runOnModule(Module &M)
           // Step 2: Update write position ("Index") to second half of the UAV 
           auto OffsetIndex = Builder.CreateAdd(Index, NumPixelsByteOffsetArg, "OffsetByteIndex");
 
-          // Step 3: Increment UAV value by the weight
+          // Step 3: Increment UAV value by the weight, once for each lane this one counts for
+          if (UseWaveAggregation) {
+            Weight = Builder.CreateMul(Weight, Increment, "AggregatedWeight");
+          }
           (void)Builder.CreateCall(AtomicOpFunc,{
             AtomicBinOpcode,          // i32, ; opcode
             HandleForUAV,   // %dx.types.Handle, ; resource handle
@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilBlockCountInstrumentation.cpp                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a pass to count the executions of each basic block. Used by PIX. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DxilPIXPasses/DxilPIXPasses.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "DxilPIXWaveAggregation.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FormattedStream.h"
+
+#include <climits>
+
+using namespace llvm;
+using namespace hlsl;
+
+// This pass gives each basic block of the entry function a slot in a UAV of uints, in the order of the blocks
+// in the function, and adds code at the start of each block to increment that slot. The increments are made
+// with one atomic per wave where wave intrinsics are available (shader model 6.0+).
+//
+// So that the counts can be mapped back to the source, the pass writes out, if the caller asked for it,
+// the source lines that each slot covers, from the debug info:
+//   BlockCount=<number of slots>;<slot>:<first line>-<last line>:<file>;...;.
+// Blocks that have no instructions with a location aren't listed.
+
+class DxilBlockCountInstrumentation : public ModulePass {
+
+  bool WaveAggregate = true;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilBlockCountInstrumentation() : ModulePass(ID) {}
+  const char *getPassName() const override { return "DXIL basic block count instrumentation"; }
+  void applyOptions(PassOptions O) override;
+  bool runOnModule(Module &M) override;
+
+private:
+  CallInst *addUAV(DxilModule &DM);
+  void addBlockCount(OP *HlslOP, IRBuilder<> &Builder, CallInst *HandleForUAV, unsigned Slot, bool UseWaveAggregation);
+  void writeSourceMap(formatted_raw_ostream &FOS, const std::vector<BasicBlock *> &Blocks);
+};
+
+void DxilBlockCountInstrumentation::applyOptions(PassOptions O) {
+  GetPassOptionBool(O, "wave-aggregate", &WaveAggregate, true);
+}
+
+CallInst *DxilBlockCountInstrumentation::addUAV(DxilModule &DM) {
+  LLVMContext &Ctx = DM.GetCtx();
+  OP *HlslOP = DM.GetOP();
+
+  IRBuilder<> Builder(dxilutil::FirstNonAllocaInsertionPt(DM.GetEntryFunction()));
+
+  unsigned int UAVResourceHandle = static_cast<unsigned int>(DM.GetUAVs().size());
+
+  // Set up a UAV with structure of a single int
+  SmallVector<llvm::Type*, 1> Elements{ Type::getInt32Ty(Ctx) };
+  llvm::StructType *UAVStructTy = llvm::StructType::create(Elements, "class.RWStructuredBuffer");
+  std::unique_ptr<DxilResource> pUAV = llvm::make_unique<DxilResource>();
+  pUAV->SetGlobalName("PIX_BlockCountUAVName");
+  pUAV->SetGlobalSymbol(UndefValue::get(UAVStructTy->getPointerTo()));
+  pUAV->SetID(UAVResourceHandle);
+  pUAV->SetSpaceID((unsigned int)-2); // This is the reserved-for-tools register space
+  pUAV->SetSampleCount(1);
+  pUAV->SetGloballyCoherent(false);
+  pUAV->SetHasCounter(false);
+  pUAV->SetCompType(CompType::getI32());
+  pUAV->SetLowerBound(0);
+  pUAV->SetRangeSize(1);
+  pUAV->SetKind(DXIL::ResourceKind::RawBuffer);
+  pUAV->SetRW(true);
+
+  auto pAnnotation = DM.GetTypeSystem().GetStructAnnotation(UAVStructTy);
+  if (pAnnotation == nullptr) {
+    pAnnotation = DM.GetTypeSystem().AddStructAnnotation(UAVStructTy);
+    DM.MarkDxilMetadataDirty(DxilModule::kMDTypeSystem);
+    pAnnotation->GetFieldAnnotation(0).SetCBufferOffset(0);
+    pAnnotation->GetFieldAnnotation(0).SetCompType(hlsl::DXIL::ComponentType::I32);
+    pAnnotation->GetFieldAnnotation(0).SetFieldName("count");
+  }
+
+  unsigned ID = DM.AddUAV(std::move(pUAV));
+  assert(ID == UAVResourceHandle);
+
+  // Create handle for the newly-added UAV
+  Function* CreateHandleOpFunc = HlslOP->GetOpFunc(DXIL::OpCode::CreateHandle, Type::getVoidTy(Ctx));
+  Constant* CreateHandleOpcodeArg = HlslOP->GetU32Const((unsigned)DXIL::OpCode::CreateHandle);
+  Constant* UAVArg = HlslOP->GetI8Const(static_cast<std::underlying_type<DxilResourceBase::Class>::type>(DXIL::ResourceClass::UAV));
+  Constant* MetaDataArg = HlslOP->GetU32Const(ID); // position of the metadata record in the corresponding metadata list
+  Constant* IndexArg = HlslOP->GetU32Const(0); //
+  Constant* FalseArg = HlslOP->GetI1Const(0); // non-uniform resource index: false
+  CallInst *HandleForUAV = Builder.CreateCall(CreateHandleOpFunc,
+  { CreateHandleOpcodeArg, UAVArg, MetaDataArg, IndexArg, FalseArg }, "PIX_BlockCountUAV_Handle");
+
+  DM.ReEmitDxilResources();
+
+  return HandleForUAV;
+}
+
+void DxilBlockCountInstrumentation::addBlockCount(OP *HlslOP, IRBuilder<> &Builder, CallInst *HandleForUAV, unsigned Slot, bool UseWaveAggregation) {
+  LLVMContext &Ctx = Builder.getContext();
+
+  // Slots are four bytes each:
+  Constant* ByteIndex = HlslOP->GetU32Const(Slot * 4);
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
+
+  // The offset is the same in all lanes, so the first lane counts for the wave
+  Value * Increment = HlslOP->GetU32Const(1);
+  if (UseWaveAggregation) {
+    Value * UpdatesCounter = pix_dxil::WaveAggregation::EmitAggregation(HlslOP, Builder, ByteIndex, &Increment);
+    pix_dxil::WaveAggregation::EmitConditionalBlock(Builder, UpdatesCounter);
+  }
+
+  Function* AtomicOpFunc = HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
+  Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
+  Constant* AtomicAdd = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add);
+  (void)Builder.CreateCall(AtomicOpFunc, {
+    AtomicBinOpcode,// i32, ; opcode
+    HandleForUAV,   // %dx.types.Handle, ; resource handle
+    AtomicAdd,      // i32, ; binary operation code : EXCHANGE, IADD, AND, OR, XOR, IMIN, IMAX, UMIN, UMAX
+    ByteIndex,      // i32, ; coordinate c0: byte offset
+    UndefArg,       // i32, ; coordinate c1 (unused)
+    UndefArg,       // i32, ; coordinate c2 (unused)
+    Increment       // i32); increment value
+  }, "BlockCountResult");
+}
+
+void DxilBlockCountInstrumentation::writeSourceMap(formatted_raw_ostream &FOS, const std::vector<BasicBlock *> &Blocks) {
+  FOS << "BlockCount=" << Blocks.size() << ';';
+  for (unsigned Slot = 0; Slot < Blocks.size(); ++Slot) {
+    unsigned FirstLine = UINT_MAX;
+    unsigned LastLine = 0;
+    StringRef File;
+    for (Instruction &I : *Blocks[Slot]) {
+      DILocation *Loc = I.getDebugLoc().get();
+      if (Loc == nullptr || Loc->getLine() == 0) {
+        continue;
+      }
+      FirstLine = std::min(FirstLine, Loc->getLine());
+      LastLine = std::max(LastLine, Loc->getLine());
+      if (File.empty()) {
+        File = Loc->getFilename();
+      }
+    }
+    if (LastLine != 0) {
+      FOS << Slot << ':' << FirstLine << '-' << LastLine << ':' << File << ';';
+    }
+  }
+  FOS << ".";
+}
+
+bool DxilBlockCountInstrumentation::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  OP *HlslOP = DM.GetOP();
+
+  bool UseWaveAggregation = WaveAggregate && pix_dxil::WaveAggregation::Enable(DM);
+
+  // Take the blocks before instrumenting, since the wave aggregation splits them.
+  std::vector<BasicBlock *> Blocks;
+  for (BasicBlock &BB : *DM.GetEntryFunction()) {
+    Blocks.push_back(&BB);
+  }
+
+  // The source map is written first: the blocks still hold only the original instructions.
+  if (OSOverride != nullptr) {
+    formatted_raw_ostream FOS(*OSOverride);
+    writeSourceMap(FOS, Blocks);
+  }
+
+  CallInst *HandleForUAV = addUAV(DM);
+
+  for (unsigned Slot = 0; Slot < Blocks.size(); ++Slot) {
+    // The entry block is counted once the UAV handle has been created
+    Instruction *InsertPt = Slot == 0 ? HandleForUAV->getNextNode() : &*Blocks[Slot]->getFirstInsertionPt();
+    IRBuilder<> Builder(InsertPt);
+    addBlockCount(HlslOP, Builder, HandleForUAV, Slot, UseWaveAggregation);
+  }
+
+  return true;
+}
+
+char DxilBlockCountInstrumentation::ID = 0;
+
+ModulePass *llvm::createDxilBlockCountInstrumentationPass() {
+  return new DxilBlockCountInstrumentation();
+}
+
+INITIALIZE_PASS(DxilBlockCountInstrumentation, "hlsl-dxil-block-count-instrumentation", "HLSL DXIL basic block count instrumentation for PIX", false, false)
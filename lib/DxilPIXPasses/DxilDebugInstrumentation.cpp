@@ -17,6 +17,7 @@
 
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/ADT/STLExtras.h"
@@ -70,6 +71,15 @@ using namespace hlsl;
 // close to the end of the power-of-two size of the UAV. If this value has been overwritten, the debug session
 // is deemed to have overflowed the UAV. The caller will than allocate a UAV that is twice the size and
 // try again, up to a predefined maximum.
+//
+// Instrumentation can be limited to the part of the shader that is being inspected, which keeps the
+// UAV small and the instrumented shader fast when only a region of a large shader is of interest:
+// -  FirstInstruction/LastInstruction limit it to a range of the instruction numbers assigned by
+//    -dxil-annotate-with-virtual-regs.
+// -  FirstLine/LastLine limit it to instructions whose debug location is within a range of source lines.
+// -  Function limits it to instructions that come from the named function, including the places where
+//    it was inlined.
+// The line and function limits need debug info: instructions without a location are then skipped.
 
 // Keep this in sync with the same-named value in the debugger application's WinPixShaderUtils.h
 constexpr uint64_t DebugBufferDumpingGroundSize = 64 * 1024;
@@ -215,6 +225,13 @@ private:
   uint32_t m_RemainingReservedSpaceInBytes = 0;
   Value * m_CurrentIndex = nullptr;
 
+  // The region of the shader that is instrumented
+  unsigned m_FirstInstruction = 0;
+  unsigned m_LastInstruction = UINT_MAX;
+  unsigned m_FirstLine = 0;
+  unsigned m_LastLine = UINT_MAX;
+  std::string m_Function;
+
 public:
   static char ID; // Pass identification, replacement for typeid
   explicit DxilDebugInstrumentation() : ModulePass(ID) {}
@@ -233,6 +250,7 @@ private:
   void addDebugEntryValue(BuilderContext &BC, Value * TheValue);
   void addInvocationStartMarker(BuilderContext &BC);
   void reserveDebugEntrySpace(BuilderContext &BC, uint32_t SpaceInDwords);
+  bool isInSelectedRegion(Instruction *Inst, std::uint32_t InstNum);
   void addStoreStepDebugEntry(BuilderContext &BC, StoreInst *Inst);
   void addStepDebugEntry(BuilderContext &BC, Instruction *Inst);
   void addStepDebugEntryValue(BuilderContext &BC, std::uint32_t InstNum, Value *V, std::uint32_t ValueOrdinal, Value *ValueOrdinalIndex);
@@ -247,6 +265,14 @@ void DxilDebugInstrumentation::applyOptions(PassOptions O) {
   GetPassOptionUnsigned(O, "parameter1", &m_Parameters.Parameters[1], 0);
   GetPassOptionUnsigned(O, "parameter2", &m_Parameters.Parameters[2], 0);
   GetPassOptionUInt64(O, "UAVSize", &m_UAVSize, 1024 * 1024);
+  GetPassOptionUnsigned(O, "FirstInstruction", &m_FirstInstruction, 0);
+  GetPassOptionUnsigned(O, "LastInstruction", &m_LastInstruction, UINT_MAX);
+  GetPassOptionUnsigned(O, "FirstLine", &m_FirstLine, 0);
+  GetPassOptionUnsigned(O, "LastLine", &m_LastLine, UINT_MAX);
+  StringRef Function;
+  if (GetPassOption(O, "Function", &Function)) {
+    m_Function = Function;
+  }
 }
 
 uint32_t DxilDebugInstrumentation::UAVDumpingGroundOffset() {
@@ -663,6 +689,34 @@ void DxilDebugInstrumentation::addStepEntryForType(DebugShaderModifierRecordType
   }
 }
 
+bool DxilDebugInstrumentation::isInSelectedRegion(Instruction *Inst, std::uint32_t InstNum) {
+  if (InstNum < m_FirstInstruction || InstNum > m_LastInstruction) {
+    return false;
+  }
+
+  if (m_FirstLine == 0 && m_LastLine == UINT_MAX && m_Function.empty()) {
+    return true;
+  }
+
+  DILocation *Loc = Inst->getDebugLoc().get();
+  if (Loc == nullptr || Loc->getLine() < m_FirstLine || Loc->getLine() > m_LastLine) {
+    return false;
+  }
+
+  if (m_Function.empty()) {
+    return true;
+  }
+
+  // Match the function the instruction came from, or any function it was inlined into.
+  for (; Loc != nullptr; Loc = Loc->getInlinedAt()) {
+    DISubprogram *Subprogram = Loc->getScope()->getSubprogram();
+    if (Subprogram != nullptr && Subprogram->getName() == m_Function) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void DxilDebugInstrumentation::addStoreStepDebugEntry(BuilderContext &BC, StoreInst *Inst) {
   std::uint32_t ValueOrdinalBase;
   std::uint32_t UnusedValueOrdinalSize;
@@ -676,6 +730,10 @@ void DxilDebugInstrumentation::addStoreStepDebugEntry(BuilderContext &BC, StoreI
     return;
   }
 
+  if (!isInSelectedRegion(Inst, InstNum)) {
+    return;
+  }
+
   addStepDebugEntryValue(BC, InstNum, Inst->getValueOperand(), ValueOrdinalBase, ValueOrdinalIndex);
 }
 
@@ -699,6 +757,10 @@ void DxilDebugInstrumentation::addStepDebugEntry(BuilderContext &BC, Instruction
     return;
   }
 
+  if (!isInSelectedRegion(Inst, InstNum)) {
+    return;
+  }
+
   addStepDebugEntryValue(BC, InstNum, Inst, RegNum, BC.Builder.getInt32(0));
 }
 
@@ -32,12 +32,14 @@ HRESULT SetupRegistryPassForPIX() {
     // INIT-PASSES:BEGIN
     initializeDxilAddPixelHitInstrumentationPass(Registry);
     initializeDxilAnnotateWithVirtualRegisterPass(Registry);
+    initializeDxilBlockCountInstrumentationPass(Registry);
     initializeDxilDebugInstrumentationPass(Registry);
     initializeDxilForceEarlyZPass(Registry);
     initializeDxilOutputColorBecomesConstantPass(Registry);
     initializeDxilReduceMSAAToSingleSamplePass(Registry);
     initializeDxilRemoveDiscardsPass(Registry);
     initializeDxilShaderAccessTrackingPass(Registry);
+    initializeDxilTimestampInstrumentationPass(Registry);
     // INIT-PASSES:END
   }
   CATCH_CPP_RETURN_HRESULT();
@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPIXWaveAggregation.cpp                                                //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Defines functions for aggregating the UAV updates of instrumentation      //
+// within a wave.                                                            //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DxilPIXWaveAggregation.h"
+
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+bool pix_dxil::WaveAggregation::Enable(DxilModule &DM) {
+  if (!DM.GetShaderModel()->IsSM60Plus()) {
+    return false;
+  }
+  DM.m_ShaderFlags.SetWaveOps(true);
+  return true;
+}
+
+Value *pix_dxil::WaveAggregation::EmitAggregation(OP *HlslOP,
+                                                  IRBuilder<> &Builder,
+                                                  Value *Offset,
+                                                  Value **pLaneCount) {
+  LLVMContext &Ctx = Builder.getContext();
+  Type *VoidTy = Type::getVoidTy(Ctx);
+
+  Function *IsFirstLaneFunc = HlslOP->GetOpFunc(OP::OpCode::WaveIsFirstLane, VoidTy);
+  Constant *IsFirstLaneOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveIsFirstLane);
+  Value *IsFirstLane = Builder.CreateCall(IsFirstLaneFunc, { IsFirstLaneOpcode }, "IsFirstLane");
+
+  // All lanes share a constant offset, so the first lane can update it for the wave.
+  if (isa<Constant>(Offset)) {
+    if (pLaneCount != nullptr) {
+      Function *BitCountFunc = HlslOP->GetOpFunc(OP::OpCode::WaveAllBitCount, VoidTy);
+      Constant *BitCountOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveAllBitCount);
+      *pLaneCount = Builder.CreateCall(BitCountFunc, { BitCountOpcode, HlslOP->GetI1Const(1) }, "LaneCount");
+    }
+    return IsFirstLane;
+  }
+
+  Function *ReadFirstFunc = HlslOP->GetOpFunc(OP::OpCode::WaveReadLaneFirst, Offset->getType());
+  Constant *ReadFirstOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveReadLaneFirst);
+  Value *FirstOffset = Builder.CreateCall(ReadFirstFunc, { ReadFirstOpcode, Offset }, "FirstLaneOffset");
+  Value *SharesFirstOffset = Builder.CreateICmpEQ(Offset, FirstOffset, "SharesFirstLaneOffset");
+
+  if (pLaneCount != nullptr) {
+    Function *BitCountFunc = HlslOP->GetOpFunc(OP::OpCode::WaveAllBitCount, VoidTy);
+    Constant *BitCountOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveAllBitCount);
+    Value *SharingLanes = Builder.CreateCall(BitCountFunc, { BitCountOpcode, SharesFirstOffset }, "SharingLaneCount");
+    *pLaneCount = Builder.CreateSelect(IsFirstLane, SharingLanes, HlslOP->GetU32Const(1), "LaneCount");
+  }
+
+  Value *OwnOffset = Builder.CreateNot(SharesFirstOffset, "HasOwnOffset");
+  return Builder.CreateOr(IsFirstLane, OwnOffset, "UpdatesCounter");
+}
+
+void pix_dxil::WaveAggregation::EmitConditionalBlock(IRBuilder<> &Builder,
+                                                     Value *Condition) {
+  Instruction *SplitBefore = &*Builder.GetInsertPoint();
+  TerminatorInst *ThenTerm = SplitBlockAndInsertIfThen(Condition, SplitBefore, false);
+  Builder.SetInsertPoint(ThenTerm);
+}
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPIXWaveAggregation.h                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Declares functions for aggregating the UAV updates of instrumentation     //
+// within a wave, so that one lane updates a counter for all lanes sharing   //
+// it.                                                                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "llvm/IR/IRBuilder.h"
+
+namespace hlsl {
+class DxilModule;
+class OP;
+}  // namespace hlsl
+
+namespace llvm {
+class Value;
+}  // namespace llvm
+
+namespace pix_dxil {
+namespace WaveAggregation {
+// Wave intrinsics are available from shader model 6.0. Sets the wave ops
+// flag of the module when they are, since the instrumentation will use them.
+bool Enable(hlsl::DxilModule &DM);
+
+// Emits the code to aggregate the updates of a UAV counter at a per-lane
+// Offset. Returns the condition for this lane to still update the counter:
+// the first active lane updates it on behalf of all lanes with the same
+// Offset, and lanes with another Offset update it themselves.
+// *pLaneCount receives the number of lanes that this lane's update is for.
+// Pass nullptr when the update is idempotent, e.g. an OR of a constant.
+llvm::Value *EmitAggregation(hlsl::OP *HlslOP, llvm::IRBuilder<> &Builder,
+                             llvm::Value *Offset, llvm::Value **pLaneCount);
+
+// Splits the block at the insertion point of Builder, so that the code
+// that Builder emits afterwards only runs when Condition is true.
+void EmitConditionalBlock(llvm::IRBuilder<> &Builder, llvm::Value *Condition);
+}  // namespace WaveAggregation
+}  // namespace pix_dxil
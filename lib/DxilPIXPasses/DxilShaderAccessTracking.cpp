@@ -17,9 +17,13 @@
 #include "dxc/DxilPIXPasses/DxilPIXPasses.h"
 #include "dxc/HLSL/DxilSpanAllocator.h"
 
+#include "DxilPIXWaveAggregation.h"
+
 #include "llvm/IR/PassManager.h"
 #include "llvm/Support/FormattedStream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include <climits>
 #include <deque>
 
 #ifdef _WIN32
@@ -113,6 +117,10 @@ struct SlotRange
 
   // Number of slots needed if no descriptors from unbounded ranges are included
   unsigned numInvariableSlots;
+
+  // Each slot covers 2^granularityShift descriptors, so the range takes numSlots >> granularityShift slots
+  // (rounded up). numSlots still counts descriptors.
+  unsigned granularityShift;
 };
 
 
@@ -134,10 +142,16 @@ public:
 
 private:
   void EmitAccess(LLVMContext & Ctx, OP *HlslOP, IRBuilder<> &, Value *slot, ShaderAccessFlags access);
+  void EmitOverflow(LLVMContext & Ctx, OP *HlslOP, IRBuilder<> &, unsigned startSlot, Value *index, ShaderAccessFlags access);
   bool EmitResourceAccess(DxilResourceAndClass &res, Instruction * instruction, OP * HlslOP, LLVMContext & Ctx, ShaderAccessFlags readWrite);
 
 private:
   bool m_CheckForDynamicIndexing = false;
+  bool m_WaveAggregate = true;
+  bool m_UseWaveAggregation = false;
+  bool m_Compact = false;
+  unsigned m_OverflowSize = 1024;
+  unsigned m_OverflowOffset = 0;
   std::map<RegisterTypeAndSpace, SlotRange> m_slotAssignments;
   CallInst *m_HandleForUAV;
   std::set<RSRegisterIdentifier> m_DynamicallyIndexedBindPoints;
@@ -195,6 +209,9 @@ void DxilShaderAccessTracking::applyOptions(PassOptions O) {
   int checkForDynamic;
   GetPassOptionInt(O, "checkForDynamicIndexing", &checkForDynamic, 0);
   m_CheckForDynamicIndexing = checkForDynamic != 0;
+  GetPassOptionBool(O, "wave-aggregate", &m_WaveAggregate, true);
+  GetPassOptionBool(O, "compact", &m_Compact, false);
+  GetPassOptionUnsigned(O, "overflow-size", &m_OverflowSize, 1024);
 
   StringRef configOption;
   if (GetPassOption(O, "config", &configOption)) {
@@ -219,6 +236,14 @@ void DxilShaderAccessTracking::applyOptions(PassOptions O) {
       ValidateDelimiter(config, 'i');
 
       sr.numInvariableSlots = DeserializeInt(config);
+
+      // Optional coarser tracking, e.g. for large bindless heaps: g<log2 of descriptors per slot>
+      sr.granularityShift = 0;
+      if (!config.empty() && config.front() == 'g') {
+        config.pop_front();
+        sr.granularityShift = DeserializeInt(config);
+        ThrowIf(sr.granularityShift >= 32);
+      }
       ValidateDelimiter(config, ';');
 
       m_slotAssignments[rst] = sr;
@@ -228,10 +253,36 @@ void DxilShaderAccessTracking::applyOptions(PassOptions O) {
   }
 }
 
+// The compact encoding packs the flags of eight slots into each uint, four bits per slot. It is
+// followed, at m_OverflowOffset, by a list of the accesses that were out of the bounds of their range:
+//   uint count; { uint startSlot of the range, uint descriptor index, uint flags } entries[overflow-size + 1]
+// Accesses past the end of the list all land in the last entry; the count says how many were lost.
+static const unsigned CompactSlotsPerUint = 8;
+static const unsigned CompactBitsPerSlot = 4;
+static const unsigned OverflowEntrySizeInBytes = 12;
+
 void DxilShaderAccessTracking::EmitAccess(LLVMContext & Ctx, OP *HlslOP, IRBuilder<> & Builder, Value * slot, ShaderAccessFlags access)
 {
-  // Slots are four bytes each:
-  auto ByteIndex = Builder.CreateMul(slot, HlslOP->GetU32Const(4));
+  Value * ByteIndex;
+  Value * AccessValue;
+  if (m_Compact) {
+    ByteIndex = Builder.CreateMul(Builder.CreateLShr(slot, HlslOP->GetU32Const(3)), HlslOP->GetU32Const(4));
+    Value * Shift = Builder.CreateMul(Builder.CreateAnd(slot, HlslOP->GetU32Const(CompactSlotsPerUint - 1)),
+                                      HlslOP->GetU32Const(CompactBitsPerSlot));
+    AccessValue = Builder.CreateShl(HlslOP->GetU32Const(static_cast<unsigned>(access)), Shift);
+  }
+  else {
+    // Slots are four bytes each:
+    ByteIndex = Builder.CreateMul(slot, HlslOP->GetU32Const(4));
+    AccessValue = HlslOP->GetU32Const(static_cast<unsigned>(access));
+  }
+
+  // ORing in the access flags is idempotent, so only one lane for each slot needs to do it. (Lanes that
+  // share a compact uint but not a slot OR in different bits, so they are told apart by slot.)
+  if (m_UseWaveAggregation) {
+    Value * UpdatesSlot = pix_dxil::WaveAggregation::EmitAggregation(HlslOP, Builder, m_Compact ? slot : ByteIndex, nullptr);
+    pix_dxil::WaveAggregation::EmitConditionalBlock(Builder, UpdatesSlot);
+  }
 
   // Insert the UAV increment instruction:
 
@@ -239,7 +290,6 @@ void DxilShaderAccessTracking::EmitAccess(LLVMContext & Ctx, OP *HlslOP, IRBuild
   Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
   Constant* AtomicOr = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Or);
 
-  Constant* AccessValue = HlslOP->GetU32Const(static_cast<unsigned>(access));
   UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
 
   (void)Builder.CreateCall(AtomicOpFunc, {
@@ -253,6 +303,44 @@ void DxilShaderAccessTracking::EmitAccess(LLVMContext & Ctx, OP *HlslOP, IRBuild
   }, "UAVOrResult");
 }
 
+void DxilShaderAccessTracking::EmitOverflow(LLVMContext & Ctx, OP *HlslOP, IRBuilder<> & Builder, unsigned startSlot, Value * index, ShaderAccessFlags access)
+{
+  Function* AtomicOpFunc = HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
+  Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
+  Constant* AtomicAdd = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add);
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
+
+  Value * Entry = Builder.CreateCall(AtomicOpFunc, {
+      AtomicBinOpcode,                        // i32, ; opcode
+      m_HandleForUAV,                         // %dx.types.Handle, ; resource handle
+      AtomicAdd,                              // i32, ; binary operation code : EXCHANGE, IADD, AND, OR, XOR, IMIN, IMAX, UMIN, UMAX
+      HlslOP->GetU32Const(m_OverflowOffset),  // i32, ; coordinate c0: byte offset
+      UndefArg,                               // i32, ; coordinate c1 (unused)
+      UndefArg,                               // i32, ; coordinate c2 (unused)
+      HlslOP->GetU32Const(1)                  // i32) ; increment value
+  }, "OverflowEntry");
+
+  auto IsListFull = Builder.CreateICmpUGE(Entry, HlslOP->GetU32Const(m_OverflowSize), "IsOverflowListFull");
+  Entry = Builder.CreateSelect(IsListFull, HlslOP->GetU32Const(m_OverflowSize), Entry);
+  auto EntryOffset = Builder.CreateAdd(Builder.CreateMul(Entry, HlslOP->GetU32Const(OverflowEntrySizeInBytes)),
+                                       HlslOP->GetU32Const(m_OverflowOffset + 4), "OverflowEntryOffset");
+
+  Function* StoreValue = HlslOP->GetOpFunc(OP::OpCode::BufferStore, Type::getInt32Ty(Ctx));
+  Constant* StoreValueOpcode = HlslOP->GetU32Const((unsigned)DXIL::OpCode::BufferStore);
+  Constant* WriteMask_XYZ = HlslOP->GetI8Const(0x7);
+  (void)Builder.CreateCall(StoreValue, {
+      StoreValueOpcode,                                       // i32 opcode
+      m_HandleForUAV,                                         // %dx.types.Handle, ; resource handle
+      EntryOffset,                                            // i32 c0: index in bytes into UAV
+      UndefArg,                                               // i32 c1: unused
+      HlslOP->GetU32Const(startSlot),
+      index,
+      HlslOP->GetU32Const(static_cast<unsigned>(access)),
+      UndefArg,
+      WriteMask_XYZ
+  });
+}
+
 bool DxilShaderAccessTracking::EmitResourceAccess(DxilResourceAndClass &res, Instruction * instruction, OP * HlslOP, LLVMContext & Ctx, ShaderAccessFlags readWrite) {
 
   RegisterTypeAndSpace typeAndSpace{ RegisterTypeFromResourceClass(res.resClass), res.resource->GetSpaceID() };
@@ -263,15 +351,21 @@ bool DxilShaderAccessTracking::EmitResourceAccess(DxilResourceAndClass &res, Ins
 
     IRBuilder<> Builder(instruction);
     Value * slotIndex;
+    Value * isOutOfBounds = nullptr;
+    unsigned granularityShift = slot->second.granularityShift;
 
     if (isa<ConstantInt>(res.index)) {
       unsigned index = cast<ConstantInt>(res.index)->getLimitedValue();
       if (index > slot->second.numSlots) {
+        if (m_Compact) {
+          EmitOverflow(Ctx, HlslOP, Builder, slot->second.startSlot, res.index, readWrite);
+          return true;
+        }
         // out-of-range accesses are written to slot zero:
         slotIndex = HlslOP->GetU32Const(0);
       }
       else {
-        slotIndex = HlslOP->GetU32Const(slot->second.startSlot + index);
+        slotIndex = HlslOP->GetU32Const(slot->second.startSlot + (index >> granularityShift));
       }
     }
     else {
@@ -287,14 +381,27 @@ bool DxilShaderAccessTracking::EmitResourceAccess(DxilResourceAndClass &res, Ins
       // IsInBounds will therefore contain 0 if the access is out-of-bounds, and 1 otherwise.
       auto IsInBounds = Builder.CreateSub(HlslOP->GetU32Const(1), CompareWithSlotLimitAsUint, "IsInBounds");
 
-      auto SlotOffset = Builder.CreateAdd(res.index, HlslOP->GetU32Const(slot->second.startSlot), "SlotOffset");
+      Value * SlotInRange = res.index;
+      if (granularityShift != 0) {
+        SlotInRange = Builder.CreateLShr(res.index, HlslOP->GetU32Const(granularityShift), "SlotInRange");
+      }
+      auto SlotOffset = Builder.CreateAdd(SlotInRange, HlslOP->GetU32Const(slot->second.startSlot), "SlotOffset");
 
       // This will drive an out-of-bounds access slot down to 0
       slotIndex = Builder.CreateMul(SlotOffset, IsInBounds, "slotIndex");
+      isOutOfBounds = CompareWithSlotLimit;
     }
 
     EmitAccess(Ctx, HlslOP, Builder, slotIndex, readWrite);
 
+    // The compact encoding also lists the out-of-bounds accesses, which are common with unbounded
+    // bindless ranges, so that they aren't all lost in slot zero.
+    if (m_Compact && isOutOfBounds != nullptr) {
+      TerminatorInst *ThenTerm = SplitBlockAndInsertIfThen(isOutOfBounds, instruction, false);
+      IRBuilder<> OverflowBuilder(ThenTerm);
+      EmitOverflow(Ctx, HlslOP, OverflowBuilder, slot->second.startSlot, res.index, readWrite);
+    }
+
     return true; // did modify
   }
   return false; // did not modify
@@ -385,6 +492,18 @@ bool DxilShaderAccessTracking::runOnModule(Module &M)
           FOS << "ShouldAssumeDsvAccess";
         }
       }
+      m_UseWaveAggregation = m_WaveAggregate && pix_dxil::WaveAggregation::Enable(DM);
+
+      if (m_Compact) {
+        unsigned numSlots = 1; // slot zero gets the out-of-range accesses
+        for (auto const & assignment : m_slotAssignments) {
+          const SlotRange & sr = assignment.second;
+          uint64_t rangeSlots = ((uint64_t)sr.numSlots + (1ull << sr.granularityShift) - 1) >> sr.granularityShift;
+          numSlots = std::max(numSlots, (unsigned)std::min<uint64_t>(sr.startSlot + rangeSlots, UINT_MAX - CompactSlotsPerUint));
+        }
+        m_OverflowOffset = (numSlots + CompactSlotsPerUint - 1) / CompactSlotsPerUint * 4;
+      }
+
       IRBuilder<> Builder(DM.GetEntryFunction()->getEntryBlock().getFirstInsertionPt());
 
       unsigned int UAVResourceHandle = static_cast<unsigned int>(DM.GetUAVs().size());
@@ -409,6 +528,7 @@ bool DxilShaderAccessTracking::runOnModule(Module &M)
       if (pAnnotation == nullptr) {
 
           pAnnotation = DM.GetTypeSystem().AddStructAnnotation(UAVStructTy);
+          DM.MarkDxilMetadataDirty(DxilModule::kMDTypeSystem);
           pAnnotation->GetFieldAnnotation(0).SetCBufferOffset(0);
           pAnnotation->GetFieldAnnotation(0).SetCompType(hlsl::DXIL::ComponentType::I32);
           pAnnotation->GetFieldAnnotation(0).SetFieldName("count");
@@ -507,6 +627,9 @@ bool DxilShaderAccessTracking::runOnModule(Module &M)
         FOS << EncodeRegisterType(bp.Type) << bp.Space << ':' << bp.Index <<';';
       }
       FOS << ".";
+      if (m_Compact) {
+        FOS << "CompactOverflow=" << m_OverflowOffset << ':' << m_OverflowSize << ".";
+      }
     }
   }
 
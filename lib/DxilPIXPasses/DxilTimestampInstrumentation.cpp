@@ -0,0 +1,356 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilTimestampInstrumentation.cpp                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides a pass to record shader clock timestamps at the boundaries of    //
+// source regions. Used by PIX.                                              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DxilPIXPasses/DxilPIXPasses.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "DxilPIXWaveAggregation.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FormattedStream.h"
+
+#include <map>
+
+using namespace llvm;
+using namespace hlsl;
+
+// DXIL has no clock operation, so this pass reads the clock through a function that the driver's shader
+// clock extension provides, named by the clock-function option: it returns the clock as an i64 or an i32.
+// Without one, the pass leaves the shader alone.
+//
+// The source is divided into regions by the regions option, a list of line ranges:
+//   regions=<first>-<last>,<first>-<last>...
+// Region N is the Nth range; region 0 is everything else. The pass records a timestamp at function entry,
+// wherever the code goes from one region to another, and before each return.
+//
+// The records go to a ring buffer in a UAV. The first uint counts the records written; the records follow at
+// byte 16, each of four uints:
+//   { wave, region, clock low, clock high }
+// where wave is the number of the first record of the wave (or of the lane, below shader model 6.0) that
+// wrote it, and region is 0xFFFFFFFF for the function exit. The wave spends the clocks between a record and
+// its next record in the record's region, so a decoder aggregates cycles per region by sorting the records of
+// each wave. It should ignore waves whose records were overwritten: the count says when the ring wrapped.
+//
+// So that the regions can be shown, the pass writes out, if the caller asked for it:
+//   Timestamps=<ring size in records>;<region>:<first line>-<last line>;...;.
+
+static const uint32_t ExitRegion = 0xFFFFFFFF;
+static const uint32_t RecordSizeInBytes = 16;
+static const uint32_t RecordsOffsetInBytes = 16;
+
+class DxilTimestampInstrumentation : public ModulePass {
+
+  struct LineRange {
+    unsigned First;
+    unsigned Last;
+  };
+
+  std::string ClockFunction;
+  std::vector<LineRange> Regions;
+  unsigned RingSize = 65536;
+  bool WaveAggregate = true;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilTimestampInstrumentation() : ModulePass(ID) {}
+  const char *getPassName() const override { return "DXIL timestamp instrumentation"; }
+  void applyOptions(PassOptions O) override;
+  bool runOnModule(Module &M) override;
+
+private:
+  int getRegion(Instruction &I);
+  void writeRegionMap(formatted_raw_ostream &FOS, unsigned RecordCount);
+  CallInst *addUAV(DxilModule &DM);
+  Value *addRecord(OP *HlslOP, IRBuilder<> &Builder, Function *Clock, CallInst *HandleForUAV, Value *Wave,
+                   uint32_t Region, bool UseWaveAggregation);
+};
+
+void DxilTimestampInstrumentation::applyOptions(PassOptions O) {
+  StringRef Value;
+  if (GetPassOption(O, "clock-function", &Value)) {
+    ClockFunction = Value;
+  }
+  if (GetPassOption(O, "regions", &Value)) {
+    SmallVector<StringRef, 8> Ranges;
+    Value.split(Ranges, ",", -1, false);
+    for (StringRef Range : Ranges) {
+      std::pair<StringRef, StringRef> Lines = Range.split('-');
+      LineRange R;
+      if (Lines.first.trim().getAsInteger(10, R.First)) {
+        continue;
+      }
+      if (Lines.second.empty() || Lines.second.trim().getAsInteger(10, R.Last)) {
+        R.Last = R.First;
+      }
+      Regions.push_back(R);
+    }
+  }
+  GetPassOptionUnsigned(O, "ring-size", &RingSize, 65536);
+  if (RingSize == 0) {
+    RingSize = 1;
+  }
+  GetPassOptionBool(O, "wave-aggregate", &WaveAggregate, true);
+}
+
+// Returns the region of an instruction, or -1 if it has no location.
+int DxilTimestampInstrumentation::getRegion(Instruction &I) {
+  DILocation *Loc = I.getDebugLoc().get();
+  if (Loc == nullptr || Loc->getLine() == 0) {
+    return -1;
+  }
+  for (unsigned i = 0; i < Regions.size(); ++i) {
+    if (Loc->getLine() >= Regions[i].First && Loc->getLine() <= Regions[i].Last) {
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+void DxilTimestampInstrumentation::writeRegionMap(formatted_raw_ostream &FOS, unsigned RecordCount) {
+  FOS << "Timestamps=" << RecordCount << ';';
+  for (unsigned i = 0; i < Regions.size(); ++i) {
+    FOS << (i + 1) << ':' << Regions[i].First << '-' << Regions[i].Last << ';';
+  }
+  FOS << ".";
+}
+
+CallInst *DxilTimestampInstrumentation::addUAV(DxilModule &DM) {
+  LLVMContext &Ctx = DM.GetCtx();
+  OP *HlslOP = DM.GetOP();
+
+  IRBuilder<> Builder(dxilutil::FirstNonAllocaInsertionPt(DM.GetEntryFunction()));
+
+  unsigned int UAVResourceHandle = static_cast<unsigned int>(DM.GetUAVs().size());
+
+  // Set up a UAV with structure of a single int
+  SmallVector<llvm::Type*, 1> Elements{ Type::getInt32Ty(Ctx) };
+  llvm::StructType *UAVStructTy = llvm::StructType::create(Elements, "class.RWStructuredBuffer");
+  std::unique_ptr<DxilResource> pUAV = llvm::make_unique<DxilResource>();
+  pUAV->SetGlobalName("PIX_TimestampUAVName");
+  pUAV->SetGlobalSymbol(UndefValue::get(UAVStructTy->getPointerTo()));
+  pUAV->SetID(UAVResourceHandle);
+  pUAV->SetSpaceID((unsigned int)-2); // This is the reserved-for-tools register space
+  pUAV->SetSampleCount(1);
+  pUAV->SetGloballyCoherent(false);
+  pUAV->SetHasCounter(false);
+  pUAV->SetCompType(CompType::getI32());
+  pUAV->SetLowerBound(0);
+  pUAV->SetRangeSize(1);
+  pUAV->SetKind(DXIL::ResourceKind::RawBuffer);
+  pUAV->SetRW(true);
+
+  auto pAnnotation = DM.GetTypeSystem().GetStructAnnotation(UAVStructTy);
+  if (pAnnotation == nullptr) {
+    pAnnotation = DM.GetTypeSystem().AddStructAnnotation(UAVStructTy);
+    DM.MarkDxilMetadataDirty(DxilModule::kMDTypeSystem);
+    pAnnotation->GetFieldAnnotation(0).SetCBufferOffset(0);
+    pAnnotation->GetFieldAnnotation(0).SetCompType(hlsl::DXIL::ComponentType::I32);
+    pAnnotation->GetFieldAnnotation(0).SetFieldName("count");
+  }
+
+  unsigned ID = DM.AddUAV(std::move(pUAV));
+  assert(ID == UAVResourceHandle);
+
+  // Create handle for the newly-added UAV
+  Function* CreateHandleOpFunc = HlslOP->GetOpFunc(DXIL::OpCode::CreateHandle, Type::getVoidTy(Ctx));
+  Constant* CreateHandleOpcodeArg = HlslOP->GetU32Const((unsigned)DXIL::OpCode::CreateHandle);
+  Constant* UAVArg = HlslOP->GetI8Const(static_cast<std::underlying_type<DxilResourceBase::Class>::type>(DXIL::ResourceClass::UAV));
+  Constant* MetaDataArg = HlslOP->GetU32Const(ID); // position of the metadata record in the corresponding metadata list
+  Constant* IndexArg = HlslOP->GetU32Const(0); //
+  Constant* FalseArg = HlslOP->GetI1Const(0); // non-uniform resource index: false
+  CallInst *HandleForUAV = Builder.CreateCall(CreateHandleOpFunc,
+  { CreateHandleOpcodeArg, UAVArg, MetaDataArg, IndexArg, FalseArg }, "PIX_TimestampUAV_Handle");
+
+  DM.ReEmitDxilResources();
+
+  return HandleForUAV;
+}
+
+// Adds the code to write a record, and returns the number of the record. Wave is the number of the first record
+// of the wave, or nullptr for the first record itself.
+Value *DxilTimestampInstrumentation::addRecord(OP *HlslOP, IRBuilder<> &Builder, Function *Clock, CallInst *HandleForUAV,
+                                               Value *Wave, uint32_t Region, bool UseWaveAggregation) {
+  LLVMContext &Ctx = Builder.getContext();
+  UndefValue* UndefArg = UndefValue::get(Type::getInt32Ty(Ctx));
+
+  // The lanes of a wave share its clock, so the first lane records for the wave
+  if (UseWaveAggregation) {
+    Value *UpdatesCounter = pix_dxil::WaveAggregation::EmitAggregation(HlslOP, Builder, HlslOP->GetU32Const(0), nullptr);
+    pix_dxil::WaveAggregation::EmitConditionalBlock(Builder, UpdatesCounter);
+  }
+
+  Value *Time = Builder.CreateCall(Clock, {}, "Timestamp");
+  Value *TimeLow = Builder.CreateTrunc(Time, Type::getInt32Ty(Ctx));
+  Value *TimeHigh = HlslOP->GetU32Const(0);
+  if (Time->getType()->getIntegerBitWidth() > 32) {
+    TimeHigh = Builder.CreateTrunc(Builder.CreateLShr(Time, 32), Type::getInt32Ty(Ctx));
+  }
+
+  Function* AtomicOpFunc = HlslOP->GetOpFunc(OP::OpCode::AtomicBinOp, Type::getInt32Ty(Ctx));
+  Constant* AtomicBinOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::AtomicBinOp);
+  Constant* AtomicAdd = HlslOP->GetU32Const((unsigned)DXIL::AtomicBinOpCode::Add);
+  Value *Record = Builder.CreateCall(AtomicOpFunc, {
+    AtomicBinOpcode,          // i32, ; opcode
+    HandleForUAV,             // %dx.types.Handle, ; resource handle
+    AtomicAdd,                // i32, ; binary operation code : EXCHANGE, IADD, AND, OR, XOR, IMIN, IMAX, UMIN, UMAX
+    HlslOP->GetU32Const(0),   // i32, ; coordinate c0: byte offset
+    UndefArg,                 // i32, ; coordinate c1 (unused)
+    UndefArg,                 // i32, ; coordinate c2 (unused)
+    HlslOP->GetU32Const(1)    // i32); increment value
+  }, "TimestampRecord");
+  if (Wave == nullptr) {
+    Wave = Record;
+  }
+
+  Value *RingIndex = Builder.CreateURem(Record, HlslOP->GetU32Const(RingSize));
+  Value *Offset = Builder.CreateAdd(Builder.CreateMul(RingIndex, HlslOP->GetU32Const(RecordSizeInBytes)),
+                                    HlslOP->GetU32Const(RecordsOffsetInBytes));
+
+  Function* StoreValue = HlslOP->GetOpFunc(OP::OpCode::BufferStore, Type::getInt32Ty(Ctx));
+  Constant* StoreValueOpcode = HlslOP->GetU32Const((unsigned)DXIL::OpCode::BufferStore);
+  Constant* WriteMask_XYZW = HlslOP->GetI8Const(0xF);
+  (void)Builder.CreateCall(StoreValue, {
+    StoreValueOpcode,             // i32 opcode
+    HandleForUAV,                 // %dx.types.Handle, ; resource handle
+    Offset,                       // i32 c0: index in bytes into UAV
+    UndefArg,                     // i32 c1: unused
+    Wave,
+    HlslOP->GetU32Const(Region),
+    TimeLow,
+    TimeHigh,
+    WriteMask_XYZW
+  });
+
+  return Record;
+}
+
+bool DxilTimestampInstrumentation::runOnModule(Module &M) {
+  Function *Clock = ClockFunction.empty() ? nullptr : M.getFunction(ClockFunction);
+  if (Clock == nullptr && !ClockFunction.empty()) {
+    Clock = cast<Function>(M.getOrInsertFunction(ClockFunction, FunctionType::get(Type::getInt64Ty(M.getContext()), false)));
+  }
+  if (Clock == nullptr || !Clock->getReturnType()->isIntegerTy() || Clock->getFunctionType()->getNumParams() != 0) {
+    // The target has no shader clock.
+    if (OSOverride != nullptr) {
+      formatted_raw_ostream FOS(*OSOverride);
+      writeRegionMap(FOS, 0);
+    }
+    return false;
+  }
+
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  OP *HlslOP = DM.GetOP();
+  Function *EntryFunction = DM.GetEntryFunction();
+
+  bool UseWaveAggregation = WaveAggregate && pix_dxil::WaveAggregation::Enable(DM);
+
+  // Find the points to record at before instrumenting, since the wave aggregation splits the blocks.
+  // A block is entered in the region of its first instruction that has a location, and left in the
+  // region of its last; a block without one passes through whatever region it is entered in.
+  std::map<BasicBlock *, std::pair<int, int>> BlockRegions;
+  for (BasicBlock &BB : *EntryFunction) {
+    std::pair<int, int> FirstAndLast(-1, -1);
+    for (Instruction &I : BB) {
+      int Region = getRegion(I);
+      if (Region >= 0) {
+        if (FirstAndLast.first < 0) {
+          FirstAndLast.first = Region;
+        }
+        FirstAndLast.second = Region;
+      }
+    }
+    BlockRegions[&BB] = FirstAndLast;
+  }
+
+  BasicBlock *EntryBlock = &EntryFunction->getEntryBlock();
+  uint32_t EntryRegion = std::max(BlockRegions[EntryBlock].first, 0);
+
+  std::vector<std::pair<Instruction *, uint32_t>> RecordPoints;
+  for (BasicBlock &BB : *EntryFunction) {
+    int CurrentRegion = -1;
+    for (Instruction &I : BB) {
+      if (isa<PHINode>(&I) || isa<AllocaInst>(&I)) {
+        continue;
+      }
+      if (isa<ReturnInst>(&I)) {
+        RecordPoints.emplace_back(&I, ExitRegion);
+        continue;
+      }
+      int Region = getRegion(I);
+      if (Region < 0 || Region == CurrentRegion) {
+        continue;
+      }
+      if (CurrentRegion < 0) {
+        // The entry record covers the entry block. Other blocks need a record unless every
+        // predecessor is known to leave in the same region.
+        bool NeedsRecord = false;
+        if (&BB != EntryBlock) {
+          for (BasicBlock *Pred : predecessors(&BB)) {
+            NeedsRecord |= BlockRegions[Pred].second != Region;
+          }
+        }
+        if (NeedsRecord) {
+          RecordPoints.emplace_back(&*BB.getFirstInsertionPt(), Region);
+        }
+      }
+      else {
+        RecordPoints.emplace_back(&I, Region);
+      }
+      CurrentRegion = Region;
+    }
+  }
+
+  if (OSOverride != nullptr) {
+    formatted_raw_ostream FOS(*OSOverride);
+    writeRegionMap(FOS, RingSize);
+  }
+
+  CallInst *HandleForUAV = addUAV(DM);
+
+  // The first record of each wave numbers the wave.
+  IRBuilder<> Builder(HandleForUAV->getNextNode());
+  Value *Wave = addRecord(HlslOP, Builder, Clock, HandleForUAV, nullptr, EntryRegion, UseWaveAggregation);
+  if (UseWaveAggregation) {
+    // Only the first lane took the number, so hand it to the rest of the wave.
+    BasicBlock *RecordBlock = Builder.GetInsertBlock();
+    BasicBlock *SkipBlock = RecordBlock->getSinglePredecessor();
+    BasicBlock *Tail = RecordBlock->getTerminator()->getSuccessor(0);
+    Builder.SetInsertPoint(Tail, Tail->begin());
+    PHINode *FirstLaneWave = Builder.CreatePHI(Wave->getType(), 2);
+    FirstLaneWave->addIncoming(Wave, RecordBlock);
+    FirstLaneWave->addIncoming(UndefValue::get(Wave->getType()), SkipBlock);
+    Function *ReadFirstFunc = HlslOP->GetOpFunc(OP::OpCode::WaveReadLaneFirst, Wave->getType());
+    Constant *ReadFirstOpcode = HlslOP->GetU32Const((unsigned)OP::OpCode::WaveReadLaneFirst);
+    Wave = Builder.CreateCall(ReadFirstFunc, { ReadFirstOpcode, FirstLaneWave }, "TimestampWave");
+  }
+
+  for (auto &RecordPoint : RecordPoints) {
+    IRBuilder<> RecordBuilder(RecordPoint.first);
+    addRecord(HlslOP, RecordBuilder, Clock, HandleForUAV, Wave, RecordPoint.second, UseWaveAggregation);
+  }
+
+  return true;
+}
+
+char DxilTimestampInstrumentation::ID = 0;
+
+ModulePass *llvm::createDxilTimestampInstrumentationPass() {
+  return new DxilTimestampInstrumentation();
+}
+
+INITIALIZE_PASS(DxilTimestampInstrumentation, "hlsl-dxil-timestamp-instrumentation", "HLSL DXIL timestamp instrumentation for PIX", false, false)
@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilRootSignatureOptimizer.cpp                                            //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Proposes root signature layouts for the shaders they bind.                //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/DxilRootSignature/DxilRootSignature.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/dxcapi.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "DxilRootSignatureHelper.h"
+
+using namespace llvm;
+
+namespace hlsl {
+
+namespace {
+
+// Root signatures are limited to 64 DWORDs.
+static const unsigned kMaxRootSignatureDWords = 64;
+
+// A shader binding, as the PSV describes it.
+struct ShaderBinding {
+  DxilShaderVisibility Visibility;
+  DxilDescriptorRangeType RangeType;
+  PSVResourceType ResType;
+  uint32_t Space, LowerBound, UpperBound;
+};
+
+// How a parameter of the original root signature is used and laid out.
+struct ParameterInfo {
+  unsigned Index;
+  uint32_t Frequency;
+  DxilRootParameterType NewType;
+  bool bUsed;
+  // Whether every binding read through the parameter is a single buffer
+  // that a root descriptor could hold.
+  bool bRootDescriptorCompatible;
+};
+
+DxilShaderVisibility GetShaderVisibility(DXIL::ShaderKind ShaderKind) {
+  switch (ShaderKind) {
+  case DXIL::ShaderKind::Pixel:    return DxilShaderVisibility::Pixel;
+  case DXIL::ShaderKind::Vertex:   return DxilShaderVisibility::Vertex;
+  case DXIL::ShaderKind::Geometry: return DxilShaderVisibility::Geometry;
+  case DXIL::ShaderKind::Hull:     return DxilShaderVisibility::Hull;
+  case DXIL::ShaderKind::Domain:   return DxilShaderVisibility::Domain;
+  default:                         return DxilShaderVisibility::All;
+  }
+}
+
+bool GetRangeType(PSVResourceType ResType, DxilDescriptorRangeType &RangeType) {
+  switch (ResType) {
+  case PSVResourceType::Sampler:
+    RangeType = DxilDescriptorRangeType::Sampler;
+    return true;
+  case PSVResourceType::CBV:
+    RangeType = DxilDescriptorRangeType::CBV;
+    return true;
+  case PSVResourceType::SRVTyped:
+  case PSVResourceType::SRVRaw:
+  case PSVResourceType::SRVStructured:
+    RangeType = DxilDescriptorRangeType::SRV;
+    return true;
+  case PSVResourceType::UAVTyped:
+  case PSVResourceType::UAVRaw:
+  case PSVResourceType::UAVStructured:
+  case PSVResourceType::UAVStructuredWithCounter:
+    RangeType = DxilDescriptorRangeType::UAV;
+    return true;
+  default:
+    return false;
+  }
+}
+
+DxilRootParameterType GetRootDescriptorType(DxilDescriptorRangeType RangeType) {
+  switch (RangeType) {
+  case DxilDescriptorRangeType::CBV: return DxilRootParameterType::CBV;
+  case DxilDescriptorRangeType::SRV: return DxilRootParameterType::SRV;
+  default:
+    DXASSERT_NOMSG(RangeType == DxilDescriptorRangeType::UAV);
+    return DxilRootParameterType::UAV;
+  }
+}
+
+unsigned GetParameterDWords(const DxilRootParameter1 &P,
+                            DxilRootParameterType Type) {
+  switch (Type) {
+  case DxilRootParameterType::DescriptorTable:
+    return 1;
+  case DxilRootParameterType::Constants32Bit:
+    return P.Constants.Num32BitValues;
+  default:
+    return 2;
+  }
+}
+
+void GatherShaderBindings(const DxilRootSignatureShader &Shader,
+                          std::vector<ShaderBinding> &Bindings) {
+  DxilPipelineStateValidation PSV;
+  IFTBOOL(PSV.InitFromPSV0(Shader.pPSVData, Shader.PSVSize), E_INVALIDARG);
+  for (unsigned i = 0; i < PSV.GetBindCount(); ++i) {
+    const PSVResourceBindInfo0 *pBindInfo0 = PSV.GetPSVResourceBindInfo0(i);
+    ShaderBinding B;
+    B.ResType = (PSVResourceType)pBindInfo0->ResType;
+    if (!GetRangeType(B.ResType, B.RangeType))
+      continue;
+    B.Visibility = GetShaderVisibility(Shader.ShaderKind);
+    B.Space = pBindInfo0->Space;
+    B.LowerBound = pBindInfo0->LowerBound;
+    B.UpperBound = pBindInfo0->UpperBound;
+    Bindings.push_back(B);
+  }
+}
+
+bool IsVisible(const DxilRootParameter1 &P, const ShaderBinding &B) {
+  return P.ShaderVisibility == DxilShaderVisibility::All ||
+         P.ShaderVisibility == B.Visibility;
+}
+
+// Whether a binding reads registers [Base, Base + Num - 1] of a space;
+// bSingle tells whether it reads a single buffer.
+bool IsRead(const ShaderBinding &B, DxilDescriptorRangeType RangeType,
+            uint32_t Space, uint32_t Base, uint32_t Num, bool &bSingle) {
+  if (B.RangeType != RangeType || B.Space != Space)
+    return false;
+  uint32_t Last = (Num == UINT_MAX || UINT_MAX - Base < Num - 1)
+                      ? UINT_MAX
+                      : Base + (Num - 1);
+  if (B.UpperBound < Base || Last < B.LowerBound)
+    return false;
+  bSingle = B.LowerBound == B.UpperBound &&
+            B.ResType != PSVResourceType::SRVTyped &&
+            B.ResType != PSVResourceType::UAVTyped &&
+            B.ResType != PSVResourceType::UAVStructuredWithCounter;
+  return true;
+}
+
+void AnalyzeParameter(const DxilRootParameter1 &P,
+                      const std::vector<ShaderBinding> &Bindings,
+                      ParameterInfo &Info) {
+  Info.bUsed = false;
+  Info.bRootDescriptorCompatible = true;
+  for (const ShaderBinding &B : Bindings) {
+    if (!IsVisible(P, B))
+      continue;
+    bool bSingle = false;
+    switch (P.ParameterType) {
+    case DxilRootParameterType::DescriptorTable:
+      for (unsigned i = 0; i < P.DescriptorTable.NumDescriptorRanges; ++i) {
+        const DxilDescriptorRange1 &R = P.DescriptorTable.pDescriptorRanges[i];
+        if (IsRead(B, R.RangeType, R.RegisterSpace, R.BaseShaderRegister,
+                   R.NumDescriptors, bSingle)) {
+          Info.bUsed = true;
+          Info.bRootDescriptorCompatible &= bSingle;
+        }
+      }
+      break;
+    case DxilRootParameterType::Constants32Bit:
+      if (IsRead(B, DxilDescriptorRangeType::CBV, P.Constants.RegisterSpace,
+                 P.Constants.ShaderRegister, 1, bSingle))
+        Info.bUsed = true;
+      break;
+    case DxilRootParameterType::CBV:
+    case DxilRootParameterType::SRV:
+    case DxilRootParameterType::UAV: {
+      DxilDescriptorRangeType RangeType =
+          P.ParameterType == DxilRootParameterType::CBV
+              ? DxilDescriptorRangeType::CBV
+              : P.ParameterType == DxilRootParameterType::SRV
+                    ? DxilDescriptorRangeType::SRV
+                    : DxilDescriptorRangeType::UAV;
+      if (IsRead(B, RangeType, P.Descriptor.RegisterSpace,
+                 P.Descriptor.ShaderRegister, 1, bSingle))
+        Info.bUsed = true;
+      break;
+    }
+    }
+  }
+}
+
+// Whether a descriptor table could be a root descriptor instead.
+bool IsSingleBufferTable(const DxilRootParameter1 &P) {
+  if (P.ParameterType != DxilRootParameterType::DescriptorTable ||
+      P.DescriptorTable.NumDescriptorRanges != 1)
+    return false;
+  const DxilDescriptorRange1 &R = P.DescriptorTable.pDescriptorRanges[0];
+  return R.NumDescriptors == 1 &&
+         R.RangeType != DxilDescriptorRangeType::Sampler;
+}
+
+void CopyParameter(const DxilRootParameter1 &In, DxilRootParameterType NewType,
+                   DxilRootParameter1 &Out) {
+  Out.ParameterType = NewType;
+  Out.ShaderVisibility = In.ShaderVisibility;
+  if (NewType == In.ParameterType) {
+    if (NewType == DxilRootParameterType::DescriptorTable) {
+      unsigned NumRanges = In.DescriptorTable.NumDescriptorRanges;
+      DxilDescriptorRange1 *pRanges = new DxilDescriptorRange1[NumRanges];
+      std::copy(In.DescriptorTable.pDescriptorRanges,
+                In.DescriptorTable.pDescriptorRanges + NumRanges, pRanges);
+      Out.DescriptorTable.NumDescriptorRanges = NumRanges;
+      Out.DescriptorTable.pDescriptorRanges = pRanges;
+    } else if (NewType == DxilRootParameterType::Constants32Bit) {
+      Out.Constants = In.Constants;
+    } else {
+      Out.Descriptor = In.Descriptor;
+    }
+    return;
+  }
+  if (In.ParameterType == DxilRootParameterType::Constants32Bit) {
+    DXASSERT_NOMSG(NewType == DxilRootParameterType::CBV);
+    Out.Descriptor.ShaderRegister = In.Constants.ShaderRegister;
+    Out.Descriptor.RegisterSpace = In.Constants.RegisterSpace;
+    Out.Descriptor.Flags = DxilRootDescriptorFlags::None;
+    return;
+  }
+  DXASSERT_NOMSG(IsSingleBufferTable(In));
+  const DxilDescriptorRange1 &R = In.DescriptorTable.pDescriptorRanges[0];
+  Out.Descriptor.ShaderRegister = R.BaseShaderRegister;
+  Out.Descriptor.RegisterSpace = R.RegisterSpace;
+  // The data flags of ranges and root descriptors share their values.
+  Out.Descriptor.Flags = (DxilRootDescriptorFlags)(
+      (unsigned)R.Flags & (unsigned)DxilRootDescriptorFlags::ValidFlags);
+}
+
+} // namespace
+
+_Use_decl_annotations_
+bool OptimizeRootSignature(const DxilVersionedRootSignatureDesc *pDesc,
+                           const uint32_t *pUpdateFrequencies,
+                           const DxilRootSignatureShader *pShaders,
+                           uint32_t ShaderCount, IDxcBlob **ppBlob,
+                           DxilRootParameterRemap *pRemap,
+                           llvm::raw_ostream &DiagStream) {
+  DXASSERT_NOMSG(pDesc != nullptr && ppBlob != nullptr);
+  *ppBlob = nullptr;
+  try {
+    // The layout must keep binding every shader.
+    for (uint32_t i = 0; i < ShaderCount; ++i) {
+      if (!VerifyRootSignatureWithShaderPSV(pDesc, pShaders[i].ShaderKind,
+                                            pShaders[i].pPSVData,
+                                            pShaders[i].PSVSize, DiagStream))
+        return false;
+    }
+
+    RootSignatureHandle Converted;
+    const DxilVersionedRootSignatureDesc *pDesc1 = pDesc;
+    if (pDesc->Version != DxilRootSignatureVersion::Version_1_1) {
+      ConvertRootSignature(pDesc, DxilRootSignatureVersion::Version_1_1,
+                           &pDesc1);
+      Converted.Assign(pDesc1, nullptr);
+    }
+    const DxilRootSignatureDesc1 &RS = pDesc1->Desc_1_1;
+
+    std::vector<ShaderBinding> Bindings;
+    for (uint32_t i = 0; i < ShaderCount; ++i)
+      GatherShaderBindings(pShaders[i], Bindings);
+
+    std::vector<ParameterInfo> Infos(RS.NumParameters);
+    unsigned DWords = 0;
+    for (unsigned i = 0; i < RS.NumParameters; ++i) {
+      ParameterInfo &Info = Infos[i];
+      const DxilRootParameter1 &P = RS.pParameters[i];
+      Info.Index = i;
+      Info.Frequency = pUpdateFrequencies ? pUpdateFrequencies[i] : 0;
+      Info.NewType = P.ParameterType;
+      AnalyzeParameter(P, Bindings, Info);
+      if (!Info.bUsed)
+        continue;
+      // Static root constants only take up space; a buffer holds them.
+      if (P.ParameterType == DxilRootParameterType::Constants32Bit &&
+          Info.Frequency == 0 && P.Constants.Num32BitValues > 2)
+        Info.NewType = DxilRootParameterType::CBV;
+      DWords += GetParameterDWords(P, Info.NewType);
+    }
+
+    // Rank what stays by update frequency, then by size.
+    std::vector<ParameterInfo *> Order;
+    for (ParameterInfo &Info : Infos) {
+      if (Info.bUsed)
+        Order.push_back(&Info);
+    }
+    std::stable_sort(Order.begin(), Order.end(),
+                     [&](const ParameterInfo *L, const ParameterInfo *R) {
+      if (L->Frequency != R->Frequency)
+        return L->Frequency > R->Frequency;
+      return GetParameterDWords(RS.pParameters[L->Index], L->NewType) <
+             GetParameterDWords(RS.pParameters[R->Index], R->NewType);
+    });
+
+    // Setting a root descriptor saves writing a descriptor to the heap for
+    // each update; spend the space left on the most frequent ones.
+    for (ParameterInfo *Info : Order) {
+      const DxilRootParameter1 &P = RS.pParameters[Info->Index];
+      if (Info->Frequency == 0 || !Info->bRootDescriptorCompatible ||
+          !IsSingleBufferTable(P) || DWords + 1 > kMaxRootSignatureDWords)
+        continue;
+      Info->NewType =
+          GetRootDescriptorType(P.DescriptorTable.pDescriptorRanges[0].RangeType);
+      DWords += 1;
+    }
+
+    DxilVersionedRootSignatureDesc *pNewDesc =
+        new DxilVersionedRootSignatureDesc();
+    memset(pNewDesc, 0, sizeof(*pNewDesc));
+    RootSignatureHandle Result;
+    Result.Assign(pNewDesc, nullptr);
+    pNewDesc->Version = DxilRootSignatureVersion::Version_1_1;
+    DxilRootSignatureDesc1 &NewRS = pNewDesc->Desc_1_1;
+    NewRS.Flags = RS.Flags;
+    if (!Order.empty()) {
+      NewRS.pParameters = new DxilRootParameter1[Order.size()];
+      memset(NewRS.pParameters, 0, Order.size() * sizeof(DxilRootParameter1));
+    }
+    for (unsigned i = 0; i < RS.NumParameters; ++i) {
+      pRemap[i].NewIndex = DxilRootParameterRemoved;
+      pRemap[i].NewType = RS.pParameters[i].ParameterType;
+    }
+    for (ParameterInfo *Info : Order) {
+      CopyParameter(RS.pParameters[Info->Index], Info->NewType,
+                    NewRS.pParameters[NewRS.NumParameters]);
+      pRemap[Info->Index].NewIndex = NewRS.NumParameters++;
+      pRemap[Info->Index].NewType = Info->NewType;
+    }
+    if (RS.NumStaticSamplers > 0) {
+      NewRS.pStaticSamplers = new DxilStaticSamplerDesc[RS.NumStaticSamplers];
+      std::copy(RS.pStaticSamplers, RS.pStaticSamplers + RS.NumStaticSamplers,
+                NewRS.pStaticSamplers);
+      NewRS.NumStaticSamplers = RS.NumStaticSamplers;
+    }
+
+    // Give back the version that came in.
+    const DxilVersionedRootSignatureDesc *pOutDesc = pNewDesc;
+    RootSignatureHandle Reverted;
+    if (pDesc->Version != DxilRootSignatureVersion::Version_1_1) {
+      ConvertRootSignature(pNewDesc, pDesc->Version, &pOutDesc);
+      Reverted.Assign(pOutDesc, nullptr);
+    }
+    for (uint32_t i = 0; i < ShaderCount; ++i) {
+      if (!VerifyRootSignatureWithShaderPSV(pOutDesc, pShaders[i].ShaderKind,
+                                            pShaders[i].pPSVData,
+                                            pShaders[i].PSVSize, DiagStream))
+        return false;
+    }
+
+    CComPtr<IDxcBlob> pBlob;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    SerializeRootSignature(pOutDesc, &pBlob, &pErrors, false);
+    if (pErrors) {
+      DiagStream << StringRef((const char *)pErrors->GetBufferPointer(),
+                              pErrors->GetBufferSize());
+      return false;
+    }
+    IFTBOOL(pBlob != nullptr, E_FAIL);
+    *ppBlob = pBlob.Detach();
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
+
+} // namespace hlsl
@@ -18,6 +18,7 @@
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/dxcapi.h"
 
+#include "llvm/ADT/Hashing.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 
@@ -26,6 +27,8 @@
 #include <utility>
 #include <vector>
 #include <set>
+#include <mutex>
+#include <unordered_map>
 
 #include "DxilRootSignatureHelper.h"
 
@@ -44,7 +47,7 @@ class CIntervalCollection {
 private:
   std::set<T> m_set;
 public:
-  const T* FindIntersectingInterval(const T &I) {
+  const T* FindIntersectingInterval(const T &I) const {
     auto it = m_set.find(I);
     if (it != m_set.end())
       return &*it;
@@ -87,7 +90,7 @@ public:
   void VerifyShader(DxilShaderVisibility VisType,
                     const void *pPSVData,
                     uint32_t PSVSize,
-                    DiagnosticPrinter &DiagPrinter);
+                    DiagnosticPrinter &DiagPrinter) const;
 
   typedef enum NODE_TYPE {
     DESCRIPTOR_TABLE_ENTRY,
@@ -139,12 +142,17 @@ private:
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space);
+                                            unsigned Space) const;
 
   RegisterRanges &
   GetRanges(DxilShaderVisibility VisType, DxilDescriptorRangeType DescType) {
     return RangeKinds[(unsigned)VisType][(unsigned)DescType];
   }
+  const RegisterRanges &
+  GetRanges(DxilShaderVisibility VisType,
+            DxilDescriptorRangeType DescType) const {
+    return RangeKinds[(unsigned)VisType][(unsigned)DescType];
+  }
 
   RegisterRanges RangeKinds[kMaxVisType + 1][kMaxDescType + 1];
   bool m_bAllowReservedRegisterSpace;
@@ -369,7 +377,7 @@ RootSignatureVerifier::FindCoveringInterval(DxilDescriptorRangeType RangeType,
                                             DxilShaderVisibility VisType,
                                             unsigned Num,
                                             unsigned LB,
-                                            unsigned Space) {
+                                            unsigned Space) const {
   RegisterRange RR;
   RR.space = Space;
   RR.lb = LB;
@@ -560,7 +568,7 @@ void RootSignatureVerifier::VerifyRootSignature(
 void RootSignatureVerifier::VerifyShader(DxilShaderVisibility VisType,
                                          const void *pPSVData,
                                          uint32_t PSVSize,
-                                         DiagnosticPrinter &DiagPrinter) {
+                                         DiagnosticPrinter &DiagPrinter) const {
   DxilPipelineStateValidation PSV;
   IFTBOOL(PSV.InitFromPSV0(pPSVData, PSVSize), E_INVALIDARG);
 
@@ -842,4 +850,135 @@ bool VerifyRootSignature(_In_ const DxilVersionedRootSignatureDesc *pDesc,
   return true;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+// Root signature cache.
+
+CachedRootSignature::CachedRootSignature(const void *pData, uint32_t length) {
+  m_Handle.LoadSerialized((const uint8_t *)pData, length);
+  m_Handle.Deserialize();
+  IFTBOOL(m_Handle.GetDesc() != nullptr, E_FAIL);
+
+  raw_string_ostream DiagStream(m_Diag);
+  try {
+    std::unique_ptr<RootSignatureVerifier> pVerifier(
+        new RootSignatureVerifier());
+    DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+    pVerifier->VerifyRootSignature(m_Handle.GetDesc(), DiagPrinter);
+    m_pVerifier = std::move(pVerifier);
+  } catch (...) {
+  }
+  DiagStream.flush();
+}
+
+CachedRootSignature::~CachedRootSignature() {}
+
+bool CachedRootSignature::VerifyShaderPSV(DXIL::ShaderKind ShaderKind,
+                                          const void *pPSVData,
+                                          uint32_t PSVSize,
+                                          llvm::raw_ostream &DiagStream) const {
+  if (!m_pVerifier) {
+    DiagStream << m_Diag;
+    return false;
+  }
+  try {
+    DiagnosticPrinterRawOStream DiagPrinter(DiagStream);
+    m_pVerifier->VerifyShader(GetVisibilityType(ShaderKind), pPSVData, PSVSize,
+                              DiagPrinter);
+  } catch (...) {
+    return false;
+  }
+  return true;
+}
+
+namespace {
+// Few distinct root signatures are expected; past this many, the cache
+// starts over rather than growing.
+static const size_t kMaxCachedRootSignatures = 256;
+
+// The cache and its entries outlive the compile that filled them, and the
+// last reference to an entry may go away during another compile, with
+// another allocator for the thread. So all of it is allocated and freed
+// with the default allocator, whatever the thread uses at the time.
+template <typename T> struct DefaultMallocAllocator {
+  typedef T value_type;
+  DefaultMallocAllocator() {}
+  template <typename U>
+  DefaultMallocAllocator(const DefaultMallocAllocator<U> &) {}
+  T *allocate(size_t n) {
+    DxcThreadMalloc TM(nullptr);
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T *p, size_t) {
+    DxcThreadMalloc TM(nullptr);
+    ::operator delete(p);
+  }
+  template <typename U>
+  bool operator==(const DefaultMallocAllocator<U> &) const { return true; }
+  template <typename U>
+  bool operator!=(const DefaultMallocAllocator<U> &) const { return false; }
+};
+
+struct DefaultMallocDelete {
+  void operator()(const CachedRootSignature *p) const {
+    DxcThreadMalloc TM(nullptr);
+    delete p;
+  }
+};
+
+struct RootSignatureCache {
+  std::mutex Mutex;
+  std::unordered_multimap<size_t, std::shared_ptr<const CachedRootSignature>>
+      Entries;
+};
+
+RootSignatureCache &GetRootSignatureCache() {
+  static RootSignatureCache Cache;
+  return Cache;
+}
+} // namespace
+
+_Use_decl_annotations_
+std::shared_ptr<const CachedRootSignature>
+GetCachedRootSignature(const void *pData, uint32_t length) {
+  size_t Hash = (size_t)hash_combine_range((const char *)pData,
+                                           (const char *)pData + length);
+  DxcThreadMalloc TM(nullptr);
+  RootSignatureCache &Cache = GetRootSignatureCache();
+  auto Find = [&]() -> std::shared_ptr<const CachedRootSignature> {
+    auto Range = Cache.Entries.equal_range(Hash);
+    for (auto it = Range.first; it != Range.second; ++it) {
+      const RootSignatureHandle &Handle = it->second->GetHandle();
+      if (Handle.GetSerializedSize() == length &&
+          0 == memcmp(Handle.GetSerializedBytes(), pData, length))
+        return it->second;
+    }
+    return nullptr;
+  };
+  {
+    std::lock_guard<std::mutex> lock(Cache.Mutex);
+    if (std::shared_ptr<const CachedRootSignature> pEntry = Find())
+      return pEntry;
+  }
+
+  // Deserialize and verify outside of the lock; if another thread added the
+  // same blob meanwhile, keep the one in the cache.
+  std::shared_ptr<const CachedRootSignature> pEntry(
+      new CachedRootSignature(pData, length), DefaultMallocDelete(),
+      DefaultMallocAllocator<CachedRootSignature>());
+  std::lock_guard<std::mutex> lock(Cache.Mutex);
+  if (std::shared_ptr<const CachedRootSignature> pExisting = Find())
+    return pExisting;
+  if (Cache.Entries.size() >= kMaxCachedRootSignatures)
+    Cache.Entries.clear();
+  Cache.Entries.emplace(Hash, pEntry);
+  return pEntry;
+}
+
+void ClearRootSignatureCache() {
+  DxcThreadMalloc TM(nullptr);
+  RootSignatureCache &Cache = GetRootSignatureCache();
+  std::lock_guard<std::mutex> lock(Cache.Mutex);
+  Cache.Entries.clear();
+}
+
 } // namespace hlsl
@@ -186,6 +186,9 @@ void DxrFallbackCompiler::link(std::vector<int>& shaderEntryStateIds, std::vecto
         }
     }
     
+    if (m_stackSizeInBytes == 0 && m_maxTraceRecursionDepth > 0)
+      m_stackSizeInBytes = getPipelineStackSize(shaderStackSizes);
+
     // Fix up scheduler
     Function* schedulerFunc = m_module->getFunction("fb_Fallback_Scheduler");
     createLaunchParams(schedulerFunc);
@@ -203,6 +206,11 @@ void DxrFallbackCompiler::setDebugOutputLevel(int val)
   m_debugOutputLevel = val;
 }
 
+void DxrFallbackCompiler::setMaxTraceRecursionDepth(unsigned depth)
+{
+  m_maxTraceRecursionDepth = depth;
+}
+
 static bool isShader(Function* F)
 {
   if (F->hasFnAttribute("exp-shader"))
@@ -551,6 +559,50 @@ void DxrFallbackCompiler::createStateFunctions(
   StateFunctionTransform::finalizeStateIds(m_module, shaderEntryStateIds);
 }
 
+// Returns the largest stack the shaders can use under the recursion limit, or 
+// 0 if there is no bound. Each level of recursion holds the frame of the 
+// shader calling TraceRay() and the frames of functions that aren't shaders, 
+// like the traversal. Intersection and anyhit frames are only on the stack 
+// during traversal, so they are counted once.
+unsigned DxrFallbackCompiler::getPipelineStackSize(const std::vector<unsigned int>& shaderStackSizes)
+{
+  unsigned raygen = 0, closestHitOrMiss = 0, intersection = 0, anyHit = 0, other = 0;
+  for (size_t i = 0; i < m_entryShaderNames.size() && i < shaderStackSizes.size(); ++i)
+  {
+    Function* F = m_module->getFunction(m_entryShaderNames[i] + ".ss_0");
+    DXIL::ShaderKind kind = F ? getRayShaderKind(F) : DXIL::ShaderKind::Invalid;
+    unsigned size = shaderStackSizes[i];
+    switch (kind)
+    {
+    case DXIL::ShaderKind::RayGeneration:
+      raygen = std::max(raygen, size);
+      break;
+    case DXIL::ShaderKind::ClosestHit:
+    case DXIL::ShaderKind::Miss:
+      closestHitOrMiss = std::max(closestHitOrMiss, size);
+      break;
+    case DXIL::ShaderKind::Intersection:
+      intersection = std::max(intersection, size);
+      break;
+    case DXIL::ShaderKind::AnyHit:
+      anyHit = std::max(anyHit, size);
+      break;
+    case DXIL::ShaderKind::Callable:
+      return 0; // Callable shaders can recurse without limit
+    default:
+      other += size; // Unknown, so assume they can all be nested
+      break;
+    }
+  }
+
+  uint64_t size = sizeof(int) // the final return stateID at the top
+    + raygen
+    + (uint64_t)m_maxTraceRecursionDepth * (closestHitOrMiss + other)
+    + intersection + anyHit;
+  size = (size + sizeof(int) - 1) & ~(uint64_t)(sizeof(int) - 1);
+  return size > UINT_MAX ? 0 : (unsigned)size;
+}
+
 void DxrFallbackCompiler::createLaunchParams(Function* func)
 {
   Module* module = func->getParent();
@@ -3,6 +3,7 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -12,9 +13,12 @@
 
 #include "LLVMUtils.h"
 
+#include <algorithm>
 #include <fstream>
-#include <vector>
 #include <map>
+#include <memory>
+#include <set>
+#include <vector>
 
 #define DBGS errs
 //#define DBGS dbgs
@@ -246,8 +250,115 @@ static Node* split(Node* N, std::map<BasicBlock*, Node*>& bbToNode, bool firstSp
   return Np;
 }
 
+// Applies the T1 (remove self edges) and T2 (fold a node into its only
+// predecessor) transformations to the nodes on the work list, and to any 
+// node they change, until none applies. Removed nodes are added to removed.
+static void reduce(std::vector<Node*>& workList, std::set<Node*>& removed)
+{
+  while (!workList.empty())
+  {
+    Node* N = workList.back();
+    workList.pop_back();
+    if (removed.count(N))
+      continue;
+
+    // Remove self references
+    if (N->in.count(N))
+    {
+      N->in.remove(N);
+      N->out.remove(N);
+    }
+
+    // Remove singletons
+    if (N->in.size() == 0 && N->out.size() == 0)
+    {
+      removed.insert(N);
+      continue;
+    }
+
+    // Remove nodes with only one incoming edge
+    if (N->in.size() == 1)
+    {
+      // fold into predecessor
+      Node* P = N->in.back();
+      P->blocks.insert(N->blocks.begin(), N->blocks.end());
+      P->out.remove(N);
+      for (Node* S : N->out)
+      {
+        S->in.remove(N);
+        P->out.insert(S);
+        S->in.insert(P);
+        workList.push_back(S);
+      }
+      P->numInstructions += N->numInstructions;
+      removed.insert(N);
+      workList.push_back(P);
+    }
+  }
+}
+
+// Routes the edges into the entries of the remaining nodes with more than one
+// predecessor through a single block, which branches on a selector variable 
+// to the entry that was meant. Each of these entries is then only entered 
+// from that block, which makes the graph reducible without duplicating code.
+// Returns the number of entries.
+static int dispatch(const std::vector<Node*>& nodes, Function* F, bool demoted)
+{
+  // Run reg2mem on the whole function so we don't have to deal with phis or
+  // with values that no longer dominate their uses.
+  if (!demoted)
+  {
+    runPasses(F, {
+      createDemoteRegisterToMemoryPass()
+    });
+  }
+
+  std::vector<Node*> entryNodes;
+  for (Node* N : nodes)
+  {
+    if (N->in.size() > 1)
+      entryNodes.push_back(N);
+  }
+
+  LLVMContext& C = F->getContext();
+  IntegerType* int32Ty = Type::getInt32Ty(C);
+  AllocaInst* selector = new AllocaInst(int32Ty, "irr.selector", F->getEntryBlock().begin());
+  BasicBlock* dispatchBlock = BasicBlock::Create(C, "irr.dispatch", F);
+  Value* selectorVal = new LoadInst(selector, "irr.selector.val", dispatchBlock);
+  SwitchInst* switchInst = SwitchInst::Create(selectorVal, entryNodes[0]->blocks[0], entryNodes.size(), dispatchBlock);
+  for (size_t i = 0; i < entryNodes.size(); ++i)
+  {
+    Node* N = entryNodes[i];
+    BasicBlock* entry = N->blocks[0];
+    ConstantInt* selectorIdx = ConstantInt::get(int32Ty, i);
+    if (i > 0)
+      switchInst->addCase(selectorIdx, entry);
+
+    // Edges from within N are loops on its entry and can stay.
+    SetVector<BasicBlock*> preds;
+    for (BasicBlock* B : predecessors(entry))
+    {
+      if (B != dispatchBlock && !N->blocks.count(B))
+        preds.insert(B);
+    }
+    for (BasicBlock* B : preds)
+    {
+      BasicBlock* edgeBlock = BasicBlock::Create(C, entry->getName() + ".irr.entry", F, dispatchBlock);
+      new StoreInst(selectorIdx, selector, edgeBlock);
+      BranchInst::Create(dispatchBlock, edgeBlock);
+      TerminatorInst* term = B->getTerminator();
+      for (unsigned j = 0; j < term->getNumSuccessors(); ++j)
+      {
+        if (term->getSuccessor(j) == entry)
+          term->setSuccessor(j, edgeBlock);
+      }
+    }
+  }
+  return entryNodes.size();
+}
+
 // Returns the number of splits
-int makeReducible(Function* F)
+int makeReducible(Function* F, ReducibilityCost* pCost)
 {
   // Break critical edges now in case we need to do mem2reg in split(). mem2reg
   // will break critical edges and the CFG needs to remain unchanged.
@@ -256,12 +367,16 @@ int makeReducible(Function* F)
   });
 
   // initialize nodes
+  std::vector<std::unique_ptr<Node>> allNodes;
   std::vector<Node*> nodes;
   std::map<BasicBlock*, Node*> bbToNode;
+  size_t numInstructions = 0;
   for (BasicBlock& B : *F)
   {
-    nodes.push_back(new Node(&B));
+    allNodes.emplace_back(new Node(&B));
+    nodes.push_back(allNodes.back().get());
     bbToNode[&B] = nodes.back();
+    numInstructions += B.size();
   }
 
   // initialize edges
@@ -275,82 +390,56 @@ int makeReducible(Function* F)
     }
   }
 
+  // Splitting may at most double the size of the function. With pathological
+  // control flow it could otherwise grow exponentially.
+  const size_t duplicationBudget = std::max<size_t>(numInstructions, 64);
+
   int step = 0;
   bool print = false;
   if (print) printDotGraph(nodes, F, step++);
 
-  int numSplits = 0;
-  while (!nodes.empty())
+  ReducibilityCost cost;
+  std::set<Node*> removed;
+  std::vector<Node*> workList(nodes.rbegin(), nodes.rend());
+  for (;;)
   {
-    bool changed;
-    do
+    reduce(workList, removed);
+    nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&removed](Node* N) { return removed.count(N) != 0; }), nodes.end());
+    if (print) printDotGraph(nodes, F, step++);
+
+    // Duplicate the smallest node with more than one incoming edge. Better 
+    // methods exist for picking the node to split, e.g. "Making Graphs Reducible
+    // with Controlled Node Splitting" by Janssen and Corporaal.
+    Node* Nmin = nullptr;
+    for (Node* N : nodes)
     {
-  // It might more efficient to use a worklist based implementation instead
-  // of iterating over the vector.
-      changed = false;
-      for (size_t i = 0; i < nodes.size(); )
-      {
-        Node* N = nodes[i];
-
-        // Remove self references
-        if (N->in.count(N))
-        {
-          N->in.remove(N);
-          N->out.remove(N);
-          changed = true;
-        }
-
-        // Remove singletons
-        if (N->in.size() == 0 && N->out.size() == 0)
-        {
-          nodes.erase(nodes.begin() + i);
-          changed = true;
-          if (print) printDotGraph(nodes, F, step++);
-          continue;
-        }
-
-        // Remove nodes with only one incoming edge
-        if (N->in.size() == 1)
-        {
-          // fold into predecessor
-          Node* P = N->in.back();
-          P->blocks.insert(N->blocks.begin(), N->blocks.end());
-          P->out.remove(N);
-          for (Node* S : N->out)
-          {
-            S->in.remove(N);
-            P->out.insert(S);
-            S->in.insert(P);
-          }
-          P->numInstructions += N->numInstructions;
-          nodes.erase(nodes.begin() + i);
-          changed = true;
-          if (print) printDotGraph(nodes, F, step++);
-          continue;
-        }
+      if (N->in.size() <= 1)
+        continue;
 
-        i++;
-      }
-    } while (changed);
+      if (!Nmin || N->numInstructions < Nmin->numInstructions)
+        Nmin = N;
+    }
+    if (!Nmin)
+      break;
 
-    if (!nodes.empty())
+    if (cost.numDuplicatedInstructions + Nmin->numInstructions > duplicationBudget)
     {
-      // Duplicate the smallest node with more than one incoming edge. Better 
-      // methods exist for picking the node to split, e.g. "Making Graphs Reducible
-      // with Controlled Node Splitting" by Janssen and Corporaal.
-      size_t idxMin = ~0;
-      for (size_t i = 0; i < nodes.size(); ++i)
-      {
-        if (nodes[i]->in.size() <= 1)
-          continue;
-
-        if (idxMin == ~0 || nodes[i]->numInstructions < nodes[idxMin]->numInstructions)
-          idxMin = i;
-      }
-      nodes.push_back(split(nodes[idxMin], bbToNode, numSplits == 0));
-      numSplits++;
-      if (print) printDotGraph(nodes, F, step++);
+      cost.numDispatchedEntries = dispatch(nodes, F, cost.numSplits > 0);
+      break;
     }
+
+    Node* P = Nmin->in.back();
+    allNodes.emplace_back(split(Nmin, bbToNode, cost.numSplits == 0));
+    Node* Np = allNodes.back().get();
+    nodes.push_back(Np);
+    cost.numSplits++;
+    cost.numDuplicatedInstructions += Nmin->numInstructions;
+    workList.push_back(Nmin);
+    workList.push_back(Np);
+    workList.push_back(P);
   }
-  return numSplits;
+
+  if (pCost)
+    *pCost = cost;
+  return cost.numSplits;
 }
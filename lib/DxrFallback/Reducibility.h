@@ -1,10 +1,23 @@
 #pragma once
 
+#include <cstddef>
+
 namespace llvm
 {
   class Function;
 }
 
+// What it cost to make a control flow graph reducible.
+struct ReducibilityCost
+{
+  int numSplits = 0;                    // Nodes that were split
+  size_t numDuplicatedInstructions = 0; // Instructions cloned by the splits
+  int numDispatchedEntries = 0;         // Entries routed through a dispatch block
+};
+
 // Analyzes the reducibility of the control flow graph of F and uses node splitting
-// to make an irredicible CFG reducible. Returns the number of node splits.
-int makeReducible(llvm::Function* F);
\ No newline at end of file
+// to make an irredicible CFG reducible. Splitting stops before it would duplicate
+// more instructions than F has; the remaining irreducible entries are then 
+// routed through a dispatch block that switches on a selector variable. Returns
+// the number of node splits, and the full cost in pCost if it is given.
+int makeReducible(llvm::Function* F, ReducibilityCost* pCost = nullptr);
\ No newline at end of file
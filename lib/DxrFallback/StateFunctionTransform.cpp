@@ -518,7 +518,7 @@ public:
 
 
   // Returns true if inst can be rematerialized.
-  bool canRematerialize(Instruction* inst)
+  bool canRematerialize(Instruction* inst, int depth = 0)
   {
     if (CallInst* call = dyn_cast<CallInst>(inst))
     {
@@ -531,6 +531,12 @@ public:
         return true;
       if (funcName.startswith("dx.op.createHandle"))
         return true;
+      // Values that don't change over the lifetime of a ray are cheaper to 
+      // recompute than to carry on the stack.
+      if (funcName.startswith("dx.op.dispatchRaysIndex") ||
+          funcName.startswith("dx.op.dispatchRaysDimensions") ||
+          funcName.startswith("dx.op.cbufferLoad"))
+        return canRematerializeOperands(inst, depth);
     }
     else if (LoadInst* load = dyn_cast<LoadInst>(inst))
     {
@@ -545,22 +551,22 @@ public:
       assert(gep->hasAllConstantIndices() && "Unhandled non-constant index"); // Should have been changed to stack.ptr
       return true;
     }
+    else if (isa<CastInst>(inst) || isa<BinaryOperator>(inst) || isa<CmpInst>(inst) ||
+             isa<ExtractValueInst>(inst) || isa<ExtractElementInst>(inst))
+    {
+      // Cheap arithmetic on rematerializable values, e.g. the components of 
+      // a cbuffer load.
+      return canRematerializeOperands(inst, depth);
+    }
 
     return false;
   }
 
-
   // Rematerialize the given instruction and its dependency graph, adding 
   // any nonrematerializable values that are live in the function, but not 
   // at this callsite to the work list to insure that their values are restored.
-  Instruction* rematerialize(Instruction* inst, std::vector<Instruction *> workList, Instruction* insertBefore, int depth = 0)
+  Instruction* rematerialize(Instruction* inst, std::vector<Instruction *>& workList, Instruction* insertBefore, int depth = 0)
   {
-    // Signal if we hit a complex case. Deep rematerialization needs more analysis.
-    // To make this robust we would need to make it possible to run the current
-    // value through the live value handling pipeline: figure out where it is live,
-    // reg2mem, save/restore at appropriate callsites, etc.
-    assert(depth < 8);
-
     // Reuse an already rematerialized value?
     auto it = m_rematMap.find(inst);
     if (it != m_rematMap.end())
@@ -621,6 +627,36 @@ public:
 
 
 private:
+  // Maximum depth of an expression that is rematerialized instead of saved
+  static const int kMaxRematDepth = 4;
+
+  // Returns true if the operands of inst are available after the callsite:
+  // constants, reg2mem'd live values, which are restored or rematerialized 
+  // themselves, or values that can be rematerialized.
+  bool canRematerializeOperands(Instruction* inst, int depth)
+  {
+    if (depth >= kMaxRematDepth)
+      return false;
+
+    for (Value* op : inst->operands())
+    {
+      if (isa<Constant>(op))
+        continue;
+      Instruction* opInst = dyn_cast<Instruction>(op);
+      if (!opInst)
+        return false;
+      if (LoadInst* load = dyn_cast<LoadInst>(opInst))
+      {
+        AllocaInst* alloc = dyn_cast<AllocaInst>(load->getPointerOperand());
+        if (alloc && m_allocaToVal.count(alloc))
+          continue;
+      }
+      if (!canRematerialize(opInst, depth + 1))
+        return false;
+    }
+    return true;
+  }
+
   DenseMap<Instruction*, Instruction*> m_rematMap;    // Map instructions to their rematerialized counterparts
   DenseMap<AllocaInst*, Instruction*>& m_allocaToVal; // Map allocas for reg2mem'd live values back to the value
   const InstructionSetVector& m_liveHere;             // Values live at this callsite
@@ -1636,7 +1672,14 @@ Function* StateFunctionTransform::split(Function* baseFunc, BasicBlock* substate
 
   //printFunction( substateFunc, substateFunc->getName().str() + "-BeforeSplittingOpt", m_dumpId++ );
 
-  makeReducible(substateFunc);
+  ReducibilityCost cost;
+  makeReducible(substateFunc, &cost);
+  if (m_verbose && (cost.numSplits > 0 || cost.numDispatchedEntries > 0))
+  {
+    DBGS() << substateFunc->getName() << ": " << cost.numSplits << " node splits duplicating "
+           << cost.numDuplicatedInstructions << " instructions, " << cost.numDispatchedEntries
+           << " dispatched entries\n";
+  }
 
   // Undo the reg2mem done in preserveLiveValuesAcrossCallSites()
   runPasses(substateFunc, {
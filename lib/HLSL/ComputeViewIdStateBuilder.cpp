@@ -22,8 +22,10 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/Analysis/CallGraph.h"
+#include "llvm/ADT/SparseBitVector.h"
 
 #include <algorithm>
+#include <deque>
 
 using namespace llvm;
 using namespace llvm::legacy;
@@ -47,8 +49,9 @@ public:
   using OutputsDependentOnViewIdType = DxilViewIdStateData::OutputsDependentOnViewIdType;
   using InputsContributingToOutputType = DxilViewIdStateData::InputsContributingToOutputType;
 
-  DxilViewIdStateBuilder(DxilViewIdStateData &state, DxilModule *pDxilModule)
-      : m_pModule(pDxilModule),
+  DxilViewIdStateBuilder(DxilViewIdStateData &state, DxilModule *pDxilModule,
+                         ControlDependenceAnalysis &CtrlDepAnalysis)
+      : m_pModule(pDxilModule), m_CtrlDepAnalysis(CtrlDepAnalysis),
         m_NumInputSigScalars(state.m_NumInputSigScalars),
         m_NumOutputSigScalars(state.m_NumOutputSigScalars,
                               DxilViewIdStateData::kNumStreams),
@@ -68,6 +71,7 @@ private:
   static const unsigned kNumStreams = 4;
 
   DxilModule *m_pModule;
+  ControlDependenceAnalysis &m_CtrlDepAnalysis;
 
   unsigned &m_NumInputSigScalars;
   MutableArrayRef<unsigned> m_NumOutputSigScalars;
@@ -95,15 +99,24 @@ private:
   // Information per entry point.
   using FunctionSetType = std::unordered_set<llvm::Function *>;
   using InstructionSetType = std::unordered_set<llvm::Instruction *>;
+  // Indices of sources, the inputs and ViewID instructions of an entry.
+  using SourceSetType = llvm::SparseBitVector<>;
   struct EntryInfo {
     llvm::Function *pEntryFunc = nullptr;
     // Sets of functions that may be reachable from an entry.
     FunctionSetType Functions;
     // Outputs to analyze.
     InstructionSetType Outputs;
-    // Contributing instructions per output.
-    std::unordered_map<unsigned, InstructionSetType>
-        ContributingInstructions[kNumStreams];
+    // Contributing sources per output.
+    std::unordered_map<unsigned, SourceSetType>
+        ContributingSources[kNumStreams];
+    // Sources and their indices.
+    std::vector<llvm::Instruction *> Sources;
+    std::unordered_map<llvm::Instruction *, unsigned> SourceIndices;
+    // Sources contributing to each value, computed once for each strongly
+    // connected component of the contribution graph.
+    std::unordered_map<llvm::Instruction *, unsigned> ValueSCCs;
+    std::deque<SourceSetType> SCCSources;
 
     void Clear();
   };
@@ -115,7 +128,7 @@ private:
   using FunctionReturnSet = std::unordered_set<llvm::ReturnInst *>;
   struct FuncInfo {
     FunctionReturnSet Returns;
-    ControlDependence CtrlDep;
+    const ControlDependence *pCtrlDep = nullptr;
     std::unique_ptr<llvm::DominatorTreeBase<llvm::BasicBlock>> pDomTree;
     void Clear();
   };
@@ -137,12 +150,16 @@ private:
                                     FunctionSetType &FuncSet);
   void AnalyzeFunctions(EntryInfo &Entry);
   void CollectValuesContributingToOutputs(EntryInfo &Entry);
-  void CollectValuesContributingToOutputRec(
-      EntryInfo &Entry, llvm::Value *pContributingValue,
-      InstructionSetType &ContributingInstructions);
-  void CollectPhiCFValuesContributingToOutputRec(
-      llvm::PHINode *pPhi, EntryInfo &Entry,
-      InstructionSetType &ContributingInstructions);
+  void AddContributingSources(EntryInfo &Entry, llvm::Value *pValue,
+                              SourceSetType &Sources);
+  const SourceSetType &GetContributingSources(EntryInfo &Entry,
+                                              llvm::Instruction *pInst);
+  void CollectContributors(EntryInfo &Entry, llvm::Instruction *pInst,
+                           std::vector<llvm::Instruction *> &Contributors);
+  void AddContributor(EntryInfo &Entry, llvm::Value *pValue,
+                      std::vector<llvm::Instruction *> &Contributors);
+  void CollectPhiCFContributors(llvm::PHINode *pPhi, EntryInfo &Entry,
+                                std::vector<llvm::Instruction *> &Contributors);
   const ValueSetType &CollectReachingDecls(llvm::Value *pValue);
   void CollectReachingDeclsRec(llvm::Value *pValue, ValueSetType &ReachingDecls,
                                ValueSetType &Visited);
@@ -151,8 +168,7 @@ private:
                         ValueSetType &Visited);
   void UpdateDynamicIndexUsageState() const;
   void
-  CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType>
-                       &ContributingInstructions,
+  CreateViewIdSets(const EntryInfo &Entry, unsigned StreamId,
                    OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                    InputsContributingToOutputType &InputsContributingToOutputs,
                    bool bPC);
@@ -201,17 +217,29 @@ void DxilViewIdStateBuilder::Compute() {
 
   // 5. Construct dependency sets.
   for (unsigned StreamId = 0; StreamId < (pSM->IsGS() ? kNumStreams : 1u); StreamId++) {
-    CreateViewIdSets(m_Entry.ContributingInstructions[StreamId],
+    CreateViewIdSets(m_Entry, StreamId,
                      m_OutputsDependentOnViewId[StreamId],
                      m_InputsContributingToOutputs[StreamId], false);
   }
+  // A pass-through hull shader outputs each input component as it is.
+  if (pSM->IsHS() && m_Entry.pEntryFunc->isDeclaration()) {
+    for (auto &E : m_pModule->GetOutputSignature().GetElements()) {
+      if (!E->IsAllocated()) continue;
+      for (unsigned row = 0; row < E->GetRows(); row++) {
+        for (unsigned col = 0; col < E->GetCols(); col++) {
+          unsigned index = GetLinearIndex(*E, row, col);
+          m_InputsContributingToOutputs[0][index].emplace(index);
+        }
+      }
+    }
+  }
   if (pSM->IsHS()) {
-    CreateViewIdSets(m_PCEntry.ContributingInstructions[0],
+    CreateViewIdSets(m_PCEntry, 0,
                      m_PCOutputsDependentOnViewId,
                      m_InputsContributingToPCOutputs, true);
   } else if (pSM->IsDS()) {
     OutputsDependentOnViewIdType OutputsDependentOnViewId;
-    CreateViewIdSets(m_Entry.ContributingInstructions[0],
+    CreateViewIdSets(m_Entry, 0,
                      OutputsDependentOnViewId,
                      m_PCInputsContributingToOutputs, true);
     DXASSERT_NOMSG(OutputsDependentOnViewId == m_OutputsDependentOnViewId[0]);
@@ -251,12 +279,16 @@ void DxilViewIdStateBuilder::EntryInfo::Clear() {
   Functions.clear();
   Outputs.clear();
   for (unsigned i = 0; i < kNumStreams; i++)
-    ContributingInstructions[i].clear();
+    ContributingSources[i].clear();
+  Sources.clear();
+  SourceIndices.clear();
+  ValueSCCs.clear();
+  SCCSources.clear();
 }
 
 void DxilViewIdStateBuilder::FuncInfo::Clear() {
   Returns.clear();
-  CtrlDep.Clear();
+  pCtrlDep = nullptr;
   pDomTree.reset();
 }
 
@@ -385,16 +417,10 @@ void DxilViewIdStateBuilder::AnalyzeFunctions(EntryInfo &Entry) {
     pFuncInfo->pDomTree->print(dbgs());
 #endif
 
-    // Compute postdominator relation.
-    DominatorTreeBase<BasicBlock> PDR(true);
-    PDR.recalculate(*F);
+    // Get control dependence.
+    pFuncInfo->pCtrlDep = &m_CtrlDepAnalysis.GetControlDependence(F);
 #if DXILVIEWID_DBG
-    PDR.print(dbgs());
-#endif
-    // Compute control dependence.
-    pFuncInfo->CtrlDep.Compute(F, PDR);
-#if DXILVIEWID_DBG
-    pFuncInfo->CtrlDep.print(dbgs());
+    pFuncInfo->pCtrlDep->print(dbgs());
 #endif
   }
 }
@@ -437,59 +463,154 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputs(EntryInfo &Entry
       endRow = SigElem.GetRows() - 1;
     }
 
-    InstructionSetType ContributingInstructionsAllRows;
-    InstructionSetType *pContributingInstructions = &ContributingInstructionsAllRows;
-    if (startRow == endRow) {
-      // Scalar or indexable with known index.
-      unsigned index = GetLinearIndex(SigElem, startRow, col);
-      pContributingInstructions = &Entry.ContributingInstructions[StreamId][index];
-    }
-
-    CollectValuesContributingToOutputRec(Entry, pContributingValue, *pContributingInstructions);
+    SourceSetType Sources;
+    AddContributingSources(Entry, pContributingValue, Sources);
 
     // Handle control dependence of this instruction BB.
     BasicBlock *pBB = CI->getParent();
     Function *F = pBB->getParent();
     FuncInfo *pFuncInfo = m_FuncInfo[F].get();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+    ArrayRef<BasicBlock *> CtrlDepSet = pFuncInfo->pCtrlDep->GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), *pContributingInstructions);
+      AddContributingSources(Entry, B->getTerminator(), Sources);
+    }
+
+    // Dynamically indexed outputs get the contributions in all rows.
+    for (int row = startRow; row <= endRow; row++) {
+      unsigned index = GetLinearIndex(SigElem, row, col);
+      Entry.ContributingSources[StreamId][index] |= Sources;
+    }
+  }
+}
+
+void DxilViewIdStateBuilder::AddContributingSources(EntryInfo &Entry,
+                                                    Value *pValue,
+                                                    SourceSetType &Sources) {
+  std::vector<Instruction *> Insts;
+  AddContributor(Entry, pValue, Insts);
+  for (Instruction *pInst : Insts)
+    Sources |= GetContributingSources(Entry, pInst);
+}
+
+static bool IsViewIdSource(Instruction *pInst) {
+  return DxilInst_ViewID(pInst) || DxilInst_LoadInput(pInst) ||
+         DxilInst_LoadOutputControlPoint(pInst) ||
+         DxilInst_LoadPatchConstant(pInst);
+}
+
+// Values contribute to an output through their operands, memory, calls and
+// control dependence; loops make this graph cyclic. Its strongly connected
+// components are found with Tarjan's algorithm, over an explicit stack, and
+// each gets the union of the sources of its values and of the components
+// it reaches. Every value is thus visited once per entry, however many
+// outputs it contributes to.
+const DxilViewIdStateBuilder::SourceSetType &
+DxilViewIdStateBuilder::GetContributingSources(EntryInfo &Entry,
+                                               Instruction *pRoot) {
+  auto itRoot = Entry.ValueSCCs.find(pRoot);
+  if (itRoot != Entry.ValueSCCs.end())
+    return Entry.SCCSources[itRoot->second];
+
+  struct Frame {
+    Instruction *pInst;
+    std::vector<Instruction *> Contributors;
+    unsigned Next;
+  };
+  std::vector<Frame> Frames;
+  std::vector<Instruction *> Stack;
+  std::unordered_map<Instruction *, unsigned> Index, LowLink;
+  // Sources gathered by values whose component isn't complete yet.
+  std::unordered_map<Instruction *, SourceSetType> Pending;
+
+  auto Visit = [&](Instruction *pInst) {
+    unsigned N = Index.size();
+    Index[pInst] = N;
+    LowLink[pInst] = N;
+    Stack.push_back(pInst);
+    Frames.emplace_back();
+    Frames.back().pInst = pInst;
+    Frames.back().Next = 0;
+    CollectContributors(Entry, pInst, Frames.back().Contributors);
+    SourceSetType &Sources = Pending[pInst];
+    if (IsViewIdSource(pInst)) {
+      auto itIns = Entry.SourceIndices.emplace(pInst, Entry.Sources.size());
+      if (itIns.second)
+        Entry.Sources.push_back(pInst);
+      Sources.set(itIns.first->second);
     }
+  };
 
-    if (pContributingInstructions == &ContributingInstructionsAllRows) {
-      // Write dynamically indexed output contributions to all rows.
-      for (int row = startRow; row <= endRow; row++) {
-        unsigned index = GetLinearIndex(SigElem, row, col);
-        Entry.ContributingInstructions[StreamId][index].insert(ContributingInstructionsAllRows.begin(), ContributingInstructionsAllRows.end());
+  Visit(pRoot);
+  while (!Frames.empty()) {
+    Frame &F = Frames.back();
+    if (F.Next < F.Contributors.size()) {
+      Instruction *pNext = F.Contributors[F.Next++];
+      auto itSCC = Entry.ValueSCCs.find(pNext);
+      if (itSCC != Entry.ValueSCCs.end()) {
+        Pending[F.pInst] |= Entry.SCCSources[itSCC->second];
+        continue;
+      }
+      auto itIndex = Index.find(pNext);
+      if (itIndex == Index.end()) {
+        Visit(pNext);
+        continue;
       }
+      // Still on the stack, so in the same component.
+      LowLink[F.pInst] = std::min(LowLink[F.pInst], itIndex->second);
+      continue;
+    }
+
+    Instruction *pInst = F.pInst;
+    Frames.pop_back();
+    if (!Frames.empty()) {
+      unsigned &ParentLowLink = LowLink[Frames.back().pInst];
+      ParentLowLink = std::min(ParentLowLink, LowLink[pInst]);
     }
+    if (LowLink[pInst] != Index[pInst])
+      continue;
+
+    // pInst is the root of a component; gather the sources of its values.
+    unsigned SCC = Entry.SCCSources.size();
+    Entry.SCCSources.emplace_back();
+    SourceSetType &Sources = Entry.SCCSources.back();
+    Instruction *pMember;
+    do {
+      pMember = Stack.back();
+      Stack.pop_back();
+      Sources |= Pending[pMember];
+      Pending.erase(pMember);
+      Entry.ValueSCCs[pMember] = SCC;
+    } while (pMember != pInst);
+    if (!Frames.empty())
+      Pending[Frames.back().pInst] |= Sources;
   }
+  return Entry.SCCSources[Entry.ValueSCCs[pRoot]];
 }
 
-void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Entry,
-                                                           Value *pContributingValue,
-                                                           InstructionSetType &ContributingInstructions) {
-  if (dyn_cast<Argument>(pContributingValue)) {
+void DxilViewIdStateBuilder::AddContributor(
+    EntryInfo &Entry, Value *pValue, std::vector<Instruction *> &Contributors) {
+  if (dyn_cast<Argument>(pValue)) {
     // This must be a leftover signature argument of an entry function.
     DXASSERT_NOMSG(Entry.pEntryFunc == m_pModule->GetEntryFunction() ||
                    Entry.pEntryFunc == m_pModule->GetPatchConstantFunction());
     return;
   }
 
-  Instruction *pContributingInst = dyn_cast<Instruction>(pContributingValue);
-  if (pContributingInst == nullptr) {
+  Instruction *pInst = dyn_cast<Instruction>(pValue);
+  if (pInst == nullptr) {
     // Can be literal constant, global decl, branch target.
-    DXASSERT_NOMSG(isa<Constant>(pContributingValue) || isa<BasicBlock>(pContributingValue));
+    DXASSERT_NOMSG(isa<Constant>(pValue) || isa<BasicBlock>(pValue));
     return;
   }
+  Contributors.push_back(pInst);
+}
 
-  auto itInst = ContributingInstructions.emplace(pContributingInst);
-  // Already visited instruction.
-  if (!itInst.second) return;
-
+void DxilViewIdStateBuilder::CollectContributors(
+    EntryInfo &Entry, Instruction *pContributingInst,
+    std::vector<Instruction *> &Contributors) {
   // Handle special cases.
   if (PHINode *phi = dyn_cast<PHINode>(pContributingInst)) {
-    CollectPhiCFValuesContributingToOutputRec(phi, Entry, ContributingInstructions);
+    CollectPhiCFContributors(phi, Entry, Contributors);
   } else if (isa<LoadInst>(pContributingInst) || 
              isa<AtomicCmpXchgInst>(pContributingInst) ||
              isa<AtomicRMWInst>(pContributingInst)) {
@@ -500,7 +621,7 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
     for (Value *pDeclValue : ReachingDecls) {
       const ValueSetType &Stores = CollectStores(pDeclValue);
       for (Value *V : Stores) {
-        CollectValuesContributingToOutputRec(Entry, V, ContributingInstructions);
+        AddContributor(Entry, V, Contributors);
       }
     }
   } else if (CallInst *CI = dyn_cast<CallInst>(pContributingInst)) {
@@ -511,7 +632,7 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
         if (Entry.Functions.find(F) != Entry.Functions.end()) {
           const FuncInfo &FI = *m_FuncInfo[F];
           for (ReturnInst *pRetInst : FI.Returns) {
-            CollectValuesContributingToOutputRec(Entry, pRetInst, ContributingInstructions);
+            AddContributor(Entry, pRetInst, Contributors);
           }
         }
       }
@@ -522,16 +643,16 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
   unsigned NumOps = pContributingInst->getNumOperands();
   for (unsigned i = 0; i < NumOps; i++) {
     Value *O = pContributingInst->getOperand(i);
-    CollectValuesContributingToOutputRec(Entry, O, ContributingInstructions);
+    AddContributor(Entry, O, Contributors);
   }
 
   // Handle control dependence of this instruction BB.
   BasicBlock *pBB = pContributingInst->getParent();
   Function *F = pBB->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
-  const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+  ArrayRef<BasicBlock *> CtrlDepSet = pFuncInfo->pCtrlDep->GetCDBlocks(pBB);
   for (BasicBlock *B : CtrlDepSet) {
-    CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+    AddContributor(Entry, B->getTerminator(), Contributors);
   }
 }
 
@@ -540,9 +661,9 @@ void DxilViewIdStateBuilder::CollectValuesContributingToOutputRec(EntryInfo &Ent
 // However, this may be too conservative and, as such, pick up extra control dependent BBs.
 // A better "definition" point is the highest dominator where it is still legal to "insert" constant assignment.
 // In this context, "legal" means that only one value "leaves" the dominator and reaches Phi.
-void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *pPhi,
-                                                                EntryInfo &Entry,
-                                                                InstructionSetType &ContributingInstructions) {
+void DxilViewIdStateBuilder::CollectPhiCFContributors(PHINode *pPhi,
+                                                      EntryInfo &Entry,
+                                                      std::vector<Instruction *> &Contributors) {
   Function *F = pPhi->getParent()->getParent();
   FuncInfo *pFuncInfo = m_FuncInfo[F].get();
   unordered_map<DomTreeNodeBase<BasicBlock> *, Value *> DomTreeMarkers;
@@ -615,9 +736,9 @@ void DxilViewIdStateBuilder::CollectPhiCFValuesContributingToOutputRec(PHINode *
 
     // Handle control dependence of this constant argument highest legal "definition" point.
     pBB = pDefDomNode->getBlock();
-    const BasicBlockSet &CtrlDepSet = pFuncInfo->CtrlDep.GetCDBlocks(pBB);
+    ArrayRef<BasicBlock *> CtrlDepSet = pFuncInfo->pCtrlDep->GetCDBlocks(pBB);
     for (BasicBlock *B : CtrlDepSet) {
-      CollectValuesContributingToOutputRec(Entry, B->getTerminator(), ContributingInstructions);
+      AddContributor(Entry, B->getTerminator(), Contributors);
     }
   }
 }
@@ -713,15 +834,16 @@ void DxilViewIdStateBuilder::CollectStoresRec(llvm::Value *pValue, ValueSetType
   }
 }
 
-void DxilViewIdStateBuilder::CreateViewIdSets(const std::unordered_map<unsigned, InstructionSetType> &ContributingInstructions, 
+void DxilViewIdStateBuilder::CreateViewIdSets(const EntryInfo &Entry, unsigned StreamId,
                                        OutputsDependentOnViewIdType &OutputsDependentOnViewId,
                                        InputsContributingToOutputType &InputsContributingToOutputs,
                                        bool bPC) {
   const ShaderModel *pSM = m_pModule->GetShaderModel();
 
-  for (auto &itOut : ContributingInstructions) {
+  for (auto &itOut : Entry.ContributingSources[StreamId]) {
     unsigned outIdx = itOut.first;
-    for (Instruction *pInst : itOut.second) {
+    for (unsigned SourceIdx : itOut.second) {
+      Instruction *pInst = Entry.Sources[SourceIdx];
       // Set output dependence on ViewId.
       if (DxilInst_ViewID VID = DxilInst_ViewID(pInst)) {
         DXASSERT(m_bUsesViewId, "otherwise, DxilModule flag not set properly");
@@ -845,6 +967,7 @@ char ComputeViewIdState::ID = 0;
 
 INITIALIZE_PASS_BEGIN(ComputeViewIdState, "viewid-state",
                 "Compute information related to ViewID", true, true)
+INITIALIZE_PASS_DEPENDENCY(ControlDependenceAnalysis)
 INITIALIZE_PASS_END(ComputeViewIdState, "viewid-state",
                 "Compute information related to ViewID", true, true)
 
@@ -856,7 +979,8 @@ bool ComputeViewIdState::runOnModule(Module &M) {
   const ShaderModel *pSM = DxilModule.GetShaderModel();
   if (!pSM->IsCS() && !pSM->IsLib()) {
     DxilViewIdState ViewIdState(&DxilModule);
-    DxilViewIdStateBuilder Builder(ViewIdState, &DxilModule);
+    DxilViewIdStateBuilder Builder(ViewIdState, &DxilModule,
+                                   getAnalysis<ControlDependenceAnalysis>());
     Builder.Compute();
     // Serialize viewidstate.
     ViewIdState.Serialize();
@@ -872,6 +996,7 @@ bool ComputeViewIdState::runOnModule(Module &M) {
 }
 
 void ComputeViewIdState::getAnalysisUsage(AnalysisUsage &AU) const {
+  AU.addRequired<ControlDependenceAnalysis>();
   AU.setPreservesAll();
 }
 
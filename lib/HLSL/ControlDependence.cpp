@@ -13,27 +13,31 @@
 
 #include "dxc/HLSL/ControlDependence.h"
 #include "dxc/Support/Global.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/Module.h"
 #include "llvm/Support/Debug.h"
 
 using namespace llvm;
 using namespace hlsl;
 
 
-const BasicBlockSet &ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
-  auto it = m_ControlDependence.find(pBB);
-  if (it != m_ControlDependence.end())
-    return it->second;
-  else
-    return m_EmptyBBSet;
+ArrayRef<BasicBlock *> ControlDependence::GetCDBlocks(BasicBlock *pBB) const {
+  auto it = m_CDRanges.find(pBB);
+  if (it == m_CDRanges.end())
+    return ArrayRef<BasicBlock *>();
+  return ArrayRef<BasicBlock *>(m_CDBlocks.data() + it->second.first,
+                                m_CDBlocks.data() + it->second.second);
 }
 
-void ControlDependence::print(raw_ostream &OS) {
+void ControlDependence::print(raw_ostream &OS) const {
   OS << "Control dependence for function '" << m_pFunc->getName() << "'\n";
-  for (auto &it : m_ControlDependence) {
-    BasicBlock *pBB = it.first;
-    OS << "Block " << pBB->getName() << ": { ";
+  for (BasicBlock &BB : *m_pFunc) {
+    ArrayRef<BasicBlock *> CDBlocks = GetCDBlocks(&BB);
+    if (CDBlocks.empty())
+      continue;
+    OS << "Block " << BB.getName() << ": { ";
     bool bFirst = true;
-    for (BasicBlock *pBB2 : it.second) {
+    for (BasicBlock *pBB2 : CDBlocks) {
       if (!bFirst) OS << ", ";
       OS << pBB2->getName();
       bFirst = false;
@@ -43,7 +47,7 @@ void ControlDependence::print(raw_ostream &OS) {
   OS << "\n";
 }
 
-void ControlDependence::dump() {
+void ControlDependence::dump() const {
   print(dbgs());
 }
 
@@ -58,16 +62,19 @@ void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
   }
   DXASSERT_NOMSG(RevTopOrder.size() == VisitedBBs.size());
 
-  // Compute control dependence relation.
+  // Compute control dependence relation. Blocks come after the blocks they
+  // immediately post-dominate, so the relation of those is complete.
+  SmallSetVector<BasicBlock *, 8> CDBlocks;
   for (size_t iBB = 0; iBB < RevTopOrder.size(); iBB++) {
     BasicBlock *x = RevTopOrder[iBB];
+    CDBlocks.clear();
 
     // For each y = pred(x): if ipostdom(y) != x then add "x is control dependent on y"
     for (auto itPred = pred_begin(x), endPred = pred_end(x); itPred != endPred; ++itPred) {
       BasicBlock *y = *itPred;  // predecessor of x
       BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
       if (pPredIDomBB != x) {
-        m_ControlDependence[x].insert(y);
+        CDBlocks.insert(y);
       }
     }
 
@@ -75,26 +82,28 @@ void ControlDependence::Compute(Function *F, PostDomRelationType &PostDomRel) {
     for (DomTreeNode *child : PostDomRel.getNode(x)->getChildren()) {
       BasicBlock *z = child->getBlock();
 
-      auto it = m_ControlDependence.find(z);
-      if (it == m_ControlDependence.end())
-        continue;
-
       // For all y in CDG(z)
-      for (BasicBlock *y : it->second) {
+      for (BasicBlock *y : GetCDBlocks(z)) {
         // if ipostdom(y) != x then add "x is control dependent on y" 
         BasicBlock *pPredIDomBB = GetIPostDom(PostDomRel, y);
         if (pPredIDomBB != x) {
-          m_ControlDependence[x].insert(y);
+          CDBlocks.insert(y);
         }
       }
     }
+
+    if (!CDBlocks.empty()) {
+      unsigned Begin = m_CDBlocks.size();
+      m_CDBlocks.insert(m_CDBlocks.end(), CDBlocks.begin(), CDBlocks.end());
+      m_CDRanges[x] = std::make_pair(Begin, (unsigned)m_CDBlocks.size());
+    }
   }
 }
 
 void ControlDependence::Clear() {
   m_pFunc = nullptr;
-  m_ControlDependence.clear();
-  m_EmptyBBSet.clear();
+  m_CDRanges.clear();
+  m_CDBlocks.clear();
 }
 
 BasicBlock *ControlDependence::GetIPostDom(PostDomRelationType &PostDomRel, BasicBlock *pBB) {
@@ -122,3 +131,30 @@ void ControlDependence::ComputeRevTopOrderRec(PostDomRelationType &PostDomRel,
 
   RevTopOrder.emplace_back(pBB);
 }
+
+char ControlDependenceAnalysis::ID = 0;
+
+ControlDependenceAnalysis::ControlDependenceAnalysis() : ModulePass(ID) {}
+
+const ControlDependence &
+ControlDependenceAnalysis::GetControlDependence(Function *F) {
+  std::unique_ptr<ControlDependence> &pCtrlDep = m_Functions[F];
+  if (!pCtrlDep) {
+    DominatorTreeBase<BasicBlock> PDR(true);
+    PDR.recalculate(*F);
+    pCtrlDep = llvm::make_unique<ControlDependence>();
+    pCtrlDep->Compute(F, PDR);
+  }
+  return *pCtrlDep;
+}
+
+void ControlDependenceAnalysis::print(raw_ostream &OS, const Module *M) const {
+  for (const Function &F : *M) {
+    auto it = m_Functions.find(&F);
+    if (it != m_Functions.end())
+      it->second->print(OS);
+  }
+}
+
+INITIALIZE_PASS(ControlDependenceAnalysis, "control-dependence",
+                "Control dependence analysis", true, true)
@@ -22,6 +22,7 @@
 #include "dxc/HLSL/ComputeViewIdState.h"
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/DxcJson.h"
 
 #include "llvm/Pass.h"
 #include "llvm/PassInfo.h"
@@ -30,6 +31,8 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/PhaseTiming.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/IR/IRPrintingPasses.h"
 #include "llvm/IR/LegacyPassManager.h"
@@ -38,6 +41,7 @@
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
 
 #include <algorithm>
+#include <chrono>
 #include <list>   // should change this for string_table
 #include <vector>
 
@@ -78,6 +82,7 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeCFLAliasAnalysisPass(Registry);
     initializeComputeViewIdStatePass(Registry);
     initializeConstantMergePass(Registry);
+    initializeControlDependenceAnalysisPass(Registry);
     initializeCorrelatedValuePropagationPass(Registry);
     initializeDAEPass(Registry);
     initializeDAHPass(Registry);
@@ -85,27 +90,48 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeDSEPass(Registry);
     initializeDeadInstEliminationPass(Registry);
     initializeDxilAllocateResourcesForLibPass(Registry);
+    initializeDxilClusterFetchesPass(Registry);
+    initializeDxilCoalesceRawBufferAccessPass(Registry);
     initializeDxilCondenseResourcesPass(Registry);
     initializeDxilConvergentClearPass(Registry);
     initializeDxilConvergentMarkPass(Registry);
     initializeDxilDeadFunctionEliminationPass(Registry);
+    initializeDxilDemoteOutputPrecisionPass(Registry);
+    initializeDxilEliminateDeadOutputStoresPass(Registry);
+    initializeDxilEliminateLocalDynamicIndexingPass(Registry);
     initializeDxilEliminateOutputDynamicIndexingPass(Registry);
+    initializeDxilEliminateRedundantBarriersPass(Registry);
     initializeDxilEmitMetadataPass(Registry);
     initializeDxilExpandTrigIntrinsicsPass(Registry);
     initializeDxilFinalizeModulePass(Registry);
+    initializeDxilGatherTexelLoadsPass(Registry);
     initializeDxilGenerationPassPass(Registry);
+    initializeDxilGroupSharedBankConflictsPass(Registry);
+    initializeDxilHoistResourceOpsPass(Registry);
+    initializeDxilInferEarlyDepthStencilPass(Registry);
     initializeDxilLegalizeEvalOperationsPass(Registry);
     initializeDxilLegalizeResourcesPass(Registry);
     initializeDxilLegalizeSampleOffsetPassPass(Registry);
     initializeDxilLoadMetadataPass(Registry);
     initializeDxilLoopUnrollPass(Registry);
     initializeDxilLowerCreateHandleForLibPass(Registry);
+    initializeDxilMergeIdenticalFunctionsPass(Registry);
+    initializeDxilPair16BitOpsPass(Registry);
+    initializeDxilPassThroughHullShaderPass(Registry);
+    initializeDxilPositionOnlyPass(Registry);
     initializeDxilPrecisePropagatePassPass(Registry);
     initializeDxilPreserveAllOutputsPass(Registry);
     initializeDxilPromoteLocalResourcesPass(Registry);
     initializeDxilPromoteStaticResourcesPass(Registry);
+    initializeDxilReuseDerivativesPass(Registry);
+    initializeDxilRootConstantCandidatesPass(Registry);
+    initializeDxilSelectControlFlowHintsPass(Registry);
+    initializeDxilSimpleGVNEliminatePass(Registry);
     initializeDxilSimpleGVNHoistPass(Registry);
+    initializeDxilStrengthReduceBufferIndicesPass(Registry);
     initializeDxilTranslateRawBufferPass(Registry);
+    initializeDxilUniformResourceIndexPass(Registry);
+    initializeDxilWaveAggregateAtomicsPass(Registry);
     initializeDynamicIndexingVectorToArrayPass(Registry);
     initializeEarlyCSELegacyPassPass(Registry);
     initializeEliminateAvailableExternallyPass(Registry);
@@ -115,6 +141,7 @@ HRESULT SetupRegistryPassForHLSL() {
     initializeGVNPass(Registry);
     initializeGlobalDCEPass(Registry);
     initializeGlobalOptPass(Registry);
+    initializeHLBindConstantsPass(Registry);
     initializeHLDeadFunctionEliminationPass(Registry);
     initializeHLEmitMetadataPass(Registry);
     initializeHLEnsureMetadataPass(Registry);
@@ -186,21 +213,38 @@ static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   static const LPCSTR AlwaysInlinerArgs[] = { "InsertLifetime", "InlineThreshold" };
   static const LPCSTR ArgPromotionArgs[] = { "maxElements" };
   static const LPCSTR CFGSimplifyPassArgs[] = { "Threshold", "Ftor", "bonus-inst-threshold" };
-  static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "force-early-z", "add-pixel-cost", "rt-width", "sv-position-index", "num-pixels" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2" };
+  static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "force-early-z", "add-pixel-cost", "rt-width", "sv-position-index", "num-pixels", "wave-aggregate" };
+  static const LPCSTR DxilBlockCountInstrumentationArgs[] = { "wave-aggregate" };
+  static const LPCSTR DxilClusterFetchesArgs[] = { "MaxLiveComponents" };
+  static const LPCSTR DxilCondenseResourcesArgs[] = { "Contiguous", "UpdateOrder" };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "UAVSize", "parameter0", "parameter1", "parameter2", "FirstInstruction", "LastInstruction", "FirstLine", "LastLine", "Function" };
+  static const LPCSTR DxilDemoteOutputPrecisionArgs[] = { "OutputBits", "Report" };
+  static const LPCSTR DxilEliminateLocalDynamicIndexingArgs[] = { "MaxElements", "MaxSelects", "Report" };
+  static const LPCSTR DxilEliminateRedundantBarriersArgs[] = { "Report" };
+  static const LPCSTR DxilExpandTrigIntrinsicsArgs[] = { "Fast" };
   static const LPCSTR DxilGenerationPassArgs[] = { "NotOptimized" };
+  static const LPCSTR DxilGroupSharedBankConflictsArgs[] = { "Banks", "BankWidth", "Pad", "Report" };
+  static const LPCSTR DxilInferEarlyDepthStencilArgs[] = { "Apply", "Report" };
+  static const LPCSTR DxilLoopUnrollArgs[] = { "MaxIterationAttempt", "MaxUnrolledSize" };
+  static const LPCSTR DxilMergeIdenticalFunctionsArgs[] = { "Report" };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "mod-mode", "constant-red", "constant-green", "constant-blue", "constant-alpha" };
-  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "config", "checkForDynamicIndexing" };
+  static const LPCSTR DxilRootConstantCandidatesArgs[] = { "MaxDWords" };
+  static const LPCSTR DxilSelectControlFlowHintsArgs[] = { "BranchThreshold", "DivergentBranchThreshold", "Report", "BiasedRatio", "ProfiledOnly" };
+  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "config", "checkForDynamicIndexing", "wave-aggregate", "compact", "overflow-size" };
+  static const LPCSTR DxilTimestampInstrumentationArgs[] = { "clock-function", "regions", "ring-size", "wave-aggregate" };
+  static const LPCSTR DxilUniformResourceIndexArgs[] = { "InferNonUniform" };
+  static const LPCSTR DxilWaveAggregateAtomicsArgs[] = { "Report" };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "ReplaceAllVectors" };
   static const LPCSTR Float2IntArgs[] = { "float2int-max-integer-bw" };
   static const LPCSTR GVNArgs[] = { "noloads", "enable-pre", "enable-load-pre", "max-recurse-depth" };
+  static const LPCSTR HLBindConstantsArgs[] = { "constants" };
   static const LPCSTR JumpThreadingArgs[] = { "Threshold", "jump-threading-threshold" };
   static const LPCSTR LICMArgs[] = { "disable-licm-promotion" };
   static const LPCSTR LoopDistributeArgs[] = { "loop-distribute-verify", "loop-distribute-non-if-convertible" };
   static const LPCSTR LoopRerollArgs[] = { "max-reroll-increment", "reroll-num-tolerated-failed-matches" };
   static const LPCSTR LoopRotateArgs[] = { "MaxHeaderSize", "rotation-max-header-size" };
   static const LPCSTR LoopUnrollArgs[] = { "Threshold", "Count", "AllowPartial", "Runtime", "unroll-threshold", "unroll-percent-dynamic-cost-saved-threshold", "unroll-dynamic-cost-savings-discount", "unroll-max-iteration-count-to-analyze", "unroll-count", "unroll-allow-partial", "unroll-runtime", "pragma-unroll-threshold" };
-  static const LPCSTR LoopUnswitchArgs[] = { "Os", "loop-unswitch-threshold" };
+  static const LPCSTR LoopUnswitchArgs[] = { "Os", "UniformOnly", "SizeBudget", "loop-unswitch-threshold" };
   static const LPCSTR LowerBitSetsArgs[] = { "lowerbitsets-avoid-reuse" };
   static const LPCSTR LowerExpectIntrinsicArgs[] = { "likely-branch-weight", "unlikely-branch-weight" };
   static const LPCSTR MergeFunctionsArgs[] = { "mergefunc-sanity" };
@@ -220,13 +264,30 @@ static ArrayRef<LPCSTR> GetPassArgNames(LPCSTR passName) {
   if (strcmp(passName, "argpromotion") == 0) return ArrayRef<LPCSTR>(ArgPromotionArgs, _countof(ArgPromotionArgs));
   if (strcmp(passName, "simplifycfg") == 0) return ArrayRef<LPCSTR>(CFGSimplifyPassArgs, _countof(CFGSimplifyPassArgs));
   if (strcmp(passName, "hlsl-dxil-add-pixel-hit-instrmentation") == 0) return ArrayRef<LPCSTR>(DxilAddPixelHitInstrumentationArgs, _countof(DxilAddPixelHitInstrumentationArgs));
+  if (strcmp(passName, "hlsl-dxil-block-count-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilBlockCountInstrumentationArgs, _countof(DxilBlockCountInstrumentationArgs));
+  if (strcmp(passName, "dxil-cluster-fetches") == 0) return ArrayRef<LPCSTR>(DxilClusterFetchesArgs, _countof(DxilClusterFetchesArgs));
+  if (strcmp(passName, "hlsl-dxil-condense") == 0) return ArrayRef<LPCSTR>(DxilCondenseResourcesArgs, _countof(DxilCondenseResourcesArgs));
   if (strcmp(passName, "hlsl-dxil-debug-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilDebugInstrumentationArgs, _countof(DxilDebugInstrumentationArgs));
+  if (strcmp(passName, "dxil-demote-output-precision") == 0) return ArrayRef<LPCSTR>(DxilDemoteOutputPrecisionArgs, _countof(DxilDemoteOutputPrecisionArgs));
+  if (strcmp(passName, "hlsl-dxil-eliminate-local-dynamic") == 0) return ArrayRef<LPCSTR>(DxilEliminateLocalDynamicIndexingArgs, _countof(DxilEliminateLocalDynamicIndexingArgs));
+  if (strcmp(passName, "dxil-eliminate-redundant-barriers") == 0) return ArrayRef<LPCSTR>(DxilEliminateRedundantBarriersArgs, _countof(DxilEliminateRedundantBarriersArgs));
+  if (strcmp(passName, "hlsl-dxil-expand-trig-intrinsics") == 0) return ArrayRef<LPCSTR>(DxilExpandTrigIntrinsicsArgs, _countof(DxilExpandTrigIntrinsicsArgs));
   if (strcmp(passName, "dxilgen") == 0) return ArrayRef<LPCSTR>(DxilGenerationPassArgs, _countof(DxilGenerationPassArgs));
+  if (strcmp(passName, "dxil-groupshared-bank-conflicts") == 0) return ArrayRef<LPCSTR>(DxilGroupSharedBankConflictsArgs, _countof(DxilGroupSharedBankConflictsArgs));
+  if (strcmp(passName, "dxil-infer-early-depth-stencil") == 0) return ArrayRef<LPCSTR>(DxilInferEarlyDepthStencilArgs, _countof(DxilInferEarlyDepthStencilArgs));
+  if (strcmp(passName, "dxil-loop-unroll") == 0) return ArrayRef<LPCSTR>(DxilLoopUnrollArgs, _countof(DxilLoopUnrollArgs));
+  if (strcmp(passName, "dxil-merge-identical-functions") == 0) return ArrayRef<LPCSTR>(DxilMergeIdenticalFunctionsArgs, _countof(DxilMergeIdenticalFunctionsArgs));
   if (strcmp(passName, "hlsl-dxil-constantColor") == 0) return ArrayRef<LPCSTR>(DxilOutputColorBecomesConstantArgs, _countof(DxilOutputColorBecomesConstantArgs));
+  if (strcmp(passName, "dxil-root-constant-candidates") == 0) return ArrayRef<LPCSTR>(DxilRootConstantCandidatesArgs, _countof(DxilRootConstantCandidatesArgs));
+  if (strcmp(passName, "dxil-select-control-flow-hints") == 0) return ArrayRef<LPCSTR>(DxilSelectControlFlowHintsArgs, _countof(DxilSelectControlFlowHintsArgs));
   if (strcmp(passName, "hlsl-dxil-pix-shader-access-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilShaderAccessTrackingArgs, _countof(DxilShaderAccessTrackingArgs));
+  if (strcmp(passName, "hlsl-dxil-timestamp-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilTimestampInstrumentationArgs, _countof(DxilTimestampInstrumentationArgs));
+  if (strcmp(passName, "dxil-uniform-resource-index") == 0) return ArrayRef<LPCSTR>(DxilUniformResourceIndexArgs, _countof(DxilUniformResourceIndexArgs));
+  if (strcmp(passName, "dxil-wave-aggregate-atomics") == 0) return ArrayRef<LPCSTR>(DxilWaveAggregateAtomicsArgs, _countof(DxilWaveAggregateAtomicsArgs));
   if (strcmp(passName, "dynamic-vector-to-array") == 0) return ArrayRef<LPCSTR>(DynamicIndexingVectorToArrayArgs, _countof(DynamicIndexingVectorToArrayArgs));
   if (strcmp(passName, "float2int") == 0) return ArrayRef<LPCSTR>(Float2IntArgs, _countof(Float2IntArgs));
   if (strcmp(passName, "gvn") == 0) return ArrayRef<LPCSTR>(GVNArgs, _countof(GVNArgs));
+  if (strcmp(passName, "hl-bind-constants") == 0) return ArrayRef<LPCSTR>(HLBindConstantsArgs, _countof(HLBindConstantsArgs));
   if (strcmp(passName, "jump-threading") == 0) return ArrayRef<LPCSTR>(JumpThreadingArgs, _countof(JumpThreadingArgs));
   if (strcmp(passName, "licm") == 0) return ArrayRef<LPCSTR>(LICMArgs, _countof(LICMArgs));
   if (strcmp(passName, "loop-distribute") == 0) return ArrayRef<LPCSTR>(LoopDistributeArgs, _countof(LoopDistributeArgs));
@@ -259,21 +320,38 @@ static ArrayRef<LPCSTR> GetPassArgDescriptions(LPCSTR passName) {
   static const LPCSTR AlwaysInlinerArgs[] = { "Insert @llvm.lifetime intrinsics", "Insert @llvm.lifetime intrinsics" };
   static const LPCSTR ArgPromotionArgs[] = { "None" };
   static const LPCSTR CFGSimplifyPassArgs[] = { "None", "None", "Control the number of bonus instructions (default = 1)" };
-  static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "None", "None", "None", "None", "None" };
-  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None" };
+  static const LPCSTR DxilAddPixelHitInstrumentationArgs[] = { "None", "None", "None", "None", "None", "Count the lanes of a wave that hit the same pixel with one atomic (shader model 6.0+)." };
+  static const LPCSTR DxilBlockCountInstrumentationArgs[] = { "Count the lanes of a wave that run a block with one atomic (shader model 6.0+)." };
+  static const LPCSTR DxilClusterFetchesArgs[] = { "Largest number of used result components that a group of moved fetches keeps live." };
+  static const LPCSTR DxilCondenseResourcesArgs[] = { "Pack the resources without a register of each class, and warn with the matching descriptor tables.", "Resources packed with Contiguous, most frequently updated first, as name;name..." };
+  static const LPCSTR DxilDebugInstrumentationArgs[] = { "None", "None", "None", "None", "First instruction number that is instrumented.", "Last instruction number that is instrumented.", "First source line that is instrumented.", "Last source line that is instrumented.", "Only instrument instructions from this function." };
+  static const LPCSTR DxilDemoteOutputPrecisionArgs[] = { "Bits per channel of the color targets and UNORM/SNORM resources written.", "Warn about each output computed in 16-bit precision." };
+  static const LPCSTR DxilEliminateLocalDynamicIndexingArgs[] = { "Largest number of elements of an array promoted to registers.", "Largest number of selects that promoting an array may add.", "Warn about each dynamically indexed array, and whether it was promoted." };
+  static const LPCSTR DxilEliminateRedundantBarriersArgs[] = { "Warn about each barrier or fence removed." };
+  static const LPCSTR DxilExpandTrigIntrinsicsArgs[] = { "Use lower degree approximations for calls that are not precise." };
   static const LPCSTR DxilGenerationPassArgs[] = { "None" };
+  static const LPCSTR DxilGroupSharedBankConflictsArgs[] = { "Number of groupshared memory banks.", "Width of a groupshared memory bank, in bytes.", "Pad the inner dimensions of arrays with conflicting accesses.", "Warn about each conflicting access and padded array." };
+  static const LPCSTR DxilInferEarlyDepthStencilArgs[] = { "Set [earlydepthstencil] on each pixel shader that can use it.", "Warn about each pixel shader that can use [earlydepthstencil]." };
+  static const LPCSTR DxilLoopUnrollArgs[] = { "Maximum number of iterations to attempt when iteratively unrolling.", "Maximum size, in cost units, that unrolled loops may add to a function." };
+  static const LPCSTR DxilMergeIdenticalFunctionsArgs[] = { "Warn about each function merged." };
   static const LPCSTR DxilOutputColorBecomesConstantArgs[] = { "None", "None", "None", "None", "None" };
-  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "None", "None" };
+  static const LPCSTR DxilRootConstantCandidatesArgs[] = { "Largest cbuffer, in DWORDs, to recommend as root constants." };
+  static const LPCSTR DxilSelectControlFlowHintsArgs[] = { "Cost of a side above which a branch on a uniform condition is kept.", "Cost of both sides above which a branch on a divergent condition is kept.", "Warn about each hint selected, with its reason.", "Ratio of the profile weights of the sides above which a branch is kept.", "Only hint branches that have profile weights." };
+  static const LPCSTR DxilShaderAccessTrackingArgs[] = { "None", "None", "Record the accesses of a wave to the same slot with one atomic (shader model 6.0+).", "Pack the flags of eight slots into each uint, and list out-of-bounds accesses separately.", "Number of entries in the out-of-bounds access list of the compact encoding." };
+  static const LPCSTR DxilTimestampInstrumentationArgs[] = { "Function of the shader clock extension that returns the clock.", "Source line ranges to time, as first-last,first-last...", "Number of records in the ring buffer.", "Record once per wave (shader model 6.0+)." };
+  static const LPCSTR DxilUniformResourceIndexArgs[] = { "Set the non-uniform flag exactly when the index may differ between lanes, and warn on each change" };
+  static const LPCSTR DxilWaveAggregateAtomicsArgs[] = { "Warn about each atomic combined." };
   static const LPCSTR DynamicIndexingVectorToArrayArgs[] = { "None" };
   static const LPCSTR Float2IntArgs[] = { "Max integer bitwidth to consider in float2int" };
   static const LPCSTR GVNArgs[] = { "None", "None", "None", "Max recurse depth" };
+  static const LPCSTR HLBindConstantsArgs[] = { "Values of the -late-bind-const static consts, as name:value;name:value..." };
   static const LPCSTR JumpThreadingArgs[] = { "None", "Max block size to duplicate for jump threading" };
   static const LPCSTR LICMArgs[] = { "Disable memory promotion in LICM pass" };
   static const LPCSTR LoopDistributeArgs[] = { "Turn on DominatorTree and LoopInfo verification after Loop Distribution", "Whether to distribute into a loop that may not be if-convertible by the loop vectorizer" };
   static const LPCSTR LoopRerollArgs[] = { "The maximum increment for loop rerolling", "The maximum number of failures to tolerate during fuzzy matching." };
   static const LPCSTR LoopRotateArgs[] = { "None", "The default maximum header size for automatic loop rotation" };
   static const LPCSTR LoopUnrollArgs[] = { "None", "None", "None", "None", "The baseline cost threshold for loop unrolling", "The percentage of estimated dynamic cost which must be saved by unrolling to allow unrolling up to the max threshold.", "This is the amount discounted from the total unroll cost when the unrolled form has a high dynamic cost savings (triggered by the '-unroll-perecent-dynamic-cost-saved-threshold' flag).", "Don't allow loop unrolling to simulate more than this number of iterations when checking full unroll profitability", "Use this unroll count for all loops including those with unroll_count pragma values, for testing purposes", "Allows loops to be partially unrolled until -unroll-threshold loop size is reached.", "Unroll loops with run-time trip counts", "Unrolled size limit for loops with an unroll(full) or unroll_count pragma." };
-  static const LPCSTR LoopUnswitchArgs[] = { "Optimize for size", "Max loop size to unswitch" };
+  static const LPCSTR LoopUnswitchArgs[] = { "Optimize for size", "Only unswitch on wave-uniform conditions, in loops without barriers", "Max loop size to unswitch, in DXIL instruction costs when UniformOnly", "Max loop size to unswitch" };
   static const LPCSTR LowerBitSetsArgs[] = { "Try to avoid reuse of byte array addresses using aliases" };
   static const LPCSTR LowerExpectIntrinsicArgs[] = { "Weight of the branch likely to be taken (default = 64)", "Weight of the branch unlikely to be taken (default = 4)" };
   static const LPCSTR MergeFunctionsArgs[] = { "How many functions in module could be used for MergeFunctions pass sanity check. '0' disables this check. Works only with '-debug' key." };
@@ -293,13 +371,30 @@ static ArrayRef<LPCSTR> GetPassArgDescriptions(LPCSTR passName) {
   if (strcmp(passName, "argpromotion") == 0) return ArrayRef<LPCSTR>(ArgPromotionArgs, _countof(ArgPromotionArgs));
   if (strcmp(passName, "simplifycfg") == 0) return ArrayRef<LPCSTR>(CFGSimplifyPassArgs, _countof(CFGSimplifyPassArgs));
   if (strcmp(passName, "hlsl-dxil-add-pixel-hit-instrmentation") == 0) return ArrayRef<LPCSTR>(DxilAddPixelHitInstrumentationArgs, _countof(DxilAddPixelHitInstrumentationArgs));
+  if (strcmp(passName, "hlsl-dxil-block-count-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilBlockCountInstrumentationArgs, _countof(DxilBlockCountInstrumentationArgs));
+  if (strcmp(passName, "dxil-cluster-fetches") == 0) return ArrayRef<LPCSTR>(DxilClusterFetchesArgs, _countof(DxilClusterFetchesArgs));
+  if (strcmp(passName, "hlsl-dxil-condense") == 0) return ArrayRef<LPCSTR>(DxilCondenseResourcesArgs, _countof(DxilCondenseResourcesArgs));
   if (strcmp(passName, "hlsl-dxil-debug-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilDebugInstrumentationArgs, _countof(DxilDebugInstrumentationArgs));
+  if (strcmp(passName, "dxil-demote-output-precision") == 0) return ArrayRef<LPCSTR>(DxilDemoteOutputPrecisionArgs, _countof(DxilDemoteOutputPrecisionArgs));
+  if (strcmp(passName, "hlsl-dxil-eliminate-local-dynamic") == 0) return ArrayRef<LPCSTR>(DxilEliminateLocalDynamicIndexingArgs, _countof(DxilEliminateLocalDynamicIndexingArgs));
+  if (strcmp(passName, "dxil-eliminate-redundant-barriers") == 0) return ArrayRef<LPCSTR>(DxilEliminateRedundantBarriersArgs, _countof(DxilEliminateRedundantBarriersArgs));
+  if (strcmp(passName, "hlsl-dxil-expand-trig-intrinsics") == 0) return ArrayRef<LPCSTR>(DxilExpandTrigIntrinsicsArgs, _countof(DxilExpandTrigIntrinsicsArgs));
   if (strcmp(passName, "dxilgen") == 0) return ArrayRef<LPCSTR>(DxilGenerationPassArgs, _countof(DxilGenerationPassArgs));
+  if (strcmp(passName, "dxil-groupshared-bank-conflicts") == 0) return ArrayRef<LPCSTR>(DxilGroupSharedBankConflictsArgs, _countof(DxilGroupSharedBankConflictsArgs));
+  if (strcmp(passName, "dxil-infer-early-depth-stencil") == 0) return ArrayRef<LPCSTR>(DxilInferEarlyDepthStencilArgs, _countof(DxilInferEarlyDepthStencilArgs));
+  if (strcmp(passName, "dxil-loop-unroll") == 0) return ArrayRef<LPCSTR>(DxilLoopUnrollArgs, _countof(DxilLoopUnrollArgs));
+  if (strcmp(passName, "dxil-merge-identical-functions") == 0) return ArrayRef<LPCSTR>(DxilMergeIdenticalFunctionsArgs, _countof(DxilMergeIdenticalFunctionsArgs));
   if (strcmp(passName, "hlsl-dxil-constantColor") == 0) return ArrayRef<LPCSTR>(DxilOutputColorBecomesConstantArgs, _countof(DxilOutputColorBecomesConstantArgs));
+  if (strcmp(passName, "dxil-root-constant-candidates") == 0) return ArrayRef<LPCSTR>(DxilRootConstantCandidatesArgs, _countof(DxilRootConstantCandidatesArgs));
+  if (strcmp(passName, "dxil-select-control-flow-hints") == 0) return ArrayRef<LPCSTR>(DxilSelectControlFlowHintsArgs, _countof(DxilSelectControlFlowHintsArgs));
   if (strcmp(passName, "hlsl-dxil-pix-shader-access-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilShaderAccessTrackingArgs, _countof(DxilShaderAccessTrackingArgs));
+  if (strcmp(passName, "hlsl-dxil-timestamp-instrumentation") == 0) return ArrayRef<LPCSTR>(DxilTimestampInstrumentationArgs, _countof(DxilTimestampInstrumentationArgs));
+  if (strcmp(passName, "dxil-uniform-resource-index") == 0) return ArrayRef<LPCSTR>(DxilUniformResourceIndexArgs, _countof(DxilUniformResourceIndexArgs));
+  if (strcmp(passName, "dxil-wave-aggregate-atomics") == 0) return ArrayRef<LPCSTR>(DxilWaveAggregateAtomicsArgs, _countof(DxilWaveAggregateAtomicsArgs));
   if (strcmp(passName, "dynamic-vector-to-array") == 0) return ArrayRef<LPCSTR>(DynamicIndexingVectorToArrayArgs, _countof(DynamicIndexingVectorToArrayArgs));
   if (strcmp(passName, "float2int") == 0) return ArrayRef<LPCSTR>(Float2IntArgs, _countof(Float2IntArgs));
   if (strcmp(passName, "gvn") == 0) return ArrayRef<LPCSTR>(GVNArgs, _countof(GVNArgs));
+  if (strcmp(passName, "hl-bind-constants") == 0) return ArrayRef<LPCSTR>(HLBindConstantsArgs, _countof(HLBindConstantsArgs));
   if (strcmp(passName, "jump-threading") == 0) return ArrayRef<LPCSTR>(JumpThreadingArgs, _countof(JumpThreadingArgs));
   if (strcmp(passName, "licm") == 0) return ArrayRef<LPCSTR>(LICMArgs, _countof(LICMArgs));
   if (strcmp(passName, "loop-distribute") == 0) return ArrayRef<LPCSTR>(LoopDistributeArgs, _countof(LoopDistributeArgs));
@@ -329,34 +424,64 @@ static bool IsPassOptionName(StringRef S) {
   /* <py::lines('ISPASSOPTIONNAME')>hctdb_instrhelp.get_is_pass_option_name()</py>*/
   // ISPASSOPTIONNAME:BEGIN
   return S.equals("AllowPartial")
+    ||  S.equals("Apply")
     ||  S.equals("ArrayElementThreshold")
+    ||  S.equals("BankWidth")
+    ||  S.equals("Banks")
+    ||  S.equals("BiasedRatio")
+    ||  S.equals("BranchThreshold")
+    ||  S.equals("Contiguous")
     ||  S.equals("Count")
     ||  S.equals("DL")
+    ||  S.equals("DivergentBranchThreshold")
+    ||  S.equals("Fast")
     ||  S.equals("FatalErrors")
+    ||  S.equals("FirstInstruction")
+    ||  S.equals("FirstLine")
     ||  S.equals("Ftor")
+    ||  S.equals("Function")
+    ||  S.equals("InferNonUniform")
     ||  S.equals("InlineThreshold")
     ||  S.equals("InsertLifetime")
+    ||  S.equals("LastInstruction")
+    ||  S.equals("LastLine")
+    ||  S.equals("MaxDWords")
+    ||  S.equals("MaxElements")
     ||  S.equals("MaxHeaderSize")
+    ||  S.equals("MaxIterationAttempt")
+    ||  S.equals("MaxLiveComponents")
+    ||  S.equals("MaxSelects")
+    ||  S.equals("MaxUnrolledSize")
     ||  S.equals("NotOptimized")
     ||  S.equals("Os")
+    ||  S.equals("OutputBits")
+    ||  S.equals("Pad")
+    ||  S.equals("ProfiledOnly")
     ||  S.equals("ReplaceAllVectors")
+    ||  S.equals("Report")
     ||  S.equals("RequiresDomTree")
     ||  S.equals("Runtime")
     ||  S.equals("ScalarLoadThreshold")
+    ||  S.equals("SizeBudget")
     ||  S.equals("SkipHLSLMat")
     ||  S.equals("StructMemberThreshold")
     ||  S.equals("TIRA")
     ||  S.equals("TLIImpl")
     ||  S.equals("Threshold")
     ||  S.equals("UAVSize")
+    ||  S.equals("UniformOnly")
+    ||  S.equals("UpdateOrder")
     ||  S.equals("add-pixel-cost")
     ||  S.equals("bonus-inst-threshold")
     ||  S.equals("checkForDynamicIndexing")
+    ||  S.equals("clock-function")
+    ||  S.equals("compact")
     ||  S.equals("config")
     ||  S.equals("constant-alpha")
     ||  S.equals("constant-blue")
     ||  S.equals("constant-green")
     ||  S.equals("constant-red")
+    ||  S.equals("constants")
     ||  S.equals("disable-licm-promotion")
     ||  S.equals("enable-load-pre")
     ||  S.equals("enable-pre")
@@ -379,12 +504,15 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("no-discriminators")
     ||  S.equals("noloads")
     ||  S.equals("num-pixels")
+    ||  S.equals("overflow-size")
     ||  S.equals("parameter0")
     ||  S.equals("parameter1")
     ||  S.equals("parameter2")
     ||  S.equals("pragma-unroll-threshold")
+    ||  S.equals("regions")
     ||  S.equals("reroll-num-tolerated-failed-matches")
     ||  S.equals("rewrite-map-file")
+    ||  S.equals("ring-size")
     ||  S.equals("rotation-max-header-size")
     ||  S.equals("rt-width")
     ||  S.equals("sample-profile-file")
@@ -401,7 +529,8 @@ static bool IsPassOptionName(StringRef S) {
     ||  S.equals("unroll-runtime")
     ||  S.equals("unroll-threshold")
     ||  S.equals("vector-library")
-    ||  S.equals("verify-debug-info");
+    ||  S.equals("verify-debug-info")
+    ||  S.equals("wave-aggregate");
   // ISPASSOPTIONNAME:END
 }
 
@@ -480,7 +609,80 @@ public:
   }
 };
 
-class DxcOptimizer : public IDxcOptimizer {
+// Collects the passes run by RunOptimizerWithReport while in scope and renders
+// them as JSON, with pass runs summed per pass name as in -ftime-report.
+class DxcPassReportRecorder : public PhaseTimingListener {
+private:
+  struct PassTotal {
+    std::string Name;
+    double Seconds;
+    unsigned Runs;
+    int64_t InstructionDelta;
+  };
+  std::vector<PassTotal> m_passes;
+  StringMap<size_t> m_passIndex;
+  std::chrono::steady_clock::time_point m_start;
+  PhaseTimingListener *m_pPriorListener;
+
+  PassTotal &GetPass(StringRef Name) {
+    auto it = m_passIndex.insert(std::make_pair(Name, m_passes.size()));
+    if (it.second) {
+      PassTotal pass = {Name, 0, 0, 0};
+      m_passes.emplace_back(std::move(pass));
+    }
+    return m_passes[it.first->second];
+  }
+
+public:
+  static uint64_t CountInstructions(const Module &M) {
+    uint64_t count = 0;
+    for (const Function &F : M)
+      for (const BasicBlock &BB : F)
+        count += BB.size();
+    return count;
+  }
+
+  DxcPassReportRecorder() : m_start(std::chrono::steady_clock::now()) {
+    m_pPriorListener = setPhaseTimingListener(this);
+  }
+
+  ~DxcPassReportRecorder() { setPhaseTimingListener(m_pPriorListener); }
+
+  void phaseFinished(StringRef Name, double Seconds) override {}
+
+  void passFinished(StringRef Name, double Seconds) override {
+    PassTotal &pass = GetPass(Name);
+    pass.Seconds += Seconds;
+    ++pass.Runs;
+  }
+
+  bool wantsPassSizes() override { return true; }
+
+  void passSizeChanged(StringRef Name, int64_t InstructionDelta) override {
+    GetPass(Name).InstructionDelta += InstructionDelta;
+  }
+
+  void WriteReport(raw_ostream &OS, uint64_t InstructionsBefore,
+                   const Module &M) {
+    double total = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_start).count();
+    OS << "{\n  \"seconds\": " << format("%.6f", total)
+       << ",\n  \"instructionsBefore\": " << InstructionsBefore
+       << ",\n  \"instructionsAfter\": " << CountInstructions(M)
+       << ",\n  \"passes\": [";
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+      const PassTotal &pass = m_passes[i];
+      OS << (i ? ",\n" : "\n") << "    {\"name\": ";
+      WriteJsonString(OS, pass.Name);
+      OS << ", \"seconds\": " << format("%.6f", pass.Seconds)
+         << ", \"runs\": " << pass.Runs
+         << ", \"instructionDelta\": " << pass.InstructionDelta << "}";
+    }
+    OS << "\n  ]\n}\n";
+  }
+};
+
+class DxcOptimizer : public IDxcOptimizer2 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   PassRegistry *m_registry;
@@ -490,7 +692,7 @@ public:
   DXC_MICROCOM_TM_CTOR(DxcOptimizer)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcOptimizer>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcOptimizer, IDxcOptimizer2>(this, iid, ppvObject);
   }
 
   HRESULT Initialize();
@@ -503,7 +705,15 @@ public:
   HRESULT STDMETHODCALLTYPE RunOptimizer(IDxcBlob *pBlob,
     _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
     _COM_Outptr_ IDxcBlob **ppOutputModule,
-    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) override;
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) override {
+    return RunOptimizerWithReport(pBlob, ppOptions, optionCount,
+                                  ppOutputModule, ppOutputText, nullptr);
+  }
+  HRESULT STDMETHODCALLTYPE RunOptimizerWithReport(IDxcBlob *pBlob,
+    _In_count_(optionCount) LPCWSTR *ppOptions, UINT32 optionCount,
+    _COM_Outptr_ IDxcBlob **ppOutputModule,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppPassReport) override;
 };
 
 class CapturePassManager : public llvm::legacy::PassManagerBase {
@@ -566,12 +776,14 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::GetAvailablePass(
       GetPassArgDescriptions(m_passes[index]->getPassArgument()), ppResult);
 }
 
-HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
+HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizerWithReport(
     IDxcBlob *pBlob, _In_count_(optionCount) LPCWSTR *ppOptions,
     UINT32 optionCount, _COM_Outptr_ IDxcBlob **ppOutputModule,
-    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText) {
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppOutputText,
+    _COM_Outptr_opt_ IDxcBlobEncoding **ppPassReport) {
   AssignToOutOpt(nullptr, ppOutputModule);
   AssignToOutOpt(nullptr, ppOutputText);
+  AssignToOutOpt(nullptr, ppPassReport);
   if (pBlob == nullptr)
     return E_POINTER;
   if (optionCount > 0 && ppOptions == nullptr)
@@ -782,22 +994,40 @@ HRESULT STDMETHODCALLTYPE DxcOptimizer::RunOptimizer(
     }
 
     // Now that we have all of the passes ready, run them.
+    std::string passReport;
     {
       raw_ostream *err_ostream = &outStream;
       ScopedFatalErrorHandler errHandler(FatalErrorHandlerStreamWrite, err_ostream);
 
+      std::unique_ptr<DxcPassReportRecorder> pRecorder;
+      uint64_t instructionsBefore = 0;
+      if (ppPassReport != nullptr) {
+        instructionsBefore =
+            DxcPassReportRecorder::CountInstructions(*M.get());
+        pRecorder.reset(new DxcPassReportRecorder());
+      }
+
       FunctionPasses.doInitialization();
       for (Function &F : *M.get())
         if (!F.isDeclaration())
           FunctionPasses.run(F);
       FunctionPasses.doFinalization();
       ModulePasses.run(*M.get());
+
+      if (pRecorder) {
+        raw_string_ostream reportStream(passReport);
+        pRecorder->WriteReport(reportStream, instructionsBefore, *M.get());
+      }
     }
 
     outStream.flush();
     if (ppOutputText != nullptr) {
       IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppOutputText));
     }
+    if (ppPassReport != nullptr) {
+      IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+          passReport.data(), passReport.size(), CP_UTF8, ppPassReport));
+    }
     if (ppOutputModule != nullptr) {
       CComPtr<AbstractMemoryStream> pProgramStream;
       IFT(CreateMemoryStream(m_pMalloc, &pProgramStream));
@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilClusterFetches.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Moves texture and buffer fetches up within their block, next to each      //
+// other, so their latency overlaps.                                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Fetches come out in the order of the source, each next to the math that
+// uses it, and drivers that keep that order wait on each fetch in turn. Each
+// fetch here moves up to right after the last instruction it can't cross:
+// an earlier fetch, which keeps the fetches in order and next to each other,
+// a PHI, or an instruction that writes memory or has other side effects. The
+// instructions in between that compute its operands move up with it, in
+// their order; none of them writes memory, so moving them above the others,
+// loads included, doesn't change what they read.
+//
+// Each fetch result stays live from the fetch to its uses, so a group of
+// fetches, each moved to follow the last, is limited to MaxLiveComponents
+// components of results. A fetch that doesn't fit stays where it is.
+
+namespace {
+
+// How far up, in instructions, a fetch looks for where it can go.
+static const unsigned kMaxDistance = 256;
+
+class DxilClusterFetches : public FunctionPass {
+  unsigned m_MaxLiveComponents;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilClusterFetches(unsigned MaxLiveComponents = 16)
+      : FunctionPass(ID), m_MaxLiveComponents(MaxLiveComponents) {}
+
+  const char *getPassName() const override { return "DXIL cluster fetches"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "MaxLiveComponents", &m_MaxLiveComponents, 16);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",MaxLiveComponents=" << m_MaxLiveComponents;
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  static bool IsFetch(Instruction *I);
+  static unsigned GetUsedComponents(Instruction *Fetch);
+  static bool Hoist(Instruction *Fetch, Instruction *Floor);
+};
+
+bool DxilClusterFetches::IsFetch(Instruction *I) {
+  if (!OP::IsDxilOpFuncCallInst(I))
+    return false;
+  switch (OP::GetDxilOpFuncCallInst(I)) {
+  case DXIL::OpCode::Sample:
+  case DXIL::OpCode::SampleBias:
+  case DXIL::OpCode::SampleLevel:
+  case DXIL::OpCode::SampleGrad:
+  case DXIL::OpCode::SampleCmp:
+  case DXIL::OpCode::SampleCmpLevelZero:
+  case DXIL::OpCode::TextureLoad:
+  case DXIL::OpCode::TextureGather:
+  case DXIL::OpCode::TextureGatherCmp:
+  case DXIL::OpCode::BufferLoad:
+  case DXIL::OpCode::RawBufferLoad:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Gets the number of result components that are used, which is what a
+// fetch keeps live.
+unsigned DxilClusterFetches::GetUsedComponents(Instruction *Fetch) {
+  unsigned UsedMask = 0;
+  for (User *U : Fetch->users()) {
+    ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(U);
+    if (!EVI || EVI->getNumIndices() != 1 || EVI->getIndices()[0] >= 32)
+      return 4;
+    UsedMask |= 1u << EVI->getIndices()[0];
+  }
+  return std::max(1u, countPopulation(UsedMask));
+}
+
+// Moves Fetch, and the operands it computes after Floor, to right after
+// Floor, or to the start of the block if Floor is null. Returns true if
+// anything moved.
+bool DxilClusterFetches::Hoist(Instruction *Fetch, Instruction *Floor) {
+  BasicBlock *BB = Fetch->getParent();
+  Instruction *Start = Floor ? Floor->getNextNode() : &BB->front();
+  if (Start == Fetch)
+    return false;
+
+  SmallPtrSet<Instruction *, 16> Between;
+  for (Instruction *I = Start; I != Fetch; I = I->getNextNode())
+    Between.insert(I);
+  SmallPtrSet<Instruction *, 16> Moved;
+  SmallVector<Instruction *, 16> Worklist;
+  Worklist.push_back(Fetch);
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    for (Value *Op : I->operands()) {
+      Instruction *OpI = dyn_cast<Instruction>(Op);
+      if (OpI && Between.count(OpI) && Moved.insert(OpI).second)
+        Worklist.push_back(OpI);
+    }
+  }
+  // Nothing else is in between, so the fetch already is as early as it
+  // gets.
+  if (Moved.size() == Between.size())
+    return false;
+
+  SmallVector<Instruction *, 16> InOrder;
+  for (Instruction *I = Start; I != Fetch; I = I->getNextNode()) {
+    if (Moved.count(I))
+      InOrder.push_back(I);
+  }
+  InOrder.push_back(Fetch);
+  for (Instruction *I : InOrder)
+    I->moveBefore(Start);
+  return true;
+}
+
+bool DxilClusterFetches::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule() || m_MaxLiveComponents == 0)
+    return false;
+
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    SmallVector<Instruction *, 8> Fetches;
+    for (Instruction &I : BB) {
+      if (IsFetch(&I))
+        Fetches.push_back(&I);
+    }
+
+    // The last fetch, and the result components of the group it ends.
+    Instruction *LastFetch = nullptr;
+    unsigned GroupComponents = 0;
+    for (Instruction *Fetch : Fetches) {
+      Instruction *Floor = nullptr;
+      unsigned Distance = 0;
+      for (Instruction *I = Fetch->getPrevNode(); I; I = I->getPrevNode()) {
+        if (IsFetch(I) || isa<PHINode>(I) || I->mayWriteToMemory() ||
+            I->mayHaveSideEffects() || ++Distance > kMaxDistance) {
+          Floor = I;
+          break;
+        }
+      }
+
+      unsigned Components = GetUsedComponents(Fetch);
+      bool bJoinsGroup = Floor && Floor == LastFetch;
+      if (bJoinsGroup &&
+          GroupComponents + Components > m_MaxLiveComponents) {
+        // Starts a group of its own where it is.
+        GroupComponents = Components;
+        LastFetch = Fetch;
+        continue;
+      }
+      bChanged |= Hoist(Fetch, Floor);
+      GroupComponents = bJoinsGroup ? GroupComponents + Components
+                                    : Components;
+      LastFetch = Fetch;
+    }
+  }
+  return bChanged;
+}
+
+}
+
+char DxilClusterFetches::ID = 0;
+
+FunctionPass *llvm::createDxilClusterFetchesPass(unsigned MaxLiveComponents) {
+  return new DxilClusterFetches(MaxLiveComponents);
+}
+
+INITIALIZE_PASS(DxilClusterFetches, "dxil-cluster-fetches",
+                "DXIL cluster fetches", false, false)
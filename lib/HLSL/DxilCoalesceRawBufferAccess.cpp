@@ -0,0 +1,444 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilCoalesceRawBufferAccess.cpp                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Merges adjacent raw buffer loads and stores into wider ones.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilModule.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+///////////////////////////////////////////////////////////////////////////////
+// Coalesce raw buffer access.
+
+namespace {
+// Raw buffer accesses read or write at most four components.
+const unsigned kMaxComponents = 4;
+
+// A rawBufferLoad or rawBufferStore of components [0, NumComps) at a constant
+// byte offset from the base address of its group.
+struct RawBufferAccess {
+  CallInst *CI;
+  int64_t ByteOffset;
+  unsigned NumComps;
+  unsigned Order; // Position in the block.
+};
+
+// Accesses merge when they share handle, base index, base element offset and
+// overload. Raw buffers put the byte offset in the index; structured buffers
+// put it in the element offset.
+typedef std::pair<std::pair<Value *, Value *>, std::pair<Value *, Function *>>
+    AccessKey;
+
+struct AccessGroup {
+  AccessKey Key;
+  unsigned EltSize;
+  SmallVector<RawBufferAccess, 4> Accesses;
+};
+
+// Splits V into a base value and a constant added to it. The base is null when
+// V is a constant. InstCombine turns adds of aligned offsets into ors, so an or
+// with no bits in common counts as an add.
+void SplitConstantOffset(Value *V, const DataLayout &DL, Value *&Base,
+                         int64_t &Offset) {
+  Base = V;
+  Offset = 0;
+  if (ConstantInt *C = dyn_cast<ConstantInt>(V)) {
+    Base = nullptr;
+    Offset = C->getSExtValue();
+  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(V)) {
+    ConstantInt *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+    if (!C)
+      return;
+    if (BO->getOpcode() == Instruction::Add ||
+        (BO->getOpcode() == Instruction::Or &&
+         haveNoCommonBitsSet(BO->getOperand(0), C, DL))) {
+      Base = BO->getOperand(0);
+      Offset = C->getSExtValue();
+    }
+  }
+}
+
+// Returns the number of components in a mask of the form (1 << N) - 1, or 0
+// for any other mask.
+unsigned GetLowComponentCount(Value *Mask) {
+  ConstantInt *C = dyn_cast<ConstantInt>(Mask);
+  if (!C)
+    return 0;
+  uint64_t Bits = C->getZExtValue();
+  if (Bits == 0 || Bits >= (1u << kMaxComponents) || (Bits & (Bits + 1)) != 0)
+    return 0;
+  unsigned NumComps = 0;
+  for (; Bits; Bits >>= 1)
+    ++NumComps;
+  return NumComps;
+}
+
+// Merge contiguous rawBufferLoads and rawBufferStores on the same handle within
+// a basic block into the widest legal access, such as the loads generated for
+// each field of a structure read from a ByteAddressBuffer:
+// %a = rawBufferLoad(h, i, undef, mask 0x7)       ; float3 at i
+// %b = rawBufferLoad(h, i + 12, undef, mask 0x1)  ; float at i + 12
+// becomes a single rawBufferLoad(h, i, undef, mask 0xf).
+// Loads merge across other loads and stores across other stores to different
+// handles, so resources must not alias.
+class DxilCoalesceRawBufferAccess : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilCoalesceRawBufferAccess() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL coalesce raw buffer access";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override {
+    Module &M = *F.getParent();
+    if (!M.HasDxilModule())
+      return false;
+    DxilModule &DM = M.GetDxilModule();
+    m_pHlslOP = DM.GetOP();
+    m_pDL = &M.getDataLayout();
+    m_bMinPrecision = DM.GetUseMinPrecision();
+
+    bool bChanged = false;
+    for (BasicBlock &BB : F)
+      bChanged |= runOnBlock(BB);
+    return bChanged;
+  }
+
+private:
+  hlsl::OP *m_pHlslOP;
+  const DataLayout *m_pDL;
+  bool m_bMinPrecision;
+  // Position of each visited instruction in the current block.
+  DenseMap<Instruction *, unsigned> m_Order;
+  bool m_bChanged;
+
+  struct AccessWindow {
+    DenseMap<AccessKey, unsigned> GroupIdx;
+    std::vector<AccessGroup> Groups;
+  };
+
+  bool runOnBlock(BasicBlock &BB);
+  bool GetAccess(CallInst *CI, bool bStore, AccessKey &Key,
+                 RawBufferAccess &Access, unsigned &EltSize);
+  AccessGroup &GetGroup(AccessWindow &Window, const AccessKey &Key,
+                        unsigned EltSize);
+  void FlushLoads(AccessWindow &Window);
+  void FlushStores(AccessWindow &Window);
+  void CoalesceLoads(AccessGroup &Group);
+  void CoalesceStores(AccessGroup &Group);
+  bool IsAvailableBefore(Value *V, BasicBlock *BB, unsigned Order);
+};
+
+char DxilCoalesceRawBufferAccess::ID = 0;
+
+bool DxilCoalesceRawBufferAccess::GetAccess(CallInst *CI, bool bStore,
+                                            AccessKey &Key,
+                                            RawBufferAccess &Access,
+                                            unsigned &EltSize) {
+  Value *Handle, *Index, *ElementOffset, *Mask;
+  Type *EltTy;
+  if (bStore) {
+    DxilInst_RawBufferStore bufSt(CI);
+    Handle = bufSt.get_uav();
+    Index = bufSt.get_index();
+    ElementOffset = bufSt.get_elementOffset();
+    Mask = bufSt.get_mask();
+    EltTy = bufSt.get_value0()->getType();
+  } else {
+    DxilInst_RawBufferLoad bufLd(CI);
+    Handle = bufLd.get_srv();
+    Index = bufLd.get_index();
+    ElementOffset = bufLd.get_elementOffset();
+    Mask = bufLd.get_mask();
+    EltTy = CI->getType()->getStructElementType(0);
+    // Only component extracts can be redirected into the wider load; the
+    // status of the wider load differs from the narrow one.
+    for (User *U : CI->users()) {
+      ExtractValueInst *EV = dyn_cast<ExtractValueInst>(U);
+      if (!EV || EV->getNumIndices() != 1 ||
+          EV->getIndices()[0] >= DXIL::kResRetStatusIndex)
+        return false;
+    }
+  }
+
+  // Min precision types are stored in 32 bits even though their type is
+  // smaller, so their offsets do not follow the type size.
+  if (m_bMinPrecision && EltTy->getScalarSizeInBits() < 32)
+    return false;
+
+  Access.NumComps = GetLowComponentCount(Mask);
+  if (!Access.NumComps)
+    return false;
+
+  Value *IndexBase = Index;
+  Value *OffsetBase = ElementOffset;
+  if (isa<UndefValue>(ElementOffset))
+    SplitConstantOffset(Index, *m_pDL, IndexBase, Access.ByteOffset);
+  else
+    SplitConstantOffset(ElementOffset, *m_pDL, OffsetBase, Access.ByteOffset);
+
+  Access.CI = CI;
+  Key = AccessKey(std::make_pair(Handle, IndexBase),
+                  std::make_pair(OffsetBase, CI->getCalledFunction()));
+  EltSize = m_pDL->getTypeAllocSize(EltTy);
+  return EltSize != 0;
+}
+
+AccessGroup &DxilCoalesceRawBufferAccess::GetGroup(AccessWindow &Window,
+                                                   const AccessKey &Key,
+                                                   unsigned EltSize) {
+  auto It = Window.GroupIdx.find(Key);
+  if (It != Window.GroupIdx.end())
+    return Window.Groups[It->second];
+  Window.GroupIdx[Key] = Window.Groups.size();
+  Window.Groups.emplace_back();
+  AccessGroup &Group = Window.Groups.back();
+  Group.Key = Key;
+  Group.EltSize = EltSize;
+  return Group;
+}
+
+bool DxilCoalesceRawBufferAccess::IsAvailableBefore(Value *V, BasicBlock *BB,
+                                                    unsigned Order) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I || I->getParent() != BB)
+    return true;
+  auto It = m_Order.find(I);
+  return It != m_Order.end() && It->second < Order;
+}
+
+static bool CompareByOffset(const RawBufferAccess &A,
+                            const RawBufferAccess &B) {
+  if (A.ByteOffset != B.ByteOffset)
+    return A.ByteOffset < B.ByteOffset;
+  return A.Order < B.Order;
+}
+
+void DxilCoalesceRawBufferAccess::CoalesceLoads(AccessGroup &Group) {
+  auto &Accesses = Group.Accesses;
+  if (Accesses.size() < 2)
+    return;
+  const int64_t EltSize = Group.EltSize;
+  const int64_t MaxSize = EltSize * kMaxComponents;
+  std::sort(Accesses.begin(), Accesses.end(), CompareByOffset);
+
+  for (unsigned Begin = 0, End; Begin < Accesses.size(); Begin = End) {
+    // Extend the run while the loads overlap or touch and fit in one load.
+    const RawBufferAccess &Base = Accesses[Begin];
+    int64_t RunEnd = Base.ByteOffset + Base.NumComps * EltSize;
+    unsigned FirstOrder = Base.Order;
+    for (End = Begin + 1; End < Accesses.size(); ++End) {
+      const RawBufferAccess &A = Accesses[End];
+      int64_t AEnd = A.ByteOffset + A.NumComps * EltSize;
+      if (A.ByteOffset > RunEnd || (A.ByteOffset - Base.ByteOffset) % EltSize ||
+          std::max(RunEnd, AEnd) - Base.ByteOffset > MaxSize)
+        break;
+      RunEnd = std::max(RunEnd, AEnd);
+      FirstOrder = std::min(FirstOrder, A.Order);
+    }
+    if (End - Begin < 2)
+      continue;
+
+    // The wider load replaces the earliest one, so the address of the lowest
+    // must be computed by then.
+    CallInst *BaseCI = Base.CI;
+    Instruction *InsertPt = nullptr;
+    for (unsigned i = Begin; i < End; ++i)
+      if (Accesses[i].Order == FirstOrder)
+        InsertPt = Accesses[i].CI;
+    BasicBlock *BB = InsertPt->getParent();
+    DxilInst_RawBufferLoad bufLd(BaseCI);
+    if (!IsAvailableBefore(bufLd.get_index(), BB, FirstOrder) ||
+        !IsAvailableBefore(bufLd.get_elementOffset(), BB, FirstOrder))
+      continue;
+
+    unsigned NumComps = (RunEnd - Base.ByteOffset) / EltSize;
+    SmallVector<Value *, 6> Args(BaseCI->arg_operands());
+    Args[DXIL::OperandIndex::kRawBufferLoadMaskOpIdx] =
+        m_pHlslOP->GetI8Const((1 << NumComps) - 1);
+    IRBuilder<> Builder(InsertPt);
+    CallInst *NewLd = Builder.CreateCall(BaseCI->getCalledFunction(), Args);
+
+    for (unsigned i = Begin; i < End; ++i) {
+      CallInst *CI = Accesses[i].CI;
+      unsigned Shift = (Accesses[i].ByteOffset - Base.ByteOffset) / EltSize;
+      for (auto U = CI->user_begin(); U != CI->user_end();) {
+        ExtractValueInst *EV = cast<ExtractValueInst>(*(U++));
+        IRBuilder<> EVBuilder(EV);
+        Value *NewEV =
+            EVBuilder.CreateExtractValue(NewLd, EV->getIndices()[0] + Shift);
+        EV->replaceAllUsesWith(NewEV);
+        EV->eraseFromParent();
+      }
+      CI->eraseFromParent();
+    }
+    m_bChanged = true;
+  }
+}
+
+void DxilCoalesceRawBufferAccess::CoalesceStores(AccessGroup &Group) {
+  auto &Accesses = Group.Accesses;
+  if (Accesses.size() < 2)
+    return;
+  const int64_t EltSize = Group.EltSize;
+  const int64_t MaxSize = EltSize * kMaxComponents;
+  // Stores in a group never overlap, so their order does not matter.
+  std::sort(Accesses.begin(), Accesses.end(), CompareByOffset);
+
+  for (unsigned Begin = 0, End; Begin < Accesses.size(); Begin = End) {
+    // Extend the run while the stores touch and fit in one store.
+    const RawBufferAccess &Base = Accesses[Begin];
+    int64_t RunEnd = Base.ByteOffset + Base.NumComps * EltSize;
+    unsigned LastOrder = Base.Order;
+    for (End = Begin + 1; End < Accesses.size(); ++End) {
+      const RawBufferAccess &A = Accesses[End];
+      int64_t AEnd = A.ByteOffset + A.NumComps * EltSize;
+      if (A.ByteOffset != RunEnd || AEnd - Base.ByteOffset > MaxSize)
+        break;
+      RunEnd = AEnd;
+      LastOrder = std::max(LastOrder, A.Order);
+    }
+    if (End - Begin < 2)
+      continue;
+
+    // The wider store replaces the latest one, where every value is ready.
+    CallInst *BaseCI = Base.CI;
+    Instruction *InsertPt = nullptr;
+    for (unsigned i = Begin; i < End; ++i)
+      if (Accesses[i].Order == LastOrder)
+        InsertPt = Accesses[i].CI;
+
+    unsigned NumComps = (RunEnd - Base.ByteOffset) / EltSize;
+    SmallVector<Value *, 10> Args(BaseCI->arg_operands());
+    for (unsigned i = Begin; i < End; ++i) {
+      CallInst *CI = Accesses[i].CI;
+      unsigned Shift = (Accesses[i].ByteOffset - Base.ByteOffset) / EltSize;
+      for (unsigned c = 0; c < Accesses[i].NumComps; ++c)
+        Args[DXIL::OperandIndex::kRawBufferStoreVal0OpIdx + Shift + c] =
+            CI->getArgOperand(DXIL::OperandIndex::kRawBufferStoreVal0OpIdx + c);
+    }
+    Args[DXIL::OperandIndex::kRawBufferStoreMaskOpIdx] =
+        m_pHlslOP->GetI8Const((1 << NumComps) - 1);
+    IRBuilder<> Builder(InsertPt);
+    Builder.CreateCall(BaseCI->getCalledFunction(), Args);
+
+    for (unsigned i = Begin; i < End; ++i)
+      Accesses[i].CI->eraseFromParent();
+    m_bChanged = true;
+  }
+}
+
+void DxilCoalesceRawBufferAccess::FlushLoads(AccessWindow &Window) {
+  for (AccessGroup &Group : Window.Groups)
+    CoalesceLoads(Group);
+  Window.Groups.clear();
+  Window.GroupIdx.clear();
+}
+
+void DxilCoalesceRawBufferAccess::FlushStores(AccessWindow &Window) {
+  for (AccessGroup &Group : Window.Groups)
+    CoalesceStores(Group);
+  Window.Groups.clear();
+  Window.GroupIdx.clear();
+}
+
+bool DxilCoalesceRawBufferAccess::runOnBlock(BasicBlock &BB) {
+  m_bChanged = false;
+  m_Order.clear();
+  AccessWindow Loads;
+  AccessWindow Stores;
+  unsigned Order = 0;
+  for (auto It = BB.begin(); It != BB.end();) {
+    Instruction *I = It++;
+    m_Order[I] = ++Order;
+
+    CallInst *CI = dyn_cast<CallInst>(I);
+    if (CI && hlsl::OP::IsDxilOpFunc(CI->getCalledFunction())) {
+      DXIL::OpCode opcode = hlsl::OP::GetDxilOpFuncCallInst(CI);
+      AccessKey Key;
+      RawBufferAccess Access;
+      unsigned EltSize;
+      if (opcode == DXIL::OpCode::RawBufferLoad) {
+        // Stores must not move across this load.
+        FlushStores(Stores);
+        if (GetAccess(CI, /*bStore*/ false, Key, Access, EltSize)) {
+          Access.Order = Order;
+          GetGroup(Loads, Key, EltSize).Accesses.emplace_back(Access);
+        }
+        continue;
+      }
+      if (opcode == DXIL::OpCode::RawBufferStore) {
+        // Loads must not move across this store.
+        FlushLoads(Loads);
+        if (!GetAccess(CI, /*bStore*/ true, Key, Access, EltSize)) {
+          FlushStores(Stores);
+          continue;
+        }
+        Access.Order = Order;
+        // Stores to other addresses of the same handle may overlap this one,
+        // and so may earlier stores in its own group; those must stay before
+        // it.
+        int64_t AEnd = Access.ByteOffset + Access.NumComps * EltSize;
+        for (AccessGroup &Group : Stores.Groups) {
+          if (Group.Key.first.first != Key.first.first)
+            continue;
+          bool bOverlap = Group.Key != Key;
+          for (RawBufferAccess &Prev : Group.Accesses)
+            bOverlap |= Prev.ByteOffset < AEnd &&
+                        Access.ByteOffset <
+                            Prev.ByteOffset + Prev.NumComps * Group.EltSize;
+          if (bOverlap) {
+            CoalesceStores(Group);
+            Group.Accesses.clear();
+          }
+        }
+        GetGroup(Stores, Key, EltSize).Accesses.emplace_back(Access);
+        continue;
+      }
+    }
+
+    if (I->mayWriteToMemory())
+      FlushLoads(Loads);
+    if (I->mayReadOrWriteMemory())
+      FlushStores(Stores);
+  }
+  FlushLoads(Loads);
+  FlushStores(Stores);
+  return m_bChanged;
+}
+
+}
+
+FunctionPass *llvm::createDxilCoalesceRawBufferAccessPass() {
+  return new DxilCoalesceRawBufferAccess();
+}
+
+INITIALIZE_PASS(DxilCoalesceRawBufferAccess, "dxil-coalesce-raw-buffer",
+                "DXIL coalesce raw buffer access", false, false)
@@ -31,7 +31,9 @@
 #include "llvm/ADT/SetVector.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include <algorithm>
 #include <memory>
+#include <string>
 #include <unordered_set>
 
 using namespace llvm;
@@ -119,7 +121,7 @@ private:
   static bool
   AllocateRegisters(const std::vector<std::unique_ptr<T>> &resourceList,
     LLVMContext &Ctx, SpacesAllocator<unsigned, T> &ReservedRegisters,
-    unsigned AutoBindingSpace) {
+    unsigned AutoBindingSpace, const std::vector<std::string> *pUpdateOrder) {
     bool bChanged = false;
     SpacesAllocator<unsigned, T> SAlloc;
 
@@ -170,9 +172,38 @@ private:
     const unsigned space = AutoBindingSpace;
     typename SpacesAllocator<unsigned, T>::Allocator &alloc0 = SAlloc.Get(space);
     typename SpacesAllocator<unsigned, T>::Allocator &reservedAlloc0 = ReservedRegisters.Get(space);
+    std::vector<T *> unallocated;
     for (auto &res : resourceList) {
-      if (res->IsAllocated())
-        continue;
+      if (!res->IsAllocated())
+        unallocated.emplace_back(res.get());
+    }
+
+    // In contiguous mode, resources are placed one after the other, in the
+    // update order, from the first gap that holds all the bounded ones; the
+    // unbounded one goes last, so it is adjacent when nothing follows.
+    unsigned cursor = 0;
+    if (pUpdateOrder) {
+      const std::vector<std::string> &order = *pUpdateOrder;
+      auto rank = [&order](const T *res) {
+        return (size_t)(std::find(order.begin(), order.end(),
+                                  res->GetGlobalName()) - order.begin());
+      };
+      std::stable_sort(unallocated.begin(), unallocated.end(),
+          [&rank](const T *a, const T *b) {
+            if (a->IsUnbounded() != b->IsUnbounded())
+              return b->IsUnbounded();
+            return rank(a) < rank(b);
+          });
+      unsigned total = 0;
+      for (const T *res : unallocated) {
+        if (!res->IsUnbounded())
+          total += res->GetRangeSize();
+      }
+      if (total && !reservedAlloc0.Find(total, cursor))
+        cursor = 0;
+    }
+
+    for (T *res : unallocated) {
 
       DXASSERT(res->GetSpaceID() == 0,
         "otherwise non-zero space has no user register assignment");
@@ -195,25 +226,33 @@ private:
           allocateSpaceFound = true;
         }
       }
-      else if (reservedAlloc0.Find(res->GetRangeSize(), reg)) {
+      else {
+        // Past the cursor first, then anywhere.
+        reg = cursor;
+        allocateSpaceFound = reservedAlloc0.Find(res->GetRangeSize(), reg);
+        if (!allocateSpaceFound && cursor) {
+          reg = 0;
+          allocateSpaceFound = reservedAlloc0.Find(res->GetRangeSize(), reg);
+        }
         end = reg + res->GetRangeSize() - 1;
-        allocateSpaceFound = true;
       }
 
       if (allocateSpaceFound) {
-        bool success = reservedAlloc0.Insert(res.get(), reg, end) == nullptr;
+        bool success = reservedAlloc0.Insert(res, reg, end) == nullptr;
         DXASSERT_NOMSG(success);
 
-        success = alloc0.Insert(res.get(), reg, end) == nullptr;
+        success = alloc0.Insert(res, reg, end) == nullptr;
         DXASSERT_NOMSG(success);
 
         if (res->IsUnbounded()) {
-          alloc0.SetUnbounded(res.get());
-          reservedAlloc0.SetUnbounded(res.get());
+          alloc0.SetUnbounded(res);
+          reservedAlloc0.SetUnbounded(res);
         }
 
         res->SetLowerBound(reg);
         res->SetSpaceID(space);
+        if (pUpdateOrder && !res->IsUnbounded())
+          cursor = end + 1;
         bChanged = true;
       } else {
         Ctx.emitError(((res->IsUnbounded()) ? Twine("unbounded ") : Twine("")) +
@@ -237,7 +276,10 @@ public:
     }
   }
 
-  bool AllocateRegisters(DxilModule &DM) {
+  // With pUpdateOrder, the resources without a register of each class are
+  // packed, most frequently updated first as that list of names says.
+  bool AllocateRegisters(DxilModule &DM,
+                         const std::vector<std::string> *pUpdateOrder = nullptr) {
     uint32_t AutoBindingSpace = DM.GetAutoBindingSpace();
     if (AutoBindingSpace == UINT_MAX) {
       // For libraries, we don't allocate unless AutoBindingSpace is set.
@@ -248,24 +290,60 @@ public:
     }
 
     bool bChanged = false;
-    bChanged |= AllocateRegisters(DM.GetCBuffers(), DM.GetCtx(), m_reservedCBufferRegisters, AutoBindingSpace);
-    bChanged |= AllocateRegisters(DM.GetSamplers(), DM.GetCtx(), m_reservedSamplerRegisters, AutoBindingSpace);
-    bChanged |= AllocateRegisters(DM.GetUAVs(), DM.GetCtx(), m_reservedUAVRegisters, AutoBindingSpace);
-    bChanged |= AllocateRegisters(DM.GetSRVs(), DM.GetCtx(), m_reservedSRVRegisters, AutoBindingSpace);
+    bChanged |= AllocateRegisters(DM.GetCBuffers(), DM.GetCtx(), m_reservedCBufferRegisters, AutoBindingSpace, pUpdateOrder);
+    bChanged |= AllocateRegisters(DM.GetSamplers(), DM.GetCtx(), m_reservedSamplerRegisters, AutoBindingSpace, pUpdateOrder);
+    bChanged |= AllocateRegisters(DM.GetUAVs(), DM.GetCtx(), m_reservedUAVRegisters, AutoBindingSpace, pUpdateOrder);
+    bChanged |= AllocateRegisters(DM.GetSRVs(), DM.GetCtx(), m_reservedSRVRegisters, AutoBindingSpace, pUpdateOrder);
     return bChanged;
   }
 };
 
+// With Contiguous, the registers that the compiler picks are packed instead
+// of first-fit: in each class, the resources without a register follow one
+// another from the first gap of the auto-binding space that holds them all,
+// in the order of UpdateOrder, most frequently updated resource first, then
+// in declaration order:
+//   hlsl-dxil-condense,Contiguous=1,UpdateOrder=<name>;<name>...
+// The user supplies the UpdateOrder list. The pass then warns with the
+// descriptor tables that match the bindings, one for the CBVs, SRVs and UAVs
+// and one for the samplers, as root signature text.
 class DxilCondenseResources : public ModulePass {
 private:
   RemapEntryCollection m_rewrites;
+  bool m_Contiguous;
+  std::string m_UpdateOrderText;
+  std::vector<std::string> m_UpdateOrder;
 
 public:
   static char ID; // Pass identification, replacement for typeid
-  explicit DxilCondenseResources() : ModulePass(ID) {}
+  explicit DxilCondenseResources() : ModulePass(ID), m_Contiguous(false) {}
 
   const char *getPassName() const override { return "DXIL Condense Resources"; }
 
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Contiguous", &m_Contiguous, false);
+    StringRef UpdateOrder;
+    if (GetPassOption(O, "UpdateOrder", &UpdateOrder)) {
+      m_UpdateOrderText = UpdateOrder;
+      m_UpdateOrder.clear();
+      SmallVector<StringRef, 8> Names;
+      StringRef(m_UpdateOrderText).split(Names, ";", -1, false);
+      for (StringRef Name : Names)
+        m_UpdateOrder.emplace_back(Name.trim());
+    }
+  }
+
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",Contiguous=" << m_Contiguous;
+    if (!m_UpdateOrderText.empty())
+      OS << ",UpdateOrder=" << m_UpdateOrderText;
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &DM = M.GetOrCreateDxilModule();
     // Skip lib.
@@ -291,8 +369,11 @@ public:
 
     if (hasResource) {
       if (!DM.GetShaderModel()->IsLib()) {
-        ResourceRegisterAllocator.AllocateRegisters(DM);
+        ResourceRegisterAllocator.AllocateRegisters(
+            DM, m_Contiguous ? &m_UpdateOrder : nullptr);
         PatchCreateHandle(DM);
+        if (m_Contiguous)
+          ReportDescriptorTables(DM);
       }
     }
     return true;
@@ -307,6 +388,7 @@ private:
   void ApplyRewriteMap(DxilModule &DM);
   // Add lowbound to create handle range index.
   void PatchCreateHandle(DxilModule &DM);
+  void ReportDescriptorTables(DxilModule &DM);
 };
 
 void DxilCondenseResources::ApplyRewriteMap(DxilModule &DM) {
@@ -401,6 +483,62 @@ void DxilCondenseResources::PatchCreateHandle(DxilModule &DM) {
   }
 }
 
+namespace {
+// Writes the descriptor ranges that cover Rs, merging the resources that
+// follow one another in the same space.
+template <typename T>
+void WriteDescriptorRanges(const std::vector<std::unique_ptr<T>> &Rs,
+                           const char *Type, char Register, raw_ostream &OS) {
+  std::vector<std::pair<unsigned, std::pair<unsigned, unsigned>>> Ranges;
+  for (auto &R : Rs) {
+    if (R->IsAllocated())
+      Ranges.push_back({R->GetSpaceID(),
+                        {R->GetLowerBound(), R->GetUpperBound()}});
+  }
+  std::sort(Ranges.begin(), Ranges.end());
+  for (unsigned i = 0; i < Ranges.size();) {
+    unsigned Space = Ranges[i].first;
+    unsigned Lower = Ranges[i].second.first;
+    unsigned Upper = Ranges[i].second.second;
+    for (++i; i < Ranges.size() && Ranges[i].first == Space &&
+              Upper != UINT_MAX && Ranges[i].second.first == Upper + 1;
+         ++i)
+      Upper = Ranges[i].second.second;
+    OS << (OS.tell() ? ", " : "") << Type << "(" << Register << Lower;
+    if (Upper == UINT_MAX)
+      OS << ", numDescriptors=unbounded";
+    else if (Upper != Lower)
+      OS << ", numDescriptors=" << (Upper - Lower + 1);
+    if (Space)
+      OS << ", space=" << Space;
+    OS << ")";
+  }
+}
+} // namespace
+
+void DxilCondenseResources::ReportDescriptorTables(DxilModule &DM) {
+  // Samplers cannot share a table with the other classes.
+  std::string Views, Samplers;
+  raw_string_ostream ViewsOS(Views), SamplersOS(Samplers);
+  WriteDescriptorRanges(DM.GetCBuffers(), "CBV", 'b', ViewsOS);
+  WriteDescriptorRanges(DM.GetSRVs(), "SRV", 't', ViewsOS);
+  WriteDescriptorRanges(DM.GetUAVs(), "UAV", 'u', ViewsOS);
+  WriteDescriptorRanges(DM.GetSamplers(), "Sampler", 's', SamplersOS);
+  ViewsOS.flush();
+  SamplersOS.flush();
+  if (Views.empty() && Samplers.empty())
+    return;
+
+  std::string Msg;
+  raw_string_ostream OS(Msg);
+  OS << "descriptor tables for " << DM.GetEntryFunctionName() << ": ";
+  if (!Views.empty())
+    OS << "DescriptorTable(" << Views << ")";
+  if (!Samplers.empty())
+    OS << (Views.empty() ? "" : ", ") << "DescriptorTable(" << Samplers << ")";
+  DM.GetCtx().emitWarning(dxilutil::FormatMessageWithoutLocation(OS.str()));
+}
+
 char DxilCondenseResources::ID = 0;
 
 bool llvm::AreDxilResourcesDense(llvm::Module *M, hlsl::DxilResourceBase **ppNonDense) {
@@ -438,6 +576,10 @@ public:
     return "DXIL Lower createHandleForLib";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &DM = M.GetOrCreateDxilModule();
     m_DM = &DM;
@@ -1485,6 +1627,10 @@ public:
     return "DXIL Legalize Resource Use";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     LegalizeResourceUseHelper helper;
     return helper.runOnModule(M);
@@ -2095,6 +2241,10 @@ public:
   }
   const char *getPassName() const override { return "DXIL Condense Resources"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &DM = M.GetOrCreateDxilModule();
     // Must specify a default space, and must apply to library.
@@ -13,10 +13,13 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/InstIterator.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+#include "dxc/DxilContainer/DxilShaderStatistics.h"
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilShaderModel.h"
 #include "dxc/DXIL/DxilOperations.h"
 #include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
 #include "dxc/Support/Global.h"
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/WinIncludes.h"
@@ -25,8 +28,14 @@
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/DXIL/DxilFunctionProps.h"
 
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <tuple>
 #include <unordered_set>
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 #include "dxc/dxcapi.h"
 
@@ -49,7 +58,19 @@ using namespace llvm;
 using namespace hlsl;
 using namespace hlsl::DXIL;
 
-class DxilContainerReflection : public IDxcContainerReflection {
+// Thread safety: once GetPartReflection returns it, a shader or library
+// reflection and every object reached from it (constant buffers, variables,
+// types, functions) only hands out what it held when it was created, and can
+// be queried from any number of threads at once. The little that is built
+// on first use (struct members, the bodies and resources of library
+// functions, the function table, and the bitcode behind a reflection made
+// from PSV0) is built once under a lock and published with a release store;
+// every later query reads it without locking. Descriptions and strings stay
+// valid as long as the reflection does. The container reflection itself is
+// not safe to Load while it is being queried.
+
+class DxilContainerReflection : public IDxcContainerReflection,
+                                public IDxcContainerSemanticHash {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
   CComPtr<IDxcBlob> m_container;
@@ -60,7 +81,9 @@ public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxilContainerReflection)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcContainerReflection>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcContainerReflection,
+                                 IDxcContainerSemanticHash>(this, iid,
+                                                            ppvObject);
   }
 
   HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pContainer) override;
@@ -69,10 +92,14 @@ public:
   HRESULT STDMETHODCALLTYPE GetPartContent(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) override;
   HRESULT STDMETHODCALLTYPE FindFirstPartKind(UINT32 kind, _Out_ UINT32 *pResult) override;
   HRESULT STDMETHODCALLTYPE GetPartReflection(UINT32 idx, REFIID iid, _COM_Outptr_ void **ppvObject) override;
+
+  // IDxcContainerSemanticHash
+  HRESULT STDMETHODCALLTYPE GetSemanticHash(_Out_ UINT64 *pResult) override;
 };
 
 class CShaderReflectionConstantBuffer;
 class CShaderReflectionType;
+class CShaderReflectionTypeCache;
 
 enum class PublicAPI { D3D12 = 0, D3D11_47 = 1, D3D11_43 = 2 };
 
@@ -84,11 +111,15 @@ public:
   DxilModule *m_pDxilModule = nullptr;
   std::vector<std::unique_ptr<CShaderReflectionConstantBuffer>>    m_CBs;
   std::vector<D3D12_SHADER_INPUT_BIND_DESC>       m_Resources;
-  std::vector<std::unique_ptr<CShaderReflectionType>> m_Types;
+  std::unique_ptr<CShaderReflectionTypeCache> m_pTypes;
+  const DxilShaderStatisticsHeader *m_pStatistics = nullptr;
   void CreateReflectionObjects();
   void CreateReflectionObjectForResource(DxilResourceBase *R);
 
-  HRESULT LoadModule(IDxcBlob *pBlob, const DxilPartHeader *pPart);
+  HRESULT LoadModule(IDxcBlob *pBlob, const DxilPartHeader *pPart,
+                     bool bLazyLoad = false);
+  // Reads the statistics of the named entry; false if the container has none.
+  bool GetStatistics(LPCSTR pName, DxilShaderStatisticsEntry *pEntry) const;
 
   // Common code
   ID3D12ShaderReflectionConstantBuffer* _GetConstantBufferByIndex(UINT Index);
@@ -189,7 +220,9 @@ public:
 };
 
 class CFunctionReflection;
-class DxilLibraryReflection : public DxilModuleReflection, public ID3D12LibraryReflection {
+class DxilLibraryReflection : public DxilModuleReflection,
+                              public ID3D12LibraryReflection,
+                              public IDxcLibraryReflectionTable {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
 
@@ -200,15 +233,32 @@ private:
   FunctionsByPtr m_FunctionsByPtr;
   // Enable indexing into functions in deterministic order:
   std::vector<CFunctionReflection*> m_FunctionVector;
-
-  void AddResourceUseToFunctions(DxilResourceBase &resource, unsigned resIndex);
+  // Index into m_Resources of each resource global symbol.
+  DenseMap<const Constant*, UINT> m_ResourceIndexBySymbol;
+  // Flat function table, built on the first GetFunctionTable call.
+  std::vector<DxcLibraryFunctionDesc> m_FunctionDescs;
+  std::vector<DxcLibraryResourceDesc> m_ResourceDescs;
+  std::vector<UINT32> m_FunctionResources;
+  std::vector<std::string> m_UnmangledNames;
+  std::atomic<bool> m_bFunctionTableBuilt{false};
+
+  void AddResourceSymbol(DxilResourceBase &resource, unsigned resIndex);
   void AddResourceDependencies();
+  void BuildFunctionTable();
+
+public:
+  // Held while function bodies are materialized and what is collected from
+  // them is stored, since all functions share the module.
+  std::mutex m_LazyLock;
+  void AddFunctionResourceUse(CFunctionReflection &func);
 
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxilLibraryReflection)
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
-    return DoBasicQueryInterface<ID3D12LibraryReflection>(this, iid, ppvObject);
+    return DoBasicQueryInterface<ID3D12LibraryReflection,
+                                 IDxcLibraryReflectionTable>(this, iid,
+                                                             ppvObject);
   }
 
   HRESULT Load(IDxcBlob *pBlob, const DxilPartHeader *pPart);
@@ -217,6 +267,100 @@ public:
   STDMETHOD(GetDesc)(THIS_ _Out_ D3D12_LIBRARY_DESC * pDesc);
 
   STDMETHOD_(ID3D12FunctionReflection *, GetFunctionByIndex)(THIS_ _In_ INT FunctionIndex);
+
+  // IDxcLibraryReflectionTable
+  HRESULT STDMETHODCALLTYPE GetFunctionTable(_Out_ DxcLibraryFunctionTable *pTable) override;
+};
+
+// Shader reflection served from the PSV0, signature and feature info parts,
+// without parsing bitcode. Resource bindings have no names. Queries that the
+// parts can't answer load the DXIL part into a DxilShaderReflection on first
+// use.
+class DxilPartShaderReflection : public ID3D12ShaderReflection {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcBlob> m_pContainer;
+  const DxilContainerHeader *m_pHeader = nullptr;
+  DxilPipelineStateValidation m_PSV;
+  uint64_t m_FeatureInfo = 0;
+  std::vector<D3D12_SHADER_INPUT_BIND_DESC>       m_Resources;
+  std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_InputSignature;
+  std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_OutputSignature;
+  std::vector<D3D12_SIGNATURE_PARAMETER_DESC>     m_PatchConstantSignature;
+  std::vector<std::unique_ptr<char[]>>            m_UpperCaseNames;
+  DxilShaderStatisticsEntry m_Statistics;
+  bool m_bHasStatistics = false;
+  CComPtr<DxilShaderReflection> m_pModuleReflection;
+  HRESULT m_hrModuleReflection = S_FALSE; // S_FALSE until loaded
+  std::atomic<bool> m_bModuleReflectionLoaded{false};
+  std::mutex m_ModuleReflectionLock;
+  PublicAPI m_PublicAPI;
+
+  void CreateReflectionObjectsForSignature(
+      const DxilPartHeader *pPart, bool bInput,
+      std::vector<D3D12_SIGNATURE_PARAMETER_DESC> &Descs);
+  HRESULT GetSignatureDesc(
+      const std::vector<D3D12_SIGNATURE_PARAMETER_DESC> &Descs,
+      UINT ParameterIndex, D3D12_SIGNATURE_PARAMETER_DESC *pDesc);
+  DxilShaderReflection *GetModuleReflection();
+public:
+  void SetPublicAPI(PublicAPI value) { m_PublicAPI = value; }
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxilPartShaderReflection)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    HRESULT hr = DoBasicQueryInterface<ID3D12ShaderReflection>(this, iid, ppvObject);
+    if (hr == E_NOINTERFACE) {
+      PublicAPI api = DxilShaderReflection::IIDToAPI(iid);
+      if (api == m_PublicAPI) {
+        *ppvObject = (ID3D12ShaderReflection *)this;
+        this->AddRef();
+        hr = S_OK;
+      }
+    }
+    return hr;
+  }
+
+  HRESULT Load(IDxcBlob *pBlob, const DxilContainerHeader *pHeader,
+               const DxilPartHeader *pPSVPart);
+
+  // ID3D12ShaderReflection
+  STDMETHODIMP GetDesc(THIS_ _Out_ D3D12_SHADER_DESC *pDesc);
+
+  STDMETHODIMP_(ID3D12ShaderReflectionConstantBuffer*) GetConstantBufferByIndex(THIS_ _In_ UINT Index);
+  STDMETHODIMP_(ID3D12ShaderReflectionConstantBuffer*) GetConstantBufferByName(THIS_ _In_ LPCSTR Name);
+
+  STDMETHODIMP GetResourceBindingDesc(THIS_ _In_ UINT ResourceIndex,
+    _Out_ D3D12_SHADER_INPUT_BIND_DESC *pDesc);
+
+  STDMETHODIMP GetInputParameterDesc(THIS_ _In_ UINT ParameterIndex,
+    _Out_ D3D12_SIGNATURE_PARAMETER_DESC *pDesc);
+  STDMETHODIMP GetOutputParameterDesc(THIS_ _In_ UINT ParameterIndex,
+    _Out_ D3D12_SIGNATURE_PARAMETER_DESC *pDesc);
+  STDMETHODIMP GetPatchConstantParameterDesc(THIS_ _In_ UINT ParameterIndex,
+    _Out_ D3D12_SIGNATURE_PARAMETER_DESC *pDesc);
+
+  STDMETHODIMP_(ID3D12ShaderReflectionVariable*) GetVariableByName(THIS_ _In_ LPCSTR Name);
+
+  STDMETHODIMP GetResourceBindingDescByName(THIS_ _In_ LPCSTR Name,
+    _Out_ D3D12_SHADER_INPUT_BIND_DESC *pDesc);
+
+  STDMETHODIMP_(UINT) GetMovInstructionCount(THIS);
+  STDMETHODIMP_(UINT) GetMovcInstructionCount(THIS);
+  STDMETHODIMP_(UINT) GetConversionInstructionCount(THIS);
+  STDMETHODIMP_(UINT) GetBitwiseInstructionCount(THIS);
+
+  STDMETHODIMP_(D3D_PRIMITIVE) GetGSInputPrimitive(THIS);
+  STDMETHODIMP_(BOOL) IsSampleFrequencyShader(THIS);
+
+  STDMETHODIMP_(UINT) GetNumInterfaceSlots(THIS);
+  STDMETHODIMP GetMinFeatureLevel(THIS_ _Out_ enum D3D_FEATURE_LEVEL* pLevel);
+
+  STDMETHODIMP_(UINT) GetThreadGroupSize(THIS_
+    _Out_opt_ UINT* pSizeX,
+    _Out_opt_ UINT* pSizeY,
+    _Out_opt_ UINT* pSizeZ);
+
+  STDMETHODIMP_(UINT64) GetRequiresFlags(THIS);
 };
 
 _Use_decl_annotations_
@@ -238,6 +382,23 @@ HRESULT DxilContainerReflection::Load(IDxcBlob *pContainer) {
     return E_INVALIDARG;
   }
 
+  // Parts and reflection are served from a copy with the compressed parts
+  // restored.
+  CComPtr<IDxcBlob> pDecompressed;
+  if (HasCompressedDxilParts(pHeader)) {
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      CComPtr<AbstractMemoryStream> pStream;
+      IFT(CreateMemoryStream(m_pMalloc, &pStream));
+      IFR(DecompressDxilContainer(pHeader, pStream));
+      IFT(pStream.QueryInterface(&pDecompressed));
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    pContainer = pDecompressed;
+    bufLen = pContainer->GetBufferSize();
+    pHeader = IsDxilContainerLike(pContainer->GetBufferPointer(), bufLen);
+  }
+
   m_container = pContainer;
   m_headerLen = bufLen;
   m_pHeader = pHeader;
@@ -288,6 +449,19 @@ HRESULT DxilContainerReflection::FindFirstPartKind(UINT32 kind, _Out_ UINT32 *pR
   return S_OK;
 }
 
+_Use_decl_annotations_
+HRESULT DxilContainerReflection::GetSemanticHash(UINT64 *pResult) {
+  if (pResult == nullptr) return E_POINTER;
+  *pResult = 0;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  // Compressed parts were restored on Load.
+  uint64_t hash;
+  HRESULT hr = GetDxilContainerSemanticHash(m_pHeader, &hash);
+  if (SUCCEEDED(hr))
+    *pResult = hash;
+  return hr;
+}
+
 _Use_decl_annotations_
 HRESULT DxilContainerReflection::GetPartReflection(UINT32 idx, REFIID iid, void **ppvObject) {
   if (ppvObject == nullptr) return E_POINTER;
@@ -295,12 +469,22 @@ HRESULT DxilContainerReflection::GetPartReflection(UINT32 idx, REFIID iid, void
   if (!IsLoaded()) return E_NOT_VALID_STATE;
   if (idx >= m_pHeader->PartCount) return E_BOUNDS;
   const DxilPartHeader *pPart = GetDxilContainerPart(m_pHeader, idx);
+  DxcThreadMalloc TM(m_pMalloc);
+  HRESULT hr = S_OK;
+  if (pPart->PartFourCC == DFCC_PipelineStateValidation) {
+    // Reflection of the PSV0 part is served without parsing bitcode.
+    CComPtr<DxilPartShaderReflection> pReflection =
+        DxilPartShaderReflection::Alloc(m_pMalloc);
+    IFCOOM(pReflection.p);
+    pReflection->SetPublicAPI(DxilShaderReflection::IIDToAPI(iid));
+    IFC(pReflection->Load(m_container, m_pHeader, pPart));
+    IFC(pReflection.p->QueryInterface(iid, ppvObject));
+    return hr;
+  }
   if (pPart->PartFourCC != DFCC_DXIL && pPart->PartFourCC != DFCC_ShaderDebugInfoDXIL) {
     return E_NOTIMPL;
   }
-  
-  DxcThreadMalloc TM(m_pMalloc);
-  HRESULT hr = S_OK;
+
   const DxilProgramHeader *pProgramHeader =
     reinterpret_cast<const DxilProgramHeader*>(GetDxilPartData(pPart));
   if (!IsValidDxilProgramHeader(pProgramHeader, pPart->PartSize)) {
@@ -352,6 +536,13 @@ protected:
   CShaderReflectionType*              m_pBaseClass;
   std::vector<CShaderReflectionType*> m_Interfaces;
   ULONG_PTR                           m_Identity;
+  // Struct members are built on first access, from these.
+  DxilModule                         *m_pModule = nullptr;
+  llvm::StructType                   *m_pStructType = nullptr;
+  CShaderReflectionTypeCache         *m_pCache = nullptr;
+  std::atomic<bool>                   m_bMembersBuilt{false};
+
+  void EnsureMembers();
 
 public:
   // Internal
@@ -360,7 +551,7 @@ public:
     llvm::Type              *type,
     DxilFieldAnnotation     &typeAnnotation,
     unsigned int            baseOffset,
-    std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+    CShaderReflectionTypeCache &cache);
 
   // ID3D12ShaderReflectionType
   STDMETHOD(GetDesc)(D3D12_SHADER_TYPE_DESC *pDesc);
@@ -382,6 +573,36 @@ public:
   }
 };
 
+// Reflection types are immutable once built, so equal types share a node:
+// a struct that several cbuffers or fields use is reflected once. Members
+// built on first access go through the cache, so the lock serializes them.
+class CShaderReflectionTypeCache
+{
+public:
+  // The allocator of the reflection that owns the cache, for types built
+  // on another thread than the one that loaded it.
+  IMalloc *m_pMalloc = DxcGetThreadMallocNoRef();
+  std::mutex m_LazyLock;
+
+  struct StructShape {
+    UINT Columns;
+    UINT Members;
+  };
+
+  CShaderReflectionType *GetType(DxilModule &M, llvm::Type *type,
+                                 DxilFieldAnnotation &typeAnnotation,
+                                 unsigned int baseOffset);
+  StructShape GetStructShape(DxilModule &M, llvm::StructType *structType);
+
+private:
+  // The type, and everything from the annotation that the reflected type
+  // depends on: component type, matrix orientation and size, and offset.
+  typedef std::tuple<llvm::Type *, unsigned, unsigned, unsigned, unsigned,
+                     unsigned> TypeKey;
+  std::map<TypeKey, std::unique_ptr<CShaderReflectionType>> m_Types;
+  std::map<llvm::StructType *, StructShape> m_StructShapes;
+};
+
 class CShaderReflectionVariable : public ID3D12ShaderReflectionVariable
 {
 protected:
@@ -421,10 +642,10 @@ public:
 
   void Initialize(DxilModule &M,
                   DxilCBuffer &CB,
-                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+                  CShaderReflectionTypeCache &types);
   void InitializeStructuredBuffer(DxilModule &M,
                                   DxilResource &R,
-                                  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes);
+                                  CShaderReflectionTypeCache &types);
   LPCSTR GetName() { return m_Desc.Name; }
 
   // ID3D12ShaderReflectionConstantBuffer
@@ -546,6 +767,7 @@ STDMETHODIMP CShaderReflectionType::GetDesc(D3D12_SHADER_TYPE_DESC *pDesc)
 
 STDMETHODIMP_(ID3D12ShaderReflectionType*) CShaderReflectionType::GetMemberTypeByIndex(UINT Index)
 {
+  EnsureMembers();
   if (Index >= m_MemberTypes.size()) {
     return &g_InvalidSRType;
   }
@@ -554,6 +776,7 @@ STDMETHODIMP_(ID3D12ShaderReflectionType*) CShaderReflectionType::GetMemberTypeB
 
 STDMETHODIMP_(LPCSTR) CShaderReflectionType::GetMemberTypeName(UINT Index)
 {
+  EnsureMembers();
   if (Index >= m_MemberTypes.size()) {
     return nullptr;
   }
@@ -562,7 +785,8 @@ STDMETHODIMP_(LPCSTR) CShaderReflectionType::GetMemberTypeName(UINT Index)
 
 STDMETHODIMP_(ID3D12ShaderReflectionType*) CShaderReflectionType::GetMemberTypeByName(LPCSTR Name)
 {
-  UINT memberCount = m_Desc.Members;
+  EnsureMembers();
+  UINT memberCount = (UINT)m_MemberNames.size();
   for( UINT mm = 0; mm < memberCount; ++mm ) {
     if( m_MemberNames[mm] == Name ) {
       return m_MemberTypes[mm];
@@ -736,7 +960,7 @@ HRESULT CShaderReflectionType::Initialize(
   llvm::Type              *inType,
   DxilFieldAnnotation     &typeAnnotation,
   unsigned int            baseOffset,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes)
+  CShaderReflectionTypeCache &cache)
 {
   DXASSERT_NOMSG(inType);
 
@@ -927,59 +1151,15 @@ HRESULT CShaderReflectionType::Initialize(
       name = name.ltrim("struct.");
       m_Name = name;
 
-      // Fields may have annotations, and we need to look at these
-      // in order to decode their types properly.
-      DxilTypeSystem &typeSys = M.GetTypeSystem();
-      DxilStructAnnotation *structAnnotation = typeSys.GetStructAnnotation(structType);
-
-      // There is no annotation for empty structs
-      unsigned int fieldCount = 0;
-      if (structAnnotation)
-        fieldCount = type->getStructNumElements();
-
-      // The DXBC reflection info computes `Columns` for a
-      // `struct` type from the fields (see below)
-      UINT columnCounter = 0;
-
-      for(unsigned int ff = 0; ff < fieldCount; ++ff)
-      {
-        DxilFieldAnnotation& fieldAnnotation = structAnnotation->GetFieldAnnotation(ff);
-        llvm::Type* fieldType = structType->getStructElementType(ff);
-
-        // Skip fields with object types, since applications may not expect to see them here.
-        //
-        // TODO: should skipping be context-dependent, since we might not be inside
-        // a constant buffer?
-        if( IsObjectType(fieldType) )
-        {
-          continue;
-        }
-
-        CShaderReflectionType *fieldReflectionType = new CShaderReflectionType();
-        allTypes.push_back(std::unique_ptr<CShaderReflectionType>(fieldReflectionType));
-
-        fieldReflectionType->Initialize(M, fieldType, fieldAnnotation, 0, allTypes);
-
-        m_MemberTypes.push_back(fieldReflectionType);
-        m_MemberNames.push_back(fieldAnnotation.GetFieldName().c_str());
-
-        // Effectively, we want to add one to `Columns` for every scalar nested recursively
-        // inside this `struct` type (ignoring objects, which we filtered above). We should
-        // be able to compute this as the product of the `Columns`, `Rows` and `Elements`
-        // of each field, with the caveat that some of these may be zero, but shoud be
-        // treated as one.
-        columnCounter +=
-            (fieldReflectionType->m_Desc.Columns  ? fieldReflectionType->m_Desc.Columns  : 1)
-          * (fieldReflectionType->m_Desc.Rows     ? fieldReflectionType->m_Desc.Rows     : 1)
-          * (fieldReflectionType->m_Desc.Elements ? fieldReflectionType->m_Desc.Elements : 1);
-      }
-
-      m_Desc.Columns = columnCounter;
-
-      // Because we might have skipped fields during enumeration,
-      // the `Members` count in the description might not be the same
-      // as the field count of the original LLVM type.
-      m_Desc.Members = m_MemberTypes.size();
+      // Only the shape is needed here; the members are built on first
+      // access.
+      m_pModule = &M;
+      m_pStructType = structType;
+      m_pCache = &cache;
+      CShaderReflectionTypeCache::StructShape shape =
+          cache.GetStructShape(M, structType);
+      m_Desc.Columns = shape.Columns;
+      m_Desc.Members = shape.Members;
     }
   }
   else if( type->isPointerTy() )
@@ -1022,11 +1202,120 @@ HRESULT CShaderReflectionType::Initialize(
   return S_OK;
 }
 
+void CShaderReflectionType::EnsureMembers()
+{
+  if (!m_pStructType || m_bMembersBuilt.load(std::memory_order_acquire))
+    return;
+  std::lock_guard<std::mutex> lock(m_pCache->m_LazyLock);
+  if (m_bMembersBuilt.load(std::memory_order_relaxed))
+    return;
+  DxcThreadMalloc TM(m_pCache->m_pMalloc);
+
+  DxilStructAnnotation *structAnnotation =
+      m_pModule->GetTypeSystem().GetStructAnnotation(m_pStructType);
+  // There is no annotation for empty structs
+  if (!structAnnotation) {
+    m_bMembersBuilt.store(true, std::memory_order_release);
+    return;
+  }
+  for (unsigned int ff = 0; ff < m_pStructType->getStructNumElements(); ++ff)
+  {
+    // Skip fields with object types, since applications may not expect to see them here.
+    //
+    // TODO: should skipping be context-dependent, since we might not be inside
+    // a constant buffer?
+    llvm::Type* fieldType = m_pStructType->getStructElementType(ff);
+    if( IsObjectType(fieldType) )
+    {
+      continue;
+    }
+
+    DxilFieldAnnotation& fieldAnnotation = structAnnotation->GetFieldAnnotation(ff);
+    m_MemberTypes.push_back(m_pCache->GetType(*m_pModule, fieldType, fieldAnnotation, 0));
+    m_MemberNames.push_back(fieldAnnotation.GetFieldName().c_str());
+  }
+  m_bMembersBuilt.store(true, std::memory_order_release);
+}
+
+CShaderReflectionType *CShaderReflectionTypeCache::GetType(
+  DxilModule              &M,
+  llvm::Type              *type,
+  DxilFieldAnnotation     &typeAnnotation,
+  unsigned int            baseOffset)
+{
+  bool hasMatrix = typeAnnotation.HasMatrixAnnotation();
+  const DxilMatrixAnnotation &matrixAnnotation = typeAnnotation.GetMatrixAnnotation();
+  TypeKey key(type, (unsigned)typeAnnotation.GetCompType().GetKind(),
+              hasMatrix ? (unsigned)matrixAnnotation.Orientation + 1 : 0,
+              hasMatrix ? matrixAnnotation.Rows : 0,
+              hasMatrix ? matrixAnnotation.Cols : 0,
+              typeAnnotation.GetCBufferOffset() - baseOffset);
+  std::unique_ptr<CShaderReflectionType> &pType = m_Types[key];
+  if (!pType) {
+    pType.reset(new CShaderReflectionType());
+    pType->Initialize(M, type, typeAnnotation, baseOffset, *this);
+  }
+  return pType.get();
+}
+
+CShaderReflectionTypeCache::StructShape CShaderReflectionTypeCache::GetStructShape(
+  DxilModule              &M,
+  llvm::StructType        *structType)
+{
+  auto it = m_StructShapes.find(structType);
+  if (it != m_StructShapes.end())
+    return it->second;
+
+  // Fields may have annotations, and we need to look at these
+  // in order to decode their types properly.
+  DxilStructAnnotation *structAnnotation =
+      M.GetTypeSystem().GetStructAnnotation(structType);
+
+  // There is no annotation for empty structs
+  unsigned int fieldCount = 0;
+  if (structAnnotation)
+    fieldCount = structType->getStructNumElements();
+
+  StructShape shape = { 0, 0 };
+  for(unsigned int ff = 0; ff < fieldCount; ++ff)
+  {
+    llvm::Type* fieldType = structType->getStructElementType(ff);
+    if( IsObjectType(fieldType) )
+    {
+      continue;
+    }
+
+    // Describe the field without keeping it; nested structs have their
+    // shapes cached, so this doesn't build the tree below.
+    CShaderReflectionType fieldReflectionType;
+    fieldReflectionType.Initialize(M, fieldType, structAnnotation->GetFieldAnnotation(ff), 0, *this);
+    D3D12_SHADER_TYPE_DESC fieldDesc;
+    fieldReflectionType.GetDesc(&fieldDesc);
+
+    // The DXBC reflection info computes `Columns` for a `struct` type by
+    // adding one for every scalar nested recursively inside it (ignoring
+    // objects, which we filtered above). We compute this as the product of
+    // the `Columns`, `Rows` and `Elements` of each field, with the caveat
+    // that some of these may be zero, but shoud be treated as one.
+    shape.Columns +=
+        (fieldDesc.Columns  ? fieldDesc.Columns  : 1)
+      * (fieldDesc.Rows     ? fieldDesc.Rows     : 1)
+      * (fieldDesc.Elements ? fieldDesc.Elements : 1);
+
+    // Because we skip object fields, the `Members` count might not be the
+    // same as the field count of the original LLVM type.
+    ++shape.Members;
+  }
+
+  m_StructShapes[structType] = shape;
+  return shape;
+}
+
 
 void CShaderReflectionConstantBuffer::Initialize(
   DxilModule &M,
   DxilCBuffer &CB,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes) {
+  CShaderReflectionTypeCache &types) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_Desc.Name = CB.GetGlobalName().c_str();
   m_Desc.Size = CB.GetSize() / CB.GetRangeSize();
@@ -1058,9 +1347,7 @@ void CShaderReflectionConstantBuffer::Initialize(
     VarDesc.uFlags |= D3D_SVF_USED; // Will update in SetCBufferUsage.
     CShaderReflectionVariable Var;
     //Create reflection type.
-    CShaderReflectionType *pVarType = new CShaderReflectionType();
-    allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
-    pVarType->Initialize(M, ST->getContainedType(i), fieldAnnotation, fieldAnnotation.GetCBufferOffset(), allTypes);
+    CShaderReflectionType *pVarType = types.GetType(M, ST->getContainedType(i), fieldAnnotation, fieldAnnotation.GetCBufferOffset());
 
     BYTE *pDefaultValue = nullptr;
 
@@ -1074,6 +1361,12 @@ void CShaderReflectionConstantBuffer::Initialize(
     else {
       VarDesc.Size = CB.GetSize() - fieldAnnotation.GetCBufferOffset();
     }
+    // A linked cbuffer may be cut short of fields that aren't read.
+    if (VarDesc.StartOffset >= CB.GetSize())
+      VarDesc.Size = 0;
+    else
+      VarDesc.Size =
+          std::min(VarDesc.Size, CB.GetSize() - VarDesc.StartOffset);
     Var.Initialize(this, &VarDesc, pVarType, pDefaultValue);
     m_Variables.push_back(Var);
   }
@@ -1117,7 +1410,7 @@ static unsigned CalcResTypeSize(DxilModule &M, DxilResource &R) {
 void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   DxilModule &M,
   DxilResource &R,
-  std::vector<std::unique_ptr<CShaderReflectionType>>& allTypes) {
+  CShaderReflectionTypeCache &types) {
   ZeroMemory(&m_Desc, sizeof(m_Desc));
   m_Desc.Name = R.GetGlobalName().c_str();
   //m_Desc.Size = R.GetSize();
@@ -1152,14 +1445,11 @@ void CShaderReflectionConstantBuffer::InitializeStructuredBuffer(
   if(annotation)
   {
     // Actually create the reflection type.
-    pVarType = new CShaderReflectionType();
-    allTypes.push_back(std::unique_ptr<CShaderReflectionType>(pVarType));
-
     // The user-visible element type is the first field of the wrapepr `struct`
     Type *fieldType = ST->getElementType(0);
     DxilFieldAnnotation &fieldAnnotation = annotation->GetFieldAnnotation(0);
 
-    pVarType->Initialize(M, fieldType, fieldAnnotation, fieldAnnotation.GetCBufferOffset(), allTypes);
+    pVarType = types.GetType(M, fieldType, fieldAnnotation, fieldAnnotation.GetCBufferOffset());
   }
 
   BYTE *pDefaultValue = nullptr;
@@ -1517,10 +1807,12 @@ void DxilShaderReflection::SetCBufferUsage() {
 void DxilModuleReflection::CreateReflectionObjects() {
   DXASSERT_NOMSG(m_pDxilModule != nullptr);
 
+  m_pTypes.reset(new CShaderReflectionTypeCache());
+
   // Create constant buffers, resources and signatures.
   for (auto && cb : m_pDxilModule->GetCBuffers()) {
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->Initialize(*m_pDxilModule, *(cb.get()), m_Types);
+    rcb->Initialize(*m_pDxilModule, *(cb.get()), *m_pTypes);
     m_CBs.emplace_back(std::move(rcb));
   }
 
@@ -1530,7 +1822,7 @@ void DxilModuleReflection::CreateReflectionObjects() {
       continue;
     }
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(uav.get()), m_Types);
+    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(uav.get()), *m_pTypes);
     m_CBs.emplace_back(std::move(rcb));
   }
   for (auto && srv : m_pDxilModule->GetSRVs()) {
@@ -1538,7 +1830,7 @@ void DxilModuleReflection::CreateReflectionObjects() {
       continue;
     }
     std::unique_ptr<CShaderReflectionConstantBuffer> rcb(new CShaderReflectionConstantBuffer());
-    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(srv.get()), m_Types);
+    rcb->InitializeStructuredBuffer(*m_pDxilModule, *(srv.get()), *m_pTypes);
     m_CBs.emplace_back(std::move(rcb));
   }
 
@@ -1701,7 +1993,8 @@ void DxilShaderReflection::CreateReflectionObjectsForSignature(
   }
 }
 
-LPCSTR DxilShaderReflection::CreateUpperCase(LPCSTR pValue) {
+static LPCSTR CreateUpperCase(LPCSTR pValue,
+                              std::vector<std::unique_ptr<char[]>> &Names) {
   // Restricted only to [a-z] ASCII.
   LPCSTR pCursor = pValue;
   while (*pCursor != '\0') {
@@ -1725,15 +2018,75 @@ LPCSTR DxilShaderReflection::CreateUpperCase(LPCSTR pValue) {
     ++pWrite;
     ++pCursor;
   }
-  m_UpperCaseNames.push_back(std::move(pUpperStr));
-  return m_UpperCaseNames.back().get();
+  Names.push_back(std::move(pUpperStr));
+  return Names.back().get();
+}
+
+LPCSTR DxilShaderReflection::CreateUpperCase(LPCSTR pValue) {
+  return ::CreateUpperCase(pValue, m_UpperCaseNames);
+}
+
+// Returns the statistics (STAT) part of a container, or null if it has none
+// or it is malformed.
+static const DxilShaderStatisticsHeader *
+GetStatisticsPart(const DxilContainerHeader *pHeader) {
+  const DxilPartHeader *pPart =
+      GetDxilPartByType(pHeader, DFCC_ShaderStatistics);
+  if (pPart == nullptr)
+    return nullptr;
+  const DxilShaderStatisticsHeader *pStatistics =
+      reinterpret_cast<const DxilShaderStatisticsHeader *>(
+          GetDxilPartData(pPart));
+  return IsValidDxilShaderStatistics(pStatistics, pPart->PartSize)
+             ? pStatistics
+             : nullptr;
+}
+
+// Fills the counts the shader and function descriptions share.
+template <typename TDesc>
+static void SetInstructionCounts(const DxilShaderStatisticsEntry &E,
+                                 TDesc *pDesc) {
+  pDesc->InstructionCount = E.InstructionCount;
+  pDesc->TempArrayCount = E.TempArrayCount;
+  pDesc->TextureNormalInstructions = E.TextureNormalInstructions;
+  pDesc->TextureLoadInstructions = E.TextureLoadInstructions;
+  pDesc->TextureCompInstructions = E.TextureCompInstructions;
+  pDesc->TextureBiasInstructions = E.TextureBiasInstructions;
+  pDesc->TextureGradientInstructions = E.TextureGradientInstructions;
+  pDesc->FloatInstructionCount = E.FloatInstructionCount;
+  pDesc->IntInstructionCount = E.IntInstructionCount;
+  pDesc->UintInstructionCount = E.UintInstructionCount;
+  pDesc->StaticFlowControlCount = E.StaticFlowControlCount;
+  pDesc->DynamicFlowControlCount = E.DynamicFlowControlCount;
+  pDesc->ArrayInstructionCount = E.ArrayInstructionCount;
+}
+
+static void SetShaderDescStatistics(const DxilShaderStatisticsEntry &E,
+                                    D3D12_SHADER_DESC *pDesc) {
+  SetInstructionCounts(E, pDesc);
+  pDesc->CutInstructionCount = E.CutInstructionCount;
+  pDesc->EmitInstructionCount = E.EmitInstructionCount;
+  pDesc->cBarrierInstructions = E.BarrierInstructions;
+  pDesc->cInterlockedInstructions = E.InterlockedInstructions;
+  pDesc->cTextureStoreInstructions = E.TextureStoreInstructions;
+}
+
+bool DxilModuleReflection::GetStatistics(
+    LPCSTR pName, DxilShaderStatisticsEntry *pEntry) const {
+  return m_pStatistics != nullptr &&
+         FindDxilShaderStatisticsEntry(m_pStatistics, pName, pEntry);
 }
 
 HRESULT DxilModuleReflection::LoadModule(IDxcBlob *pBlob,
-                                         const DxilPartHeader *pPart) {
+                                         const DxilPartHeader *pPart,
+                                         bool bLazyLoad) {
   DXASSERT_NOMSG(pBlob != nullptr);
   DXASSERT_NOMSG(pPart != nullptr);
   m_pContainer = pBlob;
+  const DxilContainerHeader *pHeader = IsDxilContainerLike(
+      pBlob->GetBufferPointer(), pBlob->GetBufferSize());
+  if (pHeader && IsValidDxilContainer(pHeader, pBlob->GetBufferSize()))
+    m_pStatistics = GetStatisticsPart(pHeader);
   const char *pData = GetDxilPartData(pPart);
   try {
     const char *pBitcode;
@@ -1741,13 +2094,12 @@ HRESULT DxilModuleReflection::LoadModule(IDxcBlob *pBlob,
     GetDxilProgramBitcode((DxilProgramHeader *)pData, &pBitcode, &bitcodeLength);
     std::unique_ptr<MemoryBuffer> pMemBuffer =
         MemoryBuffer::getMemBufferCopy(StringRef(pBitcode, bitcodeLength));
-#if 0 // We materialize eagerly, because we'll need to walk instructions to look for usage information.
-    ErrorOr<std::unique_ptr<Module>> module =
-        getLazyBitcodeModule(std::move(pMemBuffer), Context);
-#else
+    // Function bodies of a lazily loaded module are parsed by whoever first
+    // walks their instructions.
     ErrorOr<std::unique_ptr<Module>> module =
-      parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, nullptr);
-#endif
+        bLazyLoad
+            ? getLazyBitcodeModule(std::move(pMemBuffer), Context)
+            : parseBitcodeFile(pMemBuffer->getMemBufferRef(), Context, nullptr);
     if (!module) {
       return E_INVALIDARG;
     }
@@ -1794,25 +2146,15 @@ HRESULT DxilShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
   pDesc->OutputParameters = m_OutputSignature.size();
   pDesc->PatchConstantParameters = m_PatchConstantSignature.size();
 
-  // Unset:  UINT                    InstructionCount;            // Number of emitted instructions
+  // Instruction counts come from the statistics part, if the container has
+  // one.
   // Unset:  UINT                    TempRegisterCount;           // Number of temporary registers used 
-  // Unset:  UINT                    TempArrayCount;              // Number of temporary arrays used
   // Unset:  UINT                    DefCount;                    // Number of constant defines 
   // Unset:  UINT                    DclCount;                    // Number of declarations (input + output)
-  // Unset:  UINT                    TextureNormalInstructions;   // Number of non-categorized texture instructions
-  // Unset:  UINT                    TextureLoadInstructions;     // Number of texture load instructions
-  // Unset:  UINT                    TextureCompInstructions;     // Number of texture comparison instructions
-  // Unset:  UINT                    TextureBiasInstructions;     // Number of texture bias instructions
-  // Unset:  UINT                    TextureGradientInstructions; // Number of texture gradient instructions
-  // Unset:  UINT                    FloatInstructionCount;       // Number of floating point arithmetic instructions used
-  // Unset:  UINT                    IntInstructionCount;         // Number of signed integer arithmetic instructions used
-  // Unset:  UINT                    UintInstructionCount;        // Number of unsigned integer arithmetic instructions used
-  // Unset:  UINT                    StaticFlowControlCount;      // Number of static flow control instructions used
-  // Unset:  UINT                    DynamicFlowControlCount;     // Number of dynamic flow control instructions used
   // Unset:  UINT                    MacroInstructionCount;       // Number of macro instructions used
-  // Unset:  UINT                    ArrayInstructionCount;       // Number of array instructions used
-  // Unset:  UINT                    CutInstructionCount;         // Number of cut instructions used
-  // Unset:  UINT                    EmitInstructionCount;        // Number of emit instructions used
+  DxilShaderStatisticsEntry Stats;
+  if (GetStatistics(M.GetEntryFunctionName().c_str(), &Stats))
+    SetShaderDescStatistics(Stats, pDesc);
 
   pDesc->GSOutputTopology = (D3D_PRIMITIVE_TOPOLOGY)M.GetStreamPrimitiveTopology();
   pDesc->GSMaxOutputVertexCount = M.GetMaxVertexCount();
@@ -1833,11 +2175,6 @@ HRESULT DxilShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
   pDesc->HSPartitioning = (D3D_TESSELLATOR_PARTITIONING)M.GetTessellatorPartitioning();
   pDesc->TessellatorDomain = (D3D_TESSELLATOR_DOMAIN)M.GetTessellatorDomain();
 
-  // instruction counts
-  // Unset:  UINT cBarrierInstructions;                           // Number of barrier instructions in a compute shader
-  // Unset:  UINT cInterlockedInstructions;                       // Number of interlocked instructions
-  // Unset:  UINT cTextureStoreInstructions;                      // Number of texture writes
-
   return S_OK;
 }
 
@@ -2046,9 +2383,24 @@ HRESULT DxilModuleReflection::_GetResourceBindingDescByName(LPCSTR Name,
 }
 
 UINT DxilShaderReflection::GetMovInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetMovcInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetConversionInstructionCount() { return 0; }
-UINT DxilShaderReflection::GetBitwiseInstructionCount() { return 0; }
+UINT DxilShaderReflection::GetMovcInstructionCount() {
+  DxilShaderStatisticsEntry Stats;
+  if (!GetStatistics(m_pDxilModule->GetEntryFunctionName().c_str(), &Stats))
+    return 0;
+  return Stats.MovcInstructionCount;
+}
+UINT DxilShaderReflection::GetConversionInstructionCount() {
+  DxilShaderStatisticsEntry Stats;
+  if (!GetStatistics(m_pDxilModule->GetEntryFunctionName().c_str(), &Stats))
+    return 0;
+  return Stats.ConversionInstructionCount;
+}
+UINT DxilShaderReflection::GetBitwiseInstructionCount() {
+  DxilShaderStatisticsEntry Stats;
+  if (!GetStatistics(m_pDxilModule->GetEntryFunctionName().c_str(), &Stats))
+    return 0;
+  return Stats.BitwiseInstructionCount;
+}
 
 D3D_PRIMITIVE DxilShaderReflection::GetGSInputPrimitive() {
   if (!m_pDxilModule->GetShaderModel()->IsGS())
@@ -2086,9 +2438,8 @@ UINT DxilShaderReflection::GetThreadGroupSize(UINT *pSizeX, UINT *pSizeY, UINT *
   return x * y * z;
 }
 
-UINT64 DxilShaderReflection::GetRequiresFlags() {
+static UINT64 FeatureInfoToRequiresFlags(uint64_t features) {
   UINT64 result = 0;
-  uint64_t features = m_pDxilModule->m_ShaderFlags.GetFeatureInfo();
   if (features & ShaderFeatureInfo_Doubles) result |= D3D_SHADER_REQUIRES_DOUBLES;
   if (features & ShaderFeatureInfo_UAVsAtEveryStage) result |= D3D_SHADER_REQUIRES_UAVS_AT_EVERY_STAGE;
   if (features & ShaderFeatureInfo_64UAVs) result |= D3D_SHADER_REQUIRES_64_UAVS;
@@ -2105,18 +2456,407 @@ UINT64 DxilShaderReflection::GetRequiresFlags() {
   return result;
 }
 
+UINT64 DxilShaderReflection::GetRequiresFlags() {
+  return FeatureInfoToRequiresFlags(m_pDxilModule->m_ShaderFlags.GetFeatureInfo());
+}
+
+// DxilPartShaderReflection
+
+static D3D_SHADER_INPUT_TYPE PSVResourceTypeToShaderInputType(uint32_t ResType) {
+  switch ((PSVResourceType)ResType) {
+  case PSVResourceType::Sampler:
+    return D3D_SIT_SAMPLER;
+  case PSVResourceType::CBV:
+    return D3D_SIT_CBUFFER;
+  case PSVResourceType::SRVTyped:
+    return D3D_SIT_TEXTURE;
+  case PSVResourceType::SRVRaw:
+    return D3D_SIT_BYTEADDRESS;
+  case PSVResourceType::SRVStructured:
+    return D3D_SIT_STRUCTURED;
+  case PSVResourceType::UAVTyped:
+    return D3D_SIT_UAV_RWTYPED;
+  case PSVResourceType::UAVRaw:
+    return D3D_SIT_UAV_RWBYTEADDRESS;
+  case PSVResourceType::UAVStructured:
+    return D3D_SIT_UAV_RWSTRUCTURED;
+  case PSVResourceType::UAVStructuredWithCounter:
+    return D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER;
+  default:
+    return (D3D_SHADER_INPUT_TYPE)-1;
+  }
+}
+
+static D3D_REGISTER_COMPONENT_TYPE
+SigCompTypeToRegisterComponentType(DxilProgramSigCompType CT) {
+  switch (CT) {
+  case DxilProgramSigCompType::Float16:
+  case DxilProgramSigCompType::Float32:
+    return D3D_REGISTER_COMPONENT_FLOAT32;
+  case DxilProgramSigCompType::UInt16:
+  case DxilProgramSigCompType::UInt32:
+    return D3D_REGISTER_COMPONENT_UINT32;
+  case DxilProgramSigCompType::SInt16:
+  case DxilProgramSigCompType::SInt32:
+    return D3D_REGISTER_COMPONENT_SINT32;
+  default:
+    return D3D_REGISTER_COMPONENT_UNKNOWN;
+  }
+}
+
+static D3D_MIN_PRECISION SigElementToMinPrecision(
+    const DxilProgramSignatureElement &E) {
+  if (E.MinPrecision != DxilProgramSigMinPrecision::Default)
+    return (D3D_MIN_PRECISION)E.MinPrecision;
+  // Native 16-bit types are written with the default precision.
+  switch (E.CompType) {
+  case DxilProgramSigCompType::Float16:
+    return D3D_MIN_PRECISION_FLOAT_16;
+  case DxilProgramSigCompType::SInt16:
+    return D3D_MIN_PRECISION_SINT_16;
+  case DxilProgramSigCompType::UInt16:
+    return D3D_MIN_PRECISION_UINT_16;
+  default:
+    return D3D_MIN_PRECISION_DEFAULT;
+  }
+}
+
+void DxilPartShaderReflection::CreateReflectionObjectsForSignature(
+    const DxilPartHeader *pPart, bool bInput,
+    std::vector<D3D12_SIGNATURE_PARAMETER_DESC> &Descs) {
+  if (pPart == nullptr || pPart->PartSize < sizeof(DxilProgramSignature))
+    return;
+  const char *pData = GetDxilPartData(pPart);
+  const DxilProgramSignature *pSig =
+      reinterpret_cast<const DxilProgramSignature *>(pData);
+  IFTBOOL((uint64_t)pSig->ParamOffset +
+                  (uint64_t)pSig->ParamCount *
+                      sizeof(DxilProgramSignatureElement) <=
+              pPart->PartSize,
+          DXC_E_MALFORMED_CONTAINER);
+  const DxilProgramSignatureElement *pElements =
+      reinterpret_cast<const DxilProgramSignatureElement *>(pData +
+                                                            pSig->ParamOffset);
+  for (uint32_t i = 0; i < pSig->ParamCount; ++i) {
+    const DxilProgramSignatureElement &E = pElements[i];
+    IFTBOOL(E.SemanticName < pPart->PartSize &&
+                memchr(pData + E.SemanticName, '\0',
+                       pPart->PartSize - E.SemanticName) != nullptr,
+            DXC_E_MALFORMED_CONTAINER);
+    D3D12_SIGNATURE_PARAMETER_DESC Desc;
+    ZeroMemory(&Desc, sizeof(Desc));
+    Desc.SemanticName = pData + E.SemanticName;
+    if (E.SystemValue != DxilProgramSigSemantic::Undefined)
+      Desc.SemanticName = ::CreateUpperCase(Desc.SemanticName, m_UpperCaseNames);
+    Desc.SemanticIndex = E.SemanticIndex;
+    Desc.Register = E.Register;
+    Desc.SystemValueType = (D3D_NAME)E.SystemValue;
+    Desc.ComponentType = SigCompTypeToRegisterComponentType(E.CompType);
+    Desc.Mask = E.Mask;
+    // The part records what the shader never writes or always reads, which
+    // is less precise than the usage the bitcode shows.
+    Desc.ReadWriteMask = bInput ? (E.AlwaysReads_Mask & E.Mask)
+                                : (E.NeverWrites_Mask & E.Mask);
+    Desc.Stream = E.Stream;
+    // D3D11_43 does not have MinPrecison.
+    if (m_PublicAPI != PublicAPI::D3D11_43)
+      Desc.MinPrecision = SigElementToMinPrecision(E);
+    Descs.push_back(Desc);
+  }
+}
+
+HRESULT DxilPartShaderReflection::Load(IDxcBlob *pBlob,
+                                       const DxilContainerHeader *pHeader,
+                                       const DxilPartHeader *pPSVPart) {
+  m_pContainer = pBlob;
+  m_pHeader = pHeader;
+  if (!m_PSV.InitFromPSV0(GetDxilPartData(pPSVPart), pPSVPart->PartSize))
+    return E_INVALIDARG;
+
+  try {
+    // Resources are in order of CBuffer, Sampler, SRV and UAV, as in the
+    // module; IDs count up within each class.
+    UINT classIDs[4] = {0, 0, 0, 0};
+    for (uint32_t i = 0; i < m_PSV.GetBindCount(); ++i) {
+      const PSVResourceBindInfo0 *pBind = m_PSV.GetPSVResourceBindInfo0(i);
+      IFTBOOL(pBind != nullptr, E_INVALIDARG);
+      D3D12_SHADER_INPUT_BIND_DESC inputBind;
+      ZeroMemory(&inputBind, sizeof(inputBind));
+      inputBind.Name = "";
+      inputBind.Type = PSVResourceTypeToShaderInputType(pBind->ResType);
+      inputBind.BindPoint = pBind->LowerBound;
+      inputBind.BindCount = pBind->UpperBound == UINT_MAX
+                                ? 0
+                                : pBind->UpperBound - pBind->LowerBound + 1;
+      inputBind.Space = pBind->Space;
+      unsigned classIdx;
+      switch ((PSVResourceType)pBind->ResType) {
+      case PSVResourceType::CBV: classIdx = 0; break;
+      case PSVResourceType::Sampler: classIdx = 1; break;
+      case PSVResourceType::SRVTyped:
+      case PSVResourceType::SRVRaw:
+      case PSVResourceType::SRVStructured: classIdx = 2; break;
+      default: classIdx = 3; break;
+      }
+      inputBind.uID = classIDs[classIdx]++;
+      m_Resources.push_back(inputBind);
+    }
+
+    CreateReflectionObjectsForSignature(
+        GetDxilPartByType(pHeader, DFCC_InputSignature), true,
+        m_InputSignature);
+    CreateReflectionObjectsForSignature(
+        GetDxilPartByType(pHeader, DFCC_OutputSignature), false,
+        m_OutputSignature);
+    // Patch constants are an input of domain shaders.
+    CreateReflectionObjectsForSignature(
+        GetDxilPartByType(pHeader, DFCC_PatchConstantSignature), m_PSV.IsDS(),
+        m_PatchConstantSignature);
+
+    const DxilPartHeader *pFeaturePart =
+        GetDxilPartByType(pHeader, DFCC_FeatureInfo);
+    if (pFeaturePart && pFeaturePart->PartSize >= sizeof(DxilShaderFeatureInfo))
+      m_FeatureInfo = reinterpret_cast<const DxilShaderFeatureInfo *>(
+                          GetDxilPartData(pFeaturePart))->FeatureFlags;
+
+    // A shader has a single entry.
+    const DxilShaderStatisticsHeader *pStatistics = GetStatisticsPart(pHeader);
+    m_bHasStatistics =
+        pStatistics &&
+        GetDxilShaderStatisticsEntry(pStatistics, 0, &m_Statistics);
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+DxilShaderReflection *DxilPartShaderReflection::GetModuleReflection() {
+  if (m_bModuleReflectionLoaded.load(std::memory_order_acquire))
+    return m_pModuleReflection;
+  std::lock_guard<std::mutex> lock(m_ModuleReflectionLock);
+  if (m_bModuleReflectionLoaded.load(std::memory_order_relaxed))
+    return m_pModuleReflection;
+  m_hrModuleReflection = E_FAIL;
+  if (const DxilPartHeader *pPart = GetDxilPartByType(m_pHeader, DFCC_DXIL)) {
+    DxcThreadMalloc TM(m_pMalloc);
+    CComPtr<DxilShaderReflection> pReflection =
+        DxilShaderReflection::Alloc(m_pMalloc);
+    if (pReflection != nullptr) {
+      pReflection->SetPublicAPI(m_PublicAPI);
+      m_hrModuleReflection = pReflection->Load(m_pContainer, pPart);
+      if (SUCCEEDED(m_hrModuleReflection))
+        m_pModuleReflection = pReflection;
+    }
+  }
+  m_bModuleReflectionLoaded.store(true, std::memory_order_release);
+  return m_pModuleReflection;
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetDesc(D3D12_SHADER_DESC *pDesc) {
+  // Without statistics, the counts and properties are in the bitcode only.
+  const DxilPartHeader *pProgramPart = GetDxilPartByType(m_pHeader, DFCC_DXIL);
+  if (!m_bHasStatistics || pProgramPart == nullptr ||
+      pProgramPart->PartSize < sizeof(DxilProgramHeader)) {
+    DxilShaderReflection *pReflection = GetModuleReflection();
+    if (pReflection == nullptr) {
+      IFR(ZeroMemoryToOut(pDesc));
+      return m_hrModuleReflection;
+    }
+    return pReflection->GetDesc(pDesc);
+  }
+
+  IFR(ZeroMemoryToOut(pDesc));
+  pDesc->Version = reinterpret_cast<const DxilProgramHeader *>(
+                       GetDxilPartData(pProgramPart))->ProgramVersion;
+
+  // Structured buffers are reflected as constant buffers, as by the module.
+  for (const D3D12_SHADER_INPUT_BIND_DESC &Bind : m_Resources) {
+    if (Bind.Type == D3D_SIT_CBUFFER || Bind.Type == D3D_SIT_STRUCTURED ||
+        Bind.Type == D3D_SIT_UAV_RWSTRUCTURED ||
+        Bind.Type == D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER)
+      ++pDesc->ConstantBuffers;
+  }
+  pDesc->BoundResources = m_Resources.size();
+  pDesc->InputParameters = m_InputSignature.size();
+  pDesc->OutputParameters = m_OutputSignature.size();
+  pDesc->PatchConstantParameters = m_PatchConstantSignature.size();
+
+  const DxilShaderStatisticsEntry &E = m_Statistics;
+  SetShaderDescStatistics(E, pDesc);
+  pDesc->GSOutputTopology = (D3D_PRIMITIVE_TOPOLOGY)E.GSOutputTopology;
+  pDesc->GSMaxOutputVertexCount = E.GSMaxOutputVertexCount;
+  pDesc->InputPrimitive = (D3D_PRIMITIVE)E.InputPrimitive;
+  pDesc->cGSInstanceCount = E.GSInstanceCount;
+  pDesc->cControlPoints = E.ControlPoints;
+  pDesc->HSOutputPrimitive = (D3D_TESSELLATOR_OUTPUT_PRIMITIVE)E.HSOutputPrimitive;
+  pDesc->HSPartitioning = (D3D_TESSELLATOR_PARTITIONING)E.HSPartitioning;
+  pDesc->TessellatorDomain = (D3D_TESSELLATOR_DOMAIN)E.TessellatorDomain;
+  return S_OK;
+}
+
+_Use_decl_annotations_
+ID3D12ShaderReflectionConstantBuffer *
+DxilPartShaderReflection::GetConstantBufferByIndex(UINT Index) {
+  DxilShaderReflection *pReflection = GetModuleReflection();
+  if (pReflection == nullptr)
+    return &g_InvalidSRConstantBuffer;
+  return pReflection->GetConstantBufferByIndex(Index);
+}
+
+_Use_decl_annotations_
+ID3D12ShaderReflectionConstantBuffer *
+DxilPartShaderReflection::GetConstantBufferByName(LPCSTR Name) {
+  DxilShaderReflection *pReflection = GetModuleReflection();
+  if (pReflection == nullptr)
+    return &g_InvalidSRConstantBuffer;
+  return pReflection->GetConstantBufferByName(Name);
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetResourceBindingDesc(
+    UINT ResourceIndex, D3D12_SHADER_INPUT_BIND_DESC *pDesc) {
+  IFRBOOL(pDesc != nullptr, E_INVALIDARG);
+  IFRBOOL(ResourceIndex < m_Resources.size(), E_INVALIDARG);
+  if (m_PublicAPI != PublicAPI::D3D12) {
+    memcpy(pDesc, &m_Resources[ResourceIndex], sizeof(D3D11_SHADER_INPUT_BIND_DESC));
+  }
+  else {
+    *pDesc = m_Resources[ResourceIndex];
+  }
+  return S_OK;
+}
+
+HRESULT DxilPartShaderReflection::GetSignatureDesc(
+    const std::vector<D3D12_SIGNATURE_PARAMETER_DESC> &Descs,
+    UINT ParameterIndex, D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
+  IFRBOOL(pDesc != nullptr, E_INVALIDARG);
+  IFRBOOL(ParameterIndex < Descs.size(), E_INVALIDARG);
+  if (m_PublicAPI != PublicAPI::D3D11_43)
+    *pDesc = Descs[ParameterIndex];
+  else
+    memcpy(pDesc, &Descs[ParameterIndex],
+           // D3D11_43 does not have MinPrecison.
+           sizeof(D3D12_SIGNATURE_PARAMETER_DESC) - sizeof(D3D_MIN_PRECISION));
+  return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetInputParameterDesc(
+    UINT ParameterIndex, D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
+  return GetSignatureDesc(m_InputSignature, ParameterIndex, pDesc);
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetOutputParameterDesc(
+    UINT ParameterIndex, D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
+  return GetSignatureDesc(m_OutputSignature, ParameterIndex, pDesc);
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetPatchConstantParameterDesc(
+    UINT ParameterIndex, D3D12_SIGNATURE_PARAMETER_DESC *pDesc) {
+  return GetSignatureDesc(m_PatchConstantSignature, ParameterIndex, pDesc);
+}
+
+_Use_decl_annotations_
+ID3D12ShaderReflectionVariable *
+DxilPartShaderReflection::GetVariableByName(LPCSTR Name) {
+  DxilShaderReflection *pReflection = GetModuleReflection();
+  if (pReflection == nullptr)
+    return &g_InvalidSRVariable;
+  return pReflection->GetVariableByName(Name);
+}
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetResourceBindingDescByName(
+    LPCSTR Name, D3D12_SHADER_INPUT_BIND_DESC *pDesc) {
+  // Only the bitcode has resource names.
+  DxilShaderReflection *pReflection = GetModuleReflection();
+  if (pReflection == nullptr)
+    return m_hrModuleReflection;
+  return pReflection->GetResourceBindingDescByName(Name, pDesc);
+}
+
+UINT DxilPartShaderReflection::GetMovInstructionCount() { return 0; }
+UINT DxilPartShaderReflection::GetMovcInstructionCount() {
+  return m_bHasStatistics ? m_Statistics.MovcInstructionCount : 0;
+}
+UINT DxilPartShaderReflection::GetConversionInstructionCount() {
+  return m_bHasStatistics ? m_Statistics.ConversionInstructionCount : 0;
+}
+UINT DxilPartShaderReflection::GetBitwiseInstructionCount() {
+  return m_bHasStatistics ? m_Statistics.BitwiseInstructionCount : 0;
+}
+
+D3D_PRIMITIVE DxilPartShaderReflection::GetGSInputPrimitive() {
+  // PSV0 written for validator 1.0 doesn't record the shader kind.
+  if (m_PSV.GetShaderKind() == PSVShaderKind::Invalid) {
+    DxilShaderReflection *pReflection = GetModuleReflection();
+    return pReflection ? pReflection->GetGSInputPrimitive()
+                       : D3D_PRIMITIVE::D3D10_PRIMITIVE_UNDEFINED;
+  }
+  if (!m_PSV.IsGS())
+    return D3D_PRIMITIVE::D3D10_PRIMITIVE_UNDEFINED;
+  return (D3D_PRIMITIVE)m_PSV.GetPSVRuntimeInfo0()->GS.InputPrimitive;
+}
+
+BOOL DxilPartShaderReflection::IsSampleFrequencyShader() {
+  return m_PSV.IsPS() && m_PSV.GetPSVRuntimeInfo0()->PS.SampleFrequency;
+}
+
+UINT DxilPartShaderReflection::GetNumInterfaceSlots() { return 0; }
+
+_Use_decl_annotations_
+HRESULT DxilPartShaderReflection::GetMinFeatureLevel(enum D3D_FEATURE_LEVEL* pLevel) {
+  IFR(AssignToOut(D3D_FEATURE_LEVEL_12_0, pLevel));
+  return S_OK;
+}
+
+_Use_decl_annotations_
+UINT DxilPartShaderReflection::GetThreadGroupSize(UINT *pSizeX, UINT *pSizeY,
+                                                  UINT *pSizeZ) {
+  // PSV0 doesn't record the thread group size, so only compute shaders need
+  // the bitcode.
+  DxilShaderReflection *pReflection =
+      (m_PSV.GetShaderKind() == PSVShaderKind::Invalid || m_PSV.IsCS())
+          ? GetModuleReflection()
+          : nullptr;
+  if (pReflection == nullptr) {
+    AssignToOutOpt((UINT)0, pSizeX);
+    AssignToOutOpt((UINT)0, pSizeY);
+    AssignToOutOpt((UINT)0, pSizeZ);
+    return 0;
+  }
+  return pReflection->GetThreadGroupSize(pSizeX, pSizeY, pSizeZ);
+}
+
+UINT64 DxilPartShaderReflection::GetRequiresFlags() {
+  return FeatureInfoToRequiresFlags(m_FeatureInfo);
+}
+
+
 
 // ID3D12FunctionReflection
 
 class CFunctionReflection : public ID3D12FunctionReflection {
 protected:
   DxilLibraryReflection * m_pLibraryReflection = nullptr;
-  const Function *m_pFunction;
+  Function *m_pFunction;
   const DxilFunctionProps *m_pProps;  // nullptr if non-shader library function or patch constant function
   std::string m_Name;
   typedef SmallSetVector<UINT32, 8> ResourceUseSet;
   ResourceUseSet m_UsedResources;
   ResourceUseSet m_UsedCBs;
+  std::atomic<bool> m_bResourceUseLoaded{false};
+
+  // Resource use is collected from the function body, which is only parsed
+  // when the function is first queried.
+  void LoadResourceUse() {
+    if (m_bResourceUseLoaded.load(std::memory_order_acquire))
+      return;
+    std::lock_guard<std::mutex> lock(m_pLibraryReflection->m_LazyLock);
+    LoadResourceUseLocked();
+  }
 
 public:
   void Initialize(DxilLibraryReflection* pLibraryReflection, Function *pFunction) {
@@ -2132,6 +2872,20 @@ public:
       m_pProps = &M.GetDxilFunctionProps(m_pFunction);
     }
   }
+  Function *GetFunction() { return m_pFunction; }
+  const DxilFunctionProps *GetProps() { return m_pProps; }
+  const std::string &GetName() { return m_Name; }
+  // The caller holds the library's m_LazyLock.
+  void LoadResourceUseLocked() {
+    if (m_bResourceUseLoaded.load(std::memory_order_relaxed))
+      return;
+    m_pLibraryReflection->AddFunctionResourceUse(*this);
+    m_bResourceUseLoaded.store(true, std::memory_order_release);
+  }
+  const ResourceUseSet &GetUsedResourcesLocked() {
+    LoadResourceUseLocked();
+    return m_UsedResources;
+  }
   void AddResourceReference(UINT resIndex) {
     m_UsedResources.insert(resIndex);
   }
@@ -2164,6 +2918,7 @@ _Use_decl_annotations_
 HRESULT CFunctionReflection::GetDesc(D3D12_FUNCTION_DESC *pDesc) {
   DXASSERT_NOMSG(m_pLibraryReflection);
   IFR(ZeroMemoryToOut(pDesc));
+  LoadResourceUse();
 
   const ShaderModel* pSM = m_pLibraryReflection->m_pDxilModule->GetShaderModel();
   DXIL::ShaderKind kind = DXIL::ShaderKind::Library;
@@ -2178,27 +2933,20 @@ HRESULT CFunctionReflection::GetDesc(D3D12_FUNCTION_DESC *pDesc) {
   pDesc->ConstantBuffers = (UINT)m_UsedCBs.size();
   pDesc->BoundResources = (UINT)m_UsedResources.size();
 
-  //Unset:  UINT                    InstructionCount;            // Number of emitted instructions
+  // Instruction counts come from the statistics part, if the container has
+  // one.
   //Unset:  UINT                    TempRegisterCount;           // Number of temporary registers used 
-  //Unset:  UINT                    TempArrayCount;              // Number of temporary arrays used
   //Unset:  UINT                    DefCount;                    // Number of constant defines 
   //Unset:  UINT                    DclCount;                    // Number of declarations (input + output)
-  //Unset:  UINT                    TextureNormalInstructions;   // Number of non-categorized texture instructions
-  //Unset:  UINT                    TextureLoadInstructions;     // Number of texture load instructions
-  //Unset:  UINT                    TextureCompInstructions;     // Number of texture comparison instructions
-  //Unset:  UINT                    TextureBiasInstructions;     // Number of texture bias instructions
-  //Unset:  UINT                    TextureGradientInstructions; // Number of texture gradient instructions
-  //Unset:  UINT                    FloatInstructionCount;       // Number of floating point arithmetic instructions used
-  //Unset:  UINT                    IntInstructionCount;         // Number of signed integer arithmetic instructions used
-  //Unset:  UINT                    UintInstructionCount;        // Number of unsigned integer arithmetic instructions used
-  //Unset:  UINT                    StaticFlowControlCount;      // Number of static flow control instructions used
-  //Unset:  UINT                    DynamicFlowControlCount;     // Number of dynamic flow control instructions used
   //Unset:  UINT                    MacroInstructionCount;       // Number of macro instructions used
-  //Unset:  UINT                    ArrayInstructionCount;       // Number of array instructions used
   //Unset:  UINT                    MovInstructionCount;         // Number of mov instructions used
-  //Unset:  UINT                    MovcInstructionCount;        // Number of movc instructions used
-  //Unset:  UINT                    ConversionInstructionCount;  // Number of type conversion instructions used
-  //Unset:  UINT                    BitwiseInstructionCount;     // Number of bitwise arithmetic instructions used
+  DxilShaderStatisticsEntry Stats;
+  if (m_pLibraryReflection->GetStatistics(m_Name.c_str(), &Stats)) {
+    SetInstructionCounts(Stats, pDesc);
+    pDesc->MovcInstructionCount = Stats.MovcInstructionCount;
+    pDesc->ConversionInstructionCount = Stats.ConversionInstructionCount;
+    pDesc->BitwiseInstructionCount = Stats.BitwiseInstructionCount;
+  }
   //Unset:  D3D_FEATURE_LEVEL       MinFeatureLevel;             // Min target of the function byte code
   //Unset:  UINT64                  RequiredFeatureFlags;        // Required feature flags
 
@@ -2214,6 +2962,7 @@ HRESULT CFunctionReflection::GetDesc(D3D12_FUNCTION_DESC *pDesc) {
 // BufferIndex is relative to used constant buffers here
 ID3D12ShaderReflectionConstantBuffer *CFunctionReflection::GetConstantBufferByIndex(UINT BufferIndex) {
   DXASSERT_NOMSG(m_pLibraryReflection);
+  LoadResourceUse();
   if (BufferIndex >= m_UsedCBs.size())
     return &g_InvalidSRConstantBuffer;
   return m_pLibraryReflection->_GetConstantBufferByIndex(m_UsedCBs[BufferIndex]);
@@ -2227,6 +2976,7 @@ ID3D12ShaderReflectionConstantBuffer *CFunctionReflection::GetConstantBufferByNa
 HRESULT CFunctionReflection::GetResourceBindingDesc(UINT ResourceIndex,
   D3D12_SHADER_INPUT_BIND_DESC * pDesc) {
   DXASSERT_NOMSG(m_pLibraryReflection);
+  LoadResourceUse();
   if (ResourceIndex >= m_UsedResources.size())
     return E_INVALIDARG;
   return m_pLibraryReflection->_GetResourceBindingDesc(m_UsedResources[ResourceIndex], pDesc);
@@ -2246,35 +2996,52 @@ HRESULT CFunctionReflection::GetResourceBindingDescByName(LPCSTR Name,
 
 // DxilLibraryReflection
 
-// From DxilContainerAssembler:
-static llvm::Function *FindUsingFunction(llvm::Value *User) {
-  if (llvm::Instruction *I = dyn_cast<llvm::Instruction>(User)) {
-    // Instruction should be inside a basic block, which is in a function
-    return cast<llvm::Function>(I->getParent()->getParent());
-  }
-  // User can be either instruction, constant, or operator. But User is an
-  // operator only if constant is a scalar value, not resource pointer.
-  llvm::Constant *CU = cast<llvm::Constant>(User);
-  if (!CU->user_empty())
-    return FindUsingFunction(*CU->user_begin());
-  else
-    return nullptr;
+void DxilLibraryReflection::AddResourceSymbol(DxilResourceBase &resource, unsigned resIndex) {
+  if (Constant *var = resource.GetGlobalSymbol())
+    m_ResourceIndexBySymbol[var] = resIndex;
 }
 
-void DxilLibraryReflection::AddResourceUseToFunctions(DxilResourceBase &resource, unsigned resIndex) {
-  Constant *var = resource.GetGlobalSymbol();
-  if (var) {
-    for (auto user : var->users()) {
-      // Find the function.
-      if (llvm::Function *F = FindUsingFunction(user)) {
-        auto funcReflector = m_FunctionsByPtr[F];
-        funcReflector->AddResourceReference(resIndex);
-        if (resource.GetClass() == DXIL::ResourceClass::CBuffer) {
-          funcReflector->AddCBReference(resource.GetID());
-        }
-      }
+// Resource symbols are used directly or through constant expressions.
+static void CollectResourceUse(const Constant *C,
+                               const DenseMap<const Constant*, UINT> &symbols,
+                               SmallPtrSetImpl<const Constant*> &visited,
+                               std::set<UINT> &used) {
+  if (!visited.insert(C).second)
+    return;
+  auto it = symbols.find(C);
+  if (it != symbols.end()) {
+    used.insert(it->second);
+    return;
+  }
+  if (isa<GlobalValue>(C))
+    return;
+  for (const Use &U : C->operands()) {
+    if (const Constant *Op = dyn_cast<Constant>(U.get()))
+      CollectResourceUse(Op, symbols, visited, used);
+  }
+}
+
+void DxilLibraryReflection::AddFunctionResourceUse(CFunctionReflection &func) {
+  DxcThreadMalloc TM(m_pMalloc);
+  Function *F = func.GetFunction();
+  if (F->isMaterializable() && F->materialize())
+    return;
+
+  std::set<UINT> used;
+  SmallPtrSet<const Constant*, 16> visited;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    for (const Use &U : I->operands()) {
+      if (const Constant *C = dyn_cast<Constant>(U.get()))
+        CollectResourceUse(C, m_ResourceIndexBySymbol, visited, used);
     }
   }
+  // Resources are reported in the order of m_Resources.
+  for (UINT resIndex : used) {
+    const D3D12_SHADER_INPUT_BIND_DESC &resource = m_Resources[resIndex];
+    func.AddResourceReference(resIndex);
+    if (resource.Type == D3D_SIT_CBUFFER)
+      func.AddCBReference(resource.uID);
+  }
 }
 
 void DxilLibraryReflection::AddResourceDependencies() {
@@ -2299,14 +3066,14 @@ void DxilLibraryReflection::AddResourceDependencies() {
   for (auto &resource : m_Resources) {
     switch ((UINT32)resource.Type) {
     case D3D_SIT_CBUFFER:
-      AddResourceUseToFunctions(m_pDxilModule->GetCBuffer(resource.uID), resIndex);
+      AddResourceSymbol(m_pDxilModule->GetCBuffer(resource.uID), resIndex);
       break;
     case D3D_SIT_TBUFFER:   // TODO: Handle when TBuffers are added to CB list
     case D3D_SIT_TEXTURE:
     case D3D_SIT_STRUCTURED:
     case D3D_SIT_BYTEADDRESS:
     case D3D_SIT_RTACCELERATIONSTRUCTURE:
-      AddResourceUseToFunctions(m_pDxilModule->GetSRV(resource.uID), resIndex);
+      AddResourceSymbol(m_pDxilModule->GetSRV(resource.uID), resIndex);
       break;
     case D3D_SIT_UAV_RWTYPED:
     case D3D_SIT_UAV_RWSTRUCTURED:
@@ -2314,10 +3081,10 @@ void DxilLibraryReflection::AddResourceDependencies() {
     case D3D_SIT_UAV_APPEND_STRUCTURED:
     case D3D_SIT_UAV_CONSUME_STRUCTURED:
     case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
-      AddResourceUseToFunctions(m_pDxilModule->GetUAV(resource.uID), resIndex);
+      AddResourceSymbol(m_pDxilModule->GetUAV(resource.uID), resIndex);
       break;
     case D3D_SIT_SAMPLER:
-      AddResourceUseToFunctions(m_pDxilModule->GetSampler(resource.uID), resIndex);
+      AddResourceSymbol(m_pDxilModule->GetSampler(resource.uID), resIndex);
       break;
     }
     resIndex++;
@@ -2328,7 +3095,7 @@ void DxilLibraryReflection::AddResourceDependencies() {
 
 HRESULT DxilLibraryReflection::Load(IDxcBlob *pBlob,
   const DxilPartHeader *pPart) {
-  IFR(LoadModule(pBlob, pPart));
+  IFR(LoadModule(pBlob, pPart, /*bLazyLoad*/ true));
 
   try {
     AddResourceDependencies();
@@ -2354,6 +3121,89 @@ ID3D12FunctionReflection *DxilLibraryReflection::GetFunctionByIndex(INT Function
   return m_FunctionVector[FunctionIndex];
 }
 
+// IDxcLibraryReflectionTable
+
+void DxilLibraryReflection::BuildFunctionTable() {
+  m_FunctionDescs.clear();
+  m_ResourceDescs.clear();
+  m_FunctionResources.clear();
+  m_UnmangledNames.clear();
+  m_ResourceDescs.reserve(m_Resources.size());
+  for (const D3D12_SHADER_INPUT_BIND_DESC &resource : m_Resources) {
+    DxcLibraryResourceDesc desc;
+    desc.Name = resource.Name;
+    desc.Type = (UINT32)resource.Type;
+    desc.Space = resource.Space;
+    desc.BindPoint = resource.BindPoint;
+    desc.BindCount = resource.BindCount;
+    m_ResourceDescs.push_back(desc);
+  }
+
+  // Collect everything first, so that pointers into the vectors are stable.
+  std::vector<std::pair<UINT32, UINT32>> resourceRanges;
+  resourceRanges.reserve(m_FunctionVector.size());
+  m_UnmangledNames.reserve(m_FunctionVector.size());
+  m_FunctionDescs.reserve(m_FunctionVector.size());
+  for (CFunctionReflection *pFunc : m_FunctionVector) {
+    const auto &used = pFunc->GetUsedResourcesLocked();
+    resourceRanges.emplace_back((UINT32)m_FunctionResources.size(),
+                                (UINT32)used.size());
+    m_FunctionResources.insert(m_FunctionResources.end(), used.begin(),
+                               used.end());
+    m_UnmangledNames.push_back(
+        dxilutil::DemangleFunctionName(pFunc->GetName()).str());
+
+    DxcLibraryFunctionDesc desc = {};
+    desc.Name = pFunc->GetName().c_str();
+    desc.ShaderKind = (UINT32)DXIL::ShaderKind::Library;
+    // The body is materialized by now, so shader flags can be collected.
+    desc.FeatureInfo =
+        m_pDxilModule->GetFunctionShaderFlags(pFunc->GetFunction())
+            .GetFeatureInfo();
+    if (const DxilFunctionProps *pProps = pFunc->GetProps()) {
+      desc.ShaderKind = (UINT32)pProps->shaderKind;
+      if (pProps->IsClosestHit() || pProps->IsAnyHit()) {
+        desc.PayloadSizeInBytes = pProps->ShaderProps.Ray.payloadSizeInBytes;
+        desc.AttributeSizeInBytes = pProps->ShaderProps.Ray.attributeSizeInBytes;
+      } else if (pProps->IsMiss()) {
+        desc.PayloadSizeInBytes = pProps->ShaderProps.Ray.payloadSizeInBytes;
+      } else if (pProps->IsCallable()) {
+        desc.PayloadSizeInBytes = pProps->ShaderProps.Ray.paramSizeInBytes;
+      }
+    }
+    m_FunctionDescs.push_back(desc);
+  }
+  for (size_t i = 0; i < m_FunctionDescs.size(); ++i) {
+    DxcLibraryFunctionDesc &desc = m_FunctionDescs[i];
+    desc.UnmangledName = m_UnmangledNames[i].c_str();
+    desc.NumResources = resourceRanges[i].second;
+    desc.Resources = desc.NumResources
+                         ? m_FunctionResources.data() + resourceRanges[i].first
+                         : nullptr;
+  }
+}
+
+_Use_decl_annotations_
+HRESULT DxilLibraryReflection::GetFunctionTable(DxcLibraryFunctionTable *pTable) {
+  IFR(ZeroMemoryToOut(pTable));
+  try {
+    if (!m_bFunctionTableBuilt.load(std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(m_LazyLock);
+      if (!m_bFunctionTableBuilt.load(std::memory_order_relaxed)) {
+        DxcThreadMalloc TM(m_pMalloc);
+        BuildFunctionTable();
+        m_bFunctionTableBuilt.store(true, std::memory_order_release);
+      }
+    }
+    pTable->NumFunctions = (UINT32)m_FunctionDescs.size();
+    pTable->Functions = m_FunctionDescs.data();
+    pTable->NumResources = (UINT32)m_ResourceDescs.size();
+    pTable->Resources = m_ResourceDescs.data();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 #else // LLVM_ON_WIN32
 
 void hlsl::CreateDxcContainerReflection(IDxcContainerReflection **ppResult) {
@@ -2361,6 +3211,8 @@ void hlsl::CreateDxcContainerReflection(IDxcContainerReflection **ppResult) {
 }
 
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerReflection)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerSemanticHash)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLibraryReflectionTable)
 
 #endif // LLVM_ON_WIN32
 
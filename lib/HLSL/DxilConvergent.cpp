@@ -46,6 +46,10 @@ public:
     return "DxilConvergentMark";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     if (M.HasHLModule()) {
       if (!M.GetHLModule().GetShaderModel()->IsPS())
@@ -223,6 +227,10 @@ public:
     return "DxilConvergentClear";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     std::vector<Function *> convergentList;
     for (Function &F : M.functions()) {
@@ -0,0 +1,562 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilDemoteOutputPrecision.cpp                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Demote arithmetic that feeds low precision outputs to 16-bit floats.      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilSignatureElement.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cmath>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Pixel shader color outputs and UNORM/SNORM UAV writes are quantized to a
+// few bits per channel, so the fp32 arithmetic that computes them often
+// needs no more than a 16-bit float. Such arithmetic is rewritten to half,
+// which means min16float unless 16-bit types are enabled, halving the
+// registers it needs.
+//
+// A write is demoted only when interval arithmetic proves that every value
+// computing it stays within the half range, and that the accumulated
+// rounding error of IEEE half arithmetic stays under half a quantization
+// step of an OutputBits-bit target. Values that come from outside the
+// demoted arithmetic need a known range too: constants, saturate results,
+// half values, and samples of UNORM/SNORM resources qualify. Precise
+// instructions, including those marked by precise propagation, are never
+// demoted, and an instruction is only demoted if all of its users are.
+//
+// The render target format isn't known when compiling, so demoting color
+// outputs relies on the caller knowing that they are no wider than
+// OutputBits. UAV writes are only demoted for UNORM/SNORM resources.
+
+namespace {
+
+// Range of a value and a bound on the absolute error of computing it in
+// half precision.
+struct HalfBounds {
+  double Lo = 0;
+  double Hi = 0;
+  double Err = 0;
+  bool bKnown = false;
+
+  double Magnitude() const { return std::max(std::fabs(Lo), std::fabs(Hi)); }
+};
+
+// A write to a low precision destination.
+struct OutputSink {
+  CallInst *Store;
+  unsigned OpIdx;
+  std::string Desc;
+};
+
+const double kHalfMax = 65504.0;
+
+// Bound on the error of rounding a value of at most magnitude M to half.
+double HalfRoundingError(double M) {
+  if (M == 0)
+    return 0;
+  if (M < std::ldexp(1.0, -14))
+    return std::ldexp(1.0, -25);
+  int Exp;
+  std::frexp(M, &Exp);
+  return std::ldexp(1.0, Exp - 12);
+}
+
+HalfBounds MakeBounds(double Lo, double Hi, double Err) {
+  HalfBounds B;
+  B.Lo = Lo;
+  B.Hi = Hi;
+  B.Err = Err;
+  B.bKnown = B.Magnitude() + Err <= kHalfMax;
+  return B;
+}
+
+HalfBounds MulBounds(const HalfBounds &A, const HalfBounds &B) {
+  double P[] = {A.Lo * B.Lo, A.Lo * B.Hi, A.Hi * B.Lo, A.Hi * B.Hi};
+  double Lo = *std::min_element(P, P + 4);
+  double Hi = *std::max_element(P, P + 4);
+  double Err = A.Magnitude() * B.Err + B.Magnitude() * A.Err + A.Err * B.Err;
+  return MakeBounds(Lo, Hi,
+                    Err + HalfRoundingError(std::max(-Lo, Hi)));
+}
+
+HalfBounds AddBounds(const HalfBounds &A, const HalfBounds &B) {
+  double Lo = A.Lo + B.Lo;
+  double Hi = A.Hi + B.Hi;
+  return MakeBounds(Lo, Hi,
+                    A.Err + B.Err + HalfRoundingError(std::max(-Lo, Hi)));
+}
+
+HalfBounds NegBounds(const HalfBounds &A) {
+  return MakeBounds(-A.Hi, -A.Lo, A.Err);
+}
+
+// min, max and select don't round, and don't increase the error.
+HalfBounds UnionBounds(const HalfBounds &A, const HalfBounds &B) {
+  return MakeBounds(std::min(A.Lo, B.Lo), std::max(A.Hi, B.Hi),
+                    std::max(A.Err, B.Err));
+}
+
+class DxilDemoteOutputPrecision : public FunctionPass {
+  unsigned m_OutputBits;
+  bool m_Report;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilDemoteOutputPrecision(bool Report = false)
+      : FunctionPass(ID), m_OutputBits(8), m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL demote output precision";
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "OutputBits", &m_OutputBits, 8);
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",OutputBits=" << m_OutputBits;
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  DxilModule *m_pDM = nullptr;
+  SetVector<Instruction *> m_Candidates;
+  DenseMap<Value *, HalfBounds> m_Bounds;
+  DenseMap<Value *, Value *> m_HalfValues;
+
+  void CollectSinks(Function &F, std::vector<OutputSink> &Sinks);
+  bool IsCandidate(Instruction *I);
+  void CollectCandidates(Value *V);
+  HalfBounds GetBounds(Value *V);
+  HalfBounds GetLeafBounds(Value *V);
+  HalfBounds GetCandidateBounds(Instruction *I);
+  Value *GetHalfValue(Value *V, SetVector<Instruction *> &Demoted);
+};
+
+char DxilDemoteOutputPrecision::ID = 0;
+
+// Returns the resource a handle was created for, or null.
+DxilResource *GetHandleResource(DxilModule &DM, Value *Handle) {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI, OP::OpCode::CreateHandle))
+    return nullptr;
+  DxilInst_CreateHandle CreateHandle(CI);
+  ConstantInt *RangeId = dyn_cast<ConstantInt>(CreateHandle.get_rangeId());
+  if (!RangeId)
+    return nullptr;
+  switch (static_cast<DXIL::ResourceClass>(
+      CreateHandle.get_resourceClass_val())) {
+  case DXIL::ResourceClass::SRV:
+    return &DM.GetSRV(RangeId->getLimitedValue());
+  case DXIL::ResourceClass::UAV:
+    return &DM.GetUAV(RangeId->getLimitedValue());
+  default:
+    return nullptr;
+  }
+}
+
+bool IsNormalized(DxilResource *Res) {
+  return Res && (Res->GetCompType().IsUNorm() || Res->GetCompType().IsSNorm());
+}
+
+void DxilDemoteOutputPrecision::CollectSinks(Function &F,
+                                             std::vector<OutputSink> &Sinks) {
+  bool bColorOutputs = m_pDM->GetShaderModel()->IsPS();
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (!CI || !OP::IsDxilOpFuncCallInst(CI))
+        continue;
+      unsigned FirstValue = 0, NumValues = 4;
+      std::string Desc;
+      switch (OP::GetDxilOpFuncCallInst(CI)) {
+      case OP::OpCode::StoreOutput: {
+        DxilInst_StoreOutput Store(CI);
+        ConstantInt *SigId = dyn_cast<ConstantInt>(Store.get_outputSigId());
+        if (!bColorOutputs || !SigId)
+          continue;
+        const DxilSignatureElement &Elt =
+            m_pDM->GetOutputSignature().GetElement(SigId->getLimitedValue());
+        if (Elt.GetKind() != Semantic::Kind::Target)
+          continue;
+        FirstValue = DxilInst_StoreOutput::arg_value;
+        NumValues = 1;
+        Desc = (Twine(Elt.GetSemanticName()) +
+                Twine(Elt.GetSemanticStartIndex())).str();
+        break;
+      }
+      case OP::OpCode::TextureStore:
+      case OP::OpCode::BufferStore: {
+        DxilResource *Res = GetHandleResource(*m_pDM, CI->getArgOperand(1));
+        if (!IsNormalized(Res))
+          continue;
+        FirstValue = OP::GetDxilOpFuncCallInst(CI) == OP::OpCode::TextureStore
+                         ? DxilInst_TextureStore::arg_value0
+                         : DxilInst_BufferStore::arg_value0;
+        Desc = "'" + Res->GetGlobalName() + "'";
+        break;
+      }
+      default:
+        continue;
+      }
+      for (unsigned i = 0; i < NumValues; ++i) {
+        if (CI->getArgOperand(FirstValue + i)->getType()->isFloatTy())
+          Sinks.push_back({CI, FirstValue + i, Desc});
+      }
+    }
+  }
+}
+
+// fp32 arithmetic that can be redone in half.
+bool DxilDemoteOutputPrecision::IsCandidate(Instruction *I) {
+  if (!I->getType()->isFloatTy() || m_pDM->IsPrecise(I))
+    return false;
+  if (isa<SelectInst>(I))
+    return true;
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(I)) {
+    switch (BO->getOpcode()) {
+    case Instruction::FAdd:
+    case Instruction::FSub:
+    case Instruction::FMul:
+      return true;
+    default:
+      return false;
+    }
+  }
+  if (!OP::IsDxilOpFuncCallInst(I))
+    return false;
+  OP::OpCode Opcode = OP::GetDxilOpFuncCallInst(I);
+  switch (Opcode) {
+  case OP::OpCode::Saturate:
+  case OP::OpCode::FMax:
+  case OP::OpCode::FMin:
+  case OP::OpCode::FMad:
+  case OP::OpCode::Dot2:
+  case OP::OpCode::Dot3:
+  case OP::OpCode::Dot4:
+    return OP::IsOverloadLegal(Opcode, Type::getHalfTy(I->getContext()));
+  default:
+    return false;
+  }
+}
+
+void DxilDemoteOutputPrecision::CollectCandidates(Value *V) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I || m_Candidates.count(I) || !IsCandidate(I))
+    return;
+  m_Candidates.insert(I);
+  for (unsigned i = isa<CallInst>(I) ? 1 : 0; i < I->getNumOperands(); ++i) {
+    if (isa<SelectInst>(I) && i == 0)
+      continue;
+    CollectCandidates(I->getOperand(i));
+  }
+}
+
+HalfBounds DxilDemoteOutputPrecision::GetLeafBounds(Value *V) {
+  if (isa<UndefValue>(V))
+    return MakeBounds(0, 0, 0);
+  if (ConstantFP *C = dyn_cast<ConstantFP>(V)) {
+    APFloat Half = C->getValueAPF();
+    bool bLosesInfo;
+    Half.convert(APFloat::IEEEhalf, APFloat::rmNearestTiesToEven, &bLosesInfo);
+    Half.convert(APFloat::IEEEdouble, APFloat::rmNearestTiesToEven,
+                 &bLosesInfo);
+    double Value = C->getValueAPF().convertToFloat();
+    if (!C->getValueAPF().isFinite())
+      return HalfBounds();
+    return MakeBounds(Value, Value,
+                      std::fabs(Value - Half.convertToDouble()));
+  }
+  if (FPExtInst *Ext = dyn_cast<FPExtInst>(V)) {
+    if (Ext->getSrcTy()->isHalfTy())
+      return MakeBounds(-kHalfMax, kHalfMax, 0);
+  }
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (I && OP::IsDxilOpFuncCallInst(I, OP::OpCode::Saturate))
+    return MakeBounds(0, 1, HalfRoundingError(1));
+  // Components of a sample or load of a UNORM or SNORM resource.
+  if (ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(V)) {
+    Instruction *Agg = dyn_cast<Instruction>(EVI->getAggregateOperand());
+    if (!Agg || !OP::IsDxilOpFuncCallInst(Agg) || EVI->getIndices()[0] >= 4)
+      return HalfBounds();
+    switch (OP::GetDxilOpFuncCallInst(Agg)) {
+    case OP::OpCode::Sample:
+    case OP::OpCode::SampleBias:
+    case OP::OpCode::SampleLevel:
+    case OP::OpCode::SampleGrad:
+    case OP::OpCode::TextureLoad:
+    case OP::OpCode::BufferLoad:
+      break;
+    default:
+      return HalfBounds();
+    }
+    DxilResource *Res =
+        GetHandleResource(*m_pDM, cast<CallInst>(Agg)->getArgOperand(1));
+    if (!IsNormalized(Res))
+      return HalfBounds();
+    return MakeBounds(Res->GetCompType().IsSNorm() ? -1 : 0, 1,
+                      HalfRoundingError(1));
+  }
+  return HalfBounds();
+}
+
+HalfBounds DxilDemoteOutputPrecision::GetCandidateBounds(Instruction *I) {
+  if (SelectInst *SI = dyn_cast<SelectInst>(I))
+    return UnionBounds(GetBounds(SI->getTrueValue()),
+                       GetBounds(SI->getFalseValue()));
+
+  // Operands first, so the map isn't changed while they are referenced.
+  SmallVector<HalfBounds, 8> Ops;
+  for (unsigned i = isa<CallInst>(I) ? 1 : 0; i < I->getNumOperands(); ++i) {
+    if (isa<Function>(I->getOperand(i)))
+      continue;
+    Ops.push_back(GetBounds(I->getOperand(i)));
+    if (!Ops.back().bKnown)
+      return HalfBounds();
+  }
+
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(I)) {
+    switch (BO->getOpcode()) {
+    case Instruction::FAdd:
+      return AddBounds(Ops[0], Ops[1]);
+    case Instruction::FSub:
+      return AddBounds(Ops[0], NegBounds(Ops[1]));
+    default:
+      return MulBounds(Ops[0], Ops[1]);
+    }
+  }
+
+  switch (OP::GetDxilOpFuncCallInst(I)) {
+  case OP::OpCode::Saturate:
+    return MakeBounds(std::min(std::max(Ops[0].Lo, 0.0), 1.0),
+                      std::min(std::max(Ops[0].Hi, 0.0), 1.0), Ops[0].Err);
+  case OP::OpCode::FMax:
+    return MakeBounds(std::max(Ops[0].Lo, Ops[1].Lo),
+                      std::max(Ops[0].Hi, Ops[1].Hi),
+                      std::max(Ops[0].Err, Ops[1].Err));
+  case OP::OpCode::FMin:
+    return MakeBounds(std::min(Ops[0].Lo, Ops[1].Lo),
+                      std::min(Ops[0].Hi, Ops[1].Hi),
+                      std::max(Ops[0].Err, Ops[1].Err));
+  case OP::OpCode::FMad:
+    return AddBounds(MulBounds(Ops[0], Ops[1]), Ops[2]);
+  default: {
+    // Dot2, Dot3 and Dot4 take the components of both vectors in turn.
+    unsigned N = Ops.size() / 2;
+    HalfBounds Sum = MulBounds(Ops[0], Ops[N]);
+    for (unsigned i = 1; i < N; ++i)
+      Sum = AddBounds(Sum, MulBounds(Ops[i], Ops[N + i]));
+    return Sum;
+  }
+  }
+}
+
+HalfBounds DxilDemoteOutputPrecision::GetBounds(Value *V) {
+  auto It = m_Bounds.find(V);
+  if (It != m_Bounds.end())
+    return It->second;
+  Instruction *I = dyn_cast<Instruction>(V);
+  HalfBounds B = I && m_Candidates.count(I) ? GetCandidateBounds(I)
+                                            : GetLeafBounds(V);
+  return m_Bounds[V] = B;
+}
+
+// Returns V computed in half, creating the demoted instructions it needs.
+Value *DxilDemoteOutputPrecision::GetHalfValue(
+    Value *V, SetVector<Instruction *> &Demoted) {
+  auto It = m_HalfValues.find(V);
+  if (It != m_HalfValues.end())
+    return It->second;
+
+  Type *HalfTy = Type::getHalfTy(V->getContext());
+  Value *Result;
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (Constant *C = dyn_cast<Constant>(V)) {
+    Result = ConstantExpr::getFPTrunc(C, HalfTy);
+  } else if (I && Demoted.count(I)) {
+    Instruction *Clone = I->clone();
+    Clone->mutateType(HalfTy);
+    for (unsigned i = 0; i < I->getNumOperands(); ++i) {
+      Value *Op = I->getOperand(i);
+      if (Op->getType()->isFloatTy())
+        Clone->setOperand(i, GetHalfValue(Op, Demoted));
+    }
+    if (CallInst *CI = dyn_cast<CallInst>(Clone)) {
+      OP *HlslOP = m_pDM->GetOP();
+      CI->setCalledFunction(
+          HlslOP->GetOpFunc(OP::GetDxilOpFuncCallInst(I), HalfTy));
+    }
+    Clone->insertBefore(I);
+    Clone->takeName(I);
+    Result = Clone;
+  } else {
+    // A value from outside the demoted code; truncate it once, right where
+    // it is defined.
+    BasicBlock::iterator InsertPt;
+    if (!I)
+      InsertPt = cast<Argument>(V)->getParent()->getEntryBlock()
+                     .getFirstInsertionPt();
+    else if (isa<PHINode>(I))
+      InsertPt = I->getParent()->getFirstInsertionPt();
+    else
+      InsertPt = std::next(BasicBlock::iterator(I));
+    Result = IRBuilder<>(InsertPt).CreateFPTrunc(V, HalfTy);
+  }
+  return m_HalfValues[V] = Result;
+}
+
+bool DxilDemoteOutputPrecision::runOnFunction(Function &F) {
+  if (!F.getParent()->HasDxilModule())
+    return false;
+  m_pDM = &F.getParent()->GetDxilModule();
+
+  std::vector<OutputSink> Sinks;
+  CollectSinks(F, Sinks);
+  if (Sinks.empty())
+    return false;
+
+  m_Candidates.clear();
+  m_Bounds.clear();
+  m_HalfValues.clear();
+  for (OutputSink &Sink : Sinks)
+    CollectCandidates(Sink.Store->getArgOperand(Sink.OpIdx));
+
+  // Half a step of an unsigned normalized target with OutputBits bits.
+  double MaxErr =
+      0.5 / (std::ldexp(1.0, std::max(1u, std::min(m_OutputBits, 24u))) - 1);
+
+  // Bounds are only valid for the set of candidates they were computed
+  // with, so shrink the set until everything in it is demoted.
+  SmallPtrSet<Instruction *, 16> AcceptedSinks;
+  SetVector<Instruction *> Roots;
+  SetVector<Instruction *> Demoted;
+  for (;;) {
+    // Accept the writes whose error is small enough.
+    m_Bounds.clear();
+    AcceptedSinks.clear();
+    Roots.clear();
+    for (OutputSink &Sink : Sinks) {
+      Instruction *I =
+          dyn_cast<Instruction>(Sink.Store->getArgOperand(Sink.OpIdx));
+      if (!I || !m_Candidates.count(I))
+        continue;
+      HalfBounds B = GetBounds(I);
+      if (B.bKnown && B.Err <= MaxErr) {
+        AcceptedSinks.insert(Sink.Store);
+        Roots.insert(I);
+      }
+    }
+
+    // Demote what the accepted writes need, as long as nothing else uses it.
+    Demoted.clear();
+    SmallVector<Instruction *, 16> Worklist(Roots.begin(), Roots.end());
+    while (!Worklist.empty()) {
+      Instruction *I = Worklist.pop_back_val();
+      if (!Demoted.insert(I))
+        continue;
+      for (Value *Op : I->operands()) {
+        Instruction *OpI = dyn_cast<Instruction>(Op);
+        if (OpI && m_Candidates.count(OpI))
+          Worklist.push_back(OpI);
+      }
+    }
+    bool bRemoved = true;
+    while (bRemoved) {
+      bRemoved = false;
+      for (unsigned i = 0; i < Demoted.size(); ++i) {
+        Instruction *I = Demoted[i];
+        for (User *U : I->users()) {
+          Instruction *UI = cast<Instruction>(U);
+          if (!Demoted.count(UI) && !AcceptedSinks.count(UI)) {
+            Demoted.remove(I);
+            bRemoved = true;
+            break;
+          }
+        }
+      }
+    }
+
+    if (Demoted.size() == m_Candidates.size())
+      break;
+    m_Candidates = Demoted;
+  }
+
+  if (Roots.empty())
+    return false;
+
+  DenseMap<Value *, double> RootErrors;
+  for (Instruction *Root : Roots) {
+    Value *Half = GetHalfValue(Root, Demoted);
+    Value *Ext = IRBuilder<>(cast<Instruction>(Half)->getNextNode())
+                     .CreateFPExt(Half, Root->getType());
+    RootErrors[Ext] = m_Bounds[Root].Err;
+    Root->replaceAllUsesWith(Ext);
+  }
+  for (Instruction *I : Demoted)
+    I->dropAllReferences();
+  for (Instruction *I : Demoted)
+    I->eraseFromParent();
+
+  if (m_Report) {
+    MapVector<StringRef, std::pair<Instruction *, double>> Changed;
+    for (OutputSink &Sink : Sinks) {
+      auto It = RootErrors.find(Sink.Store->getArgOperand(Sink.OpIdx));
+      if (It == RootErrors.end())
+        continue;
+      auto &Entry = Changed[Sink.Desc];
+      if (!Entry.first)
+        Entry.first = Sink.Store;
+      Entry.second = std::max(Entry.second, It->second);
+    }
+    LLVMContext &Ctx = F.getContext();
+    for (auto &Entry : Changed) {
+      std::string Msg;
+      raw_string_ostream OS(Msg);
+      OS << Entry.first << " computed in 16-bit precision, with an error of "
+         << "at most " << format("%.2g", Entry.second.second) << ".";
+      OS.flush();
+      if (DebugLoc DL = Entry.second.first->getDebugLoc())
+        Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, Msg));
+      else
+        Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+    }
+  }
+  return true;
+}
+
+}
+
+FunctionPass *llvm::createDxilDemoteOutputPrecisionPass(bool Report) {
+  return new DxilDemoteOutputPrecision(Report);
+}
+
+INITIALIZE_PASS(DxilDemoteOutputPrecision, "dxil-demote-output-precision",
+                "DXIL demote output precision", false, false)
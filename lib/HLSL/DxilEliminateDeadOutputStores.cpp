@@ -0,0 +1,205 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilEliminateDeadOutputStores.cpp                                         //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Removes output stores that a later store to the same component always     //
+// overwrites.                                                               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Inlined helpers that initialize a whole output structure leave stores that
+// the shader then overwrites. Only the last value stored to an output
+// component before the shader returns is exported, so a store is dead when,
+// on every path from it to a return, another store to the same component
+// follows. Vertex, domain and geometry shader outputs can't be read back, so
+// the only other events that observe them are the emits and cuts of a
+// geometry shader, and calls, which end the search.
+//
+// Stores with a dynamic row or column are kept and never overwrite others.
+// The last store to each component along each path is never removed, so the
+// components a path writes, which DxilPreserveAllOutputs relies on, don't
+// change.
+
+namespace {
+
+class DxilEliminateDeadOutputStores : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilEliminateDeadOutputStores() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL eliminate dead output stores";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // Components with a constant row and column, numbered in the order first
+  // found.
+  DenseMap<uint64_t, unsigned> m_Components;
+
+  // Gets the component a store writes, or -1 if it's dynamic.
+  int GetComponent(DxilInst_StoreOutput &Store, bool bCreate);
+  static bool ObservesOutputs(Instruction *I);
+  // Steps Overwritten, the components stored on every path from after I,
+  // to before it. Returns true if I is a store they include.
+  bool Transfer(Instruction *I, BitVector &Overwritten);
+};
+
+int DxilEliminateDeadOutputStores::GetComponent(DxilInst_StoreOutput &Store,
+                                                bool bCreate) {
+  ConstantInt *SigId = dyn_cast<ConstantInt>(Store.get_outputSigId());
+  ConstantInt *Row = dyn_cast<ConstantInt>(Store.get_rowIndex());
+  ConstantInt *Col = dyn_cast<ConstantInt>(Store.get_colIndex());
+  if (!SigId || !Row || !Col)
+    return -1;
+  uint64_t Key = (SigId->getZExtValue() << 40) | (Row->getZExtValue() << 8) |
+                 Col->getZExtValue();
+  if (!bCreate) {
+    auto It = m_Components.find(Key);
+    return It == m_Components.end() ? -1 : (int)It->second;
+  }
+  return m_Components.insert(std::make_pair(Key, m_Components.size()))
+      .first->second;
+}
+
+bool DxilEliminateDeadOutputStores::ObservesOutputs(Instruction *I) {
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI)
+    return false;
+  Function *Callee = CI->getCalledFunction();
+  if (!Callee || !OP::IsDxilOpFunc(Callee))
+    return !isa<DbgInfoIntrinsic>(CI);
+  switch (OP::GetDxilOpFuncCallInst(CI)) {
+  case DXIL::OpCode::EmitStream:
+  case DXIL::OpCode::CutStream:
+  case DXIL::OpCode::EmitThenCutStream:
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool DxilEliminateDeadOutputStores::Transfer(Instruction *I,
+                                             BitVector &Overwritten) {
+  if (ObservesOutputs(I)) {
+    Overwritten.reset();
+    return false;
+  }
+  DxilInst_StoreOutput Store(I);
+  if (!Store)
+    return false;
+  int Component = GetComponent(Store, /*bCreate*/ false);
+  if (Component < 0)
+    return false;
+  bool bDead = Overwritten.test(Component);
+  Overwritten.set(Component);
+  return bDead;
+}
+
+bool DxilEliminateDeadOutputStores::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+  const ShaderModel *SM = DM.GetShaderModel();
+  if (&F != DM.GetEntryFunction() ||
+      !(SM->IsVS() || SM->IsDS() || SM->IsGS()))
+    return false;
+
+  m_Components.clear();
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      DxilInst_StoreOutput Store(&I);
+      if (Store)
+        GetComponent(Store, /*bCreate*/ true);
+    }
+  }
+  if (m_Components.empty())
+    return false;
+
+  // The components stored on every path from the start of each block. This
+  // is a must analysis, so blocks start with every component and only lose
+  // them.
+  unsigned NumComponents = m_Components.size();
+  DenseMap<BasicBlock *, BitVector> In;
+  for (BasicBlock &BB : F)
+    In[&BB] = BitVector(NumComponents, true);
+
+  auto GetOut = [&](BasicBlock *BB) {
+    BitVector Out(NumComponents, false);
+    bool bFirst = true;
+    for (BasicBlock *Succ : successors(BB)) {
+      if (bFirst)
+        Out = In[Succ];
+      else
+        Out &= In[Succ];
+      bFirst = false;
+    }
+    return Out;
+  };
+
+  // Successors mostly come first in post order.
+  bool bIterate = true;
+  while (bIterate) {
+    bIterate = false;
+    for (BasicBlock *BB : post_order(&F)) {
+      BitVector Overwritten = GetOut(BB);
+      for (auto It = BB->rbegin(); It != BB->rend(); ++It)
+        Transfer(&*It, Overwritten);
+      if (Overwritten != In[BB]) {
+        In[BB] = Overwritten;
+        bIterate = true;
+      }
+    }
+  }
+
+  SmallVector<Instruction *, 8> DeadStores;
+  for (BasicBlock &BB : F) {
+    BitVector Overwritten = GetOut(&BB);
+    for (auto It = BB.rbegin(); It != BB.rend(); ++It) {
+      if (Transfer(&*It, Overwritten))
+        DeadStores.push_back(&*It);
+    }
+  }
+  for (Instruction *I : DeadStores)
+    I->eraseFromParent();
+  return !DeadStores.empty();
+}
+
+}
+
+char DxilEliminateDeadOutputStores::ID = 0;
+
+FunctionPass *llvm::createDxilEliminateDeadOutputStoresPass() {
+  return new DxilEliminateDeadOutputStores();
+}
+
+INITIALIZE_PASS(DxilEliminateDeadOutputStores,
+                "dxil-eliminate-dead-output-stores",
+                "DXIL eliminate dead output stores", false, false)
@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilEliminateLocalDynamicIndexing.cpp                                     //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Eliminate dynamic indexing on small local arrays.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilUtil.h"
+#include "dxc/Support/Global.h"
+
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/PromoteMemToReg.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Dynamically indexed local arrays become indexable temps, which drivers
+// usually place in scratch memory. A small array is split into one alloca per
+// element and promoted to registers instead:
+// - a dynamic load becomes a chain of selects over the elements,
+// - a dynamic store becomes a select per element between the stored value
+//   and the element's current value.
+// Arrays that are too large or accessed dynamically too often, where the
+// selects would cost more than the memory access, are kept in memory.
+
+namespace {
+struct LocalArrayAccesses {
+  SmallVector<GetElementPtrInst *, 8> GEPs;
+  unsigned DynamicLoads = 0;
+  unsigned DynamicStores = 0;
+  bool bAllStoresConstant = true;
+  Instruction *FirstDynamic = nullptr;
+};
+
+class DxilEliminateLocalDynamicIndexing : public FunctionPass {
+  unsigned m_MaxElements;
+  unsigned m_MaxSelects;
+  bool m_Report = false;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilEliminateLocalDynamicIndexing(unsigned MaxElements = 8,
+                                             unsigned MaxSelects = 64)
+      : FunctionPass(ID), m_MaxElements(MaxElements),
+        m_MaxSelects(MaxSelects) {}
+
+  const char *getPassName() const override {
+    return "DXIL eliminate local array dynamic indexing";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "MaxElements", &m_MaxElements, m_MaxElements);
+    GetPassOptionUnsigned(O, "MaxSelects", &m_MaxSelects, m_MaxSelects);
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",MaxElements=" << m_MaxElements;
+    OS << ",MaxSelects=" << m_MaxSelects;
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnFunction(Function &F) override {
+    std::vector<AllocaInst *> Candidates;
+    for (Instruction &I : F.getEntryBlock()) {
+      if (AllocaInst *AI = dyn_cast<AllocaInst>(&I))
+        Candidates.emplace_back(AI);
+    }
+
+    std::vector<AllocaInst *> ElementAllocas;
+    for (AllocaInst *AI : Candidates) {
+      LocalArrayAccesses Accesses;
+      if (!CollectAccesses(AI, Accesses) || !Accesses.FirstDynamic)
+        continue;
+
+      unsigned NumElements = AI->getAllocatedType()->getArrayNumElements();
+      unsigned Selects = Accesses.DynamicLoads * (NumElements - 1) +
+                         Accesses.DynamicStores * NumElements;
+      if (NumElements > m_MaxElements) {
+        Report(AI, Accesses, Twine("kept in memory; ") + Twine(NumElements) +
+                                 " elements exceed the limit of " +
+                                 Twine(m_MaxElements) + ".");
+        continue;
+      }
+      if (Selects > m_MaxSelects) {
+        Report(AI, Accesses, Twine("kept in memory; ") + Twine(Selects) +
+                                 " selects exceed the limit of " +
+                                 Twine(m_MaxSelects) + ".");
+        continue;
+      }
+
+      Report(AI, Accesses, Twine("promoted to registers with ") +
+                               Twine(Selects) + " selects.");
+      SplitArray(AI, Accesses, ElementAllocas);
+    }
+
+    if (ElementAllocas.empty())
+      return false;
+
+    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    AssumptionCache &AC =
+        getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+    PromoteMemToReg(ElementAllocas, DT, nullptr, &AC);
+    return true;
+  }
+
+private:
+  bool CollectAccesses(AllocaInst *AI, LocalArrayAccesses &Accesses);
+  void SplitArray(AllocaInst *AI, LocalArrayAccesses &Accesses,
+                  std::vector<AllocaInst *> &ElementAllocas);
+  void Report(AllocaInst *AI, LocalArrayAccesses &Accesses, const Twine &Msg);
+};
+
+char DxilEliminateLocalDynamicIndexing::ID = 0;
+
+// Accepts one-dimensional arrays of scalars or vectors that are only
+// accessed by loads and stores through element GEPs.
+bool DxilEliminateLocalDynamicIndexing::CollectAccesses(
+    AllocaInst *AI, LocalArrayAccesses &Accesses) {
+  ArrayType *AT = dyn_cast<ArrayType>(AI->getAllocatedType());
+  if (!AT || AI->isArrayAllocation() || AT->getNumElements() == 0)
+    return false;
+  Type *EltTy = AT->getElementType();
+  if (!EltTy->isSingleValueType() || EltTy->isPointerTy())
+    return false;
+
+  for (User *U : AI->users()) {
+    GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(U);
+    if (!GEP || GEP->getNumIndices() != 2)
+      return false;
+    ConstantInt *Zero = dyn_cast<ConstantInt>(GEP->getOperand(1));
+    if (!Zero || !Zero->isZero())
+      return false;
+    Value *Index = GEP->getOperand(2);
+    ConstantInt *ConstIndex = dyn_cast<ConstantInt>(Index);
+    if (ConstIndex && ConstIndex->getLimitedValue() >= AT->getNumElements())
+      return false;
+
+    for (User *GEPUser : GEP->users()) {
+      if (LoadInst *LI = dyn_cast<LoadInst>(GEPUser)) {
+        if (LI->isVolatile())
+          return false;
+        if (!ConstIndex)
+          ++Accesses.DynamicLoads;
+      } else if (StoreInst *SI = dyn_cast<StoreInst>(GEPUser)) {
+        if (SI->isVolatile() || SI->getValueOperand() == GEP)
+          return false;
+        if (!ConstIndex)
+          ++Accesses.DynamicStores;
+        if (!ConstIndex || !isa<Constant>(SI->getValueOperand()))
+          Accesses.bAllStoresConstant = false;
+      } else {
+        return false;
+      }
+      if (!ConstIndex && !Accesses.FirstDynamic)
+        Accesses.FirstDynamic = cast<Instruction>(GEPUser);
+    }
+    Accesses.GEPs.emplace_back(GEP);
+  }
+  // Arrays of constants are left for HoistConstantArray to turn into
+  // immediate constant buffers.
+  return !Accesses.bAllStoresConstant;
+}
+
+void DxilEliminateLocalDynamicIndexing::SplitArray(
+    AllocaInst *AI, LocalArrayAccesses &Accesses,
+    std::vector<AllocaInst *> &ElementAllocas) {
+  ArrayType *AT = cast<ArrayType>(AI->getAllocatedType());
+  unsigned NumElements = AT->getNumElements();
+
+  IRBuilder<> AllocaBuilder(AI);
+  std::vector<AllocaInst *> Elts(NumElements);
+  for (unsigned i = 0; i < NumElements; i++) {
+    Elts[i] = AllocaBuilder.CreateAlloca(AT->getElementType(), nullptr,
+                                         AI->getName() + "." + Twine(i));
+    ElementAllocas.emplace_back(Elts[i]);
+  }
+
+  for (GetElementPtrInst *GEP : Accesses.GEPs) {
+    Value *Index = GEP->getOperand(2);
+    if (ConstantInt *ConstIndex = dyn_cast<ConstantInt>(Index)) {
+      GEP->replaceAllUsesWith(Elts[ConstIndex->getLimitedValue()]);
+      GEP->eraseFromParent();
+      continue;
+    }
+
+    for (auto it = GEP->user_begin(); it != GEP->user_end();) {
+      Instruction *I = cast<Instruction>(*(it++));
+      IRBuilder<> Builder(I);
+      if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+        Value *Result = Builder.CreateLoad(Elts[0]);
+        for (unsigned i = 1; i < NumElements; i++) {
+          Value *Elt = Builder.CreateLoad(Elts[i]);
+          Value *IsElt =
+              Builder.CreateICmpEQ(Index, ConstantInt::get(Index->getType(), i));
+          Result = Builder.CreateSelect(IsElt, Elt, Result);
+        }
+        LI->replaceAllUsesWith(Result);
+      } else {
+        StoreInst *SI = cast<StoreInst>(I);
+        Value *Val = SI->getValueOperand();
+        for (unsigned i = 0; i < NumElements; i++) {
+          Value *Elt = Builder.CreateLoad(Elts[i]);
+          Value *IsElt =
+              Builder.CreateICmpEQ(Index, ConstantInt::get(Index->getType(), i));
+          Builder.CreateStore(Builder.CreateSelect(IsElt, Val, Elt), Elts[i]);
+        }
+      }
+      I->eraseFromParent();
+    }
+    GEP->eraseFromParent();
+  }
+  AI->eraseFromParent();
+}
+
+void DxilEliminateLocalDynamicIndexing::Report(AllocaInst *AI,
+                                               LocalArrayAccesses &Accesses,
+                                               const Twine &Msg) {
+  if (!m_Report)
+    return;
+  std::string Name = AI->hasName() ? ("'" + AI->getName() + "' ").str() : "";
+  std::string FullMsg =
+      (Twine("dynamically indexed local array ") + Name + Msg).str();
+  LLVMContext &Ctx = AI->getContext();
+  if (DebugLoc DL = Accesses.FirstDynamic->getDebugLoc())
+    Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, FullMsg));
+  else
+    Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(FullMsg));
+}
+
+}
+
+FunctionPass *llvm::createDxilEliminateLocalDynamicIndexingPass() {
+  return new DxilEliminateLocalDynamicIndexing();
+}
+
+INITIALIZE_PASS_BEGIN(DxilEliminateLocalDynamicIndexing,
+                      "hlsl-dxil-eliminate-local-dynamic",
+                      "DXIL eliminate local array dynamic indexing", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(AssumptionCacheTracker)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(DxilEliminateLocalDynamicIndexing,
+                    "hlsl-dxil-eliminate-local-dynamic",
+                    "DXIL eliminate local array dynamic indexing", false,
+                    false)
@@ -37,6 +37,10 @@ public:
     return "DXIL eliminate output dynamic indexing";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &DM = M.GetOrCreateDxilModule();
     bool bUpdated = false;
@@ -0,0 +1,348 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilEliminateRedundantBarriers.cpp                                        //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Removes barriers, or the fences of barriers, that order no memory access  //
+// an earlier barrier doesn't already order.                                 //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilFunctionProps.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// A fence orders the accesses of a thread before it with those after it, and
+// with a group sync, those of every thread in the group. When a barrier B
+// follows an earlier barrier on every path, with a fence of the same kind, at
+// least the same scope and a sync if B has one, and no access of that kind
+// happens in between, the earlier barrier already orders everything that B's
+// fence would. B then loses that fence, and is removed when it has none
+// left.
+//
+// Groupshared and UAV fences are tracked apart. A groupshared access is a
+// load, store or atomic through an address space 3 pointer. DXIL operations
+// that may touch memory, other than cbuffer loads, count as UAV accesses,
+// and calls of other functions as both. A compute shader starts as if after
+// a barrier with every fence and a sync, since nothing precedes it; other
+// functions start with nothing ordered.
+//
+// With Report, each removed barrier or fence gets a warning.
+
+namespace {
+
+// What every path has ordered since the last access of one kind: the widest
+// fence scope, 0 when none, and whether it synced the group.
+struct FenceState {
+  unsigned Scope;
+  bool bSync;
+
+  FenceState(unsigned Scope = 0, bool bSync = false)
+      : Scope(Scope), bSync(bSync) {}
+
+  bool Covers(const FenceState &O) const {
+    return Scope >= O.Scope && (bSync || !O.bSync);
+  }
+  bool operator!=(const FenceState &O) const {
+    return Scope != O.Scope || bSync != O.bSync;
+  }
+  void Meet(const FenceState &O) {
+    Scope = std::min(Scope, O.Scope);
+    bSync = Scope != 0 && bSync && O.bSync;
+  }
+};
+
+enum FenceKind { kGroupShared, kUAV, kNumFenceKinds };
+
+struct BarrierState {
+  FenceState Fences[kNumFenceKinds];
+
+  bool operator!=(const BarrierState &O) const {
+    return Fences[kGroupShared] != O.Fences[kGroupShared] ||
+           Fences[kUAV] != O.Fences[kUAV];
+  }
+  void Meet(const BarrierState &O) {
+    for (unsigned K = 0; K < kNumFenceKinds; ++K)
+      Fences[K].Meet(O.Fences[K]);
+  }
+  static BarrierState Full() {
+    BarrierState S;
+    S.Fences[kGroupShared] = FenceState(1, true);
+    S.Fences[kUAV] = FenceState(2, true);
+    return S;
+  }
+};
+
+class DxilEliminateRedundantBarriers : public ModulePass {
+  bool m_Report;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilEliminateRedundantBarriers(bool Report = false)
+      : ModulePass(ID), m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL eliminate redundant barriers";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  // A barrier, and the mode it can be reduced to.
+  struct Reduction {
+    CallInst *Barrier;
+    unsigned NewMode;
+  };
+
+  static void GetFences(unsigned Mode, FenceState Fences[]);
+  static bool GetBarrierFences(CallInst *CI, FenceState Fences[]);
+  static unsigned GetMode(const FenceState Fences[]);
+  static void Transfer(Instruction *I, BarrierState &State,
+                       SmallVectorImpl<Reduction> *pReductions);
+  bool RunOnFunction(Function &F, bool bStartsFenced);
+  void Report(CallInst *Barrier, unsigned NewMode);
+};
+
+void DxilEliminateRedundantBarriers::GetFences(unsigned M,
+                                               FenceState Fences[]) {
+  bool bSync = M & (unsigned)DXIL::BarrierMode::SyncThreadGroup;
+  Fences[kGroupShared].Scope =
+      (M & (unsigned)DXIL::BarrierMode::TGSMFence) ? 1 : 0;
+  Fences[kUAV].Scope =
+      (M & (unsigned)DXIL::BarrierMode::UAVFenceGlobal)        ? 2
+      : (M & (unsigned)DXIL::BarrierMode::UAVFenceThreadGroup) ? 1
+                                                               : 0;
+  for (unsigned K = 0; K < kNumFenceKinds; ++K)
+    Fences[K].bSync = bSync && Fences[K].Scope != 0;
+}
+
+// Gets the fences of a barrier. Returns false if it isn't a barrier with a
+// known mode.
+bool DxilEliminateRedundantBarriers::GetBarrierFences(CallInst *CI,
+                                                      FenceState Fences[]) {
+  DxilInst_Barrier Barrier(CI);
+  if (!Barrier)
+    return false;
+  ConstantInt *Mode = dyn_cast<ConstantInt>(Barrier.get_barrierMode());
+  if (!Mode)
+    return false;
+  GetFences(Mode->getZExtValue(), Fences);
+  return true;
+}
+
+unsigned DxilEliminateRedundantBarriers::GetMode(const FenceState Fences[]) {
+  unsigned M = 0;
+  if (Fences[kGroupShared].Scope)
+    M |= (unsigned)DXIL::BarrierMode::TGSMFence;
+  if (Fences[kUAV].Scope == 2)
+    M |= (unsigned)DXIL::BarrierMode::UAVFenceGlobal;
+  else if (Fences[kUAV].Scope == 1)
+    M |= (unsigned)DXIL::BarrierMode::UAVFenceThreadGroup;
+  if (Fences[kGroupShared].bSync || Fences[kUAV].bSync)
+    M |= (unsigned)DXIL::BarrierMode::SyncThreadGroup;
+  return M;
+}
+
+// Steps State over I. When pReductions is set, the barriers that can lose
+// fences are added to it.
+void DxilEliminateRedundantBarriers::Transfer(
+    Instruction *I, BarrierState &State,
+    SmallVectorImpl<Reduction> *pReductions) {
+  Value *Ptr = nullptr;
+  if (LoadInst *LI = dyn_cast<LoadInst>(I))
+    Ptr = LI->getPointerOperand();
+  else if (StoreInst *SI = dyn_cast<StoreInst>(I))
+    Ptr = SI->getPointerOperand();
+  else if (AtomicRMWInst *RMW = dyn_cast<AtomicRMWInst>(I))
+    Ptr = RMW->getPointerOperand();
+  else if (AtomicCmpXchgInst *CX = dyn_cast<AtomicCmpXchgInst>(I))
+    Ptr = CX->getPointerOperand();
+  if (Ptr) {
+    unsigned AddrSpace = Ptr->getType()->getPointerAddressSpace();
+    if (AddrSpace == DXIL::kTGSMAddrSpace)
+      State.Fences[kGroupShared] = FenceState();
+    else if (AddrSpace == DXIL::kDeviceMemoryAddrSpace)
+      State.Fences[kUAV] = FenceState();
+    return;
+  }
+
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI || isa<DbgInfoIntrinsic>(CI))
+    return;
+  Function *Callee = CI->getCalledFunction();
+  if (!Callee || !OP::IsDxilOpFunc(Callee)) {
+    if (Callee && Callee->isIntrinsic() && Callee->doesNotAccessMemory())
+      return;
+    State = BarrierState();
+    return;
+  }
+
+  FenceState Fences[kNumFenceKinds];
+  if (GetBarrierFences(CI, Fences)) {
+    FenceState Kept[kNumFenceKinds];
+    for (unsigned K = 0; K < kNumFenceKinds; ++K) {
+      // Right after the barrier, its own fences hold.
+      if (Fences[K].Scope != 0 && !State.Fences[K].Covers(Fences[K])) {
+        Kept[K] = Fences[K];
+        State.Fences[K] = Fences[K];
+      }
+    }
+    unsigned Mode = GetMode(Kept);
+    if (pReductions && Mode != GetMode(Fences))
+      pReductions->push_back({CI, Mode});
+    return;
+  }
+  if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::Barrier)) {
+    State = BarrierState();
+    return;
+  }
+  if (Callee->doesNotAccessMemory() ||
+      OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CBufferLoad) ||
+      OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CBufferLoadLegacy))
+    return;
+  State.Fences[kUAV] = FenceState();
+}
+
+void DxilEliminateRedundantBarriers::Report(CallInst *Barrier,
+                                            unsigned NewMode) {
+  std::string Msg;
+  raw_string_ostream OS(Msg);
+  if (NewMode == 0) {
+    OS << "removed a barrier";
+  } else {
+    FenceState Old[kNumFenceKinds], New[kNumFenceKinds];
+    GetBarrierFences(Barrier, Old);
+    GetFences(NewMode, New);
+    OS << "removed the";
+    const char *Sep = " ";
+    for (unsigned K = 0; K < kNumFenceKinds; ++K) {
+      if (Old[K].Scope == New[K].Scope)
+        continue;
+      OS << Sep << (K == kGroupShared ? "groupshared" : "UAV");
+      Sep = " and ";
+    }
+    OS << " fence of a barrier";
+  }
+  OS << "; an earlier barrier already orders every access since";
+  LLVMContext &Ctx = Barrier->getContext();
+  if (DebugLoc DL = Barrier->getDebugLoc())
+    Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, OS.str()));
+  else
+    Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(OS.str()));
+}
+
+bool DxilEliminateRedundantBarriers::RunOnFunction(Function &F,
+                                                   bool bStartsFenced) {
+  // A forward must analysis, so blocks start with everything ordered and
+  // only lose it.
+  DenseMap<BasicBlock *, BarrierState> Out;
+  for (BasicBlock &BB : F)
+    Out[&BB] = BarrierState::Full();
+
+  auto GetIn = [&](BasicBlock *BB) {
+    if (BB == &F.getEntryBlock())
+      return bStartsFenced ? BarrierState::Full() : BarrierState();
+    BarrierState In = BarrierState::Full();
+    for (BasicBlock *Pred : predecessors(BB))
+      In.Meet(Out[Pred]);
+    return In;
+  };
+
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  bool bIterate = true;
+  while (bIterate) {
+    bIterate = false;
+    for (BasicBlock *BB : RPOT) {
+      BarrierState State = GetIn(BB);
+      for (Instruction &I : *BB)
+        Transfer(&I, State, nullptr);
+      if (State != Out[BB]) {
+        Out[BB] = State;
+        bIterate = true;
+      }
+    }
+  }
+
+  SmallVector<Reduction, 4> Reductions;
+  for (BasicBlock *BB : RPOT) {
+    BarrierState State = GetIn(BB);
+    for (Instruction &I : *BB)
+      Transfer(&I, State, &Reductions);
+  }
+  for (Reduction &R : Reductions) {
+    if (m_Report)
+      Report(R.Barrier, R.NewMode);
+    if (R.NewMode == 0)
+      R.Barrier->eraseFromParent();
+    else
+      DxilInst_Barrier(R.Barrier).set_barrierMode_val(R.NewMode);
+  }
+  return !Reductions.empty();
+}
+
+bool DxilEliminateRedundantBarriers::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  SetVector<Function *> Functions;
+  for (Function &F : M.functions()) {
+    if (!OP::IsDxilOpFunc(&F))
+      continue;
+    for (User *U : F.users()) {
+      Instruction *I = cast<Instruction>(U);
+      if (OP::IsDxilOpFuncCallInst(I, DXIL::OpCode::Barrier))
+        Functions.insert(I->getParent()->getParent());
+    }
+  }
+
+  bool bChanged = false;
+  for (Function *F : Functions) {
+    bool bIsCS = DM.HasDxilFunctionProps(F) &&
+                 DM.GetDxilFunctionProps(F).IsCS();
+    bChanged |= RunOnFunction(*F, bIsCS);
+  }
+  return bChanged;
+}
+
+}
+
+char DxilEliminateRedundantBarriers::ID = 0;
+
+ModulePass *llvm::createDxilEliminateRedundantBarriersPass(bool Report) {
+  return new DxilEliminateRedundantBarriers(Report);
+}
+
+INITIALIZE_PASS(DxilEliminateRedundantBarriers,
+                "dxil-eliminate-redundant-barriers",
+                "DXIL eliminate redundant barriers", false, false)
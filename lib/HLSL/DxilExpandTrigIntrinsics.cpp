@@ -38,6 +38,26 @@
 // The approximation functions mostly come from [ADC]. The approximations
 // are also referenced in [HMF], but they give original credit to [ADC].
 // 
+// Fast approximations
+// ---------------------------------------------------------------------------
+// With the Fast option, calls that are not precise use lower degree
+// polynomials for asin, acos and atan, and a single exponential for tanh.
+// Their coefficients are minimax fits to the absolute error on the reduced
+// range, and the bounds given with each expansion were measured against the
+// double precision library functions. The bounds are absolute rather than in
+// ulps, because like the full expansions these lose relative accuracy near
+// the zeros of asin and atan. Precise calls always use the full expansion.
+//
+// Sharing
+// ---------------------------------------------------------------------------
+// tan(x) expands to sin(x) / cos(x), and rotations take the sin and cos of
+// the same angle, so the same Sin or Cos often ends up computed twice. This
+// pass runs after GVN, so calls of an operation on the same value, with the
+// same precision, are shared with one that dominates them: before expanding,
+// so each is expanded once, and after, for the Sin and Cos that tan adds.
+// The Sin and Cos of one value in a block are then placed next to each
+// other, where drivers with a combined sincos reduce the range once for both.
+// 
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/HLSL/DxilGenerationPass.h"
@@ -49,11 +69,16 @@
 
 #include "llvm/IR/Module.h"
 #include "llvm/Pass.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <cmath>
+#include <map>
+#include <tuple>
 #include <utility>
 
 using namespace llvm;
@@ -62,25 +87,46 @@ using namespace hlsl;
 namespace {
 class DxilExpandTrigIntrinsics : public FunctionPass {
 private:
+  bool m_Fast;
 
 public:
   static char ID; // Pass identification, replacement for typeid
-  explicit DxilExpandTrigIntrinsics() : FunctionPass(ID) {}
+  explicit DxilExpandTrigIntrinsics(bool Fast = false)
+      : FunctionPass(ID), m_Fast(Fast) {}
 
   const char *getPassName() const override {
     return "DXIL expand trig intrinsics";
   }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Fast", &m_Fast, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",Fast=" << m_Fast;
+  }
   
   bool runOnFunction(Function &F) override;
   
 
 private:
   typedef std::vector<CallInst *> IntrinsicList;
+  // Calls of an operation on a value, with a precision.
+  typedef std::tuple<unsigned, Value *, bool> TrigCallKey;
+  typedef std::map<TrigCallKey, SmallVector<CallInst *, 2>> TrigCallMap;
+  bool shareTrigCalls(Function &F, DxilModule &DM, DominatorTree &DT);
+  static bool pairSinCos(TrigCallMap &calls);
   IntrinsicList findTrigFunctionsToExpand(Function &F);
   CallInst *isExpandableTrigIntrinsicCall(Instruction *I);
   bool expandTrigIntrinsics(DxilModule &DM, const IntrinsicList &worklist);
   FastMathFlags getFastMathFlagsForIntrinsic(CallInst *intrinsic);
   void prepareBuilderToExpandIntrinsic(IRBuilder<> &builder, CallInst *intrinsic);
+  bool useFastExpansion(IRBuilder<> &builder);
 
   // Expansion implementations.
   Value *expandACos(IRBuilder<> &builder, DxilInst_Acos acos, DxilModule &DM);
@@ -106,8 +152,102 @@ namespace math {
 
 bool DxilExpandTrigIntrinsics::runOnFunction(Function &F) {
   DxilModule &DM = F.getParent()->GetOrCreateDxilModule(); 
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  bool changed = shareTrigCalls(F, DM, DT);
   IntrinsicList intrinsics = findTrigFunctionsToExpand(F);
-  const bool changed = expandTrigIntrinsics(DM, intrinsics);
+  changed |= expandTrigIntrinsics(DM, intrinsics);
+  if (!intrinsics.empty())
+    changed |= shareTrigCalls(F, DM, DT);
+  return changed;
+}
+
+static bool isSharedTrigOpCode(OP::OpCode opcode) {
+  switch (opcode) {
+  case OP::OpCode::Cos:
+  case OP::OpCode::Sin:
+  case OP::OpCode::Tan:
+  case OP::OpCode::Acos:
+  case OP::OpCode::Asin:
+  case OP::OpCode::Atan:
+  case OP::OpCode::Hcos:
+  case OP::OpCode::Hsin:
+  case OP::OpCode::Htan:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Replaces each trig call with an earlier one of the same operation, value
+// and precision that dominates it, then pairs the Sin and Cos that remain.
+bool DxilExpandTrigIntrinsics::shareTrigCalls(Function &F, DxilModule &DM,
+                                              DominatorTree &DT) {
+  TrigCallMap calls;
+  std::vector<CallInst *> shared;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    if (!OP::IsDxilOpFuncCallInst(&*I))
+      continue;
+    OP::OpCode opcode = OP::GetDxilOpFuncCallInst(&*I);
+    if (!isSharedTrigOpCode(opcode))
+      continue;
+    CallInst *call = cast<CallInst>(&*I);
+    Value *X = call->getArgOperand(DXIL::OperandIndex::kUnarySrc0OpIdx);
+    SmallVector<CallInst *, 2> &kept =
+        calls[TrigCallKey((unsigned)opcode, X, DM.IsPrecise(call))];
+    CallInst *dominating = nullptr;
+    for (CallInst *prev : kept) {
+      if (DT.dominates(prev, call)) {
+        dominating = prev;
+        break;
+      }
+    }
+    if (dominating) {
+      call->replaceAllUsesWith(dominating);
+      shared.push_back(call);
+    } else {
+      kept.push_back(call);
+    }
+  }
+  for (CallInst *call : shared)
+    call->eraseFromParent();
+  bool paired = pairSinCos(calls);
+  return paired || !shared.empty();
+}
+
+// Moves the later of the Sin and Cos of a value in a block right after the
+// earlier. Both calls read the value, and neither touches memory, so the
+// move is always safe.
+bool DxilExpandTrigIntrinsics::pairSinCos(TrigCallMap &calls) {
+  bool changed = false;
+  for (auto &it : calls) {
+    if (std::get<0>(it.first) != (unsigned)OP::OpCode::Sin)
+      continue;
+    auto cosIt = calls.find(TrigCallKey((unsigned)OP::OpCode::Cos,
+                                        std::get<1>(it.first),
+                                        std::get<2>(it.first)));
+    if (cosIt == calls.end())
+      continue;
+    for (CallInst *sin : it.second) {
+      for (CallInst *cos : cosIt->second) {
+        if (sin->getParent() != cos->getParent())
+          continue;
+        if (sin->getNextNode() == cos || cos->getNextNode() == sin)
+          break;
+        // Find which comes first.
+        Instruction *first = nullptr;
+        for (Instruction &I : *sin->getParent()) {
+          if (&I == sin || &I == cos) {
+            first = &I;
+            break;
+          }
+        }
+        Instruction *second = first == sin ? cos : sin;
+        second->moveBefore(first->getNextNode());
+        changed = true;
+        break;
+      }
+    }
+  }
   return changed;
 }
 
@@ -141,6 +281,10 @@ static bool isPreciseBuilder(IRBuilder<> &builder) {
   return !builder.getFastMathFlags().any();
 }
 
+bool DxilExpandTrigIntrinsics::useFastExpansion(IRBuilder<> &builder) {
+  return m_Fast && !isPreciseBuilder(builder);
+}
+
 static void setPreciseBuilder(IRBuilder<> &builder, bool precise) {
   FastMathFlags flags;
   if (precise)
@@ -220,25 +364,42 @@ static Value *emitSqrt(IRBuilder<> &builder, Value *X, OP *dxOp, StringRef name)
 //         = a0 + x(a1 + a2x + a3x^2)
 //         = a0 + x(a1 + x(a2 + a3x))
 //
-static Value *emitSqrt1mXtimesPsiX(IRBuilder<> &builder, Value *X, OP *dxOp, StringRef name) {
+// The fast approximation is a quadratic with its own coefficients
+//
+// psi*(X) = b0 + b1x + b2x^2
+//         = b0 + x(b1 + b2x)
+//
+static Value *emitSqrt1mXtimesPsiX(IRBuilder<> &builder, Value *X, OP *dxOp, bool fast, StringRef name) {
   Value *One = ConstantFP::get(X->getType(), 1.0);
-  Value *a0 = ConstantFP::get(X->getType(),  1.5707288);
-  Value *a1 = ConstantFP::get(X->getType(), -0.2121144);
-  Value *a2 = ConstantFP::get(X->getType(),  0.0742610);
-  Value *a3 = ConstantFP::get(X->getType(), -0.0187293);
-
 
   // sqrt(1-x)
   Value *r1 = builder.CreateFSub(One, X, name);
   Value *r2 = emitSqrt(builder, r1, dxOp, name);
 
   // psi*(x)
-  Value *r3 = builder.CreateFMul(X,  a3, name);
-         r3 = builder.CreateFAdd(r3, a2, name);
-         r3 = builder.CreateFMul(X,  r3, name);
-         r3 = builder.CreateFAdd(r3, a1, name);
-         r3 = builder.CreateFMul(X,  r3, name);
-         r3 = builder.CreateFAdd(r3, a0, name);
+  Value *r3;
+  if (fast) {
+    Value *b0 = ConstantFP::get(X->getType(),  1.5704706);
+    Value *b1 = ConstantFP::get(X->getType(), -0.2054994);
+    Value *b2 = ConstantFP::get(X->getType(),  0.0513915);
+
+    r3 = builder.CreateFMul(X,  b2, name);
+    r3 = builder.CreateFAdd(r3, b1, name);
+    r3 = builder.CreateFMul(X,  r3, name);
+    r3 = builder.CreateFAdd(r3, b0, name);
+  } else {
+    Value *a0 = ConstantFP::get(X->getType(),  1.5707288);
+    Value *a1 = ConstantFP::get(X->getType(), -0.2121144);
+    Value *a2 = ConstantFP::get(X->getType(),  0.0742610);
+    Value *a3 = ConstantFP::get(X->getType(), -0.0187293);
+
+    r3 = builder.CreateFMul(X,  a3, name);
+    r3 = builder.CreateFAdd(r3, a2, name);
+    r3 = builder.CreateFMul(X,  r3, name);
+    r3 = builder.CreateFAdd(r3, a1, name);
+    r3 = builder.CreateFMul(X,  r3, name);
+    r3 = builder.CreateFAdd(r3, a0, name);
+  }
 
   // sqrt(1-x) * psi*(x)
   Value *r4 = builder.CreateFMul(r2, r3,  name);
@@ -294,6 +455,14 @@ static std::pair<Value *, Value *> emitExEmx(IRBuilder<> &builder, Value *X, OP
 //
 // In [HMF] the authors claim an error, e, of |e| <= 5e-5, but the error graph
 // in [ADC] looks like the error can be larger that that for some inputs.
+//
+// Fast approximation
+//    Psi*(X) = b0 + b1x + b2x^2
+//      b0 =  1.5704706
+//      b1 = -0.2054994
+//      b2 =  0.0513915
+//
+// The measured error is |e| <= 3.3e-4 for both asin and acos.
 // 
 Value *DxilExpandTrigIntrinsics::expandASin(IRBuilder<> &builder, DxilInst_Asin asin, DxilModule &DM) {
   assert(asin);
@@ -306,7 +475,8 @@ Value *DxilExpandTrigIntrinsics::expandASin(IRBuilder<> &builder, DxilInst_Asin
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
 
   // Approximation
-  Value *psiX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(), name);
+  Value *psiX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(),
+                                      useFastExpansion(builder), name);
   Value *asinX = builder.CreateFSub(PI_2, psiX, name);
   Value *asinmX = builder.CreateFSub(Zero, asinX, name);
 
@@ -350,7 +520,8 @@ Value *DxilExpandTrigIntrinsics::expandACos(IRBuilder<> &builder, DxilInst_Acos
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
 
   // Approximation
-  Value *acosX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(), name);
+  Value *acosX = emitSqrt1mXtimesPsiX(builder, absX, DM.GetOP(),
+                                      useFastExpansion(builder), name);
   Value *acosmX = builder.CreateFSub(PI, acosX, name);
 
   // Range expansion to [-1, 1]
@@ -400,6 +571,16 @@ Value *DxilExpandTrigIntrinsics::expandACos(IRBuilder<> &builder, DxilInst_Acos
 // To expand the range we check if x > 1 then subtracted the computed value from
 // pi/2 and if x is negative then negate the final value.
 //
+// The error of the approximation is |e| <= 1e-5 [HMF].
+//
+// Fast approximation
+//    arctan*(x) = d1x + d3x^3 + d5x^5
+//      d1 =  0.9953574
+//      d3 = -0.2886871
+//      d5 =  0.0793358
+//
+// The measured error is |e| <= 6.1e-4.
+//
 Value *DxilExpandTrigIntrinsics::expandATan(IRBuilder<> &builder, DxilInst_Atan atan, DxilModule &DM) {
   assert(atan);
   StringRef name  = "atan.x";
@@ -407,11 +588,6 @@ Value *DxilExpandTrigIntrinsics::expandATan(IRBuilder<> &builder, DxilInst_Atan
   Value *PI_2 = ConstantFP::get(X->getType(), math::PI_2);
   Value *One  = ConstantFP::get(X->getType(), 1.0);
   Value *Zero = ConstantFP::get(X->getType(), 0.0);
-  Value *c1 = ConstantFP::get(X->getType(),  0.9998660);
-  Value *c3 = ConstantFP::get(X->getType(), -0.3302995);
-  Value *c5 = ConstantFP::get(X->getType(),  0.1801410);
-  Value *c7 = ConstantFP::get(X->getType(), -0.0851330);
-  Value *c9 = ConstantFP::get(X->getType(),  0.0208351);
 
   // Range reduction to [0, inf]
   Value *absX = emitFAbs(builder, X, DM.GetOP(), name);
@@ -423,15 +599,34 @@ Value *DxilExpandTrigIntrinsics::expandATan(IRBuilder<> &builder, DxilInst_Atan
 
   // Approximate
   Value *r3 = builder.CreateFMul(r2, r2, name);
-  Value *r4 = builder.CreateFMul(r3, c9, name);
-         r4 = builder.CreateFAdd(r4, c7, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c5, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c3, name);
-         r4 = builder.CreateFMul(r4, r3, name);
-         r4 = builder.CreateFAdd(r4, c1, name);
-         r4 = builder.CreateFMul(r2, r4, name);
+  Value *r4;
+  if (useFastExpansion(builder)) {
+    Value *d1 = ConstantFP::get(X->getType(),  0.9953574);
+    Value *d3 = ConstantFP::get(X->getType(), -0.2886871);
+    Value *d5 = ConstantFP::get(X->getType(),  0.0793358);
+
+    r4 = builder.CreateFMul(r3, d5, name);
+    r4 = builder.CreateFAdd(r4, d3, name);
+    r4 = builder.CreateFMul(r4, r3, name);
+    r4 = builder.CreateFAdd(r4, d1, name);
+    r4 = builder.CreateFMul(r2, r4, name);
+  } else {
+    Value *c1 = ConstantFP::get(X->getType(),  0.9998660);
+    Value *c3 = ConstantFP::get(X->getType(), -0.3302995);
+    Value *c5 = ConstantFP::get(X->getType(),  0.1801410);
+    Value *c7 = ConstantFP::get(X->getType(), -0.0851330);
+    Value *c9 = ConstantFP::get(X->getType(),  0.0208351);
+
+    r4 = builder.CreateFMul(r3, c9, name);
+    r4 = builder.CreateFAdd(r4, c7, name);
+    r4 = builder.CreateFMul(r4, r3, name);
+    r4 = builder.CreateFAdd(r4, c5, name);
+    r4 = builder.CreateFMul(r4, r3, name);
+    r4 = builder.CreateFAdd(r4, c3, name);
+    r4 = builder.CreateFMul(r4, r3, name);
+    r4 = builder.CreateFAdd(r4, c1, name);
+    r4 = builder.CreateFMul(r2, r4, name);
+  }
 
   // Range Expansion to [0, inf]
   Value *r5 = builder.CreateFSub(PI_2, r4, name);
@@ -497,12 +692,32 @@ Value *DxilExpandTrigIntrinsics::expandHSin(IRBuilder<> &builder, DxilInst_Hsin
 //
 // No range reduction is needed.
 //
+// The fast expansion needs a single exponential
+//
+//    tanh(x) = 1 - 2 / (e^2x + 1)
+//
+// which gives 1 and -1 when e^2x overflows or underflows. The absolute error
+// is about 2^-23 plus the error of Exp, so small inputs lose relative accuracy.
+//
 Value *DxilExpandTrigIntrinsics::expandHTan(IRBuilder<> &builder, DxilInst_Htan htan, DxilModule &DM) {
   assert(htan);
   StringRef name = "htan.x";
   Value *eX, *emX;
   Value *X = htan.get_value();
 
+  if (useFastExpansion(builder)) {
+    Value *One = ConstantFP::get(X->getType(), 1.0);
+    Value *Two = ConstantFP::get(X->getType(), 2.0);
+    Value *Log2e2 = ConstantFP::get(X->getType(), 2.0 * math::LOG2E);
+
+    Value *r0 = builder.CreateFMul(X, Log2e2, name);
+    Value *r1 = emitUnaryFloat(builder, r0, DM.GetOP(), OP::OpCode::Exp, name);
+    Value *r2 = builder.CreateFAdd(r1, One, name);
+    Value *r3 = builder.CreateFDiv(Two, r2, name);
+    Value *r  = builder.CreateFSub(One, r3, name);
+    return r;
+  }
+
   std::tie(eX, emX) = emitExEmx(builder, X, DM.GetOP(), name);
   Value *r4 = builder.CreateFSub(eX, emX, name);
   Value *r5 = builder.CreateFAdd(eX, emX, name);
@@ -534,10 +749,14 @@ Value *DxilExpandTrigIntrinsics::expandTan(IRBuilder<> &builder,
 
 char DxilExpandTrigIntrinsics::ID = 0;
 
-FunctionPass *llvm::createDxilExpandTrigIntrinsicsPass() {
-  return new DxilExpandTrigIntrinsics();
+FunctionPass *llvm::createDxilExpandTrigIntrinsicsPass(bool Fast) {
+  return new DxilExpandTrigIntrinsics(Fast);
 }
 
-INITIALIZE_PASS(DxilExpandTrigIntrinsics,
-                "hlsl-dxil-expand-trig-intrinsics",
-                "DXIL expand trig intrinsics", false, false)
+INITIALIZE_PASS_BEGIN(DxilExpandTrigIntrinsics,
+                      "hlsl-dxil-expand-trig-intrinsics",
+                      "DXIL expand trig intrinsics", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(DxilExpandTrigIntrinsics,
+                    "hlsl-dxil-expand-trig-intrinsics",
+                    "DXIL expand trig intrinsics", false, false)
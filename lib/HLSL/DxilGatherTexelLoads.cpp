@@ -0,0 +1,380 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilGatherTexelLoads.cpp                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Combines loads of a 2x2 block of texels into one gather.                  //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DxilRootSignature/DxilRootSignature.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+
+#include <map>
+#include <memory>
+#include <tuple>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Filtering kernels load the texels around a location one by one, though a
+// gather returns one channel of a 2x2 block of them in one operation. Four
+// loads of the same channel of a Texture2D at mip 0, at (x, y), (x + 1, y),
+// (x, y + 1) and (x + 1, y + 1), are the gather at the corner the four
+// texels share, (x + 1, y + 1) / size, which is half a texel away from any
+// other block.
+//
+// A gather reads through a sampler, where loads don't, so one is only made
+// with a sampler of the shader that the root signature binds as a static
+// sampler with border addressing and a black border: out-of-bounds texels
+// then read as 0, as they do for loads. Without such a sampler, or without
+// a root signature, nothing changes.
+//
+// Point samples of neighboring texels are not combined: where a point
+// sample and a gather look depends on where within its texel the location
+// falls, so they only agree for some locations.
+
+namespace {
+
+DxilShaderVisibility GetShaderVisibility(DXIL::ShaderKind ShaderKind) {
+  switch (ShaderKind) {
+  case DXIL::ShaderKind::Pixel:    return DxilShaderVisibility::Pixel;
+  case DXIL::ShaderKind::Vertex:   return DxilShaderVisibility::Vertex;
+  case DXIL::ShaderKind::Geometry: return DxilShaderVisibility::Geometry;
+  case DXIL::ShaderKind::Hull:     return DxilShaderVisibility::Hull;
+  case DXIL::ShaderKind::Domain:   return DxilShaderVisibility::Domain;
+  default:                         return DxilShaderVisibility::All;
+  }
+}
+
+class DxilGatherTexelLoads : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilGatherTexelLoads() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL gather texel loads";
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // A load of one channel of a texel, at Base + Offset on each axis.
+  struct TexelLoad {
+    CallInst *CI;
+    GlobalVariable *Texture;
+    unsigned Channel;
+    Value *Base[2];
+    int64_t Offset[2];
+  };
+
+  static GlobalVariable *GetResourceSymbol(Value *Handle);
+  static void DecomposeCoord(Value *Coord, Value *ImmOffset, Value *&Base,
+                             int64_t &Offset);
+  static bool GetUsedChannel(CallInst *CI, unsigned &Channel);
+  static DxilSampler *FindBorderSampler(DxilModule &DM, unsigned Channel);
+  bool CollectLoad(DxilModule &DM, CallInst *CI, TexelLoad &Load);
+  void Combine(DxilModule &DM, Function &F, TexelLoad *Quad[4]);
+
+  DenseMap<DxilSampler *, Value *> m_SamplerHandles;
+};
+
+// Gets the global variable of a handle to a resource that isn't an array.
+GlobalVariable *DxilGatherTexelLoads::GetResourceSymbol(Value *Handle) {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::CreateHandleForLib))
+    return nullptr;
+  DxilInst_CreateHandleForLib CH(CI);
+  LoadInst *LI = dyn_cast<LoadInst>(CH.get_Resource());
+  if (!LI)
+    return nullptr;
+  return dyn_cast<GlobalVariable>(LI->getPointerOperand());
+}
+
+// Splits a coordinate into a value and a constant added to it, including the
+// immediate offset of the load.
+void DxilGatherTexelLoads::DecomposeCoord(Value *Coord, Value *ImmOffset,
+                                          Value *&Base, int64_t &Offset) {
+  Base = Coord;
+  Offset = 0;
+  if (ConstantInt *C = dyn_cast<ConstantInt>(Coord)) {
+    Base = nullptr;
+    Offset = C->getSExtValue();
+  } else if (BinaryOperator *BO = dyn_cast<BinaryOperator>(Coord)) {
+    ConstantInt *C = dyn_cast<ConstantInt>(BO->getOperand(1));
+    if (C && BO->getOpcode() == Instruction::Add) {
+      Base = BO->getOperand(0);
+      Offset = C->getSExtValue();
+    } else if (C && BO->getOpcode() == Instruction::Sub) {
+      Base = BO->getOperand(0);
+      Offset = -C->getSExtValue();
+    }
+  }
+  if (ConstantInt *C = dyn_cast<ConstantInt>(ImmOffset))
+    Offset += C->getSExtValue();
+}
+
+// Returns true if the result of CI is only used for one of its four
+// channels, and gets that channel.
+bool DxilGatherTexelLoads::GetUsedChannel(CallInst *CI, unsigned &Channel) {
+  bool bFound = false;
+  for (User *U : CI->users()) {
+    ExtractValueInst *EVI = dyn_cast<ExtractValueInst>(U);
+    if (!EVI || EVI->getNumIndices() != 1)
+      return false;
+    unsigned Idx = EVI->getIndices()[0];
+    if (Idx >= 4 || (bFound && Idx != Channel))
+      return false;
+    Channel = Idx;
+    bFound = true;
+  }
+  return bFound;
+}
+
+// Finds a sampler of the shader that the root signature binds as a static
+// sampler reading out-of-bounds texels as 0 in Channel.
+DxilSampler *DxilGatherTexelLoads::FindBorderSampler(DxilModule &DM,
+                                                     unsigned Channel) {
+  const std::vector<uint8_t> &Serialized = DM.GetSerializedRootSignature();
+  if (Serialized.empty())
+    return nullptr;
+  std::shared_ptr<const CachedRootSignature> pRS;
+  try {
+    pRS = GetCachedRootSignature(Serialized.data(), Serialized.size());
+  } catch (...) {
+    return nullptr;
+  }
+  const DxilVersionedRootSignatureDesc *pDesc = pRS->GetDesc();
+  uint32_t NumStaticSamplers = 0;
+  const DxilStaticSamplerDesc *pStaticSamplers = nullptr;
+  if (pDesc->Version == DxilRootSignatureVersion::Version_1_1) {
+    NumStaticSamplers = pDesc->Desc_1_1.NumStaticSamplers;
+    pStaticSamplers = pDesc->Desc_1_1.pStaticSamplers;
+  } else {
+    NumStaticSamplers = pDesc->Desc_1_0.NumStaticSamplers;
+    pStaticSamplers = pDesc->Desc_1_0.pStaticSamplers;
+  }
+  DxilShaderVisibility Visibility =
+      GetShaderVisibility(DM.GetShaderModel()->GetKind());
+
+  for (auto &S : DM.GetSamplers()) {
+    if (S->GetSamplerKind() != DXIL::SamplerKind::Default ||
+        !S->IsAllocated() || S->GetRangeSize() != 1 ||
+        !dyn_cast_or_null<GlobalVariable>(S->GetGlobalSymbol()))
+      continue;
+    for (uint32_t i = 0; i < NumStaticSamplers; ++i) {
+      const DxilStaticSamplerDesc &SS = pStaticSamplers[i];
+      if (SS.ShaderRegister != S->GetLowerBound() ||
+          SS.RegisterSpace != S->GetSpaceID() ||
+          (SS.ShaderVisibility != DxilShaderVisibility::All &&
+           SS.ShaderVisibility != Visibility))
+        continue;
+      // Comparison and min/max filters change what a gather returns.
+      bool bPlainFilter = ((unsigned)SS.Filter & 0x180) == 0;
+      bool bBlack = SS.BorderColor == DxilStaticBorderColor::TransparentBlack ||
+                    (SS.BorderColor == DxilStaticBorderColor::OpaqueBlack &&
+                     Channel < 3);
+      if (bPlainFilter && bBlack && SS.MinLOD <= 0.0f &&
+          SS.AddressU == DxilTextureAddressMode::Border &&
+          SS.AddressV == DxilTextureAddressMode::Border)
+        return S.get();
+    }
+  }
+  return nullptr;
+}
+
+// Returns true if CI loads one channel of a texel at mip 0 of a Texture2D.
+bool DxilGatherTexelLoads::CollectLoad(DxilModule &DM, CallInst *CI,
+                                       TexelLoad &Load) {
+  DxilInst_TextureLoad TL(CI);
+  if (!TL)
+    return false;
+  GlobalVariable *GV = GetResourceSymbol(TL.get_srv());
+  ConstantInt *Mip = dyn_cast<ConstantInt>(TL.get_mipLevelOrSampleCount());
+  if (!GV || !Mip || !Mip->isZero() || !GetUsedChannel(CI, Load.Channel))
+    return false;
+  bool bTexture2D = false;
+  for (auto &SRV : DM.GetSRVs()) {
+    if (SRV->GetGlobalSymbol() == GV) {
+      bTexture2D = SRV->GetKind() == DXIL::ResourceKind::Texture2D;
+      break;
+    }
+  }
+  if (!bTexture2D)
+    return false;
+  Load.CI = CI;
+  Load.Texture = GV;
+  DecomposeCoord(TL.get_coord0(), TL.get_offset0(), Load.Base[0],
+                 Load.Offset[0]);
+  DecomposeCoord(TL.get_coord1(), TL.get_offset1(), Load.Base[1],
+                 Load.Offset[1]);
+  return true;
+}
+
+// Replaces the channel of the four loads, top-left, top-right, bottom-left
+// and bottom-right, with the components of one gather.
+void DxilGatherTexelLoads::Combine(DxilModule &DM, Function &F,
+                                   TexelLoad *Quad[4]) {
+  OP *hlslOP = DM.GetOP();
+  LLVMContext &Ctx = F.getContext();
+  DxilSampler *Sampler = FindBorderSampler(DM, Quad[0]->Channel);
+  Value *&SamplerHandle = m_SamplerHandles[Sampler];
+  if (!SamplerHandle) {
+    GlobalVariable *GV = cast<GlobalVariable>(Sampler->GetGlobalSymbol());
+    IRBuilder<> Builder(dxilutil::FirstNonAllocaInsertionPt(&F));
+    Function *CreateHandle = hlslOP->GetOpFunc(
+        DXIL::OpCode::CreateHandleForLib, GV->getType()->getElementType());
+    SamplerHandle = Builder.CreateCall(
+        CreateHandle,
+        {hlslOP->GetU32Const((unsigned)DXIL::OpCode::CreateHandleForLib),
+         Builder.CreateLoad(GV)},
+        GV->getName());
+  }
+
+  // The first load in the block, where every base is available.
+  CallInst *First = Quad[0]->CI;
+  for (unsigned i = 1; i < 4; ++i) {
+    for (Instruction &I : *First->getParent()) {
+      if (&I == First)
+        break;
+      if (&I == Quad[i]->CI) {
+        First = Quad[i]->CI;
+        break;
+      }
+    }
+  }
+  IRBuilder<> Builder(First);
+  Value *Texture = DxilInst_TextureLoad(First).get_srv();
+  Function *GetDimensions =
+      hlslOP->GetOpFunc(DXIL::OpCode::GetDimensions, Type::getVoidTy(Ctx));
+  Value *Dims = Builder.CreateCall(
+      GetDimensions,
+      {hlslOP->GetU32Const((unsigned)DXIL::OpCode::GetDimensions), Texture,
+       hlslOP->GetU32Const(0)});
+  Value *Coords[2];
+  for (unsigned Axis = 0; Axis < 2; ++Axis) {
+    Value *Corner = hlslOP->GetI32Const((int)Quad[0]->Offset[Axis] + 1);
+    if (Value *Base = Quad[0]->Base[Axis])
+      Corner = Builder.CreateAdd(Base, Corner);
+    Value *Size = Builder.CreateExtractValue(Dims, Axis);
+    Coords[Axis] = Builder.CreateFDiv(
+        Builder.CreateSIToFP(Corner, Type::getFloatTy(Ctx)),
+        Builder.CreateUIToFP(Size, Type::getFloatTy(Ctx)));
+  }
+
+  Type *OverloadTy = First->getType()->getStructElementType(0);
+  Function *Gather =
+      hlslOP->GetOpFunc(DXIL::OpCode::TextureGather, OverloadTy);
+  Value *UndefF = UndefValue::get(Type::getFloatTy(Ctx));
+  Value *UndefI = UndefValue::get(Type::getInt32Ty(Ctx));
+  Value *GatherArgs[] = {
+      hlslOP->GetU32Const((unsigned)DXIL::OpCode::TextureGather), Texture,
+      SamplerHandle, Coords[0], Coords[1], UndefF, UndefF, UndefI, UndefI,
+      hlslOP->GetU32Const(Quad[0]->Channel)};
+  Value *Result = Builder.CreateCall(Gather, GatherArgs);
+
+  // Gather returns the lower left texel first, then counterclockwise.
+  static const unsigned kComponent[4] = {3, 2, 0, 1};
+  for (unsigned i = 0; i < 4; ++i) {
+    CallInst *CI = Quad[i]->CI;
+    Value *V = Builder.CreateExtractValue(Result, kComponent[i]);
+    for (auto It = CI->user_begin(); It != CI->user_end();) {
+      ExtractValueInst *EVI = cast<ExtractValueInst>(*(It++));
+      EVI->replaceAllUsesWith(V);
+      EVI->eraseFromParent();
+    }
+    CI->eraseFromParent();
+  }
+}
+
+bool DxilGatherTexelLoads::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule() || F.isDeclaration())
+    return false;
+  DxilModule &DM = M->GetDxilModule();
+  m_SamplerHandles.clear();
+
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    // Loads of the same texture, channel and bases, by their offsets.
+    typedef std::tuple<GlobalVariable *, unsigned, Type *, Value *, Value *>
+        GroupKey;
+    std::map<GroupKey, std::map<std::pair<int64_t, int64_t>, TexelLoad *>>
+        Groups;
+    SmallVector<std::unique_ptr<TexelLoad>, 16> Loads;
+    for (Instruction &I : BB) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (!CI)
+        continue;
+      std::unique_ptr<TexelLoad> Load(new TexelLoad());
+      if (!CollectLoad(DM, CI, *Load))
+        continue;
+      GroupKey Key(Load->Texture, Load->Channel, CI->getType(), Load->Base[0],
+                   Load->Base[1]);
+      // A second load of the same texel is left for GVN.
+      auto &Slot = Groups[Key][std::make_pair(Load->Offset[1],
+                                              Load->Offset[0])];
+      if (!Slot) {
+        Slot = Load.get();
+        Loads.push_back(std::move(Load));
+      }
+    }
+
+    for (auto &Group : Groups) {
+      auto &ByOffset = Group.second;
+      if (ByOffset.size() < 4 ||
+          !FindBorderSampler(DM, std::get<1>(Group.first)))
+        continue;
+      // Row by row, so each load joins the first block it is the top left
+      // corner of.
+      for (auto &It : ByOffset) {
+        if (!It.second)
+          continue;
+        int64_t Y = It.first.first, X = It.first.second;
+        std::pair<int64_t, int64_t> Corners[4] = {
+            {Y, X}, {Y, X + 1}, {Y + 1, X}, {Y + 1, X + 1}};
+        TexelLoad *Quad[4];
+        bool bComplete = true;
+        for (unsigned i = 0; i < 4 && bComplete; ++i) {
+          auto Found = ByOffset.find(Corners[i]);
+          bComplete = Found != ByOffset.end() && Found->second;
+          if (bComplete)
+            Quad[i] = Found->second;
+        }
+        if (!bComplete)
+          continue;
+        Combine(DM, F, Quad);
+        for (auto &Corner : Corners)
+          ByOffset[Corner] = nullptr;
+        bChanged = true;
+      }
+    }
+  }
+  return bChanged;
+}
+
+}
+
+char DxilGatherTexelLoads::ID = 0;
+
+FunctionPass *llvm::createDxilGatherTexelLoadsPass() {
+  return new DxilGatherTexelLoads();
+}
+
+INITIALIZE_PASS(DxilGatherTexelLoads, "dxil-gather-texel-loads",
+                "DXIL gather texel loads", false, false)
@@ -639,6 +639,10 @@ public:
 
   const char *getPassName() const override { return "HLSL High-Level Metadata Emit"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override {
     if (M.HasHLModule()) {
       HLModule::ClearHLMetadata(M);
@@ -669,6 +673,10 @@ public:
 
   const char *getPassName() const override { return "HLSL High-Level Metadata Ensure"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override {
     if (!M.HasHLModule()) {
       M.GetOrCreateHLModule();
@@ -699,6 +707,10 @@ public:
 
   const char *getPassName() const override { return "DXIL Precise Propagate"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     DxilModule &dxilModule = M.GetOrCreateDxilModule();
     DxilTypeSystem &typeSys = dxilModule.GetTypeSystem();
@@ -844,6 +856,10 @@ public:
 
   const char *getPassName() const override { return "Remove all unused function except entry from HLModule"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     if (M.HasHLModule()) {
       HLModule &HLM = M.GetHLModule();
@@ -891,6 +907,10 @@ public:
     return "DXIL Legalize Static Resource Use";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     // Promote static global variables.
     return PromoteStaticGlobalResources(M);
@@ -930,7 +950,7 @@ char DxilPromoteLocalResources::ID = 0;
 void DxilPromoteLocalResources::getAnalysisUsage(AnalysisUsage &AU) const {
   AU.addRequired<AssumptionCacheTracker>();
   AU.addRequired<DominatorTreeWrapperPass>();
-  AU.setPreservesAll();
+  AU.setPreservesCFG();
 }
 
 bool DxilPromoteLocalResources::PromoteLocalResource(Function &F) {
@@ -1078,6 +1098,10 @@ public:
     return "DXIL Legalize EvalOperations";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     for (Function &F : M.getFunctionList()) {
       hlsl::HLOpcodeGroup group = hlsl::GetHLOpcodeGroup(&F);
@@ -1252,6 +1276,11 @@ class DxilTranslateRawBuffer : public ModulePass {
 public:
   static char ID;
   explicit DxilTranslateRawBuffer() : ModulePass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) {
     unsigned major, minor;
     DxilModule &DM = M.GetDxilModule();
@@ -0,0 +1,514 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilGroupSharedBankConflicts.cpp                                          //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Find groupshared accesses that likely conflict in memory banks, and pad   //
+// the arrays they index.                                                    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <set>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Groupshared memory is split into Banks banks of BankWidth bytes, and the
+// lanes of a wave that touch different words of one bank are served one
+// after the other. The pass models the lanes that run together as threads
+// adjacent in the first dimension of the thread group that has more than one
+// thread, through SV_GroupThreadID, SV_DispatchThreadID or SV_GroupIndex.
+//
+// Each load, store or atomic on a groupshared array is written as a sum of
+// its indices, each scaled by the size of what it steps over. Where the
+// indices are linear in the thread ID, the byte distance between adjacent
+// lanes gives the number of distinct words that Banks lanes touch in the
+// busiest bank, which is the conflict degree. Accesses whose address isn't
+// linear in the thread ID are not analyzed.
+//
+// With Pad, an array that has a conflicting access gets its rows padded: one
+// inner dimension is lengthened by the fewest elements that minimize the
+// conflicts of all its accesses. This is done before multi-dimensional
+// arrays are flattened, and only when every use of the array is an indexed
+// access and the padded arrays still fit in groupshared memory. A padded
+// array loses its debug info, which describes the declared layout.
+
+namespace {
+
+// An index of an access: the array level it indexes, or -1 for the pointer
+// operand of the global, and its coefficient in the thread ID.
+struct IndexTerm {
+  int Level;
+  int64_t Coefficient;
+};
+
+struct GroupSharedAccess {
+  Instruction *I;
+  SmallVector<IndexTerm, 4> Terms;
+  bool bLinear; // Whether Terms give the address between lanes.
+};
+
+struct GroupSharedArray {
+  GlobalVariable *GV;
+  SmallVector<uint64_t, 4> Dims; // Lengths of the nested arrays.
+  Type *ElementTy;
+  std::vector<GroupSharedAccess> Accesses;
+  bool bPaddable = true;
+};
+
+class DxilGroupSharedBankConflicts : public ModulePass {
+  unsigned m_Banks;
+  unsigned m_BankWidth;
+  bool m_Pad;
+  bool m_Report;
+
+  const DataLayout *m_pDL = nullptr;
+  unsigned m_LaneComponent = 0;
+  DenseSet<Value *> m_LaneDependent;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilGroupSharedBankConflicts(bool Report = false, bool Pad = false)
+      : ModulePass(ID), m_Banks(32), m_BankWidth(4), m_Pad(Pad),
+        m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL groupshared bank conflicts";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "Banks", &m_Banks, 32);
+    GetPassOptionUnsigned(O, "BankWidth", &m_BankWidth, 4);
+    GetPassOptionBool(O, "Pad", &m_Pad, false);
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",Banks=" << m_Banks;
+    OS << ",BankWidth=" << m_BankWidth;
+    OS << ",Pad=" << m_Pad;
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool IsLaneID(Value *V, int64_t &Coefficient);
+  void FindLaneDependentValues(Module &M);
+  bool GetCoefficient(Value *V, int64_t &Coefficient, unsigned Depth);
+  void CollectAccesses(GroupSharedArray &A, Value *Ptr, int Level,
+                       SmallVectorImpl<IndexTerm> &Terms, bool bLinear);
+  int64_t GetLaneStride(const GroupSharedAccess &Access,
+                        ArrayRef<uint64_t> Dims, uint64_t ElementSize);
+  unsigned GetConflictDegree(int64_t Stride);
+  unsigned GetConflictDegree(const GroupSharedArray &A,
+                             ArrayRef<uint64_t> Dims);
+  bool Pad(GroupSharedArray &A, uint64_t &TGSMSize);
+  void Report(Instruction *I, const Twine &Msg);
+};
+
+bool DxilGroupSharedBankConflicts::IsLaneID(Value *V, int64_t &Coefficient) {
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (I == nullptr)
+    return false;
+  if (DxilInst_FlattenedThreadIdInGroup(I)) {
+    Coefficient = 1;
+    return true;
+  }
+  Value *Component = nullptr;
+  if (DxilInst_ThreadIdInGroup TID = DxilInst_ThreadIdInGroup(I))
+    Component = TID.get_component();
+  else if (DxilInst_ThreadId DTID = DxilInst_ThreadId(I))
+    Component = DTID.get_component();
+  else
+    return false;
+  ConstantInt *C = dyn_cast<ConstantInt>(Component);
+  Coefficient = C && C->getZExtValue() == m_LaneComponent ? 1 : 0;
+  return true;
+}
+
+// Finds the values that may differ between adjacent lanes: those computed
+// from the thread ID, from memory, or from what calls and function
+// parameters bring in.
+void DxilGroupSharedBankConflicts::FindLaneDependentValues(Module &M) {
+  m_LaneDependent.clear();
+  SmallVector<Value *, 32> Worklist;
+  for (Function &F : M.functions()) {
+    if (F.isDeclaration())
+      continue;
+    for (Argument &Arg : F.args())
+      Worklist.push_back(&Arg);
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        int64_t Coefficient;
+        if (IsLaneID(&I, Coefficient)) {
+          if (Coefficient != 0)
+            Worklist.push_back(&I);
+        } else if (isa<LoadInst>(I) || isa<AtomicRMWInst>(I) ||
+                   isa<AtomicCmpXchgInst>(I) ||
+                   (isa<CallInst>(I) && !OP::IsDxilOpFuncCallInst(&I))) {
+          Worklist.push_back(&I);
+        }
+      }
+    }
+  }
+  while (!Worklist.empty()) {
+    Value *V = Worklist.pop_back_val();
+    if (!m_LaneDependent.insert(V).second)
+      continue;
+    for (User *U : V->users())
+      if (isa<Instruction>(U))
+        Worklist.push_back(U);
+  }
+}
+
+// Gets how much V grows from one lane to the next, if V is linear in the
+// thread ID.
+bool DxilGroupSharedBankConflicts::GetCoefficient(Value *V,
+                                                  int64_t &Coefficient,
+                                                  unsigned Depth) {
+  if (!m_LaneDependent.count(V)) {
+    Coefficient = 0;
+    return true;
+  }
+  if (Depth > 8)
+    return false;
+  if (IsLaneID(V, Coefficient))
+    return true;
+  if (CastInst *CI = dyn_cast<CastInst>(V)) {
+    if (isa<ZExtInst>(CI) || isa<SExtInst>(CI) || isa<TruncInst>(CI))
+      return GetCoefficient(CI->getOperand(0), Coefficient, Depth + 1);
+    return false;
+  }
+  BinaryOperator *BO = dyn_cast<BinaryOperator>(V);
+  if (BO == nullptr)
+    return false;
+  int64_t L, R;
+  if (!GetCoefficient(BO->getOperand(0), L, Depth + 1) ||
+      !GetCoefficient(BO->getOperand(1), R, Depth + 1))
+    return false;
+  ConstantInt *CL = dyn_cast<ConstantInt>(BO->getOperand(0));
+  ConstantInt *CR = dyn_cast<ConstantInt>(BO->getOperand(1));
+  switch (BO->getOpcode()) {
+  case Instruction::Add:
+    Coefficient = L + R;
+    return true;
+  case Instruction::Sub:
+    Coefficient = L - R;
+    return true;
+  case Instruction::Mul:
+    if (CR) {
+      Coefficient = L * CR->getSExtValue();
+      return true;
+    }
+    if (CL) {
+      Coefficient = R * CL->getSExtValue();
+      return true;
+    }
+    return false;
+  case Instruction::Shl:
+    if (CR && CR->getZExtValue() < 32) {
+      Coefficient = L << CR->getZExtValue();
+      return true;
+    }
+    return false;
+  case Instruction::Or:
+    // An or of disjoint bits is an add; a lane ID shifted left by at least
+    // the width of the constant is the common case.
+    if (CR && R == 0 && L != 0 && (L & -L) > CR->getSExtValue() &&
+        CR->getSExtValue() >= 0) {
+      Coefficient = L;
+      return true;
+    }
+    return false;
+  default:
+    return false;
+  }
+}
+
+void DxilGroupSharedBankConflicts::CollectAccesses(
+    GroupSharedArray &A, Value *Ptr, int Level,
+    SmallVectorImpl<IndexTerm> &Terms, bool bLinear) {
+  for (User *U : Ptr->users()) {
+    if (GEPOperator *GEP = dyn_cast<GEPOperator>(U)) {
+      size_t NumTerms = Terms.size();
+      // The first index steps over whole objects of the pointer's type,
+      // at the level the pointer was taken.
+      int IndexLevel = Level;
+      bool bGEPLinear = bLinear;
+      for (auto it = GEP->idx_begin(), E = GEP->idx_end(); it != E; ++it) {
+        int64_t Coefficient;
+        // Indices past the arrays select struct fields or vector elements,
+        // which don't move between lanes unless the index does.
+        if (!GetCoefficient(*it, Coefficient, 0) ||
+            (IndexLevel >= (int)A.Dims.size() && Coefficient != 0))
+          bGEPLinear = false;
+        else if (Coefficient != 0)
+          Terms.push_back({IndexLevel, Coefficient});
+        ++IndexLevel;
+      }
+      CollectAccesses(A, GEP, IndexLevel - 1, Terms, bGEPLinear);
+      Terms.resize(NumTerms);
+      continue;
+    }
+    Instruction *I = dyn_cast<Instruction>(U);
+    Value *PtrOperand = nullptr;
+    if (LoadInst *LI = dyn_cast_or_null<LoadInst>(I))
+      PtrOperand = LI->getPointerOperand();
+    else if (StoreInst *SI = dyn_cast_or_null<StoreInst>(I))
+      PtrOperand = SI->getPointerOperand();
+    else if (AtomicRMWInst *AI = dyn_cast_or_null<AtomicRMWInst>(I))
+      PtrOperand = AI->getPointerOperand();
+    else if (AtomicCmpXchgInst *AI = dyn_cast_or_null<AtomicCmpXchgInst>(I))
+      PtrOperand = AI->getPointerOperand();
+    // Anything else could see the layout, such as a bitcast or a whole
+    // array copied at once.
+    if (PtrOperand != Ptr ||
+        Ptr->getType()->getPointerElementType()->isAggregateType()) {
+      A.bPaddable = false;
+      continue;
+    }
+    A.Accesses.push_back(
+        {I, SmallVector<IndexTerm, 4>(Terms.begin(), Terms.end()), bLinear});
+  }
+}
+
+int64_t DxilGroupSharedBankConflicts::GetLaneStride(
+    const GroupSharedAccess &Access, ArrayRef<uint64_t> Dims,
+    uint64_t ElementSize) {
+  int64_t Stride = 0;
+  for (const IndexTerm &T : Access.Terms) {
+    // Each array level steps over elements of the levels inside it.
+    uint64_t Size = ElementSize;
+    for (int L = (int)Dims.size() - 1; L > T.Level; --L)
+      Size *= Dims[L];
+    Stride += T.Coefficient * (int64_t)Size;
+  }
+  return Stride;
+}
+
+unsigned DxilGroupSharedBankConflicts::GetConflictDegree(int64_t Stride) {
+  if (m_Banks == 0 || m_BankWidth == 0)
+    return 1;
+  // Lanes that read the same word are served together.
+  std::map<uint64_t, std::set<uint64_t>> WordsInBank;
+  unsigned Degree = 1;
+  for (unsigned Lane = 0; Lane < m_Banks; ++Lane) {
+    uint64_t Word = (uint64_t)(Stride * (int64_t)Lane) / m_BankWidth;
+    std::set<uint64_t> &Words = WordsInBank[Word % m_Banks];
+    Words.insert(Word);
+    Degree = std::max(Degree, (unsigned)Words.size());
+  }
+  return Degree;
+}
+
+unsigned DxilGroupSharedBankConflicts::GetConflictDegree(
+    const GroupSharedArray &A, ArrayRef<uint64_t> Dims) {
+  uint64_t ElementSize = m_pDL->getTypeAllocSize(A.ElementTy);
+  unsigned Total = 0;
+  for (const GroupSharedAccess &Access : A.Accesses)
+    if (Access.bLinear)
+      Total += GetConflictDegree(GetLaneStride(Access, Dims, ElementSize));
+  return Total;
+}
+
+static Type *GetArrayType(Type *ElementTy, ArrayRef<uint64_t> Dims) {
+  Type *Ty = ElementTy;
+  for (auto it = Dims.rbegin(), E = Dims.rend(); it != E; ++it)
+    Ty = ArrayType::get(Ty, *it);
+  return Ty;
+}
+
+// Rebuilds the users of Old, which are all indexed accesses, on New.
+static void RewriteUses(Value *Old, Value *New) {
+  SmallVector<User *, 8> Users(Old->user_begin(), Old->user_end());
+  for (User *U : Users) {
+    GEPOperator *GEP = dyn_cast<GEPOperator>(U);
+    if (GEP == nullptr) {
+      U->replaceUsesOfWith(Old, New);
+      continue;
+    }
+    SmallVector<Value *, 4> Indices(GEP->idx_begin(), GEP->idx_end());
+    if (GetElementPtrInst *GEPI = dyn_cast<GetElementPtrInst>(GEP)) {
+      IRBuilder<> Builder(GEPI);
+      Value *NewGEP = GEPI->isInBounds()
+                          ? Builder.CreateInBoundsGEP(New, Indices)
+                          : Builder.CreateGEP(New, Indices);
+      NewGEP->takeName(GEPI);
+      RewriteUses(GEPI, NewGEP);
+      GEPI->eraseFromParent();
+    } else {
+      ConstantExpr *CE = cast<ConstantExpr>(GEP);
+      SmallVector<Constant *, 4> CIndices;
+      for (Value *Idx : Indices)
+        CIndices.push_back(cast<Constant>(Idx));
+      Constant *NewCE = ConstantExpr::getGetElementPtr(
+          nullptr, cast<Constant>(New), CIndices, GEP->isInBounds());
+      RewriteUses(CE, NewCE);
+      CE->destroyConstant();
+    }
+  }
+}
+
+bool DxilGroupSharedBankConflicts::Pad(GroupSharedArray &A,
+                                       uint64_t &TGSMSize) {
+  unsigned Best = GetConflictDegree(A, A.Dims);
+  uint64_t ElementSize = m_pDL->getTypeAllocSize(A.ElementTy);
+  SmallVector<uint64_t, 4> BestDims(A.Dims.begin(), A.Dims.end());
+  // Padding the outermost level doesn't change any stride.
+  for (unsigned L = 1; L < A.Dims.size(); ++L) {
+    SmallVector<uint64_t, 4> Dims(A.Dims.begin(), A.Dims.end());
+    // Beyond a bank cycle the strides repeat.
+    uint64_t MaxPad = std::max<uint64_t>(
+        1, (uint64_t)m_Banks * m_BankWidth / ElementSize);
+    for (uint64_t P = 1; P <= MaxPad; ++P) {
+      Dims[L] = A.Dims[L] + P;
+      unsigned Degree = GetConflictDegree(A, Dims);
+      if (Degree < Best) {
+        Best = Degree;
+        BestDims = Dims;
+      }
+    }
+  }
+  if (BestDims == A.Dims)
+    return false;
+
+  GlobalVariable *GV = A.GV;
+  Type *PaddedTy = GetArrayType(A.ElementTy, BestDims);
+  uint64_t OldSize = m_pDL->getTypeAllocSize(GV->getType()->getElementType());
+  uint64_t NewSize = m_pDL->getTypeAllocSize(PaddedTy);
+  if (TGSMSize - OldSize + NewSize > DXIL::kMaxTGSMSize)
+    return false;
+  TGSMSize = TGSMSize - OldSize + NewSize;
+
+  GlobalVariable *NewGV = new GlobalVariable(
+      *GV->getParent(), PaddedTy, GV->isConstant(), GV->getLinkage(),
+      UndefValue::get(PaddedTy), "", GV, GV->getThreadLocalMode(),
+      GV->getType()->getPointerAddressSpace());
+  NewGV->takeName(GV);
+  NewGV->setAlignment(GV->getAlignment());
+  RewriteUses(GV, NewGV);
+  GV->removeDeadConstantUsers();
+  if (GV->use_empty())
+    GV->eraseFromParent();
+
+  if (m_Report) {
+    std::string Dims;
+    raw_string_ostream OS(Dims);
+    for (uint64_t D : BestDims)
+      OS << '[' << D << ']';
+    OS.flush();
+    Report(A.Accesses.front().I, "groupshared " + NewGV->getName() +
+                                     " padded to " + Dims +
+                                     " to avoid bank conflicts");
+  }
+  A.GV = NewGV;
+  A.Dims = BestDims;
+  return true;
+}
+
+void DxilGroupSharedBankConflicts::Report(Instruction *I, const Twine &Msg) {
+  LLVMContext &Ctx = I->getContext();
+  if (DebugLoc DL = I->getDebugLoc())
+    Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, Msg));
+  else
+    Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+}
+
+bool DxilGroupSharedBankConflicts::runOnModule(Module &M) {
+  if (!m_Pad && !m_Report)
+    return false;
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  m_pDL = &M.getDataLayout();
+  m_LaneComponent = 0;
+  if (DM.GetShaderModel()->IsCS()) {
+    for (unsigned i = 0; i < 3; ++i) {
+      if (DM.GetNumThreads(i) > 1) {
+        m_LaneComponent = i;
+        break;
+      }
+    }
+  }
+  FindLaneDependentValues(M);
+
+  std::vector<GroupSharedArray> Arrays;
+  uint64_t TGSMSize = 0;
+  for (GlobalVariable &GV : M.globals()) {
+    if (!dxilutil::IsSharedMemoryGlobal(&GV))
+      continue;
+    Type *Ty = GV.getType()->getElementType();
+    TGSMSize += m_pDL->getTypeAllocSize(Ty);
+    if (!Ty->isArrayTy())
+      continue;
+    GroupSharedArray A;
+    A.GV = &GV;
+    while (ArrayType *AT = dyn_cast<ArrayType>(Ty)) {
+      A.Dims.push_back(AT->getNumElements());
+      Ty = AT->getElementType();
+    }
+    A.ElementTy = Ty;
+    SmallVector<IndexTerm, 4> Terms;
+    CollectAccesses(A, &GV, -1, Terms, /*bLinear*/ true);
+    if (!A.Accesses.empty())
+      Arrays.push_back(std::move(A));
+  }
+
+  bool bChanged = false;
+  for (GroupSharedArray &A : Arrays) {
+    uint64_t ElementSize = m_pDL->getTypeAllocSize(A.ElementTy);
+    bool bConflicts = false;
+    for (const GroupSharedAccess &Access : A.Accesses) {
+      if (!Access.bLinear)
+        continue;
+      int64_t Stride = GetLaneStride(Access, A.Dims, ElementSize);
+      unsigned Degree = GetConflictDegree(Stride);
+      if (Degree <= 1)
+        continue;
+      bConflicts = true;
+      if (m_Report)
+        Report(Access.I, Twine(Degree) + "-way bank conflict on groupshared " +
+                             A.GV->getName() + "; adjacent threads are " +
+                             Twine(Stride) + " bytes apart");
+    }
+    if (bConflicts && m_Pad && A.bPaddable && A.Dims.size() > 1)
+      bChanged |= Pad(A, TGSMSize);
+  }
+  return bChanged;
+}
+
+}
+
+char DxilGroupSharedBankConflicts::ID = 0;
+
+ModulePass *llvm::createDxilGroupSharedBankConflictsPass(bool Report,
+                                                         bool Pad) {
+  return new DxilGroupSharedBankConflicts(Report, Pad);
+}
+
+INITIALIZE_PASS(DxilGroupSharedBankConflicts,
+                "dxil-groupshared-bank-conflicts",
+                "DXIL groupshared bank conflicts", false, false)
@@ -0,0 +1,223 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilHoistResourceOps.cpp                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Hoist loop-invariant handle creation and resource metadata operations.    //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilModule.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// LICM is disabled in the HLSL pipeline because it doesn't account for
+// register pressure, so createHandle with a loop-invariant index stays in the
+// loop body and is executed on every iteration. A handle is a descriptor
+// reference rather than data, and the binding it refers to can't change
+// during the shader, so it can be created in the preheader instead.
+// getDimensions on such a handle is hoisted too, along with the constant
+// buffer loads and cheap arithmetic that the index is computed from. Other
+// loop-invariant instructions are left where they are.
+//
+// Only operations in blocks that dominate every exit of the loop are hoisted,
+// so one behind a condition, or with an index computed behind one, stays
+// where it is. The pass runs before the nonUniform flags of createHandle are
+// set, so they describe the hoisted calls.
+
+namespace {
+class DxilHoistResourceOps : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilHoistResourceOps() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL hoist loop-invariant resource operations";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override {
+    if (!F.getParent()->HasDxilModule())
+      return false;
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    m_DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    bool bChanged = false;
+    for (Loop *L : LI)
+      bChanged |= HoistFromLoopNest(L);
+    return bChanged;
+  }
+
+private:
+  DominatorTree *m_DT = nullptr;
+
+  bool HoistFromLoopNest(Loop *L);
+  bool HoistFromLoop(Loop *L);
+  bool IsGuaranteedToExecute(BasicBlock *BB,
+                             const SmallVectorImpl<BasicBlock *> &ExitBlocks);
+};
+
+char DxilHoistResourceOps::ID = 0;
+
+bool IsHoistRoot(Instruction *I) {
+  return OP::IsDxilOpFuncCallInst(I, OP::OpCode::CreateHandle) ||
+         OP::IsDxilOpFuncCallInst(I, OP::OpCode::GetDimensions);
+}
+
+// Operations that may be moved to feed a hoisted root.
+bool IsHoistable(Instruction *I) {
+  if (isa<PHINode>(I) || isa<TerminatorInst>(I))
+    return false;
+  if (IsHoistRoot(I) ||
+      OP::IsDxilOpFuncCallInst(I, OP::OpCode::CBufferLoad) ||
+      OP::IsDxilOpFuncCallInst(I, OP::OpCode::CBufferLoadLegacy))
+    return true;
+  return !I->mayReadOrWriteMemory() && isSafeToSpeculativelyExecute(I);
+}
+
+// Adds I and the loop instructions it depends on to ToHoist, operands first.
+// Returns false if I can't be made loop invariant.
+bool CollectHoistable(Value *V, Loop *L, SetVector<Instruction *> &ToHoist,
+                      unsigned Depth) {
+  const unsigned kMaxDepth = 8;
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I || !L->contains(I) || ToHoist.count(I))
+    return true;
+  if (Depth > kMaxDepth || !IsHoistable(I))
+    return false;
+  for (Value *Op : I->operands()) {
+    if (!CollectHoistable(Op, L, ToHoist, Depth + 1))
+      return false;
+  }
+  ToHoist.insert(I);
+  return true;
+}
+
+// Finds the identical instructions of a preheader without comparing each
+// hoisted one with all of those before it.
+struct IdenticalInstInfo {
+  static Instruction *getEmptyKey() {
+    return DenseMapInfo<Instruction *>::getEmptyKey();
+  }
+  static Instruction *getTombstoneKey() {
+    return DenseMapInfo<Instruction *>::getTombstoneKey();
+  }
+  static unsigned getHashValue(const Instruction *I) {
+    hash_code H = hash_combine(I->getOpcode(), I->getType());
+    for (const Use &U : I->operands())
+      H = hash_combine(H, U.get());
+    return H;
+  }
+  static bool isEqual(const Instruction *LHS, const Instruction *RHS) {
+    if (LHS == RHS)
+      return true;
+    if (LHS == getEmptyKey() || LHS == getTombstoneKey() ||
+        RHS == getEmptyKey() || RHS == getTombstoneKey())
+      return false;
+    return LHS->isIdenticalTo(RHS);
+  }
+};
+
+// Inner loops are done first, so that what they hoist into a preheader inside
+// the outer loop can be hoisted again.
+bool DxilHoistResourceOps::HoistFromLoopNest(Loop *L) {
+  bool bChanged = false;
+  for (Loop *SubLoop : *L)
+    bChanged |= HoistFromLoopNest(SubLoop);
+  bChanged |= HoistFromLoop(L);
+  return bChanged;
+}
+
+// A block that dominates every exit runs on each path through the loop.
+bool DxilHoistResourceOps::IsGuaranteedToExecute(
+    BasicBlock *BB, const SmallVectorImpl<BasicBlock *> &ExitBlocks) {
+  // A loop without exits never finishes, so nothing can be said.
+  if (ExitBlocks.empty())
+    return false;
+  for (BasicBlock *Exit : ExitBlocks) {
+    if (!m_DT->dominates(BB, Exit))
+      return false;
+  }
+  return true;
+}
+
+bool DxilHoistResourceOps::HoistFromLoop(Loop *L) {
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    return false;
+
+  SmallVector<BasicBlock *, 8> ExitBlocks;
+  L->getExitBlocks(ExitBlocks);
+  std::vector<Instruction *> Roots;
+  for (BasicBlock *BB : L->getBlocks()) {
+    // The operands of a root dominate it, so they run whenever it does.
+    if (!IsGuaranteedToExecute(BB, ExitBlocks))
+      continue;
+    for (Instruction &I : *BB) {
+      if (IsHoistRoot(&I))
+        Roots.emplace_back(&I);
+    }
+  }
+
+  Instruction *InsertPt = Preheader->getTerminator();
+  DenseSet<Instruction *, IdenticalInstInfo> Available;
+  for (Instruction &I : *Preheader) {
+    if (IsHoistable(&I))
+      Available.insert(&I);
+  }
+  SmallPtrSet<Instruction *, 8> Erased;
+  bool bChanged = false;
+  for (Instruction *Root : Roots) {
+    if (Erased.count(Root))
+      continue;
+    SetVector<Instruction *> ToHoist;
+    if (!CollectHoistable(Root, L, ToHoist, 0))
+      continue;
+    for (Instruction *I : ToHoist) {
+      I->moveBefore(InsertPt);
+      // Reuse an identical operation that was hoisted or already there.
+      auto Inserted = Available.insert(I);
+      if (!Inserted.second) {
+        I->replaceAllUsesWith(*Inserted.first);
+        I->eraseFromParent();
+        Erased.insert(I);
+      }
+    }
+    bChanged = true;
+  }
+  return bChanged;
+}
+}
+
+FunctionPass *llvm::createDxilHoistResourceOpsPass() {
+  return new DxilHoistResourceOps();
+}
+
+INITIALIZE_PASS_BEGIN(DxilHoistResourceOps, "dxil-hoist-resource-ops",
+                      "DXIL hoist loop-invariant resource operations", false,
+                      false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilHoistResourceOps, "dxil-hoist-resource-ops",
+                    "DXIL hoist loop-invariant resource operations", false,
+                    false)
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilInferEarlyDepthStencil.cpp                                            //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Find pixel shaders that can run depth and stencil tests early, and set    //
+// the flag for them.                                                        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilEntryProps.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilSignature.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/IR/DebugInfo.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Running the depth and stencil tests before the pixel shader only changes
+// what the shader observes when the shader can change the outcome of the
+// tests, or has effects that must not happen for pixels that fail them.
+// A pixel shader without [earlydepthstencil] can have them run early when
+// neither it nor any function it calls:
+// - writes SV_Depth, SV_DepthGreaterEqual, SV_DepthLessEqual, SV_StencilRef
+//   or SV_Coverage;
+// - discards, through discard or clip();
+// - writes a UAV, including atomics and append/consume counters.
+// Alpha to coverage is pipeline state the compiler can't see; an application
+// that enables it for a shader must not use the inferred flag.
+//
+// With Report, each such shader gets a warning; with Apply, the flag is set.
+
+namespace {
+
+class DxilInferEarlyDepthStencil : public ModulePass {
+  bool m_Apply;
+  bool m_Report;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilInferEarlyDepthStencil(bool Apply = false, bool Report = false)
+      : ModulePass(ID), m_Apply(Apply), m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL infer early depth stencil";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Apply", &m_Apply, false);
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",Apply=" << m_Apply;
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  static bool WritesTestedOutput(const DxilSignature &Sig);
+  static bool HasLateEffects(Function *Entry);
+  void Report(Function *Entry, const Twine &Msg);
+};
+
+bool DxilInferEarlyDepthStencil::WritesTestedOutput(const DxilSignature &Sig) {
+  for (auto &E : Sig.GetElements()) {
+    switch (E->GetKind()) {
+    case Semantic::Kind::Depth:
+    case Semantic::Kind::DepthGreaterEqual:
+    case Semantic::Kind::DepthLessEqual:
+    case Semantic::Kind::StencilRef:
+    case Semantic::Kind::Coverage:
+      return true;
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+bool DxilInferEarlyDepthStencil::HasLateEffects(Function *Entry) {
+  SetVector<Function *> Functions;
+  Functions.insert(Entry);
+  for (unsigned i = 0; i < Functions.size(); ++i) {
+    for (BasicBlock &BB : *Functions[i]) {
+      for (Instruction &I : BB) {
+        CallInst *CI = dyn_cast<CallInst>(&I);
+        if (CI == nullptr)
+          continue;
+        Function *Callee = CI->getCalledFunction();
+        if (Callee == nullptr)
+          return true;
+        if (!OP::IsDxilOpFunc(Callee)) {
+          if (!Callee->isDeclaration())
+            Functions.insert(Callee);
+          else if (!Callee->isIntrinsic())
+            return true; // An external function could do anything.
+          continue;
+        }
+        switch (OP::GetDxilOpFuncCallInst(CI)) {
+        case DXIL::OpCode::Discard:
+        case DXIL::OpCode::BufferStore:
+        case DXIL::OpCode::RawBufferStore:
+        case DXIL::OpCode::TextureStore:
+        case DXIL::OpCode::AtomicBinOp:
+        case DXIL::OpCode::AtomicCompareExchange:
+        case DXIL::OpCode::BufferUpdateCounter:
+          return true;
+        default:
+          break;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+void DxilInferEarlyDepthStencil::Report(Function *Entry, const Twine &Msg) {
+  LLVMContext &Ctx = Entry->getContext();
+  if (DISubprogram *SP = getDISubprogram(Entry))
+    Ctx.emitWarning(dxilutil::FormatMessageAtLocation(
+        DebugLoc::get(SP->getLine(), 0, SP), Msg));
+  else
+    Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+}
+
+bool DxilInferEarlyDepthStencil::runOnModule(Module &M) {
+  if (!m_Apply && !m_Report)
+    return false;
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  bool bChanged = false;
+  for (Function &F : M.functions()) {
+    if (F.isDeclaration() || !DM.HasDxilEntryProps(&F))
+      continue;
+    DxilEntryProps &EntryProps = DM.GetDxilEntryProps(&F);
+    DxilFunctionProps &Props = EntryProps.props;
+    if (!Props.IsPS() || Props.ShaderProps.PS.EarlyDepthStencil)
+      continue;
+    if (WritesTestedOutput(EntryProps.sig.OutputSignature) ||
+        HasLateEffects(&F))
+      continue;
+
+    StringRef Name = dxilutil::DemangleFunctionName(F.getName());
+    if (!m_Apply) {
+      if (m_Report)
+        Report(&F, "pixel shader " + Name +
+                       " could use [earlydepthstencil]; it writes no depth, "
+                       "stencil or coverage, and doesn't discard or write "
+                       "UAVs");
+      continue;
+    }
+    Props.ShaderProps.PS.EarlyDepthStencil = true;
+    if (&F == DM.GetEntryFunction())
+      DM.m_ShaderFlags.SetForceEarlyDepthStencil(true);
+    if (m_Report)
+      Report(&F, "[earlydepthstencil] inferred for pixel shader " + Name);
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+}
+
+char DxilInferEarlyDepthStencil::ID = 0;
+
+ModulePass *llvm::createDxilInferEarlyDepthStencilPass(bool Apply,
+                                                       bool Report) {
+  return new DxilInferEarlyDepthStencil(Apply, Report);
+}
+
+INITIALIZE_PASS(DxilInferEarlyDepthStencil, "dxil-infer-early-depth-stencil",
+                "DXIL infer early depth stencil", false, false)
@@ -13,6 +13,10 @@
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilOperations.h"
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/Constants.h"
@@ -35,7 +39,17 @@ using namespace hlsl;
 // Legalize Sample offset.
 
 namespace {
+// How many times the loops that compute offsets are unrolled before giving
+// up. Another round only helps when unrolling or simplifying exposed the trip
+// count of a loop that still computes an offset.
+static const unsigned kMaxUnrollRounds = 4;
+
 // When optimizations are disabled, try to legalize sample offset.
+//
+// Only the loops that an offset depends on, through a PHI in their header,
+// are unrolled. The other loops get unroll(disable) until the unrolling is
+// done, so the cost of full unrolling is not paid on loops that can't make
+// an offset immediate.
 class DxilLegalizeSampleOffsetPass : public FunctionPass {
 
 public:
@@ -57,15 +71,28 @@ public:
     if (illegalOffsets.empty())
       return false;
 
-    // Loop unroll if has offset inside loop.
-    TryUnrollLoop(illegalOffsets, F);
+    m_stuckLoops.clear();
 
-    // Collect offset again after mem2reg.
-    std::vector<Instruction *> ssaIllegalOffsets;
-    CollectIllegalOffsets(ssaIllegalOffsets, F, hlslOP);
+    // Promote to SSA, and prepare loops for unrolling if has offset inside
+    // loop.
+    TryUnrollLoop(illegalOffsets, F);
 
-    // Run simple optimization to legalize offsets.
-    LegalizeOffsets(ssaIllegalOffsets);
+    unsigned prevNumLoops = UINT_MAX;
+    for (unsigned round = 0;; ++round) {
+      // Collect offset again after mem2reg or unrolling.
+      std::vector<Instruction *> ssaIllegalOffsets;
+      CollectIllegalOffsets(ssaIllegalOffsets, F, hlslOP);
+
+      // Run simple optimization to legalize offsets.
+      LegalizeOffsets(ssaIllegalOffsets);
+
+      // Simplification may replace offsets, so collect them once more.
+      ssaIllegalOffsets.clear();
+      CollectIllegalOffsets(ssaIllegalOffsets, F, hlslOP);
+      if (ssaIllegalOffsets.empty() ||
+          !UnrollFeedingLoops(ssaIllegalOffsets, F, round, prevNumLoops))
+        break;
+    }
 
     // Remove PHINodes to keep code shape.
     legacy::FunctionPassManager PM(F.getParent());
@@ -78,7 +105,12 @@ public:
   }
 
 private:
+  // Locations of the loops that compute offsets and were not unrolled.
+  SmallVector<DebugLoc, 4> m_stuckLoops;
+
   void TryUnrollLoop(std::vector<Instruction *> &illegalOffsets, Function &F);
+  bool UnrollFeedingLoops(const std::vector<Instruction *> &illegalOffsets,
+                          Function &F, unsigned round, unsigned &prevNumLoops);
   void CollectIllegalOffsets(std::vector<Instruction *> &illegalOffsets,
                              Function &F, hlsl::OP *hlslOP);
   void CollectIllegalOffsets(std::vector<Instruction *> &illegalOffsets,
@@ -110,6 +142,61 @@ bool HasIllegalOffsetInLoop(std::vector<Instruction *> &illegalOffsets,
   return findOffset;
 }
 
+void CollectLoops(Loop *L, SmallVectorImpl<Loop *> &loops) {
+  loops.push_back(L);
+  for (Loop *subLoop : *L)
+    CollectLoops(subLoop, loops);
+}
+
+// Adds the loops with a PHI in their header that the offset depends on. The
+// branches that PHIs merge on are followed too, since unrolling may fold
+// them.
+void CollectFeedingLoops(Instruction *offset, LoopInfo &LI,
+                         SmallSetVector<Loop *, 4> &feedingLoops) {
+  SmallPtrSet<Instruction *, 32> visited;
+  SmallVector<Instruction *, 16> worklist;
+  auto addOperand = [&](Value *V) {
+    Instruction *I = dyn_cast<Instruction>(V);
+    if (I && visited.insert(I).second)
+      worklist.push_back(I);
+  };
+  addOperand(offset);
+  while (!worklist.empty()) {
+    Instruction *I = worklist.pop_back_val();
+    if (PHINode *PN = dyn_cast<PHINode>(I)) {
+      BasicBlock *BB = PN->getParent();
+      Loop *L = LI.getLoopFor(BB);
+      if (L && L->getHeader() == BB)
+        feedingLoops.insert(L);
+      for (BasicBlock *pred : PN->blocks()) {
+        BranchInst *BI = dyn_cast<BranchInst>(pred->getTerminator());
+        if (BI && BI->isConditional())
+          addOperand(BI->getCondition());
+      }
+    }
+    for (Value *op : I->operands())
+      addOperand(op);
+  }
+}
+
+// Adds unroll(disable) to the loop, and maps the new loop ID to the one it
+// replaces so it can be restored.
+void DisableUnroll(Loop *L, DenseMap<MDNode *, MDNode *> &savedIDs) {
+  LLVMContext &Ctx = L->getHeader()->getContext();
+  SmallVector<Metadata *, 4> MDs;
+  // Reserve first location for self reference to the LoopID metadata node.
+  MDs.push_back(nullptr);
+  if (MDNode *loopID = L->getLoopID()) {
+    for (unsigned i = 1, e = loopID->getNumOperands(); i < e; ++i)
+      MDs.push_back(loopID->getOperand(i));
+  }
+  MDs.push_back(MDNode::get(Ctx, MDString::get(Ctx, "llvm.loop.unroll.disable")));
+  MDNode *newLoopID = MDNode::get(Ctx, MDs);
+  newLoopID->replaceOperandWith(0, newLoopID);
+  savedIDs[newLoopID] = L->getLoopID();
+  L->setLoopID(newLoopID);
+}
+
 void CollectIllegalOffset(CallInst *CI,
                           std::vector<Instruction *> &illegalOffsets) {
   Value *offset0 =
@@ -145,6 +232,14 @@ void DxilLegalizeSampleOffsetPass::FinalCheck(
         L.print(errorStr);
       errorStr << " " << kIllegalOffsetError;
     }
+    for (const DebugLoc &L : m_stuckLoops) {
+      if (L)
+        L.print(errorStr);
+      errorStr << " Loop computing a Sample* offset could not be unrolled: "
+                  "its trip count is not a constant, or it was still left "
+                  "after "
+               << kMaxUnrollRounds << " rounds of unrolling\n";
+    }
     errorStr.flush();
     F.getContext().emitError(errorMsg);
   }
@@ -158,16 +253,68 @@ void DxilLegalizeSampleOffsetPass::TryUnrollLoop(
   // Always need mem2reg for simplify illegal offsets.
   PM.add(createPromoteMemoryToRegisterPass());
 
+  // Put the loops in the form unrolling needs; UnrollFeedingLoops then
+  // unrolls the ones the offsets depend on.
   if (HasIllegalOffsetInLoop(illegalOffsets, F)) {
     PM.add(createCFGSimplificationPass());
     PM.add(createLCSSAPass());
     PM.add(createLoopSimplifyPass());
     PM.add(createLoopRotatePass());
-    PM.add(createLoopUnrollPass(-2, -1, 0, 0));
   }
   PM.run(F);
 }
 
+// Unrolls the loops that compute the offsets. Returns true if another round
+// may make more offsets immediate.
+bool DxilLegalizeSampleOffsetPass::UnrollFeedingLoops(
+    const std::vector<Instruction *> &illegalOffsets, Function &F,
+    unsigned round, unsigned &prevNumLoops) {
+  DominatorTreeAnalysis DTA;
+  DominatorTree DT = DTA.run(F);
+  LoopInfo LI;
+  LI.Analyze(DT);
+
+  SmallSetVector<Loop *, 4> feedingLoops;
+  for (Instruction *I : illegalOffsets)
+    CollectFeedingLoops(I, LI, feedingLoops);
+  if (feedingLoops.empty())
+    return false;
+
+  SmallVector<Loop *, 8> loops;
+  for (Loop *L : LI)
+    CollectLoops(L, loops);
+  // Unrolling removes each loop it unrolls, so no fewer loops than in the
+  // previous round means the last round got nowhere.
+  unsigned numLoops = loops.size();
+  if (round == kMaxUnrollRounds || numLoops >= prevNumLoops) {
+    for (Loop *L : feedingLoops)
+      m_stuckLoops.emplace_back(L->getStartLoc());
+    return false;
+  }
+  prevNumLoops = numLoops;
+
+  DenseMap<MDNode *, MDNode *> savedIDs;
+  for (Loop *L : loops) {
+    if (!feedingLoops.count(L))
+      DisableUnroll(L, savedIDs);
+  }
+
+  legacy::FunctionPassManager PM(F.getParent());
+  PM.add(createLoopUnrollPass(-2, -1, 0, 0));
+  PM.run(F);
+
+  // Copies of the latches made while unrolling an outer loop share the
+  // loop ID, so all of them get the original back.
+  for (BasicBlock &BB : F) {
+    TerminatorInst *TI = BB.getTerminator();
+    MDNode *loopID = TI->getMetadata(LLVMContext::MD_loop);
+    auto it = loopID ? savedIDs.find(loopID) : savedIDs.end();
+    if (it != savedIDs.end())
+      TI->setMetadata(LLVMContext::MD_loop, it->second);
+  }
+  return true;
+}
+
 void DxilLegalizeSampleOffsetPass::CollectIllegalOffsets(
     std::vector<Instruction *> &illegalOffsets, Function &CurF,
     hlsl::OP *hlslOP) {
@@ -13,6 +13,7 @@
 #include "dxc/DXIL/DxilEntryProps.h"
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
 #include "dxc/DXIL/DxilResource.h"
 #include "dxc/DXIL/DxilSampler.h"
 #include "dxc/DXIL/DxilUtil.h"
@@ -20,6 +21,7 @@
 #include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
@@ -29,6 +31,8 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include <memory>
+#include <random>
+#include <set>
 #include <vector>
 
 #include "dxc/DxilContainer/DxilContainer.h"
@@ -43,6 +47,8 @@
 
 #include "dxc/HLSL/DxilExportMap.h"
 #include "dxc/HLSL/ComputeViewIdState.h"
+#include "dxc/HLSL/DxilPackSignatureElement.h"
+#include "dxc/HLSL/DxilSignatureAllocator.h"
 
 using namespace llvm;
 using namespace hlsl;
@@ -61,6 +67,23 @@ void CollectUsedFunctions(Constant *C,
   }
 }
 
+// Globals are used directly, through constant expressions, or through the
+// initializers of other globals.
+void CollectUsedGlobals(Constant *C,
+                        std::unordered_set<GlobalVariable *> &GVSet) {
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(C)) {
+    if (GVSet.insert(GV).second && GV->hasInitializer())
+      CollectUsedGlobals(GV->getInitializer(), GVSet);
+    return;
+  }
+  if (isa<GlobalValue>(C))
+    return;
+  for (Use &U : C->operands()) {
+    if (Constant *Op = dyn_cast<Constant>(U.get()))
+      CollectUsedGlobals(Op, GVSet);
+  }
+}
+
 template <class T>
 void AddResourceMap(
     const std::vector<std::unique_ptr<T>> &resTab, DXIL::ResourceClass resClass,
@@ -104,9 +127,12 @@ struct DxilFunctionLinkInfo {
   std::unordered_set<llvm::Function *> usedFunctions;
   std::unordered_set<llvm::GlobalVariable *> usedGVs;
   std::unordered_set<DxilResourceBase *> usedResources;
+  // Set once the function is materialized and the sets above are built.
+  bool bLoaded;
 };
 
-// Library to link.
+// Library to link. A registered library is parsed once and shared by every
+// link; functions are loaded and analyzed on first use, and stay loaded.
 class DxilLib {
 
 public:
@@ -135,6 +161,7 @@ private:
   std::unordered_map<const llvm::Constant *, DxilResourceBase *> m_resourceMap;
   // Set of initialize functions for global variable.
   std::unordered_set<llvm::Function *> m_initFuncSet;
+  bool m_bGlobalUsageBuilt;
 };
 
 struct DxilLinkJob;
@@ -152,6 +179,10 @@ public:
 
   std::unique_ptr<llvm::Module>
   Link(StringRef entry, StringRef profile, dxilutil::ExportMap &exportMap) override;
+  std::unique_ptr<llvm::Module>
+  LinkPipelineStage(StringRef entry, StringRef profile, StringRef pairedEntry,
+                    unsigned packSearchLimit,
+                    dxilutil::ExportMap &exportMap) override;
 
 private:
   bool AttachLib(DxilLib *lib);
@@ -174,7 +205,8 @@ private:
 //
 // DxilFunctionLinkInfo methods.
 //
-DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
+DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F)
+    : func(F), bLoaded(false) {
   DXASSERT_NOMSG(F);
 }
 
@@ -184,7 +216,8 @@ DxilFunctionLinkInfo::DxilFunctionLinkInfo(Function *F) : func(F) {
 //
 
 DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule)
-    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()) {
+    : m_pModule(std::move(pModule)), m_DM(m_pModule->GetOrCreateDxilModule()),
+      m_bGlobalUsageBuilt(false) {
   Module &M = *m_pModule;
   const std::string &MID = M.getModuleIdentifier();
 
@@ -212,15 +245,22 @@ DxilLib::DxilLib(std::unique_ptr<llvm::Module> pModule)
 void DxilLib::LazyLoadFunction(Function *F) {
   DXASSERT(m_functionNameMap.count(F->getName()), "else invalid Function");
   DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
+  if (linkInfo->bLoaded)
+    return;
+  linkInfo->bLoaded = true;
   std::error_code EC = F->materialize();
   DXASSERT_LOCALVAR(EC, !EC, "else fail to materialize");
 
-  // Build used functions for F.
+  // Build used functions and globals for F.
   for (auto &BB : F->getBasicBlockList()) {
     for (auto &I : BB.getInstList()) {
       if (CallInst *CI = dyn_cast<CallInst>(&I)) {
         linkInfo->usedFunctions.insert(CI->getCalledFunction());
       }
+      for (Use &U : I.operands()) {
+        if (Constant *C = dyn_cast<Constant>(U.get()))
+          CollectUsedGlobals(C, linkInfo->usedGVs);
+      }
     }
   }
 
@@ -232,10 +272,14 @@ void DxilLib::LazyLoadFunction(Function *F) {
       linkInfo->usedFunctions.insert(patchConstantFunc);
     }
   }
-  // Used globals will be build before link.
 }
 
 void DxilLib::BuildGlobalUsage() {
+  // Function global usage is built as functions load, so this only needs to
+  // happen for the first link that uses the library.
+  if (m_bGlobalUsageBuilt)
+    return;
+  m_bGlobalUsageBuilt = true;
   Module &M = *m_pModule;
 
   // Collect init functions for static globals.
@@ -262,17 +306,6 @@ void DxilLib::BuildGlobalUsage() {
     }
   }
 
-  // Build used globals.
-  for (GlobalVariable &GV : M.globals()) {
-    std::unordered_set<Function *> funcSet;
-    CollectUsedFunctions(&GV, funcSet);
-    for (Function *F : funcSet) {
-      DXASSERT(m_functionNameMap.count(F->getName()), "must exist in table");
-      DxilFunctionLinkInfo *linkInfo = m_functionNameMap[F->getName()].get();
-      linkInfo->usedGVs.insert(&GV);
-    }
-  }
-
   // Build resource map.
   AddResourceMap(m_DM.GetUAVs(), DXIL::ResourceClass::UAV, m_resourceMap, m_DM);
   AddResourceMap(m_DM.GetSRVs(), DXIL::ResourceClass::SRV, m_resourceMap, m_DM);
@@ -383,6 +416,8 @@ const char kInvalidValidatorVersion[] = "Validator version does not support targ
 const char kExportNameCollision[] = "Export name collides with another export: ";
 const char kExportFunctionMissing[] = "Could not find target for export: ";
 const char kNoFunctionsToExport[] = "Library has no functions to export";
+const char kCannotPairStages[] =
+    "Cannot pair the signatures of pipeline stages ";
 } // namespace
 //------------------------------------------------------------------------------
 //
@@ -452,6 +487,69 @@ bool IsMatchedType(Type *Ty0, Type *Ty) {
 
   return Ty0 == Ty;
 }
+
+// The linked entry may read only the start of a library cbuffer. Shrinks
+// each cbuffer to the last row that is read, so it binds no more than it
+// needs. Cbuffers read with a dynamic row, or declared as arrays, keep
+// their size. Returns true if any size changed.
+bool CompactCBuffers(DxilModule &DM) {
+  if (DM.GetCBuffers().empty())
+    return false;
+
+  const unsigned kCBufferRowSize = 16; // Bytes in a legacy cbuffer row.
+  // Rows read per cbuffer ID, or UINT_MAX if it can't be compacted.
+  std::vector<unsigned> rowCounts(DM.GetCBuffers().size(), 0);
+  for (auto &it : DM.GetOP()->GetOpFuncList(DXIL::OpCode::CreateHandle)) {
+    Function *F = it.second;
+    if (F == nullptr)
+      continue;
+    for (User *U : F->users()) {
+      CallInst *CI = cast<CallInst>(U);
+      ConstantInt *cResClass = dyn_cast<ConstantInt>(
+          CI->getArgOperand(DXIL::OperandIndex::kCreateHandleResClassOpIdx));
+      if (!cResClass || cResClass->getLimitedValue() !=
+                            (unsigned)DXIL::ResourceClass::CBuffer)
+        continue;
+      ConstantInt *cResID = dyn_cast<ConstantInt>(
+          CI->getArgOperand(DXIL::OperandIndex::kCreateHandleResIDOpIdx));
+      if (!cResID) {
+        // Can't tell which cbuffer this reads.
+        std::fill(rowCounts.begin(), rowCounts.end(), UINT_MAX);
+        break;
+      }
+      unsigned ID = cResID->getLimitedValue();
+      if (ID >= rowCounts.size())
+        continue;
+      for (User *HandleU : CI->users()) {
+        CallInst *Load = dyn_cast<CallInst>(HandleU);
+        ConstantInt *cRow = nullptr;
+        if (Load && OP::IsDxilOpFuncCallInst(Load,
+                                             DXIL::OpCode::CBufferLoadLegacy))
+          cRow = dyn_cast<ConstantInt>(
+              DxilInst_CBufferLoadLegacy(Load).get_regIndex());
+        if (!cRow || rowCounts[ID] == UINT_MAX) {
+          rowCounts[ID] = UINT_MAX;
+          break;
+        }
+        rowCounts[ID] = std::max(rowCounts[ID],
+                                 (unsigned)cRow->getLimitedValue() + 1);
+      }
+    }
+  }
+
+  bool bChanged = false;
+  for (auto &CB : DM.GetCBuffers()) {
+    unsigned rowCount = rowCounts[CB->GetID()];
+    if (rowCount == 0 || rowCount == UINT_MAX || CB->GetRangeSize() != 1)
+      continue;
+    unsigned size = rowCount * kCBufferRowSize;
+    if (size < CB->GetSize()) {
+      CB->SetSize(size);
+      bChanged = true;
+    }
+  }
+  return bChanged;
+}
 } // namespace
 
 bool DxilLinkJob::AddResource(DxilResourceBase *res, llvm::GlobalVariable *GV) {
@@ -673,6 +771,12 @@ void DxilLinkJob::AddFunctions(DxilModule &DM, ValueToValueMapTy &vmap,
                                       F->getName(), pM);
     NewF->setAttributes(F->getAttributes());
 
+    // Functions kept by a library, by [noinline] or -lib-noinline-size, are
+    // only kept when linking to another library; shaders can't have calls.
+    if (!DM.GetShaderModel()->IsLib() &&
+        NewF->hasFnAttribute(llvm::Attribute::NoInline))
+      NewF->removeFnAttr(llvm::Attribute::NoInline);
+
     if (!NewF->hasFnAttribute(llvm::Attribute::NoInline))
       NewF->addFnAttr(llvm::Attribute::AlwaysInline);
 
@@ -793,6 +897,10 @@ DxilLinkJob::Link(std::pair<DxilFunctionLinkInfo *, DxilLib *> &entryLinkPair,
 
   RunPreparePass(*pM);
 
+  // Unused resources are gone now; shrink the cbuffers that are left.
+  if (CompactCBuffers(DM))
+    DM.ReEmitDxilResources();
+
   return pM;
 }
 
@@ -1337,8 +1445,574 @@ DxilLinkerImpl::Link(StringRef entry, StringRef profile, dxilutil::ExportMap &ex
   }
 }
 
+std::unique_ptr<llvm::Module>
+DxilLinkerImpl::LinkPipelineStage(StringRef entry, StringRef profile,
+                                  StringRef pairedEntry,
+                                  unsigned packSearchLimit,
+                                  dxilutil::ExportMap &exportMap) {
+  std::unique_ptr<Module> pM = Link(entry, profile, exportMap);
+  if (!pM)
+    return nullptr;
+
+  auto it = m_functionNameMap.find(pairedEntry);
+  if (it == m_functionNameMap.end()) {
+    m_ctx.emitError(Twine(kUndefFunction) + pairedEntry);
+    return nullptr;
+  }
+  Function *pairedFunc = it->second.first->func;
+  DxilModule &pairedLibDM = it->second.second->GetDxilModule();
+  if (!pairedLibDM.HasDxilFunctionProps(pairedFunc)) {
+    m_ctx.emitError(Twine(kNoEntryProps) + pairedEntry);
+    return nullptr;
+  }
+
+  // The paired stage is linked with the same shader model.
+  DxilModule &DM = pM->GetDxilModule();
+  const ShaderModel *pSM = DM.GetShaderModel();
+  const ShaderModel *pPairedSM = ShaderModel::Get(
+      pairedLibDM.GetDxilFunctionProps(pairedFunc).shaderKind,
+      pSM->GetMajor(), pSM->GetMinor());
+  dxilutil::ExportMap pairedExportMap;
+  std::unique_ptr<Module> pPairedM =
+      Link(pairedEntry, pPairedSM->GetName(), pairedExportMap);
+  if (!pPairedM)
+    return nullptr;
+
+  DxilModule &PairedDM = pPairedM->GetDxilModule();
+  unsigned rowsSaved = 0;
+  bool bPaired =
+      pSM->IsPS()
+          ? LinkPipelineSignatures(PairedDM, DM, packSearchLimit, &rowsSaved)
+          : LinkPipelineSignatures(DM, PairedDM, packSearchLimit, &rowsSaved);
+  if (!bPaired) {
+    m_ctx.emitError(Twine(kCannotPairStages) + entry + " and " + pairedEntry);
+    return nullptr;
+  }
+  if (packSearchLimit > 0) {
+    m_ctx.emitWarning(Twine("Packing searched with ") + entry + " and " +
+                      pairedEntry + " saves " + Twine(rowsSaved) +
+                      " signature rows");
+  }
+  return pM;
+}
+
+//------------------------------------------------------------------------------
+//
+// Pipeline signature linking.
+//
+
+namespace {
+
+// Operand of the signature element ID in the ops that access one.
+const unsigned kSigIdOpIdx = 1;
+
+bool IsInputElementOp(DXIL::OpCode opcode) {
+  switch (opcode) {
+  case DXIL::OpCode::LoadInput:
+  case DXIL::OpCode::EvalSnapped:
+  case DXIL::OpCode::EvalSampleIndex:
+  case DXIL::OpCode::EvalCentroid:
+  case DXIL::OpCode::AttributeAtVertex:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Collects the calls that load inputs or store outputs. Returns false if one
+// of them doesn't name its element with a constant.
+bool CollectElementOps(Module &M, bool bInputs,
+                       std::vector<CallInst *> &elementOps) {
+  for (Function &F : M.functions()) {
+    if (!OP::IsDxilOpFunc(&F))
+      continue;
+    for (User *U : F.users()) {
+      CallInst *CI = cast<CallInst>(U);
+      DXIL::OpCode opcode = OP::GetDxilOpFuncCallInst(CI);
+      if (bInputs ? !IsInputElementOp(opcode)
+                  : opcode != DXIL::OpCode::StoreOutput)
+        continue;
+      if (!isa<ConstantInt>(CI->getArgOperand(kSigIdOpIdx)))
+        return false;
+      elementOps.emplace_back(CI);
+    }
+  }
+  return true;
+}
+
+unsigned GetElementID(CallInst *CI) {
+  return cast<ConstantInt>(CI->getArgOperand(kSigIdOpIdx))->getLimitedValue();
+}
+
+// Points the ops at the renumbered elements, and removes the stores to
+// elements that are gone.
+void RemapElementOps(ArrayRef<CallInst *> elementOps,
+                     const std::vector<unsigned> &newIDs, hlsl::OP *hlslOP) {
+  for (CallInst *CI : elementOps) {
+    unsigned newID = newIDs[GetElementID(CI)];
+    if (newID == DxilSignatureElement::kUndefinedID) {
+      DXASSERT(OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::StoreOutput),
+               "else an element that is read was removed");
+      CI->eraseFromParent();
+      continue;
+    }
+    CI->setArgOperand(kSigIdOpIdx, hlslOP->GetU32Const(newID));
+  }
+}
+
+bool IsSameSemantic(const DxilSignatureElement &SE0,
+                    const DxilSignatureElement &SE) {
+  return SE0.GetKind() == SE.GetKind() &&
+         SE0.GetSemanticName().equals_lower(SE.GetSemanticName()) &&
+         SE0.GetSemanticIndexVec() == SE.GetSemanticIndexVec();
+}
+
+DxilSignatureAllocator::DummyElement
+GetPackElement(DxilSignatureElement &SE, bool bUseMinPrecision) {
+  DxilPackElement PE(&SE, bUseMinPrecision);
+  DxilSignatureAllocator::DummyElement Elt(SE.GetID());
+  Elt.rows = PE.GetRows();
+  Elt.cols = PE.GetCols();
+  Elt.kind = PE.GetKind();
+  Elt.interpolation = PE.GetInterpolationMode();
+  Elt.interpretation = PE.GetInterpretation();
+  Elt.dataBitWidth = PE.GetDataBitWidth();
+  return Elt;
+}
+
+typedef DxilSignatureAllocator::DummyElement PipelinePackElement;
+
+// Locations of the elements of a pipeline pair, indexed by element ID.
+struct PipelinePacking {
+  std::vector<PipelinePackElement> Inputs, Outputs;
+  unsigned RowsUsed = 0; // By the larger of the two signatures.
+};
+
+// Packs the elements that a pipeline pair keeps. Inputs are packed first,
+// each with room for the whole output it comes from. The outputs that are
+// read then go where they are read from, and the rest are packed around
+// them.
+class PipelinePacker {
+public:
+  PipelinePacker(DxilSignature &Inputs, DxilSignature &Outputs,
+                 const std::vector<bool> &bRemoveInput,
+                 const std::vector<bool> &bRemoveOutput,
+                 const std::vector<unsigned> &InputSources)
+      : m_Inputs(Inputs), m_Outputs(Outputs), m_bRemoveInput(bRemoveInput),
+        m_bRemoveOutput(bRemoveOutput), m_InputSources(InputSources) {
+    for (unsigned i = 0; i < bRemoveInput.size(); ++i) {
+      if (!IsPackedInput(i))
+        continue;
+      PipelinePackElement Elt = GetInput(i);
+      m_InputComponents += Elt.rows * Elt.cols;
+      m_bClipCullInputs |= Elt.kind == DXIL::SemanticKind::ClipDistance ||
+                           Elt.kind == DXIL::SemanticKind::CullDistance;
+      ++m_PackedInputCount;
+    }
+  }
+
+  unsigned GetPackedInputCount() const { return m_PackedInputCount; }
+  bool HasClipCullInputs() const { return m_bClipCullInputs; }
+  // No packing of the inputs uses fewer rows than this.
+  unsigned GetMinRows() const { return (m_InputComponents + 3) / 4; }
+
+  // Packs the inputs in the given order of the packed inputs, or with
+  // PackOptimized if there is none. Returns false if an element doesn't fit.
+  bool Pack(const std::vector<unsigned> *pInputOrder,
+            PipelinePacking &Packing) {
+    unsigned numInputs = m_bRemoveInput.size();
+    unsigned numOutputs = m_bRemoveOutput.size();
+    Packing.Inputs.assign(numInputs, PipelinePackElement());
+    Packing.Outputs.assign(numOutputs, PipelinePackElement());
+    Packing.RowsUsed = 0;
+
+    std::vector<DxilSignatureAllocator::PackElement *> elements;
+    for (unsigned i = 0; i < numInputs; ++i) {
+      if (!IsPackedInput(i))
+        continue;
+      Packing.Inputs[i] = GetInput(i);
+      elements.emplace_back(&Packing.Inputs[i]);
+    }
+    DxilSignatureAllocator inputAlloc(32, m_Inputs.UseMinPrecision());
+    if (pInputOrder) {
+      std::vector<DxilSignatureAllocator::PackElement *> ordered;
+      for (unsigned idx : *pInputOrder)
+        ordered.emplace_back(elements[idx]);
+      inputAlloc.PackGreedy(ordered, 0, 32);
+    } else {
+      inputAlloc.PackOptimized(elements, 0, 32);
+    }
+    if (!CountRows(elements, Packing.RowsUsed))
+      return false;
+
+    DxilSignatureAllocator outputAlloc(32, m_Outputs.UseMinPrecision());
+    std::vector<bool> bOutputPlaced(numOutputs, false);
+    for (unsigned i = 0; i < numInputs; ++i) {
+      unsigned o = m_InputSources[i];
+      if (o == DxilSignatureElement::kUndefinedID ||
+          !Packing.Inputs[i].IsAllocated())
+        continue;
+      PipelinePackElement &Out = Packing.Outputs[o];
+      Out = GetPackElement(m_Outputs.GetElement(o),
+                           m_Outputs.UseMinPrecision());
+      unsigned row = Packing.Inputs[i].GetStartRow();
+      unsigned col = Packing.Inputs[i].GetStartCol();
+      if (outputAlloc.DetectRowConflict(&Out, row) ||
+          outputAlloc.DetectColConflict(&Out, row, col))
+        return false;
+      outputAlloc.PlaceElement(&Out, row, col);
+      Out.SetLocation(row, col);
+      bOutputPlaced[o] = true;
+    }
+    elements.clear();
+    for (unsigned o = 0; o < numOutputs; ++o) {
+      DxilSignatureElement &Out = m_Outputs.GetElement(o);
+      if (m_bRemoveOutput[o] || bOutputPlaced[o] ||
+          !DxilSignature::ShouldBeAllocated(Out.GetInterpretation()))
+        continue;
+      Packing.Outputs[o] = GetPackElement(Out, m_Outputs.UseMinPrecision());
+      elements.emplace_back(&Packing.Outputs[o]);
+    }
+    outputAlloc.PackOptimized(elements, 0, 32);
+    if (!CountRows(elements, Packing.RowsUsed))
+      return false;
+    for (const PipelinePackElement &Out : Packing.Outputs) {
+      if (Out.IsAllocated())
+        Packing.RowsUsed =
+            std::max(Packing.RowsUsed, Out.GetStartRow() + Out.GetRows());
+    }
+    return true;
+  }
+
+private:
+  bool IsPackedInput(unsigned i) const {
+    return !m_bRemoveInput[i] && DxilSignature::ShouldBeAllocated(
+                                     m_Inputs.GetElement(i).GetInterpretation());
+  }
+
+  PipelinePackElement GetInput(unsigned i) const {
+    PipelinePackElement Elt =
+        GetPackElement(m_Inputs.GetElement(i), m_Inputs.UseMinPrecision());
+    if (m_InputSources[i] != DxilSignatureElement::kUndefinedID)
+      Elt.cols = m_Outputs.GetElement(m_InputSources[i]).GetCols();
+    return Elt;
+  }
+
+  // Adds the rows of the elements to rowsUsed. Returns false if one of them
+  // wasn't allocated.
+  static bool
+  CountRows(const std::vector<DxilSignatureAllocator::PackElement *> &elements,
+            unsigned &rowsUsed) {
+    for (DxilSignatureAllocator::PackElement *Elt : elements) {
+      if (!Elt->IsAllocated())
+        return false;
+      rowsUsed = std::max(rowsUsed, Elt->GetStartRow() + Elt->GetRows());
+    }
+    return true;
+  }
+
+  DxilSignature &m_Inputs;
+  DxilSignature &m_Outputs;
+  const std::vector<bool> &m_bRemoveInput;
+  const std::vector<bool> &m_bRemoveOutput;
+  const std::vector<unsigned> &m_InputSources;
+  unsigned m_InputComponents = 0;
+  unsigned m_PackedInputCount = 0;
+  bool m_bClipCullInputs = false;
+};
+
+// Decides whether values of a vertex or domain shader are the same for every
+// vertex of a primitive. They are when computed from constants and cbuffers,
+// the instance of a vertex shader, or the patch of a domain shader alone;
+// phis and memory are never trusted.
+class PrimitiveUniformity {
+public:
+  PrimitiveUniformity(DxilModule &DM) : m_DM(DM) {}
+  bool IsUniform(Value *V);
+
+private:
+  bool IsUniformOp(CallInst *CI);
+
+  DxilModule &m_DM;
+  DenseMap<Value *, bool> m_Uniform;
+};
+
+bool PrimitiveUniformity::IsUniform(Value *V) {
+  if (isa<Constant>(V))
+    return !isa<UndefValue>(V);
+  Instruction *I = dyn_cast<Instruction>(V);
+  if (!I)
+    return false;
+  auto It = m_Uniform.find(I);
+  if (It != m_Uniform.end())
+    return It->second;
+  // Cycles go through phis, which aren't uniform.
+  m_Uniform[I] = false;
+
+  bool bUniform = false;
+  if (CallInst *CI = dyn_cast<CallInst>(I)) {
+    bUniform = IsUniformOp(CI);
+  } else if (isa<BinaryOperator>(I) || isa<CastInst>(I) || isa<CmpInst>(I) ||
+             isa<SelectInst>(I) || isa<ExtractValueInst>(I) ||
+             isa<ExtractElementInst>(I) || isa<InsertElementInst>(I) ||
+             isa<ShuffleVectorInst>(I)) {
+    bUniform = true;
+    for (Value *Op : I->operands())
+      bUniform &= IsUniform(Op);
+  }
+  m_Uniform[I] = bUniform;
+  return bUniform;
+}
+
+bool PrimitiveUniformity::IsUniformOp(CallInst *CI) {
+  if (!OP::IsDxilOpFuncCallInst(CI))
+    return false;
+  DXIL::OpCode opcode = OP::GetDxilOpFuncCallInst(CI);
+  const ShaderModel *pSM = m_DM.GetShaderModel();
+  switch (opcode) {
+  case DXIL::OpCode::LoadInput: {
+    DxilInst_LoadInput LI(CI);
+    ConstantInt *ID = dyn_cast<ConstantInt>(LI.get_inputSigId());
+    return pSM->IsVS() && ID &&
+           m_DM.GetInputSignature().GetElement(ID->getLimitedValue())
+                   .GetKind() == Semantic::Kind::InstanceID;
+  }
+  case DXIL::OpCode::LoadPatchConstant:
+  case DXIL::OpCode::PrimitiveID:
+    if (!pSM->IsDS())
+      return false;
+    break;
+  default:
+    switch (OP::GetOpCodeClass(opcode)) {
+    case DXIL::OpCodeClass::Unary:
+    case DXIL::OpCodeClass::UnaryBits:
+    case DXIL::OpCodeClass::IsSpecialFloat:
+    case DXIL::OpCodeClass::Binary:
+    case DXIL::OpCodeClass::BinaryWithCarryOrBorrow:
+    case DXIL::OpCodeClass::BinaryWithTwoOuts:
+    case DXIL::OpCodeClass::Tertiary:
+    case DXIL::OpCodeClass::Quaternary:
+    case DXIL::OpCodeClass::Dot2:
+    case DXIL::OpCodeClass::Dot3:
+    case DXIL::OpCodeClass::Dot4:
+    case DXIL::OpCodeClass::MakeDouble:
+    case DXIL::OpCodeClass::SplitDouble:
+    case DXIL::OpCodeClass::LegacyF16ToF32:
+    case DXIL::OpCodeClass::LegacyF32ToF16:
+    case DXIL::OpCodeClass::CBufferLoad:
+    case DXIL::OpCodeClass::CBufferLoadLegacy:
+    case DXIL::OpCodeClass::CreateHandle:
+      break;
+    default:
+      return false;
+    }
+  }
+  for (Value *Arg : CI->arg_operands()) {
+    if (!IsUniform(Arg))
+      return false;
+  }
+  return true;
+}
+
+// Finds the outputs that are the same for every vertex of a primitive: every
+// component has a single store, of a uniform value, that runs on every path.
+std::vector<bool> FindFlatOutputs(DxilModule &Producer,
+                                  ArrayRef<CallInst *> storeOps) {
+  DxilSignature &Outputs = Producer.GetOutputSignature();
+  unsigned numOutputs = Outputs.GetElements().size();
+  std::vector<bool> bFlat(numOutputs, true);
+  std::vector<std::set<unsigned>> stored(numOutputs);
+
+  Function *Entry = Producer.GetEntryFunction();
+  DominatorTree DT;
+  DT.recalculate(*Entry);
+  SmallVector<BasicBlock *, 4> returns;
+  for (BasicBlock &BB : *Entry) {
+    if (isa<ReturnInst>(BB.getTerminator()))
+      returns.push_back(&BB);
+  }
+
+  PrimitiveUniformity Uniformity(Producer);
+  for (CallInst *CI : storeOps) {
+    unsigned o = GetElementID(CI);
+    if (!bFlat[o])
+      continue;
+    DxilInst_StoreOutput Store(CI);
+    ConstantInt *Row = dyn_cast<ConstantInt>(Store.get_rowIndex());
+    ConstantInt *Col = dyn_cast<ConstantInt>(Store.get_colIndex());
+    bool bAlways = CI->getParent()->getParent() == Entry;
+    for (BasicBlock *BB : returns)
+      bAlways = bAlways && DT.dominates(CI->getParent(), BB);
+    if (!Row || !Col || !bAlways || !Uniformity.IsUniform(Store.get_value()) ||
+        !stored[o]
+             .insert((Row->getLimitedValue() << 8) | Col->getLimitedValue())
+             .second)
+      bFlat[o] = false;
+  }
+  for (unsigned o = 0; o < numOutputs; ++o) {
+    DxilSignatureElement &Out = Outputs.GetElement(o);
+    if (stored[o].size() != Out.GetRows() * Out.GetCols())
+      bFlat[o] = false;
+  }
+  return bFlat;
+}
+
+// Drops code made dead by removed outputs, and brings the metadata that is
+// derived from signatures up to date.
+void FinishPipelineSignatures(DxilModule &DM) {
+  legacy::PassManager PM;
+  PM.add(createDeadCodeEliminationPass());
+  PM.add(createComputeViewIdStatePass());
+  PM.run(*DM.GetModule());
+  DM.MarkDxilMetadataDirty(DxilModule::kMDViewIdState);
+  DM.ReEmitDxilResources();
+}
+
+} // namespace
+
 namespace hlsl {
 
+bool LinkPipelineSignatures(DxilModule &Producer, DxilModule &Consumer,
+                            unsigned packSearchLimit, unsigned *pRowsSaved) {
+  const ShaderModel *pProducerSM = Producer.GetShaderModel();
+  if (!Consumer.GetShaderModel()->IsPS() ||
+      !(pProducerSM->IsVS() || pProducerSM->IsDS()))
+    return false;
+
+  DxilSignature &Outputs = Producer.GetOutputSignature();
+  DxilSignature &Inputs = Consumer.GetInputSignature();
+  unsigned numOutputs = Outputs.GetElements().size();
+  unsigned numInputs = Inputs.GetElements().size();
+
+  std::vector<CallInst *> storeOps, loadOps;
+  if (!CollectElementOps(*Producer.GetModule(), /*bInputs*/ false, storeOps) ||
+      !CollectElementOps(*Consumer.GetModule(), /*bInputs*/ true, loadOps))
+    return false;
+
+  std::vector<bool> bInputRead(numInputs, false);
+  for (CallInst *CI : loadOps)
+    bInputRead[GetElementID(CI)] = true;
+
+  // Arbitrary inputs are kept if they are read; system values may change how
+  // the pixel shader runs, so they always are. Each arbitrary input must come
+  // from an output of the same shape.
+  std::vector<bool> bRemoveInput(numInputs, false);
+  std::vector<bool> bRemoveOutput(numOutputs, true);
+  std::vector<unsigned> inputSources(numInputs,
+                                     DxilSignatureElement::kUndefinedID);
+  for (unsigned i = 0; i < numInputs; ++i) {
+    DxilSignatureElement &In = Inputs.GetElement(i);
+    if (In.IsArbitrary() && !bInputRead[i]) {
+      bRemoveInput[i] = true;
+      continue;
+    }
+    for (unsigned o = 0; o < numOutputs; ++o) {
+      if (IsSameSemantic(Outputs.GetElement(o), In)) {
+        inputSources[i] = o;
+        break;
+      }
+    }
+    if (inputSources[i] == DxilSignatureElement::kUndefinedID) {
+      if (In.IsArbitrary())
+        return false;
+      continue;
+    }
+    DxilSignatureElement &Out = Outputs.GetElement(inputSources[i]);
+    if (Out.GetRows() != In.GetRows() || Out.GetCols() < In.GetCols())
+      return false;
+    bRemoveOutput[inputSources[i]] = false;
+  }
+  // The rasterizer reads system values.
+  for (unsigned o = 0; o < numOutputs; ++o) {
+    if (!Outputs.GetElement(o).IsArbitrary())
+      bRemoveOutput[o] = false;
+  }
+
+  // An arbitrary input that is the same at every vertex of a primitive needs
+  // no interpolating, so both sides become nointerpolation before packing.
+  // Evaluation needs an interpolated input, and sample interpolation makes
+  // the pixel shader run per sample, so those inputs keep their mode.
+  std::vector<bool> bInputEvaluated(numInputs, false);
+  for (CallInst *CI : loadOps) {
+    if (!OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::LoadInput))
+      bInputEvaluated[GetElementID(CI)] = true;
+  }
+  std::vector<bool> bFlatOutput = FindFlatOutputs(Producer, storeOps);
+  for (unsigned i = 0; i < numInputs; ++i) {
+    DxilSignatureElement &In = Inputs.GetElement(i);
+    const InterpolationMode *pMode = In.GetInterpolationMode();
+    if (bRemoveInput[i] || !In.IsArbitrary() || bInputEvaluated[i] ||
+        !In.GetCompType().IsFloatTy() || pMode->IsConstant() ||
+        pMode->IsAnySample() || !bFlatOutput[inputSources[i]])
+      continue;
+    In.SetInterpolationMode(InterpolationMode::Kind::Constant);
+    Outputs.GetElement(inputSources[i])
+        .SetInterpolationMode(InterpolationMode::Kind::Constant);
+  }
+
+  PipelinePacker Packer(Inputs, Outputs, bRemoveInput, bRemoveOutput,
+                        inputSources);
+  PipelinePacking Packing;
+  if (!Packer.Pack(nullptr, Packing))
+    return false;
+  if (pRowsSaved)
+    *pRowsSaved = 0;
+
+  // Search other input orders for a packing that uses fewer rows. The
+  // search is bounded by attempts rather than time, so that both links of
+  // the pair find the same packing. Clip and cull distances have placement
+  // rules that only PackOptimized knows, so they aren't searched.
+  unsigned minRows = Packer.GetMinRows();
+  if (packSearchLimit > 0 && !Packer.HasClipCullInputs() &&
+      Packing.RowsUsed > minRows) {
+    unsigned defaultRows = Packing.RowsUsed;
+    std::vector<unsigned> order(Packer.GetPackedInputCount());
+    for (unsigned i = 0; i < order.size(); ++i)
+      order[i] = i;
+    std::mt19937 gen;
+    for (unsigned attempt = 0; attempt < packSearchLimit; ++attempt) {
+      if (attempt > 0) {
+        // The shuffle only uses the engine's output, which is the same in
+        // every implementation.
+        for (unsigned i = order.size(); i > 1; --i)
+          std::swap(order[i - 1], order[gen() % i]);
+      }
+      PipelinePacking Trial;
+      if (Packer.Pack(&order, Trial) && Trial.RowsUsed < Packing.RowsUsed) {
+        std::swap(Packing, Trial);
+        if (Packing.RowsUsed == minRows)
+          break;
+      }
+    }
+    if (pRowsSaved)
+      *pRowsSaved = defaultRows - Packing.RowsUsed;
+  }
+  std::vector<PipelinePackElement> &inputElts = Packing.Inputs;
+  std::vector<PipelinePackElement> &outputElts = Packing.Outputs;
+
+  // Both stages pair; apply the new locations and remove what isn't used.
+  for (unsigned i = 0; i < numInputs; ++i) {
+    if (inputElts[i].IsAllocated()) {
+      Inputs.GetElement(i).SetStartRow(inputElts[i].GetStartRow());
+      Inputs.GetElement(i).SetStartCol(inputElts[i].GetStartCol());
+    }
+  }
+  for (unsigned o = 0; o < numOutputs; ++o) {
+    if (outputElts[o].IsAllocated()) {
+      Outputs.GetElement(o).SetStartRow(outputElts[o].GetStartRow());
+      Outputs.GetElement(o).SetStartCol(outputElts[o].GetStartCol());
+    }
+  }
+  RemapElementOps(loadOps, Inputs.RemoveElements(bRemoveInput),
+                  Consumer.GetOP());
+  RemapElementOps(storeOps, Outputs.RemoveElements(bRemoveOutput),
+                  Producer.GetOP());
+
+  FinishPipelineSignatures(Producer);
+  FinishPipelineSignatures(Consumer);
+  return true;
+}
+
 DxilLinker *DxilLinker::CreateLinker(LLVMContext &Ctx, unsigned valMajor, unsigned valMinor) {
   return new DxilLinkerImpl(Ctx, valMajor, valMinor);
 }
@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilMergeIdenticalFunctions.cpp                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Merges the identical functions of a DXIL library.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilTypeSystem.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Template instantiations and per-material shaders often compile to the same
+// code under different names. Of each set of identical functions, the one
+// first by name keeps the body, and the others:
+// - if internal, are replaced by it and removed;
+// - otherwise, keep their name and become thunks that call it.
+// DXIL has no aliases, so exports are always thunks.
+//
+// A shader can't be called, so when a set has one, the body moves to a new
+// internal function that every member, shaders included, calls. Functions
+// only match with the same type, so calls never need bitcasts, and tiny ones
+// aren't merged since a thunk is no smaller. Bodies don't move with debug
+// info, as their scopes would describe the wrong function.
+
+namespace {
+
+// Decides whether two functions compute the same thing, mapping the values
+// of one to those of the other.
+class FunctionMatcher {
+  Function *m_L, *m_R;
+  DenseMap<const Value *, const Value *> m_LToR, m_RToL;
+
+  bool Match(const Value *L, const Value *R);
+
+public:
+  FunctionMatcher(Function *L, Function *R) : m_L(L), m_R(R) {}
+  bool Match();
+};
+
+bool FunctionMatcher::Match(const Value *L, const Value *R) {
+  if (L == m_L || R == m_R)
+    return L == m_L && R == m_R; // Recursion.
+  if (isa<Constant>(L) || isa<Constant>(R) || isa<MetadataAsValue>(L) ||
+      isa<MetadataAsValue>(R))
+    return L == R;
+  auto LIt = m_LToR.find(L);
+  auto RIt = m_RToL.find(R);
+  if (LIt != m_LToR.end() || RIt != m_RToL.end())
+    return LIt != m_LToR.end() && LIt->second == R;
+  m_LToR[L] = R;
+  m_RToL[R] = L;
+  return true;
+}
+
+bool FunctionMatcher::Match() {
+  if (m_L->getFunctionType() != m_R->getFunctionType() ||
+      m_L->getAttributes() != m_R->getAttributes() ||
+      m_L->getCallingConv() != m_R->getCallingConv() ||
+      m_L->size() != m_R->size())
+    return false;
+  for (auto LA = m_L->arg_begin(), RA = m_R->arg_begin(); LA != m_L->arg_end();
+       ++LA, ++RA)
+    Match(LA, RA);
+
+  for (auto LB = m_L->begin(), RB = m_R->begin(); LB != m_L->end();
+       ++LB, ++RB) {
+    if (LB->size() != RB->size() || !Match(LB, RB))
+      return false;
+    for (auto LI = LB->begin(), RI = RB->begin(); LI != LB->end();
+         ++LI, ++RI) {
+      if (!LI->isSameOperationAs(RI) ||
+          LI->getRawSubclassOptionalData() !=
+              RI->getRawSubclassOptionalData() ||
+          !Match(LI, RI))
+        return false;
+      for (unsigned i = 0; i < LI->getNumOperands(); ++i) {
+        if (!Match(LI->getOperand(i), RI->getOperand(i)))
+          return false;
+      }
+      if (const PHINode *LPhi = dyn_cast<PHINode>(LI)) {
+        const PHINode *RPhi = cast<PHINode>(RI);
+        for (unsigned i = 0; i < LPhi->getNumIncomingValues(); ++i) {
+          if (!Match(LPhi->getIncomingBlock(i), RPhi->getIncomingBlock(i)))
+            return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// A hash that identical functions share.
+hash_code HashFunction(const Function &F) {
+  hash_code H = hash_combine(F.getFunctionType(), F.size());
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB)
+      H = hash_combine(H, I.getOpcode(), I.getType(), I.getNumOperands());
+  }
+  return H;
+}
+
+class DxilMergeIdenticalFunctions : public ModulePass {
+  bool m_Report;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilMergeIdenticalFunctions(bool Report = false)
+      : ModulePass(ID), m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL merge identical functions";
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  bool MergeRound(DxilModule &DM, bool bDebugInfo);
+  bool MergeSet(DxilModule &DM, ArrayRef<Function *> Set, bool bDebugInfo);
+};
+
+// Replaces the body of F by a call of Target.
+void MakeThunk(Function *F, Function *Target) {
+  F->dropAllReferences();
+  BasicBlock *BB = BasicBlock::Create(F->getContext(), "entry", F);
+  IRBuilder<> Builder(BB);
+  SmallVector<Value *, 8> Args;
+  for (Argument &A : F->args())
+    Args.push_back(&A);
+  CallInst *CI = Builder.CreateCall(Target, Args);
+  CI->setCallingConv(Target->getCallingConv());
+  if (F->getReturnType()->isVoidTy())
+    Builder.CreateRetVoid();
+  else
+    Builder.CreateRet(CI);
+}
+
+bool DxilMergeIdenticalFunctions::MergeSet(DxilModule &DM,
+                                           ArrayRef<Function *> Set,
+                                           bool bDebugInfo) {
+  Function *Keep = Set.front();
+  bool bHasShader = false;
+  for (Function *F : Set)
+    bHasShader |= DM.HasDxilFunctionProps(F);
+  if (bHasShader && bDebugInfo)
+    return false;
+
+  DxilTypeSystem &TypeSys = DM.GetTypeSystem();
+  Function *Body = Keep;
+  if (bHasShader) {
+    Body = Function::Create(Keep->getFunctionType(),
+                            GlobalValue::InternalLinkage,
+                            Keep->getName() + ".merged", Keep->getParent());
+    Body->copyAttributesFrom(Keep);
+    Body->getBasicBlockList().splice(Body->begin(),
+                                     Keep->getBasicBlockList());
+    for (auto KA = Keep->arg_begin(), BA = Body->arg_begin();
+         KA != Keep->arg_end(); ++KA, ++BA) {
+      BA->takeName(KA);
+      KA->replaceAllUsesWith(BA);
+    }
+    TypeSys.CopyFunctionAnnotation(Body, Keep, TypeSys);
+    MakeThunk(Keep, Body);
+  }
+
+  for (Function *F : Set.slice(1)) {
+    if (m_Report)
+      F->getContext().emitWarning(dxilutil::FormatMessageWithoutLocation(
+          "function " + dxilutil::DemangleFunctionName(F->getName()) +
+          " is identical to " +
+          dxilutil::DemangleFunctionName(Keep->getName()) +
+          (F->hasLocalLinkage() ? ", and was removed"
+                                : ", and now calls it")));
+    if (F->hasLocalLinkage()) {
+      F->replaceAllUsesWith(Body);
+      TypeSys.EraseFunctionAnnotation(F);
+      F->eraseFromParent();
+    } else {
+      MakeThunk(F, Body);
+    }
+  }
+  return true;
+}
+
+bool DxilMergeIdenticalFunctions::MergeRound(DxilModule &DM, bool bDebugInfo) {
+  std::vector<Function *> Candidates;
+  for (Function &F : DM.GetModule()->functions()) {
+    // Hull shaders refer to their patch constant functions.
+    if (F.isDeclaration() || OP::IsDxilOpFunc(&F) ||
+        DM.IsPatchConstantShader(&F))
+      continue;
+    // A thunk would be no smaller.
+    if (F.size() == 1 && F.front().size() <= 2)
+      continue;
+    Candidates.push_back(&F);
+  }
+  std::sort(Candidates.begin(), Candidates.end(),
+            [](const Function *L, const Function *R) {
+              return L->getName() < R->getName();
+            });
+
+  std::map<hash_code, std::vector<Function *>> Buckets;
+  for (Function *F : Candidates)
+    Buckets[HashFunction(*F)].push_back(F);
+
+  bool bChanged = false;
+  for (auto &Bucket : Buckets) {
+    std::vector<Function *> &Fns = Bucket.second;
+    while (Fns.size() > 1) {
+      SmallVector<Function *, 4> Set;
+      std::vector<Function *> Rest;
+      Set.push_back(Fns.front());
+      for (Function *F : makeArrayRef(Fns).slice(1)) {
+        if (FunctionMatcher(Set.front(), F).Match())
+          Set.push_back(F);
+        else
+          Rest.push_back(F);
+      }
+      if (Set.size() > 1)
+        bChanged |= MergeSet(DM, Set, bDebugInfo);
+      Fns.swap(Rest);
+    }
+  }
+  return bChanged;
+}
+
+bool DxilMergeIdenticalFunctions::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  if (!DM.GetShaderModel()->IsLib())
+    return false;
+  bool bDebugInfo = M.getNamedMetadata("llvm.dbg.cu") != nullptr;
+
+  // Merging callees can make their callers identical.
+  bool bChanged = false;
+  while (MergeRound(DM, bDebugInfo))
+    bChanged = true;
+  return bChanged;
+}
+
+}
+
+char DxilMergeIdenticalFunctions::ID = 0;
+
+ModulePass *llvm::createDxilMergeIdenticalFunctionsPass(bool Report) {
+  return new DxilMergeIdenticalFunctions(Report);
+}
+
+INITIALIZE_PASS(DxilMergeIdenticalFunctions, "dxil-merge-identical-functions",
+                "DXIL merge identical functions", false, false)
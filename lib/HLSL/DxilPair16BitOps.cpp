@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPair16BitOps.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Places independent 16-bit operations of the same kind next to each other. //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/InstrTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Hardware with packed 16-bit math runs two half or int16 operations of the
+// same kind as one 2-wide instruction. DXIL has no vector operations, so it
+// is the driver compiler that pairs the scalar ones, and it mostly looks for
+// pairs close to each other. With native 16-bit types, this pass finds for
+// each 16-bit operation the closest earlier one of the same kind that it
+// doesn't depend on, and moves it right after it, along with the operands it
+// computes in between. Only operations that don't touch memory are moved, and
+// only within a block, so the program is the same but for the order.
+//
+// Operations of the same kind are binary operators with the same opcode, and
+// calls to the same DXIL operation that don't access memory, of the same
+// 16-bit scalar type. Each operation is paired at most once.
+
+namespace {
+
+// How far apart two operations may be, in instructions, to be paired.
+static const unsigned kMaxDistance = 64;
+// How many operands may move along with an operation.
+static const unsigned kMaxMovedOperands = 16;
+
+class DxilPair16BitOps : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilPair16BitOps() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL pair 16-bit operations";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  typedef std::pair<unsigned, Type *> OpKind;
+  SmallPtrSet<Instruction *, 32> m_Paired;
+
+  static bool GetKind(Instruction *I, OpKind &Kind);
+  static bool IsMovable(Instruction *I);
+  bool TryPair(Instruction *First, Instruction *Second);
+};
+
+bool DxilPair16BitOps::IsMovable(Instruction *I) {
+  return !isa<PHINode>(I) && !isa<TerminatorInst>(I) &&
+         !I->mayReadOrWriteMemory() && !I->mayHaveSideEffects();
+}
+
+// Gets the kind of a 16-bit operation that can be paired. Returns false for
+// other instructions.
+bool DxilPair16BitOps::GetKind(Instruction *I, OpKind &Kind) {
+  Type *Ty = I->getType();
+  if (!Ty->isHalfTy() && !Ty->isIntegerTy(16))
+    return false;
+  if (isa<BinaryOperator>(I)) {
+    Kind = OpKind(I->getOpcode(), Ty);
+    return true;
+  }
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI) || !CI->doesNotAccessMemory())
+    return false;
+  // Past the opcodes of instructions, so the two never mix.
+  Kind = OpKind(Instruction::OtherOpsEnd +
+                    (unsigned)OP::GetDxilOpFuncCallInst(CI),
+                Ty);
+  return true;
+}
+
+// Moves Second right after First, if Second doesn't depend on First. The
+// operands of Second computed between the two move before First.
+bool DxilPair16BitOps::TryPair(Instruction *First, Instruction *Second) {
+  SmallPtrSet<Instruction *, 32> Between;
+  unsigned Distance = 0;
+  for (Instruction *I = First->getNextNode(); I != Second;
+       I = I->getNextNode()) {
+    if (I == nullptr || ++Distance > kMaxDistance)
+      return false;
+    Between.insert(I);
+  }
+  if (Between.empty())
+    return true;
+
+  SmallPtrSet<Instruction *, 16> Moved;
+  SmallVector<Instruction *, 16> Worklist;
+  Worklist.push_back(Second);
+  while (!Worklist.empty()) {
+    Instruction *I = Worklist.pop_back_val();
+    for (Value *Op : I->operands()) {
+      Instruction *OpI = dyn_cast<Instruction>(Op);
+      if (OpI == First)
+        return false;
+      if (!OpI || !Between.count(OpI) || Moved.count(OpI))
+        continue;
+      if (!IsMovable(OpI) || m_Paired.count(OpI) ||
+          Moved.size() == kMaxMovedOperands)
+        return false;
+      Moved.insert(OpI);
+      Worklist.push_back(OpI);
+    }
+  }
+
+  // Operands keep their order, so each still follows its own operands.
+  if (!Moved.empty()) {
+    SmallVector<Instruction *, 16> InOrder;
+    for (Instruction *I = First->getNextNode(); I != Second;
+         I = I->getNextNode()) {
+      if (Moved.count(I))
+        InOrder.push_back(I);
+    }
+    for (Instruction *I : InOrder)
+      I->moveBefore(First);
+  }
+  if (First->getNextNode() != Second)
+    Second->moveBefore(First->getNextNode());
+  return true;
+}
+
+bool DxilPair16BitOps::runOnFunction(Function &F) {
+  Module *M = F.getParent();
+  if (!M->HasDxilModule() || M->GetDxilModule().GetUseMinPrecision())
+    return false;
+
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    SmallVector<std::pair<Instruction *, OpKind>, 32> Candidates;
+    for (Instruction &I : BB) {
+      OpKind Kind;
+      if (IsMovable(&I) && GetKind(&I, Kind))
+        Candidates.push_back(std::make_pair(&I, Kind));
+    }
+    if (Candidates.size() < 2)
+      continue;
+
+    // The last operation of each kind still waiting for a pair.
+    DenseMap<OpKind, Instruction *> Waiting;
+    m_Paired.clear();
+    for (auto &Candidate : Candidates) {
+      Instruction *I = Candidate.first;
+      auto It = Waiting.find(Candidate.second);
+      if (It != Waiting.end() && TryPair(It->second, I)) {
+        m_Paired.insert(It->second);
+        m_Paired.insert(I);
+        Waiting.erase(It);
+        bChanged = true;
+        continue;
+      }
+      Waiting[Candidate.second] = I;
+    }
+  }
+  return bChanged;
+}
+
+}
+
+char DxilPair16BitOps::ID = 0;
+
+FunctionPass *llvm::createDxilPair16BitOpsPass() {
+  return new DxilPair16BitOps();
+}
+
+INITIALIZE_PASS(DxilPair16BitOps, "dxil-pair-16bit-ops",
+                "DXIL pair 16-bit operations", false, false)
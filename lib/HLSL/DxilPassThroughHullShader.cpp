@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPassThroughHullShader.cpp                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Turns a hull shader whose control-point phase only copies its input       //
+// control points into a pass-through hull shader.                           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// A hull shader without a control-point function is a pass-through one: each
+// output control point is the input control point of the same index, and the
+// output control-point signature is the input one. A control-point function
+// that, once optimized, stores every component of every output element with
+// the same component of an input element, read at SV_OutputControlPointID,
+// does the same thing, so its body is dropped and the driver may skip the
+// phase.
+//
+// The two signatures have to match already, element by element and in their
+// packed locations, since the domain shader reads the outputs at those
+// locations. The patch constant function is left alone; the output control
+// points it reads are the same either way.
+
+namespace {
+
+class DxilPassThroughHullShader : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilPassThroughHullShader() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL pass-through hull shader";
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  static bool IsSameElement(const DxilSignatureElement &In,
+                            const DxilSignatureElement &Out);
+  static bool IsIdentityCopy(DxilModule &DM, Function *F);
+};
+
+bool DxilPassThroughHullShader::IsSameElement(const DxilSignatureElement &In,
+                                              const DxilSignatureElement &Out) {
+  return In.IsAllocated() && Out.IsAllocated() &&
+         In.GetKind() == Out.GetKind() &&
+         In.GetSemanticName().equals_lower(Out.GetSemanticName()) &&
+         In.GetSemanticIndexVec() == Out.GetSemanticIndexVec() &&
+         In.GetCompType() == Out.GetCompType() &&
+         *In.GetInterpolationMode() == *Out.GetInterpolationMode() &&
+         In.GetRows() == Out.GetRows() && In.GetCols() == Out.GetCols() &&
+         In.GetStartRow() == Out.GetStartRow() &&
+         In.GetStartCol() == Out.GetStartCol();
+}
+
+// Returns true if F stores each output component exactly once, with the same
+// component of the matching input element of the current control point.
+bool DxilPassThroughHullShader::IsIdentityCopy(DxilModule &DM, Function *F) {
+  if (F->size() != 1)
+    return false;
+  DxilSignature &InputSig = DM.GetInputSignature();
+  DxilSignature &OutputSig = DM.GetOutputSignature();
+  if (InputSig.GetElements().size() != OutputSig.GetElements().size())
+    return false;
+
+  // Output element IDs to the input element IDs they copy.
+  DenseMap<unsigned, unsigned> Copied;
+  SmallSet<uint64_t, 16> Stored;
+  for (Instruction &I : F->getEntryBlock()) {
+    if (isa<ReturnInst>(&I) || isa<DbgInfoIntrinsic>(&I) ||
+        OP::IsDxilOpFuncCallInst(&I, DXIL::OpCode::OutputControlPointID))
+      continue;
+    DxilInst_StoreOutput Store(&I);
+    if (!Store) {
+      // Loads are checked through the stores that use them.
+      if (DxilInst_LoadInput(&I))
+        continue;
+      return false;
+    }
+    Instruction *Value = dyn_cast<Instruction>(Store.get_value());
+    if (!Value)
+      return false;
+    DxilInst_LoadInput Load(Value);
+    if (!Load)
+      return false;
+    Instruction *Vertex = dyn_cast<Instruction>(Load.get_gsVertexAxis());
+    if (!Vertex)
+      return false;
+    ConstantInt *OutId = dyn_cast<ConstantInt>(Store.get_outputSigId());
+    ConstantInt *OutRow = dyn_cast<ConstantInt>(Store.get_rowIndex());
+    ConstantInt *OutCol = dyn_cast<ConstantInt>(Store.get_colIndex());
+    ConstantInt *InId = dyn_cast<ConstantInt>(Load.get_inputSigId());
+    if (!OutId || !OutRow || !OutCol || !InId ||
+        Load.get_rowIndex() != Store.get_rowIndex() ||
+        Load.get_colIndex() != Store.get_colIndex() ||
+        !OP::IsDxilOpFuncCallInst(Vertex, DXIL::OpCode::OutputControlPointID))
+      return false;
+
+    unsigned OutIdV = OutId->getZExtValue();
+    unsigned InIdV = InId->getZExtValue();
+    if (OutIdV >= OutputSig.GetElements().size() ||
+        InIdV >= InputSig.GetElements().size())
+      return false;
+    auto It = Copied.insert(std::make_pair(OutIdV, InIdV)).first;
+    if (It->second != InIdV)
+      return false;
+    uint64_t Component = ((uint64_t)OutIdV << 40) |
+                         (OutRow->getZExtValue() << 8) | OutCol->getZExtValue();
+    if (!Stored.insert(Component).second)
+      return false;
+  }
+
+  // Every element copied whole from the input element at its location, and
+  // so every input element copied once.
+  if (Copied.size() != OutputSig.GetElements().size())
+    return false;
+  unsigned NumComponents = 0;
+  for (auto &It : Copied) {
+    const DxilSignatureElement &Out = OutputSig.GetElement(It.first);
+    if (!IsSameElement(InputSig.GetElement(It.second), Out))
+      return false;
+    NumComponents += Out.GetRows() * Out.GetCols();
+  }
+  return Stored.size() == NumComponents;
+}
+
+bool DxilPassThroughHullShader::runOnModule(Module &M) {
+  if (!M.HasDxilModule())
+    return false;
+  DxilModule &DM = M.GetDxilModule();
+  if (!DM.GetShaderModel()->IsHS())
+    return false;
+  Function *F = DM.GetEntryFunction();
+  if (!F || F->isDeclaration())
+    return false;
+
+  // Hold to what the validator accepts of a pass-through hull shader.
+  if (DM.GetInputControlPointCount() < DM.GetOutputControlPointCount())
+    return false;
+  unsigned NumScalars = 0;
+  for (auto &E : DM.GetOutputSignature().GetElements())
+    NumScalars += E->GetRows() * E->GetCols();
+  if (NumScalars * DM.GetOutputControlPointCount() >
+      DXIL::kMaxHSOutputControlPointsTotalScalars)
+    return false;
+
+  if (!IsIdentityCopy(DM, F))
+    return false;
+  F->deleteBody();
+  return true;
+}
+
+}
+
+char DxilPassThroughHullShader::ID = 0;
+
+ModulePass *llvm::createDxilPassThroughHullShaderPass() {
+  return new DxilPassThroughHullShader();
+}
+
+INITIALIZE_PASS(DxilPassThroughHullShader, "dxil-pass-through-hull-shader",
+                "DXIL pass-through hull shader", false, false)
@@ -34,10 +34,14 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Pass.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Transforms/Scalar.h"
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <tuple>
 #include <unordered_set>
 #include <functional>
 #include <unordered_map>
@@ -95,6 +99,90 @@ struct ShaderRecordEntry {
   bool IsInvalid() { return (unsigned int)ParameterType == (unsigned int)-1; }
 };
 
+// The shader record entries of a local root signature, indexed by binding.
+// When several root parameters cover a binding, the first one wins, as when
+// walking the root parameters in order.
+class ShaderRecordIndex {
+public:
+  // Adds a root constant or root descriptor at a single register.
+  void AddRegister(DXIL::ResourceClass resourceClass, unsigned int shaderRegister,
+                   unsigned int registerSpace, ShaderRecordEntry entry) {
+    RegisterKey key((unsigned int)resourceClass, registerSpace, shaderRegister);
+    m_registers.insert(std::make_pair(key, std::make_pair(m_order++, entry)));
+  }
+
+  // Adds a descriptor range. The entry's OffsetInDescriptors is the one of the
+  // range's first register.
+  void AddRange(DXIL::ResourceClass resourceClass, unsigned int baseRegister,
+                unsigned int numDescriptors, unsigned int registerSpace,
+                ShaderRecordEntry entry) {
+    Range range = { baseRegister, (uint64_t)baseRegister + numDescriptors, m_order++, entry };
+    m_ranges[SpaceKey((unsigned int)resourceClass, registerSpace)].push_back(range);
+  }
+
+  // Sorts the ranges; call once all entries are added.
+  void Finalize() {
+    for (auto &it : m_ranges) {
+      std::vector<Range> &ranges = it.second;
+      std::stable_sort(ranges.begin(), ranges.end(),
+                       [](const Range &a, const Range &b) { return a.Lower < b.Lower; });
+      uint64_t maxUpper = 0;
+      for (Range &range : ranges) {
+        maxUpper = std::max(maxUpper, range.Upper);
+        range.MaxUpper = maxUpper;
+      }
+    }
+  }
+
+  ShaderRecordEntry Find(DXIL::ResourceClass resourceClass, unsigned int shaderRegister,
+                         unsigned int registerSpace) const {
+    ShaderRecordEntry result = ShaderRecordEntry::InvalidEntry();
+    unsigned int resultOrder = UINT_MAX;
+
+    auto registerIt = m_registers.find(
+        RegisterKey((unsigned int)resourceClass, registerSpace, shaderRegister));
+    if (registerIt != m_registers.end()) {
+      resultOrder = registerIt->second.first;
+      result = registerIt->second.second;
+    }
+
+    auto rangesIt = m_ranges.find(SpaceKey((unsigned int)resourceClass, registerSpace));
+    if (rangesIt != m_ranges.end()) {
+      const std::vector<Range> &ranges = rangesIt->second;
+      auto end = std::upper_bound(ranges.begin(), ranges.end(), shaderRegister,
+                    [](unsigned int reg, const Range &range) { return reg < range.Lower; });
+      // Walk back over the ranges that start at or below the register, until
+      // none that comes earlier reaches it.
+      for (auto it = end; it != ranges.begin();) {
+        --it;
+        if (it->MaxUpper <= shaderRegister)
+          break;
+        if (it->Upper > shaderRegister && it->Order < resultOrder) {
+          resultOrder = it->Order;
+          result = it->Entry;
+          result.OffsetInDescriptors += shaderRegister - it->Lower;
+        }
+      }
+    }
+    return result;
+  }
+
+private:
+  typedef std::tuple<unsigned int, unsigned int, unsigned int> RegisterKey;
+  typedef std::pair<unsigned int, unsigned int> SpaceKey;
+  struct Range {
+    unsigned int Lower;
+    uint64_t Upper;
+    unsigned int Order;
+    ShaderRecordEntry Entry;
+    uint64_t MaxUpper; // Highest Upper of this and the ranges sorted before it.
+  };
+
+  unsigned int m_order = 0;
+  std::map<RegisterKey, std::pair<unsigned int, ShaderRecordEntry>> m_registers;
+  std::map<SpaceKey, std::vector<Range>> m_ranges;
+};
+
 struct D3D12_VERSIONED_ROOT_SIGNATURE_DESC;
 class DxilPatchShaderRecordBindings : public ModulePass {
 public:
@@ -109,6 +197,8 @@ private:
   void AddInputBinding(Module &M);
   void PatchShaderBindings(Module &M);
   void InitializeViewTable();
+  void InitializeResourceIndex(DxilModule &DM);
+  void InitializeShaderRecordIndex();
 
   unsigned int AddSRVRawBuffer(Module &M, unsigned int registerIndex, unsigned int registerSpace, const std::string &bufferName);
   unsigned int AddHandle(Module &M, unsigned int baseRegisterIndex, unsigned int rangeSize, unsigned int registerSpace, DXIL::ResourceClass resClass, DXIL::ResourceKind resKind, const std::string &bufferName, llvm::Type *type = nullptr, unsigned int constantBufferSize = 0);
@@ -152,7 +242,7 @@ private:
   // Unlike the LLVM version of this function, this does not requires the InstructionToReplace and the ValueToReplaceWith to be the same instruction type
   static void ReplaceUsesOfWith(llvm::Instruction *InstructionToReplace, llvm::Value *ValueToReplaceWith);
 
-  static ShaderRecordEntry FindRootSignatureDescriptor(const DxilVersionedRootSignatureDesc &rootSignatureDescriptor, unsigned int ShaderRecordIdentifierSizeInBytes, DXIL::ResourceClass resourceClass, unsigned int baseRegisterIndex, unsigned int registerSpace);
+  ShaderRecordEntry FindRootSignatureDescriptor(DXIL::ResourceClass resourceClass, unsigned int baseRegisterIndex, unsigned int registerSpace);
 
   // TODO: I would like to see these prefixed with m_
   llvm::Value *ShaderTableHandle = nullptr;
@@ -178,6 +268,11 @@ private:
   ShaderInfo *pInputShaderInfo;
   DxilVersionedRootSignatureDesc *pRootSignatureDesc;
   DXIL::ShaderKind ShaderKind;
+
+  // Indexed up front, so patching each handle is not a walk over all the
+  // resources and root parameters.
+  llvm::DenseMap<llvm::Value *, hlsl::DxilResourceBase *> m_resourceBySymbol;
+  ShaderRecordIndex m_shaderRecordIndex;
 };
 
 char DxilPatchShaderRecordBindings::ID = 0;
@@ -398,8 +493,11 @@ bool DxilPatchShaderRecordBindings::runOnModule(Module &M) {
 
   ValidateParameters();
   InitializeViewTable();
+  InitializeResourceIndex(DM);
+  InitializeShaderRecordIndex();
 
   PatchShaderBindings(M);
+  DM.MarkDxilMetadataDirty(DxilModule::kMDTypeSystem);
   DM.ReEmitDxilResources();
   return true;
 }
@@ -708,7 +806,6 @@ const unsigned int GetResolvedRangeID(DXIL::ResourceClass resClass, Value *range
   }
 }
 
-// TODO: This code is quite inefficient
 bool DxilPatchShaderRecordBindings::GetHandleInfo(
   Module &M,
   DxilInst_CreateHandleForLib &createHandleStructForLib,
@@ -718,65 +815,12 @@ bool DxilPatchShaderRecordBindings::GetHandleInfo(
   _Out_ DXIL::ResourceClass &resClass,
   _Out_ llvm::Type *&resType)
 {
-  DxilModule &DM = M.GetOrCreateDxilModule();
   LoadInst *loadRangeId = cast<LoadInst>(createHandleStructForLib.get_Resource());
   Value *ResourceSymbol = loadRangeId->getPointerOperand();
 
-  DXIL::ResourceClass resourceClasses[] = {
-    DXIL::ResourceClass::CBuffer,
-    DXIL::ResourceClass::SRV,
-    DXIL::ResourceClass::UAV,
-    DXIL::ResourceClass::Sampler
-  };
-
-  hlsl::DxilResourceBase *Resource = nullptr;
-  for (auto &resourceClass : resourceClasses) {
-    
-    switch (resourceClass)
-    {
-    case DXIL::ResourceClass::CBuffer:
-    {
-      auto &cbuffers = DM.GetCBuffers();
-      for (auto &cbuffer : cbuffers)
-      {
-        if (cbuffer->GetGlobalSymbol() == ResourceSymbol)
-        {
-          Resource = cbuffer.get();
-          break;
-        }
-      }
-      break;
-    }
-    case DXIL::ResourceClass::SRV:
-    case DXIL::ResourceClass::UAV:
-    {
-      auto &viewList = resourceClass == DXIL::ResourceClass::SRV ? DM.GetSRVs() : DM.GetUAVs();
-      for (auto &view : viewList)
-      {
-        if (view->GetGlobalSymbol() == ResourceSymbol)
-        {
-          Resource = view.get();
-          break;
-        }
-      }
-      break;
-    }
-    case DXIL::ResourceClass::Sampler:
-    {
-      auto &samplers = DM.GetSamplers();
-      for (auto &sampler : samplers)
-      {
-        if (sampler->GetGlobalSymbol() == ResourceSymbol)
-        {
-          Resource = sampler.get();
-          break;
-        }
-      }
-      break;
-    }
-    }
-  }
-
+  auto resourceIt = m_resourceBySymbol.find(ResourceSymbol);
+  hlsl::DxilResourceBase *Resource =
+      resourceIt != m_resourceBySymbol.end() ? resourceIt->second : nullptr;
   if (Resource)
   {
     registerSpace = Resource->GetSpaceID();
@@ -829,6 +873,27 @@ void DxilPatchShaderRecordBindings::PatchCreateHandleToUseDescriptorIndex(
     createHandleInstr.set_Resource(handle);
 }
 
+template <typename TResourceList>
+static void AddResourcesBySymbol(
+    const TResourceList &resources,
+    llvm::DenseMap<llvm::Value *, hlsl::DxilResourceBase *> &resourceBySymbol) {
+  // Within a class the first resource with a symbol wins.
+  for (auto it = resources.rbegin(), e = resources.rend(); it != e; ++it)
+    resourceBySymbol[(*it)->GetGlobalSymbol()] = it->get();
+}
+
+// The resources the pass adds are all in the fallback layer's register
+// space, which is never patched, so the index is built once, before any are
+// added.
+void DxilPatchShaderRecordBindings::InitializeResourceIndex(DxilModule &DM) {
+  m_resourceBySymbol.clear();
+  // When several resources share a symbol, the last class wins.
+  AddResourcesBySymbol(DM.GetCBuffers(), m_resourceBySymbol);
+  AddResourcesBySymbol(DM.GetSRVs(), m_resourceBySymbol);
+  AddResourcesBySymbol(DM.GetUAVs(), m_resourceBySymbol);
+  AddResourcesBySymbol(DM.GetSamplers(), m_resourceBySymbol);
+}
+
 void DxilPatchShaderRecordBindings::InitializeViewTable() {
     // The Fallback Layer declares a bindless raw buffer that spans the entire descriptor heap,
     // manually add it to the list of UAV register spaces used
@@ -870,8 +935,6 @@ void DxilPatchShaderRecordBindings::PatchShaderBindings(Module &M) {
         if (!resourceIsResolved) continue; // TODO: This shouldn't actually be happening?
 
         ShaderRecordEntry shaderRecord = FindRootSignatureDescriptor(
-          *pRootSignatureDesc,
-          pInputShaderInfo->ShaderRecordIdentifierSizeInBytes,
           resourceClass,
           registerIndex,
           registerSpace);
@@ -885,7 +948,9 @@ void DxilPatchShaderRecordBindings::PatchShaderBindings(Module &M) {
           switch (shaderRecord.ParameterType) {
           case DxilRootParameterType::Constants32Bit:
           {
-            for (User *U : instr.users()) {
+            // Rewriting erases each load, so take the users up front.
+            SmallVector<User *, 16> Users(instr.user_begin(), instr.user_end());
+            for (User *U : Users) {
               llvm::Instruction *instruction = cast<CallInst>(U);
               if (IsCBufferLoad(instruction)) {
                 llvm::Instruction *cbufferLoadInstr = instruction;
@@ -989,25 +1054,6 @@ void DxilPatchShaderRecordBindings::PatchShaderBindings(Module &M) {
 
 }
 
-bool IsParameterTypeCompatibleWithResourceClass(
-  DXIL::ResourceClass resourceClass,
-  DxilRootParameterType parameterType) {
-  switch (parameterType) {
-  case DxilRootParameterType::DescriptorTable:
-    return true;
-  case DxilRootParameterType::Constants32Bit:
-  case DxilRootParameterType::CBV:
-    return resourceClass == DXIL::ResourceClass::CBuffer;
-  case DxilRootParameterType::SRV:
-    return resourceClass == DXIL::ResourceClass::SRV;
-  case DxilRootParameterType::UAV:
-    return resourceClass == DXIL::ResourceClass::UAV;
-  default:
-    ThrowFailure();
-    return false;
-  }
-}
-
 DxilRootParameterType ConvertD3D12ParameterTypeToDxil(DxilRootParameterType parameter) {
   switch (parameter) {
   case DxilRootParameterType::Constants32Bit:
@@ -1057,99 +1103,93 @@ unsigned int GetParameterTypeAlignment(DxilRootParameterType parameterType) {
 }
 
 template <typename TD3D12_ROOT_SIGNATURE_DESC>
-ShaderRecordEntry FindRootSignatureDescriptorHelper(
+void BuildShaderRecordIndex(
     const TD3D12_ROOT_SIGNATURE_DESC &rootSignatureDescriptor,
     unsigned int ShaderRecordIdentifierSizeInBytes,
-    DXIL::ResourceClass resourceClass, unsigned int baseRegisterIndex,
-    unsigned int registerSpace) {
-  // Automatically fail if it's looking for a fallback binding as these never
-  // need to be patched
-  if (registerSpace != FallbackLayerRegisterSpace) {
-    unsigned int recordOffset = ShaderRecordIdentifierSizeInBytes;
-    for (unsigned int rootParamIndex = 0;
-         rootParamIndex < rootSignatureDescriptor.NumParameters;
-         rootParamIndex++) {
-      auto &rootParam = rootSignatureDescriptor.pParameters[rootParamIndex];
-      auto dxilParamType =
-          ConvertD3D12ParameterTypeToDxil(rootParam.ParameterType);
+    ShaderRecordIndex &index) {
+  unsigned int recordOffset = ShaderRecordIdentifierSizeInBytes;
+  for (unsigned int rootParamIndex = 0;
+       rootParamIndex < rootSignatureDescriptor.NumParameters;
+       rootParamIndex++) {
+    auto &rootParam = rootSignatureDescriptor.pParameters[rootParamIndex];
+    auto dxilParamType =
+        ConvertD3D12ParameterTypeToDxil(rootParam.ParameterType);
 
 #define ALIGN(alignment, num) (((num + alignment - 1) / alignment) * alignment)
-      recordOffset = ALIGN(GetParameterTypeAlignment(rootParam.ParameterType),
-                           recordOffset);
-
-      switch (rootParam.ParameterType) {
-      case DxilRootParameterType::Constants32Bit:
-        if (IsParameterTypeCompatibleWithResourceClass(resourceClass,
-                                                       dxilParamType) &&
-            baseRegisterIndex == rootParam.Constants.ShaderRegister &&
-            registerSpace == rootParam.Constants.RegisterSpace) {
-          return {dxilParamType, recordOffset};
+    recordOffset = ALIGN(GetParameterTypeAlignment(rootParam.ParameterType),
+                         recordOffset);
+
+    switch (rootParam.ParameterType) {
+    case DxilRootParameterType::Constants32Bit:
+      index.AddRegister(DXIL::ResourceClass::CBuffer,
+                        rootParam.Constants.ShaderRegister,
+                        rootParam.Constants.RegisterSpace,
+                        {dxilParamType, recordOffset});
+      recordOffset += rootParam.Constants.Num32BitValues * sizeof(uint32_t);
+      break;
+    case DxilRootParameterType::DescriptorTable: {
+      auto &descriptorTable = rootParam.DescriptorTable;
+
+      unsigned int rangeOffsetInDescriptors = 0;
+      for (unsigned int rangeIndex = 0;
+           rangeIndex < descriptorTable.NumDescriptorRanges; rangeIndex++) {
+        auto &range = descriptorTable.pDescriptorRanges[rangeIndex];
+        if (range.OffsetInDescriptorsFromTableStart != -1) {
+          rangeOffsetInDescriptors = range.OffsetInDescriptorsFromTableStart;
         }
-        recordOffset += rootParam.Constants.Num32BitValues * sizeof(uint32_t);
-        break;
-      case DxilRootParameterType::DescriptorTable: {
-        auto &descriptorTable = rootParam.DescriptorTable;
-
-        unsigned int rangeOffsetInDescriptors = 0;
-        for (unsigned int rangeIndex = 0;
-             rangeIndex < descriptorTable.NumDescriptorRanges; rangeIndex++) {
-          auto &range = descriptorTable.pDescriptorRanges[rangeIndex];
-          if (range.OffsetInDescriptorsFromTableStart != -1) {
-            rangeOffsetInDescriptors = range.OffsetInDescriptorsFromTableStart;
-          }
-
-          if (ConvertD3D12RangeTypeToDxil(range.RangeType) == resourceClass &&
-              range.RegisterSpace == registerSpace &&
-              range.BaseShaderRegister <= baseRegisterIndex &&
-              range.BaseShaderRegister + range.NumDescriptors >
-                  baseRegisterIndex) {
-            rangeOffsetInDescriptors +=
-                baseRegisterIndex - range.BaseShaderRegister;
-            return {dxilParamType, recordOffset, rangeOffsetInDescriptors};
-          }
 
-          rangeOffsetInDescriptors += range.NumDescriptors;
-        }
+        index.AddRange(ConvertD3D12RangeTypeToDxil(range.RangeType),
+                       range.BaseShaderRegister, range.NumDescriptors,
+                       range.RegisterSpace,
+                       {dxilParamType, recordOffset, rangeOffsetInDescriptors});
 
-        recordOffset += SizeofD3D12GpuDescriptorHandle;
-        break;
+        rangeOffsetInDescriptors += range.NumDescriptors;
       }
-      case DxilRootParameterType::CBV:
-      case DxilRootParameterType::SRV:
-      case DxilRootParameterType::UAV:
-        if (IsParameterTypeCompatibleWithResourceClass(resourceClass,
-                                                       dxilParamType) &&
-            baseRegisterIndex == rootParam.Descriptor.ShaderRegister &&
-            registerSpace == rootParam.Descriptor.RegisterSpace) {
-          return {dxilParamType, recordOffset};
-        }
 
-        recordOffset += SizeofD3D12GpuVA;
-        break;
-      }
+      recordOffset += SizeofD3D12GpuDescriptorHandle;
+      break;
+    }
+    case DxilRootParameterType::CBV:
+    case DxilRootParameterType::SRV:
+    case DxilRootParameterType::UAV:
+      index.AddRegister(dxilParamType == DxilRootParameterType::CBV
+                            ? DXIL::ResourceClass::CBuffer
+                            : dxilParamType == DxilRootParameterType::SRV
+                                  ? DXIL::ResourceClass::SRV
+                                  : DXIL::ResourceClass::UAV,
+                        rootParam.Descriptor.ShaderRegister,
+                        rootParam.Descriptor.RegisterSpace,
+                        {dxilParamType, recordOffset});
+
+      recordOffset += SizeofD3D12GpuVA;
+      break;
     }
   }
-  return ShaderRecordEntry::InvalidEntry();
+  index.Finalize();
 }
 
-// TODO: Consider pre-calculating this into a map
-ShaderRecordEntry DxilPatchShaderRecordBindings::FindRootSignatureDescriptor(
-  const DxilVersionedRootSignatureDesc &rootSignatureDescriptor,
-  unsigned int ShaderRecordIdentifierSizeInBytes,
-  DXIL::ResourceClass resourceClass,
-  unsigned int baseRegisterIndex,
-  unsigned int registerSpace) {
-  switch (rootSignatureDescriptor.Version) {
+void DxilPatchShaderRecordBindings::InitializeShaderRecordIndex() {
+  m_shaderRecordIndex = ShaderRecordIndex();
+  unsigned int idSize = pInputShaderInfo->ShaderRecordIdentifierSizeInBytes;
+  switch (pRootSignatureDesc->Version) {
   case DxilRootSignatureVersion::Version_1_0:
-    return FindRootSignatureDescriptorHelper(rootSignatureDescriptor.Desc_1_0, ShaderRecordIdentifierSizeInBytes, resourceClass, baseRegisterIndex, registerSpace);
+    BuildShaderRecordIndex(pRootSignatureDesc->Desc_1_0, idSize, m_shaderRecordIndex);
+    break;
   case DxilRootSignatureVersion::Version_1_1:
-    return FindRootSignatureDescriptorHelper(rootSignatureDescriptor.Desc_1_1, ShaderRecordIdentifierSizeInBytes, resourceClass, baseRegisterIndex, registerSpace);
+    BuildShaderRecordIndex(pRootSignatureDesc->Desc_1_1, idSize, m_shaderRecordIndex);
+    break;
   default:
     ThrowFailure();
-    return ShaderRecordEntry::InvalidEntry();
   }
 }
 
-
-
-
+ShaderRecordEntry DxilPatchShaderRecordBindings::FindRootSignatureDescriptor(
+  DXIL::ResourceClass resourceClass,
+  unsigned int baseRegisterIndex,
+  unsigned int registerSpace) {
+  // Automatically fail if it's looking for a fallback binding as these never
+  // need to be patched
+  if (registerSpace == FallbackLayerRegisterSpace)
+    return ShaderRecordEntry::InvalidEntry();
+  return m_shaderRecordIndex.Find(resourceClass, baseRegisterIndex, registerSpace);
+}
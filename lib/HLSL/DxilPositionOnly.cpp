@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPositionOnly.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Reduces a vertex shader to the outputs that the rasterizer reads.         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilSignature.h"
+#include "dxc/HLSL/DxilPackSignatureElement.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// Depth prepasses and shadow passes only need where a vertex lands. The
+// position-only variant of a vertex shader keeps SV_Position and the other
+// system value outputs, since clip and cull distances and the render target
+// and viewport array indices change what gets rasterized, and drops every
+// arbitrary output along with its stores. The DCE that follows removes the
+// code that computed them, and the remaining outputs are packed again.
+//
+// The input signature is kept whole, so the variant takes the input layout
+// of the full shader.
+
+namespace {
+
+class DxilPositionOnly : public ModulePass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilPositionOnly() : ModulePass(ID) {}
+
+  const char *getPassName() const override { return "DXIL position only"; }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnModule(Module &M) override;
+};
+
+bool DxilPositionOnly::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  const ShaderModel *SM = DM.GetShaderModel();
+  if (!SM->IsVS())
+    return false;
+
+  DxilSignature &Outputs = DM.GetOutputSignature();
+  std::vector<bool> bRemove;
+  bool bAnyRemoved = false;
+  for (auto &E : Outputs.GetElements()) {
+    bRemove.push_back(E->IsArbitrary());
+    bAnyRemoved |= E->IsArbitrary();
+  }
+  if (!bAnyRemoved)
+    return false;
+
+  SmallVector<CallInst *, 16> Stores;
+  for (Function &F : M.functions()) {
+    if (!OP::IsDxilOpFunc(&F))
+      continue;
+    for (User *U : F.users()) {
+      CallInst *CI = cast<CallInst>(U);
+      if (OP::IsDxilOpFuncCallInst(CI, DXIL::OpCode::StoreOutput))
+        Stores.push_back(CI);
+    }
+  }
+
+  std::vector<unsigned> NewIDs = Outputs.RemoveElements(bRemove);
+  OP *HlslOP = DM.GetOP();
+  for (CallInst *CI : Stores) {
+    unsigned ID = cast<ConstantInt>(
+                      CI->getArgOperand(DXIL::OperandIndex::kStoreOutputIDOpIdx))
+                      ->getLimitedValue();
+    if (NewIDs[ID] == DxilSignatureElement::kUndefinedID) {
+      CI->eraseFromParent();
+      continue;
+    }
+    CI->setArgOperand(DXIL::OperandIndex::kStoreOutputIDOpIdx,
+                      HlslOP->GetU32Const(NewIDs[ID]));
+  }
+
+  for (auto &E : Outputs.GetElements()) {
+    E->SetStartRow(Semantic::kUndefinedRow);
+    E->SetStartCol(Semantic::kUndefinedCol);
+  }
+  PackDxilSignature(Outputs, SM->GetDefaultPackingStrategy());
+  return true;
+}
+
+}
+
+char DxilPositionOnly::ID = 0;
+
+ModulePass *llvm::createDxilPositionOnlyPass() {
+  return new DxilPositionOnly();
+}
+
+INITIALIZE_PASS(DxilPositionOnly, "dxil-position-only", "DXIL position only",
+                false, false)
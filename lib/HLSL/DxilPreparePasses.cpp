@@ -46,6 +46,10 @@ public:
 
   const char *getPassName() const override { return "Fail on undef resource use"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override;
 };
 }
@@ -117,6 +121,10 @@ public:
 
   const char *getPassName() const override { return "Remove all unused function except entry from DxilModule"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     if (M.HasDxilModule()) {
       DxilModule &DM = M.GetDxilModule();
@@ -460,6 +468,10 @@ public:
 
   const char *getPassName() const override { return "HLSL DXIL Metadata Emit"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override {
     if (M.HasDxilModule()) {
       DxilModule::ClearDxilMetadata(M);
@@ -0,0 +1,484 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilPressureReport.cpp                                                    //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Estimates register pressure and on-chip memory use of each entry point.   //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilPressureReport.h"
+#include "dxc/DXIL/DxilConstants.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilFunctionProps.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilShaderModel.h"
+#include "dxc/Support/DxcJson.h"
+#include "../DxrFallback/LiveValues.h"
+
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DebugLoc.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+namespace {
+
+struct DynamicArray {
+  std::string Name;
+  uint64_t Bytes;
+};
+
+struct EntryPressure {
+  std::string Name;
+  unsigned MaxLiveValues = 0;
+  unsigned MaxLiveComponents = 0;
+  unsigned MaxLiveLine = 0; // Zero when there's no debug location.
+  uint64_t GroupSharedBytes = 0;
+  uint64_t IndexableBytes = 0;
+  std::vector<DynamicArray> DynamicArrays;
+  // Compute shaders only.
+  bool bCompute = false;
+  unsigned NumThreads[3];
+  bool bUsesBarriers = false;
+  bool bUsesWaveOps = false;
+};
+
+// How many groups of one size fit on a unit of a GPU model.
+struct GroupOccupancy {
+  unsigned Threads;
+  unsigned WavesPerGroup;
+  unsigned GroupsPerUnit;
+  unsigned ResidentWaves;
+  unsigned MaxWaves;
+  SmallVector<const char *, 2> LimitedBy;
+  bool bNotWaveMultiple;
+};
+
+// Number of 32-bit registers a value of the type occupies.
+unsigned GetComponentCount(Type *Ty) {
+  if (VectorType *VT = dyn_cast<VectorType>(Ty))
+    return VT->getNumElements() * GetComponentCount(VT->getElementType());
+  if (ArrayType *AT = dyn_cast<ArrayType>(Ty))
+    return AT->getNumElements() * GetComponentCount(AT->getElementType());
+  if (StructType *ST = dyn_cast<StructType>(Ty)) {
+    unsigned Count = 0;
+    for (Type *EltTy : ST->elements())
+      Count += GetComponentCount(EltTy);
+    return Count;
+  }
+  // Pointers only appear inside handles, which are held in one register.
+  if (Ty->isPointerTy())
+    return 1;
+  return Ty->getPrimitiveSizeInBits() > 32 ? 2 : 1;
+}
+
+// Values that need a register while live. Addresses are folded into the
+// memory accesses that use them.
+bool IsRegisterValue(const Value *V) {
+  const Instruction *I = dyn_cast<Instruction>(V);
+  return I && !I->getType()->isVoidTy() && !I->getType()->isPointerTy() &&
+         !I->use_empty();
+}
+
+class LiveSet {
+  DenseSet<Instruction *> m_Values;
+  unsigned m_Components = 0;
+
+public:
+  void insert(Value *V) {
+    if (!IsRegisterValue(V))
+      return;
+    Instruction *I = cast<Instruction>(V);
+    if (m_Values.insert(I).second)
+      m_Components += GetComponentCount(I->getType());
+  }
+  void erase(Instruction *I) {
+    if (m_Values.erase(I))
+      m_Components -= GetComponentCount(I->getType());
+  }
+  unsigned size() const { return m_Values.size(); }
+  unsigned components() const { return m_Components; }
+};
+
+// LiveValues gives the values live across each terminator. Walking each
+// block backwards from there gives the values live across every other
+// instruction, without keeping a live set per instruction.
+void ComputePressure(Function &F, EntryPressure &Entry) {
+  std::vector<Instruction *> Terminators;
+  for (BasicBlock &BB : F)
+    Terminators.emplace_back(BB.getTerminator());
+  LiveValues Liveness(Terminators);
+  Liveness.run();
+
+  unsigned Index = 0;
+  for (BasicBlock &BB : F) {
+    LiveSet Live;
+    for (Instruction *I : Liveness.getLiveValues(Index++))
+      Live.insert(I);
+
+    for (BasicBlock::iterator It = BB.getTerminator(); ; --It) {
+      Instruction *I = It;
+      // A value isn't live before its definition.
+      Live.erase(I);
+      // Pressure at an instruction is what is live across it plus its result.
+      bool bDefines = IsRegisterValue(I);
+      unsigned Values = Live.size() + (bDefines ? 1 : 0);
+      unsigned Components =
+          Live.components() + (bDefines ? GetComponentCount(I->getType()) : 0);
+      Entry.MaxLiveValues = std::max(Entry.MaxLiveValues, Values);
+      if (Components > Entry.MaxLiveComponents) {
+        Entry.MaxLiveComponents = Components;
+        if (const DebugLoc &DL = I->getDebugLoc())
+          Entry.MaxLiveLine = DL.getLine();
+      }
+
+      if (It == BB.begin())
+        break;
+      // Phi operands are used on the incoming edge, so they are live at the
+      // terminator of the predecessor rather than at the phi.
+      if (isa<TerminatorInst>(I)) {
+        for (BasicBlock *Succ : successors(&BB)) {
+          for (Instruction &SuccI : *Succ) {
+            PHINode *Phi = dyn_cast<PHINode>(&SuccI);
+            if (!Phi)
+              break;
+            Live.insert(Phi->getIncomingValueForBlock(&BB));
+          }
+        }
+      }
+      if (!isa<PHINode>(I)) {
+        for (Value *Op : I->operands())
+          Live.insert(Op);
+      }
+    }
+  }
+}
+
+// Notes the thread group barriers and wave operations of F.
+void CollectSyncOps(Function &F, EntryPressure &Entry) {
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (!OP::IsDxilOpFuncCallInst(&I))
+        continue;
+      DXIL::OpCode Op = OP::GetDxilOpFuncCallInst(&I);
+      if (Op == DXIL::OpCode::Barrier) {
+        DxilInst_Barrier Barrier(&I);
+        ConstantInt *Mode = dyn_cast<ConstantInt>(Barrier.get_barrierMode());
+        if (!Mode || (Mode->getZExtValue() &
+                      (unsigned)DXIL::BarrierMode::SyncThreadGroup))
+          Entry.bUsesBarriers = true;
+      } else if (OP::IsDxilOpWave(Op)) {
+        Entry.bUsesWaveOps = true;
+      }
+    }
+  }
+}
+
+// Follows constant expressions down to the globals they refer to.
+void CollectGlobals(Value *V, SmallPtrSetImpl<GlobalVariable *> &Globals) {
+  if (GlobalVariable *GV = dyn_cast<GlobalVariable>(V)) {
+    Globals.insert(GV);
+    return;
+  }
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(V)) {
+    for (Value *Op : CE->operands())
+      CollectGlobals(Op, Globals);
+  }
+}
+
+Value *GetArrayBase(GetElementPtrInst *GEP) {
+  Value *Base = GEP->getPointerOperand();
+  while (GEPOperator *BaseGEP = dyn_cast<GEPOperator>(Base))
+    Base = BaseGEP->getPointerOperand();
+  return Base;
+}
+
+void CollectMemory(Function &F, SmallPtrSetImpl<GlobalVariable *> &Globals,
+                   SetVector<Value *> &DynamicArrays) {
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      for (Value *Op : I.operands())
+        CollectGlobals(Op, Globals);
+
+      GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(&I);
+      if (!GEP || GEP->hasAllConstantIndices())
+        continue;
+      Value *Base = GetArrayBase(GEP);
+      if (isa<AllocaInst>(Base)) {
+        DynamicArrays.insert(Base);
+      } else if (GlobalVariable *GV = dyn_cast<GlobalVariable>(Base)) {
+        // Constant arrays become immediate constant buffers.
+        if (!GV->isConstant() &&
+            GV->getType()->getAddressSpace() == DXIL::kDefaultAddrSpace)
+          DynamicArrays.insert(Base);
+      }
+    }
+  }
+}
+
+uint64_t GetAllocatedBytes(Value *V, const DataLayout &DL) {
+  if (AllocaInst *AI = dyn_cast<AllocaInst>(V))
+    return DL.getTypeAllocSize(AI->getAllocatedType());
+  return DL.getTypeAllocSize(cast<GlobalVariable>(V)->getValueType());
+}
+
+EntryPressure AnalyzeEntry(DxilModule &DM, Function *Entry,
+                           Function *PatchConstantFunc) {
+  const DataLayout &DL = DM.GetModule()->getDataLayout();
+  EntryPressure Result;
+  Result.Name = Entry->getName();
+
+  SetVector<Function *> Reachable;
+  Reachable.insert(Entry);
+  if (PatchConstantFunc)
+    Reachable.insert(PatchConstantFunc);
+  for (unsigned i = 0; i < Reachable.size(); ++i) {
+    for (BasicBlock &BB : *Reachable[i]) {
+      for (Instruction &I : BB) {
+        if (CallInst *CI = dyn_cast<CallInst>(&I)) {
+          Function *Callee = CI->getCalledFunction();
+          if (Callee && !Callee->isDeclaration())
+            Reachable.insert(Callee);
+        }
+      }
+    }
+  }
+
+  SmallPtrSet<GlobalVariable *, 8> Globals;
+  SetVector<Value *> DynamicArrays;
+  for (Function *F : Reachable) {
+    // A pass-through hull shader has no control-point function.
+    if (F->isDeclaration())
+      continue;
+    ComputePressure(*F, Result);
+    CollectMemory(*F, Globals, DynamicArrays);
+    CollectSyncOps(*F, Result);
+  }
+
+  for (GlobalVariable *GV : Globals) {
+    if (GV->getType()->getAddressSpace() == DXIL::kTGSMAddrSpace)
+      Result.GroupSharedBytes += DL.getTypeAllocSize(GV->getValueType());
+  }
+  for (Value *V : DynamicArrays) {
+    uint64_t Bytes = GetAllocatedBytes(V, DL);
+    Result.IndexableBytes += Bytes;
+    Result.DynamicArrays.push_back({V->getName(), Bytes});
+  }
+  return Result;
+}
+
+void SetNumThreads(EntryPressure &Entry, const unsigned NumThreads[3]) {
+  Entry.bCompute = true;
+  std::copy(NumThreads, NumThreads + 3, Entry.NumThreads);
+}
+
+// Groups run on one unit, so a unit holds whole groups only, as many as its
+// registers, groupshared memory, wave slots and group slots allow.
+GroupOccupancy EstimateOccupancy(const EntryPressure &Entry,
+                                 const DxilGpuModel &Model, unsigned Threads) {
+  GroupOccupancy Result;
+  Result.Threads = Threads;
+  Result.WavesPerGroup = (Threads + Model.WaveSize - 1) / Model.WaveSize;
+  Result.bNotWaveMultiple = Threads % Model.WaveSize != 0;
+  Result.MaxWaves = Model.MaxWavesPerSimd * Model.SimdsPerUnit;
+
+  unsigned Registers = std::max(Entry.MaxLiveComponents, 1u);
+  unsigned WavesByRegisters =
+      Model.RegistersPerLane / Registers * Model.SimdsPerUnit;
+  const struct {
+    const char *Name;
+    unsigned Groups;
+  } Limits[] = {
+      {"registers", WavesByRegisters / Result.WavesPerGroup},
+      {"groupshared",
+       Entry.GroupSharedBytes
+           ? (unsigned)(Model.GroupSharedBytes / Entry.GroupSharedBytes)
+           : UINT_MAX},
+      {"waves", Result.MaxWaves / Result.WavesPerGroup},
+      {"groups", Model.MaxGroupsPerUnit},
+  };
+  Result.GroupsPerUnit = UINT_MAX;
+  for (const auto &Limit : Limits)
+    Result.GroupsPerUnit = std::min(Result.GroupsPerUnit, Limit.Groups);
+  for (const auto &Limit : Limits) {
+    if (Limit.Groups == Result.GroupsPerUnit)
+      Result.LimitedBy.push_back(Limit.Name);
+  }
+  Result.ResidentWaves = Result.GroupsPerUnit * Result.WavesPerGroup;
+  return Result;
+}
+
+// Whether A is a better group size than B.
+bool IsBetterGroupSize(const EntryPressure &Entry, const GroupOccupancy &A,
+                       const GroupOccupancy &B) {
+  if (A.ResidentWaves != B.ResidentWaves)
+    return A.ResidentWaves > B.ResidentWaves;
+  if (A.bNotWaveMultiple != B.bNotWaveMultiple)
+    return !A.bNotWaveMultiple;
+  // A group waits at a barrier until all of its waves reach it.
+  if (Entry.bUsesBarriers && A.WavesPerGroup != B.WavesPerGroup)
+    return A.WavesPerGroup < B.WavesPerGroup;
+  return false;
+}
+
+void WriteOccupancy(raw_ostream &OS, const EntryPressure &Entry,
+                    const std::vector<DxilGpuModel> &Models) {
+  unsigned DeclaredThreads =
+      Entry.NumThreads[0] * Entry.NumThreads[1] * Entry.NumThreads[2];
+  std::vector<unsigned> Sizes;
+  for (unsigned Threads = 32; Threads <= 1024; Threads *= 2)
+    Sizes.push_back(Threads);
+  if (std::find(Sizes.begin(), Sizes.end(), DeclaredThreads) == Sizes.end())
+    Sizes.insert(std::upper_bound(Sizes.begin(), Sizes.end(), DeclaredThreads),
+                 DeclaredThreads);
+
+  OS << ", \"numThreads\": [" << Entry.NumThreads[0] << ", "
+     << Entry.NumThreads[1] << ", " << Entry.NumThreads[2] << "]"
+     << ", \"usesBarriers\": " << (Entry.bUsesBarriers ? "true" : "false")
+     << ", \"usesWaveOps\": " << (Entry.bUsesWaveOps ? "true" : "false")
+     << ", \"occupancy\": [";
+  for (size_t i = 0; i < Models.size(); ++i) {
+    const DxilGpuModel &Model = Models[i];
+    std::vector<GroupOccupancy> Candidates;
+    size_t Best = 0;
+    for (unsigned Threads : Sizes) {
+      Candidates.push_back(EstimateOccupancy(Entry, Model, Threads));
+      if (IsBetterGroupSize(Entry, Candidates.back(), Candidates[Best]))
+        Best = Candidates.size() - 1;
+    }
+
+    OS << (i ? ",\n" : "\n") << "      {\"model\": ";
+    WriteJsonString(OS, Model.Name);
+    OS << ", \"waveSize\": " << Model.WaveSize
+       << ", \"recommended\": " << Candidates[Best].Threads
+       << ", \"candidates\": [";
+    for (size_t j = 0; j < Candidates.size(); ++j) {
+      const GroupOccupancy &Candidate = Candidates[j];
+      OS << (j ? ",\n" : "\n")
+         << "        {\"threads\": " << Candidate.Threads
+         << ", \"wavesPerGroup\": " << Candidate.WavesPerGroup
+         << ", \"groupsPerUnit\": " << Candidate.GroupsPerUnit
+         << ", \"occupancy\": "
+         << format("%.2f",
+                   (double)Candidate.ResidentWaves / Candidate.MaxWaves)
+         << ", \"limitedBy\": [";
+      for (size_t k = 0; k < Candidate.LimitedBy.size(); ++k)
+        OS << (k ? ", " : "") << '"' << Candidate.LimitedBy[k] << '"';
+      OS << "], \"notWaveMultiple\": "
+         << (Candidate.bNotWaveMultiple ? "true" : "false") << "}";
+    }
+    OS << "]}";
+  }
+  OS << "]";
+}
+
+} // namespace
+
+bool hlsl::ParseDxilGpuModel(StringRef Spec, DxilGpuModel &Model) {
+  std::pair<StringRef, StringRef> NameAndFigures = Spec.split(':');
+  if (NameAndFigures.first.trim().empty())
+    return false;
+  unsigned *Figures[] = {&Model.WaveSize,         &Model.RegistersPerLane,
+                         &Model.MaxWavesPerSimd,  &Model.SimdsPerUnit,
+                         &Model.GroupSharedBytes, &Model.MaxGroupsPerUnit};
+  SmallVector<StringRef, 6> Values;
+  NameAndFigures.second.split(Values, ",");
+  if (Values.size() != array_lengthof(Figures))
+    return false;
+  for (unsigned i = 0; i < Values.size(); ++i) {
+    if (Values[i].trim().getAsInteger(10, *Figures[i]) || *Figures[i] == 0)
+      return false;
+  }
+  Model.Name = NameAndFigures.first.trim();
+  return true;
+}
+
+void hlsl::GetDefaultDxilGpuModels(std::vector<DxilGpuModel> &Models) {
+  DxilGpuModel Wave32 = {"wave32", 32, 512, 12, 4, 65536, 16};
+  DxilGpuModel Wave64 = {"wave64", 64, 256, 10, 4, 65536, 16};
+  Models.push_back(Wave32);
+  Models.push_back(Wave64);
+}
+
+void hlsl::WriteDxilPressureReport(Module &M, raw_ostream &OS,
+                                   const std::vector<DxilGpuModel> *pModels) {
+  std::vector<DxilGpuModel> DefaultModels;
+  if (!pModels) {
+    GetDefaultDxilGpuModels(DefaultModels);
+    pModels = &DefaultModels;
+  }
+
+  std::vector<EntryPressure> Entries;
+  if (M.HasDxilModule()) {
+    DxilModule &DM = M.GetDxilModule();
+    if (DM.GetShaderModel()->IsLib()) {
+      for (Function &F : M) {
+        if (F.isDeclaration() || !DM.HasDxilFunctionProps(&F))
+          continue;
+        DxilFunctionProps &Props = DM.GetDxilFunctionProps(&F);
+        Function *PatchConstantFunc =
+            Props.IsHS() ? Props.ShaderProps.HS.patchConstantFunc : nullptr;
+        Entries.emplace_back(AnalyzeEntry(DM, &F, PatchConstantFunc));
+        if (Props.IsCS())
+          SetNumThreads(Entries.back(), Props.ShaderProps.CS.numThreads);
+      }
+    } else if (Function *Entry = DM.GetEntryFunction()) {
+      Function *PatchConstantFunc = DM.GetShaderModel()->IsHS()
+                                        ? DM.GetPatchConstantFunction()
+                                        : nullptr;
+      Entries.emplace_back(AnalyzeEntry(DM, Entry, PatchConstantFunc));
+      if (DM.GetShaderModel()->IsCS()) {
+        unsigned NumThreads[3] = {DM.GetNumThreads(0), DM.GetNumThreads(1),
+                                  DM.GetNumThreads(2)};
+        SetNumThreads(Entries.back(), NumThreads);
+      }
+    }
+  }
+
+  OS << "{\n  \"entries\": [";
+  for (size_t i = 0; i < Entries.size(); ++i) {
+    const EntryPressure &Entry = Entries[i];
+    OS << (i ? ",\n" : "\n") << "    {\"name\": ";
+    WriteJsonString(OS, Entry.Name);
+    OS << ", \"maxLiveValues\": " << Entry.MaxLiveValues
+       << ", \"maxLiveComponents\": " << Entry.MaxLiveComponents;
+    if (Entry.MaxLiveLine)
+      OS << ", \"maxLiveLine\": " << Entry.MaxLiveLine;
+    OS << ", \"groupsharedBytes\": " << Entry.GroupSharedBytes
+       << ", \"indexableBytes\": " << Entry.IndexableBytes
+       << ", \"dynamicArrays\": [";
+    for (size_t j = 0; j < Entry.DynamicArrays.size(); ++j) {
+      OS << (j ? ", " : "") << "{\"name\": ";
+      WriteJsonString(OS, Entry.DynamicArrays[j].Name);
+      OS << ", \"bytes\": " << Entry.DynamicArrays[j].Bytes << "}";
+    }
+    OS << "]";
+    if (Entry.bCompute)
+      WriteOccupancy(OS, Entry, *pModels);
+    OS << "}";
+  }
+  OS << "\n  ]\n}\n";
+  OS.flush();
+}
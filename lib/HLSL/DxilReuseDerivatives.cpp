@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilReuseDerivatives.cpp                                                  //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Computes each derivative and level of detail once.                        //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Derivatives and CalculateLOD read their operands from the other lanes of
+// the quad. Until DxilConvergentMark's markers are cleared, each call has an
+// operand of its own, so calls on one value, from the source and from
+// helpers that take the derivatives again, are only merged here. A call that
+// another call with the same operands dominates reuses its result: wherever
+// the later one runs, the earlier one ran on the same values.
+//
+// Two calls that don't dominate each other are merged into one at their
+// nearest common dominator, when their operands are available there and
+// every branch in between that decides whether either runs is uniform. All
+// lanes of each quad then take the same path, so the lanes that take the
+// derivative are the same as before.
+
+namespace {
+
+class DxilReuseDerivatives : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilReuseDerivatives() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL reuse derivatives";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<PostDominatorTree>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  DominatorTree *m_DT;
+  PostDominatorTree *m_PDT;
+  std::unique_ptr<WaveUniformityAnalysis> m_Uniformity;
+
+  static bool IsDerivative(Instruction *I);
+  bool IsReachedUniformly(BasicBlock *From, BasicBlock *To);
+  bool CanMergeAt(BasicBlock *Dom, CallInst *A, CallInst *B);
+};
+
+bool DxilReuseDerivatives::IsDerivative(Instruction *I) {
+  if (!OP::IsDxilOpFuncCallInst(I))
+    return false;
+  switch (OP::GetDxilOpFuncCallInst(I)) {
+  case DXIL::OpCode::DerivCoarseX:
+  case DXIL::OpCode::DerivCoarseY:
+  case DXIL::OpCode::DerivFineX:
+  case DXIL::OpCode::DerivFineY:
+  case DXIL::OpCode::CalculateLOD:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Returns true if every branch between From, which dominates To, and To is
+// on a uniform condition.
+bool DxilReuseDerivatives::IsReachedUniformly(BasicBlock *From,
+                                              BasicBlock *To) {
+  if (!m_Uniformity) {
+    m_Uniformity.reset(WaveUniformityAnalysis::create(*m_PDT));
+    m_Uniformity->Analyze(From->getParent());
+  }
+  SmallPtrSet<BasicBlock *, 16> Visited;
+  SmallVector<BasicBlock *, 16> Worklist;
+  Worklist.push_back(To);
+  Visited.insert(To);
+  while (!Worklist.empty()) {
+    BasicBlock *BB = Worklist.pop_back_val();
+    if (BB == From)
+      continue;
+    for (BasicBlock *Pred : predecessors(BB)) {
+      if (!Visited.insert(Pred).second)
+        continue;
+      TerminatorInst *TI = Pred->getTerminator();
+      if (BranchInst *BI = dyn_cast<BranchInst>(TI)) {
+        if (BI->isConditional() &&
+            !m_Uniformity->IsUniform(BI->getCondition()))
+          return false;
+      } else if (SwitchInst *SI = dyn_cast<SwitchInst>(TI)) {
+        if (!m_Uniformity->IsUniform(SI->getCondition()))
+          return false;
+      } else if (TI->getNumSuccessors() > 1) {
+        return false;
+      }
+      Worklist.push_back(Pred);
+    }
+  }
+  return true;
+}
+
+bool DxilReuseDerivatives::CanMergeAt(BasicBlock *Dom, CallInst *A,
+                                      CallInst *B) {
+  TerminatorInst *InsertPt = Dom->getTerminator();
+  for (Value *Op : A->arg_operands()) {
+    Instruction *OpI = dyn_cast<Instruction>(Op);
+    if (OpI && !m_DT->dominates(OpI, InsertPt))
+      return false;
+  }
+  return IsReachedUniformly(Dom, A->getParent()) &&
+         IsReachedUniformly(Dom, B->getParent());
+}
+
+bool DxilReuseDerivatives::runOnFunction(Function &F) {
+  if (!F.getParent()->HasDxilModule())
+    return false;
+
+  // Calls grouped by callee and arguments, which include the opcode.
+  std::map<std::vector<Value *>, SmallVector<CallInst *, 2>> Groups;
+  for (inst_iterator I = inst_begin(F), E = inst_end(F); I != E; ++I) {
+    if (!IsDerivative(&*I))
+      continue;
+    CallInst *CI = cast<CallInst>(&*I);
+    std::vector<Value *> Key(1, CI->getCalledValue());
+    Key.insert(Key.end(), CI->arg_operands().begin(),
+               CI->arg_operands().end());
+    Groups[Key].push_back(CI);
+  }
+
+  m_DT = &getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  m_PDT = &getAnalysis<PostDominatorTree>();
+  m_Uniformity.reset();
+
+  std::vector<CallInst *> Merged;
+  for (auto &It : Groups) {
+    if (It.second.size() < 2)
+      continue;
+    SmallVector<CallInst *, 2> Kept;
+    for (CallInst *CI : It.second) {
+      CallInst *Reused = nullptr;
+      for (CallInst *&K : Kept) {
+        if (m_DT->dominates(K, CI)) {
+          Reused = K;
+          break;
+        }
+        // Blocks need not be laid out in dominance order.
+        if (m_DT->dominates(CI, K)) {
+          K->replaceAllUsesWith(CI);
+          Merged.push_back(K);
+          K = CI;
+          Reused = CI;
+          break;
+        }
+        BasicBlock *Dom = m_DT->findNearestCommonDominator(K->getParent(),
+                                                           CI->getParent());
+        if (Dom && CanMergeAt(Dom, K, CI)) {
+          K->moveBefore(Dom->getTerminator());
+          Reused = K;
+          break;
+        }
+      }
+      if (Reused == CI)
+        continue;
+      if (Reused) {
+        CI->replaceAllUsesWith(Reused);
+        Merged.push_back(CI);
+      } else {
+        Kept.push_back(CI);
+      }
+    }
+  }
+  for (CallInst *CI : Merged)
+    CI->eraseFromParent();
+  m_Uniformity.reset();
+  return !Merged.empty();
+}
+
+}
+
+char DxilReuseDerivatives::ID = 0;
+
+FunctionPass *llvm::createDxilReuseDerivativesPass() {
+  return new DxilReuseDerivatives();
+}
+
+INITIALIZE_PASS_BEGIN(DxilReuseDerivatives, "dxil-reuse-derivatives",
+                      "DXIL reuse derivatives", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_END(DxilReuseDerivatives, "dxil-reuse-derivatives",
+                    "DXIL reuse derivatives", false, false)
@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilRootConstantCandidates.cpp                                            //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Recommends binding small cbuffers as root constants.                      //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilCBuffer.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
+#include "dxc/DxilRootSignature/DxilRootSignature.h"
+#include "dxc/Support/Global.h"
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+// A cbuffer bound as root constants is read from the root arguments, without
+// going through a descriptor and memory; the price is a DWORD of root
+// signature per value, where a root CBV costs 2 and a table 1. That pays for
+// small cbuffers that change between draws.
+//
+// Each cbuffer that entries read, that isn't an array and that fits in
+// MaxDWords values is recommended. With a root signature in the module, the
+// recommendation says how its size changes, and is dropped if the cbuffer
+// already is root constants or the signature would no longer fit 64 DWORDs.
+// The shader code is the same either way; only the root signature changes.
+
+namespace {
+
+// Root signatures are limited to 64 DWORDs.
+static const unsigned kMaxRootSignatureDWords = 64;
+
+unsigned GetParameterDWords(const DxilRootParameter1 &P) {
+  switch (P.ParameterType) {
+  case DxilRootParameterType::DescriptorTable:
+    return 1;
+  case DxilRootParameterType::Constants32Bit:
+    return P.Constants.Num32BitValues;
+  default:
+    return 2;
+  }
+}
+
+DxilShaderVisibility GetShaderVisibility(DXIL::ShaderKind ShaderKind) {
+  switch (ShaderKind) {
+  case DXIL::ShaderKind::Pixel:    return DxilShaderVisibility::Pixel;
+  case DXIL::ShaderKind::Vertex:   return DxilShaderVisibility::Vertex;
+  case DXIL::ShaderKind::Geometry: return DxilShaderVisibility::Geometry;
+  case DXIL::ShaderKind::Hull:     return DxilShaderVisibility::Hull;
+  case DXIL::ShaderKind::Domain:   return DxilShaderVisibility::Domain;
+  default:                         return DxilShaderVisibility::All;
+  }
+}
+
+class DxilRootConstantCandidates : public ModulePass {
+  unsigned m_MaxDWords;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilRootConstantCandidates(unsigned MaxDWords = 8)
+      : ModulePass(ID), m_MaxDWords(MaxDWords) {}
+
+  const char *getPassName() const override {
+    return "DXIL root constant candidates";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "MaxDWords", &m_MaxDWords, 8);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    ModulePass::dumpConfig(OS);
+    OS << ",MaxDWords=" << m_MaxDWords;
+  }
+
+  bool runOnModule(Module &M) override;
+
+private:
+  DxilCBuffer *GetCBuffer(DxilModule &DM, Value *Handle);
+  void CollectReaders(DxilModule &DM,
+                      std::map<DxilCBuffer *, SmallVector<Function *, 2>> &Readers);
+  bool GetRootSignatureChange(DxilModule &DM, const DxilCBuffer &CB,
+                              unsigned DWords, unsigned &Before,
+                              unsigned &After);
+};
+
+// Gets the cbuffer a handle was created for, or null.
+DxilCBuffer *DxilRootConstantCandidates::GetCBuffer(DxilModule &DM,
+                                                    Value *Handle) {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (CI == nullptr || !OP::IsDxilOpFuncCallInst(CI))
+    return nullptr;
+  switch (OP::GetDxilOpFuncCallInst(CI)) {
+  case DXIL::OpCode::CreateHandle: {
+    DxilInst_CreateHandle CH(CI);
+    ConstantInt *Class = dyn_cast<ConstantInt>(CH.get_resourceClass());
+    ConstantInt *RangeId = dyn_cast<ConstantInt>(CH.get_rangeId());
+    if (Class == nullptr || RangeId == nullptr ||
+        Class->getZExtValue() != (unsigned)DXIL::ResourceClass::CBuffer ||
+        RangeId->getZExtValue() >= DM.GetCBuffers().size())
+      return nullptr;
+    return &DM.GetCBuffer(RangeId->getZExtValue());
+  }
+  case DXIL::OpCode::CreateHandleForLib: {
+    DxilInst_CreateHandleForLib CH(CI);
+    Value *Res = CH.get_Resource();
+    if (LoadInst *LI = dyn_cast<LoadInst>(Res))
+      Res = LI->getPointerOperand();
+    if (GEPOperator *GEP = dyn_cast<GEPOperator>(Res))
+      Res = GEP->getPointerOperand();
+    for (auto &CB : DM.GetCBuffers()) {
+      if (CB->GetGlobalSymbol() == Res)
+        return CB.get();
+    }
+    return nullptr;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+// Gets the entries that read each cbuffer.
+void DxilRootConstantCandidates::CollectReaders(
+    DxilModule &DM,
+    std::map<DxilCBuffer *, SmallVector<Function *, 2>> &Readers) {
+  Module &M = *DM.GetModule();
+  for (Function &Entry : M.functions()) {
+    if (Entry.isDeclaration() || !DM.HasDxilEntryProps(&Entry))
+      continue;
+    SetVector<Function *> Functions;
+    SetVector<DxilCBuffer *> CBuffers;
+    Functions.insert(&Entry);
+    for (unsigned i = 0; i < Functions.size(); ++i) {
+      for (BasicBlock &BB : *Functions[i]) {
+        for (Instruction &I : BB) {
+          CallInst *CI = dyn_cast<CallInst>(&I);
+          if (CI == nullptr || CI->getCalledFunction() == nullptr)
+            continue;
+          Function *Callee = CI->getCalledFunction();
+          if (!OP::IsDxilOpFunc(Callee)) {
+            if (!Callee->isDeclaration())
+              Functions.insert(Callee);
+            continue;
+          }
+          Value *Handle = nullptr;
+          switch (OP::GetDxilOpFuncCallInst(CI)) {
+          case DXIL::OpCode::CBufferLoadLegacy:
+            Handle = DxilInst_CBufferLoadLegacy(CI).get_handle();
+            break;
+          case DXIL::OpCode::CBufferLoad:
+            Handle = DxilInst_CBufferLoad(CI).get_handle();
+            break;
+          default:
+            continue;
+          }
+          if (DxilCBuffer *CB = GetCBuffer(DM, Handle))
+            CBuffers.insert(CB);
+        }
+      }
+    }
+    for (DxilCBuffer *CB : CBuffers)
+      Readers[CB].push_back(&Entry);
+  }
+}
+
+// Gets the size of the root signature of the module, before and after
+// binding CB as DWords root constants. Returns false if there is no root
+// signature, or CB already is root constants.
+bool DxilRootConstantCandidates::GetRootSignatureChange(DxilModule &DM,
+                                                        const DxilCBuffer &CB,
+                                                        unsigned DWords,
+                                                        unsigned &Before,
+                                                        unsigned &After) {
+  const std::vector<uint8_t> &Serialized = DM.GetSerializedRootSignature();
+  if (Serialized.empty())
+    return false;
+  std::shared_ptr<const CachedRootSignature> pRS;
+  try {
+    pRS = GetCachedRootSignature(Serialized.data(), Serialized.size());
+  } catch (...) {
+    return false;
+  }
+  const DxilVersionedRootSignatureDesc *pDesc = pRS->GetDesc();
+  const DxilVersionedRootSignatureDesc *pDesc1 = pDesc;
+  RootSignatureHandle Converted;
+  if (pDesc->Version != DxilRootSignatureVersion::Version_1_1) {
+    ConvertRootSignature(pDesc, DxilRootSignatureVersion::Version_1_1,
+                         &pDesc1);
+    Converted.Assign(pDesc1, nullptr);
+  }
+  const DxilRootSignatureDesc1 &RS = pDesc1->Desc_1_1;
+  DxilShaderVisibility Visibility =
+      GetShaderVisibility(DM.GetShaderModel()->GetKind());
+  uint32_t Space = CB.GetSpaceID(), Reg = CB.GetLowerBound();
+
+  Before = 0;
+  After = DWords;
+  for (unsigned i = 0; i < RS.NumParameters; ++i) {
+    const DxilRootParameter1 &P = RS.pParameters[i];
+    unsigned Cost = GetParameterDWords(P);
+    Before += Cost;
+    bool bVisible = P.ShaderVisibility == DxilShaderVisibility::All ||
+                    P.ShaderVisibility == Visibility;
+    switch (P.ParameterType) {
+    case DxilRootParameterType::Constants32Bit:
+      if (bVisible && P.Constants.RegisterSpace == Space &&
+          P.Constants.ShaderRegister == Reg)
+        return false;
+      break;
+    case DxilRootParameterType::CBV:
+      // The root CBV goes away.
+      if (bVisible && P.Descriptor.RegisterSpace == Space &&
+          P.Descriptor.ShaderRegister == Reg)
+        Cost = 0;
+      break;
+    case DxilRootParameterType::DescriptorTable:
+      // So does a table of just this CBV.
+      if (bVisible && P.DescriptorTable.NumDescriptorRanges == 1) {
+        const DxilDescriptorRange1 &R = P.DescriptorTable.pDescriptorRanges[0];
+        if (R.RangeType == DxilDescriptorRangeType::CBV &&
+            R.NumDescriptors == 1 && R.RegisterSpace == Space &&
+            R.BaseShaderRegister == Reg)
+          Cost = 0;
+      }
+      break;
+    default:
+      break;
+    }
+    After += Cost;
+  }
+  return true;
+}
+
+bool DxilRootConstantCandidates::runOnModule(Module &M) {
+  DxilModule &DM = M.GetOrCreateDxilModule();
+  std::map<DxilCBuffer *, SmallVector<Function *, 2>> Readers;
+  CollectReaders(DM, Readers);
+
+  for (auto &CB : DM.GetCBuffers()) {
+    auto It = Readers.find(CB.get());
+    if (It == Readers.end() || CB->GetRangeSize() != 1)
+      continue;
+    unsigned DWords = (CB->GetSize() + 3) / 4;
+    if (DWords == 0 || DWords > m_MaxDWords)
+      continue;
+
+    std::string Msg;
+    raw_string_ostream OS(Msg);
+    OS << "cbuffer " << CB->GetGlobalName() << " (" << CB->GetSize()
+       << " bytes, read by ";
+    for (unsigned i = 0; i < It->second.size(); ++i)
+      OS << (i ? ", " : "")
+         << dxilutil::DemangleFunctionName(It->second[i]->getName());
+    OS << ") could be " << DWords
+       << " root constants, if it changes often; reads then skip the "
+          "descriptor";
+    unsigned Before, After;
+    bool bHasRootSignature = !DM.GetSerializedRootSignature().empty();
+    if (GetRootSignatureChange(DM, *CB, DWords, Before, After)) {
+      if (After > kMaxRootSignatureDWords)
+        continue;
+      OS << ", and the root signature goes from " << Before << " to "
+         << After << " DWORDs";
+    } else if (bHasRootSignature) {
+      continue;
+    }
+    M.getContext().emitWarning(
+        dxilutil::FormatMessageWithoutLocation(OS.str()));
+  }
+  return false;
+}
+
+}
+
+char DxilRootConstantCandidates::ID = 0;
+
+ModulePass *llvm::createDxilRootConstantCandidatesPass(unsigned MaxDWords) {
+  return new DxilRootConstantCandidates(MaxDWords);
+}
+
+INITIALIZE_PASS(DxilRootConstantCandidates, "dxil-root-constant-candidates",
+                "DXIL root constant candidates", false, true)
@@ -0,0 +1,299 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilSelectControlFlowHints.cpp                                            //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Choose [branch] or [flatten] for branches that have no hint.              //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilMetadataHelper.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/SetVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Branches that the source doesn't annotate, and that no -Gfp or -Gfa
+// option hinted, get a hint from a cost estimate of the code on each side
+// and the uniformity of the condition:
+// - A condition that is uniform across the wave never diverges, so it is
+//   worth a branch as soon as a side costs more than BranchThreshold.
+// - When lanes may diverge, both sides often run anyway. The branch is kept
+//   only if the two sides together cost more than DivergentBranchThreshold,
+//   and is flattened if either side computes derivatives, since their
+//   neighbouring lanes must stay active.
+// - With a profile (-fprofile-use), a branch that goes one way at least
+//   BiasedRatio times as often as the other is kept, since the cold side
+//   rarely runs in any lane; unless lanes may diverge and a side computes
+//   derivatives. In ProfiledOnly mode, branches without weights are skipped.
+// Only if/else regions are hinted; branches that enter, leave or close
+// loops are left alone.
+
+namespace {
+
+struct SideCost {
+  unsigned Cost = 0;
+  bool bDerivatives = false;
+};
+
+class DxilSelectControlFlowHints : public FunctionPass {
+  unsigned m_BranchThreshold;
+  unsigned m_DivergentBranchThreshold;
+  unsigned m_BiasedRatio;
+  bool m_Report;
+  bool m_ProfiledOnly;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilSelectControlFlowHints(bool Report = false,
+                                      bool ProfiledOnly = false)
+      : FunctionPass(ID), m_BranchThreshold(16),
+        m_DivergentBranchThreshold(48), m_BiasedRatio(16), m_Report(Report),
+        m_ProfiledOnly(ProfiledOnly) {}
+
+  const char *getPassName() const override {
+    return "DXIL select control flow hints";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<PostDominatorTree>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.setPreservesAll();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "BranchThreshold", &m_BranchThreshold, 16);
+    GetPassOptionUnsigned(O, "DivergentBranchThreshold",
+                          &m_DivergentBranchThreshold, 48);
+    GetPassOptionUnsigned(O, "BiasedRatio", &m_BiasedRatio, 16);
+    GetPassOptionBool(O, "Report", &m_Report, false);
+    GetPassOptionBool(O, "ProfiledOnly", &m_ProfiledOnly, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",BranchThreshold=" << m_BranchThreshold;
+    OS << ",DivergentBranchThreshold=" << m_DivergentBranchThreshold;
+    OS << ",BiasedRatio=" << m_BiasedRatio;
+    OS << ",Report=" << m_Report;
+    OS << ",ProfiledOnly=" << m_ProfiledOnly;
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  bool GetSideCost(BasicBlock *Branch, BasicBlock *Succ, BasicBlock *Merge,
+                   DominatorTree &DT, LoopInfo &LI, SideCost &Side);
+  void Report(BranchInst *BI, bool bFlatten, const Twine &Reason);
+};
+
+char DxilSelectControlFlowHints::ID = 0;
+
+// Rough cost of an instruction in ALU operations.
+unsigned GetInstructionCost(Instruction &I, bool &bDerivatives) {
+  if (isa<PHINode>(I) || isa<DbgInfoIntrinsic>(I) || isa<BranchInst>(I))
+    return 0;
+  if (OP::IsDxilOpFuncCallInst(&I)) {
+    switch (OP::GetDxilOpFuncCallInst(&I)) {
+    case OP::OpCode::Sample:
+    case OP::OpCode::SampleBias:
+    case OP::OpCode::SampleCmp:
+    case OP::OpCode::CalculateLOD:
+      bDerivatives = true;
+      return 16;
+    case OP::OpCode::DerivCoarseX:
+    case OP::OpCode::DerivCoarseY:
+    case OP::OpCode::DerivFineX:
+    case OP::OpCode::DerivFineY:
+      bDerivatives = true;
+      return 2;
+    case OP::OpCode::SampleLevel:
+    case OP::OpCode::SampleGrad:
+    case OP::OpCode::SampleCmpLevelZero:
+    case OP::OpCode::TextureLoad:
+    case OP::OpCode::TextureGather:
+    case OP::OpCode::TextureGatherCmp:
+    case OP::OpCode::BufferLoad:
+    case OP::OpCode::RawBufferLoad:
+    case OP::OpCode::TextureStore:
+    case OP::OpCode::BufferStore:
+    case OP::OpCode::RawBufferStore:
+    case OP::OpCode::AtomicBinOp:
+    case OP::OpCode::AtomicCompareExchange:
+      return 16;
+    case OP::OpCode::CreateHandle:
+    case OP::OpCode::CBufferLoad:
+    case OP::OpCode::CBufferLoadLegacy:
+      return 1;
+    default:
+      return 4;
+    }
+  }
+  switch (I.getOpcode()) {
+  case Instruction::FDiv:
+  case Instruction::FRem:
+  case Instruction::UDiv:
+  case Instruction::SDiv:
+  case Instruction::URem:
+  case Instruction::SRem:
+    return 4;
+  case Instruction::Load:
+  case Instruction::Store:
+  case Instruction::AtomicRMW:
+  case Instruction::AtomicCmpXchg:
+    return 8;
+  default:
+    return 1;
+  }
+}
+
+// Sums the cost of the blocks between Succ and Merge. Returns false if they
+// aren't a single-entry region of the branch, or contain a loop.
+bool DxilSelectControlFlowHints::GetSideCost(BasicBlock *Branch,
+                                             BasicBlock *Succ,
+                                             BasicBlock *Merge,
+                                             DominatorTree &DT, LoopInfo &LI,
+                                             SideCost &Side) {
+  if (Succ == Merge)
+    return true;
+  SetVector<BasicBlock *> Blocks;
+  Blocks.insert(Succ);
+  for (unsigned i = 0; i < Blocks.size(); ++i) {
+    BasicBlock *BB = Blocks[i];
+    if (!DT.dominates(Branch, BB) || LI.isLoopHeader(BB) ||
+        LI.getLoopFor(BB) != LI.getLoopFor(Branch))
+      return false;
+    for (Instruction &I : *BB)
+      Side.Cost += GetInstructionCost(I, Side.bDerivatives);
+    for (BasicBlock *Next : successors(BB)) {
+      if (Next != Merge)
+        Blocks.insert(Next);
+    }
+  }
+  return true;
+}
+
+bool DxilSelectControlFlowHints::runOnFunction(Function &F) {
+  if (!F.getParent()->HasDxilModule())
+    return false;
+
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  PostDominatorTree &PDT = getAnalysis<PostDominatorTree>();
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  std::unique_ptr<WaveUniformityAnalysis> Uniformity;
+
+  LLVMContext &Ctx = F.getContext();
+  bool bChanged = false;
+  for (BasicBlock &BB : F) {
+    BranchInst *BI = dyn_cast<BranchInst>(BB.getTerminator());
+    if (!BI || !BI->isConditional() ||
+        BI->getMetadata(DxilMDHelper::kDxilControlFlowHintMDName))
+      continue;
+    uint64_t Weights[2];
+    bool bProfiled = dxilutil::GetBranchWeights(BI, &Weights[0], &Weights[1]) &&
+                     Weights[0] + Weights[1] != 0;
+    if (m_ProfiledOnly && !bProfiled)
+      continue;
+    DomTreeNode *Node = PDT.getNode(&BB);
+    if (!Node || !Node->getIDom() || !Node->getIDom()->getBlock())
+      continue;
+    BasicBlock *Merge = Node->getIDom()->getBlock();
+    if (LI.getLoopFor(Merge) != LI.getLoopFor(&BB))
+      continue;
+
+    SideCost Sides[2];
+    if (!GetSideCost(&BB, BI->getSuccessor(0), Merge, DT, LI, Sides[0]) ||
+        !GetSideCost(&BB, BI->getSuccessor(1), Merge, DT, LI, Sides[1]))
+      continue;
+
+    if (!Uniformity) {
+      Uniformity.reset(WaveUniformityAnalysis::create(PDT));
+      Uniformity->Analyze(&F);
+    }
+    bool bUniform = Uniformity->IsUniform(BI->getCondition());
+
+    bool bFlatten;
+    std::string Reason;
+    raw_string_ostream OS(Reason);
+    uint64_t Hot = std::max(Weights[0], Weights[1]);
+    uint64_t Cold = std::min(Weights[0], Weights[1]);
+    bool bDerivatives = Sides[0].bDerivatives || Sides[1].bDerivatives;
+    if (bProfiled && Hot >= Cold * m_BiasedRatio &&
+        (bUniform || !bDerivatives)) {
+      bFlatten = false;
+      OS << "the profile shows it goes one way " << Hot << " times to "
+         << Cold;
+    } else if (bUniform) {
+      bFlatten = std::max(Sides[0].Cost, Sides[1].Cost) <= m_BranchThreshold;
+      OS << "the condition is uniform";
+    } else if (bDerivatives) {
+      bFlatten = true;
+      OS << "lanes may diverge and a side computes derivatives";
+    } else {
+      bFlatten = Sides[0].Cost + Sides[1].Cost <= m_DivergentBranchThreshold;
+      OS << "lanes may diverge";
+    }
+    OS << "; the sides cost " << Sides[0].Cost << " and " << Sides[1].Cost;
+    OS.flush();
+
+    std::vector<DXIL::ControlFlowHint> Hints;
+    Hints.emplace_back(bFlatten ? DXIL::ControlFlowHint::Flatten
+                                : DXIL::ControlFlowHint::Branch);
+    BI->setMetadata(DxilMDHelper::kDxilControlFlowHintMDName,
+                    DxilMDHelper::EmitControlFlowHints(Ctx, Hints));
+    Report(BI, bFlatten, Reason);
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+void DxilSelectControlFlowHints::Report(BranchInst *BI, bool bFlatten,
+                                        const Twine &Reason) {
+  if (!m_Report)
+    return;
+  std::string Msg =
+      (Twine(bFlatten ? "[flatten]" : "[branch]") + " selected; " + Reason +
+       ".")
+          .str();
+  LLVMContext &Ctx = BI->getContext();
+  if (DebugLoc DL = BI->getDebugLoc())
+    Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, Msg));
+  else
+    Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+}
+
+}
+
+FunctionPass *llvm::createDxilSelectControlFlowHintsPass(bool Report,
+                                                        bool ProfiledOnly) {
+  return new DxilSelectControlFlowHints(Report, ProfiledOnly);
+}
+
+INITIALIZE_PASS_BEGIN(DxilSelectControlFlowHints,
+                      "dxil-select-control-flow-hints",
+                      "DXIL select control flow hints", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_END(DxilSelectControlFlowHints,
+                    "dxil-select-control-flow-hints",
+                    "DXIL select control flow hints", false, false)
@@ -6,14 +6,20 @@
 // License. See LICENSE.TXT for details.                                     //
 //                                                                           //
 // A simple version of GVN hoist for DXIL.                                   //
-// Based on GVNHoist in LLVM 6.0.                                            //                                                                           //
+// Based on GVNHoist in LLVM 6.0.                                            //
+// Also removes DXIL operations made redundant by a dominating one.          //
+//                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "dxc/HLSL/DxilGenerationPass.h"
 #include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilModule.h"
 
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Operator.h"
 
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/DenseMapInfo.h"
@@ -73,6 +79,73 @@ template <> struct DenseMapInfo<Expression> {
 } // namespace llvm
 
 namespace {
+// Resource globals of a module. Resource objects are never written after
+// DxilGeneration, so loads of them can be value numbered, and resources other
+// than UAVs are read-only for the whole shader.
+class ResourceGlobals {
+  DenseSet<Value *> Resources;
+  DenseSet<Value *> ReadOnlyResources;
+
+  static Value *GetBaseGlobal(Value *Ptr);
+
+public:
+  void init(Module &M);
+  bool isResourcePtr(Value *Ptr) const {
+    return Resources.count(GetBaseGlobal(Ptr)) != 0;
+  }
+  bool isReadOnlyHandle(Value *Handle) const;
+};
+
+Value *ResourceGlobals::GetBaseGlobal(Value *Ptr) {
+  while (GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr))
+    Ptr = GEP->getPointerOperand();
+  return Ptr;
+}
+
+void ResourceGlobals::init(Module &M) {
+  Resources.clear();
+  ReadOnlyResources.clear();
+  if (!M.HasDxilModule())
+    return;
+  DxilModule &DM = M.GetDxilModule();
+  for (auto &Res : DM.GetCBuffers())
+    ReadOnlyResources.insert(Res->GetGlobalSymbol());
+  for (auto &Res : DM.GetSamplers())
+    ReadOnlyResources.insert(Res->GetGlobalSymbol());
+  for (auto &Res : DM.GetSRVs())
+    ReadOnlyResources.insert(Res->GetGlobalSymbol());
+  Resources.insert(ReadOnlyResources.begin(), ReadOnlyResources.end());
+  for (auto &Res : DM.GetUAVs())
+    Resources.insert(Res->GetGlobalSymbol());
+}
+
+bool ResourceGlobals::isReadOnlyHandle(Value *Handle) const {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (!CI || !hlsl::OP::IsDxilOpFunc(CI->getCalledFunction()))
+    return false;
+  switch (hlsl::OP::GetDxilOpFuncCallInst(CI)) {
+  case DXIL::OpCode::CreateHandle: {
+    DxilInst_CreateHandle createHandle(CI);
+    if (!isa<ConstantInt>(createHandle.get_resourceClass()))
+      return false;
+    DXIL::ResourceClass RC = static_cast<DXIL::ResourceClass>(
+        createHandle.get_resourceClass_val());
+    return RC == DXIL::ResourceClass::SRV ||
+           RC == DXIL::ResourceClass::CBuffer ||
+           RC == DXIL::ResourceClass::Sampler;
+  }
+  case DXIL::OpCode::CreateHandleForLib: {
+    DxilInst_CreateHandleForLib createHandle(CI);
+    LoadInst *LI = dyn_cast<LoadInst>(createHandle.get_Resource());
+    if (!LI)
+      return false;
+    return ReadOnlyResources.count(GetBaseGlobal(LI->getPointerOperand())) != 0;
+  }
+  default:
+    return false;
+  }
+}
+
 // Simple Value table which support DXIL operation.
 class ValueTable {
   DenseMap<Value *, uint32_t> valueNumbering;
@@ -88,6 +161,7 @@ class ValueTable {
   std::vector<uint32_t> ExprIdx;
 
   DominatorTree *DT;
+  const ResourceGlobals *Resources = nullptr;
 
   uint32_t nextValueNumber = 1;
 
@@ -114,6 +188,7 @@ public:
   void clear();
   void erase(Value *v);
   void setDomTree(DominatorTree *D) { DT = D; }
+  void setResources(const ResourceGlobals *R) { Resources = R; }
   uint32_t getNextUnusedValueNumber() { return nextValueNumber; }
   void verifyRemoved(const Value *) const;
 };
@@ -256,7 +331,15 @@ uint32_t ValueTable::lookupOrAddCall(CallInst *C) {
       switch (Opcode) {
       default:
         break;
-        // TODO: make buffer/texture load on srv safe.
+      case DXIL::OpCode::TextureLoad:
+      case DXIL::OpCode::BufferLoad:
+      case DXIL::OpCode::RawBufferLoad:
+        // Loads are only safe on resources no thread can write. All of them
+        // take the handle as their first operand.
+        bSafe = Resources &&
+                Resources->isReadOnlyHandle(
+                    C->getArgOperand(DXIL::OperandIndex::kBufferLoadHandleOpIdx));
+        break;
       case DXIL::OpCode::CreateHandleForLib:
       case DXIL::OpCode::CBufferLoad:
       case DXIL::OpCode::CBufferLoadLegacy:
@@ -353,6 +436,15 @@ uint32_t ValueTable::lookupOrAdd(Value *V) {
     case Instruction::ExtractValue:
       exp = createExtractvalueExpr(cast<ExtractValueInst>(I));
       break;
+    case Instruction::Load:
+      // Loading a resource object always gives the same value.
+      if (Resources &&
+          Resources->isResourcePtr(cast<LoadInst>(I)->getPointerOperand())) {
+        exp = createExpr(I);
+        break;
+      }
+      valueNumbering[V] = nextValueNumber;
+      return nextValueNumber++;
     case Instruction::PHI:
       valueNumbering[V] = nextValueNumber;
       return nextValueNumber++;
@@ -453,6 +545,7 @@ public:
   bool runOnFunction(Function &F) override;
 
 private:
+  ResourceGlobals Resources;
   bool tryToHoist(BasicBlock *BB, BasicBlock *Succ0, BasicBlock *Succ1);
 };
 
@@ -473,6 +566,7 @@ bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB, BasicBlock *Succ0,
                                     BasicBlock *Succ1) {
   // ValueNumber Succ0 and Succ1.
   ValueTable VT;
+  VT.setResources(&Resources);
   DenseMap<uint32_t, SmallVector<Instruction *, 2>> VNtoInsts;
   for (Instruction &I : *Succ0) {
     uint32_t V = VT.lookupOrAdd(&I);
@@ -533,6 +627,7 @@ bool DxilSimpleGVNHoist::tryToHoist(BasicBlock *BB, BasicBlock *Succ0,
 }
 
 bool DxilSimpleGVNHoist::runOnFunction(Function &F) {
+  Resources.init(*F.getParent());
   BasicBlock &Entry = F.getEntryBlock();
   bool bUpdated = false;
   for (auto it = po_begin(&Entry); it != po_end(&Entry); it++) {
@@ -564,3 +659,128 @@ FunctionPass *llvm::createDxilSimpleGVNHoistPass() {
 
 INITIALIZE_PASS(DxilSimpleGVNHoist, "dxil-gvn-hoist",
                 "DXIL simple gvn hoist", false, false)
+
+namespace {
+// Remove DXIL operations that recompute the result of an identical operation
+// dominating them anywhere in the function, like a texture load repeated
+// after the branch that first read it:
+// float4 c = tex.Load(uv);
+// if (a.x > 0)
+//   c += tex.Load(uv);
+// Constant buffer rows are also shared between blocks that do not dominate
+// each other.
+class DxilSimpleGVNEliminate : public FunctionPass {
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilSimpleGVNEliminate() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL simple GVN eliminate";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  bool runOnFunction(Function &F) override;
+};
+
+char DxilSimpleGVNEliminate::ID = 0;
+
+// Only DXIL operations and the extracts of their results are replaced. Other
+// instructions are left to GVN, since the value table ignores flags such as
+// nsw or fast-math that differ between otherwise equal instructions.
+bool IsEliminationCandidate(Instruction *I) {
+  if (isa<ExtractValueInst>(I))
+    return true;
+  if (CallInst *CI = dyn_cast<CallInst>(I))
+    return !CI->getType()->isVoidTy() &&
+           hlsl::OP::IsDxilOpFunc(CI->getCalledFunction());
+  return false;
+}
+
+// Constant buffer loads cannot fault and are cheap to issue early.
+bool IsCBufferLoad(Instruction *I) {
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI || !hlsl::OP::IsDxilOpFunc(CI->getCalledFunction()))
+    return false;
+  DXIL::OpCode Opcode = hlsl::OP::GetDxilOpFuncCallInst(CI);
+  return Opcode == DXIL::OpCode::CBufferLoadLegacy ||
+         Opcode == DXIL::OpCode::CBufferLoad;
+}
+
+// Move I to the end of BB if all its operands are available there.
+bool TryHoistTo(Instruction *I, BasicBlock *BB, DominatorTree &DT) {
+  for (Value *Op : I->operands()) {
+    if (Instruction *OpI = dyn_cast<Instruction>(Op))
+      if (!DT.dominates(OpI->getParent(), BB))
+        return false;
+  }
+  I->moveBefore(BB->getTerminator());
+  return true;
+}
+
+bool DxilSimpleGVNEliminate::runOnFunction(Function &F) {
+  DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+  ResourceGlobals Resources;
+  Resources.init(*F.getParent());
+  ValueTable VT;
+  VT.setDomTree(&DT);
+  VT.setResources(&Resources);
+
+  // Instructions seen so far for each value number. Blocks are visited in
+  // reverse post order, so an instruction is visited after its dominators.
+  DenseMap<uint32_t, SmallVector<Instruction *, 2>> VNtoInsts;
+  bool bUpdated = false;
+  ReversePostOrderTraversal<Function *> RPOT(&F);
+  for (BasicBlock *BB : RPOT) {
+    for (auto It = BB->begin(); It != BB->end();) {
+      Instruction *I = It++;
+      if (!IsEliminationCandidate(I))
+        continue;
+      uint32_t VN = VT.lookupOrAdd(I);
+      auto &Insts = VNtoInsts[VN];
+      Instruction *Leader = nullptr;
+      for (Instruction *Candidate : Insts) {
+        if (DT.dominates(Candidate, I)) {
+          Leader = Candidate;
+          break;
+        }
+      }
+      // A constant buffer row read in blocks that do not dominate each other,
+      // like both sides of a branch and after it, is loaded once in their
+      // nearest common dominator instead.
+      if (!Leader && !Insts.empty() && IsCBufferLoad(I)) {
+        Instruction *Candidate = Insts.front();
+        BasicBlock *NCD =
+            DT.findNearestCommonDominator(Candidate->getParent(), BB);
+        if (NCD && TryHoistTo(Candidate, NCD, DT))
+          Leader = Candidate;
+      }
+      if (!Leader) {
+        Insts.emplace_back(I);
+        continue;
+      }
+      I->replaceAllUsesWith(Leader);
+      VT.erase(I);
+      I->eraseFromParent();
+      bUpdated = true;
+    }
+  }
+  return bUpdated;
+}
+
+}
+
+FunctionPass *llvm::createDxilSimpleGVNEliminatePass() {
+  return new DxilSimpleGVNEliminate();
+}
+
+INITIALIZE_PASS_BEGIN(DxilSimpleGVNEliminate, "dxil-gvn-eliminate",
+                      "DXIL simple gvn eliminate", false, false)
+INITIALIZE_PASS_DEPENDENCY(DominatorTreeWrapperPass)
+INITIALIZE_PASS_END(DxilSimpleGVNEliminate, "dxil-gvn-eliminate",
+                    "DXIL simple gvn eliminate", false, false)
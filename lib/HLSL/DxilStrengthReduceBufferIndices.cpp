@@ -0,0 +1,276 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilStrengthReduceBufferIndices.cpp                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Turns the buffer rows and offsets that loops compute from their counter   //
+// into values that step by a constant each iteration.                       //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/ScalarEvolution.h"
+#include "llvm/Analysis/ScalarEvolutionExpander.h"
+#include "llvm/Analysis/ScalarEvolutionExpressions.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueHandle.h"
+#include "llvm/Pass.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Transforms/Utils/LoopUtils.h"
+
+using namespace llvm;
+using namespace hlsl;
+
+// A loop over a cbuffer array or a buffer computes the row or offset of each
+// access from the loop counter, index * stride + base, on every iteration.
+// An index that scalar evolution sees as start + iteration * step, with a
+// constant step, is instead read from a PHI that starts at start and adds
+// step at the latch, so the multiply goes away.
+//
+// Accesses whose indices step by the same amount and start a constant apart
+// share one PHI and add their constant difference to it. That is what the
+// copies of the body that partial unrolling makes look like, once
+// DxilLoopUnroll and LoopUnroll are done: each copy steps by the unrolled
+// stride and is a fixed number of rows past the first.
+//
+// Indices that already are a PHI of the loop, or such a PHI plus a constant,
+// are left alone, since they cost no more than what would replace them.
+
+namespace {
+
+class DxilStrengthReduceBufferIndices : public FunctionPass {
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilStrengthReduceBufferIndices() : FunctionPass(ID) {}
+
+  const char *getPassName() const override {
+    return "DXIL strength reduce buffer indices";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolution>();
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  // An index operand of a buffer access.
+  struct Candidate {
+    CallInst *CI;
+    unsigned OpIdx;
+    const SCEVAddRecExpr *AR;
+  };
+  // Indices with the same step and starts a constant apart.
+  struct Stride {
+    const SCEV *Step;
+    const SCEV *Start;
+    PHINode *PN;
+    DenseMap<int64_t, Value *> Offsets;
+  };
+
+  ScalarEvolution *m_SE;
+
+  static void GetIndexOperands(CallInst *CI, SmallVectorImpl<unsigned> &Ops);
+  static bool IsCheap(Value *V, Loop *L);
+  bool ReduceLoop(Loop *L);
+};
+
+// Gets the operands of a buffer access that hold a row, index or offset.
+void DxilStrengthReduceBufferIndices::GetIndexOperands(
+    CallInst *CI, SmallVectorImpl<unsigned> &Ops) {
+  if (!OP::IsDxilOpFuncCallInst(CI))
+    return;
+  switch (OP::GetDxilOpFuncCallInst(CI)) {
+  case DXIL::OpCode::CBufferLoadLegacy:
+    Ops.push_back(DxilInst_CBufferLoadLegacy::arg_regIndex);
+    break;
+  case DXIL::OpCode::CBufferLoad:
+    Ops.push_back(DxilInst_CBufferLoad::arg_byteOffset);
+    break;
+  case DXIL::OpCode::BufferLoad:
+    Ops.push_back(DxilInst_BufferLoad::arg_index);
+    Ops.push_back(DxilInst_BufferLoad::arg_wot);
+    break;
+  case DXIL::OpCode::RawBufferLoad:
+    Ops.push_back(DxilInst_RawBufferLoad::arg_index);
+    Ops.push_back(DxilInst_RawBufferLoad::arg_elementOffset);
+    break;
+  case DXIL::OpCode::BufferStore:
+    Ops.push_back(DxilInst_BufferStore::arg_coord0);
+    Ops.push_back(DxilInst_BufferStore::arg_coord1);
+    break;
+  case DXIL::OpCode::RawBufferStore:
+    Ops.push_back(DxilInst_RawBufferStore::arg_index);
+    Ops.push_back(DxilInst_RawBufferStore::arg_elementOffset);
+    break;
+  default:
+    break;
+  }
+}
+
+// Returns true if V is a PHI of L's header, or one plus a constant.
+bool DxilStrengthReduceBufferIndices::IsCheap(Value *V, Loop *L) {
+  if (BinaryOperator *BO = dyn_cast<BinaryOperator>(V)) {
+    if (BO->getOpcode() != Instruction::Add)
+      return false;
+    if (isa<Constant>(BO->getOperand(1)))
+      V = BO->getOperand(0);
+    else if (isa<Constant>(BO->getOperand(0)))
+      V = BO->getOperand(1);
+    else
+      return false;
+  }
+  PHINode *PN = dyn_cast<PHINode>(V);
+  return PN && PN->getParent() == L->getHeader();
+}
+
+bool DxilStrengthReduceBufferIndices::ReduceLoop(Loop *L) {
+  BasicBlock *Latch = L->getLoopLatch();
+  if (!Latch)
+    return false;
+
+  SmallVector<Candidate, 8> Candidates;
+  for (BasicBlock *BB : L->getBlocks()) {
+    for (Instruction &I : *BB) {
+      CallInst *CI = dyn_cast<CallInst>(&I);
+      if (!CI)
+        continue;
+      SmallVector<unsigned, 2> Ops;
+      GetIndexOperands(CI, Ops);
+      for (unsigned OpIdx : Ops) {
+        Instruction *Index = dyn_cast<Instruction>(CI->getArgOperand(OpIdx));
+        if (!Index || !Index->getType()->isIntegerTy(32) ||
+            !L->contains(Index) || IsCheap(Index, L))
+          continue;
+        const SCEVAddRecExpr *AR =
+            dyn_cast<SCEVAddRecExpr>(m_SE->getSCEV(Index));
+        if (!AR || AR->getLoop() != L || !AR->isAffine() ||
+            !isa<SCEVConstant>(AR->getStepRecurrence(*m_SE)) ||
+            !isSafeToExpand(AR->getStart(), *m_SE))
+          continue;
+        Candidate C = {CI, OpIdx, AR};
+        Candidates.push_back(C);
+      }
+    }
+  }
+  if (Candidates.empty())
+    return false;
+  // Later passes may have folded an empty preheader away.
+  BasicBlock *Preheader = L->getLoopPreheader();
+  if (!Preheader)
+    Preheader = InsertPreheaderForLoop(L, this);
+  if (!Preheader)
+    return false;
+
+  const DataLayout &DL = L->getHeader()->getModule()->getDataLayout();
+  SCEVExpander Expander(*m_SE, DL, "dxil.sr");
+  Expander.disableCanonicalMode();
+  SmallVector<Stride, 4> Strides;
+  // An index may be used by more than one access, so it may already be
+  // deleted when its turn comes.
+  SmallVector<WeakVH, 8> Replaced;
+  for (const Candidate &C : Candidates) {
+    const SCEV *Start = C.AR->getStart();
+    const SCEV *Step = C.AR->getStepRecurrence(*m_SE);
+    Stride *S = nullptr;
+    int64_t Offset = 0;
+    for (Stride &Existing : Strides) {
+      if (Existing.Step != Step)
+        continue;
+      const SCEVConstant *Delta = dyn_cast<SCEVConstant>(
+          m_SE->getMinusSCEV(Start, Existing.Start));
+      if (Delta) {
+        S = &Existing;
+        Offset = Delta->getValue()->getSExtValue();
+        break;
+      }
+    }
+    Type *Ty = C.CI->getArgOperand(C.OpIdx)->getType();
+    if (!S) {
+      Stride NewStride;
+      NewStride.Step = Step;
+      NewStride.Start = Start;
+      Value *StartV =
+          Expander.expandCodeFor(Start, Ty, Preheader->getTerminator());
+      IRBuilder<> Builder(L->getHeader()->getFirstNonPHI());
+      PHINode *PN = Builder.CreatePHI(Ty, 2, "dxil.sr.index");
+      Builder.SetInsertPoint(Latch->getTerminator());
+      Value *Next = Builder.CreateAdd(
+          PN, cast<SCEVConstant>(Step)->getValue(), "dxil.sr.next");
+      for (BasicBlock *Pred : predecessors(L->getHeader()))
+        PN->addIncoming(Pred == Latch ? Next : StartV, Pred);
+      NewStride.PN = PN;
+      NewStride.Offsets[0] = PN;
+      Strides.push_back(NewStride);
+      S = &Strides.back();
+    }
+
+    Value *&V = S->Offsets[Offset];
+    if (!V) {
+      // Computed once per iteration, where every access in the loop sees it.
+      IRBuilder<> Builder(L->getHeader()->getFirstInsertionPt());
+      V = Builder.CreateAdd(S->PN, ConstantInt::get(Ty, Offset, true),
+                            "dxil.sr.index");
+    }
+    Replaced.push_back(C.CI->getArgOperand(C.OpIdx));
+    C.CI->setArgOperand(C.OpIdx, V);
+  }
+
+  for (WeakVH &V : Replaced) {
+    if (V)
+      RecursivelyDeleteTriviallyDeadInstructions(V);
+  }
+  m_SE->forgetLoop(L);
+  return true;
+}
+
+bool DxilStrengthReduceBufferIndices::runOnFunction(Function &F) {
+  if (!F.getParent()->HasDxilModule())
+    return false;
+
+  LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+  m_SE = &getAnalysis<ScalarEvolution>();
+
+  SmallVector<Loop *, 8> Loops;
+  SmallVector<Loop *, 8> Worklist(LI.begin(), LI.end());
+  while (!Worklist.empty()) {
+    Loop *L = Worklist.pop_back_val();
+    Loops.push_back(L);
+    Worklist.append(L->begin(), L->end());
+  }
+
+  bool bChanged = false;
+  for (Loop *L : Loops)
+    bChanged |= ReduceLoop(L);
+  return bChanged;
+}
+
+}
+
+char DxilStrengthReduceBufferIndices::ID = 0;
+
+FunctionPass *llvm::createDxilStrengthReduceBufferIndicesPass() {
+  return new DxilStrengthReduceBufferIndices();
+}
+
+INITIALIZE_PASS_BEGIN(DxilStrengthReduceBufferIndices,
+                      "dxil-strength-reduce-buffer-indices",
+                      "DXIL strength reduce buffer indices", false, false)
+INITIALIZE_PASS_DEPENDENCY(LoopInfoWrapperPass)
+INITIALIZE_PASS_DEPENDENCY(ScalarEvolution)
+INITIALIZE_PASS_END(DxilStrengthReduceBufferIndices,
+                    "dxil-strength-reduce-buffer-indices",
+                    "DXIL strength reduce buffer indices", false, false)
@@ -9,13 +9,15 @@
 //
 // \file
 // This file implements a TargetTransformInfo analysis pass specific to the
-// DXIL. Only implemented isSourceOfDivergence for DivergenceAnalysis.
+// DXIL. Implements isSourceOfDivergence for DivergenceAnalysis, and the user
+// costs that CodeMetrics sizes code with.
 //
 //===----------------------------------------------------------------------===//
 
 #include "DxilTargetTransformInfo.h"
 #include "dxc/DXIL/DxilModule.h"
 #include "dxc/DXIL/DxilOperations.h"
+#include "dxc/HLSL/DxilGenerationPass.h"
 #include "llvm/CodeGen/BasicTTIImpl.h"
 
 using namespace llvm;
@@ -94,3 +96,31 @@ bool DxilTTIImpl::isSourceOfDivergence(const Value *V) const {
 
   return false;
 }
+
+unsigned DxilTTIImpl::getOperationCost(unsigned Opcode, Type *Ty, Type *OpTy) {
+  switch (Opcode) {
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+    return TTI::TCC_Basic;
+  default:
+    return TargetTransformInfoImplBase::getOperationCost(Opcode, Ty, OpTy);
+  }
+}
+
+unsigned DxilTTIImpl::getIntrinsicCost(Intrinsic::ID IID, Type *RetTy,
+                                       ArrayRef<Type *> ParamTys) {
+  return TargetTransformInfoImplBase::getIntrinsicCost(IID, RetTy, ParamTys);
+}
+
+/// DXIL operations are single instructions to the driver, not calls.
+bool DxilTTIImpl::isLoweredToCall(const Function *F) {
+  if (OP::IsDxilOpFunc(F))
+    return false;
+  return BaseT::isLoweredToCall(F);
+}
+
+TargetTransformInfo hlsl::CreateDxilTargetTransformInfo(Function &F) {
+  return TargetTransformInfo(DxilTTIImpl(nullptr, F,
+                                         F.getParent()->GetDxilModule(),
+                                         /*ThreadGroup*/ false));
+}
@@ -8,7 +8,8 @@
 //===----------------------------------------------------------------------===//
 /// \file
 /// This file declares a TargetTransformInfo analysis pass specific to the DXIL.
-/// Only implemented isSourceOfDivergence for DivergenceAnalysis.
+/// Implements isSourceOfDivergence for DivergenceAnalysis, and the user costs
+/// that CodeMetrics sizes code with.
 ///
 //===----------------------------------------------------------------------===//
 
@@ -38,6 +39,13 @@ public:
 
   bool hasBranchDivergence() { return true; }
   bool isSourceOfDivergence(const Value *V) const;
+
+  // There is no target lowering to ask, so these don't use it.
+  unsigned getOperationCost(unsigned Opcode, Type *Ty, Type *OpTy);
+  using BaseT::getIntrinsicCost;
+  unsigned getIntrinsicCost(Intrinsic::ID IID, Type *RetTy,
+                            ArrayRef<Type *> ParamTys);
+  bool isLoweredToCall(const Function *F);
 };
 
 } // end namespace llvm
@@ -39,9 +39,12 @@
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
+#include "llvm/IR/TypeFinder.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PhaseTiming.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include <unordered_set>
 #include "llvm/Analysis/LoopInfo.h"
@@ -52,7 +55,11 @@
 #include "dxc/HLSL/DxilPackSignatureElement.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include <algorithm>
+#include <atomic>
 #include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 using namespace llvm;
 using namespace std;
@@ -395,6 +402,30 @@ struct ValidationContext {
   const unsigned kLLVMLoopMDKind;
   unsigned m_DxilMajor, m_DxilMinor;
 
+  // Diagnostics of a function validated with others in parallel. They are
+  // kept apart and appended to DiagPrinter in module order afterwards.
+  struct FunctionDiag {
+    std::string Text;
+    raw_string_ostream OS;
+    DiagnosticPrinterRawOStream Printer;
+    DebugLoc LastDebugLocEmit;
+    ValidationRule LastRuleEmit;
+    bool Failed;
+    FunctionDiag()
+        : OS(Text), Printer(OS), LastRuleEmit((ValidationRule)-1),
+          Failed(false) {}
+  };
+  std::mutex FunctionDiagMutex;
+  std::unordered_map<std::thread::id, FunctionDiag *> FunctionDiags;
+
+  // Where the diagnostics of the calling thread go.
+  struct DiagTarget {
+    DiagnosticPrinterRawOStream &Printer;
+    DebugLoc &LastDebugLocEmit;
+    ValidationRule &LastRuleEmit;
+    bool &Failed;
+  };
+
   ValidationContext(Module &llvmModule, Module *DebugModule,
                     DxilModule &dxilModule,
                     DiagnosticPrinterRawOStream &DiagPrn)
@@ -582,17 +613,40 @@ struct ValidationContext {
     return entryStatusMap.find(F) != entryStatusMap.end();
   }
 
-  EntryStatus &GetEntryStatus(Function *F) { return *entryStatusMap[F]; }
+  EntryStatus &GetEntryStatus(Function *F) {
+    DXASSERT(HasEntryStatus(F), "otherwise, F is not an entry");
+    return *entryStatusMap.find(F)->second;
+  }
 
   DxilResourceBase *GetResourceFromVal(Value *resVal);
 
+  // Sends the diagnostics of the calling thread to FD, or back to
+  // DiagPrinter when FD is null.
+  void SetFunctionDiag(FunctionDiag *FD) {
+    std::lock_guard<std::mutex> lock(FunctionDiagMutex);
+    if (FD)
+      FunctionDiags[std::this_thread::get_id()] = FD;
+    else
+      FunctionDiags.erase(std::this_thread::get_id());
+  }
+
+  DiagTarget Diag() {
+    std::lock_guard<std::mutex> lock(FunctionDiagMutex);
+    auto it = FunctionDiags.find(std::this_thread::get_id());
+    if (it != FunctionDiags.end()) {
+      FunctionDiag &FD = *it->second;
+      return {FD.Printer, FD.LastDebugLocEmit, FD.LastRuleEmit, FD.Failed};
+    }
+    return {DiagPrinter, LastDebugLocEmit, LastRuleEmit, Failed};
+  }
+
   // Provide direct access to the raw_ostream in DiagPrinter.
   raw_ostream &DiagStream() {
     struct DiagnosticPrinterRawOStream_Pub : public DiagnosticPrinterRawOStream {
     public:
       raw_ostream &DiagStream() { return Stream; }
     };
-    DiagnosticPrinterRawOStream_Pub* p = (DiagnosticPrinterRawOStream_Pub*)&DiagPrinter;
+    DiagnosticPrinterRawOStream_Pub* p = (DiagnosticPrinterRawOStream_Pub*)&Diag().Printer;
     return p->DiagStream();
   }
 
@@ -602,8 +656,9 @@ struct ValidationContext {
 
   // This is the least desirable mechanism, as it has no context.
   void EmitError(ValidationRule rule) {
-    DiagPrinter << GetValidationRuleText(rule) << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << GetValidationRuleText(rule) << '\n';
+    D.Failed = true;
   }
 
   void FormatRuleText(std::string &ruleText, ArrayRef<StringRef> args) {
@@ -634,22 +689,25 @@ struct ValidationContext {
   void EmitFormatError(ValidationRule rule, ArrayRef<StringRef> args) {
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
-    DiagPrinter << ruleText << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << ruleText << '\n';
+    D.Failed = true;
   }
 
   void EmitMetaError(Metadata *Meta, ValidationRule rule) {
-    DiagPrinter << GetValidationRuleText(rule);
+    DiagTarget D = Diag();
+    D.Printer << GetValidationRuleText(rule);
     Meta->print(DiagStream(), &M);
-    DiagPrinter << '\n';
-    Failed = true;
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   void EmitResourceError(const hlsl::DxilResourceBase *Res, ValidationRule rule) {
-    DiagPrinter << GetValidationRuleText(rule);
-    DiagPrinter << '\'' << Res->GetGlobalName() << '\'';
-    DiagPrinter << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << GetValidationRuleText(rule);
+    D.Printer << '\'' << Res->GetGlobalName() << '\'';
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   void EmitResourceFormatError(const hlsl::DxilResourceBase *Res,
@@ -657,10 +715,11 @@ struct ValidationContext {
                                ArrayRef<StringRef> args) {
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
-    DiagPrinter << ruleText;
-    DiagPrinter << '\'' << Res->GetGlobalName() << '\'';
-    DiagPrinter << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << ruleText;
+    D.Printer << '\'' << Res->GetGlobalName() << '\'';
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   bool IsDebugFunctionCall(Instruction *I) {
@@ -691,27 +750,28 @@ struct ValidationContext {
   }
 
   bool EmitInstrLoc(Instruction *I, ValidationRule Rule) {
+    DiagTarget D = Diag();
     const DebugLoc &L = GetDebugLoc(I);
     if (L) {
       // Instructions that get scalarized will likely hit
       // this case. Avoid redundant diagnostic messages.
-      if (Rule == LastRuleEmit && L == LastDebugLocEmit) {
+      if (Rule == D.LastRuleEmit && L == D.LastDebugLocEmit) {
         return false;
       }
-      LastRuleEmit = Rule;
-      LastDebugLocEmit = L;
+      D.LastRuleEmit = Rule;
+      D.LastDebugLocEmit = L;
 
       L.print(DiagStream());
-      DiagPrinter << ' ';
+      D.Printer << ' ';
       return true;
     }
     BasicBlock *BB = I->getParent();
     Function *F = BB->getParent();
 
-    DiagPrinter << "at " << I;
-    DiagPrinter << " inside block ";
+    D.Printer << "at " << I;
+    D.Printer << " inside block ";
     if (!BB->getName().empty()) {
-      DiagPrinter << BB->getName();
+      D.Printer << BB->getName();
     }
     else {
       unsigned idx = 0;
@@ -721,17 +781,18 @@ struct ValidationContext {
           break;
         }
       }
-      DiagPrinter << "#" << idx;
+      D.Printer << "#" << idx;
     }
-    DiagPrinter << " of function " << *F << ' ';
+    D.Printer << " of function " << *F << ' ';
     return true;
   }
 
   void EmitInstrError(Instruction *I, ValidationRule rule) {
     if (!EmitInstrLoc(I, rule)) return;
-    DiagPrinter << GetValidationRuleText(rule);
-    DiagPrinter << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << GetValidationRuleText(rule);
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   void EmitInstrFormatError(Instruction *I, ValidationRule rule, ArrayRef<StringRef> args) {
@@ -739,9 +800,10 @@ struct ValidationContext {
 
     std::string ruleText = GetValidationRuleText(rule);
     FormatRuleText(ruleText, args);
-    DiagPrinter << ruleText;
-    DiagPrinter << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << ruleText;
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   void EmitOperandOutOfRange(Instruction *I, StringRef name, StringRef range, StringRef v) {
@@ -749,9 +811,10 @@ struct ValidationContext {
 
     std::string ruleText = GetValidationRuleText(ValidationRule::InstrOperandRange);
     FormatRuleText(ruleText, {name, range, v});
-    DiagPrinter << ruleText;
-    DiagPrinter << '\n';
-    Failed = true;
+    DiagTarget D = Diag();
+    D.Printer << ruleText;
+    D.Printer << '\n';
+    D.Failed = true;
   }
 
   void EmitSignatureError(DxilSignatureElement *SE, ValidationRule rule) {
@@ -1497,7 +1560,7 @@ static void ValidateSignatureDxilOp(CallInst *CI, DXIL::OpCode opcode,
       ValCtx.EmitFormatError(ValidationRule::SmOpcodeInInvalidFunction,
                              {"StorePatchConstant", "PatchConstant function"});
     } else {
-      auto &hullShaders = ValCtx.PatchConstantFuncMap[func];
+      auto &hullShaders = ValCtx.PatchConstantFuncMap.find(func)->second;
       for (Function *F : hullShaders) {
         EntryStatus &Status = ValCtx.GetEntryStatus(F);
         DxilEntryProps &EntryProps = DM.GetDxilEntryProps(F);
@@ -3328,6 +3391,103 @@ static void ValidateFunction(Function &F, ValidationContext &ValCtx) {
   }
 }
 
+// Libraries with at least this many function definitions have them
+// validated on worker threads.
+static const unsigned kMinFunctionsForParallelValidation = 16;
+
+static bool CanValidateFunctionInParallel(Function &F,
+                                          ValidationContext &ValCtx) {
+  // Declarations look up dx.op overloads, which creates the missing ones, and
+  // patch constant functions update the signature status of their hull
+  // shaders. Both are validated on the calling thread.
+  return !F.isDeclaration() && !ValCtx.PatchConstantFuncMap.count(&F);
+}
+
+// Validates every function, and reports their errors in module order. With
+// bStopAtFirstError, functions are validated in turn until one fails.
+static void ValidateFunctions(ValidationContext &ValCtx,
+                              bool bStopAtFirstError) {
+  Module &M = ValCtx.M;
+  if (bStopAtFirstError) {
+    for (Function &F : M.functions()) {
+      ValidateFunction(F, ValCtx);
+      if (ValCtx.Failed)
+        return;
+    }
+    return;
+  }
+
+  std::vector<Function *> ParallelFunctions;
+  if (ValCtx.isLibProfile) {
+    for (Function &F : M.functions()) {
+      if (CanValidateFunctionInParallel(F, ValCtx))
+        ParallelFunctions.emplace_back(&F);
+    }
+  }
+  if (ParallelFunctions.size() < kMinFunctionsForParallelValidation) {
+    for (Function &F : M.functions())
+      ValidateFunction(F, ValCtx);
+    return;
+  }
+
+  // Create what validation would otherwise create on first use.
+  ValCtx.DxilMod.GetTypeSystem();
+  TypeFinder StructTypes;
+  StructTypes.run(M, /*onlyNamed*/ false);
+  for (StructType *ST : StructTypes)
+    IsDxilBuiltinStructType(ST, ValCtx.DxilMod.GetOP());
+
+  // The diagnostics of each function are kept apart, so the output is the
+  // same whatever the number of threads. This also means that a repeated
+  // error isn't folded across two functions.
+  const unsigned NumFunctions = ParallelFunctions.size();
+  std::vector<std::unique_ptr<ValidationContext::FunctionDiag>> Diags(
+      NumFunctions);
+  std::vector<std::exception_ptr> Exceptions(NumFunctions);
+  std::atomic<unsigned> NextFunction(0);
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  auto validateParallelFunctions = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    for (unsigned i = NextFunction++; i < NumFunctions; i = NextFunction++) {
+      try {
+        Diags[i].reset(new ValidationContext::FunctionDiag());
+        ValCtx.SetFunctionDiag(Diags[i].get());
+        ValidateFunction(*ParallelFunctions[i], ValCtx);
+      } catch (...) {
+        Exceptions[i] = std::current_exception();
+      }
+      ValCtx.SetFunctionDiag(nullptr);
+    }
+  };
+
+  unsigned NumThreads =
+      std::min(std::max(std::thread::hardware_concurrency(), 1U),
+               NumFunctions / kMinFunctionsForParallelValidation + 1);
+  std::vector<std::thread> workers;
+  try {
+    for (unsigned i = 1; i < NumThreads; ++i)
+      workers.emplace_back(validateParallelFunctions);
+  } catch (...) {
+    // Validate what the workers that did start leave on this thread.
+  }
+  validateParallelFunctions();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  unsigned i = 0;
+  for (Function &F : M.functions()) {
+    if (i < NumFunctions && ParallelFunctions[i] == &F) {
+      if (Exceptions[i])
+        std::rethrow_exception(Exceptions[i]);
+      ValidationContext::FunctionDiag &FD = *Diags[i++];
+      ValCtx.DiagStream() << FD.OS.str();
+      ValCtx.Failed |= FD.Failed;
+      continue;
+    }
+    ValidateFunction(F, ValCtx);
+  }
+}
+
 static void ValidateGlobalVariable(GlobalVariable &GV,
                                    ValidationContext &ValCtx) {
   bool isInternalGV =
@@ -5089,7 +5249,8 @@ void GetValidationVersion(_Out_ unsigned *pMajor, _Out_ unsigned *pMinor) {
 }
 
 _Use_decl_annotations_ HRESULT
-ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
+ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule,
+                   const ValidationOptions &Options) {
   std::string diagStr;
   raw_string_ostream diagStream(diagStr);
   DiagnosticPrinterRawOStream DiagPrinter(diagStream);
@@ -5101,28 +5262,56 @@ ValidateDxilModule(llvm::Module *pModule, llvm::Module *pDebugModule) {
 
   ValidationContext ValCtx(*pModule, pDebugModule, *pDxilModule, DiagPrinter);
 
-  ValidateMetadata(ValCtx);
+  // Some steps rely on what earlier ones collected: the instruction checks
+  // use the call info of the control flow checks, and the signature and
+  // output checks of the metadata use the outputs that the instruction
+  // checks found written. The collecting groups run whenever one that
+  // depends on them is selected, so they report their errors too.
+  unsigned RuleGroups = Options.RuleGroups;
+  if (RuleGroups & ValidationRuleGroup::Metadata)
+    RuleGroups |= ValidationRuleGroup::Instructions;
+  if (RuleGroups & ValidationRuleGroup::Instructions)
+    RuleGroups |= ValidationRuleGroup::FlowControl;
+  auto RunStep = [&](unsigned Group, StringRef Name,
+                     llvm::function_ref<void()> Step) {
+    if (!(RuleGroups & Group))
+      return;
+    if (Options.StopAtFirstError && ValCtx.Failed)
+      return;
+    PhaseTimingRegion StepPhase(Options.ReportTimings ? Name : StringRef());
+    Step();
+  };
+
+  RunStep(ValidationRuleGroup::Metadata, "validation.metadata",
+          [&]() { ValidateMetadata(ValCtx); });
 
-  ValidateShaderState(ValCtx);
+  RunStep(ValidationRuleGroup::Metadata, "validation.shader-state",
+          [&]() { ValidateShaderState(ValCtx); });
 
-  ValidateGlobalVariables(ValCtx);
+  RunStep(ValidationRuleGroup::Declarations, "validation.globals",
+          [&]() { ValidateGlobalVariables(ValCtx); });
 
-  ValidateResources(ValCtx);
+  RunStep(ValidationRuleGroup::Declarations, "validation.resources",
+          [&]() { ValidateResources(ValCtx); });
 
   // Validate control flow and collect function call info.
   // If has recursive call, call info collection will not finish.
-  ValidateFlowControl(ValCtx);
+  RunStep(ValidationRuleGroup::FlowControl, "validation.flow-control",
+          [&]() { ValidateFlowControl(ValCtx); });
 
   // Validate functions.
-  for (Function &F : pModule->functions()) {
-    ValidateFunction(F, ValCtx);
-  }
+  RunStep(ValidationRuleGroup::Instructions, "validation.functions", [&]() {
+    ValidateFunctions(ValCtx, Options.StopAtFirstError);
+  });
 
-  ValidateShaderFlags(ValCtx);
+  RunStep(ValidationRuleGroup::Metadata, "validation.shader-flags",
+          [&]() { ValidateShaderFlags(ValCtx); });
 
-  ValidateEntrySignatures(ValCtx);
+  RunStep(ValidationRuleGroup::Metadata, "validation.signatures",
+          [&]() { ValidateEntrySignatures(ValCtx); });
 
-  ValidateUninitializedOutput(ValCtx);
+  RunStep(ValidationRuleGroup::Metadata, "validation.outputs",
+          [&]() { ValidateUninitializedOutput(ValCtx); });
   // Ensure error messages are flushed out on error.
   if (ValCtx.Failed) {
     emitDxilDiag(pModule->getContext(), diagStream.str().c_str());
@@ -5216,10 +5405,13 @@ static void VerifyPSVMatches(_In_ ValidationContext &ValCtx,
                              _In_ uint32_t PSVSize) {
   uint32_t PSVVersion = 1;  // This should be set to the newest version
   unique_ptr<DxilPartWriter> pWriter(NewPSVWriter(ValCtx.DxilMod, PSVVersion));
+  // Semantic names may have been written without sharing string table entries
+  if (pWriter->size() != PSVSize)
+    pWriter.reset(NewPSVWriter(ValCtx.DxilMod, PSVVersion, false));
   // Try each version in case an earlier version matches module
   while (PSVVersion && pWriter->size() != PSVSize) {
     PSVVersion --;
-    pWriter.reset(NewPSVWriter(ValCtx.DxilMod, PSVVersion));
+    pWriter.reset(NewPSVWriter(ValCtx.DxilMod, PSVVersion, false));
   }
   // generate PSV data from module and memcmp
   VerifyBlobPartMatches(ValCtx, "Pipeline State Validation", pWriter.get(), pPSVData, PSVSize);
@@ -5255,8 +5447,8 @@ static void VerifyRDATMatches(_In_ ValidationContext &ValCtx,
   const char *PartName = "Runtime Data (RDAT)";
   // If DxilModule subobjects already loaded, validate these against the RDAT blob,
   // otherwise, load subobject into DxilModule to generate reference RDAT.
+  RDAT::DxilRuntimeData rdat(pRDATData, RDATSize);
   if (!ValCtx.DxilMod.GetSubobjects()) {
-    RDAT::DxilRuntimeData rdat(pRDATData, RDATSize);
     auto *pSubobjReader = rdat.GetSubobjectTableReader();
     if (pSubobjReader && pSubobjReader->GetCount() > 0) {
       ValCtx.DxilMod.ResetSubobjects(new DxilSubobjects());
@@ -5267,7 +5459,9 @@ static void VerifyRDATMatches(_In_ ValidationContext &ValCtx,
     }
   }
 
-  unique_ptr<DxilPartWriter> pWriter(NewRDATWriter(ValCtx.DxilMod, 0));
+  // Containers from before name indices don't have them; match either.
+  uint32_t InfoVersion = rdat.HasNameIndex() ? 1 : 0;
+  unique_ptr<DxilPartWriter> pWriter(NewRDATWriter(ValCtx.DxilMod, InfoVersion));
   VerifyBlobPartMatches(ValCtx, PartName, pWriter.get(), pRDATData, RDATSize);
 
   // Verify no errors when runtime reflection from RDAT:
@@ -5312,9 +5506,15 @@ _Use_decl_annotations_
 HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
                                    llvm::Module *pDebugModule,
                                    const DxilContainerHeader *pContainer,
-                                   uint32_t ContainerSize) {
+                                   uint32_t ContainerSize,
+                                   const ValidationOptions &Options) {
 
   DXASSERT_NOMSG(pModule);
+  if (!(Options.RuleGroups & ValidationRuleGroup::Container))
+    return S_OK;
+  PhaseTimingRegion ContainerPhase(
+      Options.ReportTimings ? "validation.container" : "");
+
   if (!pContainer || !IsValidDxilContainer(pContainer, ContainerSize)) {
     return DXC_E_CONTAINER_INVALID;
   }
@@ -5444,13 +5644,12 @@ HRESULT ValidateDxilContainerParts(llvm::Module *pModule,
     if (pPSVPart) {
       if (pRootSignaturePart) {
         try {
-          RootSignatureHandle RS;
-          RS.LoadSerialized((const uint8_t*)GetDxilPartData(pRootSignaturePart), pRootSignaturePart->PartSize);
-          RS.Deserialize();
-          IFTBOOL(VerifyRootSignatureWithShaderPSV(RS.GetDesc(),
-                                                   pDxilModule->GetShaderModel()->GetKind(),
-                                                   GetDxilPartData(pPSVPart), pPSVPart->PartSize,
-                                                   DiagStream),
+          std::shared_ptr<const CachedRootSignature> pRS =
+              GetCachedRootSignature(GetDxilPartData(pRootSignaturePart),
+                                     pRootSignaturePart->PartSize);
+          IFTBOOL(pRS->VerifyShaderPSV(pDxilModule->GetShaderModel()->GetKind(),
+                                       GetDxilPartData(pPSVPart), pPSVPart->PartSize,
+                                       DiagStream),
                   DXC_E_INCORRECT_ROOT_SIGNATURE);
         } catch (...) {
           ValCtx.EmitError(ValidationRule::ContainerRootSignatureIncompatible);
@@ -5532,7 +5731,8 @@ HRESULT ValidateLoadModule(const char *pIL,
 HRESULT ValidateDxilBitcode(
   _In_reads_bytes_(ILLength) const char *pIL,
   _In_ uint32_t ILLength,
-  _In_ llvm::raw_ostream &DiagStream) {
+  _In_ llvm::raw_ostream &DiagStream,
+  const ValidationOptions &Options) {
 
   LLVMContext Ctx;
   std::unique_ptr<llvm::Module> pModule;
@@ -5547,7 +5747,7 @@ HRESULT ValidateDxilBitcode(
                                      /*bLazyLoad*/ false)))
     return hr;
 
-  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr)))
+  if (FAILED(hr = ValidateDxilModule(pModule.get(), nullptr, Options)))
     return hr;
 
   DxilModule &dxilModule = pModule->GetDxilModule();
@@ -5560,15 +5760,11 @@ HRESULT ValidateDxilBitcode(
     pOutputStream->Reserve(pWriter->size());
     pWriter->write(pOutputStream);
     try {
-      const DxilVersionedRootSignatureDesc* pDesc = nullptr;
-      DeserializeRootSignature(SerializedRootSig.data(), SerializedRootSig.size(), &pDesc);
-      if (!pDesc) {
-        return DXC_E_INCORRECT_ROOT_SIGNATURE;
-      }
-      IFTBOOL(VerifyRootSignatureWithShaderPSV(pDesc,
-                                               dxilModule.GetShaderModel()->GetKind(),
-                                               pOutputStream->GetPtr(), pWriter->size(),
-                                               DiagStream), DXC_E_INCORRECT_ROOT_SIGNATURE);
+      std::shared_ptr<const CachedRootSignature> pRS = GetCachedRootSignature(
+          SerializedRootSig.data(), SerializedRootSig.size());
+      IFTBOOL(pRS->VerifyShaderPSV(dxilModule.GetShaderModel()->GetKind(),
+                                   pOutputStream->GetPtr(), pWriter->size(),
+                                   DiagStream), DXC_E_INCORRECT_ROOT_SIGNATURE);
     } catch (...) {
       return DXC_E_INCORRECT_ROOT_SIGNATURE;
     }
@@ -5649,7 +5845,8 @@ _Use_decl_annotations_ HRESULT ValidateLoadModuleFromContainerLazy(
 _Use_decl_annotations_
 HRESULT ValidateDxilContainer(const void *pContainer,
                               uint32_t ContainerSize,
-                              llvm::raw_ostream &DiagStream) {
+                              llvm::raw_ostream &DiagStream,
+                              const ValidationOptions &Options) {
   LLVMContext Ctx, DbgCtx;
   std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -5664,14 +5861,14 @@ HRESULT ValidateDxilContainer(const void *pContainer,
       Ctx, DbgCtx, DiagStream));
 
   // Validate DXIL Module
-  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get()));
+  IFR(ValidateDxilModule(pModule.get(), pDebugModule.get(), Options));
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
     return DXC_E_IR_VERIFICATION_FAILED;
   }
 
   return ValidateDxilContainerParts(pModule.get(), pDebugModule.get(),
-    IsDxilContainerLike(pContainer, ContainerSize), ContainerSize);
+    IsDxilContainerLike(pContainer, ContainerSize), ContainerSize, Options);
 }
 
 } // namespace hlsl
@@ -0,0 +1,209 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxilWaveAggregateAtomics.cpp                                              //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Combine the atomic adds that the lanes of a wave make to one UAV address  //
+// into a single atomic.                                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilFunctionProps.h"
+#include "dxc/DXIL/DxilOperations.h"
+#include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Analysis/PostDominators.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+
+#include <memory>
+
+using namespace llvm;
+using namespace hlsl;
+
+// Histograms and counters often have every lane of a wave add to the same
+// UAV address, and the atomics are then served one after the other. When
+// the handle and the address of an InterlockedAdd are the same on all active
+// lanes, the first lane adds WaveActiveSum of the values, and each lane gets
+// the value the first lane read plus WavePrefixSum of the values: the result
+// of the lanes adding in order. Without uses of the result, only the sum and
+// the single atomic remain.
+//
+// Wave operations need shader model 6.0. Pixel shaders are skipped, since
+// helper lanes don't write UAVs but may take part in wave operations.
+
+namespace {
+
+class DxilWaveAggregateAtomics : public FunctionPass {
+  bool m_Report;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilWaveAggregateAtomics(bool Report = false)
+      : FunctionPass(ID), m_Report(Report) {}
+
+  const char *getPassName() const override {
+    return "DXIL wave aggregate atomics";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<PostDominatorTree>();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "Report", &m_Report, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",Report=" << m_Report;
+  }
+
+  bool runOnFunction(Function &F) override;
+
+private:
+  static bool IsCandidate(DxilModule &DM, Function &F);
+  void Aggregate(CallInst *CI, hlsl::OP *hlslOP);
+};
+
+// Returns true for shaders, other than pixel shaders, that may use wave
+// operations.
+bool DxilWaveAggregateAtomics::IsCandidate(DxilModule &DM, Function &F) {
+  const ShaderModel *SM = DM.GetShaderModel();
+  if (!SM->IsSM60Plus())
+    return false;
+  if (SM->IsLib())
+    return DM.HasDxilFunctionProps(&F) && !DM.GetDxilFunctionProps(&F).IsPS();
+  return &F == DM.GetEntryFunction() && !SM->IsPS();
+}
+
+void DxilWaveAggregateAtomics::Aggregate(CallInst *CI, hlsl::OP *hlslOP) {
+  DxilInst_AtomicBinOp Atomic(CI);
+  Type *Ty = CI->getType();
+  Value *V = Atomic.get_newValue();
+  Constant *SumOp = hlslOP->GetI8Const((char)DXIL::WaveOpKind::Sum);
+  Constant *Unsigned = hlslOP->GetI8Const((char)DXIL::SignedOpKind::Unsigned);
+
+  IRBuilder<> Builder(CI);
+  Function *ActiveOp = hlslOP->GetOpFunc(DXIL::OpCode::WaveActiveOp, Ty);
+  Value *Sum = Builder.CreateCall(
+      ActiveOp, {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveActiveOp), V,
+                 SumOp, Unsigned});
+  Value *Prefix = nullptr;
+  if (!CI->use_empty()) {
+    Function *PrefixOp = hlslOP->GetOpFunc(DXIL::OpCode::WavePrefixOp, Ty);
+    Prefix = Builder.CreateCall(
+        PrefixOp, {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WavePrefixOp),
+                   V, SumOp, Unsigned});
+  }
+  Function *IsFirstLane =
+      hlslOP->GetOpFunc(DXIL::OpCode::WaveIsFirstLane,
+                        Type::getVoidTy(CI->getContext()));
+  Value *First = Builder.CreateCall(
+      IsFirstLane,
+      {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveIsFirstLane)});
+
+  BasicBlock *Head = CI->getParent();
+  TerminatorInst *Then =
+      SplitBlockAndInsertIfThen(First, CI, /*Unreachable*/ false);
+  CI->moveBefore(Then);
+  Atomic.set_newValue(Sum);
+  if (!Prefix)
+    return;
+
+  // The first lane shares what it read, and each lane adds what the lanes
+  // before it added.
+  BasicBlock *Tail = Then->getSuccessor(0);
+  Builder.SetInsertPoint(Tail->getFirstInsertionPt());
+  PHINode *Read = Builder.CreatePHI(Ty, 2);
+  Read->addIncoming(UndefValue::get(Ty), Head);
+  Function *ReadLaneFirst =
+      hlslOP->GetOpFunc(DXIL::OpCode::WaveReadLaneFirst, Ty);
+  Value *Base = Builder.CreateCall(
+      ReadLaneFirst,
+      {hlslOP->GetU32Const((unsigned)DXIL::OpCode::WaveReadLaneFirst), Read});
+  Value *Result = Builder.CreateAdd(Base, Prefix);
+  CI->replaceAllUsesWith(Result);
+  Read->addIncoming(CI, Then->getParent());
+}
+
+bool DxilWaveAggregateAtomics::runOnFunction(Function &F) {
+  Module &M = *F.getParent();
+  if (!M.HasDxilModule())
+    return false;
+  DxilModule &DM = M.GetDxilModule();
+  if (!IsCandidate(DM, F))
+    return false;
+
+  SmallVector<CallInst *, 4> Adds;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      DxilInst_AtomicBinOp Atomic(&I);
+      if (!Atomic)
+        continue;
+      ConstantInt *Op = dyn_cast<ConstantInt>(Atomic.get_atomicOp());
+      if (Op && Op->getZExtValue() == (unsigned)DXIL::AtomicBinOpCode::Add)
+        Adds.push_back(cast<CallInst>(&I));
+    }
+  }
+  if (Adds.empty())
+    return false;
+
+  PostDominatorTree &PDT = getAnalysis<PostDominatorTree>();
+  std::unique_ptr<WaveUniformityAnalysis> Uniformity(
+      WaveUniformityAnalysis::create(PDT));
+  Uniformity->Analyze(&F);
+
+  SmallVector<CallInst *, 4> Uniform;
+  for (CallInst *CI : Adds) {
+    DxilInst_AtomicBinOp Atomic(CI);
+    if (Uniformity->IsUniform(Atomic.get_handle()) &&
+        Uniformity->IsUniform(Atomic.get_offset0()) &&
+        Uniformity->IsUniform(Atomic.get_offset1()) &&
+        Uniformity->IsUniform(Atomic.get_offset2()))
+      Uniform.push_back(CI);
+  }
+  if (Uniform.empty())
+    return false;
+
+  hlsl::OP *hlslOP = DM.GetOP();
+  for (CallInst *CI : Uniform) {
+    if (m_Report) {
+      const char *Msg = "atomic add to an address that is the same on every "
+                        "lane combined into one atomic per wave";
+      LLVMContext &Ctx = CI->getContext();
+      if (DebugLoc DL = CI->getDebugLoc())
+        Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, Msg));
+      else
+        Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+    }
+    Aggregate(CI, hlslOP);
+  }
+  DM.InvalidateShaderFlags(&F);
+  return true;
+}
+
+}
+
+char DxilWaveAggregateAtomics::ID = 0;
+
+FunctionPass *llvm::createDxilWaveAggregateAtomicsPass(bool Report) {
+  return new DxilWaveAggregateAtomics(Report);
+}
+
+INITIALIZE_PASS_BEGIN(DxilWaveAggregateAtomics, "dxil-wave-aggregate-atomics",
+                      "DXIL wave aggregate atomics", false, false)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_END(DxilWaveAggregateAtomics, "dxil-wave-aggregate-atomics",
+                    "DXIL wave aggregate atomics", false, false)
@@ -0,0 +1,172 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// HLBindConstants.cpp                                                       //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Binds the static consts that the front end left unfolded to their         //
+// values for one permutation.                                               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Pass.h"
+
+#include "dxc/HLSL/DxilGenerationPass.h"
+#include "dxc/HLSL/HLModule.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using namespace llvm;
+using namespace hlsl;
+
+// With -late-bind-const, the front end keeps each named global static const
+// a constant global that is read with loads, and lists it in the module
+// under its source name. A high-level module compiled with -fcgl is then
+// shared by every permutation that only differs in those values: each one
+// runs the rest of the pipeline on it, which starts with this pass, and
+// passes the values as
+//   -hl-bind-constants,constants=<name>:<value>;<name>:<value>...
+// Integers and bools take decimal or 0x values, or true and false; floats
+// take decimal values.
+//
+// The pass sets the initializer of each bound const, then replaces the loads
+// of every listed const with its initializer, so the module looks as if the
+// front end had folded the value. Consts without a value keep the one in
+// the source. Array sizes and other places where the language requires a
+// constant keep the source value as well, since they are fixed before code
+// generation.
+
+namespace {
+
+class HLBindConstants : public ModulePass {
+  std::string m_Constants;
+  std::vector<std::pair<std::string, std::string>> m_Values;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit HLBindConstants() : ModulePass(ID) {}
+
+  const char *getPassName() const override {
+    return "HLSL High-Level bind constants";
+  }
+
+  void applyOptions(PassOptions O) override;
+  void dumpConfig(raw_ostream &OS) override;
+  bool runOnModule(Module &M) override;
+
+private:
+  static Constant *ParseValue(Type *Ty, StringRef Text);
+};
+
+void HLBindConstants::applyOptions(PassOptions O) {
+  StringRef Constants;
+  if (!GetPassOption(O, "constants", &Constants))
+    return;
+  m_Constants = Constants;
+  m_Values.clear();
+  SmallVector<StringRef, 8> Items;
+  StringRef(m_Constants).split(Items, ";", -1, false);
+  for (StringRef Item : Items) {
+    std::pair<StringRef, StringRef> NameValue = Item.split(':');
+    m_Values.emplace_back(NameValue.first.trim(), NameValue.second.trim());
+  }
+}
+
+void HLBindConstants::dumpConfig(raw_ostream &OS) {
+  ModulePass::dumpConfig(OS);
+  if (!m_Constants.empty())
+    OS << ",constants=" << m_Constants;
+}
+
+// Returns the constant of type Ty that Text spells, or null.
+Constant *HLBindConstants::ParseValue(Type *Ty, StringRef Text) {
+  if (IntegerType *ITy = dyn_cast<IntegerType>(Ty)) {
+    if (Text.equals_lower("true"))
+      return ConstantInt::get(ITy, 1);
+    if (Text.equals_lower("false"))
+      return ConstantInt::get(ITy, 0);
+    long long Value;
+    if (Text.getAsInteger(0, Value))
+      return nullptr;
+    return ConstantInt::get(ITy, Value, /*isSigned*/ true);
+  }
+  if (Ty->isFloatingPointTy() && !Text.empty()) {
+    std::string Str = Text;
+    char *End = nullptr;
+    double Value = std::strtod(Str.c_str(), &End);
+    if (*End != '\0')
+      return nullptr;
+    APFloat F(Value);
+    bool losesInfo;
+    F.convert(Ty->getFltSemantics(), APFloat::rmNearestTiesToEven, &losesInfo);
+    return ConstantFP::get(Ty->getContext(), F);
+  }
+  return nullptr;
+}
+
+bool HLBindConstants::runOnModule(Module &M) {
+  std::vector<std::pair<StringRef, GlobalVariable *>> Consts;
+  HLModule::GetLateBindConsts(M, Consts);
+  bool bChanged = HLModule::ClearLateBindConsts(M);
+
+  for (const auto &NameValue : m_Values) {
+    auto It = std::find_if(Consts.begin(), Consts.end(),
+                           [&](const std::pair<StringRef, GlobalVariable *> &C) {
+                             return C.first == NameValue.first;
+                           });
+    // A const the shader doesn't read has nothing to bind.
+    if (It == Consts.end())
+      continue;
+    GlobalVariable *GV = It->second;
+    if (!GV->isConstant())
+      continue;
+    Type *Ty = GV->getType()->getElementType();
+    Constant *Value = ParseValue(Ty, NameValue.second);
+    if (!Value) {
+      M.getContext().emitError(Twine("invalid value '") + NameValue.second +
+                               "' bound to static const " + NameValue.first);
+      continue;
+    }
+    GV->setInitializer(Value);
+  }
+
+  for (const auto &C : Consts) {
+    GlobalVariable *GV = C.second;
+    // One initialized from another bound const is computed at entry.
+    if (!GV->isConstant() || !GV->hasInitializer())
+      continue;
+    Constant *Init = GV->getInitializer();
+    for (auto U = GV->user_begin(); U != GV->user_end();) {
+      LoadInst *LI = dyn_cast<LoadInst>(*(U++));
+      if (!LI)
+        continue;
+      LI->replaceAllUsesWith(Init);
+      LI->eraseFromParent();
+    }
+    if (GV->use_empty())
+      GV->eraseFromParent();
+    bChanged = true;
+  }
+  return bChanged;
+}
+
+}
+
+char HLBindConstants::ID = 0;
+
+ModulePass *llvm::createHLBindConstantsPass() {
+  return new HLBindConstants();
+}
+
+INITIALIZE_PASS(HLBindConstants, "hl-bind-constants",
+                "HLSL High-Level bind constants", false, false)
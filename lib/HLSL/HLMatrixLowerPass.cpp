@@ -24,6 +24,7 @@
 #include "llvm/IR/Module.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/raw_ostream.h"
@@ -256,6 +257,10 @@ public:
 
   const char *getPassName() const override { return "HL matrix lower"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     m_pModule = &M;
     m_pHLModule = &m_pModule->GetOrCreateHLModule();
@@ -280,6 +285,7 @@ public:
     for (GlobalVariable *GV : staticGVs)
       runOnGlobal(GV);
 
+    m_HLFunctions.clear();
     return true;
   }
 
@@ -304,6 +310,13 @@ private:
       AddToDeadInsts(I);
     }
   }
+  // Every matrix call is rewritten to call a vector HL function, and creating
+  // one looks it up by a name built from the printed function type. Cache the
+  // lookups so each signature is only mangled once per module.
+  typedef std::pair<FunctionType *, std::pair<unsigned, unsigned>> HLFunctionKey;
+  DenseMap<HLFunctionKey, Function *> m_HLFunctions;
+  Function *GetOrCreateLoweredHLFunction(FunctionType *funcTy,
+                                         HLOpcodeGroup group, unsigned opcode);
   void runOnFunction(Function &F);
   void runOnGlobal(GlobalVariable *GV);
   void runOnGlobalMatrixArray(GlobalVariable *GV);
@@ -395,6 +408,16 @@ ModulePass *llvm::createHLMatrixLowerPass() { return new HLMatrixLowerPass(); }
 
 INITIALIZE_PASS(HLMatrixLowerPass, "hlmatrixlower", "HLSL High-Level Matrix Lower", false, false)
 
+Function *HLMatrixLowerPass::GetOrCreateLoweredHLFunction(FunctionType *funcTy,
+                                                          HLOpcodeGroup group,
+                                                          unsigned opcode) {
+  HLFunctionKey key(funcTy, std::make_pair(static_cast<unsigned>(group), opcode));
+  Function *&F = m_HLFunctions[key];
+  if (!F)
+    F = GetOrCreateHLFunction(*m_pModule, funcTy, group, opcode);
+  return F;
+}
+
 static Instruction *CreateTypeCast(HLCastOpcode castOp, Type *toTy, Value *src,
                                    IRBuilder<> Builder) {
   Type *srcTy = src->getType();
@@ -481,8 +504,8 @@ Instruction *HLMatrixLowerPass::MatCastToVec(CallInst *CI) {
       HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
       unsigned opcode = GetHLOpcode(CI);
 
-      Function *vecF = GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(FT),
-                                             group, opcode);
+      Function *vecF = GetOrCreateLoweredHLFunction(cast<FunctionType>(FT),
+                                                    group, opcode);
 
       SmallVector<Value *, 4> argList;
       for (Value *arg : CI->arg_operands()) {
@@ -580,7 +603,7 @@ Instruction *HLMatrixLowerPass::MatSubscriptToVec(CallInst *CI) {
 
     FunctionType *funcTy = FunctionType::get(CI->getType(), paramTyList, false);
     unsigned opcode = GetHLOpcode(CI);
-    Function *opFunc = GetOrCreateHLFunction(*m_pModule, funcTy, HLOpcodeGroup::HLSubscript, opcode);
+    Function *opFunc = GetOrCreateLoweredHLFunction(funcTy, HLOpcodeGroup::HLSubscript, opcode);
     return Builder.CreateCall(opFunc, args);
   } else
     return MatIntrinsicToVec(CI);
@@ -606,8 +629,8 @@ Instruction *HLMatrixLowerPass::MatFrExpToVec(CallInst *CI) {
 
   HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
   Function *vecF =
-      GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(VecFT), group,
-                            static_cast<unsigned>(IntrinsicOp::IOP_frexp));
+      GetOrCreateLoweredHLFunction(cast<FunctionType>(VecFT), group,
+                                   static_cast<unsigned>(IntrinsicOp::IOP_frexp));
 
   SmallVector<Value *, 4> argList;
   auto paramTyIt = params.begin();
@@ -635,7 +658,7 @@ Instruction *HLMatrixLowerPass::MatIntrinsicToVec(CallInst *CI) {
 
   HLOpcodeGroup group = GetHLOpcodeGroupByName(CI->getCalledFunction());
 
-  Function *vecF = GetOrCreateHLFunction(*m_pModule, cast<FunctionType>(FT), group, opcode);
+  Function *vecF = GetOrCreateLoweredHLFunction(cast<FunctionType>(FT), group, opcode);
 
   SmallVector<Value *, 4> argList;
   for (Value *arg : CI->arg_operands()) {
@@ -1040,6 +1063,68 @@ static Function *GetOrCreateMadIntrinsic(Type *Ty, Type *opcodeTy, IntrinsicOp m
   return MAD;
 }
 
+// mul sums products along the columns of a matrix it multiplies from the
+// left and along the rows of one from the right. When a cbuffer or another
+// resource stores the matrix in the orientation that keeps those elements in
+// one register, each result is the dot of that register with the other
+// operand, which DXIL has as a single operation. Otherwise each product of
+// the sum reads a different register, and the mad chain, which can start on
+// the first register loaded, is kept.
+static bool IsLoadedFromResource(Value *Mat, bool bRowMajor) {
+  CallInst *CI = dyn_cast<CallInst>(Mat);
+  if (!CI || GetHLOpcodeGroupByName(CI->getCalledFunction()) !=
+                 HLOpcodeGroup::HLMatLoadStore)
+    return false;
+  HLMatLoadStoreOpcode opcode =
+      static_cast<HLMatLoadStoreOpcode>(GetHLOpcode(CI));
+  if (opcode != (bRowMajor ? HLMatLoadStoreOpcode::RowMatLoad
+                           : HLMatLoadStoreOpcode::ColMatLoad))
+    return false;
+  Value *Ptr = CI->getArgOperand(HLOperandIndex::kMatLoadPtrOpIdx);
+  while (GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr))
+    Ptr = GEP->getPointerOperand();
+  // Resource subscripts, including cbuffers, and shader parameters in
+  // $Globals; static matrices are left to constant folding.
+  if (isa<CallInst>(Ptr))
+    return true;
+  GlobalVariable *GV = dyn_cast<GlobalVariable>(Ptr);
+  return GV && !GV->hasLocalLinkage();
+}
+
+static bool UseDotForMul(CallInst *mulInst, Type *EltTy, unsigned length) {
+  return (EltTy->isFloatTy() || EltTy->isHalfTy()) && length > 1 &&
+         !HLModule::HasPreciseAttributeWithMetadata(mulInst);
+}
+
+// Creates the dot of the elements of lhs and rhs at the given indices.
+static Value *CreateEltDot(Value *lhs, ArrayRef<uint32_t> lhsIdx, Value *rhs,
+                           ArrayRef<uint32_t> rhsIdx, Module &M,
+                           IRBuilder<> &Builder) {
+  auto Gather = [&](Value *V, ArrayRef<uint32_t> Idx) -> Value * {
+    if (V->getType()->getVectorNumElements() == Idx.size()) {
+      bool bIdentity = true;
+      for (unsigned i = 0; i < Idx.size(); i++)
+        bIdentity &= Idx[i] == i;
+      if (bIdentity)
+        return V;
+    }
+    return Builder.CreateShuffleVector(
+        V, UndefValue::get(V->getType()),
+        ConstantDataVector::get(V->getContext(), Idx));
+  };
+  Value *lhsVec = Gather(lhs, lhsIdx);
+  Value *rhsVec = Gather(rhs, rhsIdx);
+  Type *VecTy = lhsVec->getType();
+  Type *opcodeTy = Builder.getInt32Ty();
+  llvm::FunctionType *DotFuncTy = llvm::FunctionType::get(
+      VecTy->getVectorElementType(), {opcodeTy, VecTy, VecTy}, false);
+  Function *Dot =
+      GetOrCreateHLFunction(M, DotFuncTy, HLOpcodeGroup::HLIntrinsic,
+                            (unsigned)IntrinsicOp::IOP_dot);
+  return Builder.CreateCall(
+      Dot, {Builder.getInt32((unsigned)IntrinsicOp::IOP_dot), lhsVec, rhsVec});
+}
+
 void HLMatrixLowerPass::TranslateMatMatMul(Value *matVal,
                                            Value *vecVal,
                                            CallInst *mulInst, bool isSigned) {
@@ -1090,15 +1175,31 @@ void HLMatrixLowerPass::TranslateMatMatMul(Value *matVal,
     return Builder.CreateCall(Mad, {madOpArg, lMatElt, rMatElt, acc});
   };
 
+  // One of the operands is enough: its registers each give a whole sum.
+  bool bDot = UseDotForMul(mulInst, EltTy, col) &&
+              (IsLoadedFromResource(LVal, /*bRowMajor*/ true) ||
+               IsLoadedFromResource(RVal, /*bRowMajor*/ false));
+
   for (unsigned r = 0; r < row; r++) {
     for (unsigned c = 0; c < rCol; c++) {
+      unsigned matIdx = HLMatrixLower::GetRowMajorIdx(r, c, rCol);
+      if (bDot) {
+        SmallVector<uint32_t, 4> lIdx, rIdx;
+        for (unsigned lc = 0; lc < col; lc++) {
+          lIdx.emplace_back(HLMatrixLower::GetRowMajorIdx(r, lc, col));
+          rIdx.emplace_back(HLMatrixLower::GetRowMajorIdx(lc, c, rCol));
+        }
+        Value *dot = CreateEltDot(lMat, lIdx, rMat, rIdx,
+                                  *m_pHLModule->GetModule(), Builder);
+        retVal = Builder.CreateInsertElement(retVal, dot, matIdx);
+        continue;
+      }
       unsigned lc = 0;
       Value *tmpVal = CreateOneEltMul(r, lc, c);
 
       for (lc = 1; lc < col; lc++) {
         tmpVal = CreateOneEltMad(r, lc, c, tmpVal);
       }
-      unsigned matIdx = HLMatrixLower::GetRowMajorIdx(r, c, rCol);
       retVal = Builder.CreateInsertElement(retVal, tmpVal, matIdx);
     }
   }
@@ -1141,7 +1242,21 @@ void HLMatrixLowerPass::TranslateMatVecMul(Value *matVal,
     return Builder.CreateCall(Mad, {madOpArg, vecElt, matElt, acc});
   };
 
+  bool bDot = UseDotForMul(mulInst, EltTy, col) &&
+              IsLoadedFromResource(matVal, /*bRowMajor*/ true);
+
   for (unsigned r = 0; r < row; r++) {
+    if (bDot) {
+      SmallVector<uint32_t, 4> vecIdx, matIdx;
+      for (unsigned c = 0; c < col; c++) {
+        vecIdx.emplace_back(c);
+        matIdx.emplace_back(HLMatrixLower::GetRowMajorIdx(r, c, col));
+      }
+      Value *dot = CreateEltDot(vec, vecIdx, mat, matIdx,
+                                *m_pHLModule->GetModule(), Builder);
+      retVal = Builder.CreateInsertElement(retVal, dot, r);
+      continue;
+    }
     unsigned c = 0;
     Value *vecElt = Builder.CreateExtractElement(vec, c);
     uint32_t matIdx = HLMatrixLower::GetRowMajorIdx(r, c, col);
@@ -1193,7 +1308,21 @@ void HLMatrixLowerPass::TranslateVecMatMul(Value *matVal,
     return Builder.CreateCall(Mad, {madOpArg, vecElt, matElt, acc});
   };
 
+  bool bDot = UseDotForMul(mulInst, EltTy, row) &&
+              IsLoadedFromResource(matVal, /*bRowMajor*/ false);
+
   for (unsigned c = 0; c < col; c++) {
+    if (bDot) {
+      SmallVector<uint32_t, 4> vecIdx, matIdx;
+      for (unsigned r = 0; r < row; r++) {
+        vecIdx.emplace_back(r);
+        matIdx.emplace_back(HLMatrixLower::GetRowMajorIdx(r, c, col));
+      }
+      Value *dot = CreateEltDot(vec, vecIdx, mat, matIdx,
+                                *m_pHLModule->GetModule(), Builder);
+      retVal = Builder.CreateInsertElement(retVal, dot, c);
+      continue;
+    }
     unsigned r = 0;
     Value *vecElt = Builder.CreateExtractElement(vec, r);
     uint32_t matIdx = HLMatrixLower::GetRowMajorIdx(r, c, col);
@@ -2185,7 +2314,7 @@ void HLMatrixLowerPass::replaceMatWithVec(Value *matVal,
             // Don't need flat return type for Append.
             FunctionType *flatFuncTy =
               FunctionType::get(useInst->getType(), flatParamTys, false);
-            Function *flatF = GetOrCreateHLFunction(*m_pModule, flatFuncTy, group, static_cast<unsigned int>(opcode));
+            Function *flatF = GetOrCreateLoweredHLFunction(flatFuncTy, group, static_cast<unsigned int>(opcode));
             
             // Append returns void, so the old call should have no users
             DXASSERT(useInst->getType()->isVoidTy(), "Unexpected MOP_Append intrinsic return type");
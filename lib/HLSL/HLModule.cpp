@@ -460,6 +460,7 @@ void HLModule::SetDefaultLinkage(const DXIL::DefaultLinkage linkage) {
 static const StringRef kHLDxilFunctionPropertiesMDName           = "dx.fnprops";
 static const StringRef kHLDxilOptionsMDName                      = "dx.options";
 static const StringRef kHLDxilResourceTypeAnnotationMDName       = "dx.resource.type.annotation";
+static const StringRef kHLDxilLateBindConstsMDName               = "dx.lateBindConsts";
 
 // DXIL metadata serialization/deserialization.
 void HLModule::EmitHLMetadata() {
@@ -1122,6 +1123,39 @@ MDNode *HLModule::GetDxilResourceAttrib(llvm::Function *F) {
   return F->getMetadata(DxilMDHelper::kHLDxilResourceAttributeMDName);
 }
 
+void HLModule::AddLateBindConst(llvm::Module &M, StringRef Name,
+                                GlobalVariable *GV) {
+  LLVMContext &Ctx = M.getContext();
+  NamedMDNode *Consts =
+      M.getOrInsertNamedMetadata(kHLDxilLateBindConstsMDName);
+  Metadata *MDs[] = {MDString::get(Ctx, Name), ValueAsMetadata::get(GV)};
+  Consts->addOperand(MDNode::get(Ctx, MDs));
+}
+
+void HLModule::GetLateBindConsts(
+    llvm::Module &M,
+    std::vector<std::pair<StringRef, GlobalVariable *>> &Consts) {
+  NamedMDNode *MD = M.getNamedMetadata(kHLDxilLateBindConstsMDName);
+  if (!MD)
+    return;
+  for (MDNode *Node : MD->operands()) {
+    // The global is gone if it was optimized away.
+    GlobalVariable *GV = mdconst::dyn_extract_or_null<GlobalVariable>(
+        Node->getOperand(1));
+    if (GV)
+      Consts.emplace_back(cast<MDString>(Node->getOperand(0))->getString(),
+                          GV);
+  }
+}
+
+bool HLModule::ClearLateBindConsts(llvm::Module &M) {
+  NamedMDNode *MD = M.getNamedMetadata(kHLDxilLateBindConstsMDName);
+  if (!MD)
+    return false;
+  M.eraseNamedMetadata(MD);
+  return true;
+}
+
 void HLModule::MarkDxilResourceAttrib(llvm::Argument *Arg, llvm::MDNode *MD) {
   unsigned i = Arg->getArgNo();
   Function *F = Arg->getParent();
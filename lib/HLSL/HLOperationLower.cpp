@@ -4925,10 +4925,16 @@ IntrinsicLower gLowerTable[static_cast<unsigned>(IntrinsicOp::Num_Intrinsics)] =
 };
 }
 
-static void TranslateBuiltinIntrinsic(CallInst *CI,
-                                      HLOperationLowerHelper &helper,  HLObjectOperationLowerHelper *pObjHelper, bool &Translated) {
+static const IntrinsicLower &GetIntrinsicLower(CallInst *CI) {
   unsigned opcode = hlsl::GetHLOpcode(CI);
   const IntrinsicLower &lower = gLowerTable[opcode];
+  DXASSERT((unsigned)lower.IntriOpcode == opcode,
+           "otherwise gLowerTable doesn't match IntrinsicOp order");
+  return lower;
+}
+
+static void TranslateBuiltinIntrinsic(CallInst *CI, const IntrinsicLower &lower,
+                                      HLOperationLowerHelper &helper,  HLObjectOperationLowerHelper *pObjHelper, bool &Translated) {
   Value *Result =
       lower.LowerFunc(CI, lower.IntriOpcode, lower.DxilOpcode, helper, pObjHelper, Translated);
   if (Result)
@@ -6910,6 +6916,9 @@ static Instruction *CreateTransposeShuffle(IRBuilder<> &Builder, Value *vecVal,
 void TranslateHLBuiltinOperation(Function *F, HLOperationLowerHelper &helper,
                                hlsl::HLOpcodeGroup group, HLObjectOperationLowerHelper *pObjHelper) {
   if (group == HLOpcodeGroup::HLIntrinsic) {
+    // An HL function is created per opcode, so the lowering entry is looked
+    // up once and every call to F is lowered with it.
+    const IntrinsicLower *lower = nullptr;
     // map to dxil operations
     for (auto U = F->user_begin(); U != F->user_end();) {
       Value *User = *(U++);
@@ -6917,11 +6926,15 @@ void TranslateHLBuiltinOperation(Function *F, HLOperationLowerHelper &helper,
         continue;
       // must be call inst
       CallInst *CI = cast<CallInst>(User);
+      if (!lower)
+        lower = &GetIntrinsicLower(CI);
+      DXASSERT(hlsl::GetHLOpcode(CI) == (unsigned)lower->IntriOpcode,
+               "otherwise calls to one HL function use different opcodes");
 
       // Keep the instruction to lower by other function.
       bool Translated = true;
 
-      TranslateBuiltinIntrinsic(CI, helper, pObjHelper, Translated);
+      TranslateBuiltinIntrinsic(CI, *lower, helper, pObjHelper, Translated);
 
       if (Translated) {
         // delete the call
@@ -7035,7 +7048,9 @@ static void TranslateHLExtension(Function *F,
   llvm::StringRef LowerStrategy = GetHLLowerStrategy(F);
   ExtensionLowering lower(LowerStrategy, helper, hlslOp);
 
-  // Replace all calls that were successfully translated.
+  // Replace all calls that were successfully translated. The one lowering
+  // creates the lowered function for each opcode once and reuses it for the
+  // calls that follow.
   for (CallInst *CI : CallsToReplace) {
       Value *Result = lower.Translate(CI);
       if (Result && Result != CI) {
@@ -73,6 +73,11 @@ llvm::Value *ExtensionLowering::Translate(llvm::CallInst *CI) {
   return Unknown(CI);
 }
 
+llvm::Function *&ExtensionLowering::GetLoweredFunctionEntry(Strategy typeStrategy, llvm::CallInst *CI) {
+  LoweredFunctionKey key(typeStrategy, GetHLOpcode(CI), CI->getCalledFunction());
+  return m_loweredFunctions[key];
+}
+
 llvm::Value *ExtensionLowering::Unknown(CallInst *CI) {
   assert(false && "unknown translation strategy");
   return nullptr;
@@ -101,14 +106,20 @@ public:
 class FunctionTranslator {
 public:
   template <typename TypeTranslator>
-  static Function *GetLoweredFunction(CallInst *CI, ExtensionLowering &lower) {
+  static Function *GetLoweredFunction(ExtensionLowering::Strategy strategy, CallInst *CI, ExtensionLowering &lower) {
     TypeTranslator typeTranslator;
-    return GetLoweredFunction(typeTranslator, CI, lower);
+    return GetLoweredFunction(strategy, typeTranslator, CI, lower);
   }
   
-  static Function *GetLoweredFunction(FunctionTypeTranslator &typeTranslator, CallInst *CI, ExtensionLowering &lower) {
-    FunctionTranslator translator(typeTranslator, lower);
-    return translator.GetLoweredFunction(CI);
+  // The strategy names the type translator, so the function is only created
+  // once for the calls with the same opcode to one HL function.
+  static Function *GetLoweredFunction(ExtensionLowering::Strategy strategy, FunctionTypeTranslator &typeTranslator, CallInst *CI, ExtensionLowering &lower) {
+    Function *&loweredFunction = lower.GetLoweredFunctionEntry(strategy, CI);
+    if (!loweredFunction) {
+      FunctionTranslator translator(typeTranslator, lower);
+      loweredFunction = translator.GetLoweredFunction(CI);
+    }
+    return loweredFunction;
   }
 
 private:
@@ -181,7 +192,7 @@ class NoTranslationTypeTranslator : public FunctionTypeTranslator {
 };
 
 llvm::Value *ExtensionLowering::NoTranslation(CallInst *CI) {
-  Function *NoTranslationFunction = FunctionTranslator::GetLoweredFunction<NoTranslationTypeTranslator>(CI, *this);
+  Function *NoTranslationFunction = FunctionTranslator::GetLoweredFunction<NoTranslationTypeTranslator>(Strategy::NoTranslation, CI, *this);
   if (!NoTranslationFunction)
     return nullptr;
 
@@ -339,7 +350,7 @@ private:
 //
 // You can then RAWU %r with %r.v.2. The RAWU is not done by the translate function.
 Value *ExtensionLowering::Replicate(CallInst *CI) {
-  Function *ReplicatedFunction = FunctionTranslator::GetLoweredFunction<ReplicatedFunctionTypeTranslator>(CI, *this);
+  Function *ReplicatedFunction = FunctionTranslator::GetLoweredFunction<ReplicatedFunctionTypeTranslator>(Strategy::Replicate, CI, *this);
   if (!ReplicatedFunction)
     return NoTranslation(CI);
 
@@ -448,7 +459,7 @@ class PackedFunctionTypeTranslator : public FunctionTypeTranslator {
 };
 
 Value *ExtensionLowering::Pack(CallInst *CI) {
-  Function *PackedFunction = FunctionTranslator::GetLoweredFunction<PackedFunctionTypeTranslator>(CI, *this);
+  Function *PackedFunction = FunctionTranslator::GetLoweredFunction<PackedFunctionTypeTranslator>(Strategy::Pack, CI, *this);
   if (!PackedFunction)
     return NoTranslation(CI);
 
@@ -603,7 +614,7 @@ private:
 
 Value *ExtensionLowering::Resource(CallInst *CI) {
   ResourceFunctionTypeTranslator resourceTypeTranslator(m_hlslOp);
-  Function *resourceFunction = FunctionTranslator::GetLoweredFunction(resourceTypeTranslator, CI, *this);
+  Function *resourceFunction = FunctionTranslator::GetLoweredFunction(Strategy::Resource, resourceTypeTranslator, CI, *this);
   if (!resourceFunction)
     return NoTranslation(CI);
 
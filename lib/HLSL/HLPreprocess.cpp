@@ -35,6 +35,10 @@ public:
     return "Preprocess HLModule after inline";
   }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
   bool runOnModule(Module &M) override {
     bool bUpdated = false;
     // Remove stacksave and stackstore.
@@ -540,9 +540,48 @@ Value *GenerateLdInput(Function *loadInput, ArrayRef<Value *> args,
   }
 }
 
-Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
-                            unsigned cols, MutableArrayRef<Value *> args,
-                            bool bCast) {
+// Gets the users of a vector input if they only extract constant columns, so
+// that just those columns need loading. Debug info on the vector needs it
+// whole.
+bool collectColumnExtracts(Value *V,
+                           SmallVectorImpl<ExtractElementInst *> &extracts) {
+  if (LocalAsMetadata::getIfExists(V))
+    return false;
+  for (User *U : V->users()) {
+    ExtractElementInst *EEI = dyn_cast<ExtractElementInst>(U);
+    if (!EEI || !isa<ConstantInt>(EEI->getIndexOperand()))
+      return false;
+    extracts.emplace_back(EEI);
+  }
+  return true;
+}
+
+// Replaces column extracts of a vector input with one load per column read.
+void replaceColumnExtractsWithLdInput(
+    ArrayRef<ExtractElementInst *> extracts, Function *loadInput,
+    unsigned cols, MutableArrayRef<Value *> args, IRBuilder<> &Builder,
+    Value *zero, bool bCast, Type *EltTy) {
+  SmallVector<Value *, 4> colInputs(cols, nullptr);
+  for (ExtractElementInst *EEI : extracts) {
+    uint64_t col =
+        cast<ConstantInt>(EEI->getIndexOperand())->getLimitedValue();
+    Value *input = UndefValue::get(EltTy);
+    if (col < cols) {
+      if (!colInputs[col]) {
+        args[DXIL::OperandIndex::kLoadInputColOpIdx] = Builder.getInt8(col);
+        colInputs[col] =
+            GenerateLdInput(loadInput, args, Builder, zero, bCast, EltTy);
+      }
+      input = colInputs[col];
+    }
+    EEI->replaceAllUsesWith(input);
+    EEI->eraseFromParent();
+  }
+}
+
+void replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
+                          unsigned cols, MutableArrayRef<Value *> args,
+                          bool bCast) {
   IRBuilder<> Builder(ldInst);
   IRBuilder<> AllocaBuilder(dxilutil::FindAllocaInsertionPt(ldInst));
   Type *Ty = ldInst->getType();
@@ -551,8 +590,15 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
   Value *zero = Builder.getInt32(0);
 
   if (VectorType *VT = dyn_cast<VectorType>(Ty)) {
-    Value *newVec = llvm::UndefValue::get(VT);
     DXASSERT(cols == VT->getNumElements(), "vec size must match");
+    SmallVector<ExtractElementInst *, 4> extracts;
+    if (collectColumnExtracts(ldInst, extracts)) {
+      replaceColumnExtractsWithLdInput(extracts, loadInput, cols, args, Builder,
+                                       zero, bCast, EltTy);
+      ldInst->eraseFromParent();
+      return;
+    }
+    Value *newVec = llvm::UndefValue::get(VT);
     for (unsigned col = 0; col < cols; col++) {
       Value *colIdx = Builder.getInt8(col);
       args[DXIL::OperandIndex::kLoadInputColOpIdx] = colIdx;
@@ -562,7 +608,6 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
     }
     ldInst->replaceAllUsesWith(newVec);
     ldInst->eraseFromParent();
-    return newVec;
   } else {
     Value *colIdx = args[DXIL::OperandIndex::kLoadInputColOpIdx];
     if (colIdx == nullptr) {
@@ -580,7 +625,6 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
           GenerateLdInput(loadInput, args, Builder, zero, bCast, EltTy);
       ldInst->replaceAllUsesWith(input);
       ldInst->eraseFromParent();
-      return input;
     } else {
       // Vector indexing.
       // Load to array.
@@ -601,7 +645,6 @@ Value *replaceLdWithLdInput(Function *loadInput, LoadInst *ldInst,
       Value *input = Builder.CreateLoad(vecIndexingPtr);
       ldInst->replaceAllUsesWith(input);
       ldInst->eraseFromParent();
-      return input;
     }
   }
 }
@@ -614,8 +657,14 @@ void replaceDirectInputParameter(Value *param, Function *loadInput,
   Type *EltTy = Ty->getScalarType();
 
   if (VectorType *VT = dyn_cast<VectorType>(Ty)) {
-    Value *newVec = llvm::UndefValue::get(VT);
     DXASSERT(cols == VT->getNumElements(), "vec size must match");
+    SmallVector<ExtractElementInst *, 4> extracts;
+    if (collectColumnExtracts(param, extracts)) {
+      replaceColumnExtractsWithLdInput(extracts, loadInput, cols, args, Builder,
+                                       zero, bCast, EltTy);
+      return;
+    }
+    Value *newVec = llvm::UndefValue::get(VT);
     for (unsigned col = 0; col < cols; col++) {
       Value *colIdx = hlslOP->GetU8Const(col);
       args[DXIL::OperandIndex::kLoadInputColOpIdx] = colIdx;
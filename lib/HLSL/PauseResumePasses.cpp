@@ -66,6 +66,10 @@ public:
 
   const char *getPassName() const override { return "NoPausePasses"; }
 
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+
   bool runOnModule(Module &M) override {
     return ClearPauseResumePasses(M);
   }
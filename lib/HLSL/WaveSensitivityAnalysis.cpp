@@ -6,7 +6,8 @@
 // License. See LICENSE.TXT for details.                                     //
 //                                                                           //
 // This file provides support for doing analysis that are aware of wave      //
-// intrinsics.                                                               //
+// intrinsics, and a pass that uses them to relax non-uniform resource       //
+// indices.                                                                  //
 //                                                                           //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -20,6 +21,7 @@
 #include "dxc/HLSL/HLOperations.h"
 #include "dxc/HLSL/HLModule.h"
 #include "dxc/DXIL/DxilInstructions.h"
+#include "dxc/DXIL/DxilUtil.h"
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/LLVMContext.h"
@@ -28,10 +30,12 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/DiagnosticInfo.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/ADT/BitVector.h"
 #include "llvm/Analysis/PostDominators.h"
+#include "llvm/Pass.h"
 
 #ifdef _WIN32
 #include <winerror.h>
@@ -215,4 +219,318 @@ bool WaveSensitivityAnalyzer::IsWaveSensitive(Instruction *op) {
   return (*c).second == KnownSensitive;
 }
 
+// WaveUniformityAnalysis starts from values that may differ between lanes,
+// like thread ids, inputs and memory loads, and marks everything depending on
+// them as divergent. Control flow is handled like WaveSensitivityAnalysis:
+// a divergent branch makes the blocks it reaches divergent until a block that
+// post-dominates it, and phis merging its paths divergent.
+// Every value left over holds the same value on all active lanes.
+
+class WaveUniformityAnalyzer : public WaveUniformityAnalysis {
+private:
+  PostDominatorTree *pPDT;
+  unordered_set<Value *> Divergent;
+  unordered_set<BasicBlock *> DivergentBlocks;
+  std::vector<Value *> WorkList;
+  void MarkDivergent(Value *V);
+  void MarkDivergentBlock(BasicBlock *BB);
+  bool IsSourceOfDivergence(Instruction *I);
+  bool IsUniformDespiteOperand(Instruction *I, Value *Op);
+public:
+  WaveUniformityAnalyzer(PostDominatorTree &PDT) : pPDT(&PDT) {}
+  void Analyze(Function *F);
+  bool IsUniform(Value *V);
+};
+
+WaveUniformityAnalysis* WaveUniformityAnalysis::create(PostDominatorTree &PDT) {
+  return new WaveUniformityAnalyzer(PDT);
+}
+
+void WaveUniformityAnalyzer::MarkDivergent(Value *V) {
+  if (Divergent.insert(V).second)
+    WorkList.push_back(V);
+}
+
+void WaveUniformityAnalyzer::MarkDivergentBlock(BasicBlock *BB) {
+  if (!DivergentBlocks.insert(BB).second)
+    return;
+  for (Instruction &I : *BB)
+    MarkDivergent(&I);
+}
+
+// Returns true for a handle to a resource no thread can write.
+static bool IsReadOnlyHandle(Value *Handle) {
+  CallInst *CI = dyn_cast<CallInst>(Handle);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI, OP::OpCode::CreateHandle))
+    return false;
+  DxilInst_CreateHandle createHandle(CI);
+  if (!isa<ConstantInt>(createHandle.get_resourceClass()))
+    return false;
+  DXIL::ResourceClass RC =
+      static_cast<DXIL::ResourceClass>(createHandle.get_resourceClass_val());
+  return RC == DXIL::ResourceClass::SRV || RC == DXIL::ResourceClass::CBuffer;
+}
+
+bool WaveUniformityAnalyzer::IsSourceOfDivergence(Instruction *I) {
+  if (LoadInst *LI = dyn_cast<LoadInst>(I)) {
+    // Only constant memory reads the same on every lane.
+    Value *Ptr = LI->getPointerOperand();
+    while (GEPOperator *GEP = dyn_cast<GEPOperator>(Ptr))
+      Ptr = GEP->getPointerOperand();
+    GlobalVariable *GV = dyn_cast<GlobalVariable>(Ptr);
+    return !GV || !(GV->isConstant() || dxilutil::IsHLSLObjectType(
+                                            GV->getType()->getElementType()));
+  }
+  if (isa<AtomicRMWInst>(I) || isa<AtomicCmpXchgInst>(I))
+    return true;
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI)
+    return false;
+  if (!OP::IsDxilOpFuncCallInst(CI))
+    return true;
+
+  OP::OpCode opcode = OP::GetDxilOpFuncCallInst(CI);
+  switch (OP::GetOpCodeClass(opcode)) {
+  // Pure functions of their operands.
+  case DXIL::OpCodeClass::Unary:
+  case DXIL::OpCodeClass::UnaryBits:
+  case DXIL::OpCodeClass::IsSpecialFloat:
+  case DXIL::OpCodeClass::Binary:
+  case DXIL::OpCodeClass::BinaryWithCarryOrBorrow:
+  case DXIL::OpCodeClass::BinaryWithTwoOuts:
+  case DXIL::OpCodeClass::Tertiary:
+  case DXIL::OpCodeClass::Quaternary:
+  case DXIL::OpCodeClass::Dot2:
+  case DXIL::OpCodeClass::Dot3:
+  case DXIL::OpCodeClass::Dot4:
+  case DXIL::OpCodeClass::Dot2AddHalf:
+  case DXIL::OpCodeClass::Dot4AddPacked:
+  case DXIL::OpCodeClass::MakeDouble:
+  case DXIL::OpCodeClass::SplitDouble:
+  case DXIL::OpCodeClass::LegacyF16ToF32:
+  case DXIL::OpCodeClass::LegacyF32ToF16:
+  case DXIL::OpCodeClass::LegacyDoubleToFloat:
+  case DXIL::OpCodeClass::LegacyDoubleToSInt32:
+  case DXIL::OpCodeClass::LegacyDoubleToUInt32:
+  case DXIL::OpCodeClass::BitcastF16toI16:
+  case DXIL::OpCodeClass::BitcastF32toI32:
+  case DXIL::OpCodeClass::BitcastF64toI64:
+  case DXIL::OpCodeClass::BitcastI16toF16:
+  case DXIL::OpCodeClass::BitcastI32toF32:
+  case DXIL::OpCodeClass::BitcastI64toF64:
+  // Resource queries that read memory no lane can write.
+  case DXIL::OpCodeClass::CreateHandle:
+  case DXIL::OpCodeClass::CreateHandleForLib:
+  case DXIL::OpCodeClass::CBufferLoad:
+  case DXIL::OpCodeClass::CBufferLoadLegacy:
+  case DXIL::OpCodeClass::GetDimensions:
+  case DXIL::OpCodeClass::RenderTargetGetSampleCount:
+  case DXIL::OpCodeClass::RenderTargetGetSamplePosition:
+  case DXIL::OpCodeClass::Texture2DMSGetSamplePosition:
+  // A wave never spans thread groups.
+  case DXIL::OpCodeClass::GroupId:
+  // Results shared by the whole wave.
+  case DXIL::OpCodeClass::WaveGetLaneCount:
+  case DXIL::OpCodeClass::WaveReadLaneFirst:
+  case DXIL::OpCodeClass::WaveReadLaneAt:
+  case DXIL::OpCodeClass::WaveActiveOp:
+  case DXIL::OpCodeClass::WaveActiveBit:
+  case DXIL::OpCodeClass::WaveActiveAllEqual:
+  case DXIL::OpCodeClass::WaveActiveBallot:
+  case DXIL::OpCodeClass::WaveAllOp:
+  case DXIL::OpCodeClass::WaveAllTrue:
+  case DXIL::OpCodeClass::WaveAnyTrue:
+    return false;
+  case DXIL::OpCodeClass::BufferLoad:
+  case DXIL::OpCodeClass::RawBufferLoad:
+  case DXIL::OpCodeClass::TextureLoad:
+    return !IsReadOnlyHandle(
+        CI->getArgOperand(DXIL::OperandIndex::kBufferLoadHandleOpIdx));
+  default:
+    return true;
+  }
+}
+
+bool WaveUniformityAnalyzer::IsUniformDespiteOperand(Instruction *I,
+                                                     Value *Op) {
+  CallInst *CI = dyn_cast<CallInst>(I);
+  if (!CI || !OP::IsDxilOpFuncCallInst(CI))
+    return false;
+  switch (OP::GetOpCodeClass(OP::GetDxilOpFuncCallInst(CI))) {
+  // Wave reductions give every active lane the same result.
+  case DXIL::OpCodeClass::WaveReadLaneFirst:
+  case DXIL::OpCodeClass::WaveActiveOp:
+  case DXIL::OpCodeClass::WaveActiveBit:
+  case DXIL::OpCodeClass::WaveActiveAllEqual:
+  case DXIL::OpCodeClass::WaveActiveBallot:
+  case DXIL::OpCodeClass::WaveAllOp:
+  case DXIL::OpCodeClass::WaveAllTrue:
+  case DXIL::OpCodeClass::WaveAnyTrue:
+    return true;
+  case DXIL::OpCodeClass::WaveReadLaneAt:
+    return Op != CI->getArgOperand(DXIL::OperandIndex::kBinarySrc1OpIdx);
+  default:
+    return false;
+  }
+}
+
+void WaveUniformityAnalyzer::Analyze(Function *F) {
+  for (Argument &Arg : F->args())
+    MarkDivergent(&Arg);
+  for (BasicBlock &BB : *F) {
+    for (Instruction &I : BB) {
+      if (IsSourceOfDivergence(&I))
+        MarkDivergent(&I);
+    }
+  }
+
+  while (!WorkList.empty()) {
+    Value *V = WorkList.back();
+    WorkList.pop_back();
+
+    if (TerminatorInst *TI = dyn_cast<TerminatorInst>(V)) {
+      BasicBlock *CurBB = TI->getParent();
+      for (unsigned i = 0; i < TI->getNumSuccessors(); ++i) {
+        BasicBlock *BB = TI->getSuccessor(i);
+        // Lanes may arrive at BB from different paths.
+        for (Instruction &I : *BB) {
+          if (!isa<PHINode>(&I))
+            break;
+          MarkDivergent(&I);
+        }
+        // Only blocks that do not post dominate CurBB run on part of the lanes.
+        if (!pPDT->properlyDominates(BB, CurBB))
+          MarkDivergentBlock(BB);
+      }
+    }
+
+    for (User *U : V->users()) {
+      Instruction *UI = cast<Instruction>(U);
+      if (!IsUniformDespiteOperand(UI, V))
+        MarkDivergent(UI);
+    }
+  }
+}
+
+bool WaveUniformityAnalyzer::IsUniform(Value *V) {
+  if (!isa<Instruction>(V) && !isa<Argument>(V))
+    return true;
+  return Divergent.count(V) == 0;
+}
+
 } // namespace hlsl
+
+using namespace hlsl;
+
+namespace {
+// Clear the non-uniform flag on createHandle when the resource index is the
+// same on all lanes, so the access can use a scalar index. The flag comes
+// from NonUniformResourceIndex and may be applied to indices that are known
+// uniform, like one read from a constant buffer.
+// With InferNonUniform, the flag is instead set exactly when the index may
+// differ between lanes, and a warning reports each index that changed.
+class DxilUniformResourceIndex : public FunctionPass {
+  bool m_InferNonUniform;
+
+public:
+  static char ID; // Pass identification, replacement for typeid
+  explicit DxilUniformResourceIndex(bool InferNonUniform = false)
+      : FunctionPass(ID), m_InferNonUniform(InferNonUniform) {}
+
+  const char *getPassName() const override {
+    return "DXIL clear non-uniform flag of uniform resource indices";
+  }
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<PostDominatorTree>();
+    AU.setPreservesCFG();
+  }
+
+  void applyOptions(PassOptions O) override {
+    GetPassOptionBool(O, "InferNonUniform", &m_InferNonUniform, false);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    FunctionPass::dumpConfig(OS);
+    OS << ",InferNonUniform=" << m_InferNonUniform;
+  }
+
+  bool runOnFunction(Function &F) override {
+    Module &M = *F.getParent();
+    if (!M.HasDxilModule())
+      return false;
+    hlsl::OP *hlslOP = M.GetDxilModule().GetOP();
+
+    std::vector<CallInst *> Candidates;
+    for (BasicBlock &BB : F) {
+      for (Instruction &I : BB) {
+        CallInst *CI = dyn_cast<CallInst>(&I);
+        if (!CI || !OP::IsDxilOpFuncCallInst(CI, OP::OpCode::CreateHandle))
+          continue;
+        DxilInst_CreateHandle createHandle(CI);
+        if (m_InferNonUniform) {
+          if (!isa<Constant>(createHandle.get_index()))
+            Candidates.emplace_back(CI);
+          continue;
+        }
+        ConstantInt *NonUniform =
+            dyn_cast<ConstantInt>(createHandle.get_nonUniformIndex());
+        if (NonUniform && NonUniform->isOne())
+          Candidates.emplace_back(CI);
+      }
+    }
+    if (Candidates.empty())
+      return false;
+
+    PostDominatorTree &PDT = getAnalysis<PostDominatorTree>();
+    std::unique_ptr<WaveUniformityAnalysis> Uniformity(
+        WaveUniformityAnalysis::create(PDT));
+    Uniformity->Analyze(&F);
+
+    bool bChanged = false;
+    for (CallInst *CI : Candidates) {
+      DxilInst_CreateHandle createHandle(CI);
+      bool bNonUniform = !Uniformity->IsUniform(createHandle.get_index());
+      ConstantInt *NonUniform =
+          dyn_cast<ConstantInt>(createHandle.get_nonUniformIndex());
+      if (NonUniform && NonUniform->isOne() == bNonUniform)
+        continue;
+      if (bNonUniform && !m_InferNonUniform)
+        continue;
+      CI->setArgOperand(DXIL::OperandIndex::kCreateHandleIsUniformOpIdx,
+                        hlslOP->GetI1Const(bNonUniform));
+      bChanged = true;
+      if (m_InferNonUniform)
+        ReportChangedIndex(CI, bNonUniform);
+    }
+    return bChanged;
+  }
+
+private:
+  static void ReportChangedIndex(CallInst *CI, bool bNonUniform) {
+    const char *Msg =
+        bNonUniform
+            ? "resource index may differ between lanes; marked as "
+              "NonUniformResourceIndex."
+            : "resource index is uniform; NonUniformResourceIndex removed.";
+    LLVMContext &Ctx = CI->getContext();
+    if (DebugLoc DL = CI->getDebugLoc())
+      Ctx.emitWarning(dxilutil::FormatMessageAtLocation(DL, Msg));
+    else
+      Ctx.emitWarning(dxilutil::FormatMessageWithoutLocation(Msg));
+  }
+};
+
+char DxilUniformResourceIndex::ID = 0;
+}
+
+FunctionPass *llvm::createDxilUniformResourceIndexPass(bool InferNonUniform) {
+  return new DxilUniformResourceIndex(InferNonUniform);
+}
+
+INITIALIZE_PASS_BEGIN(DxilUniformResourceIndex, "dxil-uniform-resource-index",
+                      "DXIL clear non-uniform flag of uniform resource indices",
+                      false, false)
+INITIALIZE_PASS_DEPENDENCY(PostDominatorTree)
+INITIALIZE_PASS_END(DxilUniformResourceIndex, "dxil-uniform-resource-index",
+                    "DXIL clear non-uniform flag of uniform resource indices",
+                    false, false)
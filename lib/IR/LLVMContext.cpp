@@ -266,3 +266,17 @@ void LLVMContext::getMDKindNames(SmallVectorImpl<StringRef> &Names) const {
        E = pImpl->CustomMDKindNames.end(); I != E; ++I)
     Names[I->second] = I->first();
 }
+
+// HLSL Change Start
+void LLVMContext::resetStructTypeNames(StringRef KeepPrefix) {
+  SmallVector<StructType *, 64> Named;
+  for (const auto &Entry : pImpl->NamedStructTypes)
+    if (!Entry.getKey().startswith(KeepPrefix))
+      Named.push_back(Entry.getValue());
+  // Unnaming removes the entry from the table, so it can't be done while
+  // walking it.
+  for (StructType *ST : Named)
+    ST->setName("");
+  pImpl->NamedStructTypesUniqueID = 0;
+}
+// HLSL Change End
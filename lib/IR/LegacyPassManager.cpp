@@ -22,6 +22,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include "llvm/Support/TimeValue.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -1317,6 +1318,8 @@ bool BBPassManager::runOnFunction(Function &F) {
         // If the pass crashes, remember this.
         PassManagerPrettyStackEntry X(BP, *I);
         TimeRegion PassTimer(getPassTimer(BP));
+        PassSizeTracker PassSize(getPassTimingName(BP), F); // HLSL Change
+        PhaseTimingRegion PassPhase(getPassTimingName(BP), /*IsPass*/ true); // HLSL Change
 
         LocalChanged |= BP->runOnBasicBlock(*I);
       }
@@ -1402,6 +1405,8 @@ FunctionPassManager::~FunctionPassManager() {
 void FunctionPassManager::add(Pass *P) {
   // HLSL Change Starts
   std::unique_ptr<Pass> PPtr(P); // take ownership of P, even on failure paths
+  if (!PassOptionOverrides.empty())
+    ApplyPassOptionOverrides(P, PassOptionOverrides);
   if (TrackPassOS) {
     P->dumpConfig(*TrackPassOS);
     (*TrackPassOS) << '\n';
@@ -1544,6 +1549,8 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      PassSizeTracker PassSize(getPassTimingName(FP), F); // HLSL Change
+      PhaseTimingRegion PassPhase(getPassTimingName(FP), /*IsPass*/ true); // HLSL Change
 
       LocalChanged |= FP->runOnFunction(F);
     }
@@ -1620,6 +1627,8 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      PassSizeTracker PassSize(getPassTimingName(MP), M); // HLSL Change
+      PhaseTimingRegion PassPhase(getPassTimingName(MP), /*IsPass*/ true); // HLSL Change
 
       LocalChanged |= MP->runOnModule(M);
     }
@@ -1750,6 +1759,8 @@ PassManager::~PassManager() {
 void PassManager::add(Pass *P) {
   // HLSL Change Starts
   std::unique_ptr<Pass> PPtr(P); // take ownership of P, even on failure paths
+  if (!PassOptionOverrides.empty())
+    ApplyPassOptionOverrides(P, PassOptionOverrides);
   if (TrackPassOS) {
     P->dumpConfig(*TrackPassOS);
     (*TrackPassOS) << '\n';
@@ -1795,6 +1806,53 @@ Timer *llvm::getPassTimer(Pass *P) {
   return nullptr;
 }
 
+// HLSL Change Begin - per-thread pass timing.
+StringRef llvm::getPassTimingName(Pass *P) {
+  if (P->getAsPMDataManager())
+    return StringRef();
+  return P->getPassName();
+}
+
+PassSizeTracker::PassSizeTracker(StringRef Name, const Function &F)
+    : Listener(nullptr), Name(Name), F(&F), M(nullptr), Before(0) {
+  PhaseTimingListener *L = getPhaseTimingListener();
+  if (L && !Name.empty() && L->wantsPassSizes()) {
+    Listener = L;
+    Before = countInstructions();
+    Listener->passStarted(Name);
+  }
+}
+
+PassSizeTracker::PassSizeTracker(StringRef Name, const Module &M)
+    : Listener(nullptr), Name(Name), F(nullptr), M(&M), Before(0) {
+  PhaseTimingListener *L = getPhaseTimingListener();
+  if (L && !Name.empty() && L->wantsPassSizes()) {
+    Listener = L;
+    Before = countInstructions();
+    Listener->passStarted(Name);
+  }
+}
+
+PassSizeTracker::~PassSizeTracker() {
+  if (Listener)
+    Listener->passSizeChanged(Name, (int64_t)countInstructions() - (int64_t)Before);
+}
+
+uint64_t PassSizeTracker::countInstructions() const {
+  uint64_t Count = 0;
+  auto countFunction = [&Count](const Function &Fn) {
+    for (const BasicBlock &BB : Fn)
+      Count += BB.size();
+  };
+  if (F)
+    countFunction(*F);
+  else
+    for (const Function &Fn : *M)
+      countFunction(Fn);
+  return Count;
+}
+// HLSL Change End
+
 //===----------------------------------------------------------------------===//
 // PMStack implementation
 //
@@ -21,6 +21,8 @@
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm> // HLSL Change
+#include <tuple> // HLSL Change
+#include <vector> // HLSL Change
 using namespace llvm;
 
 #define DEBUG_TYPE "ir"
@@ -374,4 +376,46 @@ bool llvm::GetPassOptionFloat(PassOptions &O, llvm::StringRef name, float *pValu
   return false;
 }
 
+// Upserts the Option=Value pairs of a comma-separated list into the sorted
+// Options.
+static void AddPassOptions(StringRef List, std::vector<PassOption> &Options) {
+  while (!List.empty()) {
+    StringRef Item;
+    std::tie(Item, List) = List.split(',');
+    PassOption NameValue = Item.split('=');
+    if (NameValue.first.empty())
+      continue;
+    auto Pos = std::lower_bound(Options.begin(), Options.end(), NameValue,
+                                PassOptionsCompare());
+    if (Pos != Options.end() && Pos->first == NameValue.first)
+      Pos->second = NameValue.second;
+    else
+      Options.insert(Pos, NameValue);
+  }
+}
+
+void llvm::ApplyPassOptionOverrides(Pass *P, ArrayRef<std::string> Overrides) {
+  StringRef PassArg = P->getPassArgument();
+  std::string Config;
+  std::vector<PassOption> Options;
+  bool bOverridden = false;
+  for (const std::string &Override : Overrides) {
+    StringRef Name, List;
+    std::tie(Name, List) = StringRef(Override).split(',');
+    if (Name != PassArg)
+      continue;
+    if (!bOverridden) {
+      // dumpConfig reports "-pass-name,Option=Value...".
+      raw_string_ostream OS(Config);
+      P->dumpConfig(OS);
+      OS.flush();
+      AddPassOptions(StringRef(Config).split(',').second, Options);
+      bOverridden = true;
+    }
+    AddPassOptions(List, Options);
+  }
+  if (bOverridden)
+    P->applyOptions(Options);
+}
+
 // HLSL Changes End
@@ -21,6 +21,34 @@ using namespace llvm;
 
 static const ManagedStaticBase *StaticList = nullptr;
 
+// HLSL Change Starts - Let the host pick the allocator for Creator.
+static ManagedStaticEnterFn EnterAllocHook = nullptr;
+static ManagedStaticLeaveFn LeaveAllocHook = nullptr;
+
+void llvm::llvm_set_managed_static_alloc_hooks(ManagedStaticEnterFn Enter,
+                                               ManagedStaticLeaveFn Leave) {
+  assert((Enter == nullptr) == (Leave == nullptr) &&
+         "Alloc hooks must be set together");
+  EnterAllocHook = Enter;
+  LeaveAllocHook = Leave;
+}
+
+static void *CreateManagedStatic(void *(*Creator)()) {
+  if (!EnterAllocHook)
+    return Creator();
+  void *Cookie = EnterAllocHook();
+  void *Result;
+  try {
+    Result = Creator();
+  } catch (...) {
+    LeaveAllocHook(Cookie);
+    throw;
+  }
+  LeaveAllocHook(Cookie);
+  return Result;
+}
+// HLSL Change Ends
+
 static sys::Mutex& getManagedStaticMutex() {
   // We need to use a function local static here, since this can get called
   // during a static constructor and we need to guarantee that it's initialized
@@ -36,7 +64,7 @@ void ManagedStaticBase::RegisterManagedStatic(void *(*Creator)(),
     MutexGuard Lock(getManagedStaticMutex());
 
     if (!Ptr) {
-      void* tmp = Creator();
+      void* tmp = CreateManagedStatic(Creator); // HLSL Change
 
       TsanHappensBefore(this);
       sys::MemoryFence();
@@ -56,7 +84,7 @@ void ManagedStaticBase::RegisterManagedStatic(void *(*Creator)(),
   } else {
     assert(!Ptr && !DeleterFn && !Next &&
            "Partially initialized ManagedStatic!?");
-    Ptr = Creator();
+    Ptr = CreateManagedStatic(Creator); // HLSL Change
     DeleterFn = Deleter;
   
     // Add to list of managed statics.
@@ -0,0 +1,52 @@
+//===-- PhaseTiming.cpp - Per-thread phase timing -------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// HLSL Change - this file is new.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/PhaseTiming.h"
+#include "llvm/Support/Compiler.h"
+#include <chrono>
+
+using namespace llvm;
+
+static LLVM_THREAD_LOCAL PhaseTimingListener *ThreadListener = nullptr;
+
+static double getWallSeconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+PhaseTimingListener::~PhaseTimingListener() {}
+
+PhaseTimingListener *llvm::setPhaseTimingListener(PhaseTimingListener *L) {
+  PhaseTimingListener *Previous = ThreadListener;
+  ThreadListener = L;
+  return Previous;
+}
+
+PhaseTimingListener *llvm::getPhaseTimingListener() { return ThreadListener; }
+
+PhaseTimingRegion::PhaseTimingRegion(StringRef Name, bool IsPass)
+    : Listener(Name.empty() ? nullptr : ThreadListener), Name(Name), IsPass(IsPass), Start(0) {
+  if (Listener)
+    Start = getWallSeconds();
+}
+
+PhaseTimingRegion::~PhaseTimingRegion() {
+  if (!Listener)
+    return;
+  double Seconds = getWallSeconds() - Start;
+  if (IsPass)
+    Listener->passFinished(Name, Seconds);
+  else
+    Listener->phaseFinished(Name, Seconds);
+}
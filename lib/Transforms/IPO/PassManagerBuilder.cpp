@@ -213,6 +213,8 @@ static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExten
     return;
   }
 
+  // Give the static consts bound late their value, before anything reads it.
+  MPM.add(createHLBindConstantsPass());
   MPM.add(createHLPreprocessPass());
   bool NoOpt = OptLevel == 0;
   if (!NoOpt) {
@@ -287,6 +289,84 @@ static void addHLSLPasses(bool HLSLHighLevel, unsigned OptLevel, hlsl::HLSLExten
 
   MPM.add(createDeadCodeEliminationPass());
 }
+
+// Lowers to final DXIL once optimization is done.
+static void addDxilFinalizationPasses(const PassManagerBuilder &PMB,
+                                      legacy::PassManagerBase &MPM) {
+  if (PMB.HLSLFastTrig)
+    MPM.add(createDxilExpandTrigIntrinsicsPass(/*Fast*/ true));
+  MPM.add(createDxilConvergentClearPass());
+  // Runs before resources are collected, so the ones that only the removed
+  // outputs used go away.
+  if (PMB.HLSLPositionOnly) {
+    MPM.add(createDxilPositionOnlyPass());
+    MPM.add(createAggressiveDCEPass());
+  }
+  MPM.add(createDeadCodeEliminationPass()); // DCE needed after clearing convergence
+                                            // annotations before CreateHandleForLib
+                                            // so no unused resources get re-added to
+                                            // DxilModule.
+  // Runs once the convergent markers no longer keep the calls apart.
+  MPM.add(createDxilReuseDerivativesPass());
+  if (PMB.HLSLMergeIdenticalFunctions)
+    MPM.add(createDxilMergeIdenticalFunctionsPass(/*Report*/ true));
+  // Groupshared arrays are padded while their rows are still arrays.
+  if (PMB.HLSLGroupSharedBankConflicts || PMB.HLSLPadGroupShared)
+    MPM.add(createDxilGroupSharedBankConflictsPass(
+        /*Report*/ true, /*Pad*/ PMB.HLSLPadGroupShared));
+  // Runs while unused samplers are still declared, so a gather may use one.
+  if (PMB.HLSLGatherTexelLoads)
+    MPM.add(createDxilGatherTexelLoadsPass());
+  MPM.add(createMultiDimArrayToOneDimArrayPass());
+  MPM.add(createDxilLowerCreateHandleForLibPass());
+  // Hoists before the nonUniform flags are set, so each hoisted handle gets
+  // the flag of the place it ends up in.
+  if (PMB.OptLevel > 0)
+    MPM.add(createDxilHoistResourceOpsPass());
+  MPM.add(createDxilUniformResourceIndexPass(PMB.HLSLInferNonUniformIndex));
+  if (PMB.HLSLDemoteOutputPrecision)
+    MPM.add(createDxilDemoteOutputPrecisionPass(/*Report*/ true));
+  MPM.add(createDxilTranslateRawBuffer());
+  MPM.add(createDxilEliminateDeadOutputStoresPass());
+  MPM.add(createDeadCodeEliminationPass());
+  // Runs once the control-point function is down to what it stores.
+  MPM.add(createDxilPassThroughHullShaderPass());
+  // Runs once all unrolling is done, so the copies of a partially unrolled
+  // body share one stepping index.
+  if (PMB.HLSLStrengthReduceBufferIndices)
+    MPM.add(createDxilStrengthReduceBufferIndicesPass());
+  // Runs once dead groupshared and UAV accesses are gone.
+  if (PMB.HLSLEliminateRedundantBarriers)
+    MPM.add(createDxilEliminateRedundantBarriersPass(/*Report*/ true));
+  // Needs resource handles lowered, to tell which are uniform.
+  if (PMB.HLSLWaveAggregateAtomics)
+    MPM.add(createDxilWaveAggregateAtomicsPass(/*Report*/ true));
+  // Always try to legalize sample offsets as loop unrolling
+  // is not guaranteed for higher opt levels.
+  MPM.add(createDxilLegalizeSampleOffsetPass());
+  // With a profile but no /auto-control-flow-hints, only the branches that
+  // the profile covers get hints.
+  if (PMB.HLSLAutoControlFlowHints || PMB.HLSLProfileUse)
+    MPM.add(createDxilSelectControlFlowHintsPass(
+        /*Report*/ PMB.HLSLAutoControlFlowHints,
+        /*ProfiledOnly*/ !PMB.HLSLAutoControlFlowHints));
+  // Runs once no later pass can add a discard or UAV write.
+  if (PMB.HLSLInferEarlyDepthStencil || PMB.HLSLWarnEarlyDepthStencil)
+    MPM.add(createDxilInferEarlyDepthStencilPass(
+        /*Apply*/ PMB.HLSLInferEarlyDepthStencil, /*Report*/ true));
+  if (PMB.HLSLRecommendRootConstants)
+    MPM.add(createDxilRootConstantCandidatesPass());
+  // Both run last, so no later pass moves the instructions apart again.
+  if (PMB.HLSLClusterFetches)
+    MPM.add(createDxilClusterFetchesPass());
+  if (PMB.HLSLPair16BitOps)
+    MPM.add(createDxilPair16BitOpsPass());
+  MPM.add(createDxilFinalizeModulePass());
+  MPM.add(createComputeViewIdStatePass());
+  MPM.add(createDxilDeadFunctionEliminationPass());
+  MPM.add(createNoPausePassesPass());
+  MPM.add(createDxilEmitMetadataPass());
+}
 // HLSL Change Ends
 
 void PassManagerBuilder::populateModulePassManager(
@@ -318,6 +398,10 @@ void PassManagerBuilder::populateModulePassManager(
     addHLSLPasses(HLSLHighLevel, OptLevel, HLSLExtensionsCodeGen, MPM);
     if (!HLSLHighLevel) {
       MPM.add(createDxilConvergentClearPass());
+      if (HLSLPositionOnly) {
+        MPM.add(createDxilPositionOnlyPass());
+        MPM.add(createAggressiveDCEPass());
+      }
       MPM.add(createMultiDimArrayToOneDimArrayPass());
       MPM.add(createDxilLowerCreateHandleForLibPass());
       MPM.add(createDxilTranslateRawBuffer());
@@ -351,6 +435,27 @@ void PassManagerBuilder::populateModulePassManager(
 
   addInitialAliasAnalysisPasses(MPM);
 
+  // HLSL Change Begins.
+  // Fast iteration keeps the HLSL lowering above, which already promotes to
+  // registers, and follows it with a single round of cheap cleanups. The IPO,
+  // loop and full redundancy elimination passes are skipped, so loops are
+  // only unrolled when [unroll] requires it.
+  if (HLSLFastIteration) {
+    MPM.add(createInstructionCombiningPass());
+    addExtensionsToPM(EP_Peephole, MPM);
+    MPM.add(createCFGSimplificationPass());
+    if (!HLSLResMayAlias)
+      MPM.add(createDxilSimpleGVNHoistPass());
+    MPM.add(createHoistConstantArrayPass());
+    MPM.add(createAggressiveDCEPass());
+    MPM.add(createCFGSimplificationPass());
+    if (!HLSLHighLevel)
+      addDxilFinalizationPasses(*this, MPM);
+    addExtensionsToPM(EP_OptimizerLast, MPM);
+    return;
+  }
+  // HLSL Change Ends.
+
   if (!DisableUnitAtATime) {
     addExtensionsToPM(EP_ModuleOptimizerEarly, MPM);
 
@@ -400,6 +505,12 @@ void PassManagerBuilder::populateModulePassManager(
   // HLSL Change - disable LICM in frontend for not consider register pressure.
   //MPM.add(createLICMPass());                  // Hoist loop invariants
   //MPM.add(createLoopUnswitchPass(SizeLevel || OptLevel < 3)); // HLSL Change - may move barrier inside divergent if.
+  // HLSL Change Begins - only on wave-uniform conditions, in loops without
+  // barriers, so that each copy still runs in step across the wave.
+  if (HLSLUnswitchUniformLoops)
+    MPM.add(createLoopUnswitchPass(SizeLevel || OptLevel < 3,
+                                   /*UniformOnly*/ true));
+  // HLSL Change Ends
   MPM.add(createInstructionCombiningPass());
   MPM.add(createIndVarSimplifyPass());        // Canonicalize indvars
   // HLSL Change Begins
@@ -415,12 +526,21 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createSimpleLoopUnrollPass());    // Unroll small loops
   addExtensionsToPM(EP_LoopOptimizerEnd, MPM);
 
+  // HLSL Change - keep small dynamically indexed arrays out of scratch memory.
+  if (!HLSLHighLevel)
+    MPM.add(createDxilEliminateLocalDynamicIndexingPass());
+
   if (OptLevel > 1) {
     if (EnableMLSM)
       MPM.add(createMergedLoadStoreMotionPass()); // Merge ld/st in diamonds
     MPM.add(createGVNPass(DisableGVNLoadPRE));  // Remove redundancies
-    if (!HLSLResMayAlias)
-      MPM.add(createDxilSimpleGVNHoistPass()); // HLSL Change - GVN hoist for code size.
+    // HLSL Change Begins.
+    if (!HLSLResMayAlias) {
+      MPM.add(createDxilSimpleGVNEliminatePass()); // Remove redundant DXIL ops.
+      MPM.add(createDxilSimpleGVNHoistPass()); // GVN hoist for code size.
+      MPM.add(createDxilCoalesceRawBufferAccessPass()); // Widen buffer access.
+    }
+    // HLSL Change Ends.
   }
   // HLSL Change Begins.
   // HLSL don't allow memcpy and memset.
@@ -596,25 +716,8 @@ void PassManagerBuilder::populateModulePassManager(
     MPM.add(createMergeFunctionsPass());
 
   // HLSL Change Begins.
-  if (!HLSLHighLevel) {
-    MPM.add(createDxilConvergentClearPass());
-    MPM.add(createDeadCodeEliminationPass()); // DCE needed after clearing convergence
-                                              // annotations before CreateHandleForLib
-                                              // so no unused resources get re-added to
-                                              // DxilModule.
-    MPM.add(createMultiDimArrayToOneDimArrayPass());
-    MPM.add(createDxilLowerCreateHandleForLibPass());
-    MPM.add(createDxilTranslateRawBuffer());
-    MPM.add(createDeadCodeEliminationPass());
-    // Always try to legalize sample offsets as loop unrolling
-    // is not guaranteed for higher opt levels.
-    MPM.add(createDxilLegalizeSampleOffsetPass());
-    MPM.add(createDxilFinalizeModulePass());
-    MPM.add(createComputeViewIdStatePass());
-    MPM.add(createDxilDeadFunctionEliminationPass());
-    MPM.add(createNoPausePassesPass());
-    MPM.add(createDxilEmitMetadataPass());
-  }
+  if (!HLSLHighLevel)
+    addDxilFinalizationPasses(*this, MPM);
   // HLSL Change Ends.
   addExtensionsToPM(EP_OptimizerLast, MPM);
 }
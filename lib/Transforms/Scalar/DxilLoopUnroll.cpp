@@ -50,6 +50,10 @@
 //    Instead, we unroll to find a constant terminal condition. Give up when we
 //    fail to do so.
 //
+//    A loop that would exceed the size budget is an error, unless the profile
+//    (-fprofile-use) shows that it never runs: it then stays rolled with a
+//    warning, leaving the budget for the loops that do.
+//
 //
 //===----------------------------------------------------------------------===//
 
@@ -60,6 +64,7 @@
 #include "llvm/Analysis/LoopPass.h"
 #include "llvm/Analysis/InstructionSimplify.h"
 #include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
@@ -74,6 +79,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/Statistic.h"
 
 #include "dxc/DXIL/DxilUtil.h"
 #include "dxc/HLSL/HLModule.h"
@@ -81,6 +87,13 @@
 using namespace llvm;
 using namespace hlsl;
 
+#define DEBUG_TYPE "dxil-loop-unroll"
+
+STATISTIC(NumUnrolled, "Number of loops unrolled");
+STATISTIC(NumEstimatedSize, "Estimated size of unrolled loop bodies");
+STATISTIC(NumActualSize, "Actual size of unrolled loop bodies");
+STATISTIC(NumOverBudget, "Number of loops not unrolled for exceeding the size budget");
+
 // Copied over from LoopUnroll.cpp - RemapInstruction()
 static inline void RemapInstruction(Instruction *I,
                                     ValueToValueMapTy &VMap) {
@@ -108,11 +121,18 @@ public:
   static char ID;
 
   std::unordered_set<Function *> CleanedUpAlloca;
+  // Size added to each function by the loops unrolled in it so far.
+  std::unordered_map<Function *, uint64_t> UnrolledSize;
   unsigned MaxIterationAttempt = 0;
+  // Largest total size, in TargetTransformInfo cost units, that unrolled
+  // loops may add to a single function.
+  unsigned MaxUnrolledSize = 0;
 
-  DxilLoopUnroll(unsigned MaxIterationAttempt = 128) :
+  DxilLoopUnroll(unsigned MaxIterationAttempt = 128,
+                 unsigned MaxUnrolledSize = 1 << 20) :
     LoopPass(ID),
-    MaxIterationAttempt(MaxIterationAttempt)
+    MaxIterationAttempt(MaxIterationAttempt),
+    MaxUnrolledSize(MaxUnrolledSize)
   {
     initializeDxilLoopUnrollPass(*PassRegistry::getPassRegistry());
   }
@@ -124,6 +144,18 @@ public:
     AU.addRequired<AssumptionCacheTracker>();
     AU.addRequired<DominatorTreeWrapperPass>();
     AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+  }
+  void applyOptions(PassOptions O) override {
+    GetPassOptionUnsigned(O, "MaxIterationAttempt", &MaxIterationAttempt,
+                          MaxIterationAttempt);
+    GetPassOptionUnsigned(O, "MaxUnrolledSize", &MaxUnrolledSize,
+                          MaxUnrolledSize);
+  }
+  void dumpConfig(raw_ostream &OS) override {
+    LoopPass::dumpConfig(OS);
+    OS << ",MaxIterationAttempt=" << MaxIterationAttempt;
+    OS << ",MaxUnrolledSize=" << MaxUnrolledSize;
   }
 };
 
@@ -144,6 +176,43 @@ static void FailLoopUnroll(bool WarnOnly, LLVMContext &Ctx, DebugLoc DL, const c
   }
 }
 
+static void FailLoopUnrollOverBudget(bool WarnOnly, LLVMContext &Ctx,
+                                     DebugLoc DL, uint64_t EstimatedSize,
+                                     unsigned Budget) {
+  std::string Message;
+  raw_string_ostream OS(Message);
+  OS << "Could not unroll loop: estimated unrolled size of " << EstimatedSize
+     << " exceeds the budget of " << Budget << ".";
+  FailLoopUnroll(WarnOnly, Ctx, DL, OS.str().c_str());
+}
+
+// Whether the profile shows that the loop is never entered, from the weights
+// of the branch that leads to its preheader.
+static bool IsColdLoop(Loop *L) {
+  BasicBlock *Preheader = L->getLoopPredecessor();
+  BasicBlock *Guard = Preheader ? Preheader->getSinglePredecessor() : nullptr;
+  if (!Guard)
+    return false;
+  BranchInst *BI = dyn_cast<BranchInst>(Guard->getTerminator());
+  uint64_t Weights[2];
+  if (!BI || !hlsl::dxilutil::GetBranchWeights(BI, &Weights[0], &Weights[1]))
+    return false;
+  unsigned Entered = BI->getSuccessor(0) == Preheader ? 0 : 1;
+  return Weights[Entered] == 0 && Weights[1 - Entered] != 0;
+}
+
+// Size of the live instructions in BB, weighted by their target cost.
+static unsigned EstimateBlockSize(BasicBlock *BB,
+                                  const TargetTransformInfo &TTI) {
+  unsigned Size = 0;
+  for (Instruction &I : *BB) {
+    if (isa<DbgInfoIntrinsic>(&I) || isInstructionTriviallyDead(&I))
+      continue;
+    Size += TTI.getUserCost(&I);
+  }
+  return Size;
+}
+
 struct LoopIteration {
   SmallVector<BasicBlock *, 16> Body;
   BasicBlock *Latch = nullptr;
@@ -734,6 +803,29 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
   std::unordered_set<BasicBlock *> ProblemBlocks;
   FindProblemBlocks(L->getHeader(), BlocksInLoop, ProblemBlocks, ProblemAllocas);
 
+  // Every iteration clones the body and the exit blocks that need unrolling,
+  // so each one adds about the same size. With an explicit count the whole
+  // expansion is known before anything is cloned; otherwise the budget is
+  // checked before each iteration.
+  const TargetTransformInfo &TTI =
+      getAnalysis<TargetTransformInfoWrapperPass>().getTTI(*F);
+  uint64_t IterationSize = 0;
+  for (BasicBlock *BB : L->getBlocks())
+    IterationSize += EstimateBlockSize(BB, TTI);
+  for (BasicBlock *BB : ExitBlocks)
+    if (ProblemBlocks.count(BB))
+      IterationSize += EstimateBlockSize(BB, TTI);
+  uint64_t &FunctionUnrolledSize = UnrolledSize[F];
+  if (HasExplicitLoopCount &&
+      FunctionUnrolledSize + UnrollCount * IterationSize > MaxUnrolledSize) {
+    ++NumOverBudget;
+    FailLoopUnrollOverBudget(FxcCompatMode || IsColdLoop(L) /*warn only*/,
+                             F->getContext(), LoopLoc,
+                             UnrollCount * IterationSize,
+                             MaxUnrolledSize);
+    return false;
+  }
+
   // Keep track of the PHI nodes at the header.
   SmallVector<PHINode *, 16> PHIs;
   for (auto it = Header->begin(); it != Header->end(); it++) {
@@ -817,9 +909,15 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
   SmallVector<std::unique_ptr<LoopIteration>, 16> Iterations; // List of cloned iterations
   bool Succeeded = false;
+  bool OverBudget = false;
 
   for (unsigned IterationI = 0; IterationI < this->MaxIterationAttempt; IterationI++) {
 
+    if (FunctionUnrolledSize + (IterationI + 1) * IterationSize > MaxUnrolledSize) {
+      OverBudget = true;
+      break;
+    }
+
     LoopIteration *PrevIteration = nullptr;
     if (Iterations.size())
       PrevIteration = Iterations.back().get();
@@ -958,6 +1056,18 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
     for (AllocaInst *AI : ProblemAllocas)
       DXASSERT(AI->getParent() == &F->getEntryBlock(), "Alloca is not in entry block.");
 
+    uint64_t ActualSize = 0;
+    for (std::unique_ptr<LoopIteration> &Ptr : Iterations)
+      for (BasicBlock *BB : Ptr->Body)
+        ActualSize += EstimateBlockSize(BB, TTI);
+    FunctionUnrolledSize += ActualSize;
+    ++NumUnrolled;
+    NumEstimatedSize += Iterations.size() * IterationSize;
+    NumActualSize += ActualSize;
+    DEBUG(dbgs() << "DxilLoopUnroll: unrolled " << Iterations.size()
+                 << " iterations, estimated size " << Iterations.size() * IterationSize
+                 << ", actual size " << ActualSize << "\n");
+
     LoopIteration &FirstIteration = *Iterations.front().get();
     // Make the predecessor branch to the first new header.
     {
@@ -1033,7 +1143,15 @@ bool DxilLoopUnroll::runOnLoop(Loop *L, LPPassManager &LPM) {
 
   // If we were unsuccessful in unrolling the loop
   else {
-    FailLoopUnroll(FxcCompatMode /*warn only*/, F->getContext(), LoopLoc, "Could not unroll loop.");
+    if (OverBudget) {
+      ++NumOverBudget;
+      FailLoopUnrollOverBudget(FxcCompatMode || IsColdLoop(L) /*warn only*/,
+                               F->getContext(), LoopLoc,
+                               (Iterations.size() + 1) * IterationSize,
+                               MaxUnrolledSize);
+    } else {
+      FailLoopUnroll(FxcCompatMode /*warn only*/, F->getContext(), LoopLoc, "Could not unroll loop.");
+    }
 
     // Remove all the cloned blocks
     for (std::unique_ptr<LoopIteration> &Ptr : Iterations) {
@@ -1062,4 +1180,6 @@ Pass *llvm::createDxilLoopUnrollPass(unsigned MaxIterationAttempt) {
   return new DxilLoopUnroll(MaxIterationAttempt);
 }
 
-INITIALIZE_PASS(DxilLoopUnroll, "dxil-loop-unroll", "Dxil Unroll loops", false, false)
+INITIALIZE_PASS_BEGIN(DxilLoopUnroll, "dxil-loop-unroll", "Dxil Unroll loops", false, false)
+INITIALIZE_PASS_DEPENDENCY(TargetTransformInfoWrapperPass)
+INITIALIZE_PASS_END(DxilLoopUnroll, "dxil-loop-unroll", "Dxil Unroll loops", false, false)
@@ -50,8 +50,12 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/Local.h"
+#include "llvm/Analysis/PostDominators.h" // HLSL Change
+#include "dxc/DXIL/DxilOperations.h" // HLSL Change
+#include "dxc/HLSL/DxilGenerationPass.h" // HLSL Change
 #include <algorithm>
 #include <map>
+#include <memory> // HLSL Change
 #include <set>
 using namespace llvm;
 
@@ -116,9 +120,10 @@ namespace {
     unsigned MaxSize;
 
   public:
-    LUAnalysisCache()
+    // HLSL Change - take the threshold from the pass.
+    explicit LUAnalysisCache(unsigned MaxSize = Threshold)
         : CurLoopInstructions(nullptr), CurrentLoopProperties(nullptr),
-          MaxSize(Threshold) {}
+          MaxSize(MaxSize) {}
 
     // Analyze loop. Check its size, calculate is it possible to unswitch
     // it. Returns true if we can unswitch this loop.
@@ -161,6 +166,17 @@ namespace {
     bool OptimizeForSize;
     bool redoLoop;
 
+    // HLSL Change Begin - only unswitch on wave-uniform conditions.
+    // Every lane of a wave then takes the same copy of the loop, so no wave
+    // runs both, and for DXIL, loop sizes come from DxilTTIImpl.
+    bool UniformOnly;
+    unsigned SizeBudget;
+    std::unique_ptr<PostDominatorTree> PDT;
+    std::unique_ptr<hlsl::WaveUniformityAnalysis> Uniformity;
+    bool IsUniformCondition(Value *Cond);
+    static bool HasBarrier(Loop *L);
+    // HLSL Change End
+
     Loop *currentLoop;
     DominatorTree *DT;
     BasicBlock *loopHeader;
@@ -175,13 +191,31 @@ namespace {
 
   public:
     static char ID; // Pass ID, replacement for typeid
-    explicit LoopUnswitch(bool Os = false) :
-      LoopPass(ID), OptimizeForSize(Os), redoLoop(false),
+    // HLSL Change - add UniformOnly and SizeBudget.
+    explicit LoopUnswitch(bool Os = false, bool UniformOnly = false,
+                          unsigned SizeBudget = Threshold) :
+      LoopPass(ID), BranchesInfo(SizeBudget), OptimizeForSize(Os),
+      redoLoop(false), UniformOnly(UniformOnly), SizeBudget(SizeBudget),
       currentLoop(nullptr), DT(nullptr), loopHeader(nullptr),
       loopPreheader(nullptr) {
         initializeLoopUnswitchPass(*PassRegistry::getPassRegistry());
       }
 
+    // HLSL Change Begin
+    void applyOptions(PassOptions O) override {
+      GetPassOptionBool(O, "Os", &OptimizeForSize, OptimizeForSize);
+      GetPassOptionBool(O, "UniformOnly", &UniformOnly, UniformOnly);
+      GetPassOptionUnsigned(O, "SizeBudget", &SizeBudget, SizeBudget);
+      BranchesInfo = LUAnalysisCache(SizeBudget);
+    }
+    void dumpConfig(raw_ostream &OS) override {
+      LoopPass::dumpConfig(OS);
+      OS << ",Os=" << OptimizeForSize;
+      OS << ",UniformOnly=" << UniformOnly;
+      OS << ",SizeBudget=" << SizeBudget;
+    }
+    // HLSL Change End
+
     bool runOnLoop(Loop *L, LPPassManager &LPM) override;
     bool processCurrentLoop();
 
@@ -367,9 +401,42 @@ INITIALIZE_PASS_DEPENDENCY(LCSSA)
 INITIALIZE_PASS_END(LoopUnswitch, "loop-unswitch", "Unswitch loops",
                       false, false)
 
-Pass *llvm::createLoopUnswitchPass(bool Os) {
-  return new LoopUnswitch(Os);
+Pass *llvm::createLoopUnswitchPass(bool Os, bool UniformOnly,
+                                   unsigned SizeBudget) {
+  // HLSL Change Begin
+  if (SizeBudget == ~0U)
+    SizeBudget = Threshold;
+  return new LoopUnswitch(Os, UniformOnly, SizeBudget);
+  // HLSL Change End
+}
+
+// HLSL Change Begin
+// Returns true if Cond is the same on every lane of a wave. The analysis is
+// redone after each unswitch, since that changes the CFG it depends on.
+bool LoopUnswitch::IsUniformCondition(Value *Cond) {
+  if (!Uniformity) {
+    Function *F = loopHeader->getParent();
+    PDT.reset(new PostDominatorTree());
+    PDT->runOnFunction(*F);
+    Uniformity.reset(hlsl::WaveUniformityAnalysis::create(*PDT));
+    Uniformity->Analyze(F);
+  }
+  return Uniformity->IsUniform(Cond);
+}
+
+// Returns true if L syncs the thread group. A condition that is uniform in
+// each wave may still differ between the waves of a group, which would then
+// wait at the barriers of different copies of the loop.
+bool LoopUnswitch::HasBarrier(Loop *L) {
+  for (BasicBlock *BB : L->getBlocks()) {
+    for (Instruction &I : *BB) {
+      if (hlsl::OP::IsDxilOpFuncCallInst(&I, hlsl::OP::OpCode::Barrier))
+        return true;
+    }
+  }
+  return false;
 }
+// HLSL Change End
 
 /// FindLIVLoopCondition - Cond is a condition that occurs in L.  If it is
 /// invariant in the loop, or has an invariant piece, return the invariant.
@@ -424,8 +491,17 @@ bool LoopUnswitch::runOnLoop(Loop *L, LPPassManager &LPM_Ref) {
   do {
     assert(currentLoop->isLCSSAForm(*DT));
     redoLoop = false;
+    // HLSL Change Begin - other loop passes may have changed the CFG since
+    // the last loop, and an unswitch changes it again.
+    Uniformity.reset();
+    PDT.reset();
+    // HLSL Change End
     Changed |= processCurrentLoop();
   } while(redoLoop);
+  // HLSL Change Begin
+  Uniformity.reset();
+  PDT.reset();
+  // HLSL Change End
 
   if (Changed) {
     // FIXME: Reconstruct dom info, because it is not preserved properly.
@@ -456,12 +532,23 @@ bool LoopUnswitch::processCurrentLoop() {
 
   LLVMContext &Context = loopHeader->getContext();
 
+  // HLSL Change Begin
+  Function *F = currentLoop->getHeader()->getParent();
+  bool bDxil = F->getParent()->HasDxilModule();
+  if (UniformOnly && bDxil && HasBarrier(currentLoop))
+    return false;
+  std::unique_ptr<TargetTransformInfo> DxilTTI;
+  if (UniformOnly && bDxil)
+    DxilTTI.reset(
+        new TargetTransformInfo(hlsl::CreateDxilTargetTransformInfo(*F)));
+  const TargetTransformInfo &TTI =
+      DxilTTI ? *DxilTTI
+              : getAnalysis<TargetTransformInfoWrapperPass>().getTTI(*F);
+  // HLSL Change End
+
   // Probably we reach the quota of branches for this loop. If so
   // stop unswitching.
-  if (!BranchesInfo.countLoop(
-          currentLoop, getAnalysis<TargetTransformInfoWrapperPass>().getTTI(
-                           *currentLoop->getHeader()->getParent()),
-          AC))
+  if (!BranchesInfo.countLoop(currentLoop, TTI, AC)) // HLSL Change
     return false;
 
   // Loop over all of the basic blocks in the loop.  If we find an interior
@@ -478,6 +565,8 @@ bool LoopUnswitch::processCurrentLoop() {
         // unswitch on it if we desire.
         Value *LoopCond = FindLIVLoopCondition(BI->getCondition(),
                                                currentLoop, Changed);
+        if (LoopCond && UniformOnly && !IsUniformCondition(LoopCond)) // HLSL Change
+          LoopCond = nullptr;
         if (LoopCond &&
             UnswitchIfProfitable(LoopCond, ConstantInt::getTrue(Context), TI)) {
           ++NumBranches;
@@ -487,6 +576,8 @@ bool LoopUnswitch::processCurrentLoop() {
     } else if (SwitchInst *SI = dyn_cast<SwitchInst>(TI)) {
       Value *LoopCond = FindLIVLoopCondition(SI->getCondition(),
                                              currentLoop, Changed);
+      if (LoopCond && UniformOnly && !IsUniformCondition(LoopCond)) // HLSL Change
+        LoopCond = nullptr;
       unsigned NumCases = SI->getNumCases();
       if (LoopCond && NumCases) {
         // Find a value to unswitch on:
@@ -522,6 +613,8 @@ bool LoopUnswitch::processCurrentLoop() {
       if (SelectInst *SI = dyn_cast<SelectInst>(BBI)) {
         Value *LoopCond = FindLIVLoopCondition(SI->getCondition(),
                                                currentLoop, Changed);
+        if (LoopCond && UniformOnly && !IsUniformCondition(LoopCond)) // HLSL Change
+          LoopCond = nullptr;
         if (LoopCond && UnswitchIfProfitable(LoopCond,
                                              ConstantInt::getTrue(Context))) {
           ++NumSelects;
@@ -1549,16 +1549,32 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
   // alloca. Big alloca will be split to smaller piece first, when process the
   // alloca, it will be alloca flattened from big alloca instead of a GEP of big
   // alloca.
-  auto size_cmp = [&DL](const AllocaInst *a0, const AllocaInst *a1) -> bool {
-    Type* a0ty = a0->getAllocatedType();
-    Type* a1ty = a1->getAllocatedType();
-    bool isUnitSzStruct0 = a0ty->isStructTy() && a0ty->getStructNumElements() == 1;
-    bool isUnitSzStruct1 = a1ty->isStructTy() && a1ty->getStructNumElements() == 1;
-    auto sz0 = DL.getTypeAllocSize(a0ty);
-    auto sz1 = DL.getTypeAllocSize(a1ty);
-    if (sz0 == sz1 && (isUnitSzStruct0 || isUnitSzStruct1))
-      return getNestedLevelInStruct(a0ty) < getNestedLevelInStruct(a1ty);
-    return sz0 < sz1;
+  // The ordering is computed once per type: splitting a large array of structs
+  // pushes many allocas of the same few types, and sizing nested array types
+  // walks the whole type on every heap comparison otherwise.
+  struct AllocaOrder {
+    uint64_t Size;
+    unsigned NestedLevel;
+    bool IsUnitSzStruct;
+  };
+  std::unordered_map<Type *, AllocaOrder> OrderCache;
+  auto getOrder = [&DL, &OrderCache](const AllocaInst *AI) -> const AllocaOrder & {
+    Type *Ty = AI->getAllocatedType();
+    auto it = OrderCache.find(Ty);
+    if (it != OrderCache.end())
+      return it->second;
+    AllocaOrder Order;
+    Order.Size = DL.getTypeAllocSize(Ty);
+    Order.NestedLevel = getNestedLevelInStruct(Ty);
+    Order.IsUnitSzStruct = Ty->isStructTy() && Ty->getStructNumElements() == 1;
+    return OrderCache.emplace(Ty, Order).first->second;
+  };
+  auto size_cmp = [&getOrder](const AllocaInst *a0, const AllocaInst *a1) -> bool {
+    const AllocaOrder &o0 = getOrder(a0);
+    const AllocaOrder &o1 = getOrder(a1);
+    if (o0.Size == o1.Size && (o0.IsUnitSzStruct || o1.IsUnitSzStruct))
+      return o0.NestedLevel < o1.NestedLevel;
+    return o0.Size < o1.Size;
   };
   std::priority_queue<AllocaInst *, std::vector<AllocaInst *>,
                       std::function<bool(AllocaInst *, AllocaInst *)>>
@@ -1628,7 +1644,10 @@ bool SROA_HLSL::performScalarRepl(Function &F, DxilTypeSystem &typeSys) {
     // separate elements.
     if (ShouldAttemptScalarRepl(AI) && isSafeAllocaToScalarRepl(AI)) {
       std::vector<Value *> Elts;
-      IRBuilder<> Builder(dxilutil::FirstNonAllocaInsertionPt(AI));
+      // Allocas have no constant users, so the builder is only used to find
+      // where the new allocas go. Skipping past every alloca in the entry
+      // block for each split would make splitting quadratic in their number.
+      IRBuilder<> Builder(dxilutil::FindAllocaInsertionPt(AI));
       bool hasPrecise = HLModule::HasPreciseAttributeWithMetadata(AI);
 
       bool SROAed = SROA_Helper::DoScalarReplacement(
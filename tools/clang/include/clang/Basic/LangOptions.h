@@ -158,6 +158,13 @@ public:
   bool UseMinPrecision; // use min precision, not native precision.
   bool EnableDX9CompatMode;
   bool EnableFXCCompatMode;
+  // Library functions without export or shader attributes get internal
+  // linkage, so they need only be emitted when something else calls them.
+  bool HLSLDefaultLinkageInternal = false;
+  // When a library is generated in shards, each shard defines only the
+  // functions that would be emitted anyway and that hash to its index.
+  unsigned HLSLLibraryShardCount = 1;
+  unsigned HLSLLibraryShardIndex = 0;
   // HLSL Change Ends
 
   bool SPIRV = false;  // SPIRV Change
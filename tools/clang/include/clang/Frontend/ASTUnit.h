@@ -313,6 +313,13 @@ private:
   /// \brief True if non-system source files should be treated as volatile
   /// (likely to change while trying to use them).
   bool UserFilesAreVolatile : 1;
+
+  // HLSL Change Starts
+  /// \brief True if the bodies of functions outside the main file are
+  /// skipped. This stands in for the precompiled preamble, which isn't
+  /// supported: the included files are parsed for their declarations only.
+  bool SkipPreambleFunctionBodies : 1;
+  // HLSL Change Ends
  
   /// \brief The language options used when we load an AST file.
   LangOptions ASTFileLangOpts;
@@ -552,6 +559,8 @@ public:
 
   bool getOnlyLocalDecls() const { return OnlyLocalDecls; }
 
+  bool getSkipPreambleFunctionBodies() const { return SkipPreambleFunctionBodies; } // HLSL Change
+
   bool getOwnsRemappedFileBuffers() const { return OwnsRemappedFileBuffers; }
   void setOwnsRemappedFileBuffers(bool val) { OwnsRemappedFileBuffers = val; }
 
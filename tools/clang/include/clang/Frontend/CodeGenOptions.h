@@ -207,6 +207,9 @@ public:
   unsigned HLSLDefaultSpace = UINT_MAX;
   /// HLSLLibraryExports specifies desired exports, with optional renaming
   std::vector<std::string> HLSLLibraryExports;
+  /// Global static consts emitted as variables instead of being folded, so
+  /// that hl-bind-constants can give them per-permutation values.
+  std::vector<std::string> HLSLLateBindConsts;
   /// ExportShadersOnly limits library export functions to shaders
   bool ExportShadersOnly = false;
   /// DefaultLinkage Internal, External, or Default.  If Default, default
@@ -214,6 +217,54 @@ public:
   hlsl::DXIL::DefaultLinkage DefaultLinkage = hlsl::DXIL::DefaultLinkage::Default;
   /// Assume UAVs/SRVs may alias.
   bool HLSLResMayAlias = false;
+  /// Run the reduced optimization pipeline meant for fast iteration.
+  bool HLSLFastIteration = false;
+  /// Infer NonUniformResourceIndex from resource index uniformity.
+  bool HLSLInferNonUniformIndex = false;
+  /// Expand trig intrinsics that are not precise to fast approximations.
+  bool HLSLFastTrig = false;
+  /// Compute low precision outputs in 16-bit arithmetic where provably safe.
+  bool HLSLDemoteOutputPrecision = false;
+  /// Select [branch] or [flatten] for branches without a hint.
+  bool HLSLAutoControlFlowHints = false;
+  /// Warn on groupshared accesses that likely conflict in memory banks.
+  bool HLSLGroupSharedBankConflicts = false;
+  /// Pad groupshared arrays whose accesses conflict in memory banks.
+  bool HLSLPadGroupShared = false;
+  /// Set [earlydepthstencil] on pixel shaders that can use it.
+  bool HLSLInferEarlyDepthStencil = false;
+  /// Warn on pixel shaders that could use [earlydepthstencil].
+  bool HLSLWarnEarlyDepthStencil = false;
+  /// Reorder the constants of each cbuffer to pack them into fewer rows.
+  bool HLSLReorderCBuffers = false;
+  /// Warn on cbuffers small enough to bind as root constants.
+  bool HLSLRecommendRootConstants = false;
+  /// Merge the identical functions of a library.
+  bool HLSLMergeIdenticalFunctions = false;
+  /// Reduce a vertex shader to the outputs the rasterizer reads.
+  bool HLSLPositionOnly = false;
+  /// Remove barriers that an earlier barrier makes redundant.
+  bool HLSLEliminateRedundantBarriers = false;
+  /// Combine uniform-address atomic adds into one atomic per wave.
+  bool HLSLWaveAggregateAtomics = false;
+  /// Place independent 16-bit operations of the same kind next to each other.
+  bool HLSLPair16BitOps = false;
+  /// Move texture and buffer fetches up, next to each other.
+  bool HLSLClusterFetches = false;
+  /// Step buffer indices computed from loop counters by a constant instead.
+  bool HLSLStrengthReduceBufferIndices = false;
+  /// Unswitch loops on wave-uniform conditions, within a size budget.
+  bool HLSLUnswitchUniformLoops = false;
+  /// Combine loads of 2x2 blocks of texels into gathers.
+  bool HLSLGatherTexelLoads = false;
+  /// For lib_6_3 and later, the size from which helpers called from more
+  /// than one place are kept as functions; zero to inline every helper.
+  unsigned HLSLLibNoInlineSize = 0;
+  /// Options of backend passes, as "pass,option=value[,...]", for this
+  /// compile only.
+  std::vector<std::string> HLSLPassOptions;
+  /// Directory to keep the sources in, embedding only references to them.
+  std::string HLSLSourceStoreDir;
   // HLSL Change Ends
 
   // SPIRV Change Starts
@@ -11,8 +11,23 @@
 
 #include "clang/Frontend/FrontendAction.h"
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace llvm {
+class raw_ostream;
+}
+
 namespace clang {
 
+class ASTConsumer;
+
+/// Creates the consumer that emits SPIR-V for the translation unit to the
+/// given stream. This lets another action emit SPIR-V from the same AST.
+std::unique_ptr<ASTConsumer> CreateSPIRVEmitter(CompilerInstance &CI,
+                                                llvm::raw_ostream *OS);
+
 class EmitSPIRVAction : public ASTFrontendAction {
 public:
   EmitSPIRVAction() {}
@@ -22,6 +37,21 @@ protected:
                                                  StringRef InFile) override;
 };
 
+namespace spirv {
+
+struct SpirvCodeGenOptions;
+
+/// Links SPIR-V modules that export and import functions by name into one
+/// module. Unless it creates a library, the link also legalizes, optimizes at
+/// optLevel and validates the result, as compiling a shader would. Returns
+/// false, with the reason in messages, on failure.
+bool linkSpirvModules(const std::vector<std::vector<uint32_t>> &modules,
+                      const SpirvCodeGenOptions &options, bool createLibrary,
+                      unsigned optLevel, std::vector<uint32_t> *linked,
+                      std::string *messages);
+
+} // end namespace spirv
+
 } // end namespace clang
 
 #endif
\ No newline at end of file
@@ -69,6 +69,10 @@ public:
   };
 
   explicit InstBuilder(WordConsumer);
+  /// \brief Constructs a builder that appends the words of each instruction
+  /// to the given buffer instead of feeding them to a consumer. The buffer
+  /// for the instruction under construction is then reused.
+  explicit InstBuilder(std::vector<uint32_t> *output);
 
   // Disable copy constructor/assignment.
   InstBuilder(const InstBuilder &) = delete;
@@ -91,6 +95,10 @@ public:
   /// \brief Clears the current instruction under building.
   void clear();
 
+  /// \brief Feeds already generated SPIR-V words, like those of a stored
+  /// instruction, to the output buffer or the consumer.
+  void emit(std::vector<uint32_t> &&words);
+
   // Instruction building methods.
   InstBuilder &opSourceContinued(llvm::StringRef continued_source);
   InstBuilder &opSource(spv::SourceLanguage source_language, uint32_t version,
@@ -429,6 +437,7 @@ private:
   void encodeString(llvm::StringRef value);
 
   WordConsumer TheConsumer;
+  std::vector<uint32_t> *TheOutput = nullptr; ///< Output, if no consumer.
   std::vector<uint32_t> TheInst;       ///< The instruction under construction.
   std::deque<OperandKind> Expectation; ///< Expected additional parameters.
   Status TheStatus;                    ///< Current building status.
@@ -18,6 +18,7 @@
 #include "clang/SPIRV/InstBuilder.h"
 #include "clang/SPIRV/SPIRVContext.h"
 #include "clang/SPIRV/Structure.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringRef.h"
@@ -434,6 +435,11 @@ public:
   /// \brief Decorates the given target <result-id> with NoContraction
   void decorateNoContraction(uint32_t targetId);
 
+  /// \brief Decorates the given target <result-id> to be exported or imported
+  /// under the given name when linking.
+  void decorateLinkage(uint32_t targetId, llvm::StringRef name,
+                       spv::LinkageType linkageType);
+
   // === Type ===
 
   uint32_t getVoidType();
@@ -504,6 +510,10 @@ private:
   /// \brief Returns the basic block with the given <label-id>.
   BasicBlock *getBasicBlock(uint32_t label);
 
+  /// \brief Appends the instruction in constructSite to the current basic
+  /// block. Local variables that it uses stop being forwardable.
+  void appendInstruction();
+
   /// \brief Returns the composed ImageOperandsMask from non-zero parameters
   /// and pushes non-zero parameters to *orderedParams in the expected order.
   spv::ImageOperandsMask composeImageOperandsMask(
@@ -521,6 +531,15 @@ private:
   OrderedBasicBlockMap basicBlocks;      ///< The basic blocks under building.
   BasicBlock *insertPoint;               ///< The current insertion point.
 
+  /// Local variables of the current function, with their value types, whose
+  /// pointers have only been used by whole loads and stores. Nothing else can
+  /// write them, so a load can reuse the value last stored to or loaded from
+  /// them in the current basic block. Not tracked with -fcgl, which keeps
+  /// every load and store.
+  llvm::DenseMap<uint32_t, uint32_t> forwardableVars;
+  /// The known value of each forwardable variable in the current basic block.
+  llvm::DenseMap<uint32_t, uint32_t> knownValues;
+
   /// An InstBuilder associated with the current ModuleBuilder.
   /// It can be used to contruct instructions on the fly.
   /// The constructed instruction will appear in constructSite.
@@ -9,35 +9,76 @@
 #ifndef LLVM_CLANG_SPIRV_SPIRVCONTEXT_H
 #define LLVM_CLANG_SPIRV_SPIRVCONTEXT_H
 
-#include <unordered_map>
-
 #include "clang/Frontend/FrontendAction.h"
 #include "clang/SPIRV/Constant.h"
 #include "clang/SPIRV/Decoration.h"
 #include "clang/SPIRV/Type.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/Support/Allocator.h"
 
 namespace clang {
 namespace spirv {
 
 struct TypeHash {
   std::size_t operator()(const Type &t) const {
-    // TODO: We could improve this hash function if necessary.
-    return std::hash<uint32_t>{}(static_cast<uint32_t>(t.getOpcode()));
+    // Decorations are left out since they compare regardless of order.
+    const auto &args = t.getArgs();
+    return llvm::hash_combine(
+        static_cast<uint32_t>(t.getOpcode()),
+        llvm::hash_combine_range(args.begin(), args.end()));
   }
 };
 struct DecorationHash {
   std::size_t operator()(const Decoration &d) const {
-    // TODO: We could probably improve this hash function if needed.
-    return std::hash<uint32_t>{}(static_cast<uint32_t>(d.getValue()));
+    const auto &args = d.getArgs();
+    const auto memberIndex = d.getMemberIndex();
+    return llvm::hash_combine(
+        static_cast<uint32_t>(d.getValue()),
+        llvm::hash_combine_range(args.begin(), args.end()),
+        memberIndex.hasValue() ? memberIndex.getValue() + 1 : 0u);
   }
 };
 struct ConstantHash {
   std::size_t operator()(const Constant &c) const {
-    // TODO: We could improve this hash function if necessary.
-    return std::hash<uint32_t>{}(static_cast<uint32_t>(c.getTypeId()));
+    const auto &args = c.getArgs();
+    return llvm::hash_combine(
+        static_cast<uint32_t>(c.getOpcode()), c.getTypeId(),
+        llvm::hash_combine_range(args.begin(), args.end()));
   }
 };
 
+/// \brief DenseMapInfo for pointers to values uniqued in a SPIRVContext.
+/// Uniqued values are equal only if they are the same object, so pointers
+/// compare as pointers; looking up a value hashes and compares what it holds.
+template <typename T, typename Hash> struct UniquePtrInfo {
+  static const T *getEmptyKey() {
+    return llvm::DenseMapInfo<const T *>::getEmptyKey();
+  }
+  static const T *getTombstoneKey() {
+    return llvm::DenseMapInfo<const T *>::getTombstoneKey();
+  }
+  static unsigned getHashValue(const T *p) { return Hash()(*p); }
+  static unsigned getHashValue(const T &v) { return Hash()(v); }
+  static bool isEqual(const T *l, const T *r) { return l == r; }
+  static bool isEqual(const T &l, const T *r) {
+    return r != getEmptyKey() && r != getTombstoneKey() && l == *r;
+  }
+};
+
+/// \brief The layout of a frontend type under one layout rule, as computed
+/// by TypeTranslator::getAlignmentAndSize.
+struct TypeLayout {
+  uint32_t alignment;
+  uint32_t size;
+  /// The array or matrix stride the computation wrote, if hasStride.
+  uint32_t stride;
+  bool hasStride;
+  /// Whether the computation cleared the matrix majorness it started with.
+  bool clearsMajorness;
+};
+
 /// \brief A class for holding various data needed in SPIR-V codegen.
 /// It should outlive all SPIR-V codegen components that requires/allocates
 /// data.
@@ -79,38 +120,70 @@ public:
   /// context, and returns the unique Decoration pointer.
   const Decoration *registerDecoration(const Decoration &);
 
+  /// \brief Returns the layout recorded for the given frontend type, layout
+  /// rule and matrix majorness in effect, or nullptr if there is none.
+  inline const TypeLayout *getTypeLayout(const void *type, unsigned rule,
+                                         unsigned majorness) const;
+
+  /// \brief Records the layout of the given frontend type under the given
+  /// layout rule and matrix majorness in effect.
+  inline void setTypeLayout(const void *type, unsigned rule,
+                            unsigned majorness, const TypeLayout &layout);
+
 private:
-  using TypeSet = std::unordered_set<Type, TypeHash>;
-  using ConstantSet = std::unordered_set<Constant, ConstantHash>;
-  using DecorationSet = std::unordered_set<Decoration, DecorationHash>;
+  using TypeMap =
+      llvm::DenseMap<const Type *, uint32_t, UniquePtrInfo<Type, TypeHash>>;
+  using ConstantMap = llvm::DenseMap<const Constant *, uint32_t,
+                                     UniquePtrInfo<Constant, ConstantHash>>;
+  using DecorationSet =
+      llvm::DenseSet<const Decoration *,
+                     UniquePtrInfo<Decoration, DecorationHash>>;
+  using TypeLayoutMap =
+      llvm::DenseMap<std::pair<const void *, unsigned>, TypeLayout>;
 
   uint32_t nextId;
 
+  /// \brief Storage for the unique types, constants and decorations. They
+  /// live as long as the context.
+  llvm::SpecificBumpPtrAllocator<Type> typeArena;
+  llvm::SpecificBumpPtrAllocator<Constant> constantArena;
+  llvm::SpecificBumpPtrAllocator<Decoration> decorationArena;
+
   /// \brief All the unique Decorations defined in the current context.
   DecorationSet existingDecorations;
 
-  /// \brief All the unique types defined in the current context.
-  TypeSet existingTypes;
+  /// \brief All the unique types defined in the current context, with the
+  /// <result-id> that is defined for each. A type whose <result-id> is 0 is
+  /// not yet defined.
+  TypeMap existingTypes;
 
-  /// \brief All constants defined in the current context.
+  /// \brief All constants defined in the current context, with the
+  /// <result-id> that is defined for each, or 0 if not yet defined.
   /// These can be boolean, integer, float, or composite constants.
-  ConstantSet existingConstants;
-
-  /// \brief Maps a given type to the <result-id> that is defined for
-  /// that type. If a Type* does not exist in the map, the type
-  /// is not yet defined and is not associated with a <result-id>.
-  std::unordered_map<const Type *, uint32_t> typeResultIdMap;
+  ConstantMap existingConstants;
 
-  /// \brief Maps a given constant to the <result-id> that is defined for
-  /// that constant. If a Constant* does not exist in the map, the constant
-  /// is not yet defined and is not associated with a <result-id>.
-  std::unordered_map<const Constant *, uint32_t> constantResultIdMap;
+  /// \brief Layouts of the frontend types translated so far. Nested
+  /// resource structs are laid out again each time a type containing them
+  /// is translated or decorated with offsets.
+  TypeLayoutMap typeLayouts;
 };
 
 SPIRVContext::SPIRVContext() : nextId(1) {}
 uint32_t SPIRVContext::getNextId() const { return nextId; }
 uint32_t SPIRVContext::takeNextId() { return nextId++; }
 
+const TypeLayout *SPIRVContext::getTypeLayout(const void *type, unsigned rule,
+                                              unsigned majorness) const {
+  auto it = typeLayouts.find(std::make_pair(type, rule * 4 + majorness));
+  return it == typeLayouts.end() ? nullptr : &it->second;
+}
+
+void SPIRVContext::setTypeLayout(const void *type, unsigned rule,
+                                 unsigned majorness,
+                                 const TypeLayout &layout) {
+  typeLayouts[std::make_pair(type, rule * 4 + majorness)] = layout;
+}
+
 } // end namespace spirv
 } // end namespace clang
 
@@ -217,8 +217,9 @@ struct Header {
   /// \brief Default constructs a SPIR-V module header with id bound 0.
   Header();
 
-  /// \brief Feeds the consumer with all the SPIR-V words for this header.
-  void collect(const WordConsumer &consumer);
+  /// \brief Feeds the given InstBuilder with all the SPIR-V words for this
+  /// header.
+  void collect(InstBuilder *builder);
 
   const uint32_t magicNumber;
   uint32_t version;
@@ -289,8 +290,8 @@ public:
   /// an empty module.
   void clear();
 
-  /// \brief Collects all the SPIR-V words in this module and consumes them
-  /// using the consumer within the given InstBuilder. This method is
+  /// \brief Collects all the SPIR-V words in this module and feeds them to
+  /// the output or the consumer of the given InstBuilder. This method is
   /// destructive; the module will be consumed and cleared after calling it.
   void take(InstBuilder *builder);
 
@@ -329,6 +330,10 @@ public:
   inline uint32_t getExtInstSetId(llvm::StringRef setName);
 
 private:
+  /// \brief Serializes all functions, several at a time on large modules,
+  /// and feeds them to the given InstBuilder in order.
+  void takeFunctions(InstBuilder *builder);
+
   const SpirvCodeGenOptions &spirvOptions;
 
   Header header; ///< SPIR-V module header.
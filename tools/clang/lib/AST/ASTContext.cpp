@@ -8497,8 +8497,15 @@ bool ASTContext::DeclMustBeEmitted(const Decl *D) {
       return false;
     // HLSL Change Starts
     // Don't just return true because of visibility, unless building a library
+    if (getLangOpts().IsHLSLLibrary) {
+      // Functions that will become internal are emitted only when reached
+      // from an exported function or a shader.
+      return !getLangOpts().HLSLDefaultLinkageInternal ||
+             FD->hasAttr<HLSLExportAttr>() || FD->hasAttr<HLSLShaderAttr>() ||
+             IsPatchConstantFunctionDecl(FD);
+    }
     return FD->getName() == getLangOpts().HLSLEntryFunction ||
-           IsPatchConstantFunctionDecl(FD) || getLangOpts().IsHLSLLibrary;
+           IsPatchConstantFunctionDecl(FD);
     // HLSL Change Ends
   }
   
@@ -82,6 +82,7 @@ private:
     if (!CodeGenPasses) {
       CodeGenPasses = new legacy::PassManager();
       CodeGenPasses->TrackPassOS = &CodeGenPassesConfigOS;
+      CodeGenPasses->PassOptionOverrides = CodeGenOpts.HLSLPassOptions; // HLSL Change
       CodeGenPasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -92,6 +93,7 @@ private:
     if (!PerModulePasses) {
       PerModulePasses = new legacy::PassManager();
       PerModulePasses->TrackPassOS = &PerModulePassesConfigOS;
+      PerModulePasses->PassOptionOverrides = CodeGenOpts.HLSLPassOptions; // HLSL Change
       PerModulePasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -102,6 +104,7 @@ private:
     if (!PerFunctionPasses) {
       PerFunctionPasses = new legacy::FunctionPassManager(TheModule);
       PerFunctionPasses->TrackPassOS = &PerFunctionPassesConfigOS;
+      PerFunctionPasses->PassOptionOverrides = CodeGenOpts.HLSLPassOptions; // HLSL Change
       PerFunctionPasses->add(
           createTargetTransformInfoWrapperPass(getTargetIRAnalysis()));
     }
@@ -325,6 +328,26 @@ void EmitAssemblyHelper::CreatePasses() {
   PMBuilder.HLSLHighLevel = CodeGenOpts.HLSLHighLevel; // HLSL Change
   PMBuilder.HLSLExtensionsCodeGen = CodeGenOpts.HLSLExtensionsCodegen.get(); // HLSL Change
   PMBuilder.HLSLResMayAlias = CodeGenOpts.HLSLResMayAlias; // HLSL Change
+  PMBuilder.HLSLFastIteration = CodeGenOpts.HLSLFastIteration; // HLSL Change
+  PMBuilder.HLSLInferNonUniformIndex = CodeGenOpts.HLSLInferNonUniformIndex; // HLSL Change
+  PMBuilder.HLSLFastTrig = CodeGenOpts.HLSLFastTrig; // HLSL Change
+  PMBuilder.HLSLDemoteOutputPrecision = CodeGenOpts.HLSLDemoteOutputPrecision; // HLSL Change
+  PMBuilder.HLSLAutoControlFlowHints = CodeGenOpts.HLSLAutoControlFlowHints; // HLSL Change
+  PMBuilder.HLSLGroupSharedBankConflicts = CodeGenOpts.HLSLGroupSharedBankConflicts; // HLSL Change
+  PMBuilder.HLSLPadGroupShared = CodeGenOpts.HLSLPadGroupShared; // HLSL Change
+  PMBuilder.HLSLInferEarlyDepthStencil = CodeGenOpts.HLSLInferEarlyDepthStencil; // HLSL Change
+  PMBuilder.HLSLWarnEarlyDepthStencil = CodeGenOpts.HLSLWarnEarlyDepthStencil; // HLSL Change
+  PMBuilder.HLSLRecommendRootConstants = CodeGenOpts.HLSLRecommendRootConstants; // HLSL Change
+  PMBuilder.HLSLMergeIdenticalFunctions = CodeGenOpts.HLSLMergeIdenticalFunctions; // HLSL Change
+  PMBuilder.HLSLPositionOnly = CodeGenOpts.HLSLPositionOnly; // HLSL Change
+  PMBuilder.HLSLEliminateRedundantBarriers = CodeGenOpts.HLSLEliminateRedundantBarriers; // HLSL Change
+  PMBuilder.HLSLWaveAggregateAtomics = CodeGenOpts.HLSLWaveAggregateAtomics; // HLSL Change
+  PMBuilder.HLSLPair16BitOps = CodeGenOpts.HLSLPair16BitOps; // HLSL Change
+  PMBuilder.HLSLClusterFetches = CodeGenOpts.HLSLClusterFetches; // HLSL Change
+  PMBuilder.HLSLStrengthReduceBufferIndices = CodeGenOpts.HLSLStrengthReduceBufferIndices; // HLSL Change
+  PMBuilder.HLSLUnswitchUniformLoops = CodeGenOpts.HLSLUnswitchUniformLoops; // HLSL Change
+  PMBuilder.HLSLGatherTexelLoads = CodeGenOpts.HLSLGatherTexelLoads; // HLSL Change
+  PMBuilder.HLSLProfileUse = !CodeGenOpts.SampleProfileFile.empty(); // HLSL Change
 
   PMBuilder.DisableUnitAtATime = !CodeGenOpts.UnitAtATime;
   PMBuilder.DisableUnrollLoops = !CodeGenOpts.UnrollLoops;
@@ -1009,6 +1009,11 @@ CodeGenFunction::tryEmitAsConstant(DeclRefExpr *refExpr) {
     CEK = CEK_None;
   } else if (auto *var = dyn_cast<VarDecl>(value)) {
     CEK = checkVarTypeForConstantEmission(var->getType());
+    // HLSL Change Begin - keep static consts bound late as loads.
+    if (getLangOpts().HLSL &&
+        CGM.getHLSLRuntime().ReferencesLateBindConst(refExpr))
+      CEK = CEK_None;
+    // HLSL Change End
   } else if (isa<EnumConstantDecl>(value)) {
     CEK = CEK_AsValueOnly;
   } else {
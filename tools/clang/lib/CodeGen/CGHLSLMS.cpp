@@ -26,6 +26,7 @@
 #include "clang/Frontend/CodeGenOptions.h"
 #include "clang/Lex/HLSLMacroExpander.h"
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/StringSwitch.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/StringSet.h"
@@ -163,6 +164,13 @@ private:
 
   DxilRootSignatureVersion  rootSigVer;
 
+  // Names of the static consts bound late, and those found so far.
+  StringSet<> m_LateBindConstNames;
+  SetVector<const VarDecl *> m_LateBindConsts;
+  bool IsLateBindConst(const VarDecl *VD);
+  bool ReferencesLateBindConst(const Stmt *S, unsigned Depth);
+  void AddLateBindConsts();
+
   Value *EmitHLSLMatrixLoad(CGBuilderTy &Builder, Value *Ptr, QualType Ty);
   void EmitHLSLMatrixStore(CGBuilderTy &Builder, Value *Val, Value *DestPtr,
                            QualType Ty);
@@ -231,12 +239,17 @@ private:
                                      DxilTypeSystem &dxilTypeSys);
   unsigned AddTypeAnnotation(QualType Ty, DxilTypeSystem &dxilTypeSys,
                              unsigned &arrayEltSize);
+  unsigned AddTypeAnnotationUncached(QualType Ty, DxilTypeSystem &dxilTypeSys,
+                                     unsigned &arrayEltSize);
   MDNode *GetOrAddResTypeMD(QualType resTy);
   void ConstructFieldAttributedAnnotation(DxilFieldAnnotation &fieldAnnotation,
                                           QualType fieldTy,
                                           bool bDefaultRowMajor);
 
   std::unordered_map<Constant*, DxilFieldAnnotation> m_ConstVarAnnotationMap;
+  // Cbuffer size and innermost array element size of each type already
+  // annotated, by type with its sugar, which holds the matrix orientation.
+  llvm::DenseMap<void *, std::pair<unsigned, unsigned>> m_TypeAnnotationSizeMap;
 
 public:
   CGMSHLSLRuntime(CodeGenModule &CGM);
@@ -313,6 +326,8 @@ public:
   
   void FinishAutoVar(CodeGenFunction &CGF, const VarDecl &D, llvm::Value *V) override;
 
+  bool ReferencesLateBindConst(const Stmt *S) override;
+
   /// Get or add constant to the program
   HLCBuffer &GetOrCreateCBuffer(HLSLBufferDecl *D);
 };
@@ -404,7 +419,7 @@ CGMSHLSLRuntime::CGMSHLSLRuntime(CodeGenModule &CGM)
 
   m_pHLModule->SetValidatorVersion(CGM.getCodeGenOpts().HLSLValidatorMajorVer, CGM.getCodeGenOpts().HLSLValidatorMinorVer);
 
-  m_bDebugInfo = CGM.getCodeGenOpts().getDebugInfo() == CodeGenOptions::FullDebugInfo;
+  m_bDebugInfo = CGM.getCodeGenOpts().getDebugInfo() != CodeGenOptions::NoDebugInfo;
 
   // set profile
   m_pHLModule->SetShaderModel(SM);
@@ -451,6 +466,9 @@ CGMSHLSLRuntime::CGMSHLSLRuntime(CodeGenModule &CGM)
     unsigned DiagID = Diags.getCustomDiagID(DiagnosticsEngine::Error, "Error parsing -exports options: %0");
     Diags.Report(DiagID) << os.str();
   }
+
+  for (const std::string &Name : CGM.getCodeGenOpts().HLSLLateBindConsts)
+    m_LateBindConstNames.insert(Name);
 }
 
 
@@ -972,6 +990,26 @@ static bool IsElementInputOutputType(QualType Ty) {
 unsigned CGMSHLSLRuntime::AddTypeAnnotation(QualType Ty,
                                             DxilTypeSystem &dxilTypeSys,
                                             unsigned &arrayEltSize) {
+  // The layout of a type is the same for every use, and its annotations are
+  // added on the first one, so later uses only need the sizes.
+  auto it = m_TypeAnnotationSizeMap.find(Ty.getAsOpaquePtr());
+  if (it == m_TypeAnnotationSizeMap.end()) {
+    unsigned eltSize = 0;
+    unsigned size = AddTypeAnnotationUncached(Ty, dxilTypeSys, eltSize);
+    it = m_TypeAnnotationSizeMap
+             .insert(std::make_pair(Ty.getAsOpaquePtr(),
+                                    std::make_pair(size, eltSize)))
+             .first;
+  }
+  // Only set arrayEltSize once.
+  if (arrayEltSize == 0)
+    arrayEltSize = it->second.second;
+  return it->second.first;
+}
+
+unsigned CGMSHLSLRuntime::AddTypeAnnotationUncached(QualType Ty,
+                                                    DxilTypeSystem &dxilTypeSys,
+                                                    unsigned &arrayEltSize) {
   QualType paramTy = Ty.getCanonicalType();
   if (const ReferenceType *RefType = dyn_cast<ReferenceType>(paramTy))
     paramTy = RefType->getPointeeType();
@@ -2067,6 +2105,63 @@ void CGMSHLSLRuntime::FinishAutoVar(CodeGenFunction &CGF, const VarDecl &D, llvm
   AddTypeAnnotation(D.getType(), typeSys, arrayEltSize);
 }
 
+// A static const bound late stays a constant global variable with its
+// source value as initializer, read with loads, so that hl-bind-constants
+// can give it another value before the module is optimized. Only global
+// static consts of scalar type qualify.
+bool CGMSHLSLRuntime::IsLateBindConst(const VarDecl *VD) {
+  if (!VD->isFileVarDecl() || VD->getStorageClass() != SC_Static ||
+      !VD->getType().isConstQualified() || !VD->hasInit())
+    return false;
+  QualType Ty = VD->getType().getCanonicalType();
+  if (!Ty->isBuiltinType() && !Ty->isEnumeralType())
+    return false;
+  if (!m_LateBindConstNames.count(VD->getQualifiedNameAsString()))
+    return false;
+  m_LateBindConsts.insert(VD);
+  return true;
+}
+
+bool CGMSHLSLRuntime::ReferencesLateBindConst(const Stmt *S, unsigned Depth) {
+  if (!S)
+    return false;
+  if (const DeclRefExpr *DRE = dyn_cast<DeclRefExpr>(S)) {
+    const VarDecl *VD = dyn_cast<VarDecl>(DRE->getDecl());
+    if (!VD)
+      return false;
+    if (IsLateBindConst(VD))
+      return true;
+    // A const initialized from one is folded just the same.
+    const int kMaxDepth = 8;
+    if (VD->getType().isConstQualified() && Depth < kMaxDepth)
+      return ReferencesLateBindConst(VD->getInit(), Depth + 1);
+    return false;
+  }
+  for (const Stmt *Child : S->children()) {
+    if (ReferencesLateBindConst(Child, Depth))
+      return true;
+  }
+  return false;
+}
+
+bool CGMSHLSLRuntime::ReferencesLateBindConst(const Stmt *S) {
+  if (m_LateBindConstNames.empty())
+    return false;
+  return ReferencesLateBindConst(S, 0);
+}
+
+// Records the static consts bound late that were emitted, by name, for
+// hl-bind-constants.
+void CGMSHLSLRuntime::AddLateBindConsts() {
+  for (const VarDecl *VD : m_LateBindConsts) {
+    GlobalVariable *GV =
+        TheModule.getNamedGlobal(CGM.getMangledName(GlobalDecl(VD)));
+    if (GV)
+      HLModule::AddLateBindConst(TheModule, VD->getQualifiedNameAsString(),
+                                 GV);
+  }
+}
+
 hlsl::InterpolationMode CGMSHLSLRuntime::GetInterpMode(const Decl *decl,
                                                        CompType compType,
                                                        bool bKeepUndefined) {
@@ -3035,7 +3130,63 @@ static unsigned AlignCBufferOffset(unsigned offset, unsigned size, llvm::Type *T
   return AlignBufferOffsetInLegacy(offset, size, scalarSizeInBytes, bNeedNewRow);
 }
 
-static unsigned AllocateDxilConstantBuffer(HLCBuffer &CB) {
+// Orders the constants that have no user offset so that allocating them in
+// order, starting at offset, packs them into as few rows as the legacy rules
+// allow. Each step takes the largest constant that fits the rest of the row
+// with the least padding. With bUsedFirst, constants the code uses all go
+// before unused ones, so the loads touch as few rows as possible.
+static void ReorderDxilConstants(HLCBuffer &CB, unsigned offset,
+                                 bool bUsedFirst) {
+  std::vector<std::unique_ptr<DxilResourceBase>> &Constants =
+      CB.GetConstants();
+  std::vector<std::unique_ptr<DxilResourceBase>> Pending;
+  std::vector<std::unique_ptr<DxilResourceBase>> Sorted;
+  for (std::unique_ptr<DxilResourceBase> &C : Constants) {
+    if (C->GetLowerBound() == UINT_MAX)
+      Pending.emplace_back(std::move(C));
+    else
+      Sorted.emplace_back(std::move(C));
+  }
+
+  auto IsUsed = [bUsedFirst](const std::unique_ptr<DxilResourceBase> &C) {
+    return bUsedFirst && !C->GetGlobalSymbol()->use_empty();
+  };
+  std::stable_sort(Pending.begin(), Pending.end(),
+                   [&IsUsed](const std::unique_ptr<DxilResourceBase> &A,
+                             const std::unique_ptr<DxilResourceBase> &B) {
+                     if (IsUsed(A) != IsUsed(B))
+                       return IsUsed(A);
+                     return A->GetRangeSize() > B->GetRangeSize();
+                   });
+
+  while (!Pending.empty()) {
+    bool bUsed = IsUsed(Pending.front());
+    unsigned bestIdx = 0;
+    unsigned bestPadding = UINT_MAX;
+    for (unsigned i = 0; i < Pending.size() && bestPadding != 0; ++i) {
+      DxilResourceBase &C = *Pending[i];
+      if (IsUsed(Pending[i]) != bUsed)
+        break;
+      llvm::Type *Ty = C.GetGlobalSymbol()->getType()->getPointerElementType();
+      unsigned padding =
+          AlignCBufferOffset(offset, C.GetRangeSize(), Ty) - offset;
+      if (padding < bestPadding) {
+        bestIdx = i;
+        bestPadding = padding;
+      }
+    }
+    DxilResourceBase &C = *Pending[bestIdx];
+    llvm::Type *Ty = C.GetGlobalSymbol()->getType()->getPointerElementType();
+    offset = AlignCBufferOffset(offset, C.GetRangeSize(), Ty) +
+             C.GetRangeSize();
+    Sorted.emplace_back(std::move(Pending[bestIdx]));
+    Pending.erase(Pending.begin() + bestIdx);
+  }
+  Constants = std::move(Sorted);
+}
+
+static unsigned AllocateDxilConstantBuffer(HLCBuffer &CB, bool bReorder,
+                                           bool bUsedFirst) {
   unsigned offset = 0;
 
   // Scan user allocated constants first.
@@ -3049,6 +3200,11 @@ static unsigned AllocateDxilConstantBuffer(HLCBuffer &CB) {
       offset = nextOffset;
   }
 
+  // A ConstantBuffer array has a single constant, so only cbuffers reorder.
+  bReorder &= CB.GetRangeSize() == 1 && CB.GetConstants().size() > 1;
+  if (bReorder)
+    ReorderDxilConstants(CB, offset, bUsedFirst);
+
   // Alloc after user allocated constants.
   for (const std::unique_ptr<DxilResourceBase> &C : CB.GetConstants()) {
     if (C->GetLowerBound() != UINT_MAX)
@@ -3063,13 +3219,28 @@ static unsigned AllocateDxilConstantBuffer(HLCBuffer &CB) {
     }
     offset += size;
   }
+
+  if (bReorder) {
+    // Number the constants in offset order, which becomes the order of the
+    // fields of the cbuffer struct, as reflection expects.
+    std::vector<std::unique_ptr<DxilResourceBase>> &Constants =
+        CB.GetConstants();
+    std::stable_sort(Constants.begin(), Constants.end(),
+                     [](const std::unique_ptr<DxilResourceBase> &A,
+                        const std::unique_ptr<DxilResourceBase> &B) {
+                       return A->GetLowerBound() < B->GetLowerBound();
+                     });
+    for (unsigned i = 0; i < Constants.size(); i++)
+      Constants[i]->SetID(i);
+  }
   return offset;
 }
 
-static void AllocateDxilConstantBuffers(HLModule *pHLModule) {
+static void AllocateDxilConstantBuffers(HLModule *pHLModule, bool bReorder,
+                                        bool bUsedFirst) {
   for (unsigned i = 0; i < pHLModule->GetCBuffers().size(); i++) {
     HLCBuffer &CB = *static_cast<HLCBuffer*>(&(pHLModule->GetCBuffer(i)));
-    unsigned size = AllocateDxilConstantBuffer(CB);
+    unsigned size = AllocateDxilConstantBuffer(CB, bReorder, bUsedFirst);
     CB.SetSize(size);
   }
 }
@@ -4776,6 +4947,40 @@ static void CreateWriteEnabledStaticGlobals(llvm::Module *M,
 }
 
 
+// Returns true if a library helper is worth keeping as a function of its
+// own: it has at least MinSize instructions, is called from more than one
+// place, and its signature is one the DXIL library rules allow, with no
+// resources and no pointers outside the default address space.
+static bool ShouldKeepLibHelper(Function &F, unsigned MinSize) {
+  if (F.isDeclaration() || GetHLOpcodeGroup(&F) != HLOpcodeGroup::NotHL)
+    return false;
+  unsigned NumCalls = 0;
+  for (User *U : F.users()) {
+    if (!isa<CallInst>(U))
+      return false;
+    ++NumCalls;
+  }
+  if (NumCalls < 2)
+    return false;
+
+  if (dxilutil::ContainsHLSLObjectType(F.getReturnType()))
+    return false;
+  for (Argument &Arg : F.args()) {
+    llvm::Type *Ty = Arg.getType();
+    if (dxilutil::ContainsHLSLObjectType(Ty))
+      return false;
+    if (Ty->isPointerTy() && Ty->getPointerAddressSpace() != 0)
+      return false;
+  }
+
+  unsigned Size = 0;
+  for (BasicBlock &BB : F) {
+    Size += BB.size();
+    if (Size >= MinSize)
+      return true;
+  }
+  return false;
+}
 
 void CGMSHLSLRuntime::FinishCodeGen() {
   // Library don't have entry.
@@ -4817,6 +5022,8 @@ void CGMSHLSLRuntime::FinishCodeGen() {
   ReplaceConstStaticGlobals(staticConstGlobalInitListMap,
                             staticConstGlobalCtorMap);
 
+  AddLateBindConsts();
+
   // Create copy for clip plane.
   for (Function *F : clipPlaneFuncList) {
     DxilFunctionProps &props = m_pHLModule->GetDxilFunctionProps(F);
@@ -4842,7 +5049,11 @@ void CGMSHLSLRuntime::FinishCodeGen() {
   }
 
   // Allocate constant buffers.
-  AllocateDxilConstantBuffers(m_pHLModule);
+  // Libraries don't order by use, so that every library that declares a
+  // cbuffer lays it out the same way and they still link.
+  AllocateDxilConstantBuffers(m_pHLModule,
+                              CGM.getCodeGenOpts().HLSLReorderCBuffers,
+                              /*bUsedFirst*/ !m_bIsLib);
   // TODO: create temp variable for constant which has store use.
 
   // Create Global variable and type annotation for each CBuffer.
@@ -4867,6 +5078,11 @@ void CGMSHLSLRuntime::FinishCodeGen() {
     }
   }
 
+  // Shaders in libraries can't be called, so only helpers are kept.
+  unsigned libNoInlineSize = CGM.getCodeGenOpts().HLSLLibNoInlineSize;
+  if (!m_bIsLib || !m_pHLModule->GetShaderModel()->IsSM63Plus())
+    libNoInlineSize = 0;
+
   // Pin entry point and constant buffers, mark everything else internal.
   for (Function &f : m_pHLModule->GetModule()->functions()) {
     if (!m_bIsLib) {
@@ -4892,6 +5108,11 @@ void CGMSHLSLRuntime::FinishCodeGen() {
     // Skip no inline functions.
     if (f.hasFnAttribute(llvm::Attribute::NoInline))
       continue;
+    if (libNoInlineSize && !m_pHLModule->HasDxilFunctionProps(&f) &&
+        ShouldKeepLibHelper(f, libNoInlineSize)) {
+      f.addFnAttr(llvm::Attribute::NoInline);
+      continue;
+    }
     // Always inline for used functions.
     if (!f.user_empty() && !f.isDeclaration())
       f.addFnAttr(llvm::Attribute::AlwaysInline);
@@ -122,6 +122,11 @@ public:
   virtual void AddControlFlowHint(CodeGenFunction &CGF, const Stmt &S, llvm::TerminatorInst *TI, llvm::ArrayRef<const Attr *> Attrs) = 0;
 
   virtual void FinishAutoVar(CodeGenFunction &CGF, const VarDecl &D, llvm::Value *V) = 0;
+
+  // Returns true if S reads a static const bound late (-late-bind-const),
+  // directly or through the initializer of another const, so it must not
+  // be folded to a constant.
+  virtual bool ReferencesLateBindConst(const Stmt *S) = 0;
 };
 
 /// Create an instance of a HLSL runtime class.
@@ -32,6 +32,7 @@
 #include "llvm/Linker/Linker.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/Timer.h"
 #include <memory>
@@ -48,6 +49,13 @@ namespace clang {
     const LangOptions &LangOpts;
     raw_pwrite_stream *AsmOutStream;
     ASTContext *Context;
+    // HLSL Change Starts - optimization runs after the AST is freed, so
+    // diagnostics find the source manager on their own, and the target
+    // description is kept for it.
+    SourceManager *SourceMgr;
+    bool BackendPending;
+    std::string TargetDescription;
+    // HLSL Change Ends
 
     Timer LLVMIRGeneration;
 
@@ -67,7 +75,8 @@ namespace clang {
                     CoverageSourceInfo *CoverageInfo = nullptr)
         : Diags(Diags), Action(Action), CodeGenOpts(CodeGenOpts),
           TargetOpts(TargetOpts), LangOpts(LangOpts), AsmOutStream(OS),
-          Context(nullptr), LLVMIRGeneration("LLVM IR Generation Time"),
+          Context(nullptr), SourceMgr(nullptr), BackendPending(false), // HLSL Change
+          LLVMIRGeneration("LLVM IR Generation Time"),
           Gen(CreateLLVMCodeGen(Diags, InFile, HeaderSearchOpts, PPOpts,
                                 CodeGenOpts, C, CoverageInfo)),
           LinkModule(LinkModule) {
@@ -85,6 +94,24 @@ namespace clang {
     std::unique_ptr<llvm::Module> takeModule() { return std::move(TheModule); }
     llvm::Module *takeLinkModule() { return LinkModule.release(); }
 
+    // HLSL Change Starts
+    /// Whether HandleTranslationUnit left optimization to
+    /// EmitPendingBackendOutput.
+    bool isBackendPending() const { return BackendPending; }
+
+    /// Frees the code generator, which references the AST, once the module
+    /// is complete.
+    void releaseFrontend() {
+      Gen.reset();
+      Context = nullptr;
+    }
+
+    void EmitPendingBackendOutput() {
+      BackendPending = false;
+      EmitBackendOutputWithHandlers(TargetDescription);
+    }
+    // HLSL Change Ends
+
     void HandleCXXStaticMemberVarInstantiation(VarDecl *VD) override {
       Gen->HandleCXXStaticMemberVarInstantiation(VD);
     }
@@ -96,6 +123,7 @@ namespace clang {
       }
         
       Context = &Ctx;
+      SourceMgr = &Ctx.getSourceManager(); // HLSL Change
 
       if (llvm::TimePassesIsEnabled)
         LLVMIRGeneration.startTimer();
@@ -143,6 +171,7 @@ namespace clang {
         if (llvm::TimePassesIsEnabled)
           LLVMIRGeneration.startTimer();
 
+        llvm::PhaseTimingRegion CodeGenPhase("codegen"); // HLSL Change
         Gen->HandleTranslationUnit(C);
 
         if (llvm::TimePassesIsEnabled)
@@ -174,6 +203,19 @@ namespace clang {
           return;
       }
 
+      // HLSL Change Starts - optimize once the AST, Sema and codegen state are
+      // freed, which CodeGenAction::ExecuteAction does after the parse.
+      if (LangOpts.HLSL) {
+        TargetDescription = C.getTargetInfo().getTargetDescription();
+        BackendPending = true;
+        return;
+      }
+      // HLSL Change Ends
+
+      EmitBackendOutputWithHandlers(C.getTargetInfo().getTargetDescription());
+    }
+
+    void EmitBackendOutputWithHandlers(StringRef TDesc) {
       // Install an inline asm handler so that diagnostics get printed through
       // our diagnostics hooks.
       LLVMContext &Ctx = TheModule->getContext();
@@ -187,9 +229,12 @@ namespace clang {
       void *OldDiagnosticContext = Ctx.getDiagnosticContext();
       Ctx.setDiagnosticHandler(DiagnosticHandler, this);
 
-      EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
-                        C.getTargetInfo().getTargetDescription(),
-                        TheModule.get(), Action, AsmOutStream);
+      {
+        llvm::PhaseTimingRegion OptimizePhase("optimize"); // HLSL Change
+        EmitBackendOutput(Diags, CodeGenOpts, TargetOpts, LangOpts,
+                          TDesc,
+                          TheModule.get(), Action, AsmOutStream);
+      }
 
       Ctx.setInlineAsmDiagnosticHandler(OldHandler, OldContext);
 
@@ -317,7 +362,7 @@ void BackendConsumer::InlineAsmDiagHandler2(const llvm::SMDiagnostic &D,
   // If the SMDiagnostic has an inline asm source location, translate it.
   FullSourceLoc Loc;
   if (D.getLoc() != SMLoc())
-    Loc = ConvertBackendLocation(D, Context->getSourceManager());
+    Loc = ConvertBackendLocation(D, *SourceMgr); // HLSL Change
 
   unsigned DiagID;
   switch (D.getKind()) {
@@ -425,6 +470,8 @@ BackendConsumer::StackSizeDiagHandler(const llvm::DiagnosticInfoStackSize &D) {
     // We do not know how to format other severities.
     return false;
 
+  if (!Gen) // HLSL Change - freed with the AST
+    return false;
   if (const Decl *ND = Gen->GetDeclForMangledName(D.getFunction().getName())) {
     Diags.Report(ND->getASTContext().getFullLoc(ND->getLocation()),
                  diag::warn_fe_frame_larger_than)
@@ -441,7 +488,7 @@ void BackendConsumer::EmitOptimizationMessage(
   assert(D.getSeverity() == llvm::DS_Remark ||
          D.getSeverity() == llvm::DS_Warning);
 
-  SourceManager &SourceMgr = Context->getSourceManager();
+  SourceManager &SourceMgr = *this->SourceMgr; // HLSL Change
   FileManager &FileMgr = SourceMgr.getFileManager();
   StringRef Filename;
   unsigned Line, Column;
@@ -461,7 +508,7 @@ void BackendConsumer::EmitOptimizationMessage(
   // function definition. We use the definition's right brace to differentiate
   // from diagnostics that genuinely relate to the function itself.
   FullSourceLoc Loc(DILoc, SourceMgr);
-  if (Loc.isInvalid())
+  if (Loc.isInvalid() && Gen) // HLSL Change - Gen is freed with the AST
     if (const Decl *FD = Gen->GetDeclForMangledName(D.getFunction().getName()))
       Loc = FD->getASTContext().getFullLoc(FD->getBodyRBrace());
 
@@ -588,7 +635,7 @@ void BackendConsumer::DiagnosticHandlerImpl(const DiagnosticInfo &DI) {
 CodeGenAction::CodeGenAction(unsigned _Act, LLVMContext *_VMContext)
   : Act(_Act), LinkModule(nullptr),
     VMContext(_VMContext ? _VMContext : new LLVMContext),
-    OwnsVMContext(!_VMContext) {}
+    OwnsVMContext(!_VMContext), BEConsumer(nullptr) {} // HLSL Change
 
 CodeGenAction::~CodeGenAction() {
   TheModule.reset();
@@ -752,6 +799,21 @@ void CodeGenAction::ExecuteAction() {
 
   // Otherwise follow the normal AST path.
   this->ASTFrontendAction::ExecuteAction();
+
+  // HLSL Change Starts - the module no longer needs the front-end, so free
+  // the AST, Sema and the code generator before optimizing, when the module
+  // grows largest. The source manager stays for diagnostics locations.
+  if (BEConsumer && BEConsumer->isBackendPending()) {
+    CompilerInstance &CI = getCompilerInstance();
+    if (!CI.getFrontendOpts().DisableFree &&
+        !CI.getCodeGenOpts().DisableFree) {
+      BEConsumer->releaseFrontend();
+      CI.setSema(nullptr);
+      CI.setASTContext(nullptr);
+    }
+    BEConsumer->EmitPendingBackendOutput();
+  }
+  // HLSL Change Ends
 }
 
 //
@@ -1045,6 +1045,12 @@ ConstantFoldsToSimpleInteger(const Expr *Cond, llvm::APSInt &ResultInt) {
   if (!Cond->EvaluateAsInt(Int, getContext()))
     return false;  // Not foldable, not integer or not fully evaluatable.
 
+  // HLSL Change Begin - static consts bound late are not known yet.
+  if (getLangOpts().HLSL &&
+      CGM.getHLSLRuntime().ReferencesLateBindConst(Cond))
+    return false;
+  // HLSL Change End
+
   if (CodeGenFunction::ContainsLabel(Cond))
     return false;  // Contains a label.
 
@@ -43,6 +43,7 @@
 #include "clang/Frontend/CodeGenOptions.h"
 #include "clang/Sema/SemaDiagnostic.h"
 #include "llvm/ADT/APSInt.h"
+#include "llvm/ADT/StringExtras.h" // HLSL Change
 #include "llvm/ADT/Triple.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/CallingConv.h"
@@ -1317,6 +1318,22 @@ bool CodeGenModule::MustBeEmitted(const ValueDecl *Global) {
   return getContext().DeclMustBeEmitted(Global);
 }
 
+// HLSL Change Starts
+bool CodeGenModule::IsHLSLLibraryShardOwner(GlobalDecl GD) {
+  if (LangOpts.HLSLLibraryShardCount <= 1)
+    return true;
+  // A hull shader is finalized together with its patch constant function, so
+  // both stay in the first shard.
+  const auto *FD = cast<FunctionDecl>(GD.getDecl());
+  if (FD->hasAttr<HLSLPatchConstantFuncAttr>() ||
+      getContext().IsPatchConstantFunctionDecl(FD))
+    return LangOpts.HLSLLibraryShardIndex == 0;
+  return llvm::HashString(getMangledName(GD)) %
+             LangOpts.HLSLLibraryShardCount ==
+         LangOpts.HLSLLibraryShardIndex;
+}
+// HLSL Change Ends
+
 bool CodeGenModule::MayBeEmittedEagerly(const ValueDecl *Global) {
   if (const auto *FD = dyn_cast<FunctionDecl>(Global))
     if (FD->getTemplateSpecializationKind() == TSK_ImplicitInstantiation)
@@ -1442,6 +1459,12 @@ void CodeGenModule::EmitGlobal(GlobalDecl GD) {
       return;
   }
 
+  // HLSL Change Begin - functions another shard defines stay declarations.
+  if (isa<FunctionDecl>(Global) && MustBeEmitted(Global) &&
+      !IsHLSLLibraryShardOwner(GD))
+    return;
+  // HLSL Change End
+
   // Defer code generation to first use when possible, e.g. if this is an inline
   // function. If the global must always be emitted, do it eagerly if possible
   // to benefit from cache locality.
@@ -2093,7 +2116,12 @@ void CodeGenModule::EmitGlobalVarDefinition(const VarDecl *D) {
     Init = EmitNullConstant(D->getType());
   } else {
     initializedGlobalDecl = GlobalDecl(D);
-    Init = EmitConstantInit(*InitDecl);
+    // HLSL Change Begin - globals computed from static consts bound late
+    // are initialized when the shader starts, once those are bound.
+    bool bLateBound = getLangOpts().HLSL &&
+                      getHLSLRuntime().ReferencesLateBindConst(InitExpr);
+    Init = bLateBound ? nullptr : EmitConstantInit(*InitDecl);
+    // HLSL Change End
 
     if (!Init) {
       QualType T = InitExpr->getType();
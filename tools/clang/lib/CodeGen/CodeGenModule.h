@@ -1263,6 +1263,12 @@ private:
   /// which may later be explicitly instantiated.
   bool MayBeEmittedEagerly(const ValueDecl *D);
 
+  // HLSL Change Starts
+  /// Determine whether this shard of a sharded library defines the function;
+  /// other shards only declare it and the shards are linked afterwards.
+  bool IsHLSLLibraryShardOwner(GlobalDecl GD);
+  // HLSL Change Ends
+
   /// Check whether we can use a "simpler", more core exceptions personality
   /// function.
   void SimplifyPersonality();
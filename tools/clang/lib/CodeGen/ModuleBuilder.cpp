@@ -26,6 +26,7 @@
 #include "llvm/IR/Module.h"
 #include <memory>
 #include "dxc/DXIL/DxilMetadataHelper.h" // HLSL Change - dx source info
+#include "dxc/Support/DxcSourceStore.h" // HLSL Change - shared sources
 using namespace clang;
 
 namespace {
@@ -213,15 +214,29 @@ namespace {
         Builder->Release();
       // HLSL Change Begins
       // Error may happen in Builder->Release for HLSL
-      if (CodeGenOpts.getDebugInfo() == CodeGenOptions::DebugInfoKind::FullDebugInfo) {
+      // Line tables need the sources as much as full debug info does.
+      if (CodeGenOpts.getDebugInfo() >= CodeGenOptions::DebugInfoKind::DebugLineTablesOnly) {
         // Add all file contents in a list of filename/content pairs.
         llvm::NamedMDNode *pContents = nullptr;
         llvm::LLVMContext &LLVMCtx = M->getContext();
+        const std::string &storeDir = CodeGenOpts.HLSLSourceStoreDir;
         auto AddFile = [&](StringRef name, StringRef content) {
           if (pContents == nullptr) {
             pContents = M->getOrInsertNamedMetadata(
               hlsl::DxilMDHelper::kDxilSourceContentsMDName);
           }
+          // With a source store, only a reference to the content is embedded.
+          std::string reference;
+          if (!storeDir.empty()) {
+            if (!hlsl::AddToSourceStore(storeDir, content)) {
+              unsigned DiagID = Diags.getCustomDiagID(
+                  DiagnosticsEngine::Error,
+                  "cannot add %0 to source store '%1'");
+              Diags.Report(DiagID) << name << storeDir;
+            }
+            reference = hlsl::GetSourceStoreReference(content);
+            content = reference;
+          }
           llvm::MDTuple *pFileInfo = llvm::MDNode::get(
             LLVMCtx,
             { llvm::MDString::get(LLVMCtx, name),
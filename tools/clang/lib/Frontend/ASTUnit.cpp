@@ -230,6 +230,7 @@ ASTUnit::ASTUnit(bool _MainFileIsAST)
     NumWarningsInPreamble(0),
     ShouldCacheCodeCompletionResults(false),
     IncludeBriefCommentsInCodeCompletion(false), UserFilesAreVolatile(false),
+    SkipPreambleFunctionBodies(false), // HLSL Change
     CompletionCacheTopLevelHashValue(0),
     PreambleTopLevelHashValue(0),
     CurrentTopLevelHashValue(0),
@@ -903,6 +904,16 @@ public:
   ASTDeserializationListener *GetASTDeserializationListener() override {
     return nullptr; // return Unit.getDeserializationListener(); // HLSL Change - no support for serialization
   }
+
+  // HLSL Change Starts - parse the bodies of the main file only when
+  // standing in for the precompiled preamble.
+  bool shouldSkipFunctionBody(Decl *D) override {
+    if (!Unit.getSkipPreambleFunctionBodies())
+      return true;
+    const SourceManager &SM = Unit.getSourceManager();
+    return !SM.isInMainFile(SM.getExpansionLoc(D->getLocation()));
+  }
+  // HLSL Change Ends
 };
 
 class TopLevelDeclTrackerAction : public ASTFrontendAction {
@@ -2054,6 +2065,12 @@ ASTUnit *ASTUnit::LoadFromCommandLine(
   AST.reset(new ASTUnit(false));
   // HLSL Change Starts
   AST->HlslLangExtensions = HlslLangExtensions;
+  // Without PCH support, a preamble is approximated by parsing the included
+  // files for their declarations only, on the first parse and each reparse.
+  if (PrecompilePreamble && !SkipFunctionBodies) {
+    CI->getFrontendOpts().SkipFunctionBodies = true;
+    AST->SkipPreambleFunctionBodies = true;
+  }
   // Enable -verify and -verify-ignore-unexpected on the libclang initialization path.
   bool VerifyDiagnostics = CI->getDiagnosticOpts().VerifyDiagnostics;
   Diags->getDiagnosticOptions().setVerifyIgnoreUnexpected(
@@ -26,6 +26,19 @@
 #include "llvm/Support/ConvertUTF.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include <cstring>
+// HLSL Change Begin - MSVC doesn't define __SSE2__, but it targets SSE2 on x64
+// and with /arch:SSE2.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LEXER_SSE2 1
+#endif
+// HLSL Change End
+#ifdef LEXER_SSE2 // HLSL Change
+#include <emmintrin.h>
+#elif __ALTIVEC__
+#include <altivec.h>
+#undef bool
+#endif
 using namespace clang;
 
 //===----------------------------------------------------------------------===//
@@ -1553,6 +1566,77 @@ bool Lexer::isHexaLiteral(const char *Start, const LangOptions &LangOpts) {
   return (C2 == 'x' || C2 == 'X');
 }
 
+// HLSL Change Begin - Generated sources, such as baked lookup tables, have
+// long runs of whitespace, line comments and digits; scan those 16 characters
+// at a time. Each scan stops at the first character outside its set, at the
+// latest at the nul that ends the buffer.
+
+/// Returns the first character at or after Ptr that isn't horizontal
+/// whitespace.
+static const char *SkipHorizontalWhitespace(const char *Ptr,
+                                            const char *BufferEnd) {
+#ifdef LEXER_SSE2
+  // Most runs are a single space.
+  if (!isHorizontalWhitespace(*Ptr))
+    return Ptr;
+  while (Ptr + 16 <= BufferEnd) {
+    __m128i Chars = _mm_loadu_si128((const __m128i *)Ptr);
+    __m128i Spaces = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(Chars, _mm_set1_epi8(' ')),
+                     _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(Chars, _mm_set1_epi8('\f')),
+                     _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\v'))));
+    unsigned Mask = ~_mm_movemask_epi8(Spaces) & 0xFFFF;
+    if (Mask != 0)
+      return Ptr + llvm::countTrailingZeros(Mask);
+    Ptr += 16;
+  }
+#endif
+  while (isHorizontalWhitespace(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+
+/// Returns the first newline or nul at or after Ptr.
+static const char *FindLineEnd(const char *Ptr, const char *BufferEnd) {
+#ifdef LEXER_SSE2
+  while (Ptr + 16 <= BufferEnd) {
+    __m128i Chars = _mm_loadu_si128((const __m128i *)Ptr);
+    __m128i Ends = _mm_or_si128(
+        _mm_cmpeq_epi8(Chars, _mm_setzero_si128()),
+        _mm_or_si128(_mm_cmpeq_epi8(Chars, _mm_set1_epi8('\n')),
+                     _mm_cmpeq_epi8(Chars, _mm_set1_epi8('\r'))));
+    unsigned Mask = _mm_movemask_epi8(Ends);
+    if (Mask != 0)
+      return Ptr + llvm::countTrailingZeros(Mask);
+    Ptr += 16;
+  }
+#endif
+  while (*Ptr != 0 && *Ptr != '\n' && *Ptr != '\r')
+    ++Ptr;
+  return Ptr;
+}
+
+/// Returns the first character at or after Ptr that isn't a decimal digit.
+static const char *SkipDigits(const char *Ptr, const char *BufferEnd) {
+#ifdef LEXER_SSE2
+  while (Ptr + 16 <= BufferEnd) {
+    // Characters past 0x7f compare as negative, so below '0'.
+    __m128i Chars = _mm_loadu_si128((const __m128i *)Ptr);
+    __m128i Others = _mm_or_si128(_mm_cmplt_epi8(Chars, _mm_set1_epi8('0')),
+                                  _mm_cmpgt_epi8(Chars, _mm_set1_epi8('9')));
+    unsigned Mask = _mm_movemask_epi8(Others);
+    if (Mask != 0)
+      return Ptr + llvm::countTrailingZeros(Mask);
+    Ptr += 16;
+  }
+#endif
+  while (isDigit(*Ptr))
+    ++Ptr;
+  return Ptr;
+}
+// HLSL Change End
+
 /// LexNumericConstant - Lex the remainder of a integer or floating point
 /// constant. From[-1] is the first character lexed.  Return the end of the
 /// constant.
@@ -1576,6 +1660,11 @@ bool Lexer::LexNumericConstant(Token &Result, const char *CurPtr, unsigned Perio
           break;
         }
     }
+    // Digits are always a single character, so skip the rest of a run at once.
+    if (isDigit(*CurPtr)) {
+      CurPtr = SkipDigits(CurPtr, BufferEnd);
+      PrevCh = CurPtr[-1];
+    }
     // HLSL Change End.
     C = getCharAndSize(CurPtr, Size);
   }
@@ -1976,8 +2065,10 @@ bool Lexer::SkipWhitespace(Token &Result, const char *CurPtr,
   // Skip consecutive spaces efficiently.
   while (1) {
     // Skip horizontal whitespace very aggressively.
-    while (isHorizontalWhitespace(Char))
-      Char = *++CurPtr;
+    // HLSL Change Begin - Skip long runs 16 characters at a time.
+    CurPtr = SkipHorizontalWhitespace(CurPtr, BufferEnd);
+    Char = *CurPtr;
+    // HLSL Change End
 
     // Otherwise if we have something other than whitespace, we're done.
     if (!isVerticalWhitespace(Char))
@@ -2050,11 +2141,12 @@ bool Lexer::SkipLineComment(Token &Result, const char *CurPtr,
   // them.  As such, optimize for this case with the inner loop.
   char C;
   do {
+    // Skip over characters in the fast loop, up to a potential EOF, or a
+    // newline or DOS-style newline.
+    // HLSL Change Begin - Skip 16 characters at a time.
+    CurPtr = FindLineEnd(CurPtr, BufferEnd);
     C = *CurPtr;
-    // Skip over characters in the fast loop.
-    while (C != 0 &&                // Potentially EOF.
-           C != '\n' && C != '\r')  // Newline or DOS-style newline.
-      C = *++CurPtr;
+    // HLSL Change End
 
     const char *NextLine = CurPtr;
     if (C != 0) {
@@ -2255,13 +2347,6 @@ static bool isEndOfBlockCommentWithEscapedNewLine(const char *CurPtr,
   return true;
 }
 
-#ifdef __SSE2__
-#include <emmintrin.h>
-#elif __ALTIVEC__
-#include <altivec.h>
-#undef bool
-#endif
-
 /// We have just read from input the / and * characters that started a comment.
 /// Read until we find the * and / characters that terminate the comment.
 /// Note that we don't bother decoding trigraphs or escaped newlines in block
@@ -2318,7 +2403,7 @@ bool Lexer::SkipBlockComment(Token &Result, const char *CurPtr,
 
       if (C == '/') goto FoundSlash;
 
-#ifdef __SSE2__
+#ifdef LEXER_SSE2 // HLSL Change
       __m128i Slashes = _mm_set1_epi8('/');
       while (CurPtr+16 <= BufferEnd) {
         int cmp = _mm_movemask_epi8(_mm_cmpeq_epi8(*(const __m128i*)CurPtr,
@@ -24,6 +24,7 @@
 #include "clang/Sema/SemaConsumer.h"
 #include "clang/Sema/SemaHLSL.h" // HLSL Change
 #include "llvm/Support/CrashRecoveryContext.h"
+#include "llvm/Support/PhaseTiming.h" // HLSL Change
 #include <cstdio>
 #include <memory>
 
@@ -132,6 +133,11 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   if (External)
     External->StartTranslationUnit(Consumer);
 
+  // HLSL Change Starts - report parsing, which includes preprocessing and
+  // Sema, as a single phase.
+  {
+  llvm::PhaseTimingRegion ParsePhase("parse");
+  // HLSL Change Ends
   if (!S.getDiagnostics().hasUnrecoverableErrorOccurred()) {  // HLSL Change: Skip if fatal error already occurred
     if (P.ParseTopLevelDecl(ADecl)) {
       if (!External && !S.getLangOpts().CPlusPlus)
@@ -156,6 +162,7 @@ void clang::ParseAST(Sema &S, bool PrintStats, bool SkipFunctionBodies) {
   // errors in the front-end, without relying on code generation being
   // available.
   hlsl::DiagnoseTranslationUnit(&S);
+  } // ParsePhase
   // HLSL Change Ends
   Consumer->HandleTranslationUnit(S.getASTContext());
 
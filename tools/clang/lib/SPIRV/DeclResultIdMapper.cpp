@@ -19,8 +19,7 @@
 #include "clang/AST/Expr.h"
 #include "clang/AST/HlslTypes.h"
 #include "clang/SPIRV/AstTypeProbe.h"
-#include "llvm/ADT/SmallBitVector.h"
-#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/StringSet.h"
 
 #include "SPIRVEmitter.h"
@@ -892,7 +891,7 @@ class LocationSet {
 public:
   /// Maximum number of indices supported
   const static uint32_t kMaxIndex = 2;
-  /// Maximum number of locations supported
+  /// Maximum number of locations supported for explicit assignment
   // Typically we won't have that many stage input or output variables.
   // Using 64 should be fine here.
   const static uint32_t kMaxLoc = 64;
@@ -907,62 +906,91 @@ public:
   /// Uses the given location.
   void useLoc(uint32_t loc, uint32_t index = 0) {
     assert(index < kMaxIndex);
-    usedLocs[index].set(loc);
+    auto &locs = usedLocs[index];
+    if (loc >= locs.size())
+      locs.resize(std::max<size_t>(loc + 1, locs.size() * 2));
+    locs.set(loc);
   }
 
-  /// Uses the next |count| available location.
+  /// Uses the first |count| consecutive available locations and returns the
+  /// first one. Locations taken by explicit assignments are skipped over.
   int useNextLocs(uint32_t count, uint32_t index = 0) {
     assert(index < kMaxIndex);
     auto &locs = usedLocs[index];
     auto &next = nextLoc[index];
-    while (locs[next])
+    while (next < locs.size() && locs[next])
       next++;
 
-    int toUse = next;
-
-    for (uint32_t i = 0; i < count; ++i) {
-      assert(!locs[next]);
-      locs.set(next++);
+    uint32_t toUse = next;
+    for (;;) {
+      if (toUse + count > locs.size())
+        locs.resize(std::max<size_t>(toUse + count, locs.size() * 2));
+      const int used =
+          toUse == 0 ? locs.find_first() : locs.find_next(toUse - 1);
+      if (used < 0 || (uint32_t)used >= toUse + count)
+        break;
+      toUse = used + 1;
     }
 
+    locs.set(toUse, toUse + count);
+    if (toUse == next)
+      next += count;
     return toUse;
   }
 
   /// Returns true if the given location number is already used.
   bool isLocUsed(uint32_t loc, uint32_t index = 0) {
     assert(index < kMaxIndex);
-    return usedLocs[index][loc];
+    return loc < usedLocs[index].size() && usedLocs[index][loc];
   }
 
 private:
-  llvm::SmallBitVector usedLocs[kMaxIndex]; ///< All previously used locations
-  uint32_t nextLoc[kMaxIndex];              ///< Next available location
+  llvm::BitVector usedLocs[kMaxIndex]; ///< All previously used locations
+  uint32_t nextLoc[kMaxIndex];         ///< No free location below this one
 };
 
 /// A class for managing resource bindings to avoid duplicate uses of the same
 /// set and binding number.
 class BindingSet {
 public:
+  /// Bindings below this are kept in each set's bitmap; the few above it,
+  /// which only come from explicit assignments, are kept in a hash set.
+  const static uint32_t kMaxBitmapBinding = 1u << 16;
+
   /// Uses the given set and binding number.
   void useBinding(uint32_t binding, uint32_t set) {
-    usedBindings[set].insert(binding);
+    auto &bindings = usedBindings[set];
+    if (binding >= kMaxBitmapBinding) {
+      bindings.sparse.insert(binding);
+      return;
+    }
+    if (binding >= bindings.bitmap.size())
+      bindings.bitmap.resize(
+          std::max<size_t>(binding + 1, bindings.bitmap.size() * 2));
+    bindings.bitmap.set(binding);
   }
 
-  /// Uses the next avaiable binding number in set 0.
+  /// Uses the next avaiable binding number in the given set.
   uint32_t useNextBinding(uint32_t set) {
-    auto &binding = usedBindings[set];
-    auto &next = nextBindings[set];
-    while (binding.count(next))
+    auto &bindings = usedBindings[set];
+    auto &next = bindings.next;
+    while (next < bindings.bitmap.size() && bindings.bitmap[next])
+      ++next;
+    while (next >= kMaxBitmapBinding && bindings.sparse.count(next))
       ++next;
-    binding.insert(next);
+    useBinding(next, set);
     return next++;
   }
 
 private:
-  ///< set number -> set of used binding number
-  llvm::DenseMap<uint32_t, llvm::DenseSet<uint32_t>> usedBindings;
-  ///< set number -> next available binding number
-  llvm::DenseMap<uint32_t, uint32_t> nextBindings;
+  struct SetBindings {
+    llvm::BitVector bitmap;          ///< Used bindings below the threshold
+    llvm::DenseSet<uint32_t> sparse; ///< Used bindings above the threshold
+    uint32_t next = 0;               ///< No free binding below this one
+  };
+
+  ///< set number -> used binding numbers
+  llvm::DenseMap<uint32_t, SetBindings> usedBindings;
 };
 } // namespace
 
@@ -1162,7 +1190,13 @@ public:
         *error = "set number: " + relation[i + 3];
         return false;
       }
-      mapping[relation[i + 1] + relation[i]] = std::make_pair(setNo, bindNo);
+      int32_t regNo = -1;
+      const StringRef reg = relation[i];
+      if (reg.empty() || reg.substr(1).getAsInteger(10, regNo) || regNo < 0) {
+        *error = "register: " + relation[i];
+        return false;
+      }
+      mapping[getKey(spaceNo, reg[0], regNo)] = std::make_pair(setNo, bindNo);
     }
     return true;
   }
@@ -1171,11 +1205,9 @@ public:
   /// descriptor setting for the given register. False otherwise.
   bool getSetBinding(const hlsl::RegisterAssignment *regAttr, int *setNo,
                      int *bindNo) const {
-    std::ostringstream iss;
-    iss << regAttr->RegisterSpace << regAttr->RegisterType
-        << regAttr->RegisterNumber;
-
-    auto found = mapping.find(iss.str());
+    auto found = mapping.find(getKey(regAttr->RegisterSpace,
+                                     regAttr->RegisterType,
+                                     regAttr->RegisterNumber));
     if (found != mapping.end()) {
       *setNo = found->second.first;
       *bindNo = found->second.second;
@@ -1186,7 +1218,14 @@ public:
   }
 
 private:
-  llvm::StringMap<std::pair<int, int>> mapping;
+  /// Packs the space, register type, and register number into one key so
+  /// that lookups don't need to build strings.
+  using Key = std::pair<uint64_t, uint32_t>;
+  static Key getKey(uint32_t space, char type, uint32_t number) {
+    return Key((uint64_t)space << 32 | number, (uint8_t)type);
+  }
+
+  llvm::DenseMap<Key, std::pair<int, int>> mapping;
 };
 } // namespace
 
@@ -16,6 +16,11 @@
 
 namespace clang {
 
+std::unique_ptr<ASTConsumer> CreateSPIRVEmitter(CompilerInstance &CI,
+                                                llvm::raw_ostream *OS) {
+  return llvm::make_unique<spirv::SPIRVEmitter>(CI, OS);
+}
+
 std::unique_ptr<ASTConsumer>
 EmitSPIRVAction::CreateASTConsumer(CompilerInstance &CI, StringRef InFile) {
   return llvm::make_unique<spirv::SPIRVEmitter>(CI);
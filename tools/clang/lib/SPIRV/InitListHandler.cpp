@@ -30,6 +30,13 @@ uint32_t InitListHandler::processInit(const InitListExpr *expr) {
   initializers.clear();
   scalars.clear();
 
+  // Initializers with the braces of their type need no flattening: emit them
+  // element by element, which takes one walk over the initializer.
+  if (matchesLayout(expr->getType(), expr)) {
+    bool isConstant = true;
+    return createInitDirectly(expr->getType(), expr, &isConstant);
+  }
+
   flatten(expr);
   // Reverse the whole initializer list so we can manipulate the list at the
   // tail of the vector. This is more efficient than using a deque.
@@ -60,6 +67,298 @@ uint32_t InitListHandler::doProcess(QualType type, SourceLocation srcLoc) {
   return init;
 }
 
+/// Returns the InitListExpr init is, looking through no-op casts, or nullptr.
+static const InitListExpr *getAsInitList(ASTContext &context,
+                                         const Expr *init) {
+  if (const auto *initList = dyn_cast<InitListExpr>(init))
+    return initList;
+  // Constructor casts like <type>(<initializer-list>) are no-ops.
+  return dyn_cast<InitListExpr>(init->IgnoreParenNoopCasts(context));
+}
+
+bool InitListHandler::matchesLayout(QualType type, const Expr *init) {
+  type = type.getCanonicalType();
+  const auto *initList = getAsInitList(theEmitter.getASTContext(), init);
+
+  // Resources are copied as they are; structured buffers report an error on
+  // the general path.
+  if (TypeTranslator::isOpaqueType(type))
+    return !initList && matchesLeaf(type, init);
+  if (TypeTranslator::isAKindOfStructuredOrByteBuffer(type))
+    return false;
+
+  if (!initList)
+    return matchesLeaf(type, init);
+
+  const uint32_t numInits = initList->getNumInits();
+
+  if (type->isBuiltinType())
+    return numInits == 1 && matchesLayout(type, initList->getInit(0));
+
+  if (hlsl::IsHLSLVecType(type))
+    return matchesVectorLayout(hlsl::GetHLSLVecElementType(type),
+                               hlsl::GetHLSLVecSize(type), init);
+
+  if (hlsl::IsHLSLMatType(type)) {
+    uint32_t rowCount = 0, colCount = 0;
+    hlsl::GetHLSLMatRowColCount(type, rowCount, colCount);
+    const QualType elemType = hlsl::GetHLSLMatElementType(type);
+
+    if (rowCount == 1 || colCount == 1)
+      return matchesVectorLayout(elemType, rowCount * colCount, init);
+
+    // All of the scalars, in row-major order.
+    if (numInits == rowCount * colCount) {
+      for (uint32_t i = 0; i < numInits; ++i)
+        if (!matchesLeaf(elemType, initList->getInit(i)))
+          return false;
+      return true;
+    }
+
+    // One vector per row.
+    if (numInits != rowCount)
+      return false;
+    for (uint32_t i = 0; i < numInits; ++i)
+      if (!matchesVectorLayout(elemType, colCount, initList->getInit(i)))
+        return false;
+    return true;
+  }
+
+  if (type->isStructureType()) {
+    const RecordDecl *structDecl = type->getAsStructureType()->getDecl();
+    // Fields of base structs are not in fields().
+    if (const auto *cxxDecl = dyn_cast<CXXRecordDecl>(structDecl))
+      if (cxxDecl->getNumBases() != 0)
+        return false;
+
+    uint32_t i = 0;
+    for (const auto *field : structDecl->fields()) {
+      if (i == numInits ||
+          !matchesLayout(field->getType(), initList->getInit(i++)))
+        return false;
+    }
+    return i == numInits;
+  }
+
+  if (type->isConstantArrayType()) {
+    const auto *arrType =
+        theEmitter.getASTContext().getAsConstantArrayType(type);
+    if (arrType->getSize() != numInits)
+      return false;
+    for (uint32_t i = 0; i < numInits; ++i)
+      if (!matchesLayout(arrType->getElementType(), initList->getInit(i)))
+        return false;
+    return true;
+  }
+
+  return false;
+}
+
+bool InitListHandler::matchesVectorLayout(QualType elemType, uint32_t count,
+                                          const Expr *init) {
+  const auto *initList = getAsInitList(theEmitter.getASTContext(), init);
+  if (!initList) {
+    if (count == 1)
+      return matchesLeaf(elemType, init);
+    const QualType initType = init->getType();
+    return hlsl::IsHLSLVecType(initType) &&
+           hlsl::GetHLSLVecSize(initType) == count;
+  }
+
+  if (initList->getNumInits() != count)
+    return false;
+  for (uint32_t i = 0; i < count; ++i)
+    if (!matchesLeaf(elemType, initList->getInit(i)))
+      return false;
+  return true;
+}
+
+bool InitListHandler::matchesLeaf(QualType type, const Expr *init) {
+  if (getAsInitList(theEmitter.getASTContext(), init))
+    return false;
+
+  const QualType initType = init->getType().getCanonicalType();
+  type = type.getCanonicalType();
+
+  if (type->isBuiltinType())
+    return initType->isBuiltinType();
+  if (hlsl::IsHLSLVecType(type))
+    return hlsl::IsHLSLVecType(initType) &&
+           hlsl::GetHLSLVecSize(initType) == hlsl::GetHLSLVecSize(type);
+  return initType == type;
+}
+
+uint32_t InitListHandler::createInitDirectly(QualType type, const Expr *init,
+                                             bool *isConstant) {
+  type = type.getCanonicalType();
+  const auto *initList = getAsInitList(theEmitter.getASTContext(), init);
+
+  if (!initList)
+    return createLeafDirectly(type, init, isConstant);
+
+  if (type->isBuiltinType())
+    return createInitDirectly(type, initList->getInit(0), isConstant);
+
+  if (hlsl::IsHLSLVecType(type))
+    return createVectorDirectly(hlsl::GetHLSLVecElementType(type),
+                                hlsl::GetHLSLVecSize(type), init, isConstant);
+
+  if (hlsl::IsHLSLMatType(type)) {
+    uint32_t rowCount = 0, colCount = 0;
+    hlsl::GetHLSLMatRowColCount(type, rowCount, colCount);
+    const QualType elemType = hlsl::GetHLSLMatElementType(type);
+
+    if (rowCount == 1 || colCount == 1)
+      return createVectorDirectly(elemType, rowCount * colCount, init,
+                                  isConstant);
+
+    bool rowsAreConstant = true;
+    llvm::SmallVector<uint32_t, 4> rows;
+    if (initList->getNumInits() == rowCount * colCount) {
+      const uint32_t rowTypeId = theBuilder.getVecType(
+          typeTranslator.translateType(elemType), colCount);
+      for (uint32_t i = 0; i < rowCount; ++i) {
+        bool rowIsConstant = true;
+        llvm::SmallVector<uint32_t, 4> elements;
+        for (uint32_t j = 0; j < colCount; ++j)
+          elements.push_back(createLeafDirectly(
+              elemType, initList->getInit(i * colCount + j), &rowIsConstant));
+        rows.push_back(createComposite(rowTypeId, elements, rowIsConstant));
+        rowsAreConstant = rowsAreConstant && rowIsConstant;
+      }
+    } else {
+      for (uint32_t i = 0; i < rowCount; ++i)
+        rows.push_back(createVectorDirectly(elemType, colCount,
+                                            initList->getInit(i),
+                                            &rowsAreConstant));
+    }
+
+    *isConstant = *isConstant && rowsAreConstant;
+    return createComposite(typeTranslator.translateType(type), rows,
+                           rowsAreConstant);
+  }
+
+  bool elementsAreConstant = true;
+  llvm::SmallVector<uint32_t, 4> elements;
+  if (type->isStructureType()) {
+    const RecordDecl *structDecl = type->getAsStructureType()->getDecl();
+    uint32_t i = 0;
+    for (const auto *field : structDecl->fields()) {
+      elements.push_back(createInitDirectly(
+          field->getType(), initList->getInit(i++), &elementsAreConstant));
+      if (!elements.back())
+        return 0;
+    }
+  } else {
+    assert(type->isConstantArrayType());
+    const auto *arrType =
+        theEmitter.getASTContext().getAsConstantArrayType(type);
+    const auto elemType = arrType->getElementType();
+    for (uint32_t i = 0; i < initList->getNumInits(); ++i) {
+      elements.push_back(createInitDirectly(elemType, initList->getInit(i),
+                                            &elementsAreConstant));
+      if (!elements.back())
+        return 0;
+    }
+  }
+
+  *isConstant = *isConstant && elementsAreConstant;
+  return createComposite(typeTranslator.translateType(type), elements,
+                         elementsAreConstant);
+}
+
+uint32_t InitListHandler::createVectorDirectly(QualType elemType,
+                                               uint32_t count,
+                                               const Expr *init,
+                                               bool *isConstant) {
+  const auto *initList = getAsInitList(theEmitter.getASTContext(), init);
+  if (!initList) {
+    if (count == 1)
+      return createLeafDirectly(elemType, init, isConstant);
+    if (hlsl::GetHLSLVecElementType(init->getType()).getCanonicalType() ==
+        elemType.getCanonicalType())
+      if (const uint32_t value = theEmitter.tryToEvaluateAsConst(init))
+        return value;
+    return createLeafDirectly(
+        theEmitter.getASTContext().getExtVectorType(elemType, count), init,
+        isConstant);
+  }
+
+  if (count == 1)
+    return createLeafDirectly(elemType, initList->getInit(0), isConstant);
+
+  bool elementsAreConstant = true;
+  llvm::SmallVector<uint32_t, 4> elements;
+  for (uint32_t i = 0; i < count; ++i)
+    elements.push_back(createLeafDirectly(elemType, initList->getInit(i),
+                                          &elementsAreConstant));
+
+  *isConstant = *isConstant && elementsAreConstant;
+  const uint32_t vecType =
+      theBuilder.getVecType(typeTranslator.translateType(elemType), count);
+  return createComposite(vecType, elements, elementsAreConstant);
+}
+
+uint32_t InitListHandler::createLeafDirectly(QualType type, const Expr *init,
+                                             bool *isConstant) {
+  const QualType initType = init->getType();
+
+  if (type->isBuiltinType()) {
+    if (const uint32_t value = tryToEvaluateScalarAsConst(type, init))
+      return value;
+  } else if (!type->isVectorType()) {
+    // Structs, arrays, matrices and resources of exactly the type.
+    *isConstant = false;
+    return theEmitter.loadIfGLValue(init);
+  }
+
+  *isConstant = false;
+  return theEmitter.castToType(theEmitter.loadIfGLValue(init), initType, type,
+                               init->getExprLoc());
+}
+
+uint32_t InitListHandler::tryToEvaluateScalarAsConst(QualType type,
+                                                     const Expr *init) {
+  const QualType initType = init->getType().getCanonicalType();
+  type = type.getCanonicalType();
+  if (initType == type)
+    return theEmitter.tryToEvaluateAsConst(init);
+  if (!initType->isIntegerType() && !initType->isFloatingType())
+    return 0;
+
+  CastKind castKind;
+  if (type->isBooleanType())
+    castKind = initType->isFloatingType() ? CK_FloatingToBoolean
+                                          : CK_IntegralToBoolean;
+  else if (type->isIntegerType())
+    castKind = initType->isFloatingType() ? CK_FloatingToIntegral
+                                          : CK_IntegralCast;
+  else if (type->isFloatingType())
+    castKind = initType->isFloatingType() ? CK_FloatingCast
+                                          : CK_IntegralToFloating;
+  else
+    return 0;
+
+  // Evaluate the initializer as if it were written with the conversion.
+  const auto &context = theEmitter.getASTContext();
+  auto *operand = const_cast<Expr *>(init);
+  if (operand->isGLValue())
+    operand = ImplicitCastExpr::Create(context, operand->getType(),
+                                       CK_LValueToRValue, operand,
+                                       /*BasePath*/ nullptr, VK_RValue);
+  const auto *converted = ImplicitCastExpr::Create(
+      context, type, castKind, operand, /*BasePath*/ nullptr, VK_RValue);
+  return theEmitter.tryToEvaluateAsConst(converted);
+}
+
+uint32_t InitListHandler::createComposite(uint32_t typeId,
+                                          llvm::ArrayRef<uint32_t> elements,
+                                          bool isConstant) {
+  if (isConstant)
+    return theBuilder.getConstantComposite(typeId, elements);
+  return theBuilder.createCompositeConstruct(typeId, elements);
+}
+
 void InitListHandler::flatten(const InitListExpr *expr) {
   const auto numInits = expr->getNumInits();
 
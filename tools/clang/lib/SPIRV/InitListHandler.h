@@ -48,6 +48,13 @@ namespace spirv {
 /// top of the SPIRVEmitter class and calls into SPIRVEmitter for normal
 /// translation tasks. This gives better code structure.
 ///
+/// Most initializer lists in practice have the braces of the type they
+/// initialize: {{1, 2}, {3, 4}} for a float2x2, one brace per struct or array
+/// element. For those, matchesLayout() holds and createInitDirectly() walks
+/// the initializer and the type together, emitting each composite from its
+/// elements as they are, and as an OpConstantComposite when they are all
+/// constants. The rest of this comment is about the general case.
+///
 /// The logic for handling initalizer lists is largely the following:
 ///
 /// First we flatten() the given initalizer list recursively and put all non-
@@ -105,6 +112,29 @@ private:
   /// the final SPIR-V value of the given type.
   uint32_t doProcess(QualType type, SourceLocation srcLoc);
 
+  /// Returns true if init has the braces of type: each InitListExpr in it has
+  /// one initializer per element of the corresponding type, and each leaf is
+  /// of the type it initializes, up to scalar and vector element casts. A
+  /// matrix may also be initialized from all of its scalars.
+  bool matchesLayout(QualType type, const Expr *init);
+  bool matchesVectorLayout(QualType elemType, uint32_t count, const Expr *init);
+  bool matchesLeaf(QualType type, const Expr *init);
+
+  /// Emits the value of type for init, for which matchesLayout() holds, in
+  /// one walk and without intermediate composites. Sets isConstant to false
+  /// unless the value is a constant.
+  uint32_t createInitDirectly(QualType type, const Expr *init,
+                              bool *isConstant);
+  uint32_t createVectorDirectly(QualType elemType, uint32_t count,
+                                const Expr *init, bool *isConstant);
+  uint32_t createLeafDirectly(QualType type, const Expr *init,
+                              bool *isConstant);
+  /// Returns the constant init has once converted to the scalar type, or 0.
+  uint32_t tryToEvaluateScalarAsConst(QualType type, const Expr *init);
+  /// Emits a composite of the given elements, constant if they all are.
+  uint32_t createComposite(uint32_t typeId, llvm::ArrayRef<uint32_t> elements,
+                           bool isConstant);
+
   /// Flattens the given InitListExpr and puts all non-InitListExpr AST nodes
   /// into initializers.
   void flatten(const InitListExpr *expr);
@@ -41,7 +41,7 @@ void InstBuilder::setConsumer(WordConsumer consumer) { TheConsumer = consumer; }
 const WordConsumer &InstBuilder::getConsumer() const { return TheConsumer; }
 
 InstBuilder::Status InstBuilder::x() {
-  if (TheConsumer == nullptr)
+  if (TheConsumer == nullptr && TheOutput == nullptr)
     return Status::NullConsumer;
 
   if (TheStatus != Status::Success)
@@ -70,7 +70,10 @@ InstBuilder::Status InstBuilder::x() {
 
   if (!TheInst.empty())
     TheInst.front() |= uint32_t(TheInst.size()) << 16;
-  TheConsumer(std::move(TheInst));
+  if (TheOutput)
+    TheOutput->insert(TheOutput->end(), TheInst.begin(), TheInst.end());
+  else
+    TheConsumer(std::move(TheInst));
   TheInst.clear();
 
   return TheStatus;
@@ -15,6 +15,16 @@
 namespace clang {
 namespace spirv {
 
+InstBuilder::InstBuilder(std::vector<uint32_t> *output)
+    : TheConsumer(nullptr), TheOutput(output), TheStatus(Status::Success) {}
+
+void InstBuilder::emit(std::vector<uint32_t> &&words) {
+  if (TheOutput)
+    TheOutput->insert(TheOutput->end(), words.begin(), words.end());
+  else if (TheConsumer)
+    TheConsumer(std::move(words));
+}
+
 std::vector<uint32_t> InstBuilder::take() {
   std::vector<uint32_t> result;
 
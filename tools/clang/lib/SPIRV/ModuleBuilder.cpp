@@ -31,10 +31,7 @@ std::vector<uint32_t> ModuleBuilder::takeModule() {
   theModule.setBound(theContext.getNextId());
 
   std::vector<uint32_t> binary;
-  auto ib = InstBuilder([&binary](std::vector<uint32_t> &&words) {
-    binary.insert(binary.end(), words.begin(), words.end());
-  });
-
+  InstBuilder ib(&binary);
   theModule.take(&ib);
   return binary;
 }
@@ -53,6 +50,8 @@ uint32_t ModuleBuilder::beginFunction(uint32_t funcType, uint32_t returnType,
   theFunction = llvm::make_unique<Function>(
       returnType, fId, spv::FunctionControlMask::MaskNone, funcType);
   theModule.addDebugName(fId, funcName);
+  forwardableVars.clear();
+  knownValues.clear();
 
   return fId;
 }
@@ -75,6 +74,8 @@ uint32_t ModuleBuilder::addFnVar(uint32_t varType, llvm::StringRef name,
   const uint32_t varId = theContext.takeNextId();
   theFunction->addVariable(ptrType, varId, init);
   theModule.addDebugName(varId, name);
+  if (!spirvOptions.codeGenHighLevel)
+    forwardableVars[varId] = varType;
   return varId;
 }
 
@@ -128,6 +129,8 @@ void ModuleBuilder::setContinueTarget(uint32_t continueLabel) {
 
 void ModuleBuilder::setInsertPoint(uint32_t labelId) {
   insertPoint = getBasicBlock(labelId);
+  // Stored values don't dominate other basic blocks.
+  knownValues.clear();
 }
 
 uint32_t
@@ -136,7 +139,7 @@ ModuleBuilder::createCompositeConstruct(uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opCompositeConstruct(resultType, resultId, constituents).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
@@ -146,7 +149,7 @@ ModuleBuilder::createCompositeExtract(uint32_t resultType, uint32_t composite,
   assert(insertPoint && "null insert point");
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opCompositeExtract(resultType, resultId, composite, indexes).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
@@ -159,7 +162,7 @@ uint32_t ModuleBuilder::createCompositeInsert(uint32_t resultType,
   instBuilder
       .opCompositeInsert(resultType, resultId, object, composite, indices)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
@@ -171,22 +174,39 @@ ModuleBuilder::createVectorShuffle(uint32_t resultType, uint32_t vector1,
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opVectorShuffle(resultType, resultId, vector1, vector2, selectors)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
 uint32_t ModuleBuilder::createLoad(uint32_t resultType, uint32_t pointer) {
   assert(insertPoint && "null insert point");
+  auto var = forwardableVars.find(pointer);
+  const bool forwardable =
+      var != forwardableVars.end() && var->second == resultType;
+  if (forwardable) {
+    auto known = knownValues.find(pointer);
+    if (known != knownValues.end())
+      return known->second;
+  }
+
   const uint32_t resultId = theContext.takeNextId();
   instBuilder.opLoad(resultType, resultId, pointer, llvm::None).x();
+  // The pointer is the variable itself, so it remains forwardable.
   insertPoint->appendInstruction(std::move(constructSite));
+  if (forwardable)
+    knownValues[pointer] = resultId;
   return resultId;
 }
 
 void ModuleBuilder::createStore(uint32_t address, uint32_t value) {
   assert(insertPoint && "null insert point");
+  // Storing the pointer to a variable lets it be written through the copy.
+  if (forwardableVars.erase(value))
+    knownValues.erase(value);
   instBuilder.opStore(address, value, llvm::None).x();
   insertPoint->appendInstruction(std::move(constructSite));
+  if (forwardableVars.count(address))
+    knownValues[address] = value;
 }
 
 uint32_t ModuleBuilder::createFunctionCall(uint32_t returnType,
@@ -195,7 +215,7 @@ uint32_t ModuleBuilder::createFunctionCall(uint32_t returnType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opFunctionCall(returnType, id, functionId, params).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -204,7 +224,7 @@ uint32_t ModuleBuilder::createAccessChain(uint32_t resultType, uint32_t base,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opAccessChain(resultType, id, base, indexes).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -213,7 +233,7 @@ uint32_t ModuleBuilder::createUnaryOp(spv::Op op, uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.unaryOp(op, resultType, id, operand).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   switch (op) {
   case spv::Op::OpImageQuerySize:
   case spv::Op::OpImageQueryLevels:
@@ -232,7 +252,7 @@ uint32_t ModuleBuilder::createBinaryOp(spv::Op op, uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.binaryOp(op, resultType, id, lhs, rhs).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   switch (op) {
   case spv::Op::OpImageQueryLod:
   case spv::Op::OpImageQuerySizeLod:
@@ -259,7 +279,7 @@ uint32_t ModuleBuilder::createGroupNonUniformOp(spv::Op op, uint32_t resultType,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.groupNonUniformOp(op, resultType, id, execScope).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -271,7 +291,7 @@ uint32_t ModuleBuilder::createGroupNonUniformUnaryOp(
   instBuilder
       .groupNonUniformUnaryOp(op, resultType, id, execScope, groupOp, operand)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -286,7 +306,7 @@ uint32_t ModuleBuilder::createGroupNonUniformBinaryOp(spv::Op op,
       .groupNonUniformBinaryOp(op, resultType, id, execScope, operand1,
                                operand2)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -301,7 +321,7 @@ uint32_t ModuleBuilder::createAtomicOp(spv::Op opcode, uint32_t resultType,
       .atomicOp(opcode, resultType, id, orignalValuePtr, scopeId,
                 memorySemanticsId, valueToOp)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -315,7 +335,7 @@ uint32_t ModuleBuilder::createAtomicCompareExchange(
       resultType, id, orignalValuePtr, scopeId, equalMemorySemanticsId,
       unequalMemorySemanticsId, valueToOp, comparator);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -385,7 +405,7 @@ ModuleBuilder::createImageSparseTexelsResident(uint32_t resident_code) {
   const uint32_t result_type = getBoolType();
   const uint32_t id = theContext.takeNextId();
   instBuilder.opImageSparseTexelsResident(result_type, id, resident_code).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -397,7 +417,7 @@ uint32_t ModuleBuilder::createImageTexelPointer(uint32_t resultType,
   const uint32_t id = theContext.takeNextId();
   instBuilder.opImageTexelPointer(resultType, id, imageId, coordinate, sample)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -429,7 +449,7 @@ uint32_t ModuleBuilder::createImageSample(
   const uint32_t sampledImgId = theContext.takeNextId();
   const uint32_t sampledImgTy = getSampledImageType(imageType);
   instBuilder.opSampledImage(sampledImgTy, sampledImgId, image, sampler).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   if (isNonUniform) {
     // The sampled image will be used to access resource's memory, so we need
@@ -449,7 +469,7 @@ uint32_t ModuleBuilder::createImageSample(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   if (isSparse) {
     // Write the Residency Code
@@ -468,7 +488,7 @@ void ModuleBuilder::createImageWrite(QualType imageType, uint32_t imageId,
   requireCapability(
       TypeTranslator::getCapabilityForStorageImageReadWrite(imageType));
   instBuilder.opImageWrite(imageId, coordId, texelId, llvm::None).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 uint32_t ModuleBuilder::createImageFetchOrRead(
@@ -502,7 +522,7 @@ uint32_t ModuleBuilder::createImageFetchOrRead(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   if (isSparse) {
     // Write the Residency Code
@@ -532,7 +552,7 @@ uint32_t ModuleBuilder::createImageGather(
   const uint32_t sampledImgId = theContext.takeNextId();
   const uint32_t sampledImgTy = getSampledImageType(imageType);
   instBuilder.opSampledImage(sampledImgTy, sampledImgId, image, sampler).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   if (isNonUniform) {
     // The sampled image will be used to access resource's memory, so we need
@@ -572,7 +592,7 @@ uint32_t ModuleBuilder::createImageGather(
   for (const auto param : params)
     instBuilder.idRef(param);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   if (residencyCodeId) {
     // Write the Residency Code
@@ -590,7 +610,7 @@ uint32_t ModuleBuilder::createSelect(uint32_t resultType, uint32_t condition,
   assert(insertPoint && "null insert point");
   const uint32_t id = theContext.takeNextId();
   instBuilder.opSelect(resultType, id, condition, trueValue, falseValue).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return id;
 }
 
@@ -601,18 +621,18 @@ void ModuleBuilder::createSwitch(
   // Create the OpSelectioMerege.
   instBuilder.opSelectionMerge(mergeLabel, spv::SelectionControlMask::MaskNone)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 
   // Create the OpSwitch.
   instBuilder.opSwitch(selector, defaultLabel, target).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createKill() {
   assert(insertPoint && "null insert point");
   assert(!isCurrentBasicBlockTerminated());
   instBuilder.opKill().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createBranch(uint32_t targetLabel, uint32_t mergeBB,
@@ -622,11 +642,11 @@ void ModuleBuilder::createBranch(uint32_t targetLabel, uint32_t mergeBB,
 
   if (mergeBB && continueBB) {
     instBuilder.opLoopMerge(mergeBB, continueBB, loopControl).x();
-    insertPoint->appendInstruction(std::move(constructSite));
+    appendInstruction();
   }
 
   instBuilder.opBranch(targetLabel).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createConditionalBranch(
@@ -639,27 +659,27 @@ void ModuleBuilder::createConditionalBranch(
   if (mergeLabel) {
     if (continueLabel) {
       instBuilder.opLoopMerge(mergeLabel, continueLabel, loopControl).x();
-      insertPoint->appendInstruction(std::move(constructSite));
+      appendInstruction();
     } else {
       instBuilder.opSelectionMerge(mergeLabel, selectionControl).x();
-      insertPoint->appendInstruction(std::move(constructSite));
+      appendInstruction();
     }
   }
 
   instBuilder.opBranchConditional(condition, trueLabel, falseLabel, {}).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createReturn() {
   assert(insertPoint && "null insert point");
   instBuilder.opReturn().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createReturnValue(uint32_t value) {
   assert(insertPoint && "null insert point");
   instBuilder.opReturnValue(value).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 uint32_t ModuleBuilder::createExtInst(uint32_t resultType, uint32_t setId,
@@ -668,7 +688,7 @@ uint32_t ModuleBuilder::createExtInst(uint32_t resultType, uint32_t setId,
   assert(insertPoint && "null insert point");
   uint32_t resultId = theContext.takeNextId();
   instBuilder.opExtInst(resultType, resultId, setId, instId, operands).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
@@ -679,7 +699,7 @@ void ModuleBuilder::createBarrier(uint32_t execution, uint32_t memory,
     instBuilder.opControlBarrier(execution, memory, semantics).x();
   else
     instBuilder.opMemoryBarrier(memory, semantics).x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 uint32_t ModuleBuilder::createBitFieldExtract(uint32_t resultType,
@@ -692,7 +712,7 @@ uint32_t ModuleBuilder::createBitFieldExtract(uint32_t resultType,
   else
     instBuilder.opBitFieldUExtract(resultType, resultId, base, offset, count);
   instBuilder.x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
@@ -704,20 +724,20 @@ uint32_t ModuleBuilder::createBitFieldInsert(uint32_t resultType, uint32_t base,
   instBuilder
       .opBitFieldInsert(resultType, resultId, base, insert, offset, count)
       .x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
   return resultId;
 }
 
 void ModuleBuilder::createEmitVertex() {
   assert(insertPoint && "null insert point");
   instBuilder.opEmitVertex().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::createEndPrimitive() {
   assert(insertPoint && "null insert point");
   instBuilder.opEndPrimitive().x();
-  insertPoint->appendInstruction(std::move(constructSite));
+  appendInstruction();
 }
 
 void ModuleBuilder::addExecutionMode(uint32_t entryPointId,
@@ -898,6 +918,14 @@ void ModuleBuilder::decorateNoContraction(uint32_t targetId) {
   theModule.addDecoration(d, targetId);
 }
 
+void ModuleBuilder::decorateLinkage(uint32_t targetId, llvm::StringRef name,
+                                    spv::LinkageType linkageType) {
+  requireCapability(spv::Capability::Linkage);
+  const Decoration *d =
+      Decoration::getLinkageAttributes(theContext, name.str(), linkageType);
+  theModule.addDecoration(d, targetId);
+}
+
 #define IMPL_GET_PRIMITIVE_TYPE(ty)                                            \
                                                                                \
   uint32_t ModuleBuilder::get##ty##Type() {                                    \
@@ -1272,6 +1300,19 @@ uint32_t ModuleBuilder::getConstantNull(uint32_t typeId) {
 
 void ModuleBuilder::debugLine(uint32_t file, uint32_t line, uint32_t column) {
   instBuilder.opLine(file, line, column).x();
+  appendInstruction();
+}
+
+void ModuleBuilder::appendInstruction() {
+  // Other uses of a variable, such as access chains into it or passing it to
+  // a call, may write it behind our back. Literal operands may match a
+  // variable by chance, which only loses forwarding.
+  if (!forwardableVars.empty()) {
+    for (size_t i = 1; i < constructSite.size(); ++i) {
+      if (forwardableVars.erase(constructSite[i]))
+        knownValues.erase(constructSite[i]);
+    }
+  }
   insertPoint->appendInstruction(std::move(constructSite));
 }
 
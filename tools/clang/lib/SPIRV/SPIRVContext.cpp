@@ -7,8 +7,6 @@
 //
 //===----------------------------------------------------------------------===//
 
-#include <tuple>
-
 #include "clang/SPIRV/SPIRVContext.h"
 
 namespace clang {
@@ -16,19 +14,13 @@ namespace spirv {
 
 uint32_t SPIRVContext::getResultIdForType(const Type *t, bool *isRegistered) {
   assert(t != nullptr);
-  uint32_t result_id = 0;
+  uint32_t &result_id = existingTypes[t];
 
-  auto iter = typeResultIdMap.find(t);
-  if (iter == typeResultIdMap.end()) {
+  if (isRegistered)
+    *isRegistered = result_id != 0;
+  if (result_id == 0) {
     // The Type has not been defined yet. Reserve an ID for it.
     result_id = takeNextId();
-    typeResultIdMap[t] = result_id;
-    if (isRegistered)
-      *isRegistered = false;
-  } else {
-    result_id = iter->second;
-    if (isRegistered)
-      *isRegistered = true;
   }
 
   assert(result_id != 0);
@@ -37,15 +29,11 @@ uint32_t SPIRVContext::getResultIdForType(const Type *t, bool *isRegistered) {
 
 uint32_t SPIRVContext::getResultIdForConstant(const Constant *c) {
   assert(c != nullptr);
-  uint32_t result_id = 0;
+  uint32_t &result_id = existingConstants[c];
 
-  auto iter = constantResultIdMap.find(c);
-  if (iter == constantResultIdMap.end()) {
+  if (result_id == 0) {
     // The constant has not been defined yet. Reserve an ID for it.
     result_id = takeNextId();
-    constantResultIdMap[c] = result_id;
-  } else {
-    result_id = iter->second;
   }
 
   assert(result_id != 0);
@@ -53,24 +41,30 @@ uint32_t SPIRVContext::getResultIdForConstant(const Constant *c) {
 }
 
 const Type *SPIRVContext::registerType(const Type &t) {
-  // Insert function will only insert if it doesn't already exist in the set.
-  TypeSet::iterator it;
-  std::tie(it, std::ignore) = existingTypes.insert(t);
-  return &*it;
+  auto it = existingTypes.find_as(t);
+  if (it != existingTypes.end())
+    return it->first;
+  const Type *unique = new (typeArena.Allocate()) Type(t);
+  existingTypes.insert(std::make_pair(unique, 0u));
+  return unique;
 }
 
 const Constant *SPIRVContext::registerConstant(const Constant &c) {
-  // Insert function will only insert if it doesn't already exist in the set.
-  ConstantSet::iterator it;
-  std::tie(it, std::ignore) = existingConstants.insert(c);
-  return &*it;
+  auto it = existingConstants.find_as(c);
+  if (it != existingConstants.end())
+    return it->first;
+  const Constant *unique = new (constantArena.Allocate()) Constant(c);
+  existingConstants.insert(std::make_pair(unique, 0u));
+  return unique;
 }
 
 const Decoration *SPIRVContext::registerDecoration(const Decoration &d) {
-  // Insert function will only insert if it doesn't already exist in the set.
-  DecorationSet::iterator it;
-  std::tie(it, std::ignore) = existingDecorations.insert(d);
-  return &*it;
+  auto it = existingDecorations.find_as(d);
+  if (it != existingDecorations.end())
+    return *it;
+  const Decoration *unique = new (decorationArena.Allocate()) Decoration(d);
+  existingDecorations.insert(unique);
+  return unique;
 }
 
 } // end namespace spirv
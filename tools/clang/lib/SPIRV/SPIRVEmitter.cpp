@@ -14,9 +14,12 @@
 #include "SPIRVEmitter.h"
 
 #include "dxc/HlslIntrinsicOp.h"
+#include "spirv-tools/linker.hpp"
 #include "spirv-tools/optimizer.hpp"
 #include "clang/SPIRV/AstTypeProbe.h"
+#include "clang/SPIRV/EmitSPIRVAction.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/PhaseTiming.h"
 
 #include "InitListHandler.h"
 
@@ -192,8 +195,117 @@ bool isReferencingNonAliasStructuredOrByteBuffer(const Expr *expr) {
   return false;
 }
 
+/// Returns the spirv-opt flags that a named -Oconfig recipe stands for, or an
+/// empty list if the name isn't a recipe.
+std::vector<std::string> getOptRecipeFlags(llvm::StringRef name) {
+  if (name == "performance")
+    return {"-O", "--compact-ids"};
+  if (name == "size")
+    return {"-Os", "--compact-ids"};
+  if (name == "fast")
+    // Cheap cleanups that remove most of what the translation leaves behind,
+    // without the costlier scalar and loop transformations.
+    return {"--inline-entry-points-exhaustive", "--eliminate-dead-functions",
+            "--private-to-local",           "--eliminate-local-single-block",
+            "--eliminate-local-single-store", "--eliminate-dead-branches",
+            "--merge-blocks",               "--eliminate-dead-code-aggressive",
+            "--compact-ids"};
+  return {};
+}
+
+/// Returns the listener that times the passes, if it wants them one at a
+/// time; otherwise nullptr.
+llvm::PhaseTimingListener *getPassTimingListener() {
+  llvm::PhaseTimingListener *listener = llvm::getPhaseTimingListener();
+  return listener && listener->wantsPassSizes() ? listener : nullptr;
+}
+
+/// Returns the number of instructions in the given SPIR-V module.
+int64_t countSpirvInstructions(const std::vector<uint32_t> &module) {
+  int64_t count = 0;
+  // Skip the 5-word header; each instruction gives its word count in its high
+  // half-word.
+  for (size_t i = 5; i < module.size(); ++count) {
+    const uint32_t wordCount = module[i] >> 16;
+    if (wordCount == 0)
+      break;
+    i += wordCount;
+  }
+  return count;
+}
+
+/// Splits the -O, -Os and --legalize-hlsl flags into the flags of the passes
+/// they register, so that each pass can be timed on its own. A flag is kept
+/// whole if any of its passes has no flag of its own.
+std::vector<std::string> splitOptFlags(spv_target_env env,
+                                       const std::vector<std::string> &flags) {
+  std::vector<std::string> result;
+  for (const auto &flag : flags) {
+    if (flag == "-O" || flag == "-Os" || flag == "--legalize-hlsl") {
+      spvtools::Optimizer recipe(env);
+      if (recipe.RegisterPassesFromFlags({flag})) {
+        std::vector<std::string> passFlags;
+        for (const char *passName : recipe.GetPassNames()) {
+          std::string passFlag = std::string("--") + passName;
+          spvtools::Optimizer probe(env);
+          if (!probe.RegisterPassesFromFlags({passFlag})) {
+            passFlags.clear();
+            break;
+          }
+          passFlags.push_back(passFlag);
+        }
+        if (!passFlags.empty()) {
+          result.insert(result.end(), passFlags.begin(), passFlags.end());
+          continue;
+        }
+      }
+    }
+    result.push_back(flag);
+  }
+  return result;
+}
+
+/// Runs the passes of the given flags one at a time, reporting the time and
+/// the change in instruction count of each to the listener.
+bool spirvToolsRunTimed(spv_target_env env, std::vector<uint32_t> *module,
+                        const std::vector<std::string> &flags,
+                        std::string *messages,
+                        llvm::PhaseTimingListener *listener) {
+  spvtools::OptimizerOptions options;
+  options.set_run_validator(false);
+
+  for (const auto &flag : splitOptFlags(env, flags)) {
+    spvtools::Optimizer optimizer(env);
+    optimizer.SetMessageConsumer(
+        [messages](spv_message_level_t /*level*/, const char * /*source*/,
+                   const spv_position_t & /*position*/,
+                   const char *message) { *messages += message; });
+    if (!optimizer.RegisterPassesFromFlags({flag}))
+      return false;
+
+    const std::string name = "spirv-opt " + flag;
+    const int64_t before = countSpirvInstructions(*module);
+    listener->passStarted(name);
+    bool success;
+    {
+      llvm::PhaseTimingRegion region(name, /*IsPass*/ true);
+      success = optimizer.Run(module->data(), module->size(), module, options);
+    }
+    listener->passSizeChanged(name, countSpirvInstructions(*module) - before);
+    if (!success)
+      return false;
+  }
+  return true;
+}
+
 bool spirvToolsLegalize(spv_target_env env, std::vector<uint32_t> *module,
                         std::string *messages) {
+  if (llvm::PhaseTimingListener *listener = getPassTimingListener())
+    return spirvToolsRunTimed(
+        env, module,
+        {"--legalize-hlsl", "--replace-invalid-opcode", "--compact-ids"},
+        messages, listener);
+
   spvtools::Optimizer optimizer(env);
 
   optimizer.SetMessageConsumer(
@@ -216,6 +328,24 @@ bool spirvToolsLegalize(spv_target_env env, std::vector<uint32_t> *module,
 bool spirvToolsOptimize(spv_target_env env, std::vector<uint32_t> *module,
                         const llvm::SmallVector<llvm::StringRef, 4> &flags,
                         std::string *messages) {
+  // Command line options use llvm::SmallVector and llvm::StringRef, whereas
+  // SPIR-V optimizer uses std::vector and std::string. Named recipes are
+  // expanded in place.
+  std::vector<std::string> stdFlags;
+  for (const auto &f : flags) {
+    std::vector<std::string> recipe = getOptRecipeFlags(f);
+    if (recipe.empty())
+      stdFlags.push_back(f.str());
+    else
+      stdFlags.insert(stdFlags.end(), recipe.begin(), recipe.end());
+  }
+
+  if (llvm::PhaseTimingListener *listener = getPassTimingListener()) {
+    if (stdFlags.empty())
+      stdFlags = getOptRecipeFlags("performance");
+    return spirvToolsRunTimed(env, module, stdFlags, messages, listener);
+  }
+
   spvtools::Optimizer optimizer(env);
 
   optimizer.SetMessageConsumer(
@@ -226,15 +356,10 @@ bool spirvToolsOptimize(spv_target_env env, std::vector<uint32_t> *module,
   spvtools::OptimizerOptions options;
   options.set_run_validator(false);
 
-  if (flags.empty()) {
+  if (stdFlags.empty()) {
     optimizer.RegisterPerformancePasses();
     optimizer.RegisterPass(spvtools::CreateCompactIdsPass());
   } else {
-    // Command line options use llvm::SmallVector and llvm::StringRef, whereas
-    // SPIR-V optimizer uses std::vector and std::string.
-    std::vector<std::string> stdFlags;
-    for (const auto &f : flags)
-      stdFlags.push_back(f.str());
     if (!optimizer.RegisterPassesFromFlags(stdFlags))
       return false;
   }
@@ -595,8 +720,9 @@ spv::Capability getNonUniformCapability(QualType type) {
 
 } // namespace
 
-SPIRVEmitter::SPIRVEmitter(CompilerInstance &ci)
-    : theCompilerInstance(ci), astContext(ci.getASTContext()),
+SPIRVEmitter::SPIRVEmitter(CompilerInstance &ci, llvm::raw_ostream *out)
+    : theCompilerInstance(ci), outStream(out ? out : ci.getOutStream()),
+      astContext(ci.getASTContext()),
       diags(ci.getDiagnostics()),
       spirvOptions(ci.getCodeGenOpts().SpirvOptions),
       entryFunctionName(ci.getCodeGenOpts().HLSLEntryFunction),
@@ -610,10 +736,13 @@ SPIRVEmitter::SPIRVEmitter(CompilerInstance &ci)
       entryFunctionId(0), curFunction(nullptr), curThis(0),
       seenPushConstantAt(), isSpecConstantMode(false),
       foundNonUniformResourceIndex(false), needsLegalization(false),
-      mainSourceFileId(0) {
+      needsLinking(false), mainSourceFileId(0) {
   if (shaderModel.GetKind() == hlsl::ShaderModel::Kind::Invalid)
     emitError("unknown shader module: %0", {}) << shaderModel.GetName();
 
+  for (const auto &specConstant : spirvOptions.specConstants)
+    optionSpecConstantIds[specConstant.first] = specConstant.second;
+
   if (spirvOptions.invertY && !shaderModel.IsVS() && !shaderModel.IsDS() &&
       !shaderModel.IsGS())
     emitError("-fvk-invert-y can only be used in VS/DS/GS", {});
@@ -668,10 +797,22 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
 
   TranslationUnitDecl *tu = context.getTranslationUnitDecl();
 
-  // The entry function is the seed of the queue.
+  // The entry function is the seed of the queue. A library has no entry
+  // function; its exported functions are the seeds instead.
   for (auto *decl : tu->decls()) {
     if (auto *funcDecl = dyn_cast<FunctionDecl>(decl)) {
-      if (funcDecl->getName() == entryFunctionName) {
+      if (shaderModel.IsLib()) {
+        if (funcDecl->hasAttr<HLSLShaderAttr>()) {
+          emitWarning("entry point %0 is not emitted into a SPIR-V library; "
+                      "compile it with its own target profile and link it "
+                      "with the library",
+                      funcDecl->getLocation())
+              << funcDecl->getName();
+        } else if (isExportedFunction(funcDecl)) {
+          (void)declIdMapper.getOrRegisterFnResultId(funcDecl);
+          workQueue.insert(funcDecl);
+        }
+      } else if (funcDecl->getName() == entryFunctionName) {
         workQueue.insert(funcDecl);
       }
     } else {
@@ -697,8 +838,10 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
   theBuilder.setAddressingModel(spv::AddressingModel::Logical);
   theBuilder.setMemoryModel(spv::MemoryModel::GLSL450);
 
-  theBuilder.addEntryPoint(getSpirvShaderStage(shaderModel), entryFunctionId,
-                           entryFunctionName, declIdMapper.collectStageVars());
+  if (!shaderModel.IsLib())
+    theBuilder.addEntryPoint(getSpirvShaderStage(shaderModel), entryFunctionId,
+                             entryFunctionName,
+                             declIdMapper.collectStageVars());
 
   // Add Location decorations to stage input/output variables.
   if (!declIdMapper.decorateStageIOLocations())
@@ -711,9 +854,10 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
   // Output the constructed module.
   std::vector<uint32_t> m = theBuilder.takeModule();
 
-  if (!spirvOptions.codeGenHighLevel) {
+  if (!spirvOptions.codeGenHighLevel && !needsLinking) {
     // Run legalization passes
     if (needsLegalization || declIdMapper.requiresLegalization()) {
+      llvm::PhaseTimingRegion LegalizePhase("legalize");
       std::string messages;
       if (!spirvToolsLegalize(targetEnv, &m, &messages)) {
         emitFatalError("failed to legalize SPIR-V: %0", {}) << messages;
@@ -729,6 +873,7 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
 
     // Run optimization passes
     if (theCompilerInstance.getCodeGenOpts().OptimizationLevel > 0) {
+      llvm::PhaseTimingRegion OptimizePhase("optimize");
       std::string messages;
       if (!spirvToolsOptimize(targetEnv, &m, spirvOptions.optConfig,
                               &messages)) {
@@ -743,7 +888,8 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
   }
 
   // Validate the generated SPIR-V code
-  if (!spirvOptions.disableValidation) {
+  if (!spirvOptions.disableValidation && !needsLinking) {
+    llvm::PhaseTimingRegion ValidationPhase("validation");
     std::string messages;
     if (!spirvToolsValidate(targetEnv, spirvOptions,
                             declIdMapper.requiresLegalization(), &m,
@@ -757,8 +903,7 @@ void SPIRVEmitter::HandleTranslationUnit(ASTContext &context) {
     }
   }
 
-  theCompilerInstance.getOutStream()->write(
-      reinterpret_cast<const char *>(m.data()), m.size() * 4);
+  outStream->write(reinterpret_cast<const char *>(m.data()), m.size() * 4);
 }
 
 void SPIRVEmitter::doDecl(const Decl *decl) {
@@ -1106,6 +1251,16 @@ void SPIRVEmitter::doFunctionDecl(const FunctionDecl *decl) {
     // calls. We have already assigned <result-id>s for it when translating
     // its call site. Query it here.
     funcId = declIdMapper.getDeclEvalInfo(decl);
+
+    // A function without a body is defined by a library, and one exported
+    // from this library may be called by the modules linked with it.
+    if (!decl->hasBody()) {
+      theBuilder.decorateLinkage(funcId, funcName, spv::LinkageType::Import);
+      needsLinking = true;
+    } else if (shaderModel.IsLib() && isExportedFunction(decl)) {
+      theBuilder.decorateLinkage(funcId, funcName, spv::LinkageType::Export);
+      needsLinking = true;
+    }
   }
 
   const uint32_t retType =
@@ -1334,7 +1489,16 @@ void SPIRVEmitter::doVarDecl(const VarDecl *decl) {
 
   if (decl->hasAttr<VKConstantIdAttr>()) {
     // This is a VarDecl for specialization constant.
-    createSpecConstant(decl);
+    createSpecConstant(decl,
+                       decl->getAttr<VKConstantIdAttr>()->getSpecConstId());
+    return;
+  }
+
+  if (const auto specId = getOptionSpecConstantId(decl)) {
+    // A static const global made a specialization constant on the command
+    // line, so that one module serves the permutations of its value.
+    createSpecConstant(decl, *specId);
+    optionSpecConstants.insert(decl);
     return;
   }
 
@@ -2434,7 +2598,9 @@ SpirvEvalInfo SPIRVEmitter::doCastExpr(const CastExpr *expr) {
 
     // Optimization: we can use OpConstantNull for cases where we want to
     // initialize an entire data structure to zeros.
-    if (evaluatesToConstZero(subExpr, astContext)) {
+    if (evaluatesToConstZero(subExpr, astContext) &&
+        (optionSpecConstants.empty() ||
+         !referencesOptionSpecConstant(subExpr))) {
       subExprId =
           theBuilder.getConstantNull(typeTranslator.translateType(toType));
       return SpirvEvalInfo(subExprId).setRValue().setConstant();
@@ -5923,7 +6089,31 @@ SpirvEvalInfo SPIRVEmitter::processEachVectorInMatrix(
   return SpirvEvalInfo(valId).setRValue();
 }
 
-void SPIRVEmitter::createSpecConstant(const VarDecl *varDecl) {
+llvm::Optional<uint32_t>
+SPIRVEmitter::getOptionSpecConstantId(const VarDecl *decl) {
+  if (optionSpecConstantIds.empty() || !decl->isFileVarDecl() ||
+      decl->getStorageClass() != SC_Static ||
+      !decl->getType().isConstQualified())
+    return llvm::None;
+  auto found = optionSpecConstantIds.find(decl->getName());
+  if (found == optionSpecConstantIds.end())
+    return llvm::None;
+  return found->second;
+}
+
+bool SPIRVEmitter::referencesOptionSpecConstant(const Expr *expr) {
+  if (const auto *declRefExpr = dyn_cast<DeclRefExpr>(expr))
+    if (const auto *varDecl = dyn_cast<VarDecl>(declRefExpr->getDecl()))
+      return optionSpecConstants.count(varDecl) != 0;
+  for (const Stmt *child : expr->children())
+    if (const auto *childExpr = dyn_cast_or_null<Expr>(child))
+      if (referencesOptionSpecConstant(childExpr))
+        return true;
+  return false;
+}
+
+void SPIRVEmitter::createSpecConstant(const VarDecl *varDecl,
+                                      uint32_t specId) {
   class SpecConstantEnvRAII {
   public:
     // Creates a new instance which sets mode to true on creation,
@@ -5939,7 +6129,9 @@ void SPIRVEmitter::createSpecConstant(const VarDecl *varDecl) {
 
   bool hasError = false;
 
-  if (!varDecl->isExternallyVisible()) {
+  // Static const globals named by -fvk-spec-constant are internal.
+  if (varDecl->hasAttr<VKConstantIdAttr>() &&
+      !varDecl->isExternallyVisible()) {
     emitError("specialization constant must be externally visible",
               varDecl->getLocation());
     hasError = true;
@@ -5982,8 +6174,7 @@ void SPIRVEmitter::createSpecConstant(const VarDecl *varDecl) {
   // We are not creating a variable to hold the spec constant, instead, we
   // translate the varDecl directly into the spec constant here.
 
-  theBuilder.decorateSpecId(
-      specConstant, varDecl->getAttr<VKConstantIdAttr>()->getSpecConstId());
+  theBuilder.decorateSpecId(specConstant, specId);
 
   declIdMapper.registerSpecConstant(varDecl, specConstant);
 }
@@ -9276,6 +9467,9 @@ uint32_t SPIRVEmitter::translateAPFloat(llvm::APFloat floatValue,
 }
 
 uint32_t SPIRVEmitter::tryToEvaluateAsConst(const Expr *expr) {
+  if (!optionSpecConstants.empty() && referencesOptionSpecConstant(expr))
+    return 0;
+
   Expr::EvalResult evalResult;
   if (expr->EvaluateAsRValue(evalResult, astContext) &&
       !evalResult.HasSideEffects) {
@@ -9314,6 +9508,23 @@ SPIRVEmitter::getSpirvShaderStage(const hlsl::ShaderModel &model) {
   llvm_unreachable("unknown shader model");
 }
 
+bool SPIRVEmitter::isExportedFunction(const FunctionDecl *decl) const {
+  if (!decl->hasBody() || decl->getStorageClass() == SC_Static ||
+      !decl->isExternallyVisible() || isa<CXXMethodDecl>(decl))
+    return false;
+  if (decl->hasAttr<HLSLExportAttr>())
+    return true;
+  switch (theCompilerInstance.getCodeGenOpts().DefaultLinkage) {
+  case hlsl::DXIL::DefaultLinkage::Default:
+    return shaderModel.GetMinor() == hlsl::ShaderModel::kOfflineMinor;
+  case hlsl::DXIL::DefaultLinkage::Internal:
+    return false;
+  case hlsl::DXIL::DefaultLinkage::External:
+    return true;
+  }
+  return true;
+}
+
 void SPIRVEmitter::AddRequiredCapabilitiesForShaderModel() {
   if (shaderModel.IsHS() || shaderModel.IsDS()) {
     theBuilder.requireCapability(spv::Capability::Tessellation);
@@ -9941,6 +10152,10 @@ void SPIRVEmitter::discoverAllCaseStmtInSwitchStmt(
       emitError(
           "non-32bit integer case value in switch statement unimplemented",
           caseExpr->getExprLoc());
+    if (!optionSpecConstants.empty() &&
+        referencesOptionSpecConstant(caseExpr))
+      emitError("specialization constant cannot be used as a case value",
+                caseExpr->getExprLoc());
     Expr::EvalResult evalResult;
     caseExpr->EvaluateAsRValue(evalResult, astContext);
     const int64_t value = evalResult.Val.getInt().getSExtValue();
@@ -10162,5 +10377,61 @@ void SPIRVEmitter::emitDebugLine(SourceLocation loc) {
   }
 }
 
+bool linkSpirvModules(const std::vector<std::vector<uint32_t>> &modules,
+                      const SpirvCodeGenOptions &options, bool createLibrary,
+                      unsigned optLevel, std::vector<uint32_t> *linked,
+                      std::string *messages) {
+  spv_target_env env = SPV_ENV_VULKAN_1_0;
+  if (options.targetEnv == "vulkan1.1") {
+    env = SPV_ENV_VULKAN_1_1;
+  } else if (options.targetEnv != "vulkan1.0") {
+    *messages += "unknown SPIR-V target environment '" +
+                 options.targetEnv.str() + "'\n";
+    return false;
+  }
+
+  spvtools::Context context(env);
+  context.SetMessageConsumer(
+      [messages](spv_message_level_t /*level*/, const char * /*source*/,
+                 const spv_position_t & /*position*/, const char *message) {
+        *messages += message;
+        *messages += '\n';
+      });
+  spvtools::LinkerOptions linkerOptions;
+  linkerOptions.SetCreateLibrary(createLibrary);
+  {
+    llvm::PhaseTimingRegion LinkPhase("link");
+    if (spvtools::Link(context, modules, linked, linkerOptions) != SPV_SUCCESS)
+      return false;
+  }
+  // A library is finished by the link that uses it.
+  if (createLibrary)
+    return true;
+
+  if (!options.codeGenHighLevel) {
+    // The modules were compiled without legalization, which needs the bodies
+    // of the functions they import to inline.
+    {
+      llvm::PhaseTimingRegion LegalizePhase("legalize");
+      if (!spirvToolsLegalize(env, linked, messages))
+        return false;
+    }
+    if (optLevel > 0) {
+      llvm::PhaseTimingRegion OptimizePhase("optimize");
+      if (!spirvToolsOptimize(env, linked, options.optConfig, messages))
+        return false;
+    }
+  }
+
+  if (!options.disableValidation) {
+    llvm::PhaseTimingRegion ValidationPhase("validation");
+    // Which of the modules needed relaxed logical pointers is not known here.
+    if (!spirvToolsValidate(env, options, /*relaxLogicalPointer*/ true, linked,
+                            messages))
+      return false;
+  }
+  return true;
+}
+
 } // end namespace spirv
 } // end namespace clang
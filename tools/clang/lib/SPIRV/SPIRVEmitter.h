@@ -29,8 +29,10 @@
 #include "clang/Frontend/CompilerInstance.h"
 #include "clang/SPIRV/FeatureManager.h"
 #include "clang/SPIRV/ModuleBuilder.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "DeclResultIdMapper.h"
 #include "SpirvEvalInfo.h"
@@ -45,7 +47,9 @@ namespace spirv {
 /// through the AST is done manually instead of using ASTConsumer's harness.
 class SPIRVEmitter : public ASTConsumer {
 public:
-  SPIRVEmitter(CompilerInstance &ci);
+  /// The module is written to the given stream, or to the compiler
+  /// instance's output stream if there is none.
+  SPIRVEmitter(CompilerInstance &ci, llvm::raw_ostream *out = nullptr);
 
   void HandleTranslationUnit(ASTContext &context) override;
 
@@ -73,6 +77,10 @@ public:
   uint32_t castToType(uint32_t value, QualType fromType, QualType toType,
                       SourceLocation);
 
+  /// Tries to evaluate the given Expr as a constant and returns the <result-id>
+  /// if success. Otherwise, returns 0.
+  uint32_t tryToEvaluateAsConst(const Expr *expr);
+
 private:
   void doFunctionDecl(const FunctionDecl *decl);
   void doVarDecl(const VarDecl *decl);
@@ -265,8 +273,17 @@ private:
       llvm::function_ref<uint32_t(uint32_t, uint32_t, uint32_t)>
           actOnEachVector);
 
-  /// Translates the given varDecl into a spec constant.
-  void createSpecConstant(const VarDecl *varDecl);
+  /// Translates the given varDecl into a spec constant with the given SpecId.
+  void createSpecConstant(const VarDecl *varDecl, uint32_t specId);
+
+  /// Returns the SpecId that -fvk-spec-constant gives the given variable, or
+  /// llvm::None if it isn't a static const global named there.
+  llvm::Optional<uint32_t> getOptionSpecConstantId(const VarDecl *decl);
+
+  /// Returns true if the given expression reads a variable that
+  /// -fvk-spec-constant made a spec constant. Such expressions must not be
+  /// folded, which would bake in the default value.
+  bool referencesOptionSpecConstant(const Expr *expr);
 
   /// Generates the necessary instructions for conducting the given binary
   /// operation on lhs and rhs.
@@ -535,10 +552,6 @@ private:
   /// given targetType.
   uint32_t translateAPFloat(llvm::APFloat floatValue, QualType targetType);
 
-  /// Tries to evaluate the given Expr as a constant and returns the <result-id>
-  /// if success. Otherwise, returns 0.
-  uint32_t tryToEvaluateAsConst(const Expr *expr);
-
   /// Tries to evaluate the given APFloat as a 32-bit float. If the evaluation
   /// can be performed without loss, it returns the <result-id> of the SPIR-V
   /// constant for that value. Returns zero otherwise.
@@ -565,6 +578,10 @@ private:
 
   void AddRequiredCapabilitiesForShaderModel();
 
+  /// Returns true if the given function of a library is exported, following
+  /// the rules of -default-linkage and the export keyword.
+  bool isExportedFunction(const FunctionDecl *decl) const;
+
   /// \brief Adds necessary execution modes for the hull/domain shaders based on
   /// the HLSL attributes of the entry point function.
   /// In the case of hull shaders, also writes the number of output control
@@ -921,6 +938,7 @@ private:
 
 private:
   CompilerInstance &theCompilerInstance;
+  llvm::raw_ostream *outStream;
   ASTContext &astContext;
   DiagnosticsEngine &diags;
 
@@ -959,6 +977,11 @@ private:
   /// all 32-bit scalar constants will be translated into OpSpecConstant.
   bool isSpecConstantMode;
 
+  /// The SpecIds given by -fvk-spec-constant, by variable name.
+  llvm::StringMap<uint32_t> optionSpecConstantIds;
+  /// The variables that -fvk-spec-constant made spec constants.
+  llvm::DenseSet<const VarDecl *> optionSpecConstants;
+
   /// Indicates that we have found a NonUniformResourceIndex call when
   /// traversing.
   /// This field is used to convery information in a bottom-up manner; if we
@@ -982,6 +1005,11 @@ private:
   /// Note: legalization specific code
   bool needsLegalization;
 
+  /// Whether the module exports or imports functions, which leaves it to be
+  /// linked through IDxcLinker before it is complete. Legalization,
+  /// optimization and validation then run on the linked module instead.
+  bool needsLinking;
+
   /// Mapping from methods to the decls to represent their implicit object
   /// parameters
   ///
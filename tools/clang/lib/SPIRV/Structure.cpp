@@ -10,6 +10,12 @@
 #include "clang/SPIRV/Structure.h"
 
 #include "BlockReadableOrder.h"
+#include "dxc/Support/Global.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
 
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
 #include "clang/Basic/Version.h"
@@ -26,6 +32,8 @@ namespace spirv {
 namespace {
 constexpr uint32_t kGeneratorNumber = 14;
 constexpr uint32_t kToolVersion = 0;
+/// Functions are serialized on several threads only when there are this many.
+constexpr uint32_t kMinFunctionsForParallelTake = 16;
 
 /// Chops the given original string into multiple smaller ones to make sure they
 /// can be encoded in a sequence of OpSourceContinued instructions following an
@@ -104,7 +112,7 @@ void BasicBlock::take(InstBuilder *builder) {
   builder->opLabel(labelId).x();
 
   for (auto &inst : instructions) {
-    builder->getConsumer()(inst.take());
+    builder->emit(inst.take());
   }
 
   clear();
@@ -212,14 +220,14 @@ Header::Header()
       generator((kGeneratorNumber << 16) | kToolVersion), bound(0),
       reserved(0) {}
 
-void Header::collect(const WordConsumer &consumer) {
+void Header::collect(InstBuilder *builder) {
   std::vector<uint32_t> words;
   words.push_back(magicNumber);
   words.push_back(version);
   words.push_back(generator);
   words.push_back(bound);
   words.push_back(reserved);
-  consumer(std::move(words));
+  builder->emit(std::move(words));
 }
 
 bool DebugName::operator==(const DebugName &that) const {
@@ -284,13 +292,11 @@ void SPIRVModule::clear() {
 }
 
 void SPIRVModule::take(InstBuilder *builder) {
-  const auto &consumer = builder->getConsumer();
-
   // Order matters here.
 
   if (spirvOptions.targetEnv == "vulkan1.1")
     header.version = 0x00010300u;
-  header.collect(consumer);
+  header.collect(builder);
 
   for (auto &cap : capabilities) {
     builder->opCapability(cap).x();
@@ -316,7 +322,7 @@ void SPIRVModule::take(InstBuilder *builder) {
   }
 
   for (auto &inst : executionModes) {
-    consumer(inst.take());
+    builder->emit(inst.take());
   }
 
   if (shaderModelVersion != 0) {
@@ -389,7 +395,7 @@ void SPIRVModule::take(InstBuilder *builder) {
   }
 
   for (const auto &idDecorPair : decorations) {
-    consumer(idDecorPair.second->withTargetId(idDecorPair.first));
+    builder->emit(idDecorPair.second->withTargetId(idDecorPair.first));
   }
 
   // Note on interdependence of types and constants:
@@ -399,20 +405,67 @@ void SPIRVModule::take(InstBuilder *builder) {
   // constant integer is defined.
 
   for (auto &v : typeConstant) {
-    consumer(v.take());
+    builder->emit(v.take());
   }
 
   for (auto &v : variables) {
-    consumer(v.take());
+    builder->emit(v.take());
   }
 
-  for (uint32_t i = 0; i < functions.size(); ++i) {
-    functions[i]->take(builder);
-  }
+  takeFunctions(builder);
 
   clear();
 }
 
+void SPIRVModule::takeFunctions(InstBuilder *builder) {
+  const uint32_t numFunctions = functions.size();
+  if (numFunctions < kMinFunctionsForParallelTake) {
+    for (uint32_t i = 0; i < numFunctions; ++i) {
+      functions[i]->take(builder);
+    }
+    return;
+  }
+
+  // All <result-id>s are assigned by now, so each function serializes on its
+  // own into its own words. They are then fed to the builder in the order of
+  // the functions, so the binary doesn't depend on the number of threads.
+  std::vector<std::vector<uint32_t>> words(numFunctions);
+  std::vector<std::exception_ptr> exceptions(numFunctions);
+  std::atomic<uint32_t> nextFunction(0);
+  IMalloc *pMalloc = DxcGetThreadMallocNoRef();
+  auto takeParallelFunctions = [&]() {
+    DxcThreadMalloc TM(pMalloc);
+    for (uint32_t i = nextFunction++; i < numFunctions; i = nextFunction++) {
+      try {
+        InstBuilder fnBuilder(&words[i]);
+        functions[i]->take(&fnBuilder);
+      } catch (...) {
+        exceptions[i] = std::current_exception();
+      }
+    }
+  };
+
+  const uint32_t numThreads =
+      std::min(std::max(std::thread::hardware_concurrency(), 1u),
+               numFunctions / kMinFunctionsForParallelTake + 1);
+  std::vector<std::thread> workers;
+  try {
+    for (uint32_t i = 1; i < numThreads; ++i)
+      workers.emplace_back(takeParallelFunctions);
+  } catch (...) {
+    // Serialize what the workers that did start leave on this thread.
+  }
+  takeParallelFunctions();
+  for (std::thread &worker : workers)
+    worker.join();
+
+  for (uint32_t i = 0; i < numFunctions; ++i) {
+    if (exceptions[i])
+      std::rethrow_exception(exceptions[i]);
+    builder->emit(std::move(words[i]));
+  }
+}
+
 void SPIRVModule::addType(const Type *type, uint32_t resultId) {
   bool inserted = false;
   std::tie(std::ignore, inserted) = types.insert(type);
@@ -1589,6 +1589,45 @@ void TypeTranslator::alignUsingHLSLRelaxedLayout(QualType fieldType,
 std::pair<uint32_t, uint32_t>
 TypeTranslator::getAlignmentAndSize(QualType type, SpirvLayoutRule rule,
                                     uint32_t *stride) {
+  // The result depends on the majorness recorded by an enclosing attributed
+  // type, so that is part of the key along with the type and rule.
+  unsigned majorness = 0;
+  if (typeMatMajorAttr.hasValue()) {
+    const bool rowMajor =
+        typeMatMajorAttr.getValue() == AttributedType::attr_hlsl_row_major;
+    majorness = rowMajor ? 1 : 2;
+  }
+  SPIRVContext &context = *theBuilder.getSPIRVContext();
+  if (const TypeLayout *layout = context.getTypeLayout(
+          type.getAsOpaquePtr(), static_cast<unsigned>(rule), majorness)) {
+    if (layout->hasStride && stride)
+      *stride = layout->stride;
+    if (layout->clearsMajorness)
+      typeMatMajorAttr = llvm::None;
+    return {layout->alignment, layout->size};
+  }
+
+  // Strides are only ever written, never read, so one the computation leaves
+  // alone keeps this value.
+  const uint32_t kNoStride = ~0u;
+  uint32_t computedStride = kNoStride;
+  const auto result = computeAlignmentAndSize(type, rule, &computedStride);
+  TypeLayout layout;
+  layout.alignment = result.first;
+  layout.size = result.second;
+  layout.stride = computedStride;
+  layout.hasStride = computedStride != kNoStride;
+  layout.clearsMajorness = majorness != 0 && !typeMatMajorAttr.hasValue();
+  context.setTypeLayout(type.getAsOpaquePtr(), static_cast<unsigned>(rule),
+                        majorness, layout);
+  if (layout.hasStride && stride)
+    *stride = layout.stride;
+  return result;
+}
+
+std::pair<uint32_t, uint32_t>
+TypeTranslator::computeAlignmentAndSize(QualType type, SpirvLayoutRule rule,
+                                        uint32_t *stride) {
   // std140 layout rules:
 
   // 1. If the member is a scalar consuming N basic machine units, the base
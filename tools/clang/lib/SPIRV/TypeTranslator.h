@@ -295,6 +295,14 @@ public:
   std::pair<uint32_t, uint32_t>
   getAlignmentAndSize(QualType type, SpirvLayoutRule rule, uint32_t *stride);
 
+private:
+  /// \brief Computes what getAlignmentAndSize returns, which records it in
+  /// the SPIRVContext for the type, rule and majorness in effect.
+  std::pair<uint32_t, uint32_t>
+  computeAlignmentAndSize(QualType type, SpirvLayoutRule rule,
+                          uint32_t *stride);
+
+public:
   /// \brief If a hint exists regarding the usage of literal types, it
   /// is returned. Otherwise, the given type itself is returned.
   /// The hint is the type on top of the intendedLiteralTypes stack. This is the
@@ -40,6 +40,7 @@
 #include "dxc/HLSL/HLOperations.h"
 #include "dxc/DXIL/DxilShaderModel.h"
 #include <array>
+#include <memory>
 #include <float.h>
 
 enum ArBasicKind {
@@ -2323,6 +2324,45 @@ public:
   }
 };
 
+static bool IntrinsicMatches(const HLSL_INTRINSIC &intrinsic, StringRef name,
+                             UINT numArgs) {
+  // Do some quick checks to verify size and name.
+  return intrinsic.uNumArgs == numArgs &&
+         name.equals(StringRef(intrinsic.pArgs[0].pName));
+}
+
+// 32-bit FNV-1a over the name and argument count, starting from the seed.
+// Must match hlsl_intrinsic_hash in hctdb_instrhelp.py.
+static uint32_t HashIntrinsicKey(StringRef name, UINT numArgs, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : name) {
+    hash = (hash ^ (uint8_t)c) * 16777619u;
+  }
+  hash = (hash ^ 0) * 16777619u;
+  hash = (hash ^ (uint8_t)numArgs) * 16777619u;
+  return hash;
+}
+
+static const HLSL_INTRINSIC_INDEX *FindIntrinsicIndex(const HLSL_INTRINSIC *table) {
+  for (const HLSL_INTRINSIC_INDEX &index : g_IntrinsicIndices) {
+    if (index.pTable == table)
+      return &index;
+  }
+  return nullptr;
+}
+
+// Returns the first entry matching the name and argument count, or nullptr.
+static const HLSL_INTRINSIC *LookupIntrinsicIndex(const HLSL_INTRINSIC_INDEX &index,
+                                                  StringRef name, UINT numArgs) {
+  uint32_t bucket = HashIntrinsicKey(name, numArgs, 0) % index.uNumDisplacements;
+  uint32_t slot = HashIntrinsicKey(name, numArgs, index.pDisplacements[bucket]) &
+                  index.uSlotMask;
+  WORD entry = index.pSlots[slot];
+  if (entry == 0xFFFF || !IntrinsicMatches(index.pTable[entry], name, numArgs))
+    return nullptr;
+  return &index.pTable[entry];
+}
+
 /// <summary>
 /// Use this class to iterate over intrinsic definitions that have the same name and parameter count.
 /// </summary>
@@ -2719,6 +2759,10 @@ TypedefDecl *CreateGlobalTypedef(ASTContext* context, const char* ident, QualTyp
   return decl;
 }
 
+// Flattened type as runs of consecutive elements of one type, in the order that
+// FlattenedTypeIterator visits them.
+typedef llvm::SmallVector<std::pair<QualType, unsigned>, 4> FlattenedTypeLayout;
+
 class HLSLExternalSource : public ExternalSemaSource {
 private:
   // Inner types.
@@ -2777,9 +2821,14 @@ private:
   ObjectTypeDeclMapType m_objectTypeDeclsMap;
   // Mask for object which not has methods created.
   uint64_t m_objectTypeLazyInitMask;
+  // Alias for SamplerState, declared on demand.
+  TypedefDecl* m_samplerTypedef;
 
   UsedIntrinsicStore m_usedIntrinsics;
 
+  // Flattened layouts already built, by type.
+  llvm::DenseMap<void*, std::unique_ptr<FlattenedTypeLayout>> m_flattenedTypeLayouts;
+
   /// <summary>Add all base QualTypes for each hlsl scalar types.</summary>
   void AddBaseTypes();
 
@@ -3152,6 +3201,9 @@ private:
   };
 
   int FindObjectBasicKindIndex(const CXXRecordDecl* recordDecl) {
+    // Object types not declared yet have null entries.
+    if (recordDecl == nullptr)
+      return -1;
     auto begin = m_objectTypeDeclsMap.begin();
     auto end = m_objectTypeDeclsMap.end();
     auto val = std::make_pair(const_cast<CXXRecordDecl*>(recordDecl), 0);
@@ -3164,110 +3216,152 @@ private:
       return -1;
   }
 
-  // Adds all built-in HLSL object types.
+  // Returns the index in g_ArBasicKindsAsTypes of the object type with the
+  // given name, or -1 if there is none.
+  static int FindObjectTypeIndexByName(StringRef name) {
+    for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
+      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+      if (kind != AR_OBJECT_WAVE && kind != AR_OBJECT_LEGACY_EFFECT &&
+          name.equals(g_ArBasicTypeNames[kind]))
+        return i;
+    }
+    return -1;
+  }
+
+  // Returns the declaration of a built-in HLSL object type, declaring it the
+  // first time it's needed; methods are added later still, when the type is
+  // first used as an object.
+  CXXRecordDecl* GetOrCreateObjectTypeDecl(unsigned i)
+  {
+    DXASSERT_NOMSG(i < _countof(g_ArBasicKindsAsTypes));
+    if (m_objectTypeDecls[i] != nullptr)
+      return m_objectTypeDecls[i];
+
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
+      return nullptr;
+    }
+
+    DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
+    _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
+    const char* typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    CXXRecordDecl* recordDecl = nullptr;
+    if (kind == AR_OBJECT_RAY_DESC) {
+      QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
+      recordDecl = CreateRayDescStruct(*m_context, float3Ty);
+    } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
+      QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
+      recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
+    } else if (IsSubobjectBasicKind(kind)) {
+      switch (kind) {
+      case AR_OBJECT_STATE_OBJECT_CONFIG:
+        recordDecl = CreateSubobjectStateObjectConfig(*m_context);
+        break;
+      case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, true);
+        break;
+      case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
+        recordDecl = CreateSubobjectRootSignature(*m_context, false);
+        break;
+      case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
+        recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
+        break;
+        break;
+      case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
+        recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
+        break;
+      case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
+        recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
+        break;
+      case AR_OBJECT_TRIANGLE_HIT_GROUP:
+        recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
+        break;
+      case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
+        recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
+        break;
+      }
+    }
+    else if (templateArgCount == 0)
+    {
+      AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
+      DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
+      recordDecl->setImplicit(true);
+    }
+    else
+    {
+      DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
+
+      ClassTemplateDecl* typeDecl = nullptr;
+      TypeSourceInfo* typeDefault = nullptr;
+      if (TemplateHasDefaultType(kind)) {
+        QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
+        typeDefault = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
+      }
+      AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
+      DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
+      typeDecl->setImplicit(true);
+      recordDecl->setImplicit(true);
+    }
+    m_objectTypeDecls[i] = recordDecl;
+
+    // Take over the null entry reserved for this type and keep the map sorted.
+    auto entry = std::find(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(),
+                           std::make_pair((CXXRecordDecl*)nullptr, i));
+    DXASSERT(entry != m_objectTypeDeclsMap.end(), "otherwise the map wasn't reserved for this type");
+    entry->first = recordDecl;
+    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
+
+    for (auto && intrinsic : m_intrinsicTables) {
+      AddIntrinsicTableMethods(intrinsic, i);
+    }
+    m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+    return recordDecl;
+  }
+
+  // Sets up the built-in HLSL object types. Most are declared on demand; only
+  // the deprecated effect object names are declared here.
   void AddObjectTypes()
   {
     DXASSERT(m_context != nullptr, "otherwise caller hasn't initialized context yet");
 
-    QualType float4Type = LookupVectorType(HLSLScalarType_float, 4);
-    TypeSourceInfo *float4TypeSourceInfo = m_context->getTrivialTypeSourceInfo(float4Type, NoLoc);
     m_objectTypeLazyInitMask = 0;
     unsigned effectKindIndex = 0;
     for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++)
     {
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      if (kind == AR_OBJECT_WAVE) { // wave objects are currently unused
-        continue;
-      }
-      if (kind == AR_OBJECT_LEGACY_EFFECT)
+      if (g_ArBasicKindsAsTypes[i] == AR_OBJECT_LEGACY_EFFECT)
         effectKindIndex = i;
+      m_objectTypeDecls[i] = nullptr;
+      m_objectTypeDeclsMap[i] = std::make_pair((CXXRecordDecl*)nullptr, i);
+    }
 
-      DXASSERT(kind < _countof(g_ArBasicTypeNames), "g_ArBasicTypeNames has the wrong number of entries");
-      _Analysis_assume_(kind < _countof(g_ArBasicTypeNames));
-      const char* typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      CXXRecordDecl* recordDecl = nullptr;
-      if (kind == AR_OBJECT_RAY_DESC) {
-        QualType float3Ty = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 3);
-        recordDecl = CreateRayDescStruct(*m_context, float3Ty);
-      } else if (kind == AR_OBJECT_TRIANGLE_INTERSECTION_ATTRIBUTES) {
-        QualType float2Type = LookupVectorType(HLSLScalarType::HLSLScalarType_float, 2);
-        recordDecl = AddBuiltInTriangleIntersectionAttributes(*m_context, float2Type);
-      } else if (IsSubobjectBasicKind(kind)) {
-        switch (kind) {
-        case AR_OBJECT_STATE_OBJECT_CONFIG:
-          recordDecl = CreateSubobjectStateObjectConfig(*m_context);
-          break;
-        case AR_OBJECT_GLOBAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, true);
-          break;
-        case AR_OBJECT_LOCAL_ROOT_SIGNATURE:
-          recordDecl = CreateSubobjectRootSignature(*m_context, false);
-          break;
-        case AR_OBJECT_SUBOBJECT_TO_EXPORTS_ASSOC:
-          recordDecl = CreateSubobjectSubobjectToExportsAssoc(*m_context);
-          break;
-          break;
-        case AR_OBJECT_RAYTRACING_SHADER_CONFIG:
-          recordDecl = CreateSubobjectRaytracingShaderConfig(*m_context);
-          break;
-        case AR_OBJECT_RAYTRACING_PIPELINE_CONFIG:
-          recordDecl = CreateSubobjectRaytracingPipelineConfig(*m_context);
-          break;
-        case AR_OBJECT_TRIANGLE_HIT_GROUP:
-          recordDecl = CreateSubobjectTriangleHitGroup(*m_context);
-          break;
-        case AR_OBJECT_PROCEDURAL_PRIMITIVE_HIT_GROUP:
-          recordDecl = CreateSubobjectProceduralPrimitiveHitGroup(*m_context);
-          break;
-        }
-      }
-      else if (templateArgCount == 0)
-      {
-        AddRecordTypeWithHandle(*m_context, &recordDecl, typeName);
-        DXASSERT(recordDecl != nullptr, "AddRecordTypeWithHandle failed to return the object declaration");
-        recordDecl->setImplicit(true);
-      }
-      else
-      {
-        DXASSERT(templateArgCount == 1 || templateArgCount == 2, "otherwise a new case has been added");
-
-        ClassTemplateDecl* typeDecl = nullptr;
-        TypeSourceInfo* typeDefault = TemplateHasDefaultType(kind) ? float4TypeSourceInfo : nullptr;
-        AddTemplateTypeWithHandle(*m_context, &typeDecl, &recordDecl, typeName, templateArgCount, typeDefault);
-        DXASSERT(typeDecl != nullptr, "AddTemplateTypeWithHandle failed to return the object declaration");
-        typeDecl->setImplicit(true);
-        recordDecl->setImplicit(true);
-      }
-      m_objectTypeDecls[i] = recordDecl;
-      m_objectTypeDeclsMap[i] = std::make_pair(recordDecl, i);
-      m_objectTypeLazyInitMask |= ((uint64_t)1)<<i;
+    // Create decls for each deprecated effect object type:
+    DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
+    unsigned effectObjBase = _countof(g_ArBasicKindsAsTypes);
+    for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
+      IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
+      CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
+      currentDeclContext->addDecl(effectObjDecl);
+      effectObjDecl->setImplicit(true);
+      m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
     }
 
-    // Create an alias for SamplerState. 'sampler' is very commonly used.
-    {
+    // Make sure it's in order.
+    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
+  }
+
+  // Creates the 'sampler' alias for SamplerState the first time it's looked
+  // up. 'sampler' is very commonly used.
+  TypedefDecl* GetSamplerTypedef() {
+    if (m_samplerTypedef == nullptr) {
       DeclContext* currentDeclContext = m_context->getTranslationUnitDecl();
       IdentifierInfo& samplerId = m_context->Idents.get(StringRef("sampler"), tok::TokenKind::identifier);
       TypeSourceInfo* samplerTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_SAMPLER));
-      TypedefDecl* samplerDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
-      currentDeclContext->addDecl(samplerDecl);
-      samplerDecl->setImplicit(true);
-
-      // Create decls for each deprecated effect object type:
-      unsigned effectObjBase = _countof(g_ArBasicKindsAsTypes);
-      // TypeSourceInfo* effectObjTypeSource = m_context->getTrivialTypeSourceInfo(GetBasicKindType(AR_OBJECT_LEGACY_EFFECT));
-      for (unsigned i = 0; i < _countof(g_DeprecatedEffectObjectNames); i++) {
-        IdentifierInfo& idInfo = m_context->Idents.get(StringRef(g_DeprecatedEffectObjectNames[i]), tok::TokenKind::identifier);
-        //TypedefDecl* effectObjDecl = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &idInfo, effectObjTypeSource);
-        CXXRecordDecl *effectObjDecl = CXXRecordDecl::Create(*m_context, TagTypeKind::TTK_Struct, currentDeclContext, NoLoc, NoLoc, &idInfo);
-        currentDeclContext->addDecl(effectObjDecl);
-        effectObjDecl->setImplicit(true);
-        m_objectTypeDeclsMap[i+effectObjBase] = std::make_pair(effectObjDecl, effectKindIndex);
-      }
+      m_samplerTypedef = TypedefDecl::Create(*m_context, currentDeclContext, NoLoc, NoLoc, &samplerId, samplerTypeSource);
+      currentDeclContext->addDecl(m_samplerTypedef);
+      m_samplerTypedef->setImplicit(true);
     }
-
-    // Make sure it's in order.
-    std::sort(m_objectTypeDeclsMap.begin(), m_objectTypeDeclsMap.end(), ObjectTypeDeclMapTypeCmp);
+    return m_samplerTypedef;
   }
 
   FunctionDecl* AddSubscriptSpecialization(
@@ -3321,7 +3415,8 @@ public:
     m_vectorTemplateDecl(nullptr),
     m_context(nullptr),
     m_sema(nullptr),
-    m_hlslStringTypedef(nullptr)
+    m_hlslStringTypedef(nullptr),
+    m_samplerTypedef(nullptr)
   {
     memset(m_matrixTypes, 0, sizeof(m_matrixTypes));
     memset(m_matrixShorthandTypes, 0, sizeof(m_matrixShorthandTypes));
@@ -3352,9 +3447,6 @@ public:
 
     AddObjectTypes();
     AddStdIsEqualImplementation(S.getASTContext(), S);
-    for (auto && intrinsic : m_intrinsicTables) {
-      AddIntrinsicTableMethods(intrinsic);
-    }
   }
 
   void ForgetSema() override
@@ -3524,8 +3616,22 @@ public:
       }
       return true;
     }
+    // built-in object types, declared the first time they're looked up
+    int objectIndex = FindObjectTypeIndexByName(nameIdentifier);
+    if (objectIndex != -1) {
+      CXXRecordDecl *recordDecl = GetOrCreateObjectTypeDecl(objectIndex);
+      if (ClassTemplateDecl *templateDecl = recordDecl->getDescribedClassTemplate())
+        R.addDecl(templateDecl);
+      else
+        R.addDecl(recordDecl);
+      return true;
+    }
+    if (nameIdentifier.equals("sampler")) {
+      R.addDecl(GetSamplerTypedef());
+      return true;
+    }
     // string
-    else if (TryParseString(nameIdentifier.data(), nameIdentifier.size(), getSema()->getLangOpts())) {
+    if (TryParseString(nameIdentifier.data(), nameIdentifier.size(), getSema()->getLangOpts())) {
       TypedefDecl *strDecl = GetStringTypedef();
       R.addDecl(strDecl);
     }
@@ -3758,38 +3864,45 @@ public:
     return AR_BASIC_UNKNOWN;
   }
 
+  // Adds the methods from an intrinsic table to the declared object type at
+  // the given index in g_ArBasicKindsAsTypes.
+  void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table, unsigned i) {
+    DXASSERT_NOMSG(table != nullptr);
+
+    // Grab information already processed by GetOrCreateObjectTypeDecl.
+    ArBasicKind kind = g_ArBasicKindsAsTypes[i];
+    const char *typeName = g_ArBasicTypeNames[kind];
+    uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
+    DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
+    int startDepth = (templateArgCount == 0) ? 0 : 1;
+    CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
+    DXASSERT_NOMSG(recordDecl != nullptr);
+
+    // This is a variation of AddObjectMethods using the new table.
+    const HLSL_INTRINSIC *pIntrinsic = nullptr;
+    const HLSL_INTRINSIC *pPrior = nullptr;
+    UINT64 lookupCookie = 0;
+    CA2W wideTypeName(typeName);
+    HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    while (pIntrinsic != nullptr && SUCCEEDED(found)) {
+      if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
+        AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
+        // NOTE: this only works with the current implementation because
+        // intrinsics are alive as long as the table is alive.
+        pPrior = pIntrinsic;
+      }
+      found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
+    }
+  }
+
   void AddIntrinsicTableMethods(_In_ IDxcIntrinsicTable *table) {
     DXASSERT_NOMSG(table != nullptr);
 
     // Function intrinsics are added on-demand, objects get template methods.
+    // Object types declared later get them when they're declared.
     for (unsigned i = 0; i < _countof(g_ArBasicKindsAsTypes); i++) {
-      // Grab information already processed by AddObjectTypes.
-      ArBasicKind kind = g_ArBasicKindsAsTypes[i];
-      const char *typeName = g_ArBasicTypeNames[kind];
-      uint8_t templateArgCount = g_ArBasicKindsTemplateCount[i];
-      DXASSERT(templateArgCount <= 2, "otherwise a new case has been added");
-      int startDepth = (templateArgCount == 0) ? 0 : 1;
-      CXXRecordDecl *recordDecl = m_objectTypeDecls[i];
-      if (recordDecl == nullptr) {
-        DXASSERT(kind == AR_OBJECT_WAVE, "else objects other than reserved not initialized");
-        continue;
-      }
-
-      // This is a variation of AddObjectMethods using the new table.
-      const HLSL_INTRINSIC *pIntrinsic = nullptr;
-      const HLSL_INTRINSIC *pPrior = nullptr;
-      UINT64 lookupCookie = 0;
-      CA2W wideTypeName(typeName);
-      HRESULT found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      while (pIntrinsic != nullptr && SUCCEEDED(found)) {
-        if (!AreIntrinsicTemplatesEquivalent(pIntrinsic, pPrior)) {
-          AddObjectIntrinsicTemplate(recordDecl, startDepth, pIntrinsic);
-          // NOTE: this only works with the current implementation because
-          // intrinsics are alive as long as the table is alive.
-          pPrior = pIntrinsic;
-        }
-        found = table->LookupIntrinsic(wideTypeName, L"*", &pIntrinsic, &lookupCookie);
-      }
+      if (m_objectTypeDecls[i] != nullptr)
+        AddIntrinsicTableMethods(table, i);
     }
   }
 
@@ -3910,7 +4023,7 @@ public:
         const ArBasicKind* match = std::find(g_ArBasicKindsAsTypes, &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], kind);
         DXASSERT(match != &g_ArBasicKindsAsTypes[_countof(g_ArBasicKindsAsTypes)], "otherwise can't find constant in basic kinds");
         size_t index = match - g_ArBasicKindsAsTypes;
-        return m_context->getTagDeclType(this->m_objectTypeDecls[index]);
+        return m_context->getTagDeclType(GetOrCreateObjectTypeDecl(index));
     }
 
     case AR_OBJECT_SAMPLER1D:
@@ -4034,30 +4147,26 @@ public:
     StringRef nameIdentifier,
     size_t argumentCount)
   {
-    // This is implemented by a linear scan for now.
-    // We tested binary search on tables, and there was no performance gain on
-    // samples probably for the following reasons.
-    // 1. The tables are not big enough to make noticable difference
-    // 2. The user of this function assumes that it returns the first entry in
-    // the table that matches name and argument count. So even in the binary
-    // search, we have to scan backwards until the entry does not match the name
-    // or arg count. For linear search this is not a problem
-    for (unsigned int i = 0; i < tableSize; i++) {
-      const HLSL_INTRINSIC* pIntrinsic = &table[i];
-
-      // Do some quick checks to verify size and name.
-      if (pIntrinsic->uNumArgs != 1 + argumentCount) {
-        continue;
-      }
-      if (!nameIdentifier.equals(StringRef(pIntrinsic->pArgs[0].pName))) {
-        continue;
+    // Entries with the same name and argument count are adjacent, and the
+    // generated index maps each such run to its first entry.
+    const HLSL_INTRINSIC *pIntrinsic = nullptr;
+    if (const HLSL_INTRINSIC_INDEX *pIndex = FindIntrinsicIndex(table)) {
+      pIntrinsic = LookupIntrinsicIndex(*pIndex, nameIdentifier, 1 + argumentCount);
+    }
+    else {
+      // Fall back to a linear scan for tables without an index.
+      for (unsigned int i = 0; i < tableSize; i++) {
+        if (IntrinsicMatches(table[i], nameIdentifier, 1 + argumentCount)) {
+          pIntrinsic = &table[i];
+          break;
+        }
       }
-
-      return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
-        IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
+    }
+    if (pIntrinsic == nullptr) {
+      pIntrinsic = table + tableSize;
     }
 
-    return IntrinsicDefIter::CreateStart(table, tableSize, table + tableSize,
+    return IntrinsicDefIter::CreateStart(table, tableSize, pIntrinsic,
       IntrinsicTableDefIter::CreateStart(m_intrinsicTables, typeName, nameIdentifier, argumentCount));
   }
 
@@ -4162,6 +4271,10 @@ public:
   /// <summary>Checks whether the specified type is numeric or composed of numeric elements exclusively.</summary>
   bool IsTypeNumeric(QualType type, _Out_ UINT* count);
 
+  /// <summary>Gets the flattened layout of the specified type, building it on first use.</summary>
+  /// <returns>The layout; nullptr if the type must be flattened with a FlattenedTypeIterator instead.</returns>
+  const FlattenedTypeLayout* GetFlattenedTypeLayout(QualType type, unsigned depth = 0);
+
   /// <summary>Checks whether the specified type is a scalar type.</summary>
   bool IsScalarType(const QualType& type) {
     DXASSERT(!type.isNull(), "caller should validate its type is initialized");
@@ -4864,6 +4977,10 @@ public:
   static ComparisonResult CompareIterators(
     HLSLExternalSource& source, SourceLocation loc,
     FlattenedTypeIterator& leftIter, FlattenedTypeIterator& rightIter);
+  // Compares flattened layouts as CompareIterators compares the iterators of their types.
+  static ComparisonResult CompareLayouts(
+    HLSLExternalSource& source, SourceLocation loc,
+    const FlattenedTypeLayout& left, const FlattenedTypeLayout& right);
   static ComparisonResult CompareTypes(
     HLSLExternalSource& source,
     SourceLocation leftLoc, SourceLocation rightLoc,
@@ -6926,6 +7043,18 @@ bool HLSLExternalSource::IsTypeNumeric(QualType type, UINT* count)
     }
     return false;
   case AR_TOBJ_COMPOUND:
+    if (const FlattenedTypeLayout* layout = GetFlattenedTypeLayout(type)) {
+      if (layout->empty()) {
+        return false; // empty struct.
+      }
+      for (const auto& run : *layout) {
+        if (!IsTypeNumeric(run.first, &subCount)) {
+          return false;
+        }
+        *count += subCount * run.second;
+      }
+      return true;
+    }
     {
       UINT maxCount = 0;
       { // Determine maximum count to prevent infinite loop on incomplete array
@@ -9081,6 +9210,125 @@ void HLSLExternalSource::ReportUnsupportedTypeNesting(SourceLocation loc, QualTy
   m_sema->Diag(loc, diag::err_hlsl_unsupported_type_nesting) << type;
 }
 
+// Appends count elements of the specified type, extending the last run if it
+// has the same type.
+static void AppendFlattenedRun(FlattenedTypeLayout& layout, QualType type, unsigned count)
+{
+  if (!layout.empty() && layout.back().first == type)
+    layout.back().second += count;
+  else
+    layout.push_back(std::make_pair(type, count));
+}
+
+const FlattenedTypeLayout* HLSLExternalSource::GetFlattenedTypeLayout(QualType type, unsigned depth)
+{
+  // Well under the depth at which FlattenedTypeIterator reports nesting, as it
+  // may take two levels for each of these; deeper types go to the iterator,
+  // which diagnoses them. So do incomplete arrays, which have no fixed length,
+  // and types that aren't complete yet, whose layout may still change.
+  static const unsigned MaxLayoutDepth = 32;
+  // Arrays of structs of mixed elements repeat their runs; past this many,
+  // iterating is as fast.
+  static const size_t MaxLayoutRuns = 4096;
+
+  if (depth > MaxLayoutDepth || type.isNull() || type->isDependentType())
+    return nullptr;
+  auto found = m_flattenedTypeLayouts.find(type.getAsOpaquePtr());
+  if (found != m_flattenedTypeLayouts.end())
+    return found->second.get();
+
+  std::unique_ptr<FlattenedTypeLayout> layout(new FlattenedTypeLayout());
+  if (!type->isVoidType() && !type->isFunctionType()) {
+    const RecordType* recordType = nullptr;
+    bool hasBases = false;
+    switch (GetTypeObjectKind(type)) {
+    case ArTypeObjectKind::AR_TOBJ_ARRAY: {
+      unsigned int elementCount = GetArraySize(type);
+      if (elementCount == 0) {
+        if (type->isIncompleteArrayType())
+          return nullptr;
+        break;
+      }
+      // Homogeneous arrays are a single run however long they are.
+      const FlattenedTypeLayout* elementLayout = GetFlattenedTypeLayout(
+          type->getAsArrayTypeUnsafe()->getElementType(), depth + 1);
+      if (elementLayout == nullptr)
+        return nullptr;
+      if (elementLayout->size() == 1) {
+        AppendFlattenedRun(*layout, elementLayout->front().first,
+                           elementLayout->front().second * elementCount);
+        break;
+      }
+      if (elementLayout->size() * elementCount > MaxLayoutRuns)
+        return nullptr;
+      for (unsigned int i = 0; i < elementCount; ++i) {
+        for (const auto& run : *elementLayout)
+          AppendFlattenedRun(*layout, run.first, run.second);
+      }
+      break;
+    }
+    case ArTypeObjectKind::AR_TOBJ_BASIC:
+      AppendFlattenedRun(*layout, type, 1);
+      break;
+    case ArTypeObjectKind::AR_TOBJ_MATRIX:
+      AppendFlattenedRun(*layout, GetMatrixOrVectorElementType(type), GetElementCount(type));
+      break;
+    case ArTypeObjectKind::AR_TOBJ_VECTOR:
+      AppendFlattenedRun(*layout, GetMatrixOrVectorElementType(type), GetHLSLVecSize(type));
+      break;
+    case ArTypeObjectKind::AR_TOBJ_OBJECT:
+      if (!IsSubobjectType(type)) {
+        AppendFlattenedRun(*layout, type.getCanonicalType(), 1);
+        break;
+      }
+      recordType = type->getAsStructureType();
+      break;
+    case ArTypeObjectKind::AR_TOBJ_STRING:
+      AppendFlattenedRun(*layout, type.getCanonicalType(), 1);
+      break;
+    case ArTypeObjectKind::AR_TOBJ_COMPOUND:
+      recordType = type->getAsStructureType();
+      if (recordType == nullptr)
+        recordType = dyn_cast<RecordType>(type.getTypePtr());
+      hasBases = true;
+      break;
+    default:
+      return nullptr;
+    }
+
+    // Bases come first, then fields, as FlattenedTypeIterator visits them;
+    // subobjects only have fields.
+    if (recordType != nullptr) {
+      RecordDecl* recordDecl = recordType->getDecl();
+      if (!recordDecl->isCompleteDefinition())
+        return nullptr;
+      CXXRecordDecl* cxxRecordDecl = dyn_cast<CXXRecordDecl>(recordDecl);
+      if (hasBases && cxxRecordDecl != nullptr) {
+        for (const CXXBaseSpecifier& base : cxxRecordDecl->bases()) {
+          const FlattenedTypeLayout* baseLayout = GetFlattenedTypeLayout(base.getType(), depth + 1);
+          if (baseLayout == nullptr)
+            return nullptr;
+          for (const auto& run : *baseLayout)
+            AppendFlattenedRun(*layout, run.first, run.second);
+        }
+      }
+      for (const FieldDecl* field : recordDecl->fields()) {
+        const FlattenedTypeLayout* fieldLayout = GetFlattenedTypeLayout(field->getType(), depth + 1);
+        if (fieldLayout == nullptr)
+          return nullptr;
+        for (const auto& run : *fieldLayout)
+          AppendFlattenedRun(*layout, run.first, run.second);
+      }
+      if (layout->size() > MaxLayoutRuns)
+        return nullptr;
+    }
+  }
+
+  const FlattenedTypeLayout* result = layout.get();
+  m_flattenedTypeLayouts[type.getAsOpaquePtr()] = std::move(layout);
+  return result;
+}
+
 bool HLSLExternalSource::TryStaticCastForHLSL(ExprResult &SrcExpr,
   QualType DestType,
   Sema::CheckedConversionKind CCK,
@@ -10181,8 +10429,6 @@ bool FlattenedTypeIterator::pushTrackerForExpression(MultiExprArg::iterator expr
   return pushTrackerForType(e->getType(), expression);
 }
 
-// TODO: improve this to provide a 'peek' at intermediate types,
-// which should help compare struct foo[1000] to avoid 1000 steps + per-field steps
 bool FlattenedTypeIterator::pushTrackerForType(QualType type, MultiExprArg::iterator expression)
   {
   if (type->isVoidType()) {
@@ -10362,12 +10608,81 @@ FlattenedTypeIterator::CompareIterators(
   return result;
 }
 
+FlattenedTypeIterator::ComparisonResult
+FlattenedTypeIterator::CompareLayouts(
+  HLSLExternalSource& source,
+  SourceLocation loc,
+  const FlattenedTypeLayout& left,
+  const FlattenedTypeLayout& right)
+{
+  FlattenedTypeIterator::ComparisonResult result;
+  result.LeftCount = 0;
+  result.RightCount = 0;
+  result.AreElementsEqual = true; // Until proven otherwise.
+  result.CanConvertElements = true; // Until proven otherwise.
+
+  // Whether each pair of element types converts, checked once per pair.
+  llvm::DenseMap<std::pair<void*, void*>, bool> canConvert;
+  const FlattenedTypeLayout::value_type* leftRun = left.begin();
+  const FlattenedTypeLayout::value_type* rightRun = right.begin();
+  unsigned int leftPending = leftRun != left.end() ? leftRun->second : 0;
+  unsigned int rightPending = rightRun != right.end() ? rightRun->second : 0;
+  while (leftRun != left.end() && rightRun != right.end())
+  {
+    QualType leftType = leftRun->first;
+    QualType rightType = rightRun->first;
+    auto key = std::make_pair(leftType.getAsOpaquePtr(), rightType.getAsOpaquePtr());
+    auto converts = canConvert.find(key);
+    if (converts == canConvert.end()) {
+      StmtExpr scratchExpr(nullptr, rightType, NoLoc, NoLoc);
+      StandardConversionSequence standard;
+      bool canConvertPair = source.CanConvert(loc, &scratchExpr, leftType,
+                                              ExplicitConversionFalse, nullptr,
+                                              &standard);
+      converts = canConvert.insert(std::make_pair(key, canConvertPair)).first;
+    }
+    if (!converts->second) {
+      result.AreElementsEqual = false;
+      result.CanConvertElements = false;
+      break;
+    }
+
+    if (rightType->getCanonicalTypeUnqualified() !=
+        leftType->getCanonicalTypeUnqualified())
+    {
+      result.AreElementsEqual = false;
+    }
+
+    unsigned int advance = std::min(leftPending, rightPending);
+    leftPending -= advance;
+    rightPending -= advance;
+    if (leftPending == 0 && ++leftRun != left.end())
+      leftPending = leftRun->second;
+    if (rightPending == 0 && ++rightRun != right.end())
+      rightPending = rightRun->second;
+  }
+
+  for (const auto& run : left)
+    result.LeftCount += run.second;
+  for (const auto& run : right)
+    result.RightCount += run.second;
+
+  return result;
+}
+
 FlattenedTypeIterator::ComparisonResult
 FlattenedTypeIterator::CompareTypes(
   HLSLExternalSource& source,
   SourceLocation leftLoc, SourceLocation rightLoc,
   QualType left, QualType right)
 {
+  // Types with layouts compare by runs of elements, not element by element.
+  const FlattenedTypeLayout* leftLayout = source.GetFlattenedTypeLayout(left);
+  const FlattenedTypeLayout* rightLayout =
+      leftLayout ? source.GetFlattenedTypeLayout(right) : nullptr;
+  if (rightLayout != nullptr)
+    return CompareLayouts(source, leftLoc, *leftLayout, *rightLayout);
+
   FlattenedTypeIterator leftIter(leftLoc, left, source);
   FlattenedTypeIterator rightIter(rightLoc, right, source);
 
@@ -5811,3 +5811,404 @@ static const int g_MaxIntrinsicName = 32; // Count of characters for longest int
 static const int g_MaxIntrinsicParamName = 48; // Count of characters for longest intrinsic parameter name - 'MultiplierForGeometryContributionToHitGroupIndex'
 static const int g_MaxIntrinsicParamCount = 8; // Count of parameters (without return) for longest intrinsic argument list - 'TraceRay'
 // HLSL-INTRINSIC-STATS:END
+
+/* <py::lines('HLSL-INTRINSIC-INDEX')>hctdb_instrhelp.get_hlsl_intrinsic_index()</py>*/
+// HLSL-INTRINSIC-INDEX:BEGIN
+static const WORD g_Intrinsics_Displacements[] =
+{
+    1, 0, 1, 1, 1, 1, 1, 3, 2, 2, 2, 1, 3, 1, 5, 1,
+    1, 2, 0, 1, 1, 2, 1, 0, 2, 1, 1, 0, 0, 3, 3, 1,
+    0, 1, 1, 0, 0, 2, 1, 1, 3, 1, 3, 1, 2, 1, 1, 1,
+    2, 1, 2, 2, 0, 0, 4, 1, 0, 2, 1, 1, 1, 1, 1, 0,
+    3, 2, 0, 3, 1, 1, 2, 3, 4, 7, 1, 2, 5, 1, 1, 1,
+    1, 1, 3, 0, 2, 1, 1, 2, 1, 2, 2, 1, 1, 1, 1, 0,
+    1, 0, 1, 1, 1,
+};
+
+static const WORD g_Intrinsics_Slots[] =
+{
+    95, 65535, 81, 65535, 115, 65535, 71, 76, 203, 65535, 65535, 65535, 75, 147, 88, 150,
+    78, 65535, 125, 65535, 65535, 65535, 16, 65535, 65535, 65535, 65535, 65535, 65535, 167, 117, 65535,
+    65535, 65535, 65535, 65535, 65535, 65535, 65535, 173, 65535, 144, 65535, 119, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 141, 65535, 65535, 65535, 65535, 200, 97, 65535, 65535, 65535, 72, 65535, 65535,
+    65535, 132, 65535, 181, 65535, 65535, 65535, 65535, 65535, 65535, 205, 65535, 107, 163, 21, 12,
+    65535, 68, 65535, 65535, 65535, 175, 37, 7, 59, 196, 22, 65535, 65535, 92, 65535, 98,
+    135, 89, 197, 65535, 65535, 166, 65535, 55, 192, 194, 2, 65535, 113, 52, 171, 50,
+    65535, 65535, 65535, 65535, 207, 65535, 65535, 184, 65535, 65535, 120, 114, 65535, 65535, 65535, 4,
+    65535, 65535, 65535, 69, 103, 65535, 65535, 65535, 65, 65535, 42, 57, 34, 65535, 65535, 153,
+    33, 65535, 65535, 105, 169, 65535, 65535, 164, 87, 65535, 62, 65535, 65535, 65535, 65535, 106,
+    65535, 65535, 65535, 65535, 65535, 65535, 134, 65535, 65535, 65535, 65535, 65535, 65535, 110, 23, 109,
+    65535, 127, 65535, 65535, 179, 108, 65535, 65535, 65535, 65535, 73, 65535, 65535, 65535, 65535, 172,
+    65535, 65535, 187, 65535, 206, 65535, 65535, 65535, 29, 65535, 65535, 96, 65535, 65535, 65535, 202,
+    65535, 126, 65535, 65535, 65535, 65535, 65535, 152, 65535, 65535, 170, 65535, 0, 65535, 65535, 65535,
+    65535, 83, 112, 65535, 45, 15, 65535, 130, 65535, 65535, 65535, 65535, 65535, 180, 65535, 65535,
+    64, 139, 100, 65535, 65535, 65535, 79, 204, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 186,
+    65535, 65535, 65535, 61, 190, 65535, 177, 65535, 44, 198, 60, 65535, 133, 65535, 65535, 65535,
+    151, 65535, 65535, 47, 65535, 82, 199, 65535, 65535, 65535, 84, 94, 65535, 140, 65535, 131,
+    65535, 65535, 65535, 65535, 165, 65535, 65535, 188, 65535, 65535, 65535, 65535, 65535, 65535, 27, 101,
+    67, 65535, 65535, 65535, 65535, 41, 65535, 65535, 116, 65535, 137, 65535, 185, 65535, 128, 154,
+    65535, 65535, 6, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 142, 65535, 65535, 65535,
+    74, 183, 65535, 168, 65535, 65535, 3, 65535, 65535, 65535, 65535, 10, 43, 65535, 65535, 118,
+    65535, 102, 191, 176, 65535, 65535, 65535, 24, 65535, 65535, 31, 65535, 65535, 46, 9, 65535,
+    65535, 104, 65535, 65535, 65535, 65535, 65535, 17, 65535, 66, 65535, 65535, 63, 65535, 48, 195,
+    124, 70, 90, 65535, 65535, 56, 65535, 65535, 145, 65535, 65535, 30, 65535, 19, 65535, 65535,
+    65535, 85, 14, 65535, 65535, 111, 148, 65535, 178, 65535, 65535, 65535, 208, 65535, 99, 65535,
+    91, 65535, 65535, 65535, 65535, 65535, 65535, 5, 65535, 201, 122, 65535, 123, 65535, 65535, 65535,
+    65535, 65535, 136, 65535, 28, 39, 80, 65535, 65535, 11, 65535, 35, 121, 65535, 58, 53,
+    65535, 65535, 65535, 193, 36, 40, 65535, 65535, 38, 65535, 149, 65535, 65535, 26, 65535, 65535,
+    65535, 54, 65535, 65535, 13, 65535, 65535, 65535, 65535, 8, 174, 65535, 20, 49, 189, 25,
+    146, 51, 65535, 32, 65535, 143, 65535, 138, 65535, 182, 65535, 65535, 65535, 65535, 18, 65535,
+    77, 129, 65535, 65535, 65535, 93, 65535, 1, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 86,
+};
+
+static const WORD g_StreamMethods_Displacements[] =
+{
+    1,
+};
+
+static const WORD g_StreamMethods_Slots[] =
+{
+    1, 65535, 0, 65535,
+};
+
+static const WORD g_Texture1DMethods_Displacements[] =
+{
+    1, 4, 0, 0, 2, 1, 2, 0, 0, 2, 1, 1, 3, 1, 2,
+};
+
+static const WORD g_Texture1DMethods_Slots[] =
+{
+    15, 65535, 65535, 65535, 27, 65535, 25, 65535, 65535, 65535, 65535, 20, 65535, 24, 28, 65535,
+    65535, 22, 65535, 29, 14, 65535, 65535, 65535, 23, 4, 19, 0, 65535, 6, 17, 65535,
+    65535, 7, 65535, 65535, 9, 1, 30, 26, 13, 65535, 10, 12, 65535, 65535, 65535, 65535,
+    21, 18, 2, 65535, 8, 65535, 65535, 65535, 65535, 65535, 16, 11, 65535, 65535, 65535, 65535,
+};
+
+static const WORD g_Texture1DArrayMethods_Displacements[] =
+{
+    7, 1, 0, 1, 1, 2, 1, 0, 0, 1, 1, 1, 1, 3, 1,
+};
+
+static const WORD g_Texture1DArrayMethods_Slots[] =
+{
+    28, 65535, 8, 22, 12, 65535, 4, 65535, 65535, 65535, 7, 9, 65535, 15, 6, 65535,
+    16, 65535, 65535, 65535, 25, 65535, 27, 65535, 23, 26, 65535, 0, 65535, 65535, 17, 24,
+    65535, 29, 65535, 65535, 65535, 65535, 30, 13, 65535, 65535, 10, 65535, 2, 20, 65535, 65535,
+    65535, 18, 65535, 65535, 1, 65535, 65535, 65535, 19, 65535, 14, 65535, 65535, 11, 21, 65535,
+};
+
+static const WORD g_Texture2DMethods_Displacements[] =
+{
+    1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1,
+    1, 1, 1, 0, 4, 1, 1, 1, 1, 0, 2, 2, 1, 1, 1, 1,
+    2, 2, 2, 1, 1, 2,
+};
+
+static const WORD g_Texture2DMethods_Slots[] =
+{
+    65535, 65535, 65535, 65535, 65535, 65535, 50, 3, 65535, 65535, 65535, 65535, 65535, 65535, 16, 65535,
+    12, 65535, 65535, 65535, 65535, 65535, 35, 65535, 65535, 65535, 27, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 24, 65535, 65535, 65535, 65535, 22, 65535, 65535, 65535, 48, 65535, 65535, 7,
+    65535, 65535, 65535, 46, 1, 65535, 13, 65535, 65, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    74, 65535, 65535, 65535, 58, 65535, 65535, 32, 65535, 65535, 53, 65535, 65535, 65535, 2, 65535,
+    65535, 65535, 65535, 65535, 60, 65535, 65535, 65535, 65535, 45, 65535, 65535, 65535, 65535, 63, 65535,
+    65535, 6, 65535, 39, 29, 65535, 65535, 37, 65535, 65535, 56, 54, 65535, 65535, 65535, 18,
+    65535, 65535, 65535, 41, 65535, 65535, 65535, 71, 65535, 65535, 62, 19, 65535, 65535, 65535, 43,
+    61, 65535, 10, 34, 65535, 65535, 65535, 14, 65535, 65535, 65535, 55, 65535, 65535, 65535, 65535,
+    65535, 68, 65535, 65535, 65535, 20, 65535, 65535, 65535, 40, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 15, 65535, 25, 65535, 65535, 65535, 65535, 8, 65535, 47, 65535, 65535, 26, 65535, 65535,
+    65535, 65535, 65535, 4, 31, 65535, 65535, 65535, 65535, 73, 65535, 21, 65535, 65535, 65535, 38,
+    65535, 65535, 65535, 65535, 65535, 65535, 44, 65535, 65535, 23, 65535, 66, 11, 70, 65535, 65535,
+    28, 65535, 65535, 75, 36, 65535, 65535, 65535, 69, 65535, 65535, 0, 65535, 52, 65535, 65535,
+    65535, 65535, 65535, 76, 72, 65535, 65535, 59, 9, 65535, 42, 65535, 65535, 65535, 65535, 65535,
+    33, 64, 65535, 65535, 5, 65535, 30, 65535, 17, 65535, 65535, 65535, 65535, 57, 67, 65535,
+};
+
+static const WORD g_Texture2DMSMethods_Displacements[] =
+{
+    1, 1, 1,
+};
+
+static const WORD g_Texture2DMSMethods_Slots[] =
+{
+    65535, 3, 65535, 65535, 4, 65535, 65535, 5, 65535, 0, 65535, 65535, 65535, 65535, 65535, 2,
+};
+
+static const WORD g_Texture2DArrayMethods_Displacements[] =
+{
+    1, 1, 1, 1, 1, 2, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1,
+    2, 1, 1, 0, 1, 1, 1, 1, 1, 0, 2, 2, 1, 1, 2, 1,
+    1, 2, 3, 1, 1, 2,
+};
+
+static const WORD g_Texture2DArrayMethods_Slots[] =
+{
+    65535, 65535, 65535, 65535, 65535, 65535, 39, 65535, 65535, 65535, 65535, 65535, 65535, 61, 16, 65535,
+    12, 65535, 65535, 65535, 65535, 65535, 35, 65535, 65535, 65535, 27, 65535, 65535, 65535, 65535, 65535,
+    3, 65535, 65535, 24, 65535, 65535, 65535, 65535, 22, 65535, 65535, 65535, 65535, 65535, 65535, 7,
+    65535, 65535, 65535, 46, 1, 65535, 13, 65535, 65, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    74, 65535, 65535, 65535, 58, 65535, 65535, 32, 65535, 65535, 53, 65535, 65535, 65535, 2, 65535,
+    65535, 65535, 65535, 65535, 60, 8, 73, 65535, 65535, 45, 65535, 65535, 65535, 65535, 63, 65535,
+    65535, 65535, 65535, 29, 65535, 65535, 50, 37, 65535, 65535, 56, 54, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 41, 65535, 65535, 65535, 71, 65535, 65535, 62, 17, 65535, 65535, 65535, 43,
+    65535, 65535, 10, 34, 65535, 65535, 65535, 14, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 68, 65535, 65535, 65535, 20, 65535, 65535, 65535, 48, 65535, 65535, 6, 65535, 65535, 65535,
+    65535, 15, 65535, 25, 55, 65535, 65535, 65535, 65535, 65535, 47, 65535, 65535, 26, 65535, 65535,
+    65535, 11, 65535, 4, 31, 65535, 65535, 65535, 65535, 65535, 65535, 21, 65535, 65535, 65535, 38,
+    65535, 65535, 65535, 65535, 65535, 65535, 44, 65535, 65535, 23, 65535, 66, 65535, 70, 65535, 65535,
+    40, 65535, 65535, 75, 36, 65535, 65535, 65535, 69, 65535, 65535, 0, 19, 52, 65535, 65535,
+    65535, 65535, 65535, 76, 72, 65535, 65535, 59, 18, 65535, 42, 65535, 65535, 65535, 65535, 65535,
+    33, 64, 65535, 9, 5, 65535, 30, 28, 65535, 65535, 65535, 65535, 65535, 57, 67, 65535,
+};
+
+static const WORD g_Texture2DArrayMSMethods_Displacements[] =
+{
+    1, 1, 1,
+};
+
+static const WORD g_Texture2DArrayMSMethods_Slots[] =
+{
+    65535, 3, 65535, 65535, 4, 65535, 0, 5, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 2,
+};
+
+static const WORD g_Texture3DMethods_Displacements[] =
+{
+    1, 1, 2, 2, 1, 0, 1, 1, 0, 6, 1,
+};
+
+static const WORD g_Texture3DMethods_Slots[] =
+{
+    21, 65535, 65535, 65535, 65535, 65535, 65535, 12, 65535, 65535, 65535, 9, 65535, 15, 6, 65535,
+    65535, 65535, 65535, 22, 18, 65535, 17, 65535, 65535, 2, 65535, 0, 65535, 65535, 65535, 65535,
+    65535, 7, 65535, 23, 65535, 65535, 65535, 19, 13, 65535, 10, 8, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 4, 1, 65535, 65535, 65535, 65535, 20, 16, 14, 65535, 11, 65535, 65535,
+};
+
+static const WORD g_TextureCUBEMethods_Displacements[] =
+{
+    1, 0, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    1, 1, 1, 2,
+};
+
+static const WORD g_TextureCUBEMethods_Slots[] =
+{
+    65535, 65535, 6, 17, 65535, 65535, 24, 3, 65535, 4, 65535, 26, 65535, 31, 9, 65535,
+    65535, 36, 14, 65535, 38, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 8, 65535, 7, 65535, 65535, 65535, 39, 19, 65535, 65535, 65535, 22, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 1, 65535, 13, 65535, 34, 65535, 65535, 65535, 65535, 65535, 65535, 18,
+    40, 65535, 65535, 65535, 65535, 65535, 21, 65535, 65535, 12, 65535, 65535, 65535, 37, 2, 65535,
+    65535, 65535, 65535, 41, 30, 65535, 65535, 65535, 65535, 65535, 65535, 0, 11, 65535, 65535, 65535,
+    65535, 5, 65535, 15, 65535, 65535, 65535, 29, 65535, 65535, 27, 65535, 65535, 65535, 65535, 10,
+    16, 33, 65535, 65535, 32, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 28, 35, 20,
+};
+
+static const WORD g_TextureCUBEArrayMethods_Displacements[] =
+{
+    1, 0, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    1, 1, 1, 1,
+};
+
+static const WORD g_TextureCUBEArrayMethods_Slots[] =
+{
+    65535, 65535, 6, 17, 65535, 65535, 19, 3, 65535, 65535, 65535, 26, 65535, 31, 9, 65535,
+    65535, 36, 65535, 65535, 38, 65535, 65535, 65535, 65535, 22, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 8, 65535, 7, 65535, 65535, 65535, 39, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535,
+    65535, 65535, 65535, 65535, 1, 65535, 13, 65535, 34, 65535, 65535, 65535, 65535, 65535, 65535, 18,
+    40, 65535, 65535, 65535, 65535, 65535, 21, 65535, 65535, 12, 65535, 65535, 65535, 37, 2, 65535,
+    14, 65535, 65535, 41, 30, 65535, 65535, 65535, 65535, 65535, 65535, 0, 11, 65535, 32, 65535,
+    65535, 5, 65535, 15, 65535, 65535, 65535, 29, 65535, 65535, 27, 65535, 65535, 65535, 65535, 10,
+    16, 33, 65535, 24, 4, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 28, 35, 20,
+};
+
+static const WORD g_BufferMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_BufferMethods_Slots[] =
+{
+    65535, 2, 65535, 65535, 65535, 65535, 1, 0,
+};
+
+static const WORD g_RWTexture1DMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_RWTexture1DMethods_Slots[] =
+{
+    65535, 3, 65535, 65535, 65535, 65535, 2, 0,
+};
+
+static const WORD g_RWTexture1DArrayMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_RWTexture1DArrayMethods_Slots[] =
+{
+    65535, 3, 65535, 65535, 0, 65535, 2, 65535,
+};
+
+static const WORD g_RWTexture2DMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_RWTexture2DMethods_Slots[] =
+{
+    65535, 3, 65535, 65535, 0, 65535, 2, 65535,
+};
+
+static const WORD g_RWTexture2DArrayMethods_Displacements[] =
+{
+    2, 1,
+};
+
+static const WORD g_RWTexture2DArrayMethods_Slots[] =
+{
+    0, 65535, 3, 65535, 65535, 65535, 2, 65535,
+};
+
+static const WORD g_RWTexture3DMethods_Displacements[] =
+{
+    2, 1,
+};
+
+static const WORD g_RWTexture3DMethods_Slots[] =
+{
+    0, 65535, 3, 65535, 65535, 65535, 2, 65535,
+};
+
+static const WORD g_RWBufferMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_RWBufferMethods_Slots[] =
+{
+    65535, 2, 65535, 65535, 65535, 65535, 1, 0,
+};
+
+static const WORD g_ByteAddressBufferMethods_Displacements[] =
+{
+    1, 1, 1, 1, 1,
+};
+
+static const WORD g_ByteAddressBufferMethods_Slots[] =
+{
+    65535, 2, 65535, 5, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 4, 65535, 8, 1, 65535,
+    6, 65535, 65535, 65535, 65535, 65535, 65535, 65535, 3, 65535, 7, 65535, 65535, 65535, 65535, 0,
+};
+
+static const WORD g_RWByteAddressBufferMethods_Displacements[] =
+{
+    1, 1, 1, 1, 1, 1, 3, 1, 1, 3, 1, 1, 1, 1,
+};
+
+static const WORD g_RWByteAddressBufferMethods_Slots[] =
+{
+    65535, 65535, 65535, 20, 14, 65535, 65535, 65535, 3, 65535, 65535, 8, 12, 4, 16, 65535,
+    11, 65535, 65535, 65535, 26, 5, 65535, 65535, 65535, 7, 22, 65535, 65535, 65535, 28, 65535,
+    65535, 17, 24, 10, 65535, 65535, 65535, 2, 65535, 65535, 9, 65535, 65535, 23, 1, 27,
+    21, 15, 65535, 65535, 6, 19, 65535, 65535, 18, 13, 65535, 65535, 65535, 65535, 65535, 0,
+};
+
+static const WORD g_StructuredBufferMethods_Displacements[] =
+{
+    1, 1,
+};
+
+static const WORD g_StructuredBufferMethods_Slots[] =
+{
+    65535, 2, 65535, 65535, 0, 65535, 1, 65535,
+};
+
+static const WORD g_RWStructuredBufferMethods_Displacements[] =
+{
+    2, 1, 1,
+};
+
+static const WORD g_RWStructuredBufferMethods_Slots[] =
+{
+    0, 4, 65535, 65535, 65535, 1, 65535, 65535, 65535, 65535, 65535, 65535, 2, 65535, 3, 65535,
+};
+
+static const WORD g_AppendStructuredBufferMethods_Displacements[] =
+{
+    1,
+};
+
+static const WORD g_AppendStructuredBufferMethods_Slots[] =
+{
+    1, 65535, 0, 65535,
+};
+
+static const WORD g_ConsumeStructuredBufferMethods_Displacements[] =
+{
+    1,
+};
+
+static const WORD g_ConsumeStructuredBufferMethods_Slots[] =
+{
+    1, 0, 65535, 65535,
+};
+
+#ifdef ENABLE_SPIRV_CODEGEN
+static const WORD g_VkSubpassInputMethods_Displacements[] =
+{
+    1,
+};
+
+static const WORD g_VkSubpassInputMethods_Slots[] =
+{
+    0, 65535,
+};
+
+#endif // ENABLE_SPIRV_CODEGEN
+
+#ifdef ENABLE_SPIRV_CODEGEN
+static const WORD g_VkSubpassInputMSMethods_Displacements[] =
+{
+    1,
+};
+
+static const WORD g_VkSubpassInputMSMethods_Slots[] =
+{
+    65535, 0,
+};
+
+#endif // ENABLE_SPIRV_CODEGEN
+
+static const HLSL_INTRINSIC_INDEX g_IntrinsicIndices[] =
+{
+    {g_Intrinsics, _countof(g_Intrinsics_Displacements), _countof(g_Intrinsics_Slots) - 1, g_Intrinsics_Displacements, g_Intrinsics_Slots},
+    {g_StreamMethods, _countof(g_StreamMethods_Displacements), _countof(g_StreamMethods_Slots) - 1, g_StreamMethods_Displacements, g_StreamMethods_Slots},
+    {g_Texture1DMethods, _countof(g_Texture1DMethods_Displacements), _countof(g_Texture1DMethods_Slots) - 1, g_Texture1DMethods_Displacements, g_Texture1DMethods_Slots},
+    {g_Texture1DArrayMethods, _countof(g_Texture1DArrayMethods_Displacements), _countof(g_Texture1DArrayMethods_Slots) - 1, g_Texture1DArrayMethods_Displacements, g_Texture1DArrayMethods_Slots},
+    {g_Texture2DMethods, _countof(g_Texture2DMethods_Displacements), _countof(g_Texture2DMethods_Slots) - 1, g_Texture2DMethods_Displacements, g_Texture2DMethods_Slots},
+    {g_Texture2DMSMethods, _countof(g_Texture2DMSMethods_Displacements), _countof(g_Texture2DMSMethods_Slots) - 1, g_Texture2DMSMethods_Displacements, g_Texture2DMSMethods_Slots},
+    {g_Texture2DArrayMethods, _countof(g_Texture2DArrayMethods_Displacements), _countof(g_Texture2DArrayMethods_Slots) - 1, g_Texture2DArrayMethods_Displacements, g_Texture2DArrayMethods_Slots},
+    {g_Texture2DArrayMSMethods, _countof(g_Texture2DArrayMSMethods_Displacements), _countof(g_Texture2DArrayMSMethods_Slots) - 1, g_Texture2DArrayMSMethods_Displacements, g_Texture2DArrayMSMethods_Slots},
+    {g_Texture3DMethods, _countof(g_Texture3DMethods_Displacements), _countof(g_Texture3DMethods_Slots) - 1, g_Texture3DMethods_Displacements, g_Texture3DMethods_Slots},
+    {g_TextureCUBEMethods, _countof(g_TextureCUBEMethods_Displacements), _countof(g_TextureCUBEMethods_Slots) - 1, g_TextureCUBEMethods_Displacements, g_TextureCUBEMethods_Slots},
+    {g_TextureCUBEArrayMethods, _countof(g_TextureCUBEArrayMethods_Displacements), _countof(g_TextureCUBEArrayMethods_Slots) - 1, g_TextureCUBEArrayMethods_Displacements, g_TextureCUBEArrayMethods_Slots},
+    {g_BufferMethods, _countof(g_BufferMethods_Displacements), _countof(g_BufferMethods_Slots) - 1, g_BufferMethods_Displacements, g_BufferMethods_Slots},
+    {g_RWTexture1DMethods, _countof(g_RWTexture1DMethods_Displacements), _countof(g_RWTexture1DMethods_Slots) - 1, g_RWTexture1DMethods_Displacements, g_RWTexture1DMethods_Slots},
+    {g_RWTexture1DArrayMethods, _countof(g_RWTexture1DArrayMethods_Displacements), _countof(g_RWTexture1DArrayMethods_Slots) - 1, g_RWTexture1DArrayMethods_Displacements, g_RWTexture1DArrayMethods_Slots},
+    {g_RWTexture2DMethods, _countof(g_RWTexture2DMethods_Displacements), _countof(g_RWTexture2DMethods_Slots) - 1, g_RWTexture2DMethods_Displacements, g_RWTexture2DMethods_Slots},
+    {g_RWTexture2DArrayMethods, _countof(g_RWTexture2DArrayMethods_Displacements), _countof(g_RWTexture2DArrayMethods_Slots) - 1, g_RWTexture2DArrayMethods_Displacements, g_RWTexture2DArrayMethods_Slots},
+    {g_RWTexture3DMethods, _countof(g_RWTexture3DMethods_Displacements), _countof(g_RWTexture3DMethods_Slots) - 1, g_RWTexture3DMethods_Displacements, g_RWTexture3DMethods_Slots},
+    {g_RWBufferMethods, _countof(g_RWBufferMethods_Displacements), _countof(g_RWBufferMethods_Slots) - 1, g_RWBufferMethods_Displacements, g_RWBufferMethods_Slots},
+    {g_ByteAddressBufferMethods, _countof(g_ByteAddressBufferMethods_Displacements), _countof(g_ByteAddressBufferMethods_Slots) - 1, g_ByteAddressBufferMethods_Displacements, g_ByteAddressBufferMethods_Slots},
+    {g_RWByteAddressBufferMethods, _countof(g_RWByteAddressBufferMethods_Displacements), _countof(g_RWByteAddressBufferMethods_Slots) - 1, g_RWByteAddressBufferMethods_Displacements, g_RWByteAddressBufferMethods_Slots},
+    {g_StructuredBufferMethods, _countof(g_StructuredBufferMethods_Displacements), _countof(g_StructuredBufferMethods_Slots) - 1, g_StructuredBufferMethods_Displacements, g_StructuredBufferMethods_Slots},
+    {g_RWStructuredBufferMethods, _countof(g_RWStructuredBufferMethods_Displacements), _countof(g_RWStructuredBufferMethods_Slots) - 1, g_RWStructuredBufferMethods_Displacements, g_RWStructuredBufferMethods_Slots},
+    {g_AppendStructuredBufferMethods, _countof(g_AppendStructuredBufferMethods_Displacements), _countof(g_AppendStructuredBufferMethods_Slots) - 1, g_AppendStructuredBufferMethods_Displacements, g_AppendStructuredBufferMethods_Slots},
+    {g_ConsumeStructuredBufferMethods, _countof(g_ConsumeStructuredBufferMethods_Displacements), _countof(g_ConsumeStructuredBufferMethods_Slots) - 1, g_ConsumeStructuredBufferMethods_Displacements, g_ConsumeStructuredBufferMethods_Slots},
+#ifdef ENABLE_SPIRV_CODEGEN
+    {g_VkSubpassInputMethods, _countof(g_VkSubpassInputMethods_Displacements), _countof(g_VkSubpassInputMethods_Slots) - 1, g_VkSubpassInputMethods_Displacements, g_VkSubpassInputMethods_Slots},
+    {g_VkSubpassInputMSMethods, _countof(g_VkSubpassInputMSMethods_Displacements), _countof(g_VkSubpassInputMSMethods_Slots) - 1, g_VkSubpassInputMSMethods_Displacements, g_VkSubpassInputMSMethods_Slots},
+#endif // ENABLE_SPIRV_CODEGEN
+};
+// HLSL-INTRINSIC-INDEX:END
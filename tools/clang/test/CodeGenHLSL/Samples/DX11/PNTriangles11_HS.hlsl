@@ -4,9 +4,10 @@
 // CHECK: Rsqrt
 // CHECK: dot3
 // CHECK: storePatchConstant
-// CHECK: main
-// CHECK: outputControlPointID
-// CHECK: storeOutput
+// The control-point function only copies its inputs, so the hull shader
+// becomes a pass-through one.
+// CHECK: declare void @main()
+// CHECK-NOT: outputControlPointID
 
 //--------------------------------------------------------------------------------------
 // File: PNTriangles11.hlsl
@@ -0,0 +1,8 @@
+// RUN: %dxc -T ps_6_0 %s -E main | %FileCheck %s
+// CHECK: call void @dx.op.storeOutput{{.*}} float 7.500000e-01
+
+[RootSignature("")]
+float main(float x : A) : SV_Target {
+    float y = -0.25;
+    return frac(y);
+}
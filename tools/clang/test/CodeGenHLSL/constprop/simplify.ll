@@ -0,0 +1,143 @@
+; RUN: %opt %s -hlsl-dxilload -simplify-inst -S | FileCheck %s
+
+target datalayout = "e-m:e-p:32:32-i64:64-f80:32-n8:16:32-a:0:32-S32"
+target triple = "dxil-ms-dx"
+
+%dx.types.Handle = type { i8* }
+%struct.RWByteAddressBuffer = type { i32 }
+
+define void @main() {
+entry:
+  %buf_UAV_rawbuf = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 0, i32 0, i1 false)  ; CreateHandle(resourceClass,rangeId,index,nonUniformIndex)
+  %x = call float @dx.op.loadInput.f32(i32 4, i32 0, i32 0, i8 0, i32 undef)  ; LoadInput(inputSigId,rowIndex,colIndex,gsVertexAxis)
+  %y = call float @dx.op.loadInput.f32(i32 4, i32 0, i32 0, i8 1, i32 undef)  ; LoadInput(inputSigId,rowIndex,colIndex,gsVertexAxis)
+  %z = call float @dx.op.loadInput.f32(i32 4, i32 0, i32 0, i8 2, i32 undef)  ; LoadInput(inputSigId,rowIndex,colIndex,gsVertexAxis)
+
+  ; Saturate of values already in [0, 1] is dropped.
+  ; CHECK: %frc = call float @dx.op.unary.f32(i32 22, float %x)
+  ; CHECK-NOT: @dx.op.unary.f32(i32 7,
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 0, i32 undef, float %frc,
+  %frc = call float @dx.op.unary.f32(i32 22, float %x)
+  %sat0 = call float @dx.op.unary.f32(i32 7, float %frc)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 0, i32 undef, float %sat0, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; CHECK: %sel = select i1 %cmp, float 1.000000e+00, float %sat
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 4, i32 undef, float %sel,
+  %cmp = fcmp olt float %x, %y
+  %sat = call float @dx.op.unary.f32(i32 7, float %y)
+  %sel = select i1 %cmp, float 1.000000e+00, float %sat
+  %sat1 = call float @dx.op.unary.f32(i32 7, float %sel)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 4, i32 undef, float %sat1, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; CHECK: %fmin = call float @dx.op.binary.f32(i32 36, float %frc, float 5.000000e-01)
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 8, i32 undef, float %fmin,
+  %fmin = call float @dx.op.binary.f32(i32 36, float %frc, float 5.000000e-01)
+  %sat2 = call float @dx.op.unary.f32(i32 7, float %fmin)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 8, i32 undef, float %sat2, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; CHECK: %b = uitofp i1 %cmp to float
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 12, i32 undef, float %b,
+  %b = uitofp i1 %cmp to float
+  %sat3 = call float @dx.op.unary.f32(i32 7, float %b)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 12, i32 undef, float %sat3, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; -0 is not, since saturate returns +0 for it.
+  ; CHECK: %sel2 = select i1 %cmp, float -0.000000e+00, float 1.000000e+00
+  ; CHECK: %sat4 = call float @dx.op.unary.f32(i32 7, float %sel2)
+  %sel2 = select i1 %cmp, float -0.000000e+00, float 1.000000e+00
+  %sat4 = call float @dx.op.unary.f32(i32 7, float %sel2)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 16, i32 undef, float %sat4, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; Dot products drop the components that are 0 on either side.
+  ; CHECK: [[DOT4:%.*]] = call float @dx.op.dot2.f32(i32 54, float %x, float %z, float %y, float %x)
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 20, i32 undef, float [[DOT4]],
+  %dot4 = call float @dx.op.dot4.f32(i32 56, float %x, float 0.000000e+00, float %z, float %y, float %y, float %z, float %x, float 0.000000e+00)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 20, i32 undef, float %dot4, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; CHECK: [[DOT3:%.*]] = fmul fast float %y, %z
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 24, i32 undef, float [[DOT3]],
+  %dot3 = call float @dx.op.dot3.f32(i32 55, float 0.000000e+00, float %y, float %x, float %z, float %z, float -0.000000e+00)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 24, i32 undef, float %dot3, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 28, i32 undef, float 0.000000e+00,
+  %dot2 = call float @dx.op.dot2.f32(i32 54, float 0.000000e+00, float %y, float %x, float 0.000000e+00)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 28, i32 undef, float %dot2, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; mad without an addend is a multiply.
+  ; CHECK: [[MAD:%.*]] = fmul fast float %x, %y
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 32, i32 undef, float [[MAD]],
+  %mad = call float @dx.op.tertiary.f32(i32 46, float %x, float %y, float 0.000000e+00)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 32, i32 undef, float %mad, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  ; min and max of a value with itself is that value.
+  ; CHECK: @dx.op.bufferStore{{.*}}, i32 36, i32 undef, float %z,
+  %fmax = call float @dx.op.binary.f32(i32 35, float %z, float %z)
+  call void @dx.op.bufferStore.f32(i32 69, %dx.types.Handle %buf_UAV_rawbuf, i32 36, i32 undef, float %fmax, float undef, float undef, float undef, i8 1)  ; BufferStore(uav,coord0,coord1,value0,value1,value2,value3,mask)
+
+  call void @dx.op.storeOutput.i32(i32 5, i32 0, i32 0, i8 0, i32 0)  ; StoreOutput(outputSigId,rowIndex,colIndex,value)
+  ret void
+}
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.loadInput.f32(i32, i32, i32, i8, i32) #0
+
+; Function Attrs: nounwind
+declare void @dx.op.storeOutput.i32(i32, i32, i32, i8, i32) #1
+
+; Function Attrs: nounwind
+declare void @dx.op.bufferStore.f32(i32, %dx.types.Handle, i32, i32, float, float, float, float, i8) #1
+
+; Function Attrs: nounwind readonly
+declare %dx.types.Handle @dx.op.createHandle(i32, i8, i32, i32, i1) #2
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.unary.f32(i32, float) #0
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.binary.f32(i32, float, float) #0
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.tertiary.f32(i32, float, float, float) #0
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.dot2.f32(i32, float, float, float, float) #0
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.dot3.f32(i32, float, float, float, float, float, float) #0
+
+; Function Attrs: nounwind readnone
+declare float @dx.op.dot4.f32(i32, float, float, float, float, float, float, float, float) #0
+
+attributes #0 = { nounwind readnone }
+attributes #1 = { nounwind }
+attributes #2 = { nounwind readonly }
+
+!llvm.ident = !{!0}
+!dx.valver = !{!1}
+!dx.version = !{!1}
+!dx.shaderModel = !{!2}
+!dx.resources = !{!3}
+!dx.typeAnnotations = !{!6, !9}
+!dx.entryPoints = !{!13}
+
+!0 = !{!"clang version 3.7 (tags/RELEASE_370/final)"}
+!1 = !{i32 1, i32 0}
+!2 = !{!"ps", i32 6, i32 0}
+!3 = !{null, !4, null, null}
+!4 = !{!5}
+!5 = !{i32 0, %struct.RWByteAddressBuffer* undef, !"buf", i32 0, i32 0, i32 1, i32 11, i1 false, i1 false, i1 false, null}
+!6 = !{i32 0, %struct.RWByteAddressBuffer undef, !7}
+!7 = !{i32 4, !8}
+!8 = !{i32 6, !"h", i32 3, i32 0, i32 7, i32 4}
+!9 = !{i32 1, void ()* @main, !10}
+!10 = !{!11}
+!11 = !{i32 0, !12, !12}
+!12 = !{}
+!13 = !{void ()* @main, !"main", !14, !3, !20}
+!14 = !{!15, !18, null}
+!15 = !{!16}
+!16 = !{i32 0, !"A", i8 4, i8 0, !17, i8 1, i32 1, i8 1, i32 0, i8 0, null}
+!17 = !{i32 0}
+!18 = !{!19}
+!19 = !{i32 0, !"SV_Target", i8 4, i8 16, !17, i8 0, i32 1, i8 1, i32 0, i8 0, null}
+!20 = !{i32 0, i64 16}
\ No newline at end of file
@@ -0,0 +1,16 @@
+// RUN: %dxc -Emain -Tps_6_0 -ffast-trig %s | %FileCheck %s
+
+// With -ffast-trig the compiler expands tanh with a single exponential,
+// while the precise acos keeps the full expansion.
+
+// CHECK-DAG: fmul fast float {{.*}}, 0x4007154760000000
+// CHECK-DAG: fmul float {{.*}}, 0xBF932DC600000000
+// CHECK-NOT: 0x3FF7154760000000
+// CHECK-NOT: call float @dx.op.unary.f32(i32 15
+// CHECK-NOT: call float @dx.op.unary.f32(i32 20
+
+[RootSignature("")]
+float main(float x : A, float y : B) : SV_Target {
+    precise float a = acos(y);
+    return tanh(x) + a;
+}
@@ -0,0 +1,17 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -hlsl-dxil-expand-trig-intrinsics | %FileCheck %s
+
+// The expansion of tan shares the Sin and Cos of the rotation, and the two
+// end up next to each other.
+
+// CHECK: call float @dx.op.unary.f32(i32 1{{[23]}}, float
+// CHECK-NEXT: call float @dx.op.unary.f32(i32 1{{[23]}}, float
+// CHECK-NOT: call float @dx.op.unary.f32(i32 1{{[234]}}
+// CHECK: fdiv
+
+[RootSignature("")]
+float2 main(float x : A, float2 v : B) : SV_Target {
+    float s = sin(x);
+    float c = cos(x);
+    float2 r = float2(v.x * c - v.y * s, v.x * s + v.y * c);
+    return r * tan(x);
+}
@@ -1,7 +1,8 @@
 // RUN: %dxc -E main -T ps_6_0 /Gfa /all_resources_bound %s | FileCheck %s
 
+// Both hinted branches share one node.
 // CHECK: !"dx.controlflow.hints", i32 2
-// CHECK: !"dx.controlflow.hints", i32 2
+// CHECK-NOT: !"dx.controlflow.hints", i32 2
 
 float main(float2 a : A, int3 b : B) : SV_Target
 {
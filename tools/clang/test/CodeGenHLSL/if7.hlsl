@@ -1,7 +1,8 @@
 // RUN: %dxc -E main -T ps_6_0 /Gfp %s | FileCheck %s
 
+// Both hinted branches share one node.
 // CHECK: !"dx.controlflow.hints", i32 1
-// CHECK: !"dx.controlflow.hints", i32 1
+// CHECK-NOT: !"dx.controlflow.hints", i32 1
 
 float main(float2 a : A, int3 b : B) : SV_Target
 {
@@ -0,0 +1,31 @@
+// Check that linking an entry drops the resources it doesn't read, and
+// shrinks its cbuffer to the rows it reads.
+
+cbuffer Params {
+  float4 color;
+  float4 scale;
+  float4 bias;
+  float4 unusedTail;
+};
+
+Texture2D<float4> unusedTex;
+RWStructuredBuffer<float4> outBuf;
+
+float4 ColorOnly() {
+  return color;
+}
+
+float4 Everything(uint i) {
+  return color * scale + bias + unusedTail + unusedTex.Load(int3(i, 0, 0));
+}
+
+[shader("pixel")]
+float4 ps_main() : SV_Target {
+  return ColorOnly();
+}
+
+[shader("compute")]
+[numthreads(8, 1, 1)]
+void cs_main(uint tid : SV_DispatchThreadID) {
+  outBuf[tid] = Everything(tid);
+}
@@ -0,0 +1,31 @@
+// Check that linking a vertex shader with the pixel shader after it removes
+// the outputs that the pixel shader doesn't read, and stops interpolating
+// the outputs that are the same at every vertex.
+
+cbuffer Material {
+  float4 tint;
+};
+
+struct Interpolants {
+  float4 pos : SV_Position;
+  float4 color : COLOR0;
+  float4 tint : COLOR1;
+  float4 unused : TEXCOORD1;
+  float2 uv : TEXCOORD0;
+};
+
+[shader("vertex")]
+Interpolants vs_main(float4 pos : POSITION, float2 uv : TEXCOORD0) {
+  Interpolants o;
+  o.pos = pos;
+  o.color = pos * 0.25;
+  o.tint = tint * 2;
+  o.unused = pos * 3.5;
+  o.uv = uv;
+  return o;
+}
+
+[shader("pixel")]
+float4 ps_main(Interpolants i) : SV_Target {
+  return i.color * i.tint + i.uv.xyxy;
+}
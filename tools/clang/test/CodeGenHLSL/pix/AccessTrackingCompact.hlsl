@@ -0,0 +1,34 @@
+// RUN: %dxc -ECSMain -Tcs_6_0 %s | %opt -S -hlsl-dxil-pix-shader-access-instrumentation,config=S0:1:1i1;U0:2:1024i0g4;..,compact=1,wave-aggregate=0 | %FileCheck %s
+
+// Check we added the UAV:
+// CHECK:  %PIX_CountUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 1, i32 0, i1 false)
+
+// Check the UAV range tracks sixteen descriptors per slot:
+// CHECK: CompareWithSlotLimit = icmp uge i32 %{{.*}}, 1024
+// CHECK: SlotInRange = lshr i32 %{{.*}}, 4
+// CHECK: SlotOffset = add i32 %SlotInRange, 2
+// CHECK: slotIndex = mul i32
+
+// Check the flags are packed four bits per slot:
+// CHECK: lshr i32 %slotIndex, 3
+// CHECK: and i32 %slotIndex, 7
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_CountUAV_Handle, i32 2, i32
+
+// Check the out-of-bounds accesses are listed after the 66 slots (9 uints):
+// CHECK: br i1 %CompareWithSlotLimit
+// CHECK: %OverflowEntry = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_CountUAV_Handle, i32 0, i32 36, i32 undef, i32 undef, i32 1)
+// CHECK: %OverflowEntryOffset = add i32 %{{.*}}, 40
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_CountUAV_Handle, i32 %OverflowEntryOffset, i32 undef, i32 2, i32 %{{.*}}, i32 2, i32 undef, i8 7)
+
+ByteAddressBuffer inBuffer : register(t0);
+RWByteAddressBuffer bufferArray[] : register(u0);
+
+[numthreads(1, 1, 1)]
+void CSMain()
+{
+  // Simple read
+  uint dynamicBufferIndex = inBuffer.Load(0);
+
+  // Dynamically indexed write
+  bufferArray[dynamicBufferIndex].Store(0, 1);
+}
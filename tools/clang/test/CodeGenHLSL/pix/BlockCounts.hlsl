@@ -0,0 +1,24 @@
+// RUN: %dxc -Emain -Tcs_6_0 %s | %opt -S -hlsl-dxil-block-count-instrumentation | %FileCheck %s
+
+// Check we added the UAV:
+// CHECK: %PIX_BlockCountUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 1, i32 0, i1 false)
+
+// Check the entry block is counted once for the wave:
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: %LaneCount = call i32 @dx.op.waveAllOp(i32 135, i1 true)
+// CHECK: br i1 %IsFirstLane
+// CHECK: %BlockCountResult = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockCountUAV_Handle, i32 0, i32 0, i32 undef, i32 undef, i32 %LaneCount)
+
+// Check the next block has the next slot:
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_BlockCountUAV_Handle, i32 0, i32 4, i32 undef, i32 undef, i32
+
+RWByteAddressBuffer output : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+  [branch]
+  if (output.Load(id * 4) != 0) {
+    output.Store(id * 4, 1);
+  }
+}
@@ -0,0 +1,12 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -dxil-annotate-with-virtual-regs -hlsl-dxil-debug-instrumentation,FirstInstruction=1000000 | %FileCheck %s
+
+// Check that instructions outside of the selected range aren't instrumented:
+// only the invocation start marker reserves space in the UAV.
+
+// CHECK: %UAVIncResult = call i32 @dx.op.atomicBinOp.i32
+// CHECK-NOT: @dx.op.atomicBinOp.i32
+
+[RootSignature("")]
+float4 main(float4 color : COLOR) : SV_Target {
+    return color * 2 + 1;
+}
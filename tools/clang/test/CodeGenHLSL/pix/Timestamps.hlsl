@@ -0,0 +1,25 @@
+// RUN: %dxc -Emain -Tcs_6_0 -Zi %s | %opt -S -hlsl-dxil-timestamp-instrumentation,clock-function=dx.shader.clock,regions=23-23 | %FileCheck %s
+
+// Check we added the UAV:
+// CHECK: %PIX_TimestampUAV_Handle = call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 1, i32 0, i1 false)
+
+// Check the first lane takes the wave's first record and hands its number to the wave:
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: %Timestamp = call i64 @dx.shader.clock()
+// CHECK: %TimestampRecord = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_TimestampUAV_Handle, i32 0, i32 0, i32 undef, i32 undef, i32 1)
+// CHECK: %TimestampWave = call i32 @dx.op.waveReadLaneFirst.i32(i32 118
+
+// Check the region is entered and the function left:
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_TimestampUAV_Handle, i32 %{{.*}}, i32 undef, i32 %TimestampWave, i32 1,
+// CHECK: call void @dx.op.bufferStore.i32(i32 69, %dx.types.Handle %PIX_TimestampUAV_Handle, i32 %{{.*}}, i32 undef, i32 %TimestampWave, i32 -1,
+
+RWByteAddressBuffer output : register(u0);
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID)
+{
+  [branch]
+  if (output.Load(id * 4) != 0) {
+    output.Store(id * 4, 1);
+  }
+}
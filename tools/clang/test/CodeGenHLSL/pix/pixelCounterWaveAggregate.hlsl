@@ -0,0 +1,21 @@
+// RUN: %dxc -Emain -Tps_6_0 %s | %opt -S -hlsl-dxil-add-pixel-hit-instrmentation,rt-width=16,num-pixels=64,add-pixel-cost=1 | %FileCheck %s
+
+// Check that the lanes sharing the first lane's pixel are counted by the first lane:
+// CHECK: %IsFirstLane = call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: %FirstLaneOffset = call i32 @dx.op.waveReadLaneFirst.i32(i32 118, i32 %ByteIndex)
+// CHECK: %SharesFirstLaneOffset = icmp eq i32 %ByteIndex, %FirstLaneOffset
+// CHECK: %SharingLaneCount = call i32 @dx.op.waveAllOp(i32 135, i1 %SharesFirstLaneOffset)
+// CHECK: %LaneCount = select i1 %IsFirstLane, i32 %SharingLaneCount, i32 1
+// CHECK: %HasOwnOffset = xor i1 %SharesFirstLaneOffset, true
+// CHECK: %UpdatesCounter = or i1 %IsFirstLane, %HasOwnOffset
+// CHECK: br i1 %UpdatesCounter
+
+// Check the write to the UAV is made by those lanes only:
+// CHECK: %UAVIncResult = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_CountUAV_Handle, i32 0, i32 %ByteIndex, i32 undef, i32 undef, i32 %LaneCount)
+// CHECK: %AggregatedWeight = mul i32 %Weight, %LaneCount
+// CHECK: %UAVIncResult2 = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle %PIX_CountUAV_Handle, i32 0, i32 %OffsetByteIndex, i32 undef, i32 undef, i32 %AggregatedWeight)
+// CHECK: ret void
+
+float4 main(float4 pos : SV_Position) : SV_Target {
+  return pos;
+}
@@ -0,0 +1,35 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -pass-option hlsl-dxil-condense,Contiguous=1 %s 2>&1 | FileCheck %s -check-prefix=PACK
+// RUN: %dxc -E main -T ps_6_0 -pass-option "hlsl-dxil-condense,Contiguous=1,UpdateOrder=C;A" %s 2>&1 | FileCheck %s -check-prefix=ORDER
+
+// First-fit puts D in the gap that B leaves at t1, and C after B.
+// CHECK-DAG: ; A {{.*}} t0{{ +}}1
+// CHECK-DAG: ; B {{.*}} t2{{ +}}1
+// CHECK-DAG: ; C {{.*}} t3{{ +}}2
+// CHECK-DAG: ; D {{.*}} t1{{ +}}1
+
+// Packed, A, C and D follow one another from the first gap that holds all
+// four registers, and the SRVs take a single descriptor range.
+// PACK-DAG: warning: descriptor tables for main: DescriptorTable(SRV(t2, numDescriptors=5)), DescriptorTable(Sampler(s0))
+// PACK-DAG: ; A {{.*}} t3{{ +}}1
+// PACK-DAG: ; B {{.*}} t2{{ +}}1
+// PACK-DAG: ; C {{.*}} t4{{ +}}2
+// PACK-DAG: ; D {{.*}} t6{{ +}}1
+
+// The update order comes first, then declaration order.
+// ORDER-DAG: warning: descriptor tables for main: DescriptorTable(SRV(t2, numDescriptors=5)), DescriptorTable(Sampler(s0))
+// ORDER-DAG: ; A {{.*}} t5{{ +}}1
+// ORDER-DAG: ; B {{.*}} t2{{ +}}1
+// ORDER-DAG: ; C {{.*}} t3{{ +}}2
+// ORDER-DAG: ; D {{.*}} t6{{ +}}1
+
+Texture2D A;
+Texture2D B : register(t2);
+Texture2D C[2];
+Texture2D D;
+SamplerState S;
+
+float4 main(float2 uv : TEXCOORD, uint i : INDEX) : SV_Target {
+  return A.Sample(S, uv) + B.Sample(S, uv) + C[i].Sample(S, uv) +
+         D.Sample(S, uv);
+}
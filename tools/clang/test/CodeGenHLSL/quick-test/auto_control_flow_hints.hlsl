@@ -0,0 +1,34 @@
+// RUN: %dxc -E main -T ps_6_0 -auto-control-flow-hints %s 2>&1 | FileCheck %s
+
+// An expensive side under a uniform condition keeps its branch. A cheap
+// side under a condition that may diverge is flattened. A hint written in
+// the source is left alone.
+
+// CHECK: warning: [branch] selected; the condition is uniform; the sides cost {{[0-9]+}} and 0.
+// CHECK: warning: [flatten] selected; lanes may diverge; the sides cost {{[0-9]+}} and 0.
+// CHECK-NOT: selected;
+
+// CHECK: br i1 %{{.*}}, !dx.controlflow.hints [[BRANCH:![0-9]+]]
+// CHECK: br i1 %{{.*}}, !dx.controlflow.hints [[FLATTEN:![0-9]+]]
+// CHECK: br i1 %{{.*}}, !dx.controlflow.hints [[BRANCH]]
+// CHECK-DAG: [[BRANCH]] = distinct !{[[BRANCH]], !"dx.controlflow.hints", i32 1}
+// CHECK-DAG: [[FLATTEN]] = distinct !{[[FLATTEN]], !"dx.controlflow.hints", i32 2}
+
+RWBuffer<float> u : register(u1);
+Texture2D t;
+SamplerState s;
+uint mode;
+
+float main(float2 uv : UV, float b : B) : SV_Target {
+  float r = 0;
+  if (mode == 1) {
+    r = t.SampleLevel(s, uv, 0).x + t.SampleLevel(s, uv * 2, 0).y;
+    u[0] = r;
+  }
+  if (b > 0)
+    u[1] = b;
+  [branch]
+  if (b > 1)
+    u[2] = b;
+  return r;
+}
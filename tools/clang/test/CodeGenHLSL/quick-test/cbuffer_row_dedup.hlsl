@@ -0,0 +1,25 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// A constant buffer row read on every side of a branch and after it is loaded
+// once, ahead of the branch.
+
+// CHECK: call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK-NOT: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 0)
+// CHECK: br i1
+// CHECK: ret void
+
+cbuffer Material {
+  float4 g_tint;
+};
+
+float4 main(float4 c : COLOR, uint mode : MODE) : SV_Target {
+  float4 r;
+  [branch]
+  if (mode == 0)
+    r = c * g_tint.x;
+  else if (mode == 1)
+    r = c + g_tint.y;
+  else
+    r = c - g_tint.z;
+  return r * g_tint.w;
+}
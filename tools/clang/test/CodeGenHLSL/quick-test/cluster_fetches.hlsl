@@ -0,0 +1,21 @@
+// RUN: %dxc -E main -T ps_6_0 -cluster-fetches %s | FileCheck %s
+
+// The second sample doesn't depend on the math on the first, so it moves up
+// next to it, with the multiply of its coordinates.
+
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK-NOT: fadd
+// CHECK: call %dx.types.ResRet.f32 @dx.op.sample.f32(i32 60
+// CHECK: fadd
+// CHECK: ret void
+
+Texture2D base;
+Texture2D detail;
+SamplerState samp;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  float4 a = base.Sample(samp, uv);
+  float4 b = a * a + a.wzyx;
+  float4 c = detail.Sample(samp, uv * 8);
+  return b * c;
+}
@@ -0,0 +1,18 @@
+// RUN: %dxc -E main -T vs_6_0 %s | FileCheck %s
+
+// The zeros stored to pos are always overwritten, but the ones stored to
+// color are only overwritten when p.x > 0.
+
+// CHECK-NOT: @dx.op.storeOutput.f32(i32 5, i32 0, i32 {{[0-9]+}}, i8 {{[0-9]+}}, float 0.000000e+00)
+// CHECK-DAG: call void @dx.op.storeOutput.f32(i32 5, i32 0, i32 0, i8 0, float %
+// CHECK-DAG: call void @dx.op.storeOutput.f32(i32 5, i32 1, i32 0, i8 0, float 0.000000e+00)
+// CHECK-NOT: @dx.op.storeOutput.f32(i32 5, i32 0, i32 {{[0-9]+}}, i8 {{[0-9]+}}, float 0.000000e+00)
+
+void main(float4 p : POSITION, out float4 pos : SV_Position,
+          out float4 color : COLOR) {
+  pos = 0;
+  color = 0;
+  pos = p * 2;
+  if (p.x > 0)
+    color = p;
+}
@@ -0,0 +1,25 @@
+// RUN: %dxc -E main -T ps_6_0 -Zi-lines %s | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -Zi-lines %s | FileCheck %s -check-prefix=NOVARS
+
+// With line tables only, instructions keep their lines, including those
+// of the inlined helper, but no variables or types are described. The
+// sources are still embedded, for debuggers to show the lines.
+
+// CHECK: @dx.op.unary.f32(i32 13, {{.*}}), !dbg [[SIN:![0-9]+]]
+// CHECK-DAG: !DICompileUnit({{.*}}emissionKind: 2
+// CHECK-DAG: !dx.source.contents = !{
+// CHECK-DAG: [[SIN]] = !DILocation(line: 16, {{.*}}inlinedAt:
+
+// NOVARS-NOT: @llvm.dbg.
+// NOVARS-NOT: !DILocalVariable
+// NOVARS-NOT: !DICompositeType
+
+float helper(float x) {
+  return sin(x) * 2;
+}
+
+float4 main(float4 inp : COLOR) : SV_TARGET0 {
+  float4 a = inp;
+  a.x = helper(a.y);
+  return a;
+}
@@ -0,0 +1,34 @@
+// RUN: %dxc -E main -T ps_6_0 -demote-output-precision %s 2>&1 | FileCheck %s
+
+// Blending two UNORM textures into a color output provably fits in half
+// precision, so it is computed in half. A color scaled by an unbounded
+// constant buffer value isn't.
+
+// CHECK: warning: SV_Target0 computed in 16-bit precision
+// CHECK-NOT: SV_Target1 computed
+
+// CHECK: fptrunc float %{{.*}} to half
+// CHECK: fmul fast half %{{.*}}, 0xH3A00
+// CHECK: call half @dx.op.unary.f16(i32 7,
+// CHECK: fpext half %{{.*}} to float
+// CHECK: call void @dx.op.storeOutput.f32(i32 5, i32 0,
+// CHECK: fmul fast float
+// CHECK: call void @dx.op.storeOutput.f32(i32 5, i32 1,
+
+Texture2D<unorm float4> t0;
+Texture2D<unorm float4> t1;
+SamplerState s;
+float4 tint;
+
+struct PSOut {
+  float4 color : SV_Target0;
+  float4 tinted : SV_Target1;
+};
+
+PSOut main(float2 uv : TEXCOORD) {
+  PSOut o;
+  float4 a = t0.Sample(s, uv);
+  o.color = saturate(a * 0.75 + t1.Sample(s, uv) * 0.25);
+  o.tinted = a * tint;
+  return o;
+}
@@ -0,0 +1,17 @@
+// RUN: echo "-E main -T ps_6_0 %s" | %dxc -server 2>%t.err | FileCheck %s
+// RUN: FileCheck %s -check-prefix=ERR < %t.err
+// RUN: not %dxc -server -not-an-option 2>&1 | FileCheck %s -check-prefix=UNKNOWN
+
+// Standard output only carries the end of each command; the disassembly
+// that the command would print there goes to standard error.
+// CHECK-NOT: define void @main
+// CHECK: dxc-server: 0
+// CHECK-NOT: define void @main
+
+// ERR: define void @main
+
+// UNKNOWN: Unknown argument: '-not-an-option'
+
+float4 main() : SV_Target {
+  return 1;
+}
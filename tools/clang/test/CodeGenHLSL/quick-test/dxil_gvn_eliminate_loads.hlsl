@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// A load from a read-only resource that repeats one made before the branch is
+// replaced with the first load. The UAV load is kept because the store may
+// change what it reads.
+
+// CHECK: call %dx.types.ResRet.f32 @dx.op.textureLoad.f32(
+// CHECK-NOT: call %dx.types.ResRet.f32 @dx.op.textureLoad.f32(
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(
+// CHECK: call void @dx.op.bufferStore.f32(
+// CHECK: call %dx.types.ResRet.f32 @dx.op.bufferLoad.f32(
+// CHECK: ret void
+
+Texture2D<float4> g_albedo;
+RWBuffer<float> g_accum;
+
+float4 main(float4 pos : SV_Position, uint flags : FLAGS) : SV_Target {
+  int3 coord = int3(pos.xy, 0);
+  float4 c = g_albedo.Load(coord);
+  float a = g_accum[flags];
+  if (flags & 1) {
+    g_accum[flags + 1] = c.x;
+    c += g_albedo.Load(coord) * g_accum[flags];
+  }
+  return c * a;
+}
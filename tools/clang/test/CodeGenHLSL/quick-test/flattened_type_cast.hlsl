@@ -0,0 +1,35 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Casts and assignments between structs with bases and long arrays, which
+// Sema compares by their flattened layouts.
+
+// CHECK: @main
+// CHECK: ret void
+
+struct Base {
+  float2 uv;
+};
+
+struct Table : Base {
+  float4 rows[256];
+  int count;
+};
+
+struct Mixed {
+  float2 uv;
+  float4 rows[256];
+  int count;
+};
+
+cbuffer Params {
+  int index;
+  float scale;
+};
+
+float4 main() : SV_Target {
+  Table t = (Table)0;
+  t.rows[index] = scale;
+  Mixed m = (Mixed)t;
+  float4 v[256] = (float4[256])scale;
+  return m.rows[index] + v[index] + m.count;
+}
@@ -0,0 +1,39 @@
+// RUN: %dxc -E main -T cs_6_0 -gather-texel-loads %s | FileCheck %s
+// RUN: %dxc -E main -T cs_6_0 -gather-texel-loads -DCLAMP %s | FileCheck %s -check-prefix=CLAMP
+
+// The four loads of a 2x2 block become one gather at the corner the texels
+// share, through the static border sampler.
+// CHECK: call %dx.types.Dimensions @dx.op.getDimensions(i32 72
+// CHECK: call %dx.types.ResRet.f32 @dx.op.textureGather.f32(i32 73, %dx.types.Handle %{{.*}}, %dx.types.Handle %{{.*}}, float %{{.*}}, float %{{.*}}, float undef, float undef, i32 undef, i32 undef, i32 0)
+// CHECK-NOT: textureLoad
+
+// A clamping sampler would read edge texels where the loads read 0.
+// CLAMP-NOT: textureGather
+// CLAMP: textureLoad
+// CLAMP: textureLoad
+// CLAMP: textureLoad
+// CLAMP: textureLoad
+
+#ifdef CLAMP
+#define ADDRESS "TEXTURE_ADDRESS_CLAMP"
+#else
+#define ADDRESS "TEXTURE_ADDRESS_BORDER"
+#endif
+
+#define RS "DescriptorTable(SRV(t0), UAV(u0)), " \
+           "StaticSampler(s0, addressU = " ADDRESS ", addressV = " ADDRESS ", " \
+           "borderColor = STATIC_BORDER_COLOR_TRANSPARENT_BLACK)"
+
+Texture2D<float> depth : register(t0);
+RWTexture2D<float> result : register(u0);
+SamplerState border : register(s0);
+
+[RootSignature(RS)]
+[numthreads(8, 8, 1)]
+void main(uint2 id : SV_DispatchThreadID) {
+  int2 p = int2(id) * 2;
+  float sum = depth.Load(int3(p, 0)) + depth.Load(int3(p + int2(1, 0), 0)) +
+              depth.Load(int3(p + int2(0, 1), 0)) +
+              depth.Load(int3(p, 0), int2(1, 1));
+  result[id] = sum * 0.25;
+}
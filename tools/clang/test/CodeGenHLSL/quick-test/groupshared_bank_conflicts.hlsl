@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T cs_6_0 -pad-groupshared %s 2>&1 | FileCheck %s
+
+// Writing a column of the tile puts adjacent threads a row, 128 bytes,
+// apart, so all 32 of them hit one bank. A row of 33 floats moves each
+// thread to its own bank. Reading a row is conflict free either way.
+
+// CHECK: warning: 32-way bank conflict on groupshared {{.*}}tile{{.*}}; adjacent threads are 128 bytes apart
+// CHECK-NOT: bank conflict
+// CHECK: warning: groupshared {{.*}}tile{{.*}} padded to [32][33] to avoid bank conflicts
+// CHECK: tile{{.*}} = addrspace(3) global [1056 x float]
+
+groupshared float tile[32][32];
+RWStructuredBuffer<float> buf;
+
+[numthreads(32, 1, 1)]
+void main(uint3 tid : SV_GroupThreadID, uint3 gid : SV_GroupID) {
+  [loop]
+  for (uint i = 0; i < 32; ++i)
+    tile[tid.x][i] = buf[(gid.x * 32 + tid.x) * 32 + i];
+  GroupMemoryBarrierWithGroupSync();
+  float s = 0;
+  [loop]
+  for (uint j = 0; j < 32; ++j)
+    s += tile[j][tid.x];
+  buf[gid.x * 32 + tid.x] = s;
+}
@@ -0,0 +1,38 @@
+// RUN: %dxc -E main -T cs_6_0 %s | FileCheck %s
+// RUN: %dxc -E main -T cs_6_0 -DGUARDED %s | FileCheck %s -check-prefix=GUARD
+
+// The handle for a buffer picked by a constant buffer index, and the
+// constant buffer load feeding it, are created once before the loop rather
+// than on every iteration.
+
+// CHECK: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %
+// CHECK: phi
+// CHECK-NOT: @dx.op.createHandle(i32 57, i8 0
+// CHECK: ret void
+
+// One that only some iterations reach stays in the loop.
+// GUARD: phi
+// GUARD: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 1, i32 1, i32 %
+// GUARD: ret void
+
+Buffer<float> g_buffers[8] : register(t0);
+RWBuffer<float> g_output : register(u0);
+RWBuffer<float> g_partials[8] : register(u1);
+
+cbuffer Params {
+  uint g_bufferIndex;
+  uint g_count;
+};
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID) {
+  float sum = 0;
+  for (uint i = 0; i < g_count; ++i) {
+    sum += g_buffers[g_bufferIndex][id * g_count + i];
+#ifdef GUARDED
+    if (i == id)
+      g_partials[g_bufferIndex][id] = sum;
+#endif
+  }
+  g_output[id] = sum;
+}
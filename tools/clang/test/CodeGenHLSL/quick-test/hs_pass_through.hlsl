@@ -0,0 +1,58 @@
+// RUN: %dxc -E main -T hs_6_0 %s | FileCheck %s
+// RUN: %dxc -E main -T hs_6_0 -DSCALE %s | FileCheck %s -check-prefix=SCALE
+// RUN: %dxc -E main -T hs_6_0 -DSWAP %s | FileCheck %s -check-prefix=SWAP
+
+// A control-point function that copies its input control point is dropped,
+// which makes this a pass-through hull shader.
+// CHECK: declare void @main()
+// CHECK-NOT: outputControlPointID
+
+// One that changes a value keeps its body.
+// SCALE: define void @main()
+// SCALE: outputControlPointID
+
+// So does one that copies another input than its own control point.
+// SWAP: define void @main()
+// SWAP: outputControlPointID
+
+struct ControlPoint {
+  float3 pos : POSITION;
+  float2 uv : TEXCOORD0;
+};
+
+struct PatchConstants {
+  float edges[3] : SV_TessFactor;
+  float inside : SV_InsideTessFactor;
+};
+
+float4 g_TessFactors;
+
+PatchConstants PatchConstantsHS(InputPatch<ControlPoint, 3> ip) {
+  PatchConstants pc;
+  pc.edges[0] = g_TessFactors.x;
+  pc.edges[1] = g_TessFactors.y;
+  pc.edges[2] = g_TessFactors.z;
+  pc.inside = g_TessFactors.w;
+  return pc;
+}
+
+[domain("tri")]
+[partitioning("fractional_odd")]
+[outputtopology("triangle_cw")]
+[outputcontrolpoints(3)]
+[patchconstantfunc("PatchConstantsHS")]
+ControlPoint main(InputPatch<ControlPoint, 3> ip,
+                  uint id : SV_OutputControlPointID) {
+  ControlPoint cp;
+#ifdef SWAP
+  cp.pos = ip[2 - id].pos;
+#else
+  cp.pos = ip[id].pos;
+#endif
+#ifdef SCALE
+  cp.uv = ip[id].uv * 2;
+#else
+  cp.uv = ip[id].uv;
+#endif
+  return cp;
+}
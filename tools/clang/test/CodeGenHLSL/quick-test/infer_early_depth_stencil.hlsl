@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T ps_6_0 -infer-early-depth-stencil %s 2>&1 | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -warn-early-depth-stencil %s 2>&1 | FileCheck %s -check-prefix=WARN
+// RUN: %dxc -E main -T ps_6_0 -infer-early-depth-stencil -DDISCARD %s 2>&1 | FileCheck %s -check-prefix=DISCARD
+
+// The shader writes only a color, so its depth and stencil tests can run
+// before it. A clip() that depends on the texture makes it need them late.
+
+// CHECK: warning: [earlydepthstencil] inferred for pixel shader main
+// CHECK: !{i32 0, i64 8}
+
+// WARN: warning: pixel shader main could use [earlydepthstencil]
+// WARN-NOT: !{i32 0, i64 8}
+
+// DISCARD-NOT: earlydepthstencil
+// DISCARD: call void @dx.op.discard
+
+Texture2D<float4> tex;
+SamplerState samp;
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  float4 c = tex.Sample(samp, uv);
+#ifdef DISCARD
+  clip(c.a - 0.5);
+#endif
+  return c;
+}
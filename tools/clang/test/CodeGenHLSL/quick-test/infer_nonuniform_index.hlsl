@@ -0,0 +1,20 @@
+// RUN: %dxc -E main -T ps_6_0 -infer_nonuniform_index %s 2>&1 | FileCheck %s
+
+// With -infer_nonuniform_index, an index that may differ between lanes gets
+// the non-uniform flag without NonUniformResourceIndex, a uniform index
+// loses it, and each changed index is reported.
+// CHECK-DAG: warning: resource index may differ between lanes; marked as NonUniformResourceIndex.
+// CHECK-DAG: warning: resource index is uniform; NonUniformResourceIndex removed.
+// CHECK-DAG: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 true)
+// CHECK-DAG: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 false)
+
+Texture2D<float4> g_textures[8] : register(t0);
+SamplerState g_samp : register(s0);
+
+uint g_index;
+
+float4 main(nointerpolation uint idx : IDX, float2 uv : TEXCOORD) : SV_Target {
+  float4 a = g_textures[idx].Sample(g_samp, uv);
+  float4 b = g_textures[NonUniformResourceIndex(g_index)].Sample(g_samp, uv);
+  return a + b;
+}
@@ -0,0 +1,19 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Only the columns of an input that the shader reads are loaded.
+
+// CHECK-NOT: @dx.op.loadInput.f32(i32 4,
+// CHECK: call float @dx.op.loadInput.f32(i32 4, i32 0, i32 0, i8 1,
+// CHECK-NOT: @dx.op.loadInput.f32(i32 4,
+// CHECK: call float @dx.op.loadInput.f32(i32 4, i32 1, i32 0, i8 3,
+// CHECK-NOT: @dx.op.loadInput.f32(i32 4,
+
+struct VSOut {
+  float4 a : A;
+  float4 b : B;
+  float4 c[4] : C;
+};
+
+float4 main(VSOut v) : SV_Target {
+  return float4(v.a.y, v.b.w, 0, 1);
+}
@@ -0,0 +1,32 @@
+// RUN: %dxc -E main -T ps_6_0 -fcgl -late-bind-const UseFoo -late-bind-const Scale %s | FileCheck %s -check-prefix=HL
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -late-bind-const UseFoo -late-bind-const Scale %s | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -late-bind-const UseFoo -late-bind-const Scale -pass-option "hl-bind-constants,constants=UseFoo:true;Scale:4" %s | FileCheck %s -check-prefix=BOUND
+
+// The high-level module keeps the consts named with -late-bind-const as
+// globals, read with loads, and lists them by source name.
+// HL: @UseFoo = internal constant
+// HL: @Scale = internal constant float 2.000000e+00
+// HL: load {{.*}} @UseFoo
+// HL: !dx.lateBindConsts =
+
+// Without values, the source ones are folded in as usual.
+// CHECK-NOT: @UseFoo
+// CHECK: fmul fast float %{{.*}}, 2.000000e+00
+// CHECK-NOT: cbufferLoad
+
+// Bound values take their place.
+// BOUND-NOT: @UseFoo
+// BOUND: fmul fast float %{{.*}}, 4.000000e+00
+// BOUND: fadd fast float %{{.*}}, 1.000000e+00
+
+static const bool UseFoo = false;
+static const float Scale = 2.0;
+
+float Foo;
+float4 main(float4 a : A) : SV_Target {
+  float r = a.x * Scale;
+  if (UseFoo)
+    r += Foo + 1;
+  return r;
+}
@@ -0,0 +1,34 @@
+// RUN: %dxc -T lib_6_3 -lib-noinline-size=16 %s | FileCheck %s
+// RUN: %dxc -T lib_6_3 -lib-noinline-size=16 %s | FileCheck -check-prefix=TINY %s
+
+// The large helper is called from both shaders, so it is kept.
+// CHECK-DAG: define internal float @"{{.*}}heavy
+// CHECK-DAG: call float @"{{.*}}heavy
+
+// The small one is inlined.
+// TINY-NOT: tiny
+
+StructuredBuffer<float> In;
+RWStructuredBuffer<float> Out;
+
+float heavy(float x) {
+  float r = sin(x) * cos(x) + x;
+  r = r * r + sqrt(abs(r));
+  r = exp(r) - log(abs(r) + 1);
+  r = r * x + frac(r);
+  return r;
+}
+
+float tiny(float x) {
+  return x + 1;
+}
+
+[shader("raygeneration")]
+void RG1() {
+  Out[0] = heavy(In[0]) + tiny(In[2]);
+}
+
+[shader("raygeneration")]
+void RG2() {
+  Out[1] = heavy(In[1]) + tiny(In[3]);
+}
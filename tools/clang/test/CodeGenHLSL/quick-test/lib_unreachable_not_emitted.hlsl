@@ -0,0 +1,19 @@
+// RUN: %dxc -T lib_6_3 -fcgl %s | FileCheck %s
+
+// Functions that get internal linkage in a library are only emitted when an
+// exported function or a shader reaches them, even before optimization.
+// CHECK-DAG: define {{.*}}export_fn
+// CHECK-DAG: define {{.*}}reached_fn
+// CHECK-DAG: define {{.*}}PSMain
+// CHECK-NOT: unreached_fn
+
+float reached_fn(float f) { return f * 2.0; }
+
+export float export_fn(float f) { return reached_fn(f); }
+
+[shader("pixel")]
+float4 PSMain(float2 coord : TEXCOORD) : SV_Target {
+  return coord.xyxy;
+}
+
+float unreached_fn(float f) { return f + 1.0; }
@@ -0,0 +1,21 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// A small local array that is written and read with dynamic indices is
+// promoted to registers with selects instead of staying an indexable temp,
+// while a larger one stays in memory.
+
+// CHECK-DAG: alloca [32 x float]
+// CHECK-NOT: alloca [4 x float]
+// CHECK: select
+// CHECK: ret void
+
+float4 main(nointerpolation uint i : I, nointerpolation uint j : J,
+            float v : V) : SV_Target {
+  float small[4] = { v, v * 2, v * 3, v * 4 };
+  small[i & 3] = 0;
+  float large[32];
+  for (uint k = 0; k < 32; ++k)
+    large[k] = v * k;
+  large[i & 31] = 1;
+  return float4(small[j & 3], large[j & 31], 0, 1);
+}
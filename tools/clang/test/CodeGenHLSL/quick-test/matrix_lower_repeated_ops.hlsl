@@ -0,0 +1,24 @@
+// RUN: %dxc -E main -T vs_6_0 %s | FileCheck %s
+
+// Many matrix operations share the same lowered signature; each one still
+// lowers to scalar math with no matrix or HL calls left over.
+
+// CHECK: @main
+// CHECK: fmul fast float
+// CHECK-NOT: call {{.*}} @"dx.hl.
+// CHECK: ret void
+
+float4x4 g_bones[32];
+float4x4 g_viewProj;
+
+float4 main(float4 pos : POSITION, uint4 idx : BLENDINDICES,
+            float4 w : BLENDWEIGHT) : SV_Position {
+  float4x4 skin = g_bones[idx.x] * w.x;
+  skin += g_bones[idx.y] * w.y;
+  skin += g_bones[idx.z] * w.z;
+  skin += g_bones[idx.w] * w.w;
+  float4x4 local = transpose(skin);
+  local = mul(local, g_bones[0]);
+  local = mul(g_bones[1], local);
+  return mul(mul(pos, local), g_viewProj);
+}
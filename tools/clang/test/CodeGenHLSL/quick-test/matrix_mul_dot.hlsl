@@ -0,0 +1,29 @@
+// RUN: %dxc -E main -T vs_6_0 %s | FileCheck %s
+
+// The column-major cbuffer matrix keeps each column, which mul(v, M) sums
+// along, in one register, so each result is a dot. The row-major one spreads
+// the sums across registers and keeps the mad chain.
+
+// CHECK: call float @dx.op.dot4.f32(i32 56
+// CHECK: call float @dx.op.dot4.f32(i32 56
+// CHECK: call float @dx.op.dot4.f32(i32 56
+// CHECK: call float @dx.op.dot4.f32(i32 56
+// CHECK-NOT: @dx.op.dot3
+// CHECK: call float @dx.op.tertiary.f32(i32 46
+// CHECK-NOT: @dx.op.dot3
+// CHECK: ret void
+
+float4x4 g_worldViewProj;
+row_major float3x3 g_normalMat;
+
+struct VSOut {
+  float4 pos : SV_Position;
+  float3 normal : NORMAL;
+};
+
+VSOut main(float4 pos : POSITION, float3 normal : NORMAL) {
+  VSOut o;
+  o.pos = mul(pos, g_worldViewProj);
+  o.normal = mul(normal, g_normalMat);
+  return o;
+}
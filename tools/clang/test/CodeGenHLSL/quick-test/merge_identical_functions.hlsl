@@ -0,0 +1,46 @@
+// RUN: %dxc -T lib_6_3 -auto-binding-space 11 -merge-identical-functions %s 2>&1 | FileCheck %s
+// RUN: %dxc -T lib_6_3 -auto-binding-space 11 -merge-identical-functions %s 2>&1 | FileCheck %s -check-prefix=SHADE
+
+// The two hit shaders differ only in name. Neither can call the other, so
+// their body moves to an internal function that both call. The exported
+// helpers keep their names, with ShadeB calling ShadeA.
+
+// CHECK: warning: function HitB is identical to HitA, and now calls it
+// CHECK: define void @"\01?HitA@@
+// CHECK-NEXT: entry:
+// CHECK-NEXT: call void @"\01?HitA@@{{[^"]*}}.merged"
+// CHECK: define void @"\01?HitB@@
+// CHECK-NEXT: entry:
+// CHECK-NEXT: call void @"\01?HitA@@{{[^"]*}}.merged"
+// CHECK: define internal void @"\01?HitA@@{{[^"]*}}.merged"
+// CHECK: @dx.op.sampleLevel
+
+// SHADE: warning: function ShadeB is identical to ShadeA, and now calls it
+// SHADE: define <4 x float> @"\01?ShadeB@@
+// SHADE-NEXT: entry:
+// SHADE-NEXT: {{.*}} = call <4 x float> @"\01?ShadeA@@
+
+struct Payload {
+  float4 color;
+};
+
+Texture2D<float4> tex;
+SamplerState samp;
+
+export float4 ShadeA(float2 uv, float scale) {
+  return tex.SampleLevel(samp, uv, 0) * scale + float4(uv, 0, 1);
+}
+
+export float4 ShadeB(float2 uv, float scale) {
+  return tex.SampleLevel(samp, uv, 0) * scale + float4(uv, 0, 1);
+}
+
+[shader("closesthit")]
+void HitA(inout Payload p, in BuiltInTriangleIntersectionAttributes a) {
+  p.color = tex.SampleLevel(samp, a.barycentrics, 0) * 0.5 + p.color;
+}
+
+[shader("closesthit")]
+void HitB(inout Payload p, in BuiltInTriangleIntersectionAttributes a) {
+  p.color = tex.SampleLevel(samp, a.barycentrics, 0) * 0.5 + p.color;
+}
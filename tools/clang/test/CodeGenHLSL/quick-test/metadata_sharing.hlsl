@@ -0,0 +1,26 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Branches with the same hints share one hint node, and structs with the
+// same layout share their annotation, after a trip through the container.
+
+// CHECK: br i1 %{{.*}}, !dx.controlflow.hints [[HINT:![0-9]+]]
+// CHECK: br i1 %{{.*}}, !dx.controlflow.hints [[HINT]]
+// CHECK: !{i32 0, %{{[^ ]+}} undef, [[ANN:![0-9]+]], %{{[^ ]+}} undef, [[ANN]]}
+// CHECK: [[HINT]] = distinct !{[[HINT]], !"dx.controlflow.hints", i32 1}
+// CHECK-NOT: !"dx.controlflow.hints"
+
+struct S1 { float4 v; };
+struct S2 { float4 v; };
+ConstantBuffer<S1> A;
+ConstantBuffer<S2> B;
+RWBuffer<float> u;
+
+float4 main(float b : B) : SV_Target {
+  [branch]
+  if (b > 0)
+    u[0] = b;
+  [branch]
+  if (b > 1)
+    u[1] = b;
+  return A.v + B.v;
+}
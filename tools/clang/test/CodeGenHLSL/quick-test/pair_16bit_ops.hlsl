@@ -0,0 +1,15 @@
+// RUN: %dxc -E main -T ps_6_2 -enable-16bit-types -pair-16bit-ops %s | FileCheck %s
+
+// The multiply of y doesn't depend on x, so it moves up next to the multiply
+// of x, and the adds end up next to each other too.
+
+// CHECK: fmul {{.*}}half
+// CHECK-NEXT: fmul {{.*}}half
+// CHECK-NEXT: fadd {{.*}}half
+// CHECK-NEXT: fadd {{.*}}half
+
+half2 main(half4 a : A) : SV_Target {
+  half x = a.x * a.y + a.z;
+  half y = a.w * a.x + a.y;
+  return half2(x, y);
+}
@@ -0,0 +1,32 @@
+// RUN: %dxc -E main -T vs_6_0 -position-only %s | FileCheck %s
+
+// Check that the position-only variant keeps the system values, and drops
+// the COLOR output with the texture and math that only it used.
+
+// CHECK: ; Output signature:
+// CHECK-NOT: ; COLOR
+// CHECK: ; SV_Position              0   xyzw        0      POS   float   xyzw
+// CHECK: ; SV_ClipDistance          0   x           1  CLIPDST   float   x
+// CHECK-NOT: ; COLOR
+// CHECK-NOT: @dx.op.sampleLevel
+// CHECK: call void @dx.op.storeOutput.f32(i32 5, i32 0,
+// CHECK: call void @dx.op.storeOutput.f32(i32 5, i32 1,
+// CHECK-NOT: @dx.op.storeOutput
+// CHECK: ret void
+
+Texture2D<float4> tex;
+SamplerState samp;
+
+struct Out {
+  float4 color : COLOR0;
+  float4 pos : SV_Position;
+  float clip : SV_ClipDistance;
+};
+
+Out main(float4 pos : POSITION, float2 uv : TEXCOORD0) {
+  Out o;
+  o.color = tex.SampleLevel(samp, uv, 0) * 2;
+  o.pos = pos;
+  o.clip = pos.z;
+  return o;
+}
@@ -0,0 +1,22 @@
+// RUN: %dxc -E main -T cs_6_2 %s | FileCheck %s
+
+// Loads and stores at contiguous offsets of the same buffer are merged into a
+// single access of all four components.
+
+// CHECK: call %dx.types.ResRet.i32 @dx.op.rawBufferLoad.i32(i32 139, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 undef, i8 15,
+// CHECK-NOT: @dx.op.rawBufferLoad
+// CHECK: call void @dx.op.rawBufferStore.i32(i32 140, %dx.types.Handle %{{.*}}, i32 %{{.*}}, i32 undef, i32 %{{.*}}, i32 %{{.*}}, i32 %{{.*}}, i32 %{{.*}}, i8 15,
+// CHECK-NOT: @dx.op.rawBufferStore
+// CHECK: ret void
+
+ByteAddressBuffer g_particles;
+RWByteAddressBuffer g_output;
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID) {
+  uint addr = id * 16;
+  float3 pos = asfloat(g_particles.Load3(addr));
+  float scale = asfloat(g_particles.Load(addr + 12));
+  g_output.Store3(addr, asuint(pos * scale));
+  g_output.Store(addr + 12, asuint(scale));
+}
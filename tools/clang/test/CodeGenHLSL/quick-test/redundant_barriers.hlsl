@@ -0,0 +1,24 @@
+// RUN: %dxc -E main -T cs_6_0 -eliminate-redundant-barriers %s 2>&1 | FileCheck %s
+
+// Nothing precedes the first barrier. Only groupshared memory is accessed
+// before the second, so it loses its UAV fence, and nothing at all before
+// the third.
+
+// CHECK: warning: removed a barrier; an earlier barrier already orders every access since
+// CHECK: warning: removed the UAV fence of a barrier; an earlier barrier already orders every access since
+// CHECK: warning: removed a barrier; an earlier barrier already orders every access since
+// CHECK: call void @dx.op.barrier(i32 80, i32 9)
+// CHECK-NOT: @dx.op.barrier(
+// CHECK: ret void
+
+RWStructuredBuffer<float> buf;
+groupshared float cache[64];
+
+[numthreads(64, 1, 1)]
+void main(uint gi : SV_GroupIndex) {
+  AllMemoryBarrierWithGroupSync();
+  cache[gi] = gi;
+  AllMemoryBarrierWithGroupSync();
+  GroupMemoryBarrierWithGroupSync();
+  buf[gi] = cache[63 - gi];
+}
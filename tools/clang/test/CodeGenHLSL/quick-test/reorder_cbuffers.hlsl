@@ -0,0 +1,32 @@
+// RUN: %dxc -E main -T ps_6_0 -reorder-cbuffers %s | FileCheck %s
+
+// In declaration order the used constants take rows 0 to 3 and 5, with
+// unused in row 4. Packed, they fit rows 0 to 3, and unused goes last.
+
+// CHECK: cbuffer Material
+// CHECK:       float4 b;                                     ; Offset:    0
+// CHECK:       float3 d;                                     ; Offset:   16
+// CHECK:       float a;                                      ; Offset:   28
+// CHECK:       float2 e;                                     ; Offset:   32
+// CHECK:       float2 g;                                     ; Offset:   40
+// CHECK:       float c;                                      ; Offset:   48
+// CHECK:       float f;                                      ; Offset:   52
+// CHECK:       float4 unused;                                ; Offset:   64
+// CHECK:   } Material                                        ; Offset:    0 Size:    80
+
+// CHECK-NOT: @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %Material_cbuffer, i32 4)
+
+cbuffer Material {
+  float a;
+  float4 b;
+  float c;
+  float3 d;
+  float2 e;
+  float f;
+  float4 unused;
+  float2 g;
+};
+
+float4 main() : SV_Target {
+  return a * b + float4(d, c) + float4(e, g) * f;
+}
@@ -0,0 +1,20 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// Both sides of the branch on a constant take ddx of the same value, so it is
+// taken once, before the branch.
+
+// CHECK: call float @dx.op.unary.f32(i32 83
+// CHECK-NOT: call float @dx.op.unary.f32(i32 83
+// CHECK: br i1
+// CHECK-NOT: call float @dx.op.unary.f32(i32 83
+// CHECK: ret void
+
+cbuffer Params {
+  bool useSin;
+};
+
+float4 main(float2 uv : TEXCOORD) : SV_Target {
+  [branch] if (useSin)
+    return sin(ddx(uv.x * 4)).xxxx;
+  return cos(ddx(uv.x * 4)).xxxx;
+}
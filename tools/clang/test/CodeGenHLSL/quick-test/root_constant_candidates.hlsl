@@ -0,0 +1,34 @@
+// RUN: %dxc -E main -T ps_6_0 -recommend-root-constants %s 2>&1 | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -recommend-root-constants -DRS %s 2>&1 | FileCheck %s -check-prefix=RS
+// RUN: %dxc -E main -T ps_6_0 -recommend-root-constants -pass-option dxil-root-constant-candidates,MaxDWords=16 %s 2>&1 | FileCheck %s -check-prefix=MAX
+// RUN: not %dxc -E main -T ps_6_0 -pass-option dxil-root-constant-candidate,MaxDWords=16 %s 2>&1 | FileCheck %s -check-prefix=UNKNOWN
+
+// PerDraw is 3 DWORDs; Material is 16, too big for root constants. As a
+// root CBV, PerDraw costs 2 DWORDs, so root constants add 1.
+
+// CHECK: warning: cbuffer PerDraw (12 bytes, read by main) could be 3 root constants, if it changes often; reads then skip the descriptor
+// CHECK-NOT: cbuffer Material
+
+// RS: warning: cbuffer PerDraw (12 bytes, read by main) could be 3 root constants, if it changes often; reads then skip the descriptor, and the root signature goes from 3 to 4 DWORDs
+// RS-NOT: cbuffer Material
+
+// MAX: warning: cbuffer PerDraw (12 bytes, read by main) could be 3 root constants
+// MAX: warning: cbuffer Material (64 bytes, read by main) could be 16 root constants
+
+// UNKNOWN: /pass-option names unknown pass 'dxil-root-constant-candidate'
+
+cbuffer PerDraw : register(b0) {
+  uint drawID;
+  float2 scale;
+};
+
+cbuffer Material : register(b1) {
+  float4 colors[4];
+};
+
+#ifdef RS
+[RootSignature("CBV(b0), DescriptorTable(CBV(b1))")]
+#endif
+float4 main() : SV_Target {
+  return colors[drawID & 3] * scale.xyxy;
+}
@@ -0,0 +1,27 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// A large local array of nested structs is split into one scalar array per
+// leaf field, with no struct allocas left over.
+
+// CHECK-DAG: alloca [256 x float]
+// CHECK-DAG: alloca [256 x i32]
+// CHECK-NOT: alloca %struct
+// CHECK: ret void
+
+struct Attenuation { float2 range; uint mode; };
+struct Light { float3 dir; float intensity; Attenuation atten; };
+
+uint g_count;
+
+float4 main(uint idx : IDX) : SV_Target {
+  Light lights[256];
+  for (uint i = 0; i < g_count; ++i) {
+    lights[i].dir = float3(i, 0, 1);
+    lights[i].intensity = i * 0.5;
+    lights[i].atten.range = float2(1, i);
+    lights[i].atten.mode = i & 3;
+  }
+  Light l = lights[idx];
+  float a = l.atten.mode == 0 ? l.atten.range.x : l.atten.range.y;
+  return float4(l.dir * l.intensity * a, 1);
+}
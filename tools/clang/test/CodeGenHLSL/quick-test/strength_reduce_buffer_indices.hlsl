@@ -0,0 +1,31 @@
+// RUN: %dxc -E main -T ps_6_0 -strength-reduce-buffer-indices %s | FileCheck %s
+
+// Each light takes two rows, so the rows of a light are i * 2 and i * 2 + 1.
+// They become a row that steps by 2 each iteration and the next row after
+// it, without a shift or multiply in the loop.
+
+// CHECK: [[ROW:%dxil.sr.index[0-9]*]] = phi i32
+// CHECK: [[ROW1:%dxil.sr.index[0-9]*]] = add i32 [[ROW]], 1
+// CHECK-NOT: shl i32
+// CHECK-DAG: call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 [[ROW]])
+// CHECK-DAG: call %dx.types.CBufRet.f32 @dx.op.cbufferLoadLegacy.f32(i32 59, %dx.types.Handle %{{.*}}, i32 [[ROW1]])
+// CHECK-NOT: shl i32
+// CHECK: add i32 [[ROW]], 2
+
+struct Light {
+  float4 pos;
+  float4 color;
+};
+
+cbuffer Lights {
+  Light lights[16];
+  uint count;
+};
+
+float4 main(float3 p : POSITION) : SV_Target {
+  float4 r = 0;
+  [loop]
+  for (uint i = 0; i < count; ++i)
+    r += lights[i].color / dot(lights[i].pos.xyz - p, lights[i].pos.xyz - p);
+  return r;
+}
@@ -0,0 +1,28 @@
+// RUN: %dxc -E main -T ps_6_0 -strip-unused-before-codegen %s 2>&1 | FileCheck %s
+
+// Only what main reaches is compiled. The warning in the function it never
+// calls isn't reported, and the function called from a method is kept.
+
+// CHECK-NOT: implicit truncation
+// CHECK: define void @main()
+// CHECK: call float @dx.op.unary.f32(i32 13,
+
+float scale;
+Texture2D unusedTexture;
+
+float Helper(float x) {
+  return sin(x) * scale;
+}
+
+struct Shaper {
+  float Apply(float x) { return Helper(x); }
+};
+
+float2 Unused(float4 v) {
+  return v + unusedTexture.Load(int3(0, 0, 0));
+}
+
+float4 main(float x : X) : SV_Target {
+  Shaper s;
+  return s.Apply(x);
+}
@@ -0,0 +1,20 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+
+// NonUniformResourceIndex on an index read from a constant buffer is dropped,
+// since the index is the same on every lane. An index from an input keeps it.
+
+// CHECK-DAG: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 false)
+// CHECK-DAG: call %dx.types.Handle @dx.op.createHandle(i32 57, i8 0, i32 0, i32 %{{.*}}, i1 true)
+
+Texture2D g_textures[16];
+SamplerState g_sampler;
+
+cbuffer Material {
+  uint g_materialIndex;
+};
+
+float4 main(float2 uv : TEXCOORD, nointerpolation uint instance : INSTANCE) : SV_Target {
+  float4 a = g_textures[NonUniformResourceIndex(g_materialIndex * 2)].Sample(g_sampler, uv);
+  float4 b = g_textures[NonUniformResourceIndex(instance)].Sample(g_sampler, uv);
+  return a + b;
+}
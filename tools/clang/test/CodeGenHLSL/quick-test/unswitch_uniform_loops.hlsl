@@ -0,0 +1,43 @@
+// RUN: %dxc -E main -T ps_6_0 -unswitch-uniform-loops %s | FileCheck %s
+// RUN: %dxc -E main -T ps_6_0 -unswitch-uniform-loops -DDIVERGENT %s | FileCheck %s -check-prefix=DIV
+
+// The cbuffer flag is the same for the whole wave, so the loop is copied
+// once per value of it and each copy only computes its own side.
+// CHECK: phi
+// CHECK: call float @dx.op.unary.f32(i32 {{12|13}}
+// CHECK-NOT: call float @dx.op.unary.f32(i32 {{12|13}}
+// CHECK: phi
+// CHECK: call float @dx.op.unary.f32(i32 {{12|13}}
+// CHECK-NOT: call float @dx.op.unary.f32(i32 {{12|13}}
+// CHECK: ret void
+
+// A condition read from an input may differ across the wave, and the loop
+// is left as it is.
+// DIV: call float @dx.op.unary.f32(i32 {{12|13}}
+// DIV: call float @dx.op.unary.f32(i32 {{12|13}}
+// DIV-NOT: call float @dx.op.unary.f32(i32 {{12|13}}
+// DIV: ret void
+
+cbuffer Params {
+  uint count;
+  bool useSin;
+};
+
+float4 main(float3 p : POSITION) : SV_Target {
+#ifdef DIVERGENT
+  bool cond = p.z > 0;
+#else
+  bool cond = useSin;
+#endif
+  float r = 0;
+  [loop]
+  for (uint i = 0; i < count; ++i) {
+    float x = p.x + i * p.y;
+    [branch]
+    if (cond)
+      r += sin(x);
+    else
+      r += cos(x);
+  }
+  return r;
+}
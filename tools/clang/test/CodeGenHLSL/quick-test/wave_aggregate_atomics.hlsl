@@ -0,0 +1,31 @@
+// RUN: %dxc -E main -T cs_6_0 -wave-aggregate-atomics %s 2>&1 | FileCheck %s
+
+// The first add goes to an address read from a cbuffer, so the first lane
+// adds the sum of the wave, and the others rebuild what they would have
+// read. The second add goes to a different address on each lane and stays.
+
+// CHECK: warning: atomic add to an address that is the same on every lane combined into one atomic per wave
+// CHECK-NOT: warning: atomic add
+// CHECK: [[SUM:%.+]] = call i32 @dx.op.waveActiveOp.i32(i32 119, i32 {{%.+}}, i8 0, i8 1)
+// CHECK: [[PREFIX:%.+]] = call i32 @dx.op.wavePrefixOp.i32(i32 121, i32 {{%.+}}, i8 0, i8 1)
+// CHECK: call i1 @dx.op.waveIsFirstLane(i32 110)
+// CHECK: [[OLD:%.+]] = call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle {{%.+}}, i32 0, i32 {{%.+}}, i32 undef, i32 undef, i32 [[SUM]])
+// CHECK: [[READ:%.+]] = phi i32 [ undef, {{%.+}} ], [ [[OLD]], {{%.+}} ]
+// CHECK: [[BASE:%.+]] = call i32 @dx.op.waveReadLaneFirst.i32(i32 118, i32 [[READ]])
+// CHECK: add i32 [[BASE]], [[PREFIX]]
+// CHECK: call i32 @dx.op.atomicBinOp.i32(i32 78, %dx.types.Handle {{%.+}}, i32 0, i32 {{%.+}}, i32 undef, i32 undef, i32 1)
+
+RWByteAddressBuffer counters;
+RWStructuredBuffer<uint> slots;
+
+cbuffer Params {
+  uint bin;
+};
+
+[numthreads(64, 1, 1)]
+void main(uint id : SV_DispatchThreadID) {
+  uint old;
+  counters.InterlockedAdd(bin * 4, id & 7, old);
+  slots[id] = old;
+  counters.InterlockedAdd(id * 4, 1);
+}
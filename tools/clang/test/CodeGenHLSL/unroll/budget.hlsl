@@ -0,0 +1,20 @@
+// RUN: %dxc -E main -T ps_6_0 %s | FileCheck %s
+// CHECK: Could not unroll loop: estimated unrolled size of {{[0-9]+}} exceeds the budget of {{[0-9]+}}.
+// CHECK-NOT: @main
+
+// Check that the compilation fails up front when unrolling the outer loop
+// would expand the already unrolled inner loop past the size budget.
+
+uint g_seed;
+
+float main() : SV_Target {
+  float result = 0;
+  [unroll(4096)]
+  for (uint i = 0; i < 4096; i++) {
+    [unroll]
+    for (uint j = 0; j < 100; j++) {
+      result += sin(float(i * j + g_seed)) * cos(float(j));
+    }
+  }
+  return result;
+}
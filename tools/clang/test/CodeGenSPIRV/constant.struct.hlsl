@@ -11,6 +11,14 @@ struct T {
     int y;
 };
 
+// Initializer with the braces of the type
+// CHECK:      [[b:%\d+]] = OpConstantComposite %v2bool %true %false
+// CHECK:     [[c1:%\d+]] = OpConstantComposite %v2float %float_1 %float_2
+// CHECK:     [[c2:%\d+]] = OpConstantComposite %v2float %float_3 %float_4
+// CHECK:      [[c:%\d+]] = OpConstantComposite %mat2v2float [[c1]] [[c2]]
+// CHECK:      [[s:%\d+]] = OpConstantComposite %S %uint_1 [[b]] [[c]]
+// CHECK:      [[t:%\d+]] = OpConstantComposite %T [[s]] %int_5
+
 void main() {
     // TODO: Okay, we are not acutally generating constants here.
     // We should optimize to use OpConstantComposite for the following.
@@ -21,4 +29,7 @@ void main() {
 // CHECK-NEXT: [[s:%\d+]] = OpCompositeConstruct %S %uint_1 [[b]] [[c]]
 // CHECK-NEXT: {{%\d+}} = OpCompositeConstruct %T [[s]] %int_5
     T t = {1, true, false, 1.0, 2.0, 3.0, 4.0, 5};
+
+// CHECK: OpStore %u [[t]]
+    T u = {{1, {true, false}, {{1.0, 2.0}, {3.0, 4.0}}}, 5};
 }
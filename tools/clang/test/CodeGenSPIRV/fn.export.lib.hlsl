@@ -0,0 +1,20 @@
+// Run: %dxc -T lib_6_3
+
+// CHECK:      OpCapability Linkage
+// CHECK-NOT:  OpEntryPoint
+
+// CHECK:      OpDecorate %shade LinkageAttributes "shade" Export
+// CHECK-NOT:  OpDecorate %scale LinkageAttributes
+// CHECK-NOT:  OpDecorate %unused LinkageAttributes
+
+// CHECK:      %scale = OpFunction %float None
+float scale(float v) { return v * 2.0; }
+
+// CHECK:      %shade = OpFunction %v4float None
+// CHECK:      OpFunctionCall %float %scale
+export float4 shade(float3 n) {
+  return float4(n, scale(n.x));
+}
+
+// CHECK-NOT:  %unused = OpFunction
+float unused() { return 1.0; }
@@ -0,0 +1,18 @@
+// Run: %dxc -T ps_6_0 -E main
+
+// CHECK:      OpCapability Linkage
+// CHECK:      OpEntryPoint Fragment %main "main"
+
+// CHECK:      OpDecorate %shade LinkageAttributes "shade" Import
+
+// Defined in a library that this shader is linked with.
+float4 shade(float3 n);
+
+float4 main(float3 n : NORMAL) : SV_Target {
+// CHECK:      OpFunctionCall %v4float %shade
+  return shade(n);
+}
+
+// CHECK:      %shade = OpFunction %v4float None
+// CHECK-NEXT: OpFunctionParameter %_ptr_Function_v3float
+// CHECK-NEXT: OpFunctionEnd
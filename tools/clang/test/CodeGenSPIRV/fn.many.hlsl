@@ -0,0 +1,93 @@
+// Run: %dxc -T ps_6_0 -E main
+
+// Modules with many functions serialize them on several threads; they must
+// still come out in the order they were emitted.
+
+float f19(float x) { return x * 19.0; }
+float f18(float x) { return f19(x) + 18.0; }
+float f17(float x) { return f18(x) + 17.0; }
+float f16(float x) { return f17(x) + 16.0; }
+float f15(float x) { return f16(x) + 15.0; }
+float f14(float x) { return f15(x) + 14.0; }
+float f13(float x) { return f14(x) + 13.0; }
+float f12(float x) { return f13(x) + 12.0; }
+float f11(float x) { return f12(x) + 11.0; }
+float f10(float x) { return f11(x) + 10.0; }
+float f9(float x) { return f10(x) + 9.0; }
+float f8(float x) { return f9(x) + 8.0; }
+float f7(float x) { return f8(x) + 7.0; }
+float f6(float x) { return f7(x) + 6.0; }
+float f5(float x) { return f6(x) + 5.0; }
+float f4(float x) { return f5(x) + 4.0; }
+float f3(float x) { return f4(x) + 3.0; }
+float f2(float x) { return f3(x) + 2.0; }
+float f1(float x) { return f2(x) + 1.0; }
+float f0(float x) { return f1(x) + 0.0; }
+
+static float result;
+
+// CHECK: %main = OpFunction %void
+// CHECK: OpFunctionCall %float %f0
+void main() {
+  result = f0(1.0);
+}
+
+// CHECK: %f0 = OpFunction %float
+// CHECK: OpFunctionCall %float %f1
+// CHECK: OpFunctionEnd
+// CHECK: %f1 = OpFunction %float
+// CHECK: OpFunctionCall %float %f2
+// CHECK: OpFunctionEnd
+// CHECK: %f2 = OpFunction %float
+// CHECK: OpFunctionCall %float %f3
+// CHECK: OpFunctionEnd
+// CHECK: %f3 = OpFunction %float
+// CHECK: OpFunctionCall %float %f4
+// CHECK: OpFunctionEnd
+// CHECK: %f4 = OpFunction %float
+// CHECK: OpFunctionCall %float %f5
+// CHECK: OpFunctionEnd
+// CHECK: %f5 = OpFunction %float
+// CHECK: OpFunctionCall %float %f6
+// CHECK: OpFunctionEnd
+// CHECK: %f6 = OpFunction %float
+// CHECK: OpFunctionCall %float %f7
+// CHECK: OpFunctionEnd
+// CHECK: %f7 = OpFunction %float
+// CHECK: OpFunctionCall %float %f8
+// CHECK: OpFunctionEnd
+// CHECK: %f8 = OpFunction %float
+// CHECK: OpFunctionCall %float %f9
+// CHECK: OpFunctionEnd
+// CHECK: %f9 = OpFunction %float
+// CHECK: OpFunctionCall %float %f10
+// CHECK: OpFunctionEnd
+// CHECK: %f10 = OpFunction %float
+// CHECK: OpFunctionCall %float %f11
+// CHECK: OpFunctionEnd
+// CHECK: %f11 = OpFunction %float
+// CHECK: OpFunctionCall %float %f12
+// CHECK: OpFunctionEnd
+// CHECK: %f12 = OpFunction %float
+// CHECK: OpFunctionCall %float %f13
+// CHECK: OpFunctionEnd
+// CHECK: %f13 = OpFunction %float
+// CHECK: OpFunctionCall %float %f14
+// CHECK: OpFunctionEnd
+// CHECK: %f14 = OpFunction %float
+// CHECK: OpFunctionCall %float %f15
+// CHECK: OpFunctionEnd
+// CHECK: %f15 = OpFunction %float
+// CHECK: OpFunctionCall %float %f16
+// CHECK: OpFunctionEnd
+// CHECK: %f16 = OpFunction %float
+// CHECK: OpFunctionCall %float %f17
+// CHECK: OpFunctionEnd
+// CHECK: %f17 = OpFunction %float
+// CHECK: OpFunctionCall %float %f18
+// CHECK: OpFunctionEnd
+// CHECK: %f18 = OpFunction %float
+// CHECK: OpFunctionCall %float %f19
+// CHECK: OpFunctionEnd
+// CHECK: %f19 = OpFunction %float
+// CHECK: OpFunctionEnd
@@ -0,0 +1,16 @@
+// Run: %dxc -T ps_6_0 -E main -Oconfig=fast
+
+// The fast recipe inlines and removes the local variables, but doesn't fold
+// the loop away.
+
+float4 main(float4 color : COLOR) : SV_TARGET {
+  float4 sum = 0;
+  for (int i = 0; i < 4; ++i) {
+    sum += color;
+  }
+  return sum;
+}
+
+// CHECK-NOT: OpFunctionCall
+// CHECK:     OpLoopMerge
+// CHECK:     OpFAdd %v4float
@@ -1,16 +1,16 @@
 // Run: %dxc -T ps_6_0 -E main
 
+// CHECK: [[v3f123:%\d+]] = OpConstantComposite %v3float %float_1 %float_2 %float_3
+
 void main() {
 // CHECK-LABEL: %bb_entry = OpLabel
 
-// CHECK:      [[cc00:%\d+]] = OpCompositeConstruct %v3float %float_1 %float_2 %float_3
-// CHECK-NEXT: OpStore %mat1 [[cc00]]
+// CHECK:      OpStore %mat1 [[v3f123]]
     float1x3 mat1 = {1., 2., 3.};
 // CHECK-NEXT: [[cc01:%\d+]] = OpCompositeConstruct %v3float %float_1 %float_2 %float_3
 // CHECK-NEXT: OpStore %mat2 [[cc01]]
     float1x3 mat2 = {1., {2., {{3.}}}};
-// CHECK-NEXT: [[cc02:%\d+]] = OpCompositeConstruct %v3float %float_1 %float_2 %float_3
-// CHECK-NEXT: OpStore %mat3 [[cc02]]
+// CHECK-NEXT: OpStore %mat3 [[v3f123]]
     float1x3 mat3 = float1x3(1., 2., 3.);
 // CHECK-NEXT: [[mat3:%\d+]] = OpLoad %v3float %mat3
 // CHECK-NEXT: OpStore %mat4 [[mat3]]
@@ -1,32 +1,45 @@
 // Run: %dxc -T ps_6_0 -E main
 
-// TODO: optimize to generate constant composite for suitable initializers
 // TODO: decompose matrix in initializer
 
+// Initializers with the layout of the matrix and constant elements
+// CHECK:      [[v3f123:%\d+]] = OpConstantComposite %v3float %float_1 %float_2 %float_3
+// CHECK:      [[v3f456:%\d+]] = OpConstantComposite %v3float %float_4 %float_5 %float_6
+// CHECK:      [[m2v3f:%\d+]] = OpConstantComposite %mat2v3float [[v3f123]] [[v3f456]]
+// CHECK:      [[v2f12:%\d+]] = OpConstantComposite %v2float %float_1 %float_2
+// CHECK:      [[v2f34:%\d+]] = OpConstantComposite %v2float %float_3 %float_4
+// CHECK:      [[v2f56:%\d+]] = OpConstantComposite %v2float %float_5 %float_6
+// CHECK:      [[m3v2f:%\d+]] = OpConstantComposite %mat3v2float [[v2f12]] [[v2f34]] [[v2f56]]
+
 // CHECK:      [[v3fc1:%\d+]] = OpConstantComposite %v3float %float_1 %float_1 %float_1
 // CHECK-NEXT: [[v3fc0:%\d+]] = OpConstantComposite %v3float %float_0 %float_0 %float_0
 
+// CHECK:      [[v3i123:%\d+]] = OpConstantComposite %v3int %int_1 %int_2 %int_3
+// CHECK:      [[v3i456:%\d+]] = OpConstantComposite %v3int %int_4 %int_5 %int_6
+// CHECK:      [[im2v3i:%\d+]] = OpConstantComposite %_arr_v3int_uint_2 [[v3i123]] [[v3i456]]
+// CHECK:      [[v2i12:%\d+]] = OpConstantComposite %v2int %int_1 %int_2
+// CHECK:      [[v2i34:%\d+]] = OpConstantComposite %v2int %int_3 %int_4
+// CHECK:      [[v2i56:%\d+]] = OpConstantComposite %v2int %int_5 %int_6
+// CHECK:      [[im3v2i:%\d+]] = OpConstantComposite %_arr_v2int_uint_3 [[v2i12]] [[v2i34]] [[v2i56]]
+
+// CHECK:      [[v3bftf:%\d+]] = OpConstantComposite %v3bool %false %true %false
+// CHECK:      [[v3bttf:%\d+]] = OpConstantComposite %v3bool %true %true %false
+// CHECK:      [[bm2v3b:%\d+]] = OpConstantComposite %_arr_v3bool_uint_2 [[v3bftf]] [[v3bttf]]
+// CHECK:      [[v2bft:%\d+]] = OpConstantComposite %v2bool %false %true
+// CHECK:      [[v2btf:%\d+]] = OpConstantComposite %v2bool %true %false
+// CHECK:      [[bm3v2b:%\d+]] = OpConstantComposite %_arr_v2bool_uint_3 [[v2bft]] [[v2bft]] [[v2btf]]
+
 void main() {
 // CHECK-LABEL: %bb_entry = OpLabel
 
     // Constructor
-// CHECK:      [[cc00:%\d+]] = OpCompositeConstruct %v3float %float_1 %float_2 %float_3
-// CHECK-NEXT: [[cc01:%\d+]] = OpCompositeConstruct %v3float %float_4 %float_5 %float_6
-// CHECK-NEXT: [[cc02:%\d+]] = OpCompositeConstruct %mat2v3float [[cc00]] [[cc01]]
-// CHECK-NEXT: OpStore %mat1 [[cc02]]
+// CHECK:      OpStore %mat1 [[m2v3f]]
     float2x3 mat1 = float2x3(1.0, 2.0, 3.0, 4.0, 5.0, 6.0);
     // All elements in a single {}
-// CHECK-NEXT: [[cc03:%\d+]] = OpCompositeConstruct %v2float %float_1 %float_2
-// CHECK-NEXT: [[cc04:%\d+]] = OpCompositeConstruct %v2float %float_3 %float_4
-// CHECK-NEXT: [[cc05:%\d+]] = OpCompositeConstruct %v2float %float_5 %float_6
-// CHECK-NEXT: [[cc06:%\d+]] = OpCompositeConstruct %mat3v2float [[cc03]] [[cc04]] [[cc05]]
-// CHECK-NEXT: OpStore %mat2 [[cc06]]
+// CHECK-NEXT: OpStore %mat2 [[m3v2f]]
     float3x2 mat2 = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
     // Each vector has its own {}
-// CHECK-NEXT: [[cc07:%\d+]] = OpCompositeConstruct %v3float %float_1 %float_2 %float_3
-// CHECK-NEXT: [[cc08:%\d+]] = OpCompositeConstruct %v3float %float_4 %float_5 %float_6
-// CHECK-NEXT: [[cc09:%\d+]] = OpCompositeConstruct %mat2v3float [[cc07]] [[cc08]]
-// CHECK-NEXT: OpStore %mat3 [[cc09]]
+// CHECK-NEXT: OpStore %mat3 [[m2v3f]]
     float2x3 mat3 = {{1.0, 2.0, 3.0}, {4.0, 5.0, 6.0}};
     // Wired & complicated {}s
 // CHECK-NEXT: [[cc10:%\d+]] = OpCompositeConstruct %v2float %float_1 %float_2
@@ -154,23 +167,13 @@ void main() {
 
 
     // Constructor
-// CHECK:      [[cc00:%\d+]] = OpCompositeConstruct %v3int %int_1 %int_2 %int_3
-// CHECK-NEXT: [[cc01:%\d+]] = OpCompositeConstruct %v3int %int_4 %int_5 %int_6
-// CHECK-NEXT: [[cc02:%\d+]] = OpCompositeConstruct %_arr_v3int_uint_2 [[cc00]] [[cc01]]
-// CHECK-NEXT: OpStore %imat1 [[cc02]]
+// CHECK:      OpStore %imat1 [[im2v3i]]
     int2x3 imat1 = int2x3(1, 2, 3, 4, 5, 6);
     // All elements in a single {}
-// CHECK-NEXT: [[cc03:%\d+]] = OpCompositeConstruct %v2int %int_1 %int_2
-// CHECK-NEXT: [[cc04:%\d+]] = OpCompositeConstruct %v2int %int_3 %int_4
-// CHECK-NEXT: [[cc05:%\d+]] = OpCompositeConstruct %v2int %int_5 %int_6
-// CHECK-NEXT: [[cc06:%\d+]] = OpCompositeConstruct %_arr_v2int_uint_3 [[cc03]] [[cc04]] [[cc05]]
-// CHECK-NEXT: OpStore %imat2 [[cc06]]
+// CHECK-NEXT: OpStore %imat2 [[im3v2i]]
     int3x2 imat2 = {1, 2, 3, 4, 5, 6};
     // Each vector has its own {}
-// CHECK-NEXT: [[cc07:%\d+]] = OpCompositeConstruct %v3int %int_1 %int_2 %int_3
-// CHECK-NEXT: [[cc08:%\d+]] = OpCompositeConstruct %v3int %int_4 %int_5 %int_6
-// CHECK-NEXT: [[cc09:%\d+]] = OpCompositeConstruct %_arr_v3int_uint_2 [[cc07]] [[cc08]]
-// CHECK-NEXT: OpStore %imat3 [[cc09]]
+// CHECK-NEXT: OpStore %imat3 [[im2v3i]]
     int2x3 imat3 = {{1, 2, 3}, {4, 5, 6}};
     // Wired & complicated {}s
 // CHECK-NEXT: [[cc10:%\d+]] = OpCompositeConstruct %v2int %int_1 %int_2
@@ -281,23 +284,13 @@ void main() {
     int4x4 imat11 = {imat8, imat9, imat10};
 
     // Boolean matrices
-// CHECK:      [[cc00:%\d+]] = OpCompositeConstruct %v3bool %false %true %false
-// CHECK-NEXT: [[cc01:%\d+]] = OpCompositeConstruct %v3bool %true %true %false
-// CHECK-NEXT: [[cc02:%\d+]] = OpCompositeConstruct %_arr_v3bool_uint_2 [[cc00]] [[cc01]]
-// CHECK-NEXT:                 OpStore %bmat1 [[cc02]]
+// CHECK:      OpStore %bmat1 [[bm2v3b]]
     bool2x3 bmat1 = bool2x3(false, true, false, true, true, false);
     // All elements in a single {}
-// CHECK-NEXT: [[cc03:%\d+]] = OpCompositeConstruct %v2bool %false %true
-// CHECK-NEXT: [[cc04:%\d+]] = OpCompositeConstruct %v2bool %false %true
-// CHECK-NEXT: [[cc05:%\d+]] = OpCompositeConstruct %v2bool %true %false
-// CHECK-NEXT: [[cc06:%\d+]] = OpCompositeConstruct %_arr_v2bool_uint_3 [[cc03]] [[cc04]] [[cc05]]
-// CHECK-NEXT:                 OpStore %bmat2 [[cc06]]
+// CHECK-NEXT: OpStore %bmat2 [[bm3v2b]]
     bool3x2 bmat2 = {false, true, false, true, true, false};
     // Each vector has its own {}
-// CHECK-NEXT: [[cc07:%\d+]] = OpCompositeConstruct %v3bool %false %true %false
-// CHECK-NEXT: [[cc08:%\d+]] = OpCompositeConstruct %v3bool %true %true %false
-// CHECK-NEXT: [[cc09:%\d+]] = OpCompositeConstruct %_arr_v3bool_uint_2 [[cc07]] [[cc08]]
-// CHECK-NEXT:                 OpStore %bmat3 [[cc09]]
+// CHECK-NEXT: OpStore %bmat3 [[bm2v3b]]
     bool2x3 bmat3 = {{false, true, false}, {true, true, false}};
     // Wired & complicated {}s
 // CHECK-NEXT: [[cc10:%\d+]] = OpCompositeConstruct %v2bool %false %true
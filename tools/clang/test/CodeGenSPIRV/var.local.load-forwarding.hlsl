@@ -0,0 +1,17 @@
+// Run: %dxc -T ps_6_0 -E main -Oconfig=--compact-ids
+
+// Within a basic block, loads of a local variable reuse the value last
+// stored to it instead of loading it again.
+
+float4 main(float4 a : A) : SV_Target {
+  float4 b = a;
+  float4 c = b + b;
+  return c * b;
+}
+
+// CHECK:      [[a:%\d+]] = OpLoad %v4float %a
+// CHECK-NEXT:              OpStore %b [[a]]
+// CHECK-NEXT: [[c:%\d+]] = OpFAdd %v4float [[a]] [[a]]
+// CHECK-NEXT:              OpStore %c [[c]]
+// CHECK-NEXT: [[r:%\d+]] = OpFMul %v4float [[c]] [[a]]
+// CHECK-NEXT:              OpReturnValue [[r]]
@@ -1,7 +1,10 @@
 // Run: %dxc -T vs_6_0 -E main
 
-// CHECK: [[v3b0:%\d+]] = OpConstantNull %v3bool
-// CHECK: [[v4f0:%\d+]] = OpConstantNull %v4float
+// CHECK:     [[v3b0:%\d+]] = OpConstantNull %v3bool
+// CHECK-DAG:  [[v2f12:%\d+]] = OpConstantComposite %v2float %float_1 %float_2
+// CHECK-DAG:  [[v2f34:%\d+]] = OpConstantComposite %v2float %float_3 %float_4
+// CHECK-DAG: [[mat1234:%\d+]] = OpConstantComposite %mat2v2float [[v2f12]] [[v2f34]]
+// CHECK-DAG:     [[v4f0:%\d+]] = OpConstantNull %v4float
 
 // CHECK: %ga = OpVariable %_ptr_Private_int Private
 static int ga = 6;
@@ -9,10 +12,9 @@ static int ga = 6;
 static bool3 gb;
 // The front end has no const evaluation support for HLSL specific types.
 // So the following will ends up trying to create an OpStore into gc. We emit
-// those initialization code at the beginning of the entry function.
-// TODO: optimize this to emit initializer directly: need to fix either the
-// general const evaluation in the front end or add const evaluation in our
-// InitListHandler.
+// those initialization code at the beginning of the entry function, storing
+// the constant the InitListHandler evaluates.
+// TODO: optimize this to emit initializer directly on the variable.
 static float2x2 gc = {1, 2, 3, 4};
 
 // CHECK: %a = OpVariable %_ptr_Private_uint Private
@@ -26,9 +28,6 @@ static float2x2 gc = {1, 2, 3, 4};
 // CHECK-LABEL: OpLabel
 // CHECK:      OpStore %ga %int_6
 // CHECK-NEXT: OpStore %gb [[v3b0]]
-// CHECK-NEXT: [[v2f12:%\d+]] = OpCompositeConstruct %v2float %float_1 %float_2
-// CHECK-NEXT: [[v2f34:%\d+]] = OpCompositeConstruct %v2float %float_3 %float_4
-// CHECK-NEXT: [[mat1234:%\d+]] = OpCompositeConstruct %mat2v2float [[v2f12]] [[v2f34]]
 // CHECK-NEXT: OpStore %gc [[mat1234]]
 // CHECK:      OpFunctionCall %int %src_main
 // CHECK-LABEL: OpFunctionEnd
@@ -0,0 +1,19 @@
+// Run: %dxc -T vs_6_0 -E main -fvk-spec-constant kCount 7 -fvk-spec-constant kScale 8
+
+// CHECK: OpDecorate [[count:%\d+]] SpecId 7
+// CHECK: OpDecorate [[scale:%\d+]] SpecId 8
+
+// CHECK: [[count]] = OpSpecConstant %int 4
+static const int kCount = 4;
+// CHECK: [[scale]] = OpSpecConstant %float 0.5
+static const float kScale = 0.5;
+// Not named on the command line, so it isn't a spec constant.
+static const int kOther = 3;
+
+float main() : A {
+// Uses of spec constants aren't folded into their default values.
+// CHECK:      [[mul:%\d+]] = OpIMul %int [[count]] %int_2
+// CHECK-NEXT: [[cvt:%\d+]] = OpConvertSToF %float [[mul]]
+// CHECK-NEXT:     {{%\d+}} = OpFMul %float [[cvt]] [[scale]]
+  return (kCount * 2) * kScale + kOther;
+}
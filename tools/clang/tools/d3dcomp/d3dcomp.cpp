@@ -34,6 +34,23 @@ HRESULT CreateContainerReflection(IDxcContainerReflection **ppReflection) {
                            (void **)ppReflection);
 }
 
+// Legacy applications can't pass -cache-dir, so the compile cache directory
+// is taken from the DXC_D3DCOMPILE_CACHE_DIR environment variable, read
+// once per process. Compiles are only cached when it is set.
+static LPCWSTR GetCompileCacheDir() {
+  static const std::wstring CacheDir = []() {
+    std::wstring Dir;
+    DWORD Size = GetEnvironmentVariableW(L"DXC_D3DCOMPILE_CACHE_DIR", nullptr, 0);
+    if (Size > 1) {
+      Dir.resize(Size);
+      Size = GetEnvironmentVariableW(L"DXC_D3DCOMPILE_CACHE_DIR", &Dir[0], Size);
+      Dir.resize(Size);
+    }
+    return Dir;
+  }();
+  return CacheDir.empty() ? nullptr : CacheDir.c_str();
+}
+
 HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
                         const D3D_SHADER_MACRO *pDefines, IDxcIncludeHandler *pInclude,
                         LPCSTR pEntrypoint, LPCSTR pTarget, UINT Flags1,
@@ -104,6 +121,10 @@ HRESULT CompileFromBlob(IDxcBlobEncoding *pSource, LPCWSTR pSourceName,
     // We don't implement this:
     //if(Flags1 & D3DCOMPILE_PARTIAL_PRECISION) arguments.push_back(L"/Gpp");
     if(Flags1 & D3DCOMPILE_RESOURCES_MAY_ALIAS) arguments.push_back(L"/res_may_alias");
+    if (LPCWSTR pCacheDir = GetCompileCacheDir()) {
+      arguments.push_back(L"/cache-dir");
+      arguments.push_back(pCacheDir);
+    }
 
     IFR(CreateCompiler(&compiler));
     IFR(compiler->Compile(pSource, pSourceName, pEntrypointW, pTargetProfileW,
@@ -16,9 +16,17 @@
 #include "dxc/dxcapi.h"
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerReader.h"
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <dia2.h>
 #include <intsafe.h>
 
@@ -48,6 +56,36 @@ static cl::opt<bool> ListFiles("listfiles",
 static cl::opt<std::string>
     ExtractFile("extractfile", cl::desc("Extract file from debug information (use '*' for all files)"));
 
+static cl::opt<std::string>
+    Manifest("manifest", cl::desc("Build the containers listed in a manifest, one per line:\n"
+                                  "  <input> <output> [+FOURCC=<part file>] [-FOURCC] ...\n"
+                                  "Inputs are containers or assembly; +RTS0=rs.bin sets the root\n"
+                                  "signature, -ILDB strips debug info. Relative paths are relative\n"
+                                  "to the manifest"),
+             cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+    ThreadCount("j", cl::desc("Number of threads building manifest entries (default: one per core)"),
+                cl::init(0));
+
+// A container to build from a manifest line.
+struct DxaManifestEntry {
+  unsigned Line;
+  std::string Input;
+  std::string Output;
+  std::vector<std::pair<UINT32, std::string>> AddParts;
+  std::vector<UINT32> RemoveParts;
+  std::string Error;
+};
+
+static bool GetFourCC(StringRef Name, UINT32 &FourCC) {
+  if (Name.size() != 4)
+    return false;
+  FourCC = ((UINT32)Name[0] | ((UINT32)Name[1] << 8) |
+            ((UINT32)Name[2] << 16) | ((UINT32)Name[3] << 24));
+  return true;
+}
+
 
 class DxaContext {
 
@@ -55,10 +93,13 @@ private:
   DxcDllSupport &m_dxcSupport;
   HRESULT GetInjectedSourcesTable(IDxcLibrary *pLibrary, IDxcBlob *pTargetBlob, IDiaTable **ppTable);
   HRESULT FindModule(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcBlob **ppTarget);
+  bool LoadContainerView(hlsl::DxilContainerView &view);
 public:
   DxaContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {}
 
   void Assemble();
+  void BuildEntry(DxaManifestEntry &Entry);
+  int BuildManifest();
   bool ExtractFile(const char *pName);
   bool ExtractPart(const char *pName);
   void ListFiles();
@@ -100,6 +141,176 @@ void DxaContext::Assemble() {
   }
 }
 
+// Builds one manifest entry on the calling thread. Inputs and parts are
+// mapped rather than read, so only the pages the builder copies are touched.
+void DxaContext::BuildEntry(DxaManifestEntry &Entry) {
+  CComPtr<IDxcBlob> pInput;
+  IFT(hlsl::DxcCreateBlobFromMappedFile(StringRefUtf16(Entry.Input), &pInput));
+
+  CComPtr<IDxcBlob> pContainer;
+  if (hlsl::IsDxilContainerLike(pInput->GetBufferPointer(),
+                                pInput->GetBufferSize())) {
+    pContainer = pInput;
+  } else {
+    CComPtr<IDxcAssembler> pAssembler;
+    CComPtr<IDxcOperationResult> pAssembleResult;
+    HRESULT status;
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+    IFT(pAssembler->AssembleToContainer(pInput, &pAssembleResult));
+    IFT(pAssembleResult->GetStatus(&status));
+    if (FAILED(status)) {
+      CComPtr<IDxcBlobEncoding> pErrors;
+      IFT(pAssembleResult->GetErrorBuffer(&pErrors));
+      IFTMSG(status, std::string((const char *)pErrors->GetBufferPointer(),
+                                 pErrors->GetBufferSize()));
+    }
+    IFT(pAssembleResult->GetResult(&pContainer));
+  }
+
+  if (!Entry.AddParts.empty() || !Entry.RemoveParts.empty()) {
+    CComPtr<IDxcContainerBuilder> pBuilder;
+    CComPtr<IDxcOperationResult> pBuildResult;
+    HRESULT status;
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerBuilder, &pBuilder));
+    IFT(pBuilder->Load(pContainer));
+    // Parts that are already missing are fine to remove, and added parts
+    // replace the ones there.
+    for (UINT32 fourCC : Entry.RemoveParts) {
+      HRESULT hr = pBuilder->RemovePart(fourCC);
+      if (hr != DXC_E_MISSING_PART)
+        IFT(hr);
+    }
+    for (auto &Part : Entry.AddParts) {
+      CComPtr<IDxcBlob> pPart;
+      IFT(hlsl::DxcCreateBlobFromMappedFile(StringRefUtf16(Part.second), &pPart));
+      HRESULT hr = pBuilder->RemovePart(Part.first);
+      if (hr != DXC_E_MISSING_PART && hr != E_INVALIDARG)
+        IFT(hr);
+      IFT(pBuilder->AddPart(Part.first, pPart));
+    }
+    IFT(pBuilder->SerializeContainer(&pBuildResult));
+    IFT(pBuildResult->GetStatus(&status));
+    if (FAILED(status)) {
+      CComPtr<IDxcBlobEncoding> pErrors;
+      IFT(pBuildResult->GetErrorBuffer(&pErrors));
+      IFTMSG(status, std::string((const char *)pErrors->GetBufferPointer(),
+                                 pErrors->GetBufferSize()));
+    }
+    pContainer.Release();
+    IFT(pBuildResult->GetResult(&pContainer));
+  }
+
+  WriteBlobToFile(pContainer, StringRefUtf16(Entry.Output));
+}
+
+// Builds every entry of the manifest on a pool of threads, then prints the
+// entries that failed. Returns the process exit code.
+int DxaContext::BuildManifest() {
+  CComPtr<IDxcBlob> pManifest;
+  IFT(hlsl::DxcCreateBlobFromMappedFile(StringRefUtf16(Manifest), &pManifest));
+  StringRef Text((const char *)pManifest->GetBufferPointer(),
+                 pManifest->GetBufferSize());
+  StringRef BaseDir = sys::path::parent_path(Manifest);
+  auto Resolve = [&](StringRef Path) -> std::string {
+    if (BaseDir.empty() || sys::path::is_absolute(Path))
+      return Path.str();
+    SmallString<128> Resolved(BaseDir);
+    sys::path::append(Resolved, Path);
+    return Resolved.str();
+  };
+
+  std::vector<DxaManifestEntry> Entries;
+  unsigned LineNumber = 0;
+  size_t ParseErrors = 0;
+  while (!Text.empty()) {
+    StringRef Line;
+    std::tie(Line, Text) = Text.split('\n');
+    ++LineNumber;
+    Line = Line.trim();
+    if (Line.empty() || Line[0] == '#')
+      continue;
+    SmallVector<StringRef, 8> Fields;
+    Line.split(Fields, " ", -1, false);
+    DxaManifestEntry Entry;
+    Entry.Line = LineNumber;
+    if (Fields.size() < 2) {
+      Entry.Error = "expected <input> <output>";
+    } else {
+      Entry.Input = Resolve(Fields[0]);
+      Entry.Output = Resolve(Fields[1]);
+    }
+    for (StringRef Field : makeArrayRef(Fields).slice(std::min<size_t>(2, Fields.size()))) {
+      UINT32 fourCC;
+      StringRef Name, File;
+      std::tie(Name, File) = Field.drop_front().split('=');
+      if (Field[0] == '+' && GetFourCC(Name, fourCC) && !File.empty())
+        Entry.AddParts.emplace_back(fourCC, Resolve(File));
+      else if (Field[0] == '-' && GetFourCC(Field.drop_front(), fourCC))
+        Entry.RemoveParts.push_back(fourCC);
+      else
+        Entry.Error = "unexpected '" + Field.str() + "'";
+    }
+    if (!Entry.Error.empty())
+      ++ParseErrors;
+    Entries.emplace_back(std::move(Entry));
+  }
+
+  std::atomic<size_t> Next(0);
+  auto worker = [&]() {
+    for (size_t i = Next++; i < Entries.size(); i = Next++) {
+      DxaManifestEntry &Entry = Entries[i];
+      if (!Entry.Error.empty())
+        continue;
+      try {
+        BuildEntry(Entry);
+      } catch (const ::hlsl::Exception &hlslException) {
+        Entry.Error = hlslException.msg;
+        if (Entry.Error.empty()) {
+          char Buffer[64];
+          sprintf_s(Buffer, _countof(Buffer), "error code 0x%08x",
+                    (unsigned)hlslException.hr);
+          Entry.Error = Buffer;
+        }
+      } catch (...) {
+        Entry.Error = "unknown error";
+      }
+    }
+  };
+
+  unsigned Threads = ThreadCount ? (unsigned)ThreadCount
+                                 : std::thread::hardware_concurrency();
+  Threads = std::max(1u, std::min<unsigned>(Threads, Entries.size()));
+  auto Start = std::chrono::steady_clock::now();
+  if (ParseErrors == 0) {
+    if (Threads > 1) {
+      std::vector<std::thread> Pool;
+      for (unsigned i = 0; i < Threads; ++i)
+        Pool.emplace_back(worker);
+      for (std::thread &T : Pool)
+        T.join();
+    } else {
+      worker();
+    }
+  }
+  double Seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - Start).count();
+
+  size_t Failed = 0;
+  for (const DxaManifestEntry &Entry : Entries) {
+    if (Entry.Error.empty())
+      continue;
+    ++Failed;
+    printf("%s(%u): %s\n", Manifest.c_str(), Entry.Line,
+           StringRef(Entry.Error).rtrim().str().c_str());
+  }
+  if (ParseErrors)
+    return 1;
+  printf("Built %u of %u containers in %.2f s on %u threads.\n",
+         (unsigned)(Entries.size() - Failed), (unsigned)Entries.size(),
+         Seconds, Threads);
+  return Failed ? 1 : 0;
+}
+
 // Finds DXIL module from the blob assuming blob is either DxilContainer, DxilPartHeader, or DXIL module
 HRESULT DxaContext::FindModule(hlsl::DxilFourCC fourCC, IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcBlob **ppTargetBlob) {
   if (!pSource || !pLibrary || !ppTargetBlob)
@@ -238,11 +449,17 @@ bool DxaContext::ExtractFile(const char *pName) {
   return printedAny;
 }
 
-bool DxaContext::ExtractPart(const char *pName) {
-  CComPtr<IDxcContainerReflection> pReflection;
-  CComPtr<IDxcBlobEncoding> pSource;
-  UINT32 partCount;
+// Maps the input so that parts are read in place rather than copied.
+// Returns false for standard input and for containers with compressed
+// parts, which are read through IDxcContainerReflection instead.
+bool DxaContext::LoadContainerView(hlsl::DxilContainerView &view) {
+  if (InputFilename == "-")
+    return false;
+  IFT(view.LoadFile(StringRefUtf16(InputFilename)));
+  return view.FindPart(hlsl::DFCC_CompressedPart) == nullptr;
+}
 
+bool DxaContext::ExtractPart(const char *pName) {
   // If the part name is 'module', don't just extract the part,
   // but also skip the appropriate header.
   bool extractModule = strcmp("module", pName) == 0;
@@ -253,60 +470,83 @@ bool DxaContext::ExtractPart(const char *pName) {
     pName = "ILDB";
     extractModule = true;
   }
-
-  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
-  IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerReflection, &pReflection));
-  IFT(pReflection->Load(pSource));
-  IFT(pReflection->GetPartCount(&partCount));
   IFTARG(strlen(pName) == 4);
 
   const UINT32 matchName = ((UINT32)pName[0] | ((UINT32)pName[1] << 8) | ((UINT32)pName[2] << 16) | ((UINT32)pName[3] << 24));
-  for (UINT32 i = 0; i < partCount; ++i) {
-    UINT32 partKind;
-    IFT(pReflection->GetPartKind(i, &partKind));
-    if (partKind == matchName) {
-      CComPtr<IDxcBlob> pContent;
-      IFT(pReflection->GetPartContent(i, &pContent));
-      if (OutputFilename.empty()) {
-        if (InputFilename == "-") {
-          OutputFilename = "-";
-        }
-        else {
-          OutputFilename = InputFilename.getValue();
-          OutputFilename += ".";
-          if (extractModule) {
-            OutputFilename += "ll";
-          }
-          else {
-            OutputFilename += pName;
-          }
-        }
+  const char *pData = nullptr;
+  uint32_t dataSize = 0;
+  hlsl::DxilContainerView view;
+  CComPtr<IDxcBlob> pContent;
+  if (LoadContainerView(view)) {
+    const hlsl::DxilPartHeader *pPart = view.FindPart(matchName);
+    if (pPart == nullptr) {
+      return false;
+    }
+    pData = hlsl::GetDxilPartData(pPart);
+    dataSize = pPart->PartSize;
+  }
+  else {
+    CComPtr<IDxcContainerReflection> pReflection;
+    CComPtr<IDxcBlobEncoding> pSource;
+    UINT32 partCount;
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerReflection, &pReflection));
+    IFT(pReflection->Load(pSource));
+    IFT(pReflection->GetPartCount(&partCount));
+    for (UINT32 i = 0; i < partCount && !pContent; ++i) {
+      UINT32 partKind;
+      IFT(pReflection->GetPartKind(i, &partKind));
+      if (partKind == matchName) {
+        IFT(pReflection->GetPartContent(i, &pContent));
       }
+    }
+    if (!pContent) {
+      return false;
+    }
+    pData = (const char *)pContent->GetBufferPointer();
+    dataSize = (uint32_t)pContent->GetBufferSize();
+  }
 
+  if (OutputFilename.empty()) {
+    if (InputFilename == "-") {
+      OutputFilename = "-";
+    }
+    else {
+      OutputFilename = InputFilename.getValue();
+      OutputFilename += ".";
       if (extractModule) {
-        char *pDxilPart = (char *)pContent->GetBufferPointer();
-        hlsl::DxilProgramHeader *pProgramHdr = (hlsl::DxilProgramHeader *)pDxilPart;
-        const char *pBitcode;
-        uint32_t bitcodeLength;
-        GetDxilProgramBitcode(pProgramHdr, &pBitcode, &bitcodeLength);
-        uint32_t offset = pBitcode - pDxilPart;
-
-        CComPtr<IDxcLibrary> pLib;
-        CComPtr<IDxcBlob> pModuleBlob;
-        IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLib));
-        IFT(pLib->CreateBlobFromBlob(pContent, offset, bitcodeLength, &pModuleBlob));
-        std::swap(pModuleBlob, pContent);
+        OutputFilename += "ll";
+      }
+      else {
+        OutputFilename += pName;
       }
-
-      WriteBlobToFile(pContent, StringRefUtf16(OutputFilename));
-      printf("%Iu bytes written to %s\n", pContent->GetBufferSize(), OutputFilename.c_str());
-      return true;
     }
   }
-  return false;
+
+  if (extractModule) {
+    const hlsl::DxilProgramHeader *pProgramHdr = (const hlsl::DxilProgramHeader *)pData;
+    GetDxilProgramBitcode(pProgramHdr, &pData, &dataSize);
+  }
+
+  hlsl::WriteBinaryFile(StringRefUtf16(OutputFilename), pData, dataSize);
+  printf("%u bytes written to %s\n", dataSize, OutputFilename.c_str());
+  return true;
 }
 
 void DxaContext::ListParts() {
+  hlsl::DxilContainerView view;
+  if (LoadContainerView(view)) {
+    printf("Part count: %u\n", view.GetPartCount());
+    for (UINT32 i = 0; i < view.GetPartCount(); ++i) {
+      const hlsl::DxilPartHeader *pPart = view.GetPart(i);
+      IFTBOOL(pPart != nullptr, DXC_E_CONTAINER_INVALID);
+      char kindText[5];
+      hlsl::PartKindToCharArray(pPart->PartFourCC, kindText);
+      printf("#%u - %s\n", i, kindText);
+    }
+    return;
+  }
+
   CComPtr<IDxcContainerReflection> pReflection;
   CComPtr<IDxcBlobEncoding> pSource;
   UINT32 partCount;
@@ -341,7 +581,11 @@ int __cdecl main(int argc, _In_reads_z_(argc) char **argv) {
 
     dxc::EnsureEnabled(dxcSupport);
     DxaContext context(dxcSupport);
-    if (ListParts) {
+    if (!Manifest.empty()) {
+      pStage = "Building manifest";
+      return context.BuildManifest();
+    }
+    else if (ListParts) {
       pStage = "Listing parts";
       context.ListParts();
     }
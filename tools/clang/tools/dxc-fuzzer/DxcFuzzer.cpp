@@ -0,0 +1,178 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// DxcFuzzer.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Compiles each fuzzer input as a shader and reports slow or memory-hungry  //
+// compiles as findings.                                                     //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// libFuzzer only finds inputs that crash. Inputs that compile for minutes or
+// take gigabytes, such as nested unrolls or exponential SROA and matrix
+// cases, are just as much a bug, so this harness aborts, which libFuzzer
+// saves as a crash artifact, when a compile takes longer or allocates more
+// than a limit. Limits and the target come from the environment, because
+// libFuzzer owns the command line:
+//
+//   DXC_FUZZ_TARGET  target profile, ps_6_0 by default
+//   DXC_FUZZ_ENTRY   entry point, main by default
+//   DXC_FUZZ_MAX_MS  wall time limit of a compile, 5000 by default
+//   DXC_FUZZ_MAX_MB  memory limit of a compile, 512 by default
+//
+// The memory limit is also passed as -max-memory, so on Windows, where the
+// compiler's heap is tracked, a compile stops when it reaches the limit and
+// the peak comes from the compile itself. Elsewhere the peak is the highest
+// resident set size of the process, which only grows, so the input that
+// takes it past the limit is the one reported.
+//
+// Artifacts are reduced with reduce_slow_input.py, which writes them out as
+// regression tests for the dxc_bench corpus.
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace dxc;
+
+namespace {
+
+struct FuzzLimits {
+  std::wstring TargetProfile;
+  std::wstring EntryPoint;
+  std::wstring MaxMemoryArg;
+  unsigned long MaxMs;
+  unsigned long MaxMB;
+};
+
+std::wstring GetEnvWide(const char *Name, const char *Default) {
+  const char *Value = getenv(Name);
+  return Unicode::UTF8ToUTF16StringOrThrow(Value && *Value ? Value : Default);
+}
+
+unsigned long GetEnvUnsigned(const char *Name, unsigned long Default) {
+  const char *Value = getenv(Name);
+  if (!Value || !*Value)
+    return Default;
+  char *End = nullptr;
+  unsigned long Result = strtoul(Value, &End, 10);
+  if (*End != '\0' || Result == 0) {
+    fprintf(stderr, "dxc-fuzzer: ignoring %s=%s, not a positive number\n",
+            Name, Value);
+    return Default;
+  }
+  return Result;
+}
+
+class FuzzContext {
+private:
+  DxcDllSupport m_dxcSupport;
+  CComPtr<IDxcLibrary> m_pLibrary;
+  CComPtr<IDxcCompiler> m_pCompiler;
+  FuzzLimits m_limits;
+
+public:
+  FuzzContext() {
+    dxc::EnsureEnabled(m_dxcSupport);
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &m_pLibrary));
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &m_pCompiler));
+    m_limits.TargetProfile = GetEnvWide("DXC_FUZZ_TARGET", "ps_6_0");
+    m_limits.EntryPoint = GetEnvWide("DXC_FUZZ_ENTRY", "main");
+    m_limits.MaxMs = GetEnvUnsigned("DXC_FUZZ_MAX_MS", 5000);
+    m_limits.MaxMB = GetEnvUnsigned("DXC_FUZZ_MAX_MB", 512);
+    m_limits.MaxMemoryArg =
+        L"-max-memory=" + std::to_wstring(m_limits.MaxMB);
+  }
+
+  void Run(const uint8_t *Data, size_t Size);
+};
+
+// Highest number of bytes the compile, or elsewhere the process, had at any
+// one time, or -1 if unknown.
+int64_t GetPeakBytes(IDxcOperationResult *pResult) {
+  CComPtr<IDxcCompileMemoryUsage> pMemory;
+  UINT64 PeakBytes;
+  if (SUCCEEDED(pResult->QueryInterface(&pMemory)) &&
+      SUCCEEDED(pMemory->GetPeakBytes(&PeakBytes)))
+    return (int64_t)PeakBytes;
+#ifndef _WIN32
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) == 0) {
+#ifdef __APPLE__
+    return (int64_t)Usage.ru_maxrss;
+#else
+    return (int64_t)Usage.ru_maxrss * 1024;
+#endif
+  }
+#endif
+  return -1;
+}
+
+// Tells whether the compile failed because it ran out of -max-memory.
+bool ExceededMemoryBudget(IDxcOperationResult *pResult) {
+  CComPtr<IDxcBlobEncoding> pErrors;
+  if (FAILED(pResult->GetErrorBuffer(&pErrors)) || !pErrors ||
+      pErrors->GetBufferSize() == 0)
+    return false;
+  std::string Errors((const char *)pErrors->GetBufferPointer(),
+                     pErrors->GetBufferSize());
+  return Errors.find("exceeded the memory budget") != std::string::npos;
+}
+
+void FuzzContext::Run(const uint8_t *Data, size_t Size) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  IFT(m_pLibrary->CreateBlobWithEncodingOnHeapCopy(Data, (UINT32)Size,
+                                                   CP_UTF8, &pSource));
+  CComPtr<IDxcIncludeHandler> pIncludeHandler;
+  IFT(m_pLibrary->CreateIncludeHandler(&pIncludeHandler));
+
+  std::vector<LPCWSTR> Args;
+  Args.push_back(m_limits.MaxMemoryArg.c_str());
+  CComPtr<IDxcOperationResult> pResult;
+  auto Start = std::chrono::steady_clock::now();
+  HRESULT hr = m_pCompiler->Compile(
+      pSource, L"fuzz.hlsl", m_limits.EntryPoint.c_str(),
+      m_limits.TargetProfile.c_str(), Args.data(), (UINT32)Args.size(),
+      nullptr, 0, pIncludeHandler, &pResult);
+  double Ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - Start).count();
+  // Inputs that don't compile are expected; only cost is a finding here.
+  if (FAILED(hr) || !pResult)
+    return;
+
+  if (Ms > m_limits.MaxMs) {
+    fprintf(stderr, "==dxc-fuzzer== compile took %.0f ms, limit is %lu ms\n",
+            Ms, m_limits.MaxMs);
+    abort();
+  }
+  int64_t PeakBytes = GetPeakBytes(pResult);
+  if (ExceededMemoryBudget(pResult) ||
+      PeakBytes > (int64_t)m_limits.MaxMB * 1024 * 1024) {
+    fprintf(stderr, "==dxc-fuzzer== compile used %lld MB, limit is %lu MB\n",
+            (long long)(PeakBytes / (1024 * 1024)), m_limits.MaxMB);
+    abort();
+  }
+}
+
+} // namespace
+
+extern "C" void LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size) {
+  static FuzzContext *Context = new FuzzContext();
+  Context->Run(Data, Size);
+}
@@ -0,0 +1,135 @@
+# Copyright (C) Microsoft Corporation. All rights reserved.
+# This file is distributed under the University of Illinois Open Source License. See LICENSE.TXT for details.
+r"""reduce_slow_input.py - reduce a slow or memory-hungry shader.
+
+Takes an input that dxc-fuzzer reported, or any shader that compiles too
+slowly, and removes lines for as long as the compile stays over the limits,
+then writes what is left as a regression test for the dxc_bench corpus:
+
+  reduce_slow_input.py --dxc bin/dxc --max-ms 2000 crash-<sha1>
+
+A candidate keeps the finding when dxc either compiles it successfully but
+takes longer than --max-ms, or fails because it ran out of --max-mb, or is
+still running at --kill-ms. Candidates that fail to compile for any other
+reason are dropped, so the result still compiles for the benchmark.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+bench_dir = os.path.normpath(os.path.join(
+    os.path.dirname(os.path.abspath(__file__)),
+    '..', '..', 'unittests', 'dxc_bench'))
+
+class SlowCompileTest(object):
+    def __init__(self, args):
+        self.args = args
+        self.runs = 0
+
+    def command(self, path):
+        cmd = [self.args.dxc, '-E', self.args.entry, '-T', self.args.target,
+               '-max-memory=%d' % self.args.max_mb, path]
+        return cmd + self.args.extra
+
+    def is_slow(self, lines):
+        """Returns True if the shader of the given lines still is a finding."""
+        self.runs += 1
+        fd, path = tempfile.mkstemp(suffix='.hlsl')
+        try:
+            with os.fdopen(fd, 'w') as f:
+                f.writelines(lines)
+            start = time.time()
+            try:
+                p = subprocess.run(self.command(path), stdout=subprocess.PIPE,
+                                   stderr=subprocess.PIPE,
+                                   timeout=self.args.kill_ms / 1000.0)
+            except subprocess.TimeoutExpired:
+                return True
+            ms = (time.time() - start) * 1000
+            if b'exceeded the memory budget' in p.stderr:
+                return True
+            return p.returncode == 0 and ms > self.args.max_ms
+        finally:
+            os.remove(path)
+
+def ddmin(lines, test):
+    """Removes chunks of lines for as long as test still passes."""
+    n = 2
+    while len(lines) >= 2:
+        chunk = (len(lines) + n - 1) // n
+        reduced = False
+        for start in range(0, len(lines), chunk):
+            candidate = lines[:start] + lines[start + chunk:]
+            if candidate and test(candidate):
+                lines = candidate
+                n = max(n - 1, 2)
+                reduced = True
+                break
+        if not reduced:
+            if chunk == 1:
+                break
+            n = min(n * 2, len(lines))
+    return lines
+
+def write_regression(args, lines):
+    out_dir = os.path.join(bench_dir, 'slow')
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+    name = args.name or os.path.splitext(os.path.basename(args.input))[0]
+    path = os.path.join(out_dir, name + '.hlsl')
+    run_line = '// RUN: %%dxc -E %s -T %s %s%%s\n' % (
+        args.entry, args.target, ''.join(a + ' ' for a in args.extra))
+    with open(path, 'w') as f:
+        f.write(run_line)
+        f.write('\n')
+        f.write('// Reduced from an input that took more than %d ms or %d MB '
+                'to compile.\n\n' % (args.max_ms, args.max_mb))
+        f.writelines(lines)
+
+    corpus = os.path.join(bench_dir, 'corpus.txt')
+    entry = os.path.relpath(path, bench_dir).replace(os.sep, '/')
+    with open(corpus) as f:
+        listed = entry in (l.strip() for l in f)
+    if not listed:
+        with open(corpus, 'a') as f:
+            f.write(entry + '\n')
+    return path
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('input', help='shader to reduce')
+    parser.add_argument('--dxc', default='dxc', help='dxc to compile with')
+    parser.add_argument('--target', default='ps_6_0')
+    parser.add_argument('--entry', default='main')
+    parser.add_argument('--max-ms', type=int, default=5000,
+                        help='compiles slower than this keep the finding')
+    parser.add_argument('--max-mb', type=int, default=512,
+                        help='passed to dxc as -max-memory')
+    parser.add_argument('--kill-ms', type=int, default=0,
+                        help='compiles still running then keep the finding; '
+                             'four times --max-ms by default')
+    parser.add_argument('--name', help='name of the regression test')
+    parser.add_argument('--extra', action='append', default=[],
+                        help='another argument for dxc')
+    args = parser.parse_args()
+    if args.kill_ms == 0:
+        args.kill_ms = args.max_ms * 4
+
+    with open(args.input) as f:
+        lines = [l for l in f.readlines() if 'RUN:' not in l]
+    test = SlowCompileTest(args)
+    if not test.is_slow(lines):
+        sys.exit('%s compiles within the limits, or fails for another reason'
+                 % args.input)
+    lines = ddmin(lines, test.is_slow)
+    path = write_regression(args, lines)
+    print('Reduced to %d lines in %d compiles: %s' % (len(lines), test.runs,
+                                                     path))
+
+if __name__ == '__main__':
+    main()
@@ -58,11 +58,17 @@
 #include "llvm/Option/ArgList.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/StringSaver.h"
 #ifdef _WIN32
 #include <dia2.h>
 #include <comdef.h>
+#include <io.h>
+#else
+#include <unistd.h>
 #endif
 #include <algorithm>
+#include <iostream>
 #include <unordered_map>
 
 #pragma comment(lib, "version.lib")
@@ -152,6 +158,9 @@ public:
   void Recompile(IDxcBlob *pSource, IDxcLibrary *pLibrary, IDxcCompiler *pCompiler, std::vector<LPCWSTR> &args, IDxcOperationResult **pCompileResult);
   int DumpBinary();
   void Preprocess();
+  void WriteDependencies();
+  void RunPreprocessor(llvm::ArrayRef<LPCWSTR> extraArgs,
+                       IDxcOperationResult **ppResult);
   void GetCompilerVersionInfo(llvm::raw_string_ostream &OS);
 };
 
@@ -777,6 +786,32 @@ int DxcContext::Compile() {
     WriteOperationErrorsToConsole(pCompileResult, m_Opts.OutputWarnings);
   }
 
+  if (m_Opts.TimeReport) {
+    CComPtr<IDxcCompileTimings> pTimings;
+    CComPtr<IDxcBlobEncoding> pTimingsBlob;
+    if (SUCCEEDED(pCompileResult.QueryInterface(&pTimings)) &&
+        SUCCEEDED(pTimings->GetTimings(&pTimingsBlob)))
+      WriteBlobToConsole(pTimingsBlob, STD_ERROR_HANDLE);
+  }
+
+  if (!m_Opts.OutputPressureReport.empty()) {
+    CComPtr<IDxcCompilePressureReport> pReport;
+    CComPtr<IDxcBlobEncoding> pReportBlob;
+    if (SUCCEEDED(pCompileResult.QueryInterface(&pReport)) &&
+        SUCCEEDED(pReport->GetPressureReport(&pReportBlob)))
+      WriteBlobToFile(pReportBlob, m_Opts.OutputPressureReport);
+  }
+
+#ifdef ENABLE_SPIRV_CODEGEN
+  if (!m_Opts.OutputSpirvFile.empty()) {
+    CComPtr<IDxcCompileSpirvOutput> pSpirvOutput;
+    CComPtr<IDxcBlob> pSpirvBlob;
+    if (SUCCEEDED(pCompileResult.QueryInterface(&pSpirvOutput)) &&
+        SUCCEEDED(pSpirvOutput->GetSpirv(&pSpirvBlob)))
+      WriteBlobToFile(pSpirvBlob, m_Opts.OutputSpirvFile);
+  }
+#endif // ENABLE_SPIRV_CODEGEN
+
   HRESULT status;
   IFT(pCompileResult->GetStatus(&status));
   if (SUCCEEDED(status) || m_Opts.AstDump || m_Opts.OptDump) {
@@ -799,8 +834,48 @@ int DxcContext::DumpBinary() {
 
 void DxcContext::Preprocess() {
   DXASSERT(!m_Opts.Preprocess.empty(), "else option reading should have failed");
-  CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pPreprocessResult;
+  RunPreprocessor({}, &pPreprocessResult);
+
+  HRESULT status;
+  IFT(pPreprocessResult->GetStatus(&status));
+  if (SUCCEEDED(status)) {
+    CComPtr<IDxcBlob> pProgram;
+    IFT(pPreprocessResult->GetResult(&pProgram));
+    WriteBlobToFile(pProgram, m_Opts.Preprocess);
+  }
+}
+
+// Writes the make rule for the files the input includes, for -M and -MD.
+void DxcContext::WriteDependencies() {
+  // Name the rule after what the compile produces unless told otherwise.
+  llvm::StringRef target = m_Opts.DependencyTarget;
+  if (target.empty())
+    target = m_Opts.OutputObject.empty() ? m_Opts.InputFile : m_Opts.OutputObject;
+  std::wstring targetW = Unicode::UTF8ToUTF16StringOrThrow(target.str().c_str());
+  LPCWSTR args[] = {L"-M", L"-MT", targetW.c_str()};
+  CComPtr<IDxcOperationResult> pScanResult;
+  RunPreprocessor(args, &pScanResult);
+
+  HRESULT status;
+  IFT(pScanResult->GetStatus(&status));
+  if (FAILED(status))
+    throw hlsl::Exception(status, "failed to scan dependencies");
+  CComPtr<IDxcBlob> pRule;
+  IFT(pScanResult->GetResult(&pRule));
+  if (!m_Opts.DependencyFile.empty())
+    WriteBlobToFile(pRule, m_Opts.DependencyFile);
+  else if (m_Opts.WriteDependencies)
+    WriteBlobToFile(pRule, m_Opts.OutputObject.str() + ".d");
+  else
+    WriteBlobToConsole(pRule);
+}
+
+// Preprocesses the input with the options that control the preprocessor,
+// followed by extraArgs.
+void DxcContext::RunPreprocessor(llvm::ArrayRef<LPCWSTR> extraArgs,
+                                 IDxcOperationResult **ppResult) {
+  CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
   std::vector<LPCWSTR> args;
 
@@ -821,18 +896,12 @@ void DxcContext::Preprocess() {
     args.emplace_back(directory.c_str()); // The strings are kept alive in the includePath vector
   }
 
+  args.insert(args.end(), extraArgs.begin(), extraArgs.end());
+
   ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
   IFT(CreateInstance(CLSID_DxcCompiler, &pCompiler));
-  IFT(pCompiler->Preprocess(pSource, StringRefUtf16(m_Opts.InputFile), args.data(), args.size(), m_Opts.Defines.data(), m_Opts.Defines.size(), pIncludeHandler, &pPreprocessResult));
-  WriteOperationErrorsToConsole(pPreprocessResult, m_Opts.OutputWarnings);
-
-  HRESULT status;
-  IFT(pPreprocessResult->GetStatus(&status));
-  if (SUCCEEDED(status)) {
-    CComPtr<IDxcBlob> pProgram;
-    IFT(pPreprocessResult->GetResult(&pProgram));
-    WriteBlobToFile(pProgram, m_Opts.Preprocess);
-  }
+  IFT(pCompiler->Preprocess(pSource, StringRefUtf16(m_Opts.InputFile), args.data(), args.size(), m_Opts.Defines.data(), m_Opts.Defines.size(), pIncludeHandler, ppResult));
+  WriteOperationErrorsToConsole(*ppResult, m_Opts.OutputWarnings);
 }
 
 static void WriteString(HANDLE hFile, _In_z_ LPCSTR value, LPCWSTR pFileName) {
@@ -1057,6 +1126,159 @@ void DxcContext::GetCompilerVersionInfo(llvm::raw_string_ostream &OS) {
   }
 }
 
+static void PrintHlslException(const ::hlsl::Exception &hlslException,
+                               const char *pStage) {
+  try {
+    const char *msg = hlslException.what();
+    Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                        // UTF-8 because we use ASCII only errors
+    if (msg == nullptr || *msg == '\0') {
+      if (hlslException.hr == DXC_E_DUPLICATE_PART) {
+        sprintf_s(
+            printBuffer, _countof(printBuffer),
+            "dxc failed : DXIL container already contains the given part.");
+      } else if (hlslException.hr == DXC_E_MISSING_PART) {
+        sprintf_s(
+            printBuffer, _countof(printBuffer),
+            "dxc failed : DXIL container does not contain the given part.");
+      } else if (hlslException.hr == DXC_E_CONTAINER_INVALID) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc failed : Invalid DXIL container.");
+      } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DXIL) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc failed : DXIL container is missing DXIL part.");
+      } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DEBUG) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc failed : DXIL container is missing Debug Info part.");
+      } else if (hlslException.hr == E_OUTOFMEMORY) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc failed : Out of Memory.");
+      } else if (hlslException.hr == E_INVALIDARG) {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "dxc failed : Invalid argument.");
+      } else {
+        sprintf_s(printBuffer, _countof(printBuffer),
+          "dxc failed : error code 0x%08x.\n", hlslException.hr);
+      }
+      msg = printBuffer;
+    }
+
+    WriteUtf8ToConsoleSizeT(msg, strlen(msg), STD_ERROR_HANDLE);
+    printf("\n");
+  } catch (...) {
+    printf("%s failed - unable to retrieve error message.\n", pStage);
+  }
+}
+
+// Runs one command line against an already loaded compiler.
+static int RunCommandLine(const MainArgs &argStrings,
+                          DxcDllSupport &dxcSupport) {
+  const char *pStage = "Argument processing";
+  int retVal = 0;
+  try {
+    DxcOpts dxcOpts;
+    {
+      std::string errorString;
+      llvm::raw_string_ostream errorStream(errorString);
+      int optResult = ReadDxcOpts(getHlslOptTable(), DxcFlags, argStrings,
+                                  dxcOpts, errorStream);
+      errorStream.flush();
+      if (errorString.size()) {
+        fprintf(stderr, "dxc failed : %s\n", errorString.data());
+      }
+      if (optResult != 0) {
+        return optResult;
+      }
+    }
+    if (dxcOpts.Server || dxcOpts.ShowHelp) {
+      fprintf(stderr, "dxc failed : option not supported in server mode.\n");
+      return 1;
+    }
+
+    // Apply defaults.
+    if (dxcOpts.EntryPoint.empty() && !dxcOpts.RecompileFromBinary) {
+      dxcOpts.EntryPoint = "main";
+    }
+
+    DxcContext context(dxcOpts, dxcSupport);
+    if (!dxcOpts.Preprocess.empty()) {
+      pStage = "Preprocessing";
+      context.Preprocess();
+    }
+    else if (dxcOpts.ScanDependencies) {
+      pStage = "Scanning dependencies";
+      context.WriteDependencies();
+    }
+    else if (dxcOpts.DumpBin) {
+      pStage = "Dumping existing binary";
+      retVal = context.DumpBinary();
+    }
+    else {
+      pStage = "Compilation";
+      retVal = context.Compile();
+      if (retVal == 0 && dxcOpts.WriteDependencies) {
+        pStage = "Scanning dependencies";
+        context.WriteDependencies();
+      }
+    }
+  } catch (const ::hlsl::Exception &hlslException) {
+    PrintHlslException(hlslException, pStage);
+    return 1;
+  } catch (std::bad_alloc &) {
+    fprintf(stderr, "%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    fprintf(stderr, "%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+  return retVal;
+}
+
+// Reads the arguments of one dxc invocation per line from standard input
+// until it is closed, running each as its own compile. Each command ends
+// with a "dxc-server: <exit code>" line on standard output, so a build
+// system driving the pipe knows when its outputs are ready. Standard output
+// only carries those lines: whatever a command would print there, such as
+// a disassembly without /Fc or printf output, goes to standard error.
+static int ServeCommandLines(DxcDllSupport &dxcSupport) {
+  fflush(stdout);
+#ifdef _WIN32
+  int protocolFd = _dup(_fileno(stdout));
+  if (protocolFd == -1 || _dup2(_fileno(stderr), _fileno(stdout)) != 0) {
+#else
+  int protocolFd = dup(fileno(stdout));
+  if (protocolFd == -1 || dup2(fileno(stderr), fileno(stdout)) == -1) {
+#endif
+    fprintf(stderr, "dxc failed : cannot redirect standard output.\n");
+    return 1;
+  }
+  llvm::raw_fd_ostream protocol(protocolFd, /*shouldClose*/ true);
+
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    llvm::StringRef command = llvm::StringRef(line).trim();
+    if (command.empty())
+      continue;
+
+    llvm::BumpPtrAllocator allocator;
+    llvm::BumpPtrStringSaver saver(allocator);
+    llvm::SmallVector<const char *, 32> argv;
+#ifdef _WIN32
+    llvm::cl::TokenizeWindowsCommandLine(command, saver, argv);
+#else
+    llvm::cl::TokenizeGNUCommandLine(command, saver, argv);
+#endif
+    std::vector<llvm::StringRef> args(argv.begin(), argv.end());
+
+    int retVal = RunCommandLine(MainArgs(args), dxcSupport);
+    fflush(stdout);
+    fflush(stderr);
+    protocol << "dxc-server: " << retVal << "\n";
+    protocol.flush();
+  }
+  return 0;
+}
+
 #ifdef _WIN32
 int __cdecl wmain(int argc, const wchar_t **argv_) {
 #else
@@ -1110,6 +1332,11 @@ int main(int argc, const char **argv_) {
     }
 
     EnsureEnabled(dxcSupport);
+    if (dxcOpts.Server) {
+      pStage = "Serving";
+      return ServeCommandLines(dxcSupport);
+    }
+
     DxcContext context(dxcOpts, dxcSupport);
     // Handle help request, which overrides any other processing.
     if (dxcOpts.ShowHelp) {
@@ -1131,6 +1358,10 @@ int main(int argc, const char **argv_) {
       pStage = "Preprocessing";
       context.Preprocess();
     }
+    else if (dxcOpts.ScanDependencies) {
+      pStage = "Scanning dependencies";
+      context.WriteDependencies();
+    }
     else if (dxcOpts.DumpBin) {
       pStage = "Dumping existing binary";
       retVal = context.DumpBinary();
@@ -1138,49 +1369,13 @@ int main(int argc, const char **argv_) {
     else {
       pStage = "Compilation";
       retVal = context.Compile();
-    }
-  } catch (const ::hlsl::Exception &hlslException) {
-    try {
-      const char *msg = hlslException.what();
-      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
-                                          // UTF-8 because we use ASCII only errors
-      if (msg == nullptr || *msg == '\0') {
-        if (hlslException.hr == DXC_E_DUPLICATE_PART) {
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container already contains the given part.");
-        } else if (hlslException.hr == DXC_E_MISSING_PART) {
-          sprintf_s(
-              printBuffer, _countof(printBuffer),
-              "dxc failed : DXIL container does not contain the given part.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_INVALID) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid DXIL container.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DXIL) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing DXIL part.");
-        } else if (hlslException.hr == DXC_E_CONTAINER_MISSING_DEBUG) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : DXIL container is missing Debug Info part.");
-        } else if (hlslException.hr == E_OUTOFMEMORY) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Out of Memory.");
-        } else if (hlslException.hr == E_INVALIDARG) {
-          sprintf_s(printBuffer, _countof(printBuffer),
-                    "dxc failed : Invalid argument.");
-        } else {
-          sprintf_s(printBuffer, _countof(printBuffer),
-            "dxc failed : error code 0x%08x.\n", hlslException.hr);
-        }
-        msg = printBuffer;
+      if (retVal == 0 && dxcOpts.WriteDependencies) {
+        pStage = "Scanning dependencies";
+        context.WriteDependencies();
       }
-
-      WriteUtf8ToConsoleSizeT(msg, strlen(msg), STD_ERROR_HANDLE);
-      printf("\n");
-    } catch (...) {
-      printf("%s failed - unable to retrieve error message.\n", pStage);
     }
-
+  } catch (const ::hlsl::Exception &hlslException) {
+    PrintHlslException(hlslException, pStage);
     return 1;
   } catch (std::bad_alloc &) {
     printf("%s failed - out of memory.\n", pStage);
@@ -47,12 +47,26 @@ void  __CRTDECL operator delete (void* ptr, const std::nothrow_t& nothrow_consta
 }
 #endif
 
+// LLVM's process-wide state is created on first use, which may be during a
+// compile served by a per-compile allocator such as an arena. Create it on the
+// default allocator instead, since it outlives the compile.
+static void *EnterManagedStaticAlloc() {
+  IMalloc *pPrior;
+  DxcSwapThreadMallocOrDefault(nullptr, &pPrior);
+  return pPrior;
+}
+static void LeaveManagedStaticAlloc(void *pPrior) {
+  DxcSwapThreadMalloc((IMalloc *)pPrior, nullptr);
+}
+
 static HRESULT InitMaybeFail() throw() {
   HRESULT hr;
   bool fsSetup = false, memSetup = false;
   IFC(DxcInitThreadMalloc());
   DxcSetThreadMallocOrDefault(nullptr);
   memSetup = true;
+  ::llvm::llvm_set_managed_static_alloc_hooks(EnterManagedStaticAlloc,
+                                              LeaveManagedStaticAlloc);
   if (::llvm::sys::fs::SetupPerThreadFileSystem()) {
     hr = E_FAIL;
     goto Cleanup;
@@ -71,6 +85,7 @@ Cleanup:
       ::llvm::sys::fs::CleanupPerThreadFileSystem();
     }
     if (memSetup) {
+      ::llvm::llvm_set_managed_static_alloc_hooks(nullptr, nullptr);
       DxcClearThreadMalloc();
       DxcCleanupThreadMalloc();
     }
@@ -90,6 +105,7 @@ void __attribute__ ((destructor)) DllShutdown() {
   ::hlsl::options::cleanupHlslOptTable();
   ::llvm::sys::fs::CleanupPerThreadFileSystem();
   ::llvm::llvm_shutdown();
+  ::llvm::llvm_set_managed_static_alloc_hooks(nullptr, nullptr);
   DxcClearThreadMalloc();
   DxcCleanupThreadMalloc();
 }
@@ -115,6 +131,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD Reason, LPVOID reserved) {
     else { // Process termination. We should not call FreeLibrary()
       DxilLibCleanup(DxilLibCleanUpType::ProcessTermination);
     }
+    ::llvm::llvm_set_managed_static_alloc_hooks(nullptr, nullptr);
     DxcClearThreadMalloc();
     DxcCleanupThreadMalloc();
     DxcEtw_DXCompilerShutdown_Stop(S_OK);
@@ -26,23 +26,37 @@
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLibrary)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcBlobEncoding)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOperationResult)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileTimings)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileMemoryUsage)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompilePressureReport)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompileSpirvOutput)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAssembler)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcBlob)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcIncludeHandler)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompiler)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompiler2)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcCompiler3)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompileCallback)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAsyncOperation)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcAsyncCompiler)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcVersionInfo)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcVersionInfo2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcValidator)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcValidatorCache)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcContainerBuilder)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchiveBuilder)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcShaderArchive)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizerPass)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcOptimizer2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcRewriter)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcRewriter2)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcIntelliSense)
 DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLinker)
+DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLinker2)
 
 HRESULT CreateDxcCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcAsyncCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcDiaDataSource(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcIntelliSense(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcLibrary(_In_ REFIID riid, _Out_ LPVOID *ppv);
@@ -51,6 +65,8 @@ HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcAssembler(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcOptimizer(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcContainerBuilder(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcShaderArchiveBuilder(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcShaderArchive(_In_ REFIID riid, _Out_ LPVOID *ppv);
 HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
 namespace hlsl {
@@ -78,6 +94,9 @@ static HRESULT ThreadMallocDxcCreateInstance(
   if (IsEqualCLSID(rclsid, CLSID_DxcCompiler)) {
     hr = CreateDxcCompiler(riid, ppv);
   }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcAsyncCompiler)) {
+    hr = CreateDxcAsyncCompiler(riid, ppv);
+  }
   else if (IsEqualCLSID(rclsid, CLSID_DxcLibrary)) {
     hr = CreateDxcLibrary(riid, ppv);
   }
@@ -97,6 +116,12 @@ static HRESULT ThreadMallocDxcCreateInstance(
   else if (IsEqualCLSID(rclsid, CLSID_DxcIntelliSense)) {
     hr = CreateDxcIntelliSense(riid, ppv);
   }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcShaderArchiveBuilder)) {
+    hr = CreateDxcShaderArchiveBuilder(riid, ppv);
+  }
+  else if (IsEqualCLSID(rclsid, CLSID_DxcShaderArchive)) {
+    hr = CreateDxcShaderArchive(riid, ppv);
+  }
 // Note: The following targets are not yet enabled for non-Windows platforms.
 #ifdef _WIN32
   else if (IsEqualCLSID(rclsid, CLSID_DxcRewriter)) {
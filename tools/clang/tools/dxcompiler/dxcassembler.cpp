@@ -125,10 +125,7 @@ HRESULT STDMETHODCALLTYPE DxcAssembler::AssembleToContainer(
                                                           e.hr, ppResult));
       return S_OK;
     }
-    // Create bitcode of M.
-    WriteBitcodeToFile(M.get(), outStream);
-    outStream.flush();
-
+    // The container serializes M itself, after stripping its metadata.
     CComPtr<IDxcBlob> pResultBlob;
     static constexpr hlsl::SerializeDxilFlags flags = static_cast<hlsl::SerializeDxilFlags>(
         static_cast<uint32_t>(SerializeDxilFlags::IncludeDebugNamePart) |
@@ -0,0 +1,306 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcasynccompiler.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the DirectX Compiler asynchronous compile interface.           //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/microcom.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hlsl;
+
+HRESULT CreateDxcCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
+
+namespace {
+
+// A single queued compile. The request is copied when the operation is
+// created so the caller's buffers don't need to outlive CompileAsync.
+class DxcAsyncCompileOperation : public IDxcAsyncOperation {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+
+  enum class State { Pending, Running, Completed, Cancelled };
+
+  CComPtr<IDxcBlob> m_pSource;
+  std::wstring m_sourceName;
+  bool m_hasSourceName = false;
+  std::wstring m_entryPoint;
+  std::wstring m_targetProfile;
+  std::vector<std::wstring> m_arguments;
+  std::vector<std::wstring> m_defineNames;
+  std::vector<std::wstring> m_defineValues;
+  std::vector<bool> m_hasDefineValue;
+  CComPtr<IDxcIncludeHandler> m_pIncludeHandler;
+  CComPtr<IDxcAsyncCompileCallback> m_pCallback;
+
+  std::mutex m_mutex;
+  std::condition_variable m_done;
+  State m_state = State::Pending;
+  HRESULT m_hr = E_PENDING;
+  CComPtr<IDxcOperationResult> m_pResult;
+
+  void Finish(State state, HRESULT hr, IDxcOperationResult *pResult) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_state = state;
+      m_hr = hr;
+      m_pResult = pResult;
+    }
+    m_done.notify_all();
+    if (m_pCallback)
+      m_pCallback->OnCompleted(this);
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcAsyncCompileOperation)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcAsyncOperation>(this, iid, ppvObject);
+  }
+
+  void Initialize(IDxcBlob *pSource, LPCWSTR pSourceName, LPCWSTR pEntryPoint,
+                  LPCWSTR pTargetProfile, LPCWSTR *pArguments, UINT32 argCount,
+                  const DxcDefine *pDefines, UINT32 defineCount,
+                  IDxcIncludeHandler *pIncludeHandler,
+                  IDxcAsyncCompileCallback *pCallback) {
+    m_pSource = pSource;
+    m_hasSourceName = pSourceName != nullptr;
+    if (m_hasSourceName)
+      m_sourceName = pSourceName;
+    m_entryPoint = pEntryPoint;
+    m_targetProfile = pTargetProfile;
+    for (UINT32 i = 0; i < argCount; ++i)
+      m_arguments.emplace_back(pArguments[i]);
+    for (UINT32 i = 0; i < defineCount; ++i) {
+      m_defineNames.emplace_back(pDefines[i].Name);
+      m_hasDefineValue.push_back(pDefines[i].Value != nullptr);
+      m_defineValues.emplace_back(pDefines[i].Value ? pDefines[i].Value : L"");
+    }
+    m_pIncludeHandler = pIncludeHandler;
+    m_pCallback = pCallback;
+  }
+
+  // Claims the operation for a worker; fails if it was cancelled meanwhile.
+  bool Start() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state != State::Pending)
+      return false;
+    m_state = State::Running;
+    return true;
+  }
+
+  void Run(IDxcCompiler *pCompiler) {
+    if (pCompiler == nullptr) {
+      Finish(State::Completed, E_FAIL, nullptr);
+      return;
+    }
+    std::vector<LPCWSTR> arguments;
+    for (const std::wstring &arg : m_arguments)
+      arguments.push_back(arg.c_str());
+    std::vector<DxcDefine> defines;
+    for (size_t i = 0; i < m_defineNames.size(); ++i) {
+      DxcDefine define;
+      define.Name = m_defineNames[i].c_str();
+      define.Value = m_hasDefineValue[i] ? m_defineValues[i].c_str() : nullptr;
+      defines.push_back(define);
+    }
+
+    CComPtr<IDxcOperationResult> pResult;
+    HRESULT hr = pCompiler->Compile(
+        m_pSource, m_hasSourceName ? m_sourceName.c_str() : nullptr,
+        m_entryPoint.c_str(), m_targetProfile.c_str(), arguments.data(),
+        (UINT32)arguments.size(), defines.data(), (UINT32)defines.size(),
+        m_pIncludeHandler, &pResult);
+    Finish(State::Completed, hr, pResult);
+  }
+
+  HRESULT STDMETHODCALLTYPE IsComplete(_Out_ BOOL *pComplete) override {
+    if (pComplete == nullptr)
+      return E_INVALIDARG;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    *pComplete = m_state == State::Completed || m_state == State::Cancelled;
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Wait() override {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] {
+      return m_state == State::Completed || m_state == State::Cancelled;
+    });
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE Cancel() override {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_state != State::Pending)
+        return S_FALSE;
+      m_state = State::Cancelled;
+      m_hr = E_ABORT;
+    }
+    Finish(State::Cancelled, E_ABORT, nullptr);
+    return S_OK;
+  }
+
+  HRESULT STDMETHODCALLTYPE GetResult(_COM_Outptr_ IDxcOperationResult **ppResult) override {
+    if (ppResult == nullptr)
+      return E_INVALIDARG;
+    *ppResult = nullptr;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_state == State::Pending || m_state == State::Running)
+      return E_PENDING;
+    if (FAILED(m_hr))
+      return m_hr;
+    return m_pResult.CopyTo(ppResult);
+  }
+};
+
+// Work queue shared by the async compiler and its worker threads. Workers
+// keep the queue alive on their own, so a compiler released from within a
+// completion callback doesn't pull the queue out from under its own worker.
+struct DxcAsyncCompileQueue {
+  std::mutex Mutex;
+  std::condition_variable Available;
+  std::deque<CComPtr<DxcAsyncCompileOperation>> Pending;
+  bool Stopping = false;
+};
+
+void AsyncCompileWorkerMain(std::shared_ptr<DxcAsyncCompileQueue> queue) {
+  // The thread allocator is left in place on exit: the thread's start state
+  // and the queue reference are released after this function returns.
+  DxcSetThreadMallocOrDefault(nullptr);
+  // Each worker compiles with its own compiler object.
+  CComPtr<IDxcCompiler> pCompiler;
+  HRESULT hr = CreateDxcCompiler(__uuidof(IDxcCompiler), (void **)&pCompiler);
+  for (;;) {
+    CComPtr<DxcAsyncCompileOperation> pOperation;
+    {
+      std::unique_lock<std::mutex> lock(queue->Mutex);
+      queue->Available.wait(lock, [&queue] {
+        return queue->Stopping || !queue->Pending.empty();
+      });
+      if (queue->Pending.empty())
+        break;
+      pOperation = queue->Pending.front();
+      queue->Pending.pop_front();
+    }
+    if (pOperation->Start())
+      pOperation->Run(SUCCEEDED(hr) ? pCompiler.p : nullptr);
+  }
+}
+
+class DxcAsyncCompiler : public IDxcAsyncCompiler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::shared_ptr<DxcAsyncCompileQueue> m_queue;
+  std::vector<std::thread> m_workers;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcAsyncCompiler)
+
+  ~DxcAsyncCompiler() {
+    if (!m_queue)
+      return;
+
+    // Cancel whatever hasn't started; compiles already running finish
+    // normally before their workers exit.
+    std::deque<CComPtr<DxcAsyncCompileOperation>> pending;
+    {
+      std::lock_guard<std::mutex> lock(m_queue->Mutex);
+      pending.swap(m_queue->Pending);
+      m_queue->Stopping = true;
+    }
+    m_queue->Available.notify_all();
+    for (auto &pOperation : pending)
+      pOperation->Cancel();
+
+    for (std::thread &worker : m_workers) {
+      if (worker.get_id() == std::this_thread::get_id())
+        worker.detach();
+      else
+        worker.join();
+    }
+  }
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcAsyncCompiler>(this, iid, ppvObject);
+  }
+
+  void Initialize() {
+    m_queue = std::make_shared<DxcAsyncCompileQueue>();
+    unsigned workerCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < workerCount; ++i)
+      m_workers.emplace_back(AsyncCompileWorkerMain, m_queue);
+  }
+
+  HRESULT STDMETHODCALLTYPE CompileAsync(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // entry point name
+    _In_ LPCWSTR pTargetProfile,                  // shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _In_opt_ IDxcAsyncCompileCallback *pCallback, // Optional callback invoked on completion
+    _COM_Outptr_ IDxcAsyncOperation **ppOperation // Handle to wait on, cancel, or get the result from
+  ) override {
+    if (pSource == nullptr || pEntryPoint == nullptr ||
+        pTargetProfile == nullptr || ppOperation == nullptr ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    *ppOperation = nullptr;
+
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      CComPtr<DxcAsyncCompileOperation> pOperation =
+          DxcAsyncCompileOperation::Alloc(m_pMalloc);
+      IFROOM(pOperation.p);
+      pOperation->Initialize(pSource, pSourceName, pEntryPoint, pTargetProfile,
+                             pArguments, argCount, pDefines, defineCount,
+                             pIncludeHandler, pCallback);
+      {
+        std::lock_guard<std::mutex> lock(m_queue->Mutex);
+        m_queue->Pending.push_back(pOperation);
+      }
+      m_queue->Available.notify_one();
+      *ppOperation = pOperation.Detach();
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+} // namespace
+
+HRESULT CreateDxcAsyncCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  *ppv = nullptr;
+  try {
+    CComPtr<DxcAsyncCompiler> result(
+        DxcAsyncCompiler::Alloc(DxcGetThreadMallocNoRef()));
+    IFROOM(result.p);
+    result->Initialize();
+    return result.p->QueryInterface(riid, ppv);
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
@@ -31,6 +31,7 @@
 #include "dxc/DxilContainer/DxilContainerReader.h"
 #include "dxc/HLSL/ComputeViewIdState.h"
 #include "dxc/DXIL/DxilUtil.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxcutil.h"
 
 using namespace llvm;
@@ -49,7 +50,7 @@ bool SigElementHasStream(const DxilProgramSignatureElement &pSignature) {
 }
 
 void PrintSignature(LPCSTR pName, const DxilProgramSignature *pSignature,
-                           bool bIsInput, raw_string_ostream &OS,
+                           bool bIsInput, raw_ostream &OS,
                            StringRef comment) {
   OS << comment << "\n"
      << comment << " " << pName << " signature:\n"
@@ -257,7 +258,7 @@ void PrintSignature(LPCSTR pName, const DxilProgramSignature *pSignature,
   OS << comment << "\n";
 }
 
-void PintCompMaskNameCompact(raw_string_ostream &OS, unsigned CompMask) {
+void PintCompMaskNameCompact(raw_ostream &OS, unsigned CompMask) {
   char Mask[5];
   memset(Mask, '\0', sizeof(Mask));
   unsigned idx = 0;
@@ -273,7 +274,7 @@ void PintCompMaskNameCompact(raw_string_ostream &OS, unsigned CompMask) {
 }
 
 void PrintDxilSignature(LPCSTR pName, const DxilSignature &Signature,
-                               raw_string_ostream &OS, StringRef comment) {
+                               raw_ostream &OS, StringRef comment) {
   const std::vector<std::unique_ptr<DxilSignatureElement>> &sigElts =
       Signature.GetElements();
   if (sigElts.size() == 0)
@@ -330,7 +331,7 @@ PCSTR g_pFeatureInfoNames[] = {
 static_assert(_countof(g_pFeatureInfoNames) == ShaderFeatureInfoCount, "g_pFeatureInfoNames needs to be updated");
 
 void PrintFeatureInfo(const DxilShaderFeatureInfo *pFeatureInfo,
-                             raw_string_ostream &OS, StringRef comment) {
+                             raw_ostream &OS, StringRef comment) {
   uint64_t featureFlags = pFeatureInfo->FeatureFlags;
   if (!featureFlags)
     return;
@@ -344,7 +345,7 @@ void PrintFeatureInfo(const DxilShaderFeatureInfo *pFeatureInfo,
 }
 
 void PrintResourceFormat(DxilResourceBase &res, unsigned alignment,
-                                raw_string_ostream &OS) {
+                                raw_ostream &OS) {
   switch (res.GetClass()) {
   case DxilResourceBase::Class::CBuffer:
   case DxilResourceBase::Class::Sampler:
@@ -373,7 +374,7 @@ void PrintResourceFormat(DxilResourceBase &res, unsigned alignment,
 }
 
 void PrintResourceDim(DxilResourceBase &res, unsigned alignment,
-                             raw_string_ostream &OS) {
+                             raw_ostream &OS) {
   switch (res.GetClass()) {
   case DxilResourceBase::Class::CBuffer:
   case DxilResourceBase::Class::Sampler:
@@ -415,7 +416,7 @@ void PrintResourceDim(DxilResourceBase &res, unsigned alignment,
   }
 }
 
-void PrintResourceBinding(DxilResourceBase &res, raw_string_ostream &OS,
+void PrintResourceBinding(DxilResourceBase &res, raw_ostream &OS,
                                  StringRef comment) {
   OS << comment << " " << left_justify(res.GetGlobalName(), 31);
 
@@ -441,7 +442,7 @@ void PrintResourceBinding(DxilResourceBase &res, raw_string_ostream &OS,
     OS << right_justify("unbounded", 6) << "\n";
 }
 
-void PrintResourceBindings(DxilModule &M, raw_string_ostream &OS,
+void PrintResourceBindings(DxilModule &M, raw_ostream &OS,
                                   StringRef comment) {
   OS << comment << "\n"
      << comment << " Resource Bindings:\n"
@@ -508,7 +509,7 @@ void PrintInputsContributingToOutputs(
   }
 }
 
-void PrintViewIdState(DxilModule &M, raw_string_ostream &OS,
+void PrintViewIdState(DxilModule &M, raw_ostream &OS,
                              StringRef comment) {
   if (!M.GetModule()->getNamedMetadata("dx.viewIdState"))
     return;
@@ -612,7 +613,7 @@ static const char *HitGroupTypeToString(DXIL::HitGroupType type) {
 }
 
 template <typename _T>
-void PrintFlags(raw_string_ostream &OS, uint32_t Flags) {
+void PrintFlags(raw_ostream &OS, uint32_t Flags) {
   if (!Flags) {
     OS << "0";
     return;
@@ -628,7 +629,7 @@ void PrintFlags(raw_string_ostream &OS, uint32_t Flags) {
 }
 
 void PrintSubobjects(const DxilSubobjects &subobjects,
-                     raw_string_ostream &OS,
+                     raw_ostream &OS,
                      StringRef comment) {
   if (subobjects.GetSubobjects().empty())
     return;
@@ -733,7 +734,7 @@ void PrintSubobjects(const DxilSubobjects &subobjects,
 }
 
 void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys, const DataLayout *DL,
-                       raw_string_ostream &OS, StringRef comment,
+                       raw_ostream &OS, StringRef comment,
                        StringRef varName, unsigned offset,
                        unsigned indent, unsigned arraySize,
                        unsigned sizeOfStruct = 0);
@@ -773,7 +774,7 @@ void PrintTypeAndName(llvm::Type *Ty, DxilFieldAnnotation &annotation,
 
 void PrintFieldLayout(llvm::Type *Ty, DxilFieldAnnotation &annotation,
                       DxilTypeSystem &typeSys, const DataLayout* DL,
-                      raw_string_ostream &OS,
+                      raw_ostream &OS,
                       StringRef comment, unsigned offset,
                       unsigned indent, unsigned offsetIndent,
                       unsigned sizeToPrint = 0) {
@@ -844,7 +845,7 @@ void PrintFieldLayout(llvm::Type *Ty, DxilFieldAnnotation &annotation,
 
 // null DataLayout => assume constant buffer layout
 void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys, const DataLayout *DL,
-                       raw_string_ostream &OS, StringRef comment,
+                       raw_ostream &OS, StringRef comment,
                        StringRef varName, unsigned offset,
                        unsigned indent, unsigned offsetIndent,
                        unsigned sizeOfStruct) {
@@ -892,7 +893,7 @@ void PrintStructLayout(StructType *ST, DxilTypeSystem &typeSys, const DataLayout
 void PrintStructBufferDefinition(DxilResource *buf,
                                         DxilTypeSystem &typeSys,
                                         const DataLayout &DL,
-                                        raw_string_ostream &OS,
+                                        raw_ostream &OS,
                                         StringRef comment) {
   const unsigned offsetIndent = 50;
 
@@ -939,7 +940,7 @@ void PrintStructBufferDefinition(DxilResource *buf,
 }
 
 void PrintTBufferDefinition(DxilResource *buf, DxilTypeSystem &typeSys,
-                                   raw_string_ostream &OS, StringRef comment) {
+                                   raw_ostream &OS, StringRef comment) {
   const unsigned offsetIndent = 50;
   llvm::Type *Ty = buf->GetGlobalSymbol()->getType()->getPointerElementType();
   // For TextureBuffer<> buf[2], the array size is in Resource binding count
@@ -965,7 +966,7 @@ void PrintTBufferDefinition(DxilResource *buf, DxilTypeSystem &typeSys,
 }
 
 void PrintCBufferDefinition(DxilCBuffer *buf, DxilTypeSystem &typeSys,
-                                   raw_string_ostream &OS, StringRef comment) {
+                                   raw_ostream &OS, StringRef comment) {
   const unsigned offsetIndent = 50;
   llvm::Type *Ty = buf->GetGlobalSymbol()->getType()->getPointerElementType();
   // For ConstantBuffer<> buf[2], the array size is in Resource binding count
@@ -991,7 +992,7 @@ void PrintCBufferDefinition(DxilCBuffer *buf, DxilTypeSystem &typeSys,
   OS << comment << "\n";
 }
 
-void PrintBufferDefinitions(DxilModule &M, raw_string_ostream &OS,
+void PrintBufferDefinitions(DxilModule &M, raw_ostream &OS,
                                    StringRef comment) {
   OS << comment << "\n"
      << comment << " Buffer Definitions:\n"
@@ -1219,7 +1220,7 @@ public:
 
 void PrintPipelineStateValidationRuntimeInfo(const char *pBuffer,
                                                     DXIL::ShaderKind shaderKind,
-                                                    raw_string_ostream &OS,
+                                                    raw_ostream &OS,
                                                     StringRef comment) {
   OS << comment << "\n"
      << comment << " Pipeline Runtime Information: \n"
@@ -1454,7 +1455,7 @@ void PrintPipelineStateValidationRuntimeInfo(const char *pBuffer,
 
 namespace dxcutil {
 
-HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
+HRESULT Disassemble(IDxcBlob *pProgram, raw_ostream &Stream) {
   const char *pIL = (const char *)pProgram->GetBufferPointer();
   uint32_t pILLength = pProgram->GetBufferSize();
   const DxilPartHeader *pRDATPart = nullptr;
@@ -1464,6 +1465,15 @@ HRESULT Disassemble(IDxcBlob *pProgram, raw_string_ostream &Stream) {
       return DXC_E_CONTAINER_INVALID;
     }
 
+    if (HasCompressedDxilParts(pContainer)) {
+      CComPtr<AbstractMemoryStream> pStream;
+      CComPtr<IDxcBlob> pDecompressed;
+      IFR(CreateMemoryStream(DxcGetThreadMallocNoRef(), &pStream));
+      IFR(DecompressDxilContainer(pContainer, pStream));
+      IFR(pStream.QueryInterface(&pDecompressed));
+      return Disassemble(pDecompressed, Stream);
+    }
+
     DxilPartIterator it = std::find_if(begin(pContainer), end(pContainer),
                                        DxilPartIsType(DFCC_FeatureInfo));
     if (it != end(pContainer)) {
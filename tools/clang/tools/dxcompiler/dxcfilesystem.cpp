@@ -21,6 +21,9 @@
 #include "dxc/Support/Unicode.h"
 #include "clang/Frontend/CompilerInstance.h"
 
+#include <mutex>
+#include <unordered_map>
+
 #ifndef _WIN32
 #include <sys/stat.h>
 #include <unistd.h>
@@ -82,8 +85,8 @@ enum class SpecialValue {
   Output = 4
 };
 struct HandleBits {
-  unsigned Offset : 8;
-  unsigned Length : 8;
+  unsigned Offset : 16;
+  unsigned Length : 12;
   unsigned Kind : 4;
 };
 struct DxcArgsHandle {
@@ -142,9 +145,107 @@ const DxcArgsHandle StdErrHandle(SpecialValue::StdErr);
 const DxcArgsHandle OutputHandle(SpecialValue::Output);
 
 /// Max number of included files (1:1 to their directories) or search directories.
-/// If programs include more than a handful, DxcArgsFileSystem will need to do better than linear scans.
+/// Must fit in HandleBits::Offset.
 /// If this is fired, ERROR_OUT_OF_STRUCTURES will be returned by an attempt to open a file.
 static const size_t MaxIncludedFiles = 1000;
+static_assert(MaxIncludedFiles < (1 << 16), "else file index doesn't fit in a handle");
+
+/// Process-wide cache of UTF-8 encoded include contents.
+///
+/// The include handler remains the source of truth on every compile, but hosts
+/// commonly serve the same headers to many concurrent compiles. When the
+/// handler returns bytes that needed conversion to UTF-8, the encoded blob is
+/// kept here keyed on the resolved name, and reused by later compiles that
+/// receive byte-identical contents for that name. Different contents for the
+/// same name replace the entry, so edited files are never served stale.
+/// Cached blobs are immutable and allocated from the default allocator, so
+/// they can be shared safely across threads and compiler instances.
+class SharedIncludeCache {
+private:
+  struct Entry {
+    CComPtr<IDxcBlob> Raw;
+    UINT32 CodePage;
+    CComPtr<IDxcBlobEncoding> Encoded;
+  };
+  std::mutex m_mutex;
+  std::unordered_map<std::wstring, Entry> m_entries;
+  size_t m_totalBytes = 0;
+  static const size_t MaxTotalBytes = 64 * 1024 * 1024;
+
+  static UINT32 GetBlobCodePage(IDxcBlob *pBlob) {
+    CComPtr<IDxcBlobEncoding> pBlobEncoding;
+    BOOL known = FALSE;
+    UINT32 codePage = CP_ACP;
+    if (SUCCEEDED(pBlob->QueryInterface(&pBlobEncoding)) &&
+        SUCCEEDED(pBlobEncoding->GetEncoding(&known, &codePage)) && known)
+      return codePage;
+    return CP_ACP;
+  }
+
+  static bool SameBytes(IDxcBlob *pA, IDxcBlob *pB) {
+    return pA->GetBufferSize() == pB->GetBufferSize() &&
+           0 == memcmp(pA->GetBufferPointer(), pB->GetBufferPointer(),
+                       pA->GetBufferSize());
+  }
+
+public:
+  static SharedIncludeCache &Get() {
+    static SharedIncludeCache g_Cache;
+    return g_Cache;
+  }
+
+  HRESULT GetBlobAsUtf8(LPCWSTR pName, IDxcBlob *pBlob,
+                        IDxcBlobEncoding **ppEncoded) {
+    UINT32 codePage = GetBlobCodePage(pBlob);
+    std::wstring name(pName);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(name);
+      if (it != m_entries.end() && it->second.CodePage == codePage &&
+          SameBytes(it->second.Raw, pBlob))
+        return it->second.Encoded.CopyTo(ppEncoded);
+    }
+
+    // Encode outside the lock; the cache owns its memory independently of
+    // the compile that first encountered the file.
+    DxcThreadMalloc TM(nullptr);
+    CComPtr<IDxcBlobEncoding> pEncoded;
+    IFR(hlsl::DxcGetBlobAsUtf8(pBlob, &pEncoded));
+    if (pEncoded->GetBufferPointer() == pBlob->GetBufferPointer()) {
+      // No conversion was needed, so there is nothing worth sharing.
+      *ppEncoded = pEncoded.Detach();
+      return S_OK;
+    }
+
+    CComPtr<IDxcBlob> pRaw;
+    IFR(hlsl::DxcCreateBlobOnHeapCopy(pBlob->GetBufferPointer(),
+                                      pBlob->GetBufferSize(), &pRaw));
+    size_t entryBytes = pRaw->GetBufferSize() + pEncoded->GetBufferSize();
+    try {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(name);
+      if (it != m_entries.end()) {
+        m_totalBytes -= it->second.Raw->GetBufferSize() +
+                        it->second.Encoded->GetBufferSize();
+        m_entries.erase(it);
+      }
+      if (m_totalBytes + entryBytes > MaxTotalBytes) {
+        m_entries.clear();
+        m_totalBytes = 0;
+      }
+      if (entryBytes <= MaxTotalBytes) {
+        Entry &entry = m_entries[name];
+        entry.Raw = pRaw;
+        entry.CodePage = codePage;
+        entry.Encoded = pEncoded;
+        m_totalBytes += entryBytes;
+      }
+    }
+    CATCH_CPP_RETURN_HRESULT();
+    *ppEncoded = pEncoded.Detach();
+    return S_OK;
+  }
+};
 
 bool IsAbsoluteOrCurDirRelativeW(LPCWSTR Path) {
   if (!Path || !Path[0]) return FALSE;
@@ -240,6 +341,7 @@ private:
       : Blob(pBlob), BlobStream(pStream), Name(name) { }
   };
   llvm::SmallVector<IncludedFile, 4> m_includedFiles;
+  std::unordered_map<std::wstring, size_t> m_includedFileIndices;
 
   static bool IsDirOf(LPCWSTR lpDir, size_t dirLen, const std::wstring &fileName) {
     if (fileName.size() <= dirLen) return false;
@@ -275,12 +377,15 @@ private:
     }
     return INVALID_HANDLE_VALUE;
   }
+  void AddIncludedFile(std::wstring &&name, IDxcBlob *pBlob, IStream *pStream) {
+    m_includedFileIndices.emplace(name, m_includedFiles.size());
+    m_includedFiles.emplace_back(std::move(name), pBlob, pStream);
+  }
   DWORD TryFindOrOpen(LPCWSTR lpFileName, size_t &index) {
-    for (size_t i = 0; i < m_includedFiles.size(); ++i) {
-      if (0 == wcscmp(lpFileName, m_includedFiles[i].Name.data())) {
-        index = i;
-        return ERROR_SUCCESS;
-      }
+    auto found = m_includedFileIndices.find(lpFileName);
+    if (found != m_includedFileIndices.end()) {
+      index = found->second;
+      return ERROR_SUCCESS;
     }
 
     if (m_includeLoader.p != nullptr) {
@@ -295,14 +400,19 @@ private:
       }
       if (fileBlob.p != nullptr) {
         CComPtr<IDxcBlobEncoding> fileBlobEncoded;
-        if (FAILED(hlsl::DxcGetBlobAsUtf8(fileBlob, &fileBlobEncoded))) {
+        if (FAILED(SharedIncludeCache::Get().GetBlobAsUtf8(
+                lpFileName, fileBlob, &fileBlobEncoded))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
         CComPtr<IStream> fileStream;
         if (FAILED(hlsl::CreateReadOnlyBlobStream(fileBlobEncoded, &fileStream))) {
           return ERROR_UNHANDLED_EXCEPTION;
         }
-        m_includedFiles.emplace_back(std::wstring(lpFileName), fileBlobEncoded, fileStream);
+        try {
+          AddIncludedFile(std::wstring(lpFileName), fileBlobEncoded, fileStream);
+        } catch (...) {
+          return ERROR_UNHANDLED_EXCEPTION;
+        }
         index = m_includedFiles.size() - 1;
 
         if (m_bDisplayIncludeProcess) {
@@ -339,7 +449,7 @@ public:
         m_includeLoader(pHandler), m_bDisplayIncludeProcess(false) {
     MakeAbsoluteOrCurDirRelativeW(m_pSourceName, m_pAbsSourceName);
     IFT(CreateReadOnlyBlobStream(m_pSource, &m_pSourceStream));
-    m_includedFiles.push_back(IncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream));
+    AddIncludedFile(std::wstring(m_pSourceName), m_pSource, m_pSourceStream);
   }
   void EnableDisplayIncludeProcess() override {
     m_bDisplayIncludeProcess = true;
@@ -413,6 +523,11 @@ public:
     return S_OK;
   }
 
+  void GetOpenedFileNames(std::vector<std::wstring> &names) override {
+    for (const IncludedFile &file : m_includedFiles)
+      names.push_back(file.Name);
+  }
+
   ~DxcArgsFileSystemImpl() override { };
   BOOL FindNextFileW(
     _In_   HANDLE hFindFile,
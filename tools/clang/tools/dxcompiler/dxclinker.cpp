@@ -21,6 +21,8 @@
 
 #include "llvm/ADT/SmallVector.h"
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "dxc/HLSL/DxilLinker.h"
 #include "dxc/HLSL/DxilValidation.h"
@@ -37,13 +39,20 @@
 #include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "dxc/Support/HLSLOptions.h"
 
+// SPIRV change starts
+#ifdef ENABLE_SPIRV_CODEGEN
+#include "clang/SPIRV/EmitSPIRVAction.h"
+#endif
+// SPIRV change ends
+
 using namespace hlsl;
 using namespace llvm;
 
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv);
 
-class DxcLinker : public IDxcLinker, public IDxcContainerEvent {
+class DxcLinker : public IDxcLinker2, public IDxcContainerEvent {
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
   DXC_MICROCOM_TM_CTOR(DxcLinker)
@@ -69,6 +78,21 @@ public:
           *ppResult // Linker output status, buffer, and errors
   ) override;
 
+  // Links several targets against the same libraries on worker threads.
+  HRESULT STDMETHODCALLTYPE LinkMany(
+      _In_count_(targetCount)
+          const DxcCompileTarget *pTargets, // Array of entry point and profile pairs
+      UINT32 targetCount,                   // Number of targets
+      _In_count_(libCount)
+          const LPCWSTR *pLibNames, // Array of library names to link
+      UINT32 libCount,              // Number of libraries to link
+      _In_count_(argCount)
+          const LPCWSTR *pArguments, // Array of pointers to arguments
+      _In_ UINT32 argCount,          // Number of arguments
+      _Out_writes_(targetCount) IDxcOperationResult *
+          *ppResults // Linker output status, buffer, and errors per target
+  ) override;
+
   HRESULT STDMETHODCALLTYPE RegisterDxilContainerEventHandler(
       IDxcContainerEventsHandler *pHandler, UINT64 *pCookie) override {
     DxcThreadMalloc TM(m_pMalloc);
@@ -88,7 +112,8 @@ public:
   }
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) {
-    return DoBasicQueryInterface<IDxcLinker>(this, riid, ppvObject);
+    return DoBasicQueryInterface<IDxcLinker, IDxcLinker2>(this, riid,
+                                                          ppvObject);
   }
 
   void Initialize() {
@@ -103,13 +128,33 @@ public:
   }
 
 private:
+#ifdef ENABLE_SPIRV_CODEGEN
+  // Links SPIR-V modules, which spirv-link does in place of DxilLinker.
+  bool LinkSpirv(hlsl::options::DxcOpts &opts,
+                 const std::vector<IDxcBlob *> &libs,
+                 CComPtr<IDxcBlob> &pOutputBlob, raw_ostream &DiagStream);
+#endif
+
   DXC_MICROCOM_TM_REF_FIELDS()
   LLVMContext m_Ctx;
   std::unique_ptr<DxilLinker> m_pLinker;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
   std::vector<CComPtr<IDxcBlob>> m_blobs; // Keep blobs live for lazy load.
+  std::vector<std::wstring> m_blobNames;  // Name each blob is registered as.
+  // Libraries attached by the last link, if attaching them succeeded.
+  std::vector<std::string> m_attachedLibNames;
 };
 
+#ifdef ENABLE_SPIRV_CODEGEN
+// Tells whether the blob is a SPIR-V module rather than a DXIL container.
+static bool IsSpirvModule(IDxcBlob *pBlob) {
+  const uint32_t kSpirvMagicNumber = 0x07230203;
+  return pBlob->GetBufferSize() >= sizeof(uint32_t) &&
+         pBlob->GetBufferSize() % sizeof(uint32_t) == 0 &&
+         *(const uint32_t *)pBlob->GetBufferPointer() == kSpirvMagicNumber;
+}
+#endif
+
 HRESULT
 DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
                            _In_ IDxcBlob *pBlob       // Library to add.
@@ -122,6 +167,19 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
   if (m_pLinker->HasLibNameRegistered(pUtf8LibName.m_psz))
     return E_INVALIDARG;
 
+#ifdef ENABLE_SPIRV_CODEGEN
+  // SPIR-V modules are only kept until they are linked.
+  if (IsSpirvModule(pBlob)) {
+    std::wstring libName(pLibName ? pLibName : L"");
+    if (std::find(m_blobNames.begin(), m_blobNames.end(), libName) !=
+        m_blobNames.end())
+      return E_INVALIDARG;
+    m_blobs.emplace_back(pBlob);
+    m_blobNames.emplace_back(std::move(libName));
+    return S_OK;
+  }
+#endif
+
   try {
     std::unique_ptr<llvm::Module> pModule, pDebugModule;
 
@@ -140,6 +198,7 @@ DxcLinker::RegisterLibrary(_In_opt_ LPCWSTR pLibName, // Name of the library.
     if (m_pLinker->RegisterLib(pUtf8LibName.m_psz, std::move(pModule),
                                std::move(pDebugModule))) {
       m_blobs.emplace_back(pBlob);
+      m_blobNames.emplace_back(pLibName ? pLibName : L"");
       return S_OK;
     } else {
       return E_INVALIDARG;
@@ -163,6 +222,13 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     _COM_Outptr_ IDxcOperationResult *
         *ppResult // Linker output status, buffer, and errors
 ) {
+  if (ppResult == nullptr || (libCount > 0 && pLibNames == nullptr))
+    return E_INVALIDARG;
+  for (UINT32 i = 0; i < libCount; ++i) {
+    if (pLibNames[i] == nullptr)
+      return E_INVALIDARG;
+  }
+
   DxcThreadMalloc TM(m_pMalloc);
   // Prepare UTF8-encoded versions of API values.
   CW2A pUtf8TargetProfile(pTargetProfile, CP_UTF8);
@@ -170,9 +236,6 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
   CComPtr<AbstractMemoryStream> pOutputStream;
 
-  // Detach previous libraries.
-  m_pLinker->DetachAll();
-
   HRESULT hr = S_OK;
   try {
     CComPtr<IMalloc> pMalloc;
@@ -209,11 +272,48 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
     m_Ctx.setDiagnosticHandler(PrintDiagnosticContext::PrintDiagnosticHandler,
                                &DiagContext, true);
 
-    // Attach libraries.
-    bool bSuccess = true;
+#ifdef ENABLE_SPIRV_CODEGEN
+    // The entry points of SPIR-V modules are already in them, so only the
+    // libraries and whether the target is a library matter.
+    std::vector<IDxcBlob *> spirvLibs;
+    for (unsigned i = 0; i < libCount; i++) {
+      auto it = std::find(m_blobNames.begin(), m_blobNames.end(),
+                          std::wstring(pLibNames[i]));
+      if (it != m_blobNames.end() &&
+          IsSpirvModule(m_blobs[it - m_blobNames.begin()]))
+        spirvLibs.push_back(m_blobs[it - m_blobNames.begin()]);
+    }
+    if (!spirvLibs.empty()) {
+      bool hasErrorOccurred = true;
+      if (spirvLibs.size() != libCount)
+        DiagStream << "error: SPIR-V modules cannot be linked with DXIL "
+                      "libraries\n";
+      else
+        hasErrorOccurred =
+            !LinkSpirv(opts, spirvLibs, pOutputBlob, DiagStream);
+      DiagStream.flush();
+      CComPtr<IStream> pStream = pDiagStream;
+      dxcutil::CreateOperationResultFromOutputs(
+          pOutputBlob, pStream, warnings, hasErrorOccurred, ppResult);
+      return S_OK;
+    }
+#endif
+
+    // Attach libraries, unless the last link attached the same ones.
+    std::vector<std::string> libNames;
     for (unsigned i = 0; i < libCount; i++) {
       CW2A pUtf8LibName(pLibNames[i], CP_UTF8);
-      bSuccess &= m_pLinker->AttachLib(pUtf8LibName.m_psz);
+      libNames.emplace_back(pUtf8LibName.m_psz);
+    }
+    bool bSuccess = true;
+    if (libNames != m_attachedLibNames) {
+      // Detach previous libraries.
+      m_pLinker->DetachAll();
+      m_attachedLibNames.clear();
+      for (const std::string &libName : libNames)
+        bSuccess &= m_pLinker->AttachLib(libName);
+      if (bSuccess)
+        m_attachedLibNames = std::move(libNames);
     }
 
     dxilutil::ExportMap exportMap;
@@ -221,8 +321,13 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
 
     bool hasErrorOccurred = !bSuccess;
     if (bSuccess) {
-      std::unique_ptr<Module> pM = m_pLinker->Link(
-          opts.EntryPoint, pUtf8TargetProfile.m_psz, exportMap);
+      std::unique_ptr<Module> pM =
+          opts.PipelineStage.empty()
+              ? m_pLinker->Link(opts.EntryPoint, pUtf8TargetProfile.m_psz,
+                                exportMap)
+              : m_pLinker->LinkPipelineStage(
+                    opts.EntryPoint, pUtf8TargetProfile.m_psz,
+                    opts.PipelineStage, opts.PipelinePackSearch, exportMap);
       if (pM) {
         const IntrusiveRefCntPtr<clang::DiagnosticIDs> Diags(
             new clang::DiagnosticIDs);
@@ -233,10 +338,8 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
             new clang::TextDiagnosticPrinter(DiagStream, &*DiagOpts);
         clang::DiagnosticsEngine Diag(Diags, &*DiagOpts, DiagClient);
 
-        raw_stream_ostream outStream(pOutputStream.p);
-        // Create bitcode of M.
-        WriteBitcodeToFile(pM.get(), outStream);
-        outStream.flush();
+        // pOutputStream is left empty for the container to serialize pM
+        // itself, after stripping its metadata.
 
         // Always save debug info. If lib has debug info, the link result will
         // have debug info.
@@ -249,6 +352,9 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
         if (opts.DebugNameForSource) {
           SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
         }
+        if (!opts.StripReflection) {
+          SerializeFlags |= SerializeDxilFlags::IncludeStatisticsPart;
+        }
         // Validation.
         HRESULT valHR = S_OK;
         // Skip validation on lib for now.
@@ -289,6 +395,136 @@ HRESULT STDMETHODCALLTYPE DxcLinker::Link(
   return hr;
 }
 
+#ifdef ENABLE_SPIRV_CODEGEN
+bool DxcLinker::LinkSpirv(hlsl::options::DxcOpts &opts,
+                          const std::vector<IDxcBlob *> &libs,
+                          CComPtr<IDxcBlob> &pOutputBlob,
+                          raw_ostream &DiagStream) {
+  std::vector<std::vector<uint32_t>> modules;
+  for (IDxcBlob *pLib : libs) {
+    const uint32_t *pWords = (const uint32_t *)pLib->GetBufferPointer();
+    modules.emplace_back(pWords,
+                         pWords + pLib->GetBufferSize() / sizeof(uint32_t));
+  }
+
+  clang::spirv::SpirvCodeGenOptions spirvOpts = opts.SpirvOptions;
+  spirvOpts.codeGenHighLevel = opts.CodeGenHighLevel;
+  spirvOpts.disableValidation = opts.DisableValidation;
+  std::vector<uint32_t> linked;
+  std::string messages;
+  if (!clang::spirv::linkSpirvModules(modules, spirvOpts,
+                                      opts.IsLibraryProfile(), opts.OptLevel,
+                                      &linked, &messages)) {
+    DiagStream << "error: failed to link SPIR-V: " << messages;
+    return false;
+  }
+  IFT(DxcCreateBlobOnHeapCopy(linked.data(),
+                              (UINT32)(linked.size() * sizeof(uint32_t)),
+                              &pOutputBlob));
+  return true;
+}
+#endif
+
+HRESULT STDMETHODCALLTYPE DxcLinker::LinkMany(
+    _In_count_(targetCount)
+        const DxcCompileTarget *pTargets, // Array of entry point and profile pairs
+    UINT32 targetCount,                   // Number of targets
+    _In_count_(libCount)
+        const LPCWSTR *pLibNames, // Array of library names to link
+    UINT32 libCount,              // Number of libraries to link
+    _In_count_(argCount)
+        const LPCWSTR *pArguments, // Array of pointers to arguments
+    _In_ UINT32 argCount,          // Number of arguments
+    _Out_writes_(targetCount) IDxcOperationResult *
+        *ppResults // Linker output status, buffer, and errors per target
+) {
+  if (ppResults == nullptr || (targetCount > 0 && pTargets == nullptr) ||
+      (libCount > 0 && pLibNames == nullptr) ||
+      (argCount > 0 && pArguments == nullptr))
+    return E_INVALIDARG;
+  for (UINT32 i = 0; i < libCount; ++i) {
+    if (pLibNames[i] == nullptr)
+      return E_INVALIDARG;
+  }
+  for (UINT32 i = 0; i < targetCount; ++i) {
+    if (pTargets[i].TargetProfile == nullptr)
+      return E_INVALIDARG;
+    ppResults[i] = nullptr;
+  }
+
+  DxcThreadMalloc TM(m_pMalloc);
+  HRESULT hr = S_OK;
+  try {
+    // Modules belong to an LLVMContext, which only one thread may use at a
+    // time, so each worker has a linker of its own. Container events are
+    // delivered by this linker; with a handler registered, the targets are
+    // linked here instead.
+    unsigned workerCount = std::min<unsigned>(
+        targetCount, std::max(1u, std::thread::hardware_concurrency()));
+    if (workerCount <= 1 || m_pDxcContainerEventsHandler != nullptr) {
+      for (UINT32 i = 0; i < targetCount; ++i) {
+        IFT(Link(pTargets[i].EntryPoint, pTargets[i].TargetProfile, pLibNames,
+                 libCount, pArguments, argCount, &ppResults[i]));
+      }
+    } else {
+      // Workers only load the libraries that are linked.
+      std::vector<size_t> libBlobs;
+      for (UINT32 i = 0; i < libCount; ++i) {
+        auto it = std::find(m_blobNames.begin(), m_blobNames.end(),
+                            std::wstring(pLibNames[i]));
+        if (it != m_blobNames.end())
+          libBlobs.push_back(it - m_blobNames.begin());
+      }
+
+      std::atomic<UINT32> nextTarget(0);
+      std::vector<HRESULT> workerHRs(workerCount, E_FAIL);
+      IMalloc *pMalloc = m_pMalloc;
+      auto linkTargets = [&](unsigned w) {
+        DxcThreadMalloc TM(pMalloc);
+        HRESULT hr = S_OK;
+        try {
+          CComPtr<IDxcLinker> pLinker;
+          IFT(CreateDxcLinker(__uuidof(IDxcLinker), (void **)&pLinker));
+          for (size_t b : libBlobs)
+            IFT(pLinker->RegisterLibrary(m_blobNames[b].c_str(), m_blobs[b]));
+          for (UINT32 i = nextTarget++; i < targetCount; i = nextTarget++) {
+            IFT(pLinker->Link(pTargets[i].EntryPoint,
+                              pTargets[i].TargetProfile, pLibNames, libCount,
+                              pArguments, argCount, &ppResults[i]));
+          }
+        }
+        CATCH_CPP_ASSIGN_HRESULT();
+        workerHRs[w] = hr;
+      };
+
+      std::vector<std::thread> workers;
+      try {
+        for (unsigned w = 0; w < workerCount; ++w)
+          workers.emplace_back(linkTargets, w);
+      } catch (...) {
+        for (std::thread &worker : workers)
+          worker.join();
+        throw;
+      }
+      for (std::thread &worker : workers)
+        worker.join();
+      for (HRESULT workerHR : workerHRs)
+        IFT(workerHR);
+    }
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
+
+  if (FAILED(hr)) {
+    for (UINT32 i = 0; i < targetCount; ++i) {
+      if (ppResults[i] != nullptr) {
+        ppResults[i]->Release();
+        ppResults[i] = nullptr;
+      }
+    }
+  }
+  return hr;
+}
+
 HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv) {
   *ppv = nullptr;
   try {
@@ -22,15 +22,27 @@
 #include "clang/Sema/SemaHLSL.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/MultiplexConsumer.h"
 #include "clang/CodeGen/CodeGenAction.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/PhaseTiming.h"
+#include "llvm/Support/Path.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/HLSL/HLSLExtensionsCodegenHelper.h"
+#include "dxc/HLSL/DxilPressureReport.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include "dxcutil.h"
 #include "dxc/Support/dxcfilesystem.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/DxilContainer/DxilContainerAssembler.h"
+#include "dxc/DxilContainer/DxilShaderArchive.h"
+#include "dxc/DXIL/DxilMetadataHelper.h"
+#include "dxc/DXIL/DxilModule.h"
+#include "dxc/DXIL/DxilShaderModel.h"
 #include "dxc/dxcapi.internal.h"
 
 #include "dxc/Support/dxcapi.use.h"
@@ -38,15 +50,29 @@
 #include "dxc/Support/Unicode.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/WinFunctions.h"
 #include "dxc/Support/dxcapi.impl.h"
+#include "dxc/Support/DxcArenaMalloc.h"
+#include "dxc/Support/DxcJson.h"
 #include "dxc/Support/DxcLangExtensionsHelper.h"
 #include "dxc/Support/HLSLOptions.h"
 #ifdef _WIN32
 #include "dxcetw.h"
+#else
+#include <unistd.h>
 #endif
 #include "dxillib.h"
 #include <algorithm>
+#include <atomic>
 #include <cfloat>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
@@ -69,6 +95,15 @@ DEFINE_CROSS_PLATFORM_UUIDOF(IDxcLangExtensions)
 
 // This declaration is used for the locally-linked validator.
 HRESULT CreateDxcValidator(_In_ REFIID riid, _Out_ LPVOID *ppv);
+// These are used to compile and link the shards of a sharded library.
+HRESULT CreateDxcCompiler(_In_ REFIID riid, _Out_ LPVOID *ppv);
+HRESULT CreateDxcLinker(_In_ REFIID riid, _Out_ LPVOID *ppv);
+// This is used to strip sources with -strip-unused-before-codegen.
+HRESULT DxcRewriteUnusedForEntry(_In_ DxcLangExtensionsHelper *pHelper,
+                                 StringRef preprocessed,
+                                 _In_ LPCSTR pEntryPoint,
+                                 _In_ hlsl::options::DxcOpts &opts,
+                                 std::string &result);
 
 // This internal call allows the validator to avoid having to re-deserialize
 // the module. It trusts that the caller didn't make any changes and is
@@ -123,11 +158,45 @@ struct DefaultFPEnvScope
 #endif
 };
 
+// Semantic defines parsed by the targets of a CompileMany call, by profile.
+// The targets compile the same source with the same arguments and defines, so
+// those with the same profile, which sets the only predefined macros that
+// differ, end preprocessing with the same macros.
+typedef std::unordered_map<std::string, ParsedSemanticDefineList>
+    SharedSemanticDefineMap;
+
 class HLSLExtensionsCodegenHelperImpl : public HLSLExtensionsCodegenHelper {
 private:
   CompilerInstance &m_CI;
   DxcLangExtensionsHelper &m_langExtensionsHelper;
   std::string m_rootSigDefine;
+  std::string m_targetProfile;
+  SharedSemanticDefineMap *m_pSharedDefines;
+
+  // Semantic defines and custom root signature, looked up on first use.
+  bool m_bDefinesParsed;
+  ParsedSemanticDefineList m_defines;
+  bool m_bRootSigFound;
+  CustomRootSignature::Status m_rootSigStatus;
+  CustomRootSignature m_rootSig;
+
+  const ParsedSemanticDefineList &GetParsedSemanticDefines() {
+    if (m_bDefinesParsed)
+      return m_defines;
+    m_bDefinesParsed = true;
+    if (m_pSharedDefines) {
+      auto it = m_pSharedDefines->find(m_targetProfile);
+      if (it != m_pSharedDefines->end()) {
+        m_defines = it->second;
+        return m_defines;
+      }
+    }
+    // Grab the semantic defines seen by the parser.
+    m_defines = CollectSemanticDefinesParsedByCompiler(m_CI, &m_langExtensionsHelper);
+    if (m_pSharedDefines)
+      (*m_pSharedDefines)[m_targetProfile] = m_defines;
+    return m_defines;
+  }
 
   // The metadata format is a root node that has pointers to metadata
   // nodes for each define. The metatdata node for a define is a pair
@@ -167,16 +236,17 @@ private:
   }
 
 public:
-  HLSLExtensionsCodegenHelperImpl(CompilerInstance &CI, DxcLangExtensionsHelper &langExtensionsHelper, StringRef rootSigDefine)
+  HLSLExtensionsCodegenHelperImpl(CompilerInstance &CI, DxcLangExtensionsHelper &langExtensionsHelper, StringRef rootSigDefine,
+                                  StringRef targetProfile = StringRef(), SharedSemanticDefineMap *pSharedDefines = nullptr)
   : m_CI(CI), m_langExtensionsHelper(langExtensionsHelper)
-  , m_rootSigDefine(rootSigDefine)
+  , m_rootSigDefine(rootSigDefine), m_targetProfile(targetProfile)
+  , m_pSharedDefines(pSharedDefines), m_bDefinesParsed(false)
+  , m_bRootSigFound(false), m_rootSigStatus(CustomRootSignature::NOT_FOUND)
   {}
 
   // Write semantic defines as metadata in the module.
   virtual std::vector<SemanticDefineError> WriteSemanticDefines(llvm::Module *M) override {
-    // Grab the semantic defines seen by the parser.
-    ParsedSemanticDefineList defines =
-      CollectSemanticDefinesParsedByCompiler(m_CI, &m_langExtensionsHelper);
+    const ParsedSemanticDefineList &defines = GetParsedSemanticDefines();
 
     // Nothing to do if we have no defines.
     SemanticDefineErrorList errors;
@@ -205,6 +275,17 @@ public:
   }
 
   virtual HLSLExtensionsCodegenHelper::CustomRootSignature::Status GetCustomRootSignature(CustomRootSignature *out) override {
+    if (!m_bRootSigFound) {
+      m_bRootSigFound = true;
+      m_rootSigStatus = FindCustomRootSignature(&m_rootSig);
+    }
+    if (m_rootSigStatus == CustomRootSignature::FOUND)
+      *out = m_rootSig;
+    return m_rootSigStatus;
+  }
+
+private:
+  CustomRootSignature::Status FindCustomRootSignature(CustomRootSignature *out) {
     // Find macro definition in preprocessor.
     Preprocessor &pp = m_CI.getPreprocessor();
     MacroInfo *macro = MacroExpander::FindMacroInfo(pp, m_rootSigDefine);
@@ -223,7 +304,1110 @@ public:
   }
 };
 
-class DxcCompiler : public IDxcCompiler2,
+// Include handler that forwards to another handler and remembers what it
+// returned, so that compiling the same source several times in one API call
+// opens each included file only once.
+class DxcMemoizingIncludeHandler : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcIncludeHandler> m_pInner;
+  struct Entry {
+    HRESULT hr;
+    CComPtr<IDxcBlob> pBlob;
+  };
+  std::unordered_map<std::wstring, Entry> m_loaded;
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcMemoizingIncludeHandler)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  void SetInner(IDxcIncludeHandler *pInner) { m_pInner = pInner; }
+
+  HRESULT STDMETHODCALLTYPE LoadSource(
+    _In_ LPCWSTR pFilename,                                   // Candidate filename.
+    _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource  // Resultant source object for included file, nullptr if not found.
+    ) override {
+    *ppIncludeSource = nullptr;
+    try {
+      auto it = m_loaded.find(pFilename);
+      if (it == m_loaded.end()) {
+        Entry entry;
+        entry.hr = m_pInner->LoadSource(pFilename, &entry.pBlob);
+        it = m_loaded.emplace(pFilename, std::move(entry)).first;
+      }
+      if (it->second.pBlob != nullptr)
+        *ppIncludeSource = CComPtr<IDxcBlob>(it->second.pBlob).Detach();
+      return it->second.hr;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+};
+
+#ifdef _WIN32
+// Allocator that forwards to another allocator and tracks how many bytes the
+// compile has outstanding, for peak allocation reporting and -max-memory.
+// Sizes come from the inner allocator's GetSize, so memory allocated before
+// the wrapper was installed can still be freed through it. Outstanding bytes
+// are relative to when the wrapper was created and may go negative.
+class DxcCountingMalloc : public IMalloc {
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  std::atomic<int64_t> m_current = {0};
+  std::atomic<int64_t> m_peak = {0};      // Since the last TakePeak.
+  std::atomic<int64_t> m_totalPeak = {0}; // Since creation.
+  std::atomic<int64_t> m_allocs = {0};    // Since the last TakeAllocations.
+  int64_t m_budget = 0;                   // Zero when unlimited.
+  std::atomic<bool> m_budgetExceeded = {false};
+
+  // Refuses growth that would take the outstanding bytes past the budget.
+  bool Admit(int64_t bytes) {
+    if (m_budget == 0 || bytes <= 0 || m_current.load() + bytes <= m_budget)
+      return true;
+    m_budgetExceeded = true;
+    return false;
+  }
+
+  static void Raise(std::atomic<int64_t> &peak, int64_t value) {
+    int64_t prior = peak.load();
+    while (value > prior && !peak.compare_exchange_weak(prior, value)) {
+    }
+  }
+
+  void Add(int64_t bytes) {
+    int64_t current = m_current.fetch_add(bytes) + bytes;
+    Raise(m_peak, current);
+    Raise(m_totalPeak, current);
+  }
+
+public:
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcCountingMalloc)
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
+    return DoBasicQueryInterface<IMalloc>(this, iid, ppvObject);
+  }
+
+  // Returns the peak since the previous call and restarts tracking from the
+  // bytes outstanding now.
+  int64_t TakePeak() {
+    int64_t peak = m_peak.exchange(m_current.load());
+    return std::max(peak, (int64_t)0);
+  }
+  int64_t GetTotalPeak() const { return m_totalPeak.load(); }
+  int64_t GetCurrent() const { return m_current.load(); }
+
+  // Returns the number of blocks allocated or reallocated since the previous
+  // call.
+  int64_t TakeAllocations() { return m_allocs.exchange(0); }
+
+  void SetBudget(int64_t bytes) { m_budget = bytes; }
+  bool BudgetExceeded() const { return m_budgetExceeded.load(); }
+
+  void *STDMETHODCALLTYPE Alloc(_In_ SIZE_T cb) override {
+    if (!Admit((int64_t)cb))
+      return nullptr;
+    void *p = m_pMalloc->Alloc(cb);
+    if (p != nullptr) {
+      Add((int64_t)m_pMalloc->GetSize(p));
+      ++m_allocs;
+    }
+    return p;
+  }
+
+  void *STDMETHODCALLTYPE Realloc(_In_opt_ void *pv, _In_ SIZE_T cb) override {
+    int64_t oldSize = pv ? (int64_t)m_pMalloc->GetSize(pv) : 0;
+    if (!Admit((int64_t)cb - oldSize))
+      return nullptr;
+    void *p = m_pMalloc->Realloc(pv, cb);
+    if (p != nullptr) {
+      Add((int64_t)m_pMalloc->GetSize(p) - oldSize);
+      ++m_allocs;
+    } else if (cb == 0)
+      Add(-oldSize);
+    return p;
+  }
+
+  void STDMETHODCALLTYPE Free(_In_opt_ void *pv) override {
+    if (pv == nullptr)
+      return;
+    Add(-(int64_t)m_pMalloc->GetSize(pv));
+    m_pMalloc->Free(pv);
+  }
+
+  SIZE_T STDMETHODCALLTYPE GetSize(_In_opt_ _Post_writable_byte_size_(return) void *pv) override {
+    return m_pMalloc->GetSize(pv);
+  }
+
+  int STDMETHODCALLTYPE DidAlloc(_In_opt_ void *pv) override {
+    return m_pMalloc->DidAlloc(pv);
+  }
+
+  void STDMETHODCALLTYPE HeapMinimize(void) override {
+    m_pMalloc->HeapMinimize();
+  }
+};
+#endif
+
+// Tracks the heap usage of one compile while in scope and enforces the
+// -max-memory budget. Usage can only be seen on Windows, where the compiler's
+// operator new goes through the thread allocator; elsewhere nothing is
+// tracked, the budget isn't enforced and peaks are reported as unknown.
+class DxcCompileMemoryTracker {
+private:
+  unsigned long m_budgetMB;
+#ifdef _WIN32
+  CComPtr<DxcCountingMalloc> m_pMalloc;
+  std::unique_ptr<DxcThreadMalloc> m_pTM;
+#endif
+
+public:
+  DxcCompileMemoryTracker(IMalloc *pMalloc, unsigned long budgetMB)
+      : m_budgetMB(budgetMB) {
+#ifdef _WIN32
+    m_pMalloc = DxcCountingMalloc::Alloc(pMalloc);
+    IFTOOM(m_pMalloc.p);
+    m_pMalloc->SetBudget((int64_t)budgetMB * 1024 * 1024);
+    m_pTM.reset(new DxcThreadMalloc(m_pMalloc));
+#else
+    (void)pMalloc;
+#endif
+  }
+
+  unsigned long GetBudgetMB() const { return m_budgetMB; }
+
+  // Peak since the previous call, or -1 when usage isn't tracked.
+  int64_t TakePeak() {
+#ifdef _WIN32
+    return m_pMalloc->TakePeak();
+#else
+    return -1;
+#endif
+  }
+
+  // Blocks allocated since the previous call, or -1 when usage isn't
+  // tracked.
+  int64_t TakeAllocations() {
+#ifdef _WIN32
+    return m_pMalloc->TakeAllocations();
+#else
+    return -1;
+#endif
+  }
+
+  // Peak since the tracker was created, or -1 when usage isn't tracked.
+  int64_t GetTotalPeak() const {
+#ifdef _WIN32
+    return m_pMalloc->GetTotalPeak();
+#else
+    return -1;
+#endif
+  }
+
+  // Bytes outstanding now, or -1 when usage isn't tracked.
+  int64_t GetCurrent() const {
+#ifdef _WIN32
+    return m_pMalloc->GetCurrent();
+#else
+    return -1;
+#endif
+  }
+
+  bool BudgetExceeded() const {
+#ifdef _WIN32
+    return m_pMalloc->BudgetExceeded();
+#else
+    return false;
+#endif
+  }
+
+  // Makes the peak available from pResult through IDxcCompileMemoryUsage.
+  void AttachTo(IDxcOperationResult *pResult) const {
+    // All compile results are created through DxcOperationResult.
+    static_cast<DxcOperationResult *>(pResult)->m_peakBytes = GetTotalPeak();
+  }
+};
+
+// Collects the timings of one compile for -ftime-report while in scope and
+// renders them as JSON. Phases are listed in the order they finished; pass
+// runs are summed per pass name, along with how much they grew the IR and,
+// when the memory tracker can see usage, the heap. Peak allocation and the
+// number of allocations per phase come from the same tracker. With
+// -arena-malloc, the arena's statistics are included as well.
+class DxcCompileTimingsRecorder : public llvm::PhaseTimingListener {
+private:
+  struct Phase {
+    std::string Name;
+    double Seconds;
+    int64_t PeakBytes;
+    int64_t Allocations;
+  };
+  struct PassTotal {
+    std::string Name;
+    double Seconds;
+    unsigned Runs;
+    int64_t InstructionDelta;
+    int64_t MemoryDelta;
+  };
+  std::vector<Phase> m_phases;
+  std::vector<PassTotal> m_passes;
+  llvm::StringMap<size_t> m_passIndex;
+  // Bytes outstanding when each pass run in progress started; pass runs nest
+  // when a pass manager runs inside another pass.
+  std::vector<int64_t> m_passStartBytes;
+  std::chrono::steady_clock::time_point m_start;
+  CComPtr<DxcArenaMalloc> m_pArena;
+  llvm::PhaseTimingListener *m_pPriorListener;
+  DxcCompileMemoryTracker *m_pMemory;
+
+public:
+  DxcCompileTimingsRecorder(DxcCompileMemoryTracker *pMemory,
+                            DxcArenaMalloc *pArena)
+      : m_start(std::chrono::steady_clock::now()), m_pArena(pArena),
+        m_pMemory(pMemory) {
+    m_pPriorListener = llvm::setPhaseTimingListener(this);
+  }
+
+  ~DxcCompileTimingsRecorder() {
+    llvm::setPhaseTimingListener(m_pPriorListener);
+  }
+
+  void phaseFinished(StringRef Name, double Seconds) override {
+    Phase phase;
+    phase.Name = Name;
+    phase.Seconds = Seconds;
+    phase.PeakBytes = m_pMemory->TakePeak();
+    phase.Allocations = m_pMemory->TakeAllocations();
+    m_phases.emplace_back(std::move(phase));
+  }
+
+  PassTotal &GetPass(StringRef Name) {
+    auto it = m_passIndex.insert(std::make_pair(Name, m_passes.size()));
+    if (it.second) {
+      PassTotal pass;
+      pass.Name = Name;
+      pass.Seconds = 0;
+      pass.Runs = 0;
+      pass.InstructionDelta = 0;
+      pass.MemoryDelta = 0;
+      m_passes.emplace_back(std::move(pass));
+    }
+    return m_passes[it.first->second];
+  }
+
+  void passFinished(StringRef Name, double Seconds) override {
+    PassTotal &pass = GetPass(Name);
+    pass.Seconds += Seconds;
+    ++pass.Runs;
+  }
+
+  bool wantsPassSizes() override { return true; }
+
+  void passStarted(StringRef Name) override {
+    m_passStartBytes.push_back(m_pMemory->GetCurrent());
+  }
+
+  void passSizeChanged(StringRef Name, int64_t InstructionDelta) override {
+    PassTotal &pass = GetPass(Name);
+    pass.InstructionDelta += InstructionDelta;
+    if (!m_passStartBytes.empty()) {
+      int64_t startBytes = m_passStartBytes.back();
+      m_passStartBytes.pop_back();
+      if (startBytes >= 0)
+        pass.MemoryDelta += m_pMemory->GetCurrent() - startBytes;
+    }
+  }
+
+  // Renders what was recorded so far and makes it available from pResult
+  // through IDxcCompileTimings.
+  void AttachTo(IDxcOperationResult *pResult) {
+    double total = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_start).count();
+    std::string json;
+    raw_string_ostream OS(json);
+    OS << "{\n  \"seconds\": " << format("%.6f", total);
+    if (m_pMemory->GetTotalPeak() >= 0)
+      OS << ",\n  \"peakBytes\": " << m_pMemory->GetTotalPeak();
+    OS << ",\n  \"phases\": [";
+    for (size_t i = 0; i < m_phases.size(); ++i) {
+      const Phase &phase = m_phases[i];
+      OS << (i ? ",\n" : "\n") << "    {\"name\": ";
+      WriteJsonString(OS, phase.Name);
+      OS << ", \"seconds\": " << format("%.6f", phase.Seconds);
+      if (phase.PeakBytes >= 0)
+        OS << ", \"peakBytes\": " << phase.PeakBytes;
+      if (phase.Allocations >= 0)
+        OS << ", \"allocations\": " << phase.Allocations;
+      OS << "}";
+    }
+    OS << "\n  ],\n  \"passes\": [";
+    for (size_t i = 0; i < m_passes.size(); ++i) {
+      const PassTotal &pass = m_passes[i];
+      OS << (i ? ",\n" : "\n") << "    {\"name\": ";
+      WriteJsonString(OS, pass.Name);
+      OS << ", \"seconds\": " << format("%.6f", pass.Seconds)
+         << ", \"runs\": " << pass.Runs
+         << ", \"instructionDelta\": " << pass.InstructionDelta;
+      if (m_pMemory->GetTotalPeak() >= 0)
+        OS << ", \"memoryDelta\": " << pass.MemoryDelta;
+      OS << "}";
+    }
+    OS << "\n  ]";
+    if (m_pArena) {
+      DxcArenaMallocStats stats = m_pArena->GetStats();
+      OS << ",\n  \"arena\": {\"allocations\": " << stats.AllocCount
+         << ", \"allocatedBytes\": " << stats.AllocBytes
+         << ", \"frees\": " << stats.FreeCount
+         << ", \"foreignFrees\": " << stats.ForeignFreeCount
+         << ", \"chunks\": " << stats.ChunkCount
+         << ", \"reservedBytes\": " << stats.ReservedBytes << "}";
+    }
+    OS << "\n}\n";
+    OS.flush();
+
+    CComPtr<IDxcBlobEncoding> pTimings;
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(json.data(), json.size(), CP_UTF8,
+                                            &pTimings));
+    // All compile results are created through DxcOperationResult.
+    static_cast<DxcOperationResult *>(pResult)->m_timings = pTimings;
+  }
+};
+
+// Records the phases and passes of a compile for -ftime-trace, and reports
+// each as an ETW event where those are available. When the compile is done
+// they are appended to the trace file as Chrome trace events, together with
+// a span for the whole compile that names the shader and its hash. Events are
+// written in the JSON array format without the closing bracket, which trace
+// viewers accept, so the compiles of one or several processes can share a
+// file; each compile appends with a single write.
+class DxcCompileTraceRecorder : public llvm::PhaseTimingListener {
+private:
+  struct Span {
+    std::string Name;
+    bool IsPass;
+    int64_t StartMicroseconds;
+    int64_t DurationMicroseconds;
+  };
+  std::vector<Span> m_spans;
+  std::wstring m_fileName;
+  std::string m_shader;
+  std::string m_target;
+  int64_t m_startMicroseconds;
+  llvm::PhaseTimingListener *m_pPriorListener;
+
+  static int64_t NowMicroseconds() {
+    // Wall-clock time, so that traces taken on several machines line up.
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  void Record(StringRef Name, bool IsPass, double Seconds) {
+    Span span;
+    span.Name = Name;
+    span.IsPass = IsPass;
+    span.DurationMicroseconds = (int64_t)(Seconds * 1e6);
+    span.StartMicroseconds = NowMicroseconds() - span.DurationMicroseconds;
+    DxcEtw_DXCompilerPhase(span.Name.c_str(), IsPass, m_shader.c_str(),
+                           (UINT64)span.DurationMicroseconds);
+    m_spans.emplace_back(std::move(span));
+  }
+
+  void WriteEvent(raw_ostream &OS, StringRef Name, StringRef Category,
+                  int64_t Start, int64_t Duration, unsigned ProcessId,
+                  unsigned ThreadId, StringRef Hash) {
+    OS << "{\"name\": ";
+    WriteJsonString(OS, Name);
+    OS << ", \"cat\": \"" << Category << "\", \"ph\": \"X\", \"ts\": " << Start
+       << ", \"dur\": " << Duration << ", \"pid\": " << ProcessId
+       << ", \"tid\": " << ThreadId << ", \"args\": {\"shader\": ";
+    WriteJsonString(OS, m_shader);
+    OS << ", \"target\": ";
+    WriteJsonString(OS, m_target);
+    if (!Hash.empty())
+      OS << ", \"hash\": \"" << Hash << '"';
+    OS << "}},\n";
+  }
+
+public:
+  DxcCompileTraceRecorder(StringRef FileName, LPCWSTR pSourceName,
+                          LPCWSTR pEntryPoint, LPCWSTR pTargetProfile)
+      : m_startMicroseconds(NowMicroseconds()) {
+    m_fileName = CA2W(FileName.str().c_str(), CP_UTF8).m_psz;
+    m_shader = CW2A(pSourceName, CP_UTF8).m_psz;
+    m_shader += ':';
+    m_shader += CW2A(pEntryPoint, CP_UTF8).m_psz;
+    m_target = CW2A(pTargetProfile, CP_UTF8).m_psz;
+    // Any listener already installed, such as -ftime-report's, keeps getting
+    // everything.
+    m_pPriorListener = llvm::setPhaseTimingListener(this);
+  }
+
+  ~DxcCompileTraceRecorder() {
+    llvm::setPhaseTimingListener(m_pPriorListener);
+  }
+
+  void phaseFinished(StringRef Name, double Seconds) override {
+    Record(Name, false, Seconds);
+    if (m_pPriorListener)
+      m_pPriorListener->phaseFinished(Name, Seconds);
+  }
+
+  void passFinished(StringRef Name, double Seconds) override {
+    Record(Name, true, Seconds);
+    if (m_pPriorListener)
+      m_pPriorListener->passFinished(Name, Seconds);
+  }
+
+  bool wantsPassSizes() override {
+    return m_pPriorListener && m_pPriorListener->wantsPassSizes();
+  }
+
+  void passStarted(StringRef Name) override {
+    if (m_pPriorListener)
+      m_pPriorListener->passStarted(Name);
+  }
+
+  void passSizeChanged(StringRef Name, int64_t InstructionDelta) override {
+    if (m_pPriorListener)
+      m_pPriorListener->passSizeChanged(Name, InstructionDelta);
+  }
+
+  // Appends what was recorded to the trace file. The hash is taken from the
+  // container the compile produced, if any. Failing to write the trace
+  // doesn't fail the compile.
+  void Write(IDxcBlob *pOutput) {
+    try {
+      SmallString<32> hash;
+      const DxilContainerHeader *pContainer =
+          pOutput ? IsDxilContainerLike(pOutput->GetBufferPointer(),
+                                        pOutput->GetBufferSize())
+                  : nullptr;
+      if (pContainer &&
+          IsValidDxilContainer(pContainer, pOutput->GetBufferSize())) {
+        DxilContainerHash key;
+        GetDxilShaderArchiveKey(pContainer, &key);
+        llvm::MD5::stringifyResult(key.Digest, hash);
+      }
+
+#ifdef _WIN32
+      unsigned processId = (unsigned)GetCurrentProcessId();
+#else
+      unsigned processId = (unsigned)getpid();
+#endif
+      unsigned threadId =
+          (unsigned)std::hash<std::thread::id>()(std::this_thread::get_id());
+
+      std::string text;
+      raw_string_ostream OS(text);
+      WriteEvent(OS, "compile", "compile", m_startMicroseconds,
+                 NowMicroseconds() - m_startMicroseconds, processId, threadId,
+                 hash);
+      for (const Span &span : m_spans)
+        WriteEvent(OS, span.Name, span.IsPass ? "pass" : "phase",
+                   span.StartMicroseconds, span.DurationMicroseconds,
+                   processId, threadId, hash);
+      OS.flush();
+
+      // Appends are atomic between processes; the lock only keeps the check
+      // for an empty file and the write together within this one.
+      static std::mutex s_fileMutex;
+      std::lock_guard<std::mutex> lock(s_fileMutex);
+      CHandle file(CreateFileW(m_fileName.c_str(), FILE_APPEND_DATA,
+                               FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                               OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+      if (file == INVALID_HANDLE_VALUE)
+        return;
+      LARGE_INTEGER size;
+      if (GetFileSizeEx(file, &size) && size.QuadPart == 0)
+        text.insert(0, "[\n");
+      DWORD written;
+      WriteFile(file, text.data(), (DWORD)text.size(), &written, nullptr);
+    } catch (...) {
+    }
+  }
+};
+
+// Builds the keys of the compile caches. Every value is followed by a
+// separator so adjacent strings can't alias each other.
+class DxcCacheKeyHasher {
+private:
+  llvm::MD5 m_hasher;
+
+public:
+  void AddString(llvm::StringRef value) {
+    m_hasher.update(value);
+    m_hasher.update(llvm::ArrayRef<uint8_t>((const uint8_t *)"", 1));
+  }
+
+  void AddBlob(IDxcBlob *pBlob) {
+    AddString(llvm::StringRef((const char *)pBlob->GetBufferPointer(),
+                              pBlob->GetBufferSize()));
+  }
+
+  // Returns the digest as hex text; the hasher can't be used afterwards.
+  std::string Finish() {
+    llvm::MD5::MD5Result digest;
+    m_hasher.final(digest);
+    SmallString<32> digestText;
+    llvm::MD5::stringifyResult(digest, digestText);
+    return digestText.str();
+  }
+};
+
+// Content-addressed store of compile results, enabled with -cache-dir.
+//
+// Entries are keyed on the preprocessed source and on everything else that
+// can influence the output (arguments, defines, entry point, profile and the
+// compiler/validator versions), so a hit can hand back the stored blobs
+// without running Sema, codegen or the optimizer. Each entry is a single file
+// holding a small header followed by the result, error and debug blobs; any
+// entry that cannot be read back in full is treated as a miss.
+class DxcCompileCache {
+private:
+  struct EntryHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t ResultSize;
+    uint32_t ErrorSize;
+    uint32_t DebugSize;
+  };
+  static const uint32_t EntryMagic = 0x43435844; // 'DXCC'
+  static const uint32_t EntryVersion = 1;
+
+  std::wstring m_entryPath;
+
+  static void AppendBlob(std::vector<uint8_t> &data, IDxcBlob *pBlob) {
+    if (pBlob == nullptr)
+      return;
+    const uint8_t *pBytes = (const uint8_t *)pBlob->GetBufferPointer();
+    data.insert(data.end(), pBytes, pBytes + pBlob->GetBufferSize());
+  }
+
+  static uint32_t BlobSize(IDxcBlob *pBlob) {
+    return pBlob ? (uint32_t)pBlob->GetBufferSize() : 0;
+  }
+
+public:
+  // Computes the key for this compile and the file that would hold its entry.
+  DxcCompileCache(const hlsl::options::DxcOpts &opts, IDxcBlob *pPreprocessed,
+                  LPCWSTR pEntryPoint, LPCWSTR pTargetProfile,
+                  _In_count_(defineCount) const DxcDefine *pDefines,
+                  UINT32 defineCount, bool wantsDebugBlob) {
+    DxcCacheKeyHasher hasher;
+    hasher.AddBlob(pPreprocessed);
+    hasher.AddString(Unicode::UTF16ToUTF8StringOrThrow(pEntryPoint));
+    hasher.AddString(Unicode::UTF16ToUTF8StringOrThrow(pTargetProfile));
+
+    // Normalize the arguments: the cache location itself never affects the
+    // output, and API defines are order-independent.
+    for (const llvm::opt::Arg *A : opts.Args) {
+      if (A->getOption().matches(options::OPT_cache_dir))
+        continue;
+      hasher.AddString(A->getAsString(opts.Args));
+    }
+    std::vector<std::string> defines;
+    for (UINT32 i = 0; i < defineCount; ++i) {
+      std::string define = Unicode::UTF16ToUTF8StringOrThrow(pDefines[i].Name);
+      define += "=";
+      if (pDefines[i].Value)
+        define += Unicode::UTF16ToUTF8StringOrThrow(pDefines[i].Value);
+      defines.emplace_back(std::move(define));
+    }
+    std::sort(defines.begin(), defines.end());
+    for (const std::string &define : defines)
+      hasher.AddString(define);
+
+    // Compiler identity.
+    UINT32 valMajor, valMinor;
+    dxcutil::GetValidatorVersion(&valMajor, &valMinor);
+    std::string version;
+    raw_string_ostream versionStream(version);
+    versionStream << DXIL::kDxilMajor << "." << DXIL::kDxilMinor << ";"
+                  << valMajor << "." << valMinor << ";"
+                  << (wantsDebugBlob ? "dbg" : "nodbg");
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+    versionStream << ";" << getGitCommitHash();
+#endif
+    hasher.AddString(versionStream.str());
+
+    SmallString<256> entryPath(opts.CacheDir);
+    llvm::sys::path::append(entryPath, hasher.Finish() + ".dxcache");
+    m_entryPath = Unicode::UTF8ToUTF16StringOrThrow(entryPath.c_str());
+  }
+
+  // Loads the stored blobs for this key, if a complete entry exists.
+  bool Lookup(IMalloc *pMalloc, CComPtr<IDxcBlob> &pResult,
+              CComPtr<IDxcBlobEncoding> &pErrors,
+              CComPtr<IDxcBlob> &pDebug) {
+    CDxcMallocHeapPtr<uint8_t> pData(pMalloc);
+    DWORD dataSize = 0;
+    try {
+      ReadBinaryFile(pMalloc, m_entryPath.c_str(), (void **)&pData.m_pData,
+                     &dataSize);
+    } catch (...) {
+      return false;
+    }
+
+    EntryHeader header;
+    if (dataSize < sizeof(header))
+      return false;
+    memcpy(&header, pData.m_pData, sizeof(header));
+    uint64_t expectedSize = (uint64_t)sizeof(header) + header.ResultSize +
+                            header.ErrorSize + header.DebugSize;
+    if (header.Magic != EntryMagic || header.Version != EntryVersion ||
+        header.ResultSize == 0 || expectedSize != dataSize)
+      return false;
+
+    const uint8_t *pCursor = pData.m_pData + sizeof(header);
+    IFT(DxcCreateBlobOnHeapCopy(pCursor, header.ResultSize, &pResult));
+    pCursor += header.ResultSize;
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(pCursor, header.ErrorSize,
+                                            CP_UTF8, &pErrors));
+    pCursor += header.ErrorSize;
+    if (header.DebugSize)
+      IFT(DxcCreateBlobOnHeapCopy(pCursor, header.DebugSize, &pDebug));
+    return true;
+  }
+
+  // Stores the blobs of a successful compile. Failing to write the entry
+  // only costs a future cache hit, so errors are not reported.
+  void Store(IDxcBlob *pResult, IDxcBlobEncoding *pErrors, IDxcBlob *pDebug) {
+    if (pResult == nullptr || pResult->GetBufferSize() == 0)
+      return;
+    try {
+      EntryHeader header = {EntryMagic, EntryVersion, BlobSize(pResult),
+                            BlobSize(pErrors), BlobSize(pDebug)};
+      std::vector<uint8_t> data((const uint8_t *)&header,
+                                (const uint8_t *)(&header + 1));
+      AppendBlob(data, pResult);
+      AppendBlob(data, pErrors);
+      AppendBlob(data, pDebug);
+      WriteBinaryFile(m_entryPath.c_str(), data.data(), data.size());
+    } catch (...) {
+    }
+  }
+};
+
+// Extracts the suggested PDB name from the debug name part of a container.
+static void GetDebugBlobNameFromContainer(IDxcBlob *pContainerBlob,
+                                          CHeapPtr<wchar_t> &DebugBlobName) {
+  const DxilContainerHeader *pContainer =
+      reinterpret_cast<DxilContainerHeader *>(pContainerBlob->GetBufferPointer());
+  DXASSERT(IsValidDxilContainer(pContainer, pContainerBlob->GetBufferSize()),
+           "else invalid container generated");
+  auto it = std::find_if(begin(pContainer), end(pContainer),
+                         DxilPartIsType(DFCC_ShaderDebugName));
+  if (it != end(pContainer)) {
+    const char *pDebugName;
+    if (GetDxilShaderDebugName(*it, &pDebugName, nullptr) && pDebugName &&
+        *pDebugName) {
+      IFTBOOL(Unicode::UTF8BufferToUTF16ComHeap(pDebugName, &DebugBlobName),
+              DXC_E_CONTAINER_INVALID);
+    }
+  }
+}
+
+// Writes the debug info part for -Qstream_debug to its file while the
+// frontend serializes the debug module, rather than keeping the bitcode in
+// memory next to the stripped program. The file holds the same bytes as the
+// debug info part would. Its program header depends on the bitcode size, so
+// room is left for it and it is filled in by Finish.
+class DxcDebugPartFileStream : public llvm::raw_ostream {
+private:
+  std::wstring m_FileName;
+  HANDLE m_File;
+  uint64_t m_BitcodeSize;
+  llvm::MD5 m_Hash;
+  HRESULT m_Error;
+
+  void Write(const void *pData, DWORD size) {
+    DWORD written;
+    if (SUCCEEDED(m_Error) &&
+        (!WriteFile(m_File, pData, size, &written, nullptr) ||
+         written != size)) {
+      m_Error = HRESULT_FROM_WIN32(GetLastError());
+    }
+  }
+
+  void write_impl(const char *Ptr, size_t Size) override {
+    m_Hash.update(ArrayRef<uint8_t>((const uint8_t *)Ptr, Size));
+    m_BitcodeSize += Size;
+    Write(Ptr, (DWORD)Size);
+  }
+
+  uint64_t current_pos() const override { return m_BitcodeSize; }
+
+  void Close() {
+    if (m_File != INVALID_HANDLE_VALUE) {
+      CloseHandle(m_File);
+      m_File = INVALID_HANDLE_VALUE;
+    }
+  }
+
+public:
+  DxcDebugPartFileStream(LPCWSTR pFileName)
+      : m_FileName(pFileName), m_BitcodeSize(0), m_Error(S_OK) {
+    m_File = CreateFileW(pFileName, GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                         CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE) {
+      dxc::IFT_Data(HRESULT_FROM_WIN32(GetLastError()), pFileName);
+    }
+    DxilProgramHeader header = {};
+    Write(&header, sizeof(header));
+  }
+  ~DxcDebugPartFileStream() override {
+    flush();
+    Close();
+  }
+
+  // Pads the bitcode, writes the program header for it, and closes the file.
+  // Gives back the MD5 of the bitcode, for the debug name part.
+  void Finish(const ShaderModel *pModel, DxilContainerHash *pBitcodeHash) {
+    flush();
+    uint32_t padding = 0;
+    Write(&padding, (4 - m_BitcodeSize % 4) % 4);
+
+    DxilProgramHeader header;
+    unsigned dxilMajor, dxilMinor;
+    pModel->GetDxilVersion(dxilMajor, dxilMinor);
+    InitProgramHeader(header,
+                      EncodeVersion(pModel->GetKind(), pModel->GetMajor(),
+                                    pModel->GetMinor()),
+                      DXIL::MakeDxilVersion(dxilMajor, dxilMinor),
+                      (uint32_t)m_BitcodeSize);
+    LARGE_INTEGER start = {};
+    if (SUCCEEDED(m_Error) &&
+        !SetFilePointerEx(m_File, start, nullptr, FILE_BEGIN)) {
+      m_Error = HRESULT_FROM_WIN32(GetLastError());
+    }
+    Write(&header, sizeof(header));
+    Close();
+    dxc::IFT_Data(m_Error, m_FileName.c_str());
+
+    llvm::MD5::MD5Result md5Result;
+    m_Hash.final(md5Result);
+    memcpy(pBitcodeHash->Digest, md5Result, sizeof(pBitcodeHash->Digest));
+  }
+
+  LPCWSTR GetFileName() const { return m_FileName.c_str(); }
+};
+
+#ifdef ENABLE_SPIRV_CODEGEN
+// Generates DXIL and, with -Fspv, SPIR-V from a single parse. Code generation
+// consumes the AST first, then the SPIR-V emitter walks the same AST and
+// writes its module to a stream of its own.
+class EmitBCAndSPIRVAction : public EmitBCAction {
+  raw_ostream *m_pSpirvStream;
+
+public:
+  EmitBCAndSPIRVAction(llvm::LLVMContext *pContext, raw_ostream *pSpirvStream)
+      : EmitBCAction(pContext), m_pSpirvStream(pSpirvStream) {}
+
+protected:
+  std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                 StringRef InFile) override {
+    std::unique_ptr<ASTConsumer> pCodeGen =
+        EmitBCAction::CreateASTConsumer(CI, InFile);
+    if (!pCodeGen)
+      return nullptr;
+    std::vector<std::unique_ptr<ASTConsumer>> consumers;
+    consumers.push_back(std::move(pCodeGen));
+    consumers.push_back(clang::CreateSPIRVEmitter(CI, m_pSpirvStream));
+    return llvm::make_unique<MultiplexConsumer>(std::move(consumers));
+  }
+};
+#endif // ENABLE_SPIRV_CODEGEN
+
+// Keeps TargetInfo instances built by earlier compiles so later compiles on
+// the same compiler object don't have to create them again. The target only
+// depends on the data layout, and the per-compile adjustments made by
+// CompilerInstance are the same for every HLSL compile. Each instance is lent
+// to a single compile at a time, since its reference count isn't atomic.
+class DxcWarmTargetPool {
+private:
+  std::mutex m_mutex;
+  // Idle targets, indexed by whether they use the 16-bit type layout.
+  std::vector<IntrusiveRefCntPtr<TargetInfo>> m_idle[2];
+
+public:
+  IntrusiveRefCntPtr<TargetInfo> Take(bool Enable16BitTypes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<IntrusiveRefCntPtr<TargetInfo>> &idle = m_idle[Enable16BitTypes];
+    if (idle.empty())
+      return nullptr;
+    IntrusiveRefCntPtr<TargetInfo> result = std::move(idle.back());
+    idle.pop_back();
+    return result;
+  }
+
+  void Return(bool Enable16BitTypes, IntrusiveRefCntPtr<TargetInfo> pTarget) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_idle[Enable16BitTypes].push_back(std::move(pTarget));
+  }
+};
+
+// Lends a target from the pool for the duration of a compile. It must be
+// declared before the CompilerInstance that uses the target, so the compiler
+// lets go of it before it goes back to the pool.
+class DxcWarmTargetLease {
+private:
+  DxcWarmTargetPool &m_pool;
+  IMalloc *m_pMalloc;
+  IntrusiveRefCntPtr<TargetInfo> m_pTarget;
+  bool m_enable16BitTypes = false;
+
+public:
+  DxcWarmTargetLease(DxcWarmTargetPool &pool, IMalloc *pMalloc)
+      : m_pool(pool), m_pMalloc(pMalloc) {}
+  ~DxcWarmTargetLease() {
+    if (m_pTarget)
+      m_pool.Return(m_enable16BitTypes, std::move(m_pTarget));
+  }
+
+  TargetInfo *Acquire(DiagnosticsEngine &Diags, bool Enable16BitTypes) {
+    m_enable16BitTypes = Enable16BitTypes;
+    m_pTarget = m_pool.Take(Enable16BitTypes);
+    if (!m_pTarget) {
+      // The target outlives this compile, so it must not come from a
+      // per-compile allocator such as an arena.
+      DxcThreadMalloc TM(m_pMalloc);
+      std::shared_ptr<TargetOptions> targetOptions(new TargetOptions);
+      targetOptions->Triple = "dxil-ms-dx";
+      targetOptions->DescriptionString = Enable16BitTypes
+        ? hlsl::DXIL::kNewLayoutString
+        : hlsl::DXIL::kLegacyLayoutString;
+      m_pTarget = TargetInfo::CreateTargetInfo(Diags, targetOptions);
+    }
+    return m_pTarget.get();
+  }
+};
+
+// Keeps the LLVMContexts of earlier -reuse-context compiles, so later ones
+// find the DXIL struct types, function types and metadata kinds already
+// built. Each context is lent to a single compile at a time, which makes it
+// private to the thread running that compile.
+//
+// A context goes back to the pool clean: other than the dx.types structs,
+// which every module builds the same way, the named struct types lose their
+// names so the next module can use them again. If a compile registered a
+// metadata kind the pool didn't start the context with, the bitcode of
+// later compiles would list it, so such a context is dropped instead; so is
+// one that has been used often enough to have piled up the types and
+// constants of the modules it held.
+class DxcContextPool {
+private:
+  static const unsigned MaxUses = 64;
+  struct Entry {
+    std::unique_ptr<llvm::LLVMContext> Context;
+    unsigned Uses;
+  };
+  std::mutex m_mutex;
+  std::vector<Entry> m_idle;
+  size_t m_kindCount = 0;
+
+public:
+  std::unique_ptr<llvm::LLVMContext> Take(unsigned *pUses) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (!m_idle.empty()) {
+        Entry entry = std::move(m_idle.back());
+        m_idle.pop_back();
+        *pUses = entry.Uses;
+        return std::move(entry.Context);
+      }
+    }
+    std::unique_ptr<llvm::LLVMContext> pContext(new llvm::LLVMContext());
+    // The kinds DXIL code generation and validation attach on demand.
+    for (const char *kind : {hlsl::DxilMDHelper::kDxilPreciseAttributeMDName,
+                             hlsl::DxilMDHelper::kDxilNonUniformAttributeMDName,
+                             hlsl::DxilMDHelper::kDxilControlFlowHintMDName,
+                             hlsl::DxilMDHelper::kHLDxilResourceAttributeMDName,
+                             "llvm.loop"})
+      pContext->getMDKindID(kind);
+    SmallVector<StringRef, 32> kinds;
+    pContext->getMDKindNames(kinds);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_kindCount = kinds.size();
+    }
+    *pUses = 0;
+    return pContext;
+  }
+
+  // Returns a context whose modules are all gone.
+  void Return(std::unique_ptr<llvm::LLVMContext> pContext, unsigned uses) {
+    SmallVector<StringRef, 32> kinds;
+    pContext->getMDKindNames(kinds);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (uses >= MaxUses || kinds.size() != m_kindCount)
+      return;
+    pContext->setDiagnosticHandler(nullptr, nullptr);
+    pContext->setInlineAsmDiagnosticHandler(nullptr, nullptr);
+    pContext->resetStructTypeNames("dx.types.");
+    m_idle.push_back(Entry{std::move(pContext), uses});
+  }
+};
+
+// Provides the LLVMContext of a compile, lent from the pool with
+// -reuse-context and new otherwise. It must be declared before anything that
+// owns a module in the context.
+class DxcContextLease {
+private:
+  DxcContextPool &m_pool;
+  IMalloc *m_pMalloc;
+  std::unique_ptr<llvm::LLVMContext> m_pContext;
+  unsigned m_uses = 0;
+  bool m_pooled;
+
+public:
+  DxcContextLease(DxcContextPool &pool, IMalloc *pMalloc, bool reuse)
+      : m_pool(pool), m_pMalloc(pMalloc), m_pooled(reuse) {
+    if (m_pooled) {
+      // A pooled context outlives this compile, so it must not come from a
+      // per-compile allocator such as an arena.
+      DxcThreadMalloc TM(m_pMalloc);
+      m_pContext = m_pool.Take(&m_uses);
+    } else {
+      m_pContext.reset(new llvm::LLVMContext());
+    }
+  }
+  ~DxcContextLease() {
+    if (!m_pooled)
+      return;
+    DxcThreadMalloc TM(m_pMalloc);
+    // A compile that unwound may have left anything behind.
+    if (std::uncaught_exception())
+      m_pContext.reset();
+    else
+      m_pool.Return(std::move(m_pContext), m_uses + 1);
+  }
+
+  llvm::LLVMContext &Get() { return *m_pContext; }
+};
+
+// Keeps the sources stripped by -strip-unused-before-codegen, so compiles of
+// the same entry point of an ubershader only pay for the strip once. Entries
+// are keyed on the preprocessed source, the entry point and the arguments,
+// and live on the compiler's allocator rather than on the compile's.
+class DxcStrippedSourceCache {
+private:
+  static const size_t MaxEntries = 64;
+  std::mutex m_mutex;
+  std::unordered_map<std::string, std::string> m_entries;
+
+public:
+  static std::string GetKey(const hlsl::options::DxcOpts &opts,
+                            IDxcBlob *pPreprocessed, LPCSTR pEntryPoint) {
+    DxcCacheKeyHasher hasher;
+    hasher.AddBlob(pPreprocessed);
+    hasher.AddString(pEntryPoint);
+    for (const llvm::opt::Arg *A : opts.Args)
+      hasher.AddString(A->getAsString(opts.Args));
+    return hasher.Finish();
+  }
+
+  bool Lookup(const std::string &key, std::string &source) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    if (it == m_entries.end())
+      return false;
+    source = it->second;
+    return true;
+  }
+
+  void Insert(IMalloc *pMalloc, const std::string &key,
+              const std::string &source) {
+    DxcThreadMalloc TM(pMalloc);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() >= MaxEntries)
+      m_entries.clear();
+    m_entries[key] = source;
+  }
+};
+
+// Options read from one argument set. The options refer to the strings held
+// here, and are never changed once read, so compiles can share them.
+struct DxcParsedOptions {
+  hlsl::options::MainArgs Args;
+  std::string TargetProfile;
+  hlsl::options::DxcOpts Opts;
+  // What reading the options wrote to the output stream, replayed into the
+  // stream of every compile that reuses them.
+  std::string Warnings;
+};
+
+// Keeps the options read for recent argument sets, so that compiles repeating
+// the same arguments skip parsing and validating them.
+class DxcParsedOptionsCache {
+private:
+  static const size_t MaxEntries = 64;
+  std::mutex m_mutex;
+  std::unordered_map<std::wstring, std::shared_ptr<DxcParsedOptions>> m_entries;
+
+public:
+  static std::wstring GetKey(LPCWSTR pTargetProfile, LPCWSTR *pArguments,
+                             UINT32 argCount) {
+    // Separate values so adjacent strings can't alias each other.
+    std::wstring key(pTargetProfile ? pTargetProfile : L"");
+    for (UINT32 i = 0; i < argCount; ++i) {
+      key.push_back(L'\0');
+      key.append(pArguments[i]);
+    }
+    return key;
+  }
+
+  std::shared_ptr<DxcParsedOptions> Lookup(const std::wstring &key) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(key);
+    return it == m_entries.end() ? nullptr : it->second;
+  }
+
+  void Insert(IMalloc *pMalloc, const std::wstring &key,
+              const std::shared_ptr<DxcParsedOptions> &options) {
+    DxcThreadMalloc TM(pMalloc);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.size() >= MaxEntries)
+      m_entries.clear();
+    m_entries[key] = options;
+  }
+};
+
+// The semantic defines shared by the targets of each CompileMany call, by the
+// thread making the call, which compiles its targets one after the other.
+class DxcSharedSemanticDefines {
+private:
+  std::mutex m_mutex;
+  std::unordered_map<std::thread::id, SharedSemanticDefineMap *> m_active;
+
+public:
+  class Scope {
+    DxcSharedSemanticDefines &m_owner;
+    SharedSemanticDefineMap m_defines;
+
+  public:
+    explicit Scope(DxcSharedSemanticDefines &owner) : m_owner(owner) {
+      std::lock_guard<std::mutex> lock(m_owner.m_mutex);
+      m_owner.m_active[std::this_thread::get_id()] = &m_defines;
+    }
+    ~Scope() {
+      std::lock_guard<std::mutex> lock(m_owner.m_mutex);
+      m_owner.m_active.erase(std::this_thread::get_id());
+    }
+  };
+
+  // Gets the defines of the CompileMany call on this thread, if any.
+  SharedSemanticDefineMap *GetForThisThread() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_active.find(std::this_thread::get_id());
+    return it == m_active.end() ? nullptr : it->second;
+  }
+};
+
+class DxcCompiler : public IDxcCompiler3,
                     public IDxcLangExtensions,
                     public IDxcContainerEvent,
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
@@ -236,6 +1420,11 @@ private:
   DXC_MICROCOM_TM_REF_FIELDS()
   DxcLangExtensionsHelper m_langExtensionsHelper;
   CComPtr<IDxcContainerEventsHandler> m_pDxcContainerEventsHandler;
+  DxcWarmTargetPool m_warmTargets;
+  DxcContextPool m_contexts;
+  DxcStrippedSourceCache m_strippedSources;
+  DxcParsedOptionsCache m_parsedOptions;
+  DxcSharedSemanticDefines m_sharedSemanticDefines;
 
   void CreateDefineStrings(_In_count_(defineCount) const DxcDefine *pDefines,
                            UINT defineCount,
@@ -271,6 +1460,7 @@ public:
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
     return DoBasicQueryInterface<IDxcCompiler,
                                  IDxcCompiler2,
+                                 IDxcCompiler3,
                                  IDxcLangExtensions,
                                  IDxcContainerEvent,
                                  IDxcVersionInfo
@@ -332,6 +1522,14 @@ public:
     DxcEtw_DXCompilerCompile_Start();
     pSourceName = (pSourceName && *pSourceName) ? pSourceName : L"hlsl.hlsl"; // declared optional, so pick a default
     DxcThreadMalloc TM(m_pMalloc);
+    // With -arena-malloc, installed once the options are read and kept until
+    // everything allocated from it during the compile, including in the
+    // handlers below, has been destroyed.
+    CComPtr<DxcArenaMalloc> pArena;
+    std::unique_ptr<DxcThreadMalloc> pArenaTM;
+    // With -max-memory or -ftime-report; kept past the try block so running
+    // out of budget can be told apart from other allocation failures.
+    std::unique_ptr<DxcCompileMemoryTracker> pMemory;
 
     try {
       DefaultFPEnvScope fpEnvScope;
@@ -339,19 +1537,117 @@ public:
       IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
 
       // Parse command-line options into DxcOpts
-      int argCountInt;
-      IFT(UIntToInt(argCount, &argCountInt));
-      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
-      hlsl::options::DxcOpts opts;
-      CW2A pUtf8TargetProfile(pTargetProfile, CP_UTF8);
-      // Set target profile before reading options and validate
-      opts.TargetProfile = pUtf8TargetProfile.m_psz;
-      bool finished = false;
-      dxcutil::ReadOptsAndValidate(mainArgs, opts, pOutputStream, ppResult, finished);
-      if (finished) {
+      std::shared_ptr<DxcParsedOptions> pParsedOptions = ReadOptions(
+          pTargetProfile, pArguments, argCount, pOutputStream, ppResult);
+      if (!pParsedOptions) {
         hr = S_OK;
         goto Cleanup;
       }
+      hlsl::options::DxcOpts &opts = pParsedOptions->Opts;
+
+      // A dependency scan is served by the preprocessor alone.
+      if (opts.ScanDependencies) {
+        hr = Preprocess(pSource, pSourceName, pArguments, argCount, pDefines,
+                        defineCount, pIncludeHandler, ppResult);
+        goto Cleanup;
+      }
+
+      std::vector<hlsl::DxilGpuModel> pressureModels;
+      if (!ParsePressureReportModels(opts, pressureModels, ppResult)) {
+        hr = S_OK;
+        goto Cleanup;
+      }
+      if (!CheckPassOptionNames(opts, ppResult)) {
+        hr = S_OK;
+        goto Cleanup;
+      }
+
+      // A sharded library is compiled one shard per thread, each shard by a
+      // compiler of its own, and the shards are linked back together.
+      if (opts.LibShards > 1 && opts.LibShardIndex == UINT_MAX &&
+          CompileLibraryShards(opts, pSource, pSourceName, pEntryPoint,
+                               pTargetProfile, pArguments, argCount, pDefines,
+                               defineCount, pIncludeHandler, ppResult)) {
+        hr = S_OK;
+        goto Cleanup;
+      }
+
+      if (opts.ArenaMalloc) {
+        pArena = DxcArenaMalloc::Alloc(m_pMalloc);
+        IFTOOM(pArena.p);
+        pArenaTM.reset(new DxcThreadMalloc(pArena));
+      }
+
+      if (opts.TimeReport || opts.MaxMemoryMB != 0)
+        pMemory.reset(new DxcCompileMemoryTracker(DxcGetThreadMallocNoRef(),
+                                                  opts.MaxMemoryMB));
+
+      std::unique_ptr<DxcCompileTimingsRecorder> pTimings;
+      if (opts.TimeReport)
+        pTimings.reset(new DxcCompileTimingsRecorder(pMemory.get(), pArena));
+      std::unique_ptr<DxcCompileTraceRecorder> pTrace;
+      if (!opts.TimeTraceFile.empty())
+        pTrace.reset(new DxcCompileTraceRecorder(
+            opts.TimeTraceFile, pSourceName, pEntryPoint, pTargetProfile));
+
+      // Serve the compile from the result cache when one is configured. The
+      // key is computed over the preprocessed source, so edits to included
+      // files are picked up.
+      std::unique_ptr<DxcCompileCache> pCache;
+      CComPtr<IDxcBlob> pPreprocessed;
+      if (!opts.CacheDir.empty() && IsCacheableCompile(opts)) {
+        CComPtr<IDxcOperationResult> pPreprocessResult;
+        PreprocessWithOptions(opts, pSource, pSourceName, pArguments, argCount,
+                              pDefines, defineCount, pIncludeHandler,
+                              pPreprocessResult);
+        HRESULT preprocessStatus;
+        IFT(pPreprocessResult->GetStatus(&preprocessStatus));
+        if (SUCCEEDED(preprocessStatus)) {
+          IFT(pPreprocessResult->GetResult(&pPreprocessed));
+          pCache.reset(new DxcCompileCache(
+              opts, pPreprocessed, pEntryPoint, pTargetProfile, pDefines,
+              defineCount, opts.DebugInfo && ppDebugBlob != nullptr));
+
+          CComPtr<IDxcBlob> pCachedResult;
+          CComPtr<IDxcBlobEncoding> pCachedErrors;
+          CComPtr<IDxcBlob> pCachedDebug;
+          if (pCache->Lookup(m_pMalloc, pCachedResult, pCachedErrors,
+                             pCachedDebug)) {
+            if (pTrace)
+              pTrace->Write(pCachedResult);
+            if (ppDebugBlobName)
+              GetDebugBlobNameFromContainer(pCachedResult, DebugBlobName);
+            DxcThreadMalloc TMResult(m_pMalloc);
+            IFT(DxcOperationResult::CreateFromResultErrorStatus(
+                pCachedResult, pCachedErrors, S_OK, ppResult));
+            if (pMemory)
+              pMemory->AttachTo(*ppResult);
+            if (ppDebugBlob)
+              *ppDebugBlob = pCachedDebug.Detach();
+            if (ppDebugBlobName)
+              *ppDebugBlobName = DebugBlobName.Detach();
+            hr = S_OK;
+            goto Cleanup;
+          }
+
+          // On a miss, compile the text already preprocessed for the key
+          // rather than preprocessing the source a second time.
+          if (CanCompilePreprocessed(opts) &&
+              IsCleanPreprocess(pPreprocessResult))
+            pSource = pPreprocessed;
+        }
+      }
+
+      // With -strip-unused-before-codegen, compile the preprocessed source
+      // less what the entry point doesn't reach. Sources the strip can't
+      // handle are compiled as given, so their errors come from the compile.
+      CComPtr<IDxcBlobEncoding> pStrippedSource;
+      if (opts.StripUnusedBeforeCodegen &&
+          StripUnusedSource(opts, pSource, pSourceName, pEntryPoint, pArguments,
+                            argCount, pDefines, defineCount, pIncludeHandler,
+                            pPreprocessed, &pStrippedSource)) {
+        pSource = pStrippedSource;
+      }
 
 #ifdef ENABLE_SPIRV_CODEGEN
       // We want to embed the preprocessed source code in the final SPIR-V if
@@ -377,6 +1673,9 @@ public:
       IFC(hlsl::DxcGetBlobAsUtf8(pSource, &utf8Source));
 
       CComPtr<IDxcBlob> pOutputBlob;
+      CComPtr<IDxcBlob> pStreamedDebugBlob; // With -Qstream_debug.
+      std::string pressureReport; // With -Fre.
+      CComPtr<IDxcBlob> pSpirvBlob; // With -Fspv.
       dxcutil::DxcArgsFileSystem *msfPtr =
         dxcutil::CreateDxcArgsFileSystem(utf8Source, pSourceName, pIncludeHandler);
       std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
@@ -419,11 +1718,17 @@ public:
       std::string warnings;
       raw_string_ostream w(warnings);
       raw_stream_ostream outStream(pOutputStream.p);
-      llvm::LLVMContext llvmContext; // LLVMContext should outlive CompilerInstance
+      // LLVMContext should outlive CompilerInstance. A pooled one must not
+      // be used for allocations that are tracked or released with the
+      // compile.
+      DxcContextLease contextLease(m_contexts, m_pMalloc,
+                                   opts.ReuseContext && !pArena && !pMemory);
+      llvm::LLVMContext &llvmContext = contextLease.Get();
+      DxcWarmTargetLease warmTarget(m_warmTargets, m_pMalloc);
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
+      SetupCompilerForCompile(compiler, warmTarget, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
       msfPtr->SetupForCompilerInstance(compiler);
 
       // The clang entry point (cc1_main) would now create a compiler invocation
@@ -441,7 +1746,7 @@ public:
       compiler.getLangOpts().HLSLEntryFunction =
       compiler.getCodeGenOpts().HLSLEntryFunction = pUtf8EntryPoint.m_psz;
       compiler.getLangOpts().HLSLProfile =
-      compiler.getCodeGenOpts().HLSLProfile = pUtf8TargetProfile.m_psz;
+      compiler.getCodeGenOpts().HLSLProfile = pParsedOptions->TargetProfile;
 
       unsigned rootSigMajor = 0;
       unsigned rootSigMinor = 0;
@@ -521,19 +1826,7 @@ public:
       // SPIRV change starts
 #ifdef ENABLE_SPIRV_CODEGEN
       else if (opts.GenSPIRV) {
-        // Since SpirvOptions is passed to the SPIR-V CodeGen as a whole
-        // structure, we need to copy a few non-spirv-specific options into the
-        // structure.
-        opts.SpirvOptions.enable16BitTypes = opts.Enable16BitTypes;
-        opts.SpirvOptions.codeGenHighLevel = opts.CodeGenHighLevel;
-        opts.SpirvOptions.defaultRowMajor = opts.DefaultRowMajor;
-        opts.SpirvOptions.disableValidation = opts.DisableValidation;
-        // Store a string representation of command line options.
-        if (opts.DebugInfo)
-          for (auto opt : mainArgs.getArrayRef())
-            opts.SpirvOptions.clOptions += " " + std::string(opt);
-
-        compiler.getCodeGenOpts().SpirvOptions = opts.SpirvOptions;
+        SetupSpirvCodeGenOptions(compiler, opts, pParsedOptions->Args);
         clang::EmitSPIRVAction action;
         FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
         action.BeginSourceFile(compiler, file);
@@ -544,8 +1837,31 @@ public:
 #endif
       // SPIRV change ends
       else {
-        EmitBCAction action(&llvmContext);
+        std::unique_ptr<EmitBCAction> pBCAction;
+#ifdef ENABLE_SPIRV_CODEGEN
+        // With -Fspv, the SPIR-V emitter shares the parse with codegen.
+        CComPtr<AbstractMemoryStream> pSpirvStream;
+        std::unique_ptr<raw_stream_ostream> pSpirvOutStream;
+        if (!opts.OutputSpirvFile.empty()) {
+          SetupSpirvCodeGenOptions(compiler, opts, pParsedOptions->Args);
+          IFT(CreateMemoryStream(m_pMalloc, &pSpirvStream));
+          pSpirvOutStream.reset(new raw_stream_ostream(pSpirvStream.p));
+          pBCAction.reset(
+              new EmitBCAndSPIRVAction(&llvmContext, pSpirvOutStream.get()));
+        }
+#endif
+        if (!pBCAction)
+          pBCAction.reset(new EmitBCAction(&llvmContext));
+        EmitBCAction &action = *pBCAction;
         FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+        // With -Qstream_debug, the debug module goes straight to its file
+        // instead of the output stream.
+        std::unique_ptr<DxcDebugPartFileStream> pDebugPartStream;
+        if (!opts.StreamDebugFile.empty() && !opts.CodeGenHighLevel) {
+          CA2W pDebugFile(opts.StreamDebugFile.str().c_str(), CP_UTF8);
+          pDebugPartStream.reset(new DxcDebugPartFileStream(pDebugFile));
+          compiler.setOutStream(pDebugPartStream.get());
+        }
         bool compileOK;
         if (action.BeginSourceFile(compiler, file)) {
           action.Execute();
@@ -556,32 +1872,71 @@ public:
           compileOK = false;
         }
         outStream.flush();
+        compiler.setOutStream(&outStream);
+#ifdef ENABLE_SPIRV_CODEGEN
+        if (pSpirvOutStream) {
+          pSpirvOutStream->flush();
+          if (compileOK)
+            IFT(pSpirvStream.QueryInterface(&pSpirvBlob));
+        }
+#endif
 
         SerializeDxilFlags SerializeFlags = SerializeDxilFlags::None;
         if (opts.DebugInfo) {
           SerializeFlags = SerializeDxilFlags::IncludeDebugNamePart;
           // Unless we want to strip it right away, include it in the container.
-          if (!opts.StripDebug || ppDebugBlob == nullptr) {
+          if (!opts.StripDebug ||
+              (ppDebugBlob == nullptr && opts.StreamDebugFile.empty())) {
             SerializeFlags |= SerializeDxilFlags::IncludeDebugInfoPart;
           }
         }
         if (opts.DebugNameForSource) {
           SerializeFlags |= SerializeDxilFlags::DebugNameDependOnSource;
         }
+        if (!opts.StripReflection) {
+          SerializeFlags |= SerializeDxilFlags::IncludeStatisticsPart;
+        }
+        if (opts.CompactParts) {
+          SerializeFlags |= SerializeDxilFlags::CompactParts;
+        }
 
         // Don't do work to put in a container if an error has occurred
         // Do not create a container when there is only a a high-level representation in the module.
         if (compileOK && !opts.CodeGenHighLevel) {
           HRESULT valHR = S_OK;
+          std::unique_ptr<llvm::Module> pModule = action.takeModule();
+
+          if (!opts.OutputPressureReport.empty()) {
+            raw_string_ostream reportOS(pressureReport);
+            hlsl::WriteDxilPressureReport(
+                *pModule, reportOS,
+                pressureModels.empty() ? nullptr : &pressureModels);
+          }
+
+          DxilContainerHash DebugBitcodeHash;
+          const DxilContainerHash *pDebugBitcodeHash = nullptr;
+          if (pDebugPartStream) {
+            pDebugPartStream->Finish(
+                pModule->GetOrCreateDxilModule().GetShaderModel(),
+                &DebugBitcodeHash);
+            pDebugBitcodeHash = &DebugBitcodeHash;
+            if (ppDebugBlob) {
+              DxcThreadMalloc TMResult(m_pMalloc);
+              IFT(DxcCreateBlobFromMappedFile(pDebugPartStream->GetFileName(),
+                                              &pStreamedDebugBlob));
+            }
+          }
 
           if (needsValidation) {
             valHR = dxcutil::ValidateAndAssembleToContainer(
-                action.takeModule(), pOutputBlob, m_pMalloc, SerializeFlags,
-                pOutputStream, opts.DebugInfo, compiler.getDiagnostics());
+                std::move(pModule), pOutputBlob, m_pMalloc, SerializeFlags,
+                pOutputStream, opts.DebugInfo, compiler.getDiagnostics(),
+                pDebugBitcodeHash);
           } else {
-            dxcutil::AssembleToContainer(action.takeModule(),
+            dxcutil::AssembleToContainer(std::move(pModule),
                                                  pOutputBlob, m_pMalloc,
-                                                 SerializeFlags, pOutputStream);
+                                                 SerializeFlags, pOutputStream,
+                                                 pDebugBitcodeHash);
           }
 
           // Callback after valid DXIL is produced
@@ -595,16 +1950,20 @@ public:
             }
 
             if (ppDebugBlobName && produceFullContainer) {
-              const DxilContainerHeader *pContainer = reinterpret_cast<DxilContainerHeader *>(pOutputBlob->GetBufferPointer());
-              DXASSERT(IsValidDxilContainer(pContainer, pOutputBlob->GetBufferSize()), "else invalid container generated");
-              auto it = std::find_if(begin(pContainer), end(pContainer),
-                DxilPartIsType(DFCC_ShaderDebugName));
-              if (it != end(pContainer)) {
-                const char *pDebugName;
-                if (GetDxilShaderDebugName(*it, &pDebugName, nullptr) && pDebugName && *pDebugName) {
-                  IFTBOOL(Unicode::UTF8BufferToUTF16ComHeap(pDebugName, &DebugBlobName), DXC_E_CONTAINER_INVALID);
-                }
-              }
+              GetDebugBlobNameFromContainer(pOutputBlob, DebugBlobName);
+            }
+
+            // Compress once the container is validated and signed; the
+            // signature still holds for the decompressed container.
+            const DxilContainerHeader *pContainer = IsDxilContainerLike(
+                pOutputBlob->GetBufferPointer(), pOutputBlob->GetBufferSize());
+            if (opts.CompressParts && pContainer &&
+                IsValidDxilContainer(pContainer, pOutputBlob->GetBufferSize())) {
+              CComPtr<AbstractMemoryStream> pCompressedStream;
+              IFT(CreateMemoryStream(m_pMalloc, &pCompressedStream));
+              CompressDxilContainer(pContainer, pCompressedStream);
+              pOutputBlob.Release();
+              IFT(pCompressedStream.QueryInterface(&pOutputBlob));
             }
           }
         }
@@ -613,28 +1972,64 @@ public:
       // Add std err to warnings.
       msfPtr->WriteStdErrToStream(w);
 
-      CreateOperationResultFromOutputs(pOutputBlob, msfPtr, warnings,
-                                       compiler.getDiagnostics(), ppResult);
+      {
+        // The result outlives the compile, so it doesn't come from the arena.
+        DxcThreadMalloc TMResult(m_pMalloc);
+        CreateOperationResultFromOutputs(pOutputBlob, msfPtr, warnings,
+                                         compiler.getDiagnostics(), ppResult);
+        if (pTimings)
+          pTimings->AttachTo(*ppResult);
+        if (pTrace)
+          pTrace->Write(pOutputBlob);
+        if (pMemory)
+          pMemory->AttachTo(*ppResult);
+        if (!pressureReport.empty()) {
+          CComPtr<IDxcBlobEncoding> pReport;
+          IFT(DxcCreateBlobWithEncodingOnHeapCopy(
+              pressureReport.data(), pressureReport.size(), CP_UTF8, &pReport));
+          // All compile results are created through DxcOperationResult.
+          static_cast<DxcOperationResult *>(*ppResult)->m_pressureReport =
+              pReport;
+        }
+        if (pSpirvBlob)
+          static_cast<DxcOperationResult *>(*ppResult)->m_spirv = pSpirvBlob;
+      }
 
       // On success, return values. After assigning ppResult, nothing should fail.
       HRESULT status;
       DXVERIFY_NOMSG(SUCCEEDED((*ppResult)->GetStatus(&status)));
       if (SUCCEEDED(status)) {
-        if (opts.DebugInfo && ppDebugBlob) {
+        if (pStreamedDebugBlob) {
+          *ppDebugBlob = pStreamedDebugBlob.Detach();
+        } else if (opts.DebugInfo && ppDebugBlob) {
           DXVERIFY_NOMSG(SUCCEEDED(pOutputStream.QueryInterface(ppDebugBlob)));
         }
         if (ppDebugBlobName) {
           *ppDebugBlobName = DebugBlobName.Detach();
         }
+        if (pCache) {
+          CComPtr<IDxcBlob> pResultBlob;
+          CComPtr<IDxcBlobEncoding> pErrorBlob;
+          DXVERIFY_NOMSG(SUCCEEDED((*ppResult)->GetResult(&pResultBlob)));
+          DXVERIFY_NOMSG(SUCCEEDED((*ppResult)->GetErrorBuffer(&pErrorBlob)));
+          pCache->Store(pResultBlob, pErrorBlob,
+                        ppDebugBlob ? *ppDebugBlob : nullptr);
+        }
       }
 
       hr = S_OK;
     } catch (std::bad_alloc &) {
       hr = E_OUTOFMEMORY;
+      if (pMemory && pMemory->BudgetExceeded())
+        hr = CreateMemoryBudgetResult(*pMemory, ppResult);
     } catch (hlsl::Exception &e) {
       _Analysis_assume_(DXC_FAILED(e.hr));
-      if (e.hr == DXC_E_ABORT_COMPILATION_ERROR) {
+      if (e.hr == E_OUTOFMEMORY && pMemory && pMemory->BudgetExceeded()) {
+        e.hr = CreateMemoryBudgetResult(*pMemory, ppResult);
+      }
+      else if (e.hr == DXC_E_ABORT_COMPILATION_ERROR) {
         e.hr = S_OK;
+        DxcThreadMalloc TMResult(m_pMalloc);
         CComPtr<IDxcBlobEncoding> pErrorBlob;
         IFT(DxcCreateBlobWithEncodingOnHeapCopy(e.msg.c_str(), e.msg.size(),
                                                 CP_UTF8, &pErrorBlob));
@@ -650,6 +2045,196 @@ public:
     return hr;
   }
 
+  // Compile several entry points out of the same source.
+  HRESULT STDMETHODCALLTYPE CompileMany(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_count_(targetCount) const DxcCompileTarget *pTargets, // Array of entry point and profile pairs
+    _In_ UINT32 targetCount,                      // Number of targets
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(defineCount) const DxcDefine *pDefines,  // Array of defines
+    _In_ UINT32 defineCount,                      // Number of defines
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(targetCount) IDxcOperationResult **ppResults // Compiler output status, buffer, and errors per target
+  ) override {
+    if (pSource == nullptr || ppResults == nullptr ||
+        (targetCount > 0 && pTargets == nullptr) ||
+        (defineCount > 0 && pDefines == nullptr) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < targetCount; ++i) {
+      if (pTargets[i].EntryPoint == nullptr || pTargets[i].TargetProfile == nullptr)
+        return E_INVALIDARG;
+      ppResults[i] = nullptr;
+    }
+
+    HRESULT hr = S_OK;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // The front end keys entry point validation, reachability and
+      // profile-specific semantic checks off a single entry and profile, so
+      // the AST itself cannot be shared between targets. What is shared is
+      // include resolution and preprocessing, which dominate on large
+      // include graphs.
+      CComPtr<IDxcBlob> pPreprocessed;
+      if (targetCount > 1)
+        PreprocessForSharing(pSource, pSourceName, pArguments, argCount,
+                             pDefines, defineCount, pIncludeHandler,
+                             pPreprocessed);
+      // Without shared preprocessing, the targets still share the semantic
+      // defines they parse.
+      std::unique_ptr<DxcSharedSemanticDefines::Scope> pSharedDefines;
+      if (targetCount > 1 && !pPreprocessed &&
+          !m_langExtensionsHelper.GetSemanticDefines().empty())
+        pSharedDefines.reset(
+            new DxcSharedSemanticDefines::Scope(m_sharedSemanticDefines));
+
+      for (UINT32 i = 0; i < targetCount; ++i) {
+        if (pPreprocessed)
+          hr = Compile(pPreprocessed, pSourceName, pTargets[i].EntryPoint,
+                       pTargets[i].TargetProfile, pArguments, argCount,
+                       pDefines, defineCount, nullptr, &ppResults[i]);
+        else
+          hr = Compile(pSource, pSourceName, pTargets[i].EntryPoint,
+                       pTargets[i].TargetProfile, pArguments, argCount,
+                       pDefines, defineCount, pIncludeHandler, &ppResults[i]);
+        if (FAILED(hr))
+          break;
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < targetCount; ++i) {
+        if (ppResults[i] != nullptr) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    return hr;
+  }
+
+  // Compile one entry point once per define set.
+  HRESULT STDMETHODCALLTYPE CompilePermutations(
+    _In_ IDxcBlob *pSource,                       // Source text to compile
+    _In_opt_ LPCWSTR pSourceName,                 // Optional file name for pSource. Used in errors and include handlers.
+    _In_ LPCWSTR pEntryPoint,                     // Entry point name
+    _In_ LPCWSTR pTargetProfile,                  // Shader profile to compile
+    _In_count_(argCount) LPCWSTR *pArguments,     // Array of pointers to arguments
+    _In_ UINT32 argCount,                         // Number of arguments
+    _In_count_(permutationCount) const DxcDefine *const *ppDefineSets, // Array of define arrays, one per permutation
+    _In_count_(permutationCount) const UINT32 *pDefineCounts, // Number of defines in each define array
+    _In_ UINT32 permutationCount,                 // Number of permutations
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler, // user-provided interface to handle #include directives (optional)
+    _Out_writes_(permutationCount) IDxcOperationResult **ppResults, // Compiler output status, buffer, and errors per permutation
+    _Out_writes_opt_(permutationCount) UINT32 *pCollapsedInto // Index of the permutation each result was shared with
+  ) override {
+    if (pSource == nullptr || pEntryPoint == nullptr ||
+        pTargetProfile == nullptr || ppResults == nullptr ||
+        (permutationCount > 0 &&
+         (ppDefineSets == nullptr || pDefineCounts == nullptr)) ||
+        (argCount > 0 && pArguments == nullptr))
+      return E_INVALIDARG;
+    for (UINT32 i = 0; i < permutationCount; ++i) {
+      if (pDefineCounts[i] > 0 && ppDefineSets[i] == nullptr)
+        return E_INVALIDARG;
+      ppResults[i] = nullptr;
+      if (pCollapsedInto)
+        pCollapsedInto[i] = i;
+    }
+
+    HRESULT hr = S_OK;
+    DxcThreadMalloc TM(m_pMalloc);
+    try {
+      // Conditional blocks are resolved by the preprocessor, so nothing past
+      // include loading is define-independent; share that, and collapse
+      // permutations that produce the same container afterwards.
+      CComPtr<DxcMemoizingIncludeHandler> pSharedIncludes;
+      if (pIncludeHandler != nullptr) {
+        pSharedIncludes = DxcMemoizingIncludeHandler::Alloc(m_pMalloc);
+        IFTOOM(pSharedIncludes.p);
+        pSharedIncludes->SetInner(pIncludeHandler);
+      }
+
+      std::unordered_map<std::string, UINT32> outputsByDigest;
+      for (UINT32 i = 0; i < permutationCount; ++i) {
+        IFT(Compile(pSource, pSourceName, pEntryPoint, pTargetProfile,
+                    pArguments, argCount, ppDefineSets[i], pDefineCounts[i],
+                    pSharedIncludes, &ppResults[i]));
+
+        HRESULT status;
+        IFT(ppResults[i]->GetStatus(&status));
+        if (FAILED(status))
+          continue;
+        CComPtr<IDxcBlob> pOutput;
+        IFT(ppResults[i]->GetResult(&pOutput));
+        if (pOutput == nullptr)
+          continue;
+
+        llvm::MD5 hasher;
+        hasher.update(llvm::ArrayRef<uint8_t>(
+            (const uint8_t *)pOutput->GetBufferPointer(),
+            pOutput->GetBufferSize()));
+        llvm::MD5::MD5Result digest;
+        hasher.final(digest);
+        std::string key((const char *)digest, sizeof(digest));
+
+        auto inserted = outputsByDigest.emplace(key, i);
+        if (inserted.second)
+          continue;
+        UINT32 first = inserted.first->second;
+        CComPtr<IDxcBlob> pFirstOutput;
+        IFT(ppResults[first]->GetResult(&pFirstOutput));
+        if (pFirstOutput->GetBufferSize() != pOutput->GetBufferSize() ||
+            0 != memcmp(pFirstOutput->GetBufferPointer(),
+                        pOutput->GetBufferPointer(), pOutput->GetBufferSize()))
+          continue;
+
+        // Hand back the first result, warnings included, for every duplicate.
+        ppResults[i]->Release();
+        ppResults[i] = ppResults[first];
+        ppResults[i]->AddRef();
+        if (pCollapsedInto)
+          pCollapsedInto[i] = first;
+      }
+    }
+    CATCH_CPP_ASSIGN_HRESULT();
+
+    if (FAILED(hr)) {
+      for (UINT32 i = 0; i < permutationCount; ++i) {
+        if (ppResults[i] != nullptr) {
+          ppResults[i]->Release();
+          ppResults[i] = nullptr;
+        }
+      }
+    }
+    return hr;
+  }
+
+  // Writes a make rule with the given prerequisites, escaping the characters
+  // make would otherwise interpret.
+  static void WriteDependencyRule(raw_ostream &OS, StringRef Target,
+                                  const std::vector<std::wstring> &Files) {
+    auto writeName = [&OS](StringRef Name) {
+      for (char c : Name) {
+        if (c == ' ' || c == '#')
+          OS << '\\';
+        else if (c == '$')
+          OS << '$';
+        OS << c;
+      }
+    };
+    writeName(Target);
+    OS << ':';
+    for (const std::wstring &file : Files) {
+      OS << " \\\n  ";
+      writeName(Unicode::UTF16ToUTF8StringOrThrow(file.c_str()));
+    }
+    OS << '\n';
+  }
+
   // Preprocess source text
   HRESULT STDMETHODCALLTYPE Preprocess(
     _In_ IDxcBlob *pSource,                       // Source text to preprocess
@@ -685,16 +2270,13 @@ public:
 
       IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
 
-      int argCountInt;
-      IFT(UIntToInt(argCount, &argCountInt));
-      hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
-      hlsl::options::DxcOpts opts;
-      bool finished;
-      dxcutil::ReadOptsAndValidate(mainArgs, opts, pOutputStream, ppResult, finished);
-      if (finished) {
+      std::shared_ptr<DxcParsedOptions> pParsedOptions =
+          ReadOptions(nullptr, pArguments, argCount, pOutputStream, ppResult);
+      if (!pParsedOptions) {
         hr = S_OK;
         goto Cleanup;
       }
+      hlsl::options::DxcOpts &opts = pParsedOptions->Opts;
 
       // Prepare UTF8-encoded versions of API values.
       CW2A utf8SourceName(pSourceName, CP_UTF8);
@@ -720,16 +2302,48 @@ public:
       std::vector<std::string> defines;
       CreateDefineStrings(pDefines, defineCount, defines);
 
+      // A dependency scan comes from Compile with the -D arguments still in
+      // the options.
+      if (opts.ScanDependencies)
+        CreateDefineStrings(opts.Defines.data(), opts.Defines.size(), defines);
+
       // Setup a compiler instance.
       std::string warnings;
       raw_string_ostream w(warnings);
       raw_stream_ostream outStream(pOutputStream.p);
+      DxcWarmTargetLease warmTarget(m_warmTargets, m_pMalloc);
       CompilerInstance compiler;
       std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
           llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
-      SetupCompilerForCompile(compiler, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
+      SetupCompilerForCompile(compiler, warmTarget, &m_langExtensionsHelper, utf8SourceName, diagPrinter.get(), defines, opts, pArguments, argCount);
       msfPtr->SetupForCompilerInstance(compiler);
 
+      if (opts.ScanDependencies) {
+        // Only run the preprocessor, then list what the file system handed
+        // out, so the rule names files exactly as the include handler saw
+        // them.
+        FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
+        clang::PreprocessOnlyAction action;
+        if (action.BeginSourceFile(compiler, file)) {
+          action.Execute();
+          action.EndSourceFile();
+        }
+        if (!compiler.getDiagnostics().hasErrorOccurred()) {
+          std::vector<std::wstring> files;
+          msfPtr->GetOpenedFileNames(files);
+          WriteDependencyRule(outStream, opts.DependencyTarget.empty()
+                                             ? StringRef(pUtf8SourceName)
+                                             : opts.DependencyTarget,
+                              files);
+        }
+        outStream.flush();
+        msfPtr->WriteStdErrToStream(w);
+        CreateOperationResultFromOutputs(pOutputStream, msfPtr, warnings,
+                                         compiler.getDiagnostics(), ppResult);
+        hr = S_OK;
+        goto Cleanup;
+      }
+
       // The clang entry point (cc1_main) would now create a compiler invocation
       // from arguments, but for this path we're exclusively trying to preproces
       // to text.
@@ -751,6 +2365,7 @@ public:
       FrontendInputFile file(utf8SourceName.m_psz, IK_HLSL);
       clang::PrintPreprocessedAction action;
       if (action.BeginSourceFile(compiler, file)) {
+        llvm::PhaseTimingRegion PreprocessPhase("preprocess");
         action.Execute();
         action.EndSourceFile();
       }
@@ -792,13 +2407,19 @@ public:
       ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
       IFTLLVM(pts.error_code());
 
-      std::string StreamStr;
-      raw_string_ostream Stream(StreamStr);
-
-      IFC(dxcutil::Disassemble(pProgram, Stream));
+      // The text goes straight into the stream that backs the result blob,
+      // through a buffer, rather than into a string that is then copied;
+      // with large libraries the copy alone can be gigabytes.
+      CComPtr<AbstractMemoryStream> pOutputStream;
+      IFT(CreateMemoryStream(m_pMalloc, &pOutputStream));
+      {
+        raw_stream_ostream Stream(pOutputStream);
+        IFC(dxcutil::Disassemble(pProgram, Stream));
+      }
 
-      IFT(DxcCreateBlobWithEncodingOnHeapCopy(
-          StreamStr.c_str(), StreamStr.size(), CP_UTF8, ppDisassembly));
+      CComPtr<IDxcBlob> pOutputBlob;
+      IFT(pOutputStream.QueryInterface(&pOutputBlob));
+      IFT(DxcCreateBlobWithEncodingSet(pOutputBlob, CP_UTF8, ppDisassembly));
 
       return S_OK;
     }
@@ -808,7 +2429,485 @@ public:
     return hr;
   }
 
+  // Compiles a library in opts.LibShards shards, in parallel, and links them
+  // into the result. Returns false without a result when the compile can't be
+  // sharded, in which case the library is compiled in one piece.
+  bool CompileLibraryShards(
+    const hlsl::options::DxcOpts &opts, _In_ IDxcBlob *pSource,
+    _In_ LPCWSTR pSourceName, _In_ LPCWSTR pEntryPoint,
+    _In_ LPCWSTR pTargetProfile,
+    _In_count_(argCount) LPCWSTR *pArguments, _In_ UINT32 argCount,
+    _In_count_(defineCount) const DxcDefine *pDefines, _In_ UINT32 defineCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    _COM_Outptr_ IDxcOperationResult **ppResult) {
+    // The shard compilers don't see the extensions and handlers registered
+    // on this one.
+    if (!m_langExtensionsHelper.GetIntrinsicTables().empty() ||
+        m_pDxcContainerEventsHandler != nullptr)
+      return false;
+
+    // Every shard parses the whole source, so includes are resolved once, on
+    // this thread, and the shards compile the preprocessed text.
+    CComPtr<IDxcBlob> pPreprocessed;
+    PreprocessForSharing(pSource, pSourceName, pArguments, argCount, pDefines,
+                         defineCount, pIncludeHandler, pPreprocessed);
+    if (!pPreprocessed)
+      return false;
+
+    const unsigned shardCount = opts.LibShards;
+    std::vector<std::wstring> shardIndexArgs, shardNames;
+    for (unsigned i = 0; i < shardCount; ++i) {
+      shardIndexArgs.push_back(L"-lib-shard-index=" + std::to_wstring(i));
+      shardNames.push_back(L"shard" + std::to_wstring(i));
+    }
+
+    std::vector<HRESULT> shardHRs(shardCount, E_FAIL);
+    std::vector<CComPtr<IDxcOperationResult>> shardResults(shardCount);
+    IMalloc *pMalloc = m_pMalloc;
+    auto compileShard = [&](unsigned i) {
+      DxcThreadMalloc TM(pMalloc);
+      HRESULT hr = S_OK;
+      try {
+        CComPtr<IDxcCompiler> pCompiler;
+        IFT(CreateDxcCompiler(__uuidof(IDxcCompiler), (void **)&pCompiler));
+        std::vector<LPCWSTR> arguments(pArguments, pArguments + argCount);
+        arguments.push_back(shardIndexArgs[i].c_str());
+        hr = pCompiler->Compile(pPreprocessed, pSourceName, pEntryPoint,
+                                pTargetProfile, arguments.data(),
+                                (UINT32)arguments.size(), pDefines,
+                                defineCount, nullptr, &shardResults[i]);
+      }
+      CATCH_CPP_ASSIGN_HRESULT();
+      shardHRs[i] = hr;
+    };
+
+    std::vector<std::thread> workers;
+    try {
+      for (unsigned i = 0; i < shardCount; ++i)
+        workers.emplace_back(compileShard, i);
+    } catch (...) {
+      for (std::thread &worker : workers)
+        worker.join();
+      throw;
+    }
+    for (std::thread &worker : workers)
+      worker.join();
+
+    for (unsigned i = 0; i < shardCount; ++i) {
+      IFT(shardHRs[i]);
+      HRESULT status;
+      IFT(shardResults[i]->GetStatus(&status));
+      if (FAILED(status)) {
+        *ppResult = shardResults[i].Detach();
+        return true;
+      }
+    }
+
+    CComPtr<IDxcLinker> pLinker;
+    IFT(CreateDxcLinker(__uuidof(IDxcLinker), (void **)&pLinker));
+    std::vector<LPCWSTR> libNames;
+    for (unsigned i = 0; i < shardCount; ++i) {
+      CComPtr<IDxcBlob> pShard;
+      IFT(shardResults[i]->GetResult(&pShard));
+      IFT(pLinker->RegisterLibrary(shardNames[i].c_str(), pShard));
+      libNames.push_back(shardNames[i].c_str());
+    }
+    CComPtr<IDxcOperationResult> pLinkResult;
+    IFT(pLinker->Link(pEntryPoint, pTargetProfile, libNames.data(),
+                      shardCount, pArguments, argCount, &pLinkResult));
+
+    // Every shard runs the same front end, so each front end warning comes
+    // back once per shard, while later warnings come only from the shard
+    // that compiled the function. Report each distinct one once, in shard
+    // order, followed by the linker's own.
+    HRESULT status;
+    IFT(pLinkResult->GetStatus(&status));
+    if (FAILED(status)) {
+      *ppResult = pLinkResult.Detach();
+      return true;
+    }
+    std::string warnings;
+    std::unordered_set<std::string> seenWarnings;
+    for (unsigned i = 0; i < shardCount; ++i)
+      AppendUniqueDiagnostics(shardResults[i], warnings, seenWarnings);
+    AppendUniqueDiagnostics(pLinkResult, warnings, seenWarnings);
+    CComPtr<IDxcBlob> pLinked;
+    IFT(pLinkResult->GetResult(&pLinked));
+    CComPtr<IDxcBlobEncoding> pWarnings;
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(warnings.data(),
+                                            (UINT32)warnings.size(), CP_UTF8,
+                                            &pWarnings));
+    IFT(DxcOperationResult::CreateFromResultErrorStatus(pLinked, pWarnings,
+                                                        status, ppResult));
+    return true;
+  }
+
+  // Appends the diagnostics in pResult's error buffer that aren't in seen
+  // yet. A diagnostic runs from its warning or error line up to the next
+  // one, so the source lines and notes under it stay with it.
+  static void AppendUniqueDiagnostics(IDxcOperationResult *pResult,
+                                      std::string &text,
+                                      std::unordered_set<std::string> &seen) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    if (pErrors == nullptr || pErrors->GetBufferSize() == 0)
+      return;
+    StringRef remaining((const char *)pErrors->GetBufferPointer(),
+                        pErrors->GetBufferSize());
+    if (remaining.back() == '\0')
+      remaining = remaining.drop_back();
+
+    auto startsDiagnostic = [](StringRef line) {
+      return line.startswith("warning: ") || line.startswith("error: ") ||
+             line.find(": warning: ") != StringRef::npos ||
+             line.find(": error: ") != StringRef::npos;
+    };
+    std::string diagnostic;
+    auto flush = [&]() {
+      if (!diagnostic.empty() && seen.insert(diagnostic).second)
+        text += diagnostic;
+      diagnostic.clear();
+    };
+    while (!remaining.empty()) {
+      size_t end = remaining.find('\n');
+      end = end == StringRef::npos ? remaining.size() : end + 1;
+      StringRef line = remaining.substr(0, end);
+      remaining = remaining.substr(end);
+      if (startsDiagnostic(line))
+        flush();
+      diagnostic += line;
+    }
+    flush();
+  }
+
+#ifdef ENABLE_SPIRV_CODEGEN
+  // Since SpirvOptions is passed to the SPIR-V CodeGen as a whole structure,
+  // we need to copy a few non-spirv-specific options into the structure.
+  // The options may be shared with other compiles with the same arguments,
+  // so the structure is filled in on a copy.
+  void SetupSpirvCodeGenOptions(CompilerInstance &compiler,
+                                const hlsl::options::DxcOpts &opts,
+                                const hlsl::options::MainArgs &mainArgs) {
+    clang::spirv::SpirvCodeGenOptions spirvOpts = opts.SpirvOptions;
+    spirvOpts.enable16BitTypes = opts.Enable16BitTypes;
+    spirvOpts.codeGenHighLevel = opts.CodeGenHighLevel;
+    spirvOpts.defaultRowMajor = opts.DefaultRowMajor;
+    spirvOpts.disableValidation = opts.DisableValidation;
+    // Store a string representation of command line options.
+    if (opts.DebugInfo)
+      for (auto opt : mainArgs.getArrayRef())
+        spirvOpts.clOptions += " " + std::string(opt);
+
+    compiler.getCodeGenOpts().SpirvOptions = spirvOpts;
+  }
+#endif // ENABLE_SPIRV_CODEGEN
+
+  // Gives back the source stripped for the entry point, from the cache when
+  // an earlier compile stripped the same source, or false if it can't be
+  // stripped. pPreprocessed is the preprocessed source, if already at hand.
+  bool StripUnusedSource(hlsl::options::DxcOpts &opts, _In_ IDxcBlob *pSource,
+                         _In_ LPCWSTR pSourceName, _In_ LPCWSTR pEntryPoint,
+                         _In_count_(argCount) LPCWSTR *pArguments,
+                         _In_ UINT32 argCount,
+                         _In_count_(defineCount) const DxcDefine *pDefines,
+                         _In_ UINT32 defineCount,
+                         _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+                         _In_opt_ IDxcBlob *pPreprocessed,
+                         _COM_Outptr_ IDxcBlobEncoding **ppStripped) {
+    *ppStripped = nullptr;
+    CComPtr<IDxcBlob> pPreprocessedSource(pPreprocessed);
+    if (!pPreprocessedSource) {
+      CComPtr<IDxcOperationResult> pPreprocessResult;
+      IFT(Preprocess(pSource, pSourceName, pArguments, argCount, pDefines,
+                     defineCount, pIncludeHandler, &pPreprocessResult));
+      HRESULT preprocessStatus;
+      IFT(pPreprocessResult->GetStatus(&preprocessStatus));
+      if (FAILED(preprocessStatus))
+        return false;
+      IFT(pPreprocessResult->GetResult(&pPreprocessedSource));
+    }
+
+    CW2A utf8EntryPoint(pEntryPoint, CP_UTF8);
+    std::string key = DxcStrippedSourceCache::GetKey(
+        opts, pPreprocessedSource, utf8EntryPoint.m_psz);
+    std::string stripped;
+    if (!m_strippedSources.Lookup(key, stripped)) {
+      StringRef preprocessed(
+          (const char *)pPreprocessedSource->GetBufferPointer(),
+          pPreprocessedSource->GetBufferSize());
+      // The preprocessed blob may or may not hold a terminating null.
+      if (!preprocessed.empty() && preprocessed.back() == '\0')
+        preprocessed = preprocessed.drop_back();
+      if (FAILED(DxcRewriteUnusedForEntry(&m_langExtensionsHelper,
+                                          preprocessed, utf8EntryPoint.m_psz,
+                                          opts, stripped)))
+        return false;
+      m_strippedSources.Insert(m_pMalloc, key, stripped);
+    }
+
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(stripped.data(),
+                                            (UINT32)stripped.size(), CP_UTF8,
+                                            ppStripped));
+    return true;
+  }
+
+  // Reads the options for an argument set, or reuses the ones read for an
+  // earlier call with the same arguments. Returns nullptr, with *ppResult
+  // holding the errors, if the arguments don't validate.
+  std::shared_ptr<DxcParsedOptions>
+  ReadOptions(_In_opt_ LPCWSTR pTargetProfile, _In_count_(argCount) LPCWSTR *pArguments,
+              UINT32 argCount, AbstractMemoryStream *pOutputStream,
+              _COM_Outptr_ IDxcOperationResult **ppResult) {
+    std::wstring key =
+        DxcParsedOptionsCache::GetKey(pTargetProfile, pArguments, argCount);
+    std::shared_ptr<DxcParsedOptions> pParsed = m_parsedOptions.Lookup(key);
+    if (pParsed) {
+      if (!pParsed->Warnings.empty()) {
+        ULONG cbWritten;
+        IFT(pOutputStream->Write(pParsed->Warnings.data(),
+                                 (ULONG)pParsed->Warnings.size(), &cbWritten));
+      }
+      return pParsed;
+    }
+
+    int argCountInt;
+    IFT(UIntToInt(argCount, &argCountInt));
+    pParsed = std::make_shared<DxcParsedOptions>();
+    pParsed->Args = hlsl::options::MainArgs(argCountInt, pArguments, 0);
+    // Set target profile before reading options and validate
+    if (pTargetProfile) {
+      pParsed->TargetProfile = CW2A(pTargetProfile, CP_UTF8).m_psz;
+      pParsed->Opts.TargetProfile = pParsed->TargetProfile;
+    }
+    bool finished = false;
+    ULONG outputStart = pOutputStream->GetPtrSize();
+    dxcutil::ReadOptsAndValidate(pParsed->Args, pParsed->Opts, pOutputStream,
+                                 ppResult, finished);
+    if (finished)
+      return nullptr;
+    pParsed->Warnings.assign(
+        (const char *)pOutputStream->GetPtr() + outputStart,
+        pOutputStream->GetPtrSize() - outputStart);
+    m_parsedOptions.Insert(m_pMalloc, key, pParsed);
+    return pParsed;
+  }
+
+  // Only compiles that produce a final container are served from the cache;
+  // a registered container event handler may rewrite the output, so its
+  // results are never stored.
+  bool IsCacheableCompile(hlsl::options::DxcOpts &opts) {
+    if (opts.CodeGenHighLevel || opts.AstDump || opts.OptDump ||
+        opts.IsRootSignatureProfile() || m_pDxcContainerEventsHandler != nullptr)
+      return false;
+    // A cached result would have no timings or pressure report, and
+    // wouldn't write the streamed debug info.
+    if (opts.TimeReport || !opts.OutputPressureReport.empty() ||
+        !opts.StreamDebugFile.empty())
+      return false;
+    // The key doesn't cover the profile, which changes with every capture.
+    if (!opts.ProfileUse.empty())
+      return false;
+    // Nor the language extensions; intrinsic tables and semantic define
+    // validators are objects whose behaviour can't be hashed.
+    if (m_langExtensionsHelper.HasRegistrations())
+      return false;
+#ifdef ENABLE_SPIRV_CODEGEN
+    if (opts.GenSPIRV || !opts.OutputSpirvFile.empty())
+      return false;
+#endif
+    return true;
+  }
+
+  // Preprocesses pSource into text that every target of a CompileMany call
+  // can be compiled from as if it were the original source. Leaves
+  // pPreprocessed empty when the options depend on macros or source files
+  // surviving preprocessing, or when preprocessing reported anything, in
+  // which case each target is compiled from the original source instead.
+  void PreprocessForSharing(
+    _In_ IDxcBlob *pSource, _In_opt_ LPCWSTR pSourceName,
+    _In_count_(argCount) LPCWSTR *pArguments, _In_ UINT32 argCount,
+    _In_count_(defineCount) const DxcDefine *pDefines, _In_ UINT32 defineCount,
+    _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    CComPtr<IDxcBlob> &pPreprocessed) {
+    int argCountInt;
+    IFT(UIntToInt(argCount, &argCountInt));
+    hlsl::options::MainArgs mainArgs(argCountInt, pArguments, 0);
+    hlsl::options::DxcOpts opts;
+    std::string errors;
+    raw_string_ostream errorStream(errors);
+    if (0 != hlsl::options::ReadDxcOpts(::options::getHlslOptTable(),
+                                        hlsl::options::CompilerFlags,
+                                        mainArgs, opts, errorStream))
+      return;
+
+    if (!CanCompilePreprocessed(opts))
+      return;
+
+    CComPtr<IDxcOperationResult> pResult;
+    PreprocessWithOptions(opts, pSource, pSourceName, pArguments, argCount,
+                          pDefines, defineCount, pIncludeHandler, pResult);
+    if (!IsCleanPreprocess(pResult))
+      return;
+    IFT(pResult->GetResult(&pPreprocessed));
+  }
+
+  // Whether a compile with these options can run on its preprocessed source
+  // as if it were the original. Debug info records the original files, the
+  // root signature define and semantic defines are looked up as macros after
+  // preprocessing, and dumps and high-level output are not compiled at all.
+  bool CanCompilePreprocessed(const hlsl::options::DxcOpts &opts) {
+    if (opts.DebugInfo || !opts.RootSignatureDefine.empty() ||
+        !m_langExtensionsHelper.GetSemanticDefines().empty() ||
+        opts.AstDump || opts.CodeGenHighLevel || !opts.Preprocess.empty())
+      return false;
+#ifdef ENABLE_SPIRV_CODEGEN
+    if (opts.GenSPIRV)
+      return false;
+#endif
+    return true;
+  }
+
+  // Preprocesses pSource the way a compile with opts sees it; Preprocess
+  // does not pick up -D arguments on its own.
+  void PreprocessWithOptions(
+    const hlsl::options::DxcOpts &opts, _In_ IDxcBlob *pSource,
+    _In_opt_ LPCWSTR pSourceName, _In_count_(argCount) LPCWSTR *pArguments,
+    _In_ UINT32 argCount, _In_count_(defineCount) const DxcDefine *pDefines,
+    _In_ UINT32 defineCount, _In_opt_ IDxcIncludeHandler *pIncludeHandler,
+    CComPtr<IDxcOperationResult> &pResult) {
+    std::vector<DxcDefine> defines(pDefines, pDefines + defineCount);
+    defines.insert(defines.end(), opts.Defines.data(),
+                   opts.Defines.data() + opts.Defines.size());
+    IFT(Preprocess(pSource, pSourceName, pArguments, argCount,
+                   defines.data(), (UINT32)defines.size(), pIncludeHandler,
+                   &pResult));
+  }
+
+  // Whether preprocessing succeeded without reporting anything, so that
+  // compiling its output won't lose a diagnostic.
+  static bool IsCleanPreprocess(IDxcOperationResult *pResult) {
+    HRESULT status;
+    IFT(pResult->GetStatus(&status));
+    if (FAILED(status))
+      return false;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    IFT(pResult->GetErrorBuffer(&pErrors));
+    return pErrors == nullptr || pErrors->GetBufferSize() == 0;
+  }
+
+  // Parses the GPU models given with -Fre-model. Returns false, with
+  // *ppResult holding the error, if one of them doesn't parse.
+  bool ParsePressureReportModels(const hlsl::options::DxcOpts &opts,
+                                 std::vector<hlsl::DxilGpuModel> &models,
+                                 _COM_Outptr_ IDxcOperationResult **ppResult) {
+    models.resize(opts.PressureReportModels.size());
+    for (size_t i = 0; i < models.size(); ++i) {
+      if (hlsl::ParseDxilGpuModel(opts.PressureReportModels[i], models[i]))
+        continue;
+      std::string msg =
+          "/Fre-model expects <name>:<wave size>,<registers per lane>,"
+          "<waves per SIMD>,<SIMDs per unit>,<groupshared bytes>,"
+          "<groups per unit> with numbers above zero, not '" +
+          opts.PressureReportModels[i] + "'";
+      CComPtr<IDxcBlobEncoding> pErrorBlob;
+      IFT(DxcCreateBlobWithEncodingOnHeapCopy(msg.c_str(), msg.size(),
+                                              CP_UTF8, &pErrorBlob));
+      IFT(DxcOperationResult::CreateFromResultErrorStatus(
+          nullptr, pErrorBlob, E_INVALIDARG, ppResult));
+      return false;
+    }
+    return true;
+  }
+
+  // Checks that each -pass-option names a registered pass; otherwise the
+  // override would match nothing and be ignored. Returns false, with
+  // *ppResult holding the error, for the first unknown pass.
+  bool CheckPassOptionNames(const hlsl::options::DxcOpts &opts,
+                            _COM_Outptr_ IDxcOperationResult **ppResult) {
+    const PassRegistry *Registry = PassRegistry::getPassRegistry();
+    for (const std::string &PassOption : opts.PassOptions) {
+      StringRef Pass = StringRef(PassOption).split(',').first;
+      if (Registry->getPassInfo(Pass) != nullptr)
+        continue;
+      std::string msg = "/pass-option names unknown pass '" + Pass.str() + "'";
+      CComPtr<IDxcBlobEncoding> pErrorBlob;
+      IFT(DxcCreateBlobWithEncodingOnHeapCopy(msg.c_str(), msg.size(),
+                                              CP_UTF8, &pErrorBlob));
+      IFT(DxcOperationResult::CreateFromResultErrorStatus(
+          nullptr, pErrorBlob, E_INVALIDARG, ppResult));
+      return false;
+    }
+    return true;
+  }
+
+  // Fails a compile that ran out of its -max-memory budget with a diagnostic
+  // rather than just an HRESULT. Everything the compile allocated has been
+  // released by now, so there is room to build the result.
+  HRESULT CreateMemoryBudgetResult(const DxcCompileMemoryTracker &memory,
+                                   _COM_Outptr_ IDxcOperationResult **ppResult) {
+    try {
+      DxcThreadMalloc TMResult(m_pMalloc);
+      std::string msg;
+      raw_string_ostream OS(msg);
+      OS << "error: compilation exceeded the memory budget of "
+         << memory.GetBudgetMB() << " MB set by -max-memory\n";
+      OS.flush();
+      CComPtr<IDxcBlobEncoding> pErrorBlob;
+      IFT(DxcCreateBlobWithEncodingOnHeapCopy(msg.c_str(), msg.size(),
+                                              CP_UTF8, &pErrorBlob));
+      IFT(DxcOperationResult::CreateFromResultErrorStatus(
+          nullptr, pErrorBlob, E_OUTOFMEMORY, ppResult));
+      memory.AttachTo(*ppResult);
+      return S_OK;
+    }
+    CATCH_CPP_RETURN_HRESULT();
+  }
+
+  // Profiles for -fprofile-use are sample profiles in LLVM's text format,
+  // whose first line names the shader they were collected from:
+  //   # shader-hash: <MD5 of the main source, entry point and target>
+  // A profile of another shader, or of an older version of its source, would
+  // weight the wrong branches, so it is rejected.
+  void SetupProfileUse(CompilerInstance &compiler, _In_ LPCSTR pMainFile,
+                       _In_ hlsl::options::DxcOpts &Opts) {
+    DiagnosticsEngine &Diags = compiler.getDiagnostics();
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> profile =
+        llvm::MemoryBuffer::getFile(Opts.ProfileUse);
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> source =
+        llvm::MemoryBuffer::getFile(pMainFile);
+    if (!profile || !source) {
+      Diags.Report(Diags.getCustomDiagID(DiagnosticsEngine::Error,
+                                         "cannot read profile '%0'"))
+          << Opts.ProfileUse;
+      return;
+    }
+
+    llvm::MD5 hasher;
+    hasher.update((*source)->getBuffer());
+    hasher.update(llvm::ArrayRef<uint8_t>((const uint8_t *)"", 1));
+    hasher.update(Opts.EntryPoint);
+    hasher.update(llvm::ArrayRef<uint8_t>((const uint8_t *)"", 1));
+    hasher.update(Opts.TargetProfile);
+    llvm::MD5::MD5Result digest;
+    hasher.final(digest);
+    SmallString<32> shaderHash;
+    llvm::MD5::stringifyResult(digest, shaderHash);
+
+    StringRef header = (*profile)->getBuffer().split('\n').first.trim();
+    const StringRef hashPrefix = "# shader-hash:";
+    if (!header.startswith(hashPrefix) ||
+        !header.substr(hashPrefix.size()).trim().equals_lower(shaderHash)) {
+      Diags.Report(Diags.getCustomDiagID(
+          DiagnosticsEngine::Error,
+          "profile '%0' was not collected from this shader (shader-hash %1)"))
+          << Opts.ProfileUse << shaderHash.str();
+      return;
+    }
+    compiler.getCodeGenOpts().SampleProfileFile = Opts.ProfileUse;
+  }
+
   void SetupCompilerForCompile(CompilerInstance &compiler,
+                               DxcWarmTargetLease &warmTarget,
                                _In_ DxcLangExtensionsHelper *helper,
                                _In_ LPCSTR pMainFile, _In_ TextDiagnosticPrinter *diagPrinter,
                                _In_ std::vector<std::string>& defines,
@@ -816,11 +2915,6 @@ public:
                                _In_count_(argCount) LPCWSTR *pArguments,
                                _In_ UINT32 argCount) {
     // Setup a compiler instance.
-    std::shared_ptr<TargetOptions> targetOptions(new TargetOptions);
-    targetOptions->Triple = "dxil-ms-dx";
-    targetOptions->DescriptionString = Opts.Enable16BitTypes
-      ? hlsl::DXIL::kNewLayoutString
-      : hlsl::DXIL::kLegacyLayoutString;
     compiler.HlslLangExtensions = helper;
     compiler.createDiagnostics(diagPrinter, false);
     // don't output warning to stderr/file if "/no-warnings" is present.
@@ -828,7 +2922,7 @@ public:
     compiler.createFileManager();
     compiler.createSourceManager(compiler.getFileManager());
     compiler.setTarget(
-        TargetInfo::CreateTargetInfo(compiler.getDiagnostics(), targetOptions));
+        warmTarget.Acquire(compiler.getDiagnostics(), Opts.Enable16BitTypes));
     if (Opts.EnableDX9CompatMode) {
       auto const ID = compiler.getDiagnostics().getCustomDiagID(clang::DiagnosticsEngine::Warning, "/Gec flag is a deprecated functionality.");
       compiler.getDiagnostics().Report(ID);
@@ -838,7 +2932,9 @@ public:
     // Setup debug information.
     if (Opts.DebugInfo) {
       CodeGenOptions &CGOpts = compiler.getCodeGenOpts();
-      CGOpts.setDebugInfo(CodeGenOptions::FullDebugInfo);
+      CGOpts.setDebugInfo(Opts.DebugInfoLinesOnly
+                              ? CodeGenOptions::DebugLineTablesOnly
+                              : CodeGenOptions::FullDebugInfo);
       CGOpts.DebugColumnInfo = 1;
       CGOpts.DwarfVersion = 4; // Latest version.
       // TODO: consider
@@ -924,6 +3020,31 @@ public:
 
     compiler.getCodeGenOpts().HLSLHighLevel = Opts.CodeGenHighLevel;
     compiler.getCodeGenOpts().HLSLResMayAlias = Opts.ResMayAlias;
+    compiler.getCodeGenOpts().HLSLFastIteration = Opts.FastIteration;
+    compiler.getCodeGenOpts().HLSLInferNonUniformIndex = Opts.InferNonUniformIndex;
+    compiler.getCodeGenOpts().HLSLFastTrig = Opts.FastTrig;
+    compiler.getCodeGenOpts().HLSLDemoteOutputPrecision = Opts.DemoteOutputPrecision;
+    compiler.getCodeGenOpts().HLSLAutoControlFlowHints = Opts.AutoControlFlowHints;
+    compiler.getCodeGenOpts().HLSLGroupSharedBankConflicts = Opts.GroupSharedBankConflicts;
+    compiler.getCodeGenOpts().HLSLPadGroupShared = Opts.PadGroupShared;
+    compiler.getCodeGenOpts().HLSLInferEarlyDepthStencil = Opts.InferEarlyDepthStencil;
+    compiler.getCodeGenOpts().HLSLWarnEarlyDepthStencil = Opts.WarnEarlyDepthStencil;
+    compiler.getCodeGenOpts().HLSLReorderCBuffers = Opts.ReorderCBuffers;
+    compiler.getCodeGenOpts().HLSLRecommendRootConstants = Opts.RecommendRootConstants;
+    compiler.getCodeGenOpts().HLSLMergeIdenticalFunctions = Opts.MergeIdenticalFunctions;
+    compiler.getCodeGenOpts().HLSLPositionOnly = Opts.PositionOnly;
+    compiler.getCodeGenOpts().HLSLEliminateRedundantBarriers = Opts.EliminateRedundantBarriers;
+    compiler.getCodeGenOpts().HLSLWaveAggregateAtomics = Opts.WaveAggregateAtomics;
+    compiler.getCodeGenOpts().HLSLPair16BitOps = Opts.Pair16BitOps;
+    compiler.getCodeGenOpts().HLSLClusterFetches = Opts.ClusterFetches;
+    compiler.getCodeGenOpts().HLSLStrengthReduceBufferIndices = Opts.StrengthReduceBufferIndices;
+    compiler.getCodeGenOpts().HLSLUnswitchUniformLoops = Opts.UnswitchUniformLoops;
+    compiler.getCodeGenOpts().HLSLGatherTexelLoads = Opts.GatherTexelLoads;
+    compiler.getCodeGenOpts().HLSLLibNoInlineSize = Opts.LibNoInlineSize;
+    compiler.getCodeGenOpts().HLSLPassOptions = Opts.PassOptions;
+    compiler.getCodeGenOpts().HLSLSourceStoreDir = Opts.SourceStoreDir;
+    if (!Opts.ProfileUse.empty())
+      SetupProfileUse(compiler, pMainFile, Opts);
     compiler.getCodeGenOpts().HLSLAllResourcesBound = Opts.AllResourcesBound;
     compiler.getCodeGenOpts().HLSLDefaultRowMajor = Opts.DefaultRowMajor;
     compiler.getCodeGenOpts().HLSLPreferControlFlow = Opts.PreferFlowControl;
@@ -958,7 +3079,9 @@ public:
     compiler.getCodeGenOpts().setInlining(
         clang::CodeGenOptions::OnlyAlwaysInlining);
 
-    compiler.getCodeGenOpts().HLSLExtensionsCodegen = std::make_shared<HLSLExtensionsCodegenHelperImpl>(compiler, m_langExtensionsHelper, Opts.RootSignatureDefine);
+    compiler.getCodeGenOpts().HLSLExtensionsCodegen = std::make_shared<HLSLExtensionsCodegenHelperImpl>(
+        compiler, m_langExtensionsHelper, Opts.RootSignatureDefine,
+        Opts.TargetProfile, m_sharedSemanticDefines.GetForThisThread());
 
     // AutoBindingSpace also enables automatic binding for libraries if set. UINT_MAX == unset
     compiler.getCodeGenOpts().HLSLDefaultSpace = Opts.AutoBindingSpace;
@@ -966,6 +3089,9 @@ public:
     // processed export names from -exports option:
     compiler.getCodeGenOpts().HLSLLibraryExports = Opts.Exports;
 
+    // static consts bound late with hl-bind-constants
+    compiler.getCodeGenOpts().HLSLLateBindConsts = Opts.LateBindConsts;
+
     // only export shader functions for library
     compiler.getCodeGenOpts().ExportShadersOnly = Opts.ExportShadersOnly;
 
@@ -976,6 +3102,27 @@ public:
     } else if (Opts.DefaultLinkage.equals_lower("external")) {
       compiler.getCodeGenOpts().DefaultLinkage = DXIL::DefaultLinkage::External;
     }
+
+    if (Opts.LibShardIndex != UINT_MAX) {
+      compiler.getLangOpts().HLSLLibraryShardCount = Opts.LibShards;
+      compiler.getLangOpts().HLSLLibraryShardIndex = Opts.LibShardIndex;
+    }
+
+    // Mirrors how CodeGen assigns linkage to library functions that aren't
+    // exported; offline libraries keep them external.
+    const ShaderModel *SM = ShaderModel::GetByName(Opts.TargetProfile.str().c_str());
+    switch (compiler.getCodeGenOpts().DefaultLinkage) {
+    case DXIL::DefaultLinkage::Default:
+      compiler.getLangOpts().HLSLDefaultLinkageInternal =
+          SM->IsValid() && SM->GetMinor() != ShaderModel::kOfflineMinor;
+      break;
+    case DXIL::DefaultLinkage::Internal:
+      compiler.getLangOpts().HLSLDefaultLinkageInternal = true;
+      break;
+    case DXIL::DefaultLinkage::External:
+      compiler.getLangOpts().HLSLDefaultLinkageInternal = false;
+      break;
+    }
   }
 
   // IDxcVersionInfo
@@ -0,0 +1,308 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxcshaderarchive.cpp                                                      //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Implements the shader archive builder and reader.                         //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+#include "dxc/Support/WinIncludes.h"
+#include "dxc/dxcapi.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilShaderArchive.h"
+#include "dxc/Support/Global.h"
+#include "dxc/Support/ErrorCodes.h"
+#include "dxc/Support/FileIOHelper.h"
+#include "dxc/Support/microcom.h"
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace hlsl;
+
+namespace {
+struct KeyLess {
+  bool operator()(const DxilContainerHash &L,
+                  const DxilContainerHash &R) const {
+    return memcmp(L.Digest, R.Digest, DxilContainerHashSize) < 0;
+  }
+};
+}
+
+class DxcShaderArchiveBuilder : public IDxcShaderArchiveBuilder {
+public:
+  HRESULT STDMETHODCALLTYPE AddContainer(_In_ IDxcBlob *pContainer) override;
+  HRESULT STDMETHODCALLTYPE SerializeArchive(_COM_Outptr_ IDxcBlob **ppResult) override;
+
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcShaderArchiveBuilder)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcShaderArchiveBuilder>(this, riid, ppvObject);
+  }
+
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  // Containers by key, in the order of the archive index.
+  std::map<DxilContainerHash, CComPtr<IDxcBlob>, KeyLess> m_containers;
+};
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchiveBuilder::AddContainer(_In_ IDxcBlob *pContainer) {
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    IFTBOOL(pContainer != nullptr, E_INVALIDARG);
+    const DxilContainerHeader *pHeader = IsDxilContainerLike(
+        pContainer->GetBufferPointer(), pContainer->GetBufferSize());
+    IFTBOOL(IsValidDxilContainer(pHeader, pContainer->GetBufferSize()),
+            DXC_E_CONTAINER_INVALID);
+    // Containers are rebuilt from their parts, which only gives back the
+    // same bytes if the parts follow each other.
+    IFTBOOL(HasContiguousDxilParts(pHeader), E_INVALIDARG);
+
+    DxilContainerHash key;
+    GetDxilShaderArchiveKey(pHeader, &key);
+    auto it = m_containers.find(key);
+    if (it != m_containers.end()) {
+      const DxilContainerHeader *pExisting =
+          (const DxilContainerHeader *)it->second->GetBufferPointer();
+      IFTBOOL(pExisting->ContainerSizeInBytes == pHeader->ContainerSizeInBytes &&
+                  0 == memcmp(pExisting, pHeader, pHeader->ContainerSizeInBytes),
+              E_INVALIDARG);
+      return S_OK;
+    }
+    m_containers[key] = pContainer;
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchiveBuilder::SerializeArchive(_COM_Outptr_ IDxcBlob **ppResult) {
+  if (ppResult == nullptr)
+    return E_POINTER;
+  *ppResult = nullptr;
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    // Store each distinct part once. Parts are found by a hash of their
+    // contents, and compared in full when the hashes match.
+    std::vector<DxilShaderArchivePart> parts;
+    std::vector<const char *> partData;
+    std::vector<uint32_t> partRefs;
+    std::vector<DxilShaderArchiveEntry> entries;
+    std::unordered_multimap<size_t, uint32_t> partsByHash;
+    for (auto &KV : m_containers) {
+      const DxilContainerHeader *pHeader =
+          (const DxilContainerHeader *)KV.second->GetBufferPointer();
+      DxilShaderArchiveEntry entry;
+      entry.Key = KV.first;
+      entry.Header = *pHeader;
+      entry.FirstPartRef = (uint32_t)partRefs.size();
+      entries.emplace_back(entry);
+
+      for (DxilPartIterator it = begin(pHeader), itEnd = end(pHeader); it != itEnd; ++it) {
+        const DxilPartHeader *pPartHeader = *it;
+        const char *pData = GetDxilPartData(pPartHeader);
+        size_t hash = llvm::hash_combine(
+            pPartHeader->PartFourCC,
+            llvm::hash_value(llvm::StringRef(pData, pPartHeader->PartSize)));
+        uint32_t partIndex = (uint32_t)parts.size();
+        auto range = partsByHash.equal_range(hash);
+        for (auto match = range.first; match != range.second; ++match) {
+          const DxilShaderArchivePart &part = parts[match->second];
+          if (part.PartFourCC == pPartHeader->PartFourCC &&
+              part.PartSize == pPartHeader->PartSize &&
+              0 == memcmp(partData[match->second], pData, part.PartSize)) {
+            partIndex = match->second;
+            break;
+          }
+        }
+        if (partIndex == parts.size()) {
+          DxilShaderArchivePart part;
+          part.PartFourCC = pPartHeader->PartFourCC;
+          part.PartSize = pPartHeader->PartSize;
+          part.DataOffset = 0;
+          parts.emplace_back(part);
+          partData.emplace_back(pData);
+          partsByHash.emplace(hash, partIndex);
+        }
+        partRefs.emplace_back(partIndex);
+      }
+    }
+
+    // Lay out the part data after the tables.
+    uint64_t offset =
+        sizeof(DxilShaderArchiveHeader) +
+        sizeof(DxilShaderArchiveEntry) * (uint64_t)entries.size() +
+        sizeof(DxilShaderArchivePart) * (uint64_t)parts.size() +
+        sizeof(uint32_t) * (uint64_t)partRefs.size();
+    for (DxilShaderArchivePart &part : parts) {
+      offset = (offset + 3) & ~(uint64_t)3;
+      part.DataOffset = (uint32_t)offset;
+      offset += part.PartSize;
+    }
+    IFTBOOL(offset <= UINT32_MAX, DXC_E_DATA_TOO_LARGE);
+
+    DxilShaderArchiveHeader header;
+    header.HeaderFourCC = DxilShaderArchiveFourCC;
+    header.Version = DxilShaderArchiveVersion;
+    header.ArchiveSizeInBytes = (uint32_t)offset;
+    header.ContainerCount = (uint32_t)entries.size();
+    header.PartCount = (uint32_t)parts.size();
+    header.PartRefCount = (uint32_t)partRefs.size();
+
+    CComPtr<AbstractMemoryStream> pStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pStream));
+    IFT(pStream->Reserve(header.ArchiveSizeInBytes));
+    ULONG cbWritten;
+    IFT(WriteStreamValue(pStream, header));
+    IFT(pStream->Write(entries.data(), sizeof(DxilShaderArchiveEntry) * entries.size(), &cbWritten));
+    IFT(pStream->Write(parts.data(), sizeof(DxilShaderArchivePart) * parts.size(), &cbWritten));
+    IFT(pStream->Write(partRefs.data(), sizeof(uint32_t) * partRefs.size(), &cbWritten));
+    const uint32_t padding = 0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+      IFT(pStream->Write(&padding, parts[i].DataOffset - pStream->GetPtrSize(), &cbWritten));
+      IFT(pStream->Write(partData[i], parts[i].PartSize, &cbWritten));
+    }
+    DXASSERT(pStream->GetPtrSize() == header.ArchiveSizeInBytes,
+             "else archive size is miscalculated");
+    IFT(pStream->QueryInterface(ppResult));
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+class DxcShaderArchive : public IDxcShaderArchive {
+public:
+  HRESULT STDMETHODCALLTYPE Load(_In_ IDxcBlob *pArchive) override;
+  HRESULT STDMETHODCALLTYPE GetContainerCount(_Out_ UINT32 *pResult) override;
+  HRESULT STDMETHODCALLTYPE GetContainerKey(UINT32 idx, _Out_writes_bytes_(16) BYTE *pKey) override;
+  HRESULT STDMETHODCALLTYPE FindContainer(_In_reads_bytes_(16) const BYTE *pKey, _Out_ UINT32 *pResult) override;
+  HRESULT STDMETHODCALLTYPE GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) override;
+  HRESULT STDMETHODCALLTYPE GetPartCount(UINT32 idx, _Out_ UINT32 *pResult) override;
+  HRESULT STDMETHODCALLTYPE GetPartKind(UINT32 idx, UINT32 partIdx, _Out_ UINT32 *pResult) override;
+  HRESULT STDMETHODCALLTYPE GetPartContent(UINT32 idx, UINT32 partIdx, _COM_Outptr_ IDxcBlob **ppResult) override;
+
+  DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
+  DXC_MICROCOM_TM_CTOR(DxcShaderArchive)
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    return DoBasicQueryInterface<IDxcShaderArchive>(this, riid, ppvObject);
+  }
+
+private:
+  DXC_MICROCOM_TM_REF_FIELDS()
+  CComPtr<IDxcBlob> m_pArchive;
+  const DxilShaderArchiveHeader *m_pHeader = nullptr;
+
+  bool IsLoaded() const { return m_pHeader != nullptr; }
+  const DxilShaderArchiveEntry *GetEntry(UINT32 idx) const {
+    return GetDxilShaderArchiveEntries(m_pHeader) + idx;
+  }
+};
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::Load(_In_ IDxcBlob *pArchive) {
+  if (pArchive == nullptr)
+    return E_POINTER;
+  m_pArchive.Release();
+  m_pHeader = nullptr;
+  const DxilShaderArchiveHeader *pHeader =
+      (const DxilShaderArchiveHeader *)pArchive->GetBufferPointer();
+  if (!IsValidDxilShaderArchive(pHeader, pArchive->GetBufferSize()))
+    return DXC_E_CONTAINER_INVALID;
+  m_pArchive = pArchive;
+  m_pHeader = pHeader;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetContainerCount(_Out_ UINT32 *pResult) {
+  if (pResult == nullptr) return E_POINTER;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  *pResult = m_pHeader->ContainerCount;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetContainerKey(UINT32 idx, _Out_writes_bytes_(16) BYTE *pKey) {
+  if (pKey == nullptr) return E_POINTER;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  if (idx >= m_pHeader->ContainerCount) return E_BOUNDS;
+  memcpy(pKey, GetEntry(idx)->Key.Digest, DxilContainerHashSize);
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::FindContainer(_In_reads_bytes_(16) const BYTE *pKey, _Out_ UINT32 *pResult) {
+  if (pKey == nullptr || pResult == nullptr) return E_POINTER;
+  *pResult = 0;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  DxilContainerHash key;
+  memcpy(key.Digest, pKey, DxilContainerHashSize);
+  const DxilShaderArchiveEntry *pEntry = FindDxilShaderArchiveEntry(m_pHeader, key);
+  if (pEntry == nullptr) return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+  *pResult = (UINT32)(pEntry - GetDxilShaderArchiveEntries(m_pHeader));
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetContainer(UINT32 idx, _COM_Outptr_ IDxcBlob **ppResult) {
+  if (ppResult == nullptr) return E_POINTER;
+  *ppResult = nullptr;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  if (idx >= m_pHeader->ContainerCount) return E_BOUNDS;
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    CComPtr<AbstractMemoryStream> pStream;
+    IFT(CreateMemoryStream(m_pMalloc, &pStream));
+    WriteDxilShaderArchiveContainer(m_pHeader, GetEntry(idx), pStream);
+    IFT(pStream->QueryInterface(ppResult));
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetPartCount(UINT32 idx, _Out_ UINT32 *pResult) {
+  if (pResult == nullptr) return E_POINTER;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  if (idx >= m_pHeader->ContainerCount) return E_BOUNDS;
+  *pResult = GetEntry(idx)->Header.PartCount;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetPartKind(UINT32 idx, UINT32 partIdx, _Out_ UINT32 *pResult) {
+  if (pResult == nullptr) return E_POINTER;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  if (idx >= m_pHeader->ContainerCount) return E_BOUNDS;
+  const DxilShaderArchiveEntry *pEntry = GetEntry(idx);
+  if (partIdx >= pEntry->Header.PartCount) return E_BOUNDS;
+  *pResult = GetDxilShaderArchivePart(m_pHeader, pEntry, partIdx)->PartFourCC;
+  return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE DxcShaderArchive::GetPartContent(UINT32 idx, UINT32 partIdx, _COM_Outptr_ IDxcBlob **ppResult) {
+  if (ppResult == nullptr) return E_POINTER;
+  *ppResult = nullptr;
+  if (!IsLoaded()) return E_NOT_VALID_STATE;
+  if (idx >= m_pHeader->ContainerCount) return E_BOUNDS;
+  const DxilShaderArchiveEntry *pEntry = GetEntry(idx);
+  if (partIdx >= pEntry->Header.PartCount) return E_BOUNDS;
+  const DxilShaderArchivePart *pPart =
+      GetDxilShaderArchivePart(m_pHeader, pEntry, partIdx);
+  DxcThreadMalloc TM(m_pMalloc);
+  return DxcCreateBlobFromBlob(m_pArchive, pPart->DataOffset, pPart->PartSize,
+                               ppResult);
+}
+
+HRESULT CreateDxcShaderArchiveBuilder(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  CComPtr<DxcShaderArchiveBuilder> Result =
+      DxcShaderArchiveBuilder::Alloc(DxcGetThreadMallocNoRef());
+  IFROOM(Result.p);
+  return Result->QueryInterface(riid, ppv);
+}
+
+HRESULT CreateDxcShaderArchive(_In_ REFIID riid, _Out_ LPVOID *ppv) {
+  CComPtr<DxcShaderArchive> Result =
+      DxcShaderArchive::Alloc(DxcGetThreadMallocNoRef());
+  IFROOM(Result.p);
+  return Result->QueryInterface(riid, ppv);
+}
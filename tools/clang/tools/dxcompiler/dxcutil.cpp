@@ -23,6 +23,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PhaseTiming.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "dxc/Support/dxcapi.impl.h"
@@ -48,9 +49,12 @@ HRESULT RunInternalValidator(_In_ IDxcValidator *pValidator,
 namespace {
 // AssembleToContainer helper functions.
 
+// Validators from dxil.dll come from a pool; give them back with
+// ReturnValidator unless this returned true.
 bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
+  // Threads that compile at the same time each validate with their own.
   if (DxilLibIsEnabled()) {
-    DxilLibCreateInstance(CLSID_DxcValidator, &pValidator);
+    DxilLibTakeValidator(&pValidator);
   }
   bool bInternalValidator = false;
   if (pValidator == nullptr) {
@@ -60,6 +64,14 @@ bool CreateValidator(CComPtr<IDxcValidator> &pValidator) {
   return bInternalValidator;
 }
 
+void ReturnValidator(CComPtr<IDxcValidator> &pValidator,
+                     bool bInternalValidator) {
+  if (bInternalValidator)
+    pValidator.Release();
+  else
+    DxilLibReturnValidator(pValidator.Detach());
+}
+
 // Class to manage lifetime of llvm module and provide some utility
 // functions used for generating compiler output.
 class DxilCompilerLLVMModuleOutput {
@@ -74,11 +86,14 @@ public:
   void WrapModuleInDxilContainer(IMalloc *pMalloc,
                                  AbstractMemoryStream *pModuleBitcode,
                                  CComPtr<IDxcBlob> &pDxilContainerBlob,
-                                 SerializeDxilFlags Flags) {
+                                 SerializeDxilFlags Flags,
+                                 const DxilContainerHash *pDebugBitcodeHash) {
+    llvm::PhaseTimingRegion ContainerPhase("container");
     CComPtr<AbstractMemoryStream> pContainerStream;
     IFT(CreateMemoryStream(pMalloc, &pContainerStream));
     SerializeDxilContainerForModule(&m_llvmModule->GetOrCreateDxilModule(),
-                                    pModuleBitcode, pContainerStream, Flags);
+                                    pModuleBitcode, pContainerStream, Flags,
+                                    pDebugBitcodeHash);
 
     pDxilContainerBlob.Release();
     IFT(pContainerStream.QueryInterface(&pDxilContainerBlob));
@@ -100,7 +115,7 @@ void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor) {
     return;
 
   CComPtr<IDxcValidator> pValidator;
-  CreateValidator(pValidator);
+  bool bInternalValidator = CreateValidator(pValidator);
 
   CComPtr<IDxcVersionInfo> pVersionInfo;
   if (SUCCEEDED(pValidator.QueryInterface(&pVersionInfo))) {
@@ -110,18 +125,21 @@ void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor) {
     *pMajor = 1;
     *pMinor = 0;
   }
+  pVersionInfo.Release();
+  ReturnValidator(pValidator, bInternalValidator);
 }
 
 void AssembleToContainer(std::unique_ptr<llvm::Module> pM,
                          CComPtr<IDxcBlob> &pOutputBlob,
                          IMalloc *pMalloc,
                          SerializeDxilFlags SerializeFlags,
-                         CComPtr<AbstractMemoryStream> &pOutputStream) {
+                         CComPtr<AbstractMemoryStream> &pOutputStream,
+                         const DxilContainerHash *pDebugBitcodeHash) {
   // Take ownership of the module from the action.
   DxilCompilerLLVMModuleOutput llvmModule(std::move(pM));
 
   llvmModule.WrapModuleInDxilContainer(pMalloc, pOutputStream, pOutputBlob,
-                                       SerializeFlags);
+                                       SerializeFlags, pDebugBitcodeHash);
 }
 
 void ReadOptsAndValidate(hlsl::options::MainArgs &mainArgs,
@@ -153,7 +171,7 @@ HRESULT ValidateAndAssembleToContainer(
     std::unique_ptr<llvm::Module> pM, CComPtr<IDxcBlob> &pOutputBlob,
     IMalloc *pMalloc, SerializeDxilFlags SerializeFlags,
     CComPtr<AbstractMemoryStream> &pOutputStream, bool bDebugInfo,
-    clang::DiagnosticsEngine &Diag) {
+    clang::DiagnosticsEngine &Diag, const DxilContainerHash *pDebugBitcodeHash) {
   HRESULT valHR = S_OK;
 
   // Take ownership of the module from the action.
@@ -180,11 +198,13 @@ HRESULT ValidateAndAssembleToContainer(
   }
 
   llvmModule.WrapModuleInDxilContainer(pMalloc, pOutputStream, pOutputBlob,
-                                       SerializeFlags);
+                                       SerializeFlags, pDebugBitcodeHash);
 
   CComPtr<IDxcOperationResult> pValResult;
   // Important: in-place edit is required so the blob is reused and thus
   // dxil.dll can be released.
+  {
+  llvm::PhaseTimingRegion ValidationPhase("validation");
   if (bInternalValidator) {
     IFT(RunInternalValidator(pValidator, llvmModule.get(),
                              llvmModule.getWithDebugInfo(), pOutputBlob,
@@ -193,6 +213,7 @@ HRESULT ValidateAndAssembleToContainer(
     IFT(pValidator->Validate(pOutputBlob, DxcValidatorFlags_InPlaceEdit,
                              &pValResult));
   }
+  }
   IFT(pValResult->GetStatus(&valHR));
   if (FAILED(valHR)) {
     CComPtr<IDxcBlobEncoding> pErrors;
@@ -210,7 +231,7 @@ HRESULT ValidateAndAssembleToContainer(
   if (pValidatedBlob != nullptr) {
     std::swap(pOutputBlob, pValidatedBlob);
   }
-  pValidator.Release();
+  ReturnValidator(pValidator, bInternalValidator);
 
   return valHR;
 }
@@ -23,6 +23,7 @@ namespace llvm {
 class LLVMContext;
 class MemoryBuffer;
 class Module;
+class raw_ostream;
 class raw_string_ostream;
 class StringRef;
 class Twine;
@@ -31,6 +32,7 @@ class Twine;
 namespace hlsl {
 enum class SerializeDxilFlags : uint32_t;
 class AbstractMemoryStream;
+struct DxilContainerHash;
 namespace options {
 class MainArgs;
 class DxcOpts;
@@ -42,14 +44,16 @@ HRESULT ValidateAndAssembleToContainer(
     std::unique_ptr<llvm::Module> pM, CComPtr<IDxcBlob> &pOutputContainerBlob,
     IMalloc *pMalloc, hlsl::SerializeDxilFlags SerializeFlags,
     CComPtr<hlsl::AbstractMemoryStream> &pModuleBitcode, bool bDebugInfo,
-    clang::DiagnosticsEngine &Diag);
+    clang::DiagnosticsEngine &Diag,
+    const hlsl::DxilContainerHash *pDebugBitcodeHash = nullptr);
 void GetValidatorVersion(unsigned *pMajor, unsigned *pMinor);
 void AssembleToContainer(std::unique_ptr<llvm::Module> pM,
                          CComPtr<IDxcBlob> &pOutputContainerBlob,
                          IMalloc *pMalloc,
                          hlsl::SerializeDxilFlags SerializeFlags,
-                         CComPtr<hlsl::AbstractMemoryStream> &pModuleBitcode);
-HRESULT Disassemble(IDxcBlob *pProgram, llvm::raw_string_ostream &Stream);
+                         CComPtr<hlsl::AbstractMemoryStream> &pModuleBitcode,
+                         const hlsl::DxilContainerHash *pDebugBitcodeHash = nullptr);
+HRESULT Disassemble(IDxcBlob *pProgram, llvm::raw_ostream &Stream);
 void ReadOptsAndValidate(hlsl::options::MainArgs &mainArgs,
                          hlsl::options::DxcOpts &opts,
                          hlsl::AbstractMemoryStream *pOutputStream,
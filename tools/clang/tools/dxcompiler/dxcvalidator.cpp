@@ -18,13 +18,22 @@
 #include "dxc/HLSL/DxilValidation.h"
 
 #include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PhaseTiming.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/dxcapi.impl.h"
 #include "dxc/DxilRootSignature/DxilRootSignature.h"
 
+#include <chrono>
+#include <vector>
+
 #ifdef _WIN32
 #include "dxcetw.h"
 #endif
@@ -53,7 +62,187 @@ struct DiagRestore {
   }
 };
 
+static ValidationOptions GetValidationOptions(UINT32 Flags) {
+  ValidationOptions Options;
+  Options.StopAtFirstError = (Flags & DxcValidatorFlags_StopAtFirstError) != 0;
+  Options.ReportTimings = (Flags & DxcValidatorFlags_ReportTimings) != 0;
+  if (Flags & DxcValidatorFlags_RulesMask) {
+    Options.RuleGroups = 0;
+    if (Flags & DxcValidatorFlags_RulesMetadata)
+      Options.RuleGroups |= ValidationRuleGroup::Metadata;
+    if (Flags & DxcValidatorFlags_RulesDeclarations)
+      Options.RuleGroups |= ValidationRuleGroup::Declarations;
+    if (Flags & DxcValidatorFlags_RulesFlowControl)
+      Options.RuleGroups |= ValidationRuleGroup::FlowControl;
+    if (Flags & DxcValidatorFlags_RulesInstructions)
+      Options.RuleGroups |= ValidationRuleGroup::Instructions;
+    if (Flags & DxcValidatorFlags_RulesContainer)
+      Options.RuleGroups |= ValidationRuleGroup::Container;
+  }
+  return Options;
+}
+
+// Collects the time taken by each step of a validation run with
+// DxcValidatorFlags_ReportTimings.
+class DxcValidationTimingsRecorder : public llvm::PhaseTimingListener {
+  struct Phase {
+    StringRef Name; // Step names are string literals.
+    double Seconds;
+  };
+  std::vector<Phase> m_phases;
+  std::chrono::steady_clock::time_point m_start;
+  llvm::PhaseTimingListener *m_pPriorListener;
+
+public:
+  DxcValidationTimingsRecorder()
+      : m_start(std::chrono::steady_clock::now()) {
+    m_pPriorListener = llvm::setPhaseTimingListener(this);
+  }
+
+  ~DxcValidationTimingsRecorder() {
+    llvm::setPhaseTimingListener(m_pPriorListener);
+  }
+
+  void phaseFinished(StringRef Name, double Seconds) override {
+    m_phases.push_back({Name, Seconds});
+  }
+
+  void passFinished(StringRef Name, double Seconds) override {}
+
+  // Makes the timings available from pResult through IDxcCompileTimings.
+  void AttachTo(IDxcOperationResult *pResult) {
+    double total = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - m_start).count();
+    std::string json;
+    raw_string_ostream OS(json);
+    OS << "{\n  \"seconds\": " << format("%.6f", total);
+    OS << ",\n  \"phases\": [";
+    for (size_t i = 0; i < m_phases.size(); ++i) {
+      OS << (i ? ",\n" : "\n") << "    {\"name\": \"" << m_phases[i].Name
+         << "\", \"seconds\": " << format("%.6f", m_phases[i].Seconds)
+         << "}";
+    }
+    OS << "\n  ]\n}\n";
+    OS.flush();
+
+    CComPtr<IDxcBlobEncoding> pTimings;
+    IFT(DxcCreateBlobWithEncodingOnHeapCopy(json.data(), json.size(), CP_UTF8,
+                                            &pTimings));
+    // All validation results are created through DxcOperationResult.
+    static_cast<DxcOperationResult *>(pResult)->m_timings = pTimings;
+  }
+};
+
+// Validation results stored on disk, enabled with
+// IDxcValidatorCache::SetCacheDirectory.
+//
+// Entries are keyed on the validator version, the flags that affect the
+// result, and the container digest and the FourCC and contents of each of its
+// parts; a module-only blob is keyed on its bytes. The internal validator
+// never edits or signs the shader, so the stored status and messages are the
+// whole result. Each entry is a single file holding a small header followed
+// by the messages; any entry that cannot be read back in full is a miss.
+class DxcValidationCache {
+private:
+  struct EntryHeader {
+    uint32_t Magic;
+    uint32_t Version;
+    int32_t Status;
+    uint32_t DiagSize;
+  };
+  static const uint32_t EntryMagic = 0x43565844; // 'DXVC'
+  static const uint32_t EntryVersion = 1;
+
+  std::wstring m_entryPath;
+
+  static void HashBytes(llvm::MD5 &hasher, const void *pData, size_t size) {
+    hasher.update(llvm::ArrayRef<uint8_t>((const uint8_t *)pData, size));
+  }
+
+public:
+  // Computes the key for this validation and the file that would hold its
+  // entry.
+  DxcValidationCache(const std::wstring &directory, IDxcBlob *pShader,
+                     UINT32 Flags) {
+    llvm::MD5 hasher;
+    UINT32 valMajor, valMinor;
+    GetValidationVersion(&valMajor, &valMinor);
+    std::string version;
+    raw_string_ostream versionStream(version);
+    // In-place edits aren't made, so that flag doesn't change the result.
+    versionStream << valMajor << "." << valMinor << ";"
+                  << (Flags & ~DxcValidatorFlags_InPlaceEdit);
+#ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
+    versionStream << ";" << clang::getGitCommitHash();
+#endif
+    versionStream.flush();
+    HashBytes(hasher, version.data(), version.size() + 1);
+
+    const DxilContainerHeader *pContainer = IsDxilContainerLike(
+        pShader->GetBufferPointer(), pShader->GetBufferSize());
+    if (pContainer && IsValidDxilContainer(pContainer, pShader->GetBufferSize())) {
+      HashBytes(hasher, &pContainer->Hash, sizeof(pContainer->Hash));
+      HashBytes(hasher, &pContainer->Version, sizeof(pContainer->Version));
+      for (const DxilPartHeader *pPart : pContainer) {
+        HashBytes(hasher, pPart, sizeof(*pPart));
+        HashBytes(hasher, GetDxilPartData(pPart), pPart->PartSize);
+      }
+    } else {
+      HashBytes(hasher, pShader->GetBufferPointer(), pShader->GetBufferSize());
+    }
+
+    llvm::MD5::MD5Result digest;
+    hasher.final(digest);
+    SmallString<32> digestText;
+    llvm::MD5::stringifyResult(digest, digestText);
+
+    SmallString<256> entryPath(Unicode::UTF16ToUTF8StringOrThrow(directory.c_str()));
+    llvm::sys::path::append(entryPath, digestText.str() + ".dxvcache");
+    m_entryPath = Unicode::UTF8ToUTF16StringOrThrow(entryPath.c_str());
+  }
+
+  // Loads the stored result for this key, if a complete entry exists.
+  bool Lookup(IMalloc *pMalloc, HRESULT &status, std::string &diag) {
+    CDxcMallocHeapPtr<uint8_t> pData(pMalloc);
+    DWORD dataSize = 0;
+    try {
+      ReadBinaryFile(pMalloc, m_entryPath.c_str(), (void **)&pData.m_pData,
+                     &dataSize);
+    } catch (...) {
+      return false;
+    }
+
+    EntryHeader header;
+    if (dataSize < sizeof(header))
+      return false;
+    memcpy(&header, pData.m_pData, sizeof(header));
+    if (header.Magic != EntryMagic || header.Version != EntryVersion ||
+        (uint64_t)sizeof(header) + header.DiagSize != dataSize)
+      return false;
+    status = header.Status;
+    diag.assign((const char *)pData.m_pData + sizeof(header), header.DiagSize);
+    return true;
+  }
+
+  // Stores the result of a validation that ran to completion. Failing to
+  // write the entry only costs a future cache hit, so errors are not
+  // reported.
+  void Store(HRESULT status, const void *pDiag, size_t diagSize) {
+    try {
+      EntryHeader header = {EntryMagic, EntryVersion, status,
+                            (uint32_t)diagSize};
+      std::vector<uint8_t> data((const uint8_t *)&header,
+                                (const uint8_t *)(&header + 1));
+      data.insert(data.end(), (const uint8_t *)pDiag,
+                  (const uint8_t *)pDiag + diagSize);
+      WriteBinaryFile(m_entryPath.c_str(), data.data(), data.size());
+    } catch (...) {
+    }
+  }
+};
+
 class DxcValidator : public IDxcValidator,
+                     public IDxcValidatorCache,
 #ifdef SUPPORT_QUERY_GIT_COMMIT_INFO
                      public IDxcVersionInfo2
 #else
@@ -62,6 +251,7 @@ class DxcValidator : public IDxcValidator,
 {
 private:
   DXC_MICROCOM_TM_REF_FIELDS()
+  std::wstring m_cacheDir;
 
   HRESULT RunValidation(
     _In_ IDxcBlob *pShader,                       // Shader to validate.
@@ -79,7 +269,8 @@ public:
   DXC_MICROCOM_TM_CTOR(DxcValidator)
 
   HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) override {
-    return DoBasicQueryInterface<IDxcValidator, IDxcVersionInfo>(this, iid, ppvObject);
+    return DoBasicQueryInterface<IDxcValidator, IDxcValidatorCache,
+                                 IDxcVersionInfo>(this, iid, ppvObject);
   }
 
   // For internal use only.
@@ -98,6 +289,9 @@ public:
     _COM_Outptr_ IDxcOperationResult **ppResult   // Validation output status, buffer, and errors
     ) override;
 
+  // IDxcValidatorCache
+  HRESULT STDMETHODCALLTYPE SetCacheDirectory(_In_opt_z_ LPCWSTR pDirectory) override;
+
   // IDxcVersionInfo
   HRESULT STDMETHODCALLTYPE GetVersion(_Out_ UINT32 *pMajor, _Out_ UINT32 *pMinor) override;
   HRESULT STDMETHODCALLTYPE GetFlags(_Out_ UINT32 *pFlags) override;
@@ -138,17 +332,39 @@ HRESULT DxcValidator::ValidateWithOptModules(
     CComPtr<AbstractMemoryStream> pDiagStream;
     IFT(CreateMemoryStream(m_pMalloc, &pDiagStream));
 
-    // Run validation may throw, but that indicates an inability to validate,
-    // not that the validation failed (eg out of memory).
-    if (Flags & DxcValidatorFlags_RootSignatureOnly) {
-      validationStatus = RunRootSignatureValidation(pShader, pDiagStream);
-    } else {
-      validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream);
-    }
-    if (FAILED(validationStatus)) {
-      std::string msg("Validation failed.\n");
+    std::unique_ptr<DxcValidationTimingsRecorder> pTimings;
+    if (Flags & DxcValidatorFlags_ReportTimings)
+      pTimings.reset(new DxcValidationTimingsRecorder());
+
+    // Results are only cached for a blob, as modules handed over by the
+    // compiler may differ from what was serialized. A cached result would
+    // have no timings to report.
+    std::unique_ptr<DxcValidationCache> pCache;
+    HRESULT cachedStatus;
+    std::string cachedDiag;
+    if (!m_cacheDir.empty() && !pModule && !pTimings)
+      pCache.reset(new DxcValidationCache(m_cacheDir, pShader, Flags));
+
+    if (pCache && pCache->Lookup(m_pMalloc, cachedStatus, cachedDiag)) {
+      validationStatus = cachedStatus;
       ULONG cbWritten;
-      pDiagStream->Write(msg.c_str(), msg.size(), &cbWritten);
+      IFT(pDiagStream->Write(cachedDiag.data(), cachedDiag.size(), &cbWritten));
+    } else {
+      // Run validation may throw, but that indicates an inability to validate,
+      // not that the validation failed (eg out of memory).
+      if (Flags & DxcValidatorFlags_RootSignatureOnly) {
+        validationStatus = RunRootSignatureValidation(pShader, pDiagStream);
+      } else {
+        validationStatus = RunValidation(pShader, Flags, pModule, pDebugModule, pDiagStream);
+      }
+      if (FAILED(validationStatus)) {
+        std::string msg("Validation failed.\n");
+        ULONG cbWritten;
+        pDiagStream->Write(msg.c_str(), msg.size(), &cbWritten);
+      }
+      if (pCache)
+        pCache->Store(validationStatus, pDiagStream->GetPtr(),
+                      pDiagStream->GetPtrSize());
     }
     // Assemble the result object.
     CComPtr<IDxcBlob> pDiagBlob;
@@ -157,6 +373,8 @@ HRESULT DxcValidator::ValidateWithOptModules(
     DXASSERT_NOMSG(SUCCEEDED(hr));
     IFT(DxcCreateBlobWithEncodingSet(pDiagBlob, CP_UTF8, &pDiagBlobEnconding));
     IFT(DxcOperationResult::CreateFromResultErrorStatus(nullptr, pDiagBlobEnconding, validationStatus, ppResult));
+    if (pTimings)
+      pTimings->AttachTo(*ppResult);
   }
   CATCH_CPP_ASSIGN_HRESULT();
 
@@ -164,6 +382,15 @@ HRESULT DxcValidator::ValidateWithOptModules(
   return hr;
 }
 
+HRESULT STDMETHODCALLTYPE DxcValidator::SetCacheDirectory(_In_opt_z_ LPCWSTR pDirectory) {
+  DxcThreadMalloc TM(m_pMalloc);
+  try {
+    m_cacheDir = pDirectory ? pDirectory : L"";
+  }
+  CATCH_CPP_RETURN_HRESULT();
+  return S_OK;
+}
+
 HRESULT STDMETHODCALLTYPE DxcValidator::GetVersion(_Out_ UINT32 *pMajor, _Out_ UINT32 *pMinor) {
   if (pMajor == nullptr || pMinor == nullptr)
     return E_INVALIDARG;
@@ -212,6 +439,7 @@ HRESULT DxcValidator::RunValidation(
   // by a failing HRESULT, and possibly error messages in the diagnostics stream.
 
   raw_stream_ostream DiagStream(pDiagStream);
+  ValidationOptions Options = GetValidationOptions(Flags);
 
   if (Flags & DxcValidatorFlags_ModuleOnly) {
     IFRBOOL(!IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()), E_INVALIDARG);
@@ -222,9 +450,9 @@ HRESULT DxcValidator::RunValidation(
   if (!pModule) {
     DXASSERT_NOMSG(pDebugModule == nullptr);
     if (Flags & DxcValidatorFlags_ModuleOnly) {
-      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilBitcode((const char*)pShader->GetBufferPointer(), (uint32_t)pShader->GetBufferSize(), DiagStream, Options);
     } else {
-      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream);
+      return ValidateDxilContainer(pShader->GetBufferPointer(), pShader->GetBufferSize(), DiagStream, Options);
     }
   }
 
@@ -232,11 +460,11 @@ HRESULT DxcValidator::RunValidation(
   PrintDiagnosticContext DiagContext(DiagPrinter);
   DiagRestore DR(pModule->getContext(), &DiagContext);
 
-  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule));
+  IFR(hlsl::ValidateDxilModule(pModule, pDebugModule, Options));
   if (!(Flags & DxcValidatorFlags_ModuleOnly)) {
     IFR(ValidateDxilContainerParts(pModule, pDebugModule,
                       IsDxilContainerLike(pShader->GetBufferPointer(), pShader->GetBufferSize()),
-                      (uint32_t)pShader->GetBufferSize()));
+                      (uint32_t)pShader->GetBufferSize(), Options));
   }
 
   if (DiagContext.HasErrors() || DiagContext.HasWarnings()) {
@@ -261,15 +489,13 @@ HRESULT DxcValidator::RunRootSignatureValidation(
   const DxilPartHeader *pRSPart = GetDxilPartByType(pDxilContainer, DFCC_RootSignature);
   IFRBOOL(pPSVPart && pRSPart, DXC_E_MISSING_PART);
   try {
-    RootSignatureHandle RSH;
-    RSH.LoadSerialized((const uint8_t*)GetDxilPartData(pRSPart), pRSPart->PartSize);
-    RSH.Deserialize();
+    std::shared_ptr<const CachedRootSignature> pRS = GetCachedRootSignature(
+        GetDxilPartData(pRSPart), pRSPart->PartSize);
     raw_stream_ostream DiagStream(pDiagStream);
-    IFRBOOL(VerifyRootSignatureWithShaderPSV(RSH.GetDesc(),
-                                             GetVersionShaderType(pProgramHeader->ProgramVersion),
-                                             GetDxilPartData(pPSVPart),
-                                             pPSVPart->PartSize,
-                                             DiagStream),
+    IFRBOOL(pRS->VerifyShaderPSV(GetVersionShaderType(pProgramHeader->ProgramVersion),
+                                 GetDxilPartData(pPSVPart),
+                                 pPSVPart->PartSize,
+                                 DiagStream),
       DXC_E_INCORRECT_ROOT_SIGNATURE);
   } catch(...) {
     return DXC_E_IR_VERIFICATION_FAILED;
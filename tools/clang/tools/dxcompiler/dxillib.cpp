@@ -13,21 +13,40 @@
 #include "dxc/Support/Global.h" // For DXASSERT
 #include "dxc/Support/dxcapi.use.h"
 #include "llvm/Support/Mutex.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 using namespace dxc;
 
 static DxcDllSupport g_DllSupport;
 static HRESULT g_DllLibResult = S_OK;
 
+// Set once dxil.dll is loaded. DxcDllSupport only reads its entry point from
+// then on, so loaded callers take no lock; cs only guards loading and the
+// pool of validators.
+static std::atomic<bool> g_DllLibLoaded(false);
 static llvm::sys::Mutex *cs = nullptr;
 
+// Validators from dxil.dll that no compile is using, each holding a
+// reference, to be released before dxil.dll is. The pool is reserved up front
+// so that returning a validator never allocates.
+static std::vector<IDxcValidator *> *g_IdleValidators = nullptr;
+static size_t g_MaxIdleValidators = 0;
+
 // Check if we can successfully get IDxcValidator from dxil.dll
 // This function is to prevent multiple attempts to load dxil.dll 
 HRESULT DxilLibInitialize() {
   cs = new llvm::sys::Mutex;
+  // One for each thread that can compile at the same time.
+  g_MaxIdleValidators = std::max(1u, std::thread::hardware_concurrency());
+  g_IdleValidators = new std::vector<IDxcValidator *>;
+  g_IdleValidators->reserve(g_MaxIdleValidators);
 #if LLVM_ON_WIN32
   cs->lock();
   g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
+  g_DllLibLoaded = SUCCEEDED(g_DllLibResult) && g_DllSupport.IsEnabled();
   cs->unlock();
 #endif
   return S_OK;
@@ -35,15 +54,23 @@ HRESULT DxilLibInitialize() {
 
 HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
   HRESULT hr = S_OK;
+  g_DllLibLoaded = false;
   if (type == DxilLibCleanUpType::ProcessTermination) {
     g_DllSupport.Detach();
   }
   else if (type == DxilLibCleanUpType::UnloadLibrary) {
+    // Validators can't outlive the library that implements them.
+    if (g_IdleValidators) {
+      for (IDxcValidator *pValidator : *g_IdleValidators)
+        pValidator->Release();
+    }
     g_DllSupport.Cleanup();
   }
   else {
     hr = E_INVALIDARG;
   }
+  delete g_IdleValidators;
+  g_IdleValidators = nullptr;
   delete cs;
   cs = nullptr;
   return hr;
@@ -54,11 +81,14 @@ HRESULT DxilLibCleanup(DxilLibCleanUpType type) {
 // have multiple attempts to load dxil.dll
 bool DxilLibIsEnabled() {
 #if LLVM_ON_WIN32
+  if (g_DllLibLoaded)
+    return true;
   cs->lock();
   if (SUCCEEDED(g_DllLibResult)) {
     if (!g_DllSupport.IsEnabled()) {
       g_DllLibResult = g_DllSupport.InitializeForDll(L"dxil.dll", "DxcCreateInstance");
     }
+    g_DllLibLoaded = SUCCEEDED(g_DllLibResult) && g_DllSupport.IsEnabled();
   }
   cs->unlock();
   return SUCCEEDED(g_DllLibResult);
@@ -73,9 +103,34 @@ HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ REFIID riid, _In_ IUnkn
   DXASSERT_NOMSG(ppInterface != nullptr);
   HRESULT hr = E_FAIL;
   if (DxilLibIsEnabled()) {
-    cs->lock();
     hr = g_DllSupport.CreateInstance(rclsid, riid, ppInterface);
-    cs->unlock();
   }
   return hr;
 }
+
+HRESULT DxilLibTakeValidator(_COM_Outptr_ IDxcValidator **ppValidator) {
+  DXASSERT_NOMSG(ppValidator != nullptr);
+  *ppValidator = nullptr;
+  if (!DxilLibIsEnabled())
+    return E_FAIL;
+  cs->lock();
+  if (!g_IdleValidators->empty()) {
+    *ppValidator = g_IdleValidators->back();
+    g_IdleValidators->pop_back();
+  }
+  cs->unlock();
+  if (*ppValidator != nullptr)
+    return S_OK;
+  return DxilLibCreateInstance(CLSID_DxcValidator, ppValidator);
+}
+
+void DxilLibReturnValidator(_In_ IDxcValidator *pValidator) {
+  DXASSERT_NOMSG(pValidator != nullptr);
+  cs->lock();
+  bool pooled = g_IdleValidators->size() < g_MaxIdleValidators;
+  if (pooled)
+    g_IdleValidators->push_back(pValidator);
+  cs->unlock();
+  if (!pooled)
+    pValidator->Release();
+}
@@ -16,6 +16,8 @@
 #include "dxc/Support/WinAdapter.h"
 #include "dxc/Support/WinIncludes.h"
 
+struct IDxcValidator;
+
 // Initialize Dxil library. 
 HRESULT DxilLibInitialize();
 
@@ -34,6 +36,17 @@ bool DxilLibIsEnabled();
 
 HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ REFIID riid, _In_ IUnknown **ppInterface);
 
+// Takes a validator from dxil.dll out of the pool of idle ones, creating one
+// if none is idle. A validator is used by one compile at a time; hand it back
+// with DxilLibReturnValidator when done. The pool keeps no more validators
+// than threads that can run at once, so threads that come and go don't grow
+// it, and it is released before dxil.dll is unloaded.
+HRESULT DxilLibTakeValidator(_COM_Outptr_ IDxcValidator **ppValidator);
+
+// Returns a validator from DxilLibTakeValidator to the pool, passing on the
+// reference to it.
+void DxilLibReturnValidator(_In_ IDxcValidator *pValidator);
+
 template <class TInterface>
 HRESULT DxilLibCreateInstance(_In_ REFCLSID rclsid, _In_ TInterface **ppInterface) {
   return DxilLibCreateInstance(rclsid, __uuidof(TInterface), (IUnknown**) ppInterface);
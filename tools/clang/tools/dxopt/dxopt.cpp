@@ -23,9 +23,12 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/Support/FileIOHelper.h"
 #include "dxc/Support/microcom.h"
+#include <algorithm>
+#include <chrono>
 #include <comdef.h>
 #include <iostream>
 #include <limits>
+#include <map>
 
 #include "llvm/Support/FileSystem.h"
 
@@ -193,16 +196,199 @@ static void ReadFileOpts(LPCWSTR pPassFileName, IDxcBlobEncoding **ppPassOpts, s
   *ppPassOpts = pPassOpts.Detach();
 }
 
+// Per-pass totals of a -report, as written by IDxcOptimizer2.
+struct PassReportEntry {
+  double Seconds;
+  unsigned Runs;
+  long long InstructionDelta;
+};
+
+static void ParsePassReport(IDxcBlob *pReport,
+                            std::map<std::string, PassReportEntry> &Passes) {
+  std::string Text((const char *)pReport->GetBufferPointer(),
+                   pReport->GetBufferSize());
+  const char NameKey[] = "{\"name\": \"";
+  for (size_t pos = Text.find(NameKey); pos != std::string::npos;
+       pos = Text.find(NameKey, pos)) {
+    pos += _countof(NameKey) - 1;
+    size_t nameEnd = Text.find('"', pos);
+    if (nameEnd == std::string::npos)
+      break;
+    PassReportEntry entry = {0, 0, 0};
+    const char *pFields = Text.c_str() + nameEnd;
+    const char *pField;
+    if ((pField = strstr(pFields, "\"seconds\": ")) != nullptr)
+      entry.Seconds = strtod(pField + 11, nullptr);
+    if ((pField = strstr(pFields, "\"runs\": ")) != nullptr)
+      entry.Runs = strtoul(pField + 8, nullptr, 10);
+    if ((pField = strstr(pFields, "\"instructionDelta\": ")) != nullptr)
+      entry.InstructionDelta = strtoll(pField + 20, nullptr, 10);
+    Passes[Text.substr(pos, nameEnd - pos)] = entry;
+    pos = nameEnd;
+  }
+}
+
+// Runs the pipeline Count times and prints the time of each pass, slowest
+// first, with the instruction count change it makes.
+static void BenchOptimizer(IDxcOptimizer *pOptimizer, IDxcBlob *pBlob,
+                           LPCWSTR *optArgs, UINT32 optArgCount,
+                           unsigned Count) {
+  CComPtr<IDxcOptimizer2> pOptimizer2;
+  IFT(pOptimizer->QueryInterface(&pOptimizer2));
+  struct PassBench {
+    double Total = 0, Min = std::numeric_limits<double>::max(), Max = 0;
+    unsigned Runs = 0;
+    long long InstructionDelta = 0;
+  };
+  std::map<std::string, PassBench> passes;
+  std::vector<double> pipelineMs;
+  size_t outputBytes = 0;
+  for (unsigned i = 0; i < Count; ++i) {
+    CComPtr<IDxcBlob> pOutputModule;
+    CComPtr<IDxcBlobEncoding> pOutputText;
+    CComPtr<IDxcBlobEncoding> pReport;
+    auto start = std::chrono::steady_clock::now();
+    IFT(pOptimizer2->RunOptimizerWithReport(pBlob, optArgs, optArgCount,
+                                            &pOutputModule, &pOutputText,
+                                            &pReport));
+    pipelineMs.push_back(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count());
+    outputBytes = pOutputModule ? pOutputModule->GetBufferSize() : 0;
+
+    std::map<std::string, PassReportEntry> report;
+    ParsePassReport(pReport, report);
+    for (auto &entry : report) {
+      PassBench &pass = passes[entry.first];
+      double ms = entry.second.Seconds * 1000;
+      pass.Total += ms;
+      pass.Min = std::min(pass.Min, ms);
+      pass.Max = std::max(pass.Max, ms);
+      pass.Runs = entry.second.Runs;
+      pass.InstructionDelta = entry.second.InstructionDelta;
+    }
+  }
+
+  std::vector<std::pair<std::string, PassBench>> bySlowest(passes.begin(),
+                                                           passes.end());
+  std::stable_sort(bySlowest.begin(), bySlowest.end(),
+                   [](const std::pair<std::string, PassBench> &a,
+                      const std::pair<std::string, PassBench> &b) {
+                     return a.second.Total > b.second.Total;
+                   });
+  wprintf(L"%-40s %10s %10s %10s %6s %12s\n", L"pass", L"mean ms",
+          L"min ms", L"max ms", L"runs", L"instr delta");
+  for (auto &entry : bySlowest) {
+    const PassBench &pass = entry.second;
+    wprintf(L"%-40S %10.3f %10.3f %10.3f %6u %12lld\n", entry.first.c_str(),
+            pass.Total / Count, pass.Min, pass.Max, pass.Runs,
+            pass.InstructionDelta);
+  }
+  std::sort(pipelineMs.begin(), pipelineMs.end());
+  double total = 0;
+  for (double ms : pipelineMs)
+    total += ms;
+  wprintf(L"\npipeline: %u runs, mean %.3f ms, median %.3f ms, min %.3f ms, "
+          L"max %.3f ms; output %u bytes\n",
+          Count, total / Count, pipelineMs[pipelineMs.size() / 2],
+          pipelineMs.front(), pipelineMs.back(), (unsigned)outputBytes);
+}
+
+// Arguments that are switches for the optimizer rather than passes.
+static bool IsOptimizerSwitch(LPCWSTR arg) {
+  return wcseq(arg, L"-S") || wcseq(arg, L"-analyze") ||
+         wcseq(arg, L"-opt-fn-passes") || wcseq(arg, L"-opt-mod-passes") ||
+         wcsistarts(arg, L"-print-module");
+}
+
+// Runs the first PassCount passes, keeping every switch, and reports whether
+// the predicate, run on the output module, accepts it. A pipeline that fails
+// is rejected.
+static bool RunBisectStep(IDxcOptimizer *pOptimizer, IDxcBlob *pBlob,
+                          LPCWSTR *optArgs, UINT32 optArgCount,
+                          UINT32 PassCount, LPCWSTR pPredicate,
+                          LPCWSTR pModuleFileName) {
+  std::vector<LPCWSTR> args;
+  UINT32 passIndex = 0;
+  for (UINT32 i = 0; i < optArgCount; ++i) {
+    if (IsOptimizerSwitch(optArgs[i]) || passIndex++ < PassCount)
+      args.push_back(optArgs[i]);
+  }
+  CComPtr<IDxcBlob> pOutputModule;
+  CComPtr<IDxcBlobEncoding> pOutputText;
+  if (FAILED(pOptimizer->RunOptimizer(pBlob, args.data(), (UINT32)args.size(),
+                                      &pOutputModule, &pOutputText)) ||
+      !pOutputModule)
+    return false;
+  dxc::WriteBlobToFile(pOutputModule, pModuleFileName);
+  std::wstring command = pPredicate;
+  command += L" \"";
+  command += pModuleFileName;
+  command += L"\"";
+  fflush(stdout);
+  return _wsystem(command.c_str()) == 0;
+}
+
+// Finds the pass that first makes the predicate reject the output: with
+// none of the passes the output must be accepted, with all of them rejected.
+static void BisectOptimizer(IDxcOptimizer *pOptimizer, IDxcBlob *pBlob,
+                            LPCWSTR *optArgs, UINT32 optArgCount,
+                            LPCWSTR pPredicate) {
+  std::vector<LPCWSTR> passes;
+  for (UINT32 i = 0; i < optArgCount; ++i) {
+    if (!IsOptimizerSwitch(optArgs[i]))
+      passes.push_back(optArgs[i]);
+  }
+  wchar_t tempPath[MAX_PATH], moduleFileName[MAX_PATH];
+  IFTBOOL(GetTempPathW(_countof(tempPath), tempPath) != 0,
+          HRESULT_FROM_WIN32(GetLastError()));
+  IFTBOOL(GetTempFileNameW(tempPath, L"dxo", 0, moduleFileName) != 0,
+          HRESULT_FROM_WIN32(GetLastError()));
+
+  auto Accepts = [&](UINT32 count) {
+    bool accepted = RunBisectStep(pOptimizer, pBlob, optArgs, optArgCount,
+                                  count, pPredicate, moduleFileName);
+    wprintf(L"bisect: %u of %u passes - %s\n", count, (UINT32)passes.size(),
+            accepted ? L"good" : L"bad");
+    return accepted;
+  };
+  bool goodWithNone = Accepts(0);
+  bool badWithAll = !goodWithNone || !Accepts((UINT32)passes.size());
+  if (!goodWithNone || !badWithAll) {
+    DeleteFileW(moduleFileName);
+    IFTMSG(E_FAIL, goodWithNone
+                       ? "the predicate accepts the output of all passes"
+                       : "the predicate rejects the output of no passes");
+  }
+
+  // Accepts(good) and !Accepts(bad) hold throughout.
+  UINT32 good = 0, bad = (UINT32)passes.size();
+  while (bad - good > 1) {
+    UINT32 mid = good + (bad - good) / 2;
+    if (Accepts(mid))
+      good = mid;
+    else
+      bad = mid;
+  }
+  DeleteFileW(moduleFileName);
+  wprintf(L"bisect: first bad pass is #%u, %s\n", bad, passes[bad - 1]);
+}
+
 static void PrintHelp() {
   wprintf(L"%s",
     L"Performs optimizations on a bitcode file by running a sequence of passes.\n\n"
-    L"dxopt [-? | -passes | -pass-details | -pf [PASS-FILE] | [-o=OUT-FILE] | IN-FILE OPT-ARGUMENTS ...]\n\n"
+    L"dxopt [-? | -passes | -pass-details | -pf [PASS-FILE] | [-o=OUT-FILE] | [-report=REPORT-FILE] | [-bench=N] | [-bisect=COMMAND] | IN-FILE OPT-ARGUMENTS ...]\n\n"
     L"Arguments:\n"
     L"  -?  Displays this help message\n"
     L"  -passes        Displays a list of pass names\n"
     L"  -pass-details  Displays a list of passes with detailed information\n"
     L"  -pf PASS-FILE  Loads passes from the specified file\n"
     L"  -o=OUT-FILE    Output file for processed module\n"
+    L"  -report=REPORT-FILE  Output file for a JSON report of the time and\n"
+    L"                 instruction count change of each pass\n"
+    L"  -bench=N       Runs the passes N times and prints the time and\n"
+    L"                 instruction count change of each pass\n"
+    L"  -bisect=COMMAND  Finds the first pass after which COMMAND, run with\n"
+    L"                 the path of the output module, exits with non-zero\n"
     L"  IN-FILE        File with with bitcode to optimize\n"
     L"  OPT-ARGUMENTS  One or more passes to run in sequence\n"
     L"\n"
@@ -223,6 +409,9 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     ProgramAction action = ProgramAction::PrintHelp;
     LPCWSTR inFileName = nullptr;
     LPCWSTR outFileName = nullptr;
+    LPCWSTR reportFileName = nullptr;
+    LPCWSTR bisectCommand = nullptr;
+    unsigned benchCount = 0;
     LPCWSTR externalLib = nullptr;
     LPCWSTR externalFn = nullptr;
     LPCWSTR passFileName = nullptr;
@@ -268,6 +457,19 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       else if (wcsistarts(arg, L"-o=")) {
         outFileName = argv_[argIdx] + 3;
       }
+      else if (wcsistarts(arg, L"-report=")) {
+        reportFileName = argv_[argIdx] + 8;
+      }
+      else if (wcsistarts(arg, L"-bench=")) {
+        benchCount = wcstoul(argv_[argIdx] + 7, nullptr, 10);
+        if (benchCount == 0) {
+          PrintHelp();
+          return 1;
+        }
+      }
+      else if (wcsistarts(arg, L"-bisect=")) {
+        bisectCommand = argv_[argIdx] + 8;
+      }
       else {
         action = ProgramAction::RunOptimizer;
         // See if arg is file input specifier.
@@ -326,7 +528,28 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       pStage = "Optimizer processing";
       BlobFromFile(inFileName, &pBlob);
       ReadFileOpts(passFileName, &pPassOpts, passes, &optArgs, &optArgCount);
-      IFT(pOptimizer->RunOptimizer(pBlob, optArgs, optArgCount, &pOutputModule, &pOutputText));
+      if (benchCount) {
+        pStage = "Benchmarking";
+        BenchOptimizer(pOptimizer, pBlob, optArgs, optArgCount, benchCount);
+        break;
+      }
+      if (bisectCommand) {
+        pStage = "Bisecting";
+        BisectOptimizer(pOptimizer, pBlob, optArgs, optArgCount, bisectCommand);
+        break;
+      }
+      if (reportFileName) {
+        CComPtr<IDxcOptimizer2> pOptimizer2;
+        CComPtr<IDxcBlobEncoding> pReport;
+        IFT(pOptimizer.QueryInterface(&pOptimizer2));
+        IFT(pOptimizer2->RunOptimizerWithReport(pBlob, optArgs, optArgCount,
+                                                &pOutputModule, &pOutputText,
+                                                &pReport));
+        dxc::WriteBlobToFile(pReport, reportFileName);
+      }
+      else {
+        IFT(pOptimizer->RunOptimizer(pBlob, optArgs, optArgCount, &pOutputModule, &pOutputText));
+      }
       PrintOptOutput(outFileName, pOutputModule, pOutputText);
       break;
     }
@@ -31,7 +31,9 @@
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IRReader/IRReader.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/MSFileSystem.h"
 #include "llvm/Support/SourceMgr.h"
@@ -39,6 +41,10 @@
 
 #include "dxc/HLSL/DxilFallbackLayerPass.h"
 
+#include <list>
+#include <map>
+#include <mutex>
+
 using namespace llvm;
 using namespace hlsl;
 
@@ -110,6 +116,53 @@ static DxilModule* ExtractDxil(LLVMContext& context, IDxcBlob* pContainer)
 }
 
 
+// Collects the limits that the pipeline and shader config subobjects in a 
+// library put on the shaders. The largest of each is kept, so that the limits
+// hold for every shader; a limit stays 0 if no subobject declares it.
+static void GetPipelineLimits(DxilModule* dxil, UINT32 &maxAttributeSize, UINT32 &maxTraceRecursionDepth)
+{
+  const DxilSubobjects* subobjects = dxil->GetSubobjects();
+  if (!subobjects)
+    return;
+
+  for (auto &it : subobjects->GetSubobjects())
+  {
+    const DxilSubobject &subobject = *it.second;
+    uint32_t payloadSize = 0, attributeSize = 0, depth = 0;
+    if (subobject.GetRaytracingShaderConfig(payloadSize, attributeSize))
+      maxAttributeSize = std::max(maxAttributeSize, attributeSize);
+    else if (subobject.GetRaytracingPipelineConfig(depth))
+      maxTraceRecursionDepth = std::max(maxTraceRecursionDepth, depth);
+  }
+}
+
+
+// Computes the key of a Compile() in the compile cache.
+static std::string GetCompileCacheKey(DxcShaderBytecode *pShaderLibs, UINT32 libCount, const LPCWSTR *pShaderNames, UINT32 shaderCount, UINT32 maxAttributeSize)
+{
+  llvm::MD5 hasher;
+  auto hashBytes = [&hasher](const void *pData, size_t size) {
+    hasher.update(llvm::ArrayRef<uint8_t>((const uint8_t *)pData, size));
+  };
+  hashBytes(&maxAttributeSize, sizeof(maxAttributeSize));
+  hashBytes(&libCount, sizeof(libCount));
+  for (UINT32 i = 0; i < libCount; ++i)
+  {
+    UINT64 size = pShaderLibs[i].Size;
+    hashBytes(&size, sizeof(size));
+    hashBytes(pShaderLibs[i].pData, pShaderLibs[i].Size);
+  }
+  for (UINT32 i = 0; i < shaderCount; ++i)
+    hashBytes(pShaderNames[i], (wcslen(pShaderNames[i]) + 1) * sizeof(wchar_t));
+
+  llvm::MD5::MD5Result digest;
+  hasher.final(digest);
+  SmallString<32> digestText;
+  llvm::MD5::stringifyResult(digest, digestText);
+  return digestText.str();
+}
+
+
 static void saveModuleToAsmFile(const llvm::Module* module, const std::string& filename)
 {
   std::error_code EC;
@@ -135,6 +188,21 @@ private:
 
   // Only used for test purposes when exports aren't explicitly listed
   std::unique_ptr<DxrFallbackCompiler::IntToFuncNameMap> m_pCachedMap;
+
+  // Successful results of Compile(), keyed on a digest of its inputs, so that
+  // state objects that share shader libraries don't transform them again.
+  // Only the most recently used results are kept.
+  static const size_t MaxCompileCacheEntries = 32;
+  struct CompileCacheEntry
+  {
+    CComPtr<IDxcBlob> pResult;
+    std::string diag;
+    std::vector<DxcShaderInfo> shaderInfo;
+    std::list<std::string>::iterator lruPos;
+  };
+  std::map<std::string, CompileCacheEntry> m_compileCache;
+  std::list<std::string> m_compileCacheLru; // Most recently used first.
+  std::mutex m_compileCacheMutex;
 public:
   DXC_MICROCOM_TM_ADDREF_RELEASE_IMPL()
     DXC_MICROCOM_TM_CTOR(DxcDxrFallbackCompiler)
@@ -475,6 +543,7 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Link(
         unsigned int valMajor = 0, valMinor = 0;
         dxcutil::GetValidatorVersion(&valMajor, &valMinor);
         std::unique_ptr<Module> M;
+        UINT32 configAttributeSize = 0, maxTraceRecursionDepth = 0;
         {
             DxilLinker* pLinker = DxilLinker::CreateLinker(context, valMajor, valMinor);
             for (UINT32 i = 0; i < libCount; ++i)
@@ -484,6 +553,7 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Link(
                 {
                     return DXC_E_CONTAINER_MISSING_DXIL;
                 }
+                GetPipelineLimits(dxil, configAttributeSize, maxTraceRecursionDepth);
                 pLinker->RegisterLib(std::to_string(i), std::unique_ptr<Module>(dxil->GetModule()), nullptr);
                 pLinker->AttachLib(std::to_string(i));
             }
@@ -501,6 +571,7 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Link(
 
         DxrFallbackCompiler compiler(M.get(), shaderNames, maxAttributeSize, stackSizeInBytes, m_findCalledShaders);
         compiler.setDebugOutputLevel(m_debugOutput);
+        compiler.setMaxTraceRecursionDepth(maxTraceRecursionDepth);
         shaderEntryStateIds.resize(shaderCount);
         shaderStackSizes.resize(shaderCount);
         for (UINT i = 0; i < shaderCount; i++)
@@ -509,6 +580,8 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Link(
             shaderStackSizes[i] = pShaderInfo[i].StackSize;
         }
         compiler.link(shaderEntryStateIds, shaderStackSizes, m_pCachedMap.get());
+        if (stackSizeInBytes == 0 && maxTraceRecursionDepth > 0)
+            stackSizeInBytes = compiler.getStackSizeInBytes();
         if (m_debugOutput)
         {
             saveModuleToAsmFile(M.get(), "compiled.ll");
@@ -609,6 +682,29 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
   LLVMContext context;
   try
   {
+    // Compiles that dump modules or find shaders for tests aren't cached.
+    std::string cacheKey;
+    if (!m_findCalledShaders && !m_debugOutput)
+    {
+      cacheKey = GetCompileCacheKey(pShaderLibs, libCount, pShaderNames, shaderCount, maxAttributeSize);
+      std::lock_guard<std::mutex> lock(m_compileCacheMutex);
+      auto it = m_compileCache.find(cacheKey);
+      if (it != m_compileCache.end())
+      {
+        const CompileCacheEntry &entry = it->second;
+        m_compileCacheLru.splice(m_compileCacheLru.begin(), m_compileCacheLru, entry.lruPos);
+        CComPtr<AbstractMemoryStream> pDiagStream;
+        IFT(CreateMemoryStream(TM.p, &pDiagStream));
+        ULONG cbWritten;
+        IFT(pDiagStream->Write(entry.diag.data(), entry.diag.size(), &cbWritten));
+        CComPtr<IStream> pStream = pDiagStream;
+        std::string warnings;
+        dxcutil::CreateOperationResultFromOutputs(entry.pResult, pStream, warnings, false, ppResult);
+        std::copy(entry.shaderInfo.begin(), entry.shaderInfo.end(), pShaderInfo);
+        return hr;
+      }
+    }
+
     std::vector<CComPtr<IDxcBlobEncoding>> pLibs(libCount);
     for (UINT i = 0; i < libCount; i++)
     {
@@ -641,6 +737,7 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
     unsigned int valMajor = 0, valMinor = 0;
     dxcutil::GetValidatorVersion(&valMajor, &valMinor);
     std::unique_ptr<Module> M;
+    UINT32 configAttributeSize = 0, maxTraceRecursionDepth = 0;
     {
     DxilLinker* pLinker = DxilLinker::CreateLinker(context, valMajor, valMinor);
     for (UINT32 i = 0; i < libCount; ++i)
@@ -650,6 +747,7 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
       {
           return DXC_E_CONTAINER_MISSING_DXIL;
       }
+      GetPipelineLimits(dxil, configAttributeSize, maxTraceRecursionDepth);
       pLinker->RegisterLib(std::to_string(i), std::unique_ptr<Module>(dxil->GetModule()), nullptr);
       pLinker->AttachLib(std::to_string(i));
     }
@@ -697,6 +795,11 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
 
     std::vector<int> shaderEntryStateIds;
     std::vector<unsigned int> shaderStackSizes;
+    // No shader can report attributes larger than its shader config allows,
+    // so the attribute slots in the trace frames can be trimmed to that.
+    if (configAttributeSize > 0 && configAttributeSize < maxAttributeSize)
+      maxAttributeSize = configAttributeSize;
+
     DxrFallbackCompiler compiler(M.get(), shaderNames, maxAttributeSize, 0, m_findCalledShaders);
     compiler.setDebugOutputLevel(m_debugOutput);
     compiler.compile(shaderEntryStateIds, shaderStackSizes, m_pCachedMap.get());
@@ -744,6 +847,29 @@ HRESULT STDMETHODCALLTYPE DxcDxrFallbackCompiler::Compile(
         pShaderInfo[i].StackSize = shaderStackSizes[i];
         pShaderInfo[i].Type = shaderTypes[i];
     }
+
+    if (!cacheKey.empty() && pResultBlob && !hasErrors)
+    {
+      CompileCacheEntry entry;
+      entry.pResult = pResultBlob;
+      entry.diag.assign((const char *)pDiagStream->GetPtr(), pDiagStream->GetPtrSize());
+      entry.shaderInfo.assign(pShaderInfo, pShaderInfo + shaderCount);
+      std::lock_guard<std::mutex> lock(m_compileCacheMutex);
+      auto it = m_compileCache.find(cacheKey);
+      if (it != m_compileCache.end())
+      {
+        m_compileCacheLru.erase(it->second.lruPos);
+        m_compileCache.erase(it);
+      }
+      else if (m_compileCache.size() >= MaxCompileCacheEntries)
+      {
+        m_compileCache.erase(m_compileCacheLru.back());
+        m_compileCacheLru.pop_back();
+      }
+      m_compileCacheLru.push_front(cacheKey);
+      entry.lruPos = m_compileCacheLru.begin();
+      m_compileCache.emplace(cacheKey, std::move(entry));
+    }
   }
   CATCH_CPP_ASSIGN_HRESULT();
 
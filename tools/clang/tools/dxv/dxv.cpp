@@ -16,77 +16,255 @@
 #include "dxc/dxcapi.h"
 #include "dxc/dxcapi.internal.h"
 #include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/DxcJson.h"
 #include "dxc/Support/HLSLOptions.h"
 
+#include "dxc/DxilContainer/DxilContainer.h"
+
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MSFileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 using namespace dxc;
 using namespace llvm;
 using namespace llvm::opt;
 using namespace hlsl::options;
 
+static cl::list<std::string>
+InputFilenames(cl::Positional,
+               cl::desc("<input dxil files, directories or wildcards>"));
+
+static cl::opt<std::string>
+InputList("input-list",
+          cl::desc("Validate the files listed in this file, one per line"),
+          cl::value_desc("filename"));
+
 static cl::opt<std::string>
-InputFilename(cl::Positional, cl::desc("<input dxil file>"), cl::init("-"));
+ResultsFilename("results",
+                cl::desc("Write a JSON list of per-file results"),
+                cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+ThreadCount("j", cl::desc("Number of threads validating files in parallel "
+                          "(default: one per core)"),
+            cl::init(0));
+
+struct DxvResult {
+  std::string FileName;
+  HRESULT Status;
+  std::string Message;
+  double Milliseconds;
+};
 
 class DxvContext {
 private:
   DxcDllSupport &m_dxcSupport;
+
+  void ValidateFile(const std::string &FileName, DxvResult &Result);
 public:
   DxvContext(DxcDllSupport &dxcSupport)
       : m_dxcSupport(dxcSupport) {}
 
-  void Validate();
+  void Validate(const std::string &FileName);
+  int ValidateBatch(ArrayRef<std::string> FileNames);
 };
 
-void DxvContext::Validate() {
-  CComPtr<IDxcOperationResult> pCompileResult;
+// Validates a container, or assembly that is assembled first. Failures go to
+// Result; only failures of the tool itself throw.
+void DxvContext::ValidateFile(const std::string &FileName, DxvResult &Result) {
+  Result.FileName = FileName;
+  Result.Status = S_OK;
 
-  {
-    CComPtr<IDxcBlobEncoding> pSource;
-    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(InputFilename), &pSource);
+  CComPtr<IDxcBlobEncoding> pSource;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(FileName), &pSource);
 
+  CComPtr<IDxcBlob> pContainerBlob;
+  if (pSource->GetBufferSize() >= sizeof(uint32_t) &&
+      *(const uint32_t *)pSource->GetBufferPointer() == hlsl::DFCC_Container) {
+    pContainerBlob = pSource;
+  } else {
     CComPtr<IDxcAssembler> pAssembler;
     CComPtr<IDxcOperationResult> pAsmResult;
-
-    CComPtr<IDxcBlob> pContainerBlob;
-    HRESULT resultStatus;
-
     IFT(m_dxcSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
     IFT(pAssembler->AssembleToContainer(pSource, &pAsmResult));
-    IFT(pAsmResult->GetStatus(&resultStatus));
-    if (FAILED(resultStatus)) {
+    IFT(pAsmResult->GetStatus(&Result.Status));
+    if (FAILED(Result.Status)) {
       CComPtr<IDxcBlobEncoding> text;
       IFT(pAsmResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(resultStatus, msg);
+      Result.Message = (const char *)text->GetBufferPointer();
       return;
     }
     IFT(pAsmResult->GetResult(&pContainerBlob));
+  }
 
-    CComPtr<IDxcValidator> pValidator;
-    CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcOperationResult> pResult;
 
-    IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
-    IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  IFT(pValidator->Validate(pContainerBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+  IFT(pResult->GetStatus(&Result.Status));
 
-    HRESULT status;
-    IFT(pResult->GetStatus(&status));
+  if (FAILED(Result.Status)) {
+    CComPtr<IDxcBlobEncoding> text;
+    IFT(pResult->GetErrorBuffer(&text));
+    Result.Message = (const char *)text->GetBufferPointer();
+  }
+}
 
-    if (FAILED(status)) {
-      CComPtr<IDxcBlobEncoding> text;
-      IFT(pResult->GetErrorBuffer(&text));
-      const char *pStart = (const char *)text->GetBufferPointer();
-      std::string msg(pStart);
-      IFTMSG(status, msg);
-    } else {
-      printf("Validation succeed.");
+void DxvContext::Validate(const std::string &FileName) {
+  DxvResult Result;
+  ValidateFile(FileName, Result);
+  if (FAILED(Result.Status))
+    IFTMSG(Result.Status, Result.Message);
+  printf("Validation succeed.");
+}
+
+// Validates the files on a pool of threads that share the loaded validator,
+// then prints a summary and writes the per-file results if asked to.
+// Returns the process exit code.
+int DxvContext::ValidateBatch(ArrayRef<std::string> FileNames) {
+  std::vector<DxvResult> Results(FileNames.size());
+  std::atomic<size_t> Next(0);
+  auto worker = [&]() {
+    for (size_t i = Next++; i < FileNames.size(); i = Next++) {
+      DxvResult &Result = Results[i];
+      auto Start = std::chrono::steady_clock::now();
+      try {
+        ValidateFile(FileNames[i], Result);
+      } catch (const ::hlsl::Exception &hlslException) {
+        Result.FileName = FileNames[i];
+        Result.Status = FAILED(hlslException.hr) ? hlslException.hr : E_FAIL;
+        Result.Message = hlslException.msg;
+      } catch (...) {
+        Result.FileName = FileNames[i];
+        Result.Status = E_FAIL;
+        Result.Message = "unknown error";
+      }
+      Result.Milliseconds = std::chrono::duration<double, std::milli>(
+          std::chrono::steady_clock::now() - Start).count();
     }
+  };
+
+  unsigned Threads = ThreadCount ? (unsigned)ThreadCount
+                                 : std::thread::hardware_concurrency();
+  Threads = std::max(1u, std::min<unsigned>(Threads, FileNames.size()));
+  auto Start = std::chrono::steady_clock::now();
+  if (Threads > 1) {
+    std::vector<std::thread> Pool;
+    for (unsigned i = 0; i < Threads; ++i)
+      Pool.emplace_back(worker);
+    for (std::thread &T : Pool)
+      T.join();
+  } else {
+    worker();
   }
+  double Seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - Start).count();
+
+  size_t Failed = 0;
+  for (const DxvResult &Result : Results) {
+    if (SUCCEEDED(Result.Status))
+      continue;
+    ++Failed;
+    StringRef FirstLine = StringRef(Result.Message).split('\n').first;
+    printf("%s: failed - error code 0x%08x%s%s\n", Result.FileName.c_str(),
+           (unsigned)Result.Status, FirstLine.empty() ? "" : ": ",
+           FirstLine.str().c_str());
+  }
+  printf("Validated %u files in %.2f s on %u threads: %u succeeded, %u "
+         "failed.\n",
+         (unsigned)Results.size(), Seconds, Threads,
+         (unsigned)(Results.size() - Failed), (unsigned)Failed);
+
+  if (!ResultsFilename.empty()) {
+    std::error_code EC;
+    raw_fd_ostream OS(ResultsFilename, EC, sys::fs::F_Text);
+    if (EC)
+      throw ::hlsl::Exception(E_FAIL, "cannot open " + ResultsFilename +
+                                          ": " + EC.message());
+    OS << "[";
+    for (size_t i = 0; i < Results.size(); ++i) {
+      const DxvResult &Result = Results[i];
+      OS << (i ? ",\n" : "\n") << "  {\"file\": ";
+      hlsl::WriteJsonString(OS, Result.FileName);
+      OS << ", \"valid\": " << (SUCCEEDED(Result.Status) ? "true" : "false")
+         << ", \"status\": " << format("%u", (unsigned)Result.Status)
+         << ", \"ms\": " << format("%.3f", Result.Milliseconds)
+         << ", \"message\": ";
+      hlsl::WriteJsonString(OS, Result.Message);
+      OS << "}";
+    }
+    OS << "\n]\n";
+  }
+  return Failed ? 1 : 0;
+}
+
+// Matches a file name against a pattern of '*' and '?' wildcards.
+static bool MatchWildcard(StringRef Pattern, StringRef Name) {
+  if (Pattern.empty())
+    return Name.empty();
+  if (Pattern[0] == '*') {
+    for (size_t i = 0; i <= Name.size(); ++i) {
+      if (MatchWildcard(Pattern.substr(1), Name.substr(i)))
+        return true;
+    }
+    return false;
+  }
+  return !Name.empty() && (Pattern[0] == '?' || Pattern[0] == Name[0]) &&
+         MatchWildcard(Pattern.substr(1), Name.substr(1));
+}
+
+// Expands an input into the files to validate: a directory into the files
+// under it, and wildcards in the last path component into the matching files.
+static void ExpandInput(StringRef Input, std::vector<std::string> &FileNames) {
+  std::error_code EC;
+  if (sys::fs::is_directory(Input)) {
+    for (sys::fs::recursive_directory_iterator It(Input, EC), End;
+         It != End && !EC; It.increment(EC)) {
+      if (sys::fs::is_regular_file(It->path()))
+        FileNames.push_back(It->path());
+    }
+  } else if (sys::path::filename(Input).find_first_of("*?") !=
+             StringRef::npos) {
+    StringRef Pattern = sys::path::filename(Input);
+    StringRef Dir = sys::path::parent_path(Input);
+    size_t First = FileNames.size();
+    for (sys::fs::directory_iterator It(Dir.empty() ? "." : Dir, EC), End;
+         It != End && !EC; It.increment(EC)) {
+      if (MatchWildcard(Pattern, sys::path::filename(It->path())) &&
+          sys::fs::is_regular_file(It->path()))
+        FileNames.push_back(It->path());
+    }
+    std::sort(FileNames.begin() + First, FileNames.end());
+  } else {
+    FileNames.push_back(Input);
+  }
+  if (EC)
+    throw ::hlsl::Exception(E_FAIL, "cannot list " + Input.str() + ": " +
+                                        EC.message());
 }
 
 int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
   const char *pStage = "Operation";
+  if (llvm::sys::fs::SetupPerThreadFileSystem())
+    return 1;
+  llvm::sys::fs::AutoCleanupPerThreadFileSystem auto_cleanup_fs;
+  llvm::sys::fs::MSFileSystem *msfPtr;
+  if (FAILED(CreateMSFileSystemForDisk(&msfPtr)))
+    return 1;
+  std::unique_ptr<llvm::sys::fs::MSFileSystem> msf(msfPtr);
+  llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
   try {
     pStage = "Argument processing";
 
@@ -97,8 +275,35 @@ int __cdecl main(int argc,  _In_reads_z_(argc) const char **argv) {
     dxc::EnsureEnabled(dxcSupport);
 
     DxvContext context(dxcSupport);
+
+    // Several inputs, a directory, wildcards, a list or a results file
+    // validate in batch; a single file keeps the one-shot output.
+    bool bBatch = InputFilenames.size() > 1 || !InputList.empty() ||
+                  !ResultsFilename.empty();
+    std::vector<std::string> FileNames;
+    for (const std::string &Input : InputFilenames)
+      ExpandInput(Input, FileNames);
+    if (!InputList.empty()) {
+      ErrorOr<std::unique_ptr<MemoryBuffer>> List =
+          MemoryBuffer::getFile(InputList);
+      if (!List)
+        throw ::hlsl::Exception(E_FAIL, "cannot read " + InputList + ": " +
+                                            List.getError().message());
+      SmallVector<StringRef, 16> Lines;
+      (*List)->getBuffer().split(Lines, "\n", -1, false);
+      for (StringRef Line : Lines) {
+        Line = Line.trim();
+        if (!Line.empty())
+          ExpandInput(Line, FileNames);
+      }
+    }
+    if (!InputFilenames.empty())
+      bBatch |= FileNames.size() != 1 || FileNames.front() != InputFilenames.front();
+
     pStage = "Validation";
-    context.Validate();
+    if (bBatch)
+      return context.ValidateBatch(FileNames);
+    context.Validate(FileNames.empty() ? "-" : FileNames.front());
   } catch (const ::hlsl::Exception &hlslException) {
     try {
       const char *msg = hlslException.what();
@@ -83,6 +83,7 @@ CXTranslationUnit cxtu::MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *AU) {
   D->StringPool = new cxstring::CXStringPool();
   D->Diagnostics = nullptr;
   D->OverridenCursorsPool = createOverridenCXCursorsPool();
+  D->ReferencesIndex = nullptr; // HLSL Change
   D->CommentToXML = nullptr;
   return D;
 }
@@ -2985,8 +2986,9 @@ enum CXErrorCode clang_createTranslationUnit2(CXIndex CIdx,
 }
 
 unsigned clang_defaultEditingTranslationUnitOptions() {
-  return CXTranslationUnit_PrecompiledPreamble | 
-         CXTranslationUnit_CacheCompletionResults;
+  // HLSL Change - without serialization, the preamble option skips the bodies
+  // of included functions instead, which callers must ask for.
+  return CXTranslationUnit_CacheCompletionResults;
 }
 
 CXTranslationUnit
@@ -3329,6 +3331,7 @@ void clang_disposeTranslationUnit(CXTranslationUnit CTUnit) {
     delete CTUnit->StringPool;
     delete static_cast<CXDiagnosticSetImpl *>(CTUnit->Diagnostics);
     disposeOverridenCXCursorsPool(CTUnit->OverridenCursorsPool);
+    disposeReferencesIndex(CTUnit->ReferencesIndex); // HLSL Change
     delete CTUnit->CommentToXML;
     delete CTUnit;
   }
@@ -3363,6 +3366,11 @@ static void clang_reparseTranslationUnit_Impl(void *UserData) {
   delete static_cast<CXDiagnosticSetImpl*>(TU->Diagnostics);
   TU->Diagnostics = nullptr;
 
+  // HLSL Change Starts - the indexed cursors point into the old AST.
+  disposeReferencesIndex(TU->ReferencesIndex);
+  TU->ReferencesIndex = nullptr;
+  // HLSL Change Ends
+
   CIndexer *CXXIdx = TU->CIdx;
   if (CXXIdx->isOptEnabled(CXGlobalOpt_ThreadBackgroundPriorityForEditing))
     setThreadBackgroundPriority();
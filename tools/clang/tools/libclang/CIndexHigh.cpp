@@ -15,6 +15,7 @@
 #include "clang/AST/DeclObjC.h"
 #include "clang/Frontend/ASTUnit.h"
 #include "llvm/Support/Compiler.h"
+#include <map> // HLSL Change
 
 using namespace clang;
 using namespace cxcursor;
@@ -76,7 +77,7 @@ struct FindFileIdRefVisitData {
   ///
   /// we consider the canonical decl of the constructor decl to be the class
   /// itself, so both 'C' can be highlighted.
-  const Decl *getCanonical(const Decl *D) const {
+  static const Decl *getCanonical(const Decl *D) { // HLSL Change - static
     if (!D)
       return nullptr;
 
@@ -144,6 +145,53 @@ static SourceLocation getFileSpellingLoc(SourceManager &SM,
   return SpellLoc;
 }
 
+// HLSL Change Starts - shared by the visit and the references index
+/// \brief Gets the location to report for a reference to a hit declaration,
+/// or an invalid location if the reference is not reported in the file.
+static SourceLocation getFileIdRefLoc(ASTContext &Ctx, FileID FID,
+                                      CXCursor cursor) {
+  if (clang_isExpression(cursor.kind)) {
+    if (cursor.kind == CXCursor_DeclRefExpr ||
+        cursor.kind == CXCursor_MemberRefExpr) {
+      // continue..
+
+    } else if (cursor.kind == CXCursor_ObjCMessageExpr &&
+               cxcursor::getSelectorIdentifierIndex(cursor) != -1) {
+      // continue..
+              
+    } else
+      return SourceLocation();
+  }
+
+  SourceLocation
+    Loc = cxloc::translateSourceLocation(clang_getCursorLocation(cursor));
+  SourceLocation SelIdLoc = cxcursor::getSelectorIdentifierLoc(cursor);
+  if (SelIdLoc.isValid())
+    Loc = SelIdLoc;
+
+  SourceManager &SM = Ctx.getSourceManager();
+  bool isInMacroDef = false;
+  if (Loc.isMacroID()) {
+    bool isMacroArg;
+    Loc = getFileSpellingLoc(SM, Loc, isMacroArg);
+    isInMacroDef = !isMacroArg;
+  }
+
+  // We are looking for identifiers in a specific file.
+  std::pair<FileID, unsigned> LocInfo = SM.getDecomposedLoc(Loc);
+  if (LocInfo.first != FID)
+    return SourceLocation();
+
+  if (isInMacroDef) {
+    // FIXME: For a macro definition make sure that all expansions
+    // of it expand to the same reference before allowing to point to it.
+    return SourceLocation();
+  }
+
+  return Loc;
+}
+// HLSL Change Ends
+
 static enum CXChildVisitResult findFileIdRefVisit(CXCursor cursor,
                                                   CXCursor parent,
                                                   CXClientData client_data) {
@@ -166,45 +214,11 @@ static enum CXChildVisitResult findFileIdRefVisit(CXCursor cursor,
          cxcursor::getSelectorIdentifierIndex(cursor) == -1)
       return CXChildVisit_Recurse;
 
-    if (clang_isExpression(cursor.kind)) {
-      if (cursor.kind == CXCursor_DeclRefExpr ||
-          cursor.kind == CXCursor_MemberRefExpr) {
-        // continue..
-
-      } else if (cursor.kind == CXCursor_ObjCMessageExpr &&
-                 cxcursor::getSelectorIdentifierIndex(cursor) != -1) {
-        // continue..
-                
-      } else
-        return CXChildVisit_Recurse;
-    }
-
-    SourceLocation
-      Loc = cxloc::translateSourceLocation(clang_getCursorLocation(cursor));
-    SourceLocation SelIdLoc = cxcursor::getSelectorIdentifierLoc(cursor);
-    if (SelIdLoc.isValid())
-      Loc = SelIdLoc;
-
     ASTContext &Ctx = data->getASTContext();
-    SourceManager &SM = Ctx.getSourceManager();
-    bool isInMacroDef = false;
-    if (Loc.isMacroID()) {
-      bool isMacroArg;
-      Loc = getFileSpellingLoc(SM, Loc, isMacroArg);
-      isInMacroDef = !isMacroArg;
-    }
-
-    // We are looking for identifiers in a specific file.
-    std::pair<FileID, unsigned> LocInfo = SM.getDecomposedLoc(Loc);
-    if (LocInfo.first != data->FID)
+    SourceLocation Loc = getFileIdRefLoc(Ctx, data->FID, cursor);
+    if (Loc.isInvalid())
       return CXChildVisit_Recurse;
 
-    if (isInMacroDef) {
-      // FIXME: For a macro definition make sure that all expansions
-      // of it expand to the same reference before allowing to point to it.
-      return CXChildVisit_Recurse;
-    }
-
     if (data->visitor.visit(data->visitor.context, cursor,
                         cxloc::translateSourceRange(Ctx, Loc)) == CXVisit_Break)
       return CXChildVisit_Break;
@@ -212,6 +226,93 @@ static enum CXChildVisitResult findFileIdRefVisit(CXCursor cursor,
   return CXChildVisit_Recurse;
 }
 
+// HLSL Change Starts - per-file references index
+// Finding the references of a declaration walks the whole file, and editors
+// look up the references of every symbol under the caret. The references of
+// a file are instead gathered once per parse, keyed by their declaration, and
+// replayed for each query. The index is dropped when the TU is reparsed.
+namespace {
+
+struct FileIdRefs {
+  typedef std::pair<CXCursor, SourceLocation> RefTy;
+  llvm::DenseMap<const Decl *, SmallVector<RefTy, 4> > Refs;
+};
+
+struct IdRefsIndex {
+  std::map<const FileEntry *, FileIdRefs> Files;
+};
+
+struct IndexFileIdRefsData {
+  ASTContext &Ctx;
+  FileID FID;
+  FileIdRefs &FileRefs;
+
+  IndexFileIdRefsData(ASTContext &Ctx, FileID FID, FileIdRefs &FileRefs)
+    : Ctx(Ctx), FID(FID), FileRefs(FileRefs) { }
+};
+
+} // anonymous namespace
+
+void cxtu::disposeReferencesIndex(void *Index) {
+  delete static_cast<IdRefsIndex *>(Index);
+}
+
+static enum CXChildVisitResult indexFileIdRefVisit(CXCursor cursor,
+                                                   CXCursor parent,
+                                                   CXClientData client_data) {
+  CXCursor declCursor = clang_getCursorReferenced(cursor);
+  if (!clang_isDeclaration(declCursor.kind))
+    return CXChildVisit_Recurse;
+
+  const Decl *D = cxcursor::getCursorDecl(declCursor);
+  if (!D)
+    return CXChildVisit_Continue;
+
+  IndexFileIdRefsData *data = (IndexFileIdRefsData *)client_data;
+  SourceLocation Loc = getFileIdRefLoc(data->Ctx, data->FID, cursor);
+  if (Loc.isValid()) {
+    const Decl *Canon = FindFileIdRefVisitData::getCanonical(D);
+    data->FileRefs.Refs[Canon].push_back(std::make_pair(cursor, Loc));
+  }
+  return CXChildVisit_Recurse;
+}
+
+/// \brief Whether the references of a declaration are exactly those the
+/// index holds for it, i.e. no other declaration can be a hit.
+static bool canUseIdRefsIndex(const Decl *D, int SelectorIdIdx) {
+  if (SelectorIdIdx != -1 || isa<ObjCMethodDecl>(D))
+    return false;
+  if (const CXXMethodDecl *MD = dyn_cast<CXXMethodDecl>(D))
+    return !MD->isVirtual();
+  return true;
+}
+
+static const FileIdRefs &getFileIdRefs(CXTranslationUnit TU, FileID FID,
+                                       const FileEntry *File) {
+  if (!TU->ReferencesIndex)
+    TU->ReferencesIndex = new IdRefsIndex();
+  IdRefsIndex &Index = *static_cast<IdRefsIndex *>(TU->ReferencesIndex);
+
+  std::map<const FileEntry *, FileIdRefs>::iterator I = Index.Files.find(File);
+  if (I != Index.Files.end())
+    return I->second;
+
+  FileIdRefs &FileRefs = Index.Files[File];
+  ASTUnit *Unit = cxtu::getASTUnit(TU);
+  SourceManager &SM = Unit->getSourceManager();
+  IndexFileIdRefsData data(Unit->getASTContext(), FID, FileRefs);
+  SourceRange Range(SM.getLocForStartOfFile(FID), SM.getLocForEndOfFile(FID));
+  CursorVisitor IndexVisitor(TU,
+                             indexFileIdRefVisit, &data,
+                             /*VisitPreprocessorLast=*/true,
+                             /*VisitIncludedEntities=*/false,
+                             Range,
+                             /*VisitDeclsOnly=*/true);
+  IndexVisitor.visitFileRegion();
+  return FileRefs;
+}
+// HLSL Change Ends
+
 static bool findIdRefsInFile(CXTranslationUnit TU, CXCursor declCursor,
                              const FileEntry *File,
                              CXCursorAndRangeVisitor Visitor) {
@@ -232,6 +333,23 @@ static bool findIdRefsInFile(CXTranslationUnit TU, CXCursor declCursor,
                                findFileIdRefVisit, &data);
   }
 
+  // HLSL Change Starts - answer from the per-file references index
+  if (canUseIdRefsIndex(data.Dcl, data.SelectorIdIdx)) {
+    const FileIdRefs &FileRefs = getFileIdRefs(TU, FID, File);
+    auto Hits = FileRefs.Refs.find(data.Dcl);
+    if (Hits == FileRefs.Refs.end())
+      return false;
+    ASTContext &Ctx = data.getASTContext();
+    for (const FileIdRefs::RefTy &Ref : Hits->second) {
+      if (Visitor.visit(Visitor.context, Ref.first,
+                        cxloc::translateSourceRange(Ctx, Ref.second)) ==
+          CXVisit_Break)
+        return true;
+    }
+    return false;
+  }
+  // HLSL Change Ends
+
   SourceRange Range(SM.getLocForStartOfFile(FID), SM.getLocForEndOfFile(FID));
   CursorVisitor FindIdRefsVisitor(TU,
                                   findFileIdRefVisit, &data,
@@ -32,6 +32,7 @@ struct CXTranslationUnitImpl {
   clang::cxstring::CXStringPool *StringPool;
   void *Diagnostics;
   void *OverridenCursorsPool;
+  void *ReferencesIndex; // HLSL Change
   clang::index::CommentToXMLConverter *CommentToXML;
 };
 
@@ -40,6 +41,11 @@ namespace cxtu {
 
 CXTranslationUnitImpl *MakeCXTranslationUnit(CIndexer *CIdx, ASTUnit *AU);
 
+// HLSL Change Starts
+/// \brief Disposes the references index built by clang_findReferencesInFile.
+void disposeReferencesIndex(void *Index);
+// HLSL Change Ends
+
 static inline ASTUnit *getASTUnit(CXTranslationUnit TU) {
   if (!TU)
     return nullptr;
@@ -1648,10 +1648,23 @@ HRESULT DxcTranslationUnit::Reparse(
   DxcThreadMalloc TM(m_pMalloc);
   hr = SetupUnsavedFiles(unsaved_files, num_unsaved_files, &local_unsaved_files);
   if (FAILED(hr)) return hr;
-  int reparseResult = clang_reparseTranslationUnit(
-    m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
+  try
+  {
+    // Included files that aren't unsaved are read again from disk, as when
+    // the translation unit was first parsed.
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+    int reparseResult = clang_reparseTranslationUnit(
+      m_tu, num_unsaved_files, local_unsaved_files, clang_defaultReparseOptions(m_tu));
+    hr = reparseResult == 0 ? S_OK : E_FAIL;
+  }
+  CATCH_CPP_ASSIGN_HRESULT();
   CleanupUnsavedFiles(local_unsaved_files, num_unsaved_files);
-  return reparseResult == 0 ? S_OK : E_FAIL;
+  return hr;
 }
 
 _Use_decl_annotations_
@@ -63,37 +63,62 @@ public:
   }
 };
 
+// Calls may name a prototype; the body is on the definition.
+static FunctionDecl *GetDefinitionOrSelf(FunctionDecl *fnDecl) {
+  const FunctionDecl *definition;
+  if (fnDecl->isDefined(definition))
+    return const_cast<FunctionDecl *>(definition);
+  return fnDecl;
+}
+
 class VarReferenceVisitor : public RecursiveASTVisitor<VarReferenceVisitor> {
 private:
   SmallPtrSet<VarDecl*, 128>& m_unusedGlobals;
   SmallPtrSet<FunctionDecl*, 128>& m_visitedFunctions;
   SmallVector<FunctionDecl*, 32>& m_pendingFunctions;
+  SmallVector<VarDecl*, 32>& m_pendingGlobals;
+
+  void AddPendingFunction(FunctionDecl *fnDecl) {
+    fnDecl = GetDefinitionOrSelf(fnDecl);
+    if (!m_visitedFunctions.count(fnDecl)) {
+      m_pendingFunctions.push_back(fnDecl);
+    }
+  }
 public:
   VarReferenceVisitor(
     SmallPtrSet<VarDecl*, 128>& unusedGlobals,
     SmallPtrSet<FunctionDecl*, 128>& visitedFunctions,
-    SmallVector<FunctionDecl*, 32>& pendingFunctions) :
+    SmallVector<FunctionDecl*, 32>& pendingFunctions,
+    SmallVector<VarDecl*, 32>& pendingGlobals) :
     m_unusedGlobals(unusedGlobals),
     m_visitedFunctions(visitedFunctions),
-    m_pendingFunctions(pendingFunctions) {
+    m_pendingFunctions(pendingFunctions),
+    m_pendingGlobals(pendingGlobals) {
   }
 
   bool VisitDeclRefExpr(DeclRefExpr* ref) {
     ValueDecl* valueDecl = ref->getDecl();
     FunctionDecl* fnDecl = dyn_cast_or_null<FunctionDecl>(valueDecl);
     if (fnDecl != nullptr) {
-      if (!m_visitedFunctions.count(fnDecl)) {
-        m_pendingFunctions.push_back(fnDecl);
-      }
+      AddPendingFunction(fnDecl);
     }
     else {
       VarDecl* varDecl = dyn_cast_or_null<VarDecl>(valueDecl);
-      if (varDecl != nullptr) {
-        m_unusedGlobals.erase(varDecl);
+      if (varDecl != nullptr && m_unusedGlobals.erase(varDecl)) {
+        // The initializer of a used global is reached as well.
+        if (varDecl->hasInit())
+          m_pendingGlobals.push_back(varDecl);
       }
     }
     return true;
   }
+
+  bool VisitMemberExpr(MemberExpr* ref) {
+    // Method bodies may call functions and use globals of their own.
+    if (CXXMethodDecl *methodDecl = dyn_cast<CXXMethodDecl>(ref->getMemberDecl()))
+      AddPendingFunction(methodDecl);
+    return true;
+  }
 };
 
 static void raw_string_ostream_to_CoString(raw_string_ostream &o, _Outptr_result_z_ LPSTR *pResult) {
@@ -361,36 +386,19 @@ HRESULT ReadOptsAndValidate(LPCWSTR *pArguments, _In_ UINT32 argCount,
 }
 
 
-static
-HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
-                     _In_ LPCSTR pFileName,
-                     _In_ ASTUnit::RemappedFile *pRemap,
-                     _In_ LPCSTR pEntryPoint,
-                     _In_ LPCSTR pDefines,
-                     _Outptr_result_z_ LPSTR *pWarnings,
-                     _Outptr_result_z_ LPSTR *pResult) {
-  if (pWarnings != nullptr) *pWarnings = nullptr;
-  if (pResult != nullptr) *pResult = nullptr;
-
-  std::string s, warnings;
-  raw_string_ostream o(s);
-  raw_string_ostream w(warnings);
-
-  // Setup a compiler instance.
-  CompilerInstance compiler;
-  std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
-      llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());  
-
-  hlsl::options::DxcOpts opts;
-  opts.HLSLVersion = 2015;
-
-  SetupCompilerForRewrite(compiler, pHelper, pFileName, diagPrinter.get(), pRemap, opts, pDefines);
-
-  // Parse the source file.
-  compiler.getDiagnosticClient().BeginSourceFile(compiler.getLangOpts(), &compiler.getPreprocessor());
-  ParseAST(compiler.getSema(), false, false);
+enum class UnusedRemoval {
+  EntryNotFound,
+  EntryNotFunction,
+  NothingRemoved,
+  Removed,
+};
 
-  ASTContext& C = compiler.getASTContext();
+// Removes the global variables that the entry point doesn't use, along with
+// the functions it doesn't reach. With requireUnusedGlobals, nothing is
+// removed unless there are unused globals.
+static UnusedRemoval RemoveUnusedDecls(ASTContext &C, _In_ LPCSTR pEntryPoint,
+                                       bool requireUnusedGlobals,
+                                       raw_ostream &w) {
   TranslationUnitDecl *tu = C.getTranslationUnitDecl();
 
   // Gather all global variables that are not in cbuffers and all functions.
@@ -418,59 +426,119 @@ HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
   DeclContext::lookup_result l = tu->lookup(DeclarationName(&C.Idents.get(StringRef(pEntryPoint))));
   if (l.empty()) {
     w << "//entry point not found\n";
+    return UnusedRemoval::EntryNotFound;
   }
-  else {
-    w << "//entry point found\n";
-    NamedDecl *entryDecl = l.front();
-    FunctionDecl *entryFnDecl = dyn_cast_or_null<FunctionDecl>(entryDecl);
-    if (entryFnDecl == nullptr) {
-      o << "//entry point found but is not a function declaration\n";
+
+  w << "//entry point found\n";
+  NamedDecl *entryDecl = l.front();
+  FunctionDecl *entryFnDecl = dyn_cast_or_null<FunctionDecl>(entryDecl);
+  if (entryFnDecl == nullptr)
+    return UnusedRemoval::EntryNotFunction;
+
+  // Traverse reachable functions and variables.
+  SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
+  SmallVector<FunctionDecl*, 32> pendingFunctions;
+  SmallVector<VarDecl*, 32> pendingGlobals;
+  VarReferenceVisitor visitor(unusedGlobals, visitedFunctions, pendingFunctions, pendingGlobals);
+  pendingFunctions.push_back(GetDefinitionOrSelf(entryFnDecl));
+  // A hull shader also reaches its patch constant function.
+  if (HLSLPatchConstantFuncAttr *attr = entryFnDecl->getAttr<HLSLPatchConstantFuncAttr>()) {
+    DeclContext::lookup_result pcl = tu->lookup(DeclarationName(&C.Idents.get(attr->getFunctionName())));
+    for (NamedDecl *pcDecl : pcl) {
+      if (FunctionDecl *pcFnDecl = dyn_cast<FunctionDecl>(pcDecl))
+        pendingFunctions.push_back(GetDefinitionOrSelf(pcFnDecl));
     }
-    else {
-      // Traverse reachable functions and variables.
-      SmallPtrSet<FunctionDecl*, 128> visitedFunctions;
-      SmallVector<FunctionDecl*, 32> pendingFunctions;
-      VarReferenceVisitor visitor(unusedGlobals, visitedFunctions, pendingFunctions);
-      pendingFunctions.push_back(entryFnDecl);
-      while (!pendingFunctions.empty() && !unusedGlobals.empty()) {
-        FunctionDecl* pendingDecl = pendingFunctions.pop_back_val();
-        visitedFunctions.insert(pendingDecl);
-        visitor.TraverseDecl(pendingDecl);
-      }
+  }
+  while ((!pendingFunctions.empty() || !pendingGlobals.empty()) &&
+         (!requireUnusedGlobals || !unusedGlobals.empty())) {
+    if (!pendingGlobals.empty()) {
+      visitor.TraverseStmt(pendingGlobals.pop_back_val()->getInit());
+      continue;
+    }
+    FunctionDecl* pendingDecl = pendingFunctions.pop_back_val();
+    if (!visitedFunctions.insert(pendingDecl).second)
+      continue;
+    visitor.TraverseDecl(pendingDecl);
+  }
 
-      // Don't bother doing work if there are no globals to remove.
-      if (unusedGlobals.empty()) {
-        w << "//no unused globals found - no work to be done\n";
-        StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
-        o << contents;
-      }
-      else {
-        w << "//found " << unusedGlobals.size() << " globals to remove\n";
+  // Don't bother doing work if there are no globals to remove.
+  if (requireUnusedGlobals && unusedGlobals.empty()) {
+    w << "//no unused globals found - no work to be done\n";
+    return UnusedRemoval::NothingRemoved;
+  }
+  w << "//found " << unusedGlobals.size() << " globals to remove\n";
 
-        // Don't remove visited functions.
-        for (FunctionDecl *visitedFn : visitedFunctions) {
-          unusedFunctions.erase(visitedFn);
-        }
-        w << "//found " << unusedFunctions.size() << " functions to remove\n";
+  // Don't remove visited functions.
+  for (FunctionDecl *visitedFn : visitedFunctions) {
+    unusedFunctions.erase(visitedFn);
+  }
+  w << "//found " << unusedFunctions.size() << " functions to remove\n";
 
-        // Remove all unused variables and functions.
-        auto globalsEnd = unusedGlobals.end();
-        for (auto && unusedGlobal = unusedGlobals.begin(); unusedGlobal != globalsEnd; ++unusedGlobal) {
-          tu->removeDecl(*unusedGlobal);
-        }
+  if (unusedGlobals.empty() && unusedFunctions.empty())
+    return UnusedRemoval::NothingRemoved;
 
-        for (FunctionDecl *unusedFn : unusedFunctions) {
-          tu->removeDecl(unusedFn);
-        }
+  // Remove all unused variables and functions.
+  auto globalsEnd = unusedGlobals.end();
+  for (auto && unusedGlobal = unusedGlobals.begin(); unusedGlobal != globalsEnd; ++unusedGlobal) {
+    tu->removeDecl(*unusedGlobal);
+  }
 
-        o << "// Rewrite unused globals result:\n";
-        PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
-        p.Indentation = 1;
-        tu->print(o, p);
+  for (FunctionDecl *unusedFn : unusedFunctions) {
+    tu->removeDecl(unusedFn);
+  }
+  return UnusedRemoval::Removed;
+}
 
-        WriteSemanticDefines(compiler, pHelper, o);
-      }
-    }
+static
+HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
+                     _In_ LPCSTR pFileName,
+                     _In_ ASTUnit::RemappedFile *pRemap,
+                     _In_ LPCSTR pEntryPoint,
+                     _In_ LPCSTR pDefines,
+                     _Outptr_result_z_ LPSTR *pWarnings,
+                     _Outptr_result_z_ LPSTR *pResult) {
+  if (pWarnings != nullptr) *pWarnings = nullptr;
+  if (pResult != nullptr) *pResult = nullptr;
+
+  std::string s, warnings;
+  raw_string_ostream o(s);
+  raw_string_ostream w(warnings);
+
+  // Setup a compiler instance.
+  CompilerInstance compiler;
+  std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+      llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());  
+
+  hlsl::options::DxcOpts opts;
+  opts.HLSLVersion = 2015;
+
+  SetupCompilerForRewrite(compiler, pHelper, pFileName, diagPrinter.get(), pRemap, opts, pDefines);
+
+  // Parse the source file.
+  compiler.getDiagnosticClient().BeginSourceFile(compiler.getLangOpts(), &compiler.getPreprocessor());
+  ParseAST(compiler.getSema(), false, false);
+
+  ASTContext& C = compiler.getASTContext();
+  switch (RemoveUnusedDecls(C, pEntryPoint, /*requireUnusedGlobals*/true, w)) {
+  case UnusedRemoval::EntryNotFound:
+    break;
+  case UnusedRemoval::EntryNotFunction:
+    o << "//entry point found but is not a function declaration\n";
+    break;
+  case UnusedRemoval::NothingRemoved: {
+    StringRef contents = C.getSourceManager().getBufferData(C.getSourceManager().getMainFileID());
+    o << contents;
+    break;
+  }
+  case UnusedRemoval::Removed: {
+    o << "// Rewrite unused globals result:\n";
+    PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
+    p.Indentation = 1;
+    C.getTranslationUnitDecl()->print(o, p);
+
+    WriteSemanticDefines(compiler, pHelper, o);
+    break;
+  }
   }
 
   // Flush and return results.
@@ -482,6 +550,61 @@ HRESULT DoRewriteUnused(_In_ DxcLangExtensionsHelper *pHelper,
   return S_OK;
 }
 
+// Strips preprocessed source down to what the entry point reaches, for
+// compiles with -strip-unused-before-codegen. Fails if the source has errors
+// or the entry point isn't found, in which case the caller compiles the
+// source as given. The result is the source unchanged if nothing is unused.
+HRESULT DxcRewriteUnusedForEntry(_In_ DxcLangExtensionsHelper *pHelper,
+                                 StringRef preprocessed,
+                                 _In_ LPCSTR pEntryPoint,
+                                 _In_ hlsl::options::DxcOpts &opts,
+                                 std::string &result) {
+  LPCSTR fakeName = "input.hlsl";
+  try {
+    ::llvm::sys::fs::MSFileSystem* msfPtr;
+    IFT(CreateMSFileSystemForDisk(&msfPtr));
+    std::unique_ptr<::llvm::sys::fs::MSFileSystem> msf(msfPtr);
+    ::llvm::sys::fs::AutoPerThreadSystem pts(msf.get());
+    IFTLLVM(pts.error_code());
+
+    std::unique_ptr<llvm::MemoryBuffer> pBuffer(llvm::MemoryBuffer::getMemBufferCopy(preprocessed, fakeName));
+    std::unique_ptr<ASTUnit::RemappedFile> pRemap(new ASTUnit::RemappedFile(fakeName, pBuffer.release()));
+
+    std::string warnings;
+    raw_string_ostream w(warnings);
+    CompilerInstance compiler;
+    std::unique_ptr<TextDiagnosticPrinter> diagPrinter =
+        llvm::make_unique<TextDiagnosticPrinter>(w, &compiler.getDiagnosticOpts());
+    SetupCompilerForRewrite(compiler, pHelper, fakeName, diagPrinter.get(), pRemap.get(), opts, nullptr);
+
+    compiler.getDiagnosticClient().BeginSourceFile(compiler.getLangOpts(), &compiler.getPreprocessor());
+    ParseAST(compiler.getSema(), false, false);
+    if (compiler.getDiagnosticClient().getNumErrors() > 0)
+      return E_FAIL;
+
+    ASTContext& C = compiler.getASTContext();
+    raw_string_ostream o(result);
+    switch (RemoveUnusedDecls(C, pEntryPoint, /*requireUnusedGlobals*/false, w)) {
+    case UnusedRemoval::EntryNotFound:
+    case UnusedRemoval::EntryNotFunction:
+      return E_FAIL;
+    case UnusedRemoval::NothingRemoved:
+      o << preprocessed;
+      break;
+    case UnusedRemoval::Removed: {
+      PrintingPolicy p = PrintingPolicy(C.getPrintingPolicy());
+      p.Indentation = 1;
+      C.getTranslationUnitDecl()->print(o, p);
+      WriteSemanticDefines(compiler, pHelper, o);
+      break;
+    }
+    }
+    o.flush();
+    return S_OK;
+  }
+  CATCH_CPP_RETURN_HRESULT();
+}
+
 static void RemoveStaticDecls(DeclContext &Ctx) {
   for (auto it = Ctx.decls_begin(); it != Ctx.decls_end(); ) {
     auto cur = it++;
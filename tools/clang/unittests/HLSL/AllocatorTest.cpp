@@ -14,7 +14,11 @@
 #endif
 #include "HlslTestUtils.h"
 
+#include "DxcTestUtils.h"
 #include "dxc/HLSL/DxilSpanAllocator.h"
+#include "dxc/Support/DxcArenaMalloc.h"
+#include <chrono>
+#include <functional>
 #include <cstdlib>
 #include <random>
 #include <algorithm>
@@ -547,6 +551,8 @@ public:
   TEST_METHOD(Intersections)
   TEST_METHOD(GapFilling)
   TEST_METHOD(Allocate)
+  TEST_METHOD(AllocateWhenManySpansThenFirstFit)
+  TEST_METHOD(ArenaMalloc)
 
   void InitScenarios() {
     struct P {
@@ -766,3 +772,114 @@ TEST_F(AllocatorTest, Allocate) {
     TestSizesFn();
   }
 }
+
+TEST_F(AllocatorTest, AllocateWhenManySpansThenFirstFit) {
+  WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+  // Many explicit bindings leave gaps of 1 to 7 registers, like a large
+  // descriptor table with holes; then ranges of every size are allocated.
+  const unsigned SpanCount = 20000;
+  ElementVector spans;
+  spans.reserve(SpanCount);
+  std::vector<bool> used;
+  unsigned start = 0;
+  for (unsigned i = 0; i < SpanCount; ++i) {
+    spans.emplace_back(i, start, start);
+    used.resize(start + 1);
+    used[start] = true;
+    start += 2 + i % 7;
+  }
+  used.resize(start + 64);
+
+  // Where a first fit lands, from a walk of the registers.
+  auto firstFit = [&](unsigned size, unsigned align) -> unsigned {
+    for (unsigned pos = 0;; pos += align) {
+      unsigned i = 0;
+      while (i < size && !used[pos + i])
+        ++i;
+      if (i == size)
+        return pos;
+    }
+  };
+
+  Allocator alloc(0, UINT_MAX);
+  double seconds = 0;
+  auto timed = [&](std::function<void()> fn) {
+    auto begin = std::chrono::steady_clock::now();
+    fn();
+    seconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - begin).count();
+  };
+  timed([&] {
+    for (auto &e : spans)
+      VERIFY_ARE_EQUAL(nullptr, alloc.Insert(&e, e.start, e.end));
+  });
+  ElementVector ranges;
+  ranges.reserve(2 * 8 * 64);
+  for (unsigned align : {1u, 4u}) {
+    for (unsigned size = 1; size <= 8; ++size) {
+      for (unsigned i = 0; i < 64; ++i) {
+        unsigned expected = firstFit(size, align);
+        ranges.emplace_back(UINT_MAX, expected, expected + size - 1);
+        unsigned pos = 0xFEFEFEFE;
+        bool allocated = false;
+        timed([&] {
+          allocated = alloc.Allocate(&ranges.back(), size, pos, align);
+        });
+        VERIFY_IS_TRUE(allocated);
+        VERIFY_ARE_EQUAL(expected, pos);
+        for (unsigned j = 0; j < size; ++j) {
+          if (pos + j >= used.size())
+            used.resize(pos + j + 64);
+          used[pos + j] = true;
+        }
+      }
+    }
+  }
+  VERIFY_IS_FALSE(alloc.IsFull());
+  VERIFY_ARE_EQUAL(firstFit(1, 1), alloc.GetFirstFree());
+  hlsl_test::LogCommentFmt(L"%u spans, %u allocations: %.3fs", SpanCount,
+                           (unsigned)ranges.size(), seconds);
+}
+
+TEST_F(AllocatorTest, ArenaMalloc) {
+  CComPtr<IMalloc> pInner;
+  VERIFY_SUCCEEDED(CoGetMalloc(1, &pInner));
+  CComPtr<DxcArenaMalloc> pArena = DxcArenaMalloc::Alloc(pInner);
+  VERIFY_IS_NOT_NULL(pArena.p);
+
+  // Blocks are aligned and don't overlap.
+  char *pA = (char *)pArena->Alloc(3);
+  char *pB = (char *)pArena->Alloc(40);
+  VERIFY_IS_NOT_NULL(pA);
+  VERIFY_IS_NOT_NULL(pB);
+  VERIFY_ARE_EQUAL(0u, (unsigned)((uintptr_t)pA % 16));
+  VERIFY_ARE_EQUAL(0u, (unsigned)((uintptr_t)pB % 16));
+  VERIFY_IS_TRUE(pA + 3 <= pB);
+  memset(pB, 0x5a, 40);
+
+  // The latest block grows in place; others move and keep their contents.
+  VERIFY_ARE_EQUAL((void *)pB, pArena->Realloc(pB, 400));
+  char *pA2 = (char *)pArena->Realloc(pA, 100);
+  VERIFY_ARE_NOT_EQUAL(pA, pA2);
+  VERIFY_ARE_EQUAL(0x5a, pB[39]);
+
+  // Freeing the latest block makes its space available again.
+  pArena->Free(pA2);
+  VERIFY_ARE_EQUAL((void *)pA2, pArena->Alloc(64));
+
+  // Blocks larger than a quarter chunk get their own chunk.
+  DxcArenaMallocStats stats = pArena->GetStats();
+  VERIFY_ARE_EQUAL(1u, (unsigned)stats.ChunkCount);
+  void *pLarge = pArena->Alloc(DxcArenaMalloc::ChunkSize);
+  VERIFY_IS_NOT_NULL(pLarge);
+  stats = pArena->GetStats();
+  VERIFY_ARE_EQUAL(2u, (unsigned)stats.ChunkCount);
+  VERIFY_IS_TRUE(stats.ReservedBytes > DxcArenaMalloc::ChunkSize);
+
+  // Memory from elsewhere goes back where it came from.
+  void *pForeign = pInner->Alloc(16);
+  pArena->Free(pForeign);
+  stats = pArena->GetStats();
+  VERIFY_ARE_EQUAL(1u, (unsigned)stats.ForeignFreeCount);
+  VERIFY_ARE_EQUAL(5u, (unsigned)stats.AllocCount);
+}
@@ -24,6 +24,7 @@
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/Support/WinIncludes.h"
 #include "dxc/dxcapi.h"
+#include "dxc/dxcapi.internal.h"
 #ifdef _WIN32
 #include <atlfile.h>
 #include "dia2.h"
@@ -38,6 +39,7 @@
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/microcom.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/DxcSourceStore.h"
 #include "dxc/Support/Unicode.h"
 
 #include <fstream>
@@ -208,10 +210,38 @@ public:
 
   TEST_METHOD(CompileWhenDefinesThenApplied)
   TEST_METHOD(CompileWhenDefinesManyThenApplied)
+  TEST_METHOD(CompileWhenCacheDirThenResultReused)
+  TEST_METHOD(CompileWhenSourceStoreThenSourcesShared)
+  TEST_METHOD(CompileManyWhenSeveralTargetsThenAllSucceed)
+  TEST_METHOD(CompilePermutationsWhenSameOutputThenCollapsed)
+  TEST_METHOD(CompileAsyncWhenQueuedThenAllComplete)
+  TEST_METHOD(CompileWhenTimeReportThenTimingsAvailable)
+  TEST_METHOD(CompileWhenTimeTraceThenEventsAppended)
+  TEST_METHOD(CompileWhenViewIdStateLargeThenScales)
+  TEST_METHOD(CompileWhenPressureReportThenReportAvailable)
+  TEST_METHOD(CompileWhenPressureReportModelThenOccupancyEstimated)
+  TEST_METHOD(CompileWhenPressureReportModelInvalidThenFails)
+#ifdef ENABLE_SPIRV_CODEGEN
+  TEST_METHOD(CompileWhenSpirvOutputThenBothAvailable)
+  TEST_METHOD(CompileWhenSpirvDebugRepeatedThenSameOptionsEmbedded)
+#endif
+  TEST_METHOD(CompileWhenRepeatedWithLayoutChangesThenSameOutput)
+  TEST_METHOD(CompileWhenReuseContextThenSameOutput)
+  TEST_METHOD(CompileWhenArenaMallocThenSameOutput)
+  TEST_METHOD(CompileWhenArgumentsRepeatedThenSameOutput)
+  TEST_METHOD(CompileWhenMaxMemoryThenPeakReported)
+  TEST_METHOD(CompileWhenMaxMemoryExceededThenFails)
+  TEST_METHOD(CompileWhenOptimizingThenFrontendFreed)
+  TEST_METHOD(CompileWhenManyIntrinsicCallsThenSucceeds)
+  TEST_METHOD(UnicodeWhenMostlyASCIIThenRoundTrips)
+  TEST_METHOD(CompileWhenLibShardsThenAllExportsLinked)
+  TEST_METHOD(CompileWhenLibShardsThenWarningsReportedOnce)
   TEST_METHOD(CompileWhenEmptyThenFails)
   TEST_METHOD(CompileWhenIncorrectThenFails)
+  TEST_METHOD(CompileWhenBuiltInObjectRedeclaredThenFails)
   TEST_METHOD(CompileWhenWorksThenDisassembleWorks)
   TEST_METHOD(CompileWhenDebugWorksThenStripDebug)
+  TEST_METHOD(CompileWhenStreamDebugThenDebugPartInFile)
   TEST_METHOD(CompileWhenWorksThenAddRemovePrivate)
   TEST_METHOD(CompileThenAddCustomDebugName)
   TEST_METHOD(CompileWithRootSignatureThenStripRootSignature)
@@ -226,9 +256,11 @@ public:
   TEST_METHOD(CompileWhenIncludeMissingThenFail)
   TEST_METHOD(CompileWhenIncludeHasPathThenOK)
   TEST_METHOD(CompileWhenIncludeEmptyThenOK)
+  TEST_METHOD(CompileWhenDependencyScanThenRuleListsIncludes)
 
   TEST_METHOD(CompileWhenODumpThenPassConfig)
   TEST_METHOD(CompileWhenODumpThenOptimizerMatch)
+  TEST_METHOD(CompileWhenFastIterationThenReducedPasses)
   TEST_METHOD(CompileWhenVdThenProducesDxilContainer)
 
   TEST_METHOD(CompileWhenNoMemThenOOM)
@@ -1682,6 +1714,23 @@ TEST_F(CompilerTest, CompileDebugLines) {
   CComBSTR pName;
   VERIFY_SUCCEEDED(pFile->get_fileName(&pName));
   VERIFY_ARE_EQUAL_WSTR(pName, L"source.hlsl");
+
+  // Verify lines are ok when looking up the code of a source line.
+  pEnumLineNumbers.Release();
+  VERIFY_SUCCEEDED(pSession->findLinesByLinenum(nullptr, pFile, 3, 0, &pEnumLineNumbers));
+  std::vector<LineNumber> linesByLinenum = ReadLineNumbers(pEnumLineNumbers);
+  VERIFY_ARE_EQUAL(linesByLinenum.size(), 1);
+  VERIFY_ARE_EQUAL(linesByLinenum[0].rva, 2);
+  VERIFY_ARE_EQUAL(linesByLinenum[0].line, 3);
+  pEnumLineNumbers.Release();
+  VERIFY_SUCCEEDED(pSession->findLinesByLinenum(nullptr, pFile, 5, 0, &pEnumLineNumbers));
+  linesByLinenum = ReadLineNumbers(pEnumLineNumbers);
+  VERIFY_ARE_EQUAL(linesByLinenum.size(), 2);
+  VERIFY_ARE_EQUAL(linesByLinenum[0].line, 5);
+  VERIFY_ARE_EQUAL(linesByLinenum[1].line, 5);
+  pEnumLineNumbers.Release();
+  VERIFY_SUCCEEDED(pSession->findLines(nullptr, pFile, &pEnumLineNumbers));
+  VERIFY_ARE_EQUAL(ReadLineNumbers(pEnumLineNumbers).size(), numExpectedRVAs);
 }
 #endif // _WIN32 - exclude dia stuff
 
@@ -1734,6 +1783,961 @@ TEST_F(CompilerTest, CompileWhenDefinesManyThenApplied) {
   VERIFY_SUCCEEDED(compileStatus);
 }
 
+TEST_F(CompilerTest, CompileWhenCacheDirThenResultReused) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlobEncoding> pOtherSource;
+
+  // Give the cache a directory of its own, so entries from earlier runs
+  // can't be hit and the entries written here can be found.
+  wchar_t TempPath[MAX_PATH];
+  wchar_t CacheDir[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  VERIFY_WIN32_BOOL_SUCCEEDED(GetTempFileNameW(TempPath, L"dxc", 0, CacheDir));
+  VERIFY_WIN32_BOOL_SUCCEEDED(DeleteFileW(CacheDir));
+  VERIFY_WIN32_BOOL_SUCCEEDED(CreateDirectoryW(CacheDir, nullptr));
+  std::wstring cacheDir(CacheDir);
+  auto listEntries = [&cacheDir]() {
+    std::vector<std::wstring> entries;
+    WIN32_FIND_DATAW findData;
+    HANDLE h = FindFirstFileW((cacheDir + L"\\*.dxcache").c_str(), &findData);
+    if (h == INVALID_HANDLE_VALUE)
+      return entries;
+    do {
+      entries.push_back(cacheDir + L"\\" + findData.cFileName);
+    } while (FindNextFileW(h, &findData));
+    FindClose(h);
+    return entries;
+  };
+
+  LPCWSTR args[] = {L"-cache-dir", CacheDir};
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 1; }", &pSource);
+  CreateBlobFromText("float4 main() : SV_Target { return 2; }", &pOtherSource);
+  auto compile = [&](IDxcBlob *pSrc, IDxcBlob **ppOut) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSrc, L"source.hlsl", L"main",
+                                        L"ps_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    HRESULT compileStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+    VERIFY_SUCCEEDED(compileStatus);
+    VERIFY_SUCCEEDED(pResult->GetResult(ppOut));
+  };
+
+  // A miss compiles the source and stores a single entry for it.
+  CComPtr<IDxcBlob> pFirst, pSecond, pOther;
+  compile(pSource, &pFirst);
+  VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(
+      (const hlsl::DxilContainerHeader *)pFirst->GetBufferPointer(),
+      pFirst->GetBufferSize()));
+  std::vector<std::wstring> entries = listEntries();
+  VERIFY_ARE_EQUAL(1u, entries.size());
+
+  // Replace the stored result with a marker, keeping the entry header's
+  // magic and version; a hit hands the marker back without compiling.
+  const char marker[] = "cached";
+  uint32_t header[5];
+  HANDLE hEntry = CreateFileW(entries[0].c_str(), GENERIC_READ | GENERIC_WRITE,
+                              0, nullptr, OPEN_EXISTING, 0, nullptr);
+  VERIFY_ARE_NOT_EQUAL(INVALID_HANDLE_VALUE, hEntry);
+  DWORD bytes;
+  VERIFY_WIN32_BOOL_SUCCEEDED(
+      ReadFile(hEntry, header, sizeof(header), &bytes, nullptr));
+  VERIFY_ARE_EQUAL((DWORD)sizeof(header), bytes);
+  header[2] = sizeof(marker);
+  header[3] = header[4] = 0;
+  VERIFY_ARE_EQUAL(0u, SetFilePointer(hEntry, 0, nullptr, FILE_BEGIN));
+  VERIFY_WIN32_BOOL_SUCCEEDED(
+      WriteFile(hEntry, header, sizeof(header), &bytes, nullptr));
+  VERIFY_WIN32_BOOL_SUCCEEDED(
+      WriteFile(hEntry, marker, sizeof(marker), &bytes, nullptr));
+  VERIFY_WIN32_BOOL_SUCCEEDED(SetEndOfFile(hEntry));
+  CloseHandle(hEntry);
+
+  compile(pSource, &pSecond);
+  VERIFY_ARE_EQUAL(sizeof(marker), pSecond->GetBufferSize());
+  VERIFY_ARE_EQUAL(0, memcmp(marker, pSecond->GetBufferPointer(),
+                             sizeof(marker)));
+
+  // A different source isn't served from the same entry.
+  compile(pOtherSource, &pOther);
+  VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(
+      (const hlsl::DxilContainerHeader *)pOther->GetBufferPointer(),
+      pOther->GetBufferSize()));
+  entries = listEntries();
+  VERIFY_ARE_EQUAL(2u, entries.size());
+
+  // A compiler with language extensions registered neither reads nor
+  // writes the cache, since the key doesn't cover them.
+  CComPtr<IDxcCompiler> pExtCompiler;
+  CComPtr<IDxcLangExtensions> pLangExtensions;
+  VERIFY_SUCCEEDED(CreateCompiler(&pExtCompiler));
+  VERIFY_SUCCEEDED(pExtCompiler.QueryInterface(&pLangExtensions));
+  VERIFY_SUCCEEDED(pLangExtensions->RegisterDefine(L"EXT_DEFINE"));
+  CComPtr<IDxcOperationResult> pExtResult;
+  VERIFY_SUCCEEDED(pExtCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                         L"ps_6_0", args, _countof(args),
+                                         nullptr, 0, nullptr, &pExtResult));
+  HRESULT extStatus;
+  VERIFY_SUCCEEDED(pExtResult->GetStatus(&extStatus));
+  VERIFY_SUCCEEDED(extStatus);
+  CComPtr<IDxcBlob> pExt;
+  VERIFY_SUCCEEDED(pExtResult->GetResult(&pExt));
+  VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(
+      (const hlsl::DxilContainerHeader *)pExt->GetBufferPointer(),
+      pExt->GetBufferSize()));
+  entries = listEntries();
+  VERIFY_ARE_EQUAL(2u, entries.size());
+
+  for (const std::wstring &entry : entries)
+    DeleteFileW(entry.c_str());
+  VERIFY_WIN32_BOOL_SUCCEEDED(RemoveDirectoryW(CacheDir));
+}
+
+TEST_F(CompilerTest, CompileWhenSourceStoreThenSourcesShared) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  LPCWSTR embeddedArgs[] = {L"/Zi", L"/Qembed_debug"};
+  LPCWSTR storedArgs[] = {L"/Zi", L"/Qembed_debug", L"-Qsource_store",
+                          TempPath};
+
+  // A long comment makes the embedded copy stand out in the container size.
+  std::string text = "// " + std::string(2048, 'x') + "\n"
+                     "float4 main() : SV_Target { return 1; }";
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(text.c_str(), &pSource);
+
+  CComPtr<IDxcBlob> pEmbedded, pStored;
+  for (bool bStore : {false, true}) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(
+        pSource, L"source.hlsl", L"main", L"ps_6_0",
+        bStore ? storedArgs : embeddedArgs,
+        bStore ? _countof(storedArgs) : _countof(embeddedArgs), nullptr, 0,
+        nullptr, &pResult));
+    HRESULT compileStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+    VERIFY_SUCCEEDED(compileStatus);
+    VERIFY_SUCCEEDED(pResult->GetResult(bStore ? &pStored : &pEmbedded));
+  }
+
+  // The store holds the source under its hash, and the container only
+  // refers to it.
+  std::string stored;
+  VERIFY_IS_TRUE(hlsl::ReadFromSourceStore(
+      Unicode::UTF16ToUTF8StringOrThrow(TempPath),
+      hlsl::GetSourceStoreHash(text), stored));
+  VERIFY_ARE_EQUAL(text, stored);
+  VERIFY_IS_TRUE(pStored->GetBufferSize() + 1024 <
+                 pEmbedded->GetBufferSize());
+}
+
+TEST_F(CompilerTest, CompileManyWhenSeveralTargetsThenAllSucceed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+  CreateBlobFromText(
+      "#define COLOR float4(1, 0, 0, 1)\r\n"
+      "float4 VSMain(float4 pos : POSITION) : SV_Position { return pos; }\r\n"
+      "float4 PSMain() : SV_Target { return COLOR; }\r\n"
+      "RWBuffer<float4> buf; [numthreads(8, 1, 1)]\r\n"
+      "void CSMain(uint id : SV_DispatchThreadID) { buf[id] = COLOR; }",
+      &pSource);
+
+  DxcCompileTarget targets[] = {{L"VSMain", L"vs_6_0"},
+                                {L"PSMain", L"ps_6_0"},
+                                {L"CSMain", L"cs_6_0"},
+                                {L"Missing", L"ps_6_0"}};
+  IDxcOperationResult *pResults[_countof(targets)];
+  VERIFY_SUCCEEDED(pCompiler3->CompileMany(pSource, L"source.hlsl", targets,
+                                           _countof(targets), nullptr, 0,
+                                           nullptr, 0, nullptr, pResults));
+
+  // Each target gets its own result, and a bad entry point only fails its own.
+  for (UINT32 i = 0; i < _countof(targets); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(pResults[i]);
+    HRESULT compileStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+    if (i + 1 < _countof(targets)) {
+      VERIFY_SUCCEEDED(compileStatus);
+    } else {
+      VERIFY_FAILED(compileStatus);
+    }
+  }
+}
+
+TEST_F(CompilerTest, CompilePermutationsWhenSameOutputThenCollapsed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler3> pCompiler3;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler3));
+  CreateBlobFromText(
+      "float4 main() : SV_Target {\r\n"
+      "#if RED\r\n"
+      "  return float4(1, 0, 0, 1);\r\n"
+      "#else\r\n"
+      "  return float4(0, 0, 0, 1);\r\n"
+      "#endif\r\n"
+      "}",
+      &pSource);
+
+  // UNUSED doesn't gate anything, so the first two permutations match.
+  DxcDefine first[] = {{L"UNUSED", L"1"}};
+  DxcDefine second[] = {{L"UNUSED", L"2"}};
+  DxcDefine third[] = {{L"RED", L"1"}};
+  const DxcDefine *defineSets[] = {first, second, third};
+  UINT32 defineCounts[] = {_countof(first), _countof(second), _countof(third)};
+  IDxcOperationResult *pResults[_countof(defineSets)];
+  UINT32 collapsedInto[_countof(defineSets)];
+  VERIFY_SUCCEEDED(pCompiler3->CompilePermutations(
+      pSource, L"source.hlsl", L"main", L"ps_6_0", nullptr, 0, defineSets,
+      defineCounts, _countof(defineSets), nullptr, pResults, collapsedInto));
+
+  VERIFY_ARE_EQUAL(0u, collapsedInto[0]);
+  VERIFY_ARE_EQUAL(0u, collapsedInto[1]);
+  VERIFY_ARE_EQUAL(2u, collapsedInto[2]);
+  VERIFY_ARE_EQUAL(pResults[0], pResults[1]);
+  for (UINT32 i = 0; i < _countof(defineSets); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    pResult.Attach(pResults[i]);
+    HRESULT compileStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+    VERIFY_SUCCEEDED(compileStatus);
+  }
+}
+
+TEST_F(CompilerTest, CompileAsyncWhenQueuedThenAllComplete) {
+  CComPtr<IDxcAsyncCompiler> pAsyncCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlobEncoding> pSourceBad;
+
+  VERIFY_SUCCEEDED(
+      m_dllSupport.CreateInstance(CLSID_DxcAsyncCompiler, &pAsyncCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 0; }", &pSource);
+  CreateBlobFromText("float4 main() : SV_Target { return undef; }", &pSourceBad);
+
+  // Keep several compiles in flight, with every fourth one failing.
+  const UINT32 operationCount = 16;
+  CComPtr<IDxcAsyncOperation> pOperations[operationCount];
+  for (UINT32 i = 0; i < operationCount; ++i) {
+    IDxcBlob *pSrc = (i % 4 == 3) ? (IDxcBlob *)pSourceBad : pSource;
+    VERIFY_SUCCEEDED(pAsyncCompiler->CompileAsync(
+        pSrc, L"source.hlsl", L"main", L"ps_6_0", nullptr, 0, nullptr, 0,
+        nullptr, nullptr, &pOperations[i]));
+  }
+
+  for (UINT32 i = 0; i < operationCount; ++i) {
+    VERIFY_SUCCEEDED(pOperations[i]->Wait());
+    BOOL complete;
+    VERIFY_SUCCEEDED(pOperations[i]->IsComplete(&complete));
+    VERIFY_IS_TRUE(complete);
+    // Cancelling after completion has no effect.
+    VERIFY_ARE_EQUAL(S_FALSE, pOperations[i]->Cancel());
+
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pOperations[i]->GetResult(&pResult));
+    HRESULT compileStatus;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+    if (i % 4 == 3) {
+      VERIFY_FAILED(compileStatus);
+    } else {
+      VERIFY_SUCCEEDED(compileStatus);
+    }
+  }
+}
+
+TEST_F(CompilerTest, CompileWhenTimeTraceThenEventsAppended) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 0; }", &pSource);
+
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  std::wstring fileName = std::wstring(TempPath) + L"TimeTrace.json";
+  DeleteFileW(fileName.c_str());
+
+  // Two compiles append to the same file, which is only opened once.
+  LPCWSTR args[] = {L"-ftime-trace", fileName.c_str()};
+  for (int i = 0; i < 2; ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+  }
+
+  CComPtr<IDxcLibrary> pLibrary;
+  CComPtr<IDxcBlobEncoding> pTrace;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
+  VERIFY_SUCCEEDED(
+      pLibrary->CreateBlobFromFile(fileName.c_str(), nullptr, &pTrace));
+  std::string trace((const char *)pTrace->GetBufferPointer(),
+                    pTrace->GetBufferSize());
+  pTrace.Release();
+  DeleteFileW(fileName.c_str());
+  VERIFY_ARE_EQUAL(0u, trace.find("[\n"));
+  VERIFY_ARE_EQUAL(std::string::npos, trace.find("[", 1));
+  auto count = [&](const char *pText) {
+    size_t n = 0;
+    for (size_t pos = trace.find(pText); pos != std::string::npos;
+         pos = trace.find(pText, pos + 1))
+      ++n;
+    return n;
+  };
+  VERIFY_ARE_EQUAL(2u, count("{\"name\": \"compile\", \"cat\": \"compile\""));
+  VERIFY_ARE_EQUAL(2u, count("{\"name\": \"codegen\", \"cat\": \"phase\""));
+  VERIFY_IS_TRUE(count("\"cat\": \"pass\"") > 0);
+  VERIFY_IS_TRUE(count("\"shader\": \"source.hlsl:main\", \"target\": \"ps_6_0\", \"hash\": \"") > 0);
+}
+
+TEST_F(CompilerTest, CompileWhenTimeReportThenTimingsAvailable) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 0; }", &pSource);
+
+  // Without -ftime-report, the result has no timings.
+  CComPtr<IDxcCompileTimings> pTimings;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", nullptr, 0, nullptr, 0,
+                                      nullptr, &pResult));
+  VERIFY_FAILED(pResult.QueryInterface(&pTimings));
+  pResult.Release();
+
+  LPCWSTR args[] = {L"-ftime-report"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pTimings));
+  CComPtr<IDxcBlobEncoding> pTimingsBlob;
+  VERIFY_SUCCEEDED(pTimings->GetTimings(&pTimingsBlob));
+  std::string timings = BlobToUtf8(pTimingsBlob);
+  for (const char *pPhase : {"\"parse\"", "\"codegen\"", "\"optimize\"",
+                             "\"container\"", "\"validation\"",
+                             "\"passes\""}) {
+    VERIFY_IS_TRUE(timings.find(pPhase) != std::string::npos);
+  }
+  // Where the allocator can report usage, phases also count allocations.
+  if (timings.find("\"peakBytes\"") != std::string::npos)
+    VERIFY_IS_TRUE(timings.find("\"allocations\"") != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenPressureReportThenReportAvailable) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "RWBuffer<float> output; uint g_count;\r\n"
+      "groupshared float shared[256];\r\n"
+      "[numthreads(64, 1, 1)]\r\n"
+      "void main(uint id : SV_GroupIndex) {\r\n"
+      "  float local[16];\r\n"
+      "  for (uint i = 0; i < g_count; ++i) local[i & 15] = i;\r\n"
+      "  shared[id] = local[id & 15];\r\n"
+      "  GroupMemoryBarrierWithGroupSync();\r\n"
+      "  output[id] = shared[255 - id];\r\n"
+      "}",
+      &pSource);
+
+  LPCWSTR args[] = {L"-Fre", L"report.json"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  CComPtr<IDxcCompilePressureReport> pReport;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pReport));
+  CComPtr<IDxcBlobEncoding> pReportBlob;
+  VERIFY_SUCCEEDED(pReport->GetPressureReport(&pReportBlob));
+  std::string report = BlobToUtf8(pReportBlob);
+  VERIFY_IS_TRUE(report.find("\"name\": \"main\"") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"maxLiveValues\": ") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"groupsharedBytes\": 1024") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"indexableBytes\": 64") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"numThreads\": [64, 1, 1]") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"usesBarriers\": true") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"model\": \"wave32\"") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"model\": \"wave64\"") != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenPressureReportModelThenOccupancyEstimated) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "RWBuffer<float> output;\r\n"
+      "[numthreads(48, 1, 1)]\r\n"
+      "void main(uint id : SV_GroupIndex) {\r\n"
+      "  output[id] = WaveActiveSum(id);\r\n"
+      "}",
+      &pSource);
+
+  // One SIMD of 8 waves fits 8 groups of 32 threads, or 4 of 48 threads
+  // in 2 waves each, the second of them half empty.
+  LPCWSTR args[] = {L"-Fre", L"report.json", L"-Fre-model",
+                    L"small:32,1024,8,1,65536,64"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  CComPtr<IDxcCompilePressureReport> pReport;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pReport));
+  CComPtr<IDxcBlobEncoding> pReportBlob;
+  VERIFY_SUCCEEDED(pReport->GetPressureReport(&pReportBlob));
+  std::string report = BlobToUtf8(pReportBlob);
+  VERIFY_IS_TRUE(report.find("\"usesWaveOps\": true") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"model\": \"small\"") != std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"model\": \"wave32\"") == std::string::npos);
+  VERIFY_IS_TRUE(report.find("\"recommended\": 32") != std::string::npos);
+  VERIFY_IS_TRUE(
+      report.find("{\"threads\": 48, \"wavesPerGroup\": 2, \"groupsPerUnit\": 4,"
+                  " \"occupancy\": 1.00, \"limitedBy\": [\"waves\"],"
+                  " \"notWaveMultiple\": true}") != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenPressureReportModelInvalidThenFails) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("[numthreads(1, 1, 1)] void main() {}", &pSource);
+
+  // A register count of zero is rejected with the model in the message.
+  LPCWSTR args[] = {L"-Fre", L"report.json", L"-Fre-model",
+                    L"small:32,0,8,1,65536,64"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"cs_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_ARE_EQUAL(E_INVALIDARG, status);
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  VERIFY_IS_TRUE(errors.find("not 'small:32,0,8,1,65536,64'") !=
+                 std::string::npos);
+}
+
+#ifdef ENABLE_SPIRV_CODEGEN
+TEST_F(CompilerTest, CompileWhenSpirvOutputThenBothAvailable) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "float4 main(float4 color : COLOR) : SV_Target { return color * 2; }",
+      &pSource);
+
+  LPCWSTR args[] = {L"-Fspv", L"output.spv"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+
+  // The result is the DXIL container.
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_IS_NOT_NULL(hlsl::IsDxilContainerLike(pProgram->GetBufferPointer(),
+                                               pProgram->GetBufferSize()));
+
+  // The SPIR-V module comes from the same compile.
+  CComPtr<IDxcCompileSpirvOutput> pSpirvOutput;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pSpirvOutput));
+  CComPtr<IDxcBlob> pSpirv;
+  VERIFY_SUCCEEDED(pSpirvOutput->GetSpirv(&pSpirv));
+  VERIFY_IS_TRUE(pSpirv->GetBufferSize() > 20);
+  const uint32_t *pWords = (const uint32_t *)pSpirv->GetBufferPointer();
+  VERIFY_ARE_EQUAL(0x07230203u, pWords[0]); // SPIR-V magic number
+}
+
+TEST_F(CompilerTest, CompileWhenSpirvDebugRepeatedThenSameOptionsEmbedded) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "float4 main(float4 color : COLOR) : SV_Target { return color * 2; }",
+      &pSource);
+
+  // Compiles with the same arguments share their parsed options; each must
+  // embed the command line once, as the first one did.
+  LPCWSTR args[] = {L"-spirv", L"-Zi"};
+  std::string embedded[2];
+  for (std::string &options : embedded) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pSpirv;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pSpirv));
+    std::string module((const char *)pSpirv->GetBufferPointer(),
+                       pSpirv->GetBufferSize());
+    size_t pos = module.find("dxc-cl-option:");
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, pos);
+    options = module.substr(pos, module.find('\0', pos) - pos);
+  }
+  VERIFY_ARE_EQUAL(embedded[0], embedded[1]);
+  VERIFY_ARE_EQUAL(std::string::npos, embedded[0].find("-Zi -spirv"));
+}
+#endif // ENABLE_SPIRV_CODEGEN
+
+TEST_F(CompilerTest, CompileWhenRepeatedWithLayoutChangesThenSameOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "float4 main(min16float4 a : A) : SV_Target { return a * 2; }",
+      &pSource);
+
+  // Compiles on the same compiler object reuse their target; switching data
+  // layouts in between must not leak into the other layout's output.
+  auto compile = [&](bool enable16BitTypes) {
+    LPCWSTR args[] = {L"-enable-16bit-types"};
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(
+        pSource, L"source.hlsl", L"main", L"ps_6_2", args,
+        enable16BitTypes ? _countof(args) : 0, nullptr, 0, nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pProgram;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    return std::string((const char *)pProgram->GetBufferPointer(),
+                       pProgram->GetBufferSize());
+  };
+
+  std::string legacy = compile(false);
+  std::string native = compile(true);
+  VERIFY_ARE_NOT_EQUAL(legacy, native);
+  VERIFY_ARE_EQUAL(legacy, compile(false));
+  VERIFY_ARE_EQUAL(native, compile(true));
+}
+
+TEST_F(CompilerTest, CompileWhenArgumentsRepeatedThenSameOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "float4 main() : SV_Target { return VALUE; }", &pSource);
+
+  // Repeated arguments reuse the options read the first time; the target
+  // profile is part of what was read, and arguments that fail to validate
+  // must keep failing.
+  auto compile = [&](LPCWSTR pTarget, LPCWSTR pArg, HRESULT &status) {
+    LPCWSTR args[] = {L"-DVALUE=2", pArg};
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        pTarget, args, _countof(args), nullptr,
+                                        0, nullptr, &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    if (FAILED(status))
+      return std::string();
+    CComPtr<IDxcBlob> pProgram;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    return std::string((const char *)pProgram->GetBufferPointer(),
+                       pProgram->GetBufferSize());
+  };
+
+  HRESULT status;
+  std::string first = compile(L"ps_6_0", L"-O3", status);
+  VERIFY_SUCCEEDED(status);
+  VERIFY_ARE_EQUAL(first, compile(L"ps_6_0", L"-O3", status));
+  VERIFY_SUCCEEDED(status);
+  VERIFY_ARE_NOT_EQUAL(first, compile(L"ps_6_1", L"-O3", status));
+  VERIFY_SUCCEEDED(status);
+  compile(L"ps_6_0", L"-no-such-option", status);
+  VERIFY_FAILED(status);
+  compile(L"ps_6_0", L"-no-such-option", status);
+  VERIFY_FAILED(status);
+}
+
+TEST_F(CompilerTest, CompileWhenMaxMemoryThenPeakReported) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 0; }", &pSource);
+
+  LPCWSTR args[] = {L"-max-memory=4096"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  CComPtr<IDxcCompileMemoryUsage> pUsage;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pUsage));
+  UINT64 peakBytes = 0;
+  VERIFY_SUCCEEDED(pUsage->GetPeakBytes(&peakBytes));
+  VERIFY_IS_TRUE(peakBytes > 0);
+  VERIFY_IS_TRUE(peakBytes < 4096ull * 1024 * 1024);
+}
+
+TEST_F(CompilerTest, CompileWhenMaxMemoryExceededThenFails) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText("float4 main() : SV_Target { return 0; }", &pSource);
+
+  // Setting up the front end alone takes more than a megabyte.
+  LPCWSTR args[] = {L"-max-memory=1"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_ARE_EQUAL(E_OUTOFMEMORY, status);
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  VERIFY_IS_TRUE(errors.find("memory budget of 1 MB") != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenOptimizingThenFrontendFreed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  auto peakOf = [&](const std::string &source) -> UINT64 {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CreateBlobFromText(source.c_str(), &pSource);
+    LPCWSTR args[] = {L"-max-memory=4096"};
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    VerifyOperationSucceeded(pResult);
+    CComPtr<IDxcCompileMemoryUsage> pUsage;
+    VERIFY_SUCCEEDED(pResult.QueryInterface(&pUsage));
+    UINT64 peakBytes = 0;
+    VERIFY_SUCCEEDED(pUsage->GetPeakBytes(&peakBytes));
+    return peakBytes;
+  };
+
+  // The unused functions make for a large AST and a small module, and the
+  // unrolled loop for a small AST and a large module to optimize.
+  std::string unused;
+  for (unsigned i = 0; i < 1000; ++i)
+    unused += "float4 f" + std::to_string(i) +
+              "(float4 v) { float4 r = v * " + std::to_string(i) +
+              "; for (int j = 0; j < 4; ++j) r = r * r + v; return r; }\n";
+  const std::string trivialMain =
+      "float4 main(float4 x : A) : SV_Target { return x; }\n";
+  const std::string unrolledMain =
+      "float4 main(float4 x : A) : SV_Target {\n"
+      "  float4 acc = x;\n"
+      "  [unroll] for (int i = 0; i < 512; ++i)\n"
+      "    acc = sin(acc * i + x) + cos(acc.wzyx);\n"
+      "  return acc;\n"
+      "}\n";
+  UINT64 base = peakOf(trivialMain);
+  UINT64 frontend = peakOf(unused + trivialMain);
+  UINT64 backend = peakOf(unrolledMain);
+  UINT64 both = peakOf(unused + unrolledMain);
+  VERIFY_IS_TRUE(base < frontend && base < backend);
+
+  // Were the AST still alive while optimizing, the two costs would add up.
+  // Freed, the compile saves most of the smaller one.
+  UINT64 smaller = std::min(frontend, backend) - base;
+  VERIFY_IS_TRUE(both < frontend + backend - base - smaller / 2);
+}
+
+TEST_F(CompilerTest, CompileWhenManyIntrinsicCallsThenSucceeds) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  // Every call looks up its intrinsic by name and argument count, in the
+  // global table and in the object method tables.
+  std::string source = "Texture2D<float4> t;\nSamplerState s;\n"
+                       "RWByteAddressBuffer b;\n"
+                       "float4 main(float4 x : X) : SV_Target {\n"
+                       "  float4 r = 0;\n";
+  for (unsigned i = 0; i < 2000; ++i) {
+    source += "  r += abs(x) + saturate(x) * dot(x, r) + lerp(x, r, 0.5) +"
+              " t.Sample(s, x.xy) + clamp(r, 0, " + std::to_string(i) + ");\n"
+              "  b.Store(" + std::to_string(i * 4) + ", asuint(r.x));\n";
+  }
+  source += "  return r;\n}\n";
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  LPCWSTR args[] = {L"-ftime-report", L"-Od"};
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"ps_6_0", args, _countof(args), nullptr,
+                                      0, nullptr, &pResult));
+  HRESULT status;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_SUCCEEDED(status);
+  CComPtr<IDxcCompileTimings> pTimings;
+  VERIFY_SUCCEEDED(pResult.QueryInterface(&pTimings));
+  CComPtr<IDxcBlobEncoding> pTimingsBlob;
+  VERIFY_SUCCEEDED(pTimings->GetTimings(&pTimingsBlob));
+  std::string timings = BlobToUtf8(pTimingsBlob);
+  std::size_t parse = timings.find("\"parse\"");
+  VERIFY_IS_TRUE(parse != std::string::npos);
+  hlsl_test::LogCommentFmt(
+      L"%S", timings.substr(parse, timings.find('}', parse) - parse + 1).c_str());
+}
+
+TEST_F(CompilerTest, UnicodeWhenMostlyASCIIThenRoundTrips) {
+  // A multi-megabyte source with a non-ASCII character in some comments, so
+  // the conversions switch between the ASCII runs and the general path.
+  std::string source;
+  for (unsigned i = 0; i < 100000; ++i) {
+    source += "  r += t.Sample(s, x.xy) * " + std::to_string(i) + ";";
+    source += (i % 1000 == 0) ? " // caf\xc3\xa9\n" : "\n";
+  }
+
+  std::wstring source16 = Unicode::UTF8ToUTF16StringOrThrow(source.c_str());
+  std::string source8 = Unicode::UTF16ToUTF8StringOrThrow(source16.c_str());
+
+  VERIFY_ARE_EQUAL(source.size() - 100, source16.size());
+  VERIFY_ARE_EQUAL(L'\u00e9', source16[source16.find(L"caf") + 3]);
+  VERIFY_IS_TRUE(source == source8);
+}
+
+TEST_F(CompilerTest, CompileWhenViewIdStateLargeThenScales) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  // Each statement feeds an accumulator into its neighbour, so every output
+  // depends on a long chain of values that the ViewID analysis must walk.
+  // Only the position depends on the view.
+  const unsigned size = 256;
+  std::string source =
+      "struct VSOut { float4 pos : SV_Position; float4 o[8] : TEXCOORD0; };\n"
+      "VSOut main(float4 a : A, float4 b : B, uint n : N,\n"
+      "           uint vid : SV_ViewID) {\n"
+      "  float4 acc[8];\n"
+      "  [unroll] for (uint i = 0; i < 8; ++i) acc[i] = a * i;\n"
+      "  for (uint k = 0; k < n; ++k) {\n";
+  for (unsigned i = 0; i < size; ++i) {
+    unsigned j = i % 8;
+    source += "    acc[" + std::to_string(j) + "] = acc[" +
+              std::to_string(j) + "] * b + acc[" +
+              std::to_string((j + 1) % 8) + "];\n";
+  }
+  source += "  }\n"
+            "  VSOut r;\n"
+            "  r.pos = acc[0] + vid;\n"
+            "  [unroll] for (uint i = 0; i < 8; ++i) r.o[i] = acc[i];\n"
+            "  return r;\n"
+            "}\n";
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                      L"vs_6_1", nullptr, 0, nullptr, 0,
+                                      nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  std::string disassembly = BlobToUtf8(pDisassembly);
+  VERIFY_IS_TRUE(
+      disassembly.find("; Outputs dependent on ViewId: { 0, 1, 2, 3 }\n") !=
+      std::string::npos);
+  VERIFY_IS_TRUE(disassembly.find("contributing to computation of") !=
+                 std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenLibShardsThenAllExportsLinked) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  // Exports calling each other land in different shards and are resolved
+  // when the shards are linked.
+  std::string source = "RWByteAddressBuffer b;\n"
+                       "float helper(float f) { return f * 3; }\n";
+  for (unsigned i = 0; i < 16; ++i) {
+    source += "export float fn" + std::to_string(i) + "(float f) { return ";
+    source += i == 0 ? std::string("helper(f)")
+                     : "fn" + std::to_string(i - 1) + "(f) + 1";
+    source += "; }\n";
+  }
+  source += "[shader(\"compute\")] [numthreads(1, 1, 1)]\n"
+            "void CSMain() { b.Store(0, asuint(fn15(1))); }\n";
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  LPCWSTR args[] = {L"-lib-shards=4"};
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"", L"lib_6_3",
+                                      args, _countof(args), nullptr, 0,
+                                      nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+  std::string disassembly = BlobToUtf8(pDisassembly);
+  for (unsigned i = 0; i < 16; ++i) {
+    std::string name = "fn" + std::to_string(i) + "@@";
+    VERIFY_IS_TRUE(disassembly.find("define float @\"\\01?" + name) !=
+                   std::string::npos);
+  }
+  VERIFY_IS_TRUE(disassembly.find("define void @CSMain()") != std::string::npos);
+}
+
+TEST_F(CompilerTest, CompileWhenLibShardsThenWarningsReportedOnce) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  // Every shard parses the helper and warns about it.
+  std::string source = "RWByteAddressBuffer b;\n"
+                       "float helper(float4 f) { float2 t = f; return t.x; }\n";
+  for (unsigned i = 0; i < 8; ++i)
+    source += "export float fn" + std::to_string(i) +
+              "(float f) { return helper(f); }\n";
+  source += "[shader(\"compute\")] [numthreads(1, 1, 1)]\n"
+            "void CSMain() { b.Store(0, asuint(fn7(1))); }\n";
+  CComPtr<IDxcBlobEncoding> pSource;
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  LPCWSTR args[] = {L"-lib-shards=4"};
+  CComPtr<IDxcOperationResult> pResult;
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"", L"lib_6_3",
+                                      args, _countof(args), nullptr, 0,
+                                      nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+
+  CComPtr<IDxcBlobEncoding> pErrors;
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+  const char warning[] = "implicit truncation of vector type";
+  size_t first = errors.find(warning);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, first);
+  VERIFY_ARE_EQUAL(std::string::npos, errors.find(warning, first + 1));
+}
+
+TEST_F(CompilerTest, CompileWhenReuseContextThenSameOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+      "struct S { float4 a; uint b; };\n"
+      "StructuredBuffer<S> buf;\n"
+      "Texture2D<float4> tex;\n"
+      "SamplerState samp;\n"
+      "float4 main(float2 uv : UV, uint i : I) : SV_Target {\n"
+      "  S s = buf[i];\n"
+      "  return s.a * s.b + tex.Sample(samp, uv);\n"
+      "}",
+      &pSource);
+
+  // Later compiles run in the context of the earlier ones, whose struct
+  // types must not make them name theirs differently.
+  auto compile = [&]() {
+    LPCWSTR args[] = {L"-reuse-context"};
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", args, _countof(args),
+                                        nullptr, 0, nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pProgram;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    return std::string((const char *)pProgram->GetBufferPointer(),
+                       pProgram->GetBufferSize());
+  };
+
+  std::string first = compile();
+  VERIFY_ARE_EQUAL(first, compile());
+  VERIFY_ARE_EQUAL(first, compile());
+}
+
+TEST_F(CompilerTest, CompileWhenArenaMallocThenSameOutput) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  // Lots of small functions and unrolled loops make for a compile with many
+  // short-lived allocations.
+  std::string source;
+  for (unsigned i = 0; i < 200; ++i) {
+    source += "float f" + std::to_string(i) + "(float x) {\n"
+              "  [unroll] for (int i = 0; i < 16; ++i) x = x * 1.5f + i;\n"
+              "  return x;\n}\n";
+  }
+  source += "float4 main(float x : X) : SV_Target {\n  float r = 0;\n";
+  for (unsigned i = 0; i < 200; ++i)
+    source += "  r += f" + std::to_string(i) + "(x);\n";
+  source += "  return r;\n}\n";
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(source.c_str(), &pSource);
+
+  auto compile = [&](bool useArena) {
+    std::vector<LPCWSTR> args;
+    if (useArena)
+      args.push_back(L"-arena-malloc");
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", args.data(),
+                                        (UINT32)args.size(), nullptr, 0,
+                                        nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    CComPtr<IDxcBlob> pProgram;
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    return std::string((const char *)pProgram->GetBufferPointer(),
+                       pProgram->GetBufferSize());
+  };
+
+  // The allocator doesn't change what gets compiled, and state created during
+  // an arena compile is still good once the arena is gone.
+  std::string arena = compile(true);
+  VERIFY_ARE_EQUAL(arena, compile(false));
+  VERIFY_ARE_EQUAL(arena, compile(true));
+}
+
 TEST_F(CompilerTest, CompileWhenEmptyThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1809,6 +2813,34 @@ TEST_F(CompilerTest, CompileWhenIncorrectThenFails) {
   // WEX::Logging::Log::Comment(errorStringW.m_psz);
 }
 
+TEST_F(CompilerTest, CompileWhenBuiltInObjectRedeclaredThenFails) {
+  CComPtr<IDxcCompiler> pCompiler;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+
+  // Built-in object types are only declared once they're looked up, but
+  // redeclaring one still conflicts with the built-in declaration, whether
+  // or not the shader used it first.
+  auto compile = [&](const char *pText) -> HRESULT {
+    CComPtr<IDxcBlobEncoding> pSource;
+    CComPtr<IDxcOperationResult> pResult;
+    CreateBlobFromText(pText, &pSource);
+    VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+                                        L"ps_6_0", nullptr, 0, nullptr, 0,
+                                        nullptr, &pResult));
+    HRESULT status;
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    return status;
+  };
+  VERIFY_FAILED(compile("struct Texture2D { float f; };\n"
+                        "float4 main() : SV_Target { return 0; }"));
+  VERIFY_FAILED(compile("Buffer<float> b;\n"
+                        "struct Buffer { float f; };\n"
+                        "float4 main() : SV_Target { return b[0]; }"));
+  VERIFY_SUCCEEDED(compile("namespace N { Texture2D t; sampler s; }\n"
+                           "float4 main(float2 uv : UV) : SV_Target {\n"
+                           "  return N::t.Sample(N::s, uv);\n}"));
+}
+
 TEST_F(CompilerTest, CompileWhenWorksThenDisassembleWorks) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -1879,6 +2911,75 @@ TEST_F(CompilerTest, CompileWhenDebugWorksThenStripDebug) {
   VERIFY_IS_NULL(pPartHeader);
 }
 
+TEST_F(CompilerTest, CompileWhenStreamDebugThenDebugPartInFile) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcCompiler2> pCompiler2;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler.QueryInterface(&pCompiler2));
+  CreateBlobFromText("float4 main(float4 pos : SV_Position) : SV_Target {\r\n"
+                     "  float4 local = abs(pos);\r\n"
+                     "  return local;\r\n"
+                     "}",
+                     &pSource);
+
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  std::wstring fileName = std::wstring(TempPath) + L"StreamDebug.pdb";
+
+  // The debug info is embedded as usual without -Qstream_debug.
+  CComPtr<IDxcOperationResult> pResult;
+  CComHeapPtr<WCHAR> pEmbeddedName;
+  CComPtr<IDxcBlob> pEmbeddedDebug;
+  LPCWSTR embedArgs[] = {L"/Zi"};
+  VERIFY_SUCCEEDED(pCompiler2->CompileWithDebug(
+      pSource, L"source.hlsl", L"main", L"ps_6_0", embedArgs,
+      _countof(embedArgs), nullptr, 0, nullptr, &pResult, &pEmbeddedName,
+      &pEmbeddedDebug));
+  CComPtr<IDxcBlob> pProgram;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(
+      (hlsl::DxilContainerHeader *)pProgram->GetBufferPointer(),
+      hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL));
+
+  // With it, the part is only in the file, and the debug blob maps it.
+  pResult.Release();
+  pProgram.Release();
+  CComHeapPtr<WCHAR> pStreamedName;
+  CComPtr<IDxcBlob> pStreamedDebug;
+  LPCWSTR streamArgs[] = {L"/Zi", L"/Qstream_debug", fileName.c_str()};
+  VERIFY_SUCCEEDED(pCompiler2->CompileWithDebug(
+      pSource, L"source.hlsl", L"main", L"ps_6_0", streamArgs,
+      _countof(streamArgs), nullptr, 0, nullptr, &pResult, &pStreamedName,
+      &pStreamedDebug));
+  HRESULT compileStatus;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&compileStatus));
+  VERIFY_SUCCEEDED(compileStatus);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(
+      (hlsl::DxilContainerHeader *)pProgram->GetBufferPointer(),
+      hlsl::DxilFourCC::DFCC_ShaderDebugInfoDXIL));
+  VERIFY_IS_NOT_NULL(pStreamedDebug.p);
+  VERIFY_IS_TRUE(hlsl::IsValidDxilProgramHeader(
+      (const hlsl::DxilProgramHeader *)pStreamedDebug->GetBufferPointer(),
+      pStreamedDebug->GetBufferSize()));
+  VERIFY_ARE_EQUAL(
+      ((const hlsl::DxilProgramHeader *)pStreamedDebug->GetBufferPointer())
+              ->SizeInUint32 *
+          sizeof(uint32_t),
+      pStreamedDebug->GetBufferSize());
+
+  // The debug name still depends on the source.
+  VERIFY_IS_NOT_NULL(pEmbeddedName.m_pData);
+  VERIFY_IS_NOT_NULL(pStreamedName.m_pData);
+  VERIFY_ARE_EQUAL_WSTR(pEmbeddedName.m_pData, pStreamedName.m_pData);
+
+  pStreamedDebug.Release();
+  DeleteFileW(fileName.c_str());
+}
+
 TEST_F(CompilerTest, CompileWhenWorksThenAddRemovePrivate) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2093,6 +3194,37 @@ TEST_F(CompilerTest, CompileWhenIncludeThenLoadUsed) {
   VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
 }
 
+TEST_F(CompilerTest, CompileWhenDependencyScanThenRuleListsIncludes) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<TestIncludeHandler> pInclude;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(
+    "#include \"helper.h\"\r\n"
+    "#if SKIPPED\r\n"
+    "#include \"skipped.h\"\r\n"
+    "#endif\r\n"
+    "float4 main() : SV_Target { return ZERO; }", &pSource);
+
+  pInclude = new TestIncludeHandler(m_dllSupport);
+  pInclude->CallResults.emplace_back("#define ZERO 0\r\n"
+                                     "#define SKIPPED 0");
+
+  LPCWSTR args[] = {L"-M", L"-MT", L"my shader.dxo"};
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, pInclude, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pRule;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pRule));
+  std::string rule((const char *)pRule->GetBufferPointer(),
+                   pRule->GetBufferSize());
+  VERIFY_ARE_EQUAL_STR("my\\ shader.dxo: \\\n  source.hlsl \\\n  ./helper.h\n",
+                       rule.c_str());
+  VERIFY_ARE_EQUAL_WSTR(L"./helper.h;", pInclude->GetAllFileNames().c_str());
+}
+
 TEST_F(CompilerTest, CompileWhenIncludeAbsoluteThenLoadAbsolute) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pResult;
@@ -2339,8 +3471,30 @@ TEST_F(CompilerTest, CompileWhenVdThenProducesDxilContainer) {
   VERIFY_IS_TRUE(hlsl::IsValidDxilContainer(reinterpret_cast<hlsl::DxilContainerHeader *>(pResultBlob->GetBufferPointer()), pResultBlob->GetBufferSize()));
 }
 
+TEST_F(CompilerTest, CompileWhenFastIterationThenReducedPasses) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(EmptyCompute, &pSource);
+
+  LPCWSTR Args[] = { L"/Ofast-iteration", L"/Odump" };
+
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"cs_6_0", Args, _countof(Args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  CComPtr<IDxcBlob> pResultBlob;
+  VERIFY_SUCCEEDED(pResult->GetResult(&pResultBlob));
+  string passes((char *)pResultBlob->GetBufferPointer(), pResultBlob->GetBufferSize());
+  VERIFY_ARE_NOT_EQUAL(string::npos, passes.find("\n-mem2reg"));
+  VERIFY_ARE_NOT_EQUAL(string::npos, passes.find("\n-dxil-loop-unroll"));
+  VERIFY_ARE_EQUAL(string::npos, passes.find("\n-loop-unroll"));
+  VERIFY_ARE_EQUAL(string::npos, passes.find("\n-ipsccp"));
+}
+
 TEST_F(CompilerTest, CompileWhenODumpThenOptimizerMatch) {
-  LPCWSTR OptLevels[] = { L"/Od", L"/O1", L"/O2" };
+  LPCWSTR OptLevels[] = { L"/Od", L"/O1", L"/O2", L"/Ofast-iteration" };
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOptimizer> pOptimizer;
   CComPtr<IDxcAssembler> pAssembler;
@@ -12,6 +12,7 @@
 #include "CompilationResult.h"
 #include "HLSLTestData.h"
 #include <stdint.h>
+#include <string>
 
 #ifdef _WIN32
 #include "WexTestClass.h"
@@ -115,6 +116,8 @@ protected:
   TEST_METHOD(TUWhenRegionInactiveThenEndIsBeforeEndifHash)
   TEST_METHOD(TUWhenRegionInactiveThenStartIsAtIfdefEol)
   TEST_METHOD(TUWhenUnsaveFileThenOK)
+  TEST_METHOD(TUWhenPreambleThenIncludedBodiesSkipped)
+  TEST_METHOD(TUWhenReparsePreambleThenEditsSeen)
 
   TEST_METHOD(QualifiedNameClass)
   TEST_METHOD(QualifiedNameVariable)
@@ -159,6 +162,47 @@ TEST_F(DXIntellisenseTest, CursorWhenCBufferRefThenFound) {
   VERIFY_ARE_EQUAL(2U, line);
 }
 
+TEST_F(DXIntellisenseTest, CursorWhenFindReferencesRepeatedThenSameResults) {
+  char program[] =
+    "int a; int b;\r\n"
+    "int main() { return\r\n"
+    "a + b +\r\n"
+    "a; }";
+
+  CComPtr<IDxcCursor> aRefCursor;
+  CComPtr<IDxcCursor> bRefCursor;
+  CComPtr<IDxcFile> file;
+  CComPtr<IDxcSourceLocation> loc;
+  unsigned line;
+
+  CompilationResult c(CompilationResult::CreateForProgram(program, strlen(program)));
+  VERIFY_ARE_EQUAL(true, c.ParseSucceeded());
+  ExpectCursorAt(c.TU, 3, 1, DxcCursor_DeclRefExpr, &aRefCursor);
+  ExpectCursorAt(c.TU, 3, 5, DxcCursor_DeclRefExpr, &bRefCursor);
+  VERIFY_SUCCEEDED(c.TU->GetFile(CompilationResult::getDefaultFileName(), &file));
+
+  // The second lookup of 'a' and the lookup of 'b' are served by the index
+  // the first one builds; all must match a walk of the file.
+  for (int i = 0; i < 2; ++i) {
+    CComInterfaceArray<IDxcCursor> refs;
+    VERIFY_SUCCEEDED(aRefCursor->FindReferencesInFile(file, 0, 8, refs.size_ref(), refs.data_ref()));
+    VERIFY_ARE_EQUAL(3U, refs.size());
+    loc.Release();
+    VERIFY_SUCCEEDED(refs.begin()[2]->GetLocation(&loc));
+    VERIFY_SUCCEEDED(loc->GetSpellingLocation(nullptr, &line, nullptr, nullptr));
+    VERIFY_ARE_EQUAL(4U, line);
+  }
+
+  CComInterfaceArray<IDxcCursor> refs;
+  VERIFY_SUCCEEDED(bRefCursor->FindReferencesInFile(file, 0, 8, refs.size_ref(), refs.data_ref()));
+  VERIFY_ARE_EQUAL(2U, refs.size());
+
+  // Skipping pages through the same results.
+  CComInterfaceArray<IDxcCursor> skipped;
+  VERIFY_SUCCEEDED(aRefCursor->FindReferencesInFile(file, 1, 8, skipped.size_ref(), skipped.data_ref()));
+  VERIFY_ARE_EQUAL(2U, skipped.size());
+}
+
 TEST_F(DXIntellisenseTest, InclusionWhenMissingThenError) {
   CComPtr<IDxcIntelliSense> isense;
   CComPtr<IDxcIndex> index;
@@ -444,6 +488,88 @@ TEST_F(DXIntellisenseTest, TUWhenUnsaveFileThenOK) {
   }
 }
 
+TEST_F(DXIntellisenseTest, TUWhenPreambleThenIncludedBodiesSkipped) {
+  // With the preamble option, the bodies of included functions aren't
+  // parsed, so the error in the header isn't reported; the one in the
+  // main file still is.
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcUnsavedFile> unsaved[2];
+  CComPtr<IDxcTranslationUnit> TU;
+  const char main_text[] =
+    "#include \"inc.h\"\r\n"
+    "float4 main() : SV_Target { return helper() + g_missing_main; }";
+  const char header_text[] = "float helper() { return g_missing_header; }";
+  unsigned diagCount;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", header_text, strlen(header_text), &unsaved[0]));
+  VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_text, strlen(main_text), &unsaved[1]));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+    (DxcTranslationUnitFlags)(DxcTranslationUnitFlags_UseCallerThread | DxcTranslationUnitFlags_PrecompiledPreamble), &TU));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(1U, diagCount);
+
+  // The same holds after a reparse.
+  VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+  VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(1U, diagCount);
+
+  // The option isn't part of the defaults, which parse everything.
+  DxcTranslationUnitFlags defaultOptions;
+  CComPtr<IDxcTranslationUnit> defaultTU;
+  VERIFY_SUCCEEDED(isense->GetDefaultEditingTUOptions(&defaultOptions));
+  VERIFY_ARE_EQUAL(0U, (unsigned)(defaultOptions & DxcTranslationUnitFlags_PrecompiledPreamble));
+  VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2,
+    defaultOptions, &defaultTU));
+  VERIFY_SUCCEEDED(defaultTU->GetNumDiagnostics(&diagCount));
+  VERIFY_ARE_EQUAL(2U, diagCount);
+}
+
+TEST_F(DXIntellisenseTest, TUWhenReparsePreambleThenEditsSeen) {
+  // Reparse a file that includes a large header, as an editor does on each
+  // keystroke, with the preamble option. Edits to the main file and to the
+  // header both show up in the diagnostics.
+  std::string header_text;
+  for (unsigned i = 0; i < 2000; ++i) {
+    std::string n = std::to_string(i);
+    header_text += "float4 f" + n + "(float4 v) { float4 r = v * " + n +
+                   "; for (int j = 0; j < 4; ++j) r = r * r + v; return r; }\r\n";
+  }
+  const char *main_texts[] = {
+    "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return f1(1); }",
+    "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return f1(undeclared); }",
+    "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return extra_fn(2); }",
+    "#include \"inc.h\"\r\nfloat4 main() : SV_Target { return extra_fn(2); }",
+  };
+  const unsigned expectedDiags[] = { 0, 1, 1, 0 };
+
+  CComPtr<IDxcIntelliSense> isense;
+  CComPtr<IDxcIndex> index;
+  CComPtr<IDxcTranslationUnit> TU;
+  VERIFY_SUCCEEDED(CompilationResult::DefaultHlslSupport->CreateIntellisense(&isense));
+  VERIFY_SUCCEEDED(isense->CreateIndex(&index));
+  DxcTranslationUnitFlags flags = (DxcTranslationUnitFlags)(
+      DxcTranslationUnitFlags_UseCallerThread | DxcTranslationUnitFlags_PrecompiledPreamble);
+  for (unsigned i = 0; i < _countof(main_texts); ++i) {
+    CComPtr<IDxcUnsavedFile> unsaved[2];
+    VERIFY_SUCCEEDED(isense->CreateUnsavedFile("./inc.h", header_text.c_str(), header_text.size(), &unsaved[0]));
+    VERIFY_SUCCEEDED(isense->CreateUnsavedFile("file.hlsl", main_texts[i], strlen(main_texts[i]), &unsaved[1]));
+    if (i == 0)
+      VERIFY_SUCCEEDED(index->ParseTranslationUnit("file.hlsl", nullptr, 0, &unsaved[0].p, 2, flags, &TU));
+    else
+      VERIFY_SUCCEEDED(TU->Reparse(&unsaved[0].p, 2));
+
+    unsigned diagCount;
+    VERIFY_SUCCEEDED(TU->GetNumDiagnostics(&diagCount));
+    VERIFY_ARE_EQUAL(expectedDiags[i], diagCount);
+
+    // Declare the missing function in the header for the last reparse.
+    if (i == 2)
+      header_text += "float4 extra_fn(float4 v) { return v; }\r\n";
+  }
+}
+
 TEST_F(DXIntellisenseTest, QualifiedNameClass) {
   char program[] =
     "class TheClass {\r\n"
@@ -42,13 +42,21 @@
 #include "dxc/Support/Global.h"
 #include "dxc/Support/dxcapi.use.h"
 #include "dxc/Support/HLSLOptions.h"
+#include "dxc/Support/FileIOHelper.h"
 #include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilContainerReader.h"
+#include "dxc/DxilContainer/DxilShaderArchive.h"
 #include "dxc/DxilContainer/DxilRuntimeReflection.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+#include "dxc/DxilContainer/DxilShaderStatistics.h"
+#include "dxc/DxilRootSignature/DxilRootSignature.h"
 #include "dxc/DXIL/DxilShaderFlags.h"
 #include "dxc/DXIL/DxilUtil.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <fstream>
 #include <chrono>
+#include <thread>
 
 #include <codecvt>
 
@@ -86,10 +94,18 @@ public:
   TEST_METHOD(CompileWhenDebugSourceThenSourceMatters)
   TEST_METHOD(CompileWhenOkThenCheckRDAT)
   TEST_METHOD(CompileWhenOkThenCheckRDAT2)
+  TEST_METHOD(CompileWhenOkThenRDATFindsByName)
+  TEST_METHOD(CompileWhenOkThenRDATMergesStrings)
+  TEST_METHOD(CompileWhenOkThenPSVSharesSemanticNames)
   TEST_METHOD(CompileWhenOkThenCheckReflection1)
   TEST_METHOD(CompileWhenOKThenIncludesFeatureInfo)
   TEST_METHOD(CompileWhenOKThenIncludesSignatures)
   TEST_METHOD(CompileWhenSigSquareThenIncludeSplit)
+  TEST_METHOD(CompileWhenCompressPartsThenReadersDecompress)
+  TEST_METHOD(CompileWhenDebugInfoThenSemanticHashSame)
+  TEST_METHOD(ContainerViewWhenFileMappedThenPartsInPlace)
+  TEST_METHOD(BlobFromFileWhenTruncatedThenKeepsContents)
+  TEST_METHOD(ShaderArchiveWhenPermutationsThenPartsShared)
   TEST_METHOD(DisassemblyWhenMissingThenFails)
   TEST_METHOD(DisassemblyWhenBCInvalidThenFails)
   TEST_METHOD(DisassemblyWhenInvalidThenFails)
@@ -98,6 +114,13 @@ public:
   TEST_METHOD(DxilContainerUnitTest)
 
   TEST_METHOD(ReflectionMatchesDXBC_CheckIn)
+  TEST_METHOD(ReflectionFromPSVWhenOkThenMatchesBitcode)
+  TEST_METHOD(ReflectionWhenStatisticsThenCountsInstructions)
+  TEST_METHOD(RootSignatureWhenOptimizedThenRankedByFrequency)
+  TEST_METHOD(RootSignatureWhenSameBytesThenCachedOnce)
+  TEST_METHOD(ReflectionWhenStructSharedThenTypesShared)
+  TEST_METHOD(ReflectionWhenLibraryThenFunctionTableMatches)
+  TEST_METHOD(ReflectionWhenSharedThenQueriedFromThreads)
   BEGIN_TEST_METHOD(ReflectionMatchesDXBC_Full)
     TEST_METHOD_PROPERTY(L"Priority", L"1")
   END_TEST_METHOD()
@@ -1036,6 +1059,156 @@ static void Ref1_CheckBinding_b_buf(D3D12_SHADER_INPUT_BIND_DESC &resDesc) {
 }
 
 
+TEST_F(DxilContainerTest, CompileWhenOkThenRDATFindsByName) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  const char *shader = "float c_buf;"
+    "RWTexture1D<int4> tex : register(u5);"
+    "Texture1D<float4> tex2 : register(t0);"
+    "RWByteAddressBuffer b_buf;"
+    "export float function2(float x) { return x + tex[0].x; }"
+    "export float function0(float x) { return x + c_buf + tex2[0].x; }"
+    "export float function1(float x) { return x + b_buf.Load(0); }"
+    "export float function1(int x) { return x; }";
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pProgram;
+  CComPtr<IDxcOperationResult> pResult;
+  // The index is only written on request.
+  LPCWSTR args[] = { L"-Qcompact_parts" };
+
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  CreateBlobFromText(shader, &pSource);
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"hlsl.hlsl", L"main",
+                                      L"lib_6_3", args, _countof(args),
+                                      nullptr, 0, nullptr, &pResult));
+  HRESULT hrStatus;
+  VERIFY_SUCCEEDED(pResult->GetStatus(&hrStatus));
+  VERIFY_SUCCEEDED(hrStatus);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  const hlsl::DxilPartHeader *pPart = hlsl::GetDxilPartByType(
+      pHeader, hlsl::DxilFourCC::DFCC_RuntimeData);
+  VERIFY_IS_NOT_NULL(pPart);
+
+  using namespace hlsl::RDAT;
+  DxilRuntimeData context(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  VERIFY_IS_TRUE(context.HasNameIndex());
+  FunctionTableReader *funcTableReader = context.GetFunctionTableReader();
+  ResourceTableReader *resTableReader = context.GetResourceTableReader();
+  VERIFY_ARE_EQUAL(funcTableReader->GetNumFunctions(), 4);
+  for (uint32_t i = 0; i < funcTableReader->GetNumFunctions(); ++i) {
+    FunctionReader funcReader = funcTableReader->GetItem(i);
+    VERIFY_ARE_EQUAL(funcTableReader->FindFunction(funcReader.GetName()), i);
+    uint32_t first =
+        funcTableReader->FindFunctionByUnmangledName(funcReader.GetUnmangledName());
+    VERIFY_IS_TRUE(first <= i);
+    VERIFY_ARE_EQUAL(
+        strcmp(funcTableReader->GetItem(first).GetUnmangledName(),
+               funcReader.GetUnmangledName()), 0);
+  }
+  VERIFY_ARE_NOT_EQUAL(funcTableReader->FindFunctionByUnmangledName("function1"),
+                       UINT_MAX);
+  VERIFY_ARE_EQUAL(funcTableReader->FindFunction("function3"), UINT_MAX);
+  VERIFY_ARE_EQUAL(funcTableReader->FindFunctionByUnmangledName("function3"),
+                   UINT_MAX);
+  for (uint32_t i = 0; i < resTableReader->GetNumResources(); ++i) {
+    ResourceReader resReader = resTableReader->GetItem(i);
+    VERIFY_ARE_EQUAL(resTableReader->FindResource(resReader.GetName()), i);
+  }
+  VERIFY_ARE_EQUAL(resTableReader->FindResource("tex3"), UINT_MAX);
+
+  // By default the part has no index, and the lookups scan the tables.
+  CComPtr<IDxcBlob> pDefaultProgram;
+  CompileToProgram(shader, L"main", L"lib_6_3", nullptr, 0, &pDefaultProgram);
+  pHeader = hlsl::IsDxilContainerLike(pDefaultProgram->GetBufferPointer(),
+                                      pDefaultProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  pPart = hlsl::GetDxilPartByType(pHeader, hlsl::DxilFourCC::DFCC_RuntimeData);
+  VERIFY_IS_NOT_NULL(pPart);
+  DxilRuntimeData defaultContext(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  VERIFY_IS_FALSE(defaultContext.HasNameIndex());
+  resTableReader = defaultContext.GetResourceTableReader();
+  VERIFY_ARE_EQUAL(resTableReader->FindResource("tex2"),
+                   context.GetResourceTableReader()->FindResource("tex2"));
+}
+
+TEST_F(DxilContainerTest, CompileWhenOkThenRDATMergesStrings) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  // The unmangled function name ends the resource name, which goes into the
+  // string table first.
+  const char *shader = "RWByteAddressBuffer rw_main;"
+    "export float main(float x) { return x + rw_main.Load(0); }";
+  CComPtr<IDxcBlob> pProgram;
+  LPCWSTR args[] = { L"-Qcompact_parts" };
+  CompileToProgram(shader, L"main", L"lib_6_3", args, _countof(args),
+                   &pProgram);
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  const hlsl::DxilPartHeader *pPart = hlsl::GetDxilPartByType(
+      pHeader, hlsl::DxilFourCC::DFCC_RuntimeData);
+  VERIFY_IS_NOT_NULL(pPart);
+
+  using namespace hlsl::RDAT;
+  DxilRuntimeData context(hlsl::GetDxilPartData(pPart), pPart->PartSize);
+  ResourceTableReader *resTableReader = context.GetResourceTableReader();
+  FunctionTableReader *funcTableReader = context.GetFunctionTableReader();
+  VERIFY_ARE_EQUAL(resTableReader->GetNumResources(), 1);
+  VERIFY_ARE_EQUAL(funcTableReader->GetNumFunctions(), 1);
+  const char *resName = resTableReader->GetItem(0).GetName();
+  const char *funcName = funcTableReader->GetItem(0).GetUnmangledName();
+  VERIFY_ARE_EQUAL(strcmp(resName, "rw_main"), 0);
+  VERIFY_ARE_EQUAL(strcmp(funcName, "main"), 0);
+  VERIFY_ARE_EQUAL(funcName, resName + 3);
+}
+
+TEST_F(DxilContainerTest, CompileWhenOkThenPSVSharesSemanticNames) {
+  const char *shader =
+    "struct VSOut { float4 pos : SV_Position; float4 uv : TEXCOORD0; };"
+    "VSOut main(float4 pos : POSITION, float4 uv : TEXCOORD0) {"
+    "  VSOut o; o.pos = pos; o.uv = uv; return o; }";
+  CComPtr<IDxcBlob> pProgram;
+  LPCWSTR args[] = { L"-Qcompact_parts" };
+  CompileToProgram(shader, L"main", L"vs_6_0", args, _countof(args),
+                   &pProgram);
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  const hlsl::DxilPartHeader *pPart = hlsl::GetDxilPartByType(
+      pHeader, hlsl::DxilFourCC::DFCC_PipelineStateValidation);
+  VERIFY_IS_NOT_NULL(pPart);
+
+  DxilPipelineStateValidation PSV;
+  VERIFY_IS_TRUE(PSV.InitFromPSV0(hlsl::GetDxilPartData(pPart),
+                                  pPart->PartSize));
+  VERIFY_ARE_EQUAL(PSV.GetSigInputElements(), 2);
+  VERIFY_ARE_EQUAL(PSV.GetSigOutputElements(), 2);
+  PSVSignatureElement0 *pInputUV = PSV.GetInputElement0(1);
+  PSVSignatureElement0 *pOutputUV = PSV.GetOutputElement0(1);
+  VERIFY_ARE_EQUAL(strcmp(PSV.GetSignatureElement(pInputUV).GetSemanticName(),
+                          "TEXCOORD"), 0);
+  VERIFY_ARE_EQUAL(strcmp(PSV.GetSignatureElement(pOutputUV).GetSemanticName(),
+                          "TEXCOORD"), 0);
+  VERIFY_ARE_EQUAL(pInputUV->SemanticName, pOutputUV->SemanticName);
+
+  // By default each name is written out again.
+  CComPtr<IDxcBlob> pDefaultProgram;
+  CompileToProgram(shader, L"main", L"vs_6_0", nullptr, 0, &pDefaultProgram);
+  pHeader = hlsl::IsDxilContainerLike(pDefaultProgram->GetBufferPointer(),
+                                      pDefaultProgram->GetBufferSize());
+  VERIFY_IS_NOT_NULL(pHeader);
+  pPart = hlsl::GetDxilPartByType(
+      pHeader, hlsl::DxilFourCC::DFCC_PipelineStateValidation);
+  VERIFY_IS_NOT_NULL(pPart);
+  DxilPipelineStateValidation DefaultPSV;
+  VERIFY_IS_TRUE(DefaultPSV.InitFromPSV0(hlsl::GetDxilPartData(pPart),
+                                         pPart->PartSize));
+  VERIFY_ARE_NOT_EQUAL(DefaultPSV.GetInputElement0(1)->SemanticName,
+                       DefaultPSV.GetOutputElement0(1)->SemanticName);
+}
+
 TEST_F(DxilContainerTest, CompileWhenOkThenCheckReflection1) {
   if (m_ver.SkipDxilVersion(1, 3)) return;
   const char *shader =
@@ -1213,6 +1386,117 @@ TEST_F(DxilContainerTest, CompileWhenOKThenIncludesFeatureInfo) {
   VERIFY_ARE_EQUAL(0U, *(const uint64_t *)hlsl::GetDxilPartData(*pPartIter));
 }
 
+TEST_F(DxilContainerTest, CompileWhenCompressPartsThenReadersDecompress) {
+  std::string program = "RWStructuredBuffer<float4> u;\n"
+                        "[numthreads(64, 1, 1)]\n"
+                        "void main(uint id : SV_DispatchThreadID) {\n"
+                        "  float4 v = u[id];\n";
+  for (unsigned i = 0; i < 200; ++i)
+    program += "  v = sin(v) * " + std::to_string(i) + " + cos(v.yzwx);\n";
+  program += "  u[id] = v;\n}\n";
+  LPCWSTR args[] = {L"/Zi"};
+  LPCWSTR compressArgs[] = {L"/Zi", L"/Qcompress_parts"};
+  CComPtr<IDxcBlob> pPlain, pCompressed;
+  CompileToProgram(program.c_str(), L"main", L"cs_6_0", args, _countof(args),
+                   &pPlain);
+  CompileToProgram(program.c_str(), L"main", L"cs_6_0", compressArgs,
+                   _countof(compressArgs), &pCompressed);
+
+  const hlsl::DxilContainerHeader *pPlainHeader =
+      (const hlsl::DxilContainerHeader *)pPlain->GetBufferPointer();
+  const hlsl::DxilContainerHeader *pCompressedHeader =
+      (const hlsl::DxilContainerHeader *)pCompressed->GetBufferPointer();
+  if (!hlsl::HasCompressedDxilParts(pCompressedHeader)) {
+    // Built without zlib; the container is left as it was.
+    VERIFY_ARE_EQUAL(pPlain->GetBufferSize(), pCompressed->GetBufferSize());
+    return;
+  }
+  VERIFY_IS_TRUE(pCompressed->GetBufferSize() < pPlain->GetBufferSize());
+
+  // Reflection sees the parts of the original container.
+  CComPtr<IDxcContainerReflection> pReflection;
+  UINT32 partCount;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pReflection));
+  VERIFY_SUCCEEDED(pReflection->Load(pCompressed));
+  VERIFY_SUCCEEDED(pReflection->GetPartCount(&partCount));
+  VERIFY_ARE_EQUAL(pPlainHeader->PartCount, partCount);
+  for (UINT32 i = 0; i < partCount; ++i) {
+    const hlsl::DxilPartHeader *pPart =
+        hlsl::GetDxilContainerPart(pPlainHeader, i);
+    UINT32 kind;
+    CComPtr<IDxcBlob> pContent;
+    VERIFY_SUCCEEDED(pReflection->GetPartKind(i, &kind));
+    VERIFY_ARE_EQUAL(pPart->PartFourCC, kind);
+    VERIFY_SUCCEEDED(pReflection->GetPartContent(i, &pContent));
+    VERIFY_ARE_EQUAL(pPart->PartSize, pContent->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPart),
+                               pContent->GetBufferPointer(), pPart->PartSize));
+  }
+
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcBlobEncoding> pDisassembly;
+  VERIFY_SUCCEEDED(CreateCompiler(&pCompiler));
+  VERIFY_SUCCEEDED(pCompiler->Disassemble(pCompressed, &pDisassembly));
+
+  const unsigned loadCount = 100;
+  auto start = std::chrono::steady_clock::now();
+  for (unsigned i = 0; i < loadCount; ++i)
+    VERIFY_SUCCEEDED(pReflection->Load(pCompressed));
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start).count();
+  hlsl_test::LogCommentFmt(
+      L"Container of %u bytes compressed to %u bytes; decompressed at %.1f MB/s",
+      (unsigned)pPlain->GetBufferSize(), (unsigned)pCompressed->GetBufferSize(),
+      loadCount * pPlain->GetBufferSize() / seconds / (1024 * 1024));
+}
+
+TEST_F(DxilContainerTest, CompileWhenDebugInfoThenSemanticHashSame) {
+  const char *program = "float4 main(float4 c : COLOR) : SV_Target {\n"
+                        "  return c * 2;\n"
+                        "}\n";
+  const char *other = "float4 main(float4 c : COLOR) : SV_Target {\n"
+                      "  return c * 3;\n"
+                      "}\n";
+  LPCWSTR debugArgs[] = {L"/Zi", L"/Qembed_debug"};
+  LPCWSTR compressArgs[] = {L"/Zi", L"/Qembed_debug", L"/Qcompress_parts"};
+  CComPtr<IDxcBlob> pPlain, pDebug, pCompressed, pOther;
+  CompileToProgram(program, L"main", L"ps_6_0", nullptr, 0, &pPlain);
+  CompileToProgram(program, L"main", L"ps_6_0", debugArgs,
+                   _countof(debugArgs), &pDebug);
+  CompileToProgram(program, L"main", L"ps_6_0", compressArgs,
+                   _countof(compressArgs), &pCompressed);
+  CompileToProgram(other, L"main", L"ps_6_0", nullptr, 0, &pOther);
+
+  CComPtr<IDxcContainerReflection> pReflection;
+  CComPtr<IDxcContainerSemanticHash> pSemanticHash;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pReflection));
+  VERIFY_SUCCEEDED(pReflection.QueryInterface(&pSemanticHash));
+  UINT64 plainHash, debugHash, compressedHash, otherHash;
+  VERIFY_SUCCEEDED(pReflection->Load(pPlain));
+  VERIFY_SUCCEEDED(pSemanticHash->GetSemanticHash(&plainHash));
+  VERIFY_SUCCEEDED(pReflection->Load(pDebug));
+  VERIFY_SUCCEEDED(pSemanticHash->GetSemanticHash(&debugHash));
+  VERIFY_SUCCEEDED(pReflection->Load(pCompressed));
+  VERIFY_SUCCEEDED(pSemanticHash->GetSemanticHash(&compressedHash));
+  VERIFY_SUCCEEDED(pReflection->Load(pOther));
+  VERIFY_SUCCEEDED(pSemanticHash->GetSemanticHash(&otherHash));
+
+  const hlsl::DxilContainerHeader *pDebugHeader =
+      (const hlsl::DxilContainerHeader *)pDebug->GetBufferPointer();
+  VERIFY_IS_NOT_NULL(hlsl::GetDxilPartByType(
+      pDebugHeader, hlsl::DFCC_ShaderDebugInfoDXIL));
+  VERIFY_ARE_EQUAL(plainHash, debugHash);
+  VERIFY_ARE_EQUAL(plainHash, compressedHash);
+  VERIFY_ARE_NOT_EQUAL(plainHash, otherHash);
+
+  uint64_t directHash;
+  VERIFY_SUCCEEDED(hlsl::GetDxilContainerSemanticHash(pDebugHeader,
+                                                      &directHash));
+  VERIFY_ARE_EQUAL(debugHash, directHash);
+}
+
 TEST_F(DxilContainerTest, DisassemblyWhenBCInvalidThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
@@ -1238,6 +1522,176 @@ TEST_F(DxilContainerTest, DisassemblyWhenBCInvalidThenFails) {
   VERIFY_FAILED(pCompiler->Disassemble(pProgram, &pDisassembly));
 }
 
+TEST_F(DxilContainerTest, BlobFromFileWhenTruncatedThenKeepsContents) {
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  std::wstring fileName = std::wstring(TempPath) + L"BlobFromFile.bin";
+
+  // The blob holds its own copy of the bytes, so it must outlive both the
+  // file name and any later change to the file.
+  for (size_t size : {size_t(4096), size_t(3 * 1024 * 1024 + 17)}) {
+    std::vector<char> data(size);
+    for (size_t i = 0; i < size; ++i)
+      data[i] = (char)(i * 31 + (i >> 12));
+    hlsl::WriteBinaryFile(fileName.c_str(), data.data(), (DWORD)size);
+
+    UINT32 codePage = CP_ACP;
+    CComPtr<IDxcBlobEncoding> pBlob;
+    VERIFY_SUCCEEDED(
+        hlsl::DxcCreateBlobFromFile(fileName.c_str(), &codePage, &pBlob));
+    BOOL known;
+    UINT32 blobCodePage;
+    VERIFY_SUCCEEDED(pBlob->GetEncoding(&known, &blobCodePage));
+    VERIFY_IS_TRUE(known);
+    VERIFY_ARE_EQUAL(size, pBlob->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(data.data(), pBlob->GetBufferPointer(), size));
+    hlsl::WriteBinaryFile(fileName.c_str(), data.data(), 1);
+    VERIFY_ARE_EQUAL(0, memcmp(data.data(), pBlob->GetBufferPointer(), size));
+    DeleteFileW(fileName.c_str());
+    VERIFY_ARE_EQUAL(0, memcmp(data.data(), pBlob->GetBufferPointer(), size));
+  }
+}
+
+TEST_F(DxilContainerTest, ContainerViewWhenFileMappedThenPartsInPlace) {
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram("float4 main() : SV_Target { return 1; }", L"main",
+                   L"ps_6_0", nullptr, 0, &pProgram);
+
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+  std::wstring fileName = std::wstring(TempPath) + L"ContainerView.dxo";
+  hlsl::WriteBinaryFile(fileName.c_str(), pProgram->GetBufferPointer(),
+                        (DWORD)pProgram->GetBufferSize());
+
+  // Parts are read from the mapping and match the compiled container.
+  const hlsl::DxilContainerHeader *pHeader =
+      (const hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+  {
+    hlsl::DxilContainerView view;
+    VERIFY_SUCCEEDED(view.LoadFile(fileName.c_str()));
+    VERIFY_ARE_EQUAL(pHeader->PartCount, view.GetPartCount());
+    for (uint32_t i = 0; i < view.GetPartCount(); ++i) {
+      const hlsl::DxilPartHeader *pExpected =
+          hlsl::GetDxilContainerPart(pHeader, i);
+      const hlsl::DxilPartHeader *pPart = view.GetPart(i);
+      VERIFY_IS_NOT_NULL(pPart);
+      VERIFY_IS_TRUE((const char *)pPart > (const char *)view.GetHeader());
+      VERIFY_ARE_EQUAL(pExpected->PartFourCC, pPart->PartFourCC);
+      VERIFY_ARE_EQUAL(pExpected->PartSize, pPart->PartSize);
+      VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pExpected),
+                                 hlsl::GetDxilPartData(pPart),
+                                 pPart->PartSize));
+    }
+    VERIFY_ARE_EQUAL(view.GetPart(0), view.FindPart(view.GetPart(0)->PartFourCC));
+    VERIFY_IS_NULL(view.FindPart(hlsl::DFCC_CompressedPart));
+  }
+  DeleteFileW(fileName.c_str());
+
+  // A truncated container still loads, but the parts past the end are
+  // rejected when they are accessed.
+  std::vector<char> truncated((const char *)pHeader,
+                              (const char *)pHeader +
+                                  pHeader->ContainerSizeInBytes);
+  hlsl::DxilContainerHeader *pTruncated =
+      (hlsl::DxilContainerHeader *)truncated.data();
+  const hlsl::DxilPartHeader *pLast =
+      hlsl::GetDxilContainerPart(pHeader, pHeader->PartCount - 1);
+  pTruncated->ContainerSizeInBytes =
+      (uint32_t)((const char *)pLast - (const char *)pHeader) +
+      sizeof(hlsl::DxilPartHeader);
+  CComPtr<IDxcBlobEncoding> pTruncatedBlob;
+  CreateBlobPinned(truncated.data(), pTruncated->ContainerSizeInBytes, CP_ACP,
+                   &pTruncatedBlob);
+  hlsl::DxilContainerView view;
+  VERIFY_SUCCEEDED(view.Load(pTruncatedBlob));
+  VERIFY_IS_NOT_NULL(view.GetPart(0));
+  VERIFY_IS_NULL(view.GetPart(pHeader->PartCount - 1));
+
+  // Other files fail to load.
+  CComPtr<IDxcBlobEncoding> pText;
+  CreateBlobFromText("not a container", &pText);
+  VERIFY_ARE_EQUAL(DXC_E_CONTAINER_INVALID, view.Load(pText));
+  VERIFY_IS_FALSE(view.IsLoaded());
+}
+
+TEST_F(DxilContainerTest, ShaderArchiveWhenPermutationsThenPartsShared) {
+  // The permutations have the same signatures and differ in their code.
+  const char *programs[] = {
+      "float4 main(float4 c : COLOR) : SV_Target { return c * 2; }",
+      "float4 main(float4 c : COLOR) : SV_Target { return c * 3; }",
+      "float4 main(float4 c : COLOR) : SV_Target { return sqrt(c); }",
+  };
+  CComPtr<IDxcBlob> pPrograms[_countof(programs)];
+  size_t totalSize = 0;
+  for (size_t i = 0; i < _countof(programs); ++i) {
+    CompileToProgram(programs[i], L"main", L"ps_6_0", nullptr, 0,
+                     &pPrograms[i]);
+    totalSize += pPrograms[i]->GetBufferSize();
+  }
+
+  CComPtr<IDxcShaderArchiveBuilder> pBuilder;
+  CComPtr<IDxcBlob> pArchiveBlob;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcShaderArchiveBuilder,
+                                               &pBuilder));
+  for (IDxcBlob *pProgram : pPrograms)
+    VERIFY_SUCCEEDED(pBuilder->AddContainer(pProgram));
+  // Adding a container again has no effect.
+  VERIFY_SUCCEEDED(pBuilder->AddContainer(pPrograms[0]));
+  VERIFY_SUCCEEDED(pBuilder->SerializeArchive(&pArchiveBlob));
+  VERIFY_IS_TRUE(pArchiveBlob->GetBufferSize() < totalSize);
+
+  CComPtr<IDxcShaderArchive> pArchive;
+  UINT32 containerCount;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcShaderArchive,
+                                               &pArchive));
+  VERIFY_SUCCEEDED(pArchive->Load(pArchiveBlob));
+  VERIFY_SUCCEEDED(pArchive->GetContainerCount(&containerCount));
+  VERIFY_ARE_EQUAL(_countof(programs), containerCount);
+
+  // Each container is found by its key and comes back unchanged.
+  for (IDxcBlob *pProgram : pPrograms) {
+    const hlsl::DxilContainerHeader *pHeader =
+        (const hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+    hlsl::DxilContainerHash key;
+    hlsl::GetDxilShaderArchiveKey(pHeader, &key);
+    UINT32 index, partCount;
+    BYTE foundKey[hlsl::DxilContainerHashSize];
+    VERIFY_SUCCEEDED(pArchive->FindContainer(key.Digest, &index));
+    VERIFY_SUCCEEDED(pArchive->GetContainerKey(index, foundKey));
+    VERIFY_ARE_EQUAL(0, memcmp(key.Digest, foundKey, sizeof(foundKey)));
+
+    CComPtr<IDxcBlob> pContainer;
+    VERIFY_SUCCEEDED(pArchive->GetContainer(index, &pContainer));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pContainer->GetBufferSize());
+    VERIFY_ARE_EQUAL(0, memcmp(pProgram->GetBufferPointer(),
+                               pContainer->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+
+    VERIFY_SUCCEEDED(pArchive->GetPartCount(index, &partCount));
+    VERIFY_ARE_EQUAL(pHeader->PartCount, partCount);
+    for (UINT32 i = 0; i < partCount; ++i) {
+      const hlsl::DxilPartHeader *pPart = hlsl::GetDxilContainerPart(pHeader, i);
+      UINT32 kind;
+      CComPtr<IDxcBlob> pContent;
+      VERIFY_SUCCEEDED(pArchive->GetPartKind(index, i, &kind));
+      VERIFY_ARE_EQUAL(pPart->PartFourCC, kind);
+      VERIFY_SUCCEEDED(pArchive->GetPartContent(index, i, &pContent));
+      VERIFY_ARE_EQUAL(pPart->PartSize, pContent->GetBufferSize());
+      VERIFY_ARE_EQUAL(0, memcmp(hlsl::GetDxilPartData(pPart),
+                                 pContent->GetBufferPointer(),
+                                 pPart->PartSize));
+    }
+  }
+
+  BYTE missingKey[hlsl::DxilContainerHashSize] = {};
+  UINT32 missingIndex;
+  VERIFY_ARE_EQUAL(HRESULT_FROM_WIN32(ERROR_NOT_FOUND),
+                   pArchive->FindContainer(missingKey, &missingIndex));
+  VERIFY_ARE_EQUAL(DXC_E_CONTAINER_INVALID, pArchive->Load(pPrograms[0]));
+}
+
 TEST_F(DxilContainerTest, DisassemblyWhenMissingThenFails) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcBlobEncoding> pSource;
@@ -1437,6 +1891,464 @@ TEST_F(DxilContainerTest, ReflectionMatchesDXBC_CheckIn) {
   ReflectionTest(hlsl_test::GetPathToHlslDataFile(L"..\\CodeGenHLSL\\Samples\\DX11\\SubD11_SmoothPS.hlsl").c_str(), false);
 }
 
+TEST_F(DxilContainerTest, RootSignatureWhenOptimizedThenRankedByFrequency) {
+  const char *shader =
+    "[RootSignature(\"RootConstants(num32BitConstants=8, b0),"
+    " DescriptorTable(CBV(b1)), DescriptorTable(SRV(t0)), CBV(b2),"
+    " DescriptorTable(UAV(u5))\")]"
+    "cbuffer Static : register(b0) { float4 s[2]; };"
+    "cbuffer PerDraw : register(b1) { float4 d; };"
+    "ByteAddressBuffer instances : register(t0);"
+    "float4 main(uint i : I) : SV_Target {"
+    "  return s[i & 1] * d + asfloat(instances.Load4(i * 16)); }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(shader, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  const hlsl::DxilContainerHeader *pHeader =
+      (const hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+  const hlsl::DxilPartHeader *pRSPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_RootSignature);
+  const hlsl::DxilPartHeader *pPSVPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_PipelineStateValidation);
+  VERIFY_IS_NOT_NULL(pRSPart);
+  VERIFY_IS_NOT_NULL(pPSVPart);
+
+  hlsl::RootSignatureHandle RS;
+  RS.LoadSerialized((const uint8_t *)hlsl::GetDxilPartData(pRSPart),
+                    pRSPart->PartSize);
+  RS.Deserialize();
+  hlsl::DxilRootSignatureShader Shader = {
+      hlsl::DXIL::ShaderKind::Pixel, hlsl::GetDxilPartData(pPSVPart),
+      pPSVPart->PartSize};
+  // The root constants never change, the instances change on every draw.
+  const uint32_t frequencies[] = {0, 10, 100, 5, 1};
+  hlsl::DxilRootParameterRemap remap[5];
+  CComPtr<IDxcBlob> pOptimized;
+  std::string diag;
+  llvm::raw_string_ostream diagStream(diag);
+  bool bOptimized = hlsl::OptimizeRootSignature(
+      RS.GetDesc(), frequencies, &Shader, 1, &pOptimized, remap, diagStream);
+  diagStream.flush();
+  LogCommentFmt(L"%S", diag.c_str());
+  VERIFY_IS_TRUE(bOptimized);
+
+  // b2 and u5 aren't read; the tables become root descriptors and the
+  // static constants a root CBV.
+  VERIFY_ARE_EQUAL(2u, remap[0].NewIndex);
+  VERIFY_IS_TRUE(remap[0].NewType == hlsl::DxilRootParameterType::CBV);
+  VERIFY_ARE_EQUAL(1u, remap[1].NewIndex);
+  VERIFY_IS_TRUE(remap[1].NewType == hlsl::DxilRootParameterType::CBV);
+  VERIFY_ARE_EQUAL(0u, remap[2].NewIndex);
+  VERIFY_IS_TRUE(remap[2].NewType == hlsl::DxilRootParameterType::SRV);
+  VERIFY_ARE_EQUAL(hlsl::DxilRootParameterRemoved, remap[3].NewIndex);
+  VERIFY_ARE_EQUAL(hlsl::DxilRootParameterRemoved, remap[4].NewIndex);
+
+  hlsl::RootSignatureHandle Optimized;
+  Optimized.LoadSerialized((const uint8_t *)pOptimized->GetBufferPointer(),
+                           (uint32_t)pOptimized->GetBufferSize());
+  Optimized.Deserialize();
+  const hlsl::DxilRootSignatureDesc1 &Desc = Optimized.GetDesc()->Desc_1_1;
+  VERIFY_ARE_EQUAL(3u, Desc.NumParameters);
+  VERIFY_ARE_EQUAL(0u, Desc.pParameters[0].Descriptor.ShaderRegister);
+  VERIFY_ARE_EQUAL(1u, Desc.pParameters[1].Descriptor.ShaderRegister);
+  VERIFY_ARE_EQUAL(0u, Desc.pParameters[2].Descriptor.ShaderRegister);
+}
+
+TEST_F(DxilContainerTest, RootSignatureWhenSameBytesThenCachedOnce) {
+  const char *shader =
+    "[RootSignature(\"DescriptorTable(SRV(t0))\")]"
+    "Buffer<float4> buf : register(t0);"
+    "float4 main(uint i : I) : SV_Target { return buf[i]; }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(shader, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  const hlsl::DxilContainerHeader *pHeader =
+      (const hlsl::DxilContainerHeader *)pProgram->GetBufferPointer();
+  const hlsl::DxilPartHeader *pRSPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_RootSignature);
+  const hlsl::DxilPartHeader *pPSVPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_PipelineStateValidation);
+  VERIFY_IS_NOT_NULL(pRSPart);
+  VERIFY_IS_NOT_NULL(pPSVPart);
+
+  // A copy of the same bytes finds the same entry.
+  std::vector<char> copy(hlsl::GetDxilPartData(pRSPart),
+                         hlsl::GetDxilPartData(pRSPart) + pRSPart->PartSize);
+  std::shared_ptr<const hlsl::CachedRootSignature> pFirst =
+      hlsl::GetCachedRootSignature(hlsl::GetDxilPartData(pRSPart),
+                                   pRSPart->PartSize);
+  std::shared_ptr<const hlsl::CachedRootSignature> pSecond =
+      hlsl::GetCachedRootSignature(copy.data(), (uint32_t)copy.size());
+  VERIFY_IS_TRUE(pFirst == pSecond);
+  VERIFY_IS_TRUE(pFirst->IsValid());
+
+  std::string diag;
+  llvm::raw_string_ostream diagStream(diag);
+  VERIFY_IS_TRUE(pFirst->VerifyShaderPSV(hlsl::DXIL::ShaderKind::Pixel,
+                                         hlsl::GetDxilPartData(pPSVPart),
+                                         pPSVPart->PartSize, diagStream));
+
+  // Entries in use outlive the cache.
+  hlsl::ClearRootSignatureCache();
+  VERIFY_IS_NOT_NULL(pFirst->GetDesc());
+  std::shared_ptr<const hlsl::CachedRootSignature> pThird =
+      hlsl::GetCachedRootSignature(copy.data(), (uint32_t)copy.size());
+  VERIFY_IS_TRUE(pFirst != pThird);
+}
+
+TEST_F(DxilContainerTest, ReflectionFromPSVWhenOkThenMatchesBitcode) {
+  const char *shader =
+    "float4 color;"
+    "Texture2D<float4> tex : register(t3, space1);"
+    "SamplerState samp : register(s2);"
+    "RWStructuredBuffer<float> results : register(u1);"
+    "float4 main(float4 pos : SV_Position, float2 uv : TEXCOORD0) : SV_Target {"
+    "  results[0] = uv.x;"
+    "  return tex.Sample(samp, uv) * color; }";
+  const char *csShader =
+    "RWByteAddressBuffer buf;"
+    "[numthreads(8, 4, 2)] void main(uint i : SV_GroupIndex) {"
+    "  buf.Store(i * 4, i); }";
+  struct { const char *program; LPCWSTR target; } cases[] = {
+    { shader, L"ps_6_0" }, { csShader, L"cs_6_0" } };
+
+  for (auto &c : cases) {
+    CComPtr<IDxcBlob> pProgram;
+    CompileToProgram(c.program, L"main", c.target, nullptr, 0, &pProgram);
+    CComPtr<IDxcContainerReflection> pContainerReflection;
+    VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                                 &pContainerReflection));
+    VERIFY_SUCCEEDED(pContainerReflection->Load(pProgram));
+    UINT32 psvIdx;
+    VERIFY_SUCCEEDED(pContainerReflection->FindFirstPartKind(
+        hlsl::DFCC_PipelineStateValidation, &psvIdx));
+    CComPtr<ID3D12ShaderReflection> pPartReflection, pReflection;
+    VERIFY_SUCCEEDED(pContainerReflection->GetPartReflection(
+        psvIdx, __uuidof(ID3D12ShaderReflection), (void **)&pPartReflection));
+    CreateReflectionFromBlob(pProgram, &pReflection);
+
+    // Parts answer these without the bitcode.
+    D3D12_SHADER_DESC desc;
+    VERIFY_SUCCEEDED(pReflection->GetDesc(&desc));
+    for (UINT i = 0; i < desc.BoundResources; ++i) {
+      D3D12_SHADER_INPUT_BIND_DESC partBind, bind;
+      VERIFY_SUCCEEDED(pPartReflection->GetResourceBindingDesc(i, &partBind));
+      VERIFY_SUCCEEDED(pReflection->GetResourceBindingDesc(i, &bind));
+      VERIFY_ARE_EQUAL(partBind.Type, bind.Type);
+      VERIFY_ARE_EQUAL(partBind.BindPoint, bind.BindPoint);
+      VERIFY_ARE_EQUAL(partBind.BindCount, bind.BindCount);
+      VERIFY_ARE_EQUAL(partBind.Space, bind.Space);
+      VERIFY_ARE_EQUAL(partBind.uID, bind.uID);
+    }
+    D3D12_SHADER_INPUT_BIND_DESC bind;
+    VERIFY_FAILED(pPartReflection->GetResourceBindingDesc(desc.BoundResources,
+                                                          &bind));
+    for (UINT i = 0; i < desc.InputParameters; ++i) {
+      D3D12_SIGNATURE_PARAMETER_DESC partParam, param;
+      VERIFY_SUCCEEDED(pPartReflection->GetInputParameterDesc(i, &partParam));
+      VERIFY_SUCCEEDED(pReflection->GetInputParameterDesc(i, &param));
+      VERIFY_ARE_EQUAL_STR(partParam.SemanticName, param.SemanticName);
+      VERIFY_ARE_EQUAL(partParam.SemanticIndex, param.SemanticIndex);
+      VERIFY_ARE_EQUAL(partParam.Register, param.Register);
+      VERIFY_ARE_EQUAL(partParam.SystemValueType, param.SystemValueType);
+      VERIFY_ARE_EQUAL(partParam.ComponentType, param.ComponentType);
+      VERIFY_ARE_EQUAL(partParam.Mask, param.Mask);
+    }
+    for (UINT i = 0; i < desc.OutputParameters; ++i) {
+      D3D12_SIGNATURE_PARAMETER_DESC partParam, param;
+      VERIFY_SUCCEEDED(pPartReflection->GetOutputParameterDesc(i, &partParam));
+      VERIFY_SUCCEEDED(pReflection->GetOutputParameterDesc(i, &param));
+      VERIFY_ARE_EQUAL_STR(partParam.SemanticName, param.SemanticName);
+      VERIFY_ARE_EQUAL(partParam.SystemValueType, param.SystemValueType);
+      VERIFY_ARE_EQUAL(partParam.Mask, param.Mask);
+    }
+    VERIFY_ARE_EQUAL(pPartReflection->GetRequiresFlags(),
+                     pReflection->GetRequiresFlags());
+
+    // The rest comes from the bitcode.
+    UINT x, y, z, partX, partY, partZ;
+    VERIFY_ARE_EQUAL(pPartReflection->GetThreadGroupSize(&partX, &partY, &partZ),
+                     pReflection->GetThreadGroupSize(&x, &y, &z));
+    VERIFY_ARE_EQUAL(partX, x);
+    VERIFY_ARE_EQUAL(partY, y);
+    VERIFY_ARE_EQUAL(partZ, z);
+    D3D12_SHADER_DESC partDesc;
+    VERIFY_SUCCEEDED(pPartReflection->GetDesc(&partDesc));
+    VERIFY_ARE_EQUAL(partDesc.ConstantBuffers, desc.ConstantBuffers);
+    VERIFY_ARE_EQUAL(partDesc.BoundResources, desc.BoundResources);
+    if (desc.BoundResources > 0) {
+      D3D12_SHADER_INPUT_BIND_DESC partBind;
+      VERIFY_SUCCEEDED(pReflection->GetResourceBindingDesc(0, &bind));
+      VERIFY_SUCCEEDED(
+          pPartReflection->GetResourceBindingDescByName(bind.Name, &partBind));
+      VERIFY_ARE_EQUAL_STR(partBind.Name, bind.Name);
+    }
+  }
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenStatisticsThenCountsInstructions) {
+  const char *shader =
+    "Texture2D<float4> tex; SamplerState samp; SamplerComparisonState cmp;"
+    "uint count;"
+    "float4 main(float2 uv : TEXCOORD0) : SV_Target {"
+    "  float4 c = tex.Sample(samp, uv);"
+    "  [loop] for (uint i = 0; i < count; ++i)"
+    "    c += tex.SampleCmp(cmp, uv * i, 0.5f);"
+    "  return (count & 1) ? c : tex.Load(int3(uv * 8, 0)); }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(shader, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_ShaderStatistics);
+  VERIFY_IS_NOT_NULL(pPart);
+  const hlsl::DxilShaderStatisticsHeader *pStatistics =
+      (const hlsl::DxilShaderStatisticsHeader *)hlsl::GetDxilPartData(pPart);
+  VERIFY_IS_TRUE(hlsl::IsValidDxilShaderStatistics(pStatistics, pPart->PartSize));
+  VERIFY_ARE_EQUAL(1u, pStatistics->EntryCount);
+  hlsl::DxilShaderStatisticsEntry entry;
+  VERIFY_IS_TRUE(hlsl::FindDxilShaderStatisticsEntry(pStatistics, "main", &entry));
+  VERIFY_IS_TRUE(entry.OpCountCount > 0);
+
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CreateReflectionFromBlob(pProgram, &pReflection);
+  D3D12_SHADER_DESC desc;
+  VERIFY_SUCCEEDED(pReflection->GetDesc(&desc));
+  VERIFY_ARE_EQUAL(entry.InstructionCount, desc.InstructionCount);
+  VERIFY_ARE_EQUAL(1u, desc.TextureNormalInstructions);
+  VERIFY_ARE_EQUAL(1u, desc.TextureCompInstructions);
+  VERIFY_ARE_EQUAL(1u, desc.TextureLoadInstructions);
+  VERIFY_IS_TRUE(desc.FloatInstructionCount > 0);
+  VERIFY_IS_TRUE(desc.DynamicFlowControlCount > 0);
+  VERIFY_ARE_EQUAL(entry.MovcInstructionCount,
+                   pReflection->GetMovcInstructionCount());
+
+  // Reflection from the parts reports the same without the bitcode.
+  CComPtr<IDxcContainerReflection> pContainerReflection;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pContainerReflection));
+  VERIFY_SUCCEEDED(pContainerReflection->Load(pProgram));
+  UINT32 psvIdx;
+  VERIFY_SUCCEEDED(pContainerReflection->FindFirstPartKind(
+      hlsl::DFCC_PipelineStateValidation, &psvIdx));
+  CComPtr<ID3D12ShaderReflection> pPartReflection;
+  VERIFY_SUCCEEDED(pContainerReflection->GetPartReflection(
+      psvIdx, __uuidof(ID3D12ShaderReflection), (void **)&pPartReflection));
+  D3D12_SHADER_DESC partDesc;
+  VERIFY_SUCCEEDED(pPartReflection->GetDesc(&partDesc));
+  VERIFY_ARE_EQUAL(desc.Version, partDesc.Version);
+  VERIFY_ARE_EQUAL(desc.ConstantBuffers, partDesc.ConstantBuffers);
+  VERIFY_ARE_EQUAL(desc.BoundResources, partDesc.BoundResources);
+  VERIFY_ARE_EQUAL(desc.InstructionCount, partDesc.InstructionCount);
+  VERIFY_ARE_EQUAL(desc.TextureCompInstructions, partDesc.TextureCompInstructions);
+  VERIFY_ARE_EQUAL(desc.InputPrimitive, partDesc.InputPrimitive);
+
+  // Stripping reflection leaves the part out.
+  LPCWSTR stripArgs[] = { L"/Qstrip_reflect" };
+  CComPtr<IDxcBlob> pStripped;
+  CompileToProgram(shader, L"main", L"ps_6_0", stripArgs, 1, &pStripped);
+  pHeader = hlsl::IsDxilContainerLike(pStripped->GetBufferPointer(),
+                                      pStripped->GetBufferSize());
+  VERIFY_IS_NULL(hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_ShaderStatistics));
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenStructSharedThenTypesShared) {
+  const char *shader =
+    "struct Inner { float3 dir; float4x4 xf[2]; };"
+    "struct Material { float4 albedo; Inner inner; uint flags; };"
+    "cbuffer A : register(b0) { Material matA; };"
+    "cbuffer B : register(b1) { float4 pad; Material matB; };"
+    "float4 main() : SV_Target {"
+    "  return matA.albedo + matB.inner.xf[1][0] + matB.flags; }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(shader, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CreateReflectionFromBlob(pProgram, &pReflection);
+
+  ID3D12ShaderReflectionType *pTypeA =
+      pReflection->GetConstantBufferByName("A")->GetVariableByName("matA")->GetType();
+  ID3D12ShaderReflectionType *pTypeB =
+      pReflection->GetConstantBufferByName("B")->GetVariableByName("matB")->GetType();
+  VERIFY_ARE_EQUAL(pTypeA, pTypeB);
+
+  // The shape is known before any member is built.
+  D3D12_SHADER_TYPE_DESC desc;
+  VERIFY_SUCCEEDED(pTypeA->GetDesc(&desc));
+  VERIFY_ARE_EQUAL(D3D_SVC_STRUCT, desc.Class);
+  VERIFY_ARE_EQUAL(3u, desc.Members);
+  VERIFY_ARE_EQUAL(4u + 3u + 2u * 16u + 1u, desc.Columns);
+
+  VERIFY_ARE_EQUAL_STR("inner", pTypeA->GetMemberTypeName(1));
+  ID3D12ShaderReflectionType *pInner = pTypeA->GetMemberTypeByName("inner");
+  VERIFY_ARE_EQUAL(pInner, pTypeB->GetMemberTypeByIndex(1));
+  VERIFY_SUCCEEDED(pInner->GetDesc(&desc));
+  VERIFY_ARE_EQUAL(16u, desc.Offset);
+  VERIFY_ARE_EQUAL(2u, desc.Members);
+  VERIFY_SUCCEEDED(pInner->GetMemberTypeByName("xf")->GetDesc(&desc));
+  VERIFY_ARE_EQUAL(D3D_SVC_MATRIX_COLUMNS, desc.Class);
+  VERIFY_ARE_EQUAL(2u, desc.Elements);
+  VERIFY_IS_NULL(pInner->GetMemberTypeByName("missing"));
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenLibraryThenFunctionTableMatches) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  const char *shader =
+    "struct Payload { float4 color; };"
+    "struct Attr { float2 bary; };"
+    "struct Param { uint4 data; };"
+    "RaytracingAccelerationStructure scene : register(t0);"
+    "RWTexture2D<float4> output : register(u1);"
+    "float4 tint;"
+    "[shader(\"raygeneration\")] void RayGen() {"
+    "  Payload p = { (float4)0 }; RayDesc ray = { (float3)0, 0, (float3)1, 1 };"
+    "  TraceRay(scene, 0, 0xff, 0, 1, 0, ray, p);"
+    "  output[DispatchRaysIndex().xy] = p.color; }"
+    "[shader(\"closesthit\")]"
+    "void Hit(inout Payload p, in Attr a) { p.color = tint * a.bary.x; }"
+    "[shader(\"miss\")] void Miss(inout Payload p) { p.color = 0; }"
+    "[shader(\"callable\")] void Call(inout Param p) { p.data += 1; }"
+    "export float Helper(float x) { return x * tint.x; }";
+  CComPtr<IDxcBlob> pProgram;
+  CompileToProgram(shader, L"", L"lib_6_3", nullptr, 0, &pProgram);
+  CComPtr<IDxcContainerReflection> pContainerReflection;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pContainerReflection));
+  VERIFY_SUCCEEDED(pContainerReflection->Load(pProgram));
+  UINT32 dxilIdx;
+  VERIFY_SUCCEEDED(pContainerReflection->FindFirstPartKind(hlsl::DFCC_DXIL,
+                                                           &dxilIdx));
+  CComPtr<ID3D12LibraryReflection> pLibraryReflection;
+  CComPtr<IDxcLibraryReflectionTable> pTableReflection;
+  VERIFY_SUCCEEDED(pContainerReflection->GetPartReflection(
+      dxilIdx, IID_PPV_ARGS(&pLibraryReflection)));
+  VERIFY_SUCCEEDED(pLibraryReflection.QueryInterface(&pTableReflection));
+
+  DxcLibraryFunctionTable table;
+  VERIFY_SUCCEEDED(pTableReflection->GetFunctionTable(&table));
+  D3D12_LIBRARY_DESC libDesc;
+  VERIFY_SUCCEEDED(pLibraryReflection->GetDesc(&libDesc));
+  VERIFY_ARE_EQUAL(libDesc.FunctionCount, table.NumFunctions);
+
+  bool foundHit = false, foundCall = false;
+  for (UINT32 i = 0; i < table.NumFunctions; ++i) {
+    const DxcLibraryFunctionDesc &fn = table.Functions[i];
+    ID3D12FunctionReflection *pFunction =
+        pLibraryReflection->GetFunctionByIndex((INT)i);
+    D3D12_FUNCTION_DESC fnDesc;
+    VERIFY_SUCCEEDED(pFunction->GetDesc(&fnDesc));
+    VERIFY_ARE_EQUAL_STR(fnDesc.Name, fn.Name);
+    VERIFY_ARE_EQUAL(D3D12_SHVER_GET_TYPE(fnDesc.Version), fn.ShaderKind);
+    VERIFY_ARE_EQUAL(fnDesc.BoundResources, fn.NumResources);
+    for (UINT32 r = 0; r < fn.NumResources; ++r) {
+      D3D12_SHADER_INPUT_BIND_DESC bind;
+      VERIFY_SUCCEEDED(pFunction->GetResourceBindingDesc(r, &bind));
+      VERIFY_IS_TRUE(fn.Resources[r] < table.NumResources);
+      const DxcLibraryResourceDesc &res = table.Resources[fn.Resources[r]];
+      VERIFY_ARE_EQUAL_STR(bind.Name, res.Name);
+      VERIFY_ARE_EQUAL((UINT32)bind.Type, res.Type);
+      VERIFY_ARE_EQUAL(bind.BindPoint, res.BindPoint);
+      VERIFY_ARE_EQUAL(bind.Space, res.Space);
+    }
+    if (0 == strcmp(fn.UnmangledName, "Hit")) {
+      foundHit = true;
+      VERIFY_ARE_EQUAL((UINT32)hlsl::DXIL::ShaderKind::ClosestHit, fn.ShaderKind);
+      VERIFY_ARE_EQUAL(16u, fn.PayloadSizeInBytes);
+      VERIFY_ARE_EQUAL(8u, fn.AttributeSizeInBytes);
+    } else if (0 == strcmp(fn.UnmangledName, "Call")) {
+      foundCall = true;
+      VERIFY_ARE_EQUAL(16u, fn.PayloadSizeInBytes);
+      VERIFY_ARE_EQUAL(0u, fn.AttributeSizeInBytes);
+    }
+  }
+  VERIFY_IS_TRUE(foundHit);
+  VERIFY_IS_TRUE(foundCall);
+
+  // A second call hands out the same arrays.
+  DxcLibraryFunctionTable table2;
+  VERIFY_SUCCEEDED(pTableReflection->GetFunctionTable(&table2));
+  VERIFY_ARE_EQUAL(table.Functions, table2.Functions);
+}
+
+TEST_F(DxilContainerTest, ReflectionWhenSharedThenQueriedFromThreads) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  const char *shader =
+    "struct Inner { float3 dir; float4x4 xf[2]; };"
+    "struct Material { float4 albedo; Inner inner; uint flags; };"
+    "cbuffer A : register(b0) { Material matA; };"
+    "float4 main() : SV_Target { return matA.albedo + matA.inner.xf[1][0]; }";
+  const char *library =
+    "RWTexture2D<float4> output : register(u1);"
+    "float4 tint;"
+    "[shader(\"raygeneration\")] void RayGen() {"
+    "  output[DispatchRaysIndex().xy] = tint; }"
+    "export float Helper(float x) { return x * tint.x; }";
+  CComPtr<IDxcBlob> pProgram, pLibrary;
+  CompileToProgram(shader, L"main", L"ps_6_0", nullptr, 0, &pProgram);
+  CompileToProgram(library, L"", L"lib_6_3", nullptr, 0, &pLibrary);
+
+  // One reflection of each kind, with nothing built on first use touched
+  // before the threads start.
+  CComPtr<ID3D12ShaderReflection> pReflection;
+  CreateReflectionFromBlob(pProgram, &pReflection);
+  CComPtr<IDxcContainerReflection> pContainerReflection;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                               &pContainerReflection));
+  VERIFY_SUCCEEDED(pContainerReflection->Load(pLibrary));
+  UINT32 dxilIdx;
+  VERIFY_SUCCEEDED(pContainerReflection->FindFirstPartKind(hlsl::DFCC_DXIL,
+                                                           &dxilIdx));
+  CComPtr<ID3D12LibraryReflection> pLibraryReflection;
+  CComPtr<IDxcLibraryReflectionTable> pTableReflection;
+  VERIFY_SUCCEEDED(pContainerReflection->GetPartReflection(
+      dxilIdx, IID_PPV_ARGS(&pLibraryReflection)));
+  VERIFY_SUCCEEDED(pLibraryReflection.QueryInterface(&pTableReflection));
+
+  // Failures are checked on this thread, once all are done.
+  struct ThreadResult {
+    ID3D12ShaderReflectionType *pInner = nullptr;
+    ID3D12ShaderReflectionType *pXf = nullptr;
+    const DxcLibraryFunctionDesc *pFunctions = nullptr;
+    UINT BoundResources = 0;
+    bool Succeeded = true;
+  };
+  const unsigned ThreadCount = 8;
+  std::vector<ThreadResult> results(ThreadCount);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < ThreadCount; ++t) {
+    threads.emplace_back([&, t]() {
+      ThreadResult &result = results[t];
+      ID3D12ShaderReflectionType *pType = pReflection->GetConstantBufferByName("A")
+          ->GetVariableByName("matA")->GetType();
+      result.pInner = pType->GetMemberTypeByName("inner");
+      result.pXf = result.pInner ? result.pInner->GetMemberTypeByName("xf")
+                                 : nullptr;
+      DxcLibraryFunctionTable table;
+      result.Succeeded &= SUCCEEDED(pTableReflection->GetFunctionTable(&table));
+      result.pFunctions = table.Functions;
+      D3D12_LIBRARY_DESC libDesc;
+      result.Succeeded &= SUCCEEDED(pLibraryReflection->GetDesc(&libDesc));
+      for (UINT i = 0; i < libDesc.FunctionCount; ++i) {
+        D3D12_FUNCTION_DESC fnDesc;
+        result.Succeeded &= SUCCEEDED(
+            pLibraryReflection->GetFunctionByIndex((INT)i)->GetDesc(&fnDesc));
+        result.BoundResources += fnDesc.BoundResources;
+      }
+    });
+  }
+  for (std::thread &thread : threads)
+    thread.join();
+
+  VERIFY_IS_NOT_NULL(results[0].pInner);
+  VERIFY_IS_NOT_NULL(results[0].pXf);
+  VERIFY_IS_NOT_NULL(results[0].pFunctions);
+  for (const ThreadResult &result : results) {
+    VERIFY_IS_TRUE(result.Succeeded);
+    VERIFY_ARE_EQUAL(results[0].pInner, result.pInner);
+    VERIFY_ARE_EQUAL(results[0].pXf, result.pXf);
+    VERIFY_ARE_EQUAL(results[0].pFunctions, result.pFunctions);
+    VERIFY_ARE_EQUAL(results[0].BoundResources, result.BoundResources);
+  }
+  VERIFY_ARE_NOT_EQUAL(0u, results[0].BoundResources);
+}
+
 TEST_F(DxilContainerTest, ReflectionMatchesDXBC_Full) {
   WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
   std::wstring codeGenPath = hlsl_test::GetPathToHlslDataFile(L"..\\CodeGenHLSL\\Samples");
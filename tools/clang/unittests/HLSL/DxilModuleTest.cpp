@@ -18,6 +18,7 @@
 #include "dxc/DXIL/DxilInstructions.h"
 #include "dxc/DxilContainer/DxilContainer.h"
 #include "dxc/DXIL/DxilModule.h"
+#include "dxc/HLSL/DxilGenerationPass.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/MSFileSystem.h"
 #include "llvm/Support/FileSystem.h"
@@ -26,6 +27,8 @@
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Pass.h"
 
 using namespace hlsl;
 using namespace llvm;
@@ -52,6 +55,7 @@ public:
   TEST_METHOD(LoadDxilModule_1_0)
   TEST_METHOD(LoadDxilModule_1_1)
   TEST_METHOD(LoadDxilModule_1_2)
+  TEST_METHOD(LoadDxilModule_TypeSystemSurvivesClear)
 
   // Precise query tests.
   TEST_METHOD(Precise1)
@@ -61,6 +65,9 @@ public:
   TEST_METHOD(Precise5)
   TEST_METHOD(Precise6)
   TEST_METHOD(Precise7)
+
+  // Pass manager tests.
+  TEST_METHOD(HLSLPassesPreserveCFGAnalyses)
 };
 
 bool DxilModuleTest::InitSupport() {
@@ -227,6 +234,27 @@ TEST_F(DxilModuleTest, LoadDxilModule_1_2) {
   VERIFY_IS_TRUE(vMinor == 2);
 }
 
+TEST_F(DxilModuleTest, LoadDxilModule_TypeSystemSurvivesClear) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "struct S { float4 a; float b; };\n"
+    "cbuffer CB { S s; };\n"
+    "float4 main() : SV_Target {\n"
+    "  return s.a * s.b;\n"
+    "}\n"
+    ,
+    L"ps_6_0"
+  );
+
+  // The type system is decoded on first access, so it must be decoded before
+  // the metadata it comes from is cleared.
+  DxilModule &DM = c.GetDxilModule();
+  DxilModule::ClearDxilMetadata(*DM.GetModule());
+  DxilTypeSystem &TypeSystem = DM.GetTypeSystem();
+  VERIFY_IS_FALSE(TypeSystem.GetStructAnnotationMap().empty());
+  VERIFY_IS_NOT_NULL(TypeSystem.GetFunctionAnnotation(DM.GetEntryFunction()));
+}
+
 TEST_F(DxilModuleTest, Precise1) {
   Compiler c(m_dllSupport);
   c.Compile(
@@ -425,3 +453,66 @@ TEST_F(DxilModuleTest, Precise7) {
   }
   VERIFY_ARE_EQUAL(numChecks, 4);
 }
+
+namespace {
+// A CFG-only analysis that counts how often the pass manager computes it,
+// and a pass that uses it.
+struct CountedCFGAnalysis : public ModulePass {
+  static char ID;
+  static unsigned RunCount;
+  CountedCFGAnalysis() : ModulePass(ID) {}
+  bool runOnModule(Module &) override {
+    ++RunCount;
+    return false;
+  }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+};
+char CountedCFGAnalysis::ID = 0;
+unsigned CountedCFGAnalysis::RunCount = 0;
+RegisterPass<CountedCFGAnalysis> CountedCFGAnalysisInfo(
+    "counted-cfg-analysis", "Counted CFG analysis", /*CFGOnly*/ true,
+    /*is_analysis*/ true);
+
+struct CountedCFGAnalysisUser : public ModulePass {
+  static char ID;
+  CountedCFGAnalysisUser() : ModulePass(ID) {}
+  bool runOnModule(Module &) override { return false; }
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<CountedCFGAnalysis>();
+    AU.setPreservesAll();
+  }
+};
+char CountedCFGAnalysisUser::ID = 0;
+}
+
+TEST_F(DxilModuleTest, HLSLPassesPreserveCFGAnalyses) {
+  Compiler c(m_dllSupport);
+  c.Compile(
+    "cbuffer CB { float4 c; };\n"
+    "float4 main(float4 a : A) : SV_Target {\n"
+    "  return a * c;\n"
+    "}\n"
+  );
+
+  // None of these passes change the CFG, so an analysis of it is computed
+  // once for all of them.
+  DxilModule &DM = c.GetDxilModule();
+  ModulePass *Passes[] = {
+    createDxilEliminateOutputDynamicIndexingPass(),
+    createDxilInferEarlyDepthStencilPass(),
+    createDxilRootConstantCandidatesPass(),
+    createDxilDeadFunctionEliminationPass(),
+    createDxilEmitMetadataPass(),
+  };
+  legacy::PassManager PM;
+  PM.add(new CountedCFGAnalysisUser());
+  for (ModulePass *P : Passes) {
+    PM.add(P);
+    PM.add(new CountedCFGAnalysisUser());
+  }
+  CountedCFGAnalysis::RunCount = 0;
+  PM.run(*DM.GetModule());
+  VERIFY_ARE_EQUAL(1u, CountedCFGAnalysis::RunCount);
+}
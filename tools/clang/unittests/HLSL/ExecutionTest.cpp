@@ -296,6 +296,10 @@ public:
   TEST_METHOD(WaveIntrinsicsInPSTest);
   TEST_METHOD(PartialDerivTest);
 
+  BEGIN_TEST_METHOD(BenchmarkTest)
+    TEST_METHOD_PROPERTY(L"Priority", L"2") // Measures rather than checks; run on request.
+  END_TEST_METHOD()
+
   BEGIN_TEST_METHOD(CBufferTestHalf)
     TEST_METHOD_PROPERTY(L"Priority", L"2") // Remove this line once warp supports this feature in Shader Model 6.2
   END_TEST_METHOD()
@@ -2396,6 +2400,61 @@ TEST_F(ExecutionTest, BasicTriangleOpTestHalf) {
   BasicTriangleTestSetup("TriangleHalf", L"basic-triangle-half.bmp", D3D_SHADER_MODEL_6_2);
 }
 
+static void LogBenchmarkTimes(LPCSTR pArguments, std::vector<double> &times) {
+  std::sort(times.begin(), times.end());
+  LogCommentFmt(L"'%S': %u runs, min %.2f us, median %.2f us, max %.2f us",
+                pArguments ? pArguments : "", (unsigned)times.size(),
+                times.front(), times[times.size() / 2], times.back());
+}
+
+// Times a shader op with BenchmarkIterations set once with the arguments its
+// shaders were written with and once with others, so optimizer changes can be
+// judged by GPU time. /p:BenchmarkShaderOp=<name> picks the op from
+// ShaderOpArith.xml and /p:BenchmarkArgs="<args>" the arguments to compare;
+// precompiled shaders (Compiled="true") compare compiler versions instead.
+TEST_F(ExecutionTest, BenchmarkTest) {
+  WEX::TestExecution::SetVerifyOutput verifySettings(WEX::TestExecution::VerifyOutputSettings::LogOnlyFailures);
+  WEX::Common::String ShaderOpName(L"BenchmarkALU");
+  WEX::Common::String Arguments(L"-Od");
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkShaderOp", ShaderOpName);
+  WEX::TestExecution::RuntimeParameters::TryGetValue(L"BenchmarkArgs", Arguments);
+
+  CComPtr<IStream> pStream;
+  ReadHlslDataIntoNewStream(L"ShaderOpArith.xml", &pStream);
+
+  CComPtr<ID3D12Device> pDevice;
+  if (!CreateDevice(&pDevice))
+    return;
+
+  std::shared_ptr<st::ShaderOpSet> ShaderOpSet =
+      std::make_shared<st::ShaderOpSet>();
+  st::ParseShaderOpSetFromStream(pStream, ShaderOpSet.get());
+  CW2A name(ShaderOpName, CP_UTF8);
+  st::ShaderOp *pShaderOp = ShaderOpSet->GetShaderOp(name);
+  VERIFY_IS_NOT_NULL(pShaderOp);
+  VERIFY_IS_TRUE(pShaderOp->BenchmarkIterations > 0);
+
+  std::vector<double> times;
+  {
+    std::shared_ptr<ShaderOpTestResult> test = RunShaderOpTestAfterParse(
+        pDevice, m_support, name, nullptr, ShaderOpSet);
+    test->Test->GetBenchmarkTimes(&times);
+    VERIFY_ARE_EQUAL(pShaderOp->BenchmarkIterations, (UINT)times.size());
+    LogBenchmarkTimes(pShaderOp->Shaders.front().Arguments, times);
+  }
+
+  CW2A arguments(Arguments, CP_UTF8);
+  for (st::ShaderOpShader &S : pShaderOp->Shaders)
+    S.Arguments = pShaderOp->Strings.insert(arguments.m_psz);
+  {
+    std::shared_ptr<ShaderOpTestResult> test = RunShaderOpTestAfterParse(
+        pDevice, m_support, name, nullptr, ShaderOpSet);
+    test->Test->GetBenchmarkTimes(&times);
+    VERIFY_ARE_EQUAL(pShaderOp->BenchmarkIterations, (UINT)times.size());
+    LogBenchmarkTimes(arguments, times);
+  }
+}
+
 // Rendering two right triangles forming a square and assigning a texture value
 // for each pixel to calculate derivates.
 TEST_F(ExecutionTest, PartialDerivTest) {
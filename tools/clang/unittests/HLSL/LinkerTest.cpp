@@ -43,6 +43,10 @@ public:
   TEST_METHOD(RunLinkFailNoDefine);
   TEST_METHOD(RunLinkFailReDefine);
   TEST_METHOD(RunLinkGlobalInit);
+  TEST_METHOD(RunLinkRepeatedWithSameLibs);
+  TEST_METHOD(RunLinkManyMatchesLink);
+  TEST_METHOD(RunLinkStripUnusedResources);
+  TEST_METHOD(RunLinkPipelineStages);
   TEST_METHOD(RunLinkNoAlloca);
   TEST_METHOD(RunLinkMatArrayParam);
   TEST_METHOD(RunLinkMatParam);
@@ -233,6 +237,157 @@ TEST_F(LinkerTest, RunLinkGlobalInit) {
        {"dx.op.cbufferLoad"},{});
 }
 
+TEST_F(LinkerTest, RunLinkRepeatedWithSameLibs) {
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_entries2.hlsl", &pEntryLib);
+  LPCWSTR libName = L"entry";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+  CComPtr<IDxcBlob> pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  LPCWSTR libResName = L"res";
+  RegisterDxcModule(libResName, pResLib, pLinker);
+  LPCWSTR libNames[] = { libName, libResName };
+
+  // Libraries stay loaded between links; a link after others that loaded
+  // more of them must give the same result.
+  std::string IR[2];
+  LPCWSTR entries[] = { L"cs_main", L"ps_main", L"cs_main" };
+  LPCWSTR profiles[] = { L"cs_6_0", L"ps_6_0", L"cs_6_0" };
+  for (unsigned i = 0; i < _countof(entries); ++i) {
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pLinker->Link(entries[i], profiles[i], libNames,
+                                   _countof(libNames), nullptr, 0, &pResult));
+    CComPtr<IDxcBlob> pProgram;
+    CheckOperationSucceeded(pResult, &pProgram);
+    if (i == 1)
+      continue;
+    CComPtr<IDxcCompiler> pCompiler;
+    CComPtr<IDxcBlobEncoding> pDisassembly;
+    VERIFY_SUCCEEDED(
+        m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    VERIFY_SUCCEEDED(pCompiler->Disassemble(pProgram, &pDisassembly));
+    IR[i / 2] = BlobToUtf8(pDisassembly);
+  }
+  VERIFY_IS_TRUE(IR[0] == IR[1]);
+}
+
+TEST_F(LinkerTest, RunLinkStripUnusedResources) {
+  CComPtr<IDxcBlob> pLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_cbuffer_compact.hlsl", &pLib);
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libName = L"lib";
+  RegisterDxcModule(libName, pLib, pLinker);
+
+  // ps_main reads the first row of Params only.
+  Link(L"ps_main", L"ps_6_0", pLinker, {libName},
+       {"!\"Params\", i32 0, i32 0, i32 1, i32 16,"},
+       {"unusedTex", "outBuf"});
+  // cs_main reads all of it.
+  Link(L"cs_main", L"cs_6_0", pLinker, {libName},
+       {"!\"Params\", i32 0, i32 0, i32 1, i32 64,", "unusedTex", "outBuf"},
+       {});
+}
+
+TEST_F(LinkerTest, RunLinkPipelineStages) {
+  CComPtr<IDxcBlob> pLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_pipeline_stages.hlsl", &pLib);
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  LPCWSTR libName = L"lib";
+  RegisterDxcModule(libName, pLib, pLinker);
+
+  // Alone, vs_main writes every output.
+  Link(L"vs_main", L"vs_6_0", pLinker, {libName}, {"3.500000e+00"}, {});
+  // Paired with ps_main, TEXCOORD1 is no longer written.
+  Link(L"vs_main", L"vs_6_0", pLinker, {libName}, {"2.500000e-01"},
+       {"3.500000e+00"}, {L"-pipeline-stage", L"ps_main"});
+  // COLOR1 comes from a cbuffer, so it is no longer interpolated.
+  Link(L"ps_main", L"ps_6_0", pLinker, {libName},
+       {"; COLOR                    0                 linear",
+        "; COLOR                    1        nointerpolation"},
+       {}, {L"-pipeline-stage", L"vs_main"});
+  Link(L"ps_main", L"ps_6_0", pLinker, {libName},
+       {"; COLOR                    1                 linear"}, {});
+
+  // A packing search reports what it saves.
+  LinkCheckMsg(L"ps_main", L"ps_6_0", pLinker, {libName},
+               {"signature rows"},
+               {L"-pipeline-stage", L"vs_main", L"-pipeline-pack-search",
+                L"64"});
+
+  // Only a vertex or domain shader can feed a pixel shader here.
+  LinkCheckMsg(L"vs_main", L"vs_6_0", pLinker, {libName},
+               {"Cannot pair the signatures of pipeline stages"},
+               {L"-pipeline-stage", L"vs_main"});
+}
+
+TEST_F(LinkerTest, RunLinkManyMatchesLink) {
+  CComPtr<IDxcLinker> pLinker;
+  CreateLinker(&pLinker);
+  CComPtr<IDxcLinker2> pLinker2;
+  VERIFY_SUCCEEDED(pLinker.QueryInterface(&pLinker2));
+
+  CComPtr<IDxcBlob> pEntryLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_entries2.hlsl", &pEntryLib);
+  LPCWSTR libName = L"entry";
+  RegisterDxcModule(libName, pEntryLib, pLinker);
+  CComPtr<IDxcBlob> pResLib;
+  CompileLib(L"..\\CodeGenHLSL\\lib_resource2.hlsl", &pResLib);
+  LPCWSTR libResName = L"res";
+  RegisterDxcModule(libResName, pResLib, pLinker);
+  LPCWSTR libNames[] = { libName, libResName };
+
+  DxcCompileTarget targets[] = {
+    { L"vs_main", L"vs_6_0" }, { L"hs_main", L"hs_6_0" },
+    { L"ds_main", L"ds_6_0" }, { L"gs_main", L"gs_6_0" },
+    { L"ps_main", L"ps_6_0" }, { L"cs_main", L"cs_6_0" },
+    { L"missing", L"ps_6_0" } };
+  const UINT32 targetCount = _countof(targets);
+  IDxcOperationResult *pResults[targetCount];
+  VERIFY_SUCCEEDED(pLinker2->LinkMany(targets, targetCount, libNames,
+                                      _countof(libNames), nullptr, 0,
+                                      pResults));
+
+  // Each target gets the result that linking it alone gives.
+  for (UINT32 i = 0; i < targetCount; ++i) {
+    CComPtr<IDxcOperationResult> pManyResult;
+    pManyResult.Attach(pResults[i]);
+    CComPtr<IDxcOperationResult> pResult;
+    VERIFY_SUCCEEDED(pLinker->Link(targets[i].EntryPoint,
+                                   targets[i].TargetProfile, libNames,
+                                   _countof(libNames), nullptr, 0, &pResult));
+    HRESULT manyStatus, status;
+    VERIFY_SUCCEEDED(pManyResult->GetStatus(&manyStatus));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_ARE_EQUAL(SUCCEEDED(status), SUCCEEDED(manyStatus));
+    if (FAILED(status))
+      continue;
+    CComPtr<IDxcBlob> pManyProgram, pProgram;
+    VERIFY_SUCCEEDED(pManyResult->GetResult(&pManyProgram));
+    VERIFY_SUCCEEDED(pResult->GetResult(&pProgram));
+    VERIFY_ARE_EQUAL(pProgram->GetBufferSize(), pManyProgram->GetBufferSize());
+    VERIFY_IS_TRUE(0 == memcmp(pProgram->GetBufferPointer(),
+                               pManyProgram->GetBufferPointer(),
+                               pProgram->GetBufferSize()));
+  }
+
+  // A missing library name is rejected rather than looked up.
+  LPCWSTR nullLibNames[] = { libName, nullptr };
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pLinker2->LinkMany(targets, targetCount, nullLibNames,
+                                      _countof(nullLibNames), nullptr, 0,
+                                      pResults));
+  CComPtr<IDxcOperationResult> pNullResult;
+  VERIFY_ARE_EQUAL(E_INVALIDARG,
+                   pLinker->Link(L"ps_main", L"ps_6_0", nullLibNames,
+                                 _countof(nullLibNames), nullptr, 0,
+                                 &pNullResult));
+}
+
 TEST_F(LinkerTest, RunLinkFailReDefineGlobal) {
   CComPtr<IDxcBlob> pEntryLib;
   CompileLib(L"..\\CodeGenHLSL\\lib_global2.hlsl", &pEntryLib);
@@ -66,6 +66,8 @@ public:
   TEST_METHOD(OptimizerWhenSlice2ThenOK)
   TEST_METHOD(OptimizerWhenSlice3ThenOK)
   TEST_METHOD(OptimizerWhenSliceWithIntermediateOptionsThenOK)
+  TEST_METHOD(OptimizerWhenReportRequestedThenPassesListed)
+  TEST_METHOD(OptimizerWhenClusterFetchesOptionThenAccepted)
 
   void OptimizerWhenSliceNThenOK(int optLevel);
   void OptimizerWhenSliceNThenOK(int optLevel, LPCWSTR pText, LPCWSTR pTarget, llvm::ArrayRef<LPCWSTR> args = {});
@@ -120,6 +122,75 @@ TEST_F(OptimizerTest, OptimizerWhenSliceWithIntermediateOptionsThenOK) {
   OptimizerWhenSliceNThenOK(1, SampleProgram, L"ps_6_0", { L"-flegacy-resource-reservation" });
 }
 
+TEST_F(OptimizerTest, OptimizerWhenReportRequestedThenPassesListed) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOptimizer2> pOptimizer;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pHighLevelBlob;
+
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+
+  Utf16ToBlob(m_dllSupport, L"float4 main(float4 a : A) : SV_Target {\r\n"
+                            L"  float4 b = a * 2;\r\n"
+                            L"  return b + a;\r\n"
+                            L"}", &pSource);
+  LPCWSTR args[] = { L"/fcgl" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pHighLevelBlob));
+
+  // Promoting the locals removes their loads and stores.
+  LPCWSTR passes[] = { L"-mem2reg" };
+  CComPtr<IDxcBlob> pModule;
+  CComPtr<IDxcBlobEncoding> pReport;
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizerWithReport(pHighLevelBlob,
+    passes, _countof(passes), &pModule, nullptr, &pReport));
+  std::string report = BlobToUtf8(pReport);
+  VERIFY_IS_TRUE(report.find("\"instructionsBefore\"") != std::string::npos);
+  size_t pass = report.find("\"Promote Memory to Register\"");
+  VERIFY_IS_TRUE(pass != std::string::npos);
+  size_t delta = report.find("\"instructionDelta\": -", pass);
+  VERIFY_IS_TRUE(delta != std::string::npos);
+  VERIFY_IS_TRUE(delta < report.find('}', pass));
+}
+
+TEST_F(OptimizerTest, OptimizerWhenClusterFetchesOptionThenAccepted) {
+  CComPtr<IDxcCompiler> pCompiler;
+  CComPtr<IDxcOptimizer> pOptimizer;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pHighLevelBlob;
+
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcOptimizer, &pOptimizer));
+
+  Utf16ToBlob(m_dllSupport, L"Texture2D g_Tex;\r\n"
+                            L"float4 main(int2 uv : UV) : SV_Target {\r\n"
+                            L"  return g_Tex.Load(int3(uv, 0));\r\n"
+                            L"}", &pSource);
+  LPCWSTR args[] = { L"/fcgl" };
+  VERIFY_SUCCEEDED(pCompiler->Compile(pSource, L"source.hlsl", L"main",
+    L"ps_6_0", args, _countof(args), nullptr, 0, nullptr, &pResult));
+  VerifyOperationSucceeded(pResult);
+  VERIFY_SUCCEEDED(pResult->GetResult(&pHighLevelBlob));
+
+  // MaxLiveComponents is read by the pass, so the optimizer must take it;
+  // a name that no pass reads is still rejected.
+  LPCWSTR passes[] = { L"-dxil-cluster-fetches,MaxLiveComponents=4" };
+  CComPtr<IDxcBlob> pModule;
+  VERIFY_SUCCEEDED(pOptimizer->RunOptimizer(pHighLevelBlob, passes,
+    _countof(passes), &pModule, nullptr));
+  VERIFY_IS_NOT_NULL(pModule.p);
+
+  LPCWSTR badPasses[] = { L"-dxil-cluster-fetches,MaxLiveComponent=4" };
+  CComPtr<IDxcBlob> pBadModule;
+  VERIFY_ARE_EQUAL(E_INVALIDARG, pOptimizer->RunOptimizer(pHighLevelBlob,
+    badPasses, _countof(badPasses), &pBadModule, nullptr));
+}
+
 void OptimizerTest::OptimizerWhenSliceNThenOK(int optLevel) {
   LPCWSTR SampleProgram =
     L"Texture2D g_Tex;\r\n"
@@ -68,6 +68,7 @@ public:
   TEST_METHOD(ReadOptionsWhenValidThenOK)
   TEST_METHOD(ReadOptionsWhenJoinedThenOK)
   TEST_METHOD(ReadOptionsWhenNoEntryThenOK)
+  TEST_METHOD(ReadOptionsWhenMaxMemoryThenParsed)
   TEST_METHOD(ReadOptionsForOutputObject)
 
   TEST_METHOD(ReadOptionsForDxcWhenApiArgMissingThenFail)
@@ -154,6 +155,34 @@ TEST_F(OptionsTest, ReadOptionsConflict) {
       L"hlsl.hlsl"};
   MainArgsArr libArr(libArgs);
   ReadOptsTest(libArr, DxrFlags, "cannot specify entry point for a library");
+
+  const wchar_t *depArgs[] = {
+      L"exe.exe",   L"/T",        L"ps_6_0",
+      L"-M", L"-MD", L"-MF", L"hlsl.d",
+      L"hlsl.hlsl"};
+  MainArgsArr depArr(depArgs);
+  ReadOptsTest(depArr, DxrFlags, "Cannot specify -M with -MD or -P.");
+
+  const wchar_t *depFileArgs[] = {
+      L"exe.exe",   L"/T",        L"ps_6_0",
+      L"-MD",
+      L"hlsl.hlsl"};
+  MainArgsArr depFileArr(depFileArgs);
+  ReadOptsTest(depFileArr, DxrFlags, "Cannot specify -MD without -MF or -Fo.");
+
+  const wchar_t *shardArgs[] = {
+      L"exe.exe",   L"/T",        L"ps_6_0",
+      L"-lib-shards=2",
+      L"hlsl.hlsl"};
+  MainArgsArr shardArr(shardArgs);
+  ReadOptsTest(shardArr, DxrFlags, "library profile required when using -lib-shards option");
+
+  const wchar_t *shardExportArgs[] = {
+      L"exe.exe",   L"/T",        L"lib_6_3",
+      L"-lib-shards=2", L"-exports", L"a",
+      L"hlsl.hlsl"};
+  MainArgsArr shardExportArr(shardExportArgs);
+  ReadOptsTest(shardExportArr, DxrFlags, "Cannot specify -exports with -lib-shards.");
 }
 
 TEST_F(OptionsTest, ReadOptionsWhenHelpThenShortcut) {
@@ -190,6 +219,29 @@ TEST_F(OptionsTest, ReadOptionsWhenNoEntryThenOK) {
   VERIFY_IS_TRUE(o->EntryPoint.empty());
 }
 
+TEST_F(OptionsTest, ReadOptionsWhenMaxMemoryThenParsed) {
+  const wchar_t *Args[] = { L"exe.exe", L"/T", L"ps_6_0", L"-max-memory=512",
+                            L"hlsl.hlsl" };
+  MainArgsArr ArgsArr(Args);
+  std::unique_ptr<DxcOpts> o = ReadOptsTest(ArgsArr, DxrFlags);
+  VERIFY_ARE_EQUAL(512ul, o->MaxMemoryMB);
+
+  const wchar_t *ArgsNone[] = { L"exe.exe", L"/T", L"ps_6_0", L"hlsl.hlsl" };
+  MainArgsArr ArgsNoneArr(ArgsNone);
+  o = ReadOptsTest(ArgsNoneArr, DxrFlags);
+  VERIFY_ARE_EQUAL(0ul, o->MaxMemoryMB);
+
+  const wchar_t *ArgsBad[] = { L"exe.exe", L"/T", L"ps_6_0",
+                               L"-max-memory=lots", L"hlsl.hlsl" };
+  MainArgsArr ArgsBadArr(ArgsBad);
+  ReadOptsTest(ArgsBadArr, DxrFlags, "Unsupported value 'lots' for max memory.");
+
+  const wchar_t *ArgsZero[] = { L"exe.exe", L"/T", L"ps_6_0",
+                                L"-max-memory=0", L"hlsl.hlsl" };
+  MainArgsArr ArgsZeroArr(ArgsZero);
+  ReadOptsTest(ArgsZeroArr, DxrFlags, "Unsupported value '0' for max memory.");
+}
+
 TEST_F(OptionsTest, ReadOptionsWhenInvalidThenFail) {
   const wchar_t *ArgsNoTarget[] = {L"exe.exe", L"/E", L"main", L"hlsl.hlsl"};
   const wchar_t *ArgsNoInput[] = {L"exe.exe", L"/E", L"main", L"/T", L"ps_6_0"};
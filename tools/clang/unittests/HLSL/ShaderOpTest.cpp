@@ -350,6 +350,13 @@ void ShaderOpTest::CreateDescriptorHeaps() {
   queryHeapDesc.Count = 1;
   queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_PIPELINE_STATISTICS;
   CHECK_HR(m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pQueryHeap)));
+
+  // Create timestamp heap, with a begin and end query for each repeat.
+  if (m_pShaderOp->BenchmarkIterations) {
+    queryHeapDesc.Count = m_pShaderOp->BenchmarkIterations * 2;
+    queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+    CHECK_HR(m_pDevice->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&m_pTimestampHeap)));
+  }
 }
 
 void ShaderOpTest::CreateDevice() {
@@ -602,6 +609,18 @@ void ShaderOpTest::CreateResources() {
     SetObjectName(m_pQueryBuffer, "Query Pipeline Readback Buffer");
   }
 
+  // Create a buffer to receive benchmark timestamps.
+  if (m_pShaderOp->BenchmarkIterations) {
+    CD3DX12_HEAP_PROPERTIES readback(D3D12_HEAP_TYPE_READBACK);
+    CD3DX12_RESOURCE_DESC readbackDesc(CD3DX12_RESOURCE_DESC::Buffer(
+        sizeof(UINT64) * 2 * m_pShaderOp->BenchmarkIterations));
+    CHECK_HR(m_pDevice->CreateCommittedResource(
+      &readback, D3D12_HEAP_FLAG_NONE, &readbackDesc,
+      D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+      IID_PPV_ARGS(&m_pTimestampBuffer)));
+    SetObjectName(m_pTimestampBuffer, "Query Timestamp Readback Buffer");
+  }
+
   CHECK_HR(pList->Close());
   ExecuteCommandList(ResCommandList.Queue, pList);
   WaitForSignal(ResCommandList.Queue, m_pFence, m_hFence, m_FenceValue++);
@@ -733,6 +752,22 @@ void ShaderOpTest::CreateShaders() {
   }
 }
 
+void ShaderOpTest::GetBenchmarkTimes(std::vector<double> *pMicroseconds) {
+  pMicroseconds->clear();
+  if (!m_pShaderOp->BenchmarkIterations)
+    return;
+  UINT64 frequency;
+  CHECK_HR(m_CommandList.Queue->GetTimestampFrequency(&frequency));
+  UINT count = m_pShaderOp->BenchmarkIterations;
+  MappedData M;
+  M.reset(m_pTimestampBuffer, sizeof(UINT64) * 2 * count);
+  const UINT64 *pTimestamps = (const UINT64 *)M.data();
+  for (UINT i = 0; i < count; ++i) {
+    UINT64 ticks = pTimestamps[i * 2 + 1] - pTimestamps[i * 2];
+    pMicroseconds->push_back(ticks * 1000000.0 / frequency);
+  }
+}
+
 void ShaderOpTest::GetPipelineStats(D3D12_QUERY_DATA_PIPELINE_STATISTICS *pStats) {
   MappedData M;
   M.reset(m_pQueryBuffer, sizeof(*pStats));
@@ -761,6 +796,22 @@ static void SetDescriptorHeaps(ID3D12GraphicsCommandList *pList,
     pList->SetDescriptorHeaps((UINT)localHeaps.size(), localHeaps.data());
 }
 
+void ShaderOpTest::RecordTimedRepeats(ID3D12GraphicsCommandList *pList,
+                                      const std::function<void()> &RecordWork) {
+  UINT count = m_pShaderOp->BenchmarkIterations;
+  for (UINT i = 0; i < count; ++i) {
+    // Keep the repeats from overlapping, so each timing covers one of them.
+    CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::UAV(nullptr);
+    pList->ResourceBarrier(1, &barrier);
+    pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, i * 2);
+    RecordWork();
+    pList->EndQuery(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, i * 2 + 1);
+  }
+  if (count)
+    pList->ResolveQueryData(m_pTimestampHeap, D3D12_QUERY_TYPE_TIMESTAMP, 0,
+                            count * 2, m_pTimestampBuffer, 0);
+}
+
 void ShaderOpTest::RunCommandList() {
   ID3D12GraphicsCommandList *pList = m_CommandList.List.p;
   if (m_pShaderOp->IsCompute()) {
@@ -770,6 +821,10 @@ void ShaderOpTest::RunCommandList() {
     SetRootValues(pList, m_pShaderOp->IsCompute());
     pList->Dispatch(m_pShaderOp->DispatchX, m_pShaderOp->DispatchY,
                     m_pShaderOp->DispatchZ);
+    RecordTimedRepeats(pList, [&]() {
+      pList->Dispatch(m_pShaderOp->DispatchX, m_pShaderOp->DispatchY,
+                      m_pShaderOp->DispatchZ);
+    });
   } else {
     pList->SetPipelineState(m_pPSO);
     pList->SetGraphicsRootSignature(m_pRootSignature);
@@ -843,6 +898,9 @@ void ShaderOpTest::RunCommandList() {
     pList->EndQuery(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS, 0);
     pList->ResolveQueryData(m_pQueryHeap, D3D12_QUERY_TYPE_PIPELINE_STATISTICS,
                             0, 1, m_pQueryBuffer, 0);
+    RecordTimedRepeats(pList, [&]() {
+      pList->DrawInstanced(vertexCountPerInstance, instanceCount, 0, 0);
+    });
   }
   CHECK_HR(pList->Close());
   ExecuteCommandList(m_CommandList.Queue, pList);
@@ -1871,6 +1929,7 @@ void ShaderOpParser::ParseShaderOp(IXmlReader *pReader, ShaderOp *pShaderOp) {
   CHECK_HR(ReadAttrUINT(pReader, L"DispatchX", &pShaderOp->DispatchX, 1));
   CHECK_HR(ReadAttrUINT(pReader, L"DispatchY", &pShaderOp->DispatchY, 1));
   CHECK_HR(ReadAttrUINT(pReader, L"DispatchZ", &pShaderOp->DispatchZ, 1));
+  CHECK_HR(ReadAttrUINT(pReader, L"BenchmarkIterations", &pShaderOp->BenchmarkIterations, 0));
   CHECK_HR(ReadAttrPRIMITIVE_TOPOLOGY_TYPE(pReader, L"TopologyType", &pShaderOp->PrimitiveTopologyType));
   UINT startDepth;
   CHECK_HR(pReader->GetDepth(&startDepth));
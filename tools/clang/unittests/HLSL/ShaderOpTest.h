@@ -184,6 +184,7 @@ public:
   LPCSTR CS = nullptr, VS = nullptr, PS = nullptr;
   LPCSTR GS = nullptr, DS = nullptr, HS = nullptr;
   UINT DispatchX = 1, DispatchY = 1, DispatchZ = 1;
+  UINT BenchmarkIterations = 0; // Timed repeats of the draw or dispatch.
   D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
 
   UINT SampleMask = UINT_MAX; // TODO: parse from file
@@ -239,6 +240,7 @@ struct CommandListRefs {
 class ShaderOpTest {
 public:
   typedef std::function<void(LPCSTR Name, std::vector<BYTE> &Data, ShaderOp *pShaderOp)> TInitCallbackFn;
+  void GetBenchmarkTimes(std::vector<double> *pMicroseconds);
   void GetPipelineStats(D3D12_QUERY_DATA_PIPELINE_STATISTICS *pStats);
   void GetReadBackData(LPCSTR pResourceName, MappedData *pData);
   void RunShaderOp(ShaderOp *pShaderOp);
@@ -271,6 +273,8 @@ private:
   CComPtr<ID3D12RootSignature> m_pRootSignature;
   CComPtr<ID3D12QueryHeap> m_pQueryHeap;
   CComPtr<ID3D12Resource> m_pQueryBuffer;
+  CComPtr<ID3D12QueryHeap> m_pTimestampHeap;
+  CComPtr<ID3D12Resource> m_pTimestampBuffer;
   dxc::DxcDllSupport *m_pDxcSupport = nullptr;
   CommandListRefs m_CommandList;
   HANDLE m_hFence;
@@ -291,6 +295,8 @@ private:
   void CreateResources();
   void CreateRootSignature();
   void CreateShaders();
+  void RecordTimedRepeats(ID3D12GraphicsCommandList *pList,
+                          const std::function<void()> &RecordWork);
   void RunCommandList();
   void SetRootValues(ID3D12GraphicsCommandList *pList, bool isCompute);
 };
@@ -173,6 +173,8 @@ public:
 
   TEST_METHOD(WhenInstrDisallowedThenFail)
   TEST_METHOD(WhenDepthNotFloatThenFail)
+  TEST_METHOD(WhenCacheDirThenResultReused)
+  TEST_METHOD(WhenRuleGroupsSelectedThenOthersSkipped)
   TEST_METHOD(BarrierFail)
   TEST_METHOD(CBufferLegacyOutOfBoundFail)
   TEST_METHOD(CsThreadSizeFail)
@@ -255,6 +257,7 @@ public:
   TEST_METHOD(WhenPayloadSizeTooSmallThenFail)
   TEST_METHOD(WhenMissingPayloadThenFail)
   TEST_METHOD(ShaderFunctionReturnTypeVoid)
+  TEST_METHOD(LibFunctionErrorsInModuleOrder)
 
   TEST_METHOD(SpaceOnlyRegisterFail)
 
@@ -648,6 +651,130 @@ TEST_F(ValidationTest, WhenDepthNotFloatThenFail) {
                           });
 }
 
+TEST_F(ValidationTest, WhenCacheDirThenResultReused) {
+  // Only the internal validator caches results.
+  if (!m_ver.m_InternalValidator) return;
+  wchar_t TempPath[MAX_PATH];
+  DWORD length = GetTempPathW(MAX_PATH, TempPath);
+  VERIFY_WIN32_BOOL_SUCCEEDED(length != 0);
+
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pText;
+  Utf8ToBlob(m_dllSupport, "float main() : SV_Depth { return 1; }", &pSource);
+  RewriteAssemblyToText(pSource, "ps_6_0", nullptr, 0, nullptr, 0,
+                        {"!\"SV_Depth\", i8 9"}, {"!\"SV_Depth\", i8 4"},
+                        &pText);
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pBlob;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pBlob));
+
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcValidatorCache> pCache;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  VERIFY_SUCCEEDED(pValidator.QueryInterface(&pCache));
+  VERIFY_SUCCEEDED(pCache->SetCacheDirectory(TempPath));
+
+  // The second validation is answered from the cache with the same status
+  // and messages.
+  std::string errors[2];
+  for (std::string &error : errors) {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    HRESULT status;
+    VERIFY_SUCCEEDED(pValidator->Validate(pBlob, DxcValidatorFlags_InPlaceEdit, &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_FAILED(status);
+    VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+    error = BlobToUtf8(pErrors);
+  }
+  VERIFY_IS_TRUE(errors[0] == errors[1]);
+  VERIFY_ARE_NOT_EQUAL(std::string::npos, errors[1].find("SV_Depth must be float"));
+}
+
+TEST_F(ValidationTest, WhenRuleGroupsSelectedThenOthersSkipped) {
+  if (!m_ver.m_InternalValidator) return;
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pText;
+  Utf8ToBlob(m_dllSupport, "float main() : SV_Depth { return 1; }", &pSource);
+  RewriteAssemblyToText(pSource, "ps_6_0", nullptr, 0, nullptr, 0,
+                        {"!\"SV_Depth\", i8 9"}, {"!\"SV_Depth\", i8 4"},
+                        &pText);
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pBlob;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pBlob));
+
+  CComPtr<IDxcValidator> pValidator;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+
+  // The signature error is a metadata check, which isn't run when only the
+  // instruction checks are selected.
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcCompileTimings> pCompileTimings;
+    CComPtr<IDxcBlobEncoding> pTimings;
+    HRESULT status;
+    VERIFY_SUCCEEDED(pValidator->Validate(
+        pBlob, DxcValidatorFlags_RulesInstructions | DxcValidatorFlags_ReportTimings,
+        &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    VERIFY_SUCCEEDED(pResult.QueryInterface(&pCompileTimings));
+    VERIFY_SUCCEEDED(pCompileTimings->GetTimings(&pTimings));
+    std::string timings = BlobToUtf8(pTimings);
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, timings.find("\"validation.functions\""));
+    VERIFY_ARE_EQUAL(std::string::npos, timings.find("\"validation.signatures\""));
+  }
+  {
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcBlobEncoding> pErrors;
+    HRESULT status;
+    VERIFY_SUCCEEDED(pValidator->Validate(
+        pBlob, DxcValidatorFlags_RulesMetadata | DxcValidatorFlags_StopAtFirstError,
+        &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_FAILED(status);
+    VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+    VERIFY_ARE_NOT_EQUAL(std::string::npos,
+                         BlobToUtf8(pErrors).find("SV_Depth must be float"));
+  }
+  // The metadata checks run the instruction checks that find the written
+  // outputs, so a shader that writes its output passes.
+  {
+    CComPtr<IDxcBlobEncoding> pGoodSource;
+    CComPtr<IDxcBlob> pGoodText;
+    CComPtr<IDxcOperationResult> pGoodAssembleResult;
+    CComPtr<IDxcBlob> pGoodBlob;
+    CComPtr<IDxcOperationResult> pResult;
+    CComPtr<IDxcCompileTimings> pCompileTimings;
+    CComPtr<IDxcBlobEncoding> pTimings;
+    HRESULT status;
+    Utf8ToBlob(m_dllSupport, "float main() : SV_Depth { return 1; }",
+               &pGoodSource);
+    RewriteAssemblyToText(pGoodSource, "ps_6_0", nullptr, 0, nullptr, 0, {},
+                          {}, &pGoodText);
+    VERIFY_SUCCEEDED(
+        pAssembler->AssembleToContainer(pGoodText, &pGoodAssembleResult));
+    VERIFY_SUCCEEDED(pGoodAssembleResult->GetResult(&pGoodBlob));
+    VERIFY_SUCCEEDED(pValidator->Validate(
+        pGoodBlob, DxcValidatorFlags_RulesMetadata | DxcValidatorFlags_ReportTimings,
+        &pResult));
+    VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+    VERIFY_SUCCEEDED(status);
+    VERIFY_SUCCEEDED(pResult.QueryInterface(&pCompileTimings));
+    VERIFY_SUCCEEDED(pCompileTimings->GetTimings(&pTimings));
+    std::string timings = BlobToUtf8(pTimings);
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, timings.find("\"validation.functions\""));
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, timings.find("\"validation.flow-control\""));
+    VERIFY_ARE_EQUAL(std::string::npos, timings.find("\"validation.resources\""));
+  }
+}
+
 TEST_F(ValidationTest, BarrierFail) {
   if (m_ver.SkipIRSensitiveTest()) return;
     RewriteAssemblyCheckMsg(
@@ -3505,3 +3632,59 @@ TEST_F(ValidationTest, ShaderFunctionReturnTypeVoid) {
     },
     false);
 }
+
+TEST_F(ValidationTest, LibFunctionErrorsInModuleOrder) {
+  if (m_ver.SkipDxilVersion(1, 3)) return;
+  // Enough functions for the validator to check them on several threads.
+  // Each one gets an error, which must be reported in function order.
+  const unsigned kNumFunctions = 48;
+  std::string source;
+  std::vector<std::string> lookFors, replacements;
+  for (unsigned i = 0; i < kNumFunctions; ++i) {
+    std::string n = std::to_string(i);
+    source += "[shader(\"raygeneration\")] void RayGenProto" + n +
+              "() { return; }\n";
+    source += "export float BadRayGen" + n + "() { return " + n + "; }\n";
+    lookFors.emplace_back("!{void ()* @\"\\01?RayGenProto" + n +
+                          "@@YAXXZ\", !\"\\01?RayGenProto" + n + "@@YAXXZ\",");
+    replacements.emplace_back("!{float ()* @\"\\01?BadRayGen" + n +
+                              "@@YAMXZ\", !\"\\01?BadRayGen" + n +
+                              "@@YAMXZ\",");
+  }
+  std::vector<LPCSTR> pLookFors, pReplacements;
+  for (unsigned i = 0; i < kNumFunctions; ++i) {
+    pLookFors.emplace_back(lookFors[i].c_str());
+    pReplacements.emplace_back(replacements[i].c_str());
+  }
+
+  CComPtr<IDxcBlobEncoding> pSource;
+  CComPtr<IDxcBlob> pText;
+  Utf8ToBlob(m_dllSupport, source.c_str(), &pSource);
+  RewriteAssemblyToText(pSource, "lib_6_3", nullptr, 0, nullptr, 0, pLookFors,
+                        pReplacements, &pText);
+  CComPtr<IDxcAssembler> pAssembler;
+  CComPtr<IDxcOperationResult> pAssembleResult;
+  CComPtr<IDxcBlob> pBlob;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcAssembler, &pAssembler));
+  VERIFY_SUCCEEDED(pAssembler->AssembleToContainer(pText, &pAssembleResult));
+  VERIFY_SUCCEEDED(pAssembleResult->GetResult(&pBlob));
+
+  CComPtr<IDxcValidator> pValidator;
+  CComPtr<IDxcOperationResult> pResult;
+  CComPtr<IDxcBlobEncoding> pErrors;
+  HRESULT status;
+  VERIFY_SUCCEEDED(m_dllSupport.CreateInstance(CLSID_DxcValidator, &pValidator));
+  VERIFY_SUCCEEDED(pValidator->Validate(pBlob, DxcValidatorFlags_Default, &pResult));
+  VERIFY_SUCCEEDED(pResult->GetStatus(&status));
+  VERIFY_FAILED(status);
+  VERIFY_SUCCEEDED(pResult->GetErrorBuffer(&pErrors));
+  std::string errors = BlobToUtf8(pErrors);
+
+  size_t pos = 0;
+  for (unsigned i = 0; i < kNumFunctions; ++i) {
+    std::string msg = "Shader function '\\01?BadRayGen" + std::to_string(i) +
+                      "@@YAMXZ' must have void return type";
+    pos = errors.find(msg, pos);
+    VERIFY_ARE_NOT_EQUAL(std::string::npos, pos);
+  }
+}
@@ -133,6 +133,9 @@ TEST_F(FileTest, VarInitMatrix1xN) { runFileTest("var.init.matrix.1xn.hlsl"); }
 TEST_F(FileTest, VarInitMatrix1x1) { runFileTest("var.init.matrix.1x1.hlsl"); }
 TEST_F(FileTest, VarInitStruct) { runFileTest("var.init.struct.hlsl"); }
 TEST_F(FileTest, VarInitArray) { runFileTest("var.init.array.hlsl"); }
+TEST_F(FileTest, VarLocalLoadForwarding) {
+  runFileTest("var.local.load-forwarding.hlsl");
+}
 TEST_F(FileTest, VarInitCbuffer) {
   runFileTest("var.init.cbuffer.hlsl", Expect::Warning);
 }
@@ -456,6 +459,16 @@ TEST_F(FileTest, ControlFlowConditionalOp) { runFileTest("cf.cond-op.hlsl"); }
 
 // For functions
 TEST_F(FileTest, FunctionCall) { runFileTest("fn.call.hlsl"); }
+TEST_F(FileTest, FunctionMany) { runFileTest("fn.many.hlsl"); }
+TEST_F(FileTest, FunctionExportFromLibrary) {
+  // Vulkan has no Linkage capability; linking removes it.
+  runFileTest("fn.export.lib.hlsl", Expect::Success,
+              /*runValidation=*/false);
+}
+TEST_F(FileTest, FunctionImport) {
+  runFileTest("fn.import.hlsl", Expect::Success,
+              /*runValidation=*/false);
+}
 TEST_F(FileTest, FunctionDefaultArg) { runFileTest("fn.default-arg.hlsl"); }
 TEST_F(FileTest, FunctionInOutParam) {
   // Tests using uniform/in/out/inout annotations on function parameters
@@ -1276,6 +1289,9 @@ TEST_F(FileTest, SpirvOptOconfigInvalidFlag) {
   runFileTest("spirv.opt.invalid-flag.cl.oconfig.hlsl", Expect::Failure);
 }
 TEST_F(FileTest, SpirvOptOconfig) { runFileTest("spirv.opt.cl.oconfig.hlsl"); }
+TEST_F(FileTest, SpirvOptOconfigFast) {
+  runFileTest("spirv.opt.fast.cl.oconfig.hlsl");
+}
 
 // For shader stage input/output interface
 // For semantic SV_Position, SV_ClipDistance, SV_CullDistance
@@ -1479,6 +1495,9 @@ TEST_F(FileTest, VulkanRegisterBinding1to1MappingInvalidSetNo) {
 TEST_F(FileTest, VulkanRegisterBinding1to1MappingInvalidBindNo) {
   runFileTest("vk.binding.cl.register.invalid-bind.hlsl", Expect::Failure);
 }
+TEST_F(FileTest, VulkanRegisterBinding1to1MappingInvalidRegister) {
+  runFileTest("vk.binding.cl.register.invalid-reg.hlsl", Expect::Failure);
+}
 TEST_F(FileTest, VulkanRegisterBinding1to1MappingMissingAttr) {
   runFileTest("vk.binding.cl.register.missing-attr.hlsl", Expect::Failure);
 }
@@ -1512,6 +1531,9 @@ TEST_F(FileTest, VulkanSpecConstantInit) {
 TEST_F(FileTest, VulkanSpecConstantUsage) {
   runFileTest("vk.spec-constant.usage.hlsl");
 }
+TEST_F(FileTest, VulkanSpecConstantOption) {
+  runFileTest("vk.spec-constant.option.hlsl");
+}
 TEST_F(FileTest, VulkanSpecConstantError) {
   runFileTest("vk.spec-constant.error.hlsl", Expect::Failure);
 }
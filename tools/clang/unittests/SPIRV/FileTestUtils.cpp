@@ -85,7 +85,8 @@ bool processRunCommandArgs(const llvm::StringRef runCommandLine,
     fprintf(stderr, "Error: Missing target profile argument (-T).\n");
     return false;
   }
-  if (entryPoint->empty()) {
+  // Libraries have no entry point.
+  if (entryPoint->empty() && targetProfile->compare(0, 4, "lib_") != 0) {
     fprintf(stderr, "Error: Missing entry point argument (-E).\n");
     return false;
   }
@@ -159,8 +160,10 @@ bool runCompilerWithSpirvGeneration(const llvm::StringRef inputFilePath,
         requires_opt = true;
 
     std::vector<LPCWSTR> flags;
-    flags.push_back(L"-E");
-    flags.push_back(entry.c_str());
+    if (!entry.empty()) {
+      flags.push_back(L"-E");
+      flags.push_back(entry.c_str());
+    }
     flags.push_back(L"-T");
     flags.push_back(profile.c_str());
     flags.push_back(L"-spirv");
@@ -158,6 +158,30 @@ TEST(InstBuilder, NullConsumerResultsInError) {
   EXPECT_EQ(InstBuilder::Status::NullConsumer, ib.opLine(1, 2, 3).x());
 }
 
+TEST(InstBuilder, OutputBufferGetsAllWords) {
+  std::vector<uint32_t> result = {42u};
+  InstBuilder ib(&result);
+
+  expectBuildSuccess(
+      ib.opMemoryModel(spv::AddressingModel::Logical, spv::MemoryModel::GLSL450)
+          .x());
+  ib.emit(constructInst(spv::Op::OpLabel, {7u}));
+  expectBuildSuccess(ib.opFunctionEnd().x());
+
+  // Words are appended after what the buffer already held, in order.
+  std::vector<uint32_t> expected = {42u};
+  auto memoryModel =
+      constructInst(spv::Op::OpMemoryModel,
+                    {static_cast<uint32_t>(spv::AddressingModel::Logical),
+                     static_cast<uint32_t>(spv::MemoryModel::GLSL450)});
+  auto label = constructInst(spv::Op::OpLabel, {7u});
+  auto functionEnd = constructInst(spv::Op::OpFunctionEnd, {});
+  expected.insert(expected.end(), memoryModel.begin(), memoryModel.end());
+  expected.insert(expected.end(), label.begin(), label.end());
+  expected.insert(expected.end(), functionEnd.begin(), functionEnd.end());
+  EXPECT_THAT(result, ContainerEq(expected));
+}
+
 TEST(InstBuilder, InstWStringParams) {
   std::vector<uint32_t> result;
   auto ib = constructInstBuilder(result);
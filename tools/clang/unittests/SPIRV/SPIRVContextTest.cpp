@@ -13,6 +13,8 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <vector>
+
 using namespace clang::spirv;
 
 namespace {
@@ -101,6 +103,49 @@ TEST(SPIRVContext, UniqueIdForUniqueConstants) {
   EXPECT_NE(uint1Id, float1Id);
   EXPECT_NE(int1Id, anotherInt1Id);
 }
+
+TEST(SPIRVContext, UniquePointersSurviveGrowth) {
+  SPIRVContext ctx;
+
+  // Register enough constants to grow the tables several times; the first
+  // ones must keep their address and <result-id>.
+  const Constant *first = Constant::getUint32(ctx, 1, 0);
+  const uint32_t firstId = ctx.getResultIdForConstant(first);
+  std::vector<const Constant *> constants;
+  for (uint32_t i = 0; i < 10000; ++i)
+    constants.push_back(Constant::getUint32(ctx, 1, i));
+
+  EXPECT_EQ(constants.front(), first);
+  EXPECT_EQ(ctx.getResultIdForConstant(constants.front()), firstId);
+  for (uint32_t i = 0; i < 10000; ++i) {
+    EXPECT_EQ(constants[i]->getArgs().front(), i);
+    EXPECT_EQ(Constant::getUint32(ctx, 1, i), constants[i]);
+  }
+  EXPECT_NE(Constant::getUint32(ctx, 2, 0), first);
+}
+
+TEST(SPIRVContext, TypeLayoutsKeyedByTypeRuleAndMajorness) {
+  SPIRVContext ctx;
+  int a = 0, b = 0;
+
+  EXPECT_EQ(ctx.getTypeLayout(&a, 1, 0), nullptr);
+  const TypeLayout layout = {16, 64, 16, true, false};
+  ctx.setTypeLayout(&a, 1, 0, layout);
+
+  const TypeLayout *found = ctx.getTypeLayout(&a, 1, 0);
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(found->alignment, 16u);
+  EXPECT_EQ(found->size, 64u);
+  EXPECT_EQ(found->stride, 16u);
+  EXPECT_TRUE(found->hasStride);
+  EXPECT_FALSE(found->clearsMajorness);
+
+  // Another type, rule or majorness has a layout of its own.
+  EXPECT_EQ(ctx.getTypeLayout(&b, 1, 0), nullptr);
+  EXPECT_EQ(ctx.getTypeLayout(&a, 2, 0), nullptr);
+  EXPECT_EQ(ctx.getTypeLayout(&a, 1, 1), nullptr);
+}
+
 // TODO: Add more SPIRVContext tests
 
 } // anonymous namespace
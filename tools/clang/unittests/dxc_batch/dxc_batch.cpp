@@ -30,12 +30,19 @@
 #include "dxc/dxctools.h"
 #include "llvm/Option/ArgList.h"
 #include "llvm/Option/OptTable.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <comdef.h>
+#include <fstream>
+#include <limits>
+#include <mutex>
 #include <thread>
+#include <tuple>
 #include <unordered_map>
 
 #include "llvm/Support//MSFileSystem.h"
@@ -81,11 +88,17 @@ private:
   void ExtractRootSignature(IDxcBlob *pBlob, IDxcBlob **ppResult);
   int VerifyRootSignature();
 
+  // Files read by the last Compile: the input file, then each include.
+  std::vector<std::string> m_Dependencies;
+
 public:
   DxcContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
       : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
 
   int Compile(llvm::StringRef path, bool bLibLink);
+  const std::vector<std::string> &GetDependencies() const {
+    return m_Dependencies;
+  }
   int DumpBinary();
   void Preprocess();
 };
@@ -119,9 +132,139 @@ static void PrintHlslException(const ::hlsl::Exception &hlslException,
   }
 }
 
+// Record of what each command read and wrote the last time it succeeded,
+// used by -incremental to skip commands whose inputs haven't changed.
+//
+// The manifest is a text file next to the command file. Each entry starts
+// with a "command" line holding the exact command text, which covers every
+// argument and define, followed by "dep" and "out" lines with the MD5 and
+// path of each file the command read or wrote.
+class DxcBatchManifest {
+public:
+  void Load(const std::string &fileName) {
+    std::ifstream in(fileName);
+    std::string line;
+    Entry *pEntry = nullptr;
+    while (std::getline(in, line)) {
+      llvm::StringRef kind, rest;
+      std::tie(kind, rest) = llvm::StringRef(line).split(' ');
+      if (kind == "command") {
+        pEntry = &m_entries[rest.str()];
+        continue;
+      }
+      if (pEntry == nullptr)
+        continue;
+      llvm::StringRef hash, file;
+      std::tie(hash, file) = rest.split(' ');
+      if (kind == "dep")
+        pEntry->Dependencies.emplace_back(hash.str(), file.str());
+      else if (kind == "out")
+        pEntry->Outputs.emplace_back(hash.str(), file.str());
+    }
+  }
+
+  void Save(const std::string &fileName,
+            const std::vector<llvm::StringRef> &commands) {
+    std::ofstream out(fileName);
+    for (llvm::StringRef command : commands) {
+      auto it = m_entries.find(command.str());
+      if (it == m_entries.end())
+        continue;
+      out << "command " << it->first << '\n';
+      for (auto &dep : it->second.Dependencies)
+        out << "dep " << dep.first << ' ' << dep.second << '\n';
+      for (auto &output : it->second.Outputs)
+        out << "out " << output.first << ' ' << output.second << '\n';
+    }
+  }
+
+  // A command is up to date if it ran before with the same text, none of the
+  // files it read have changed, and its outputs are still what it wrote.
+  // Files are hashed without holding the lock, so workers checking other
+  // commands don't wait on each other's reads.
+  bool IsUpToDate(const std::string &command) {
+    Entry entry;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(command);
+      if (it == m_entries.end() || it->second.Outputs.empty())
+        return false;
+      entry = it->second;
+    }
+    for (auto &dep : entry.Dependencies) {
+      if (HashInput(dep.second) != dep.first)
+        return false;
+    }
+    for (auto &output : entry.Outputs) {
+      if (HashFile(output.second) != output.first)
+        return false;
+    }
+    return true;
+  }
+
+  void Record(const std::string &command,
+              const std::vector<std::string> &dependencies,
+              const std::vector<std::string> &outputs) {
+    Entry entry;
+    for (const std::string &dep : dependencies)
+      entry.Dependencies.emplace_back(HashInput(dep), dep);
+    for (const std::string &output : outputs)
+      entry.Outputs.emplace_back(HashFile(output), output);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries[command] = std::move(entry);
+  }
+
+  void Forget(const std::string &command) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_entries.erase(command);
+  }
+
+private:
+  struct Entry {
+    std::vector<std::pair<std::string, std::string>> Dependencies;
+    std::vector<std::pair<std::string, std::string>> Outputs;
+  };
+  std::mutex m_mutex;
+  std::unordered_map<std::string, Entry> m_entries;
+  // Inputs don't change during a batch, so each one is hashed once per run
+  // no matter how many commands include it.
+  std::unordered_map<std::string, std::string> m_inputHashes;
+
+  static std::string HashFile(const std::string &fileName) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in)
+      return "missing";
+    std::string contents((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    llvm::MD5 hasher;
+    hasher.update(contents);
+    llvm::MD5::MD5Result digest;
+    hasher.final(digest);
+    SmallString<32> digestText;
+    llvm::MD5::stringifyResult(digest, digestText);
+    return digestText.str();
+  }
+
+  // Two workers may hash the same input at once; both get the same hash, and
+  // the first to finish publishes it.
+  std::string HashInput(const std::string &fileName) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_inputHashes.find(fileName);
+      if (it != m_inputHashes.end())
+        return it->second;
+    }
+    std::string hash = HashFile(fileName);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inputHashes.emplace(fileName, hash).first->second;
+  }
+};
+
 static int Compile(llvm::StringRef command, DxcDllSupport &dxcSupport,
                    llvm::StringRef path, bool bLinkLib,
-                   std::string &errorString) {
+                   std::string &errorString,
+                   std::vector<std::string> *pDependencies = nullptr,
+                   std::vector<std::string> *pOutputs = nullptr) {
                    //llvm::raw_string_ostream &errorStream) {
   const OptTable *optionTable = getHlslOptTable();
   llvm::SmallVector<llvm::StringRef, 4> args;
@@ -150,6 +293,18 @@ static int Compile(llvm::StringRef command, DxcDllSupport &dxcSupport,
       }
       else {
         retVal = context.Compile(path, bLinkLib);
+        // Debug output may go to a directory under a generated name, so
+        // only commands with plain file outputs can be tracked.
+        if (0 == retVal && pDependencies && pOutputs &&
+            dxcOpts.DebugFile.empty()) {
+          *pDependencies = context.GetDependencies();
+          for (llvm::StringRef output :
+               {dxcOpts.OutputObject, dxcOpts.OutputHeader,
+                dxcOpts.AssemblyCode, dxcOpts.OutputWarningsFile}) {
+            if (!output.empty())
+              pOutputs->push_back(output.str());
+          }
+        }
       }
     }
     catch (const ::hlsl::Exception &hlslException) {
@@ -558,6 +713,37 @@ public:
   }
 };
 
+// Forwards to another include handler and records every file it found.
+class DxcIncludeHandlerForDependencies : public IDxcIncludeHandler {
+private:
+  DXC_MICROCOM_REF_FIELD(m_dwRef)
+  CComPtr<IDxcIncludeHandler> m_pInner;
+  std::vector<std::string> &m_Dependencies;
+
+public:
+  DXC_MICROCOM_ADDREF_RELEASE_IMPL(m_dwRef)
+  DxcIncludeHandlerForDependencies(IDxcIncludeHandler *pInner,
+                                   std::vector<std::string> &dependencies)
+      : m_dwRef(0), m_pInner(pInner), m_Dependencies(dependencies) {}
+
+  HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, void **ppvObject) {
+    return DoBasicQueryInterface<IDxcIncludeHandler>(this, iid, ppvObject);
+  }
+
+  HRESULT STDMETHODCALLTYPE
+  LoadSource(_In_ LPCWSTR pFilename,
+             _COM_Outptr_result_maybenull_ IDxcBlob **ppIncludeSource) override {
+    HRESULT hr = m_pInner->LoadSource(pFilename, ppIncludeSource);
+    if (SUCCEEDED(hr) && *ppIncludeSource != nullptr) {
+      try {
+        m_Dependencies.push_back(Unicode::UTF16ToUTF8StringOrThrow(pFilename));
+      }
+      CATCH_CPP_RETURN_HRESULT()
+    }
+    return hr;
+  }
+};
+
 int DxcContext::Compile(llvm::StringRef path, bool bLibLink) {
   CComPtr<IDxcCompiler> pCompiler;
   CComPtr<IDxcOperationResult> pCompileResult;
@@ -584,9 +770,11 @@ int DxcContext::Compile(llvm::StringRef path, bool bLibLink) {
     CComPtr<IDxcLibrary> pLibrary;
     IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &pLibrary));
     IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+    m_Dependencies.clear();
     if (path.empty()) {
       ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile),
                        &pSource);
+      m_Dependencies.push_back(m_Opts.InputFile);
     } else {
       llvm::sys::fs::MSFileSystem *msfPtr;
       IFT(CreateMSFileSystemForDisk(&msfPtr));
@@ -598,18 +786,23 @@ int DxcContext::Compile(llvm::StringRef path, bool bLibLink) {
       if (llvm::sys::fs::exists(m_Opts.InputFile)) {
         ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile),
                          &pSource);
+        m_Dependencies.push_back(m_Opts.InputFile);
       } else {
         SmallString<128> pathStr(path.begin(), path.end());
         llvm::sys::path::append(pathStr, m_Opts.InputFile.begin(),
                                 m_Opts.InputFile.end());
         ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(pathStr.str().str()),
                          &pSource);
+        m_Dependencies.push_back(pathStr.str());
       }
     }
     IFTARG(pSource->GetBufferSize() >= 4);
 
-    CComPtr<IDxcIncludeHandler> pIncludeHandler;
-    IFT(pLibrary->CreateIncludeHandler(&pIncludeHandler));
+    CComPtr<IDxcIncludeHandler> pDefaultIncludeHandler;
+    IFT(pLibrary->CreateIncludeHandler(&pDefaultIncludeHandler));
+    CComPtr<IDxcIncludeHandler> pIncludeHandler =
+        new DxcIncludeHandlerForDependencies(pDefaultIncludeHandler,
+                                             m_Dependencies);
 
     // Upgrade profile to 6.0 version from minimum recognized shader model
     llvm::StringRef TargetProfile = m_Opts.TargetProfile;
@@ -755,18 +948,38 @@ public:
   DxcBatchContext(DxcOpts &Opts, DxcDllSupport &dxcSupport)
       : m_Opts(Opts), m_dxcSupport(dxcSupport) {}
 
-  int BatchCompile(bool bMultiThread, bool bLibLink);
+  int BatchCompile(bool bMultiThread, bool bLibLink, bool bIncremental,
+                   bool bTimings);
 
 private:
   DxcOpts &m_Opts;
   DxcDllSupport &m_dxcSupport;
 };
 
-int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink) {
+// Reads the per-command wall-clock times recorded by the previous run.
+static void ReadCommandTimings(const std::string &fileName,
+                               std::unordered_map<std::string, double> &timings) {
+  std::ifstream in(fileName);
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t space = line.find(' ');
+    if (space == std::string::npos)
+      continue;
+    timings[line.substr(space + 1)] = atof(line.substr(0, space).c_str());
+  }
+}
+
+static void WriteCommandTimings(const std::string &fileName,
+                                const std::vector<llvm::StringRef> &commands,
+                                const std::vector<double> &durations) {
+  std::ofstream out(fileName);
+  for (size_t i = 0; i < commands.size(); ++i)
+    out << durations[i] << ' ' << commands[i].str() << '\n';
+}
+
+int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink,
+                                  bool bIncremental, bool bTimings) {
   int retVal = 0;
-  DxcOpts tmp_Opts;
-  // tmp_Opts = m_Opts;
-  m_Opts.InputFile;
   SmallString<128> path(m_Opts.InputFile.begin(), m_Opts.InputFile.end());
   llvm::sys::path::remove_filename(path);
 
@@ -774,63 +987,127 @@ int DxcBatchContext::BatchCompile(bool bMultiThread, bool bLibLink) {
   ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(m_Opts.InputFile), &pSource);
   llvm::StringRef source((char *)pSource->GetBufferPointer(),
                          pSource->GetBufferSize());
-  llvm::SmallVector<llvm::StringRef, 4> commands;
-  source.split(commands, "\n", /*MaxSplit*/-1, /*KeepEmpty*/false);
-
-  if (bMultiThread) {
-    unsigned int threadNum = std::min<unsigned>(
-        std::thread::hardware_concurrency(), commands.size());
-    auto empty_fn = []() {};
-    std::vector<std::thread> threads(threadNum);
-    std::vector<std::string> errorStrings(threadNum);
-    for (unsigned i = 0; i < threadNum; i++)
-      threads[i] = std::thread(empty_fn);
+  llvm::SmallVector<llvm::StringRef, 4> lines;
+  source.split(lines, "\n", /*MaxSplit*/-1, /*KeepEmpty*/false);
+
+  std::vector<llvm::StringRef> commands;
+  for (llvm::StringRef command : lines) {
+    // trim to remove /r if exist.
+    command = command.trim();
+    if (command.empty())
+      continue;
+    if (command.startswith("//"))
+      continue;
+    commands.push_back(command);
+  }
 
-    for (unsigned i = 0; i < commands.size(); i++) {
-      // trim to remove /r if exist.
-      llvm::StringRef command = commands[i].trim();
-      if (command.empty())
+  // Start the longest commands first, going by the timings recorded by the
+  // last run with -timings, so a slow shader doesn't end up queued behind
+  // everything else. Commands without a recorded time are started first.
+  std::string timingsFile = m_Opts.InputFile.str() + ".timings";
+  std::unordered_map<std::string, double> lastTimings;
+  ReadCommandTimings(timingsFile, lastTimings);
+  auto lastDuration = [&](unsigned i) {
+    auto it = lastTimings.find(commands[i].str());
+    return it == lastTimings.end() ? std::numeric_limits<double>::infinity()
+                                   : it->second;
+  };
+  std::vector<unsigned> order(commands.size());
+  for (unsigned i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+    return lastDuration(a) > lastDuration(b);
+  });
+
+  // Workers take the next command off the shared queue as soon as they are
+  // done with their current one.
+  // With -incremental, commands whose recorded inputs and outputs are
+  // unchanged since the last successful run are skipped.
+  std::string manifestFile = m_Opts.InputFile.str() + ".deps";
+  DxcBatchManifest manifest;
+  if (bIncremental)
+    manifest.Load(manifestFile);
+
+  std::vector<int> results(commands.size(), 0);
+  std::vector<std::string> errorStrings(commands.size());
+  std::vector<double> durations(commands.size(), 0.0);
+  std::vector<bool> upToDate(commands.size(), false);
+  std::atomic<unsigned> nextCommand(0);
+  auto worker = [&]() {
+    for (unsigned n = nextCommand++; n < order.size(); n = nextCommand++) {
+      unsigned i = order[n];
+      std::string command = commands[i].str();
+      if (bIncremental && manifest.IsUpToDate(command)) {
+        // Keep the old timing so the command is still ordered sensibly
+        // once it needs to run again.
+        upToDate[i] = true;
+        double last = lastDuration(i);
+        durations[i] = std::isinf(last) ? 0.0 : last;
         continue;
-      if (command.startswith("//"))
+      }
+      std::vector<std::string> dependencies, outputs;
+      auto t_start = std::chrono::high_resolution_clock::now();
+      results[i] = ::Compile(commands[i], m_dxcSupport, path.str(), bLibLink,
+                             errorStrings[i], &dependencies, &outputs);
+      auto t_end = std::chrono::high_resolution_clock::now();
+      durations[i] =
+          std::chrono::duration<double, std::milli>(t_end - t_start).count();
+      if (!bIncremental)
         continue;
-
-      unsigned threadIdx = i % threadNum;
-      threads[threadIdx].join();
-
-      threads[threadIdx] = std::thread(
-          ::Compile, command, std::ref(m_dxcSupport), path.str(), bLibLink,
-                     std::ref(errorStrings[threadIdx]));
+      if (0 == results[i] && errorStrings[i].empty() && !outputs.empty())
+        manifest.Record(command, dependencies, outputs);
+      else
+        manifest.Forget(command);
     }
+  };
+
+  if (bMultiThread) {
+    unsigned int threadNum = std::max(1u, std::min<unsigned>(
+        std::thread::hardware_concurrency(), commands.size()));
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadNum; i++)
+      threads.emplace_back(worker);
     for (auto &th : threads)
       th.join();
+  } else {
+    worker();
+  }
 
-    for (unsigned i = 0; i < threadNum; i++) {
-      auto &errorString = errorStrings[i];
-      if (errorString.size()) {
-        fprintf(stderr, "dxc_batch failed : %s", errorString.c_str());
-        if (0 == retVal)
-          retVal = 1;
-      }
+  for (unsigned i = 0; i < commands.size(); i++) {
+    if (results[i] && 0 == retVal)
+      retVal = results[i];
+    auto &errorString = errorStrings[i];
+    if (errorString.size()) {
+      fprintf(stderr, "dxc_batch failed : %s", errorString.c_str());
+      if (0 == retVal)
+        retVal = 1;
     }
-  } else {
-    for (llvm::StringRef command : commands) {
-      // trim to remove /r if exist.
-      command = command.trim();
-      if (command.empty())
-        continue;
-      if (command.startswith("//"))
-        continue;
-      std::string errorString;
-      int ret = Compile(command, m_dxcSupport, path.str(), bLibLink, errorString);
-      if (ret && 0 == retVal)
-        retVal = ret;
-      if (errorString.size()) {
-        fprintf(stderr, "dxc_batch failed : %s", errorString.c_str());
-        if (0 == retVal)
-          retVal = 1;
-      }
+  }
+
+  // With -timings, report where the time went, slowest first, and record
+  // it for the next run to order its commands by.
+  if (bTimings) {
+    std::vector<unsigned> bySlowest(order);
+    std::stable_sort(bySlowest.begin(), bySlowest.end(),
+                     [&](unsigned a, unsigned b) {
+                       return durations[a] > durations[b];
+                     });
+    fprintf(stderr, "command timings:\n");
+    for (unsigned i : bySlowest) {
+      if (!upToDate[i])
+        fprintf(stderr, "%10.1f ms  %s\n", durations[i],
+                commands[i].str().c_str());
     }
+    WriteCommandTimings(timingsFile, commands, durations);
   }
+  if (bIncremental) {
+    unsigned upToDateCount = (unsigned)std::count(upToDate.begin(),
+                                                  upToDate.end(), true);
+    fprintf(stderr, "%u of %u commands up to date\n", upToDateCount,
+            (unsigned)commands.size());
+    manifest.Save(manifestFile, commands);
+  }
+
   return retVal;
 }
 
@@ -854,6 +1131,10 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     bool bMultiThread = false;
     const char *kLibLinkArg = "-lib-link";
     bool bLibLink = false;
+    const char *kIncrementalArg = "-incremental";
+    bool bIncremental = false;
+    const char *kTimingsArg = "-timings";
+    bool bTimings = false;
     // Parse command line options.
     const OptTable *optionTable = getHlslOptTable();
     MainArgs argStrings(argc, argv_);
@@ -866,10 +1147,15 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     std::vector<StringRef> refArgs;
     refArgs.reserve(args.size());
     for (auto &arg : args) {
-      if (arg != kMultiThreadArg && arg != kLibLinkArg) {
+      if (arg != kMultiThreadArg && arg != kLibLinkArg &&
+          arg != kIncrementalArg && arg != kTimingsArg) {
         refArgs.emplace_back(arg.c_str());
       } else if (arg == kLibLinkArg) {
         bLibLink = true;
+      } else if (arg == kIncrementalArg) {
+        bIncremental = true;
+      } else if (arg == kTimingsArg) {
+        bTimings = true;
       } else {
         bMultiThread = true;
       }
@@ -901,7 +1187,7 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
       std::string helpString;
       llvm::raw_string_ostream helpStream(helpString);
       optionTable->PrintHelp(helpStream, "dxc_bach.exe", "HLSL Compiler", "");
-      helpStream << "multi-thread";
+      helpStream << "multi-thread\nincremental\ntimings";
       helpStream.flush();
       dxc::WriteUtf8ToConsoleSizeT(helpString.data(), helpString.size());
       return 0;
@@ -923,7 +1209,8 @@ int __cdecl wmain(int argc, const wchar_t **argv_) {
     EnsureEnabled(dxcSupport);
     DxcBatchContext context(dxcOpts, dxcSupport);
     pStage = "BatchCompilation";
-    retVal = context.BatchCompile(bMultiThread, bLibLink);
+    retVal = context.BatchCompile(bMultiThread, bLibLink, bIncremental,
+                                  bTimings);
     {
       auto t_end = std::chrono::high_resolution_clock::now();
       double duration_ms =
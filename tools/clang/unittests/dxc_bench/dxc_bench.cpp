@@ -0,0 +1,730 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxc_bench.cpp                                                             //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxc_bench console program.               //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// dxc_bench compiles a set of shaders several times each and reports how long
+// the compiles took, how much memory they needed and which passes dominated,
+// so that changes to the compiler's speed can be tracked against a baseline.
+//
+// Shaders come from the corpus list (paths relative to the list, compiled
+// with the arguments of their first %dxc RUN line) and from a few generated
+// stress shaders.
+//
+// The size of the DXIL part and the time to load it back are reported as
+// well, to track the bitcode encoding; -arg /validator-version -arg 1.3
+// compares against the encoding older validators get.
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <d3d12shader.h>
+#endif
+
+using namespace dxc;
+using namespace llvm;
+using namespace hlsl::options;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input hlsl files>"));
+
+static cl::opt<std::string>
+CorpusFilename("corpus", cl::desc("File listing the shaders to compile"),
+               cl::value_desc("filename"));
+
+static cl::opt<unsigned>
+Iterations("n", cl::desc("Timed compiles of each shader (default 10)"),
+           cl::init(10));
+
+static cl::opt<bool>
+NoSynthetic("no-synthetic", cl::desc("Skip the generated stress shaders"));
+
+static cl::opt<unsigned>
+TableMegabytes("table-mb",
+               cl::desc("Also compile a generated lookup table shader of "
+                        "about this many megabytes (default 0, none)"),
+               cl::init(0));
+
+static cl::list<std::string>
+ExtraArguments("arg", cl::desc("Argument to add to every compile"),
+               cl::value_desc("argument"));
+
+static cl::opt<unsigned>
+TopPasses("passes", cl::desc("Passes to list for each shader (default 3)"),
+          cl::init(3));
+
+static cl::opt<std::string>
+BaselineFilename("baseline", cl::desc("Baseline to compare against"),
+                 cl::value_desc("filename"));
+
+static cl::opt<std::string>
+SaveBaselineFilename("save-baseline", cl::desc("Write the results as a baseline"),
+                     cl::value_desc("filename"));
+
+static cl::opt<double>
+Threshold("threshold",
+          cl::desc("Slowdown in p50 over the baseline, in percent, that "
+                   "counts as a regression (default 10)"),
+          cl::init(10.0));
+
+namespace {
+
+struct BenchShader {
+  std::string Name;
+  std::string SourceName;
+  std::string Source;          // Empty when read from SourceName.
+  std::string EntryPoint;
+  std::string TargetProfile;
+  std::vector<std::string> Arguments;
+};
+
+struct BenchResult {
+  std::string Name;
+  double P50 = 0;              // Milliseconds.
+  double P90 = 0;
+  int64_t PeakBytes = -1;
+  int64_t DxilBytes = -1;      // Bitcode of the DXIL part.
+  double LoadP50 = -1;         // Milliseconds to load the DXIL part.
+  std::vector<std::pair<std::string, double>> Passes; // Slowest first.
+  bool Failed = false;
+};
+
+struct BaselineEntry {
+  double P50;
+  double P90;
+  int64_t PeakBytes;
+};
+
+} // namespace
+
+// Takes the arguments of the first %dxc RUN line, up to the pipe or
+// redirection, and splits out the entry point and target.
+static bool ReadRunLine(const std::string &Source, BenchShader &Shader) {
+  std::istringstream Lines(Source);
+  std::string Line;
+  while (std::getline(Lines, Line)) {
+    size_t Pos = Line.find("RUN:");
+    if (Pos == std::string::npos)
+      continue;
+    size_t Dxc = Line.find("%dxc", Pos);
+    if (Dxc == std::string::npos)
+      continue;
+    std::istringstream Tokens(Line.substr(Dxc + 4));
+    std::vector<std::string> Args;
+    std::string Token;
+    while (Tokens >> Token) {
+      if (Token == "|" || Token[0] == '>' || Token == "2>&1")
+        break;
+      if (Token == "%s")
+        continue;
+      Token.erase(std::remove(Token.begin(), Token.end(), '"'), Token.end());
+      Args.push_back(Token);
+    }
+    Shader.EntryPoint = "main";
+    for (size_t i = 0; i < Args.size(); ++i) {
+      StringRef Arg(Args[i]);
+      if (Arg.size() < 2 || (Arg[0] != '-' && Arg[0] != '/') ||
+          (Arg[1] != 'E' && Arg[1] != 'T')) {
+        Shader.Arguments.push_back(Args[i]);
+        continue;
+      }
+      std::string Value = Arg.substr(2);
+      if (Value.empty() && i + 1 < Args.size())
+        Value = Args[++i];
+      (Arg[1] == 'E' ? Shader.EntryPoint : Shader.TargetProfile) = Value;
+    }
+    // Libraries have no single entry point.
+    if (StringRef(Shader.TargetProfile).startswith("lib_"))
+      Shader.EntryPoint.clear();
+    return !Shader.TargetProfile.empty();
+  }
+  return false;
+}
+
+static bool ReadShaderFile(const std::string &Path, BenchShader &Shader) {
+  std::ifstream File(Path, std::ios::binary);
+  if (!File)
+    return false;
+  std::stringstream Contents;
+  Contents << File.rdbuf();
+  Shader.Name = sys::path::filename(Path);
+  Shader.SourceName = Path;
+  return ReadRunLine(Contents.str(), Shader);
+}
+
+static void ReadCorpus(const std::string &ListPath,
+                       std::vector<BenchShader> &Shaders) {
+  std::ifstream List(ListPath);
+  if (!List)
+    throw hlsl::Exception(E_INVALIDARG, "unable to open " + ListPath);
+  StringRef Dir = sys::path::parent_path(ListPath);
+  std::string Line;
+  while (std::getline(List, Line)) {
+    StringRef Entry = StringRef(Line).trim();
+    if (Entry.empty() || Entry[0] == '#')
+      continue;
+    SmallString<256> Path(Dir);
+    sys::path::append(Path, Entry);
+    BenchShader Shader;
+    if (!ReadShaderFile(Path.str(), Shader))
+      throw hlsl::Exception(E_INVALIDARG,
+                            "no %dxc RUN line with a target in " +
+                                Path.str().str());
+    Shaders.push_back(std::move(Shader));
+  }
+}
+
+// The stress shaders stretch the parts of the compiler the corpus only
+// touches lightly: unrolling, large constant buffers and rows read across
+// branches, large local arrays of structs, dense intrinsic calls, long chains
+// of matrix math, long dependency chains for the ViewID analysis, libraries
+// with many entry points and, with SPIR-V, many resources to bind.
+static void AddSyntheticShaders(std::vector<BenchShader> &Shaders) {
+  std::ostringstream Unroll;
+  Unroll << "float4 main(float4 x : A) : SV_Target {\n"
+            "  float4 acc = x;\n"
+            "  [unroll] for (int i = 0; i < 512; ++i)\n"
+            "    acc = sin(acc * i + x) + cos(acc.wzyx);\n"
+            "  return acc;\n"
+            "}\n";
+
+  std::ostringstream CBuffer;
+  CBuffer << "cbuffer Constants : register(b0) {\n";
+  for (unsigned i = 0; i < 1024; ++i)
+    CBuffer << "  float4 c" << i << ";\n";
+  CBuffer << "};\n"
+             "float4 main(float4 x : A) : SV_Target {\n"
+             "  float4 acc = x;\n";
+  for (unsigned i = 0; i < 1024; ++i)
+    CBuffer << "  acc = acc * c" << i << " + c" << (1023 - i) << ".yzwx;\n";
+  CBuffer << "  return acc;\n"
+             "}\n";
+
+  std::ostringstream Branches;
+  Branches << "cbuffer Constants : register(b0) {\n";
+  for (unsigned i = 0; i < 64; ++i)
+    Branches << "  float4 c" << i << ";\n";
+  Branches << "};\n"
+              "float4 main(float4 x : A) : SV_Target {\n"
+              "  float4 acc = x;\n";
+  for (unsigned i = 0; i < 256; ++i)
+    Branches << "  if (acc.x > " << i << ") acc += c" << (i % 64)
+             << "; else acc -= c" << (i % 64) << ".wzyx;\n"
+             << "  acc *= c" << (i % 64) << ".x;\n";
+  Branches << "  return acc;\n"
+              "}\n";
+
+  std::ostringstream Aggregates;
+  Aggregates << "struct Inner { float4 a; float b; };\n"
+                "struct Outer { Inner i[2]; float4 c; };\n"
+                "float4 main(float4 x : A, uint n : N) : SV_Target {\n"
+                "  Outer o[256];\n"
+                "  [unroll] for (uint i = 0; i < 256; ++i) {\n"
+                "    o[i].i[0].a = x * i; o[i].i[0].b = i;\n"
+                "    o[i].i[1].a = x.wzyx; o[i].i[1].b = i + 1;\n"
+                "    o[i].c = x + i;\n"
+                "  }\n"
+                "  Outer r = o[n % 256];\n"
+                "  return r.i[n & 1].a * r.i[0].b + r.c;\n"
+                "}\n";
+
+  std::ostringstream Intrinsics;
+  Intrinsics << "float4 main(float4 x : A, float4 y : B) : SV_Target {\n"
+                "  float4 acc = x;\n";
+  for (unsigned i = 0; i < 256; ++i)
+    Intrinsics << "  acc = lerp(saturate(acc), abs(y), frac(acc.x));\n"
+                  "  acc = max(min(acc, exp2(y)), log2(abs(acc) + 1));\n"
+                  "  acc = smoothstep(0, 1, acc) * rsqrt(dot(acc, y) + 2);\n"
+                  "  acc = clamp(normalize(acc + 1), -y, y + " << i
+               << ");\n";
+  Intrinsics << "  return acc;\n"
+                "}\n";
+
+  std::ostringstream Matrix;
+  Matrix << "float4x4 m[8];\n"
+            "float4 main(float4 x : A) : SV_Target {\n"
+            "  float4x4 acc = m[0];\n";
+  for (unsigned i = 0; i < 256; ++i)
+    Matrix << "  acc = mul(transpose(acc), m[" << (i % 8)
+           << "]) + (float4x4)x.x;\n";
+  Matrix << "  return mul(x, acc);\n"
+            "}\n";
+
+  std::ostringstream ViewId;
+  ViewId << "struct VSOut { float4 pos : SV_Position; float4 o[8] : O; };\n"
+            "VSOut main(float4 a : A, float4 b : B, uint n : N,\n"
+            "           uint vid : SV_ViewID) {\n"
+            "  float4 acc[8];\n"
+            "  [unroll] for (uint i = 0; i < 8; ++i) acc[i] = a * i;\n"
+            "  for (uint k = 0; k < n; ++k) {\n";
+  for (unsigned i = 0; i < 1024; ++i)
+    ViewId << "    acc[" << (i % 8) << "] = acc[" << (i % 8) << "] * b + acc["
+           << ((i + 1) % 8) << "];\n";
+  ViewId << "  }\n"
+            "  VSOut r;\n"
+            "  r.pos = acc[0] + vid;\n"
+            "  [unroll] for (uint i = 0; i < 8; ++i) r.o[i] = acc[i];\n"
+            "  return r;\n"
+            "}\n";
+
+#ifdef ENABLE_SPIRV_CODEGEN
+  // Every other texture has an explicit register, so implicit bindings are
+  // found between explicit ones.
+  std::ostringstream Bindings;
+  for (unsigned i = 0; i < 4096; ++i) {
+    Bindings << "Texture2D<float4> t" << i;
+    if (i % 2)
+      Bindings << " : register(t" << (i * 3) << ", space" << (i % 4) << ")";
+    Bindings << ";\n";
+  }
+  Bindings << "float4 main(float4 a : A) : SV_Position {\n"
+              "  float4 r = 0;\n";
+  for (unsigned i = 0; i < 4096; ++i)
+    Bindings << "  r += t" << i << ".Load(int3(a.xy, " << (i % 4) << "));\n";
+  Bindings << "  return r;\n"
+              "}\n";
+#endif
+
+  std::ostringstream Library;
+  Library << "struct Payload { float4 color; };\n"
+             "RaytracingAccelerationStructure Scene : register(t0);\n"
+             "RWTexture2D<float4> Output : register(u0);\n";
+  for (unsigned i = 0; i < 64; ++i) {
+    Library << "[shader(\"raygeneration\")] void RayGen" << i << "() {\n"
+               "  RayDesc ray;\n"
+               "  ray.Origin = float3(DispatchRaysIndex().xy, " << i << ");\n"
+               "  ray.Direction = float3(0, 0, 1);\n"
+               "  ray.TMin = 0;\n"
+               "  ray.TMax = 1000;\n"
+               "  Payload p = { float4(0, 0, 0, 0) };\n"
+               "  TraceRay(Scene, RAY_FLAG_NONE, 0xff, " << i << ", 1, " << i
+            << ", ray, p);\n"
+               "  Output[DispatchRaysIndex().xy] = p.color;\n"
+               "}\n"
+               "[shader(\"miss\")] void Miss" << i << "(inout Payload p) {\n"
+               "  p.color = float4(" << i << ", WorldRayDirection());\n"
+               "}\n";
+  }
+
+  const struct {
+    const char *Name;
+    std::string Source;
+    const char *EntryPoint;
+    const char *TargetProfile;
+    std::vector<std::string> Arguments;
+  } Synthetic[] = {
+    { "synthetic-unroll", Unroll.str(), "main", "ps_6_0" },
+    { "synthetic-cbuffer", CBuffer.str(), "main", "ps_6_0" },
+    { "synthetic-cbuffer-branches", Branches.str(), "main", "ps_6_0" },
+    { "synthetic-aggregates", Aggregates.str(), "main", "ps_6_0" },
+    { "synthetic-intrinsics", Intrinsics.str(), "main", "ps_6_0" },
+    { "synthetic-matrix", Matrix.str(), "main", "ps_6_0" },
+    { "synthetic-viewid", ViewId.str(), "main", "vs_6_1" },
+    { "synthetic-library", Library.str(), "", "lib_6_3" },
+#ifdef ENABLE_SPIRV_CODEGEN
+    { "synthetic-spirv-bindings", Bindings.str(), "main", "vs_6_0",
+      { "-spirv" } },
+#endif
+  };
+  for (const auto &S : Synthetic) {
+    BenchShader Shader;
+    Shader.Name = S.Name;
+    Shader.SourceName = std::string(S.Name) + ".hlsl";
+    Shader.Source = S.Source;
+    Shader.EntryPoint = S.EntryPoint;
+    Shader.TargetProfile = S.TargetProfile;
+    Shader.Arguments = S.Arguments;
+    Shaders.push_back(std::move(Shader));
+  }
+}
+
+// The table shader is what tools that bake data write: a few lines of code
+// and megabytes of literals, aligned with spaces and commented per row, which
+// mostly stretches the lexer.
+static void AddTableShader(std::vector<BenchShader> &Shaders,
+                           unsigned Megabytes) {
+  std::ostringstream Rows;
+  uint64_t TargetBytes = (uint64_t)Megabytes << 20;
+  unsigned RowCount = 0;
+  Rows << "// Generated lookup table. Do not edit.\n";
+  while ((uint64_t)Rows.tellp() < TargetBytes) {
+    Rows << "    float4(  " << (RowCount % 1000) << ".125000,  -"
+         << (RowCount % 977) << ".062500,   0.333333,  " << RowCount
+         << ".0 ),   // row " << RowCount << "\n";
+    ++RowCount;
+  }
+
+  std::ostringstream Table;
+  Table << "static const float4 Table[" << RowCount << "] = {\n"
+        << Rows.str()
+        << "};\n"
+           "float4 main(uint i : A) : SV_Target {\n"
+           "  return Table[i % " << RowCount << "];\n"
+           "}\n";
+
+  BenchShader Shader;
+  Shader.Name = "synthetic-table";
+  Shader.SourceName = "synthetic-table.hlsl";
+  Shader.Source = Table.str();
+  Shader.EntryPoint = "main";
+  Shader.TargetProfile = "ps_6_0";
+  Shaders.push_back(std::move(Shader));
+}
+
+// Sums the seconds of each pass in the -ftime-report timings, where every
+// pass is an object on its own line.
+static void ReadPassTimes(StringRef Timings,
+                          std::vector<std::pair<std::string, double>> &Passes) {
+  std::map<std::string, double> Totals;
+  size_t Start = Timings.find("\"passes\"");
+  if (Start == StringRef::npos)
+    return;
+  SmallVector<StringRef, 64> Lines;
+  Timings.substr(Start).split(Lines, "\n");
+  for (StringRef Line : Lines) {
+    size_t NamePos = Line.find("{\"name\": \"");
+    size_t SecondsPos = Line.find("\"seconds\": ");
+    if (NamePos == StringRef::npos || SecondsPos == StringRef::npos)
+      continue;
+    StringRef Name = Line.substr(NamePos + 10);
+    Name = Name.substr(0, Name.find('"'));
+    double Seconds = 0;
+    std::istringstream(Line.substr(SecondsPos + 11).str()) >> Seconds;
+    Totals[Name] += Seconds;
+  }
+  Passes.assign(Totals.begin(), Totals.end());
+  std::sort(Passes.begin(), Passes.end(),
+            [](const std::pair<std::string, double> &A,
+               const std::pair<std::string, double> &B) {
+              return A.second > B.second;
+            });
+}
+
+class BenchContext {
+private:
+  DxcDllSupport &m_dxcSupport;
+  CComPtr<IDxcLibrary> m_pLibrary;
+
+  HRESULT CompileOnce(IDxcCompiler *pCompiler, IDxcBlobEncoding *pSource,
+                      IDxcIncludeHandler *pIncludeHandler,
+                      const BenchShader &Shader, bool TimeReport,
+                      IDxcOperationResult **ppResult);
+  void MeasureDxil(IDxcBlob *pProgram, BenchResult &Result);
+
+public:
+  BenchContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &m_pLibrary));
+  }
+
+  BenchResult Run(const BenchShader &Shader);
+};
+
+HRESULT BenchContext::CompileOnce(IDxcCompiler *pCompiler,
+                                  IDxcBlobEncoding *pSource,
+                                  IDxcIncludeHandler *pIncludeHandler,
+                                  const BenchShader &Shader, bool TimeReport,
+                                  IDxcOperationResult **ppResult) {
+  std::vector<std::wstring> Args;
+  for (const std::string &Arg : Shader.Arguments)
+    Args.push_back(Unicode::UTF8ToUTF16StringOrThrow(Arg.c_str()));
+  for (const std::string &Arg : ExtraArguments)
+    Args.push_back(Unicode::UTF8ToUTF16StringOrThrow(Arg.c_str()));
+  if (TimeReport)
+    Args.push_back(L"-ftime-report");
+  std::vector<LPCWSTR> ArgPtrs;
+  for (const std::wstring &Arg : Args)
+    ArgPtrs.push_back(Arg.c_str());
+
+  std::wstring SourceName =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.SourceName.c_str());
+  std::wstring EntryPoint =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.EntryPoint.c_str());
+  std::wstring TargetProfile =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.TargetProfile.c_str());
+  IFR(pCompiler->Compile(pSource, SourceName.c_str(), EntryPoint.c_str(),
+                         TargetProfile.c_str(), ArgPtrs.data(),
+                         (UINT32)ArgPtrs.size(), nullptr, 0, pIncludeHandler,
+                         ppResult));
+  HRESULT status;
+  IFR((*ppResult)->GetStatus(&status));
+  return status;
+}
+
+// Gets the size of the DXIL bitcode and, where shader reflection is
+// available, how long loading it through reflection takes. Library
+// reflection loads function bodies lazily, so libraries mostly measure the
+// module-level records.
+void BenchContext::MeasureDxil(IDxcBlob *pProgram, BenchResult &Result) {
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  if (pHeader == nullptr)
+    return;
+  const hlsl::DxilProgramHeader *pProgramHeader =
+      hlsl::GetDxilProgramHeader(pHeader, hlsl::DFCC_DXIL);
+  if (pProgramHeader == nullptr)
+    return;
+  Result.DxilBytes = hlsl::GetDxilBitcodeSize(pProgramHeader);
+
+#ifdef _WIN32
+  std::vector<double> Times;
+  for (unsigned i = 0; i < Iterations; ++i) {
+    CComPtr<IDxcContainerReflection> pReflection;
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcContainerReflection,
+                                    &pReflection));
+    auto Start = std::chrono::steady_clock::now();
+    UINT32 PartIndex;
+    CComPtr<IUnknown> pPartReflection;
+    if (FAILED(pReflection->Load(pProgram)) ||
+        FAILED(pReflection->FindFirstPartKind(hlsl::DFCC_DXIL, &PartIndex)) ||
+        (FAILED(pReflection->GetPartReflection(
+             PartIndex, __uuidof(ID3D12ShaderReflection),
+             (void **)&pPartReflection)) &&
+         FAILED(pReflection->GetPartReflection(
+             PartIndex, __uuidof(ID3D12LibraryReflection),
+             (void **)&pPartReflection))))
+      return;
+    Times.push_back(std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - Start).count());
+  }
+  std::sort(Times.begin(), Times.end());
+  Result.LoadP50 = Times[(Times.size() - 1) / 2];
+#endif
+}
+
+BenchResult BenchContext::Run(const BenchShader &Shader) {
+  BenchResult Result;
+  Result.Name = Shader.Name;
+
+  CComPtr<IDxcBlobEncoding> pSource;
+  if (Shader.Source.empty()) {
+    ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(Shader.SourceName),
+                     &pSource);
+  } else {
+    IFT(m_pLibrary->CreateBlobWithEncodingOnHeapCopy(
+        Shader.Source.data(), (UINT32)Shader.Source.size(), CP_UTF8,
+        &pSource));
+  }
+  CComPtr<IDxcIncludeHandler> pIncludeHandler;
+  IFT(m_pLibrary->CreateIncludeHandler(&pIncludeHandler));
+  CComPtr<IDxcCompiler> pCompiler;
+  IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &pCompiler));
+
+  // The first compile warms up the compiler and is not timed; the last one
+  // reports memory and passes, which slows it down, and is not timed either.
+  std::vector<double> Times;
+  CComPtr<IDxcBlob> pProgram;
+  for (unsigned i = 0; i < Iterations + 2; ++i) {
+    bool TimeReport = i == Iterations + 1;
+    CComPtr<IDxcOperationResult> pResult;
+    auto Start = std::chrono::steady_clock::now();
+    HRESULT status = CompileOnce(pCompiler, pSource, pIncludeHandler, Shader,
+                                 TimeReport, &pResult);
+    double Ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - Start).count();
+    if (FAILED(status)) {
+      CComPtr<IDxcBlobEncoding> pErrors;
+      if (pResult && SUCCEEDED(pResult->GetErrorBuffer(&pErrors)) &&
+          pErrors->GetBufferSize())
+        fprintf(stderr, "%s: %.*s\n", Shader.Name.c_str(),
+                (int)pErrors->GetBufferSize(),
+                (const char *)pErrors->GetBufferPointer());
+      Result.Failed = true;
+      return Result;
+    }
+    if (i == 0)
+      pResult->GetResult(&pProgram);
+    if (i != 0 && !TimeReport)
+      Times.push_back(Ms);
+    if (!TimeReport)
+      continue;
+
+    CComPtr<IDxcCompileMemoryUsage> pMemory;
+    UINT64 PeakBytes;
+    if (SUCCEEDED(pResult.QueryInterface(&pMemory)) &&
+        SUCCEEDED(pMemory->GetPeakBytes(&PeakBytes)))
+      Result.PeakBytes = (int64_t)PeakBytes;
+    CComPtr<IDxcCompileTimings> pTimings;
+    CComPtr<IDxcBlobEncoding> pTimingsText;
+    if (SUCCEEDED(pResult.QueryInterface(&pTimings)) &&
+        SUCCEEDED(pTimings->GetTimings(&pTimingsText)))
+      ReadPassTimes(StringRef((const char *)pTimingsText->GetBufferPointer(),
+                              pTimingsText->GetBufferSize()),
+                    Result.Passes);
+  }
+
+  std::sort(Times.begin(), Times.end());
+  if (!Times.empty()) {
+    Result.P50 = Times[(Times.size() - 1) / 2];
+    Result.P90 = Times[(Times.size() - 1) * 9 / 10];
+  }
+  if (pProgram)
+    MeasureDxil(pProgram, Result);
+  return Result;
+}
+
+static std::map<std::string, BaselineEntry>
+ReadBaseline(const std::string &Path) {
+  std::map<std::string, BaselineEntry> Baseline;
+  std::ifstream File(Path);
+  if (!File)
+    throw hlsl::Exception(E_INVALIDARG, "unable to open " + Path);
+  std::string Line;
+  while (std::getline(File, Line)) {
+    if (Line.empty() || Line[0] == '#')
+      continue;
+    std::istringstream Fields(Line);
+    std::string Name;
+    BaselineEntry Entry;
+    if (Fields >> Name >> Entry.P50 >> Entry.P90 >> Entry.PeakBytes)
+      Baseline[Name] = Entry;
+  }
+  return Baseline;
+}
+
+static void WriteBaseline(const std::string &Path,
+                          const std::vector<BenchResult> &Results) {
+  std::ofstream File(Path);
+  if (!File)
+    throw hlsl::Exception(E_INVALIDARG, "unable to write " + Path);
+  File << "# name\tp50 ms\tp90 ms\tpeak bytes\n";
+  for (const BenchResult &Result : Results) {
+    if (!Result.Failed)
+      File << Result.Name << '\t' << Result.P50 << '\t' << Result.P90 << '\t'
+           << Result.PeakBytes << '\n';
+  }
+}
+
+int main(int argc, const char **argv) {
+  const char *pStage = "Operation";
+  try {
+    pStage = "Argument processing";
+
+    // Parse command line options.
+    cl::ParseCommandLineOptions(argc, argv, "dxc compile-time benchmark\n");
+
+    std::vector<BenchShader> Shaders;
+    if (!CorpusFilename.empty())
+      ReadCorpus(CorpusFilename, Shaders);
+    for (const std::string &Input : InputFilenames) {
+      BenchShader Shader;
+      if (!ReadShaderFile(Input, Shader))
+        throw hlsl::Exception(E_INVALIDARG,
+                              "no %dxc RUN line with a target in " + Input);
+      Shaders.push_back(std::move(Shader));
+    }
+    if (!NoSynthetic)
+      AddSyntheticShaders(Shaders);
+    if (TableMegabytes != 0)
+      AddTableShader(Shaders, TableMegabytes);
+    if (Iterations == 0)
+      throw hlsl::Exception(E_INVALIDARG, "-n must be at least 1");
+
+    std::map<std::string, BaselineEntry> Baseline;
+    if (!BaselineFilename.empty())
+      Baseline = ReadBaseline(BaselineFilename);
+
+    DxcDllSupport dxcSupport;
+    dxc::EnsureEnabled(dxcSupport);
+
+    pStage = "Benchmark";
+    BenchContext context(dxcSupport);
+    std::vector<BenchResult> Results;
+    unsigned Failures = 0;
+    unsigned Regressions = 0;
+    printf("%-40s %10s %10s %12s %9s %11s %9s\n", "shader", "p50 ms",
+           "p90 ms", "peak KiB", "vs base", "DXIL bytes", "load ms");
+    for (const BenchShader &Shader : Shaders) {
+      BenchResult Result = context.Run(Shader);
+      if (Result.Failed) {
+        printf("%-40s failed\n", Result.Name.c_str());
+        ++Failures;
+        Results.push_back(std::move(Result));
+        continue;
+      }
+      char PeakText[32] = "-";
+      if (Result.PeakBytes >= 0)
+        sprintf_s(PeakText, _countof(PeakText), "%lld",
+                  (long long)(Result.PeakBytes / 1024));
+      char DeltaText[32] = "";
+      auto Base = Baseline.find(Result.Name);
+      if (Base != Baseline.end() && Base->second.P50 > 0) {
+        double Delta = (Result.P50 / Base->second.P50 - 1) * 100;
+        bool Regressed = Delta > Threshold;
+        Regressions += Regressed;
+        sprintf_s(DeltaText, _countof(DeltaText), "%+.1f%%%s", Delta,
+                  Regressed ? " !" : "");
+      }
+      char DxilText[32] = "-";
+      if (Result.DxilBytes >= 0)
+        sprintf_s(DxilText, _countof(DxilText), "%lld",
+                  (long long)Result.DxilBytes);
+      char LoadText[32] = "-";
+      if (Result.LoadP50 >= 0)
+        sprintf_s(LoadText, _countof(LoadText), "%.3f", Result.LoadP50);
+      printf("%-40s %10.2f %10.2f %12s %9s %11s %9s\n", Result.Name.c_str(),
+             Result.P50, Result.P90, PeakText, DeltaText, DxilText, LoadText);
+      for (size_t i = 0; i < Result.Passes.size() && i < TopPasses; ++i)
+        printf("    %-36s %10.2f\n", Result.Passes[i].first.c_str(),
+               Result.Passes[i].second * 1000);
+      Results.push_back(std::move(Result));
+    }
+
+    if (!SaveBaselineFilename.empty())
+      WriteBaseline(SaveBaselineFilename, Results);
+    if (Regressions)
+      printf("%u shader(s) more than %.1f%% slower than the baseline.\n",
+             Regressions, (double)Threshold);
+    if (Failures || Regressions)
+      return 1;
+  } catch (const ::hlsl::Exception &hlslException) {
+    try {
+      const char *msg = hlslException.what();
+      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                          // UTF-8 because we use ASCII only errors
+                                          // only
+      if (msg == nullptr || *msg == '\0') {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "%s failed - error code 0x%08x.", pStage, hlslException.hr);
+        msg = printBuffer;
+      }
+      printf("%s\n", msg);
+    } catch (...) {
+      printf("%s failed - unable to retrieve error message.\n", pStage);
+    }
+
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,462 @@
+///////////////////////////////////////////////////////////////////////////////
+//                                                                           //
+// dxc_quality.cpp                                                           //
+// Copyright (C) Microsoft Corporation. All rights reserved.                 //
+// This file is distributed under the University of Illinois Open Source     //
+// License. See LICENSE.TXT for details.                                     //
+//                                                                           //
+// Provides the entry point for the dxc_quality console program.             //
+//                                                                           //
+///////////////////////////////////////////////////////////////////////////////
+
+// dxc_quality compiles a set of shaders once each and records what the
+// generated code looks like, so that optimizer regressions (a lost CSE, an
+// extra cbuffer load, a local array that is no longer promoted) show up as a
+// diff against a checked-in baseline rather than in a driver's profiles.
+//
+// For each entry in the shader statistics (STAT) part it records the
+// instruction count, the calls of each DXIL operation class, the temp array
+// and groupshared bytes. For each shader with a pipeline state validation
+// (PSV0) part it records the resource count and the packed rows of each
+// signature. Libraries have no PSV0 part, so they only get the entries.
+//
+// Every metric counts something the driver pays for, so a value above the
+// baseline is a regression and a value below it is an improvement; both are
+// listed, and -save-baseline refreshes the file once a change is accepted.
+// Metrics missing on either side count as zero. A shader the baseline has
+// nothing for fails the comparison too, so a shader added to the corpus, or a
+// baseline that was never generated, can't pass unchecked.
+
+#include "dxc/Support/Global.h"
+#include "dxc/Support/Unicode.h"
+#include "dxc/Support/WinIncludes.h"
+
+#include "dxc/dxcapi.h"
+#include "dxc/Support/dxcapi.use.h"
+#include "dxc/Support/HLSLOptions.h"
+#include "dxc/DxilContainer/DxilContainer.h"
+#include "dxc/DxilContainer/DxilPipelineStateValidation.h"
+#include "dxc/DxilContainer/DxilShaderStatistics.h"
+#include "dxc/DXIL/DxilOperations.h"
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Path.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace dxc;
+using namespace llvm;
+using namespace hlsl::options;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::desc("<input hlsl files>"));
+
+static cl::opt<std::string>
+CorpusFilename("corpus", cl::desc("File listing the shaders to compile"),
+               cl::value_desc("filename"));
+
+static cl::list<std::string>
+ExtraArguments("arg", cl::desc("Argument to add to every compile"),
+               cl::value_desc("argument"));
+
+static cl::opt<std::string>
+BaselineFilename("baseline", cl::desc("Baseline to compare against"),
+                 cl::value_desc("filename"));
+
+static cl::opt<std::string>
+SaveBaselineFilename("save-baseline", cl::desc("Write the results as a baseline"),
+                     cl::value_desc("filename"));
+
+static cl::opt<double>
+Tolerance("tolerance",
+          cl::desc("Growth of a metric over the baseline, in percent, that "
+                   "is still accepted (default 0)"),
+          cl::init(0.0));
+
+static cl::opt<bool>
+Verbose("v", cl::desc("List every metric, not only the changed ones"));
+
+namespace {
+
+struct QualityShader {
+  std::string Name;
+  std::string SourceName;
+  std::string EntryPoint;
+  std::string TargetProfile;
+  std::vector<std::string> Arguments;
+};
+
+// Metrics by "<shader>\t<entry>\t<metric>"; shader-wide metrics use "-" for
+// the entry.
+typedef std::map<std::string, uint64_t> MetricMap;
+
+} // namespace
+
+// Takes the arguments of the first %dxc RUN line, up to the pipe or
+// redirection, and splits out the entry point and target.
+static bool ReadRunLine(const std::string &Source, QualityShader &Shader) {
+  std::istringstream Lines(Source);
+  std::string Line;
+  while (std::getline(Lines, Line)) {
+    size_t Pos = Line.find("RUN:");
+    if (Pos == std::string::npos)
+      continue;
+    size_t Dxc = Line.find("%dxc", Pos);
+    if (Dxc == std::string::npos)
+      continue;
+    std::istringstream Tokens(Line.substr(Dxc + 4));
+    std::vector<std::string> Args;
+    std::string Token;
+    while (Tokens >> Token) {
+      if (Token == "|" || Token[0] == '>' || Token == "2>&1")
+        break;
+      if (Token == "%s")
+        continue;
+      Token.erase(std::remove(Token.begin(), Token.end(), '"'), Token.end());
+      Args.push_back(Token);
+    }
+    Shader.EntryPoint = "main";
+    for (size_t i = 0; i < Args.size(); ++i) {
+      StringRef Arg(Args[i]);
+      if (Arg.size() < 2 || (Arg[0] != '-' && Arg[0] != '/') ||
+          (Arg[1] != 'E' && Arg[1] != 'T')) {
+        Shader.Arguments.push_back(Args[i]);
+        continue;
+      }
+      std::string Value = Arg.substr(2);
+      if (Value.empty() && i + 1 < Args.size())
+        Value = Args[++i];
+      (Arg[1] == 'E' ? Shader.EntryPoint : Shader.TargetProfile) = Value;
+    }
+    // Libraries have no single entry point.
+    if (StringRef(Shader.TargetProfile).startswith("lib_"))
+      Shader.EntryPoint.clear();
+    return !Shader.TargetProfile.empty();
+  }
+  return false;
+}
+
+static bool ReadShaderFile(const std::string &Path, QualityShader &Shader) {
+  std::ifstream File(Path, std::ios::binary);
+  if (!File)
+    return false;
+  std::stringstream Contents;
+  Contents << File.rdbuf();
+  Shader.Name = sys::path::filename(Path);
+  Shader.SourceName = Path;
+  return ReadRunLine(Contents.str(), Shader);
+}
+
+static void ReadCorpus(const std::string &ListPath,
+                       std::vector<QualityShader> &Shaders) {
+  std::ifstream List(ListPath);
+  if (!List)
+    throw hlsl::Exception(E_INVALIDARG, "unable to open " + ListPath);
+  StringRef Dir = sys::path::parent_path(ListPath);
+  std::string Line;
+  while (std::getline(List, Line)) {
+    StringRef Entry = StringRef(Line).trim();
+    if (Entry.empty() || Entry[0] == '#')
+      continue;
+    SmallString<256> Path(Dir);
+    sys::path::append(Path, Entry);
+    QualityShader Shader;
+    if (!ReadShaderFile(Path.str(), Shader))
+      throw hlsl::Exception(E_INVALIDARG,
+                            "no %dxc RUN line with a target in " +
+                                Path.str().str());
+    Shaders.push_back(std::move(Shader));
+  }
+}
+
+static void AddMetric(MetricMap &Metrics, const std::string &Shader,
+                      const std::string &Entry, const std::string &Metric,
+                      uint64_t Value) {
+  Metrics[Shader + '\t' + (Entry.empty() ? "-" : Entry) + '\t' + Metric] +=
+      Value;
+}
+
+// Records the per-entry metrics of the STAT part.
+static bool ReadStatistics(const hlsl::DxilContainerHeader *pHeader,
+                           const std::string &Shader, MetricMap &Metrics) {
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_ShaderStatistics);
+  if (pPart == nullptr)
+    return false;
+  const hlsl::DxilShaderStatisticsHeader *pStats =
+      reinterpret_cast<const hlsl::DxilShaderStatisticsHeader *>(
+          hlsl::GetDxilPartData(pPart));
+  if (!hlsl::IsValidDxilShaderStatistics(pStats, pPart->PartSize))
+    return false;
+  const hlsl::DxilShaderStatisticsOpCount *pOpCounts =
+      hlsl::GetDxilShaderStatisticsOpCounts(pStats);
+  const char *pStrings = hlsl::GetDxilShaderStatisticsStrings(pStats);
+  for (uint32_t i = 0; i < pStats->EntryCount; ++i) {
+    hlsl::DxilShaderStatisticsEntry Entry;
+    if (!hlsl::GetDxilShaderStatisticsEntry(pStats, i, &Entry))
+      return false;
+    std::string Name = pStrings + Entry.Name;
+    AddMetric(Metrics, Shader, Name, "instructions", Entry.InstructionCount);
+    AddMetric(Metrics, Shader, Name, "temp-array-bytes", Entry.TempArrayBytes);
+    AddMetric(Metrics, Shader, Name, "groupshared-bytes",
+              Entry.GroupSharedBytes);
+    for (uint32_t j = 0; j < Entry.OpCountCount; ++j) {
+      const hlsl::DxilShaderStatisticsOpCount &Op =
+          pOpCounts[Entry.FirstOpCount + j];
+      if (Op.OpCode >= (uint32_t)hlsl::DXIL::OpCode::NumOpCodes)
+        continue;
+      AddMetric(Metrics, Shader, Name,
+                std::string("class.") +
+                    hlsl::OP::GetOpCodeClassName((hlsl::DXIL::OpCode)Op.OpCode),
+                Op.Count);
+    }
+  }
+  return true;
+}
+
+// Records the resource count and signature rows of the PSV0 part.
+static void ReadPipelineState(const hlsl::DxilContainerHeader *pHeader,
+                              const std::string &Shader, MetricMap &Metrics) {
+  const hlsl::DxilPartHeader *pPart =
+      hlsl::GetDxilPartByType(pHeader, hlsl::DFCC_PipelineStateValidation);
+  if (pPart == nullptr)
+    return;
+  DxilPipelineStateValidation PSV;
+  if (!PSV.InitFromPSV0(hlsl::GetDxilPartData(pPart), pPart->PartSize))
+    return;
+  AddMetric(Metrics, Shader, "", "resources", PSV.GetBindCount());
+  const PSVRuntimeInfo1 *pInfo1 = PSV.GetPSVRuntimeInfo1();
+  if (pInfo1 == nullptr)
+    return;
+  unsigned OutputRows = 0;
+  for (unsigned i = 0; i < _countof(pInfo1->SigOutputVectors); ++i)
+    OutputRows += pInfo1->SigOutputVectors[i];
+  AddMetric(Metrics, Shader, "", "input-rows", pInfo1->SigInputVectors);
+  AddMetric(Metrics, Shader, "", "output-rows", OutputRows);
+  // MaxVertexCount shares the field in geometry shaders.
+  if (PSV.IsHS() || PSV.IsDS())
+    AddMetric(Metrics, Shader, "", "patch-constant-rows",
+              pInfo1->SigPatchConstantVectors);
+}
+
+class QualityContext {
+private:
+  DxcDllSupport &m_dxcSupport;
+  CComPtr<IDxcLibrary> m_pLibrary;
+  CComPtr<IDxcCompiler> m_pCompiler;
+
+public:
+  QualityContext(DxcDllSupport &dxcSupport) : m_dxcSupport(dxcSupport) {
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcLibrary, &m_pLibrary));
+    IFT(m_dxcSupport.CreateInstance(CLSID_DxcCompiler, &m_pCompiler));
+  }
+
+  bool Run(const QualityShader &Shader, MetricMap &Metrics);
+};
+
+bool QualityContext::Run(const QualityShader &Shader, MetricMap &Metrics) {
+  CComPtr<IDxcBlobEncoding> pSource;
+  ReadFileIntoBlob(m_dxcSupport, StringRefUtf16(Shader.SourceName), &pSource);
+  CComPtr<IDxcIncludeHandler> pIncludeHandler;
+  IFT(m_pLibrary->CreateIncludeHandler(&pIncludeHandler));
+
+  std::vector<std::wstring> Args;
+  for (const std::string &Arg : Shader.Arguments)
+    Args.push_back(Unicode::UTF8ToUTF16StringOrThrow(Arg.c_str()));
+  for (const std::string &Arg : ExtraArguments)
+    Args.push_back(Unicode::UTF8ToUTF16StringOrThrow(Arg.c_str()));
+  std::vector<LPCWSTR> ArgPtrs;
+  for (const std::wstring &Arg : Args)
+    ArgPtrs.push_back(Arg.c_str());
+
+  std::wstring SourceName =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.SourceName.c_str());
+  std::wstring EntryPoint =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.EntryPoint.c_str());
+  std::wstring TargetProfile =
+      Unicode::UTF8ToUTF16StringOrThrow(Shader.TargetProfile.c_str());
+  CComPtr<IDxcOperationResult> pResult;
+  HRESULT status;
+  IFT(m_pCompiler->Compile(pSource, SourceName.c_str(), EntryPoint.c_str(),
+                           TargetProfile.c_str(), ArgPtrs.data(),
+                           (UINT32)ArgPtrs.size(), nullptr, 0,
+                           pIncludeHandler, &pResult));
+  IFT(pResult->GetStatus(&status));
+  if (FAILED(status)) {
+    CComPtr<IDxcBlobEncoding> pErrors;
+    if (SUCCEEDED(pResult->GetErrorBuffer(&pErrors)) &&
+        pErrors->GetBufferSize())
+      fprintf(stderr, "%s: %.*s\n", Shader.Name.c_str(),
+              (int)pErrors->GetBufferSize(),
+              (const char *)pErrors->GetBufferPointer());
+    return false;
+  }
+
+  CComPtr<IDxcBlob> pProgram;
+  IFT(pResult->GetResult(&pProgram));
+  const hlsl::DxilContainerHeader *pHeader = hlsl::IsDxilContainerLike(
+      pProgram->GetBufferPointer(), pProgram->GetBufferSize());
+  if (pHeader == nullptr || !ReadStatistics(pHeader, Shader.Name, Metrics)) {
+    fprintf(stderr, "%s: no shader statistics part in the output\n",
+            Shader.Name.c_str());
+    return false;
+  }
+  ReadPipelineState(pHeader, Shader.Name, Metrics);
+  return true;
+}
+
+static MetricMap ReadBaseline(const std::string &Path) {
+  MetricMap Baseline;
+  std::ifstream File(Path);
+  if (!File)
+    throw hlsl::Exception(E_INVALIDARG, "unable to open " + Path);
+  std::string Line;
+  while (std::getline(File, Line)) {
+    if (Line.empty() || Line[0] == '#')
+      continue;
+    size_t Tab = Line.rfind('\t');
+    if (Tab == std::string::npos)
+      continue;
+    uint64_t Value = 0;
+    if (std::istringstream(Line.substr(Tab + 1)) >> Value)
+      Baseline[Line.substr(0, Tab)] = Value;
+  }
+  return Baseline;
+}
+
+static void WriteBaseline(const std::string &Path, const MetricMap &Metrics) {
+  std::ofstream File(Path);
+  if (!File)
+    throw hlsl::Exception(E_INVALIDARG, "unable to write " + Path);
+  File << "# Generated by dxc_quality -save-baseline; do not edit by hand.\n"
+          "# shader\tentry\tmetric\tvalue\n";
+  for (const auto &Metric : Metrics)
+    File << Metric.first << '\t' << Metric.second << '\n';
+}
+
+int main(int argc, const char **argv) {
+  const char *pStage = "Operation";
+  try {
+    pStage = "Argument processing";
+
+    // Parse command line options.
+    cl::ParseCommandLineOptions(argc, argv, "dxc generated-code quality\n");
+
+    std::vector<QualityShader> Shaders;
+    if (!CorpusFilename.empty())
+      ReadCorpus(CorpusFilename, Shaders);
+    for (const std::string &Input : InputFilenames) {
+      QualityShader Shader;
+      if (!ReadShaderFile(Input, Shader))
+        throw hlsl::Exception(E_INVALIDARG,
+                              "no %dxc RUN line with a target in " + Input);
+      Shaders.push_back(std::move(Shader));
+    }
+
+    MetricMap Baseline;
+    if (!BaselineFilename.empty())
+      Baseline = ReadBaseline(BaselineFilename);
+
+    DxcDllSupport dxcSupport;
+    dxc::EnsureEnabled(dxcSupport);
+
+    pStage = "Compilation";
+    QualityContext context(dxcSupport);
+    MetricMap Metrics;
+    unsigned Failures = 0;
+    for (const QualityShader &Shader : Shaders) {
+      if (!context.Run(Shader, Metrics)) {
+        printf("%s failed\n", Shader.Name.c_str());
+        ++Failures;
+      }
+    }
+
+    std::set<std::string> BaselineShaders;
+    for (const auto &Metric : Baseline)
+      BaselineShaders.insert(Metric.first.substr(0, Metric.first.find('\t')));
+
+    // Walk the union of both sides, in order.
+    unsigned Regressions = 0;
+    unsigned NewShaders = 0;
+    unsigned Improvements = 0;
+    auto Cur = Metrics.begin();
+    auto Base = Baseline.begin();
+    while (Cur != Metrics.end() || Base != Baseline.end()) {
+      const std::string *pName;
+      uint64_t Value = 0, BaseValue = 0;
+      if (Base == Baseline.end() ||
+          (Cur != Metrics.end() && Cur->first < Base->first)) {
+        pName = &Cur->first;
+        Value = (Cur++)->second;
+      } else if (Cur == Metrics.end() || Base->first < Cur->first) {
+        pName = &Base->first;
+        BaseValue = (Base++)->second;
+      } else {
+        pName = &Cur->first;
+        Value = (Cur++)->second;
+        BaseValue = (Base++)->second;
+      }
+      if (BaselineFilename.empty()) {
+        printf("%s\t%llu\n", pName->c_str(), (unsigned long long)Value);
+        continue;
+      }
+      const char *pMark = "";
+      if (!BaselineShaders.count(pName->substr(0, pName->find('\t')))) {
+        ++NewShaders;
+        pMark = " (new)";
+      } else if (Value > BaseValue * (1 + Tolerance / 100)) {
+        pMark = " !";
+        ++Regressions;
+      } else if (Value < BaseValue) {
+        ++Improvements;
+      } else if (!Verbose) {
+        continue;
+      }
+      printf("%s\t%llu -> %llu%s\n", pName->c_str(),
+             (unsigned long long)BaseValue, (unsigned long long)Value, pMark);
+    }
+
+    if (!SaveBaselineFilename.empty())
+      WriteBaseline(SaveBaselineFilename, Metrics);
+    if (!BaselineFilename.empty())
+      printf("%u metric(s) worse and %u better than the baseline, %u new.\n",
+             Regressions, Improvements, NewShaders);
+    if (NewShaders && SaveBaselineFilename.empty())
+      printf("Shaders missing from the baseline; run dxc-quality-baseline and "
+             "check in %s.\n", BaselineFilename.c_str());
+    if (Failures || Regressions || (NewShaders && SaveBaselineFilename.empty()))
+      return 1;
+  } catch (const ::hlsl::Exception &hlslException) {
+    try {
+      const char *msg = hlslException.what();
+      Unicode::acp_char printBuffer[128]; // printBuffer is safe to treat as
+                                          // UTF-8 because we use ASCII only errors
+                                          // only
+      if (msg == nullptr || *msg == '\0') {
+        sprintf_s(printBuffer, _countof(printBuffer),
+                  "%s failed - error code 0x%08x.", pStage, hlslException.hr);
+        msg = printBuffer;
+      }
+      printf("%s\n", msg);
+    } catch (...) {
+      printf("%s failed - unable to retrieve error message.\n", pStage);
+    }
+
+    return 1;
+  } catch (std::bad_alloc &) {
+    printf("%s failed - out of memory.\n", pStage);
+    return 1;
+  } catch (...) {
+    printf("%s failed - unknown error.\n", pStage);
+    return 1;
+  }
+
+  return 0;
+}
@@ -64,6 +64,7 @@ class db_dxil_inst(object):
         self.is_deriv = False           # whether this is some kind of derivative
         self.is_gradient = False        # whether this requires a gradient calculation
         self.is_wave = False            # whether this requires in-wave, cross-lane functionality
+        self.is_const_foldable = False  # whether calls with constant operands are folded to a constant
         self.requires_uniform_inputs = False  # whether this operation requires that all of its inputs are uniform across the wave
         self.shader_stages = ()         # shader stages to which this applies, empty for all.
         self.shader_model = 6,0         # minimum shader model required
@@ -311,6 +312,11 @@ class db_dxil(object):
             self.name_idx[i].category = "Other"
         for i in "LegacyF32ToF16,LegacyF16ToF32".split(","):
             self.name_idx[i].category = "Legacy floating-point"
+        for i in ("FAbs,Saturate,IsNaN,IsInf,IsFinite,IsNormal,Cos,Sin,Tan,Acos,Asin,Atan,Hcos,Hsin,Htan,Exp,Frc,Log,Sqrt,Rsqrt,"
+                  "Round_ne,Round_ni,Round_pi,Round_z,Bfrev,Countbits,FirstbitLo,FirstbitHi,FirstbitSHi,"
+                  "FMax,FMin,IMax,IMin,UMax,UMin,UDiv,UAddc,USubb,FMad,Fma,IMad,UMad,Msad,Ibfe,Ubfe,Bfi,"
+                  "Dot2,Dot3,Dot4,MakeDouble,LegacyF16ToF32,Dot2AddHalf,Dot4AddI8Packed,Dot4AddU8Packed").split(","):
+            self.name_idx[i].is_const_foldable = True
         for i in self.instr:
             if i.name.startswith("Wave") or i.name.startswith("Quad") or i.name == "GlobalOrderedCountInc":
                 i.category = "Wave"
@@ -1522,7 +1528,8 @@ class db_dxil(object):
             {'n':'add-pixel-cost','t':'int','c':1},
             {'n':'rt-width','t':'int','c':1},
             {'n':'sv-position-index','t':'int','c':1},
-            {'n':'num-pixels','t':'int','c':1}])
+            {'n':'num-pixels','t':'int','c':1},
+            {'n':'wave-aggregate','t':'int','c':1,'d':'Count the lanes of a wave that hit the same pixel with one atomic (shader model 6.0+).'}])
         add_pass('hlsl-dxil-constantColor', 'DxilOutputColorBecomesConstant', 'DXIL Constant Color Mod', [
             {'n':'mod-mode','t':'int','c':1},
             {'n':'constant-red','t':'float','c':1},
@@ -1533,13 +1540,28 @@ class db_dxil(object):
         add_pass('hlsl-dxil-force-early-z', 'DxilForceEarlyZ', 'HLSL DXIL Force the early Z global flag, if shader has no discard calls', [])
         add_pass('hlsl-dxil-pix-shader-access-instrumentation', 'DxilShaderAccessTracking', 'HLSL DXIL shader access tracking for PIX', [
             {'n':'config','t':'int','c':1},
-            {'n':'checkForDynamicIndexing','t':'bool','c':1}])
+            {'n':'checkForDynamicIndexing','t':'bool','c':1},
+            {'n':'wave-aggregate','t':'bool','c':1,'d':'Record the accesses of a wave to the same slot with one atomic (shader model 6.0+).'},
+            {'n':'compact','t':'bool','c':1,'d':'Pack the flags of eight slots into each uint, and list out-of-bounds accesses separately.'},
+            {'n':'overflow-size','t':'int','c':1,'d':'Number of entries in the out-of-bounds access list of the compact encoding.'}])
         add_pass('hlsl-dxil-debug-instrumentation', 'DxilDebugInstrumentation', 'HLSL DXIL debug instrumentation for PIX', [
             {'n':'UAVSize','t':'int','c':1},
             {'n':'parameter0','t':'int','c':1},
             {'n':'parameter1','t':'int','c':1},
-            {'n':'parameter2','t':'int','c':1}])
+            {'n':'parameter2','t':'int','c':1},
+            {'n':'FirstInstruction','t':'int','c':1,'d':'First instruction number that is instrumented.'},
+            {'n':'LastInstruction','t':'int','c':1,'d':'Last instruction number that is instrumented.'},
+            {'n':'FirstLine','t':'int','c':1,'d':'First source line that is instrumented.'},
+            {'n':'LastLine','t':'int','c':1,'d':'Last source line that is instrumented.'},
+            {'n':'Function','t':'string','c':1,'d':'Only instrument instructions from this function.'}])
         add_pass('dxil-annotate-with-virtual-regs', 'DxilAnnotateWithVirtualRegister', 'Annotates each instruction in the DXIL module with a virtual register number', [])
+        add_pass('hlsl-dxil-block-count-instrumentation', 'DxilBlockCountInstrumentation', 'HLSL DXIL basic block count instrumentation for PIX', [
+            {'n':'wave-aggregate','t':'bool','c':1,'d':'Count the lanes of a wave that run a block with one atomic (shader model 6.0+).'}])
+        add_pass('hlsl-dxil-timestamp-instrumentation', 'DxilTimestampInstrumentation', 'HLSL DXIL timestamp instrumentation for PIX', [
+            {'n':'clock-function','t':'string','c':1,'d':'Function of the shader clock extension that returns the clock.'},
+            {'n':'regions','t':'string','c':1,'d':'Source line ranges to time, as first-last,first-last...'},
+            {'n':'ring-size','t':'int','c':1,'d':'Number of records in the ring buffer.'},
+            {'n':'wave-aggregate','t':'bool','c':1,'d':'Record once per wave (shader model 6.0+).'}])
         add_pass('hlsl-dxil-reduce-msaa-to-single', 'DxilReduceMSAAToSingleSample', 'HLSL DXIL Reduce all MSAA reads to single-sample reads', [])
 
         category_lib="dxil_gen"
@@ -1565,29 +1587,78 @@ class db_dxil(object):
         add_pass('hlsl-dxil-precise', 'DxilPrecisePropagatePass', 'DXIL precise attribute propagate', [])
         add_pass('dxil-legalize-sample-offset', 'DxilLegalizeSampleOffsetPass', 'DXIL legalize sample offset', [])
         add_pass('dxil-gvn-hoist', 'DxilSimpleGVNHoist', 'DXIL simple gvn hoist', [])
+        add_pass('dxil-gvn-eliminate', 'DxilSimpleGVNEliminate', 'DXIL simple gvn eliminate', [])
+        add_pass('dxil-coalesce-raw-buffer', 'DxilCoalesceRawBufferAccess', 'DXIL coalesce raw buffer access', [])
+        add_pass('dxil-hoist-resource-ops', 'DxilHoistResourceOps', 'DXIL hoist loop-invariant resource operations', [])
+        add_pass('dxil-uniform-resource-index', 'DxilUniformResourceIndex', 'DXIL clear non-uniform flag of uniform resource indices', [
+            {'n':'InferNonUniform', 't':'bool', 'c':1, 'd':'Set the non-uniform flag exactly when the index may differ between lanes, and warn on each change'}])
+        add_pass('dxil-wave-aggregate-atomics', 'DxilWaveAggregateAtomics', 'DXIL wave aggregate atomics', [
+            {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each atomic combined.'}])
         add_pass('hlsl-hlensure', 'HLEnsureMetadata', 'HLSL High-Level Metadata Ensure', [])
         add_pass('multi-dim-one-dim', 'MultiDimArrayToOneDimArray', 'Flatten multi-dim array into one-dim array', [])
         add_pass('resource-handle', 'ResourceToHandle', 'Lower resource into handle', [])
         add_pass('hlsl-passes-nopause', 'NoPausePasses', 'Clears metadata used for pause and resume', [])
         add_pass('hlsl-passes-pause', 'PausePasses', 'Prepare to pause passes', [])
         add_pass('hlsl-passes-resume', 'ResumePasses', 'Prepare to resume passes', [])
-        add_pass('hlsl-dxil-condense', 'DxilCondenseResources', 'DXIL Condense Resources', [])
+        add_pass('hlsl-dxil-condense', 'DxilCondenseResources', 'DXIL Condense Resources', [
+                {'n':'Contiguous', 't':'bool', 'c':1, 'd':'Pack the resources without a register of each class, and warn with the matching descriptor tables.'},
+                {'n':'UpdateOrder', 't':'string', 'c':1, 'd':'Resources packed with Contiguous, most frequently updated first, as name;name...'}])
         add_pass('hlsl-dxil-lower-handle-for-lib', 'DxilLowerCreateHandleForLib', 'DXIL Lower createHandleForLib', [])
         add_pass('hlsl-dxil-allocate-resources-for-lib', 'DxilAllocateResourcesForLib', 'DXIL Allocate Resources For Library', [])
         add_pass('hlsl-dxil-convergent-mark', 'DxilConvergentMark', 'Mark convergent', [])
         add_pass('hlsl-dxil-convergent-clear', 'DxilConvergentClear', 'Clear convergent before dxil emit', [])
         add_pass('hlsl-dxil-eliminate-output-dynamic', 'DxilEliminateOutputDynamicIndexing', 'DXIL eliminate ouptut dynamic indexing', [])
+        add_pass('dxil-eliminate-dead-output-stores', 'DxilEliminateDeadOutputStores', 'DXIL eliminate dead output stores', [])
+        add_pass('dxil-position-only', 'DxilPositionOnly', 'DXIL position only', [])
+        add_pass('dxil-pass-through-hull-shader', 'DxilPassThroughHullShader', 'DXIL pass-through hull shader', [])
+        add_pass('dxil-pair-16bit-ops', 'DxilPair16BitOps', 'DXIL pair 16-bit operations', [])
+        add_pass('dxil-cluster-fetches', 'DxilClusterFetches', 'DXIL cluster fetches', [
+            {'n':'MaxLiveComponents', 't':'unsigned', 'c':1, 'd':'Largest number of used result components that a group of moved fetches keeps live.'}])
+        add_pass('dxil-reuse-derivatives', 'DxilReuseDerivatives', 'DXIL reuse derivatives', [])
+        add_pass('dxil-strength-reduce-buffer-indices', 'DxilStrengthReduceBufferIndices', 'DXIL strength reduce buffer indices', [])
+        add_pass('dxil-gather-texel-loads', 'DxilGatherTexelLoads', 'DXIL gather texel loads', [])
+        add_pass('hlsl-dxil-eliminate-local-dynamic', 'DxilEliminateLocalDynamicIndexing', 'DXIL eliminate local array dynamic indexing', [
+            {'n':'MaxElements', 't':'unsigned', 'c':1, 'd':'Largest number of elements of an array promoted to registers.'},
+            {'n':'MaxSelects', 't':'unsigned', 'c':1, 'd':'Largest number of selects that promoting an array may add.'},
+            {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each dynamically indexed array, and whether it was promoted.'}])
         add_pass('hlsl-dxilfinalize', 'DxilFinalizeModule', 'HLSL DXIL Finalize Module', [])
         add_pass('hlsl-dxilemit', 'DxilEmitMetadata', 'HLSL DXIL Metadata Emit', [])
         add_pass('hlsl-dxilload', 'DxilLoadMetadata', 'HLSL DXIL Metadata Load', [])
         add_pass('dxil-dfe', 'DxilDeadFunctionElimination', 'Remove all unused function except entry from DxilModule', [])
         add_pass('hl-dfe', 'HLDeadFunctionElimination', 'Remove all unused function except entry from HLModule', [])
         add_pass('hl-preprocess', 'HLPreprocess', 'Preprocess HLModule after inline', [])
-        add_pass('hlsl-dxil-expand-trig', 'DxilExpandTrigIntrinsics', 'DXIL expand trig intrinsics', [])
+        add_pass('hl-bind-constants', 'HLBindConstants', 'HLSL High-Level bind constants', [
+                {'n':'constants', 't':'string', 'c':1, 'd':'Values of the -late-bind-const static consts, as name:value;name:value...'}])
+        add_pass('hlsl-dxil-expand-trig-intrinsics', 'DxilExpandTrigIntrinsics', 'DXIL expand trig intrinsics', [
+                {'n':'Fast', 't':'bool', 'c':1, 'd':'Use lower degree approximations for calls that are not precise.'}])
+        add_pass('dxil-demote-output-precision', 'DxilDemoteOutputPrecision', 'DXIL demote output precision', [
+                {'n':'OutputBits', 't':'unsigned', 'c':1, 'd':'Bits per channel of the color targets and UNORM/SNORM resources written.'},
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each output computed in 16-bit precision.'}])
+        add_pass('dxil-select-control-flow-hints', 'DxilSelectControlFlowHints', 'DXIL select control flow hints', [
+                {'n':'BranchThreshold', 't':'unsigned', 'c':1, 'd':'Cost of a side above which a branch on a uniform condition is kept.'},
+                {'n':'DivergentBranchThreshold', 't':'unsigned', 'c':1, 'd':'Cost of both sides above which a branch on a divergent condition is kept.'},
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each hint selected, with its reason.'},
+                {'n':'BiasedRatio', 't':'unsigned', 'c':1, 'd':'Ratio of the profile weights of the sides above which a branch is kept.'},
+                {'n':'ProfiledOnly', 't':'bool', 'c':1, 'd':'Only hint branches that have profile weights.'}])
+        add_pass('dxil-groupshared-bank-conflicts', 'DxilGroupSharedBankConflicts', 'DXIL groupshared bank conflicts', [
+                {'n':'Banks', 't':'unsigned', 'c':1, 'd':'Number of groupshared memory banks.'},
+                {'n':'BankWidth', 't':'unsigned', 'c':1, 'd':'Width of a groupshared memory bank, in bytes.'},
+                {'n':'Pad', 't':'bool', 'c':1, 'd':'Pad the inner dimensions of arrays with conflicting accesses.'},
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each conflicting access and padded array.'}])
+        add_pass('dxil-infer-early-depth-stencil', 'DxilInferEarlyDepthStencil', 'DXIL infer early depth stencil', [
+                {'n':'Apply', 't':'bool', 'c':1, 'd':'Set [earlydepthstencil] on each pixel shader that can use it.'},
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each pixel shader that can use [earlydepthstencil].'}])
+        add_pass('dxil-root-constant-candidates', 'DxilRootConstantCandidates', 'DXIL root constant candidates', [
+                {'n':'MaxDWords', 't':'unsigned', 'c':1, 'd':'Largest cbuffer, in DWORDs, to recommend as root constants.'}])
+        add_pass('dxil-merge-identical-functions', 'DxilMergeIdenticalFunctions', 'DXIL merge identical functions', [
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each function merged.'}])
+        add_pass('dxil-eliminate-redundant-barriers', 'DxilEliminateRedundantBarriers', 'DXIL eliminate redundant barriers', [
+                {'n':'Report', 't':'bool', 'c':1, 'd':'Warn about each barrier or fence removed.'}])
         add_pass('hlsl-hca', 'HoistConstantArray', 'HLSL constant array hoisting', [])
         add_pass('hlsl-dxil-preserve-all-outputs', 'DxilPreserveAllOutputs', 'DXIL write to all outputs in signature', [])
         add_pass('red', 'ReducibilityAnalysis', 'Reducibility Analysis', [])
         add_pass('viewid-state', 'ComputeViewIdState', 'Compute information related to ViewID', [])
+        add_pass('control-dependence', 'ControlDependenceAnalysis', 'Control dependence analysis', [])
         add_pass('hlsl-translate-dxil-opcode-version', 'DxilTranslateRawBuffer', 'Translates one version of dxil to another', [])
 
         category_lib="llvm"
@@ -1614,11 +1685,15 @@ class db_dxil(object):
             {'n':'disable-licm-promotion', 'i':'DisablePromotion', 't':'bool', 'd':'Disable memory promotion in LICM pass'}])
         add_pass('loop-unswitch', 'LoopUnswitch', 'Unswitch loops', [
             {'n':'Os', 't':'bool', 'c':1, 'd':'Optimize for size'},
+            {'n':'UniformOnly', 't':'bool', 'c':1, 'd':'Only unswitch on wave-uniform conditions, in loops without barriers'},
+            {'n':'SizeBudget', 't':'unsigned', 'c':1, 'd':'Max loop size to unswitch, in DXIL instruction costs when UniformOnly'},
             {'n':'loop-unswitch-threshold', 'i':'Threshold', 't':'unsigned', 'd':'Max loop size to unswitch'}])
         # C:\nobackup\work\HLSLonLLVM\lib\Transforms\IPO\PassManagerBuilder.cpp:353
         add_pass('indvars', 'IndVarSimplify', "Induction Variable Simplification", [])
         add_pass('loop-idiom', 'LoopIdiomRecognize', "Recognize loop idioms", [])
-        add_pass('dxil-loop-unroll', 'DxilLoopUnroll', 'DxilLoopUnroll', [])
+        add_pass('dxil-loop-unroll', 'DxilLoopUnroll', 'DxilLoopUnroll', [
+            {'n':'MaxIterationAttempt', 't':'unsigned', 'c':1, 'd':'Maximum number of iterations to attempt when iteratively unrolling.'},
+            {'n':'MaxUnrolledSize', 't':'unsigned', 'c':1, 'd':'Maximum size, in cost units, that unrolled loops may add to a function.'}])
         add_pass('loop-deletion', 'LoopDeletion', "Delete dead loops", [])
         add_pass('loop-interchange', 'LoopInterchange', 'Interchanges loops for cache reuse', [])
         add_pass('loop-unroll', 'LoopUnroll', 'Unroll loops', [
@@ -700,6 +700,77 @@ def get_hlsl_intrinsics():
     result += "\n#endif // ENABLE_SPIRV_CODEGEN\n" if is_vk_table else ""  # SPIRV Change
     return result
 
+def hlsl_intrinsic_hash(name, num_args, seed):
+    # 32-bit FNV-1a over the name and argument count, starting from the seed.
+    # Must match HashIntrinsicKey in SemaHLSL.cpp.
+    h = (2166136261 ^ seed) & 0xffffffff
+    for c in name.encode("ascii") + bytes([0, num_args]):
+        h = ((h ^ c) * 16777619) & 0xffffffff
+    return h
+
+def build_hlsl_intrinsic_index(keys):
+    # Builds a hash-and-displace perfect hash over (name, argument count)
+    # keys: a key's bucket comes from the hash with seed 0, and the bucket's
+    # displacement is the seed that places all of its keys in free slots.
+    bucket_count = max(1, (len(keys) + 1) // 2)
+    slot_count = 1
+    while slot_count < 2 * len(keys):
+        slot_count *= 2
+    buckets = [[] for _ in range(bucket_count)]
+    for k in keys:
+        buckets[hlsl_intrinsic_hash(k[0], k[1], 0) % bucket_count].append(k)
+    displacements = [0] * bucket_count
+    slots = [0xffff] * slot_count
+    order = sorted(range(bucket_count), key=lambda b: -len(buckets[b]))
+    for b in order:
+        if not buckets[b]:
+            continue
+        seed = 1
+        while True:
+            placed = [hlsl_intrinsic_hash(k[0], k[1], seed) & (slot_count - 1) for k in buckets[b]]
+            if len(set(placed)) == len(placed) and all(slots[i] == 0xffff for i in placed):
+                break
+            seed += 1
+            assert seed < 0xffff, "no displacement found for intrinsic index"
+        displacements[b] = seed
+        for k, i in zip(buckets[b], placed):
+            slots[i] = keys[k]
+    return displacements, slots
+
+def get_hlsl_intrinsic_index():
+    # Emits, for every intrinsic table, a perfect hash from (name, argument
+    # count) to the first matching entry, and a list tying each index to its
+    # table.
+    db = get_db_hlsl()
+    tables = []
+    for i in sorted(db.intrinsics, key=lambda x: x.key):
+        if not tables or tables[-1][0] != i.ns:
+            tables.append((i.ns, i.vulkanSpecific, {}, [0]))
+        ns, vk, keys, count = tables[-1]
+        keys.setdefault((i.name, len(i.params)), count[0])
+        count[0] += 1
+    def format_values(values):
+        lines = []
+        for start in range(0, len(values), 16):
+            lines.append("    " + ", ".join("%d" % v for v in values[start:start + 16]) + ",\n")
+        return "".join(lines)
+    result = ""
+    for ns, vk, keys, count in tables:
+        displacements, slots = build_hlsl_intrinsic_index(keys)
+        text = "static const WORD g_%s_Displacements[] =\n{\n%s};\n\n" % (ns, format_values(displacements))
+        text += "static const WORD g_%s_Slots[] =\n{\n%s};\n\n" % (ns, format_values(slots))
+        result += ("#ifdef ENABLE_SPIRV_CODEGEN\n" + text + "#endif // ENABLE_SPIRV_CODEGEN\n\n") if vk else text
+    def format_entries(vk):
+        return "".join("    {g_%s, _countof(g_%s_Displacements), _countof(g_%s_Slots) - 1, g_%s_Displacements, g_%s_Slots},\n" % (ns, ns, ns, ns, ns)
+                       for ns, table_vk, keys, count in tables if table_vk == vk)
+    result += "static const HLSL_INTRINSIC_INDEX g_IntrinsicIndices[] =\n{\n"
+    result += format_entries(False)
+    vk_entries = format_entries(True)
+    if vk_entries:
+        result += "#ifdef ENABLE_SPIRV_CODEGEN\n" + vk_entries + "#endif // ENABLE_SPIRV_CODEGEN\n"
+    result += "};\n"
+    return result
+
 # SPIRV Change Starts
 def wrap_with_ifdef_if_vulkan_specific(intrinsic, text):
     if intrinsic.vulkanSpecific:
@@ -1144,6 +1215,7 @@ if __name__ == "__main__":
         files = [
             'docs/DXIL.rst',
             'lib/DXIL/DXILOperations.cpp',
+            'lib/Analysis/DxilConstantFolding.cpp',
             'include/dxc/DXIL/DXILConstants.h',
             'include/dxc/HLSL/DxilValidation.h',
             'include/dxc/DXIL/DxilInstructions.h',